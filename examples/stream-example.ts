@@ -14,7 +14,7 @@ async function analyzeAudioStream() {
 
   await pool.init({
     wasmPath: '/dist/wasm/lip-sync-engine.wasm',
-    dataPath: '/dist/wasm/lip-sync-engine.data',
+    modelsPath: '/dist/wasm/models',
     jsPath: '/dist/wasm/lip-sync-engine.js',
     workerScriptUrl: '/dist/worker.js'
   });
@@ -302,7 +302,11 @@
     { "-dictcase",						\
       ARG_BOOLEAN,						\
       "no",							\
-      "Dictionary is case sensitive (NOTE: case insensitivity applies to ASCII characters only)" }	\
+      "Dictionary is case sensitive (NOTE: case insensitivity applies to ASCII characters only)" },	\
+    { "-dictsubset",						\
+      ARG_BOOLEAN,						\
+      "no",							\
+      "Enter the words of a compiled main dictionary only when they are added, not when it is read" }	\
 
 /** Command-line options for acoustic modeling */
 #define POCKETSPHINX_ACMOD_OPTIONS \
@@ -374,6 +378,11 @@
       ARG_INT32,                                                                \
       "4",                                                                      \
       "Maximum number of top Gaussians to use in scoring." },                   \
+{ "-topn_block",                                                                \
+      ARG_INT32,                                                                \
+      "0",                                                                      \
+      "Number of queued frames whose top Gaussians are computed together, "     \
+      "codebook by codebook (0 for frame by frame; PTM models only)" },         \
 { "-topn_beam",                                                                 \
       ARG_STRING,                                                               \
       "0",                                                                     \
@@ -61,6 +61,7 @@
 #include "s2_semi_mgau.h"
 #include "ptm_mgau.h"
 #include "ms_mgau.h"
+#include "ps_refcount.h"
 
 #ifndef WORDS_BIGENDIAN
 #define WORDS_BIGENDIAN 1
@@ -68,6 +69,69 @@
 
 static int32 acmod_process_mfcbuf(acmod_t *acmod);
 
+/**
+ * A model file name, or NULL if the model directory doesn't have it.
+ */
+static char const *
+acmod_model_file(cmd_ln_t *config, char const *name)
+{
+    return cmd_ln_exists_r(config, name) ? cmd_ln_str_r(config, name) : NULL;
+}
+
+/**
+ * Whether the parameters of model were read from other files or with
+ * other parameters than those configured for acmod, so they can't be
+ * shared.
+ */
+static int
+acmod_params_mismatch(acmod_t *acmod, acmod_t *model)
+{
+    static char const *const files[] = {
+        "_mdef", "_tmat", "_mean", "_var", "_mixw", "_sendump", "_senmgau"
+    };
+    static char const *const floats[] = {
+        "-logbase", "-tmatfloor", "-varfloor", "-mixwfloor"
+    };
+    size_t i;
+
+    for (i = 0; i < sizeof(files) / sizeof(files[0]); ++i) {
+        char const *a = acmod_model_file(acmod->config, files[i]);
+        char const *b = acmod_model_file(model->config, files[i]);
+        if ((a == NULL) != (b == NULL) || (a && 0 != strcmp(a, b)))
+            return TRUE;
+    }
+    for (i = 0; i < sizeof(floats) / sizeof(floats[0]); ++i) {
+        if (cmd_ln_float32_r(acmod->config, floats[i])
+            != cmd_ln_float32_r(model->config, floats[i]))
+            return TRUE;
+    }
+    if (cmd_ln_boolean_r(acmod->config, "-mmap")
+        != cmd_ln_boolean_r(model->config, "-mmap"))
+        return TRUE;
+    /* Transformed Gaussians are the model's own. */
+    if (cmd_ln_str_r(acmod->config, "-mllr") || model->mllr)
+        return TRUE;
+    return FALSE;
+}
+
+/**
+ * Share the model definition, transition matrices and Gaussian
+ * parameters of model.  Only PTM mixtures can be shared.
+ */
+static int
+acmod_share_am(acmod_t *acmod, acmod_t *model)
+{
+    if (model->mgau == NULL || acmod_params_mismatch(acmod, model))
+        return -1;
+    if ((acmod->mgau = ptm_mgau_init_shared(acmod, model->mdef,
+                                            model->mgau)) == NULL)
+        return -1;
+    acmod->mdef = bin_mdef_retain(model->mdef);
+    acmod->tmat = tmat_retain(model->tmat);
+    E_INFO("Sharing acoustic model parameters\n");
+    return 0;
+}
+
 static int
 acmod_init_am(acmod_t *acmod)
 {
@@ -230,10 +294,18 @@ acmod_feat_mismatch(acmod_t *acmod, feat_t *fcb)
 
 acmod_t *
 acmod_init(cmd_ln_t *config, logmath_t *lmath, fe_t *fe, feat_t *fcb)
+{
+    return acmod_init_shared(config, lmath, fe, fcb, NULL);
+}
+
+acmod_t *
+acmod_init_shared(cmd_ln_t *config, logmath_t *lmath, fe_t *fe,
+                  feat_t *fcb, acmod_t *model)
 {
     acmod_t *acmod;
 
     acmod = ckd_calloc(1, sizeof(*acmod));
+    acmod->refcount = 1;
     acmod->config = cmd_ln_retain(config);
     acmod->lmath = lmath;
     acmod->state = ACMOD_IDLE;
@@ -265,8 +337,9 @@ acmod_init(cmd_ln_t *config, logmath_t *lmath, fe_t *fe, feat_t *fcb)
             goto error_out;
     }
 
-    /* Load acoustic model parameters. */
-    if (acmod_init_am(acmod) < 0)
+    /* Load acoustic model parameters, unless they can be shared. */
+    if ((model == NULL || acmod_share_am(acmod, model) < 0)
+        && acmod_init_am(acmod) < 0)
         goto error_out;
 
 
@@ -299,11 +372,20 @@ error_out:
     return NULL;
 }
 
+acmod_t *
+acmod_retain(acmod_t *acmod)
+{
+    ps_refcount_inc(&acmod->refcount);
+    return acmod;
+}
+
 void
 acmod_free(acmod_t *acmod)
 {
     if (acmod == NULL)
         return;
+    if (ps_refcount_dec(&acmod->refcount) > 0)
+        return;
 
     feat_free(acmod->fcb);
     fe_free(acmod->fe);
@@ -423,6 +505,52 @@ acmod_set_grow(acmod_t *acmod, int grow_feat)
     return tmp;
 }
 
+void
+acmod_compact(acmod_t *acmod, int max_frames)
+{
+    int32 n_base;
+
+    if (acmod->state == ACMOD_STARTED || acmod->state == ACMOD_PROCESSING)
+        return;
+
+    /* The size acmod_init() and acmod_set_grow() allocate. */
+    n_base = acmod->n_mfc_alloc + cmd_ln_int32_r(acmod->config, "-pl_window");
+    if (acmod->grow_feat && n_base < 128)
+        n_base = 128;
+    if (acmod->n_feat_alloc > max_frames && acmod->n_feat_alloc > n_base) {
+        feat_array_free(acmod->feat_buf);
+        acmod->feat_buf = feat_array_alloc(acmod->fcb, n_base);
+        acmod->framepos = ckd_realloc(acmod->framepos,
+                                      n_base * sizeof(*acmod->framepos));
+        acmod->n_feat_alloc = n_base;
+        acmod->n_feat_frame = 0;
+        acmod->feat_outidx = 0;
+    }
+
+    if (acmod->mgau->vt->compact)
+        acmod->mgau->vt->compact(acmod->mgau, max_frames);
+}
+
+int
+acmod_set_ds_ratio(acmod_t *acmod, int ds_ratio)
+{
+    int tmp = acmod->mgau->ds_ratio;
+
+    assert(ds_ratio >= 1);
+    acmod->mgau->ds_ratio = ds_ratio;
+    return tmp;
+}
+
+int
+acmod_set_cache_mode(acmod_t *acmod, int mode)
+{
+    int tmp = acmod->mgau->cache_mode;
+
+    assert(mode >= PS_MGAU_CACHE_OFF && mode <= PS_MGAU_CACHE_REPLAY);
+    acmod->mgau->cache_mode = mode;
+    return tmp;
+}
+
 int
 acmod_start_utt(acmod_t *acmod)
 {
@@ -1124,6 +1252,16 @@ acmod_get_frame(acmod_t *acmod, int *inout_frame_idx)
     return acmod->feat_buf[feat_idx];
 }
 
+mfcc_t **
+acmod_peek_frame(acmod_t *acmod, int frame_idx)
+{
+    if (frame_idx < acmod->output_frame
+        || frame_idx >= acmod->output_frame + acmod->n_feat_frame)
+        return NULL;
+    return acmod->feat_buf[(acmod->feat_outidx + frame_idx - acmod->output_frame)
+                           % acmod->n_feat_alloc];
+}
+
 int16 const *
 acmod_score(acmod_t *acmod, int *inout_frame_idx)
 {
@@ -108,11 +108,25 @@ typedef struct ps_mgaufuncs_s {
     int (*transform)(ps_mgau_t *mgau,
                      ps_mllr_t *mllr);
     void (*free)(ps_mgau_t *mgau);
+    /* Free per-utterance buffers sized for more than max_frames frames
+     * (see acmod_compact()), or NULL if there are none. */
+    void (*compact)(ps_mgau_t *mgau, int max_frames);
 } ps_mgaufuncs_t;    
 
+/**
+ * Modes of the codebook cache, see acmod_set_cache_mode().
+ */
+enum ps_mgau_cache_mode_e {
+    PS_MGAU_CACHE_OFF,    /**< Neither record nor replay. */
+    PS_MGAU_CACHE_RECORD, /**< Record the codebooks evaluated in each frame. */
+    PS_MGAU_CACHE_REPLAY  /**< Reuse the recorded codebooks. */
+};
+
 struct ps_mgau_s {
     ps_mgaufuncs_t *vt;  /**< vtable of mgau functions. */
     int frame_idx;       /**< frame counter. */
+    int ds_ratio;        /**< Frame downsampling ratio (-ds), if supported. */
+    int cache_mode;      /**< Mode of the codebook cache (ps_mgau_cache_mode_e), if supported. */
 };
 
 #define ps_mgau_base(mg) ((ps_mgau_t *)(mg))
@@ -146,6 +160,8 @@ struct ps_mgau_s {
  * asynchronous passes of recognition operating in parallel.
  */
 struct acmod_s {
+    int refcount;              /**< Reference count (see acmod_retain()). */
+
     /* Global objects, not retained. */
     cmd_ln_t *config;          /**< Configuration. */
     logmath_t *lmath;          /**< Log-math computation. */
@@ -219,6 +235,30 @@ typedef struct acmod_s acmod_t;
  */
 acmod_t *acmod_init(cmd_ln_t *config, logmath_t *lmath, fe_t *fe, feat_t *fcb);
 
+/**
+ * Initialize an acoustic model sharing the parameters of another.
+ *
+ * The model definition, transition matrices and Gaussian parameters
+ * of model are retained instead of being read again, if they were
+ * read from the same files with the same parameters (and without an
+ * MLLR transform); otherwise they are read as by acmod_init().  The
+ * new model has its own feature computation and scoring state, so
+ * models sharing parameters may be used on different threads.
+ *
+ * @param model a previously-initialized acoustic model, or NULL.
+ *              This pointer is not retained, but it must not be
+ *              freed concurrently.
+ * @return a newly initialized acmod_t, or NULL on failure.
+ */
+acmod_t *acmod_init_shared(cmd_ln_t *config, logmath_t *lmath, fe_t *fe,
+                           feat_t *fcb, acmod_t *model);
+
+/**
+ * Retain an acoustic model, for instance to share its parameters
+ * after the decoder that read it is freed.
+ */
+acmod_t *acmod_retain(acmod_t *acmod);
+
 /**
  * Adapt acoustic model using a linear transform.
  *
@@ -260,7 +300,7 @@ int acmod_set_mfcfh(acmod_t *acmod, FILE *logfh);
 int acmod_set_rawfh(acmod_t *acmod, FILE *logfh);
 
 /**
- * Finalize an acoustic model.
+ * Finalize an acoustic model (once the last reference is released).
  */
 void acmod_free(acmod_t *acmod);
 
@@ -309,6 +349,47 @@ int acmod_advance(acmod_t *acmod);
  */
 int acmod_set_grow(acmod_t *acmod, int grow_feat);
 
+/**
+ * Set the frame downsampling ratio of GMM computation (-ds).
+ *
+ * Semi-continuous and tied-mixture models then only evaluate all
+ * active codebooks in every ds_ratio-th frame, and only update the
+ * top-N densities of the previous frame in the others.  It can be
+ * changed between utterances, e.g. to score one search pass at a
+ * lower rate than another.
+ *
+ * @return previous ratio.
+ */
+int acmod_set_ds_ratio(acmod_t *acmod, int ds_ratio);
+
+/**
+ * Set the mode of the codebook cache, which lets a later pass over
+ * the same utterance reuse the Gaussian evaluations of an earlier
+ * one.
+ *
+ * While recording, tied-mixture models keep the top-N densities of
+ * every codebook evaluated in full, frame by frame; recording from
+ * the first frame of an utterance discards the previous recording.
+ * While replaying, they take the densities of the recorded codebooks
+ * from the cache and only evaluate the others, which gives the same
+ * scores as evaluating all of them.  The passes must process the same
+ * features, e.g. word recognition followed by forced alignment.
+ * Other models ignore the mode.
+ *
+ * @return previous mode.
+ */
+int acmod_set_cache_mode(acmod_t *acmod, int mode);
+
+/**
+ * Shrink the buffers that grow with the length of an utterance, i.e.
+ * the dynamic feature buffer and the codebook cache, back to their
+ * initial sizes if they hold more than max_frames frames.
+ *
+ * Buffers otherwise stay at the size of the longest utterance
+ * processed.  Does nothing during an utterance.
+ */
+void acmod_compact(acmod_t *acmod, int max_frames);
+
 /**
  * TODO: Set queue length for utterance processing.
  *
@@ -390,6 +471,15 @@ int acmod_read_scores(acmod_t *acmod);
  */
 mfcc_t **acmod_get_frame(acmod_t *acmod, int *inout_frame_idx);
 
+/**
+ * Get the features of a frame that has not been scored yet, if they are
+ * available, e.g. for models scoring frames in blocks.
+ *
+ * @param frame_idx Absolute index of a frame at or after the current one.
+ * @return Feature array, or NULL if the frame is not in the queue.
+ */
+mfcc_t **acmod_peek_frame(acmod_t *acmod, int frame_idx);
+
 /**
  * Score one frame of data.
  *
@@ -61,6 +61,7 @@
 /* Local headers. */
 #include "mdef.h"
 #include "bin_mdef.h"
+#include "ps_refcount.h"
 
 bin_mdef_t *
 bin_mdef_read_text(cmd_ln_t *config, const char *filename)
@@ -264,17 +265,19 @@ bin_mdef_read_text(cmd_ln_t *config, const char *filename)
 bin_mdef_t *
 bin_mdef_retain(bin_mdef_t *m)
 {
-    ++m->refcnt;
+    ps_refcount_inc(&m->refcnt);
     return m;
 }
 
 int
 bin_mdef_free(bin_mdef_t * m)
 {
+    int refcnt;
+
     if (m == NULL)
         return 0;
-    if (--m->refcnt > 0)
-        return m->refcnt;
+    if ((refcnt = ps_refcount_dec(&m->refcnt)) > 0)
+        return refcnt;
 
     switch (m->alloc_mode) {
     case BIN_MDEF_FROM_TEXT:
@@ -41,6 +41,8 @@
 /* SphinxBase headers. */
 #include <sphinxbase/pio.h>
 #include <sphinxbase/strfuncs.h>
+#include <sphinxbase/mmio.h>
+#include <sphinxbase/case.h>
 
 /* Local headers. */
 #include "dict.h"
@@ -55,6 +57,139 @@
 
 extern const char *const cmu6_lts_phone_table[];
 
+/*
+ * Compiled (binary) dictionary, which holds the words of a main
+ * dictionary in a form that can be used in place:
+ *
+ *   dict_bin_header_t header
+ *   int32 ciphone_name[n_ciphone]    Offsets of the CI phone names in string[]
+ *   dict_bin_word_t word[n_word]
+ *   int32 seed[n_bucket]             Perfect hash index (see dict_bin_wordid())
+ *   s3wid_t slot[n_slot]
+ *   s3cipid_t phone[n_phone]         All pronunciations, padded to 4 bytes
+ *   char string[n_string]            NUL-terminated phone names and words,
+ *                                    padded to 4 bytes
+ *   char tables[n_tables]            Triphone tables (see dict2pid_write_tables())
+ *
+ * Alternative pronunciations are already linked to their base words.
+ * The CI phone IDs are those of the mdef the dictionary was compiled
+ * with; they are remapped if the current mdef numbers them otherwise.
+ * The index is empty if it could not be built; the words are then
+ * entered into the hash table instead, as they are if the dictionary
+ * is used with a different -dictcase.  The triphone tables are only
+ * used if the phones are not remapped.  The file is in native byte
+ * order.
+ */
+#define DICT_BIN_MAGIC		"S3DICTBN"
+#define DICT_BIN_BYTEORDER	0x11223344
+#define DICT_BIN_VERSION	2
+
+typedef struct {
+    char magic[8];
+    int32 byteorder;
+    int32 version;
+    int32 n_ciphone;
+    int32 n_word;
+    int32 n_bucket;
+    int32 n_slot;
+    int32 n_phone;
+    int32 n_string;
+    int32 nocase;       /* Whether the index ignores case */
+    int32 n_tables;
+} dict_bin_header_t;
+
+typedef struct {
+    int32 word;         /* Offset of the word in string[] */
+    int32 ciphone;      /* Index of the pronunciation in phone[] */
+    int32 pronlen;
+    s3wid_t alt;
+    s3wid_t basewid;
+} dict_bin_word_t;
+
+#define DICT_BIN_PHONE_SIZE(n_phone) \
+    ((((n_phone) * sizeof(s3cipid_t)) + 3) & ~(size_t)3)
+#define DICT_BIN_STRING_SIZE(n_string) \
+    (((n_string) + 3) & ~(size_t)3)
+
+/* Gives up building the index if a bucket needs more seeds than this. */
+#define DICT_BIN_MAX_SEED	(1 << 16)
+
+/* FNV-1a hash of a word, ignoring case like hash_table_t if nocase. */
+static uint64
+dict_bin_hash(char const *word, int nocase)
+{
+    uint64 h = 14695981039346656037ULL;
+
+    for (; *word; ++word) {
+        h ^= (unsigned char) (nocase ? UPPER_CASE(*word) : *word);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/* Derives the k-th well-distributed value from a hash (splitmix64). */
+static uint64
+dict_bin_mix(uint64 h, uint64 k)
+{
+    h += (k + 1) * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+/* A word's bucket, and its slot for the bucket's seed: the "hash and
+ * displace" scheme of perfect hashing. */
+static int32
+dict_bin_bucket(uint64 h, int32 n_bucket)
+{
+    return (int32) (dict_bin_mix(h, 0) % (uint64) n_bucket);
+}
+
+static int32
+dict_bin_slot(uint64 h, int32 seed, int32 n_slot)
+{
+    uint64 f = dict_bin_mix(h, 1);
+    return (int32) (((f & 0xffffffffULL) + (uint64) seed * ((f >> 32) | 1))
+                    % (uint64) n_slot);
+}
+
+/* Looks up a word of the compiled dictionary with its index, returning
+ * its position in the file. */
+static s3wid_t
+dict_bin_index(dict_t * d, char const *word)
+{
+    uint64 h;
+    s3wid_t w;
+    char const *str;
+
+    if (d->bin_slot == NULL)
+        return BAD_S3WID;
+    h = dict_bin_hash(word, d->nocase);
+    w = d->bin_slot[dict_bin_slot(h, d->bin_seed[dict_bin_bucket(h, d->n_bin_bucket)],
+                                  d->n_bin_slot)];
+    if (w == BAD_S3WID)
+        return BAD_S3WID;
+    if (d->subset_word) {
+        if ((str = dict_bin_wordstr(d, w)) == NULL)
+            return BAD_S3WID;
+    }
+    else
+        str = d->word[w].word;
+    if ((d->nocase ? strcmp_nocase(str, word) : strcmp(str, word)) != 0)
+        return BAD_S3WID;
+    return w;
+}
+
+/* Looks up a word of the compiled dictionary entered when it was read. */
+static s3wid_t
+dict_bin_wordid(dict_t * d, char const *word)
+{
+    /* Words entered on demand are in the hash table */
+    if (d->subset_word)
+        return BAD_S3WID;
+    return dict_bin_index(d, word);
+}
+
 static s3cipid_t
 dict_ciphone_id(dict_t * d, const char *str)
 {
@@ -84,6 +219,10 @@ dict_add_word(dict_t * d, char const *word, s3cipid_t const * p, int32 np)
     s3wid_t newwid;
     char *wword;
 
+    /* Words of a compiled dictionary may be missing from the hash table */
+    if (dict_bin_wordid(d, word) != BAD_S3WID)
+        return BAD_S3WID;
+
     if (d->n_word >= d->max_words) {
         E_INFO("Reallocating to %d KiB for word entries\n",
                (d->max_words + S3DICT_INC_SZ) * sizeof(dictword_t) / 1024);
@@ -103,7 +242,7 @@ dict_add_word(dict_t * d, char const *word, s3cipid_t const * p, int32 np)
         int32 w;
 
         /* Truncated to a baseword string; find its ID */
-        if (hash_table_lookup_int32(d->ht, wword, &w) < 0) {
+        if ((w = dict_wordid(d, wword)) == BAD_S3WID) {
             E_ERROR("Missing base word for: %s\n", word);
             ckd_free(wword);
             ckd_free(wordp->word);
@@ -145,6 +284,133 @@ dict_add_word(dict_t * d, char const *word, s3cipid_t const * p, int32 np)
 }
 
 
+int32
+dict_remove_added_words(dict_t * d)
+{
+    int32 n_removed;
+
+    n_removed = d->n_word - d->n_init_word;
+    /* Newest first, so that alternative pronunciations are unlinked from the head of their list */
+    while (d->n_word > d->n_init_word) {
+        s3wid_t w = d->n_word - 1;
+        dictword_t *wordp = d->word + w;
+
+        if (wordp->basewid != w) {
+            s3wid_t *alt;
+            for (alt = &d->word[wordp->basewid].alt; !NOT_S3WID(*alt); alt = &d->word[*alt].alt) {
+                if (*alt == w) {
+                    *alt = wordp->alt;
+                    break;
+                }
+            }
+        }
+        hash_table_delete(d->ht, wordp->word);
+        ckd_free(wordp->word);
+        ckd_free(wordp->ciphone);
+        wordp->word = NULL;
+        wordp->ciphone = NULL;
+        --d->n_word;
+    }
+
+    return n_removed;
+}
+
+
+char const *
+dict_bin_wordstr(dict_t const * d, int32 i)
+{
+    dict_bin_word_t const *bw = (dict_bin_word_t const *) d->subset_word;
+
+    if (bw == NULL || i < 0 || i >= d->n_subset_word
+        || bw[i].word < 0 || bw[i].word >= d->n_subset_string)
+        return NULL;
+    return d->subset_string + bw[i].word;
+}
+
+
+int
+dict_has_bin_word(dict_t * d, char const *word)
+{
+    return d->subset_word != NULL && dict_bin_index(d, word) != BAD_S3WID;
+}
+
+
+/* Enters the i-th word of the compiled dictionary read with -dictsubset. */
+static s3wid_t
+dict_add_bin_entry(dict_t * d, s3wid_t i)
+{
+    dict_bin_word_t const *bw = (dict_bin_word_t const *) d->subset_word + i;
+    s3cipid_t *ciphone;
+    char const *word;
+    s3wid_t w;
+    int32 j;
+
+    if ((word = dict_bin_wordstr(d, i)) == NULL
+        || bw->pronlen <= 0 || bw->ciphone < 0
+        || bw->ciphone > d->n_subset_phone - bw->pronlen) {
+        E_ERROR("Compiled dictionary is corrupt\n");
+        return BAD_S3WID;
+    }
+    ciphone = (s3cipid_t *) ckd_malloc(bw->pronlen * sizeof(s3cipid_t));
+    for (j = 0; j < bw->pronlen; ++j) {
+        s3cipid_t p = d->subset_phone[bw->ciphone + j];
+        if (p < 0 || p >= d->n_subset_ciphone) {
+            E_ERROR("Compiled dictionary is corrupt\n");
+            ckd_free(ciphone);
+            return BAD_S3WID;
+        }
+        ciphone[j] = d->subset_ciphone_map[p];
+    }
+    w = dict_add_word(d, word, ciphone, bw->pronlen);
+    ckd_free(ciphone);
+    return w;
+}
+
+
+/* Enters the alternative pronunciations in the list starting at the
+ * i-th word of the compiled dictionary, last first, so that they end up
+ * listed in the order of the file. */
+static int
+dict_add_bin_alts(dict_t * d, s3wid_t i, int32 depth)
+{
+    dict_bin_word_t const *bw = (dict_bin_word_t const *) d->subset_word;
+
+    if (NOT_S3WID(i))
+        return 0;
+    if (i >= d->n_subset_word || depth >= d->n_subset_word) {
+        E_ERROR("Compiled dictionary is corrupt\n");
+        return -1;
+    }
+    if (dict_add_bin_alts(d, bw[i].alt, depth + 1) < 0)
+        return -1;
+    return dict_add_bin_entry(d, i) == BAD_S3WID ? -1 : 0;
+}
+
+
+s3wid_t
+dict_add_bin_word(dict_t * d, char const *word)
+{
+    dict_bin_word_t const *bw = (dict_bin_word_t const *) d->subset_word;
+    s3wid_t i, base, w;
+
+    if ((w = dict_wordid(d, word)) != BAD_S3WID)
+        return w;
+    if (bw == NULL || (i = dict_bin_index(d, word)) == BAD_S3WID)
+        return BAD_S3WID;
+
+    /* Enter the whole list of pronunciations, even for an alternative one */
+    base = bw[i].basewid;
+    if (base < 0 || base >= d->n_subset_word) {
+        E_ERROR("Compiled dictionary is corrupt\n");
+        return BAD_S3WID;
+    }
+    if (dict_add_bin_entry(d, base) == BAD_S3WID)
+        return BAD_S3WID;
+    if (dict_add_bin_alts(d, bw[base].alt, 0) < 0)
+        return BAD_S3WID;
+    return dict_wordid(d, word);
+}
+
 static int32
 dict_read(FILE * fp, dict_t * d)
 {
@@ -248,6 +514,421 @@ dict_write(dict_t *dict, char const *filename, char const *format)
 }
 
 
+/* Returns TRUE and reads the header if filename is a compiled
+ * dictionary, FALSE otherwise. */
+static int
+dict_read_bin_header(char const *filename, dict_bin_header_t * hdr)
+{
+    FILE *fp;
+    int is_bin;
+
+    if ((fp = fopen(filename, "rb")) == NULL)
+        return FALSE;
+    is_bin = fread(hdr, sizeof(*hdr), 1, fp) == 1
+        && 0 == memcmp(hdr->magic, DICT_BIN_MAGIC, sizeof(hdr->magic));
+    fclose(fp);
+    return is_bin;
+}
+
+static int32
+dict_read_bin(dict_t * d, char const *filename, int do_mmap, int subset)
+{
+    FILE *fp;
+    long size;
+    char const *data;
+    dict_bin_header_t const *hdr;
+    int32 const *ciphone_name;
+    dict_bin_word_t const *bw;
+    int32 const *seed, *slot;
+    s3cipid_t const *phone;
+    char const *string;
+    s3cipid_t *ciphone_map;
+    int32 i, j, remap, use_index;
+
+    if ((fp = fopen(filename, "rb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open dictionary file '%s' for reading", filename);
+        return -1;
+    }
+    fseek(fp, 0L, SEEK_END);
+    size = ftell(fp);
+    fseek(fp, 0L, SEEK_SET);
+    if (do_mmap) {
+        if ((d->filemap = mmio_file_read(filename)) == NULL) {
+            E_WARN("Failed to mmap dictionary '%s', reading it instead\n", filename);
+            do_mmap = FALSE;
+        }
+    }
+    if (do_mmap)
+        data = mmio_file_ptr(d->filemap);
+    else {
+        d->filedata = ckd_malloc(size > 0 ? size : 1);
+        if (size < 0 || fread(d->filedata, 1, size, fp) != (size_t)size) {
+            E_ERROR("Failed to read dictionary '%s'\n", filename);
+            fclose(fp);
+            return -1;
+        }
+        data = d->filedata;
+    }
+    fclose(fp);
+
+    /* Check that the sections fill the file exactly. */
+    hdr = (dict_bin_header_t const *) data;
+    if ((size_t)size < sizeof(*hdr)
+        || memcmp(hdr->magic, DICT_BIN_MAGIC, sizeof(hdr->magic)) != 0
+        || hdr->byteorder != DICT_BIN_BYTEORDER) {
+        E_ERROR("'%s' is not a compiled dictionary in this machine's byte order\n",
+                filename);
+        return -1;
+    }
+    if (hdr->version != DICT_BIN_VERSION) {
+        E_ERROR("Compiled dictionary '%s' has version %d, expected %d; recompile it\n",
+                filename, hdr->version, DICT_BIN_VERSION);
+        return -1;
+    }
+    if (hdr->n_ciphone < 0 || hdr->n_word < 0
+        || hdr->n_bucket < 0 || hdr->n_slot < 0
+        || (hdr->n_bucket == 0) != (hdr->n_slot == 0)
+        || hdr->n_phone < 0 || hdr->n_string < 0 || hdr->n_tables < 0
+        || (size_t)size != sizeof(*hdr)
+           + (size_t)hdr->n_ciphone * sizeof(int32)
+           + (size_t)hdr->n_word * sizeof(dict_bin_word_t)
+           + (size_t)hdr->n_bucket * sizeof(int32)
+           + (size_t)hdr->n_slot * sizeof(int32)
+           + DICT_BIN_PHONE_SIZE((size_t)hdr->n_phone)
+           + DICT_BIN_STRING_SIZE((size_t)hdr->n_string)
+           + (size_t)hdr->n_tables) {
+        E_ERROR("Compiled dictionary '%s' is corrupt\n", filename);
+        return -1;
+    }
+    /* The word IDs in the file are final, so it must come first. */
+    if (d->n_word != 0 || (!subset && hdr->n_word > d->max_words)) {
+        E_ERROR("Dictionary '%s' has more words than allocated\n", filename);
+        return -1;
+    }
+    ciphone_name = (int32 const *) (hdr + 1);
+    bw = (dict_bin_word_t const *) (ciphone_name + hdr->n_ciphone);
+    seed = (int32 const *) (bw + hdr->n_word);
+    slot = seed + hdr->n_bucket;
+    phone = (s3cipid_t const *) (slot + hdr->n_slot);
+    string = (char const *) phone + DICT_BIN_PHONE_SIZE((size_t)hdr->n_phone);
+    if (hdr->n_string == 0 || string[hdr->n_string - 1] != '\0') {
+        E_ERROR("Dictionary '%s' is corrupt\n", filename);
+        return -1;
+    }
+    for (i = 0; i < hdr->n_slot; ++i) {
+        if (slot[i] < BAD_S3WID || slot[i] >= hdr->n_word) {
+            E_ERROR("Dictionary '%s' is corrupt\n", filename);
+            return -1;
+        }
+    }
+
+    /* The index only works for the case sensitivity it was built with.
+     * Otherwise, or without one, enter the words into the hash table. */
+    use_index = hdr->n_slot > 0 && hdr->nocase == d->nocase;
+    if (subset && !use_index) {
+        E_ERROR("Dictionary '%s' has no index for its case sensitivity to look words up with\n",
+                filename);
+        return -1;
+    }
+    if (use_index) {
+        d->bin_seed = seed;
+        d->bin_slot = slot;
+        d->n_bin_bucket = hdr->n_bucket;
+        d->n_bin_slot = hdr->n_slot;
+        /* The hash table only needs room for fillers and added words. */
+        hash_table_free(d->ht);
+        d->ht = hash_table_new(S3DICT_INC_SZ, d->nocase);
+    }
+
+    /* Map the CI phone IDs of the file to those of the model. */
+    remap = FALSE;
+    ciphone_map = (s3cipid_t *) ckd_calloc(hdr->n_ciphone + 1, sizeof(*ciphone_map));
+    for (i = 0; i < hdr->n_ciphone; ++i) {
+        if (ciphone_name[i] < 0 || ciphone_name[i] >= hdr->n_string) {
+            E_ERROR("Dictionary '%s' is corrupt\n", filename);
+            ckd_free(ciphone_map);
+            return -1;
+        }
+        ciphone_map[i] = d->mdef ? dict_ciphone_id(d, string + ciphone_name[i]) : i;
+        if (NOT_S3CIPID(ciphone_map[i])) {
+            E_ERROR("Phone '%s' of compiled dictionary '%s' is missing in the acoustic model\n",
+                    string + ciphone_name[i], filename);
+            ckd_free(ciphone_map);
+            return -1;
+        }
+        if (ciphone_map[i] != i)
+            remap = TRUE;
+    }
+    if (remap)
+        E_INFO("Remapping the CI phones of compiled dictionary '%s'\n", filename);
+
+    if (hdr->n_tables > 0 && !remap) {
+        d->bin_tables = string + DICT_BIN_STRING_SIZE((size_t)hdr->n_string);
+        d->n_bin_tables = hdr->n_tables;
+    }
+    if (subset) {
+        /* The words are checked as they are entered */
+        d->subset_word = bw;
+        d->n_subset_word = hdr->n_word;
+        d->subset_phone = phone;
+        d->n_subset_phone = hdr->n_phone;
+        d->subset_string = string;
+        d->n_subset_string = hdr->n_string;
+        d->n_subset_ciphone = hdr->n_ciphone;
+        d->subset_ciphone_map = ciphone_map;
+        E_INFO("Dictionary size %d, entering its words on demand\n", hdr->n_word);
+        return 0;
+    }
+
+    d->n_bin_word = hdr->n_word;
+    d->bin_ciphone = !remap;
+    for (i = 0; i < hdr->n_word; ++i) {
+        dictword_t *wordp = d->word + d->n_word;
+
+        if (bw[i].word < 0 || bw[i].word >= hdr->n_string
+            || bw[i].pronlen <= 0 || bw[i].ciphone < 0
+            || bw[i].ciphone > hdr->n_phone - bw[i].pronlen
+            || bw[i].basewid < 0 || bw[i].basewid >= hdr->n_word
+            || bw[i].alt < BAD_S3WID || bw[i].alt >= hdr->n_word) {
+            E_ERROR("Dictionary '%s' is corrupt\n", filename);
+            break;
+        }
+        for (j = 0; j < bw[i].pronlen; ++j) {
+            if (phone[bw[i].ciphone + j] < 0
+                || phone[bw[i].ciphone + j] >= hdr->n_ciphone)
+                break;
+        }
+        if (j < bw[i].pronlen) {
+            E_ERROR("Dictionary '%s' is corrupt\n", filename);
+            break;
+        }
+
+        /* The strings are used in place, also as hash table keys. */
+        wordp->word = (char *) string + bw[i].word;
+        if (remap) {
+            wordp->ciphone = (s3cipid_t *) ckd_malloc(bw[i].pronlen * sizeof(s3cipid_t));
+            for (j = 0; j < bw[i].pronlen; ++j)
+                wordp->ciphone[j] = ciphone_map[phone[bw[i].ciphone + j]];
+        }
+        else
+            wordp->ciphone = (s3cipid_t *) phone + bw[i].ciphone;
+        wordp->pronlen = bw[i].pronlen;
+        wordp->alt = bw[i].alt;
+        wordp->basewid = bw[i].basewid;
+        ++d->n_word;
+
+        if (!use_index
+            && hash_table_enter_int32(d->ht, wordp->word, i) != i) {
+            E_ERROR("Duplicate word '%s' in dictionary '%s'\n", wordp->word, filename);
+            break;
+        }
+    }
+    ckd_free(ciphone_map);
+    if (i < hdr->n_word)
+        return -1;
+
+    E_INFO("Dictionary size %d, used in place%s\n", dict_size(d),
+           use_index ? " with its index" : "");
+    return 0;
+}
+
+int
+dict_bin_compatible(char const *filename)
+{
+    dict_bin_header_t hdr;
+
+    return dict_read_bin_header(filename, &hdr)
+        && hdr.byteorder == DICT_BIN_BYTEORDER
+        && hdr.version == DICT_BIN_VERSION;
+}
+
+/* Builds the perfect hash index of the first n_word words: every word
+ * is hashed into a bucket, and each bucket gets the first seed that
+ * moves all of its words into free slots.  Buckets are placed largest
+ * first, while there are still many free slots.  Returns FALSE if a
+ * bucket finds no seed, which is very unlikely. */
+static int
+dict_bin_build_index(dict_t * d, int32 n_word, int32 n_bucket,
+                     int32 n_slot, int32 * seed, int32 * slot)
+{
+    uint64 *hash;
+    int32 *bucket_of, *order, *count, *start, *member, *pending;
+    int32 i, j, b, n, s;
+    int ok = TRUE;
+
+    hash = (uint64 *) ckd_calloc(n_word, sizeof(*hash));
+    bucket_of = (int32 *) ckd_calloc(n_word, sizeof(*bucket_of));
+    member = (int32 *) ckd_calloc(n_word, sizeof(*member));
+    count = (int32 *) ckd_calloc(n_bucket, sizeof(*count));
+    start = (int32 *) ckd_calloc(n_bucket + 1, sizeof(*start));
+    order = (int32 *) ckd_calloc(n_bucket, sizeof(*order));
+    pending = (int32 *) ckd_calloc(n_word, sizeof(*pending));
+
+    for (i = 0; i < n_word; ++i) {
+        hash[i] = dict_bin_hash(d->word[i].word, d->nocase);
+        bucket_of[i] = dict_bin_bucket(hash[i], n_bucket);
+        ++count[bucket_of[i]];
+    }
+    /* Group the words by bucket (counting sort). */
+    for (b = 0; b < n_bucket; ++b)
+        start[b + 1] = start[b] + count[b];
+    for (i = 0; i < n_word; ++i)
+        member[start[bucket_of[i]]++] = i;
+    for (b = 0; b < n_bucket; ++b)
+        start[b] -= count[b];
+    /* Order the buckets by descending size, again by counting. */
+    for (n = b = 0; b < n_bucket; ++b)
+        if (count[b] > n)
+            n = count[b];
+    for (i = 0; n >= 0; --n)
+        for (b = 0; b < n_bucket; ++b)
+            if (count[b] == n)
+                order[i++] = b;
+
+    for (i = 0; i < n_slot; ++i)
+        slot[i] = BAD_S3WID;
+    for (i = 0; ok && i < n_bucket; ++i) {
+        b = order[i];
+        seed[b] = 0;
+        if (count[b] == 0)
+            continue;
+        for (s = 0; s < DICT_BIN_MAX_SEED; ++s) {
+            /* Try the seed, undoing it if any words collide. */
+            for (j = 0; j < count[b]; ++j) {
+                int32 w = member[start[b] + j];
+                pending[j] = dict_bin_slot(hash[w], s, n_slot);
+                if (slot[pending[j]] != BAD_S3WID)
+                    break;
+                slot[pending[j]] = w;
+            }
+            if (j == count[b])
+                break;
+            while (j-- > 0)
+                slot[pending[j]] = BAD_S3WID;
+        }
+        if (s == DICT_BIN_MAX_SEED)
+            ok = FALSE;
+        seed[b] = s;
+    }
+
+    ckd_free(hash);
+    ckd_free(bucket_of);
+    ckd_free(member);
+    ckd_free(count);
+    ckd_free(start);
+    ckd_free(order);
+    ckd_free(pending);
+    return ok;
+}
+
+/* Skips alternative pronunciations with IDs of n or above. */
+static s3wid_t
+dict_bin_alt(dict_t * d, s3wid_t w, int32 n)
+{
+    while (w != BAD_S3WID && w >= n)
+        w = d->word[w].alt;
+    return w;
+}
+
+int
+dict_write_bin(dict_t * d, void const *tables, size_t n_tables,
+               char const *filename)
+{
+    FILE *fh;
+    dict_bin_header_t hdr;
+    dict_bin_word_t bw;
+    int32 i, n_word, offset;
+    int32 *seed, *slot;
+    int32 pad = 0;	/* Zero bytes for padding the sections */
+    int ok;
+
+    if (d->mdef == NULL) {
+        E_ERROR("A compiled dictionary needs an mdef\n");
+        return -1;
+    }
+
+    /* Only the words of the main dictionary, preceding the fillers */
+    n_word = d->filler_start;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, DICT_BIN_MAGIC, sizeof(hdr.magic));
+    hdr.byteorder = DICT_BIN_BYTEORDER;
+    hdr.version = DICT_BIN_VERSION;
+    hdr.n_ciphone = bin_mdef_n_ciphone(d->mdef);
+    hdr.n_word = n_word;
+    hdr.nocase = d->nocase;
+    hdr.n_tables = tables ? n_tables : 0;
+
+    /* About four words per bucket and a load factor of 0.8 */
+    hdr.n_bucket = n_word / 4 + 1;
+    hdr.n_slot = n_word + n_word / 4 + 1;
+    seed = (int32 *) ckd_calloc(hdr.n_bucket, sizeof(*seed));
+    slot = (int32 *) ckd_calloc(hdr.n_slot, sizeof(*slot));
+    if (!dict_bin_build_index(d, n_word, hdr.n_bucket, hdr.n_slot, seed, slot)) {
+        E_WARN("Failed to build the index of compiled dictionary '%s'\n", filename);
+        hdr.n_bucket = hdr.n_slot = 0;
+    }
+
+    if ((fh = fopen(filename, "wb")) == NULL) {
+        E_ERROR_SYSTEM("Failed to open '%s'", filename);
+        ckd_free(seed);
+        ckd_free(slot);
+        return -1;
+    }
+    for (i = 0; i < hdr.n_ciphone; ++i)
+        hdr.n_string += strlen(bin_mdef_ciphone_str(d->mdef, i)) + 1;
+    for (i = 0; i < n_word; ++i) {
+        hdr.n_phone += d->word[i].pronlen;
+        hdr.n_string += strlen(d->word[i].word) + 1;
+    }
+    ok = fwrite(&hdr, sizeof(hdr), 1, fh) == 1;
+
+    /* Phone names come first in the string table, then the words. */
+    for (offset = i = 0; ok && i < hdr.n_ciphone; ++i) {
+        ok = fwrite(&offset, sizeof(offset), 1, fh) == 1;
+        offset += strlen(bin_mdef_ciphone_str(d->mdef, i)) + 1;
+    }
+    for (bw.ciphone = i = 0; ok && i < n_word; ++i) {
+        bw.word = offset;
+        bw.pronlen = d->word[i].pronlen;
+        bw.alt = dict_bin_alt(d, d->word[i].alt, n_word);
+        bw.basewid = d->word[i].basewid;
+        ok = fwrite(&bw, sizeof(bw), 1, fh) == 1;
+        offset += strlen(d->word[i].word) + 1;
+        bw.ciphone += d->word[i].pronlen;
+    }
+    if (ok && hdr.n_slot > 0)
+        ok = fwrite(seed, sizeof(*seed), hdr.n_bucket, fh) == (size_t)hdr.n_bucket
+            && fwrite(slot, sizeof(*slot), hdr.n_slot, fh) == (size_t)hdr.n_slot;
+    ckd_free(seed);
+    ckd_free(slot);
+    for (i = 0; ok && i < n_word; ++i)
+        ok = fwrite(d->word[i].ciphone, sizeof(s3cipid_t), d->word[i].pronlen, fh)
+            == (size_t)d->word[i].pronlen;
+    if (ok && DICT_BIN_PHONE_SIZE((size_t)hdr.n_phone) > hdr.n_phone * sizeof(s3cipid_t))
+        ok = fwrite(&pad, sizeof(s3cipid_t), 1, fh) == 1;
+    for (i = 0; ok && i < hdr.n_ciphone; ++i) {
+        const char *name = bin_mdef_ciphone_str(d->mdef, i);
+        ok = fwrite(name, 1, strlen(name) + 1, fh) == strlen(name) + 1;
+    }
+    for (i = 0; ok && i < n_word; ++i)
+        ok = fwrite(d->word[i].word, 1, strlen(d->word[i].word) + 1, fh)
+            == strlen(d->word[i].word) + 1;
+    if (ok && DICT_BIN_STRING_SIZE((size_t)hdr.n_string) > (size_t)hdr.n_string)
+        ok = fwrite(&pad, 1, DICT_BIN_STRING_SIZE((size_t)hdr.n_string) - hdr.n_string, fh)
+            == DICT_BIN_STRING_SIZE((size_t)hdr.n_string) - hdr.n_string;
+    if (ok && hdr.n_tables > 0)
+        ok = fwrite(tables, 1, hdr.n_tables, fh) == (size_t)hdr.n_tables;
+
+    if (fclose(fh) != 0)
+        ok = FALSE;
+    if (!ok) {
+        E_ERROR_SYSTEM("Failed to write compiled dictionary '%s'", filename);
+        return -1;
+    }
+    return 0;
+}
+
+
 dict_t *
 dict_init(cmd_ln_t *config, bin_mdef_t * mdef)
 {
@@ -257,10 +938,16 @@ dict_init(cmd_ln_t *config, bin_mdef_t * mdef)
     dict_t *d;
     s3cipid_t sil;
     char const *dictfile = NULL, *fillerfile = NULL;
+    dict_bin_header_t bin_hdr;
+    int is_bin = FALSE, do_mmap = FALSE, subset = FALSE;
 
     if (config) {
         dictfile = cmd_ln_str_r(config, "-dict");
         fillerfile = cmd_ln_str_r(config, "_fdict");
+        if (cmd_ln_exists_r(config, "-mmap"))
+            do_mmap = cmd_ln_boolean_r(config, "-mmap");
+        if (cmd_ln_exists_r(config, "-dictsubset"))
+            subset = cmd_ln_boolean_r(config, "-dictsubset");
     }
 
     /*
@@ -275,12 +962,19 @@ dict_init(cmd_ln_t *config, bin_mdef_t * mdef)
             E_ERROR_SYSTEM("Failed to open dictionary file '%s' for reading", dictfile);
             return NULL;
         }
-        for (li = lineiter_start(fp); li; li = lineiter_next(li)) {
-            if (0 != strncmp(li->buf, "##", 2)
-                && 0 != strncmp(li->buf, ";;", 2))
-                n++;
+        if ((is_bin = dict_read_bin_header(dictfile, &bin_hdr))) {
+            /* Words entered on demand take the entries for added words */
+            if (!subset)
+                n = bin_hdr.n_word;
+        }
+        else {
+            for (li = lineiter_start(fp); li; li = lineiter_next(li)) {
+                if (0 != strncmp(li->buf, "##", 2)
+                    && 0 != strncmp(li->buf, ";;", 2))
+                    n++;
+            }
+            fseek(fp, 0L, SEEK_SET);
         }
-	fseek(fp, 0L, SEEK_SET);
     }
 
     fp2 = NULL;
@@ -329,7 +1023,18 @@ dict_init(cmd_ln_t *config, bin_mdef_t * mdef)
     d->ht = hash_table_new(d->max_words, d->nocase);
 
     /* Digest main dictionary file */
-    if (fp) {
+    if (fp && is_bin) {
+        E_INFO("Reading compiled main dictionary: %s\n", dictfile);
+        fclose(fp);
+        if (dict_read_bin(d, dictfile, do_mmap, subset) < 0) {
+            if (fp2)
+                fclose(fp2);
+            dict_free(d);
+            return NULL;
+        }
+        E_INFO("%d words read\n", d->n_word);
+    }
+    else if (fp) {
         E_INFO("Reading main dictionary: %s\n", dictfile);
         dict_read(fp, d);
         fclose(fp);
@@ -391,6 +1096,7 @@ dict_init(cmd_ln_t *config, bin_mdef_t * mdef)
 
     /* No check that alternative pronunciations for filler words are in filler range!! */
 
+    d->n_init_word = d->n_word;
     return d;
 }
 
@@ -403,6 +1109,8 @@ dict_wordid(dict_t *d, const char *word)
     assert(d);
     assert(word);
 
+    if ((w = dict_bin_wordid(d, word)) != BAD_S3WID)
+        return w;
     if (hash_table_lookup_int32(d->ht, word, &w) < 0)
         return (BAD_S3WID);
     return w;
@@ -475,14 +1183,19 @@ dict_free(dict_t * d)
     if (--d->refcnt > 0)
         return d->refcnt;
 
-    /* First Step, free all memory allocated for each word */
+    /* First Step, free all memory allocated for each word (but not
+     * what points into a compiled dictionary) */
     for (i = 0; i < d->n_word; i++) {
         word = (dictword_t *) & (d->word[i]);
-        if (word->word)
+        if (word->word && i >= d->n_bin_word)
             ckd_free((void *) word->word);
-        if (word->ciphone)
+        if (word->ciphone && (i >= d->n_bin_word || !d->bin_ciphone))
             ckd_free((void *) word->ciphone);
     }
+    if (d->filemap)
+        mmio_file_unmap(d->filemap);
+    ckd_free(d->filedata);
+    ckd_free(d->subset_ciphone_map);
 
     if (d->word)
         ckd_free((void *) d->word);
@@ -44,6 +44,7 @@
 
 /* SphinxBase headers. */
 #include <sphinxbase/hash_table.h>
+#include <sphinxbase/mmio.h>
 
 /* Local headers. */
 #include "s3types.h"
@@ -80,12 +81,33 @@ typedef struct {
     hash_table_t *ht;	/**< Hash table for mapping word strings to word ids */
     int32 max_words;	/**< #Entries allocated in dict, including empty slots */
     int32 n_word;	/**< #Occupied entries in dict; ie, excluding empty slots */
+    int32 n_init_word;	/**< #Entries after initialization; later ones were added by dict_add_word() */
     int32 filler_start;	/**< First filler word id (read from filler dict) */
     int32 filler_end;	/**< Last filler word id (read from filler dict) */
     s3wid_t startwid;	/**< FOR INTERNAL-USE ONLY */
     s3wid_t finishwid;	/**< FOR INTERNAL-USE ONLY */
     s3wid_t silwid;	/**< FOR INTERNAL-USE ONLY */
     int nocase;
+    int32 n_bin_word;	/**< #Leading words whose strings point into the compiled dictionary */
+    int bin_ciphone;	/**< Whether their pronunciations point into it as well */
+    mmio_file_t *filemap;	/**< Memory-mapped compiled dictionary, or NULL */
+    void *filedata;	/**< Compiled dictionary read into memory, if not mapped */
+    int32 const *bin_seed;	/**< Perfect hash index of the compiled dictionary, or NULL */
+    int32 const *bin_slot;
+    int32 n_bin_bucket;
+    int32 n_bin_slot;
+    void const *bin_tables;	/**< Triphone tables of the compiled dictionary (see dict2pid_write_tables()), or NULL */
+    int32 n_bin_tables;
+    /* Compiled dictionary read with -dictsubset, whose words are only
+     * entered on demand (see dict_add_bin_word()) */
+    void const *subset_word;	/**< Its words, or NULL if all are entered */
+    int32 n_subset_word;
+    s3cipid_t const *subset_phone;
+    int32 n_subset_phone;
+    char const *subset_string;
+    int32 n_subset_string;
+    int32 n_subset_ciphone;
+    s3cipid_t *subset_ciphone_map;	/**< CI phone IDs of the model by those of the file */
 } dict_t;
 
 
@@ -109,6 +131,31 @@ dict_t *dict_init(cmd_ln_t *config, /**< Configuration (-dict, -fdict, -dictcase
  */
 int dict_write(dict_t *dict, char const *filename, char const *format);
 
+/**
+ * Write the words of the main dictionary to a compiled (binary)
+ * dictionary file.  dict_init() accepts such a file for -dict, and
+ * uses it in place instead of parsing it, memory-mapping it if -mmap
+ * is set.  The file contains a perfect hash index of the words, so
+ * that they need not be entered into a hash table when it is read,
+ * and optionally the triphone tables of the dictionary, which
+ * dict2pid_build() then copies.  The dictionary must have been
+ * created with an mdef.
+ *
+ * Return 0 if successful, <0 otherwise.
+ */
+POCKETSPHINX_EXPORT
+int dict_write_bin(dict_t *dict,
+                   void const *tables, /**< From dict2pid_write_tables(), or NULL */
+                   size_t n_tables,
+                   char const *filename);
+
+/**
+ * Return TRUE if filename is a compiled dictionary that dict_init()
+ * can read: one of this version, in this machine's byte order.
+ */
+POCKETSPHINX_EXPORT
+int dict_bin_compatible(char const *filename);
+
 /** Return word id for given word string if present.  Otherwise return BAD_S3WID */
 POCKETSPHINX_EXPORT
 s3wid_t dict_wordid(dict_t *d, const char *word);
@@ -139,6 +186,50 @@ s3wid_t dict_add_word(dict_t *d,          /**< The dictionary structure. */
                       int32 np            /**< Number of phones. */
     );
 
+/**
+ * Enter a word of a compiled dictionary read with -dictsubset, and its
+ * alternative pronunciations, looking them up with its index.  Such a
+ * dictionary starts out with the filler words only, so that only the
+ * words a search needs take memory.  The words count as added, see
+ * dict_remove_added_words().
+ * Return value: Word id of the word, which may have been entered
+ * before, or BAD_S3WID if the compiled dictionary lacks it
+ */
+POCKETSPHINX_EXPORT
+s3wid_t dict_add_bin_word(dict_t *d,       /**< The dictionary structure. */
+                          char const *word /**< The word. */
+    );
+
+/**
+ * Return 1 if the compiled dictionary read with -dictsubset has the
+ * word, whether or not it has been entered, 0 if not or if the
+ * dictionary was read without -dictsubset.
+ */
+POCKETSPHINX_EXPORT
+int dict_has_bin_word(dict_t *d,       /**< The dictionary structure. */
+                      char const *word /**< The word. */
+    );
+
+/**
+ * Return the string of the i-th word of the compiled dictionary read
+ * with -dictsubset, for i below n_subset_word, or NULL if there is
+ * none.
+ */
+POCKETSPHINX_EXPORT
+char const *dict_bin_wordstr(dict_t const *d, /**< The dictionary structure. */
+                             int32 i          /**< Index in the compiled dictionary. */
+    );
+
+/**
+ * Remove the words added with dict_add_word() since the dictionary was
+ * initialized, so that their IDs are reused by the next words added.
+ * Searches built with any of these words must be freed beforehand.
+ * Return value: Number of words removed
+ */
+POCKETSPHINX_EXPORT
+int32 dict_remove_added_words(dict_t *d /**< The dictionary structure. */
+    );
+
 /**
  * Return value: CI phone string for the given word, phone position.
  */
@@ -384,6 +384,263 @@ dict2pid_internal(dict2pid_t *d2p,
     return bin_mdef_pid2ssid(mdef, p);
 }
 
+/*
+ * Saved tables, which dict_write_bin() stores in a compiled dictionary
+ * so that decoders copy them instead of building them:
+ *
+ *   int32 n_ciphone, n_phone, n_sseq
+ *   uint32 hash                      Of the mdef's phones and CD tree
+ *   bitvec_t ldiph[bitvec_size(n_ciphone^2)]
+ *   bitvec_t rdiph[bitvec_size(n_ciphone^2)]
+ *   bitvec_t single[bitvec_size(n_ciphone)]
+ *   int32 n_rssid[n_ciphone^2], n_lrssid[n_ciphone^2]
+ *   s3ssid_t ldiph_lc[n_ciphone^3], lrdiph_rc[n_ciphone^3]
+ *   for rssid, then lrssid, each [b][l] with n_ssid > 0:
+ *     s3ssid_t ssid[n_ssid]
+ *     s3cipid_t cimap[n_ciphone]
+ *
+ * The tables only depend on the mdef and on which word-initial and
+ * word-final diphones and single phones the dictionary has (its key,
+ * the three bit vectors), so they are used if both match and built
+ * otherwise.
+ */
+#define DICT2PID_TABLES_HEADER	4
+
+/* FNV-1a hash of a table, taken a 32-bit word at a time. */
+static uint32
+dict2pid_hash(uint32 h, void const *data, size_t size)
+{
+    uint32 const *p = (uint32 const *) data;
+    size_t i;
+
+    for (i = 0; i < size / sizeof(uint32); ++i)
+        h = (h ^ p[i]) * 16777619U;
+    return h;
+}
+
+static uint32
+dict2pid_mdef_hash(bin_mdef_t * mdef)
+{
+    uint32 h = 2166136261U;
+
+    h = dict2pid_hash(h, mdef->phone, mdef->n_phone * sizeof(*mdef->phone));
+    return dict2pid_hash(h, mdef->cd_tree, mdef->n_cd_tree * sizeof(*mdef->cd_tree));
+}
+
+/* Marks the diphones and single phones that dict2pid_build() fills in. */
+static void
+dict2pid_key(bin_mdef_t * mdef, dict_t * dict,
+             bitvec_t * ldiph, bitvec_t * rdiph, bitvec_t * single)
+{
+    int32 n_ci = bin_mdef_n_ciphone(mdef);
+    int32 w, pronlen;
+
+    for (w = 0; w < dict_size(dict); w++) {
+        pronlen = dict_pronlen(dict, w);
+        if (pronlen >= 2) {
+            bitvec_set(ldiph, dict_first_phone(dict, w) * n_ci
+                       + dict_second_phone(dict, w));
+            bitvec_set(rdiph, dict_last_phone(dict, w) * n_ci
+                       + dict_second_last_phone(dict, w));
+        }
+        else if (pronlen == 1)
+            bitvec_set(single, dict_pron(dict, w, 0));
+    }
+}
+
+static size_t
+dict2pid_key_size(int32 n_ci)
+{
+    return (2 * bitvec_size(n_ci * n_ci) + bitvec_size(n_ci)) * sizeof(bitvec_t);
+}
+
+static size_t
+dict2pid_count_ssid(xwdssid_t ** tree, int32 n_ci, int32 * n_entry)
+{
+    int32 b, l;
+    size_t n = 0;
+
+    *n_entry = 0;
+    for (b = 0; b < n_ci; b++) {
+        for (l = 0; l < n_ci; l++) {
+            if (tree[b][l].n_ssid > 0) {
+                n += tree[b][l].n_ssid;
+                ++*n_entry;
+            }
+        }
+    }
+    return n;
+}
+
+static char *
+dict2pid_save_tree(xwdssid_t ** tree, int32 n_ci, int32 * n_ssid, char *p)
+{
+    int32 b, l;
+
+    for (b = 0; b < n_ci; b++) {
+        for (l = 0; l < n_ci; l++) {
+            n_ssid[b * n_ci + l] = tree[b][l].n_ssid;
+            if (tree[b][l].n_ssid > 0) {
+                memcpy(p, tree[b][l].ssid, tree[b][l].n_ssid * sizeof(s3ssid_t));
+                p += tree[b][l].n_ssid * sizeof(s3ssid_t);
+                memcpy(p, tree[b][l].cimap, n_ci * sizeof(s3cipid_t));
+                p += n_ci * sizeof(s3cipid_t);
+            }
+        }
+    }
+    return p;
+}
+
+void *
+dict2pid_write_tables(dict2pid_t * d2p, size_t * out_size)
+{
+    bin_mdef_t *mdef = d2p->mdef;
+    int32 n_ci = bin_mdef_n_ciphone(mdef);
+    int32 n_rentry, n_lrentry;
+    size_t n_rssid, n_lrssid, size;
+    int32 *header;
+    bitvec_t *ldiph, *rdiph, *single;
+    int32 *n_ssid;
+    char *tables, *p;
+
+    n_rssid = dict2pid_count_ssid(d2p->rssid, n_ci, &n_rentry);
+    n_lrssid = dict2pid_count_ssid(d2p->lrssid, n_ci, &n_lrentry);
+    size = DICT2PID_TABLES_HEADER * sizeof(int32) + dict2pid_key_size(n_ci)
+        + 2 * n_ci * n_ci * sizeof(int32)
+        + 2 * (size_t)n_ci * n_ci * n_ci * sizeof(s3ssid_t)
+        + (n_rssid + n_lrssid) * sizeof(s3ssid_t)
+        + (size_t)(n_rentry + n_lrentry) * n_ci * sizeof(s3cipid_t);
+    tables = (char *) ckd_calloc(size, 1);
+
+    header = (int32 *) tables;
+    header[0] = n_ci;
+    header[1] = bin_mdef_n_phone(mdef);
+    header[2] = bin_mdef_n_sseq(mdef);
+    header[3] = (int32) dict2pid_mdef_hash(mdef);
+    ldiph = (bitvec_t *) (header + DICT2PID_TABLES_HEADER);
+    rdiph = ldiph + bitvec_size(n_ci * n_ci);
+    single = rdiph + bitvec_size(n_ci * n_ci);
+    dict2pid_key(mdef, d2p->dict, ldiph, rdiph, single);
+
+    n_ssid = (int32 *) (single + bitvec_size(n_ci));
+    p = (char *) (n_ssid + 2 * n_ci * n_ci);
+    memcpy(p, d2p->ldiph_lc[0][0], (size_t)n_ci * n_ci * n_ci * sizeof(s3ssid_t));
+    p += (size_t)n_ci * n_ci * n_ci * sizeof(s3ssid_t);
+    memcpy(p, d2p->lrdiph_rc[0][0], (size_t)n_ci * n_ci * n_ci * sizeof(s3ssid_t));
+    p += (size_t)n_ci * n_ci * n_ci * sizeof(s3ssid_t);
+    p = dict2pid_save_tree(d2p->rssid, n_ci, n_ssid, p);
+    p = dict2pid_save_tree(d2p->lrssid, n_ci, n_ssid + n_ci * n_ci, p);
+    assert(p == tables + size);
+
+    *out_size = size;
+    return tables;
+}
+
+static xwdssid_t **
+dict2pid_restore_tree(int32 n_ci, int32 const *n_ssid, char const **pp, char const *end)
+{
+    xwdssid_t **tree;
+    char const *p = *pp;
+    int32 b, l;
+
+    tree = (xwdssid_t **) ckd_calloc(n_ci, sizeof(xwdssid_t *));
+    for (b = 0; b < n_ci; b++) {
+        tree[b] = (xwdssid_t *) ckd_calloc(n_ci, sizeof(xwdssid_t));
+        for (l = 0; l < n_ci; l++) {
+            xwdssid_t *x = &tree[b][l];
+            int32 n = n_ssid[b * n_ci + l];
+
+            if (n == 0)
+                continue;
+            if (n < 0 || n > n_ci
+                || (size_t)(end - p) < n * sizeof(s3ssid_t) + n_ci * sizeof(s3cipid_t)) {
+                free_compress_map(tree, b + 1);
+                return NULL;
+            }
+            x->ssid = ckd_malloc(n * sizeof(s3ssid_t));
+            memcpy(x->ssid, p, n * sizeof(s3ssid_t));
+            p += n * sizeof(s3ssid_t);
+            x->cimap = ckd_malloc(n_ci * sizeof(s3cipid_t));
+            memcpy(x->cimap, p, n_ci * sizeof(s3cipid_t));
+            p += n_ci * sizeof(s3cipid_t);
+            x->n_ssid = n;
+        }
+    }
+    *pp = p;
+    return tree;
+}
+
+/* Copies the saved tables into d2p if they were built for its mdef
+ * and for all diphones and single phones of its dictionary; returns
+ * FALSE otherwise.  Tables of a dictionary with more words, e.g. the
+ * compiled one of a dictionary read with -dictsubset, serve as well:
+ * the entries of each diphone don't depend on the others. */
+static int
+dict2pid_restore(dict2pid_t * d2p, void const *tables, size_t size)
+{
+    bin_mdef_t *mdef = d2p->mdef;
+    int32 n_ci = bin_mdef_n_ciphone(mdef);
+    size_t n_key = dict2pid_key_size(n_ci);
+    size_t n_table = (size_t)n_ci * n_ci * n_ci * sizeof(s3ssid_t);
+    int32 const *header = (int32 const *) tables;
+    int32 const *n_ssid;
+    char const *p, *end = (char const *) tables + size;
+    bitvec_t *key;
+    bitvec_t const *saved_key;
+    size_t i;
+    int match;
+
+    if (size < DICT2PID_TABLES_HEADER * sizeof(int32) + n_key
+        + 2 * n_ci * n_ci * sizeof(int32) + 2 * n_table
+        || header[0] != n_ci
+        || header[1] != bin_mdef_n_phone(mdef)
+        || header[2] != bin_mdef_n_sseq(mdef)
+        || header[3] != (int32) dict2pid_mdef_hash(mdef))
+        return FALSE;
+
+    key = (bitvec_t *) ckd_calloc(n_key, 1);
+    dict2pid_key(mdef, d2p->dict, key, key + bitvec_size(n_ci * n_ci),
+                 key + 2 * bitvec_size(n_ci * n_ci));
+    saved_key = (bitvec_t const *) (header + DICT2PID_TABLES_HEADER);
+    match = TRUE;
+    for (i = 0; i < n_key / sizeof(bitvec_t); ++i) {
+        if ((key[i] & ~saved_key[i]) != 0) {
+            match = FALSE;
+            break;
+        }
+    }
+    ckd_free(key);
+    if (!match)
+        return FALSE;
+
+    n_ssid = (int32 const *) ((char const *) (header + DICT2PID_TABLES_HEADER) + n_key);
+    p = (char const *) (n_ssid + 2 * n_ci * n_ci);
+    d2p->ldiph_lc =
+        (s3ssid_t ***) ckd_calloc_3d(n_ci, n_ci, n_ci, sizeof(s3ssid_t));
+    memcpy(d2p->ldiph_lc[0][0], p, n_table);
+    p += n_table;
+    d2p->lrdiph_rc =
+        (s3ssid_t ***) ckd_calloc_3d(n_ci, n_ci, n_ci, sizeof(s3ssid_t));
+    memcpy(d2p->lrdiph_rc[0][0], p, n_table);
+    p += n_table;
+    if ((d2p->rssid = dict2pid_restore_tree(n_ci, n_ssid, &p, end)) == NULL
+        || (d2p->lrssid = dict2pid_restore_tree(n_ci, n_ssid + n_ci * n_ci, &p, end)) == NULL
+        || p != end) {
+        E_WARN("Saved triphone tables are corrupt, building them instead\n");
+        ckd_free_3d((void ***) d2p->ldiph_lc);
+        ckd_free_3d((void ***) d2p->lrdiph_rc);
+        d2p->ldiph_lc = NULL;
+        d2p->lrdiph_rc = NULL;
+        if (d2p->rssid)
+            free_compress_map(d2p->rssid, n_ci);
+        if (d2p->lrssid)
+            free_compress_map(d2p->lrssid, n_ci);
+        d2p->rssid = d2p->lrssid = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
 dict2pid_t *
 dict2pid_build(bin_mdef_t * mdef, dict_t * dict)
 {
@@ -401,6 +658,11 @@ dict2pid_build(bin_mdef_t * mdef, dict_t * dict)
     dict2pid->refcount = 1;
     dict2pid->mdef = bin_mdef_retain(mdef);
     dict2pid->dict = dict_retain(dict);
+    if (dict->bin_tables
+        && dict2pid_restore(dict2pid, dict->bin_tables, dict->n_bin_tables)) {
+        E_INFO("Using the triphone tables of the compiled dictionary\n");
+        return dict2pid;
+    }
     E_INFO("Allocating %d^3 * %d bytes (%d KiB) for word-initial triphones\n",
            mdef->n_ciphone, sizeof(s3ssid_t),
            mdef->n_ciphone * mdef->n_ciphone * mdef->n_ciphone * sizeof(s3ssid_t) / 1024);
@@ -123,6 +123,19 @@ dict2pid_t *dict2pid_build(bin_mdef_t *mdef,   /**< A  model definition*/
                            dict_t *dict        /**< An initialized dictionary */
     );
 
+/**
+ * Save the tables of a dict2pid structure, for dict_write_bin().
+ * dict2pid_build() copies them instead of building the tables if its
+ * dictionary was read from a compiled dictionary holding them, and
+ * has the same word-initial, word-final and single-phone contexts.
+ *
+ * Return a buffer of *out_size bytes, to free with ckd_free().
+ */
+POCKETSPHINX_EXPORT
+void *dict2pid_write_tables(dict2pid_t *d2p, /**< In: the d2p */
+                            size_t *out_size /**< Out: size of the tables */
+    );
+
 /**
  * Retain a pointer to dict2pid
  */
@@ -1386,8 +1386,7 @@ fsg_search_lattice(ps_search_t *search)
         return search->dag;
 
     /* Nope, create a new one. */
-    ps_lattice_free(search->dag);
-    search->dag = NULL;
+    ps_lattice_release_search(search);
     dag = ps_lattice_init_search(search, fsgs->frame);
     fsg = fsgs->fsg;
 
@@ -253,6 +253,17 @@ gauden_param_free(mfcc_t **** p)
     ckd_free_3d(p);
 }
 
+void
+gauden_free_params(gauden_t *g)
+{
+    if (g->mean)
+        gauden_param_free(g->mean);
+    if (g->var)
+        gauden_param_free(g->var);
+    g->mean = NULL;
+    g->var = NULL;
+}
+
 /*
  * Some of the gaussian density computation can be carried out in advance:
  * 	log(determinant) calculation,
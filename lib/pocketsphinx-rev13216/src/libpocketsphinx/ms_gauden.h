@@ -108,6 +108,13 @@ gauden_init (char const *meanfile,/**< Input: File containing means of mixture g
 /** Release memory allocated by gauden_init. */
 void gauden_free(gauden_t *g); /**< In: The gauden_t to free */
 
+/**
+ * Release the means and variances of the Gaussians, keeping the
+ * determinants, e.g. once a model has copied them to its own layout.
+ * gauden_mllr_transform() reloads them.
+ */
+void gauden_free_params(gauden_t *g);
+
 /** Transform Gaussians according to an MLLR matrix (or, eventually, more). */
 int32 gauden_mllr_transform(gauden_t *s, ps_mllr_t *mllr, cmd_ln_t *config);
 
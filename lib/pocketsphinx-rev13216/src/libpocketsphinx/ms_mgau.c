@@ -75,7 +75,8 @@ static ps_mgaufuncs_t ms_mgau_funcs = {
     "ms",
     ms_cont_mgau_frame_eval, /* frame_eval */
     ms_mgau_mllr_transform,  /* transform */
-    ms_mgau_free             /* free */
+    ms_mgau_free,            /* free */
+    NULL                     /* compact */
 };
 
 ps_mgau_t *
@@ -156,6 +157,8 @@ ms_mgau_init(acmod_t *acmod, logmath_t *lmath, bin_mdef_t *mdef)
 
     mg = (ps_mgau_t *)msg;
     mg->vt = &ms_mgau_funcs;
+    /* Always evaluates every frame */
+    mg->ds_ratio = 1;
     return mg;
 error_out:
     ms_mgau_free(ps_mgau_base(msg));
@@ -325,11 +325,12 @@ ngram_search_free(ps_search_t *search)
     ckd_free(ngs);
 }
 
-int
-ngram_search_mark_bptable(ngram_search_t *ngs, int frame_idx)
+static void
+ngram_search_alloc_frames(ngram_search_t *ngs, int n_frame)
 {
-    if (frame_idx >= ngs->n_frame_alloc) {
-        ngs->n_frame_alloc *= 2;
+    if (n_frame > ngs->n_frame_alloc) {
+        while (n_frame > ngs->n_frame_alloc)
+            ngs->n_frame_alloc *= 2;
         ngs->bp_table_idx = ckd_realloc(ngs->bp_table_idx - 1,
                                         (ngs->n_frame_alloc + 1)
                                         * sizeof(*ngs->bp_table_idx));
@@ -340,10 +341,95 @@ ngram_search_mark_bptable(ngram_search_t *ngs, int frame_idx)
         }
         ++ngs->bp_table_idx; /* Make bptableidx[-1] valid */
     }
+}
+
+int
+ngram_search_mark_bptable(ngram_search_t *ngs, int frame_idx)
+{
+    ngram_search_alloc_frames(ngs, frame_idx + 1);
     ngs->bp_table_idx[frame_idx] = ngs->bpidx;
     return ngs->bpidx;
 }
 
+void
+ngram_search_reserve(ngram_search_t *ngs, int n_frame)
+{
+    int32 n_bp, n_bss;
+
+    ngram_search_alloc_frames(ngs, n_frame);
+
+    n_bp = n_frame * ngs->bp_per_frame;
+    if (n_bp > ngs->bp_table_size) {
+        ngs->bp_table_size = n_bp;
+        ngs->bp_table = ckd_realloc(ngs->bp_table,
+                                    ngs->bp_table_size
+                                    * sizeof(*ngs->bp_table));
+    }
+    n_bss = n_frame * ngs->bss_per_frame
+        + bin_mdef_n_ciphone(ps_search_acmod(ngs)->mdef);
+    if (n_bss > ngs->bscore_stack_size) {
+        ngs->bscore_stack_size = n_bss;
+        ngs->bscore_stack = ckd_realloc(ngs->bscore_stack,
+                                        ngs->bscore_stack_size
+                                        * sizeof(*ngs->bscore_stack));
+    }
+}
+
+void
+ngram_search_compact(ngram_search_t *ngs, int max_frames)
+{
+    int32 n_bp;
+
+    /* The sizes ngram_search_init() allocates. */
+    if (ngs->n_frame_alloc > max_frames && ngs->n_frame_alloc > 256) {
+        ngs->n_frame_alloc = 256;
+        ngs->bp_table_idx = ckd_realloc(ngs->bp_table_idx - 1,
+                                        (ngs->n_frame_alloc + 1)
+                                        * sizeof(*ngs->bp_table_idx));
+        ++ngs->bp_table_idx;
+        if (ngs->frm_wordlist) {
+            ngs->frm_wordlist = ckd_realloc(ngs->frm_wordlist,
+                                            ngs->n_frame_alloc
+                                            * sizeof(*ngs->frm_wordlist));
+        }
+    }
+    n_bp = cmd_ln_int32_r(ps_search_config(ngs), "-latsize");
+    if (ngs->bp_table_size > n_bp
+        && ngs->bp_table_size > max_frames * ngs->bp_per_frame) {
+        ngs->bp_table_size = n_bp;
+        ngs->bp_table = ckd_realloc(ngs->bp_table,
+                                    ngs->bp_table_size
+                                    * sizeof(*ngs->bp_table));
+    }
+    if (ngs->bscore_stack_size > n_bp * 20
+        && ngs->bscore_stack_size > max_frames * ngs->bss_per_frame
+           + bin_mdef_n_ciphone(ps_search_acmod(ngs)->mdef)) {
+        ngs->bscore_stack_size = n_bp * 20;
+        ngs->bscore_stack = ckd_realloc(ngs->bscore_stack,
+                                        ngs->bscore_stack_size
+                                        * sizeof(*ngs->bscore_stack));
+    }
+}
+
+/**
+ * Record how many backpointer table entries per frame the last pass
+ * needed, for ngram_search_reserve().
+ */
+static void
+ngram_search_update_bp_rate(ngram_search_t *ngs)
+{
+    int32 rate;
+
+    if (ngs->n_frame <= 0)
+        return;
+    rate = (ngs->bpidx + ngs->n_frame - 1) / ngs->n_frame;
+    if (rate > ngs->bp_per_frame)
+        ngs->bp_per_frame = rate;
+    rate = (ngs->bss_head + ngs->n_frame - 1) / ngs->n_frame;
+    if (rate > ngs->bss_per_frame)
+        ngs->bss_per_frame = rate;
+}
+
 static void
 set_real_wid(ngram_search_t *ngs, int32 bp)
 {
@@ -791,6 +877,7 @@ ngram_search_finish(ps_search_t *search)
     ngs->n_tot_frame += ngs->n_frame;
     if (ngs->fwdtree) {
         ngram_fwdtree_finish(ngs);
+        ngram_search_update_bp_rate(ngs);
         /* dump_bptable(ngs); */
 
         /* Now do fwdflat search in its entirety, if requested. */
@@ -810,12 +897,14 @@ ngram_search_finish(ps_search_t *search)
                 ++i;
             }
             ngram_fwdflat_finish(ngs);
+            ngram_search_update_bp_rate(ngs);
             /* And now, we should have a result... */
             /* dump_bptable(ngs); */
         }
     }
     else if (ngs->fwdflat) {
         ngram_fwdflat_finish(ngs);
+        ngram_search_update_bp_rate(ngs);
     }
 
     /* Mark the current utterance as done. */
@@ -1235,8 +1324,7 @@ ngram_search_lattice(ps_search_t *search)
         return search->dag;
 
     /* Nope, create a new one. */
-    ps_lattice_free(search->dag);
-    search->dag = NULL;
+    ps_lattice_release_search(search);
     dag = ps_lattice_init_search(search, ngs->n_frame);
     /* Compute these such that they agree with the fwdtree language weight. */
     lwf = ngs->fwdflat ? ngs->fwdflat_fwdtree_lw_ratio : 1.0;
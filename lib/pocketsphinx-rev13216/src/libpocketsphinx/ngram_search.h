@@ -304,6 +304,9 @@ struct ngram_search_s {
     int32 bss_head;          /* First free BScoreStack entry */
     int32 bscore_stack_size;
 
+    int32 bp_per_frame;  /**< Most BPTable entries per frame of any utterance so far. */
+    int32 bss_per_frame; /**< Most BScoreStack entries per frame of any utterance so far. */
+
     int32 n_frame_alloc; /**< Number of frames allocated in bp_table_idx and friends. */
     int32 n_frame;       /**< Number of frames actually present. */
     int32 *bp_table_idx; /* First BPTable entry for each frame */
@@ -379,6 +382,20 @@ void ngram_search_free(ps_search_t *ngs);
  */
 int ngram_search_mark_bptable(ngram_search_t *ngs, int frame_idx);
 
+/**
+ * Size the backpointer table and per-frame arrays for an utterance of
+ * n_frame frames, at the rate of entries per frame previous utterances
+ * reached, so that searching it doesn't grow them frame by frame.
+ */
+void ngram_search_reserve(ngram_search_t *ngs, int n_frame);
+
+/**
+ * Shrink the backpointer table and per-frame arrays back to their
+ * initial sizes if they are sized for more than max_frames frames.
+ * Call between utterances.
+ */
+void ngram_search_compact(ngram_search_t *ngs, int max_frames);
+
 /**
  * Enter a word in the backpointer table.
  */
@@ -63,6 +63,7 @@
 #include "ngram_search_fwdtree.h"
 #include "ngram_search_fwdflat.h"
 #include "allphone_search.h"
+#include "ps_alignment.h"
 
 static const arg_t ps_args_def[] = {
     POCKETSPHINX_OPTIONS,
@@ -158,9 +159,21 @@ ps_expand_model_config(ps_decoder_t *ps)
     }
 }
 
+static void
+ps_free_alignment(ps_decoder_t *ps)
+{
+    /* The search refers to the alignment, so it goes first. */
+    if (ps->align_search)
+        ps_search_free(ps->align_search);
+    ps_alignment_free(ps->align);
+    ps->align_search = NULL;
+    ps->align = NULL;
+}
+
 static void
 ps_free_searches(ps_decoder_t *ps)
 {
+    ps_free_alignment(ps);
     if (ps->searches) {
         hash_iter_t *search_it;
         for (search_it = hash_table_iter(ps->searches); search_it;
@@ -213,8 +226,12 @@ ps_default_search_args(cmd_ln_t *config)
 #endif
 }
 
-int
-ps_reinit(ps_decoder_t *ps, cmd_ln_t *config)
+/**
+ * Reinitialize the decoder, sharing the parameters of model (if not
+ * NULL) instead of reading the acoustic model again.
+ */
+static int
+ps_reinit_shared(ps_decoder_t *ps, cmd_ln_t *config, acmod_t *model)
 {
     const char *path;
     const char *keyphrase;
@@ -271,7 +288,8 @@ ps_reinit(ps_decoder_t *ps, cmd_ln_t *config)
 
     /* Acoustic model (this is basically everything that
      * uttproc.c, senscr.c, and others used to do) */
-    if ((ps->acmod = acmod_init(ps->config, ps->lmath, NULL, NULL)) == NULL)
+    if ((ps->acmod = acmod_init_shared(ps->config, ps->lmath, NULL, NULL,
+                                       model)) == NULL)
         return -1;
 
 
@@ -383,8 +401,20 @@ ps_reinit(ps_decoder_t *ps, cmd_ln_t *config)
     return 0;
 }
 
+int
+ps_reinit(ps_decoder_t *ps, cmd_ln_t *config)
+{
+    return ps_reinit_shared(ps, config, NULL);
+}
+
 ps_decoder_t *
 ps_init(cmd_ln_t *config)
+{
+    return ps_init_shared(config, NULL);
+}
+
+ps_decoder_t *
+ps_init_shared(cmd_ln_t *config, acmod_t *model)
 {
     ps_decoder_t *ps;
     
@@ -395,13 +425,32 @@ ps_init(cmd_ln_t *config)
 
     ps = ckd_calloc(1, sizeof(*ps));
     ps->refcount = 1;
-    if (ps_reinit(ps, config) < 0) {
+    if (ps_reinit_shared(ps, config, model) < 0) {
         ps_free(ps);
         return NULL;
     }
     return ps;
 }
 
+void
+ps_compact(ps_decoder_t *ps, int max_frames)
+{
+    hash_iter_t *search_it;
+
+    if (ps->acmod->state == ACMOD_STARTED
+        || ps->acmod->state == ACMOD_PROCESSING)
+        return;
+    acmod_compact(ps->acmod, max_frames);
+    for (search_it = hash_table_iter(ps->searches); search_it;
+         search_it = hash_table_iter_next(search_it)) {
+        ps_search_t *search = hash_entry_val(search_it->ent);
+
+        ps_lattice_compact_search(search, max_frames);
+        if (0 == strcmp(ps_search_type(search), PS_SEARCH_TYPE_NGRAM))
+            ngram_search_compact((ngram_search_t *)search, max_frames);
+    }
+}
+
 arg_t const *
 ps_args(void)
 {
@@ -763,6 +812,7 @@ ps_load_dict(ps_decoder_t *ps, char const *dictfile,
     /* Success!  Update the existing config to reflect new dicts and
      * drop everything into place. */
     cmd_ln_free_r(newconfig);
+    ps_free_alignment(ps);
     dict_free(ps->dict);
     ps->dict = dict;
     dict2pid_free(ps->d2p);
@@ -952,8 +1002,7 @@ ps_start_utt(ps_decoder_t *ps)
     ++ps->uttno;
 
     /* Remove any residual word lattice and hypothesis. */
-    ps_lattice_free(ps->search->dag);
-    ps->search->dag = NULL;
+    ps_lattice_release_search(ps->search);
     ps->search->last_link = NULL;
     ps->search->post = 0;
     ckd_free(ps->search->hyp_str);
@@ -1408,6 +1457,7 @@ ps_search_base_free(ps_search_t *search)
     dict2pid_free(search->d2p);
     ckd_free(search->hyp_str);
     ps_lattice_free(search->dag);
+    ps_lattice_free(search->spare_dag);
 }
 
 void
@@ -108,6 +108,7 @@ struct ps_search_s {
     dict2pid_t *d2p;       /**< Dictionary to senone mappings. */
     char *hyp_str;         /**< Current hypothesis string. */
     ps_lattice_t *dag;	   /**< Current hypothesis word graph. */
+    ps_lattice_t *spare_dag; /**< Released word graph whose memory the next one reuses. */
     ps_latlink_t *last_link; /**< Final link in best path. */
     int32 post;            /**< Utterance posterior probability. */
     int32 n_words;         /**< Number of words known to search (may
@@ -217,6 +218,10 @@ struct ps_decoder_s {
     ps_search_t *phone_loop; /**< Phone loop search for lookahead. */
     int pl_window;           /**< Window size for phoneme lookahead. */
 
+    /* Forced alignment workspace, reused across utterances. */
+    struct ps_alignment_s *align; /**< Alignment of the last aligned utterance, or NULL. */
+    ps_search_t *align_search;    /**< State alignment search over it, or NULL. */
+
     /* Utterance-processing related stuff. */
     uint32 uttno;       /**< Utterance counter. */
     ptmr_t perf;        /**< Performance counter for all of decoding. */
@@ -231,4 +236,21 @@ struct ps_search_iter_s {
     hash_iter_t itor;
 };
 
+/**
+ * Initialize a decoder like ps_init(), sharing the acoustic model
+ * parameters of model (see acmod_init_shared()).
+ *
+ * @param model the acoustic model of another decoder, or NULL.
+ */
+ps_decoder_t *ps_init_shared(cmd_ln_t *config, acmod_t *model);
+
+/**
+ * Shrink the buffers of a decoder that grow with the length of an
+ * utterance, i.e. those of the acoustic model (see acmod_compact()),
+ * the backpointer tables of N-Gram searches and word graphs, back to
+ * their initial sizes if they are sized for more than max_frames
+ * frames.  Does nothing during an utterance.
+ */
+void ps_compact(ps_decoder_t *ps, int max_frames);
+
 #endif /* __POCKETSPHINX_INTERNAL_H__ */
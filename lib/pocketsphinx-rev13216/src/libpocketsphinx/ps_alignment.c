@@ -68,6 +68,15 @@ ps_alignment_free(ps_alignment_t *al)
     return 0;
 }
 
+int
+ps_alignment_reset(ps_alignment_t *al)
+{
+    al->word.n_ent = 0;
+    al->sseq.n_ent = 0;
+    al->state.n_ent = 0;
+    return 0;
+}
+
 #define VECTOR_GROW 10
 static void *
 vector_grow_one(void *ptr, uint16 *n_alloc, uint16 *n, size_t item_size)
@@ -102,6 +102,11 @@ ps_alignment_t *ps_alignment_init(dict2pid_t *d2p);
  */
 int ps_alignment_free(ps_alignment_t *al);
 
+/**
+ * Remove all words, phones and states, keeping the memory for the next ones.
+ */
+int ps_alignment_reset(ps_alignment_t *al);
+
 /**
  * Append a word.
  */
@@ -640,6 +640,25 @@ ps_lattice_init_search(ps_search_t *search, int n_frame)
 {
     ps_lattice_t *dag;
 
+    if ((dag = search->spare_dag) != NULL) {
+        search->spare_dag = NULL;
+        if (dag->dict != search->dict) {
+            dict_free(dag->dict);
+            dag->dict = dict_retain(search->dict);
+        }
+        dag->silence = dict_silwid(dag->dict);
+        dag->n_frames = n_frame;
+        dag->nodes = dag->start = dag->end = NULL;
+        dag->n_nodes = 0;
+        dag->final_node_ascr = 0;
+        dag->norm = 0;
+        dag->q_head = dag->q_tail = NULL;
+        listelem_alloc_reset(dag->latnode_alloc);
+        listelem_alloc_reset(dag->latlink_alloc);
+        listelem_alloc_reset(dag->latlink_list_alloc);
+        return dag;
+    }
+
     dag = ckd_calloc(1, sizeof(*dag));
     dag->search = search;
     dag->dict = dict_retain(search->dict);
@@ -654,6 +673,36 @@ ps_lattice_init_search(ps_search_t *search, int n_frame)
     return dag;
 }
 
+void
+ps_lattice_release_search(ps_search_t *search)
+{
+    ps_lattice_t *dag = search->dag;
+
+    search->dag = NULL;
+    if (dag == NULL)
+        return;
+    if (dag->refcount > 1 || search->spare_dag != NULL) {
+        ps_lattice_free(dag);
+        return;
+    }
+    search->spare_dag = dag;
+}
+
+void
+ps_lattice_compact_search(ps_search_t *search, int max_frames)
+{
+    if (search->dag && search->dag->n_frames > max_frames) {
+        ps_lattice_free(search->dag);
+        search->dag = NULL;
+        search->last_link = NULL;
+        search->post = 0;
+    }
+    if (search->spare_dag && search->spare_dag->n_frames > max_frames) {
+        ps_lattice_free(search->spare_dag);
+        search->spare_dag = NULL;
+    }
+}
+
 ps_lattice_t *
 ps_lattice_retain(ps_lattice_t *dag)
 {
@@ -196,9 +196,24 @@ typedef struct astar_seg_s {
 
 /**
  * Construct an empty word graph with reference to a search structure.
+ * Reuses the nodes and links of the search's spare word graph, if any.
  */
 ps_lattice_t *ps_lattice_init_search(ps_search_t *search, int n_frame);
 
+/**
+ * Release the current word graph of a search.  Unless it is retained
+ * elsewhere, it becomes the search's spare word graph, so that the
+ * next utterance's one is built without heap allocation.
+ */
+void ps_lattice_release_search(ps_search_t *search);
+
+/**
+ * Free the word graphs of a search that span more than max_frames
+ * frames, along with the nodes and links kept for reuse.  Call between
+ * utterances.
+ */
+void ps_lattice_compact_search(ps_search_t *search, int max_frames);
+
 /**
  * Insert penalty for fillers
  */
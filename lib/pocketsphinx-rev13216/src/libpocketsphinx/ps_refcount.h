@@ -0,0 +1,23 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/**
+ * @file ps_refcount.h
+ * @brief Atomic reference counts for model data shared between decoders.
+ *
+ * Decoders sharing an acoustic model (see ps_init_shared()) are created
+ * and freed on different threads, so the counts of the model
+ * definition, transition matrices and Gaussian parameters they share
+ * are changed atomically.  Both macros return the new count.
+ */
+#ifndef PS_REFCOUNT_H
+#define PS_REFCOUNT_H
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ps_refcount_inc(p) ((int) _InterlockedIncrement((volatile long *)(p)))
+#define ps_refcount_dec(p) ((int) _InterlockedDecrement((volatile long *)(p)))
+#else
+#define ps_refcount_inc(p) __sync_add_and_fetch((p), 1)
+#define ps_refcount_dec(p) __sync_sub_and_fetch((p), 1)
+#endif
+
+#endif /* PS_REFCOUNT_H */
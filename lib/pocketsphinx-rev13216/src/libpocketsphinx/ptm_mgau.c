@@ -42,6 +42,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <math.h>
+#include <stdint.h>
 #if defined(__ADSPBLACKFIN__)
 #elif !defined(_WIN32_WCE)
 #include <sys/types.h>
@@ -59,12 +60,14 @@
 /* Local headers */
 #include "tied_mgau_common.h"
 #include "ptm_mgau.h"
+#include "ps_refcount.h"
 
 static ps_mgaufuncs_t ptm_mgau_funcs = {
     "ptm",
     ptm_mgau_frame_eval,      /* frame_eval */
     ptm_mgau_mllr_transform,  /* transform */
-    ptm_mgau_free             /* free */
+    ptm_mgau_free,            /* free */
+    ptm_mgau_compact          /* compact */
 };
 
 #define COMPUTE_GMM_MAP(_idx)                           \
@@ -74,6 +77,33 @@ static ps_mgaufuncs_t ptm_mgau_funcs = {
 #define COMPUTE_GMM_REDUCE(_idx)                \
     d = GMMSUB(d, compl[_idx]);
 
+/*
+ * Portable x86-64 builds (PS_KERNEL_DISPATCH, see
+ * LIPSYNCENGINE_NATIVE_ARCH in CMakeLists.txt) compile the Gaussian
+ * evaluation for several instruction set levels, and the loader picks
+ * the best one the CPU supports.  Floating-point contraction is off in
+ * those builds, so all levels compute the same scores.
+ */
+#if defined(PS_KERNEL_DISPATCH)
+#define PTM_KERNEL __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "arch=x86-64-v2", "default")))
+#else
+#define PTM_KERNEL
+#endif
+
+/* Alignment of the packed densities, enough for 256-bit vectors. */
+#define PTM_DENS_ALIGN 32
+
+/**
+ * Means of a density in the packed layout; its variances follow after
+ * the padded feature length.
+ */
+static mfcc_t *
+dens_mean(ptm_mgau_t *s, int cb, int feat, int cw)
+{
+    return s->dens + s->dens_offset[cb * s->g->n_feat + feat]
+        + (size_t)cw * 2 * s->dens_stride[feat];
+}
+
 static void
 insertion_sort_topn(ptm_topn_t *topn, int i, int32 d)
 {
@@ -90,13 +120,12 @@ insertion_sort_topn(ptm_topn_t *topn, int i, int32 d)
     topn[j + 1] = vtmp;
 }
 
+PTM_KERNEL
 static int
-eval_topn(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
+eval_topn(ptm_mgau_t *s, ptm_topn_t *topn, int cb, int feat, mfcc_t *z)
 {
-    ptm_topn_t *topn;
     int i, ceplen;
 
-    topn = s->f->topn[cb][feat];
     ceplen = s->g->featlen[feat];
 
     for (i = 0; i < s->max_topn; i++) {
@@ -106,8 +135,8 @@ eval_topn(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
         int32 cw, j;
 
         cw = topn[i].cw;
-        mean = s->g->mean[cb][feat][0] + cw * ceplen;
-        var = s->g->var[cb][feat][0] + cw * ceplen;
+        mean = dens_mean(s, cb, feat, cw);
+        var = mean + s->dens_stride[feat];
         d = s->g->det[cb][feat][cw];
         obs = z;
         for (j = 0; j < ceplen % 4; ++j) {
@@ -117,6 +146,9 @@ eval_topn(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
             d = GMMSUB(d, compl[0]);
             ++var;
         }
+#ifdef TIED_MGAU_SIMD128
+        d = GMMSUB(d, gmm_dist(obs, mean, var, ceplen - j));
+#else
         /* We could vectorize this but it's unlikely to make much
          * difference as the outer loop here isn't very big. */
         for (;j < ceplen; j += 4) {
@@ -132,6 +164,7 @@ eval_topn(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
             obs += 4;
             mean += 4;
         }
+#endif
         insertion_sort_topn(topn, i, (int32)d);
     }
 
@@ -151,29 +184,32 @@ insertion_sort_cb(ptm_topn_t **cur, ptm_topn_t *worst, ptm_topn_t *best,
     (*cur)->score = intd;
 }
 
+PTM_KERNEL
 static int
-eval_cb(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
+eval_cb(ptm_mgau_t *s, ptm_topn_t *topn, int cb, int feat, mfcc_t *z)
 {
-    ptm_topn_t *worst, *best, *topn;
-    mfcc_t *mean;
-    mfcc_t *var, *det, *detP, *detE;
-    int32 i, ceplen;
+    ptm_topn_t *worst, *best;
+    mfcc_t *row;
+    mfcc_t *det, *detP, *detE;
+    int32 i, ceplen, stride;
 
-    best = topn = s->f->topn[cb][feat];
+    best = topn;
     worst = topn + (s->max_topn - 1);
-    mean = s->g->mean[cb][feat][0];
-    var = s->g->var[cb][feat][0];
+    row = dens_mean(s, cb, feat, 0);
+    stride = s->dens_stride[feat];
     det = s->g->det[cb][feat];
     detE = det + s->g->n_density;
     ceplen = s->g->featlen[feat];
 
-    for (detP = det; detP < detE; ++detP) {
+    for (detP = det; detP < detE; ++detP, row += 2 * stride) {
         mfcc_t diff[4], sqdiff[4], compl[4]; /* diff, diff^2, component likelihood */
         mfcc_t d, thresh;
-        mfcc_t *obs;
+        mfcc_t *obs, *mean, *var;
         ptm_topn_t *cur;
         int32 cw, j;
 
+        mean = row;
+        var = row + stride;
         d = *detP;
         thresh = (mfcc_t) worst->score; /* Avoid int-to-float conversions */
         obs = z;
@@ -188,9 +224,21 @@ eval_cb(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
             compl[0] = MFCCMUL(sqdiff[0], *var++);
             d = GMMSUB(d, compl[0]);
         }
+#ifdef TIED_MGAU_SIMD128
+        /* Four dimensions per vector, still pruning after each block. */
+        for (; j < ceplen && d >= thresh; j += 4) {
+            d = GMMSUB(d, gmm_sum4(gmm_compl4(obs, mean, var)));
+            var += 4;
+            obs += 4;
+            mean += 4;
+        }
+#else
         /* Now do 4 dimensions at a time.  You'd think that GCC would
          * vectorize this?  Apparently not.  And it's right, because
-         * that won't make this any faster, at least on x86-64. */
+         * that won't make this any faster, at least on x86-64.  Nor
+         * does fixing ceplen at compile time for 39-dimensional
+         * features: the pruning test after every block bounds the
+         * loop, not reading its length. */
         for (; j < ceplen && d >= thresh; j += 4) {
             COMPUTE_GMM_MAP(0);
             COMPUTE_GMM_MAP(1);
@@ -204,10 +252,9 @@ eval_cb(ptm_mgau_t *s, int cb, int feat, mfcc_t *z)
             obs += 4;
             mean += 4;
         }
+#endif
         if (j < ceplen) {
             /* terminated early, so not in topn */
-            mean += (ceplen - j);
-            var += (ceplen - j);
             continue;
         }
         if (d < thresh)
@@ -236,10 +283,10 @@ ptm_mgau_codebook_eval(ptm_mgau_t *s, mfcc_t **z, int frame)
     /* First evaluate top-N from previous frame. */
     for (i = 0; i < s->g->n_mgau; ++i)
         for (j = 0; j < s->g->n_feat; ++j)
-            eval_topn(s, i, j, z[j]);
+            eval_topn(s, s->f->topn[i][j], i, j, z[j]);
 
     /* If frame downsampling is in effect, possibly do nothing else. */
-    if (frame % s->ds_ratio)
+    if (frame % ps_mgau_base(s)->ds_ratio)
         return 0;
 
     /* Evaluate remaining codebooks. */
@@ -247,7 +294,182 @@ ptm_mgau_codebook_eval(ptm_mgau_t *s, mfcc_t **z, int frame)
         if (bitvec_is_clear(s->f->mgau_active, i))
             continue;
         for (j = 0; j < s->g->n_feat; ++j) {
-            eval_cb(s, i, j, z[j]);
+            eval_cb(s, s->f->topn[i][j], i, j, z[j]);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Size of the top-N densities of one frame in the codebook cache
+ */
+static size_t
+cache_frame_size(ptm_mgau_t *s)
+{
+    return (size_t)s->g->n_mgau * s->g->n_feat * s->max_topn;
+}
+
+/**
+ * Pointer to the top-N densities of a codebook and feature in a frame of
+ * the current block
+ */
+static ptm_topn_t *
+block_topn(ptm_mgau_t *s, int block_frame, int cb, int feat)
+{
+    return s->block_topn
+        + (((size_t)block_frame * s->g->n_mgau + cb) * s->g->n_feat + feat)
+        * s->max_topn;
+}
+
+/**
+ * Compute the top-N densities of all codebooks for a block of frames
+ * starting at the given one, as far as the acoustic model holds their
+ * features.  Instead of sweeping all codebooks for each frame, each
+ * codebook is swept for all frames of the block while its Gaussians are
+ * in the cache.  The densities are exact, so they are the same as those
+ * of ptm_mgau_codebook_eval() for the codebooks that turn out active.
+ *
+ * @return Number of frames in the block, 0 if there are none
+ */
+static int
+ptm_mgau_codebook_block_eval(ptm_mgau_t *s, int frame)
+{
+    int i, j, k, n_frame;
+
+    for (n_frame = 0; n_frame < s->n_block_alloc; ++n_frame) {
+        s->block_feat[n_frame] = acmod_peek_frame(s->acmod, frame + n_frame);
+        if (s->block_feat[n_frame] == NULL)
+            break;
+    }
+    s->block_start = frame;
+    s->n_block_frame = n_frame;
+    if (n_frame == 0)
+        return 0;
+
+    if (s->block_eval != NULL
+        && s->block_eval(s->block_eval_udata, s, s->block_feat, n_frame,
+                         s->block_topn) == 0)
+        return n_frame;
+
+    for (i = 0; i < s->g->n_mgau; ++i) {
+        for (j = 0; j < s->g->n_feat; ++j) {
+            /* As in ptm_mgau_codebook_eval(), rescoring the previous
+             * frame's top-N first sets the pruning threshold. */
+            ptm_topn_t *prev = s->f->topn[i][j];
+            for (k = 0; k < n_frame; ++k) {
+                ptm_topn_t *topn = block_topn(s, k, i, j);
+                memcpy(topn, prev, s->max_topn * sizeof(*topn));
+                eval_topn(s, topn, i, j, s->block_feat[k][j]);
+                eval_cb(s, topn, i, j, s->block_feat[k][j]);
+                prev = topn;
+            }
+        }
+    }
+    return n_frame;
+}
+
+/**
+ * Take the top-N densities of a frame from the current block, evaluating
+ * a new block if the frame isn't in it
+ *
+ * @return 0 on success, -1 if the frame's features aren't available
+ */
+static int
+ptm_mgau_codebook_block_fetch(ptm_mgau_t *s, int frame)
+{
+    /* A new utterance starts with a new block. */
+    if (frame == 0 || frame < s->block_start
+        || frame >= s->block_start + s->n_block_frame) {
+        if (ptm_mgau_codebook_block_eval(s, frame) == 0)
+            return -1;
+    }
+    memcpy(s->f->topn[0][0], block_topn(s, frame - s->block_start, 0, 0),
+           cache_frame_size(s) * sizeof(ptm_topn_t));
+    return 0;
+}
+
+/**
+ * Pointer to the cached top-N densities of a codebook in a frame
+ */
+static ptm_topn_t *
+cache_topn(ptm_mgau_t *s, int frame, int cb)
+{
+    return s->cache_topn + frame * cache_frame_size(s)
+        + (size_t)cb * s->g->n_feat * s->max_topn;
+}
+
+/**
+ * Whether a codebook is recorded in a frame
+ */
+static int
+cache_is_valid(ptm_mgau_t *s, int frame, int cb)
+{
+    return bitvec_is_set(s->cache_valid, frame * s->g->n_mgau + cb);
+}
+
+/**
+ * Record the top-N densities of the active codebooks, which the current
+ * frame has evaluated in full
+ */
+static void
+ptm_mgau_codebook_record(ptm_mgau_t *s, int frame)
+{
+    int i, n_bits;
+
+    /* A new recording starts with the utterance. */
+    if (frame == 0)
+        s->n_cache_frame = 0;
+    if (frame >= s->n_cache_alloc) {
+        int n_alloc = s->n_cache_alloc ? s->n_cache_alloc : 256;
+        while (n_alloc <= frame)
+            n_alloc *= 2;
+        s->cache_topn = ckd_realloc(s->cache_topn,
+                                    n_alloc * cache_frame_size(s)
+                                    * sizeof(*s->cache_topn));
+        s->cache_valid = bitvec_realloc(s->cache_valid,
+                                        s->n_cache_alloc * s->g->n_mgau,
+                                        n_alloc * s->g->n_mgau);
+        s->n_cache_alloc = n_alloc;
+    }
+    /* Frames skipped since the last recorded one (e.g. downsampled
+     * ones) have nothing recorded. */
+    for (n_bits = s->n_cache_frame * s->g->n_mgau;
+         n_bits < (frame + 1) * s->g->n_mgau; ++n_bits)
+        bitvec_clear(s->cache_valid, n_bits);
+    if (frame >= s->n_cache_frame)
+        s->n_cache_frame = frame + 1;
+
+    for (i = 0; i < s->g->n_mgau; ++i) {
+        if (bitvec_is_clear(s->f->mgau_active, i))
+            continue;
+        memcpy(cache_topn(s, frame, i), s->f->topn[i][0],
+               s->g->n_feat * s->max_topn * sizeof(ptm_topn_t));
+        bitvec_set(s->cache_valid, frame * s->g->n_mgau + i);
+    }
+}
+
+/**
+ * Compute top-N densities for active codebooks, taking those recorded
+ * for the frame from the cache
+ */
+static int
+ptm_mgau_codebook_replay(ptm_mgau_t *s, mfcc_t **z, int frame)
+{
+    int i, j;
+
+    for (i = 0; i < s->g->n_mgau; ++i) {
+        if (bitvec_is_clear(s->f->mgau_active, i))
+            continue;
+        if (cache_is_valid(s, frame, i)) {
+            memcpy(s->f->topn[i][0], cache_topn(s, frame, i),
+                   s->g->n_feat * s->max_topn * sizeof(ptm_topn_t));
+            continue;
+        }
+        /* As in ptm_mgau_codebook_eval(), rescoring the previous
+         * frame's top-N first sets the pruning threshold. */
+        for (j = 0; j < s->g->n_feat; ++j) {
+            eval_topn(s, s->f->topn[i][j], i, j, z[j]);
+            eval_cb(s, s->f->topn[i][j], i, j, z[j]);
         }
     }
     return 0;
@@ -323,6 +545,7 @@ ptm_mgau_calc_cb_active(ptm_mgau_t *s, uint8 *senone_active,
 /**
  * Compute senone scores from top-N densities for active codebooks.
  */
+PTM_KERNEL
 static int
 ptm_mgau_senone_eval(ptm_mgau_t *s, int16 *senone_scores,
                      uint8 *senone_active, int32 n_senone_active,
@@ -395,7 +618,17 @@ ptm_mgau_senone_eval(ptm_mgau_t *s, int16 *senone_scores,
     }
     /* Normalize the scores again (finishing the job we started above
      * in ptm_mgau_codebook_eval...) */
-    for (i = 0; i < s->n_sen; ++i) {
+    i = 0;
+#ifdef TIED_MGAU_SIMD128
+    {
+        v128_t best = wasm_i16x8_splat((int16)bestscore);
+        for (; i + 8 <= s->n_sen; i += 8) {
+            v128_t scores = wasm_v128_load(senone_scores + i);
+            wasm_v128_store(senone_scores + i, wasm_i16x8_sub(scores, best));
+        }
+    }
+#endif
+    for (; i < s->n_sen; ++i) {
         senone_scores[i] -= bestscore;
     }
 
@@ -442,8 +675,23 @@ ptm_mgau_frame_eval(ps_mgau_t *ps,
         /* Generate initial active codebook list (this might not be
          * necessary) */
         ptm_mgau_calc_cb_active(s, senone_active, n_senone_active, compallsen);
-        /* Now evaluate top-N, prune, and evaluate remaining codebooks. */
-        ptm_mgau_codebook_eval(s, featbuf, frame);
+        if (ps->cache_mode == PS_MGAU_CACHE_REPLAY
+            && frame < s->n_cache_frame) {
+            /* Reuse the codebooks recorded by an earlier pass. */
+            ptm_mgau_codebook_replay(s, featbuf, frame);
+        }
+        else {
+            /* Now evaluate top-N, prune, and evaluate remaining codebooks,
+             * in blocks of frames if possible.  Downsampling leaves frames
+             * partially evaluated, so it rules out blocks. */
+            if (s->n_block_alloc == 0 || ps->ds_ratio != 1
+                || ptm_mgau_codebook_block_fetch(s, frame) < 0)
+                ptm_mgau_codebook_eval(s, featbuf, frame);
+            /* Downsampled frames are only partially evaluated. */
+            if (ps->cache_mode == PS_MGAU_CACHE_RECORD
+                && frame % ps->ds_ratio == 0)
+                ptm_mgau_codebook_record(s, frame);
+        }
         ptm_mgau_codebook_norm(s, featbuf, frame);
     }
     /* Evaluate intersection of active senones and active codebooks. */
@@ -766,6 +1014,132 @@ read_mixw(ptm_mgau_t * s, char const *file_name, double SmoothMin)
     return n_sen;
 }
 
+/**
+ * Copy the means and (precomputed) variances into one aligned block in
+ * the order the top-N evaluation reads them: by codebook, feature and
+ * density, each density's means followed by its variances, both padded
+ * to a multiple of four dimensions.  The nested arrays of the Gaussians
+ * are freed, as nothing else reads them.
+ */
+static void
+ptm_mgau_pack_densities(ptm_mgau_t *s)
+{
+    gauden_t *g = s->g;
+    size_t size;
+    int i, j, k;
+
+    if (s->dens_offset == NULL) {
+        s->dens_offset = ckd_calloc(g->n_mgau * g->n_feat, sizeof(*s->dens_offset));
+        s->dens_stride = ckd_calloc(g->n_feat, sizeof(*s->dens_stride));
+    }
+    for (j = 0; j < g->n_feat; ++j)
+        s->dens_stride[j] = (g->featlen[j] + 3) & ~3;
+    size = 0;
+    for (i = 0; i < g->n_mgau; ++i) {
+        for (j = 0; j < g->n_feat; ++j) {
+            s->dens_offset[i * g->n_feat + j] = size;
+            size += (size_t)g->n_density * 2 * s->dens_stride[j];
+        }
+    }
+
+    ckd_free(s->dens_alloc);
+    s->dens_alloc = ckd_calloc(size * sizeof(mfcc_t) + PTM_DENS_ALIGN, 1);
+    s->dens = (mfcc_t *)(((uintptr_t)s->dens_alloc + PTM_DENS_ALIGN - 1)
+                         & ~(uintptr_t)(PTM_DENS_ALIGN - 1));
+    for (i = 0; i < g->n_mgau; ++i) {
+        for (j = 0; j < g->n_feat; ++j) {
+            for (k = 0; k < g->n_density; ++k) {
+                mfcc_t *mean = dens_mean(s, i, j, k);
+                memcpy(mean, g->mean[i][j][k], g->featlen[j] * sizeof(mfcc_t));
+                memcpy(mean + s->dens_stride[j], g->var[i][j][k],
+                       g->featlen[j] * sizeof(mfcc_t));
+            }
+        }
+    }
+
+    gauden_free_params(g);
+}
+
+/**
+ * Verify the number and length of the Gaussians' streams against the
+ * features of the acoustic model.
+ */
+static int
+ptm_mgau_check_feat(ptm_mgau_t *s, acmod_t *acmod)
+{
+    int i;
+
+    if (s->g->n_feat != feat_dimension1(acmod->fcb)) {
+        E_ERROR("Number of streams does not match: %d != %d\n",
+                s->g->n_feat, feat_dimension1(acmod->fcb));
+        return -1;
+    }
+    for (i = 0; i < s->g->n_feat; ++i) {
+        if (s->g->featlen[i] != (int32) feat_dimension2(acmod->fcb, i)) {
+            E_ERROR("Dimension of stream %d does not match: %d != %d\n",
+                    s->g->featlen[i], feat_dimension2(acmod->fcb, i));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Allocate the evaluation state, which every mixture has its own of,
+ * even if it shares its parameters.
+ */
+static void
+ptm_mgau_init_eval(ptm_mgau_t *s, acmod_t *acmod)
+{
+    int i;
+
+    ps_mgau_base(s)->ds_ratio = cmd_ln_int32_r(s->config, "-ds");
+    s->max_topn = cmd_ln_int32_r(s->config, "-topn");
+    E_INFO("Maximum top-N: %d\n", s->max_topn);
+
+    /* Frame blocks, if enabled. */
+    s->acmod = acmod;
+    s->n_block_alloc = cmd_ln_int32_r(s->config, "-topn_block");
+    if (s->n_block_alloc > 0) {
+        E_INFO("Top-N block: %d frames\n", s->n_block_alloc);
+        s->block_feat = ckd_calloc(s->n_block_alloc, sizeof(*s->block_feat));
+        s->block_topn = ckd_calloc((size_t)s->n_block_alloc * s->g->n_mgau
+                                   * s->g->n_feat * s->max_topn,
+                                   sizeof(*s->block_topn));
+    }
+    else {
+        s->n_block_alloc = 0;
+    }
+
+    /* Allocate fast-match history buffers.  We need enough for the
+     * phoneme lookahead window, plus the current frame, plus one for
+     * good measure? (FIXME: I don't remember why) */
+    s->n_fast_hist = cmd_ln_int32_r(s->config, "-pl_window") + 2;
+    s->hist = ckd_calloc(s->n_fast_hist, sizeof(*s->hist));
+    /* s->f will be a rotating pointer into s->hist. */
+    s->f = s->hist;
+    for (i = 0; i < s->n_fast_hist; ++i) {
+        int j, k, m;
+        /* Top-N codewords for every codebook and feature. */
+        s->hist[i].topn = ckd_calloc_3d(s->g->n_mgau, s->g->n_feat,
+                                        s->max_topn, sizeof(ptm_topn_t));
+        /* Initialize them to sane (yet arbitrary) defaults. */
+        for (j = 0; j < s->g->n_mgau; ++j) {
+            for (k = 0; k < s->g->n_feat; ++k) {
+                for (m = 0; m < s->max_topn; ++m) {
+                    s->hist[i].topn[j][k][m].cw = m;
+                    s->hist[i].topn[j][k][m].score = WORST_DIST;
+                }
+            }
+        }
+        /* Active codebook mapping (just codebook, not features,
+           at least not yet) */
+        s->hist[i].mgau_active = bitvec_alloc(s->g->n_mgau);
+        /* Start with them all on, prune them later. */
+        bitvec_set_all(s->hist[i].mgau_active, s->g->n_mgau);
+    }
+}
+
 ps_mgau_t *
 ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
 {
@@ -776,6 +1150,8 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
 
     s = ckd_calloc(1, sizeof(*s));
     s->config = acmod->config;
+    s->params_refcount = ckd_calloc(1, sizeof(*s->params_refcount));
+    *s->params_refcount = 1;
 
     s->lmath = logmath_retain(acmod->lmath);
     /* Log-add table. */
@@ -809,18 +1185,10 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
         goto error_out;
     }
     /* Verify n_feat and veclen, against acmod. */
-    if (s->g->n_feat != feat_dimension1(acmod->fcb)) {
-        E_ERROR("Number of streams does not match: %d != %d\n",
-                s->g->n_feat, feat_dimension1(acmod->fcb));
+    if (ptm_mgau_check_feat(s, acmod) < 0)
         goto error_out;
-    }
-    for (i = 0; i < s->g->n_feat; ++i) {
-        if (s->g->featlen[i] != feat_dimension2(acmod->fcb, i)) {
-            E_ERROR("Dimension of stream %d does not match: %d != %d\n",
-                    s->g->featlen[i], feat_dimension2(acmod->fcb, i));
-            goto error_out;
-        }
-    }
+    ptm_mgau_pack_densities(s);
+
     /* Read mixture weights. */
     if ((sendump_path = cmd_ln_str_r(s->config, "_sendump"))) {
         if (read_sendump(s, acmod->mdef, sendump_path) < 0) {
@@ -833,9 +1201,6 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
             goto error_out;
         }
     }
-    s->ds_ratio = cmd_ln_int32_r(s->config, "-ds");
-    s->max_topn = cmd_ln_int32_r(s->config, "-topn");
-    E_INFO("Maximum top-N: %d\n", s->max_topn);
 
     /* Assume mapping of senones to their base phones, though this
      * will become more flexible in the future. */
@@ -843,33 +1208,49 @@ ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef)
     for (i = 0; i < s->n_sen; ++i)
         s->sen2cb[i] = bin_mdef_sen2cimap(acmod->mdef, i);
 
-    /* Allocate fast-match history buffers.  We need enough for the
-     * phoneme lookahead window, plus the current frame, plus one for
-     * good measure? (FIXME: I don't remember why) */
-    s->n_fast_hist = cmd_ln_int32_r(s->config, "-pl_window") + 2;
-    s->hist = ckd_calloc(s->n_fast_hist, sizeof(*s->hist));
-    /* s->f will be a rotating pointer into s->hist. */
-    s->f = s->hist;
-    for (i = 0; i < s->n_fast_hist; ++i) {
-        int j, k, m;
-        /* Top-N codewords for every codebook and feature. */
-        s->hist[i].topn = ckd_calloc_3d(s->g->n_mgau, s->g->n_feat,
-                                        s->max_topn, sizeof(ptm_topn_t));
-        /* Initialize them to sane (yet arbitrary) defaults. */
-        for (j = 0; j < s->g->n_mgau; ++j) {
-            for (k = 0; k < s->g->n_feat; ++k) {
-                for (m = 0; m < s->max_topn; ++m) {
-                    s->hist[i].topn[j][k][m].cw = m;
-                    s->hist[i].topn[j][k][m].score = WORST_DIST;
-                }
-            }
-        }
-        /* Active codebook mapping (just codebook, not features,
-           at least not yet) */
-        s->hist[i].mgau_active = bitvec_alloc(s->g->n_mgau);
-        /* Start with them all on, prune them later. */
-        bitvec_set_all(s->hist[i].mgau_active, s->g->n_mgau);
-    }
+    ptm_mgau_init_eval(s, acmod);
+
+    ps = (ps_mgau_t *)s;
+    ps->vt = &ptm_mgau_funcs;
+    return ps;
+error_out:
+    ptm_mgau_free(ps_mgau_base(s));
+    return NULL;
+}
+
+ps_mgau_t *
+ptm_mgau_init_shared(acmod_t *acmod, bin_mdef_t *mdef, ps_mgau_t *model)
+{
+    ptm_mgau_t *s, *m;
+    ps_mgau_t *ps;
+
+    if (model->vt != &ptm_mgau_funcs)
+        return NULL;
+    m = (ptm_mgau_t *)model;
+    if (m->n_sen != bin_mdef_n_sen(mdef)
+        || m->g->n_mgau != bin_mdef_n_ciphone(mdef))
+        return NULL;
+
+    s = ckd_calloc(1, sizeof(*s));
+    s->config = acmod->config;
+    s->lmath = logmath_retain(acmod->lmath);
+    s->params_refcount = m->params_refcount;
+    ps_refcount_inc(s->params_refcount);
+    s->lmath_8b = m->lmath_8b;
+    s->g = m->g;
+    s->dens = m->dens;
+    s->dens_alloc = m->dens_alloc;
+    s->dens_offset = m->dens_offset;
+    s->dens_stride = m->dens_stride;
+    s->n_sen = m->n_sen;
+    s->sen2cb = m->sen2cb;
+    s->mixw = m->mixw;
+    s->sendump_mmap = m->sendump_mmap;
+    s->mixw_cb = m->mixw_cb;
+
+    if (ptm_mgau_check_feat(s, acmod) < 0)
+        goto error_out;
+    ptm_mgau_init_eval(s, acmod);
 
     ps = (ps_mgau_t *)s;
     ps->vt = &ptm_mgau_funcs;
@@ -884,7 +1265,47 @@ ptm_mgau_mllr_transform(ps_mgau_t *ps,
                             ps_mllr_t *mllr)
 {
     ptm_mgau_t *s = (ptm_mgau_t *)ps;
-    return gauden_mllr_transform(s->g, mllr, s->config);
+    if (*s->params_refcount > 1) {
+        E_ERROR("Cannot transform Gaussians shared with other acoustic models\n");
+        return -1;
+    }
+    /* The block was evaluated with the old Gaussians. */
+    s->n_block_frame = 0;
+    if (gauden_mllr_transform(s->g, mllr, s->config) < 0)
+        return -1;
+    ptm_mgau_pack_densities(s);
+    return 0;
+}
+
+/**
+ * Free the codebook cache if it holds more than max_frames frames; the
+ * next recording allocates it again
+ */
+void
+ptm_mgau_compact(ps_mgau_t *ps, int max_frames)
+{
+    ptm_mgau_t *s = (ptm_mgau_t *)ps;
+
+    if (s->n_cache_alloc <= max_frames)
+        return;
+    ckd_free(s->cache_topn);
+    bitvec_free(s->cache_valid);
+    s->cache_topn = NULL;
+    s->cache_valid = NULL;
+    s->n_cache_alloc = 0;
+    s->n_cache_frame = 0;
+}
+
+void
+ptm_mgau_set_block_eval(ps_mgau_t *ps, ptm_mgau_block_eval_t eval,
+                        void *udata)
+{
+    ptm_mgau_t *s = (ptm_mgau_t *)ps;
+
+    s->block_eval = eval;
+    s->block_eval_udata = udata;
+    /* The current block may have been evaluated otherwise. */
+    s->n_block_frame = 0;
 }
 
 void
@@ -894,22 +1315,32 @@ ptm_mgau_free(ps_mgau_t *ps)
     ptm_mgau_t *s = (ptm_mgau_t *)ps;
 
     logmath_free(s->lmath);
-    logmath_free(s->lmath_8b);
-    if (s->sendump_mmap) {
-        ckd_free_2d(s->mixw); 
-        mmio_file_unmap(s->sendump_mmap);
-    }
-    else {
-        ckd_free_3d(s->mixw);
+    /* The last mixture sharing the parameters frees them. */
+    if (s->params_refcount && ps_refcount_dec(s->params_refcount) == 0) {
+        logmath_free(s->lmath_8b);
+        if (s->sendump_mmap) {
+            ckd_free_2d(s->mixw); 
+            mmio_file_unmap(s->sendump_mmap);
+        }
+        else {
+            ckd_free_3d(s->mixw);
+        }
+        ckd_free(s->sen2cb);
+        ckd_free(s->dens_alloc);
+        ckd_free(s->dens_offset);
+        ckd_free(s->dens_stride);
+        gauden_free(s->g);
+        ckd_free(s->params_refcount);
     }
-    ckd_free(s->sen2cb);
     
     for (i = 0; i < s->n_fast_hist; i++) {
 	ckd_free_3d(s->hist[i].topn);
 	bitvec_free(s->hist[i].mgau_active);
     }
     ckd_free(s->hist);
-    
-    gauden_free(s->g);
+    ckd_free(s->cache_topn);
+    bitvec_free(s->cache_valid);
+    ckd_free(s->block_feat);
+    ckd_free(s->block_topn);
     ckd_free(s);
 }
@@ -60,6 +60,19 @@ typedef struct ptm_topn_s {
     int32 score; /**< Score. */
 } ptm_topn_t;
 
+/**
+ * Computes the top-N densities of all codebooks for a block of frames in
+ * place of the scorer, e.g. on a GPU (see ptm_mgau_set_block_eval()).
+ * feat holds the features of n_frame frames, by frame and feature.  topn
+ * receives the top-N densities by frame, codebook, feature and rank,
+ * best first, as ptm_mgau_codebook_eval() computes them.
+ *
+ * @return 0 on success, or negative to have the scorer evaluate the block.
+ */
+typedef int (*ptm_mgau_block_eval_t)(void *udata, ptm_mgau_t *s,
+                                     mfcc_t ***feat, int n_frame,
+                                     ptm_topn_t *topn);
+
 typedef struct ptm_fast_eval_s {
     ptm_topn_t ***topn;     /**< Top-N for each codebook (mgau x feature x topn) */
     bitvec_t *mgau_active; /**< Set of active codebooks */
@@ -68,26 +81,57 @@ typedef struct ptm_fast_eval_s {
 struct ptm_mgau_s {
     ps_mgau_t base;     /**< base structure. */
     cmd_ln_t *config;   /**< Configuration parameters */
-    gauden_t *g;        /**< Set of Gaussians. */
+    gauden_t *g;        /**< Set of Gaussians (means and variances are in dens). */
+    mfcc_t *dens;       /**< Means and variances packed for evaluation (see ptm_mgau_pack_densities()). */
+    void *dens_alloc;   /**< Allocation holding dens, which is aligned within it. */
+    size_t *dens_offset;/**< Offset of each codebook's feature in dens (codebook x feature). */
+    int32 *dens_stride; /**< Padded length of each feature, half the size of a density. */
     int32 n_sen;       /**< Number of senones. */
     uint8 *sen2cb;     /**< Senone to codebook mapping. */
     uint8 ***mixw;     /**< Mixture weight distributions by feature, codeword, senone */
     mmio_file_t *sendump_mmap;/* Memory map for mixw (or NULL if not mmap) */
     uint8 *mixw_cb;    /* Mixture weight codebook, if any (assume it contains 16 values) */
     int16 max_topn;
-    int16 ds_ratio;
 
     ptm_fast_eval_t *hist;   /**< Fast evaluation info for past frames. */
     ptm_fast_eval_t *f;      /**< Fast eval info for current frame. */
     int n_fast_hist;         /**< Number of past frames tracked. */
 
+    /* Codebook cache (see acmod_set_cache_mode()), grown as needed. */
+    ptm_topn_t *cache_topn;  /**< Top-N by frame, codebook, feature and rank. */
+    bitvec_t *cache_valid;   /**< Recorded codebooks by frame and codebook. */
+    int32 n_cache_alloc;     /**< Number of frames allocated. */
+    int32 n_cache_frame;     /**< Number of frames recorded. */
+
+    /* Frame blocks (see -topn_block), evaluated codebook by codebook. */
+    acmod_t *acmod;          /**< Acoustic model holding the features (not owned). */
+    int32 n_block_alloc;     /**< Maximum number of frames per block, 0 if disabled. */
+    mfcc_t ***block_feat;    /**< Features of the frames of the current block. */
+    ptm_topn_t *block_topn;  /**< Top-N by block frame, codebook, feature and rank. */
+    int32 block_start;       /**< First frame of the current block. */
+    int32 n_block_frame;     /**< Number of frames in the current block. */
+    ptm_mgau_block_eval_t block_eval; /**< Evaluates blocks in place of the scorer, if not NULL. */
+    void *block_eval_udata;  /**< Data passed to block_eval. */
+
     /* Log-add table for compressed values. */
     logmath_t *lmath_8b;
+    /* References to the parameters read from the model (g, dens, sen2cb,
+     * mixw and lmath_8b), which mixtures initialized with
+     * ptm_mgau_init_shared() share. */
+    int *params_refcount;
     /* Log-add object for reloading means/variances. */
     logmath_t *lmath;
 };
 
 ps_mgau_t *ptm_mgau_init(acmod_t *acmod, bin_mdef_t *mdef);
+/**
+ * Initialize a mixture sharing the parameters of another, which must
+ * also be a PTM mixture read with the same model definition.  Only
+ * the evaluation state (top-N history, caches and blocks) is
+ * allocated.
+ */
+ps_mgau_t *ptm_mgau_init_shared(acmod_t *acmod, bin_mdef_t *mdef,
+                                ps_mgau_t *model);
 void ptm_mgau_free(ps_mgau_t *s);
 int ptm_mgau_frame_eval(ps_mgau_t *s,
                         int16 *senone_scores,
@@ -98,6 +142,14 @@ int ptm_mgau_frame_eval(ps_mgau_t *s,
                         int32 compallsen);
 int ptm_mgau_mllr_transform(ps_mgau_t *s,
                             ps_mllr_t *mllr);
+void ptm_mgau_compact(ps_mgau_t *s, int max_frames);
+/**
+ * Have the blocks of frames (see -topn_block) evaluated by another
+ * function, or by the scorer itself if eval is NULL.  Frames evaluated
+ * one by one, e.g. when downsampling, are always evaluated by the scorer.
+ */
+void ptm_mgau_set_block_eval(ps_mgau_t *s, ptm_mgau_block_eval_t eval,
+                             void *udata);
 
 
 #endif /*  __PTM_MGAU_H__ */
@@ -64,7 +64,8 @@ static ps_mgaufuncs_t s2_semi_mgau_funcs = {
     "s2_semi",
     s2_semi_mgau_frame_eval,      /* frame_eval */
     s2_semi_mgau_mllr_transform,  /* transform */
-    s2_semi_mgau_free             /* free */
+    s2_semi_mgau_free,            /* free */
+    NULL                          /* compact */
 };
 
 struct vqFeature_s {
@@ -93,6 +94,9 @@ eval_topn(s2_semi_mgau_t *s, int32 feat, mfcc_t *z)
         var = s->g->var[0][feat][0] + cw * ceplen;
         d = s->g->det[0][feat][cw];
         obs = z;
+#ifdef TIED_MGAU_SIMD128
+        d = GMMSUB(d, gmm_dist(obs, mean, var, ceplen));
+#else
         for (j = 0; j < ceplen; j++) {
             diff = *obs++ - *mean++;
             sqdiff = MFCCMUL(diff, diff);
@@ -100,6 +104,7 @@ eval_topn(s2_semi_mgau_t *s, int32 feat, mfcc_t *z)
             d = GMMSUB(d, compl);
             ++var;
         }
+#endif
         topn[i].score = (int32)d;
         if (i == 0)
             continue;
@@ -137,7 +142,18 @@ eval_cb(s2_semi_mgau_t *s, int32 feat, mfcc_t *z)
         d = *detP;
         obs = z;
         cw = (int)(detP - det);
-        for (j = 0; (j < ceplen) && (d >= worst->score); ++j) {
+        j = 0;
+#ifdef TIED_MGAU_SIMD128
+        /* Four dimensions per vector, pruning after each block; the
+         * remaining dimensions are done below. */
+        for (; (j + 4 <= ceplen) && (d >= worst->score); j += 4) {
+            d = GMMSUB(d, gmm_sum4(gmm_compl4(obs, mean, var)));
+            obs += 4;
+            mean += 4;
+            var += 4;
+        }
+#endif
+        for (; (j < ceplen) && (d >= worst->score); ++j) {
             diff = *obs++ - *mean++;
             sqdiff = MFCCMUL(diff, diff);
             compl = MFCCMUL(sqdiff, *var);
@@ -174,7 +190,7 @@ mgau_dist(s2_semi_mgau_t * s, int32 frame, int32 feat, mfcc_t * z)
     eval_topn(s, feat, z);
 
     /* If this frame is skipped, do nothing else. */
-    if (frame % s->ds_ratio)
+    if (frame % ps_mgau_base(s)->ds_ratio)
         return;
 
     /* Evaluate the rest of the codebook (or subset thereof). */
@@ -1288,7 +1304,7 @@ s2_semi_mgau_init(acmod_t *acmod)
             goto error_out;
         }
     }
-    s->ds_ratio = cmd_ln_int32_r(s->config, "-ds");
+    ps_mgau_base(s)->ds_ratio = cmd_ln_int32_r(s->config, "-ds");
 
     /* Determine top-N for each feature */
     s->topn_beam = ckd_calloc(n_feat, sizeof(*s->topn_beam));
@@ -69,7 +69,6 @@ struct s2_semi_mgau_s {
     int32 n_sen;	/* Number of senones */
     uint8 *topn_beam;   /* Beam for determining per-frame top-N densities */
     int16 max_topn;
-    int16 ds_ratio;
 
     vqFeature_t ***topn_hist; /**< Top-N scores and codewords for past frames. */
     uint8 **topn_hist_n;      /**< Variable top-N for past frames. */
@@ -125,11 +125,10 @@ phone_transition(state_align_search_t *sas, int frame_idx)
 static void
 extend_tokenstack(state_align_search_t *sas, int frame_idx)
 {
-    if (frame_idx >= sas->n_fr_alloc) {
-        sas->n_fr_alloc = frame_idx + TOKEN_STEP + 1;
+    if ((frame_idx + 1) * sas->n_emit_state > sas->n_tok_alloc) {
+        sas->n_tok_alloc = (frame_idx + TOKEN_STEP + 1) * sas->n_emit_state;
         sas->tokens = ckd_realloc(sas->tokens,
-                                  sas->n_emit_state * sas->n_fr_alloc
-                                  * sizeof(*sas->tokens));
+                                  sas->n_tok_alloc * sizeof(*sas->tokens));
     }
     memset(sas->tokens + frame_idx * sas->n_emit_state, 0xff,
            sas->n_emit_state * sizeof(*sas->tokens));
@@ -287,8 +286,6 @@ state_align_search_init(const char *name,
                         ps_alignment_t *al)
 {
     state_align_search_t *sas;
-    ps_alignment_iter_t *itor;
-    hmm_t *hmm;
 
     sas = ckd_calloc(1, sizeof(*sas));
     ps_search_init(ps_search_base(sas), &state_align_search_funcs,
@@ -302,15 +299,33 @@ state_align_search_init(const char *name,
     }
     sas->al = al;
 
+    state_align_search_reset(ps_search_base(sas));
+    return ps_search_base(sas);
+}
+
+int
+state_align_search_reset(ps_search_t *search)
+{
+    state_align_search_t *sas = (state_align_search_t *)search;
+    ps_alignment_t *al = sas->al;
+    ps_alignment_iter_t *itor;
+    hmm_t *hmm;
+
     /* Generate HMM vector from phone level of alignment. */
     sas->n_phones = ps_alignment_n_phones(al);
     sas->n_emit_state = ps_alignment_n_states(al);
-    sas->hmms = ckd_calloc(sas->n_phones, sizeof(*sas->hmms));
+    if (sas->n_phones > sas->n_hmm_alloc) {
+        ckd_free(sas->hmms);
+        sas->hmms = ckd_calloc(sas->n_phones, sizeof(*sas->hmms));
+        sas->n_hmm_alloc = sas->n_phones;
+    }
     for (hmm = sas->hmms, itor = ps_alignment_phones(al); itor;
          ++hmm, itor = ps_alignment_iter_next(itor)) {
         ps_alignment_entry_t *ent = ps_alignment_iter_get(itor);
         hmm_init(sas->hmmctx, hmm, FALSE,
                  ent->id.pid.ssid, ent->id.pid.tmatid);
     }
-    return ps_search_base(sas);
+    sas->frame = 0;
+    sas->best_score = 0;
+    return 0;
 }
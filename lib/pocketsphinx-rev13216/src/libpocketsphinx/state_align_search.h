@@ -69,13 +69,14 @@ struct state_align_search_s {
     ps_alignment_t *al;     /**< Alignment structure being operated on. */
     hmm_t *hmms;            /**< Vector of HMMs corresponding to phone level. */
     int n_phones;	    /**< Number of HMMs (phones). */
+    int n_hmm_alloc;        /**< Number of HMMs allocated. */
 
     int frame;              /**< Current frame being processed. */
     int32 best_score;       /**< Best score in current frame. */
 
     int n_emit_state;       /**< Number of emitting states (tokens per frame) */
     state_align_hist_t *tokens;         /**< Tokens (backpointers) for state alignment. */
-    int n_fr_alloc;         /**< Number of frames of tokens allocated. */
+    int n_tok_alloc;        /**< Number of tokens allocated, for any number of states. */
 };
 typedef struct state_align_search_s state_align_search_t;
 
@@ -84,4 +85,12 @@ ps_search_t *state_align_search_init(const char *name,
                                      acmod_t *acmod,
                                      ps_alignment_t *al);
 
+/**
+ * Prepare a state alignment search for its alignment's current phones,
+ * after the alignment has been reset and populated again.  The HMM vector
+ * and the token stack only grow, so aligning many utterances with one
+ * search allocates for the longest of them.
+ */
+int state_align_search_reset(ps_search_t *search);
+
 #endif /* __STATE_ALIGN_SEARCH_H__ */
@@ -118,4 +118,52 @@ fast_logmath_add(logmath_t *lmath, int mlx, int mly)
     return r - (((uint8 *)t->table)[d]);
 }
 
+#if defined(__wasm_simd128__) && !defined(FIXED_POINT)
+/* WebAssembly SIMD128 kernels for Gaussian evaluation.  mfcc_t is
+ * float32 in floating-point builds, so four dimensions fit a vector. */
+#include <wasm_simd128.h>
+#define TIED_MGAU_SIMD128
+
+/**
+ * Component likelihoods (obs - mean)^2 * var of four consecutive
+ * dimensions.  The pointers need not be aligned.
+ */
+static inline v128_t
+gmm_compl4(const float32 *obs, const float32 *mean, const float32 *var)
+{
+    v128_t diff = wasm_f32x4_sub(wasm_v128_load(obs), wasm_v128_load(mean));
+    return wasm_f32x4_mul(wasm_f32x4_mul(diff, diff), wasm_v128_load(var));
+}
+
+/** Horizontal sum of the four lanes of a vector. */
+static inline float32
+gmm_sum4(v128_t v)
+{
+    v = wasm_f32x4_add(v, wasm_i32x4_shuffle(v, v, 2, 3, 0, 1));
+    v = wasm_f32x4_add(v, wasm_i32x4_shuffle(v, v, 1, 0, 3, 2));
+    return wasm_f32x4_extract_lane(v, 0);
+}
+
+/**
+ * Sum of the component likelihoods of n dimensions, i.e. the
+ * Mahalanobis distance scaled by the (inverted) variances.
+ */
+static inline float32
+gmm_dist(const float32 *obs, const float32 *mean, const float32 *var, int n)
+{
+    v128_t sum = wasm_f32x4_splat(0.0f);
+    float32 d, diff;
+    int j;
+
+    for (j = 0; j + 4 <= n; j += 4)
+        sum = wasm_f32x4_add(sum, gmm_compl4(obs + j, mean + j, var + j));
+    d = gmm_sum4(sum);
+    for (; j < n; ++j) {
+        diff = obs[j] - mean[j];
+        d += diff * diff * var[j];
+    }
+    return d;
+}
+#endif
+
 #endif /* __TIED_MGAU_COMMON_H__ */
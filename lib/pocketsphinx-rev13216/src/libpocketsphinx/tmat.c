@@ -105,6 +105,7 @@
 #include "tmat.h"
 #include "hmm.h"
 #include "vector.h"
+#include "ps_refcount.h"
 
 #define TMAT_PARAM_VERSION		"1.0"
 
@@ -207,6 +208,7 @@ tmat_init(char const *file_name, logmath_t *lmath, float64 tpfloor, int32 brepor
     }
 
     t = (tmat_t *) ckd_calloc(1, sizeof(tmat_t));
+    t->refcnt = 1;
 
     if ((fp = fopen(file_name, "rb")) == NULL)
         E_FATAL_SYSTEM("Failed to open transition file '%s' for reading", file_name);
@@ -325,13 +327,20 @@ tmat_report(tmat_t * t)
 
 }
 
+tmat_t *
+tmat_retain(tmat_t * t)
+{
+    ps_refcount_inc(&t->refcnt);
+    return t;
+}
+
 /* 
  *  RAH, Free memory allocated in tmat_init ()
  */
 void
 tmat_free(tmat_t * t)
 {
-    if (t) {
+    if (t && ps_refcount_dec(&t->refcnt) == 0) {
         if (t->tp)
             ckd_free_3d(t->tp);
         ckd_free(t);
@@ -104,6 +104,7 @@ extern "C" {
  * topology.
  */
 typedef struct {
+    int refcnt;         /**< Reference count, as acoustic models may share the matrices. */
     uint8 ***tp;	/**< The transition matrices; kept in the same scale as acoustic scores;
 			   tp[tmatid][from-state][to-state] */
     int16 n_tmat;	/**< Number matrices */
@@ -129,8 +130,15 @@ void tmat_dump (tmat_t *tmat,  /**< In: transition matrix */
     );	
 
 
+/**
+ * Retain a transition matrix.
+ */
+tmat_t *tmat_retain(tmat_t *t /**< In: transition matrix */
+    );
+
 /**
  * RAH, add code to remove memory allocated by tmat_init
+ * (once the last reference is released).
  */
 
 void tmat_free (tmat_t *t /**< In: transition matrix */
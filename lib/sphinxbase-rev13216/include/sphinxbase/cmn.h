@@ -131,6 +131,10 @@ typedef struct {
     mfcc_t *sum;        /**< The sum of the cmn frames */
     int32 nframe;	/**< Number of frames */
     int32 veclen;	/**< Length of cepstral vector */
+    mfcc_t *prior;      /**< Batch CMN: mean of earlier speech, blended into each utterance's mean */
+    int32 prior_nframe; /**< Batch CMN: number of frames prior weighs as; 0 to ignore it */
+    mfcc_t *utt_sum;    /**< Batch CMN: sum of the non-silent frames of the last utterance */
+    int32 utt_nframe;   /**< Batch CMN: number of frames in utt_sum */
 } cmn_t;
 
 SPHINXBASE_EXPORT
@@ -138,6 +142,9 @@ cmn_t* cmn_init(int32 veclen);
 
 /**
  * CMN for the whole sentence
+ * If prior_nframe is positive, the mean is estimated as if the utterance were preceded by that
+ * many frames of mean prior, so that short utterances get a stable mean. The utterance's own
+ * statistics are left in utt_sum and utt_nframe.
 */
 SPHINXBASE_EXPORT
 void cmn (cmn_t *cmn,   /**< In/Out: cmn normalization, which contains the cmn_mean and cmn_var) */
@@ -76,6 +76,15 @@ listelem_alloc_t * listelem_alloc_init(size_t elemsize);
 SPHINXBASE_EXPORT
 void listelem_alloc_free(listelem_alloc_t *le);
 
+/**
+ * Return all elements to the free list at once, zeroed like those of
+ * new blocks, keeping the allocated blocks.  Elements allocated before
+ * are invalid afterwards.  Lets a structure that is rebuilt over and
+ * over reuse its memory without freeing its elements one by one.
+ */
+SPHINXBASE_EXPORT
+void listelem_alloc_reset(listelem_alloc_t *le);
+
 
 SPHINXBASE_EXPORT
 void *__listelem_malloc__(listelem_alloc_t *le, char *file, int line);
@@ -658,6 +658,27 @@ ngram_model_t *ngram_model_set_remove(ngram_model_t *set,
                                       const char *name,
                                       int reuse_widmap);
 
+/**
+ * Precompute the interpolated scores of some N-Grams of a set.
+ *
+ * While the set interpolates, scoring one of these N-Grams looks its
+ * score up in a table instead of querying every submodel.  This suits
+ * the few N-Grams a search scores over and over, e.g. those of an
+ * expected transcript.  The scores follow later changes of the weights,
+ * and the table is dropped when the set's word IDs change.
+ *
+ * @param set The language model set.
+ * @param ngrams The N-Grams, N word IDs each: the word, then its history
+ *               from the most recent word on, as ngram_ng_score() takes
+ *               them.  Missing history words are NGRAM_INVALID_WID.
+ * @param n_ngrams Number of N-Grams in <code>ngrams</code>.
+ * @return the number of distinct N-Grams precomputed.
+ */
+SPHINXBASE_EXPORT
+int32 ngram_model_set_precompute(ngram_model_t *set,
+                                 const int32 *ngrams,
+                                 int32 n_ngrams);
+
 /**
  * Set the word-to-ID mapping for this model set.
  */
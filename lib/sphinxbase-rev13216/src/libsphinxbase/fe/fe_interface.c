@@ -252,9 +252,6 @@ fe_init_auto_r(cmd_ln_t *config)
         return NULL;
     }
 
-    if (fe->dither)
-        fe_init_dither(fe->dither_seed);
-
     /* establish buffers for overflow samps and hamming window */
     fe->overflow_samps = ckd_calloc(fe->frame_size, sizeof(int16));
     fe->hamming_window = ckd_calloc(fe->frame_size/2, sizeof(window_t));
@@ -340,6 +337,7 @@ fe_start_utt(fe_t * fe)
     fe->num_overflow_samps = 0;
     memset(fe->overflow_samps, 0, fe->frame_size * sizeof(int16));
     fe->pre_emphasis_prior = 0;
+    fe->dither_state = (uint32) fe->dither_seed;
     fe_reset_vad_data(fe->vad_data);
     return 0;
 }
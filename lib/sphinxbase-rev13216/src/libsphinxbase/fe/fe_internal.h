@@ -140,6 +140,9 @@ struct fe_s {
     float32 pre_emphasis_alpha;
     int16 pre_emphasis_prior;
     int32 dither_seed;
+    /* Dither noise is drawn from this front end's own generator, restarted with
+     * every utterance, so that it doesn't depend on other decoders or threads. */
+    uint32 dither_state;
 
     int16 num_overflow_samps;    
     size_t num_processed_samps;
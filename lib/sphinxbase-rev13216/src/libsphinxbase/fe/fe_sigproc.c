@@ -61,11 +61,11 @@
 #include "sphinxbase/byteorder.h"
 #include "sphinxbase/fixpoint.h"
 #include "sphinxbase/fe.h"
-#include "sphinxbase/genrand.h"
 #include "sphinxbase/err.h"
 
 #include "fe_internal.h"
 #include "fe_warp.h"
+#include "fe_simd.h"
 
 /* Use extra precision for cosines, Hamming window, pre-emphasis
  * coefficient, twiddle factors. */
@@ -818,6 +818,14 @@ fe_spch_to_frame(fe_t * fe, int len)
     return len;
 }
 
+/* Linear congruential step; its top two bits are zero a quarter of the time. */
+static int16
+fe_dither_bit(fe_t * fe)
+{
+    fe->dither_state = fe->dither_state * 1664525u + 1013904223u;
+    return (fe->dither_state >> 30) == 0;
+}
+
 int
 fe_read_frame(fe_t * fe, int16 const *in, int32 len)
 {
@@ -834,7 +842,7 @@ fe_read_frame(fe_t * fe, int16 const *in, int32 len)
             SWAP_INT16(&fe->spch[i]);
     if (fe->dither)
         for (i = 0; i < len; ++i)
-            fe->spch[i] += (int16) ((!(s3_rand_int31() % 4)) ? 1 : 0);
+            fe->spch[i] += fe_dither_bit(fe);
 
     return fe_spch_to_frame(fe, len);
 }
@@ -859,7 +867,7 @@ fe_shift_frame(fe_t * fe, int16 const *in, int32 len)
     if (fe->dither)
         for (i = 0; i < len; ++i)
             fe->spch[offset + i]
-                += (int16) ((!(s3_rand_int31() % 4)) ? 1 : 0);
+                += fe_dither_bit(fe);
 
     return fe_spch_to_frame(fe, offset + len);
 }
@@ -950,7 +958,39 @@ fe_fft_real(fe_t * fe)
             /* Butterflies with complex twiddle factors.
              * There are (1<<k-1) of them.
              */
-            for (j = 1; j < (1 << n4); ++j) {
+            j = 1;
+#ifdef FE_SIMD
+            /* Two butterflies (j, j+1) at a time.  i2 and i4 run
+             * backwards, so their pairs are loaded and stored
+             * reversed.  The butterflies don't overlap. */
+            for (; j + 1 < (1 << n4); j += 2) {
+                fe_vec2_t cc, ss, t1, t2, x1, x2, x3, x4;
+                int i1, i2, i3, i4;
+
+                i1 = i + j;
+                i2 = i + (1 << n2) - j - 1;
+                i3 = i + (1 << n2) + j;
+                i4 = i + (1 << n2) + (1 << n2) - j - 1;
+
+                cc = fe_vec2_make(fe->ccc[j << (m - n1)],
+                                  fe->ccc[(j + 1) << (m - n1)]);
+                ss = fe_vec2_make(fe->sss[j << (m - n1)],
+                                  fe->sss[(j + 1) << (m - n1)]);
+                x1 = fe_vec2_load(x + i1);
+                x2 = fe_vec2_reverse(fe_vec2_load(x + i2));
+                x3 = fe_vec2_load(x + i3);
+                x4 = fe_vec2_reverse(fe_vec2_load(x + i4));
+
+                t1 = fe_vec2_add(fe_vec2_mul(x3, cc), fe_vec2_mul(x4, ss));
+                t2 = fe_vec2_sub(fe_vec2_mul(x3, ss), fe_vec2_mul(x4, cc));
+
+                fe_vec2_store(x + i4, fe_vec2_reverse(fe_vec2_sub(x2, t2)));
+                fe_vec2_store(x + i3, fe_vec2_sub(fe_vec2_neg(x2), t2));
+                fe_vec2_store(x + i2, fe_vec2_reverse(fe_vec2_sub(x1, t1)));
+                fe_vec2_store(x + i1, fe_vec2_add(x1, t1));
+            }
+#endif
+            for (; j < (1 << n4); ++j) {
                 frame_t cc, ss, t1, t2;
                 int i1, i2, i3, i4;
 
@@ -1011,7 +1051,17 @@ fe_spec_magnitude(fe_t * fe)
 #endif
     }
 
-    for (j = 1; j <= fftsize / 2; j++) {
+    j = 1;
+#ifdef FE_SIMD
+    for (; j + 1 <= fftsize / 2; j += 2) {
+        fe_vec2_t re, im;
+        re = fe_vec2_load(fft + j);
+        im = fe_vec2_reverse(fe_vec2_load(fft + fftsize - j - 1));
+        fe_vec2_store(spec + j, fe_vec2_add(fe_vec2_mul(re, re),
+                                            fe_vec2_mul(im, im)));
+    }
+#endif
+    for (; j <= fftsize / 2; j++) {
 #if defined(FIXED_POINT)
         int32 rr = FIXLN(abs(fft[j]) << scale) * 2;
         int32 ii = FIXLN(abs(fft[fftsize - j]) << scale) * 2;
@@ -1046,6 +1096,22 @@ fe_mel_spec(fe_t * fe)
                                            fe->mel_fb->
                                            filt_coeffs[filt_start + i]);
         }
+#elif defined(FE_SIMD)
+        /* Two partial sums, so this differs from the scalar code by
+         * rounding only. */
+        {
+            fe_vec2_t sum = fe_vec2_splat(0);
+            int32 width = fe->mel_fb->filt_width[whichfilt];
+            for (i = 0; i + 1 < width; i += 2)
+                sum = fe_vec2_add(sum,
+                                  fe_vec2_mul(fe_vec2_load(spec + spec_start + i),
+                                              fe_vec2_load_f32(fe->mel_fb->filt_coeffs
+                                                               + filt_start + i)));
+            mfspec[whichfilt] = fe_vec2_lane0(sum) + fe_vec2_lane1(sum);
+            if (i < width)
+                mfspec[whichfilt] +=
+                    spec[spec_start + i] * fe->mel_fb->filt_coeffs[filt_start + i];
+        }
 #else                           /* !FIXED_POINT */
         mfspec[whichfilt] = 0;
         for (i = 0; i < fe->mel_fb->filt_width[whichfilt]; i++)
@@ -1143,7 +1209,25 @@ fe_dct2(fe_t * fe, const powspec_t * mflogspec, mfcc_t * mfcep, int htk)
     else                        /* sqrt(1/N) = sqrt(2/N) * 1/sqrt(2) */
         mfcep[0] = COSMUL(mfcep[0], fe->mel_fb->sqrt_inv_n);
 
-    for (i = 1; i < fe->num_cepstra; ++i) {
+    i = 1;
+#ifdef FE_SIMD
+    /* Two cepstra at a time, summing in the same order as below.
+     * mfcep is float32, so the sums are rounded to it after each
+     * addition as well. */
+    for (; i + 1 < fe->num_cepstra; i += 2) {
+        fe_vec2_t sum = fe_vec2_splat(0);
+        for (j = 0; j < fe->mel_fb->num_filters; j++) {
+            sum = fe_vec2_round_f32(
+                fe_vec2_add(sum,
+                            fe_vec2_mul(fe_vec2_splat(mflogspec[j]),
+                                        fe_vec2_make(fe->mel_fb->mel_cosine[i][j],
+                                                     fe->mel_fb->mel_cosine[i + 1][j]))));
+        }
+        mfcep[i] = COSMUL((mfcc_t) fe_vec2_lane0(sum), fe->mel_fb->sqrt_inv_2n);
+        mfcep[i + 1] = COSMUL((mfcc_t) fe_vec2_lane1(sum), fe->mel_fb->sqrt_inv_2n);
+    }
+#endif
+    for (; i < fe->num_cepstra; ++i) {
         mfcep[i] = 0;
         for (j = 0; j < fe->mel_fb->num_filters; j++) {
             mfcep[i] += COSMUL(mflogspec[j], fe->mel_fb->mel_cosine[i][j]);
@@ -0,0 +1,77 @@
+/* -*- c-basic-offset: 4; indent-tabs-mode: nil -*- */
+/**
+ * @file fe_simd.h
+ * @brief Two-lane float64 vectors for the front end's inner loops.
+ *
+ * Maps a handful of operations onto WebAssembly SIMD128, SSE2 or
+ * AArch64 NEON.  fe_vec2_load_f32() widens two float32 values, and
+ * fe_vec2_round_f32() rounds both lanes to float32 precision.  FE_SIMD is defined if one of them is available in a
+ * floating-point build; otherwise the scalar code is used.  Every lane
+ * does exactly the arithmetic of the scalar code, in the same order,
+ * unless noted otherwise where the kernels are used.
+ */
+#ifndef FE_SIMD_H
+#define FE_SIMD_H
+
+#include "fe_type.h"
+
+#if !defined(FIXED_POINT)
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define FE_SIMD
+typedef v128_t fe_vec2_t;
+#define fe_vec2_load(p)         wasm_v128_load(p)
+#define fe_vec2_load_f32(p)     wasm_f64x2_promote_low_f32x4(wasm_v128_load64_zero(p))
+#define fe_vec2_store(p, v)     wasm_v128_store(p, v)
+#define fe_vec2_splat(a)        wasm_f64x2_splat(a)
+#define fe_vec2_make(a, b)      wasm_f64x2_make(a, b)
+#define fe_vec2_add(a, b)       wasm_f64x2_add(a, b)
+#define fe_vec2_sub(a, b)       wasm_f64x2_sub(a, b)
+#define fe_vec2_mul(a, b)       wasm_f64x2_mul(a, b)
+#define fe_vec2_neg(a)          wasm_f64x2_neg(a)
+#define fe_vec2_reverse(a)      wasm_i64x2_shuffle(a, a, 1, 0)
+#define fe_vec2_round_f32(a)    wasm_f64x2_promote_low_f32x4(wasm_f32x4_demote_f64x2_zero(a))
+#define fe_vec2_lane0(a)        wasm_f64x2_extract_lane(a, 0)
+#define fe_vec2_lane1(a)        wasm_f64x2_extract_lane(a, 1)
+
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FE_SIMD
+typedef __m128d fe_vec2_t;
+#define fe_vec2_load(p)         _mm_loadu_pd(p)
+#define fe_vec2_load_f32(p)     _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((__m128i const *)(p))))
+#define fe_vec2_store(p, v)     _mm_storeu_pd(p, v)
+#define fe_vec2_splat(a)        _mm_set1_pd(a)
+#define fe_vec2_make(a, b)      _mm_set_pd(b, a)
+#define fe_vec2_add(a, b)       _mm_add_pd(a, b)
+#define fe_vec2_sub(a, b)       _mm_sub_pd(a, b)
+#define fe_vec2_mul(a, b)       _mm_mul_pd(a, b)
+#define fe_vec2_neg(a)          _mm_xor_pd(a, _mm_set1_pd(-0.0))
+#define fe_vec2_reverse(a)      _mm_shuffle_pd(a, a, 1)
+#define fe_vec2_round_f32(a)    _mm_cvtps_pd(_mm_cvtpd_ps(a))
+#define fe_vec2_lane0(a)        _mm_cvtsd_f64(a)
+#define fe_vec2_lane1(a)        _mm_cvtsd_f64(_mm_unpackhi_pd(a, a))
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define FE_SIMD
+typedef float64x2_t fe_vec2_t;
+#define fe_vec2_load(p)         vld1q_f64(p)
+#define fe_vec2_load_f32(p)     vcvt_f64_f32(vld1_f32(p))
+#define fe_vec2_store(p, v)     vst1q_f64(p, v)
+#define fe_vec2_splat(a)        vdupq_n_f64(a)
+#define fe_vec2_make(a, b)      vcombine_f64(vdup_n_f64(a), vdup_n_f64(b))
+#define fe_vec2_add(a, b)       vaddq_f64(a, b)
+#define fe_vec2_sub(a, b)       vsubq_f64(a, b)
+#define fe_vec2_mul(a, b)       vmulq_f64(a, b)
+#define fe_vec2_neg(a)          vnegq_f64(a)
+#define fe_vec2_reverse(a)      vextq_f64(a, a, 1)
+#define fe_vec2_round_f32(a)    vcvt_f64_f32(vcvt_f32_f64(a))
+#define fe_vec2_lane0(a)        vgetq_lane_f64(a, 0)
+#define fe_vec2_lane1(a)        vgetq_lane_f64(a, 1)
+#endif
+
+#endif /* !FIXED_POINT */
+
+#endif /* FE_SIMD_H */
@@ -90,6 +90,8 @@ cmn_init(int32 veclen)
     cmn->cmn_mean = (mfcc_t *) ckd_calloc(veclen, sizeof(mfcc_t));
     cmn->cmn_var = (mfcc_t *) ckd_calloc(veclen, sizeof(mfcc_t));
     cmn->sum = (mfcc_t *) ckd_calloc(veclen, sizeof(mfcc_t));
+    cmn->prior = (mfcc_t *) ckd_calloc(veclen, sizeof(mfcc_t));
+    cmn->utt_sum = (mfcc_t *) ckd_calloc(veclen, sizeof(mfcc_t));
     /* A front-end dependent magic number */
     cmn->cmn_mean[0] = FLOAT2MFCC(12.0);
     cmn->nframe = 0;
@@ -131,6 +133,14 @@ cmn(cmn_t *cmn, mfcc_t ** mfc, int32 varnorm, int32 n_frame)
         n_pos_frame++;
     }
 
+    memcpy(cmn->utt_sum, cmn->cmn_mean, cmn->veclen * sizeof(mfcc_t));
+    cmn->utt_nframe = n_pos_frame;
+    if (cmn->prior_nframe > 0) {
+        for (i = 0; i < cmn->veclen; i++)
+            cmn->cmn_mean[i] += cmn->prior[i] * cmn->prior_nframe;
+        n_pos_frame += cmn->prior_nframe;
+    }
+
     for (i = 0; i < cmn->veclen; i++)
         cmn->cmn_mean[i] /= n_pos_frame;
 
@@ -187,6 +197,12 @@ cmn_free(cmn_t * cmn)
         if (cmn->sum)
             ckd_free((void *) cmn->sum);
 
+        if (cmn->prior)
+            ckd_free((void *) cmn->prior);
+
+        if (cmn->utt_sum)
+            ckd_free((void *) cmn->utt_sum);
+
         ckd_free((void *) cmn);
     }
 }
@@ -47,7 +47,37 @@
 #include "lm_trie.h"
 #include "lm_trie_quant.h"
 
-static void lm_trie_alloc_ngram(lm_trie_t * trie, uint32 * counts, int order);
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define LM_TRIE_THREAD_LOCAL __declspec(thread)
+#define lm_trie_next_serial() ((uint32) _InterlockedIncrement(&lm_trie_serial_counter))
+static volatile long lm_trie_serial_counter = 0;
+/* Volatile accesses have acquire and release semantics with MSVC */
+#define lm_trie_page_loaded(pages, page) (((volatile uint8 *) (pages)->loaded)[page])
+#define lm_trie_mark_page_loaded(pages, page) (((volatile uint8 *) (pages)->loaded)[page] = 1)
+#else
+#define LM_TRIE_THREAD_LOCAL __thread
+#define lm_trie_next_serial() ((uint32) __sync_add_and_fetch(&lm_trie_serial_counter, 1))
+static volatile uint32 lm_trie_serial_counter = 0;
+#define lm_trie_page_loaded(pages, page) __atomic_load_n(&(pages)->loaded[page], __ATOMIC_ACQUIRE)
+#define lm_trie_mark_page_loaded(pages, page) __atomic_store_n(&(pages)->loaded[page], 1, __ATOMIC_RELEASE)
+#endif
+
+/*
+ * Backoff weights of the most recently scored history.
+ * The cache is kept per thread rather than per trie, so that scoring doesn't write to
+ * the trie and a single trie can be shared between decoders running on different threads.
+ */
+typedef struct backoff_cache_s {
+    uint32 serial;   /* Serial of the trie the cache was filled from, 0 if empty */
+    float backoff[NGRAM_MAX_ORDER];
+    uint32 hist[NGRAM_MAX_ORDER - 1];
+} backoff_cache_t;
+
+static LM_TRIE_THREAD_LOCAL backoff_cache_t backoff_cache;
+
+static void lm_trie_alloc_ngram(lm_trie_t * trie, uint32 * counts, int order,
+                                uint8 * ngram_mem);
 
 static uint32
 base_size(uint32 entries, uint32 max_vocab, uint8 remaining_bits)
@@ -356,8 +386,7 @@ lm_trie_init(uint32 unigram_count)
     lm_trie_t *trie;
 
     trie = (lm_trie_t *) ckd_calloc(1, sizeof(*trie));
-    memset(trie->hist_cache, -1, sizeof(trie->hist_cache)); /* prepare request history */
-    memset(trie->backoff_cache, 0, sizeof(trie->backoff_cache));
+    trie->serial = lm_trie_next_serial();
     trie->unigrams =
         (unigram_t *) ckd_calloc((unigram_count + 1),
                                  sizeof(*trie->unigrams));
@@ -375,18 +404,135 @@ lm_trie_create(uint32 unigram_count, int order)
 }
 
 lm_trie_t *
-lm_trie_read_bin(uint32 * counts, int order, FILE * fp)
+lm_trie_read_bin(uint32 * counts, int order, FILE * fp,
+                 mmio_file_t * filemap)
 {
     lm_trie_t *trie = lm_trie_init(counts[0]);
     trie->quant = (order > 1) ? lm_trie_quant_read_bin(fp, order) : NULL;
     fread(trie->unigrams, sizeof(*trie->unigrams), (counts[0] + 1), fp);
     if (order > 1) {
-        lm_trie_alloc_ngram(trie, counts, order);
-        fread(trie->ngram_mem, 1, trie->ngram_mem_size, fp);
+        if (filemap) {
+            /* Use the n-gram arrays in place instead of copying them */
+            uint8 *file_mem = (uint8 *) mmio_file_ptr(filemap);
+            lm_trie_alloc_ngram(trie, counts, order, file_mem + ftell(fp));
+            fseek(fp, (long) trie->ngram_mem_size, SEEK_CUR);
+            trie->filemap = filemap;
+        }
+        else {
+            lm_trie_alloc_ngram(trie, counts, order, NULL);
+            fread(trie->ngram_mem, 1, trie->ngram_mem_size, fp);
+        }
+    }
+    else if (filemap) {
+        mmio_file_unmap(filemap);
     }
     return trie;
 }
 
+lm_trie_t *
+lm_trie_read_bin_paged(uint32 * counts, int order, FILE * fp,
+                       lm_trie_pages_t * pages)
+{
+    lm_trie_t *trie;
+    middle_t *middle_ptr;
+
+    if (order < 2 || pages->size != lm_trie_ngram_mem_size(counts, order)) {
+        E_ERROR("Pages of %lu bytes don't hold the n-grams of the LM\n",
+                (unsigned long) pages->size);
+        return NULL;
+    }
+    trie = lm_trie_init(counts[0]);
+    trie->quant = lm_trie_quant_read_bin(fp, order);
+    fread(trie->unigrams, sizeof(*trie->unigrams), (counts[0] + 1), fp);
+    lm_trie_alloc_ngram(trie, counts, order, pages->mem);
+    trie->pages = pages;
+    for (middle_ptr = trie->middle_begin; middle_ptr != trie->middle_end;
+         ++middle_ptr)
+        middle_ptr->base.pages = pages;
+    trie->longest->base.pages = pages;
+    return trie;
+}
+
+lm_trie_pages_t *
+lm_trie_pages_create(size_t size, uint8 page_bits)
+{
+    lm_trie_pages_t *pages =
+        (lm_trie_pages_t *) ckd_calloc(1, sizeof(*pages));
+    pages->mem = (uint8 *) ckd_calloc(size, sizeof(*pages->mem));
+    pages->size = size;
+    pages->page_bits = page_bits;
+    pages->n_pages = (uint32) ((size + ((size_t) 1 << page_bits) - 1)
+                               >> page_bits);
+    pages->loaded = (uint8 *) ckd_calloc(pages->n_pages, 1);
+    pages->wanted = (uint8 *) ckd_calloc(pages->n_pages, 1);
+    return pages;
+}
+
+void
+lm_trie_pages_free(lm_trie_pages_t * pages)
+{
+    if (pages == NULL)
+        return;
+    ckd_free(pages->mem);
+    ckd_free(pages->loaded);
+    ckd_free(pages->wanted);
+    ckd_free(pages);
+}
+
+void
+lm_trie_pages_set_loaded(lm_trie_pages_t * pages, uint32 page)
+{
+    if (page < pages->n_pages)
+        lm_trie_mark_page_loaded(pages, page);
+}
+
+int32
+lm_trie_pages_next(lm_trie_pages_t * pages)
+{
+    int32 missing = -1;
+    uint32 i;
+
+    for (i = 0; i < pages->n_pages; ++i) {
+        if (lm_trie_page_loaded(pages, i))
+            continue;
+        if (pages->wanted[i])
+            return (int32) i;
+        if (missing < 0)
+            missing = (int32) i;
+    }
+    return missing;
+}
+
+/*
+ * Whether the entries of a range, and the entry after it, whose next pointer ends the range,
+ * have arrived. Flags the missing pages as wanted; the flags are only ever set, so lookups on
+ * other threads setting them too is harmless.
+ */
+static int
+base_range_loaded(base_t * base, node_range_t * range)
+{
+    lm_trie_pages_t *pages = base->pages;
+    size_t offset = (size_t) (base->base - pages->mem);
+    size_t first = offset + (((size_t) range->begin * base->total_bits) >> 3);
+    /* Reads of a bit-packed entry may take up to 8 bytes past it */
+    size_t last = offset + (((size_t) (range->end + 1) * base->total_bits) >> 3)
+        + sizeof(uint64);
+    uint32 page, last_page;
+    int loaded = TRUE;
+
+    last_page = (uint32) (last >> pages->page_bits);
+    if (last_page >= pages->n_pages)
+        last_page = pages->n_pages - 1;
+    for (page = (uint32) (first >> pages->page_bits); page <= last_page;
+         ++page) {
+        if (!lm_trie_page_loaded(pages, page)) {
+            pages->wanted[page] = 1;
+            loaded = FALSE;
+        }
+    }
+    return loaded;
+}
+
 void
 lm_trie_write_bin(lm_trie_t * trie, uint32 unigram_count, FILE * fp)
 {
@@ -402,34 +548,49 @@ lm_trie_write_bin(lm_trie_t * trie, uint32 unigram_count, FILE * fp)
 void
 lm_trie_free(lm_trie_t * trie)
 {
+    if (trie == NULL)
+        return;
     if (trie->ngram_mem) {
-        ckd_free(trie->ngram_mem);
+        if (trie->filemap)
+            mmio_file_unmap(trie->filemap);
+        else if (!trie->pages)
+            ckd_free(trie->ngram_mem);
         ckd_free(trie->middle_begin);
         ckd_free(trie->longest);
     }
     if (trie->quant)
         lm_trie_quant_free(trie->quant);
     ckd_free(trie->unigrams);
+    lm_trie_flush_cache(trie);
     ckd_free(trie);
 }
 
+size_t
+lm_trie_ngram_mem_size(uint32 * counts, int order)
+{
+    size_t size = 0;
+    int i;
+
+    /* The quantized sizes don't depend on the quantizer's tables */
+    for (i = 1; i < order - 1; i++) {
+        size += middle_size(lm_trie_quant_msize(NULL), counts[i],
+                            counts[0], counts[i + 1]);
+    }
+    size += longest_size(lm_trie_quant_lsize(NULL), counts[order - 1],
+                         counts[0]);
+    return size;
+}
+
 static void
-lm_trie_alloc_ngram(lm_trie_t * trie, uint32 * counts, int order)
+lm_trie_alloc_ngram(lm_trie_t * trie, uint32 * counts, int order,
+                    uint8 * ngram_mem)
 {
     int i;
     uint8 *mem_ptr;
     uint8 **middle_starts;
 
-    trie->ngram_mem_size = 0;
-    for (i = 1; i < order - 1; i++) {
-        trie->ngram_mem_size +=
-            middle_size(lm_trie_quant_msize(trie->quant), counts[i],
-                        counts[0], counts[i + 1]);
-    }
-    trie->ngram_mem_size +=
-        longest_size(lm_trie_quant_lsize(trie->quant), counts[order - 1],
-                     counts[0]);
-    trie->ngram_mem =
+    trie->ngram_mem_size = lm_trie_ngram_mem_size(counts, order);
+    trie->ngram_mem = ngram_mem ? ngram_mem :
         (uint8 *) ckd_calloc(trie->ngram_mem_size,
                              sizeof(*trie->ngram_mem));
     mem_ptr = trie->ngram_mem;
@@ -468,7 +629,7 @@ lm_trie_build(lm_trie_t * trie, ngram_raw_t ** raw_ngrams, uint32 * counts, uint
     int i;
 
     lm_trie_fix_counts(raw_ngrams, counts, out_counts, order);
-    lm_trie_alloc_ngram(trie, out_counts, order);
+    lm_trie_alloc_ngram(trie, out_counts, order, NULL);
     
     if (order > 1)
         E_INFO("Training quantizer\n");
@@ -551,7 +712,8 @@ middle_find(middle_t * middle, uint32 word, node_range_t * range)
     bitarr_address_t address;
 
     /* finding BitPacked with uniform find */
-    if (!uniform_find
+    if ((middle->base.pages && !base_range_loaded(&middle->base, range))
+        || !uniform_find
         ((void *) middle->base.base, middle->base.total_bits,
          middle->base.word_bits, middle->base.word_mask, range->begin - 1,
          0, range->end, middle->base.max_vocab, word, &at_pointer)) {
@@ -583,7 +745,8 @@ longest_find(longest_t * longest, uint32 word, node_range_t * range)
     bitarr_address_t address;
 
     /* finding BitPacked with uniform find */
-    if (!uniform_find
+    if ((longest->base.pages && !base_range_loaded(&longest->base, range))
+        || !uniform_find
         ((void *) longest->base.base, longest->base.total_bits,
          longest->base.word_bits, longest->base.word_mask,
          range->begin - 1, 0, range->end, longest->base.max_vocab, word,
@@ -704,7 +867,7 @@ lm_trie_hist_score(lm_trie_t * trie, int32 wid, int32 * hist, int32 n_hist,
         address = middle_find(&trie->middle_begin[i], hist[i], &node);
         if (address.base == NULL) {
             for (j = i; j < n_hist; j++) {
-                prob += trie->backoff_cache[j];
+                prob += backoff_cache.backoff[j];
             }
             return prob;
         }
@@ -715,7 +878,7 @@ lm_trie_hist_score(lm_trie_t * trie, int32 wid, int32 * hist, int32 n_hist,
     }
     address = longest_find(trie->longest, hist[n_hist - 1], &node);
     if (address.base == NULL) {
-        return prob + trie->backoff_cache[n_hist - 1];
+        return prob + backoff_cache.backoff[n_hist - 1];
     }
     else {
         (*n_used)++;
@@ -742,17 +905,25 @@ update_backoff(lm_trie_t * trie, int32 * hist, int32 n_hist)
     node_range_t node;
     bitarr_address_t address;
 
-    memset(trie->backoff_cache, 0, sizeof(trie->backoff_cache));
-    trie->backoff_cache[0] = unigram_find(trie->unigrams, hist[0], &node)->bo;
+    memset(backoff_cache.backoff, 0, sizeof(backoff_cache.backoff));
+    backoff_cache.backoff[0] = unigram_find(trie->unigrams, hist[0], &node)->bo;
     for (i = 1; i < n_hist; i++) {
         address = middle_find(&trie->middle_begin[i - 1], hist[i], &node);
         if (address.base == NULL) {
             break;
         }
-        trie->backoff_cache[i] =
+        backoff_cache.backoff[i] =
             lm_trie_quant_mboread(trie->quant, address, i - 1);
     }
-    memcpy(trie->hist_cache, hist, n_hist * sizeof(*hist));
+    memcpy(backoff_cache.hist, hist, n_hist * sizeof(*hist));
+    backoff_cache.serial = trie->serial;
+}
+
+void
+lm_trie_flush_cache(lm_trie_t * trie)
+{
+    if (backoff_cache.serial == trie->serial)
+        backoff_cache.serial = 0;
 }
 
 float
@@ -764,7 +935,8 @@ lm_trie_score(lm_trie_t * trie, int order, int32 wid, int32 * hist,
     }
     else {
         assert(n_hist == order - 1);
-        if (!history_matches(hist, (int32 *) trie->hist_cache, n_hist)) {
+        if (backoff_cache.serial != trie->serial
+            || !history_matches(hist, (int32 *) backoff_cache.hist, n_hist)) {
             update_backoff(trie, hist, n_hist);
         }
         return lm_trie_hist_score(trie, wid, hist, n_hist, n_used);
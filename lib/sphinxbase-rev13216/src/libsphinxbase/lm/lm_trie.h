@@ -40,6 +40,7 @@
 
 #include <sphinxbase/pio.h>
 #include <sphinxbase/bitarr.h>
+#include <sphinxbase/mmio.h>
 
 #include "ngram_model_internal.h"
 #include "lm_trie_quant.h"
@@ -55,6 +56,21 @@ typedef struct node_range_s {
     uint32 end;
 } node_range_t;
 
+/**
+ * N-gram arrays that arrive page by page after the rest of the model, e.g. over the network.
+ * Lookups treat the n-grams of pages that haven't arrived as missing, backing off to lower
+ * orders, and flag those pages as wanted. The owner fills pages and marks them loaded from any
+ * thread; the memory must outlive the tries reading it.
+ */
+typedef struct lm_trie_pages_s {
+    uint8 *mem;        /**< The n-gram arrays, zeroed until their pages arrive */
+    size_t size;       /**< Size of mem */
+    uint8 page_bits;   /**< Log2 of the page size */
+    uint32 n_pages;
+    uint8 *loaded;     /**< Per page: set once its bytes are in mem */
+    uint8 *wanted;     /**< Per page: set by lookups that needed it before it arrived */
+} lm_trie_pages_t;
+
 typedef struct base_s {
     uint8 word_bits;
     uint8 total_bits;
@@ -62,6 +78,7 @@ typedef struct base_s {
     uint8 *base;
     uint32 insert_index;
     uint32 max_vocab;
+    lm_trie_pages_t *pages; /**< Pages of the array, if it arrives page by page */
 } base_t;
 
 typedef struct middle_s {
@@ -84,9 +101,10 @@ typedef struct lm_trie_s {
     middle_t *middle_end;
     longest_t *longest;
     lm_trie_quant_t *quant;
+    mmio_file_t *filemap; /**< Mapped LM file holding ngram_mem, if any */
+    lm_trie_pages_t *pages; /**< Pages holding ngram_mem, if it arrives page by page */
 
-    float backoff_cache[NGRAM_MAX_ORDER];
-    uint32 hist_cache[NGRAM_MAX_ORDER - 1];
+    uint32 serial; /**< Unique id, identifies the trie in per-thread backoff caches */
 } lm_trie_t;
 
 /**
@@ -94,7 +112,43 @@ typedef struct lm_trie_s {
  */
 lm_trie_t *lm_trie_create(uint32 unigram_count, int order);
 
-lm_trie_t *lm_trie_read_bin(uint32 * counts, int order, FILE * fp);
+/**
+ * Reads a trie from a binary LM file positioned after the counts.
+ * If filemap maps the same file, the n-gram arrays are used in place and the trie takes
+ * ownership of the mapping.
+ */
+lm_trie_t *lm_trie_read_bin(uint32 * counts, int order, FILE * fp,
+                            mmio_file_t * filemap);
+
+/**
+ * Reads a trie like lm_trie_read_bin() from a file without the n-gram arrays, which are in pages
+ * instead. Returns NULL if the pages don't have the size of the arrays.
+ */
+lm_trie_t *lm_trie_read_bin_paged(uint32 * counts, int order, FILE * fp,
+                                  lm_trie_pages_t * pages);
+
+/**
+ * Size of the n-gram arrays of a trie with these counts
+ */
+size_t lm_trie_ngram_mem_size(uint32 * counts, int order);
+
+/**
+ * Creates the pages of n-gram arrays of the given size, all missing
+ */
+lm_trie_pages_t *lm_trie_pages_create(size_t size, uint8 page_bits);
+
+void lm_trie_pages_free(lm_trie_pages_t * pages);
+
+/**
+ * Marks a page loaded once its bytes are in pages->mem
+ */
+void lm_trie_pages_set_loaded(lm_trie_pages_t * pages, uint32 page);
+
+/**
+ * Returns the next page to load: a wanted one if any, otherwise the first missing one, or -1 once
+ * all are loaded
+ */
+int32 lm_trie_pages_next(lm_trie_pages_t * pages);
 
 void lm_trie_write_bin(lm_trie_t * trie, uint32 unigram_count, FILE * fp);
 
@@ -108,6 +162,11 @@ void lm_trie_fill_raw_ngram(lm_trie_t * trie,
             	            uint32 * counts, node_range_t range, uint32 * hist,
     	                    int n_hist, int order, int max_order);
 
+/**
+ * Invalidates the calling thread's backoff cache if it refers to this trie
+ */
+void lm_trie_flush_cache(lm_trie_t * trie);
+
 float lm_trie_score(lm_trie_t * trie, int order, int32 wid, int32 * hist,
                     int32 n_hist, int32 * n_used);
 
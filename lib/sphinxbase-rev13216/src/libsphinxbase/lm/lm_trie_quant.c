@@ -119,6 +119,12 @@ quant_size(int order)
     return (order - 2) * middle_table + longest_table;
 }
 
+size_t
+lm_trie_quant_mem_size(int order)
+{
+    return quant_size(order);
+}
+
 lm_trie_quant_t *
 lm_trie_quant_create(int order)
 {
@@ -48,6 +48,11 @@ typedef struct lm_trie_quant_s lm_trie_quant_t;
  */
 lm_trie_quant_t *lm_trie_quant_create(int order);
 
+/**
+ * Size of the quant data of a binary file, after its leading int
+ */
+size_t lm_trie_quant_mem_size(int order);
+
 /**
  * Write quant data to binary file
  */
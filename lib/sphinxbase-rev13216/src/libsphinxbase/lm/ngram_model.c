@@ -59,6 +59,16 @@
 #include "ngram_model_internal.h"
 #include "ngram_model_trie.h"
 
+/* Decoders and model sets on several threads share one model, so its
+ * reference count is updated atomically. */
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ngram_model_add_ref(model, n) \
+    ((int) _InterlockedExchangeAdd((volatile long *) &(model)->refcount, (n)) + (n))
+#else
+#define ngram_model_add_ref(model, n) __sync_add_and_fetch(&(model)->refcount, (n))
+#endif
+
 ngram_file_type_t
 ngram_file_name_to_type(const char *file_name)
 {
@@ -248,7 +258,7 @@ ngram_model_init(ngram_model_t * base,
 ngram_model_t *
 ngram_model_retain(ngram_model_t * model)
 {
-    ++model->refcount;
+    ngram_model_add_ref(model, 1);
     return model;
 }
 
@@ -262,12 +272,12 @@ ngram_model_flush(ngram_model_t * model)
 int
 ngram_model_free(ngram_model_t * model)
 {
-    int i;
+    int i, refcount;
 
     if (model == NULL)
         return 0;
-    if (--model->refcount > 0)
-        return model->refcount;
+    if ((refcount = ngram_model_add_ref(model, -1)) > 0)
+        return refcount;
     if (model->funcs && model->funcs->free)
         (*model->funcs->free) (model);
     if (model->writable) {
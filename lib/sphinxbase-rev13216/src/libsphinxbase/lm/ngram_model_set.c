@@ -51,6 +51,9 @@
 
 static ngram_funcs_t ngram_model_set_funcs;
 
+static void precomp_free(ngram_model_set_t * set);
+static void precomp_update(ngram_model_set_t * set);
+
 static int
 my_compare(const void *a, const void *b)
 {
@@ -517,6 +520,7 @@ ngram_model_set_interp(ngram_model_t * base,
     }
     /* Otherwise just enable existing weights. */
     set->cur = -1;
+    precomp_update(set);
     return base;
 }
 
@@ -529,6 +533,9 @@ ngram_model_set_add(ngram_model_t * base,
     float32 fprob;
     int32 scale, i;
 
+    /* Word IDs and weights change. */
+    precomp_free(set);
+
     /* Add it to the array of lms. */
     ++set->n_models;
     set->lms = ckd_realloc(set->lms, set->n_models * sizeof(*set->lms));
@@ -594,6 +601,7 @@ ngram_model_set_remove(ngram_model_t * base,
     if (lmidx == set->n_models)
         return NULL;
     submodel = set->lms[lmidx];
+    precomp_free(set);
 
     /* Renormalize the interpolation weights by scaling them by
      * 1/(1-fprob) */
@@ -643,6 +651,7 @@ ngram_model_set_map_words(ngram_model_t * base,
     int32 i;
 
     /* Recreate the word mapping. */
+    precomp_free(set);
     if (base->writable) {
         for (i = 0; i < base->n_words; ++i) {
             ckd_free(base->word_str[i]);
@@ -656,7 +665,11 @@ ngram_model_set_map_words(ngram_model_t * base,
     set->widmap =
         (int32 **) ckd_calloc_2d(n_words, set->n_models,
                                  sizeof(**set->widmap));
-    hash_table_empty(base->wid);
+    /* The table was sized for the set's vocabulary, which may be far
+     * smaller than the words mapped here (e.g. a dialog-only model mapped
+     * to a whole dictionary), so size it anew to keep the chains short. */
+    hash_table_free(base->wid);
+    base->wid = hash_table_new(n_words, FALSE);
     for (i = 0; i < n_words; ++i) {
         int32 j;
         base->word_str[i] = ckd_salloc(words[i]);
@@ -677,9 +690,153 @@ ngram_model_set_apply_weights(ngram_model_t * base, float32 lw,
     /* Apply weights to each sub-model. */
     for (i = 0; i < set->n_models; ++i)
         ngram_model_apply_weights(set->lms[i], lw, wip);
+    precomp_update(set);
     return 0;
 }
 
+/* Interpolates the scores of the submodels that know the word; the
+ * others would add nothing. */
+static int32
+set_interp_score(ngram_model_set_t * set, int32 wid,
+                 int32 * history, int32 n_hist, int32 * n_used)
+{
+    ngram_model_t *base = &set->base;
+    int32 mapwid;
+    int32 score;
+    int32 i;
+
+    score = base->log_zero;
+    for (i = 0; i < set->n_models; ++i) {
+        int32 j;
+        /* Map word and history IDs for each model. */
+        mapwid = set->widmap[wid][i];
+        if (mapwid == NGRAM_INVALID_WID)
+            continue;
+        for (j = 0; j < n_hist; ++j) {
+            if (history[j] == NGRAM_INVALID_WID)
+                set->maphist[j] = NGRAM_INVALID_WID;
+            else
+                set->maphist[j] = set->widmap[history[j]][i];
+        }
+        score = logmath_add(base->lmath, score,
+                            set->lweights[i] +
+                            ngram_ng_score(set->lms[i],
+                                           mapwid, set->maphist,
+                                           n_hist, n_used));
+    }
+    return score;
+}
+
+static uint32
+precomp_hash(const int32 * ngram, int32 n)
+{
+    uint32 hash = 2166136261u;
+    int32 i;
+
+    for (i = 0; i < n; ++i)
+        hash = (hash ^ (uint32) ngram[i]) * 16777619u;
+    return hash;
+}
+
+/* Returns the index of a precomputed N-Gram, or -1. */
+static int32
+precomp_find(ngram_model_set_t * set, const int32 * ngram)
+{
+    int32 n = set->base.n;
+    uint32 slot;
+
+    for (slot = precomp_hash(ngram, n) & set->precomp_mask;
+         set->precomp_slots[slot];
+         slot = (slot + 1) & set->precomp_mask) {
+        int32 index = set->precomp_slots[slot] - 1;
+        if (0 == memcmp(set->precomp_ngrams + index * n, ngram,
+                        n * sizeof(*ngram)))
+            return index;
+    }
+    return -1;
+}
+
+static void
+precomp_free(ngram_model_set_t * set)
+{
+    ckd_free(set->precomp_slots);
+    ckd_free(set->precomp_ngrams);
+    ckd_free(set->precomp_scores);
+    ckd_free(set->precomp_n_used);
+    bitvec_free(set->precomp_words);
+    set->precomp_words = NULL;
+    set->precomp_slots = NULL;
+    set->precomp_ngrams = NULL;
+    set->precomp_scores = NULL;
+    set->precomp_n_used = NULL;
+    set->n_precomp = 0;
+}
+
+static void
+precomp_update(ngram_model_set_t * set)
+{
+    int32 n = set->base.n;
+    int32 i;
+
+    for (i = 0; i < set->n_precomp; ++i) {
+        int32 *ngram = set->precomp_ngrams + i * n;
+        int32 n_used = 0;
+        set->precomp_scores[i] =
+            set_interp_score(set, ngram[0], ngram + 1, n - 1, &n_used);
+        set->precomp_n_used[i] = n_used;
+    }
+}
+
+int32
+ngram_model_set_precompute(ngram_model_t * base,
+                           const int32 * ngrams, int32 n_ngrams)
+{
+    ngram_model_set_t *set = (ngram_model_set_t *) base;
+    int32 n = base->n;
+    int32 n_slots, i, j;
+
+    precomp_free(set);
+    if (n_ngrams <= 0)
+        return 0;
+
+    /* Keep the table at most half full. */
+    for (n_slots = 16; n_slots < 2 * n_ngrams; n_slots *= 2);
+    set->precomp_mask = n_slots - 1;
+    set->precomp_slots = ckd_calloc(n_slots, sizeof(*set->precomp_slots));
+    set->precomp_ngrams =
+        ckd_calloc(n_ngrams * n, sizeof(*set->precomp_ngrams));
+    set->precomp_scores =
+        ckd_calloc(n_ngrams, sizeof(*set->precomp_scores));
+    set->precomp_n_used =
+        ckd_calloc(n_ngrams, sizeof(*set->precomp_n_used));
+    set->n_precomp_words = base->n_words;
+    set->precomp_words = bitvec_alloc(base->n_words);
+    for (i = 0; i < n_ngrams; ++i) {
+        const int32 *ngram = ngrams + i * n;
+        uint32 slot;
+
+        /* Skip N-Grams of unknown words and repeated ones. */
+        if (ngram[0] < 0 || ngram[0] >= base->n_words)
+            continue;
+        for (j = 1; j < n; ++j)
+            if (ngram[j] != NGRAM_INVALID_WID
+                && (ngram[j] < 0 || ngram[j] >= base->n_words))
+                break;
+        if (j < n || precomp_find(set, ngram) >= 0)
+            continue;
+
+        memcpy(set->precomp_ngrams + set->n_precomp * n, ngram,
+               n * sizeof(*ngram));
+        bitvec_set(set->precomp_words, ngram[0]);
+        for (slot = precomp_hash(ngram, n) & set->precomp_mask;
+             set->precomp_slots[slot];
+             slot = (slot + 1) & set->precomp_mask);
+        set->precomp_slots[slot] = ++set->n_precomp;
+    }
+    precomp_update(set);
+    return set->n_precomp;
+}
+
 static int32
 ngram_model_set_score(ngram_model_t * base, int32 wid,
                       int32 * history, int32 n_hist, int32 * n_used)
@@ -687,7 +844,6 @@ ngram_model_set_score(ngram_model_t * base, int32 wid,
     ngram_model_set_t *set = (ngram_model_set_t *) base;
     int32 mapwid;
     int32 score;
-    int32 i;
 
     /* Truncate the history. */
     if (n_hist > base->n - 1)
@@ -695,23 +851,21 @@ ngram_model_set_score(ngram_model_t * base, int32 wid,
 
     /* Interpolate if there is no current. */
     if (set->cur == -1) {
-        score = base->log_zero;
-        for (i = 0; i < set->n_models; ++i) {
-            int32 j;
-            /* Map word and history IDs for each model. */
-            mapwid = set->widmap[wid][i];
-            for (j = 0; j < n_hist; ++j) {
-                if (history[j] == NGRAM_INVALID_WID)
-                    set->maphist[j] = NGRAM_INVALID_WID;
-                else
-                    set->maphist[j] = set->widmap[history[j]][i];
+        /* Most words the search scores aren't in the table. */
+        if (set->n_precomp && n_hist == base->n - 1
+            && wid < set->n_precomp_words
+            && bitvec_is_set(set->precomp_words, wid)) {
+            int32 ngram[NGRAM_MAX_ORDER];
+            int32 index;
+
+            ngram[0] = wid;
+            memcpy(ngram + 1, history, n_hist * sizeof(*history));
+            if ((index = precomp_find(set, ngram)) >= 0) {
+                *n_used = set->precomp_n_used[index];
+                return set->precomp_scores[index];
             }
-            score = logmath_add(base->lmath, score,
-                                set->lweights[i] +
-                                ngram_ng_score(set->lms[i],
-                                               mapwid, set->maphist,
-                                               n_hist, n_used));
         }
+        score = set_interp_score(set, wid, history, n_hist, n_used);
     }
     else {
         int32 j;
@@ -750,6 +904,8 @@ ngram_model_set_raw_score(ngram_model_t * base, int32 wid,
             int32 j;
             /* Map word and history IDs for each model. */
             mapwid = set->widmap[wid][i];
+            if (mapwid == NGRAM_INVALID_WID)
+                continue;
             for (j = 0; j < n_hist; ++j) {
                 if (history[j] == NGRAM_INVALID_WID)
                     set->maphist[j] = NGRAM_INVALID_WID;
@@ -837,6 +993,7 @@ ngram_model_set_add_ug(ngram_model_t * base, int32 wid, int32 lweight)
         set->widmap[i] = set->widmap[0] + i * set->n_models;
     memcpy(set->widmap[wid], newwid, set->n_models * sizeof(*newwid));
     ckd_free(newwid);
+    precomp_update(set);
     return prob;
 }
 
@@ -855,6 +1012,7 @@ ngram_model_set_free(ngram_model_t * base)
     ckd_free(set->lweights);
     ckd_free(set->maphist);
     ckd_free_2d((void **) set->widmap);
+    precomp_free(set);
 }
 
 static ngram_funcs_t ngram_model_set_funcs = {
@@ -42,6 +42,7 @@
 #ifndef __NGRAM_MODEL_SET_H__
 #define __NGRAM_MODEL_SET_H__
 
+#include "sphinxbase/bitvec.h"
 #include "ngram_model_internal.h"
 
 /**
@@ -57,6 +58,15 @@ typedef struct ngram_model_set_s {
     int32 *lweights;     /**< Log interpolation weights. */
     int32 **widmap;      /**< Word ID mapping for submodels. */
     int32 *maphist;      /**< Word ID mapping for N-Gram history. */
+
+    int32 n_precomp;        /**< Number of precomputed N-Grams. */
+    int32 n_precomp_words;  /**< Number of words when they were precomputed. */
+    bitvec_t *precomp_words; /**< Words of precomputed N-Grams, to skip the table for others. */
+    int32 precomp_mask;     /**< Number of slots of the precomputed table minus one. */
+    int32 *precomp_slots;   /**< Index + 1 of the N-Gram in each slot, or 0. */
+    int32 *precomp_ngrams;  /**< Precomputed N-Grams, word then history. */
+    int32 *precomp_scores;  /**< Their interpolated scores. */
+    int32 *precomp_n_used;  /**< Their N-Gram orders used. */
 } ngram_model_set_t;
 
 /**
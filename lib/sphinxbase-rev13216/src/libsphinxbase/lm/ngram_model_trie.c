@@ -37,12 +37,14 @@
 
 #include <string.h>
 #include <assert.h>
+#include <math.h>
 
 #include <sphinxbase/err.h>
 #include <sphinxbase/pio.h>
 #include <sphinxbase/strfuncs.h>
 #include <sphinxbase/ckd_alloc.h>
 #include <sphinxbase/byteorder.h>
+#include <sphinxbase/mmio.h>
 
 #include "ngram_model_trie.h"
 
@@ -228,6 +230,312 @@ ngram_model_trie_read_arpa(cmd_ln_t * config,
     return base;
 }
 
+ngram_model_t *
+ngram_model_trie_build(cmd_ln_t * config, logmath_t * lmath, int order,
+                       const uint32 * in_counts, const char *const *words,
+                       const float32 *const *probs,
+                       const float32 *const *backoffs,
+                       const uint32 *const *wids)
+{
+    ngram_model_trie_t *model;
+    ngram_model_t *base;
+    ngram_raw_t **raw_ngrams;
+    uint32 counts[NGRAM_MAX_ORDER];
+    uint32 i;
+    int order_it;
+
+    if (order < 1 || order > NGRAM_MAX_ORDER) {
+        E_ERROR("Unsupported LM order %d\n", order);
+        return NULL;
+    }
+    memcpy(counts, in_counts, order * sizeof(*counts));
+
+    model = (ngram_model_trie_t *) ckd_calloc(1, sizeof(*model));
+    base = &model->base;
+    ngram_model_init(base, &ngram_model_trie_funcs, lmath, order,
+                     (int32) counts[0]);
+    base->writable = TRUE;
+
+    /* Unigrams, as read_1grams_arpa() would store them */
+    model->trie = lm_trie_create(counts[0], order);
+    for (i = 0; i < counts[0]; i++) {
+        unigram_t *unigram = &model->trie->unigrams[i];
+        unigram->prob = logmath_log10_to_log_float(lmath, probs[0][i]);
+        if (unigram->prob > 0)
+            unigram->prob = 0;
+        unigram->bo = order > 1
+            ? logmath_log10_to_log_float(lmath, backoffs[0][i]) : 0.0f;
+        base->word_str[i] = ckd_salloc(words[i]);
+        if ((hash_table_enter
+             (base->wid, base->word_str[i],
+              (void *) (long) i)) != (void *) (long) i) {
+            E_WARN("Duplicate word in dictionary: %s\n",
+                   base->word_str[i]);
+        }
+    }
+
+    /* Higher orders, as ngrams_raw_read_arpa() would store them */
+    if (order > 1) {
+        raw_ngrams =
+            (ngram_raw_t **) ckd_calloc(order - 1, sizeof(*raw_ngrams));
+        for (order_it = 2; order_it <= order; order_it++) {
+            ngram_raw_t *raw;
+            raw_ngrams[order_it - 2] = raw = (ngram_raw_t *)
+                ckd_calloc(counts[order_it - 1], sizeof(*raw));
+            for (i = 0; i < counts[order_it - 1]; i++) {
+                const uint32 *ngram_wids =
+                    wids[order_it - 1] + (size_t) i * order_it;
+                int j;
+                raw[i].order = order_it;
+                raw[i].prob =
+                    logmath_log10_to_log_float(lmath,
+                                               probs[order_it - 1][i]);
+                if (raw[i].prob > 0)
+                    raw[i].prob = 0;
+                raw[i].backoff = order_it < order
+                    ? logmath_log10_to_log_float(lmath,
+                                                 backoffs[order_it - 1][i])
+                    : 0.0f;
+                /* Words are stored in reverse order */
+                raw[i].words =
+                    (uint32 *) ckd_calloc(order_it, sizeof(*raw[i].words));
+                for (j = 0; j < order_it; j++)
+                    raw[i].words[j] = ngram_wids[order_it - 1 - j];
+            }
+            qsort(raw, counts[order_it - 1], sizeof(*raw),
+                  &ngram_ord_comparator);
+        }
+        lm_trie_build(model->trie, raw_ngrams, counts, base->n_counts, order);
+        ngrams_raw_free(raw_ngrams, counts, order);
+    }
+
+    /* Now set weights based on config if present, as ngram_model_read() does */
+    if (config) {
+        float32 lw = 1.0;
+        float32 wip = 1.0;
+
+        if (cmd_ln_exists_r(config, "-lw"))
+            lw = cmd_ln_float32_r(config, "-lw");
+        if (cmd_ln_exists_r(config, "-wip"))
+            wip = cmd_ln_float32_r(config, "-wip");
+
+        ngram_model_apply_weights(base, lw, wip);
+    }
+
+    return base;
+}
+
+/* Backoff context of an n-gram: its history, the n-gram without its last word */
+static ngram_raw_t *
+find_context(ngram_raw_t * contexts, uint32 count, const ngram_raw_t * ngram)
+{
+    ngram_raw_t key;
+    /* Words are stored in reverse order, so the history follows the last word */
+    key.words = ngram->words + 1;
+    key.order = ngram->order - 1;
+    return (ngram_raw_t *) bsearch(&key, contexts, count, sizeof(*contexts),
+                                   &ngram_ord_comparator);
+}
+
+ngram_model_t *
+ngram_model_trie_prune(ngram_model_t * base, float64 threshold)
+{
+    ngram_model_trie_t *model = (ngram_model_trie_t *) base;
+    ngram_model_trie_t *pruned;
+    ngram_model_t *pruned_base;
+    ngram_raw_t **raw_ngrams;
+    uint8 **keep, **trimmed;
+    float64 **kept_probs, **kept_lower_probs;
+    uint32 counts[NGRAM_MAX_ORDER];
+    uint32 pruned_counts[NGRAM_MAX_ORDER];
+    uint32 i, j;
+    int order = base->n;
+    int order_it;
+
+    if (order < 2) {
+        E_ERROR("Nothing to prune in a unigram LM\n");
+        return NULL;
+    }
+    if (base->lw != 1.0f || base->log_wip != 0) {
+        E_ERROR("Pruning needs an LM without language weight or word "
+                "insertion penalty applied\n");
+        return NULL;
+    }
+    memcpy(counts, base->n_counts, order * sizeof(*counts));
+
+    /*
+     * Extract the n-grams of each order > 1, which come first word first, and store them like
+     * ngrams_raw_read_arpa() does: in reverse order and sorted
+     */
+    raw_ngrams =
+        (ngram_raw_t **) ckd_calloc(order - 1, sizeof(*raw_ngrams));
+    for (order_it = 2; order_it <= order; order_it++) {
+        uint32 raw_ngram_idx = 0;
+        uint32 hist[NGRAM_MAX_ORDER];
+        node_range_t range;
+        range.begin = range.end = 0;
+        raw_ngrams[order_it - 2] = (ngram_raw_t *)
+            ckd_calloc((size_t) counts[order_it - 1], sizeof(ngram_raw_t));
+        lm_trie_fill_raw_ngram(model->trie, raw_ngrams[order_it - 2],
+                               &raw_ngram_idx, counts, range, hist, 0,
+                               order_it, order);
+        /* Counts of the file may include n-grams the trie can't reach */
+        counts[order_it - 1] = raw_ngram_idx;
+        for (i = 0; i < counts[order_it - 1]; i++) {
+            ngram_raw_t *raw = &raw_ngrams[order_it - 2][i];
+            int k;
+            raw->order = order_it;
+            for (k = 0; k < order_it / 2; k++) {
+                uint32 word = raw->words[k];
+                raw->words[k] = raw->words[order_it - 1 - k];
+                raw->words[order_it - 1 - k] = word;
+            }
+        }
+        qsort(raw_ngrams[order_it - 2], (size_t) counts[order_it - 1],
+              sizeof(ngram_raw_t), &ngram_ord_comparator);
+    }
+
+    /*
+     * Prune from the highest order down, so that the contexts of kept n-grams are known
+     * to be needed when their own order is pruned. An n-gram is pruned if the model changes
+     * little without it: if its probability, weighted by that of the whole n-gram, differs
+     * little from backing off, P(h) P(w|h) |log P(w|h) - log (bo(h) P(w|h'))| being below the
+     * threshold. Each context sums the probabilities of its kept successors, and of their
+     * backoff estimates, for renormalizing its backoff weight if it lost any. The estimates
+     * use the unpruned lower orders.
+     */
+    keep = (uint8 **) ckd_calloc(order, sizeof(*keep));
+    trimmed = (uint8 **) ckd_calloc(order, sizeof(*trimmed));
+    kept_probs = (float64 **) ckd_calloc(order, sizeof(*kept_probs));
+    kept_lower_probs = (float64 **) ckd_calloc(order, sizeof(*kept_lower_probs));
+    for (order_it = 1; order_it <= order; order_it++) {
+        keep[order_it - 1] = (uint8 *) ckd_calloc(counts[order_it - 1], 1);
+        if (order_it < order) {
+            trimmed[order_it - 1] = (uint8 *) ckd_calloc(counts[order_it - 1], 1);
+            kept_probs[order_it - 1] = (float64 *)
+                ckd_calloc(counts[order_it - 1], sizeof(float64));
+            kept_lower_probs[order_it - 1] = (float64 *)
+                ckd_calloc(counts[order_it - 1], sizeof(float64));
+        }
+    }
+    memset(keep[0], 1, counts[0]);
+    pruned_counts[0] = counts[0];
+    for (order_it = order; order_it >= 2; order_it--) {
+        ngram_raw_t *raw = raw_ngrams[order_it - 2];
+        pruned_counts[order_it - 1] = 0;
+        for (i = 0; i < counts[order_it - 1]; i++) {
+            int32 *hist = (int32 *) raw[i].words + 1;
+            int32 n_used;
+            uint32 context;
+            float64 prob, lower_prob, backoff, hist_prob;
+            int k;
+
+            if (order_it == 2) {
+                context = raw[i].words[1];
+                backoff = logmath_log_float_to_log10(base->lmath,
+                                                     model->trie->
+                                                     unigrams[context].bo);
+            }
+            else {
+                ngram_raw_t *context_ngram =
+                    find_context(raw_ngrams[order_it - 3],
+                                 counts[order_it - 2], &raw[i]);
+                assert(context_ngram != NULL);
+                context = (uint32) (context_ngram - raw_ngrams[order_it - 3]);
+                backoff = logmath_log_float_to_log10(base->lmath,
+                                                     context_ngram->backoff);
+            }
+            prob = logmath_log_float_to_log10(base->lmath, raw[i].prob);
+            lower_prob = logmath_log_to_log10(base->lmath,
+                                              ngram_ng_prob(base,
+                                                            (int32) raw[i].words[0],
+                                                            hist, order_it - 2,
+                                                            &n_used));
+
+            if (!keep[order_it - 1][i]) {
+                hist_prob = 0;
+                for (k = order_it - 1; k >= 1; k--) {
+                    hist_prob +=
+                        logmath_log_to_log10(base->lmath,
+                                             ngram_ng_prob(base,
+                                                           (int32) raw[i].words[k],
+                                                           (int32 *) raw[i].words + k + 1,
+                                                           order_it - 1 - k,
+                                                           &n_used));
+                }
+                keep[order_it - 1][i] =
+                    pow(10.0, hist_prob + prob)
+                    * fabs(prob - backoff - lower_prob) * log(10.0) >= threshold;
+            }
+            if (!keep[order_it - 1][i]) {
+                trimmed[order_it - 2][context] = 1;
+                continue;
+            }
+
+            pruned_counts[order_it - 1]++;
+            keep[order_it - 2][context] = 1;
+            kept_probs[order_it - 2][context] += pow(10.0, prob);
+            kept_lower_probs[order_it - 2][context] += pow(10.0, lower_prob);
+        }
+        E_INFO("Kept %u of %u %d-grams\n", pruned_counts[order_it - 1],
+               counts[order_it - 1], order_it);
+    }
+
+    pruned = (ngram_model_trie_t *) ckd_calloc(1, sizeof(*pruned));
+    pruned_base = &pruned->base;
+    ngram_model_init(pruned_base, &ngram_model_trie_funcs, base->lmath,
+                     order, (int32) counts[0]);
+    pruned_base->writable = TRUE;
+    pruned->trie = lm_trie_create(counts[0], order);
+    memcpy(pruned->trie->unigrams, model->trie->unigrams,
+           counts[0] * sizeof(*pruned->trie->unigrams));
+    for (order_it = 1; order_it < order; order_it++) {
+        for (i = 0; i < counts[order_it - 1]; i++) {
+            float32 *bo = order_it == 1
+                ? &pruned->trie->unigrams[i].bo
+                : &raw_ngrams[order_it - 2][i].backoff;
+            float64 left = 1.0 - kept_probs[order_it - 1][i];
+            float64 right = 1.0 - kept_lower_probs[order_it - 1][i];
+            /* Renormalize, keeping the stored weight where rounding makes that impossible */
+            if (trimmed[order_it - 1][i] && left > 0 && right > 0)
+                *bo = logmath_log10_to_log_float(base->lmath,
+                                                 log10(left / right));
+        }
+    }
+    for (i = 0; i < counts[0]; i++) {
+        pruned_base->word_str[i] = ckd_salloc(base->word_str[i]);
+        hash_table_enter(pruned_base->wid, pruned_base->word_str[i],
+                         (void *) (long) i);
+    }
+
+    /* Compact the kept n-grams, which stay sorted */
+    for (order_it = 2; order_it <= order; order_it++) {
+        ngram_raw_t *raw = raw_ngrams[order_it - 2];
+        for (i = 0, j = 0; i < counts[order_it - 1]; i++) {
+            if (keep[order_it - 1][i])
+                raw[j++] = raw[i];
+            else
+                ckd_free(raw[i].words);
+        }
+    }
+    lm_trie_build(pruned->trie, raw_ngrams, pruned_counts,
+                  pruned_base->n_counts, order);
+    ngrams_raw_free(raw_ngrams, pruned_counts, order);
+
+    for (order_it = 0; order_it < order; order_it++) {
+        ckd_free(keep[order_it]);
+        ckd_free(trimmed[order_it]);
+        ckd_free(kept_probs[order_it]);
+        ckd_free(kept_lower_probs[order_it]);
+    }
+    ckd_free(keep);
+    ckd_free(trimmed);
+    ckd_free(kept_probs);
+    ckd_free(kept_lower_probs);
+
+    return pruned_base;
+}
+
 int
 ngram_model_trie_write_arpa(ngram_model_t * base, const char *path)
 {
@@ -337,9 +645,9 @@ read_word_str(ngram_model_t * base, FILE * fp)
     free(tmp_word_str);
 }
 
-ngram_model_t *
-ngram_model_trie_read_bin(cmd_ln_t * config,
-                          const char *path, logmath_t * lmath)
+static ngram_model_t *
+read_bin(cmd_ln_t * config, const char *path, logmath_t * lmath,
+         lm_trie_pages_t * pages)
 {
     int32 is_pipe;
     FILE *fp;
@@ -350,6 +658,7 @@ ngram_model_trie_read_bin(cmd_ln_t * config,
     uint32 counts[NGRAM_MAX_ORDER];
     ngram_model_trie_t *model;
     ngram_model_t *base;
+    mmio_file_t *filemap;
 
     E_INFO("Trying to read LM in trie binary format\n");
     if ((fp = fopen_comp(path, "rb", &is_pipe)) == NULL) {
@@ -378,13 +687,72 @@ ngram_model_trie_read_bin(cmd_ln_t * config,
         base->n_counts[i] = counts[i];
     }
 
-    model->trie = lm_trie_read_bin(counts, order, fp);
+    if (pages) {
+        model->trie = lm_trie_read_bin_paged(counts, order, fp, pages);
+        if (model->trie == NULL) {
+            fclose_comp(fp, is_pipe);
+            ngram_model_free(base);
+            return NULL;
+        }
+    }
+    else {
+        /* The n-gram arrays are read-only, so they can be mapped instead of copied */
+        filemap = NULL;
+        if (!is_pipe && config && cmd_ln_exists_r(config, "-mmap")
+            && cmd_ln_boolean_r(config, "-mmap")) {
+            E_INFO("Memory-mapping LM file %s\n", path);
+            filemap = mmio_file_read(path);
+        }
+        model->trie = lm_trie_read_bin(counts, order, fp, filemap);
+    }
     read_word_str(base, fp);
     fclose_comp(fp, is_pipe);
 
     return base;
 }
 
+ngram_model_t *
+ngram_model_trie_read_bin(cmd_ln_t * config,
+                          const char *path, logmath_t * lmath)
+{
+    return read_bin(config, path, lmath, NULL);
+}
+
+ngram_model_t *
+ngram_model_trie_read_bin_paged(cmd_ln_t * config, const char *path,
+                                logmath_t * lmath, lm_trie_pages_t * pages)
+{
+    return read_bin(config, path, lmath, pages);
+}
+
+int
+ngram_model_trie_bin_layout(const uint8 * head, size_t head_size,
+                            size_t * ngram_offset, size_t * ngram_size)
+{
+    size_t hdr_size = strlen(trie_hdr);
+    uint32 counts[NGRAM_MAX_ORDER];
+    uint8 i, order;
+
+    if (head_size < hdr_size + 1
+        || memcmp(head, trie_hdr, hdr_size) != 0)
+        return -1;
+    order = head[hdr_size];
+    if (order < 2 || order > NGRAM_MAX_ORDER
+        || head_size < hdr_size + 1 + order * sizeof(*counts))
+        return -1;
+    for (i = 0; i < order; i++) {
+        memcpy(&counts[i], head + hdr_size + 1 + i * sizeof(*counts),
+               sizeof(*counts));
+    }
+
+    /* Header, order, counts, quantizer, then the unigrams */
+    *ngram_offset = hdr_size + 1 + order * sizeof(*counts)
+        + sizeof(int32) + lm_trie_quant_mem_size(order)
+        + ((size_t) counts[0] + 1) * sizeof(unigram_t);
+    *ngram_size = lm_trie_ngram_mem_size(counts, order);
+    return 0;
+}
+
 static void
 write_word_str(FILE * fp, ngram_model_t * model)
 {
@@ -677,9 +1045,7 @@ static void
 lm_trie_flush(ngram_model_t * base)
 {
     ngram_model_trie_t *model = (ngram_model_trie_t *) base;
-    lm_trie_t *trie = model->trie;
-    memset(trie->hist_cache, -1, sizeof(trie->hist_cache));
-    memset(trie->backoff_cache, 0, sizeof(trie->backoff_cache));
+    lm_trie_flush_cache(model->trie);
     return;
 }
 
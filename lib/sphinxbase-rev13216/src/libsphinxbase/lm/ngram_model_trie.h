@@ -55,6 +55,38 @@ ngram_model_t *ngram_model_trie_read_arpa(cmd_ln_t * config,
                                           const char *path,
                                           logmath_t * lmath);
 
+/**
+ * Create N-Gram model from n-grams that are already in memory and arrange it in trie structure.
+ * Values are interpreted exactly like the corresponding fields of an ARPABO file.
+ * @param config   [in] optional configuration to take language weight and word insertion penalty from
+ * @param lmath    [in] log math used for log convertions
+ * @param order    [in] maximum order of ngrams
+ * @param counts   [in] amount of ngrams for each order
+ * @param words    [in] unigram strings, counts[0] entries; a word's index is its word id
+ * @param probs    [in] log10 probabilities of each order, counts[i] entries for order i + 1
+ * @param backoffs [in] log10 backoff weights of each order but the highest, counts[i] entries for order i + 1
+ * @param wids     [in] word ids of each order > 1, counts[i] * (i + 1) entries for order i + 1, first word first;
+ *                      wids[0] is ignored
+ */
+ngram_model_t *ngram_model_trie_build(cmd_ln_t * config,
+                                      logmath_t * lmath,
+                                      int order,
+                                      const uint32 * counts,
+                                      const char *const *words,
+                                      const float32 *const *probs,
+                                      const float32 *const *backoffs,
+                                      const uint32 *const *wids);
+
+/**
+ * Create a smaller copy of a trie N-Gram model without the n-grams that contribute little,
+ * renormalizing the backoff weights of their contexts. Unigrams are all kept.
+ * @param base      [in] model to prune, without language weight or word insertion penalty applied
+ * @param threshold [in] an n-gram is dropped if its joint probability times the difference of
+ *                       its log probability (in nats) from backing off is below this
+ * @return               the pruned model, or NULL on error
+ */
+ngram_model_t *ngram_model_trie_prune(ngram_model_t * base, float64 threshold);
+
 /**
  * Write N-Gram model stored in trie structure in ARPABO format
  */
@@ -67,6 +99,27 @@ ngram_model_t *ngram_model_trie_read_bin(cmd_ln_t * config,
                                          const char *path,
                                          logmath_t * lmath);
 
+/**
+ * Read N-Gram model from a binary file without its n-gram arrays, which arrive in pages instead.
+ * The file holds the binary format up to the arrays, then the rest of it; see
+ * ngram_model_trie_bin_layout().
+ * @param pages [in] pages of lm_trie_ngram_mem_size() bytes, which must outlive the model
+ */
+ngram_model_t *ngram_model_trie_read_bin_paged(cmd_ln_t * config,
+                                               const char *path,
+                                               logmath_t * lmath,
+                                               lm_trie_pages_t * pages);
+
+/**
+ * Find where the n-gram arrays of a binary file lie, from the head of the file
+ * @param head         [in] the first bytes of the file, through the n-gram counts
+ * @param ngram_offset [out] offset of the arrays in the file
+ * @param ngram_size   [out] size of the arrays
+ * @return 0, or -1 if the head is too short or not that of a binary trie file
+ */
+int ngram_model_trie_bin_layout(const uint8 * head, size_t head_size,
+                                size_t * ngram_offset, size_t * ngram_size);
+
 /**
  * Write trie to binary file
  */
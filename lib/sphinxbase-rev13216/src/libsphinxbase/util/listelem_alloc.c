@@ -37,6 +37,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "sphinxbase/err.h"
 #include "sphinxbase/ckd_alloc.h"
@@ -130,6 +131,37 @@ listelem_alloc_free(listelem_alloc_t *list)
     ckd_free(list);
 }
 
+void
+listelem_alloc_reset(listelem_alloc_t *list)
+{
+    gnode_t *gn, *gn2;
+    char **next;
+
+    /* Link up the elements of all blocks, each block leading to the
+     * one allocated after it, as the most recent block comes first. */
+    next = NULL;
+    gn2 = list->blocksize;
+    for (gn = list->blocks; gn; gn = gnode_next(gn)) {
+        char **cpp, *cp;
+        int32 j;
+
+        /* Elements of new blocks are zeroed, and users rely on it. */
+        cp = (char *) gnode_ptr(gn);
+        memset(cp, 0, gnode_int32(gn2) * list->elemsize);
+        for (j = gnode_int32(gn2) - 1; j > 0; --j) {
+            cpp = (char **) cp;
+            cp += list->elemsize;
+            *cpp = cp;
+        }
+        *(char **) cp = (char *) next;
+        next = (char **) gnode_ptr(gn);
+        gn2 = gnode_next(gn2);
+    }
+    list->freelist = next;
+    list->n_alloc = 0;
+    list->n_freed = 0;
+}
+
 static void
 listelem_add_block(listelem_alloc_t *list, char *caller_file, int caller_line)
 {
@@ -122,21 +122,24 @@ static void SplitFilter(const int16_t* data_in, size_t data_length,
                         int16_t* hp_data_out, int16_t* lp_data_out) {
   size_t i;
   size_t half_length = data_length >> 1;  // Downsampling by 2.
-  int16_t tmp_out;
+  // The outputs never overlap; telling the compiler lets it vectorize the
+  // butterfly below (SSE/NEON natively, SIMD128 in WASM builds).
+  int16_t* __restrict hp = hp_data_out;
+  int16_t* __restrict lp = lp_data_out;
 
   // All-pass filtering upper branch.
   AllPassFilter(&data_in[0], half_length, kAllPassCoefsQ15[0], upper_state,
-                hp_data_out);
+                hp);
 
   // All-pass filtering lower branch.
   AllPassFilter(&data_in[1], half_length, kAllPassCoefsQ15[1], lower_state,
-                lp_data_out);
+                lp);
 
   // Make LP and HP signals.
   for (i = 0; i < half_length; i++) {
-    tmp_out = *hp_data_out;
-    *hp_data_out++ -= *lp_data_out;
-    *lp_data_out++ += tmp_out;
+    const int16_t tmp_out = hp[i];
+    hp[i] = (int16_t) (tmp_out - lp[i]);
+    lp[i] = (int16_t) (lp[i] + tmp_out);
   }
 }
 
@@ -8,3 +8,4 @@ npx tsup
 
 echo "✅ TypeScript build complete!"
 echo "   Output: dist/index.js, index.mjs, index.d.ts"
+echo "           dist/node.mjs, node.d.mts, node-worker.mjs (Node.js)"
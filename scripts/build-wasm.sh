@@ -9,6 +9,11 @@ mkdir -p build
 # Create output directory
 mkdir -p dist/wasm
 
+# Generate the compiled dictionary (models/sphinx/cmudict-en-us.dict.bin) and the small
+# language model (models/sphinx/en-us-small.lm.bin) with a native build
+cmake -S . -B build-native -DCMAKE_BUILD_TYPE=Release
+cmake --build build-native --target lip-sync-engine-compiled-dictionary lip-sync-engine-small-language-model -j$(nproc 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || echo 4)
+
 # Configure with Emscripten
 cd build
 emcmake cmake .. -DCMAKE_BUILD_TYPE=Release
@@ -16,4 +21,13 @@ emmake make -j$(nproc 2>/dev/null || sysctl -n hw.ncpu 2>/dev/null || echo 4)
 cd ..
 
 echo "✅ WASM build complete!"
-echo "   Output: dist/wasm/lip-sync-engine.js, .wasm, .data"
+echo "   Output: dist/wasm/lip-sync-engine.js, .wasm"
+echo "           dist/wasm/lip-sync-engine-mt.js, .wasm (multithreaded)"
+echo "           dist/wasm/lip-sync-engine-scalar.*, lip-sync-engine-mt-scalar.* (without SIMD128)"
+echo "           dist/wasm/lip-sync-engine-fixed.*, lip-sync-engine-fixed-scalar.* (fixed point, for low-end devices)"
+echo "           dist/wasm/lip-sync-engine-eh.*, lip-sync-engine-mt-eh.*, lip-sync-engine-fixed-eh.* (native exception handling)"
+echo "           dist/wasm/lip-sync-engine-compact.*, lip-sync-engine-compact-eh.* (size-optimized)"
+echo "           dist/wasm/lip-sync-engine-node.mjs, .wasm (ES module for Node.js)"
+echo "           dist/wasm/lip-sync-engine-jspi.* (analyses yield to the event loop with JSPI)"
+echo "           dist/wasm/lip-sync-engine-vad.wasm (voice activity detection for live capture)"
+echo "           dist/wasm/models/ (model files, fetched on demand)"
@@ -0,0 +1,162 @@
+#include "IncrementalAnimator.h"
+#include "mouthAnimation.h"
+#include "time/BoundedTimeline.h"
+#include <compat/boost_compat.h>
+
+using std::vector;
+using boost::optional;
+
+// A pause this long separates the animation before it from the animation after it.
+// Around a pause, the animation steps look ahead and back no more than a few tens of centiseconds:
+// pause shapes depend on pauses up to 35 cs, anticipation reaches back 20 cs, plosive occlusion
+// 12 cs, tweens 8 cs, and timing optimization 6 cs. Cutting in the middle of longer pauses gives
+// the same mouth cues as animating everything at once; 50 cs suffice in practice.
+constexpr centiseconds minCutPauseDuration = 60_cs;
+
+// If there hasn't been a long pause for this long, the window is cut at its longest pause.
+// This bounds latency and cost, but the result may differ slightly from batch animation.
+constexpr centiseconds maxWindowDuration = 3000_cs;
+
+IncrementalAnimator::IncrementalAnimator(const ShapeSet& targetShapeSet) :
+	targetShapeSet(targetShapeSet)
+{}
+
+void IncrementalAnimator::addPhones(const Timeline<Phone>& newPhones) {
+	for (const auto& timedPhone : newPhones) {
+		phones.set(timedPhone);
+	}
+}
+
+vector<Timed<Shape>> IncrementalAnimator::update(centiseconds knownEnd) {
+	vector<Timed<Shape>> cues;
+	if (knownEnd <= windowStart) return cues;
+
+	// Find the latest time that is at least half a cut pause away from any phone, known or not
+	optional<centiseconds> cut;
+	TimeRange longestPause(windowStart, windowStart);
+	const auto considerPause = [&](TimeRange pause) {
+		if (pause.getDuration() >= minCutPauseDuration) {
+			cut = pause.getEnd() - minCutPauseDuration / 2;
+		}
+		if (pause.getDuration() > longestPause.getDuration()) {
+			longestPause = pause;
+		}
+	};
+	centiseconds pauseStart = windowStart;
+	for (const auto& timedPhone : phones) {
+		if (timedPhone.getStart() > pauseStart) {
+			considerPause(TimeRange(pauseStart, timedPhone.getStart()));
+		}
+		pauseStart = std::max(pauseStart, timedPhone.getEnd());
+	}
+	if (knownEnd > pauseStart) {
+		considerPause(TimeRange(pauseStart, knownEnd));
+	}
+
+	if (!cut && knownEnd - windowStart > maxWindowDuration && !longestPause.empty()) {
+		cut = longestPause.getMiddle();
+	}
+	if (!cut || *cut <= windowStart) return cues;
+
+	animateWindow(knownEnd, *cut, cues);
+	return cues;
+}
+
+vector<Timed<Shape>> IncrementalAnimator::preview(const Timeline<Phone>& tentativePhones) const {
+	vector<Timed<Shape>> cues;
+	const centiseconds phonesEnd = std::max(
+		phones.empty() ? 0_cs : phones.rbegin()->getEnd(),
+		tentativePhones.empty() ? 0_cs : tentativePhones.rbegin()->getEnd()
+	);
+	if (phonesEnd <= windowStart) return cues;
+
+	// Leave room for the mouth to close after the last phone
+	const centiseconds end = phonesEnd + minCutPauseDuration / 2;
+	BoundedTimeline<Phone> windowPhones(TimeRange(windowStart, end), phones);
+	for (const auto& timedPhone : tentativePhones) {
+		if (timedPhone.getStart() >= windowStart) {
+			windowPhones.set(timedPhone);
+		}
+	}
+	const JoiningContinuousTimeline<Shape> animation = animate(windowPhones, targetShapeSet);
+
+	for (const auto& timedShape : animation) {
+		TimeRange range = timedShape.getTimeRange();
+		if (releasedEnd < windowStart && range.getStart() == windowStart) {
+			// Join the cue held back from the last window
+			if (timedShape.getValue() == Shape::X) {
+				range.setStart(releasedEnd);
+			} else {
+				cues.emplace_back(releasedEnd, windowStart, Shape::X);
+			}
+		}
+		cues.emplace_back(range, timedShape.getValue());
+	}
+	return cues;
+}
+
+vector<Timed<Shape>> IncrementalAnimator::finish(centiseconds end) {
+	vector<Timed<Shape>> cues;
+	if (end > windowStart) {
+		animateWindow(end, end, cues);
+	} else if (releasedEnd < windowStart) {
+		cues.emplace_back(releasedEnd, windowStart, Shape::X);
+		releasedEnd = windowStart;
+	}
+	return cues;
+}
+
+IncrementalAnimator::State IncrementalAnimator::getState() const {
+	return { phones, windowStart, releasedEnd };
+}
+
+void IncrementalAnimator::setState(const State& state) {
+	phones = state.phones;
+	windowStart = state.windowStart;
+	releasedEnd = state.releasedEnd;
+}
+
+void IncrementalAnimator::animateWindow(
+	centiseconds windowEnd,
+	centiseconds releaseEnd,
+	vector<Timed<Shape>>& cues
+) {
+	const BoundedTimeline<Phone> windowPhones(TimeRange(windowStart, windowEnd), phones);
+	const JoiningContinuousTimeline<Shape> animation = animate(windowPhones, targetShapeSet);
+
+	for (const auto& timedShape : animation) {
+		if (timedShape.getStart() >= releaseEnd) break;
+
+		TimeRange range(timedShape.getStart(), std::min(timedShape.getEnd(), releaseEnd));
+		if (releasedEnd < windowStart && range.getStart() == windowStart) {
+			// Join the cue held back from the previous window
+			if (timedShape.getValue() == Shape::X) {
+				range.setStart(releasedEnd);
+			} else {
+				cues.emplace_back(releasedEnd, windowStart, Shape::X);
+			}
+		}
+
+		// Hold back the cue reaching the end of the released range, which may continue
+		if (timedShape.getEnd() >= releaseEnd && releaseEnd < windowEnd) {
+			// Cuts lie within pauses, so this is almost always an idle cue.
+			// Otherwise, release what's known and start the held idle cue at the cut.
+			if (timedShape.getValue() != Shape::X) {
+				cues.emplace_back(range, timedShape.getValue());
+				releasedEnd = range.getEnd();
+			} else {
+				releasedEnd = range.getStart();
+			}
+			break;
+		}
+
+		cues.emplace_back(range, timedShape.getValue());
+		releasedEnd = range.getEnd();
+	}
+
+	// Phones before the cut can no longer affect the animation
+	windowStart = releaseEnd;
+	if (!phones.empty() && phones.begin()->getStart() < windowStart) {
+		phones.clear(TimeRange(phones.begin()->getStart(), windowStart));
+	}
+}
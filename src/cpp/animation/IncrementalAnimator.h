@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include "core/Phone.h"
+#include "core/Shape.h"
+#include "time/Timeline.h"
+
+// Animates phones that arrive in chronological order, such as from a stream of utterances.
+// Instead of re-animating everything for every new utterance, only a window starting at the last
+// long pause is animated. Mouth cues before that pause are final: later phones can't change them.
+class IncrementalAnimator {
+public:
+	explicit IncrementalAnimator(const ShapeSet& targetShapeSet);
+
+	// Adds recognized phones. They must not start before the knownEnd of the last update().
+	void addPhones(const Timeline<Phone>& newPhones);
+
+	// Animates the phones added so far, knowing that there will be no further phones before
+	// knownEnd. Returns the mouth cues that became final since the last call.
+	std::vector<Timed<Shape>> update(centiseconds knownEnd);
+
+	// Animates the phones added so far together with tentative ones, without changing any state.
+	// Returns provisional mouth cues from the end of those returned so far up to shortly after the
+	// last phone.
+	std::vector<Timed<Shape>> preview(const Timeline<Phone>& tentativePhones) const;
+
+	// Animates the remaining phones up to the end of the audio.
+	// Returns all mouth cues not returned before.
+	std::vector<Timed<Shape>> finish(centiseconds end);
+
+	// The phones not yet animated for good and the progress of the animation, e.g. to continue in
+	// another process
+	struct State {
+		Timeline<Phone> phones;
+		centiseconds windowStart = 0_cs;
+		centiseconds releasedEnd = 0_cs;
+	};
+
+	State getState() const;
+	void setState(const State& state);
+
+private:
+	void animateWindow(centiseconds windowEnd, centiseconds releaseEnd, std::vector<Timed<Shape>>& cues);
+
+	ShapeSet targetShapeSet;
+	Timeline<Phone> phones;
+	// The start of the window that is still animated on every update
+	centiseconds windowStart = 0_cs;
+	// The end of the mouth cues returned so far.
+	// The idle cue from here to windowStart is held back so that it can be joined with the next one.
+	centiseconds releasedEnd = 0_cs;
+};
@@ -64,17 +64,15 @@ ContinuousTimeline<ShapeRule> getShapeRules(const BoundedTimeline<Phone>& phones
 
 		if (phone) {
 			// Animate one phone
-			Timeline<ShapeSet> phoneShapeSets = getShapeSets(*phone, duration, previousDuration);
+			const PhoneShapeSets phoneShapeSets = getShapeSets(*phone, duration, previousDuration);
 
-			// Result timing is relative to phone. Make absolute.
-			phoneShapeSets.shift(timedPhone.getStart());
-
-			// Copy to timeline.
+			// Copy to timeline. Result timing is relative to phone, so make it absolute.
 			// Later shape sets may overwrite earlier ones if overlapping.
-			for (const auto& timedShapeSet : phoneShapeSets) {
+			for (size_t i = 0; i < phoneShapeSets.count; ++i) {
 				shapeRules.set(
-					timedShapeSet.getTimeRange(),
-					ShapeRule(timedShapeSet.getValue(), phone, timedPhone.getTimeRange())
+					timedPhone.getStart() + phoneShapeSets.boundaries[i],
+					timedPhone.getStart() + phoneShapeSets.boundaries[i + 1],
+					ShapeRule(phoneShapeSets.shapeSets[i], phone, timedPhone.getTimeRange())
 				);
 			}
 		}
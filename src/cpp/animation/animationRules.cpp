@@ -2,14 +2,12 @@
 #include <compat/boost_compat.h>
 #include "shapeShorthands.h"
 #include "tools/array.h"
-#include "time/ContinuousTimeline.h"
 
 using std::chrono::duration_cast;
 using boost::algorithm::clamp;
 using boost::optional;
 using std::array;
 using std::pair;
-using std::map;
 
 constexpr size_t shapeValueCount = static_cast<size_t>(Shape::EndSentinel);
 
@@ -25,87 +23,159 @@ Shape relax(Shape shape) {
 	return relaxedShapes[static_cast<size_t>(shape)];
 }
 
+// A matrix that for each shape contains all shapes in ascending order of effort required to move
+// to them
+constexpr array<array<Shape, shapeValueCount>, shapeValueCount> effortMatrix = make_array(
+	/* A */ make_array(A, X, G, B, C, H, E, D, F),
+	/* B */ make_array(B, G, A, X, C, H, E, D, F),
+	/* C */ make_array(C, H, B, G, D, A, X, E, F),
+	/* D */ make_array(D, C, H, B, G, A, X, E, F),
+	/* E */ make_array(E, C, H, B, G, A, X, D, F),
+	/* F */ make_array(F, B, G, A, X, C, H, E, D),
+	/* G */ make_array(G, A, B, C, H, X, E, D, F),
+	/* H */ make_array(H, C, B, G, D, A, X, E, F), // Like C
+	/* X */ make_array(X, A, G, B, C, H, E, D, F) // Like A
+);
+
+// The closest shape for every reference shape and every non-empty set of shapes.
+// This is needed for every shape rule, so it's worth precomputing.
+using ClosestShapes = array<array<Shape, ShapeSet::maskCount>, shapeValueCount>;
+
+constexpr ClosestShapes getClosestShapes() {
+	ClosestShapes result {};
+	for (size_t referenceIndex = 0; referenceIndex < shapeValueCount; ++referenceIndex) {
+		// The position of each shape in the reference shape's effort order
+		array<size_t, shapeValueCount> effort {};
+		for (size_t i = 0; i < shapeValueCount; ++i) {
+			effort[static_cast<size_t>(effortMatrix[referenceIndex][i])] = i;
+		}
+
+		// Each set's closest shape is its lowest shape or the closest shape of the remaining ones
+		array<Shape, ShapeSet::maskCount>& closest = result[referenceIndex];
+		for (size_t mask = 1; mask < ShapeSet::maskCount; ++mask) {
+			size_t lowestIndex = 0;
+			while (!((mask >> lowestIndex) & 1)) ++lowestIndex;
+			const size_t remainingMask = mask & (mask - 1);
+			const Shape remainingClosest = closest[remainingMask];
+			closest[mask] = remainingMask != 0
+					&& effort[static_cast<size_t>(remainingClosest)] < effort[lowestIndex]
+				? remainingClosest
+				: static_cast<Shape>(lowestIndex);
+		}
+	}
+	return result;
+}
+
+constexpr ClosestShapes closestShapes = getClosestShapes();
+
 Shape getClosestShape(Shape reference, ShapeSet shapes) {
 	if (shapes.empty()) {
 		throw std::invalid_argument("Cannot select from empty set of shapes.");
 	}
 
-	// A matrix that for each shape contains all shapes in ascending order of effort required to
-	// move to them
-	constexpr static array<array<Shape, shapeValueCount>, shapeValueCount> effortMatrix = make_array(
-		/* A */ make_array(A, X, G, B, C, H, E, D, F),
-		/* B */ make_array(B, G, A, X, C, H, E, D, F),
-		/* C */ make_array(C, H, B, G, D, A, X, E, F),
-		/* D */ make_array(D, C, H, B, G, A, X, E, F),
-		/* E */ make_array(E, C, H, B, G, A, X, D, F),
-		/* F */ make_array(F, B, G, A, X, C, H, E, D),
-		/* G */ make_array(G, A, B, C, H, X, E, D, F),
-		/* H */ make_array(H, C, B, G, D, A, X, E, F), // Like C
-		/* X */ make_array(X, A, G, B, C, H, E, D, F) // Like A
-	);
-
-	auto& closestShapes = effortMatrix.at(static_cast<size_t>(reference));
-	for (Shape closestShape : closestShapes) {
-		if (shapes.find(closestShape) != shapes.end()) {
-			return closestShape;
-		}
-	}
-
-	throw std::invalid_argument("Unable to find closest shape.");
+	return closestShapes[static_cast<size_t>(reference)][shapes.getMask()];
 }
 
-optional<pair<Shape, TweenTiming>> getTween(Shape first, Shape second) {
+// A tween between two shapes, or none
+struct TweenEntry {
+	bool exists;
+	Shape tweenShape;
+	TweenTiming timing;
+};
+
+// The tween entry for every pair of shapes
+using Tweens = array<array<TweenEntry, shapeValueCount>, shapeValueCount>;
+
+constexpr Tweens getTweens() {
+	struct TweenRule {
+		Shape first, second, tweenShape;
+		TweenTiming timing;
+	};
+
 	// Note that most of the following rules work in one direction only.
 	// That's because in animation, the mouth should usually "pop" open without inbetweens,
 	// then close slowly.
-	static const map<pair<Shape, Shape>, pair<Shape, TweenTiming>> lookup {
-		{ { D, A }, { C, TweenTiming::Early } },
-		{ { D, B }, { C, TweenTiming::Centered } },
-		{ { D, G }, { C, TweenTiming::Early } },
-		{ { D, X }, { C, TweenTiming::Late } },
-		{ { C, F }, { E, TweenTiming::Centered } }, { { F, C }, { E, TweenTiming::Centered } },
-		{ { D, F }, { E, TweenTiming::Centered } },
-		{ { H, F }, { E, TweenTiming::Late } }, { { F, H }, { E, TweenTiming::Early } }
+	constexpr TweenRule rules[] {
+		{ D, A, C, TweenTiming::Early },
+		{ D, B, C, TweenTiming::Centered },
+		{ D, G, C, TweenTiming::Early },
+		{ D, X, C, TweenTiming::Late },
+		{ C, F, E, TweenTiming::Centered }, { F, C, E, TweenTiming::Centered },
+		{ D, F, E, TweenTiming::Centered },
+		{ H, F, E, TweenTiming::Late }, { F, H, E, TweenTiming::Early }
 	};
-	const auto it = lookup.find({ first, second });
-	return it != lookup.end() ? it->second : optional<pair<Shape, TweenTiming>>();
+
+	Tweens result {};
+	for (const TweenRule& rule : rules) {
+		result[static_cast<size_t>(rule.first)][static_cast<size_t>(rule.second)] =
+			TweenEntry { true, rule.tweenShape, rule.timing };
+	}
+	return result;
 }
 
-Timeline<ShapeSet> getShapeSets(Phone phone, centiseconds duration, centiseconds previousDuration) {
-	// Returns a timeline with a single shape set
-	const auto single = [duration](ShapeSet value) {
-		return Timeline<ShapeSet> { { 0_cs, duration, value } };
+constexpr Tweens tweens = getTweens();
+
+optional<pair<Shape, TweenTiming>> getTween(Shape first, Shape second) {
+	const TweenEntry& entry = tweens[static_cast<size_t>(first)][static_cast<size_t>(second)];
+	return entry.exists
+		? pair<Shape, TweenTiming>(entry.tweenShape, entry.timing)
+		: optional<pair<Shape, TweenTiming>>();
+}
+
+// How the shape sets of a phone are timed
+enum class ShapeSetTiming {
+	// A single shape set
+	Single,
+	// Two shape sets, timed as a diphthong
+	Diphthong,
+	// Two shape sets, timed as a plosive
+	Plosive
+};
+
+// The shape sets of a phone, before timing them
+struct PhoneShapeSetRule {
+	ShapeSetTiming timing;
+	ShapeSet first;
+	ShapeSet second;
+	// Phones shorter than this use `shortFirst` instead of `first`
+	centiseconds shortDuration;
+	ShapeSet shortFirst;
+};
+
+constexpr size_t phoneValueCount = static_cast<size_t>(Phone::Noise) + 1;
+
+constexpr PhoneShapeSetRule getPhoneShapeSetRule(Phone phone) {
+	// Returns a rule with a single shape set
+	const auto single = [](ShapeSet value) {
+		return PhoneShapeSetRule { ShapeSetTiming::Single, value, {}, 0_cs, {} };
 	};
 
-	// Returns a timeline with two shape sets, timed as a diphthong
-	const auto diphthong = [duration](ShapeSet first, ShapeSet second) {
-		const centiseconds firstDuration = duration_cast<centiseconds>(duration * 0.6);
-		return Timeline<ShapeSet> {
-			{ 0_cs, firstDuration, first },
-			{ firstDuration, duration, second }
-		};
+	// Returns a rule with a single shape set that depends on the phone's duration
+	const auto singleByDuration = [](centiseconds shortDuration, ShapeSet shortValue, ShapeSet value) {
+		return PhoneShapeSetRule { ShapeSetTiming::Single, value, {}, shortDuration, shortValue };
 	};
 
-	// Returns a timeline with two shape sets, timed as a plosive
-	const auto plosive = [duration, previousDuration](ShapeSet first, ShapeSet second) {
-		const centiseconds minOcclusionDuration = 4_cs;
-		const centiseconds maxOcclusionDuration = 12_cs;
-		const centiseconds occlusionDuration =
-			clamp(previousDuration / 2, minOcclusionDuration, maxOcclusionDuration);
-		return Timeline<ShapeSet> {
-			{ -occlusionDuration, 0_cs, first },
-			{ 0_cs, duration, second }
-		};
+	// Returns a rule with two shape sets, timed as a diphthong
+	const auto diphthong = [](ShapeSet first, ShapeSet second) {
+		return PhoneShapeSetRule { ShapeSetTiming::Diphthong, first, second, 0_cs, {} };
 	};
 
-	// Returns the result of `getShapeSets` when called with identical arguments
-	// except for a different phone.
-	const auto like = [duration, previousDuration](Phone referencePhone) {
-		return getShapeSets(referencePhone, duration, previousDuration);
+	// Returns a rule with two shape sets, timed as a diphthong, of which the first depends on the
+	// phone's duration
+	const auto diphthongByDuration =
+		[](centiseconds shortDuration, ShapeSet shortFirst, ShapeSet first, ShapeSet second) {
+			return PhoneShapeSetRule {
+				ShapeSetTiming::Diphthong, first, second, shortDuration, shortFirst
+			};
+		};
+
+	// Returns a rule with two shape sets, timed as a plosive
+	const auto plosive = [](ShapeSet first, ShapeSet second) {
+		return PhoneShapeSetRule { ShapeSetTiming::Plosive, first, second, 0_cs, {} };
 	};
 
-	static const ShapeSet any { A, B, C, D, E, F, G, H, X };
-	static const ShapeSet anyOpen { B, C, D, E, F, G, H };
+	constexpr ShapeSet any { A, B, C, D, E, F, G, H, X };
+	constexpr ShapeSet anyOpen { B, C, D, E, F, G, H };
 
 	// Note:
 	// The shapes {A, B, G, X} are very similar. You should avoid regular shape sets containing more
@@ -121,15 +191,16 @@ Timeline<ShapeSet> getShapeSets(Phone phone, centiseconds duration, centiseconds
 		case Phone::EH: return single({ C });
 		case Phone::IH: return single({ B });
 		case Phone::UH: return single({ F });
-		case Phone::AH: return duration < 20_cs ? single({ C }) : single({ D });
+		case Phone::AH: return singleByDuration(20_cs, { C }, { D });
 		case Phone::Schwa: return single({ B, C });
 		case Phone::AE: return single({ C });
 		case Phone::EY: return diphthong({ C }, { B });
-		case Phone::AY: return duration < 20_cs ? diphthong({ C }, { B }) : diphthong({ D }, { B });
+		case Phone::AY: return diphthongByDuration(20_cs, { C }, { D }, { B });
 		case Phone::OW: return diphthong({ E }, { F });
-		case Phone::AW: return duration < 30_cs ? diphthong({ C }, { E }) : diphthong({ D }, { E });
+		case Phone::AW: return diphthongByDuration(30_cs, { C }, { D }, { E });
 		case Phone::OY: return diphthong({ E }, { B });
-		case Phone::ER: return duration < 7_cs ? like(Phone::Schwa) : single({ E });
+		// Short ones like Schwa
+		case Phone::ER: return singleByDuration(7_cs, { B, C }, { E });
 
 		case Phone::P:
 		case Phone::B: return plosive({ A }, any);
@@ -151,7 +222,7 @@ Timeline<ShapeSet> getShapeSets(Phone phone, centiseconds duration, centiseconds
 		case Phone::M: return single({ A });
 		case Phone::N: return single({ B, C, F, H });
 		case Phone::NG: return single({ B, C, E, F });
-		case Phone::L: return duration < 20_cs ? single({ B, E, F, H }) : single({ H });
+		case Phone::L: return singleByDuration(20_cs, { B, E, F, H }, { H });
 		case Phone::R: return single({ B, E, F });
 		case Phone::Y: return single({ B, C, F });
 		case Phone::W: return single({ F });
@@ -164,3 +235,42 @@ Timeline<ShapeSet> getShapeSets(Phone phone, centiseconds duration, centiseconds
 		default: throw std::invalid_argument("Unexpected phone.");
 	}
 }
+
+constexpr array<PhoneShapeSetRule, phoneValueCount> getPhoneShapeSetRules() {
+	array<PhoneShapeSetRule, phoneValueCount> result {};
+	for (size_t phoneIndex = 0; phoneIndex < phoneValueCount; ++phoneIndex) {
+		result[phoneIndex] = getPhoneShapeSetRule(static_cast<Phone>(phoneIndex));
+	}
+	return result;
+}
+
+constexpr array<PhoneShapeSetRule, phoneValueCount> phoneShapeSetRules = getPhoneShapeSetRules();
+
+PhoneShapeSets getShapeSets(Phone phone, centiseconds duration, centiseconds previousDuration) {
+	const size_t phoneIndex = static_cast<size_t>(phone);
+	if (phoneIndex >= phoneValueCount) {
+		throw std::invalid_argument("Unexpected phone.");
+	}
+	const PhoneShapeSetRule& rule = phoneShapeSetRules[phoneIndex];
+	const ShapeSet first = duration < rule.shortDuration ? rule.shortFirst : rule.first;
+
+	switch (rule.timing) {
+		case ShapeSetTiming::Single:
+			return { 1, { first, {} }, { 0_cs, duration, duration } };
+		case ShapeSetTiming::Diphthong:
+		{
+			const centiseconds firstDuration = duration_cast<centiseconds>(duration * 0.6);
+			return { 2, { first, rule.second }, { 0_cs, firstDuration, duration } };
+		}
+		case ShapeSetTiming::Plosive:
+		{
+			const centiseconds minOcclusionDuration = 4_cs;
+			const centiseconds maxOcclusionDuration = 12_cs;
+			const centiseconds occlusionDuration =
+				clamp(previousDuration / 2, minOcclusionDuration, maxOcclusionDuration);
+			return { 2, { first, rule.second }, { -occlusionDuration, 0_cs, duration } };
+		}
+		default:
+			throw std::runtime_error("Unexpected shape set timing.");
+	}
+}
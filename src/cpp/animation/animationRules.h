@@ -1,9 +1,9 @@
 #pragma once
 
-#include <set>
 #include "core/Shape.h"
 #include "time/Timeline.h"
 #include "core/Phone.h"
+#include <array>
 
 // Returns the basic shape (A-F) that most closely resembles the specified shape.
 Shape getBasicShape(Shape shape);
@@ -29,8 +29,16 @@ enum class TweenTiming {
 // Returns the tween shape and timing to use to transition between the specified two mouth shapes.
 boost::optional<std::pair<Shape, TweenTiming>> getTween(Shape first, Shape second);
 
+// One or two shape sets in sequence, timed relative to the start of a phone
+struct PhoneShapeSets {
+	size_t count;
+	std::array<ShapeSet, 2> shapeSets;
+	// shapeSets[i] lasts from boundaries[i] to boundaries[i + 1]
+	std::array<centiseconds, 3> boundaries;
+};
+
 // Returns the shape set(s) to use for a given phone.
-// The resulting timeline will always cover the entire duration of the phone (starting at 0 cs).
-// It may extend into the negative time range if animation is required prior to the sound being
+// The shape sets will always cover the entire duration of the phone (starting at 0 cs).
+// They may extend into the negative time range if animation is required prior to the sound being
 // heard.
-Timeline<ShapeSet> getShapeSets(Phone phone, centiseconds duration, centiseconds previousDuration);
+PhoneShapeSets getShapeSets(Phone phone, centiseconds duration, centiseconds previousDuration);
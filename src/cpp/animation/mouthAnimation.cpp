@@ -7,31 +7,52 @@
 #include "timingOptimization.h"
 #include "targetShapeSet.h"
 #include "staticSegments.h"
+#include "tools/AnalysisStats.h"
+#include "tools/cancellation.h"
+
+// Runs an animation pass, measuring its duration, unless the analysis has been cancelled
+template<typename TFunction>
+static auto runPass(AnalysisStage stage, TFunction&& function) {
+	throwIfCancelled();
+	return measureStage(stage, std::forward<TFunction>(function));
+}
 
 JoiningContinuousTimeline<Shape> animate(
 	const BoundedTimeline<Phone>& phones,
-	const ShapeSet& targetShapeSet
+	const ShapeSet& targetShapeSet,
+	int maxThreadCount
 ) {
 	// Create timeline of shape rules
-	ContinuousTimeline<ShapeRule> shapeRules = getShapeRules(phones);
+	ContinuousTimeline<ShapeRule> shapeRules = runPass(AnalysisStage::ShapeRules, [&] {
+		return getShapeRules(phones);
+	});
 
 	// Modify shape rules to only contain allowed shapes -- plus X, which is needed for pauses and
 	// will be replaced later
 	ShapeSet targetShapeSetPlusX = targetShapeSet;
 	targetShapeSetPlusX.insert(Shape::X);
-	shapeRules = convertToTargetShapeSet(shapeRules, targetShapeSetPlusX);
+	runPass(AnalysisStage::TargetShapeConversion, [&] {
+		convertToTargetShapeSet(shapeRules, targetShapeSetPlusX);
+	});
 
-	// Animate in multiple steps
+	// Animate in multiple steps. The later steps modify the same animation in place.
+	// The whole timeline is animated on one thread: even for a ten-minute recording, all steps
+	// together take a few milliseconds, next to more than a minute of recognition, so cutting it at
+	// long pauses and animating the parts in parallel wouldn't pay for itself.
 	const auto performMainAnimationSteps = [&targetShapeSet](const auto& shapeRules) {
-		JoiningContinuousTimeline<Shape> animation = animateRough(shapeRules);
-		animation = optimizeTiming(animation);
-		animation = animatePauses(animation);
-		animation = insertTweens(animation);
-		animation = convertToTargetShapeSet(animation, targetShapeSet);
+		JoiningContinuousTimeline<Shape> animation = runPass(AnalysisStage::RoughAnimation, [&] {
+			return animateRough(shapeRules);
+		});
+		animation = runPass(AnalysisStage::TimingOptimization, [&] { return optimizeTiming(animation); });
+		runPass(AnalysisStage::PauseAnimation, [&] { animatePauses(animation); });
+		runPass(AnalysisStage::Tweening, [&] { insertTweens(animation); });
+		runPass(AnalysisStage::TargetShapeConversion, [&] {
+			convertToTargetShapeSet(animation, targetShapeSet);
+		});
 		return animation;
 	};
 	const JoiningContinuousTimeline<Shape> result =
-		avoidStaticSegments(shapeRules, performMainAnimationSteps);
+		avoidStaticSegments(shapeRules, performMainAnimationSteps, maxThreadCount);
 
 	for (const auto& timedShape : result) {
 		logTimedEvent("shape", timedShape);
@@ -5,7 +5,9 @@
 #include "time/ContinuousTimeline.h"
 #include "targetShapeSet.h"
 
+// Animates the phones using only the target shapes, on up to maxThreadCount threads.
 JoiningContinuousTimeline<Shape> animate(
 	const BoundedTimeline<Phone>& phones,
-	const ShapeSet& targetShapeSet
+	const ShapeSet& targetShapeSet,
+	int maxThreadCount = 1
 );
@@ -28,21 +28,20 @@ Shape getPauseShape(Shape previous, Shape next, centiseconds duration) {
 	return Shape::X;
 }
 
-JoiningContinuousTimeline<Shape> animatePauses(const JoiningContinuousTimeline<Shape>& animation) {
-	JoiningContinuousTimeline<Shape> result(animation);
-	
-	for_each_adjacent(
-		animation.begin(),
-		animation.end(),
-		[&](const Timed<Shape>& previous, const Timed<Shape>& pause, const Timed<Shape>& next) {
-			if (pause.getValue() != Shape::X) return;
-
-			result.set(
-				pause.getTimeRange(),
-				getPauseShape(previous.getValue(), next.getValue(), pause.getDuration())
-			);
+void animatePauses(JoiningContinuousTimeline<Shape>& animation) {
+	// Only pauses between two other shapes are modified
+	animation.transformValues([&](auto pause) {
+		if (pause->getValue() != Shape::X
+			|| pause == animation.begin()
+			|| std::next(pause) == animation.end()
+		) {
+			return pause->getValue();
 		}
-	);
 
-	return result;
+		return getPauseShape(
+			std::prev(pause)->getValue(),
+			std::next(pause)->getValue(),
+			pause->getDuration()
+		);
+	});
 }
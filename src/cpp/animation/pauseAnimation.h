@@ -3,5 +3,5 @@
 #include "core/Shape.h"
 #include "time/ContinuousTimeline.h"
 
-// Takes an existing animation and modifies the pauses (X shapes) to look better.
-JoiningContinuousTimeline<Shape> animatePauses(const JoiningContinuousTimeline<Shape>& animation);
+// Modifies the pauses (X shapes) of an existing animation in place to look better.
+void animatePauses(JoiningContinuousTimeline<Shape>& animation);
@@ -1,37 +1,62 @@
 #include "staticSegments.h"
 #include <vector>
 #include <numeric>
+#include <algorithm>
 #include "tools/nextCombination.h"
+#include "tools/parallel.h"
+#include <compat/boost_compat.h>
 
 using std::vector;
+using boost::optional;
 
-int getSyllableCount(const ContinuousTimeline<ShapeRule>& shapeRules, TimeRange timeRange) {
-	if (timeRange.empty()) return 0;
-
-	const auto begin = shapeRules.find(timeRange.getStart());
-	const auto end = std::next(shapeRules.find(timeRange.getEnd(), FindMode::SampleLeft));
-
-	// Treat every vowel as one syllable
-	int syllableCount = 0;
-	for (auto it = begin; it != end; ++it) {
-		const ShapeRule shapeRule = it->getValue();
-
-		// Disregard phones that are mostly outside the specified time range.
-		const centiseconds phoneMiddle = shapeRule.phoneTiming.getMiddle();
-		if (phoneMiddle < timeRange.getStart() || phoneMiddle >= timeRange.getEnd()) continue;
-
-		auto phone = shapeRule.phone;
-		if (phone && isVowel(*phone)) {
-			++syllableCount;
+// The vowel rules of a shape rule timeline, for counting syllables in time ranges with binary
+// searches. The rules' starts, ends and phone middles all grow with their order, so each
+// condition of getSyllableCount() holds for a contiguous run of them.
+// Changing rules (see getChangedShapeRule()) keeps their phones, so the index stays valid.
+class SyllableIndex {
+public:
+	explicit SyllableIndex(const ContinuousTimeline<ShapeRule>& shapeRules) {
+		for (const auto& timedRule : shapeRules) {
+			const ShapeRule& rule = timedRule.getValue();
+			if (rule.phone && isVowel(*rule.phone)) {
+				starts.push_back(timedRule.getStart());
+				ends.push_back(timedRule.getEnd());
+				phoneMiddles.push_back(rule.phoneTiming.getMiddle());
+			}
 		}
 	}
 
-	return syllableCount;
-}
+	// Counts the vowel rules overlapping the time range whose phone middle lies within it.
+	// Treats every vowel as one syllable.
+	int getSyllableCount(TimeRange timeRange) const {
+		if (timeRange.empty()) return 0;
+
+		const auto indexOf = [&](const vector<centiseconds>& times, centiseconds time, bool inclusive) {
+			const auto it = inclusive
+				? std::upper_bound(times.begin(), times.end(), time)
+				: std::lower_bound(times.begin(), times.end(), time);
+			return it - times.begin();
+		};
+		const auto first = std::max(
+			indexOf(ends, timeRange.getStart(), true),
+			indexOf(phoneMiddles, timeRange.getStart(), false)
+		);
+		const auto last = std::min(
+			indexOf(starts, timeRange.getEnd(), false),
+			indexOf(phoneMiddles, timeRange.getEnd(), false)
+		);
+		return static_cast<int>(std::max(last - first, std::ptrdiff_t(0)));
+	}
+
+private:
+	vector<centiseconds> starts;
+	vector<centiseconds> ends;
+	vector<centiseconds> phoneMiddles;
+};
 
 // A static segment is a prolonged period during which the mouth shape doesn't change
 vector<TimeRange> getStaticSegments(
-	const ContinuousTimeline<ShapeRule>& shapeRules,
+	const SyllableIndex& syllables,
 	const JoiningContinuousTimeline<Shape>& animation
 ) {
 	// A static segment must contain a certain number of syllables to look distractingly static
@@ -44,7 +69,7 @@ vector<TimeRange> getStaticSegments(
 	for (const auto& timedShape : animation) {
 		const TimeRange timeRange = timedShape.getTimeRange();
 		const bool isStatic = timeRange.getDuration() >= minDuration
-			&& getSyllableCount(shapeRules, timeRange) >= minSyllableCount;
+			&& syllables.getSyllableCount(timeRange) >= minSyllableCount;
 		if (isStatic) {
 			result.push_back(timeRange);
 		}
@@ -94,38 +119,43 @@ class RuleChangeScenario {
 public:
 	RuleChangeScenario(
 		const ContinuousTimeline<ShapeRule>& originalRules,
-		const RuleChanges& changes,
+		const SyllableIndex& syllables,
+		RuleChanges changes,
 		const AnimationFunction& animate
 	) :
-		changedRules(applyChanges(originalRules, changes)),
-		animation(animate(changedRules)),
-		staticSegments(getStaticSegments(changedRules, animation))
-	{}
+		changes(std::move(changes))
+	{
+		// Only the score is kept, so that many scenarios can be evaluated at once
+		const ContinuousTimeline<ShapeRule> changedRules = applyChanges(originalRules, this->changes);
+		const JoiningContinuousTimeline<Shape> animation = animate(changedRules);
+		staticSegmentCount = static_cast<int>(getStaticSegments(syllables, animation).size());
+		sumOfShapeDurationSquares = getSumOfShapeDurationSquares(animation);
+	}
 
 	bool isBetterThan(const RuleChangeScenario& rhs) const {
 		// We want zero static segments
-		if (staticSegments.empty() && !rhs.staticSegments.empty()) return true;
+		if (staticSegmentCount == 0 && rhs.staticSegmentCount != 0) return true;
 
 		// Short shapes are better than long ones. Minimize sum-of-squares.
-		if (getSumOfShapeDurationSquares() < rhs.getSumOfShapeDurationSquares()) return true;
+		if (sumOfShapeDurationSquares < rhs.sumOfShapeDurationSquares) return true;
 
 		return false;
 	}
 
 	int getStaticSegmentCount() const {
-		return static_cast<int>(staticSegments.size());
+		return staticSegmentCount;
 	}
 
-	ContinuousTimeline<ShapeRule> getChangedRules() const {
-		return changedRules;
+	const RuleChanges& getChanges() const {
+		return changes;
 	}
 
 private:
-	ContinuousTimeline<ShapeRule> changedRules;
-	JoiningContinuousTimeline<Shape> animation;
-	vector<TimeRange> staticSegments;
+	RuleChanges changes;
+	int staticSegmentCount;
+	double sumOfShapeDurationSquares;
 
-	double getSumOfShapeDurationSquares() const {
+	static double getSumOfShapeDurationSquares(const JoiningContinuousTimeline<Shape>& animation) {
 		return std::accumulate(
 			animation.begin(),
 			animation.end(),
@@ -153,7 +183,8 @@ RuleChanges getPossibleRuleChanges(const ContinuousTimeline<ShapeRule>& shapeRul
 
 ContinuousTimeline<ShapeRule> fixStaticSegmentRules(
 	const ContinuousTimeline<ShapeRule>& shapeRules,
-	const AnimationFunction& animate
+	const AnimationFunction& animate,
+	int maxThreadCount
 ) {
 	// The complexity of this function is exponential with the number of replacements.
 	// So let's cap that value.
@@ -163,27 +194,38 @@ ContinuousTimeline<ShapeRule> fixStaticSegmentRules(
 	const RuleChanges possibleRuleChanges = getPossibleRuleChanges(shapeRules);
 
 	// Find best solution. Start with a single replacement, then increase as necessary.
-	RuleChangeScenario bestScenario(shapeRules, {}, animate);
+	const SyllableIndex syllables(shapeRules);
+	RuleChangeScenario bestScenario(shapeRules, syllables, {}, animate);
 	for (
 		int replacementCount = 1;
 		bestScenario.getStaticSegmentCount() > 0 && replacementCount <= std::min(static_cast<int>(possibleRuleChanges.size()), maxReplacementCount);
 		++replacementCount
 	) {
 		// Only the first <replacementCount> elements of `currentRuleChanges` count
+		vector<RuleChanges> combinations;
 		auto currentRuleChanges(possibleRuleChanges);
 		do {
-			RuleChangeScenario currentScenario(
-				shapeRules,
-				{ currentRuleChanges.begin(), currentRuleChanges.begin() + replacementCount },
-				animate
-			);
-			if (currentScenario.isBetterThan(bestScenario)) {
-				bestScenario = currentScenario;
-			}
+			combinations.emplace_back(currentRuleChanges.begin(), currentRuleChanges.begin() + replacementCount);
 		} while (next_combination(currentRuleChanges.begin(), currentRuleChanges.begin() + replacementCount, currentRuleChanges.end()));
+
+		// Evaluate the scenarios in parallel, then pick the best one in order, as if sequentially
+		vector<optional<RuleChangeScenario>> scenarios(combinations.size());
+		vector<std::function<void()>> tasks;
+		for (size_t i = 0; i < combinations.size(); ++i) {
+			tasks.push_back([&, i] {
+				scenarios[i].emplace(shapeRules, syllables, std::move(combinations[i]), animate);
+			});
+		}
+		runTasksInParallel(tasks, maxThreadCount);
+
+		for (const auto& scenario : scenarios) {
+			if (scenario->isBetterThan(bestScenario)) {
+				bestScenario = *scenario;
+			}
+		}
 	}
 
-	return bestScenario.getChangedRules();
+	return applyChanges(shapeRules, bestScenario.getChanges());
 }
 
 // Indicates whether the specified shape rule may result in different shapes depending on context
@@ -210,10 +252,11 @@ TimeRange extendToFixedRules(
 
 JoiningContinuousTimeline<Shape> avoidStaticSegments(
 	const ContinuousTimeline<ShapeRule>& shapeRules,
-	const AnimationFunction& animate
+	const AnimationFunction& animate,
+	int maxThreadCount
 ) {
 	const auto animation = animate(shapeRules);
-	const vector<TimeRange> staticSegments = getStaticSegments(shapeRules, animation);
+	const vector<TimeRange> staticSegments = getStaticSegments(SyllableIndex(shapeRules), animation);
 	if (staticSegments.empty()) {
 		return animation;
 	}
@@ -225,10 +268,14 @@ JoiningContinuousTimeline<Shape> avoidStaticSegments(
 		// influence the animation
 		const TimeRange extendedStaticSegment = extendToFixedRules(staticSegment, shapeRules);
 
-		// Fix shape rules within the static segment
+		// Fix shape rules within the static segment.
+		// Only the rules overlapping it are copied and re-animated, not the whole clip.
+		const auto segmentFirst = fixedShapeRules.find(extendedStaticSegment.getStart());
+		const auto segmentLast = std::next(fixedShapeRules.find(extendedStaticSegment.getEnd(), FindMode::SampleLeft));
 		const auto fixedSegmentShapeRules = fixStaticSegmentRules(
-			{ extendedStaticSegment, ShapeRule::getInvalid(), fixedShapeRules },
-			animate
+			{ extendedStaticSegment, ShapeRule::getInvalid(), segmentFirst, segmentLast },
+			animate,
+			maxThreadCount
 		);
 		for (const auto& timedShapeRule : fixedSegmentShapeRules) {
 			fixedShapeRules.set(timedShapeRule);
@@ -11,8 +11,11 @@ using AnimationFunction = std::function<JoiningContinuousTimeline<Shape>(const C
 // If the resulting animation contains long static segments, the shape rules are tweaked and
 // animated again.
 // Static segments happen rather often.
+// Alternative shape rules are evaluated on up to maxThreadCount threads; the animation function
+// must be safe to call concurrently.
 // See http://animateducated.blogspot.de/2016/10/lip-sync-animation-2.html?showComment=1478861729702#c2940729096183546458.
 JoiningContinuousTimeline<Shape> avoidStaticSegments(
 	const ContinuousTimeline<ShapeRule>& shapeRules,
-	const AnimationFunction& animate
+	const AnimationFunction& animate,
+	int maxThreadCount = 1
 );
@@ -20,29 +20,22 @@ ShapeSet convertToTargetShapeSet(const ShapeSet& shapes, const ShapeSet& targetS
 	return result;
 }
 
-ContinuousTimeline<ShapeRule> convertToTargetShapeSet(
-	const ContinuousTimeline<ShapeRule>& shapeRules,
+void convertToTargetShapeSet(
+	ContinuousTimeline<ShapeRule>& shapeRules,
 	const ShapeSet& targetShapeSet
 ) {
-	ContinuousTimeline<ShapeRule> result(shapeRules);
-	for (const auto& timedShapeRule : shapeRules) {
-		ShapeRule rule = timedShapeRule.getValue();
+	shapeRules.transformValues([&](auto timedShapeRule) {
+		ShapeRule rule = timedShapeRule->getValue();
 		rule.shapeSet = convertToTargetShapeSet(rule.shapeSet, targetShapeSet);
-		result.set(timedShapeRule.getTimeRange(), rule);
-	}
-	return result;
+		return rule;
+	});
 }
 
-JoiningContinuousTimeline<Shape> convertToTargetShapeSet(
-	const JoiningContinuousTimeline<Shape>& animation,
+void convertToTargetShapeSet(
+	JoiningContinuousTimeline<Shape>& animation,
 	const ShapeSet& targetShapeSet
 ) {
-	JoiningContinuousTimeline<Shape> result(animation);
-	for (const auto& timedShape : animation) {
-		result.set(
-			timedShape.getTimeRange(),
-			convertToTargetShapeSet(timedShape.getValue(), targetShapeSet)
-		);
-	}
-	return result;
+	animation.transformValues([&](auto timedShape) {
+		return convertToTargetShapeSet(timedShape->getValue(), targetShapeSet);
+	});
 }
@@ -10,15 +10,16 @@ Shape convertToTargetShapeSet(Shape shape, const ShapeSet& targetShapeSet);
 // set.
 ShapeSet convertToTargetShapeSet(const ShapeSet& shapes, const ShapeSet& targetShapeSet);
 
-// Replaces each shape in each rule with the closest shape that occurs in the target shape set.
-ContinuousTimeline<ShapeRule> convertToTargetShapeSet(
-	const ContinuousTimeline<ShapeRule>& shapeRules,
+// Replaces each shape in each rule, in place, with the closest shape that occurs in the target
+// shape set.
+void convertToTargetShapeSet(
+	ContinuousTimeline<ShapeRule>& shapeRules,
 	const ShapeSet& targetShapeSet
 );
 
-// Replaces each shape in the specified animation with the closest shape that occurs in the target
-// shape set.
-JoiningContinuousTimeline<Shape> convertToTargetShapeSet(
-	const JoiningContinuousTimeline<Shape>& animation,
+// Replaces each shape in the specified animation, in place, with the closest shape that occurs in
+// the target shape set.
+void convertToTargetShapeSet(
+	JoiningContinuousTimeline<Shape>& animation,
 	const ShapeSet& targetShapeSet
 );
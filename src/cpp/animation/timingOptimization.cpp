@@ -1,14 +1,82 @@
 #include "timingOptimization.h"
 #include "time/timedLogging.h"
 #include <compat/boost_compat.h>
-#include <map>
+#include <array>
 #include <algorithm>
 #include "ShapeRule.h"
 
 using std::string;
-using std::map;
+using std::vector;
+
+// The shapes of an animation overlapping a time range, clipped to it.
+// Refers to the animation's shapes instead of copying them.
+class ShapeView {
+public:
+	using iterator = JoiningContinuousTimeline<Shape>::iterator;
+
+	ShapeView(iterator first, iterator last, TimeRange range) :
+		first(first),
+		last(last),
+		range(range)
+	{}
+
+	// Returns a view of the shapes of the given animation overlapping the given range
+	ShapeView(const JoiningContinuousTimeline<Shape>& animation, TimeRange range) :
+		ShapeView(animation.begin(), animation.end(), range)
+	{
+		*this = getOverlapping(range);
+	}
+
+	iterator begin() const {
+		return first;
+	}
+
+	iterator end() const {
+		return last;
+	}
+
+	bool empty() const {
+		return first == last;
+	}
+
+	Timed<Shape> front() const {
+		return clip(*first);
+	}
+
+	Timed<Shape> back() const {
+		return clip(*std::prev(last));
+	}
+
+	// The range covered by the clipped shapes
+	TimeRange getRange() const {
+		return empty() ? TimeRange::zero() : TimeRange(front().getStart(), back().getEnd());
+	}
+
+	Timed<Shape> clip(Timed<Shape> timedShape) const {
+		timedShape.getTimeRange().trim(range);
+		return timedShape;
+	}
+
+	// Returns the shapes of this view overlapping the given range, clipped to it
+	ShapeView getOverlapping(TimeRange newRange) const {
+		if (newRange.getEnd() <= range.getStart() || newRange.getStart() >= range.getEnd()) {
+			return ShapeView(last, last, range);
+		}
+		newRange.trim(range);
+		const iterator newFirst = std::partition_point(first, last,
+			[&](const Timed<Shape>& timedShape) { return timedShape.getEnd() <= newRange.getStart(); });
+		const iterator newLast = std::partition_point(newFirst, last,
+			[&](const Timed<Shape>& timedShape) { return timedShape.getStart() < newRange.getEnd(); });
+		return ShapeView(newFirst, newLast, newRange);
+	}
+
+private:
+	iterator first;
+	iterator last;
+	TimeRange range;
+};
 
-string getShapesString(const JoiningContinuousTimeline<Shape>& shapes) {
+string getShapesString(const ShapeView& shapes) {
 	string result;
 	for (const auto& timedShape : shapes) {
 		if (!result.empty()) {
@@ -19,43 +87,43 @@ string getShapesString(const JoiningContinuousTimeline<Shape>& shapes) {
 	return result;
 }
 
-Shape getRepresentativeShape(const JoiningTimeline<Shape>& timeline) {
-	if (timeline.empty()) {
+Shape getRepresentativeShape(const ShapeView& shapes) {
+	if (shapes.empty()) {
 		throw std::invalid_argument("Cannot determine representative shape from empty timeline.");
 	}
 
-	// Collect candidate shapes with weights
-	map<Shape, centiseconds> candidateShapeWeights;
-	for (const auto& timedShape : timeline) {
-		candidateShapeWeights[timedShape.getValue()] += timedShape.getDuration();
+	// Collect candidate shapes with weights, indexed by shape
+	std::array<centiseconds, static_cast<size_t>(Shape::EndSentinel)> candidateShapeWeights {};
+	for (const auto& timedShape : shapes) {
+		candidateShapeWeights[static_cast<size_t>(timedShape.getValue())] += shapes.clip(timedShape).getDuration();
 	}
 
 	// Select shape with highest total duration within the candidate range
-	const Shape bestShape = std::max_element(
-		candidateShapeWeights.begin(), candidateShapeWeights.end(),
-		[](auto a, auto b) { return a.second < b.second; }
-	)->first;
+	const Shape bestShape = static_cast<Shape>(std::max_element(
+		candidateShapeWeights.begin(), candidateShapeWeights.end()
+	) - candidateShapeWeights.begin());
 
 	// Shapes C and D are similar, but D is more interesting.
-	const bool substituteD = bestShape == Shape::C && candidateShapeWeights[Shape::D] > 0_cs;
+	const bool substituteD = bestShape == Shape::C
+		&& candidateShapeWeights[static_cast<size_t>(Shape::D)] > 0_cs;
 	return substituteD ? Shape::D : bestShape;
 }
 
 struct ShapeReduction {
-	ShapeReduction(const JoiningTimeline<Shape>& sourceShapes) :
+	ShapeReduction(const ShapeView& sourceShapes) :
 		sourceShapes(sourceShapes),
 		shape(getRepresentativeShape(sourceShapes)) {}
 
-	ShapeReduction(const JoiningTimeline<Shape>& sourceShapes, TimeRange candidateRange) :
-		ShapeReduction(JoiningBoundedTimeline<Shape>(candidateRange, sourceShapes)) {}
+	ShapeReduction(const ShapeView& sourceShapes, TimeRange candidateRange) :
+		ShapeReduction(sourceShapes.getOverlapping(candidateRange)) {}
 
-	JoiningTimeline<Shape> sourceShapes;
+	ShapeView sourceShapes;
 	Shape shape;
 };
 
 // Returns a time range of candidate shapes for the next shape to draw.
 // Guaranteed to be non-empty.
-TimeRange getNextMinimalCandidateRange(const JoiningContinuousTimeline<Shape>& sourceShapes,
+TimeRange getNextMinimalCandidateRange(const ShapeView& sourceShapes,
 	const TimeRange targetRange, const centiseconds writePosition) {
 	if (sourceShapes.empty()) {
 		throw std::invalid_argument("Cannot determine candidate range for empty source timeline.");
@@ -83,19 +151,19 @@ TimeRange getNextMinimalCandidateRange(const JoiningContinuousTimeline<Shape>& s
 	if (candidateRange.getStart() >= sourceShapes.getRange().getEnd()) {
 		// We haven't reached the source range yet.
 		// Extend the candidate range to the left in order to encompass the right-most source shape.
-		candidateRange.setStart(sourceShapes.rbegin()->getStart());
+		candidateRange.setStart(sourceShapes.back().getStart());
 	}
 	if (candidateRange.getEnd() <= sourceShapes.getRange().getStart()) {
 		// We're past the source range. This can happen in corner cases.
 		// Extend the candidate range to the right in order to encompass the left-most source shape
-		candidateRange.setEnd(sourceShapes.begin()->getEnd());
+		candidateRange.setEnd(sourceShapes.front().getEnd());
 	}
 
 	return candidateRange;
 }
 
 ShapeReduction getNextShapeReduction(
-	const JoiningContinuousTimeline<Shape>& sourceShapes,
+	const ShapeView& sourceShapes,
 	const TimeRange targetRange,
 	centiseconds writePosition
 ) {
@@ -108,7 +176,7 @@ ShapeReduction getNextShapeReduction(
 	// ... a candidate range extended to the left to fully encompass its left-most shape
 	const ShapeReduction extendedReduction(sourceShapes,
 		{
-			minReduction.sourceShapes.begin()->getStart(),
+			minReduction.sourceShapes.front().getStart(),
 			minReduction.sourceShapes.getRange().getEnd()
 		}
 	);
@@ -127,18 +195,25 @@ ShapeReduction getNextShapeReduction(
 	return minEqualsExtended || extendedIsSpecial ? extendedReduction : minReduction;
 }
 
-// Modifies the timing of the given animation to fit into the specified target time range without
+// Modifies the timing of the given shapes to fit into the specified target time range without
 // jitter.
-JoiningContinuousTimeline<Shape> retime(const JoiningContinuousTimeline<Shape>& sourceShapes,
-	const TimeRange targetRange) {
-	logTimedEvent("segment", targetRange, getShapesString(sourceShapes));
+// Appends the resulting shapes to `result` from right to left, covering the entire target range.
+void retime(const ShapeView& sourceShapes, const TimeRange targetRange, vector<Timed<Shape>>& result) {
+	if (logging::isEnabled(logging::Level::Debug)) {
+		logTimedEvent("segment", targetRange, getShapesString(sourceShapes));
+	}
 
-	JoiningContinuousTimeline<Shape> result(targetRange, Shape::X);
-	if (sourceShapes.empty()) return result;
+	const auto draw = [&](TimeRange range, Shape shape) {
+		if (range.getEnd() <= targetRange.getStart()) return;
+		range.trim(targetRange);
+		if (!range.empty()) {
+			result.emplace_back(range, shape);
+		}
+	};
 
 	// Animate backwards
 	centiseconds writePosition = targetRange.getEnd();
-	while (writePosition > targetRange.getStart()) {
+	while (writePosition > targetRange.getStart() && !sourceShapes.empty()) {
 
 		// Decide which shape to show next, possibly discarding short shapes
 		const ShapeReduction shapeReduction =
@@ -152,22 +227,16 @@ JoiningContinuousTimeline<Shape> retime(const JoiningContinuousTimeline<Shape>&
 		}
 		targetShapeRange.trimRight(writePosition);
 
-		// Draw shape
-		result.set(targetShapeRange, shapeReduction.shape);
+		// Draw shape, leaving any skipped part of the target range idle
+		draw(TimeRange(targetShapeRange.getEnd(), writePosition), Shape::X);
+		draw(targetShapeRange, shapeReduction.shape);
 
 		writePosition = targetShapeRange.getStart();
 	}
 
-	return result;
-}
-
-JoiningContinuousTimeline<Shape> retime(
-	const JoiningContinuousTimeline<Shape>& animation,
-	TimeRange sourceRange,
-	TimeRange targetRange
-) {
-	const auto sourceShapes = JoiningContinuousTimeline<Shape>(sourceRange, Shape::X, animation);
-	return retime(sourceShapes, targetRange);
+	if (writePosition > targetRange.getStart()) {
+		draw(TimeRange(targetRange.getStart(), writePosition), Shape::X);
+	}
 }
 
 enum class MouthState {
@@ -196,10 +265,11 @@ JoiningContinuousTimeline<Shape> optimizeTiming(const JoiningContinuousTimeline<
 	const centiseconds maxExtensionDuration = 6_cs;
 
 	// Make sure all open and closed segments are long enough to register visually.
-	JoiningContinuousTimeline<Shape> result(animation.getRange(), Shape::X);
-	// ... we're filling the result timeline from right to left, so `resultStart` points to the
+	// ... we're collecting the result shapes from right to left, so `resultStart` points to the
 	// earliest shape already written
-	centiseconds resultStart = result.getRange().getEnd();
+	vector<Timed<Shape>> resultShapes;
+	resultShapes.reserve(animation.size());
+	centiseconds resultStart = animation.getRange().getEnd();
 	for (auto segmentIt = segments.rbegin(); segmentIt != segments.rend(); ++segmentIt) {
 		// We don't care about idle shapes at this point.
 		if (segmentIt->getValue() == MouthState::Idle) continue;
@@ -208,10 +278,7 @@ JoiningContinuousTimeline<Shape> optimizeTiming(const JoiningContinuousTimeline<
 		if (resultStart - segmentIt->getStart() >= minSegmentDuration) {
 			// The segment is long enough; we don't have to extend it to the left.
 			const TimeRange targetRange(segmentIt->getStart(), resultStart);
-			const auto retimedSegment = retime(animation, segmentIt->getTimeRange(), targetRange);
-			for (const auto& timedShape : retimedSegment) {
-				result.set(timedShape);
-			}
+			retime(ShapeView(animation, segmentIt->getTimeRange()), targetRange, resultShapes);
 			resultStart = targetRange.getStart();
 		} else {
 			// The segment is too short; we have to extend it to the left.
@@ -247,11 +314,7 @@ JoiningContinuousTimeline<Shape> optimizeTiming(const JoiningContinuousTimeline<
 				const centiseconds segmentDuration = (resultStart - shortSegmentsTargetStart) /
 					remainingShortSegmentCount;
 				const TimeRange segmentTargetRange(resultStart - segmentDuration, resultStart);
-				const auto retimedSegment =
-					retime(animation, shortSegmentIt->getTimeRange(), segmentTargetRange);
-				for (const auto& timedShape : retimedSegment) {
-					result.set(timedShape);
-				}
+				retime(ShapeView(animation, shortSegmentIt->getTimeRange()), segmentTargetRange, resultShapes);
 				resultStart = segmentTargetRange.getStart();
 			}
 
@@ -259,5 +322,10 @@ JoiningContinuousTimeline<Shape> optimizeTiming(const JoiningContinuousTimeline<
 		}
 	}
 
+	// Setting the shapes from left to right only modifies the end of the result
+	JoiningContinuousTimeline<Shape> result(animation.getRange(), Shape::X);
+	for (auto it = resultShapes.rbegin(); it != resultShapes.rend(); ++it) {
+		result.set(*it);
+	}
 	return result;
 }
@@ -1,11 +1,12 @@
 #include "tweening.h"
 #include "animationRules.h"
 
-JoiningContinuousTimeline<Shape> insertTweens(const JoiningContinuousTimeline<Shape>& animation) {
+void insertTweens(JoiningContinuousTimeline<Shape>& animation) {
 	const centiseconds minTweenDuration = 4_cs;
 	const centiseconds maxTweenDuration = 8_cs;
 
-	JoiningContinuousTimeline<Shape> result(animation);
+	// Determine all tweens from the original transitions before inserting any
+	std::vector<Timed<Shape>> tweens;
 
 	for_each_adjacent(animation.begin(), animation.end(), [&](const auto& first, const auto& second) {
 		auto pair = getTween(first.getValue(), second.getValue());
@@ -47,8 +48,10 @@ JoiningContinuousTimeline<Shape> insertTweens(const JoiningContinuousTimeline<Sh
 
 		if (tweenDuration < minTweenDuration) return;
 
-		result.set(tweenStart, tweenStart + tweenDuration, tweenShape);
+		tweens.emplace_back(tweenStart, tweenStart + tweenDuration, tweenShape);
 	});
 
-	return result;
+	for (const Timed<Shape>& tween : tweens) {
+		animation.set(tween);
+	}
 }
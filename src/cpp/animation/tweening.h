@@ -3,5 +3,5 @@
 #include "core/Shape.h"
 #include "time/ContinuousTimeline.h"
 
-// Takes an existing animation and inserts inbetween shapes for smoother results.
-JoiningContinuousTimeline<Shape> insertTweens(const JoiningContinuousTimeline<Shape>& animation);
+// Inserts inbetween shapes into an existing animation in place for smoother results.
+void insertTweens(JoiningContinuousTimeline<Shape>& animation);
@@ -3,8 +3,12 @@
 
 using std::invalid_argument;
 
+Timebase AudioClip::getTimebase() const {
+	return Timebase(getSampleRate());
+}
+
 TimeRange AudioClip::getTruncatedRange() const {
-	return TimeRange(0_cs, centiseconds(100 * size() / getSampleRate()));
+	return getTimebase().getTruncatedRange(size());
 }
 
 class SafeSampleReader {
@@ -47,6 +51,38 @@ SampleReader AudioClip::createSampleReader() const {
 	return SafeSampleReader(createUnsafeSampleReader(), size());
 }
 
+void AudioClip::readBlock(size_type start, size_type count, value_type* out) const {
+	if (start < 0 || count < 0) {
+		throw invalid_argument(fmt::format(
+			"Cannot read {} samples from sample index {}. Negative values are invalid.",
+			count,
+			start
+		));
+	}
+	if (start + count > size()) {
+		throw invalid_argument(fmt::format(
+			"Cannot read {} samples from sample index {}. Clip size is {}.",
+			count,
+			start,
+			size()
+		));
+	}
+	if (count == 0) return;
+
+	readUnsafeBlock(start, count, out);
+}
+
+void AudioClip::readUnsafeBlock(size_type start, size_type count, value_type* out) const {
+	const SampleReader read = createUnsafeSampleReader();
+	for (size_type i = 0; i < count; ++i) {
+		out[i] = read(start + i);
+	}
+}
+
+const int16_t* AudioClip::get16bitBuffer() const {
+	return nullptr;
+}
+
 AudioClip::iterator AudioClip::begin() const {
 	return SampleIterator(*this, 0);
 }
@@ -60,10 +96,11 @@ std::unique_ptr<AudioClip> operator|(std::unique_ptr<AudioClip> clip, const Audi
 }
 
 SampleIterator::SampleIterator() :
+	audioClip(nullptr),
 	sampleIndex(0)
 {}
 
 SampleIterator::SampleIterator(const AudioClip& audioClip, size_type sampleIndex) :
-	sampleReader([&audioClip] { return audioClip.createSampleReader(); }),
+	audioClip(&audioClip),
 	sampleIndex(sampleIndex)
 {}
@@ -1,9 +1,10 @@
 #pragma once
 
 #include <memory>
+#include <cstdint>
 #include "time/TimeRange.h"
+#include "Timebase.h"
 #include <functional>
-#include "tools/Lazy.h"
 
 class AudioClip;
 class SampleIterator;
@@ -20,12 +21,22 @@ public:
 	virtual std::unique_ptr<AudioClip> clone() const = 0;
 	virtual int getSampleRate() const = 0;
 	virtual size_type size() const = 0;
+	Timebase getTimebase() const;
+	// The whole centiseconds of the clip
 	TimeRange getTruncatedRange() const;
 	SampleReader createSampleReader() const;
+	// Reads the samples [start, start + count) to the specified buffer.
+	// Much faster than a sample reader when reading many consecutive samples.
+	void readBlock(size_type start, size_type count, value_type* out) const;
+	// Returns the clip's size() samples if the clip is backed by a 16-bit buffer, else nullptr
+	virtual const int16_t* get16bitBuffer() const;
 	iterator begin() const;
 	iterator end() const;
 private:
 	virtual SampleReader createUnsafeSampleReader() const = 0;
+	// Reads a block of samples without checking its bounds.
+	// The default implementation falls back to the sample reader.
+	virtual void readUnsafeBlock(size_type start, size_type count, value_type* out) const;
 };
 
 using AudioEffect = std::function<std::unique_ptr<AudioClip>(std::unique_ptr<AudioClip>)>;
@@ -50,8 +61,12 @@ public:
 private:
 	friend AudioClip;
 	SampleIterator(const AudioClip& audioClip, size_type sampleIndex);
+	const SampleReader& getSampleReader() const;
 
-	Lazy<SampleReader> sampleReader;
+	const AudioClip* audioClip;
+	// Created on the first read and shared by later copies. Like the reader itself, an iterator
+	// must not be read from several threads at once.
+	mutable std::shared_ptr<SampleReader> sampleReader;
 	size_type sampleIndex;
 };
 
@@ -63,12 +78,19 @@ inline void SampleIterator::seek(size_type sampleIndex) {
 	this->sampleIndex = sampleIndex;
 }
 
+inline const SampleReader& SampleIterator::getSampleReader() const {
+	if (!sampleReader) {
+		sampleReader = std::make_shared<SampleReader>(audioClip->createSampleReader());
+	}
+	return *sampleReader;
+}
+
 inline SampleIterator::value_type SampleIterator::operator*() const {
-	return (*sampleReader)(sampleIndex);
+	return getSampleReader()(sampleIndex);
 }
 
 inline SampleIterator::value_type SampleIterator::operator[](difference_type n) const {
-	return (*sampleReader)(sampleIndex + n);
+	return getSampleReader()(sampleIndex + n);
 }
 
 inline bool operator==(const SampleIterator& lhs, const SampleIterator& rhs) {
@@ -5,8 +5,9 @@ using std::make_unique;
 
 AudioSegment::AudioSegment(std::unique_ptr<AudioClip> inputClip, const TimeRange& range) :
 	inputClip(std::move(inputClip)),
-	sampleOffset(static_cast<int64_t>(range.getStart().count()) * this->inputClip->getSampleRate() / 100),
-	sampleCount(static_cast<int64_t>(range.getDuration().count()) * this->inputClip->getSampleRate() / 100)
+	// Counting to the first sample of the end, adjacent segments share no samples and skip none
+	sampleOffset(this->inputClip->getTimebase().toSampleIndex(range.getStart())),
+	sampleCount(this->inputClip->getTimebase().toSampleCount(range))
 {
 	if (sampleOffset < 0 || sampleOffset + sampleCount > this->inputClip->size()) {
 		throw std::invalid_argument("Segment extends beyond input clip.");
@@ -17,12 +18,21 @@ unique_ptr<AudioClip> AudioSegment::clone() const {
 	return make_unique<AudioSegment>(*this);
 }
 
+const int16_t* AudioSegment::get16bitBuffer() const {
+	const int16_t* inputBuffer = inputClip->get16bitBuffer();
+	return inputBuffer ? inputBuffer + sampleOffset : nullptr;
+}
+
 SampleReader AudioSegment::createUnsafeSampleReader() const {
 	return [read = inputClip->createSampleReader(), sampleOffset = sampleOffset](size_type index) {
 		return read(index + sampleOffset);
 	};
 }
 
+void AudioSegment::readUnsafeBlock(size_type start, size_type count, value_type* out) const {
+	inputClip->readBlock(start + sampleOffset, count, out);
+}
+
 AudioEffect segment(const TimeRange& range) {
 	return [range](unique_ptr<AudioClip> inputClip) {
 		return make_unique<AudioSegment>(std::move(inputClip), range);
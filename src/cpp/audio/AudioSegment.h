@@ -8,9 +8,11 @@ public:
 	std::unique_ptr<AudioClip> clone() const override;
 	int getSampleRate() const override;
 	size_type size() const override;
+	const int16_t* get16bitBuffer() const override;
 
 private:
 	SampleReader createUnsafeSampleReader() const override;
+	void readUnsafeBlock(size_type start, size_type count, value_type* out) const override;
 
 	std::shared_ptr<AudioClip> inputClip;
 	size_type sampleOffset, sampleCount;
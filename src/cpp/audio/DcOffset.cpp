@@ -1,5 +1,9 @@
 #include "DcOffset.h"
+#include "Int16AudioClip.h"
+#include "processing.h"
 #include <cmath>
+#include <vector>
+#include <algorithm>
 
 using std::unique_ptr;
 using std::make_unique;
@@ -25,33 +29,75 @@ SampleReader DcOffset::createUnsafeSampleReader() const {
 	};
 }
 
-float getDcOffset(const AudioClip& audioClip) {
-	int flatMeanSampleCount, fadingMeanSampleCount;
-	const int sampleRate = audioClip.getSampleRate();
-	if (audioClip.size() > 4 * sampleRate) {
+void DcOffset::readUnsafeBlock(size_type start, size_type count, value_type* out) const {
+	inputClip->readBlock(start, count, out);
+	for (size_type i = 0; i < count; ++i) {
+		out[i] = out[i] * factor + offset;
+	}
+}
+
+DcOffsetEstimator::DcOffsetEstimator(AudioClip::size_type clipSize, int sampleRate) {
+	if (clipSize > 4 * sampleRate) {
 		// Long audio file. Average over the first 3 seconds, then fade out over the 4th.
-		flatMeanSampleCount = 3 * sampleRate;
-		fadingMeanSampleCount = 1 * sampleRate;
+		flatSampleCount = 3 * sampleRate;
+		fadingSampleCount = 1 * sampleRate;
 	} else {
 		// Short audio file. Average over the entire duration.
-		flatMeanSampleCount = static_cast<int>(audioClip.size());
-		fadingMeanSampleCount = 0;
+		flatSampleCount = clipSize;
+		fadingSampleCount = 0;
 	}
+}
 
-	const auto read = audioClip.createSampleReader();
-	double sum = 0;
-	for (int i = 0; i < flatMeanSampleCount; ++i) {
-		sum += read(i);
+void DcOffsetEstimator::add(AudioClip::size_type start, const float* samples, AudioClip::size_type count) {
+	count = std::min(count, getSampleCount() - start);
+	for (AudioClip::size_type j = 0; j < count; ++j) {
+		const AudioClip::size_type index = start + j;
+		if (index < flatSampleCount) {
+			sum += samples[j];
+		} else {
+			const AudioClip::size_type i = index - flatSampleCount;
+			const double weight = static_cast<double>(fadingSampleCount - i) / fadingSampleCount;
+			sum += samples[j] * weight;
+		}
 	}
-	for (int i = 0; i < fadingMeanSampleCount; ++i) {
-		const double weight =
-			static_cast<double>(fadingMeanSampleCount - i) / fadingMeanSampleCount;
-		sum += read(flatMeanSampleCount + i) * weight;
+}
+
+float DcOffsetEstimator::getOffset() const {
+	const double totalWeight = flatSampleCount + (fadingSampleCount + 1) / 2.0;
+	return static_cast<float>(sum / totalWeight);
+}
+
+RunningDcOffset::RunningDcOffset(int sampleRate, double timeConstantSeconds) :
+	fullWeightSampleCount(sampleRate * timeConstantSeconds)
+{}
+
+void RunningDcOffset::add(const int16_t* samples, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		// A plain mean until the time constant is reached, then an exponential moving average
+		sampleCount = std::min(sampleCount + 1, fullWeightSampleCount);
+		mean += (samples[i] / 32768.0 - mean) / sampleCount;
 	}
+}
 
-	const double totalWeight = flatMeanSampleCount + (fadingMeanSampleCount + 1) / 2.0;
-	const double offset = sum / totalWeight;
-	return static_cast<float>(offset);
+void RunningDcOffset::setState(double sampleCount, double mean) {
+	this->sampleCount = std::min(std::max(sampleCount, 0.0), fullWeightSampleCount);
+	this->mean = mean;
+}
+
+float getDcOffset(const AudioClip& audioClip) {
+	DcOffsetEstimator estimator(audioClip.size(), audioClip.getSampleRate());
+
+	// Read the samples in blocks
+	constexpr AudioClip::size_type blockSize = 4096;
+	std::vector<float> block(blockSize);
+	const AudioClip::size_type sampleCount = estimator.getSampleCount();
+	for (AudioClip::size_type blockStart = 0; blockStart < sampleCount; blockStart += blockSize) {
+		const AudioClip::size_type count = std::min(blockSize, sampleCount - blockStart);
+		audioClip.readBlock(blockStart, count, block.data());
+		estimator.add(blockStart, block.data(), count);
+	}
+
+	return estimator.getOffset();
 }
 
 AudioEffect addDcOffset(float offset, float epsilon) {
@@ -67,3 +113,41 @@ AudioEffect removeDcOffset(float epsilon) {
 		return std::move(inputClip) | addDcOffset(-offset, epsilon);
 	};
 }
+
+AudioEffect removeDcOffsetTo16bit(float epsilon) {
+	return [epsilon](unique_ptr<AudioClip> inputClip) -> unique_ptr<AudioClip> {
+		const AudioClip::size_type size = inputClip->size();
+		const auto buffer = std::make_shared<std::vector<int16_t>>(static_cast<size_t>(size));
+
+		// Keep the leading samples as floats until the offset is known
+		DcOffsetEstimator estimator(size, inputClip->getSampleRate());
+		const AudioClip::size_type leadingSampleCount = estimator.getSampleCount();
+		std::vector<float> samples(static_cast<size_t>(leadingSampleCount));
+		inputClip->readBlock(0, leadingSampleCount, samples.data());
+		estimator.add(0, samples.data(), leadingSampleCount);
+
+		// Apply the offset like DcOffset
+		const float dcOffset = estimator.getOffset();
+		const float offset = std::abs(dcOffset) < epsilon ? 0.0f : -dcOffset;
+		const float factor = 1 / (1 + std::abs(offset));
+		const auto convert = [&](AudioClip::size_type start, AudioClip::size_type count) {
+			std::transform(samples.begin(), samples.begin() + count, samples.begin(),
+				[&](float sample) { return sample * factor + offset; });
+			floatSamplesToInt16(samples.data(), static_cast<size_t>(count), buffer->data() + start);
+		};
+		convert(0, leadingSampleCount);
+
+		// Convert the remaining samples block by block
+		constexpr AudioClip::size_type blockSize = 4096;
+		samples.resize(blockSize);
+		for (AudioClip::size_type blockStart = leadingSampleCount; blockStart < size; blockStart += blockSize) {
+			const AudioClip::size_type count = std::min(blockSize, size - blockStart);
+			inputClip->readBlock(blockStart, count, samples.data());
+			convert(blockStart, count);
+		}
+
+		// Share ownership of the vector while pointing to its data
+		std::shared_ptr<const int16_t> bufferData(buffer, buffer->data());
+		return make_unique<Int16AudioClip>(std::move(bufferData), size, inputClip->getSampleRate());
+	};
+}
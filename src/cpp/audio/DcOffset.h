@@ -12,6 +12,7 @@ public:
 	size_type size() const override;
 private:
 	SampleReader createUnsafeSampleReader() const override;
+	void readUnsafeBlock(size_type start, size_type count, value_type* out) const override;
 
 	std::shared_ptr<AudioClip> inputClip;
 	float offset;
@@ -26,7 +27,54 @@ inline AudioClip::size_type DcOffset::size() const {
 	return inputClip->size();
 }
 
+// Estimates the DC offset of a clip from its leading samples, which are added block by block.
+// Long clips are averaged over their first 3 seconds, fading out over the 4th; short ones over
+// their entire duration.
+class DcOffsetEstimator {
+public:
+	DcOffsetEstimator(AudioClip::size_type clipSize, int sampleRate);
+
+	// The number of leading samples the estimate is based on
+	AudioClip::size_type getSampleCount() const { return flatSampleCount + fadingSampleCount; }
+
+	// Adds consecutive samples starting at the specified index. Samples beyond getSampleCount()
+	// are ignored.
+	void add(AudioClip::size_type start, const float* samples, AudioClip::size_type count);
+
+	float getOffset() const;
+
+private:
+	AudioClip::size_type flatSampleCount;
+	AudioClip::size_type fadingSampleCount;
+	double sum = 0;
+};
+
+// Tracks the DC offset of a stream as a running mean of the samples so far, with older samples
+// fading out. Unlike DcOffsetEstimator, it doesn't need the first seconds of audio up front.
+class RunningDcOffset {
+public:
+	explicit RunningDcOffset(int sampleRate, double timeConstantSeconds = 3.0);
+
+	void add(const int16_t* samples, size_t count);
+
+	float getOffset() const { return static_cast<float>(mean); }
+
+	// The number of samples the mean weighs, and the mean, e.g. to continue in another process
+	double getSampleCount() const { return sampleCount; }
+	double getMean() const { return mean; }
+	void setState(double sampleCount, double mean);
+
+private:
+	double fullWeightSampleCount;
+	double sampleCount = 0;
+	double mean = 0;
+};
+
 float getDcOffset(const AudioClip& audioClip);
 
 AudioEffect addDcOffset(float offset, float epsilon = 1.0f / 15000);
 AudioEffect removeDcOffset(float epsilon = 1.0f / 15000);
+
+// Like removeDcOffset() followed by buffer16bit(), but evaluates the input clip only once:
+// The offset is estimated from the leading samples read for the buffer.
+AudioEffect removeDcOffsetTo16bit(float epsilon = 1.0f / 15000);
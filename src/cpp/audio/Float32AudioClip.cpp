@@ -0,0 +1,62 @@
+#include "Float32AudioClip.h"
+#include <algorithm>
+#include <stdexcept>
+
+using std::unique_ptr;
+using std::make_unique;
+using std::shared_ptr;
+using std::invalid_argument;
+
+Float32AudioClip::Float32AudioClip(
+	shared_ptr<const float> samples, size_type frameCount, int channelCount, int sampleRate
+) :
+	samples(std::move(samples)),
+	frameCount(frameCount),
+	channelCount(channelCount),
+	sampleRate(sampleRate)
+{
+	if (sampleRate <= 0) {
+		throw invalid_argument("Sample rate must be positive.");
+	}
+	if (channelCount <= 0) {
+		throw invalid_argument("Channel count must be positive.");
+	}
+	if (frameCount < 0) {
+		throw invalid_argument("Frame count must not be negative.");
+	}
+	if (!this->samples && frameCount > 0) {
+		throw invalid_argument("Samples cannot be null.");
+	}
+}
+
+unique_ptr<AudioClip> Float32AudioClip::clone() const {
+	return make_unique<Float32AudioClip>(*this);
+}
+
+SampleReader Float32AudioClip::createUnsafeSampleReader() const {
+	return [samples = samples, channelCount = channelCount](size_type index) {
+		const float* frame = samples.get() + index * channelCount;
+		float sum = 0.0f;
+		for (int channel = 0; channel < channelCount; ++channel) {
+			sum += frame[channel];
+		}
+		return sum / channelCount;
+	};
+}
+
+void Float32AudioClip::readUnsafeBlock(size_type start, size_type count, value_type* out) const {
+	const float* block = samples.get() + start * channelCount;
+	if (channelCount == 1) {
+		std::copy(block, block + count, out);
+		return;
+	}
+
+	for (size_type i = 0; i < count; ++i) {
+		const float* frame = block + i * channelCount;
+		float sum = 0.0f;
+		for (int channel = 0; channel < channelCount; ++channel) {
+			sum += frame[channel];
+		}
+		out[i] = sum / channelCount;
+	}
+}
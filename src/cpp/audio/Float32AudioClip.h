@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory>
+#include "AudioClip.h"
+
+// An audio clip backed by a buffer of 32-bit float samples in [-1.0, 1.0].
+// The buffer may hold several interleaved channels, which are mixed down to mono when read.
+// Clones share the buffer, which may or may not be owned by the clip.
+class Float32AudioClip : public AudioClip {
+public:
+	Float32AudioClip(
+		std::shared_ptr<const float> samples, size_type frameCount, int channelCount, int sampleRate
+	);
+	std::unique_ptr<AudioClip> clone() const override;
+	int getSampleRate() const override;
+	size_type size() const override;
+private:
+	SampleReader createUnsafeSampleReader() const override;
+	void readUnsafeBlock(size_type start, size_type count, value_type* out) const override;
+
+	std::shared_ptr<const float> samples;
+	size_type frameCount;
+	int channelCount;
+	int sampleRate;
+};
+
+inline int Float32AudioClip::getSampleRate() const {
+	return sampleRate;
+}
+
+inline AudioClip::size_type Float32AudioClip::size() const {
+	return frameCount;
+}
@@ -0,0 +1,56 @@
+#include "Int16AudioClip.h"
+#include "processing.h"
+#include <vector>
+#include <stdexcept>
+
+using std::unique_ptr;
+using std::make_unique;
+using std::shared_ptr;
+using std::vector;
+using std::invalid_argument;
+
+Int16AudioClip::Int16AudioClip(shared_ptr<const int16_t> samples, size_type sampleCount, int sampleRate) :
+	samples(std::move(samples)),
+	sampleCount(sampleCount),
+	sampleRate(sampleRate)
+{
+	if (sampleRate <= 0) {
+		throw invalid_argument("Sample rate must be positive.");
+	}
+	if (sampleCount < 0) {
+		throw invalid_argument("Sample count must not be negative.");
+	}
+	if (!this->samples && sampleCount > 0) {
+		throw invalid_argument("Samples cannot be null.");
+	}
+}
+
+unique_ptr<AudioClip> Int16AudioClip::clone() const {
+	return make_unique<Int16AudioClip>(*this);
+}
+
+SampleReader Int16AudioClip::createUnsafeSampleReader() const {
+	return [samples = samples](size_type index) {
+		// Convert int16 [-32768, 32767] to float [-1.0, 1.0]
+		return static_cast<float>(samples.get()[index]) / 32768.0f;
+	};
+}
+
+void Int16AudioClip::readUnsafeBlock(size_type start, size_type count, value_type* out) const {
+	int16SamplesToFloat(samples.get() + start, static_cast<size_t>(count), out);
+}
+
+AudioEffect buffer16bit() {
+	return [](unique_ptr<AudioClip> inputClip) -> unique_ptr<AudioClip> {
+		if (inputClip->get16bitBuffer()) return inputClip;
+
+		const auto buffer = std::make_shared<const vector<int16_t>>(copyTo16bitBuffer(*inputClip));
+		// Share ownership of the vector while pointing to its data
+		shared_ptr<const int16_t> samples(buffer, buffer->data());
+		return make_unique<Int16AudioClip>(
+			std::move(samples),
+			static_cast<AudioClip::size_type>(buffer->size()),
+			inputClip->getSampleRate()
+		);
+	};
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <memory>
+#include <cstdint>
+#include "AudioClip.h"
+
+// An audio clip backed by a buffer of 16-bit samples.
+// Clones share the buffer, which may or may not be owned by the clip.
+class Int16AudioClip : public AudioClip {
+public:
+	Int16AudioClip(std::shared_ptr<const int16_t> samples, size_type sampleCount, int sampleRate);
+	std::unique_ptr<AudioClip> clone() const override;
+	int getSampleRate() const override;
+	size_type size() const override;
+	const int16_t* get16bitBuffer() const override;
+private:
+	SampleReader createUnsafeSampleReader() const override;
+	void readUnsafeBlock(size_type start, size_type count, value_type* out) const override;
+
+	std::shared_ptr<const int16_t> samples;
+	size_type sampleCount;
+	int sampleRate;
+};
+
+inline int Int16AudioClip::getSampleRate() const {
+	return sampleRate;
+}
+
+inline AudioClip::size_type Int16AudioClip::size() const {
+	return sampleCount;
+}
+
+inline const int16_t* Int16AudioClip::get16bitBuffer() const {
+	return samples.get();
+}
+
+// Evaluates the input clip once, storing its samples in a 16-bit buffer.
+// Use this before reading the same samples repeatedly through expensive effects.
+AudioEffect buffer16bit();
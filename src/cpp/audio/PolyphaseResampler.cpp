@@ -0,0 +1,195 @@
+#include "PolyphaseResampler.h"
+#include <cmath>
+#include <numeric>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <format.h>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+using std::invalid_argument;
+using std::unique_ptr;
+using std::make_unique;
+using std::vector;
+
+// Zero crossings of the sinc function on each side of the filter center, at the cutoff frequency.
+// More give a steeper transition band at the cost of more taps.
+constexpr int zeroCrossingCount = 16;
+
+// The cutoff frequency relative to the lower of the two Nyquist frequencies
+constexpr double relativeCutoff = 0.95;
+
+// Above this many phases, output positions are rounded to the nearest of this many phases.
+// This bounds the filter size for awkward ratios like 44101:16000.
+constexpr int64_t maxPhaseCount = 1024;
+
+// Taps are padded to a multiple of this for SIMD
+constexpr int tapAlignment = 4;
+
+// The filter for one conversion ratio.
+// Output sample n lies at input position n * inputStep / outputStep. Its value is the dot product
+// of the input samples starting at getFirstInputIndex(n) and the taps of its phase.
+struct PolyphaseFilter {
+	PolyphaseFilter(int inputSampleRate, int outputSampleRate);
+
+	int64_t getFirstInputIndex(int64_t outputIndex, int& phase) const;
+	const float* getTaps(int phase) const {
+		return taps.data() + static_cast<size_t>(phase) * tapStride;
+	}
+
+	// The ratio of input to output positions, in lowest terms
+	int64_t inputStep, outputStep;
+	int64_t phaseCount;
+	// Input samples on each side of the output position that contribute to it
+	int halfWidth;
+	// Taps per phase, including padding
+	int tapStride;
+	vector<float> taps;
+};
+
+PolyphaseFilter::PolyphaseFilter(int inputSampleRate, int outputSampleRate) {
+	const int divisor = std::gcd(inputSampleRate, outputSampleRate);
+	inputStep = inputSampleRate / divisor;
+	outputStep = outputSampleRate / divisor;
+	phaseCount = std::min(outputStep, maxPhaseCount);
+
+	// When downsampling, the cutoff must be below the output Nyquist frequency,
+	// widening the filter in terms of input samples
+	const double cutoff =
+		relativeCutoff * std::min(1.0, static_cast<double>(outputSampleRate) / inputSampleRate);
+	halfWidth = static_cast<int>(std::ceil(zeroCrossingCount / cutoff));
+	const int tapCount = 2 * halfWidth;
+	tapStride = (tapCount + tapAlignment - 1) / tapAlignment * tapAlignment;
+
+	taps.assign(static_cast<size_t>(phaseCount) * tapStride, 0.0f);
+	const double pi = std::acos(-1.0);
+	for (int phase = 0; phase < phaseCount; ++phase) {
+		float* phaseTaps = taps.data() + static_cast<size_t>(phase) * tapStride;
+		double sum = 0;
+		for (int k = 0; k < tapCount; ++k) {
+			// Distance of the input sample from the output position, in input samples
+			const double distance = static_cast<double>(phase) / phaseCount + halfWidth - 1 - k;
+			const double x = cutoff * distance;
+			const double sinc = x == 0 ? 1.0 : std::sin(pi * x) / (pi * x);
+			// Blackman window
+			const double w = distance / halfWidth;
+			const double window = 0.42 + 0.5 * std::cos(pi * w) + 0.08 * std::cos(2 * pi * w);
+			const double tap = std::abs(w) < 1 ? sinc * window : 0.0;
+			phaseTaps[k] = static_cast<float>(tap);
+			sum += tap;
+		}
+
+		// Normalize to unity gain at DC
+		for (int k = 0; k < tapCount; ++k) {
+			phaseTaps[k] = static_cast<float>(phaseTaps[k] / sum);
+		}
+	}
+}
+
+int64_t PolyphaseFilter::getFirstInputIndex(int64_t outputIndex, int& phase) const {
+	const int64_t position = outputIndex * inputStep;
+	int64_t inputIndex = position / outputStep;
+	int64_t remainder = position % outputStep;
+	if (phaseCount != outputStep) {
+		remainder = (remainder * phaseCount * 2 + outputStep) / (outputStep * 2);
+		if (remainder == phaseCount) {
+			++inputIndex;
+			remainder = 0;
+		}
+	}
+	phase = static_cast<int>(remainder);
+	return inputIndex + 1 - halfWidth;
+}
+
+// Returns the dot product of two arrays whose length is a multiple of tapAlignment
+inline float dotProduct(const float* a, const float* b, int count) {
+#if defined(__wasm_simd128__)
+	v128_t sum = wasm_f32x4_splat(0.0f);
+	for (int i = 0; i < count; i += 4) {
+		sum = wasm_f32x4_add(sum, wasm_f32x4_mul(wasm_v128_load(a + i), wasm_v128_load(b + i)));
+	}
+	return wasm_f32x4_extract_lane(sum, 0) + wasm_f32x4_extract_lane(sum, 1)
+		+ wasm_f32x4_extract_lane(sum, 2) + wasm_f32x4_extract_lane(sum, 3);
+#elif defined(__SSE__)
+	__m128 sum = _mm_setzero_ps();
+	for (int i = 0; i < count; i += 4) {
+		sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+	}
+	alignas(16) float lanes[4];
+	_mm_store_ps(lanes, sum);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+	float sum[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < count; i += 4) {
+		for (int lane = 0; lane < 4; ++lane) {
+			sum[lane] += a[i + lane] * b[i + lane];
+		}
+	}
+	return sum[0] + sum[1] + sum[2] + sum[3];
+#endif
+}
+
+PolyphaseResampler::PolyphaseResampler(unique_ptr<AudioClip> inputClip, int outputSampleRate) :
+	inputClip(std::move(inputClip)),
+	outputSampleRate(outputSampleRate)
+{
+	if (outputSampleRate <= 0) {
+		throw invalid_argument("Sample rate must be positive.");
+	}
+	const int inputSampleRate = this->inputClip->getSampleRate();
+	if (inputSampleRate <= 0) {
+		throw invalid_argument(fmt::format("Invalid input sample rate {}Hz.", inputSampleRate));
+	}
+
+	filter = std::make_shared<PolyphaseFilter>(inputSampleRate, outputSampleRate);
+	const double downscalingFactor = static_cast<double>(inputSampleRate) / outputSampleRate;
+	outputSampleCount = std::lround(this->inputClip->size() / downscalingFactor);
+}
+
+unique_ptr<AudioClip> PolyphaseResampler::clone() const {
+	return make_unique<PolyphaseResampler>(*this);
+}
+
+SampleReader PolyphaseResampler::createUnsafeSampleReader() const {
+	return [
+		read = inputClip->createSampleReader(),
+		filter = filter,
+		inputSize = inputClip->size(),
+		input = vector<float>(static_cast<size_t>(filter->tapStride))
+	](size_type index) mutable {
+		int phase;
+		const int64_t firstInputIndex = filter->getFirstInputIndex(index, phase);
+		for (int k = 0; k < filter->tapStride; ++k) {
+			const int64_t inputIndex = firstInputIndex + k;
+			input[k] = inputIndex >= 0 && inputIndex < inputSize ? read(inputIndex) : 0.0f;
+		}
+		return dotProduct(input.data(), filter->getTaps(phase), filter->tapStride);
+	};
+}
+
+void PolyphaseResampler::readUnsafeBlock(size_type start, size_type count, value_type* out) const {
+	// Read all input samples contributing to the output samples at once, padded with silence
+	int phase;
+	const int64_t inputStart = filter->getFirstInputIndex(start, phase);
+	const int64_t inputEnd = filter->getFirstInputIndex(start + count - 1, phase) + filter->tapStride;
+	vector<float> input(static_cast<size_t>(inputEnd - inputStart), 0.0f);
+	const int64_t readStart = std::max<int64_t>(inputStart, 0);
+	const int64_t readEnd = std::min<int64_t>(inputEnd, inputClip->size());
+	if (readEnd > readStart) {
+		inputClip->readBlock(readStart, readEnd - readStart, input.data() + (readStart - inputStart));
+	}
+
+	for (size_type i = 0; i < count; ++i) {
+		const int64_t firstInputIndex = filter->getFirstInputIndex(start + i, phase);
+		out[i] = dotProduct(
+			input.data() + (firstInputIndex - inputStart),
+			filter->getTaps(phase),
+			filter->tapStride
+		);
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory>
+#include "AudioClip.h"
+
+struct PolyphaseFilter;
+
+// Converts the sample rate of an audio clip using a windowed-sinc polyphase filter.
+// Supports both upsampling and downsampling by arbitrary ratios.
+// Samples beyond the input clip are treated as silence.
+class PolyphaseResampler : public AudioClip {
+public:
+	PolyphaseResampler(std::unique_ptr<AudioClip> inputClip, int outputSampleRate);
+	std::unique_ptr<AudioClip> clone() const override;
+	int getSampleRate() const override;
+	size_type size() const override;
+private:
+	SampleReader createUnsafeSampleReader() const override;
+	void readUnsafeBlock(size_type start, size_type count, value_type* out) const override;
+
+	std::shared_ptr<AudioClip> inputClip;
+	std::shared_ptr<const PolyphaseFilter> filter;
+	int outputSampleRate;
+	int64_t outputSampleCount;
+};
+
+inline int PolyphaseResampler::getSampleRate() const {
+	return outputSampleRate;
+}
+
+inline AudioClip::size_type PolyphaseResampler::size() const {
+	return outputSampleCount;
+}
@@ -1,6 +1,9 @@
 #include <cmath>
 #include "SampleRateConverter.h"
+#include "PolyphaseResampler.h"
 #include <stdexcept>
+#include <vector>
+#include <algorithm>
 #include <format.h>
 
 using std::invalid_argument;
@@ -10,6 +13,9 @@ using std::make_unique;
 SampleRateConverter::SampleRateConverter(unique_ptr<AudioClip> inputClip, int outputSampleRate) :
 	inputClip(std::move(inputClip)),
 	downscalingFactor(static_cast<double>(this->inputClip->getSampleRate()) / outputSampleRate),
+	groupSize(outputSampleRate > 0 && this->inputClip->getSampleRate() % outputSampleRate == 0
+		? this->inputClip->getSampleRate() / outputSampleRate
+		: 0),
 	outputSampleRate(outputSampleRate),
 	outputSampleCount(std::lround(this->inputClip->size() / downscalingFactor))
 {
@@ -28,7 +34,8 @@ unique_ptr<AudioClip> SampleRateConverter::clone() const {
 	return make_unique<SampleRateConverter>(*this);
 }
 
-float mean(double inputStart, double inputEnd, const SampleReader& read) {
+template<typename Read>
+float mean(double inputStart, double inputEnd, const Read& read) {
 	// Calculate weighted sum...
 	double sum = 0;
 
@@ -50,6 +57,21 @@ float mean(double inputStart, double inputEnd, const SampleReader& read) {
 	return static_cast<float>(sum / (inputEnd - inputStart));
 }
 
+// Averages consecutive groups of input samples, as mean() does for an integer downscaling factor.
+// The sums are formed in the same order, so the results are identical. A non-zero StaticGroupSize
+// fixes the group size at compile time, for the common conversions.
+template<int StaticGroupSize>
+void averageGroups(const AudioClip::value_type* input, int64_t count, int groupSize, AudioClip::value_type* out) {
+	if (StaticGroupSize > 0) groupSize = StaticGroupSize;
+	for (int64_t i = 0; i < count; ++i, input += groupSize) {
+		double sum = 0;
+		for (int j = 0; j < groupSize; ++j) {
+			sum += input[j];
+		}
+		out[i] = static_cast<float>(sum / groupSize);
+	}
+}
+
 SampleReader SampleRateConverter::createUnsafeSampleReader() const {
 	return [
 		read = inputClip->createSampleReader(),
@@ -63,8 +85,58 @@ SampleReader SampleRateConverter::createUnsafeSampleReader() const {
 	};
 }
 
+void SampleRateConverter::readUnsafeBlock(size_type start, size_type count, value_type* out) const {
+	// Read all input samples contributing to the output samples at once
+	const double inputSize = static_cast<double>(inputClip->size());
+	const int64_t inputStart = static_cast<int64_t>(start * downscalingFactor);
+	const int64_t inputEnd = std::max(
+		static_cast<int64_t>(std::ceil(std::min((start + count) * downscalingFactor, inputSize))),
+		inputStart + 1
+	);
+	std::vector<value_type> input(static_cast<size_t>(inputEnd - inputStart));
+	inputClip->readBlock(inputStart, inputEnd - inputStart, input.data());
+
+	const auto read = [&input, inputStart](int64_t index) {
+		return input[static_cast<size_t>(index - inputStart)];
+	};
+	size_type i = 0;
+	if (groupSize > 0) {
+		// Output samples averaging whole groups; a final partial group is left to mean()
+		const size_type groupCount = std::clamp<size_type>(inputClip->size() / groupSize - start, 0, count);
+		switch (groupSize) {
+			// 16 kHz to 8 kHz, 48 kHz to 16 kHz and 48 kHz to 8 kHz
+			case 2: averageGroups<2>(input.data(), groupCount, groupSize, out); break;
+			case 3: averageGroups<3>(input.data(), groupCount, groupSize, out); break;
+			case 6: averageGroups<6>(input.data(), groupCount, groupSize, out); break;
+			default: averageGroups<0>(input.data(), groupCount, groupSize, out); break;
+		}
+		i = groupCount;
+	}
+	for (; i < count; ++i) {
+		const size_type index = start + i;
+		const double sampleStart = index * downscalingFactor;
+		const double sampleEnd = std::min((index + 1) * downscalingFactor, inputSize);
+		out[i] = mean(sampleStart, sampleEnd, read);
+	}
+}
+
 AudioEffect resample(int sampleRate) {
 	return [sampleRate](unique_ptr<AudioClip> inputClip) {
+		const ResamplingMethod method = inputClip->getSampleRate() < sampleRate
+			? ResamplingMethod::Polyphase
+			: ResamplingMethod::Mean;
+		return std::move(inputClip) | resample(sampleRate, method);
+	};
+}
+
+AudioEffect resample(int sampleRate, ResamplingMethod method) {
+	return [sampleRate, method](unique_ptr<AudioClip> inputClip) -> unique_ptr<AudioClip> {
+		// Both methods leave the samples unchanged at the same rate
+		if (inputClip->getSampleRate() == sampleRate) return inputClip;
+
+		if (method == ResamplingMethod::Polyphase) {
+			return make_unique<PolyphaseResampler>(std::move(inputClip), sampleRate);
+		}
 		return make_unique<SampleRateConverter>(std::move(inputClip), sampleRate);
 	};
 }
@@ -3,6 +3,8 @@
 #include <memory>
 #include "AudioClip.h"
 
+// Converts the sample rate of an audio clip by averaging the input samples covered by each output
+// sample. Fast, but only supports downsampling.
 class SampleRateConverter : public AudioClip {
 public:
 	SampleRateConverter(std::unique_ptr<AudioClip> inputClip, int outputSampleRate);
@@ -11,15 +13,28 @@ public:
 	size_type size() const override;
 private:
 	SampleReader createUnsafeSampleReader() const override;
+	void readUnsafeBlock(size_type start, size_type count, value_type* out) const override;
 
 	std::shared_ptr<AudioClip> inputClip;
 	double downscalingFactor; // input sample rate / output sample rate
+	int groupSize; // downscalingFactor if it is an integer, else 0
 	int outputSampleRate;
 	int64_t outputSampleCount;
 };
 
+enum class ResamplingMethod {
+	// Averages input samples (SampleRateConverter). Downsampling only.
+	Mean,
+	// Windowed-sinc polyphase filter (PolyphaseResampler). Better anti-aliasing; supports upsampling.
+	Polyphase
+};
+
+// Uses the mean method when downsampling, which is what the recognition models are tuned to,
+// and the polyphase method when upsampling
 AudioEffect resample(int sampleRate);
 
+AudioEffect resample(int sampleRate, ResamplingMethod method);
+
 inline int SampleRateConverter::getSampleRate() const {
 	return outputSampleRate;
 }
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include "time/TimeRange.h"
+
+// Maps between sample indexes and centiseconds at a sample rate.
+// Centisecond c starts at sample floor(c * sampleRate / 100), and sample i lies in centisecond
+// floor(100 * i / sampleRate), so the samples of consecutive centiseconds tile without gaps or
+// overlaps. All arithmetic is 64-bit. Rates that are multiples of 100, such as the recognizer's,
+// take a multiplication or division by the samples per centisecond instead of two operations.
+class Timebase {
+public:
+	constexpr explicit Timebase(int sampleRate) :
+		sampleRate(sampleRate),
+		samplesPerCentisecond(sampleRate % 100 == 0 ? sampleRate / 100 : 0)
+	{}
+
+	constexpr int getSampleRate() const {
+		return sampleRate;
+	}
+
+	// The first sample of the given centisecond
+	constexpr int64_t toSampleIndex(centiseconds time) const {
+		return samplesPerCentisecond
+			? static_cast<int64_t>(time.count()) * samplesPerCentisecond
+			: static_cast<int64_t>(time.count()) * sampleRate / 100;
+	}
+
+	// The centisecond containing the given sample
+	constexpr centiseconds toCentiseconds(int64_t sampleIndex) const {
+		return centiseconds(static_cast<centiseconds::rep>(samplesPerCentisecond
+			? sampleIndex / samplesPerCentisecond
+			: 100 * sampleIndex / sampleRate));
+	}
+
+	// The number of samples from the start of one centisecond to the start of another
+	int64_t toSampleCount(const TimeRange& range) const {
+		return toSampleIndex(range.getEnd()) - toSampleIndex(range.getStart());
+	}
+
+	// The whole centiseconds covered by the given number of samples
+	TimeRange getTruncatedRange(int64_t sampleCount) const {
+		return TimeRange(0_cs, toCentiseconds(sampleCount));
+	}
+
+private:
+	int sampleRate;
+	// 0 unless the sample rate is a multiple of 100
+	int samplesPerCentisecond;
+};
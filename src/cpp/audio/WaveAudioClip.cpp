@@ -0,0 +1,145 @@
+#include "WaveAudioClip.h"
+#include <format.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using std::unique_ptr;
+using std::make_unique;
+using std::shared_ptr;
+using std::runtime_error;
+
+namespace {
+
+	constexpr uint16_t formatTagPcm = 0x0001;
+	constexpr uint16_t formatTagFloat = 0x0003;
+	constexpr uint16_t formatTagExtensible = 0xFFFE;
+
+	uint32_t readUInt(const uint8_t* data, int byteCount) {
+		uint32_t result = 0;
+		for (int i = 0; i < byteCount; ++i) {
+			result |= static_cast<uint32_t>(data[i]) << (8 * i);
+		}
+		return result;
+	}
+
+	// Reads a little-endian sample, scaled to [-1, 1)
+	float readSample(const uint8_t* data, int bytesPerSample, bool isFloat) {
+		if (isFloat) {
+			const uint32_t bits = readUInt(data, 4);
+			float value;
+			std::memcpy(&value, &bits, sizeof value);
+			return value;
+		}
+
+		// 8-bit samples are unsigned, wider ones signed
+		const int bitCount = 8 * bytesPerSample;
+		const uint32_t raw = readUInt(data, bytesPerSample);
+		const int64_t value = bytesPerSample == 1
+			? static_cast<int64_t>(raw) - 128
+			: static_cast<int64_t>(raw ^ (1u << (bitCount - 1))) - (int64_t(1) << (bitCount - 1));
+		return static_cast<float>(static_cast<double>(value) / static_cast<double>(int64_t(1) << (bitCount - 1)));
+	}
+
+	bool isLittleEndian() {
+		const uint16_t value = 1;
+		uint8_t firstByte;
+		std::memcpy(&firstByte, &value, 1);
+		return firstByte == 1;
+	}
+
+}
+
+WaveAudioClip::WaveAudioClip(shared_ptr<const uint8_t> bytes, size_t byteCount) :
+	bytes(std::move(bytes))
+{
+	const uint8_t* file = this->bytes.get();
+	if (!file || byteCount < 12 || std::memcmp(file, "RIFF", 4) || std::memcmp(file + 8, "WAVE", 4)) {
+		throw runtime_error("Not a WAVE file.");
+	}
+
+	// Chunks are word-aligned; a truncated data chunk is read as far as it goes
+	size_t dataSize = 0;
+	size_t offset = 12;
+	while (offset + 8 <= byteCount && !data) {
+		const uint8_t* chunk = file + offset;
+		const size_t chunkSize = std::min<size_t>(readUInt(chunk + 4, 4), byteCount - offset - 8);
+		if (!std::memcmp(chunk, "fmt ", 4)) {
+			if (chunkSize < 16) {
+				throw runtime_error("Invalid format chunk.");
+			}
+			uint16_t formatTag = static_cast<uint16_t>(readUInt(chunk + 8, 2));
+			if (formatTag == formatTagExtensible && chunkSize >= 26) {
+				// The sub-format GUID starts with the actual format tag
+				formatTag = static_cast<uint16_t>(readUInt(chunk + 32, 2));
+			}
+			channelCount = static_cast<int>(readUInt(chunk + 10, 2));
+			sampleRate = static_cast<int>(readUInt(chunk + 12, 4));
+			bytesPerSample = (static_cast<int>(readUInt(chunk + 22, 2)) + 7) / 8;
+			if (formatTag == formatTagPcm && bytesPerSample >= 1 && bytesPerSample <= 4) {
+				sampleFormat = SampleFormat::Int;
+			} else if (formatTag == formatTagFloat && bytesPerSample == 4) {
+				sampleFormat = SampleFormat::Float;
+			} else {
+				throw runtime_error(fmt::format(
+					"Unsupported sample format (format tag {}, {} bits per sample).",
+					formatTag, readUInt(chunk + 22, 2)));
+			}
+		} else if (!std::memcmp(chunk, "data", 4)) {
+			if (!channelCount) {
+				throw runtime_error("No format chunk before the data.");
+			}
+			data = chunk + 8;
+			dataSize = chunkSize;
+		}
+		offset += 8 + chunkSize + (chunkSize & 1);
+	}
+
+	if (!data) {
+		throw runtime_error("No audio data.");
+	}
+	if (channelCount < 1 || sampleRate < 1) {
+		throw runtime_error("Invalid format.");
+	}
+	frameCount = static_cast<size_type>(dataSize / (static_cast<size_t>(channelCount) * bytesPerSample));
+}
+
+unique_ptr<AudioClip> WaveAudioClip::clone() const {
+	return make_unique<WaveAudioClip>(*this);
+}
+
+const int16_t* WaveAudioClip::get16bitBuffer() const {
+	static const bool littleEndian = isLittleEndian();
+	const bool aligned = reinterpret_cast<uintptr_t>(data) % alignof(int16_t) == 0;
+	return sampleFormat == SampleFormat::Int && bytesPerSample == 2 && channelCount == 1
+		&& littleEndian && aligned
+		? reinterpret_cast<const int16_t*>(data)
+		: nullptr;
+}
+
+SampleReader WaveAudioClip::createUnsafeSampleReader() const {
+	return [
+		bytes = bytes, data = data, channelCount = channelCount, bytesPerSample = bytesPerSample,
+		isFloat = sampleFormat == SampleFormat::Float
+	](size_type index) {
+		const uint8_t* frame = data + index * channelCount * bytesPerSample;
+		float sum = 0.0f;
+		for (int channel = 0; channel < channelCount; ++channel) {
+			sum += readSample(frame + channel * bytesPerSample, bytesPerSample, isFloat);
+		}
+		return sum / static_cast<float>(channelCount);
+	};
+}
+
+void WaveAudioClip::readUnsafeBlock(size_type start, size_type count, value_type* out) const {
+	const bool isFloat = sampleFormat == SampleFormat::Float;
+	const size_t frameSize = static_cast<size_t>(channelCount) * bytesPerSample;
+	const uint8_t* frame = data + static_cast<size_t>(start) * frameSize;
+	for (size_type i = 0; i < count; ++i, frame += frameSize) {
+		float sum = 0.0f;
+		for (int channel = 0; channel < channelCount; ++channel) {
+			sum += readSample(frame + channel * bytesPerSample, bytesPerSample, isFloat);
+		}
+		out[i] = sum / static_cast<float>(channelCount);
+	}
+}
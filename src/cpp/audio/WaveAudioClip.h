@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "AudioClip.h"
+
+// An audio clip backed by the bytes of a WAVE file with integer (8 to 32 bits) or 32-bit float
+// samples. Samples are decoded as they are read, and multiple channels are mixed down to mono, so
+// the file never exists decoded as a whole.
+// Clones share the bytes, which may or may not be owned by the clip.
+class WaveAudioClip : public AudioClip {
+public:
+	// Throws if the bytes are not a supported WAVE file. A truncated data chunk is read as far as
+	// it goes.
+	WaveAudioClip(std::shared_ptr<const uint8_t> bytes, size_t byteCount);
+	std::unique_ptr<AudioClip> clone() const override;
+	int getSampleRate() const override;
+	size_type size() const override;
+	// The samples themselves for mono 16-bit files, which need no decoding
+	const int16_t* get16bitBuffer() const override;
+private:
+	enum class SampleFormat {
+		Int,
+		Float
+	};
+
+	SampleReader createUnsafeSampleReader() const override;
+	void readUnsafeBlock(size_type start, size_type count, value_type* out) const override;
+
+	std::shared_ptr<const uint8_t> bytes;
+	// Start of the samples within bytes
+	const uint8_t* data = nullptr;
+	size_type frameCount = 0;
+	int channelCount = 0;
+	int bytesPerSample = 0;
+	SampleFormat sampleFormat = SampleFormat::Int;
+	int sampleRate = 0;
+};
+
+inline int WaveAudioClip::getSampleRate() const {
+	return sampleRate;
+}
+
+inline AudioClip::size_type WaveAudioClip::size() const {
+	return frameCount;
+}
@@ -0,0 +1,131 @@
+#include "energyGate.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <vector>
+
+using std::vector;
+
+namespace {
+
+	// Returns the sum and the sum of squares of the samples.
+	// Spread over independent lanes, so that the compiler can vectorize the loop.
+	void sumSamples(const float* samples, size_t count, double& sum, double& sumOfSquares) {
+		constexpr size_t laneCount = 8;
+		float lanes[laneCount] = {};
+		float squareLanes[laneCount] = {};
+		size_t i = 0;
+		for (; i + laneCount <= count; i += laneCount) {
+			for (size_t lane = 0; lane < laneCount; ++lane) {
+				const float sample = samples[i + lane];
+				lanes[lane] += sample;
+				squareLanes[lane] += sample * sample;
+			}
+		}
+		for (; i < count; ++i) {
+			lanes[0] += samples[i];
+			squareLanes[0] += samples[i] * samples[i];
+		}
+
+		sum = 0;
+		sumOfSquares = 0;
+		for (size_t lane = 0; lane < laneCount; ++lane) {
+			sum += lanes[lane];
+			sumOfSquares += squareLanes[lane];
+		}
+	}
+
+}
+
+JoiningBoundedTimeline<void> detectSound(
+	const AudioClip& audioClip,
+	float thresholdDb,
+	centiseconds minSilenceDuration,
+	centiseconds padding
+) {
+	const TimeRange clipRange = audioClip.getTruncatedRange();
+	JoiningBoundedTimeline<void> sound(clipRange);
+	sound.set(clipRange.getStart(), clipRange.getEnd());
+
+	// Removes a silence unless it is too short, keeping the padding next to sound
+	const auto removeSilence = [&](centiseconds start, centiseconds end) {
+		if (end - start < minSilenceDuration) return;
+		if (start > clipRange.getStart()) start += padding;
+		if (end < clipRange.getEnd()) end -= padding;
+		if (start < end) {
+			sound.clear(start, end);
+		}
+	};
+
+	// Classify the clip centisecond by centisecond, as that is the resolution of the result.
+	// The variance of a block is its energy without the DC offset.
+	const double threshold = std::pow(10.0, thresholdDb / 10.0);
+	const Timebase timebase = audioClip.getTimebase();
+	const AudioClip::size_type size = audioClip.size();
+	const centiseconds readDuration = 100_cs;
+	vector<float> buffer;
+	centiseconds silenceStart = clipRange.getStart();
+	for (centiseconds readStart = clipRange.getStart(); readStart < clipRange.getEnd(); readStart += readDuration) {
+		const centiseconds readEnd = std::min(readStart + readDuration, clipRange.getEnd());
+		const AudioClip::size_type firstSample = timebase.toSampleIndex(readStart);
+		const AudioClip::size_type lastSample = std::min(timebase.toSampleIndex(readEnd), size);
+		buffer.resize(static_cast<size_t>(lastSample - firstSample));
+		audioClip.readBlock(firstSample, lastSample - firstSample, buffer.data());
+
+		for (centiseconds block = readStart; block < readEnd; ++block) {
+			const AudioClip::size_type blockStart = timebase.toSampleIndex(block);
+			const AudioClip::size_type blockEnd = std::min(timebase.toSampleIndex(block + 1_cs), lastSample);
+			const size_t count = static_cast<size_t>(blockEnd - blockStart);
+			if (count == 0) continue;
+
+			double sum, sumOfSquares;
+			sumSamples(buffer.data() + (blockStart - firstSample), count, sum, sumOfSquares);
+			const double mean = sum / count;
+			const double variance = sumOfSquares / count - mean * mean;
+			if (variance >= threshold) {
+				removeSilence(silenceStart, block);
+				silenceStart = block + 1_cs;
+			}
+		}
+	}
+	removeSilence(silenceStart, clipRange.getEnd());
+
+	return sound;
+}
+
+centiseconds findQuietestPoint(const AudioClip& audioClip, const TimeRange& range) {
+	const TimeRange clipRange = audioClip.getTruncatedRange();
+	const centiseconds start = std::max(range.getStart(), clipRange.getStart());
+	const centiseconds end = std::min(range.getEnd(), clipRange.getEnd());
+	if (end - start < 3_cs) return start;
+
+	const Timebase timebase = audioClip.getTimebase();
+	const AudioClip::size_type firstSample = timebase.toSampleIndex(start);
+	const AudioClip::size_type lastSample = std::min(timebase.toSampleIndex(end), audioClip.size());
+	vector<float> buffer(static_cast<size_t>(lastSample - firstSample));
+	audioClip.readBlock(firstSample, lastSample - firstSample, buffer.data());
+
+	// The energy of each centisecond
+	vector<double> energies;
+	for (centiseconds block = start; block < end; ++block) {
+		const AudioClip::size_type blockStart = timebase.toSampleIndex(block);
+		const AudioClip::size_type blockEnd = std::min(timebase.toSampleIndex(block + 1_cs), lastSample);
+		const size_t count = static_cast<size_t>(blockEnd - blockStart);
+		double sum = 0, sumOfSquares = 0;
+		if (count > 0) {
+			sumSamples(buffer.data() + (blockStart - firstSample), count, sum, sumOfSquares);
+		}
+		energies.push_back(count > 0 ? sumOfSquares - sum * sum / count : 0);
+	}
+
+	size_t quietestIndex = 0;
+	double quietestEnergy = std::numeric_limits<double>::max();
+	for (size_t i = 0; i + 3 <= energies.size(); ++i) {
+		const double energy = energies[i] + energies[i + 1] + energies[i + 2];
+		if (energy < quietestEnergy) {
+			quietestEnergy = energy;
+			quietestIndex = i;
+		}
+	}
+	return start + centiseconds(static_cast<int>(quietestIndex) + 1);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "AudioClip.h"
+#include "time/BoundedTimeline.h"
+
+// Finds the audible stretches of a clip: everything but silences of at least minSilenceDuration
+// in which the signal stays below thresholdDb (RMS relative to full scale, ignoring DC offset).
+// Each stretch keeps padding of the silence around it, so that voice activity detection sees the
+// onsets and fades of the sound.
+// Much cheaper than voice activity detection, so it can be used to skip long silences in bulk.
+JoiningBoundedTimeline<void> detectSound(
+	const AudioClip& audioClip,
+	float thresholdDb = -60.0f,
+	centiseconds minSilenceDuration = 200_cs,
+	centiseconds padding = 50_cs
+);
+
+// Finds the quietest point in a range of a clip: the middle of the 30 ms with the least energy,
+// again ignoring DC offset. A good place to split audio, as it is least likely to cut a phone.
+centiseconds findQuietestPoint(const AudioClip& audioClip, const TimeRange& range);
@@ -1,14 +1,81 @@
 #include "processing.h"
 #include <algorithm>
 
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using std::function;
 using std::vector;
 
-// Converts a float in the range -1..1 to a signed 16-bit int
-inline int16_t floatSampleToInt16(float sample) {
-	sample = std::max(sample, -1.0f);
-	sample = std::min(sample, 1.0f);
-	return static_cast<int16_t>(((sample + 1) / 2) * (INT16_MAX - INT16_MIN) + INT16_MIN);
+void floatSamplesToInt16(const float* in, size_t count, int16_t* out) {
+	size_t i = 0;
+	// Same operations as floatSampleToInt16(), eight samples at a time
+#if defined(__wasm_simd128__)
+	const v128_t minSample = wasm_f32x4_splat(-1.0f);
+	const v128_t maxSample = wasm_f32x4_splat(1.0f);
+	const v128_t half = wasm_f32x4_splat(0.5f);
+	const v128_t range = wasm_f32x4_splat(static_cast<float>(INT16_MAX - INT16_MIN));
+	const v128_t minValue = wasm_f32x4_splat(static_cast<float>(INT16_MIN));
+	const auto convert = [&](v128_t sample) {
+		sample = wasm_f32x4_min(wasm_f32x4_max(sample, minSample), maxSample);
+		const v128_t scaled = wasm_f32x4_mul(wasm_f32x4_add(sample, maxSample), half);
+		return wasm_i32x4_trunc_sat_f32x4(wasm_f32x4_add(wasm_f32x4_mul(scaled, range), minValue));
+	};
+	for (; i + 8 <= count; i += 8) {
+		const v128_t low = convert(wasm_v128_load(in + i));
+		const v128_t high = convert(wasm_v128_load(in + i + 4));
+		wasm_v128_store(out + i, wasm_i16x8_narrow_i32x4(low, high));
+	}
+#elif defined(__SSE2__)
+	const __m128 minSample = _mm_set1_ps(-1.0f);
+	const __m128 maxSample = _mm_set1_ps(1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 range = _mm_set1_ps(static_cast<float>(INT16_MAX - INT16_MIN));
+	const __m128 minValue = _mm_set1_ps(static_cast<float>(INT16_MIN));
+	const auto convert = [&](__m128 sample) {
+		sample = _mm_min_ps(_mm_max_ps(sample, minSample), maxSample);
+		const __m128 scaled = _mm_mul_ps(_mm_add_ps(sample, maxSample), half);
+		return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(scaled, range), minValue));
+	};
+	for (; i + 8 <= count; i += 8) {
+		const __m128i low = convert(_mm_loadu_ps(in + i));
+		const __m128i high = convert(_mm_loadu_ps(in + i + 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(low, high));
+	}
+#endif
+	for (; i < count; ++i) {
+		out[i] = floatSampleToInt16(in[i]);
+	}
+}
+
+void int16SamplesToFloat(const int16_t* in, size_t count, float* out) {
+	size_t i = 0;
+	// Multiplying by a power of two is exact, so this matches dividing by 32768
+	constexpr float factor = 1.0f / 32768.0f;
+#if defined(__wasm_simd128__)
+	const v128_t scale = wasm_f32x4_splat(factor);
+	for (; i + 8 <= count; i += 8) {
+		const v128_t samples = wasm_v128_load(in + i);
+		wasm_v128_store(out + i, wasm_f32x4_mul(wasm_f32x4_convert_i32x4(wasm_i32x4_extend_low_i16x8(samples)), scale));
+		wasm_v128_store(out + i + 4, wasm_f32x4_mul(wasm_f32x4_convert_i32x4(wasm_i32x4_extend_high_i16x8(samples)), scale));
+	}
+#elif defined(__SSE2__)
+	const __m128 scale = _mm_set1_ps(factor);
+	for (; i + 8 <= count; i += 8) {
+		const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+		// Sign-extend by placing each sample in the upper half of a 32-bit lane
+		const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+		const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+	}
+#endif
+	for (; i < count; ++i) {
+		out[i] = static_cast<float>(in[i]) * factor;
+	}
 }
 
 void process16bitAudioClip(
@@ -20,16 +87,17 @@ void process16bitAudioClip(
 	// Process entire sound stream
 	vector<int16_t> buffer;
 	buffer.reserve(bufferCapacity);
+	vector<float> floatBuffer(bufferCapacity);
 	size_t sampleCount = 0;
-	auto it = audioClip.begin();
-	const auto end = audioClip.end();
 	do {
 		// Read to buffer
-		buffer.clear();
-		for (; buffer.size() < bufferCapacity && it != end; ++it) {
-			// Read sample to buffer
-			buffer.push_back(floatSampleToInt16(*it));
-		}
+		const size_t count = std::min(
+			bufferCapacity,
+			static_cast<size_t>(audioClip.size()) - sampleCount
+		);
+		audioClip.readBlock(static_cast<AudioClip::size_type>(sampleCount), count, floatBuffer.data());
+		buffer.resize(count);
+		floatSamplesToInt16(floatBuffer.data(), count, buffer.data());
 
 		// Process buffer
 		processBuffer(buffer);
@@ -49,10 +117,23 @@ void process16bitAudioClip(
 }
 
 vector<int16_t> copyTo16bitBuffer(const AudioClip& audioClip) {
-	vector<int16_t> result(static_cast<size_t>(audioClip.size()));
-	int index = 0;
-	for (float sample : audioClip) {
-		result[index++] = floatSampleToInt16(sample);
+	const size_t size = static_cast<size_t>(audioClip.size());
+	if (const int16_t* samples = audioClip.get16bitBuffer()) {
+		return vector<int16_t>(samples, samples + size);
 	}
+
+	vector<int16_t> result(size);
+	forEachBlock(audioClip, 0, 4096, [&](AudioClip::size_type blockStart, gsl::span<const float> block) {
+		floatSamplesToInt16(block.data(), static_cast<size_t>(block.size()), result.data() + blockStart);
+	});
 	return result;
 }
+
+gsl::span<const int16_t> get16bitSamples(const AudioClip& audioClip, vector<int16_t>& buffer) {
+	if (const int16_t* samples = audioClip.get16bitBuffer()) {
+		return gsl::span<const int16_t>(samples, static_cast<std::ptrdiff_t>(audioClip.size()));
+	}
+
+	buffer = copyTo16bitBuffer(audioClip);
+	return gsl::span<const int16_t>(buffer);
+}
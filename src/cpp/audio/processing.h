@@ -2,9 +2,45 @@
 
 #include <vector>
 #include <functional>
+#include <algorithm>
+#include <cstdint>
 #include "AudioClip.h"
+#include <span.h>
 #include "tools/progress.h"
 
+// Converts a float in the range -1..1 to a signed 16-bit int
+inline int16_t floatSampleToInt16(float sample) {
+	sample = std::max(sample, -1.0f);
+	sample = std::min(sample, 1.0f);
+	return static_cast<int16_t>(((sample + 1) / 2) * (INT16_MAX - INT16_MIN) + INT16_MIN);
+}
+
+// Converts count floats with floatSampleToInt16(), several at a time where SIMD is available
+void floatSamplesToInt16(const float* in, size_t count, int16_t* out);
+
+// Converts count signed 16-bit ints to floats in the range -1..1, several at a time where SIMD is
+// available
+void int16SamplesToFloat(const int16_t* in, size_t count, float* out);
+
+// Calls processBlock(blockStart, samples) for consecutive blocks of up to blockSize samples, from
+// sample index start to the end of the clip. Each block is read with one readBlock() call, so
+// bulk consumers skip the per-sample calls of sample readers and iterators.
+template<typename TFunction>
+void forEachBlock(
+	const AudioClip& audioClip,
+	AudioClip::size_type start,
+	AudioClip::size_type blockSize,
+	TFunction&& processBlock
+) {
+	const AudioClip::size_type size = audioClip.size();
+	std::vector<AudioClip::value_type> block(static_cast<size_t>(std::min(blockSize, std::max<AudioClip::size_type>(size - start, 0))));
+	for (AudioClip::size_type blockStart = start; blockStart < size; blockStart += blockSize) {
+		const AudioClip::size_type count = std::min(blockSize, size - blockStart);
+		audioClip.readBlock(blockStart, count, block.data());
+		processBlock(blockStart, gsl::span<const AudioClip::value_type>(block.data(), static_cast<std::ptrdiff_t>(count)));
+	}
+}
+
 void process16bitAudioClip(
 	const AudioClip& audioClip,
 	const std::function<void(const std::vector<int16_t>&)>& processBuffer,
@@ -18,4 +54,8 @@ void process16bitAudioClip(
 	ProgressSink& progressSink
 );
 
-std::vector<int16_t> copyTo16bitBuffer(const AudioClip& audioClip);
\ No newline at end of file
+std::vector<int16_t> copyTo16bitBuffer(const AudioClip& audioClip);
+// Returns the clip's samples as 16-bit values.
+// If the clip is backed by a 16-bit buffer, returns a view of it. Otherwise, copies the samples to
+// the specified buffer and returns a view of that.
+gsl::span<const int16_t> get16bitSamples(const AudioClip& audioClip, std::vector<int16_t>& buffer);
@@ -1,5 +1,4 @@
 #include "voiceActivityDetection.h"
-#include "DcOffset.h"
 #include "SampleRateConverter.h"
 #include "logging/logging.h"
 #include "tools/pairs.h"
@@ -10,6 +9,9 @@
 #include <gsl_util.h>
 #include "tools/parallel.h"
 #include <webrtc/common_audio/vad/vad_core.h>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
 
 using std::vector;
 using boost::adaptors::transformed;
@@ -17,73 +19,264 @@ using fmt::format;
 using std::runtime_error;
 using std::unique_ptr;
 
-JoiningBoundedTimeline<void> detectVoiceActivity(
-	const AudioClip& inputAudioClip,
-	ProgressSink& progressSink
-) {
-	// Prepare audio for VAD
-	constexpr int webRtcSamplingRate = 8000;
-	const unique_ptr<AudioClip> audioClip = inputAudioClip.clone()
-		| resample(webRtcSamplingRate)
-		| removeDcOffset();
+// Gaps in activity up to this length are filled
+constexpr centiseconds maxGap(10);
+// Segments of activity shorter than this are discarded
+constexpr centiseconds minSegmentLength(5);
 
-	VadInst* vadHandle = WebRtcVad_Create();
+VoiceActivityDetector::VoiceActivityDetector() :
+	vadHandle(WebRtcVad_Create())
+{
 	if (!vadHandle) throw runtime_error("Error creating WebRTC VAD handle.");
 
-	auto freeHandle = gsl::finally([&]() { WebRtcVad_Free(vadHandle); });
+	try {
+		int error = WebRtcVad_Init(vadHandle);
+		if (error) throw runtime_error("Error initializing WebRTC VAD.");
 
-	int error = WebRtcVad_Init(vadHandle);
-	if (error) throw runtime_error("Error initializing WebRTC VAD.");
+		const int aggressiveness = 2; // 0..3. The higher, the more is cut off.
+		error = WebRtcVad_set_mode(vadHandle, aggressiveness);
+		if (error) throw runtime_error("Error setting WebRTC VAD aggressiveness.");
+	} catch (...) {
+		WebRtcVad_Free(vadHandle);
+		throw;
+	}
+}
 
-	const int aggressiveness = 2; // 0..3. The higher, the more is cut off.
-	error = WebRtcVad_set_mode(vadHandle, aggressiveness);
-	if (error) throw runtime_error("Error setting WebRTC VAD aggressiveness.");
+VoiceActivityDetector::~VoiceActivityDetector() {
+	WebRtcVad_Free(vadHandle);
+}
 
-	// Detect activity
-	JoiningBoundedTimeline<void> activity(audioClip->getTruncatedRange());
-	centiseconds time = 0_cs;
-	const size_t frameSize = webRtcSamplingRate / 100;
-	const auto processBuffer = [&](const vector<int16_t>& buffer) {
-		// WebRTC is picky regarding buffer size
-		if (buffer.size() < frameSize) return;
-
-		const int result = WebRtcVad_Process(
-			vadHandle,
-			webRtcSamplingRate,
-			buffer.data(),
-			buffer.size()
-		);
-		if (result == -1) throw runtime_error("Error processing audio buffer using WebRTC VAD.");
-
-		// Ignore the result of WebRtcVad_Process, instead directly interpret the internal VAD flag.
-		// The result of WebRtcVad_Process stays 1 for a number of frames after the last detected
-		// activity.
-		const bool isActive = reinterpret_cast<VadInstT*>(vadHandle)->vad == 1;
-
-		if (isActive) {
-			activity.set(time, time + 1_cs);
-		}
+vector<TimeRange> VoiceActivityDetector::process(gsl::span<const int16_t> samples) {
+	vector<TimeRange> completedSegments;
+	const size_t frameSize = samplingRate / 100;
+	const int16_t* data = samples.data();
+	const size_t size = static_cast<size_t>(samples.size());
+	size_t offset = 0;
 
-		time += 1_cs;
-	};
-	process16bitAudioClip(*audioClip, processBuffer, frameSize, progressSink);
+	// Complete a frame started by the previous call
+	if (!pendingSamples.empty()) {
+		offset = std::min(frameSize - pendingSamples.size(), size);
+		pendingSamples.insert(pendingSamples.end(), data, data + offset);
+		if (pendingSamples.size() < frameSize) return completedSegments;
 
-	// Fill small gaps in activity
-	const centiseconds maxGap(10);
-	for (const auto& pair : getPairs(activity)) {
-		if (pair.second.getStart() - pair.first.getEnd() <= maxGap) {
-			activity.set(pair.first.getEnd(), pair.second.getStart());
-		}
+		processFrame(pendingSamples.data(), completedSegments);
+		pendingSamples.clear();
+	}
+
+	// Process whole frames in place
+	for (; offset + frameSize <= size; offset += frameSize) {
+		processFrame(data + offset, completedSegments);
+	}
+	pendingSamples.assign(data + offset, data + size);
+
+	return completedSegments;
+}
+
+vector<TimeRange> VoiceActivityDetector::processActivity(gsl::span<const uint8_t> frameActivity) {
+	if (!pendingSamples.empty()) {
+		throw std::logic_error("Frame activity can't follow an incomplete frame of audio.");
+	}
+
+	vector<TimeRange> completedSegments;
+	for (const uint8_t isActive : frameActivity) {
+		addFrame(isActive != 0, completedSegments);
+	}
+	return completedSegments;
+}
+
+vector<TimeRange> VoiceActivityDetector::finish() {
+	// WebRTC is picky regarding buffer size, so incomplete frames are dropped
+	pendingSamples.clear();
+
+	vector<TimeRange> completedSegments;
+	closeSegment(completedSegments);
+	return completedSegments;
+}
+
+namespace {
+
+	// The fields of VadInstT making up a VadNoiseModel, in order
+	template<typename TVisit>
+	void visitNoiseModel(VadInstT& vad, TVisit visit) {
+		visit(vad.noise_means);
+		visit(vad.speech_means);
+		visit(vad.noise_stds);
+		visit(vad.speech_stds);
+		visit(vad.index_vector);
+		visit(vad.low_value_vector);
+		visit(vad.mean_value);
+	}
+
+	size_t getNoiseModelSize(VadInstT& vad) {
+		size_t size = 0;
+		visitNoiseModel(vad, [&](const auto& values) { size += std::size(values); });
+		return size;
+	}
+
+	// The fields of VadInstT making up a VadState's detector values, value by value
+	template<typename TVisit>
+	void visitDetectorValues(VadInstT& vad, TVisit visit) {
+		const auto visitAll = [&](auto& values) {
+			for (auto& value : values) visit(value);
+		};
+		visit(vad.vad);
+		visitAll(vad.downsampling_filter_states);
+		visitAll(vad.state_48_to_8.S_48_24);
+		visitAll(vad.state_48_to_8.S_24_24);
+		visitAll(vad.state_48_to_8.S_24_16);
+		visitAll(vad.state_48_to_8.S_16_8);
+		visitNoiseModel(vad, visitAll);
+		visit(vad.frame_counter);
+		visit(vad.over_hang);
+		visit(vad.num_of_speech);
+		visitAll(vad.upper_state);
+		visitAll(vad.lower_state);
+		visitAll(vad.hp_filter_state);
+		visitAll(vad.over_hang_max_1);
+		visitAll(vad.over_hang_max_2);
+		visitAll(vad.individual);
+		visitAll(vad.total);
+	}
+
+}
+
+VadNoiseModel VoiceActivityDetector::getNoiseModel() const {
+	VadInstT& vad = *reinterpret_cast<VadInstT*>(vadHandle);
+	VadNoiseModel noiseModel;
+	noiseModel.values.reserve(getNoiseModelSize(vad));
+	visitNoiseModel(vad, [&](const auto& values) {
+		noiseModel.values.insert(noiseModel.values.end(), std::begin(values), std::end(values));
+	});
+	noiseModel.frameCount = vad.frame_counter;
+	return noiseModel;
+}
+
+void VoiceActivityDetector::setNoiseModel(const VadNoiseModel& noiseModel) {
+	if (noiseModel.empty()) return;
+
+	VadInstT& vad = *reinterpret_cast<VadInstT*>(vadHandle);
+	if (noiseModel.values.size() != getNoiseModelSize(vad)) {
+		throw std::invalid_argument("Voice activity noise model doesn't fit the detector.");
 	}
+	const int16_t* value = noiseModel.values.data();
+	visitNoiseModel(vad, [&](auto& values) {
+		std::copy(value, value + std::size(values), std::begin(values));
+		value += std::size(values);
+	});
+	vad.frame_counter = noiseModel.frameCount;
+}
+
+VadState VoiceActivityDetector::getState() const {
+	VadInstT& vad = *reinterpret_cast<VadInstT*>(vadHandle);
+	VadState state;
+	visitDetectorValues(vad, [&](auto value) { state.detectorValues.push_back(static_cast<int32_t>(value)); });
+	state.pendingSamples = pendingSamples;
+	state.time = time;
+	state.openSegment = openSegment;
+	return state;
+}
+
+void VoiceActivityDetector::setState(const VadState& state) {
+	VadInstT& vad = *reinterpret_cast<VadInstT*>(vadHandle);
+	size_t valueCount = 0;
+	visitDetectorValues(vad, [&](auto) { ++valueCount; });
+	if (state.detectorValues.size() != valueCount || state.pendingSamples.size() >= samplingRate / 100) {
+		throw std::invalid_argument("Voice activity detector state doesn't fit the detector.");
+	}
+
+	const int32_t* value = state.detectorValues.data();
+	visitDetectorValues(vad, [&](auto& field) {
+		field = static_cast<std::remove_reference_t<decltype(field)>>(*value++);
+	});
+	pendingSamples = state.pendingSamples;
+	time = state.time;
+	openSegment = state.openSegment;
+}
 
-	// Discard very short segments of activity
-	const centiseconds minSegmentLength(5);
-	for (const auto& segment : Timeline<void>(activity)) {
-		if (segment.getDuration() < minSegmentLength) {
-			activity.clear(segment.getTimeRange());
+boost::optional<centiseconds> VoiceActivityDetector::getOpenSegmentStart() const {
+	if (!openSegment) return boost::none;
+	return openSegment->getStart();
+}
+
+void VoiceActivityDetector::processFrame(const int16_t* frame, vector<TimeRange>& completedSegments) {
+	const size_t frameSize = samplingRate / 100;
+	const int result = WebRtcVad_Process(vadHandle, samplingRate, frame, frameSize);
+	if (result == -1) throw runtime_error("Error processing audio buffer using WebRTC VAD.");
+
+	// Ignore the result of WebRtcVad_Process, instead directly interpret the internal VAD flag.
+	// The result of WebRtcVad_Process stays 1 for a number of frames after the last detected
+	// activity.
+	addFrame(reinterpret_cast<VadInstT*>(vadHandle)->vad == 1, completedSegments);
+}
+
+void VoiceActivityDetector::addFrame(bool isActive, vector<TimeRange>& completedSegments) {
+	if (isActive) {
+		if (openSegment && time - openSegment->getEnd() <= maxGap) {
+			// Fill small gap
+			openSegment->setEnd(time + 1_cs);
+		} else {
+			closeSegment(completedSegments);
+			openSegment = TimeRange(time, time + 1_cs);
 		}
 	}
 
+	time += 1_cs;
+
+	// Once the gap exceeds the maximum, no later activity can extend the open segment
+	if (openSegment && time - openSegment->getEnd() > maxGap) {
+		closeSegment(completedSegments);
+	}
+}
+
+void VoiceActivityDetector::closeSegment(vector<TimeRange>& completedSegments) {
+	if (!openSegment) return;
+
+	if (openSegment->getDuration() >= minSegmentLength) {
+		completedSegments.push_back(*openSegment);
+	}
+	openSegment = boost::none;
+}
+
+JoiningBoundedTimeline<void> detectVoiceActivity(
+	const AudioClip& inputAudioClip,
+	ProgressSink& progressSink,
+	VadNoiseModel* noiseModel
+) {
+	// Prepare audio for VAD. Resampling keeps the input free of DC offset.
+	const unique_ptr<AudioClip> audioClip = inputAudioClip.clone()
+		| resample(VoiceActivityDetector::samplingRate);
+
+	// Detect activity. The detector fills gaps and drops short segments as it goes, so its
+	// segments are final, sorted and apart.
+	VoiceActivityDetector voiceActivityDetector;
+	if (noiseModel) {
+		voiceActivityDetector.setNoiseModel(*noiseModel);
+	}
+	vector<TimeRange> segments;
+	const auto addSegments = [&](const vector<TimeRange>& newSegments) {
+		segments.insert(segments.end(), newSegments.begin(), newSegments.end());
+	};
+	// Read a second at a time, so that the effect chain runs on large blocks. The detector splits
+	// them into frames itself.
+	const size_t blockSize = VoiceActivityDetector::samplingRate;
+	process16bitAudioClip(
+		*audioClip,
+		[&](const vector<int16_t>& buffer) { addSegments(voiceActivityDetector.process(buffer)); },
+		blockSize,
+		progressSink
+	);
+	addSegments(voiceActivityDetector.finish());
+	if (noiseModel) {
+		*noiseModel = voiceActivityDetector.getNoiseModel();
+	}
+
+	// Build the timeline once, appending each segment
+	JoiningBoundedTimeline<void> activity(audioClip->getTruncatedRange());
+	activity.reserve(segments.size());
+	for (const TimeRange& segment : segments) {
+		activity.set(segment.getStart(), segment.getEnd());
+	}
+
 	logging::debugFormat(
 		"Found {} sections of voice activity: {}",
 		activity.size(),
@@ -2,8 +2,98 @@
 #include "AudioClip.h"
 #include "time/BoundedTimeline.h"
 #include "tools/progress.h"
+#include <span.h>
+#include <vector>
+#include <cstdint>
 
+struct WebRtcVadInst;
+
+// The models of background noise and speech a VoiceActivityDetector has adapted to, so that a later
+// detector can start from them instead of its defaults, e.g. for the next clip of the same speaker
+// in the same room. Empty for the defaults.
+struct VadNoiseModel {
+	// The means and deviations of the noise and speech models, then the minimum tracker's history
+	std::vector<int16_t> values;
+	// The number of frames the models have adapted over
+	int32_t frameCount = 0;
+
+	bool empty() const { return values.empty(); }
+};
+
+// Everything a VoiceActivityDetector has processed so far, so that another detector can continue
+// exactly where it left off, e.g. in another process
+struct VadState {
+	// The fields of the WebRTC detector, including its noise model, in order
+	std::vector<int32_t> detectorValues;
+	// The samples of the incomplete frame
+	std::vector<int16_t> pendingSamples;
+	centiseconds time = 0_cs;
+	boost::optional<TimeRange> openSegment;
+};
+
+// Detects voice activity incrementally, e.g. while audio is still being recorded.
+// Each segment of activity is reported as soon as later audio proves it complete.
+class VoiceActivityDetector {
+public:
+	// Expected sampling rate of the input, as required by WebRTC VAD
+	static constexpr int samplingRate = 8000;
+
+	VoiceActivityDetector();
+	VoiceActivityDetector(const VoiceActivityDetector&) = delete;
+	VoiceActivityDetector& operator=(const VoiceActivityDetector&) = delete;
+	~VoiceActivityDetector();
+
+	// Processes 16-bit samples at samplingRate, in blocks of any size.
+	// Returns the segments of activity completed by this audio.
+	std::vector<TimeRange> process(gsl::span<const int16_t> samples);
+
+	// Continues with the activity of frames detected elsewhere instead of audio, one value per
+	// 10 ms frame, non-zero where the WebRTC detector found voice, e.g. by one running in the
+	// capture thread. Gaps are filled and short segments dropped as for audio. Throws if the audio
+	// processed so far ends in an incomplete frame.
+	// Returns the segments of activity completed by these frames.
+	std::vector<TimeRange> processActivity(gsl::span<const uint8_t> frameActivity);
+
+	// Ends the audio stream, discarding incomplete frames.
+	// Returns the final segment of activity, if any.
+	std::vector<TimeRange> finish();
+
+	// The end of the audio processed so far
+	centiseconds getTime() const { return time; }
+
+	// The models adapted to the audio processed so far
+	VadNoiseModel getNoiseModel() const;
+
+	// Continues adapting from the given models rather than the defaults. Does nothing if it is empty.
+	void setNoiseModel(const VadNoiseModel& noiseModel);
+
+	VadState getState() const;
+
+	// Continues from the state of another detector. Throws if it doesn't fit the detector.
+	void setState(const VadState& state);
+
+	// The start of the segment of activity that is still open, if any
+	boost::optional<centiseconds> getOpenSegmentStart() const;
+
+	// The segment of activity that is still open, if any, ending after its last active frame so far.
+	// It is dropped if it closes shorter than the minimum segment length.
+	const boost::optional<TimeRange>& getOpenSegment() const { return openSegment; }
+
+private:
+	void processFrame(const int16_t* frame, std::vector<TimeRange>& completedSegments);
+	void addFrame(bool isActive, std::vector<TimeRange>& completedSegments);
+	void closeSegment(std::vector<TimeRange>& completedSegments);
+
+	WebRtcVadInst* vadHandle;
+	std::vector<int16_t> pendingSamples;
+	centiseconds time = 0_cs;
+	boost::optional<TimeRange> openSegment;
+};
+
+// Detects voice activity in a clip without DC offset.
+// If noiseModel is set, detection starts from it and it receives the models adapted to the clip.
 JoiningBoundedTimeline<void> detectVoiceActivity(
 	const AudioClip& audioClip,
-	ProgressSink& progressSink
+	ProgressSink& progressSink,
+	VadNoiseModel* noiseModel = nullptr
 );
@@ -0,0 +1,92 @@
+#include "animationComparison.h"
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <format.h>
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+using std::filesystem::path;
+
+double getShapeAgreement(
+	const JoiningContinuousTimeline<Shape>& animation,
+	const JoiningContinuousTimeline<Shape>& reference
+) {
+	const TimeRange range = reference.getRange();
+	if (range.empty()) return 1;
+
+	int agreeingCount = 0;
+	for (centiseconds time = range.getStart(); time < range.getEnd(); ++time) {
+		const Timed<Shape>* shape = animation.get(time);
+		if (shape && shape->getValue() == reference.get(time)->getValue()) {
+			++agreeingCount;
+		}
+	}
+	return static_cast<double>(agreeingCount) / static_cast<double>(range.getDuration().count());
+}
+
+vector<double> getOnsetErrors(
+	const JoiningContinuousTimeline<Shape>& animation,
+	const JoiningContinuousTimeline<Shape>& reference
+) {
+	vector<centiseconds> animationOnsets;
+	for (const auto& timedShape : animation) {
+		animationOnsets.push_back(timedShape.getStart());
+	}
+
+	vector<double> errors;
+	if (animationOnsets.empty()) return errors;
+	bool isFirst = true;
+	for (const auto& timedShape : reference) {
+		if (isFirst) {
+			// Both animations start with the audio
+			isFirst = false;
+			continue;
+		}
+
+		const centiseconds onset = timedShape.getStart();
+		const auto next = std::lower_bound(animationOnsets.begin(), animationOnsets.end(), onset);
+		centiseconds distance = centiseconds::max();
+		if (next != animationOnsets.end()) {
+			distance = *next - onset;
+		}
+		if (next != animationOnsets.begin()) {
+			distance = std::min(distance, onset - *(next - 1));
+		}
+		errors.push_back(static_cast<double>(distance.count()) * 10);
+	}
+	return errors;
+}
+
+void writeAnimation(const path& filePath, const JoiningContinuousTimeline<Shape>& animation) {
+	std::ofstream file;
+	file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+	try {
+		file.open(filePath);
+		for (const auto& timedShape : animation) {
+			file << timedShape.getStart().count() << ' ' << timedShape.getEnd().count() << ' '
+				<< timedShape.getValue() << '\n';
+		}
+	} catch (...) {
+		std::throw_with_nested(runtime_error(fmt::format("Error writing file {}.", filePath.u8string())));
+	}
+}
+
+JoiningContinuousTimeline<Shape> readAnimation(const path& filePath) {
+	std::ifstream file(filePath);
+	if (!file) {
+		throw runtime_error(fmt::format("Error reading file {}.", filePath.u8string()));
+	}
+	vector<Timed<Shape>> cues;
+	centiseconds::rep start, end;
+	string shapeName;
+	while (file >> start >> end >> shapeName) {
+		cues.emplace_back(centiseconds(start), centiseconds(end), ShapeConverter::get().parse(shapeName));
+	}
+	const TimeRange range = cues.empty()
+		? TimeRange()
+		: TimeRange(cues.front().getStart(), cues.back().getEnd());
+	return JoiningContinuousTimeline<Shape>(range, Shape::X, cues);
+}
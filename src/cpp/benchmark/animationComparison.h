@@ -0,0 +1,25 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+#include "core/Shape.h"
+#include "time/ContinuousTimeline.h"
+
+// The share of the reference's time range in which the animation shows the same shape
+double getShapeAgreement(
+	const JoiningContinuousTimeline<Shape>& animation,
+	const JoiningContinuousTimeline<Shape>& reference
+);
+
+// For each mouth cue of the reference after the first, the distance from its start to the nearest
+// cue start of the animation, in milliseconds
+std::vector<double> getOnsetErrors(
+	const JoiningContinuousTimeline<Shape>& animation,
+	const JoiningContinuousTimeline<Shape>& reference
+);
+
+// Writes an animation as one line per mouth cue: start and end in centiseconds, and the shape
+void writeAnimation(const std::filesystem::path& filePath, const JoiningContinuousTimeline<Shape>& animation);
+
+// Reads an animation written by writeAnimation(), possibly by another build, or labelled by hand
+JoiningContinuousTimeline<Shape> readAnimation(const std::filesystem::path& filePath);
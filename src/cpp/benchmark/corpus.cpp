@@ -0,0 +1,108 @@
+#include "corpus.h"
+#include "cli/waveFiles.h"
+#include "audio/SampleRateConverter.h"
+#include "audio/processing.h"
+#include "audio/Timebase.h"
+#include "bridge/audio_utils.h"
+#include "tools/stringTools.h"
+#include "tools/textFiles.h"
+#include <compat/boost_compat.h>
+#include <format.h>
+#include <random>
+#include <sstream>
+#include <array>
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+using std::filesystem::path;
+
+namespace {
+
+	constexpr int corpusSampleRate = 44100;
+
+	struct Recording {
+		Pcm16Audio audio;
+		string text;
+	};
+
+	// Reads the recordings listed in cards.transcription, such as "<s> ten of clubs </s> (001)"
+	vector<Recording> readRecordings(const path& cardsDirectory) {
+		vector<Recording> recordings;
+		std::istringstream transcription(readUtf8File(cardsDirectory / "cards.transcription"));
+		string line;
+		while (std::getline(transcription, line)) {
+			const size_t textStart = line.find("<s>");
+			const size_t textEnd = line.find("</s>");
+			const size_t idStart = line.rfind('(');
+			const size_t idEnd = line.rfind(')');
+			if (textStart == string::npos || textEnd == string::npos
+				|| idStart == string::npos || idEnd == string::npos || idEnd < idStart)
+			{
+				continue;
+			}
+
+			Recording recording;
+			const string id = line.substr(idStart + 1, idEnd - idStart - 1);
+			recording.audio = readWaveFile(cardsDirectory / (id + ".wav"));
+			recording.text = line.substr(textStart + 3, textEnd - textStart - 3);
+			boost::algorithm::trim(recording.text);
+			recordings.push_back(std::move(recording));
+		}
+		if (recordings.empty()) {
+			throw runtime_error(fmt::format("No recordings found in {}.", cardsDirectory.u8string()));
+		}
+		return recordings;
+	}
+
+	// Joins recordings, cycling through them, until the clip has at least the minimum duration.
+	// Consecutive recordings are separated by pauses of varying length with a little noise.
+	BenchmarkClip assembleClip(const string& name, const vector<Recording>& recordings, centiseconds minDuration) {
+		const int sampleRate = recordings.front().audio.sampleRate;
+		const Timebase timebase(sampleRate);
+		static const std::array<centiseconds, 4> pauseDurations { 30_cs, 80_cs, 45_cs, 150_cs };
+		// Fixed seed, so that the corpus is the same on every run
+		std::minstd_rand random(1);
+		std::uniform_int_distribution<int> noise(-16, 16);
+
+		vector<int16_t> samples;
+		vector<string> words;
+		for (size_t i = 0; i == 0 || timebase.toCentiseconds(static_cast<int64_t>(samples.size())) < minDuration; ++i) {
+			const Recording& recording = recordings[i % recordings.size()];
+			if (recording.audio.sampleRate != sampleRate) {
+				throw runtime_error("All recordings of the corpus must have the same sample rate.");
+			}
+			if (i > 0) {
+				const centiseconds pause = pauseDurations[(i - 1) % pauseDurations.size()];
+				const size_t pauseSampleCount = static_cast<size_t>(timebase.toSampleIndex(pause));
+				for (size_t j = 0; j < pauseSampleCount; ++j) {
+					samples.push_back(static_cast<int16_t>(noise(random)));
+				}
+			}
+			samples.insert(samples.end(), recording.audio.samples.begin(), recording.audio.samples.end());
+			words.push_back(recording.text);
+		}
+
+		const auto clip = createAudioClipViewFromPCM16(samples.data(), samples.size(), sampleRate);
+		BenchmarkClip result;
+		result.name = name;
+		result.samples = copyTo16bitBuffer(*(clip->clone() | resample(corpusSampleRate)));
+		result.sampleRate = corpusSampleRate;
+		result.dialog = join(words, " ");
+		return result;
+	}
+
+}
+
+centiseconds BenchmarkClip::getDuration() const {
+	return Timebase(sampleRate).toCentiseconds(static_cast<int64_t>(samples.size()));
+}
+
+vector<BenchmarkClip> createCorpus(const path& cardsDirectory) {
+	const vector<Recording> recordings = readRecordings(cardsDirectory);
+	return {
+		assembleClip("bark", recordings, 0_cs),
+		assembleClip("dialog", recordings, 3000_cs),
+		assembleClip("monologue", recordings, 60000_cs)
+	};
+}
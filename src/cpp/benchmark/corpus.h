@@ -0,0 +1,26 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "time/centiseconds.h"
+
+// A recording of the benchmark corpus
+struct BenchmarkClip {
+	std::string name;
+	std::vector<int16_t> samples;
+	int sampleRate;
+	// The words spoken
+	std::string dialog;
+
+	centiseconds getDuration() const;
+};
+
+// Assembles the benchmark corpus from the recordings of PocketSphinx's "cards" test data, so that
+// every build measures the same audio:
+// * "bark": a single short utterance
+// * "dialog": about 30 s of utterances separated by pauses
+// * "monologue": about 10 min of utterances separated by pauses
+// Clips are resampled to 44.1 kHz, as common for recordings, so that the analysis resamples them.
+std::vector<BenchmarkClip> createCorpus(const std::filesystem::path& cardsDirectory);
@@ -0,0 +1,207 @@
+#include "heapTracking.h"
+#include "tools/AnalysisStats.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(LIPSYNCENGINE_TRACK_HEAP)
+
+#include <malloc.h>
+
+namespace {
+	std::atomic<size_t> heapSize(0);
+	std::atomic<size_t> peakHeapSize(0);
+
+	void addAllocation(void* pointer) {
+		const size_t allocationSize = malloc_usable_size(pointer);
+		countStageAllocation(allocationSize);
+		const size_t size = heapSize += allocationSize;
+		size_t peak = peakHeapSize.load(std::memory_order_relaxed);
+		while (size > peak && !peakHeapSize.compare_exchange_weak(peak, size, std::memory_order_relaxed)) {}
+	}
+
+	void removeAllocation(size_t size) {
+		countStageDeallocation(size);
+		heapSize -= size;
+	}
+}
+
+// The linker redirects all calls to malloc and friends to these wrappers (--wrap), including
+// those within the engine and its C libraries
+extern "C" {
+	void* __real_malloc(size_t size);
+	void* __real_calloc(size_t count, size_t size);
+	void* __real_realloc(void* pointer, size_t size);
+	void __real_free(void* pointer);
+
+	void* __wrap_malloc(size_t size) {
+		void* result = __real_malloc(size);
+		if (result) addAllocation(result);
+		return result;
+	}
+
+	void* __wrap_calloc(size_t count, size_t size) {
+		void* result = __real_calloc(count, size);
+		if (result) addAllocation(result);
+		return result;
+	}
+
+	void* __wrap_realloc(void* pointer, size_t size) {
+		const size_t oldSize = pointer ? malloc_usable_size(pointer) : 0;
+		void* result = __real_realloc(pointer, size);
+		if (result) {
+			removeAllocation(oldSize);
+			addAllocation(result);
+		} else if (size == 0) {
+			// The memory was freed
+			removeAllocation(oldSize);
+		}
+		return result;
+	}
+
+	void __wrap_free(void* pointer) {
+		if (pointer) removeAllocation(malloc_usable_size(pointer));
+		__real_free(pointer);
+	}
+}
+
+// The C++ runtime's allocation functions call the unwrapped malloc, so replace them.
+// Calls to malloc from this file are wrapped.
+void* operator new(size_t size) {
+	void* result = std::malloc(size ? size : 1);
+	if (!result) throw std::bad_alloc();
+	return result;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return std::malloc(size ? size : 1);
+}
+
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+	std::free(pointer);
+}
+
+bool areStageAllocationsCounted() {
+	return true;
+}
+
+bool isHeapTracked() {
+	return true;
+}
+
+size_t getHeapSize() {
+	return heapSize;
+}
+
+size_t getPeakHeapSize() {
+	return peakHeapSize;
+}
+
+void resetPeakHeapSize() {
+	peakHeapSize = heapSize.load();
+}
+
+#elif defined(__EMSCRIPTEN__)
+
+#include <malloc.h>
+#include <emscripten/heap.h>
+
+// The C libraries' calls to malloc can't be intercepted, but the C++ allocations can, for the
+// stage allocations
+void* operator new(size_t size) {
+	void* result = std::malloc(size ? size : 1);
+	if (!result) throw std::bad_alloc();
+	countStageAllocation(malloc_usable_size(result));
+	return result;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	void* result = std::malloc(size ? size : 1);
+	if (result) countStageAllocation(malloc_usable_size(result));
+	return result;
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+	return operator new(size, tag);
+}
+
+void operator delete(void* pointer) noexcept {
+	if (pointer) countStageDeallocation(malloc_usable_size(pointer));
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+	operator delete(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+	operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+	operator delete(pointer);
+}
+
+bool areStageAllocationsCounted() {
+	return true;
+}
+
+bool isHeapTracked() {
+	return false;
+}
+
+size_t getHeapSize() {
+	return mallinfo().uordblks;
+}
+
+size_t getPeakHeapSize() {
+	return emscripten_get_heap_size();
+}
+
+void resetPeakHeapSize() {}
+
+#else
+
+bool areStageAllocationsCounted() {
+	return false;
+}
+
+bool isHeapTracked() {
+	return false;
+}
+
+size_t getHeapSize() {
+	return 0;
+}
+
+size_t getPeakHeapSize() {
+	return 0;
+}
+
+void resetPeakHeapSize() {}
+
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+// Whether heap allocations are tracked exactly.
+// Native Linux builds wrap malloc and friends (see CMakeLists.txt); elsewhere, the heap sizes
+// below are approximations.
+// Tracked allocations are also reported to the stages of analyses (see setStageAllocationTracking()).
+// WASM builds report their C++ allocations only.
+bool isHeapTracked();
+
+// Returns the number of bytes currently allocated on the heap
+size_t getHeapSize();
+
+// Returns the maximum heap size since the last call to resetPeakHeapSize().
+// Without heap tracking, this is the size of the WASM heap, which never shrinks, or 0 natively.
+size_t getPeakHeapSize();
+
+// Starts measuring the peak heap size from the current heap size
+void resetPeakHeapSize();
+
+// Whether the allocations of stages can be counted, completely or, in WASM builds, those of C++
+bool areStageAllocationsCounted();
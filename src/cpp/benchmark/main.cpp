@@ -0,0 +1,569 @@
+// Benchmarks the analysis pipeline and its stages on a fixed corpus.
+// Builds natively and as a Node.js WASM module, so that changes can be judged on both.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <array>
+#include <tclap/CmdLine.h>
+#include <format.h>
+#include "benchmark/corpus.h"
+#include "benchmark/scenario.h"
+#include "benchmark/animationComparison.h"
+#include "benchmark/heapTracking.h"
+#include "benchmark/paretoBenchmark.h"
+#include "benchmark/textBenchmark.h"
+#include "benchmark/microBenchmark.h"
+#include "recognition/PocketSphinxRecognizer.h"
+#include "recognition/PhoneticRecognizer.h"
+#include "recognition/FrameClassifierRecognizer.h"
+#include "recognition/pocketSphinxTools.h"
+#include "exporters/JsonExporter.h"
+#include "core/appInfo.h"
+#include "tools/AnalysisStats.h"
+#include "tools/tracing.h"
+#include "tools/NiceCmdLineOutput.h"
+#include "tools/TablePrinter.h"
+#include "tools/exceptions.h"
+#include <compat/boost_compat.h>
+
+using std::string;
+using std::vector;
+using std::unique_ptr;
+using std::runtime_error;
+using std::filesystem::path;
+using std::chrono::steady_clock;
+using boost::optional;
+
+namespace {
+
+	constexpr size_t stageCount = static_cast<size_t>(AnalysisStage::EndSentinel);
+
+	using milliseconds = std::chrono::duration<double, std::milli>;
+
+	// How the build computes features and acoustic scores
+#ifdef FIXED_POINT
+	constexpr const char* arithmetic = "fixed point";
+#else
+	constexpr const char* arithmetic = "floating point";
+#endif
+
+	// The measurements of one analysis
+	struct Run {
+		double milliseconds;
+		std::array<double, stageCount> stageMilliseconds;
+		size_t peakHeapSize;
+		std::array<StageAllocations, stageCount> stageAllocations;
+	};
+
+	struct ScenarioResult {
+		string name;
+		centiseconds duration;
+		vector<Run> runs;
+		// The share of the time in which the animation matches that of the full language model,
+		// if another one was benchmarked, or that of the reference build
+		optional<double> shapeAgreement;
+	};
+
+	// Returns the nearest-rank percentile (0 to 100) of the values
+	double getPercentile(vector<double> values, double percentile) {
+		if (values.empty()) return 0;
+
+		std::sort(values.begin(), values.end());
+		const double rank = std::ceil(percentile / 100 * static_cast<double>(values.size()));
+		const size_t index = static_cast<size_t>(std::max(rank, 1.0)) - 1;
+		return values[std::min(index, values.size() - 1)];
+	}
+
+	// Analyzes the clip of a scenario like lipsyncengine_analyze_pcm16(), including the JSON export
+	Run runScenario(
+		const Scenario& scenario,
+		const Recognizer& recognizer,
+		const ShapeSet& targetShapeSet,
+		int maxThreadCount
+	) {
+		AnalysisStats stats;
+		resetPeakHeapSize();
+		const auto start = steady_clock::now();
+		{
+			const AnalysisStatsScope statsScope(&stats);
+			const JoiningContinuousTimeline<Shape> animation =
+				animateScenario(scenario, recognizer, targetShapeSet, maxThreadCount);
+
+			const StageTimer exportTimer(AnalysisStage::Export);
+			std::ostringstream json;
+			JsonExporter().exportAnimation(ExporterInput(scenario.clip->name, animation, targetShapeSet), json);
+		}
+
+		Run run;
+		run.milliseconds = milliseconds(steady_clock::now() - start).count();
+		for (size_t stage = 0; stage < stageCount; ++stage) {
+			run.stageMilliseconds[stage] = milliseconds(stats.getDuration(static_cast<AnalysisStage>(stage))).count();
+			run.stageAllocations[stage] = stats.getAllocations(static_cast<AnalysisStage>(stage));
+		}
+		run.peakHeapSize = getPeakHeapSize();
+		return run;
+	}
+
+	// The statistics of a scenario's runs
+	struct Summary {
+		double realTimeFactor;
+		double p50Milliseconds;
+		double p99Milliseconds;
+		double firstMilliseconds;
+		size_t peakHeapSize;
+		std::array<double, stageCount> stageP50Milliseconds;
+		// p50 of the allocation counts and bytes, and the maximum of the peak live bytes
+		std::array<StageAllocations, stageCount> stageAllocations;
+	};
+
+	Summary summarize(const ScenarioResult& result) {
+		vector<double> latencies;
+		std::array<vector<double>, stageCount> stageLatencies;
+		std::array<vector<double>, stageCount> stageAllocationCounts;
+		std::array<vector<double>, stageCount> stageAllocatedBytes;
+		Summary summary {};
+		for (const Run& run : result.runs) {
+			latencies.push_back(run.milliseconds);
+			for (size_t stage = 0; stage < stageCount; ++stage) {
+				const StageAllocations& allocations = run.stageAllocations[stage];
+				stageLatencies[stage].push_back(run.stageMilliseconds[stage]);
+				stageAllocationCounts[stage].push_back(static_cast<double>(allocations.count));
+				stageAllocatedBytes[stage].push_back(static_cast<double>(allocations.bytes));
+				summary.stageAllocations[stage].peakLiveBytes =
+					std::max(summary.stageAllocations[stage].peakLiveBytes, allocations.peakLiveBytes);
+			}
+			summary.peakHeapSize = std::max(summary.peakHeapSize, run.peakHeapSize);
+		}
+
+		summary.p50Milliseconds = getPercentile(latencies, 50);
+		summary.p99Milliseconds = getPercentile(latencies, 99);
+		summary.firstMilliseconds = latencies.front();
+		summary.realTimeFactor = summary.p50Milliseconds / (static_cast<double>(result.duration.count()) * 10);
+		for (size_t stage = 0; stage < stageCount; ++stage) {
+			summary.stageP50Milliseconds[stage] = getPercentile(stageLatencies[stage], 50);
+			summary.stageAllocations[stage].count = static_cast<int64_t>(getPercentile(stageAllocationCounts[stage], 50));
+			summary.stageAllocations[stage].bytes = static_cast<int64_t>(getPercentile(stageAllocatedBytes[stage], 50));
+		}
+		return summary;
+	}
+
+	string getStageName(size_t stage) {
+		return AnalysisStageConverter::get().toString(static_cast<AnalysisStage>(stage));
+	}
+
+	string formatMegabytes(int64_t bytes) {
+		return fmt::format("{:.2f} MB", static_cast<double>(bytes) / (1024 * 1024));
+	}
+
+	void printResults(const vector<ScenarioResult>& results, bool stageAllocations) {
+		const TablePrinter table(&std::cout, { 16, 10, 6, 8, 12, 12, 12, 12, 10 });
+		table.printRow({ "scenario", "audio", "runs", "RTF", "p50", "p99", "first", "peak heap", "agreement" });
+		for (const ScenarioResult& result : results) {
+			const Summary summary = summarize(result);
+			table.printRow({
+				result.name,
+				fmt::format("{:.1f} s", static_cast<double>(result.duration.count()) / 100),
+				fmt::format("{}", result.runs.size()),
+				fmt::format("{:.3f}", summary.realTimeFactor),
+				fmt::format("{:.1f} ms", summary.p50Milliseconds),
+				fmt::format("{:.1f} ms", summary.p99Milliseconds),
+				fmt::format("{:.1f} ms", summary.firstMilliseconds),
+				fmt::format("{:.1f} MB", static_cast<double>(summary.peakHeapSize) / (1024 * 1024)),
+				result.shapeAgreement ? fmt::format("{:.1f} %", *result.shapeAgreement * 100) : "-"
+			});
+		}
+		if (!isHeapTracked()) {
+			std::cout << "Heap allocations are not tracked in this build; peak heap is the heap size.\n";
+		}
+
+		// Median time per stage, with one column for each of up to 6 scenarios
+		std::cout << "\nStage p50 (ms)\n";
+		const TablePrinter stageTable(&std::cout, { 22, 14, 14, 14, 14, 14, 14 });
+		const auto printStageRow = [&](vector<string> columns) {
+			columns.resize(7);
+			stageTable.printRow({ columns[0], columns[1], columns[2], columns[3], columns[4], columns[5], columns[6] });
+		};
+		vector<string> header { "stage" };
+		vector<Summary> summaries;
+		for (const ScenarioResult& result : results) {
+			header.push_back(result.name);
+			summaries.push_back(summarize(result));
+		}
+		printStageRow(header);
+		for (size_t stage = 0; stage < stageCount; ++stage) {
+			vector<string> row { getStageName(stage) };
+			for (const Summary& summary : summaries) {
+				row.push_back(fmt::format("{:.2f}", summary.stageP50Milliseconds[stage]));
+			}
+			printStageRow(row);
+		}
+
+		if (!stageAllocations) return;
+
+		// Allocations of the stages that allocate, by scenario
+		std::cout << "\nStage allocations p50 (peak live: maximum)\n";
+		const TablePrinter allocationTable(&std::cout, { 16, 22, 14, 14, 14 });
+		allocationTable.printRow({ "scenario", "stage", "allocations", "allocated", "peak live" });
+		for (size_t i = 0; i < results.size(); ++i) {
+			for (size_t stage = 0; stage < stageCount; ++stage) {
+				const StageAllocations& allocations = summaries[i].stageAllocations[stage];
+				if (allocations.count == 0) continue;
+
+				allocationTable.printRow({
+					results[i].name,
+					getStageName(stage),
+					fmt::format("{}", allocations.count),
+					formatMegabytes(allocations.bytes),
+					formatMegabytes(allocations.peakLiveBytes)
+				});
+			}
+		}
+	}
+
+	// Writes the results as JSON, for comparison between builds
+	void writeResults(
+		const path& filePath,
+		const vector<ScenarioResult>& results,
+		const string& configuration,
+		bool stageAllocations
+	) {
+		std::ofstream file;
+		file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+		try {
+			file.open(filePath);
+			file << "{\n";
+			file << fmt::format("  \"configuration\": \"{}\",\n", configuration);
+			file << "  \"scenarios\": [";
+			bool isFirst = true;
+			for (const ScenarioResult& result : results) {
+				const Summary summary = summarize(result);
+				file << (isFirst ? "\n" : ",\n");
+				isFirst = false;
+				file << "    {\n";
+				file << fmt::format("      \"name\": \"{}\",\n", result.name);
+				file << fmt::format("      \"audioSeconds\": {:.2f},\n", static_cast<double>(result.duration.count()) / 100);
+				file << fmt::format("      \"runs\": {},\n", result.runs.size());
+				file << fmt::format("      \"realTimeFactor\": {:.4f},\n", summary.realTimeFactor);
+				file << fmt::format("      \"p50Milliseconds\": {:.2f},\n", summary.p50Milliseconds);
+				file << fmt::format("      \"p99Milliseconds\": {:.2f},\n", summary.p99Milliseconds);
+				file << fmt::format("      \"firstMilliseconds\": {:.2f},\n", summary.firstMilliseconds);
+				file << fmt::format("      \"peakHeapBytes\": {},\n", summary.peakHeapSize);
+				if (result.shapeAgreement) {
+					file << fmt::format("      \"shapeAgreement\": {:.4f},\n", *result.shapeAgreement);
+				}
+				file << "      \"stageP50Milliseconds\": {";
+				for (size_t stage = 0; stage < stageCount; ++stage) {
+					file << fmt::format("{}\"{}\": {:.3f}",
+						stage == 0 ? "\n        " : ",\n        ", getStageName(stage), summary.stageP50Milliseconds[stage]);
+				}
+				file << "\n      }";
+				if (stageAllocations) {
+					file << ",\n      \"stageAllocations\": {";
+					for (size_t stage = 0; stage < stageCount; ++stage) {
+						const StageAllocations& allocations = summary.stageAllocations[stage];
+						file << fmt::format("{}\"{}\": {{ \"count\": {}, \"bytes\": {}, \"peakLiveBytes\": {} }}",
+							stage == 0 ? "\n        " : ",\n        ", getStageName(stage),
+							allocations.count, allocations.bytes, allocations.peakLiveBytes);
+					}
+					file << "\n      }";
+				}
+				file << "\n";
+				file << "    }";
+			}
+			file << "\n  ]\n";
+			file << "}\n";
+		} catch (...) {
+			std::throw_with_nested(runtime_error(fmt::format("Error writing file {}.", filePath.u8string())));
+		}
+	}
+
+}
+
+int main(int platformArgc, char* platformArgv[]) {
+	NiceCmdLineOutput cmdLineOutput;
+	TCLAP::CmdLine cmd(string(appName) + " benchmark", ' ', appVersion);
+	cmd.setOutput(&cmdLineOutput);
+	cmd.setExceptionHandling(false);
+
+	TCLAP::ValueArg<string> modelDirectory(
+		"", "models", "The directory containing the speech recognition models.",
+		false, LIPSYNCENGINE_SOURCE_DIR "/models/sphinx", "path", cmd);
+	TCLAP::ValueArg<string> corpusDirectory(
+		"", "corpus", "The directory of the PocketSphinx \"cards\" recordings the corpus is made of.",
+		false, LIPSYNCENGINE_SOURCE_DIR "/lib/pocketsphinx-rev13216/test/data/cards", "path", cmd);
+	TCLAP::MultiArg<string> scenarioNames(
+		"s", "scenario", "A scenario to run, such as \"dialog\" or \"dialog-text\" (with dialog text). "
+		"Defaults to all scenarios.",
+		false, "name", cmd);
+	TCLAP::ValueArg<int> iterationCount(
+		"i", "iterations", "The number of analyses per scenario. "
+		"Defaults to 20 for the bark, 5 for the dialog, and 2 for the monologue.",
+		false, 0, "number", cmd);
+	TCLAP::ValueArg<int> threadCount(
+		"", "threads", "The maximum number of threads per analysis.",
+		false, 1, "number", cmd);
+	vector<string> recognizerNames { "pocketSphinx", "phonetic", "classifier" };
+	TCLAP::ValuesConstraint<string> recognizerConstraint(recognizerNames);
+	TCLAP::ValueArg<string> recognizerName(
+		"r", "recognizer", "The speech recognizer to use.",
+		false, "pocketSphinx", &recognizerConstraint, cmd);
+	vector<string> profileNames { "offline", "offlineOneBest", "balanced", "realtime", "realtimeDownsampled", "streaming" };
+	TCLAP::ValuesConstraint<string> profileConstraint(profileNames);
+	TCLAP::ValueArg<string> profileName(
+		"", "profile", "The decoder profile of the pocketSphinx recognizer. "
+		"For offlineOneBest, the agreement of the animations with those of offline is measured.",
+		false, "offline", &profileConstraint, cmd);
+	vector<string> languageModelNames { "full", "small", "vocabulary" };
+	TCLAP::ValuesConstraint<string> languageModelConstraint(languageModelNames);
+	TCLAP::ValueArg<string> languageModelName(
+		"", "languageModel", "The language model of the pocketSphinx recognizer. "
+		"For the small one and a vocabulary pack, the agreement of the animations with those of the full one "
+		"is measured.",
+		false, "full", &languageModelConstraint, cmd);
+	vector<string> dialogModeNames { "biased", "strict", "verbatim" };
+	TCLAP::ValuesConstraint<string> dialogModeConstraint(dialogModeNames);
+	TCLAP::ValueArg<string> dialogModeName(
+		"", "dialogMode", "How the dialog constrains the pocketSphinx recognizer in the -text scenarios. "
+		"For strict and verbatim, the agreement of the animations with those of biased ones is measured.",
+		false, "biased", &dialogModeConstraint, cmd);
+	TCLAP::SwitchArg textOnly(
+		"", "text", "Only benchmark the per-word text processing of dialog-aware analyses, "
+		"with 1000 iterations unless specified.",
+		cmd, false);
+	TCLAP::SwitchArg micro(
+		"", "micro", "Only time timeline operations, animation passes, text processing and the JSON export on "
+		"synthetic inputs for 1 s to 1 h of audio, reporting how their time grows with the duration.",
+		cmd, false);
+	TCLAP::SwitchArg utteranceCache(
+		"", "utteranceCache", "Reuse the phones of utterances recognized in earlier runs, as re-analyses "
+		"of edited audio do. Off by default, so that every run recognizes all utterances.",
+		cmd, false);
+	TCLAP::ValueArg<string> outputFile(
+		"o", "output", "A JSON file to write the results to, for comparison with other builds.",
+		false, string(), "path", cmd);
+	TCLAP::ValueArg<string> animationDirectory(
+		"", "animations", "A directory to write the animation of each scenario to, for comparison with "
+		"other builds using --reference.",
+		false, string(), "path", cmd);
+	TCLAP::ValueArg<string> referenceDirectory(
+		"", "reference", "A directory of animations written by another build using --animations, such as "
+		"the floating-point build for a fixed-point one. The agreement of the animations with them is measured.",
+		false, string(), "path", cmd);
+	TCLAP::SwitchArg pareto(
+		"", "pareto", "Sweep the recognizers, profiles and language models instead of benchmarking one "
+		"configuration, scoring each against reference animations (those of --reference if set, such as "
+		"labelled ones, or else the offline profile's) and marking the Pareto frontier of speed and accuracy. "
+		"Runs the dialog scenarios unless specified.",
+		cmd, false);
+	TCLAP::SwitchArg allocations(
+		"", "allocations", "Count the heap allocations, allocated bytes and peak live bytes of every stage. "
+		"WASM builds only see the allocations of C++ code, not those of the C libraries.",
+		cmd, false);
+	TCLAP::ValueArg<string> traceFile(
+		"", "trace", "A JSON file to write trace spans of the runs to, for chrome://tracing or Perfetto.",
+		false, string(), "path", cmd);
+
+	try {
+		cmd.parse(platformArgc, platformArgv);
+	} catch (TCLAP::ArgException& e) {
+		cmdLineOutput.failure(cmd, e);
+		return 1;
+	} catch (const TCLAP::ExitException& e) {
+		return e.getExitStatus();
+	}
+
+	try {
+		if (threadCount.getValue() < 1) {
+			throw std::invalid_argument(fmt::format("Thread count must be 1 or higher; got {}.", threadCount.getValue()));
+		}
+		if (iterationCount.isSet() && iterationCount.getValue() < 1) {
+			throw std::invalid_argument(fmt::format("Iteration count must be 1 or higher; got {}.", iterationCount.getValue()));
+		}
+
+		if (allocations.getValue() && !areStageAllocationsCounted()) {
+			throw std::invalid_argument("This build can't count allocations. "
+				"Allocations are counted natively on Linux and in WASM.");
+		}
+
+		if (micro.getValue()) {
+			runMicroBenchmark(outputFile.isSet() ? optional<path>(outputFile.getValue()) : boost::none);
+			return 0;
+		}
+
+		if (textOnly.getValue()) {
+			const vector<BenchmarkClip> corpus = createCorpus(path(corpusDirectory.getValue()));
+			runTextBenchmark(corpus, iterationCount.isSet() ? iterationCount.getValue() : 1000);
+			return 0;
+		}
+
+		const path models(modelDirectory.getValue());
+		if (!exists(models / "acoustic-model")) {
+			throw runtime_error(fmt::format("No speech recognition models found in {}.", models.u8string()));
+		}
+		setSphinxModelDirectory(models);
+		const LanguageModelVariant languageModel = languageModelName.getValue() == "small"
+			? LanguageModelVariant::Small
+			: languageModelName.getValue() == "vocabulary"
+			? LanguageModelVariant::Vocabulary
+			: LanguageModelVariant::Full;
+		setSphinxLanguageModelVariant(languageModel);
+		setUtterancePhoneCacheEnabled(utteranceCache.getValue());
+		if (!exists(getSphinxLanguageModelPath())) {
+			throw runtime_error(fmt::format("No language model {}. Generate it with {}.",
+				getSphinxLanguageModelPath().u8string(),
+				languageModel == LanguageModelVariant::Vocabulary
+					? "lip-sync-engine-vocabulary-pack"
+					: "lip-sync-engine-language-model"));
+		}
+
+		const DecoderProfile profile = profileName.getValue() == "streaming" ? DecoderProfile::Streaming
+			: profileName.getValue() == "realtimeDownsampled" ? DecoderProfile::RealtimeDownsampled
+			: profileName.getValue() == "realtime" ? DecoderProfile::Realtime
+			: profileName.getValue() == "balanced" ? DecoderProfile::Balanced
+			: profileName.getValue() == "offlineOneBest" ? DecoderProfile::OfflineOneBest
+			: DecoderProfile::Offline;
+		const bool phonesOnly = recognizerName.getValue() != "pocketSphinx";
+		const DialogMode dialogMode = phonesOnly ? DialogMode::Biased
+			: dialogModeName.getValue() == "verbatim" ? DialogMode::Verbatim
+			: dialogModeName.getValue() == "strict" ? DialogMode::Strict
+			: DialogMode::Biased;
+		unique_ptr<Recognizer> recognizer;
+		if (recognizerName.getValue() == "phonetic") {
+			recognizer = std::make_unique<PhoneticRecognizer>();
+		} else if (recognizerName.getValue() == "classifier") {
+			recognizer = std::make_unique<FrameClassifierRecognizer>();
+		} else {
+			recognizer = std::make_unique<PocketSphinxRecognizer>(profile, dialogMode);
+		}
+		ShapeSet targetShapeSet = ShapeConverter::get().getBasicShapes();
+		for (const Shape shape : ShapeConverter::get().getExtendedShapes()) {
+			targetShapeSet.insert(shape);
+		}
+
+		const vector<BenchmarkClip> corpus = createCorpus(path(corpusDirectory.getValue()));
+		const std::array<int, 3> defaultIterationCounts { 20, 5, 2 };
+		vector<Scenario> scenarios;
+		for (size_t i = 0; i < corpus.size(); ++i) {
+			for (const bool withDialog : { false, true }) {
+				Scenario scenario {
+					&corpus[i],
+					withDialog,
+					iterationCount.isSet() ? iterationCount.getValue() : defaultIterationCounts[i]
+				};
+				const vector<string> names = scenarioNames.getValue().empty() && pareto.getValue()
+					? vector<string> { "dialog", "dialog-text" }
+					: scenarioNames.getValue();
+				if (names.empty() || std::find(names.begin(), names.end(), scenario.getName()) != names.end()) {
+					scenarios.push_back(scenario);
+				}
+			}
+		}
+		if (scenarios.empty()) {
+			throw std::invalid_argument("No scenario matches. "
+				"Scenarios are bark, dialog and monologue, each with a -text variant.");
+		}
+
+		if (pareto.getValue()) {
+			runParetoBenchmark(
+				scenarios,
+				targetShapeSet,
+				threadCount.getValue(),
+				referenceDirectory.isSet() ? optional<path>(referenceDirectory.getValue()) : boost::none,
+				outputFile.isSet() ? optional<path>(outputFile.getValue()) : boost::none);
+			return 0;
+		}
+
+		// Trace from the start, so that the spans include reading the models and creating decoders
+		setTracingEnabled(traceFile.isSet());
+
+		setStageAllocationTracking(allocations.getValue());
+
+		// Create a decoder, so that no scenario pays for it
+		runScenario(Scenario { &corpus.front(), false, 1 }, *recognizer, targetShapeSet, 1);
+
+		vector<ScenarioResult> results;
+		for (const Scenario& scenario : scenarios) {
+			ScenarioResult result { scenario.getName(), scenario.clip->getDuration(), {}, boost::none };
+			for (int i = 0; i < scenario.iterationCount; ++i) {
+				std::cerr << fmt::format("{} #{}\n", result.name, i + 1);
+				result.runs.push_back(runScenario(scenario, *recognizer, targetShapeSet, threadCount.getValue()));
+			}
+			results.push_back(std::move(result));
+		}
+		if (traceFile.isSet()) {
+			std::ofstream file(traceFile.getValue());
+			file << "{\"traceEvents\":" << takeChromeTraceEvents(1, 0) << "}\n";
+			if (!file) {
+				throw runtime_error(fmt::format("Failed to write {}.", traceFile.getValue()));
+			}
+			setTracingEnabled(false);
+		}
+
+		// Compare with the full language model, biased dialogs and lattice rescoring once the runs are
+		// done, so that their decoders don't count towards the heap of the runs
+		const DecoderProfile referenceProfile =
+			profile == DecoderProfile::OfflineOneBest && !phonesOnly
+				? DecoderProfile::Offline
+				: profile;
+		const bool compareConfigurations = languageModel != LanguageModelVariant::Full
+			|| dialogMode != DialogMode::Biased || referenceProfile != profile;
+		if (compareConfigurations && referenceDirectory.isSet()) {
+			throw std::invalid_argument("A reference build can only be compared with the default configuration "
+				"of the chosen profile: full language model, biased dialog, and no offlineOneBest profile.");
+		}
+		if (compareConfigurations) {
+			const unique_ptr<Recognizer> separateReferenceRecognizer =
+				dialogMode != DialogMode::Biased || referenceProfile != profile
+					? std::make_unique<PocketSphinxRecognizer>(referenceProfile)
+					: nullptr;
+			const Recognizer& referenceRecognizer = separateReferenceRecognizer ? *separateReferenceRecognizer : *recognizer;
+			for (size_t i = 0; i < scenarios.size(); ++i) {
+				std::cerr << fmt::format("{} agreement\n", results[i].name);
+				const JoiningContinuousTimeline<Shape> animation =
+					animateScenario(scenarios[i], *recognizer, targetShapeSet, threadCount.getValue());
+				setSphinxLanguageModelVariant(LanguageModelVariant::Full);
+				const JoiningContinuousTimeline<Shape> reference =
+					animateScenario(scenarios[i], referenceRecognizer, targetShapeSet, threadCount.getValue());
+				setSphinxLanguageModelVariant(languageModel);
+				results[i].shapeAgreement = getShapeAgreement(animation, reference);
+			}
+		}
+
+		// Compare with another build, e.g. floating-point with fixed-point
+		if (animationDirectory.isSet() || referenceDirectory.isSet()) {
+			if (animationDirectory.isSet()) {
+				std::filesystem::create_directories(path(animationDirectory.getValue()));
+			}
+			for (size_t i = 0; i < scenarios.size(); ++i) {
+				const JoiningContinuousTimeline<Shape> animation =
+					animateScenario(scenarios[i], *recognizer, targetShapeSet, threadCount.getValue());
+				const string fileName = results[i].name + ".txt";
+				if (animationDirectory.isSet()) {
+					writeAnimation(path(animationDirectory.getValue()) / fileName, animation);
+				}
+				if (referenceDirectory.isSet()) {
+					const JoiningContinuousTimeline<Shape> reference =
+						readAnimation(path(referenceDirectory.getValue()) / fileName);
+					results[i].shapeAgreement = getShapeAgreement(animation, reference);
+				}
+			}
+		}
+
+		printResults(results, allocations.getValue());
+
+		if (outputFile.isSet()) {
+			const string configuration = fmt::format("{} recognizer, {} profile, {} language model, {} dialog, {} threads, {}",
+				recognizerName.getValue(), profileName.getValue(), languageModelName.getValue(),
+				dialogMode == DialogMode::Biased ? "biased" : dialogModeName.getValue(), threadCount.getValue(),
+				arithmetic);
+			writeResults(path(outputFile.getValue()), results, configuration, allocations.getValue());
+		}
+		return 0;
+	} catch (const std::exception& e) {
+		std::cerr << getMessage(e) << std::endl;
+		return 1;
+	}
+}
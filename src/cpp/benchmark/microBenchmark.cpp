@@ -0,0 +1,449 @@
+#include "microBenchmark.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <array>
+#include <functional>
+#include <random>
+#include <format.h>
+#include "time/ContinuousTimeline.h"
+#include "animation/ShapeRule.h"
+#include "animation/roughAnimation.h"
+#include "animation/timingOptimization.h"
+#include "animation/pauseAnimation.h"
+#include "animation/tweening.h"
+#include "animation/staticSegments.h"
+#include "recognition/tokenization.h"
+#include "recognition/languageModels.h"
+#include "recognition/g2p.h"
+#include "recognition/pocketSphinxTools.h"
+#include "exporters/JsonExporter.h"
+#include "tools/TablePrinter.h"
+
+using std::string;
+using std::vector;
+using std::function;
+using std::runtime_error;
+using std::filesystem::path;
+using std::chrono::steady_clock;
+
+namespace {
+
+	using seconds = std::chrono::duration<double>;
+
+	// The audio durations the inputs are synthesized for
+	const std::array<centiseconds, 4> inputDurations { 100_cs, 6000_cs, 60000_cs, 360000_cs };
+	const std::array<const char*, 4> inputDurationNames { "1 s", "1 min", "10 min", "1 h" };
+
+	// Operations whose count doesn't grow with the input, so that they are timed per operation
+	// against the size of the timeline
+	constexpr int editCount = 1000;
+	constexpr int lookupCount = 10000;
+
+	// Runs of at least this duration are timed as one; shorter ones are repeated up to it
+	constexpr seconds minTimedDuration(0.05);
+
+	// Growth exponents above this are flagged as superlinear. Once the inputs outgrow the CPU caches,
+	// linear cases grow by exponents up to about 1.6; quadratic ones by 2 or more.
+	constexpr double superlinearGrowth = 1.75;
+
+	// Keeps the compiler from discarding the results
+	volatile size_t checksumSink;
+
+	// A benchmark case: prepare(duration) synthesizes the input for a duration and returns the
+	// function to time, which returns a checksum. Only the returned function is timed.
+	struct MicroBenchmarkCase {
+		string name;
+		function<function<size_t()>(centiseconds)> prepare;
+	};
+
+	struct MicroBenchmarkResult {
+		string name;
+		std::array<double, 4> seconds;
+		// The exponent of the duration by which the time grows from 10 min to 1 h
+		double growth;
+	};
+
+	// Returns the mean time of a run of the function
+	double timeRuns(const function<size_t()>& run) {
+		size_t checksum = 0;
+		int runCount = 0;
+		const auto start = steady_clock::now();
+		seconds elapsed;
+		do {
+			checksum += run();
+			++runCount;
+			elapsed = steady_clock::now() - start;
+		} while (elapsed < minTimedDuration);
+		checksumSink = checksum;
+		return elapsed.count() / runCount;
+	}
+
+	// Synthesizes elements of 5 to 15 cs covering the duration, with values from 0 to 3, so that
+	// joining timelines join some of them
+	vector<Timed<int>> createElements(centiseconds duration) {
+		std::mt19937 random(duration.count());
+		std::uniform_int_distribution<int> lengths(5, 15);
+		std::uniform_int_distribution<int> values(0, 3);
+		vector<Timed<int>> elements;
+		for (centiseconds start = 0_cs; start < duration;) {
+			const centiseconds end = std::min(start + centiseconds(lengths(random)), duration);
+			elements.emplace_back(start, end, values(random));
+			start = end;
+		}
+		return elements;
+	}
+
+	// Random time ranges of 5 to 30 cs within the duration
+	vector<TimeRange> createEditRanges(centiseconds duration, int count) {
+		std::mt19937 random(static_cast<unsigned>(duration.count()) + 1);
+		std::uniform_int_distribution<int> starts(0, static_cast<int>(duration.count()) - 1);
+		std::uniform_int_distribution<int> lengths(5, 30);
+		vector<TimeRange> ranges;
+		for (int i = 0; i < count; ++i) {
+			const centiseconds start(starts(random));
+			ranges.emplace_back(start, start + centiseconds(lengths(random)));
+		}
+		return ranges;
+	}
+
+	template<typename TTimeline>
+	TTimeline createTimeline(centiseconds duration);
+
+	template<>
+	Timeline<int> createTimeline<Timeline<int>>(centiseconds) {
+		return Timeline<int>();
+	}
+
+	template<>
+	JoiningTimeline<int> createTimeline<JoiningTimeline<int>>(centiseconds) {
+		return JoiningTimeline<int>();
+	}
+
+	template<>
+	BoundedTimeline<int> createTimeline<BoundedTimeline<int>>(centiseconds duration) {
+		return BoundedTimeline<int>(TimeRange(0_cs, duration));
+	}
+
+	template<>
+	ContinuousTimeline<int> createTimeline<ContinuousTimeline<int>>(centiseconds duration) {
+		return ContinuousTimeline<int>(TimeRange(0_cs, duration), -1);
+	}
+
+	// The cases of a timeline type: building it in time order, editing and querying it at random
+	// times, and shifting it
+	template<typename TTimeline>
+	void addTimelineCases(const string& typeName, vector<MicroBenchmarkCase>& cases) {
+		cases.push_back({ typeName + "::set (in order)", [](centiseconds duration) {
+			return [elements = createElements(duration), duration]() {
+				TTimeline timeline = createTimeline<TTimeline>(duration);
+				for (const Timed<int>& element : elements) {
+					timeline.set(element);
+				}
+				return timeline.size();
+			};
+		} });
+		cases.push_back({ typeName + fmt::format("::set ({} random)", editCount), [](centiseconds duration) {
+			TTimeline timeline = createTimeline<TTimeline>(duration);
+			for (const Timed<int>& element : createElements(duration)) {
+				timeline.set(element);
+			}
+			return [timeline = std::move(timeline), ranges = createEditRanges(duration, editCount)]() {
+				TTimeline edited(timeline);
+				for (const TimeRange& range : ranges) {
+					edited.set(range, 7);
+				}
+				return edited.size();
+			};
+		} });
+		cases.push_back({ typeName + fmt::format("::clear ({} random)", editCount), [](centiseconds duration) {
+			TTimeline timeline = createTimeline<TTimeline>(duration);
+			for (const Timed<int>& element : createElements(duration)) {
+				timeline.set(element);
+			}
+			return [timeline = std::move(timeline), ranges = createEditRanges(duration, editCount)]() {
+				TTimeline edited(timeline);
+				for (const TimeRange& range : ranges) {
+					edited.clear(range);
+				}
+				return edited.size();
+			};
+		} });
+		cases.push_back({ typeName + fmt::format("::find ({} random)", lookupCount), [](centiseconds duration) {
+			TTimeline timeline = createTimeline<TTimeline>(duration);
+			for (const Timed<int>& element : createElements(duration)) {
+				timeline.set(element);
+			}
+			return [timeline = std::move(timeline), ranges = createEditRanges(duration, lookupCount)]() {
+				size_t checksum = 0;
+				for (const TimeRange& range : ranges) {
+					checksum += timeline.find(range.getStart()) != timeline.end();
+				}
+				return checksum;
+			};
+		} });
+		cases.push_back({ typeName + "::shift", [](centiseconds duration) {
+			TTimeline timeline = createTimeline<TTimeline>(duration);
+			for (const Timed<int>& element : createElements(duration)) {
+				timeline.set(element);
+			}
+			return [timeline = std::move(timeline)]() mutable {
+				timeline.shift(1_cs);
+				return timeline.size();
+			};
+		} });
+	}
+
+	// Synthesizes speech of words of 2 to 6 phones of 5 to 15 cs each, separated by pauses of up to
+	// 80 cs, some long enough to close the mouth
+	BoundedTimeline<Phone> createPhones(centiseconds duration) {
+		std::mt19937 random(duration.count());
+		std::uniform_int_distribution<int> phoneCounts(2, 6);
+		std::uniform_int_distribution<int> phoneLengths(5, 15);
+		std::uniform_int_distribution<int> pauseLengths(0, 80);
+		std::uniform_int_distribution<int> phones(0, static_cast<int>(Phone::W));
+		BoundedTimeline<Phone> result(TimeRange(0_cs, duration));
+		centiseconds time = 0_cs;
+		while (time < duration) {
+			const int phoneCount = phoneCounts(random);
+			for (int i = 0; i < phoneCount && time < duration; ++i) {
+				const centiseconds end = std::min(time + centiseconds(phoneLengths(random)), duration);
+				result.set(time, end, static_cast<Phone>(phones(random)));
+				time = end;
+			}
+			time += centiseconds(pauseLengths(random));
+		}
+		return result;
+	}
+
+	JoiningContinuousTimeline<Shape> animateMainSteps(const ContinuousTimeline<ShapeRule>& shapeRules) {
+		JoiningContinuousTimeline<Shape> animation = optimizeTiming(animateRough(shapeRules));
+		animatePauses(animation);
+		insertTweens(animation);
+		return animation;
+	}
+
+	void addAnimationCases(vector<MicroBenchmarkCase>& cases) {
+		cases.push_back({ "getShapeRules", [](centiseconds duration) {
+			return [phones = createPhones(duration)]() {
+				return getShapeRules(phones).size();
+			};
+		} });
+		cases.push_back({ "animateRough", [](centiseconds duration) {
+			return [shapeRules = getShapeRules(createPhones(duration))]() {
+				return animateRough(shapeRules).size();
+			};
+		} });
+		cases.push_back({ "optimizeTiming", [](centiseconds duration) {
+			return [animation = animateRough(getShapeRules(createPhones(duration)))]() {
+				return optimizeTiming(animation).size();
+			};
+		} });
+		// The passes working in place include copying their input
+		cases.push_back({ "animatePauses (with copy)", [](centiseconds duration) {
+			return [animation = optimizeTiming(animateRough(getShapeRules(createPhones(duration))))]() {
+				JoiningContinuousTimeline<Shape> paused(animation);
+				animatePauses(paused);
+				return paused.size();
+			};
+		} });
+		cases.push_back({ "insertTweens (with copy)", [](centiseconds duration) {
+			JoiningContinuousTimeline<Shape> animation =
+				optimizeTiming(animateRough(getShapeRules(createPhones(duration))));
+			animatePauses(animation);
+			return [animation = std::move(animation)]() {
+				JoiningContinuousTimeline<Shape> tweened(animation);
+				insertTweens(tweened);
+				return tweened.size();
+			};
+		} });
+		cases.push_back({ "avoidStaticSegments", [](centiseconds duration) {
+			return [shapeRules = getShapeRules(createPhones(duration))]() {
+				return avoidStaticSegments(shapeRules, animateMainSteps).size();
+			};
+		} });
+		cases.push_back({ "JsonExporter", [](centiseconds duration) {
+			ShapeSet targetShapeSet = ShapeConverter::get().getBasicShapes();
+			for (const Shape shape : ShapeConverter::get().getExtendedShapes()) {
+				targetShapeSet.insert(shape);
+			}
+			const JoiningContinuousTimeline<Shape> animation =
+				avoidStaticSegments(getShapeRules(createPhones(duration)), animateMainSteps);
+			return [input = ExporterInput("input.wav", animation, targetShapeSet)]() {
+				std::ostringstream json;
+				JsonExporter().exportAnimation(input, json);
+				return json.str().size();
+			};
+		} });
+	}
+
+	// Synthesizes dialog of about 2.5 words per second, in sentences of 3 to 15 words drawn from a
+	// vocabulary of 2000 pronounceable made-up words
+	vector<string> createSentences(centiseconds duration) {
+		static const vector<string> vocabulary = [] {
+			const std::array<const char*, 8> onsets { "b", "d", "f", "k", "l", "m", "s", "tr" };
+			const std::array<const char*, 5> vowels { "a", "e", "i", "o", "u" };
+			const std::array<const char*, 5> codas { "", "n", "st", "m", "r" };
+			std::mt19937 random(2000);
+			std::uniform_int_distribution<size_t> onsetIndexes(0, onsets.size() - 1);
+			std::uniform_int_distribution<size_t> vowelIndexes(0, vowels.size() - 1);
+			std::uniform_int_distribution<size_t> codaIndexes(0, codas.size() - 1);
+			std::uniform_int_distribution<int> syllableCounts(1, 3);
+			vector<string> words;
+			while (words.size() < 2000) {
+				string word;
+				for (int syllableCount = syllableCounts(random); syllableCount > 0; --syllableCount) {
+					word += string(onsets[onsetIndexes(random)]) + vowels[vowelIndexes(random)] + codas[codaIndexes(random)];
+				}
+				words.push_back(word);
+			}
+			return words;
+		}();
+
+		std::mt19937 random(duration.count());
+		std::uniform_int_distribution<size_t> wordIndexes(0, vocabulary.size() - 1);
+		std::uniform_int_distribution<int> sentenceLengths(3, 15);
+		const int wordCount = std::max(1, static_cast<int>(duration.count() / 40));
+		vector<string> sentences;
+		for (int word = 0; word < wordCount;) {
+			string sentence;
+			for (int i = sentenceLengths(random); i > 0 && word < wordCount; --i, ++word) {
+				sentence += (sentence.empty() ? "" : " ") + vocabulary[wordIndexes(random)];
+			}
+			sentences.push_back(sentence + ".");
+		}
+		return sentences;
+	}
+
+	void addTextCases(vector<MicroBenchmarkCase>& cases) {
+		const auto dictionaryContains = [](const string&) { return true; };
+		const auto join = [](const vector<string>& sentences) {
+			string text;
+			for (const string& sentence : sentences) {
+				text += (text.empty() ? "" : " ") + sentence;
+			}
+			return text;
+		};
+
+		cases.push_back({ "tokenizeText", [=](centiseconds duration) {
+			return [text = join(createSentences(duration)), dictionaryContains]() {
+				return tokenizeText(text, dictionaryContains).size();
+			};
+		} });
+		cases.push_back({ "wordToPhones (cached)", [=](centiseconds duration) {
+			const vector<string> words = tokenizeText(join(createSentences(duration)), dictionaryContains);
+			// Guess the pronunciations once, as the dialog of a recognition would
+			for (const string& word : words) {
+				wordToPhones(word);
+			}
+			return [words]() {
+				size_t checksum = 0;
+				for (const string& word : words) {
+					checksum += wordToPhones(word).size();
+				}
+				return checksum;
+			};
+		} });
+		cases.push_back({ "createLanguageModel", [=](centiseconds duration) {
+			// Each sentence between "<s>" and "</s>", as for the dialog of a recognition
+			vector<string> words;
+			for (const string& sentence : createSentences(duration)) {
+				words.push_back("<s>");
+				for (const string& word : tokenizeText(sentence, dictionaryContains)) {
+					words.push_back(word);
+				}
+				words.push_back("</s>");
+			}
+			const std::shared_ptr<logmath_t> lmath(
+				logmath_init(1.0001, 0, 0),
+				[](logmath_t* lmath) { logmath_free(lmath); });
+			return [words, lmath]() {
+				const lambda_unique_ptr<ngram_model_t> model =
+					createInterpolatedLanguageModel(words, UnigramProbabilities(), 0.0, *lmath);
+				return static_cast<size_t>(ngram_model_get_size(model.get()));
+			};
+		} });
+	}
+
+	string formatSeconds(double seconds) {
+		if (seconds < 1e-3) return fmt::format("{:.1f} us", seconds * 1e6);
+		if (seconds < 1) return fmt::format("{:.2f} ms", seconds * 1e3);
+		return fmt::format("{:.2f} s", seconds);
+	}
+
+	void writeResults(const path& filePath, const vector<MicroBenchmarkResult>& results) {
+		std::ofstream file;
+		file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+		try {
+			file.open(filePath);
+			file << "{\n";
+			file << "  \"audioSeconds\": [";
+			for (size_t i = 0; i < inputDurations.size(); ++i) {
+				file << fmt::format("{}{}", i == 0 ? "" : ", ", inputDurations[i].count() / 100);
+			}
+			file << "],\n";
+			file << "  \"cases\": [";
+			for (size_t i = 0; i < results.size(); ++i) {
+				const MicroBenchmarkResult& result = results[i];
+				file << (i == 0 ? "\n" : ",\n");
+				file << fmt::format("    {{ \"name\": \"{}\", \"seconds\": [", result.name);
+				for (size_t size = 0; size < result.seconds.size(); ++size) {
+					file << fmt::format("{}{:.9f}", size == 0 ? "" : ", ", result.seconds[size]);
+				}
+				file << fmt::format("], \"growth\": {:.3f} }}", result.growth);
+			}
+			file << "\n  ]\n";
+			file << "}\n";
+		} catch (...) {
+			std::throw_with_nested(runtime_error(fmt::format("Error writing file {}.", filePath.u8string())));
+		}
+	}
+
+}
+
+void runMicroBenchmark(const boost::optional<path>& outputFile) {
+	// Keep the language model's log messages out of the table
+	redirectPocketSphinxOutput();
+
+	vector<MicroBenchmarkCase> cases;
+	addTimelineCases<Timeline<int>>("Timeline", cases);
+	addTimelineCases<JoiningTimeline<int>>("JoiningTimeline", cases);
+	addTimelineCases<BoundedTimeline<int>>("BoundedTimeline", cases);
+	addTimelineCases<ContinuousTimeline<int>>("ContinuousTimeline", cases);
+	addAnimationCases(cases);
+	addTextCases(cases);
+
+	std::cout << "\nMicrobenchmarks (mean per run, growth as exponent of duration from 10 min to 1 h)\n";
+	const TablePrinter table(&std::cout, { 40, 11, 11, 11, 11, 8 });
+	table.printRow({ "case", inputDurationNames[0], inputDurationNames[1], inputDurationNames[2], inputDurationNames[3], "growth" });
+	vector<MicroBenchmarkResult> results;
+	bool anySuperlinear = false;
+	for (const MicroBenchmarkCase& benchmarkCase : cases) {
+		MicroBenchmarkResult result { benchmarkCase.name, {}, 0.0 };
+		for (size_t size = 0; size < inputDurations.size(); ++size) {
+			result.seconds[size] = timeRuns(benchmarkCase.prepare(inputDurations[size]));
+		}
+		result.growth = std::log(result.seconds[3] / result.seconds[2])
+			/ std::log(static_cast<double>(inputDurations[3].count()) / inputDurations[2].count());
+		const bool superlinear = result.growth > superlinearGrowth;
+		anySuperlinear |= superlinear;
+		table.printRow({
+			result.name,
+			formatSeconds(result.seconds[0]),
+			formatSeconds(result.seconds[1]),
+			formatSeconds(result.seconds[2]),
+			formatSeconds(result.seconds[3]),
+			fmt::format("{:.2f}{}", result.growth, superlinear ? " !" : "")
+		});
+		results.push_back(result);
+	}
+	if (anySuperlinear) {
+		std::cout << fmt::format("! Grows faster than duration^{}.\n", superlinearGrowth);
+	}
+
+	if (outputFile) {
+		writeResults(*outputFile, results);
+	}
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <filesystem>
+#include <compat/boost_compat.h>
+
+// Times the building blocks of an analysis on synthetic inputs for 1 s, 1 min, 10 min and 1 h of
+// audio: timeline operations, the animation passes, the text front end and the JSON export.
+// Prints the time of each at every size and its growth from 10 min to 1 h as the exponent of the
+// duration, so that quadratic behavior stands out. Writes the results as JSON if outputFile is set.
+void runMicroBenchmark(const boost::optional<std::filesystem::path>& outputFile);
@@ -0,0 +1,248 @@
+#include "paretoBenchmark.h"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <format.h>
+#include "benchmark/animationComparison.h"
+#include "benchmark/heapTracking.h"
+#include "recognition/PocketSphinxRecognizer.h"
+#include "recognition/PhoneticRecognizer.h"
+#include "recognition/FrameClassifierRecognizer.h"
+#include "recognition/pocketSphinxTools.h"
+#include "tools/TablePrinter.h"
+#include "tools/exceptions.h"
+
+using std::string;
+using std::vector;
+using std::unique_ptr;
+using std::runtime_error;
+using std::filesystem::path;
+using std::chrono::steady_clock;
+using boost::optional;
+
+namespace {
+
+	using milliseconds = std::chrono::duration<double, std::milli>;
+
+	// A point of the sweep
+	struct Configuration {
+		string name;
+		LanguageModelVariant languageModel;
+		std::function<unique_ptr<Recognizer>()> createRecognizer;
+	};
+
+	struct ConfigurationResult {
+		string name;
+		double realTimeFactor;
+		double shapeAgreement;
+		double onsetErrorMilliseconds;
+		size_t peakHeapSize;
+		bool isParetoOptimal;
+	};
+
+	vector<Configuration> getConfigurations() {
+		const vector<std::pair<string, DecoderProfile>> profiles {
+			{ "offline", DecoderProfile::Offline },
+			{ "offlineOneBest", DecoderProfile::OfflineOneBest },
+			{ "balanced", DecoderProfile::Balanced },
+			{ "realtime", DecoderProfile::Realtime },
+			{ "realtimeDownsampled", DecoderProfile::RealtimeDownsampled },
+			{ "streaming", DecoderProfile::Streaming }
+		};
+		const vector<std::pair<string, LanguageModelVariant>> languageModels {
+			{ "full", LanguageModelVariant::Full },
+			{ "small", LanguageModelVariant::Small },
+			{ "vocabulary", LanguageModelVariant::Vocabulary }
+		};
+
+		vector<Configuration> configurations;
+		for (const auto& languageModel : languageModels) {
+			// The other language models only for the profiles that bound the range
+			for (const auto& profile : profiles) {
+				const bool isBound = profile.second == DecoderProfile::Offline
+					|| profile.second == DecoderProfile::Realtime;
+				if (languageModel.second != LanguageModelVariant::Full && !isBound) continue;
+
+				const DecoderProfile decoderProfile = profile.second;
+				configurations.push_back({
+					fmt::format("pocketSphinx {} {}", profile.first, languageModel.first),
+					languageModel.second,
+					[decoderProfile] { return std::make_unique<PocketSphinxRecognizer>(decoderProfile); }
+				});
+			}
+		}
+		configurations.push_back({
+			"phonetic", LanguageModelVariant::Full, [] { return std::make_unique<PhoneticRecognizer>(); }
+		});
+		configurations.push_back({
+			"classifier", LanguageModelVariant::Full, [] { return std::make_unique<FrameClassifierRecognizer>(); }
+		});
+		return configurations;
+	}
+
+	double getMedian(vector<double> values) {
+		std::sort(values.begin(), values.end());
+		return values[values.size() / 2];
+	}
+
+	ConfigurationResult runConfiguration(
+		const Configuration& configuration,
+		const vector<Scenario>& scenarios,
+		const vector<JoiningContinuousTimeline<Shape>>& references,
+		const ShapeSet& targetShapeSet,
+		int maxThreadCount
+	) {
+		const unique_ptr<Recognizer> recognizer = configuration.createRecognizer();
+		// Create the decoders, so that no run pays for them
+		animateScenario(scenarios.front(), *recognizer, targetShapeSet, maxThreadCount);
+
+		ConfigurationResult result { configuration.name, 0, 0, 0, 0, false };
+		double medianMilliseconds = 0;
+		double audioMilliseconds = 0;
+		double agreeingCentiseconds = 0;
+		double referenceCentiseconds = 0;
+		vector<double> onsetErrors;
+		for (size_t i = 0; i < scenarios.size(); ++i) {
+			const Scenario& scenario = scenarios[i];
+			std::cerr << fmt::format("{}: {}\n", configuration.name, scenario.getName());
+			vector<double> runMilliseconds;
+			optional<JoiningContinuousTimeline<Shape>> animation;
+			for (int run = 0; run < scenario.iterationCount; ++run) {
+				resetPeakHeapSize();
+				const auto start = steady_clock::now();
+				animation = animateScenario(scenario, *recognizer, targetShapeSet, maxThreadCount);
+				runMilliseconds.push_back(milliseconds(steady_clock::now() - start).count());
+				result.peakHeapSize = std::max(result.peakHeapSize, getPeakHeapSize());
+			}
+			medianMilliseconds += getMedian(runMilliseconds);
+			audioMilliseconds += static_cast<double>(scenario.clip->getDuration().count()) * 10;
+
+			// Weigh the agreement of each scenario by its length
+			const double duration = static_cast<double>(references[i].getRange().getDuration().count());
+			agreeingCentiseconds += getShapeAgreement(*animation, references[i]) * duration;
+			referenceCentiseconds += duration;
+			const vector<double> errors = getOnsetErrors(*animation, references[i]);
+			onsetErrors.insert(onsetErrors.end(), errors.begin(), errors.end());
+		}
+
+		result.realTimeFactor = medianMilliseconds / audioMilliseconds;
+		result.shapeAgreement = referenceCentiseconds > 0 ? agreeingCentiseconds / referenceCentiseconds : 1;
+		result.onsetErrorMilliseconds = onsetErrors.empty()
+			? 0
+			: std::accumulate(onsetErrors.begin(), onsetErrors.end(), 0.0) / static_cast<double>(onsetErrors.size());
+		return result;
+	}
+
+	// Marks the results that no other result beats in both speed and agreement
+	void markParetoFrontier(vector<ConfigurationResult>& results) {
+		for (ConfigurationResult& result : results) {
+			result.isParetoOptimal = std::none_of(results.begin(), results.end(), [&](const ConfigurationResult& other) {
+				return other.realTimeFactor <= result.realTimeFactor
+					&& other.shapeAgreement >= result.shapeAgreement
+					&& (other.realTimeFactor < result.realTimeFactor || other.shapeAgreement > result.shapeAgreement);
+			});
+		}
+	}
+
+	void writeResults(const path& filePath, const vector<ConfigurationResult>& results, const string& reference) {
+		std::ofstream file;
+		file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+		try {
+			file.open(filePath);
+			file << "{\n";
+			file << fmt::format("  \"reference\": \"{}\",\n", reference);
+			file << "  \"configurations\": [";
+			bool isFirst = true;
+			for (const ConfigurationResult& result : results) {
+				file << (isFirst ? "\n" : ",\n");
+				isFirst = false;
+				file << "    {\n";
+				file << fmt::format("      \"name\": \"{}\",\n", result.name);
+				file << fmt::format("      \"realTimeFactor\": {:.4f},\n", result.realTimeFactor);
+				file << fmt::format("      \"shapeAgreement\": {:.4f},\n", result.shapeAgreement);
+				file << fmt::format("      \"onsetErrorMilliseconds\": {:.1f},\n", result.onsetErrorMilliseconds);
+				file << fmt::format("      \"peakHeapBytes\": {},\n", result.peakHeapSize);
+				file << fmt::format("      \"paretoOptimal\": {}\n", result.isParetoOptimal ? "true" : "false");
+				file << "    }";
+			}
+			file << "\n  ]\n";
+			file << "}\n";
+		} catch (...) {
+			std::throw_with_nested(runtime_error(fmt::format("Error writing file {}.", filePath.u8string())));
+		}
+	}
+
+}
+
+void runParetoBenchmark(
+	const vector<Scenario>& scenarios,
+	const ShapeSet& targetShapeSet,
+	int maxThreadCount,
+	const optional<path>& referenceDirectory,
+	const optional<path>& outputFile
+) {
+	vector<JoiningContinuousTimeline<Shape>> references;
+	setSphinxLanguageModelVariant(LanguageModelVariant::Full);
+	if (referenceDirectory) {
+		for (const Scenario& scenario : scenarios) {
+			references.push_back(readAnimation(*referenceDirectory / (scenario.getName() + ".txt")));
+		}
+	} else {
+		const PocketSphinxRecognizer referenceRecognizer(DecoderProfile::Offline);
+		// Analyze with a used decoder, like the runs
+		animateScenario(scenarios.front(), referenceRecognizer, targetShapeSet, maxThreadCount);
+		for (const Scenario& scenario : scenarios) {
+			std::cerr << fmt::format("reference: {}\n", scenario.getName());
+			references.push_back(animateScenario(scenario, referenceRecognizer, targetShapeSet, maxThreadCount));
+		}
+	}
+
+	vector<ConfigurationResult> results;
+	for (const Configuration& configuration : getConfigurations()) {
+		setSphinxLanguageModelVariant(configuration.languageModel);
+		if (!exists(getSphinxLanguageModelPath())) {
+			std::cerr << fmt::format("Skipping {}: no language model {}\n",
+				configuration.name, getSphinxLanguageModelPath().u8string());
+			continue;
+		}
+
+		try {
+			results.push_back(runConfiguration(configuration, scenarios, references, targetShapeSet, maxThreadCount));
+		} catch (const std::exception& e) {
+			std::cerr << fmt::format("Skipping {}: {}\n", configuration.name, getMessage(e));
+		}
+	}
+	setSphinxLanguageModelVariant(LanguageModelVariant::Full);
+	markParetoFrontier(results);
+	std::sort(results.begin(), results.end(), [](const ConfigurationResult& a, const ConfigurationResult& b) {
+		return a.realTimeFactor < b.realTimeFactor;
+	});
+
+	const string reference = referenceDirectory
+		? referenceDirectory->u8string()
+		: "pocketSphinx offline full";
+	std::cout << fmt::format("Reference: {}\n", reference);
+	const TablePrinter table(&std::cout, { 38, 8, 10, 12, 12, 8 });
+	table.printRow({ "configuration", "RTF", "agreement", "onset error", "peak heap", "pareto" });
+	for (const ConfigurationResult& result : results) {
+		table.printRow({
+			result.name,
+			fmt::format("{:.3f}", result.realTimeFactor),
+			fmt::format("{:.1f} %", result.shapeAgreement * 100),
+			fmt::format("{:.1f} ms", result.onsetErrorMilliseconds),
+			fmt::format("{:.1f} MB", static_cast<double>(result.peakHeapSize) / (1024 * 1024)),
+			result.isParetoOptimal ? "*" : ""
+		});
+	}
+	if (!isHeapTracked()) {
+		std::cout << "Heap allocations are not tracked in this build; peak heap is the heap size.\n";
+	}
+
+	if (outputFile) {
+		writeResults(*outputFile, results, reference);
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+#include "benchmark/scenario.h"
+#include <compat/boost_compat.h>
+
+// Sweeps the configurations that trade accuracy for speed: the recognizers, the decoder profiles of
+// the pocketSphinx recognizer, and its small language model and vocabulary pack where the model
+// directory has them. Each configuration analyzes the scenarios, and its animations are scored
+// against reference animations by shape agreement per centisecond and onset error, alongside its
+// real-time factor and peak heap. Prints the configurations by speed, marking those on the Pareto
+// frontier of real-time factor and shape agreement, and writes them to the output file if given.
+// The references are read from the reference directory, one file per scenario as written by the
+// benchmark's --animations option or labelled by hand in that format. Without one, the animations
+// of the offline profile with the full language model serve as references.
+void runParetoBenchmark(
+	const std::vector<Scenario>& scenarios,
+	const ShapeSet& targetShapeSet,
+	int maxThreadCount,
+	const boost::optional<std::filesystem::path>& referenceDirectory,
+	const boost::optional<std::filesystem::path>& outputFile
+);
@@ -0,0 +1,24 @@
+#include "scenario.h"
+#include <memory>
+#include "bridge/audio_utils.h"
+#include "lib/lipSyncEngineLib.h"
+#include "tools/progress.h"
+#include <compat/boost_compat.h>
+
+using std::string;
+using std::unique_ptr;
+using boost::optional;
+
+JoiningContinuousTimeline<Shape> animateScenario(
+	const Scenario& scenario,
+	const Recognizer& recognizer,
+	const ShapeSet& targetShapeSet,
+	int maxThreadCount
+) {
+	const BenchmarkClip& clip = *scenario.clip;
+	const optional<string> dialog = scenario.withDialog ? optional<string>(clip.dialog) : boost::none;
+	const unique_ptr<AudioClip> audioClip =
+		createAudioClipViewFromPCM16(clip.samples.data(), clip.samples.size(), clip.sampleRate);
+	NullProgressSink progressSink;
+	return animateAudioClip(*audioClip, dialog, recognizer, targetShapeSet, maxThreadCount, progressSink);
+}
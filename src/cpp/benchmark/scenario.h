@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include "benchmark/corpus.h"
+#include "core/Shape.h"
+#include "recognition/Recognizer.h"
+#include "time/ContinuousTimeline.h"
+
+// A clip of the corpus, analyzed with or without its dialog text
+struct Scenario {
+	const BenchmarkClip* clip;
+	bool withDialog;
+	int iterationCount;
+
+	std::string getName() const {
+		return withDialog ? clip->name + "-text" : clip->name;
+	}
+};
+
+// Animates the clip of a scenario like an analysis of the bridge, without the export
+JoiningContinuousTimeline<Shape> animateScenario(
+	const Scenario& scenario,
+	const Recognizer& recognizer,
+	const ShapeSet& targetShapeSet,
+	int maxThreadCount
+);
@@ -0,0 +1,127 @@
+#include "textBenchmark.h"
+#include <iostream>
+#include <chrono>
+#include <functional>
+#include <format.h>
+#include "recognition/tokenization.h"
+#include "recognition/textNormalization.h"
+#include "recognition/pocketSphinxTools.h"
+#include "recognition/g2p.h"
+#include "tools/TablePrinter.h"
+#include "tools/stringTools.h"
+
+using std::string;
+using std::vector;
+using std::chrono::steady_clock;
+
+namespace {
+
+	using nanoseconds = std::chrono::duration<double, std::nano>;
+
+	// Keeps the compiler from discarding the calls
+	volatile size_t checksumSink;
+
+	// Calls the function for every word, returning the mean time per call
+	double timePerCall(
+		const vector<string>& words,
+		int iterationCount,
+		const std::function<size_t(const string&)>& function
+	) {
+		size_t checksum = 0;
+		const auto start = steady_clock::now();
+		for (int i = 0; i < iterationCount; ++i) {
+			for (const string& word : words) {
+				checksum += function(word);
+			}
+		}
+		const double duration = nanoseconds(steady_clock::now() - start).count();
+		checksumSink = checksum;
+		return duration / static_cast<double>(words.size() * iterationCount);
+	}
+
+#if defined(LIPSYNCENGINE_FLITE)
+	// Texts covering the rules of normalizeText() that the corpus dialogs may not reach
+	const vector<string> normalizationCases = {
+		"I paid $5.50 for 3 apples on 12/25/2019 at 10:30am.",
+		"Dr. Smith lives at 221B Baker St. in St. Louis, MO.",
+		"It's the 21st century; call 555-1234 or 1-800-555-0199.",
+		"The year 1984 was followed by 1985, and by the 1990s and the '90s.",
+		"He scored 3/4 of the points, about 75% in total, and won 50-50.",
+		"Mr. and Mrs. Jones moved to CA from NY in Jan.",
+		"King Henry VIII had six wives. Chapter IV begins here.",
+		"We need 1,234,567 dollars, $1,000,000 or $1.5 million.",
+		"The U.S.A. is big. e.g. NASA, FBI, IBM and XYZZY.",
+		"1st 2nd 3rd 4th 11th 12th 13th 22nd 101st 1000th",
+		"0.5 3.14159 -7 +3 -2.5 5 km, 10kg, 3 mph, 12 ft",
+		"rock'n'roll isn't don't won't y'all 'tis o'clock",
+		"\"Quoted,\" he said (loudly) [really] {oh}... OK?!",
+		"2001 1900 2000 1066 0800 007 12:00 1:05pm 23:59",
+		"qwrtp bcdfg hmm shh brr pfft nth, A B C and an A.",
+	};
+
+	// Compares normalizeText() to Flite on the texts, printing the texts whose words differ
+	void checkNormalizationParity(const vector<string>& texts) {
+		int mismatchCount = 0;
+		for (const string& text : texts) {
+			const vector<string> words = normalizeText(text, fliteLexiconContains);
+			const vector<string> fliteWords = tokenizeViaFlite(text);
+			if (words == fliteWords) continue;
+
+			if (++mismatchCount <= 5) {
+				std::cout << fmt::format("  \"{}\"\n    normalizeText: {}\n    Flite:         {}\n",
+					text, join(words, " "), join(fliteWords, " "));
+			}
+		}
+		std::cout << fmt::format("normalizeText: {} of {} texts differ from Flite\n", mismatchCount, texts.size());
+	}
+#endif
+
+}
+
+void runTextBenchmark(const vector<BenchmarkClip>& corpus, int iterationCount) {
+	const auto dictionaryContains = [](const string&) { return true; };
+
+	vector<string> dialogs;
+	vector<string> words;
+	vector<string> recognizedWords;
+	for (const BenchmarkClip& clip : corpus) {
+		dialogs.push_back(clip.dialog);
+		for (const string& word : tokenizeText(clip.dialog, dictionaryContains)) {
+			words.push_back(word);
+			// Recognition results name alternative pronunciations like this
+			recognizedWords.push_back(word);
+			recognizedWords.push_back(word + "(2)");
+		}
+	}
+	// Symbols that replaceSymbols() turns into words or removes
+	vector<string> tokens = words;
+	for (const string symbolToken : { "r&d", "a+b", "x=y", "me@home", "5*6", "o'clock!" }) {
+		tokens.push_back(symbolToken);
+	}
+
+	std::cout << "\nText processing (mean per call)\n";
+	const TablePrinter table(&std::cout, { 26, 10, 12 });
+	table.printRow({ "function", "inputs", "time" });
+	const auto printRow = [&](const string& name, const vector<string>& inputs, double time) {
+		table.printRow({ name, fmt::format("{}", inputs.size()), time < 1e5 ? fmt::format("{:.0f} ns", time) : fmt::format("{:.1f} ms", time / 1e6) });
+	};
+	printRow("replaceSymbols", tokens, timePerCall(tokens, iterationCount,
+		[](const string& token) { return replaceSymbols(token).size(); }));
+	printRow("stripPronunciationIndex", recognizedWords, timePerCall(recognizedWords, iterationCount,
+		[](const string& word) { return stripPronunciationIndex(word).size(); }));
+	printRow("wordToPhones (cached)", words, timePerCall(words, iterationCount,
+		[](const string& word) { return wordToPhones(word).size(); }));
+	printRow("tokenizeText (dialog)", dialogs, timePerCall(dialogs, std::max(iterationCount / 100, 1),
+		[&](const string& dialog) { return tokenizeText(dialog, dictionaryContains).size(); }));
+
+#if defined(LIPSYNCENGINE_FLITE)
+	printRow("normalizeText (dialog)", dialogs, timePerCall(dialogs, std::max(iterationCount / 100, 1),
+		[](const string& dialog) { return normalizeText(dialog, fliteLexiconContains).size(); }));
+	printRow("tokenizeViaFlite (dialog)", dialogs, timePerCall(dialogs, std::max(iterationCount / 100, 1),
+		[](const string& dialog) { return tokenizeViaFlite(dialog).size(); }));
+
+	vector<string> parityTexts = dialogs;
+	parityTexts.insert(parityTexts.end(), normalizationCases.begin(), normalizationCases.end());
+	checkNormalizationParity(parityTexts);
+#endif
+}
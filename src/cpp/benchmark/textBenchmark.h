@@ -0,0 +1,10 @@
+#pragma once
+
+#include <vector>
+#include "benchmark/corpus.h"
+
+// Times the per-word text processing of dialog-aware analyses, such as replacing symbols in tokens
+// and stripping pronunciation indexes, on the words of the corpus dialogs.
+// Prints the mean time per call of each. Built with LIPSYNCENGINE_FLITE, also times normalizeText()
+// against Flite and checks that both give the same words for the dialogs and further texts.
+void runTextBenchmark(const std::vector<BenchmarkClip>& corpus, int iterationCount);
@@ -1,53 +1,76 @@
 #include "audio_utils.h"
+#include "audio/Int16AudioClip.h"
+#include "audio/Float32AudioClip.h"
 #include <memory>
-#include <algorithm>
+#include <vector>
+#include <stdexcept>
 
-// In-memory AudioClip implementation for WASM
-// NO file I/O - operates entirely on memory buffers
-class MemoryAudioClip : public AudioClip {
-public:
-	MemoryAudioClip(const int16_t* pcm16, size_t sample_count, int sample_rate)
-		: samples_(std::make_shared<std::vector<int16_t>>(pcm16, pcm16 + sample_count)),
-		  sample_rate_(sample_rate)
-	{
-		if (sample_rate <= 0) {
-			throw std::invalid_argument("Sample rate must be positive");
-		}
-		if (sample_count == 0) {
-			throw std::invalid_argument("Sample count must be greater than zero");
-		}
-	}
+// In-memory AudioClips for WASM
+// NO file I/O - operates entirely on memory buffers.
+// Clones share the samples, which may or may not be owned by the clip.
 
-	std::unique_ptr<AudioClip> clone() const override {
-		return std::make_unique<MemoryAudioClip>(samples_->data(), samples_->size(), sample_rate_);
+std::unique_ptr<AudioClip> createAudioClipFromPCM16(
+	const int16_t* pcm16,
+	size_t sample_count,
+	int sample_rate
+) {
+	if (!pcm16) {
+		throw std::invalid_argument("Samples cannot be NULL");
 	}
-
-	SampleReader createUnsafeSampleReader() const override {
-		auto data_ptr = samples_;
-		return [data_ptr](size_type index) -> float {
-			// Convert int16 [-32768, 32767] to float [-1.0, 1.0]
-			const int16_t sample = (*data_ptr)[index];
-			return static_cast<float>(sample) / 32768.0f;
-		};
+	if (sample_count == 0) {
+		throw std::invalid_argument("Sample count must be greater than zero");
 	}
 
-	int getSampleRate() const override {
-		return sample_rate_;
-	}
+	const auto buffer = std::make_shared<const std::vector<int16_t>>(pcm16, pcm16 + sample_count);
+	// Share ownership of the vector while pointing to its data
+	std::shared_ptr<const int16_t> samples(buffer, buffer->data());
+	return std::make_unique<Int16AudioClip>(
+		std::move(samples),
+		static_cast<AudioClip::size_type>(sample_count),
+		sample_rate
+	);
+}
 
-	size_type size() const override {
-		return samples_->size();
+std::unique_ptr<AudioClip> createAudioClipViewFromPCM16(
+	const int16_t* pcm16,
+	size_t sample_count,
+	int sample_rate
+) {
+	if (!pcm16) {
+		throw std::invalid_argument("Samples cannot be NULL");
+	}
+	if (sample_count == 0) {
+		throw std::invalid_argument("Sample count must be greater than zero");
 	}
 
-private:
-	std::shared_ptr<std::vector<int16_t>> samples_;
-	int sample_rate_;
-};
+	// The caller owns the samples, so there is nothing to delete
+	std::shared_ptr<const int16_t> samples(pcm16, [](const int16_t*) {});
+	return std::make_unique<Int16AudioClip>(
+		std::move(samples),
+		static_cast<AudioClip::size_type>(sample_count),
+		sample_rate
+	);
+}
 
-std::unique_ptr<AudioClip> createAudioClipFromPCM16(
-	const int16_t* pcm16,
-	size_t sample_count,
+std::unique_ptr<AudioClip> createAudioClipViewFromFloat32(
+	const float* samples,
+	size_t frame_count,
+	int channel_count,
 	int sample_rate
 ) {
-	return std::make_unique<MemoryAudioClip>(pcm16, sample_count, sample_rate);
+	if (!samples) {
+		throw std::invalid_argument("Samples cannot be NULL");
+	}
+	if (frame_count == 0) {
+		throw std::invalid_argument("Frame count must be greater than zero");
+	}
+
+	// The caller owns the samples, so there is nothing to delete
+	std::shared_ptr<const float> view(samples, [](const float*) {});
+	return std::make_unique<Float32AudioClip>(
+		std::move(view),
+		static_cast<AudioClip::size_type>(frame_count),
+		channel_count,
+		sample_rate
+	);
 }
@@ -8,6 +8,7 @@
 /**
  * Create an AudioClip from in-memory PCM16 data.
  * NO file I/O - pure memory operation.
+ * The samples are copied once; clones of the clip share that copy.
  *
  * @param pcm16 Pointer to PCM16 samples
  * @param sample_count Number of samples
@@ -19,3 +20,38 @@ std::unique_ptr<AudioClip> createAudioClipFromPCM16(
 	size_t sample_count,
 	int sample_rate
 );
+
+/**
+ * Create an AudioClip viewing in-memory PCM16 data without copying it.
+ * The caller keeps ownership of the samples. They must remain valid and unchanged for as long as
+ * the clip, any of its clones, or any sample reader created from them exists.
+ *
+ * @param pcm16 Pointer to PCM16 samples
+ * @param sample_count Number of samples
+ * @param sample_rate Sample rate in Hz
+ * @return Unique pointer to AudioClip
+ */
+std::unique_ptr<AudioClip> createAudioClipViewFromPCM16(
+	const int16_t* pcm16,
+	size_t sample_count,
+	int sample_rate
+);
+
+/**
+ * Create an AudioClip viewing in-memory float samples without copying them.
+ * Interleaved channels are mixed down to mono when the clip is read.
+ * The caller keeps ownership of the samples, with the same lifetime requirements as for
+ * createAudioClipViewFromPCM16().
+ *
+ * @param samples Pointer to float samples in [-1.0, 1.0], frame_count * channel_count of them
+ * @param frame_count Number of frames, each holding one sample per channel
+ * @param channel_count Number of interleaved channels
+ * @param sample_rate Sample rate in Hz
+ * @return Unique pointer to AudioClip
+ */
+std::unique_ptr<AudioClip> createAudioClipViewFromFloat32(
+	const float* samples,
+	size_t frame_count,
+	int channel_count,
+	int sample_rate
+);
@@ -1,20 +1,54 @@
 #include "bridge.h"
 #include "audio_utils.h"
 #include "lib/lipSyncEngineLib.h"
+#include "lib/StreamingAnalyzer.h"
+#include "lib/StreamScheduler.h"
 #include "recognition/PocketSphinxRecognizer.h"
+#include "recognition/PhoneticRecognizer.h"
+#include "recognition/FrameClassifierRecognizer.h"
+#include "recognition/pocketSphinxTools.h"
+#include "recognition/SpeakerProfile.h"
+#include "recognition/RecognitionTimings.h"
+#include "recognition/recognizedPhones.h"
+#include "recognition/gpuScoring.h"
+#include "recognition/languageModelPages.h"
+#include "audio/SampleRateConverter.h"
+#include "audio/WaveAudioClip.h"
+#include "audio/processing.h"
 #include "exporters/JsonExporter.h"
+#include "exporters/FrameExporter.h"
+#include "exporters/CompactExporter.h"
 #include "animation/targetShapeSet.h"
 #include "tools/progress.h"
 #include "logging/logging.h"
 #include "logging/sinks.h"
 #include "logging/formatters.h"
 #include "core/Shape.h"
+#include "tools/tools.h"
+#include "tools/stringTools.h"
+#include "tools/AnalysisStats.h"
+#include "tools/tracing.h"
+#include "tools/memoryUsage.h"
+#include "tools/cancellation.h"
+#include "animation/mouthAnimation.h"
 #include <compat/boost_compat.h>
-#include <sstream>
+#include <format.h>
 #include <string>
 #include <memory>
+#include <map>
+#include <set>
+#include <mutex>
+#include <atomic>
+#include <thread>
 #include <cstring>
+#include <cstdlib>
 #include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <cmath>
+#include <filesystem>
+#include <functional>
 
 // Custom sink to filter out munmap errors
 class MunmapFilterSink : public logging::Sink {
@@ -30,18 +64,138 @@ public:
 		innerSink->receive(entry);
 	}
 
+	logging::Level getMinLevel() const override {
+		return innerSink->getMinLevel();
+	}
+
 private:
 	std::shared_ptr<logging::Sink> innerSink;
 };
 
 // Global state
 static std::string g_models_path;
-static std::string g_last_error;
-static bool g_initialized = false;
+// Per thread rather than per engine, so that native callers analyzing concurrently each see their
+// own errors, including those of calls that fail before an engine is found
+static thread_local std::string g_last_error;
+// Read by calls on any thread while lipsyncengine_cleanup() may reset it
+static std::atomic<bool> g_initialized { false };
+
+// Maximum number of utterances recognized in parallel.
+// Without WASM threads, std::thread is unavailable.
+#if defined(LIPSYNCENGINE_MAX_THREAD_COUNT)
+static const int32_t g_thread_limit = LIPSYNCENGINE_MAX_THREAD_COUNT;
+#elif defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+static const int32_t g_thread_limit = 1;
+#else
+static const int32_t g_thread_limit = std::numeric_limits<int32_t>::max();
+#endif
+
+// Heap usage limit set by lipsyncengine_set_memory_budget(), 0 for none
+static double g_memory_budget = 0;
+static int32_t g_budget_policy = LIPSYNCENGINE_BUDGET_FAIL;
+
+// A generous estimate of the heap memory an analysis takes for audio buffers, per input sample:
+// the clip is resampled and buffered once, and each utterance is buffered again for recognition
+static const size_t g_audio_bytes_per_sample = 8;
+
+// The sink installed by lipsyncengine_init()
+static std::shared_ptr<logging::Sink> g_log_sink;
+
+// Guards the default engine, the engines created by lipsyncengine_create() and the scratch buffers
+// of all engines
+static std::mutex g_engines_mutex;
+// The scratch buffers of all engines, which lipsyncengine_free() leaves alone whichever engine the
+// calling thread has selected
+static std::set<const void*> g_scratch_buffers;
+
+// A buffer reused across calls, growing as needed, see lipsyncengine_reserve_input() and
+// lipsyncengine_reuse_output()
+struct scratch_buffer {
+	void* data = nullptr;
+	size_t capacity = 0;
+
+	// Returns the buffer with room for at least size bytes, or NULL if that can't be allocated.
+	// Growing discards the contents.
+	void* reserve(size_t size) {
+		if (size > capacity) {
+			// Grow by at least half, so that slowly growing inputs don't reallocate every time
+			const size_t new_capacity = std::max(size, capacity + capacity / 2);
+			release();
+			data = malloc(new_capacity);
+			if (data) {
+				capacity = new_capacity;
+				std::lock_guard<std::mutex> lock(g_engines_mutex);
+				g_scratch_buffers.insert(data);
+			}
+		}
+		return data;
+	}
+
+	void release() {
+		if (data) {
+			// Forgotten before it is freed, so that an allocation reusing its address isn't kept
+			std::lock_guard<std::mutex> lock(g_engines_mutex);
+			g_scratch_buffers.erase(data);
+		}
+		free(data);
+		data = nullptr;
+		capacity = 0;
+	}
+};
+
+struct stepped_analysis;
 
-// Decoder reuse optimization (Phase 0)
-static std::unique_ptr<PocketSphinxRecognizer> g_recognizer;
-static std::string g_cached_dialog_text;
+// The state of an engine: its recognizers with their decoders and dialog language model caches,
+// settings, scratch buffers, streaming sessions and stepped analyses.
+// Engines only share the models, the language model variant, the memory budget and logging, so
+// analyses on different engines don't contend for decoders.
+struct engine_state {
+	// Decoder reuse optimization (Phase 0)
+	// The recognizer keeps warm decoders and caches dialog language models across calls.
+	std::unique_ptr<PocketSphinxRecognizer> recognizer = std::make_unique<PocketSphinxRecognizer>();
+	// Recognizers for the other decoder profiles and dialog modes, each with its own decoders,
+	// created on first use
+	std::map<std::pair<DecoderProfile, DialogMode>, std::unique_ptr<PocketSphinxRecognizer>> profile_recognizers;
+	std::mutex profile_recognizers_mutex;
+	// Creates its decoders only when phonetic recognition is requested
+	std::unique_ptr<PhoneticRecognizer> phonetic_recognizer = std::make_unique<PhoneticRecognizer>();
+	// Creates its decoders only when frame classification is requested
+	std::unique_ptr<FrameClassifierRecognizer> classifier_recognizer = std::make_unique<FrameClassifierRecognizer>();
+
+	int32_t max_thread_count = 1;
+
+	scratch_buffer input_buffer;
+	scratch_buffer output_buffer;
+	bool reuse_output = false;
+
+	// Takes turns recognizing the utterances of the open streams; declared first so that it
+	// outlives them
+	StreamScheduler stream_scheduler;
+	// Open streaming sessions by handle
+	std::map<int32_t, std::unique_ptr<StreamingAnalyzer>> streams;
+	int32_t next_stream_handle = 1;
+
+	// Analyses begun by lipsyncengine_analyze_begin() and not yet finished, by handle
+	std::map<int32_t, std::unique_ptr<stepped_analysis>> stepped_analyses;
+	int32_t next_stepped_analysis_handle = 1;
+
+	~engine_state();
+};
+
+// The engine set up by lipsyncengine_init(), with handle 0
+static std::shared_ptr<engine_state> g_default_engine;
+// Engines created by lipsyncengine_create(), by handle. Each call shares ownership of the engine it
+// uses, so that destroying the engine on another thread frees it only once the call returns.
+static std::map<int32_t, std::shared_ptr<engine_state>> g_engines;
+static int32_t g_next_engine_handle = 1;
+// The engine used by the calling thread, see lipsyncengine_select()
+static thread_local int32_t g_engine_handle = 0;
+
+// Speaker profiles created by lipsyncengine_speaker_create(), by handle. Analyses share ownership
+// of their profile, so that releasing it doesn't end them.
+static std::map<int32_t, std::shared_ptr<SpeakerProfile>> g_speakers;
+static std::mutex g_speakers_mutex;
+static int32_t g_next_speaker_handle = 1;
 
 // Internal error handling
 static void set_error(const std::string& error) {
@@ -52,6 +206,628 @@ static void clear_error() {
 	g_last_error.clear();
 }
 
+// Returns the engine with a handle, or NULL if there is none
+static std::shared_ptr<engine_state> find_engine(int32_t handle) {
+	std::lock_guard<std::mutex> lock(g_engines_mutex);
+	if (handle == 0) {
+		return g_default_engine;
+	}
+	const auto it = g_engines.find(handle);
+	return it != g_engines.end() ? it->second : nullptr;
+}
+
+// Returns the engine used by the calling thread, or NULL after setting the error if there is none
+static std::shared_ptr<engine_state> current_engine() {
+	if (!g_initialized) {
+		set_error("Module not initialized. Call lipsyncengine_init() first");
+		return nullptr;
+	}
+	std::shared_ptr<engine_state> engine = find_engine(g_engine_handle);
+	if (!engine) {
+		set_error("The selected engine has been destroyed. Call lipsyncengine_select() first");
+	}
+	return engine;
+}
+
+// Writes JSON straight into a malloc'ed C string, to be freed by lipsyncengine_free.
+// write(JsonWriter&) is called twice: once to measure the text and once to write it.
+template<typename TWrite>
+static const char* write_json_c_string(TWrite&& write) {
+	JsonWriter counter;
+	write(counter);
+	char* result = static_cast<char*>(malloc(counter.size() + 1));
+	if (!result) {
+		set_error("Memory allocation failed");
+		return nullptr;
+	}
+
+	JsonWriter writer(result);
+	write(writer);
+	result[counter.size()] = '\0';
+	return result;
+}
+
+// Writes a JSON array of mouth cues, using the same cue format as JsonExporter
+static void write_cue_array(JsonWriter& writer, const char* name, const std::vector<Timed<Shape>>& cues) {
+	writer.write("  \"");
+	writer.write(name);
+	writer.write("\": [");
+	bool isFirst = true;
+	for (const auto& timedShape : cues) {
+		writer.write(isFirst ? "\n" : ",\n");
+		isFirst = false;
+		writeMouthCueJson(writer, timedShape);
+	}
+	writer.write(isFirst ? "],\n" : "\n  ],\n");
+}
+
+// Writes finalized and tentative mouth cues as JSON, along with the stream's quality
+static void write_stream_cues(
+	JsonWriter& writer,
+	const std::vector<Timed<Shape>>& cues,
+	const std::vector<Timed<Shape>>& tentative_cues,
+	const StreamingAnalyzer& stream,
+	bool is_final
+) {
+	writer.write("{\n");
+	write_cue_array(writer, "mouthCues", cues);
+	write_cue_array(writer, "tentativeCues", tentative_cues);
+	writer.write("  \"fallback\": ");
+	writer.write(stream.isFallback() ? "true" : "false");
+	writer.write(",\n");
+	writer.write("  \"quality\": \"");
+	writer.write(stream.getQualityLevelName());
+	writer.write("\",\n");
+	writer.write("  \"realTimeFactor\": ");
+	writer.write(fmt::format("{:.3f}", stream.getRealTimeFactor()));
+	writer.write(",\n");
+	writer.write("  \"final\": ");
+	writer.write(is_final ? "true" : "false");
+	writer.write("\n");
+	writer.write("}\n");
+}
+
+// The sound file of analyses from memory, as written by JsonExporter for the memory identifier
+static const std::string& get_memory_sound_file() {
+	// A memory identifier, NOT a file path. It only depends on the working directory, which
+	// doesn't change.
+	static const std::string sound_file =
+		escapeJsonString(std::filesystem::absolute("memory://pcm").u8string());
+	return sound_file;
+}
+
+// The settings of an analysis, as given by lipsyncengine_options
+struct analysis_options {
+	engine_state* engine;
+	ShapeSet target_shapes;
+	const Recognizer* recognizer;
+	lipsyncengine_stats* stats;
+	const volatile int32_t* cancel_flag;
+	int32_t timeout_milliseconds;
+	lipsyncengine_progress_callback progress_callback;
+	void* progress_context;
+	int32_t yield_interval_milliseconds;
+	lipsyncengine_cue_callback cue_callback;
+	void* cue_context;
+	std::shared_ptr<SpeakerProfile> speaker;
+	lipsyncengine_cue_callback preview_callback;
+	void* preview_context;
+	// Of the pocketSphinx recognizer
+	DecoderProfile profile;
+	DialogMode dialog_mode;
+	float max_real_time_factor;
+	lipsyncengine_timings* timings;
+};
+
+// Returns the pocketSphinx recognizer of the engine for a profile and dialog mode, creating it on
+// first use
+static const Recognizer* get_pocketsphinx_recognizer(engine_state& engine, DecoderProfile profile, DialogMode dialog_mode) {
+	if (profile == DecoderProfile::Offline && dialog_mode == DialogMode::Biased) {
+		return engine.recognizer.get();
+	}
+
+	std::lock_guard<std::mutex> lock(engine.profile_recognizers_mutex);
+	auto& recognizer = engine.profile_recognizers[{ profile, dialog_mode }];
+	if (!recognizer) {
+		recognizer = std::make_unique<PocketSphinxRecognizer>(profile, dialog_mode);
+	}
+	return recognizer.get();
+}
+
+// Reads optional options for an analysis on an engine.
+// Returns none after setting the error if the options are invalid.
+static boost::optional<analysis_options> read_options(engine_state& engine, const lipsyncengine_options* options) {
+	const lipsyncengine_options defaults {};
+	if (!options) {
+		options = &defaults;
+	}
+
+	analysis_options result {
+		&engine,
+		ShapeConverter::get().getBasicShapes(),
+		engine.recognizer.get(),
+		options->stats,
+		options->cancel_flag,
+		options->timeout_milliseconds,
+		options->progress_callback,
+		options->progress_context,
+		options->yield_interval_milliseconds,
+		options->cue_callback,
+		options->cue_context,
+		nullptr,
+		options->preview_callback,
+		options->preview_context,
+		DecoderProfile::Offline,
+		DialogMode::Biased,
+		options->max_real_time_factor,
+		options->timings
+	};
+	if (options->timeout_milliseconds < 0) {
+		set_error("timeout_milliseconds must not be negative");
+		return boost::none;
+	}
+	if (options->yield_interval_milliseconds < 0) {
+		set_error("yield_interval_milliseconds must not be negative");
+		return boost::none;
+	}
+	if (!(options->max_real_time_factor >= 0)) {
+		set_error("max_real_time_factor must not be negative");
+		return boost::none;
+	}
+	if (options->target_shapes != 0) {
+		if (options->target_shapes >= (1u << static_cast<int>(Shape::EndSentinel))) {
+			set_error(fmt::format("target_shapes contains unknown shapes: 0x{:X}", options->target_shapes));
+			return boost::none;
+		}
+		const ShapeSet basic_shapes = result.target_shapes;
+		result.target_shapes = ShapeSet::fromMask(static_cast<ShapeSet::mask_type>(options->target_shapes));
+		if ((result.target_shapes.getMask() & basic_shapes.getMask()) != basic_shapes.getMask()) {
+			set_error("target_shapes must contain the basic shapes A-F");
+			return boost::none;
+		}
+	}
+
+	if (options->speaker != 0) {
+		std::lock_guard<std::mutex> lock(g_speakers_mutex);
+		const auto it = g_speakers.find(options->speaker);
+		if (it == g_speakers.end()) {
+			set_error("Unknown speaker handle");
+			return boost::none;
+		}
+		result.speaker = it->second;
+	}
+
+	DecoderProfile& profile = result.profile;
+	switch (options->profile) {
+		case LIPSYNCENGINE_PROFILE_OFFLINE:
+			profile = DecoderProfile::Offline;
+			break;
+		case LIPSYNCENGINE_PROFILE_BALANCED:
+			profile = DecoderProfile::Balanced;
+			break;
+		case LIPSYNCENGINE_PROFILE_REALTIME:
+			profile = DecoderProfile::Realtime;
+			break;
+		case LIPSYNCENGINE_PROFILE_REALTIME_DOWNSAMPLED:
+			profile = DecoderProfile::RealtimeDownsampled;
+			break;
+		case LIPSYNCENGINE_PROFILE_OFFLINE_ONE_BEST:
+			profile = DecoderProfile::OfflineOneBest;
+			break;
+		case LIPSYNCENGINE_PROFILE_STREAMING:
+			profile = DecoderProfile::Streaming;
+			break;
+		default:
+			set_error(fmt::format("Unknown profile: {}", options->profile));
+			return boost::none;
+	}
+
+	DialogMode& dialog_mode = result.dialog_mode;
+	switch (options->dialog_mode) {
+		case LIPSYNCENGINE_DIALOG_MODE_BIASED:
+			dialog_mode = DialogMode::Biased;
+			break;
+		case LIPSYNCENGINE_DIALOG_MODE_STRICT:
+			dialog_mode = DialogMode::Strict;
+			break;
+		case LIPSYNCENGINE_DIALOG_MODE_VERBATIM:
+			dialog_mode = DialogMode::Verbatim;
+			break;
+		default:
+			set_error(fmt::format("Unknown dialog mode: {}", options->dialog_mode));
+			return boost::none;
+	}
+
+	switch (options->recognizer) {
+		case LIPSYNCENGINE_RECOGNIZER_POCKETSPHINX:
+			result.recognizer = get_pocketsphinx_recognizer(engine, profile, dialog_mode);
+			break;
+		case LIPSYNCENGINE_RECOGNIZER_PHONETIC:
+			result.recognizer = engine.phonetic_recognizer.get();
+			break;
+		case LIPSYNCENGINE_RECOGNIZER_CLASSIFIER:
+			result.recognizer = engine.classifier_recognizer.get();
+			break;
+		default:
+			set_error(fmt::format("Unknown recognizer: {}", options->recognizer));
+			return boost::none;
+	}
+	return result;
+}
+
+// Checks that an analysis of sample_count samples on up to thread_count threads fits the memory
+// budget, if there is one, switching to the phonetic recognizer if the policy allows it.
+// Returns false after setting the error if the analysis doesn't fit.
+static bool fit_memory_budget(analysis_options& options, size_t sample_count, int32_t thread_count) {
+	// Also samples the peak heap usage in native builds
+	const size_t heap_usage = getHeapUsage();
+	if (g_memory_budget <= 0) return true;
+
+	const double required_base = static_cast<double>(heap_usage)
+		+ static_cast<double>(sample_count) * g_audio_bytes_per_sample;
+	const auto get_required = [&](const Recognizer& recognizer) {
+		return required_base + static_cast<double>(recognizer.estimateDecoderMemory(thread_count));
+	};
+
+	const double required = get_required(*options.recognizer);
+	if (required <= g_memory_budget) return true;
+
+	constexpr double megabyte = 1024 * 1024;
+	if (g_budget_policy == LIPSYNCENGINE_BUDGET_FALLBACK_PHONETIC
+		&& options.recognizer != options.engine->phonetic_recognizer.get()
+		&& options.recognizer != options.engine->classifier_recognizer.get()
+		&& get_required(*options.engine->phonetic_recognizer) <= g_memory_budget)
+	{
+		logging::warnFormat(
+			"Analysis would take about {:.0f} MB, exceeding the memory budget of {:.0f} MB. "
+			"Using phonetic recognition instead.",
+			required / megabyte, g_memory_budget / megabyte
+		);
+		options.recognizer = options.engine->phonetic_recognizer.get();
+		return true;
+	}
+
+	set_error(fmt::format(
+		"Analysis would take about {:.0f} MB, exceeding the memory budget of {:.0f} MB",
+		required / megabyte, g_memory_budget / megabyte
+	));
+	return false;
+}
+
+static_assert(
+	LIPSYNCENGINE_STAGE_COUNT == static_cast<int>(AnalysisStage::EndSentinel),
+	"lipsyncengine_stage must match AnalysisStage"
+);
+
+// Writes the stats of an analysis that took the given time
+static void write_stats(
+	lipsyncengine_stats* output,
+	const AnalysisStats& stats,
+	std::chrono::steady_clock::duration total_duration
+) {
+	using milliseconds = std::chrono::duration<double, std::milli>;
+	for (int stage = 0; stage < LIPSYNCENGINE_STAGE_COUNT; ++stage) {
+		output->stage_milliseconds[stage] =
+			milliseconds(stats.getDuration(static_cast<AnalysisStage>(stage))).count();
+	}
+	output->total_milliseconds = milliseconds(total_duration).count();
+	const auto count = [&](AnalysisCounter counter) {
+		return static_cast<double>(stats.getCount(counter));
+	};
+	output->utterance_count = count(AnalysisCounter::Utterances);
+	output->frame_count = count(AnalysisCounter::DecodedFrames);
+	output->hmm_evaluation_count = count(AnalysisCounter::HmmEvaluations);
+	output->decoder_cache_hits = count(AnalysisCounter::DecoderCacheHits);
+	output->decoder_cache_misses = count(AnalysisCounter::DecoderCacheMisses);
+	output->dialog_model_cache_hits = count(AnalysisCounter::DialogModelCacheHits);
+	output->dialog_model_cache_misses = count(AnalysisCounter::DialogModelCacheMisses);
+	output->utterance_cache_hits = count(AnalysisCounter::UtteranceCacheHits);
+	output->utterance_cache_misses = count(AnalysisCounter::UtteranceCacheMisses);
+}
+
+// Collects the stats of an analysis on the calling thread and the threads helping it,
+// if the options ask for them
+class stats_collector {
+public:
+	explicit stats_collector(lipsyncengine_stats* output) :
+		output(output),
+		scope(output ? &stats : nullptr),
+		start(std::chrono::steady_clock::now())
+	{}
+
+	// Writes the stats collected so far to the output, if any
+	void write() const {
+		if (output) {
+			write_stats(output, stats, std::chrono::steady_clock::now() - start);
+		}
+	}
+
+private:
+	lipsyncengine_stats* output;
+	AnalysisStats stats;
+	AnalysisStatsScope scope;
+	std::chrono::steady_clock::time_point start;
+};
+
+// Collects the words and phones an analysis recognizes on the calling thread and the threads
+// helping it, if the options ask for them
+class timings_collector {
+public:
+	explicit timings_collector(lipsyncengine_timings* output) :
+		output(output),
+		scope(output ? &timings : nullptr)
+	{
+		if (output) {
+			*output = {};
+		}
+	}
+
+	// The timings of the analyzed clip, or none if the options don't ask for them
+	boost::optional<RecognitionTimings::Clip> get() const {
+		if (!output) return boost::none;
+		return timings.get(0);
+	}
+
+	// Copies the timings of the analyzed clip to the output, if any.
+	// Returns false after setting the error if memory allocation fails.
+	bool write() const {
+		if (!output) return true;
+
+		const RecognitionTimings::Clip clip = timings.get(0);
+		std::vector<std::pair<TimeRange, std::string>> labels;
+		for (const auto& timed_word : clip.words) {
+			labels.emplace_back(timed_word.getTimeRange(), timed_word.getValue());
+		}
+		for (const auto& timed_phone : clip.phones) {
+			labels.emplace_back(timed_phone.getTimeRange(), PhoneConverter::get().toString(timed_phone.getValue()));
+		}
+
+		// The labels, then their text
+		size_t size = labels.size() * sizeof(lipsyncengine_timed_label);
+		for (const auto& label : labels) {
+			size += label.second.size() + 1;
+		}
+		char* block = static_cast<char*>(malloc(std::max(size, size_t(1))));
+		if (!block) {
+			set_error("Memory allocation failed");
+			return false;
+		}
+		auto* timed_labels = reinterpret_cast<lipsyncengine_timed_label*>(block);
+		char* text = block + labels.size() * sizeof(lipsyncengine_timed_label);
+		for (size_t i = 0; i < labels.size(); ++i) {
+			timed_labels[i].start = static_cast<int32_t>(labels[i].first.getStart().count());
+			timed_labels[i].end = static_cast<int32_t>(labels[i].first.getEnd().count());
+			timed_labels[i].text = text;
+			std::memcpy(text, labels[i].second.c_str(), labels[i].second.size() + 1);
+			text += labels[i].second.size() + 1;
+		}
+
+		output->word_count = static_cast<int32_t>(clip.words.size());
+		output->words = timed_labels;
+		output->phone_count = static_cast<int32_t>(clip.phones.size());
+		output->phones = timed_labels + clip.words.size();
+		return true;
+	}
+
+private:
+	lipsyncengine_timings* output;
+	RecognitionTimings timings;
+	RecognitionTimingsScope scope;
+};
+
+// Returns the time by which an analysis times out, if it does
+static boost::optional<CancellationToken::clock::time_point> get_deadline(const analysis_options& options) {
+	if (options.timeout_milliseconds <= 0) return boost::none;
+	return CancellationToken::clock::now() + std::chrono::milliseconds(options.timeout_milliseconds);
+}
+
+// Lets an analysis on the calling thread and the threads helping it be stopped early through the
+// cancel flag and timeout of its options, and the calling thread yield as often as they ask
+class cancellation_scope {
+public:
+	explicit cancellation_scope(const analysis_options& options) :
+		token(
+			options.cancel_flag,
+			get_deadline(options),
+			std::chrono::milliseconds(options.yield_interval_milliseconds)
+		),
+		scope(&token)
+	{}
+
+private:
+	CancellationToken token;
+	CancellationScope scope;
+};
+
+// Passes the final mouth cues of an analysis to the cue callback of its options.
+// Like progress, cues found on the threads helping the analysis wait for the next flush() on the
+// thread that started it.
+class callback_cue_sink {
+public:
+	explicit callback_cue_sink(const analysis_options& options) :
+		callback(options.cue_callback),
+		context(options.cue_context),
+		thread(std::this_thread::get_id())
+	{}
+
+	void add(const std::vector<Timed<Shape>>& cues) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (const Timed<Shape>& cue : cues) {
+				pending.push_back(lipsyncengine_mouth_cue {
+					static_cast<int32_t>(cue.getStart().count()),
+					static_cast<int32_t>(cue.getEnd().count()),
+					static_cast<uint8_t>(cue.getValue()),
+					{ 0, 0, 0 }
+				});
+			}
+		}
+		flush();
+	}
+
+	// Passes the waiting cues to the callback if called on the thread that started the analysis
+	void flush() {
+		if (std::this_thread::get_id() != thread) return;
+
+		std::vector<lipsyncengine_mouth_cue> cues;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			cues.swap(pending);
+		}
+		if (!cues.empty()) {
+			callback(cues.data(), static_cast<int32_t>(cues.size()), context);
+		}
+	}
+
+private:
+	const lipsyncengine_cue_callback callback;
+	void* const context;
+	const std::thread::id thread;
+	std::mutex mutex;
+	std::vector<lipsyncengine_mouth_cue> pending;
+};
+
+// Passes the progress of an analysis to the callback of its options, in steps of at least 1%,
+// along with the time remaining.
+// The callback is only called on the thread that started the analysis, as WASM function pointers
+// into JavaScript are only valid there; progress reported by the threads helping it is passed on
+// with the next report on that thread.
+class callback_progress_sink : public ProgressSink {
+public:
+	// Estimates the remaining time from the recognizer's cost model for audio of the given duration
+	// If cue_sink is set, its cues are passed on along with the progress
+	callback_progress_sink(
+		const analysis_options& options,
+		centiseconds audio_duration,
+		callback_cue_sink* cue_sink = nullptr
+	) :
+		callback(options.progress_callback),
+		context(options.progress_context),
+		thread(std::this_thread::get_id()),
+		start(std::chrono::steady_clock::now()),
+		estimated_milliseconds(options.progress_callback
+			? static_cast<double>(options.recognizer->estimateDuration(
+				audio_duration, options.engine->max_thread_count).count())
+			: 0.0),
+		cue_sink(cue_sink)
+	{}
+
+	void reportProgress(double value) override {
+		if (cue_sink) {
+			cue_sink->flush();
+		}
+		if (!callback) return;
+
+		// Merged progress may arrive out of order from different threads
+		double latest = progress.load();
+		while (value > latest && !progress.compare_exchange_weak(latest, value)) {}
+
+		if (std::this_thread::get_id() == thread) {
+			report(progress.load());
+		}
+	}
+
+	// Reports completion, which may have been reached on another thread
+	void finish() {
+		if (callback) {
+			report(1.0);
+		}
+	}
+
+private:
+	static constexpr double step = 0.01;
+
+	void report(double value) {
+		value = std::min(value, 1.0);
+		if (value >= reported + step || (value == 1.0 && reported < 1.0)) {
+			reported = value;
+			callback(value, get_remaining_milliseconds(value), context);
+		}
+	}
+
+	// Progress is weighted by the expected cost of each stage, so it grows about evenly over time.
+	// The estimate made before the analysis gives way to the extrapolation of the progress so far as
+	// the analysis advances.
+	double get_remaining_milliseconds(double value) const {
+		const double elapsed = std::chrono::duration<double, std::milli>(
+			std::chrono::steady_clock::now() - start).count();
+		const double expected = std::max(estimated_milliseconds - elapsed, 0.0);
+		const double extrapolated = value > 0 ? elapsed * (1.0 - value) / value : expected;
+		return (1.0 - value) * expected + value * extrapolated;
+	}
+
+	const lipsyncengine_progress_callback callback;
+	void* const context;
+	const std::thread::id thread;
+	const std::chrono::steady_clock::time_point start;
+	const double estimated_milliseconds;
+	callback_cue_sink* const cue_sink;
+	std::atomic<double> progress { 0.0 };
+	// Only accessed on the calling thread
+	double reported = 0.0;
+};
+
+// Sets the error for a cancelled analysis
+static void set_cancellation_error(const OperationCancelled& e) {
+	set_error(e.getReason() == OperationCancelled::Reason::Deadline
+		? "Analysis timed out"
+		: "Analysis cancelled");
+}
+
+// An analysis run in steps on the thread that began it, see lipsyncengine_analyze_begin()
+struct stepped_analysis {
+	stepped_analysis(analysis_options options, std::unique_ptr<AudioClip> audio_clip) :
+		options(options),
+		audio_clip(std::move(audio_clip)),
+		progress_sink(options, this->audio_clip->getTruncatedRange().getDuration()),
+		// Steps aren't JSPI exports, so they mustn't yield
+		token(options.cancel_flag, get_deadline(options))
+	{}
+
+	const analysis_options options;
+	// A copy of the samples, as the analysis outlives the call passing them
+	const std::unique_ptr<AudioClip> audio_clip;
+	callback_progress_sink progress_sink;
+	CancellationToken token;
+	AnalysisStats stats;
+	// The time spent in the calls working on the analysis
+	std::chrono::steady_clock::duration work_duration { 0 };
+	// The time spent recognizing utterances, and their number, to predict the next step
+	std::chrono::steady_clock::duration step_duration { 0 };
+	int64_t step_count = 0;
+	std::unique_ptr<SteppedRecognition> recognition;
+};
+
+// Makes the calling thread work on a stepped analysis for its lifetime: the analysis's token is
+// checked and its stats collected, and the time is added to its work
+class stepped_analysis_scope {
+public:
+	explicit stepped_analysis_scope(stepped_analysis& analysis) :
+		analysis(analysis),
+		stats(analysis.options.stats ? &analysis.stats : nullptr),
+		cancellation(&analysis.token),
+		start(std::chrono::steady_clock::now())
+	{}
+
+	~stepped_analysis_scope() {
+		analysis.work_duration += std::chrono::steady_clock::now() - start;
+	}
+
+private:
+	stepped_analysis& analysis;
+	AnalysisStatsScope stats;
+	CancellationScope cancellation;
+	std::chrono::steady_clock::time_point start;
+};
+
+engine_state::~engine_state() {
+	// Streams and stepped analyses use decoder caches owned by the recognizers
+	streams.clear();
+	stepped_analyses.clear();
+	input_buffer.release();
+	output_buffer.release();
+}
+
 // Initialize LipSyncEngine WASM module
 extern "C" int lipsyncengine_init(const char* models_path) {
 	try {
@@ -64,18 +840,44 @@ extern "C" int lipsyncengine_init(const char* models_path) {
 
 		g_models_path = models_path;
 
+		// Use the models at models_path if it contains them.
+		// Otherwise, keep the default location (res/sphinx next to the binary). WASM builds don't
+		// package the models, so their callers write them to models_path first.
+		if (std::filesystem::exists(std::filesystem::path(g_models_path) / "acoustic-model")) {
+			setSphinxModelDirectory(g_models_path);
+		}
+
 		// Phase 0: Create recognizer once for reuse
-		g_recognizer = std::make_unique<PocketSphinxRecognizer>();
-		g_cached_dialog_text = "";
+		std::shared_ptr<engine_state> engine = std::make_shared<engine_state>();
+		{
+			std::lock_guard<std::mutex> lock(g_engines_mutex);
+			g_default_engine.swap(engine);
+		}
+		// Frees the engine of an earlier initialization outside of the lock, which freeing its
+		// scratch buffers takes
+		engine.reset();
 
 		g_initialized = true;
 
-		// Set up logging with custom filter to suppress munmap errors
-		auto formatter = std::make_shared<logging::SimpleConsoleFormatter>();
-		auto stderrSink = std::make_shared<logging::StdErrSink>(formatter);
-		auto munmapFilter = std::make_shared<MunmapFilterSink>(stderrSink);
-		auto levelFilter = std::make_shared<logging::LevelFilter>(munmapFilter, logging::Level::Info);
-		logging::addSink(levelFilter);
+		// Set up logging with custom filter to suppress munmap errors.
+		// Entries are filtered before they are queued; with threads, output happens in the background.
+		if (!g_log_sink) {
+			auto formatter = std::make_shared<logging::SimpleConsoleFormatter>();
+			std::shared_ptr<logging::Sink> output = std::make_shared<logging::StdErrSink>(formatter);
+			if (g_thread_limit > 1) {
+				output = std::make_shared<logging::AsyncSink>(output);
+			}
+			auto munmapFilter = std::make_shared<MunmapFilterSink>(output);
+			g_log_sink = std::make_shared<logging::LevelFilter>(munmapFilter, logging::Level::Info);
+			logging::addSink(g_log_sink);
+		}
+
+		// Free the decoders at exit while logging still works, in case the caller doesn't
+		static bool cleanup_registered = false;
+		if (!cleanup_registered) {
+			std::atexit(lipsyncengine_cleanup);
+			cleanup_registered = true;
+		}
 
 		return 0;
 	} catch (const std::exception& e) {
@@ -87,101 +889,188 @@ extern "C" int lipsyncengine_init(const char* models_path) {
 	}
 }
 
-// Analyze PCM16 audio and generate JSON lip-sync-engine data
-extern "C" const char* lipsyncengine_analyze_pcm16(
-	const int16_t* pcm16,
+// Checks the arguments describing a buffer of samples, named samples_name in errors.
+// Returns false after setting the error (prefixed with error_prefix) if they are invalid.
+static bool validate_samples(
+	const void* samples,
+	const char* samples_name,
 	int32_t sample_count,
 	int32_t sample_rate,
-	const char* dialog_text
+	const std::string& error_prefix
 ) {
-	try {
-		clear_error();
+	if (!samples) {
+		set_error(error_prefix + samples_name + " cannot be NULL");
+		return false;
+	}
 
-		if (!g_initialized || !g_recognizer) {
-			set_error("Module not initialized. Call lipsyncengine_init() first");
-			return nullptr;
-		}
+	if (sample_count <= 0) {
+		set_error(error_prefix + "sample_count must be positive");
+		return false;
+	}
 
-		if (!pcm16) {
-			set_error("pcm16 cannot be NULL");
-			return nullptr;
-		}
+	if (sample_rate <= 0) {
+		set_error(error_prefix + "sample_rate must be positive");
+		return false;
+	}
 
-		if (sample_count <= 0) {
-			set_error("sample_count must be positive");
-			return nullptr;
-		}
+	return true;
+}
 
-		if (sample_rate <= 0) {
-			set_error("sample_rate must be positive");
-			return nullptr;
-		}
+// Returns the dialog for an optional dialog text (NULL or empty for none)
+static boost::optional<std::string> to_dialog(const char* dialog_text) {
+	if (dialog_text && std::strlen(dialog_text) > 0) {
+		return std::string(dialog_text);
+	}
+	return boost::none;
+}
+
+// Allocates zeroed memory for binary mouth cues, at least one so that success is never signaled
+// by NULL. Uses the output buffer of the engine if it is to be reused.
+static lipsyncengine_mouth_cue* allocate_cues(engine_state& engine, size_t count) {
+	const size_t size = std::max<size_t>(count, 1) * sizeof(lipsyncengine_mouth_cue);
+	if (!engine.reuse_output) {
+		return static_cast<lipsyncengine_mouth_cue*>(calloc(1, size));
+	}
 
-		// Create AudioClip from PCM buffer (NO file I/O)
-		auto audio_clip = createAudioClipFromPCM16(pcm16, sample_count, sample_rate);
+	void* cues = engine.output_buffer.reserve(size);
+	if (cues) {
+		std::memset(cues, 0, size);
+	}
+	return static_cast<lipsyncengine_mouth_cue*>(cues);
+}
 
-		// Phase 0: Check if dialog text changed (for language model caching)
-		std::string current_dialog = (dialog_text && std::strlen(dialog_text) > 0)
-			? std::string(dialog_text)
-			: "";
+// Copies an animation to consecutive binary mouth cues, returning the end of the written cues
+static lipsyncengine_mouth_cue* write_cues(
+	const JoiningContinuousTimeline<Shape>& animation,
+	lipsyncengine_mouth_cue* cue
+) {
+	for (const auto& timedShape : animation) {
+		cue->start = static_cast<int32_t>(timedShape.getStart().count());
+		cue->end = static_cast<int32_t>(timedShape.getEnd().count());
+		cue->shape = static_cast<uint8_t>(timedShape.getValue());
+		++cue;
+	}
+	return cue;
+}
 
-		// Note: Full language model caching will be added in Phase 0.4
-		// For now, we rely on PocketSphinx's internal caching
-		// Update the cached dialog text for future optimizations
-		g_cached_dialog_text = current_dialog;
+// Passes a preview of the animation of a clip to the preview callback of the options, if any
+static void send_preview(const AudioClip& audio_clip, const analysis_options& options) {
+	if (!options.preview_callback) return;
 
-		// Parse dialog text (optional)
-		boost::optional<std::string> dialog;
-		if (!current_dialog.empty()) {
-			dialog = current_dialog;
-		}
+	const JoiningContinuousTimeline<Shape> preview = previewAudioClip(audio_clip, options.target_shapes);
+	std::vector<lipsyncengine_mouth_cue> cues(preview.size());
+	write_cues(preview, cues.data());
+	options.preview_callback(cues.data(), static_cast<int32_t>(cues.size()), options.preview_context);
+}
 
-		// Phase 0: Reuse global recognizer instead of creating new one
-		// This saves ~700ms per analysis after the first call
+// Runs the analysis shared by all input and output formats
+static JoiningContinuousTimeline<Shape> analyze_clip(
+	const AudioClip& audio_clip,
+	const char* dialog_text,
+	const analysis_options& options
+) {
+	// Parse dialog text (optional).
+	// The recognizer caches the language model for each dialog, so repeated dialogs are cheap.
+	const boost::optional<std::string> dialog = to_dialog(dialog_text);
 
-		// Get target shape set (using basic shapes only for now)
-		ShapeSet target_shapes = ShapeConverter::get().getBasicShapes();
+	send_preview(audio_clip, options);
 
-		// Create progress sink (no-op for WASM)
-		NullProgressSink progress_sink;
+	// Phase 0: Reuse global recognizer instead of creating new one
+	// This saves ~700ms per analysis after the first call
 
-		// Animate (single-threaded for WASM)
-		const int max_thread_count = 1;
-		auto animation = animateAudioClip(
-			*audio_clip,
-			dialog,
-			*g_recognizer,  // Phase 0: Use global recognizer for reuse
-			target_shapes,
-			max_thread_count,
-			progress_sink
-		);
+	boost::optional<callback_cue_sink> cue_sink;
+	if (options.cue_callback) {
+		cue_sink.emplace(options);
+	}
+	callback_progress_sink progress_sink(
+		options,
+		audio_clip.getTruncatedRange().getDuration(),
+		cue_sink ? &*cue_sink : nullptr
+	);
 
-		// Export to JSON (ONLY format supported)
-		std::ostringstream json_stream;
+	// Animate (single-threaded unless threads were requested in a multithreaded build)
+	JoiningContinuousTimeline<Shape> animation = animateAudioClip(
+		audio_clip,
+		dialog,
+		*options.recognizer,  // Phase 0: Use global recognizer for reuse
+		options.target_shapes,
+		options.engine->max_thread_count,
+		progress_sink,
+		cue_sink
+			? CueSink([&](const std::vector<Timed<Shape>>& cues) { cue_sink->add(cues); })
+			: CueSink(),
+		options.speaker.get()
+	);
+	if (cue_sink) {
+		cue_sink->flush();
+	}
+	progress_sink.finish();
+	return animation;
+}
 
-		// Create ExporterInput with memory identifier (NOT a filesystem path)
-		ExporterInput exporter_input(
-			"memory://pcm",  // Memory identifier, NOT a file path
-			animation,
-			target_shapes
-		);
+// Analyzes PCM16 audio for the JSON and binary output formats.
+// Returns none after setting the error if the arguments are invalid.
+static boost::optional<JoiningContinuousTimeline<Shape>> analyze_pcm16(
+	const int16_t* pcm16,
+	int32_t sample_count,
+	int32_t sample_rate,
+	const char* dialog_text,
+	const analysis_options& options
+) {
+	if (!validate_samples(pcm16, "pcm16", sample_count, sample_rate, "")) {
+		return boost::none;
+	}
 
-		JsonExporter exporter;
-		exporter.exportAnimation(exporter_input, json_stream);
+	// View the PCM buffer without copying it (NO file I/O).
+	// The caller's buffer outlives the clip, which is only used within this call.
+	auto audio_clip = createAudioClipViewFromPCM16(pcm16, sample_count, sample_rate);
+	return analyze_clip(*audio_clip, dialog_text, options);
+}
 
-		// Convert to C string
-		std::string json = json_stream.str();
-		char* result = static_cast<char*>(malloc(json.size() + 1));
-		if (!result) {
-			set_error("Memory allocation failed");
-			return nullptr;
-		}
+// Analyze PCM16 audio and generate JSON lip-sync-engine data
+extern "C" const char* lipsyncengine_analyze_pcm16(
+	const int16_t* pcm16,
+	int32_t sample_count,
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options
+) {
+	try {
+		clear_error();
 
-		std::memcpy(result, json.data(), json.size());
-		result[json.size()] = '\0';
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return nullptr;
+		auto analysis = read_options(*engine, options);
+		if (!analysis) return nullptr;
+		if (!fit_memory_budget(*analysis, std::max(sample_count, 0), analysis->engine->max_thread_count)) return nullptr;
+		const stats_collector stats(analysis->stats);
+		const timings_collector timings(analysis->timings);
+		const cancellation_scope cancellation(*analysis);
 
-		return result;
+		const auto animation = analyze_pcm16(pcm16, sample_count, sample_rate, dialog_text, *analysis);
+		if (!animation) return nullptr;
 
+		const char* json = measureStage(AnalysisStage::Export, [&] {
+			// Export to JSON, in the format of JsonExporter
+			const boost::optional<RecognitionTimings::Clip> clip_timings = timings.get();
+			return write_json_c_string([&](JsonWriter& writer) {
+				writeAnimationJson(
+					writer,
+					get_memory_sound_file(),
+					*animation,
+					analysis->target_shapes,
+					clip_timings ? &*clip_timings : nullptr
+				);
+			});
+		});
+		if (!json) return nullptr;
+
+		stats.write();
+		return json;
+
+	} catch (const OperationCancelled& e) {
+		set_cancellation_error(e);
+		return nullptr;
 	} catch (const std::exception& e) {
 		set_error(std::string("Analysis error: ") + e.what());
 		return nullptr;
@@ -191,10 +1080,1262 @@ extern "C" const char* lipsyncengine_analyze_pcm16(
 	}
 }
 
-// Free memory allocated by lipsyncengine_analyze_pcm16
-extern "C" void lipsyncengine_free(const char* ptr) {
-	if (ptr) {
-		free(const_cast<char*>(ptr));
+// Runs an analysis for the binary output format.
+// analyze returns none after setting the error if the arguments describing the audio are invalid.
+static const lipsyncengine_mouth_cue* analyze_binary(
+	int32_t sample_count,
+	const lipsyncengine_options* options,
+	int32_t* cue_count,
+	const std::function<boost::optional<JoiningContinuousTimeline<Shape>>(const analysis_options&)>& analyze
+) {
+	try {
+		clear_error();
+
+		if (!cue_count) {
+			set_error("cue_count cannot be NULL");
+			return nullptr;
+		}
+		*cue_count = 0;
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return nullptr;
+		auto analysis = read_options(*engine, options);
+		if (!analysis) return nullptr;
+		if (!fit_memory_budget(*analysis, std::max(sample_count, 0), analysis->engine->max_thread_count)) return nullptr;
+		const stats_collector stats(analysis->stats);
+		const timings_collector timings(analysis->timings);
+		const cancellation_scope cancellation(*analysis);
+
+		const auto animation = analyze(*analysis);
+		if (!animation) return nullptr;
+
+		const size_t size = animation->size();
+		auto* cues = measureStage(AnalysisStage::Export, [&] {
+			auto* cues = allocate_cues(*analysis->engine, size);
+			if (cues) {
+				write_cues(*animation, cues);
+			}
+			return cues;
+		});
+		if (!cues) {
+			set_error("Memory allocation failed");
+			return nullptr;
+		}
+		if (!measureStage(AnalysisStage::Export, [&] { return timings.write(); })) return nullptr;
+
+		*cue_count = static_cast<int32_t>(size);
+		stats.write();
+		return cues;
+	} catch (const OperationCancelled& e) {
+		set_cancellation_error(e);
+		return nullptr;
+	} catch (const std::exception& e) {
+		set_error(std::string("Analysis error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown analysis error");
+		return nullptr;
+	}
+}
+
+// Analyze PCM16 audio and generate an array of mouth cues
+extern "C" const lipsyncengine_mouth_cue* lipsyncengine_analyze_pcm16_binary(
+	const int16_t* pcm16,
+	int32_t sample_count,
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options,
+	int32_t* cue_count
+) {
+	return analyze_binary(sample_count, options, cue_count, [&](const analysis_options& analysis) {
+		return analyze_pcm16(pcm16, sample_count, sample_rate, dialog_text, analysis);
+	});
+}
+
+// Analyze float audio and generate an array of mouth cues
+extern "C" const lipsyncengine_mouth_cue* lipsyncengine_analyze_f32(
+	const float* samples,
+	int32_t sample_count,
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options,
+	int32_t* cue_count
+) {
+	return lipsyncengine_analyze_f32_interleaved(
+		samples, sample_count, 1, sample_rate, dialog_text, options, cue_count
+	);
+}
+
+// Analyze interleaved multichannel float audio, mixed down to mono, and generate an array of mouth cues
+extern "C" const lipsyncengine_mouth_cue* lipsyncengine_analyze_f32_interleaved(
+	const float* samples,
+	int32_t frame_count,
+	int32_t channel_count,
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options,
+	int32_t* cue_count
+) {
+	// The mono clip is what gets buffered, so the budget depends on the frames only
+	return analyze_binary(frame_count, options, cue_count, [&](const analysis_options& analysis)
+		-> boost::optional<JoiningContinuousTimeline<Shape>>
+	{
+		if (!validate_samples(samples, "samples", frame_count, sample_rate, "")) {
+			return boost::none;
+		}
+		if (channel_count <= 0) {
+			set_error("channel_count must be positive");
+			return boost::none;
+		}
+
+		// View the samples without copying them; the downmix happens as the clip is read
+		auto audio_clip = createAudioClipViewFromFloat32(samples, frame_count, channel_count, sample_rate);
+		return analyze_clip(*audio_clip, dialog_text, analysis);
+	});
+}
+
+// Convert float audio to mono PCM16 at another sample rate, as the engine would before analyzing it
+extern "C" const int16_t* lipsyncengine_convert_f32(
+	const float* samples,
+	int32_t frame_count,
+	int32_t channel_count,
+	int32_t sample_rate,
+	int32_t target_sample_rate,
+	int32_t* sample_count
+) {
+	try {
+		clear_error();
+
+		if (!sample_count) {
+			set_error("sample_count cannot be NULL");
+			return nullptr;
+		}
+		*sample_count = 0;
+
+		if (!validate_samples(samples, "samples", frame_count, sample_rate, "")) {
+			return nullptr;
+		}
+		if (channel_count <= 0) {
+			set_error("channel_count must be positive");
+			return nullptr;
+		}
+		if (target_sample_rate <= 0) {
+			set_error("target_sample_rate must be positive");
+			return nullptr;
+		}
+
+		const auto audio_clip = createAudioClipViewFromFloat32(samples, frame_count, channel_count, sample_rate)
+			| resample(target_sample_rate);
+		const std::vector<int16_t> pcm16 = copyTo16bitBuffer(*audio_clip);
+
+		// Allocate at least one sample so that success is never signaled by NULL
+		auto* result = static_cast<int16_t*>(malloc(std::max<size_t>(pcm16.size(), 1) * sizeof(int16_t)));
+		if (!result) {
+			set_error("Memory allocation failed");
+			return nullptr;
+		}
+		std::copy(pcm16.begin(), pcm16.end(), result);
+
+		*sample_count = static_cast<int32_t>(pcm16.size());
+		return result;
+	} catch (const std::exception& e) {
+		set_error(std::string("Conversion error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown conversion error");
+		return nullptr;
+	}
+}
+
+// Decode a WAVE file to PCM16 at target_sample_rate
+extern "C" const int16_t* lipsyncengine_decode_wav(
+	const uint8_t* bytes,
+	int32_t byte_count,
+	int32_t target_sample_rate,
+	int32_t* sample_count
+) {
+	try {
+		clear_error();
+
+		if (!sample_count) {
+			set_error("sample_count cannot be NULL");
+			return nullptr;
+		}
+		*sample_count = 0;
+
+		if (!bytes) {
+			set_error("bytes cannot be NULL");
+			return nullptr;
+		}
+		if (byte_count <= 0) {
+			set_error("byte_count must be positive");
+			return nullptr;
+		}
+		if (target_sample_rate <= 0) {
+			set_error("target_sample_rate must be positive");
+			return nullptr;
+		}
+
+		// The caller keeps the bytes alive for the duration of the call
+		const std::shared_ptr<const uint8_t> unownedBytes(bytes, [](const uint8_t*) {});
+		const auto audio_clip = std::make_unique<WaveAudioClip>(unownedBytes, static_cast<size_t>(byte_count))
+			| resample(target_sample_rate);
+		const std::vector<int16_t> pcm16 = copyTo16bitBuffer(*audio_clip);
+
+		// Allocate at least one sample so that success is never signaled by NULL
+		auto* result = static_cast<int16_t*>(malloc(std::max<size_t>(pcm16.size(), 1) * sizeof(int16_t)));
+		if (!result) {
+			set_error("Memory allocation failed");
+			return nullptr;
+		}
+		std::copy(pcm16.begin(), pcm16.end(), result);
+
+		*sample_count = static_cast<int32_t>(pcm16.size());
+		return result;
+	} catch (const std::exception& e) {
+		set_error(std::string("Decoding error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown decoding error");
+		return nullptr;
+	}
+}
+
+// Analyze many PCM16 clips at once, generating one array of mouth cues for all of them
+extern "C" const lipsyncengine_mouth_cue* lipsyncengine_analyze_batch(
+	const lipsyncengine_batch_clip* clips,
+	int32_t clip_count,
+	const lipsyncengine_options* options,
+	int32_t* cue_counts
+) {
+	try {
+		clear_error();
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return nullptr;
+
+		if (!clips || !cue_counts) {
+			set_error("clips and cue_counts cannot be NULL");
+			return nullptr;
+		}
+
+		if (clip_count <= 0) {
+			set_error("clip_count must be positive");
+			return nullptr;
+		}
+		std::fill(cue_counts, cue_counts + clip_count, 0);
+
+		auto analysis = read_options(*engine, options);
+		if (!analysis) return nullptr;
+
+		// View all PCM buffers without copying them
+		std::vector<std::unique_ptr<AudioClip>> audio_clips;
+		std::vector<RecognitionInput> inputs;
+		size_t total_sample_count = 0;
+		for (int32_t i = 0; i < clip_count; ++i) {
+			const lipsyncengine_batch_clip& clip = clips[i];
+			if (!validate_samples(clip.pcm16, "pcm16", clip.sample_count, clip.sample_rate, fmt::format("Clip {}: ", i))) {
+				return nullptr;
+			}
+			audio_clips.push_back(createAudioClipViewFromPCM16(clip.pcm16, clip.sample_count, clip.sample_rate));
+			inputs.push_back({ audio_clips.back().get(), to_dialog(clip.dialog_text), analysis->speaker.get() });
+			total_sample_count += static_cast<size_t>(clip.sample_count);
+		}
+
+		if (!fit_memory_budget(*analysis, total_sample_count, analysis->engine->max_thread_count)) return nullptr;
+		const stats_collector stats(analysis->stats);
+		const cancellation_scope cancellation(*analysis);
+
+		centiseconds audio_duration = 0_cs;
+		for (const auto& audio_clip : audio_clips) {
+			audio_duration += audio_clip->getTruncatedRange().getDuration();
+		}
+		callback_progress_sink progress_sink(*analysis, audio_duration);
+		const std::vector<JoiningContinuousTimeline<Shape>> animations = animateAudioClips(
+			inputs,
+			*analysis->recognizer,
+			analysis->target_shapes,
+			analysis->engine->max_thread_count,
+			progress_sink
+		);
+		progress_sink.finish();
+
+		auto* cues = measureStage(AnalysisStage::Export, [&] {
+			size_t total_size = 0;
+			for (const auto& animation : animations) {
+				total_size += animation.size();
+			}
+			auto* cues = allocate_cues(*analysis->engine, total_size);
+			if (cues) {
+				lipsyncengine_mouth_cue* cue = cues;
+				for (const auto& animation : animations) {
+					cue = write_cues(animation, cue);
+				}
+			}
+			return cues;
+		});
+		if (!cues) {
+			set_error("Memory allocation failed");
+			return nullptr;
+		}
+
+		for (size_t i = 0; i < animations.size(); ++i) {
+			cue_counts[i] = static_cast<int32_t>(animations[i].size());
+		}
+		stats.write();
+		return cues;
+	} catch (const OperationCancelled& e) {
+		set_cancellation_error(e);
+		return nullptr;
+	} catch (const std::exception& e) {
+		set_error(std::string("Batch analysis error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown batch analysis error");
+		return nullptr;
+	}
+}
+
+// Returns a stepped analysis of an engine, or NULL after setting the error if there is none
+static stepped_analysis* find_stepped_analysis(engine_state& engine, int32_t analysis) {
+	const auto it = engine.stepped_analyses.find(analysis);
+	if (it == engine.stepped_analyses.end()) {
+		set_error("Unknown analysis handle");
+		return nullptr;
+	}
+	return it->second.get();
+}
+
+// Begin an analysis run in steps
+extern "C" int32_t lipsyncengine_analyze_begin(
+	const int16_t* pcm16,
+	int32_t sample_count,
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options
+) {
+	try {
+		clear_error();
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return -1;
+		auto analysis_options = read_options(*engine, options);
+		if (!analysis_options) return -1;
+		if (!validate_samples(pcm16, "pcm16", sample_count, sample_rate, "")) return -1;
+		// Steps recognize on a single thread
+		if (!fit_memory_budget(*analysis_options, static_cast<size_t>(sample_count), 1)) return -1;
+
+		auto analysis = std::make_unique<stepped_analysis>(
+			*analysis_options,
+			createAudioClipFromPCM16(pcm16, sample_count, sample_rate)
+		);
+		{
+			const stepped_analysis_scope scope(*analysis);
+			send_preview(*analysis->audio_clip, analysis->options);
+			analysis->recognition = analysis->options.recognizer->beginRecognition(
+				{ RecognitionInput {
+					analysis->audio_clip.get(),
+					to_dialog(dialog_text),
+					analysis->options.speaker.get()
+				} },
+				analysis->progress_sink
+			);
+		}
+
+		const int32_t handle = engine->next_stepped_analysis_handle++;
+		engine->stepped_analyses[handle] = std::move(analysis);
+		return handle;
+	} catch (const OperationCancelled& e) {
+		set_cancellation_error(e);
+		return -1;
+	} catch (const std::exception& e) {
+		set_error(std::string("Analysis error: ") + e.what());
+		return -1;
+	} catch (...) {
+		set_error("Unknown analysis error");
+		return -1;
+	}
+}
+
+// Recognize the utterances of a stepped analysis for up to a time budget
+extern "C" int lipsyncengine_analyze_step(int32_t analysis, double budget_milliseconds) {
+	try {
+		clear_error();
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return -1;
+		stepped_analysis* stepped = find_stepped_analysis(*engine, analysis);
+		if (!stepped) return -1;
+
+		const stepped_analysis_scope scope(*stepped);
+		const auto start = std::chrono::steady_clock::now();
+		const auto budget = std::chrono::duration<double, std::milli>(std::max(budget_milliseconds, 0.0));
+		for (bool first = true; stepped->recognition->getRemainingStepCount() > 0; first = false) {
+			// Stop when the next utterance, taking as long as the average one so far, would exceed the
+			// budget; the first step of a call always runs
+			const auto elapsed = std::chrono::steady_clock::now() - start;
+			if (!first && elapsed + stepped->step_duration / stepped->step_count > budget) break;
+
+			const auto step_start = std::chrono::steady_clock::now();
+			stepped->recognition->step();
+			stepped->step_duration += std::chrono::steady_clock::now() - step_start;
+			++stepped->step_count;
+		}
+		return stepped->recognition->getRemainingStepCount() > 0 ? 1 : 0;
+	} catch (const OperationCancelled& e) {
+		set_cancellation_error(e);
+		return -1;
+	} catch (const std::exception& e) {
+		set_error(std::string("Analysis error: ") + e.what());
+		return -1;
+	} catch (...) {
+		set_error("Unknown analysis error");
+		return -1;
+	}
+}
+
+// Finish a stepped analysis, generating an array of mouth cues
+extern "C" const lipsyncengine_mouth_cue* lipsyncengine_analyze_finish(int32_t analysis, int32_t* cue_count) {
+	try {
+		clear_error();
+
+		if (!cue_count) {
+			set_error("cue_count cannot be NULL");
+			return nullptr;
+		}
+		*cue_count = 0;
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine || !find_stepped_analysis(*engine, analysis)) return nullptr;
+		auto& stepped_analyses = engine->stepped_analyses;
+		const std::unique_ptr<stepped_analysis> stepped = std::move(stepped_analyses[analysis]);
+		stepped_analyses.erase(analysis);
+
+		const auto* cues = [&]() -> lipsyncengine_mouth_cue* {
+			const stepped_analysis_scope scope(*stepped);
+			const BoundedTimeline<Phone> phones = std::move(stepped->recognition->finish().front());
+			const JoiningContinuousTimeline<Shape> animation = animate(phones, stepped->options.target_shapes);
+			stepped->progress_sink.finish();
+
+			const size_t size = animation.size();
+			auto* cues = measureStage(AnalysisStage::Export, [&] {
+				auto* cues = allocate_cues(*stepped->options.engine, size);
+				if (cues) {
+					write_cues(animation, cues);
+				}
+				return cues;
+			});
+			if (cues) {
+				*cue_count = static_cast<int32_t>(size);
+			}
+			return cues;
+		}();
+		if (!cues) {
+			set_error("Memory allocation failed");
+			return nullptr;
+		}
+
+		if (stepped->options.stats) {
+			write_stats(stepped->options.stats, stepped->stats, stepped->work_duration);
+		}
+		return cues;
+	} catch (const OperationCancelled& e) {
+		set_cancellation_error(e);
+		return nullptr;
+	} catch (const std::exception& e) {
+		set_error(std::string("Analysis error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown analysis error");
+		return nullptr;
+	}
+}
+
+// Discard a stepped analysis
+extern "C" int lipsyncengine_analyze_abort(int32_t analysis) {
+	clear_error();
+
+	const std::shared_ptr<engine_state> engine = current_engine();
+	if (!engine || !find_stepped_analysis(*engine, analysis)) return -1;
+	engine->stepped_analyses.erase(analysis);
+	return 0;
+}
+
+// Recognize PCM16 audio, returning the phones for lipsyncengine_animate()
+extern "C" const uint8_t* lipsyncengine_recognize_pcm16(
+	const int16_t* pcm16,
+	int32_t sample_count,
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options,
+	int32_t* byte_count
+) {
+	try {
+		clear_error();
+
+		if (!byte_count) {
+			set_error("byte_count cannot be NULL");
+			return nullptr;
+		}
+		*byte_count = 0;
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return nullptr;
+		auto analysis = read_options(*engine, options);
+		if (!analysis) return nullptr;
+		if (!validate_samples(pcm16, "pcm16", sample_count, sample_rate, "")) return nullptr;
+		if (!fit_memory_budget(*analysis, sample_count, analysis->engine->max_thread_count)) return nullptr;
+		const stats_collector stats(analysis->stats);
+		const cancellation_scope cancellation(*analysis);
+
+		auto audio_clip = createAudioClipViewFromPCM16(pcm16, sample_count, sample_rate);
+		callback_progress_sink progress_sink(*analysis, audio_clip->getTruncatedRange().getDuration());
+		const BoundedTimeline<Phone> phones = analysis->recognizer->recognizePhones(
+			*audio_clip,
+			to_dialog(dialog_text),
+			analysis->speaker.get(),
+			analysis->engine->max_thread_count,
+			progress_sink,
+			nullptr
+		);
+		progress_sink.finish();
+
+		auto* result = measureStage(AnalysisStage::Export, [&] {
+			const std::vector<uint8_t> bytes = serializePhones(phones);
+			auto* result = static_cast<uint8_t*>(malloc(bytes.size()));
+			if (result) {
+				std::copy(bytes.begin(), bytes.end(), result);
+				*byte_count = static_cast<int32_t>(bytes.size());
+			}
+			return result;
+		});
+		if (!result) {
+			set_error("Memory allocation failed");
+			return nullptr;
+		}
+
+		stats.write();
+		return result;
+	} catch (const OperationCancelled& e) {
+		set_cancellation_error(e);
+		return nullptr;
+	} catch (const std::exception& e) {
+		set_error(std::string("Analysis error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown analysis error");
+		return nullptr;
+	}
+}
+
+// Animate phones returned by lipsyncengine_recognize_pcm16()
+extern "C" const lipsyncengine_mouth_cue* lipsyncengine_animate(
+	const uint8_t* phones,
+	int32_t byte_count,
+	const lipsyncengine_options* options,
+	int32_t* cue_count
+) {
+	try {
+		clear_error();
+
+		if (!cue_count) {
+			set_error("cue_count cannot be NULL");
+			return nullptr;
+		}
+		*cue_count = 0;
+		if (!phones || byte_count <= 0) {
+			set_error("phones must hold byte_count bytes");
+			return nullptr;
+		}
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return nullptr;
+		auto analysis = read_options(*engine, options);
+		if (!analysis) return nullptr;
+		const stats_collector stats(analysis->stats);
+
+		const BoundedTimeline<Phone> timeline =
+			deserializePhones(gsl::span<const uint8_t>(phones, byte_count));
+		const JoiningContinuousTimeline<Shape> animation =
+			animate(timeline, analysis->target_shapes, analysis->engine->max_thread_count);
+
+		const size_t size = animation.size();
+		auto* cues = measureStage(AnalysisStage::Export, [&] {
+			auto* cues = allocate_cues(*analysis->engine, size);
+			if (cues) {
+				write_cues(animation, cues);
+			}
+			return cues;
+		});
+		if (!cues) {
+			set_error("Memory allocation failed");
+			return nullptr;
+		}
+
+		*cue_count = static_cast<int32_t>(size);
+		stats.write();
+		return cues;
+	} catch (const std::exception& e) {
+		set_error(std::string("Animation error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown animation error");
+		return nullptr;
+	}
+}
+
+// Builds an animation from mouth cues in the binary output format, from the given start to the
+// end of the last cue. Gaps between the cues are closed mouths (X).
+static JoiningContinuousTimeline<Shape> to_animation(
+	const lipsyncengine_mouth_cue* cues,
+	int32_t cue_count,
+	centiseconds start
+) {
+	const centiseconds end(cue_count > 0 ? cues[cue_count - 1].end : 0);
+	JoiningContinuousTimeline<Shape> animation(TimeRange(start, std::max(end, start)), Shape::X);
+	for (int32_t i = 0; i < cue_count; ++i) {
+		if (cues[i].shape >= static_cast<uint8_t>(Shape::EndSentinel)) {
+			throw std::invalid_argument(fmt::format("Cue {} has an unknown shape: {}", i, static_cast<int>(cues[i].shape)));
+		}
+		animation.set(
+			centiseconds(cues[i].start),
+			centiseconds(cues[i].end),
+			static_cast<Shape>(cues[i].shape));
+	}
+	return animation;
+}
+
+// Resample mouth cues at a fixed frame rate
+extern "C" int lipsyncengine_sample_frames(
+	const lipsyncengine_mouth_cue* cues,
+	int32_t cue_count,
+	double frame_rate,
+	int32_t blend,
+	lipsyncengine_frames* frames
+) {
+	try {
+		clear_error();
+
+		if (!frames) {
+			set_error("frames cannot be NULL");
+			return -1;
+		}
+		*frames = {};
+		if (cue_count < 0 || (cue_count > 0 && !cues)) {
+			set_error("cues must hold cue_count cues");
+			return -1;
+		}
+		if (!(frame_rate > 0 && frame_rate <= 1000)) {
+			set_error(fmt::format("Invalid frame rate: {}", frame_rate));
+			return -1;
+		}
+
+		const JoiningContinuousTimeline<Shape> animation = to_animation(cues, cue_count, 0_cs);
+
+		// Shapes and blend shapes, then the blend weights with their alignment
+		const size_t frame_count = getFrameCount(animation, frame_rate);
+		if (frame_count > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+			set_error("Too many frames");
+			return -1;
+		}
+		const size_t weights_offset = blend
+			? (2 * frame_count + alignof(float) - 1) / alignof(float) * alignof(float)
+			: frame_count;
+		const size_t size = weights_offset + (blend ? frame_count * sizeof(float) : 0);
+		auto* buffer = static_cast<uint8_t*>(malloc(std::max(size, size_t(1))));
+		if (!buffer) {
+			set_error("Memory allocation failed");
+			return -1;
+		}
+
+		frames->frame_count = static_cast<int32_t>(frame_count);
+		frames->shapes = buffer;
+		if (blend) {
+			frames->blend_shapes = buffer + frame_count;
+			frames->blend_weights = reinterpret_cast<float*>(buffer + weights_offset);
+		}
+		sampleFrames(animation, frame_rate, frames->shapes, frames->blend_shapes, frames->blend_weights);
+		return 0;
+	} catch (const std::exception& e) {
+		set_error(std::string("Frame sampling error: ") + e.what());
+		return -1;
+	} catch (...) {
+		set_error("Unknown frame sampling error");
+		return -1;
+	}
+}
+
+extern "C" const uint8_t* lipsyncengine_encode_cues(
+	const lipsyncengine_mouth_cue* cues,
+	int32_t cue_count,
+	int32_t seek_interval,
+	int32_t* byte_count
+) {
+	try {
+		clear_error();
+
+		if (!byte_count) {
+			set_error("byte_count cannot be NULL");
+			return nullptr;
+		}
+		*byte_count = 0;
+		if (cue_count < 0 || (cue_count > 0 && !cues)) {
+			set_error("cues must hold cue_count cues");
+			return nullptr;
+		}
+		if (seek_interval < 0) {
+			set_error(fmt::format("Invalid seek interval: {}", seek_interval));
+			return nullptr;
+		}
+		if (cue_count > 0 && cues[0].start < 0) {
+			set_error("Cues must not start before 0");
+			return nullptr;
+		}
+
+		const centiseconds start(cue_count > 0 ? cues[0].start : 0);
+		const std::vector<uint8_t> bytes = encodeCompactCues(to_animation(cues, cue_count, start), seek_interval);
+		auto* result = static_cast<uint8_t*>(malloc(bytes.size()));
+		if (!result) {
+			set_error("Memory allocation failed");
+			return nullptr;
+		}
+		std::copy(bytes.begin(), bytes.end(), result);
+		*byte_count = static_cast<int32_t>(bytes.size());
+		return result;
+	} catch (const std::exception& e) {
+		set_error(std::string("Encoding error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown encoding error");
+		return nullptr;
+	}
+}
+
+// Returns a streaming session of an engine, or NULL after setting the error if there is none
+static StreamingAnalyzer* find_stream(engine_state& engine, int32_t stream) {
+	const auto it = engine.streams.find(stream);
+	if (it == engine.streams.end()) {
+		set_error("Unknown stream handle");
+		return nullptr;
+	}
+	return it->second.get();
+}
+
+// Throws the error a streaming session ran into while the engine recognized its utterances during
+// a push, so that the session's next call reports it
+static void rethrow_stream_error(engine_state& engine, const StreamingAnalyzer& stream) {
+	if (const std::exception_ptr error = engine.stream_scheduler.takeError(stream)) {
+		std::rethrow_exception(error);
+	}
+}
+
+static const char* get_profile_name(DecoderProfile profile) {
+	switch (profile) {
+		case DecoderProfile::Offline: return "offline";
+		case DecoderProfile::Balanced: return "balanced";
+		case DecoderProfile::Realtime: return "realtime";
+		case DecoderProfile::RealtimeDownsampled: return "realtimeDownsampled";
+		case DecoderProfile::OfflineOneBest: return "offlineOneBest";
+		case DecoderProfile::Streaming: return "streaming";
+	}
+	return "unknown";
+}
+
+// Returns the recognizers a stream with the options moves between to keep up with
+// max_real_time_factor, from the best to the cheapest: its own, then the realtime profiles cheaper
+// than it, phonetic recognition and frame classification. Each profile keeps its own decoders, so
+// only the realtime ones are stepped through. Without a maximum real-time factor, the stream keeps
+// its own recognizer.
+static std::vector<StreamingAnalyzer::QualityLevel> get_quality_levels(const analysis_options& options) {
+	engine_state& engine = *options.engine;
+	const Recognizer* phonetic = engine.phonetic_recognizer.get();
+	const Recognizer* classifier = engine.classifier_recognizer.get();
+	const bool is_pocketsphinx = options.recognizer != phonetic && options.recognizer != classifier;
+
+	std::vector<StreamingAnalyzer::QualityLevel> levels;
+	if (is_pocketsphinx) {
+		levels.push_back({ get_profile_name(options.profile), options.recognizer });
+	} else {
+		levels.push_back({ options.recognizer == phonetic ? "phonetic" : "classifier", options.recognizer });
+	}
+	if (options.max_real_time_factor <= 0) return levels;
+
+	if (is_pocketsphinx) {
+		const DecoderProfile profile = options.profile;
+		if (profile == DecoderProfile::Offline
+			|| profile == DecoderProfile::OfflineOneBest
+			|| profile == DecoderProfile::Balanced
+		) {
+			levels.push_back({
+				get_profile_name(DecoderProfile::Realtime),
+				get_pocketsphinx_recognizer(engine, DecoderProfile::Realtime, options.dialog_mode)
+			});
+		}
+		if (profile != DecoderProfile::RealtimeDownsampled) {
+			levels.push_back({
+				get_profile_name(DecoderProfile::RealtimeDownsampled),
+				get_pocketsphinx_recognizer(engine, DecoderProfile::RealtimeDownsampled, options.dialog_mode)
+			});
+		}
+		levels.push_back({ "phonetic", phonetic });
+	}
+	if (options.recognizer != classifier) {
+		levels.push_back({ "classifier", classifier });
+	}
+	return levels;
+}
+
+// Begin a streaming analysis session
+extern "C" int32_t lipsyncengine_stream_begin(
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options
+) {
+	try {
+		clear_error();
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return -1;
+
+		if (sample_rate <= 0) {
+			set_error("sample_rate must be positive");
+			return -1;
+		}
+
+		auto analysis = read_options(*engine, options);
+		if (!analysis) return -1;
+		// Streams share the engine's threads, buffering their audio only until each utterance ends
+		if (!fit_memory_budget(*analysis, 0, analysis->engine->max_thread_count)) return -1;
+
+		const boost::optional<std::string> dialog = to_dialog(dialog_text);
+
+		auto stream = std::make_unique<StreamingAnalyzer>(
+			get_quality_levels(*analysis),
+			analysis->max_real_time_factor,
+			sample_rate,
+			dialog,
+			analysis->target_shapes
+		);
+		const int32_t handle = engine->next_stream_handle++;
+		engine->stream_scheduler.add(*stream);
+		engine->streams[handle] = std::move(stream);
+		return handle;
+	} catch (const std::exception& e) {
+		set_error(std::string("Stream error: ") + e.what());
+		return -1;
+	} catch (...) {
+		set_error("Unknown stream error");
+		return -1;
+	}
+}
+
+// Push audio to a streaming session
+extern "C" int lipsyncengine_stream_push(int32_t stream, const int16_t* pcm16, int32_t sample_count) {
+	try {
+		clear_error();
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return -1;
+		StreamingAnalyzer* analyzer = find_stream(*engine, stream);
+		if (!analyzer) return -1;
+
+		if (!pcm16 && sample_count > 0) {
+			set_error("pcm16 cannot be NULL");
+			return -1;
+		}
+
+		if (sample_count < 0) {
+			set_error("sample_count must not be negative");
+			return -1;
+		}
+
+		analyzer->push(pcm16, static_cast<size_t>(sample_count));
+		// Recognizes the utterances queued by this and the engine's other streams
+		engine->stream_scheduler.run(engine->max_thread_count);
+		rethrow_stream_error(*engine, *analyzer);
+		return 0;
+	} catch (const std::exception& e) {
+		set_error(std::string("Stream error: ") + e.what());
+		return -1;
+	} catch (...) {
+		set_error("Unknown stream error");
+		return -1;
+	}
+}
+
+extern "C" int lipsyncengine_stream_push_activity(
+	int32_t stream,
+	const int16_t* pcm16,
+	int32_t sample_count,
+	const uint8_t* frame_activity,
+	int32_t frame_count
+) {
+	try {
+		clear_error();
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return -1;
+		StreamingAnalyzer* analyzer = find_stream(*engine, stream);
+		if (!analyzer) return -1;
+
+		if (!pcm16 && sample_count > 0) {
+			set_error("pcm16 cannot be NULL");
+			return -1;
+		}
+
+		if (!frame_activity && frame_count > 0) {
+			set_error("frame_activity cannot be NULL");
+			return -1;
+		}
+
+		if (sample_count < 0 || frame_count < 0) {
+			set_error("sample_count and frame_count must not be negative");
+			return -1;
+		}
+
+		analyzer->pushActivity(
+			pcm16,
+			static_cast<size_t>(sample_count),
+			gsl::span<const uint8_t>(frame_activity, static_cast<size_t>(frame_count))
+		);
+		engine->stream_scheduler.run(engine->max_thread_count);
+		rethrow_stream_error(*engine, *analyzer);
+		return 0;
+	} catch (const std::exception& e) {
+		set_error(std::string("Stream error: ") + e.what());
+		return -1;
+	} catch (...) {
+		set_error("Unknown stream error");
+		return -1;
+	}
+}
+
+// Get the mouth cues finalized since the last poll
+extern "C" const char* lipsyncengine_stream_poll(int32_t stream) {
+	try {
+		clear_error();
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return nullptr;
+		StreamingAnalyzer* analyzer = find_stream(*engine, stream);
+		if (!analyzer) return nullptr;
+
+		rethrow_stream_error(*engine, *analyzer);
+		const std::vector<Timed<Shape>> cues = analyzer->poll();
+		const std::vector<Timed<Shape>>& tentativeCues = analyzer->getTentativeCues();
+		return write_json_c_string([&](JsonWriter& writer) {
+			write_stream_cues(writer, cues, tentativeCues, *analyzer, false);
+		});
+	} catch (const std::exception& e) {
+		set_error(std::string("Stream error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown stream error");
+		return nullptr;
+	}
+}
+
+// End a streaming session
+extern "C" const char* lipsyncengine_stream_end(int32_t stream) {
+	try {
+		clear_error();
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return nullptr;
+		StreamingAnalyzer* analyzer = find_stream(*engine, stream);
+		if (!analyzer) return nullptr;
+
+		// The session is closed even if recognizing the remaining audio fails
+		const std::exception_ptr error = engine->stream_scheduler.takeError(*analyzer);
+		engine->stream_scheduler.remove(*analyzer);
+		const std::unique_ptr<StreamingAnalyzer> closedStream = std::move(engine->streams[stream]);
+		engine->streams.erase(stream);
+
+		if (error) std::rethrow_exception(error);
+		closedStream->finish();
+		const std::vector<Timed<Shape>> cues = closedStream->poll();
+		return write_json_c_string([&](JsonWriter& writer) { write_stream_cues(writer, cues, {}, *closedStream, true); });
+	} catch (const std::exception& e) {
+		set_error(std::string("Stream error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown stream error");
+		return nullptr;
+	}
+}
+
+// Save the state of a streaming session, so that it can be continued by another engine or process
+extern "C" const uint8_t* lipsyncengine_stream_save(int32_t stream, int32_t* byte_count) {
+	try {
+		clear_error();
+
+		if (!byte_count) {
+			set_error("byte_count cannot be NULL");
+			return nullptr;
+		}
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return nullptr;
+		StreamingAnalyzer* analyzer = find_stream(*engine, stream);
+		if (!analyzer) return nullptr;
+
+		rethrow_stream_error(*engine, *analyzer);
+		const std::vector<uint8_t> bytes = analyzer->serialize();
+		auto* result = static_cast<uint8_t*>(malloc(bytes.size()));
+		if (!result) {
+			set_error("Memory allocation failed");
+			return nullptr;
+		}
+		std::copy(bytes.begin(), bytes.end(), result);
+		*byte_count = static_cast<int32_t>(bytes.size());
+		return result;
+	} catch (const std::exception& e) {
+		set_error(std::string("Stream error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown stream error");
+		return nullptr;
+	}
+}
+
+// Continue a streaming session saved with lipsyncengine_stream_save()
+extern "C" int32_t lipsyncengine_stream_restore(
+	const uint8_t* state,
+	int32_t byte_count,
+	const lipsyncengine_options* options
+) {
+	try {
+		clear_error();
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return -1;
+
+		if (!state || byte_count <= 0) {
+			set_error("state cannot be empty");
+			return -1;
+		}
+
+		auto analysis = read_options(*engine, options);
+		if (!analysis) return -1;
+		if (!fit_memory_budget(*analysis, 0, analysis->engine->max_thread_count)) return -1;
+
+		auto stream = StreamingAnalyzer::deserialize(
+			gsl::span<const uint8_t>(state, static_cast<size_t>(byte_count)),
+			get_quality_levels(*analysis),
+			analysis->max_real_time_factor,
+			analysis->target_shapes
+		);
+		const int32_t handle = engine->next_stream_handle++;
+		engine->stream_scheduler.add(*stream);
+		engine->streams[handle] = std::move(stream);
+		return handle;
+	} catch (const std::exception& e) {
+		set_error(std::string("Stream error: ") + e.what());
+		return -1;
+	} catch (...) {
+		set_error("Unknown stream error");
+		return -1;
+	}
+}
+
+// Close a streaming session without recognizing the rest of its audio
+extern "C" int lipsyncengine_stream_abort(int32_t stream) {
+	clear_error();
+
+	const std::shared_ptr<engine_state> engine = current_engine();
+	if (!engine) return -1;
+	StreamingAnalyzer* analyzer = find_stream(*engine, stream);
+	if (!analyzer) return -1;
+
+	engine->stream_scheduler.takeError(*analyzer);
+	engine->stream_scheduler.remove(*analyzer);
+	engine->streams.erase(stream);
+	return 0;
+}
+
+// Create an engine with recognizers, settings, buffers and streams of its own
+extern "C" int32_t lipsyncengine_create() {
+	try {
+		clear_error();
+
+		if (!current_engine()) return -1;
+
+		auto engine = std::make_shared<engine_state>();
+		std::lock_guard<std::mutex> lock(g_engines_mutex);
+		const int32_t handle = g_next_engine_handle++;
+		g_engines[handle] = std::move(engine);
+		return handle;
+	} catch (const std::exception& e) {
+		set_error(std::string("Engine error: ") + e.what());
+		return -1;
+	} catch (...) {
+		set_error("Unknown engine error");
+		return -1;
+	}
+}
+
+// Select the engine used by the calling thread
+extern "C" int lipsyncengine_select(int32_t engine) {
+	clear_error();
+
+	if (!g_initialized) {
+		set_error("Module not initialized. Call lipsyncengine_init() first");
+		return -1;
+	}
+	if (!find_engine(engine)) {
+		set_error("Unknown engine handle");
+		return -1;
+	}
+
+	g_engine_handle = engine;
+	return 0;
+}
+
+// Destroy an engine created by lipsyncengine_create()
+extern "C" int lipsyncengine_destroy(int32_t engine) {
+	clear_error();
+
+	if (engine == 0) {
+		set_error("The default engine is destroyed by lipsyncengine_cleanup()");
+		return -1;
+	}
+
+	std::shared_ptr<engine_state> destroyed;
+	{
+		std::lock_guard<std::mutex> lock(g_engines_mutex);
+		const auto it = g_engines.find(engine);
+		if (it == g_engines.end()) {
+			set_error("Unknown engine handle");
+			return -1;
+		}
+		destroyed = std::move(it->second);
+		g_engines.erase(it);
+	}
+	if (g_engine_handle == engine) {
+		g_engine_handle = 0;
+	}
+	// Frees the decoders outside of the lock, unless a call on another thread still uses the engine
+	destroyed.reset();
+	return 0;
+}
+
+// Create a speaker profile, empty or from saved bytes
+extern "C" int32_t lipsyncengine_speaker_create(const uint8_t* profile, int32_t byte_count) {
+	try {
+		clear_error();
+
+		if (byte_count < 0 || (byte_count > 0 && !profile)) {
+			set_error("profile must hold byte_count bytes");
+			return -1;
+		}
+
+		auto speaker = byte_count > 0
+			? std::make_shared<SpeakerProfile>(gsl::span<const uint8_t>(profile, byte_count))
+			: std::make_shared<SpeakerProfile>();
+		std::lock_guard<std::mutex> lock(g_speakers_mutex);
+		const int32_t handle = g_next_speaker_handle++;
+		g_speakers[handle] = std::move(speaker);
+		return handle;
+	} catch (const std::exception& e) {
+		set_error(std::string("Speaker error: ") + e.what());
+		return -1;
+	} catch (...) {
+		set_error("Unknown speaker error");
+		return -1;
+	}
+}
+
+// Save a speaker profile as bytes
+extern "C" const uint8_t* lipsyncengine_speaker_save(int32_t speaker, int32_t* byte_count) {
+	try {
+		clear_error();
+
+		if (!byte_count) {
+			set_error("byte_count cannot be NULL");
+			return nullptr;
+		}
+
+		std::shared_ptr<SpeakerProfile> profile;
+		{
+			std::lock_guard<std::mutex> lock(g_speakers_mutex);
+			const auto it = g_speakers.find(speaker);
+			if (it == g_speakers.end()) {
+				set_error("Unknown speaker handle");
+				return nullptr;
+			}
+			profile = it->second;
+		}
+
+		const std::vector<uint8_t> bytes = profile->serialize();
+		auto* result = static_cast<uint8_t*>(malloc(bytes.size()));
+		if (!result) {
+			set_error("Memory allocation failed");
+			return nullptr;
+		}
+		std::copy(bytes.begin(), bytes.end(), result);
+		*byte_count = static_cast<int32_t>(bytes.size());
+		return result;
+	} catch (const std::exception& e) {
+		set_error(std::string("Speaker error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown speaker error");
+		return nullptr;
+	}
+}
+
+// Release a speaker profile created by lipsyncengine_speaker_create()
+extern "C" int lipsyncengine_speaker_release(int32_t speaker) {
+	clear_error();
+
+	std::lock_guard<std::mutex> lock(g_speakers_mutex);
+	if (g_speakers.erase(speaker) == 0) {
+		set_error("Unknown speaker handle");
+		return -1;
+	}
+	return 0;
+}
+
+// Free memory allocated by the analysis and streaming functions
+extern "C" void lipsyncengine_free(const void* ptr) {
+	if (!ptr) return;
+
+	// The scratch buffers are kept for the next call, whichever engine they belong to
+	{
+		std::lock_guard<std::mutex> lock(g_engines_mutex);
+		if (g_scratch_buffers.count(ptr) > 0) return;
+	}
+
+	free(const_cast<void*>(ptr));
+}
+
+// Get the input buffer reused across calls, with room for at least byte_length bytes
+extern "C" void* lipsyncengine_reserve_input(int32_t byte_length) {
+	clear_error();
+
+	const std::shared_ptr<engine_state> engine = current_engine();
+	if (!engine) return nullptr;
+
+	if (byte_length < 0) {
+		set_error("byte_length must not be negative");
+		return nullptr;
+	}
+
+	void* buffer = engine->input_buffer.reserve(std::max<size_t>(byte_length, 1));
+	if (!buffer) {
+		set_error("Memory allocation failed");
+	}
+	return buffer;
+}
+
+// Let the binary analysis functions return their cues in an output buffer reused across calls
+extern "C" void lipsyncengine_reuse_output(int32_t enabled) {
+	const std::shared_ptr<engine_state> engine = g_initialized ? find_engine(g_engine_handle) : nullptr;
+	if (!engine) return;
+
+	engine->reuse_output = enabled != 0;
+	if (!engine->reuse_output) {
+		engine->output_buffer.release();
 	}
 }
 
@@ -206,9 +2347,405 @@ extern "C" const char* lipsyncengine_get_last_error() {
 	return g_last_error.c_str();
 }
 
+// Estimate how long analyzing audio of the given length takes
+extern "C" double lipsyncengine_estimate_milliseconds(
+	int32_t sample_count,
+	int32_t sample_rate,
+	const lipsyncengine_options* options
+) {
+	try {
+		clear_error();
+
+		if (sample_count < 0) {
+			set_error("sample_count must not be negative");
+			return -1;
+		}
+		if (sample_rate <= 0) {
+			set_error("sample_rate must be positive");
+			return -1;
+		}
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return -1;
+		const auto analysis = read_options(*engine, options);
+		if (!analysis) return -1;
+
+		const centiseconds audio_duration = Timebase(sample_rate).getTruncatedRange(sample_count).getDuration();
+		return static_cast<double>(
+			analysis->recognizer->estimateDuration(audio_duration, analysis->engine->max_thread_count).count());
+
+	} catch (const std::exception& e) {
+		set_error(std::string("Estimation error: ") + e.what());
+		return -1;
+	}
+}
+
+// Create decoders ahead of the first analysis
+extern "C" int lipsyncengine_prewarm(int32_t decoder_count, const lipsyncengine_options* options) {
+	try {
+		clear_error();
+
+		if (decoder_count < 0) {
+			set_error("decoder_count must not be negative");
+			return -1;
+		}
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return -1;
+		auto analysis = read_options(*engine, options);
+		if (!analysis) return -1;
+		if (!fit_memory_budget(*analysis, 0, decoder_count)) return -1;
+
+		analysis->recognizer->prewarm(decoder_count);
+		return 0;
+
+	} catch (const std::exception& e) {
+		set_error(std::string("Prewarming error: ") + e.what());
+		return -1;
+	}
+}
+
+// A second of synthetic speech for warming up: a buzz at a voice's pitch with its upper overtones
+// emphasized like a vowel's formant, swelling three times like syllables. Voice activity detection
+// takes it for speech, and it costs about as much to recognize as real speech.
+static std::vector<int16_t> create_warmup_speech(int32_t sample_rate) {
+	const double pi = std::acos(-1.0);
+	const double pitch = 120;
+	std::vector<int16_t> samples(static_cast<size_t>(sample_rate));
+	for (size_t i = 0; i < samples.size(); ++i) {
+		const double time = static_cast<double>(i) / sample_rate;
+		const double envelope = 0.5 - 0.5 * std::cos(2 * pi * 3 * time);
+		double value = 0;
+		for (int overtone = 1; overtone <= 7; ++overtone) {
+			const double weight = overtone >= 5 ? 2.0 : 1.0;
+			value += std::sin(2 * pi * pitch * overtone * time) * weight / overtone;
+		}
+		samples[i] = static_cast<int16_t>(std::clamp(3000 * envelope * value, -32767.0, 32767.0));
+	}
+	return samples;
+}
+
+// Warm up the engine ahead of the first analysis
+extern "C" int lipsyncengine_warmup(int32_t level, const lipsyncengine_options* options) {
+	try {
+		clear_error();
+
+		if (level != LIPSYNCENGINE_WARMUP_DECODERS && level != LIPSYNCENGINE_WARMUP_FULL) {
+			set_error(fmt::format("Unknown warmup level: {}", level));
+			return -1;
+		}
+
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return -1;
+		auto analysis = read_options(*engine, options);
+		if (!analysis) return -1;
+		const int32_t decoder_count = analysis->engine->max_thread_count;
+		if (!fit_memory_budget(*analysis, 0, decoder_count)) return -1;
+
+		analysis->recognizer->prewarm(decoder_count);
+		if (level == LIPSYNCENGINE_WARMUP_FULL) {
+			// Nothing of the analysis is reported
+			analysis->stats = nullptr;
+			analysis->cancel_flag = nullptr;
+			analysis->timeout_milliseconds = 0;
+			analysis->progress_callback = nullptr;
+			analysis->yield_interval_milliseconds = 0;
+			analysis->cue_callback = nullptr;
+			analysis->speaker = nullptr;
+			analysis->preview_callback = nullptr;
+
+			// Browsers record at 48 kHz, so resampling is warmed up too
+			const int32_t sample_rate = 48000;
+			const std::vector<int16_t> samples = create_warmup_speech(sample_rate);
+			const auto audio_clip = createAudioClipViewFromPCM16(
+				samples.data(), static_cast<int32_t>(samples.size()), sample_rate);
+			analyze_clip(*audio_clip, "Hello there.", *analysis);
+		}
+		return 0;
+
+	} catch (const std::exception& e) {
+		set_error(std::string("Warmup error: ") + e.what());
+		return -1;
+	}
+}
+
+// Set the maximum number of threads per analysis
+extern "C" int32_t lipsyncengine_set_max_thread_count(int32_t max_thread_count) {
+	clear_error();
+
+	const std::shared_ptr<engine_state> engine = current_engine();
+	if (!engine) return -1;
+
+	if (max_thread_count < 1) {
+		set_error("max_thread_count must be at least 1");
+		return -1;
+	}
+
+	engine->max_thread_count = std::min(max_thread_count, g_thread_limit);
+	return engine->max_thread_count;
+}
+
+// Whether analyses can yield to the host
+extern "C" int32_t lipsyncengine_can_yield() {
+	return CancellationToken::canYield() ? 1 : 0;
+}
+
+extern "C" int32_t lipsyncengine_set_gpu_scoring(int32_t enabled) {
+	clear_error();
+
+	if (enabled && !canScoreOnGpu()) {
+		set_error("This build can't score on the GPU");
+		return -1;
+	}
+	setGpuScoringEnabled(enabled != 0);
+	return 0;
+}
+
+static bool toLanguageModelVariant(int32_t language_model, LanguageModelVariant& variant) {
+	switch (language_model) {
+		case LIPSYNCENGINE_LANGUAGE_MODEL_FULL:
+			variant = LanguageModelVariant::Full;
+			return true;
+		case LIPSYNCENGINE_LANGUAGE_MODEL_SMALL:
+			variant = LanguageModelVariant::Small;
+			return true;
+		case LIPSYNCENGINE_LANGUAGE_MODEL_VOCABULARY:
+			variant = LanguageModelVariant::Vocabulary;
+			return true;
+		default:
+			set_error(fmt::format("Unknown language model: {}", language_model));
+			return false;
+	}
+}
+
+// Select the word language model
+extern "C" int lipsyncengine_set_language_model(int32_t language_model) {
+	clear_error();
+
+	LanguageModelVariant variant;
+	if (!toLanguageModelVariant(language_model, variant)) return -1;
+	setSphinxLanguageModelVariant(variant);
+	return 0;
+}
+
+// The pages of a paged language model, or nullptr with the error set
+static lm_trie_pages_t* getPages(int32_t language_model) {
+	LanguageModelVariant variant;
+	if (!toLanguageModelVariant(language_model, variant)) return nullptr;
+	lm_trie_pages_t* pages = getLanguageModelPages(getSphinxLanguageModelFileName(variant));
+	if (!pages) {
+		set_error("The language model isn't paged");
+	}
+	return pages;
+}
+
+// Prepare paged loading of a language model
+extern "C" int32_t lipsyncengine_page_language_model(
+	int32_t language_model,
+	const uint8_t* head,
+	int32_t head_size,
+	lipsyncengine_language_model_layout* layout
+) {
+	clear_error();
+
+	if (!head || head_size < 0 || !layout) {
+		set_error("head and layout cannot be NULL");
+		return -1;
+	}
+	LanguageModelVariant variant;
+	if (!toLanguageModelVariant(language_model, variant)) return -1;
+
+	const auto modelLayout =
+		pageLanguageModel(getSphinxLanguageModelFileName(variant), head, static_cast<size_t>(head_size));
+	if (!modelLayout) {
+		set_error("The language model isn't a binary trie model");
+		return -1;
+	}
+	layout->ngram_offset = static_cast<int32_t>(modelLayout->ngramOffset);
+	layout->ngram_size = static_cast<int32_t>(modelLayout->ngramSize);
+	layout->page_size = 1 << languageModelPageBits;
+	layout->page_count = modelLayout->pageCount;
+	return 0;
+}
+
+// Get the memory of a page of a paged language model
+extern "C" uint8_t* lipsyncengine_language_model_page(int32_t language_model, int32_t index) {
+	clear_error();
+
+	lm_trie_pages_t* pages = getPages(language_model);
+	if (!pages) return nullptr;
+	if (index < 0 || static_cast<uint32_t>(index) >= pages->n_pages) {
+		set_error(fmt::format("Invalid page: {}", index));
+		return nullptr;
+	}
+	return pages->mem + (static_cast<size_t>(index) << pages->page_bits);
+}
+
+// Mark a page of a paged language model loaded
+extern "C" int32_t lipsyncengine_set_language_model_page_loaded(int32_t language_model, int32_t index) {
+	clear_error();
+
+	lm_trie_pages_t* pages = getPages(language_model);
+	if (!pages) return -1;
+	if (index < 0 || static_cast<uint32_t>(index) >= pages->n_pages) {
+		set_error(fmt::format("Invalid page: {}", index));
+		return -1;
+	}
+	lm_trie_pages_set_loaded(pages, static_cast<uint32_t>(index));
+	return 0;
+}
+
+// Get the page of a paged language model to load next
+extern "C" int32_t lipsyncengine_next_language_model_page(int32_t language_model) {
+	clear_error();
+
+	lm_trie_pages_t* pages = getPages(language_model);
+	if (!pages) return -2;
+	return lm_trie_pages_next(pages);
+}
+
+// Get the heap usage of the module
+extern "C" int lipsyncengine_get_memory_stats(lipsyncengine_memory_stats* stats) {
+	try {
+		clear_error();
+
+		if (!stats) {
+			set_error("stats cannot be NULL");
+			return -1;
+		}
+
+		stats->heap_bytes = static_cast<double>(getHeapUsage());
+		stats->peak_heap_bytes = static_cast<double>(getPeakHeapUsage());
+		stats->memory_size_bytes = static_cast<double>(getMemorySize());
+		stats->model_bytes = g_initialized ? static_cast<double>(getSphinxModelSize()) : 0;
+		stats->decoder_count = getDecoderCount();
+		stats->memory_budget_bytes = g_memory_budget;
+		return 0;
+	} catch (const std::exception& e) {
+		set_error(std::string("Memory stats error: ") + e.what());
+		return -1;
+	} catch (...) {
+		set_error("Unknown memory stats error");
+		return -1;
+	}
+}
+
+// Record trace spans of the engine's work
+extern "C" void lipsyncengine_set_tracing(int32_t enabled) {
+	setTracingEnabled(enabled != 0);
+}
+
+extern "C" double lipsyncengine_trace_clock() {
+	return static_cast<double>(getTraceClockMicroseconds());
+}
+
+// Get the recorded spans as Chrome trace events
+extern "C" const char* lipsyncengine_take_trace(int32_t process_id, double clock_offset_microseconds) {
+	try {
+		clear_error();
+
+		const std::string json = takeChromeTraceEvents(process_id, std::llround(clock_offset_microseconds));
+		char* result = static_cast<char*>(malloc(json.size() + 1));
+		if (!result) {
+			set_error("Memory allocation failed");
+			return nullptr;
+		}
+		std::memcpy(result, json.c_str(), json.size() + 1);
+		return result;
+	} catch (const std::exception& e) {
+		set_error(std::string("Trace error: ") + e.what());
+		return nullptr;
+	} catch (...) {
+		set_error("Unknown trace error");
+		return nullptr;
+	}
+}
+
+// Limit the heap memory of the module
+extern "C" int lipsyncengine_set_memory_budget(double budget_bytes, int32_t policy) {
+	clear_error();
+
+	if (!(budget_bytes >= 0)) {
+		set_error("budget_bytes must not be negative");
+		return -1;
+	}
+
+	if (policy != LIPSYNCENGINE_BUDGET_FAIL && policy != LIPSYNCENGINE_BUDGET_FALLBACK_PHONETIC) {
+		set_error(fmt::format("Unknown budget policy: {}", policy));
+		return -1;
+	}
+
+	g_memory_budget = budget_bytes;
+	g_budget_policy = policy;
+	return 0;
+}
+
+// Free cached decoders and dialog language models, keeping the engine initialized
+extern "C" int lipsyncengine_release_caches() {
+	clear_error();
+
+	try {
+		const std::shared_ptr<engine_state> engine = current_engine();
+		if (!engine) return -1;
+
+		// The scratch buffers don't depend on the streams
+		engine->input_buffer.release();
+		engine->output_buffer.release();
+
+		// Streams hold decoders owned by the recognizers
+		if (!engine->streams.empty()) {
+			set_error("Cannot release caches while streaming sessions are open");
+			return -1;
+		}
+		// Stepped analyses keep track of the dialogs of the recognizers' decoders
+		if (!engine->stepped_analyses.empty()) {
+			set_error("Cannot release caches while stepped analyses are open");
+			return -1;
+		}
+
+		engine->recognizer->clearDecoderCache();
+		{
+			std::lock_guard<std::mutex> lock(engine->profile_recognizers_mutex);
+			for (auto& entry : engine->profile_recognizers) {
+				entry.second->clearDecoderCache();
+			}
+		}
+		engine->phonetic_recognizer->clearDecoderCache();
+		engine->classifier_recognizer->clearDecoderCache();
+		return 0;
+	} catch (const std::exception& e) {
+		set_error(std::string("Error releasing caches: ") + e.what());
+		return -1;
+	} catch (...) {
+		set_error("Unknown error releasing caches");
+		return -1;
+	}
+}
+
 // Phase 0: Cleanup function to free decoder resources
 extern "C" void lipsyncengine_cleanup() {
-	g_recognizer.reset();
-	g_cached_dialog_text.clear();
 	g_initialized = false;
+	std::shared_ptr<engine_state> default_engine;
+	std::map<int32_t, std::shared_ptr<engine_state>> engines;
+	{
+		std::lock_guard<std::mutex> lock(g_engines_mutex);
+		default_engine.swap(g_default_engine);
+		engines.swap(g_engines);
+	}
+	// Outside of the lock, which freeing their scratch buffers takes
+	engines.clear();
+	default_engine.reset();
+	{
+		std::lock_guard<std::mutex> lock(g_speakers_mutex);
+		g_speakers.clear();
+	}
+	g_engine_handle = 0;
+	g_memory_budget = 0;
+	g_budget_policy = LIPSYNCENGINE_BUDGET_FAIL;
+
+	// Writes out pending log entries
+	if (g_log_sink) {
+		logging::removeSink(g_log_sink);
+		g_log_sink.reset();
+	}
 }
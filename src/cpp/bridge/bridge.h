@@ -10,18 +10,399 @@ extern "C" {
  * Initialize the LipSyncEngine WASM module.
  * Must be called before any other functions.
  *
- * @param models_path Path to models directory in Emscripten virtual FS (usually "/models")
+ * @param models_path Path to the models directory in Emscripten virtual FS (usually "/models"),
+ *                    or on disk in native builds. If it doesn't contain the models (an
+ *                    acoustic-model subdirectory), the models next to the binary are used.
  * @return 0 on success, non-zero on error
  */
 int lipsyncengine_init(const char* models_path);
 
+/**
+ * Create an engine, e.g. to analyze with different decoder profiles on different threads without
+ * contending for decoders. The functions below use the engine selected by the calling thread with
+ * lipsyncengine_select(), the default engine set up by lipsyncengine_init() unless another is
+ * selected. Each engine has its own recognizers with their decoders and dialog language model
+ * caches, maximum thread count, scratch buffers and streaming sessions; the models, language
+ * model variant, memory budget and logging are shared. Different engines can be used
+ * concurrently; an engine itself should only be used by one thread at a time.
+ * The last error is kept per thread rather than per engine: as an engine is used by one thread at a
+ * time, that is the error of the engine the thread uses, and calls that fail before finding an
+ * engine, e.g. before lipsyncengine_init(), report their errors too.
+ *
+ * @return Handle of the engine (positive), or -1 on error
+ */
+int32_t lipsyncengine_create();
+
+/**
+ * Select the engine used by the calling thread.
+ *
+ * @param engine Handle returned by lipsyncengine_create(), or 0 for the default engine
+ * @return 0 on success, non-zero on error
+ */
+int lipsyncengine_select(int32_t engine);
+
+/**
+ * Destroy an engine created by lipsyncengine_create(), ending its streaming sessions and freeing
+ * its decoders and buffers. Calls already running on it on other threads finish first, and the
+ * engine is freed when the last of them returns. Threads that have selected it get errors until
+ * they select another engine; the calling thread returns to the default engine.
+ *
+ * @param engine Handle returned by lipsyncengine_create()
+ * @return 0 on success, non-zero on error
+ */
+int lipsyncengine_destroy(int32_t engine);
+
+/**
+ * Create a speaker profile, which analyses given it in their options start from and update: the
+ * mean of the speaker's cepstra, which normalizes short utterances better than the mean of the
+ * utterance alone, and the background noise voice activity detection has adapted to. Save it with
+ * lipsyncengine_speaker_save() to warm-start the next session with the same speaker. Profiles
+ * are shared by all engines and safe to use from several threads.
+ *
+ * @param profile Bytes returned by lipsyncengine_speaker_save(), or NULL for a new speaker
+ * @param byte_count Number of bytes in profile
+ * @return Handle of the profile (positive), or -1 on error
+ */
+int32_t lipsyncengine_speaker_create(const uint8_t* profile, int32_t byte_count);
+
+/**
+ * Save what a speaker profile has learned so far.
+ *
+ * @param speaker Handle returned by lipsyncengine_speaker_create()
+ * @param byte_count Receives the number of bytes returned
+ * @return The profile's bytes, or NULL on error. Caller must free them using lipsyncengine_free()
+ */
+const uint8_t* lipsyncengine_speaker_save(int32_t speaker, int32_t* byte_count);
+
+/**
+ * Release a speaker profile. Analyses still using it keep it until they finish.
+ *
+ * @param speaker Handle returned by lipsyncengine_speaker_create()
+ * @return 0 on success, non-zero on error
+ */
+int lipsyncengine_speaker_release(int32_t speaker);
+
+/**
+ * Word language models of LIPSYNCENGINE_RECOGNIZER_POCKETSPHINX.
+ */
+typedef enum lipsyncengine_language_model {
+	// en-us.lm.bin
+	LIPSYNCENGINE_LANGUAGE_MODEL_FULL = 0,
+	// en-us-small.lm.bin, a pruned copy of the full model generated at build time. About a quarter
+	// of its download and memory size, at some loss of accuracy.
+	LIPSYNCENGINE_LANGUAGE_MODEL_SMALL = 1,
+	// vocabulary.lm.bin with the dictionary vocabulary.dict.bin, a vocabulary pack generated for a
+	// project's dialog lines by lip-sync-engine-vocabulary-pack. Only the pack's words are recognized.
+	LIPSYNCENGINE_LANGUAGE_MODEL_VOCABULARY = 2
+} lipsyncengine_language_model;
+
+/**
+ * Select the word language model, read from the models directory when an analysis first needs
+ * it. Call before lipsyncengine_init() or between analyses; each model keeps its own decoders.
+ *
+ * @param language_model A lipsyncengine_language_model value
+ * @return 0 on success, non-zero on error
+ */
+int lipsyncengine_set_language_model(int32_t language_model);
+
+/**
+ * Where the n-gram arrays of a language model file lie, for paged loading.
+ */
+typedef struct lipsyncengine_language_model_layout {
+	int32_t ngram_offset;  // Offset of the n-gram arrays in the file, in bytes
+	int32_t ngram_size;    // Size of the n-gram arrays in bytes
+	int32_t page_size;     // Size of each page in bytes; the last one may be shorter
+	int32_t page_count;
+} lipsyncengine_language_model_layout;
+
+/**
+ * Prepare paged loading of a language model, so that analyses can start before all of it has
+ * arrived: the n-gram arrays make up most of a binary trie model. Write the model file without
+ * the layout's n-gram arrays into the models directory, then copy each page into the memory
+ * returned by lipsyncengine_language_model_page() as it arrives and mark it loaded. Until a page
+ * is loaded, recognition backs off past the n-grams it holds, at some loss of accuracy. Call
+ * before the file is written; pages loaded earlier in the session are kept.
+ *
+ * @param language_model A lipsyncengine_language_model value
+ * @param head The first bytes of the model file, at least 64
+ * @param head_size Number of bytes in head
+ * @param layout Receives the layout
+ * @return 0 on success, non-zero on error, e.g. if the head isn't that of a binary trie model
+ */
+int32_t lipsyncengine_page_language_model(
+	int32_t language_model,
+	const uint8_t* head,
+	int32_t head_size,
+	lipsyncengine_language_model_layout* layout
+);
+
+/**
+ * Get the memory of a page of a paged language model, to copy its bytes into from the file's
+ * n-gram arrays at ngram_offset + index * page_size.
+ *
+ * @param language_model A lipsyncengine_language_model value
+ * @param index Index of the page
+ * @return The page's memory, or NULL on error
+ */
+uint8_t* lipsyncengine_language_model_page(int32_t language_model, int32_t index);
+
+/**
+ * Mark a page of a paged language model loaded once its bytes are copied, from any thread.
+ *
+ * @param language_model A lipsyncengine_language_model value
+ * @param index Index of the page
+ * @return 0 on success, non-zero on error
+ */
+int32_t lipsyncengine_set_language_model_page_loaded(int32_t language_model, int32_t index);
+
+/**
+ * Get the page of a paged language model to load next: one that recognition needed before it
+ * arrived if any, otherwise the first one missing.
+ *
+ * @param language_model A lipsyncengine_language_model value
+ * @return Index of the page, -1 once all are loaded, or -2 on error
+ */
+int32_t lipsyncengine_next_language_model_page(int32_t language_model);
+
+/**
+ * Speech recognizers for lipsyncengine_options.
+ */
+typedef enum lipsyncengine_recognizer {
+	// Recognizes words, then aligns their phones with the audio. Uses the dialog text.
+	LIPSYNCENGINE_RECOGNIZER_POCKETSPHINX = 0,
+	// Recognizes phones directly. Several times faster and without the word language model and
+	// dictionary, but less accurate. Ignores the dialog text.
+	LIPSYNCENGINE_RECOGNIZER_PHONETIC = 1,
+	// Classifies each frame into phones that look alike, without any search. Several times faster
+	// than phonetic recognition and needs only the acoustic model, but only the mouth shapes of the
+	// phones are reliable. Suited for ambient dialog. Ignores the dialog text.
+	LIPSYNCENGINE_RECOGNIZER_CLASSIFIER = 2
+} lipsyncengine_recognizer;
+
+/**
+ * Decoder profiles for lipsyncengine_options, trading recognition accuracy for speed.
+ * Each profile keeps its own decoders, so switching between profiles costs memory.
+ */
+typedef enum lipsyncengine_profile {
+	// PocketSphinx's full search, for offline rendering
+	LIPSYNCENGINE_PROFILE_OFFLINE = 0,
+	// Tighter beams and no second search pass
+	LIPSYNCENGINE_PROFILE_BALANCED = 1,
+	// Narrow beams and a single search pass, for live audio
+	LIPSYNCENGINE_PROFILE_REALTIME = 2,
+	// Realtime, with word recognition scoring at half the frame rate and alignment at the full rate
+	LIPSYNCENGINE_PROFILE_REALTIME_DOWNSAMPLED = 3,
+	// Offline, taking the best words from the search passes without building and rescoring a lattice
+	LIPSYNCENGINE_PROFILE_OFFLINE_ONE_BEST = 4,
+	// Realtime, normalizing with the mean of the speech heard so far, so that streaming sessions
+	// recognize each utterance while it is spoken
+	LIPSYNCENGINE_PROFILE_STREAMING = 5
+} lipsyncengine_profile;
+
+/**
+ * Dialog modes for lipsyncengine_options, setting how the dialog text constrains recognition.
+ * Strict and verbatim decoding keep their own decoders, like a profile.
+ */
+typedef enum lipsyncengine_dialog_mode {
+	// The dialog's words are favored, but any word can be recognized
+	LIPSYNCENGINE_DIALOG_MODE_BIASED = 0,
+	// Only the dialog's words are recognized. Decoding scripted lines gets much faster, but words
+	// missing from the dialog text are recognized as dialog words.
+	LIPSYNCENGINE_DIALOG_MODE_STRICT = 1,
+	// The dialog is taken as spoken and aligned with the audio, skipping word recognition.
+	// Utterances the dialog doesn't fit are recognized like biased ones.
+	LIPSYNCENGINE_DIALOG_MODE_VERBATIM = 2
+} lipsyncengine_dialog_mode;
+
+/**
+ * Stages of an analysis, indexing lipsyncengine_stats.stage_milliseconds.
+ */
+typedef enum lipsyncengine_stage {
+	LIPSYNCENGINE_STAGE_DC_REMOVAL = 0,
+	// Includes applying the DC offset, which happens while the resampled audio is buffered
+	LIPSYNCENGINE_STAGE_RESAMPLING = 1,
+	// Includes the energy gate that skips long silences before voice activity detection
+	LIPSYNCENGINE_STAGE_VOICE_ACTIVITY_DETECTION = 2,
+	LIPSYNCENGINE_STAGE_FEATURE_EXTRACTION = 3,
+	// Recognition of words, or of phones by LIPSYNCENGINE_RECOGNIZER_PHONETIC
+	LIPSYNCENGINE_STAGE_WORD_RECOGNITION = 4,
+	LIPSYNCENGINE_STAGE_ALIGNMENT = 5,
+	// Animation passes
+	LIPSYNCENGINE_STAGE_SHAPE_RULES = 6,
+	LIPSYNCENGINE_STAGE_ROUGH_ANIMATION = 7,
+	LIPSYNCENGINE_STAGE_TIMING_OPTIMIZATION = 8,
+	LIPSYNCENGINE_STAGE_PAUSE_ANIMATION = 9,
+	LIPSYNCENGINE_STAGE_TWEENING = 10,
+	LIPSYNCENGINE_STAGE_TARGET_SHAPE_CONVERSION = 11,
+	// Writing the JSON or binary result
+	LIPSYNCENGINE_STAGE_EXPORT = 12,
+	LIPSYNCENGINE_STAGE_COUNT = 13
+} lipsyncengine_stage;
+
+/**
+ * Timing and counters of an analysis, filled in if requested by lipsyncengine_options.stats.
+ * All fields are doubles, so the struct can be read from WASM memory as a Float64Array.
+ */
+typedef struct lipsyncengine_stats {
+	// Time spent in each lipsyncengine_stage, summed over all threads
+	double stage_milliseconds[LIPSYNCENGINE_STAGE_COUNT];
+	// Wall time of the whole call
+	double total_milliseconds;
+	// Utterances found by voice activity detection
+	double utterance_count;
+	// Cepstral frames searched by recognition, 100 per second of utterance audio
+	double frame_count;
+	// HMMs evaluated by recognition; divide by frame_count for the number per frame
+	double hmm_evaluation_count;
+	// Decoders reused from earlier calls
+	double decoder_cache_hits;
+	// Decoders created, each costing hundreds of milliseconds and tens of megabytes
+	double decoder_cache_misses;
+	// Dialog language models reused from earlier calls
+	double dialog_model_cache_hits;
+	// Dialog language models built
+	double dialog_model_cache_misses;
+	// Utterances whose phones were reused from earlier calls, as their audio and dialog were
+	// recognized before (e.g. the unchanged parts of an edited recording)
+	double utterance_cache_hits;
+	// Utterances recognized
+	double utterance_cache_misses;
+} lipsyncengine_stats;
+
+/**
+ * A mouth cue in the binary output format.
+ * The struct is 12 bytes with 4-byte alignment, so an array of cues can be read from WASM memory
+ * as an Int32Array with a stride of 3 elements.
+ */
+typedef struct lipsyncengine_mouth_cue {
+	int32_t start;        // Start time in centiseconds
+	int32_t end;          // End time in centiseconds
+	uint8_t shape;        // Mouth shape: 0-8 for A-H and X
+	uint8_t reserved[3];  // Always 0
+} lipsyncengine_mouth_cue;
+
+/**
+ * A word or phone recognized by an analysis, see lipsyncengine_timings.
+ */
+typedef struct lipsyncengine_timed_label {
+	int32_t start;     // Start time in centiseconds
+	int32_t end;       // End time in centiseconds
+	const char* text;  // The word in lowercase, or the phone, e.g. "AA", "Schwa" or "Noise"
+} lipsyncengine_timed_label;
+
+/**
+ * The words and phones recognized by an analysis, filled in if requested by
+ * lipsyncengine_options.timings, so that callers needing them, e.g. for subtitles, don't recognize
+ * the audio a second time. The phones are the aligned phones the mouth cues were animated from.
+ * Only LIPSYNCENGINE_RECOGNIZER_POCKETSPHINX recognizes words; the other recognizers give none.
+ * The arrays and their text share one allocation; pass words to lipsyncengine_free() to free them
+ * all. Both are NULL until an analysis fills them in.
+ */
+typedef struct lipsyncengine_timings {
+	int32_t word_count;
+	lipsyncengine_timed_label* words;   // Words ordered by time, without silence and noises
+	int32_t phone_count;
+	lipsyncengine_timed_label* phones;  // Phones ordered by time, without silence
+} lipsyncengine_timings;
+
+/**
+ * Receives the progress of an analysis, from 0 to 1, on the thread that started it, along with an
+ * estimate of the milliseconds remaining until it completes.
+ * The analysis continues once the callback returns, so it should return quickly.
+ */
+typedef void (*lipsyncengine_progress_callback)(double progress, double remaining_milliseconds, void* context);
+
+/**
+ * Receives mouth cues of an analysis as soon as they are final, on the thread that started it.
+ * Together, the cues of all calls make up the analysis result, in chronological order, except that
+ * a cue may be split between two calls.
+ * The cues are only valid during the call.
+ */
+typedef void (*lipsyncengine_cue_callback)(const lipsyncengine_mouth_cue* cues, int32_t cue_count, void* context);
+
+/**
+ * Options for an analysis or streaming session.
+ * Functions taking options accept NULL for the defaults.
+ */
+typedef struct lipsyncengine_options {
+	// Bitmask of the mouth shapes to animate with: bit i for shape i (0-8 for A-H and X).
+	// Must contain the basic shapes A-F (0x3F); shapes left out are replaced by similar basic ones.
+	// 0 for the basic shapes only.
+	uint32_t target_shapes;
+	// A lipsyncengine_recognizer value (default: LIPSYNCENGINE_RECOGNIZER_POCKETSPHINX)
+	int32_t recognizer;
+	// A lipsyncengine_profile value (default: LIPSYNCENGINE_PROFILE_OFFLINE).
+	// Only affects LIPSYNCENGINE_RECOGNIZER_POCKETSPHINX.
+	int32_t profile;
+	// If not NULL, receives the stats of a successful analysis. Collecting them costs next to
+	// nothing. Ignored by streaming sessions.
+	lipsyncengine_stats* stats;
+	// If not NULL, the analysis stops with an error soon after *cancel_flag becomes non-zero.
+	// It is checked between utterances, every 100 frames of recognition and between animation
+	// passes, and may be set from any thread. Ignored by streaming sessions.
+	const volatile int32_t* cancel_flag;
+	// If positive, the analysis stops with an error once it has taken this many milliseconds,
+	// checked like cancel_flag. Ignored by streaming sessions.
+	int32_t timeout_milliseconds;
+	// If not NULL, called with the progress as it grows by at least 1%, and with 1 at the end of a
+	// successful analysis. Progress combines voice activity detection and recognition, weighted by
+	// their cost as measured in earlier analyses with the same recognizer and profile, so it grows
+	// about evenly over time. Ignored by streaming sessions.
+	lipsyncengine_progress_callback progress_callback;
+	// Passed to progress_callback
+	void* progress_context;
+	// A lipsyncengine_dialog_mode value (default: LIPSYNCENGINE_DIALOG_MODE_BIASED).
+	// Only affects LIPSYNCENGINE_RECOGNIZER_POCKETSPHINX. Ignored without dialog text.
+	int32_t dialog_mode;
+	// If positive, the thread that started the analysis yields to the host's event loop where it
+	// checks cancel_flag, at most every this many milliseconds, so that the host can set the flag
+	// or handle other events meanwhile. Ignored unless lipsyncengine_can_yield() returns 1. The
+	// analysis must then be called through its JSPI export, which returns a Promise, and nothing
+	// else may be called into the module until it settles. Ignored by streaming sessions.
+	int32_t yield_interval_milliseconds;
+	// If not NULL, called with the mouth cues as they become final: after each utterance is
+	// recognized and no later one can change them. Cues found on threads helping the analysis are
+	// passed with the next progress report on the thread that started it. Ignored by streaming
+	// sessions, batches and stepped analyses.
+	lipsyncengine_cue_callback cue_callback;
+	// Passed to cue_callback
+	void* cue_context;
+	// If not 0, a handle returned by lipsyncengine_speaker_create(). The analysis starts from what
+	// the profile has learned about the speaker and updates it once it completes; every clip of a
+	// batch counts as the speaker's. With LIPSYNCENGINE_PROFILE_STREAMING, only voice activity
+	// detection uses it. Ignored by streaming sessions.
+	int32_t speaker;
+	// If not NULL, called once before speech is recognized with a preview of the animation: mouth
+	// cues guessed from the loudness of the audio alone, within milliseconds. The analysis then
+	// returns the cues of full recognition as usual, so an editor can show the preview meanwhile.
+	// Ignored by streaming sessions and batches.
+	lipsyncengine_cue_callback preview_callback;
+	// Passed to preview_callback
+	void* preview_context;
+	// If positive, a streaming session times the recognition of its utterances and keeps it under
+	// this many seconds per second of speech, e.g. 0.5, by moving to cheaper recognition while it
+	// is slower: from its own profile to LIPSYNCENGINE_PROFILE_REALTIME, then
+	// LIPSYNCENGINE_PROFILE_REALTIME_DOWNSAMPLED, LIPSYNCENGINE_RECOGNIZER_PHONETIC,
+	// LIPSYNCENGINE_RECOGNIZER_CLASSIFIER and finally loudness alone, skipping the levels that aren't
+	// cheaper than the options. It returns to better levels once recognition has been well within
+	// the limit for a while. The level is reported by lipsyncengine_stream_poll(). Each profile
+	// keeps its own decoders, so stepping down costs memory. Ignored by other analyses.
+	float max_real_time_factor;
+	// If not NULL, receives the words and phones recognized by a successful analysis. The JSON
+	// result of lipsyncengine_analyze_pcm16() has them as "words" and "phones" instead, leaving
+	// *timings empty. Ignored by streaming sessions, batches, stepped analyses and
+	// lipsyncengine_recognize_pcm16().
+	lipsyncengine_timings* timings;
+} lipsyncengine_options;
+
 /**
  * Analyze PCM16 audio data and generate lip-sync-engine animation as JSON.
  *
  * @param pcm16 Pointer to PCM16 audio data (int16_t array)
  * @param sample_count Number of samples in pcm16 array
- * @param sample_rate Sample rate in Hz (e.g., 16000, 22050, 44100, 48000)
+ * @param sample_rate Sample rate in Hz (e.g., 8000, 16000, 22050, 44100, 48000)
  * @param dialog_text Optional dialog text for improved recognition (can be NULL or empty string)
+ * @param options Optional analysis options (can be NULL)
  * @return JSON string with animation data, or NULL on error.
  *         Caller must free the returned string using lipsyncengine_free()
  */
@@ -29,27 +410,656 @@ const char* lipsyncengine_analyze_pcm16(
 	const int16_t* pcm16,
 	int32_t sample_count,
 	int32_t sample_rate,
-	const char* dialog_text
+	const char* dialog_text,
+	const lipsyncengine_options* options
+);
+
+/**
+ * Analyze PCM16 audio data and generate lip-sync-engine animation as an array of mouth cues.
+ * Same as lipsyncengine_analyze_pcm16(), but without the cost of formatting and parsing JSON.
+ *
+ * @param pcm16 Pointer to PCM16 audio data (int16_t array)
+ * @param sample_count Number of samples in pcm16 array
+ * @param sample_rate Sample rate in Hz (e.g., 8000, 16000, 22050, 44100, 48000)
+ * @param dialog_text Optional dialog text for improved recognition (can be NULL or empty string)
+ * @param options Optional analysis options (can be NULL)
+ * @param cue_count Receives the number of mouth cues in the returned array
+ * @return Array of mouth cues ordered by time, or NULL on error.
+ *         Caller must free the returned array using lipsyncengine_free()
+ */
+const lipsyncengine_mouth_cue* lipsyncengine_analyze_pcm16_binary(
+	const int16_t* pcm16,
+	int32_t sample_count,
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options,
+	int32_t* cue_count
+);
+
+/**
+ * Analyze mono float audio data and generate lip-sync-engine animation as an array of mouth cues.
+ * Same as lipsyncengine_analyze_pcm16_binary(), but for samples in [-1.0, 1.0] as provided by the
+ * Web Audio API, which saves converting them to PCM16 first.
+ *
+ * @param samples Pointer to float samples (float array)
+ * @param sample_count Number of samples in samples array
+ * @param sample_rate Sample rate in Hz (e.g., 8000, 16000, 22050, 44100, 48000)
+ * @param dialog_text Optional dialog text for improved recognition (can be NULL or empty string)
+ * @param options Optional analysis options (can be NULL)
+ * @param cue_count Receives the number of mouth cues in the returned array
+ * @return Array of mouth cues ordered by time, or NULL on error.
+ *         Caller must free the returned array using lipsyncengine_free()
+ */
+const lipsyncengine_mouth_cue* lipsyncengine_analyze_f32(
+	const float* samples,
+	int32_t sample_count,
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options,
+	int32_t* cue_count
+);
+
+/**
+ * Analyze interleaved multichannel float audio data, such as stereo, and generate lip-sync-engine
+ * animation as an array of mouth cues. The channels are mixed down to mono while the audio is read.
+ *
+ * @param samples Pointer to float samples, frame_count * channel_count of them: the samples of all
+ *        channels of the first frame, then those of the second frame, and so on
+ * @param frame_count Number of frames in samples array
+ * @param channel_count Number of channels (e.g., 1 for mono, 2 for stereo)
+ * @param sample_rate Sample rate in Hz (e.g., 8000, 16000, 22050, 44100, 48000)
+ * @param dialog_text Optional dialog text for improved recognition (can be NULL or empty string)
+ * @param options Optional analysis options (can be NULL)
+ * @param cue_count Receives the number of mouth cues in the returned array
+ * @return Array of mouth cues ordered by time, or NULL on error.
+ *         Caller must free the returned array using lipsyncengine_free()
+ */
+const lipsyncengine_mouth_cue* lipsyncengine_analyze_f32_interleaved(
+	const float* samples,
+	int32_t frame_count,
+	int32_t channel_count,
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options,
+	int32_t* cue_count
+);
+
+/**
+ * Convert float audio data to mono PCM16 at another sample rate, using the engine's resampler.
+ * Doesn't need lipsyncengine_init(). Lets callers prepare PCM16 for the other functions without
+ * converting and resampling the audio in JavaScript.
+ *
+ * @param samples Pointer to interleaved float samples in [-1.0, 1.0], frame_count * channel_count
+ *        of them
+ * @param frame_count Number of frames in samples array
+ * @param channel_count Number of channels, mixed down to mono (e.g., 1 for mono, 2 for stereo)
+ * @param sample_rate Sample rate of samples in Hz
+ * @param target_sample_rate Sample rate of the result in Hz (e.g., 16000)
+ * @param sample_count Receives the number of samples in the returned array
+ * @return Array of PCM16 samples, or NULL on error.
+ *         Caller must free the returned array using lipsyncengine_free()
+ */
+const int16_t* lipsyncengine_convert_f32(
+	const float* samples,
+	int32_t frame_count,
+	int32_t channel_count,
+	int32_t sample_rate,
+	int32_t target_sample_rate,
+	int32_t* sample_count
+);
+
+/**
+ * Decode a WAVE file to mono PCM16 at another sample rate, using the engine's resampler.
+ * Doesn't need lipsyncengine_init(). Samples are decoded, mixed down and resampled in one pass, so
+ * the file never exists decoded at its original sample rate.
+ * Supports integer samples of 8 to 32 bits and 32-bit float samples.
+ *
+ * @param bytes Pointer to the contents of the WAVE file
+ * @param byte_count Number of bytes
+ * @param target_sample_rate Sample rate of the result in Hz (e.g., 16000)
+ * @param sample_count Receives the number of samples in the returned array
+ * @return Array of PCM16 samples, or NULL on error (e.g., for an unsupported file).
+ *         Caller must free the returned array using lipsyncengine_free()
+ */
+const int16_t* lipsyncengine_decode_wav(
+	const uint8_t* bytes,
+	int32_t byte_count,
+	int32_t target_sample_rate,
+	int32_t* sample_count
+);
+
+/**
+ * A clip to be analyzed by lipsyncengine_analyze_batch().
+ */
+typedef struct lipsyncengine_batch_clip {
+	const int16_t* pcm16;     // PCM16 audio data
+	int32_t sample_count;     // Number of samples in pcm16
+	int32_t sample_rate;      // Sample rate in Hz
+	const char* dialog_text;  // Optional dialog text (can be NULL or empty string)
+} lipsyncengine_batch_clip;
+
+/**
+ * Analyze many PCM16 clips at once, generating their mouth cues in the binary output format.
+ * Cheaper than analyzing the clips one by one: the utterances of all clips share one work queue,
+ * and clips with identical dialog text share its language model.
+ *
+ * @param clips Array of clips to analyze
+ * @param clip_count Number of clips in the array
+ * @param options Optional analysis options for all clips (can be NULL)
+ * @param cue_counts Array of clip_count elements, receiving the number of mouth cues of each clip
+ * @return Array of the mouth cues of all clips, one clip after another in the order of the clips,
+ *         or NULL on error. Caller must free the returned array using lipsyncengine_free()
+ */
+const lipsyncengine_mouth_cue* lipsyncengine_analyze_batch(
+	const lipsyncengine_batch_clip* clips,
+	int32_t clip_count,
+	const lipsyncengine_options* options,
+	int32_t* cue_counts
+);
+
+/**
+ * Begin an analysis of PCM16 audio data that runs in steps, for hosts that can't block their
+ * thread for a whole analysis, e.g. a single-threaded build on a page's main thread.
+ * Voice activity detection and the planning of the utterances happen here; call
+ * lipsyncengine_analyze_step() until it returns 0, then lipsyncengine_analyze_finish().
+ * All calls of an analysis must be made on the thread that began it. The audio data is copied.
+ * options->stats and options->cancel_flag must stay valid until the analysis is finished or
+ * aborted; options->timeout_milliseconds bounds the working time of all calls together, and
+ * options->yield_interval_milliseconds is ignored.
+ *
+ * @param pcm16 Pointer to PCM16 audio data (int16_t array)
+ * @param sample_count Number of samples in pcm16 array
+ * @param sample_rate Sample rate in Hz
+ * @param dialog_text Optional dialog text (can be NULL or empty string)
+ * @param options Optional analysis options (can be NULL)
+ * @return Handle of the analysis (positive), or -1 on error
+ */
+int32_t lipsyncengine_analyze_begin(
+	const int16_t* pcm16,
+	int32_t sample_count,
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options
+);
+
+/**
+ * Recognize utterances of an analysis begun with lipsyncengine_analyze_begin() for up to a time
+ * budget. A step recognizes whole utterances: at least one, then more while the average time of
+ * an utterance so far fits the rest of the budget.
+ *
+ * @param analysis Handle of the analysis
+ * @param budget_milliseconds Time to spend, e.g. what is left of the current frame
+ * @return 1 if utterances remain, 0 when the analysis is ready to be finished, -1 on error
+ */
+int lipsyncengine_analyze_step(int32_t analysis, double budget_milliseconds);
+
+/**
+ * Finish an analysis begun with lipsyncengine_analyze_begin(), recognizing any remaining
+ * utterances, then animating them. The handle is invalid afterwards, even on error.
+ *
+ * @param analysis Handle of the analysis
+ * @param cue_count Receives the number of mouth cues
+ * @return Array of mouth cues in the binary output format, or NULL on error.
+ *         Caller must free the returned array using lipsyncengine_free()
+ */
+const lipsyncengine_mouth_cue* lipsyncengine_analyze_finish(int32_t analysis, int32_t* cue_count);
+
+/**
+ * Discard an analysis begun with lipsyncengine_analyze_begin() without finishing it.
+ *
+ * @param analysis Handle of the analysis
+ * @return 0 on success, -1 if the handle is unknown
+ */
+int lipsyncengine_analyze_abort(int32_t analysis);
+
+/**
+ * Recognize the phones of PCM16 audio without animating them, for lipsyncengine_animate().
+ * Animating the same phones again, e.g. with other target shapes, then skips recognition, which
+ * takes almost all of the time of an analysis. The phones are in the format of serializePhones()
+ * (see src/cpp/recognition/recognizedPhones.h) and can be stored.
+ *
+ * @param pcm16 Pointer to PCM16 audio data (int16_t array)
+ * @param sample_count Number of samples in pcm16 array
+ * @param sample_rate Sample rate in Hz (e.g., 8000, 16000, 22050, 44100, 48000)
+ * @param dialog_text Optional dialog text for improved recognition (can be NULL or empty string)
+ * @param options Optional analysis options (can be NULL); target_shapes and cue_callback are ignored
+ * @param byte_count Receives the size of the returned phones in bytes
+ * @return The phones, or NULL on error. Caller must free them using lipsyncengine_free()
+ */
+const uint8_t* lipsyncengine_recognize_pcm16(
+	const int16_t* pcm16,
+	int32_t sample_count,
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options,
+	int32_t* byte_count
+);
+
+/**
+ * Animate phones returned by lipsyncengine_recognize_pcm16(), giving the same mouth cues as
+ * lipsyncengine_analyze_pcm16_binary() with the same options.
+ *
+ * @param phones The phones
+ * @param byte_count Size of the phones in bytes
+ * @param options Optional analysis options (can be NULL); only target_shapes and stats are used
+ * @param cue_count Receives the number of mouth cues in the returned array
+ * @return Array of mouth cues ordered by time, or NULL on error.
+ *         Caller must free the returned array using lipsyncengine_free()
+ */
+const lipsyncengine_mouth_cue* lipsyncengine_animate(
+	const uint8_t* phones,
+	int32_t byte_count,
+	const lipsyncengine_options* options,
+	int32_t* cue_count
+);
+
+/**
+ * Mouth shapes resampled at a fixed frame rate, see lipsyncengine_sample_frames().
+ * The arrays share one allocation; pass shapes to lipsyncengine_free() to free them all.
+ */
+typedef struct lipsyncengine_frames {
+	int32_t frame_count;     // Number of frames; frame i starts at i / frame_rate seconds
+	uint8_t* shapes;         // Mouth shape at the start of each frame: 0-8 for A-H and X
+	uint8_t* blend_shapes;   // Shape the mouth changes to within each frame (or its own shape), or NULL
+	float* blend_weights;    // Fraction of each frame covered by its blend shape, or NULL
+} lipsyncengine_frames;
+
+/**
+ * Resample mouth cues in the binary output format at a fixed frame rate, such as the frame rate
+ * of a video, as one byte per frame that can be uploaded to a renderer as it is.
+ *
+ * @param cues Array of mouth cues ordered by time, as returned by the binary analysis functions
+ * @param cue_count Number of mouth cues in the array
+ * @param frame_rate Frames per second, e.g. 24, 30 or 60
+ * @param blend Non-zero to also compute blend_shapes and blend_weights, for renderers that blend
+ *              between adjacent shapes
+ * @param frames Receives the frames
+ * @return 0 on success, -1 on error
+ */
+int lipsyncengine_sample_frames(
+	const lipsyncengine_mouth_cue* cues,
+	int32_t cue_count,
+	double frame_rate,
+	int32_t blend,
+	lipsyncengine_frames* frames
 );
 
 /**
- * Free memory allocated by lipsyncengine_analyze_pcm16.
+ * Encode mouth cues in the binary output format in the compact format of CompactExporter, for
+ * storage and network transfer: a header and a seek table, then a varint of duration and shape per
+ * cue, which is one byte for most cues. Gaps between the cues are encoded as closed mouths (X).
+ *
+ * @param cues Array of mouth cues ordered by time, as returned by the binary analysis functions
+ * @param cue_count Number of mouth cues in the array
+ * @param seek_interval Cues per seek table entry, or 0 for no seek table
+ * @param byte_count Receives the size of the encoded cues in bytes
+ * @return The encoded cues, or NULL on error. Caller must free them using lipsyncengine_free()
+ */
+const uint8_t* lipsyncengine_encode_cues(
+	const lipsyncengine_mouth_cue* cues,
+	int32_t cue_count,
+	int32_t seek_interval,
+	int32_t* byte_count
+);
+
+/**
+ * Free memory allocated by the analysis and streaming functions.
+ * Pointers to the scratch buffers are recognized if the engine that returned them is selected.
+ *
+ * @param ptr Pointer to free (returned from lipsyncengine_analyze_pcm16 and the like)
+ */
+void lipsyncengine_free(const void* ptr);
+
+/**
+ * Get a buffer for input audio that is kept and reused across calls, e.g. to pass to
+ * lipsyncengine_analyze_pcm16_binary(). Reusing it spares an allocation per analysis, which
+ * fragments the heap over long sessions. Growing the buffer discards its contents, and
+ * lipsyncengine_release_caches() and lipsyncengine_cleanup() free it.
  *
- * @param ptr Pointer to free (returned from lipsyncengine_analyze_pcm16)
+ * @param byte_length Bytes the buffer must hold
+ * @return Pointer to the buffer, valid until the next call; lipsyncengine_free() ignores it.
+ *         NULL on error.
  */
-void lipsyncengine_free(const char* ptr);
+void* lipsyncengine_reserve_input(int32_t byte_length);
 
 /**
- * Get the last error message.
+ * Make the binary analysis functions (lipsyncengine_analyze_pcm16_binary() and the like, and
+ * lipsyncengine_analyze_batch()) write their cues to an output buffer kept and reused across
+ * calls, instead of allocating an array per call. The returned cues are then only valid until
+ * the next analysis; lipsyncengine_free() ignores them, so callers may still pass them to it.
+ * lipsyncengine_release_caches() frees the buffer, and lipsyncengine_cleanup() also turns reuse off.
+ *
+ * @param enabled Non-zero to reuse the output buffer, 0 to allocate per call (the default)
+ */
+void lipsyncengine_reuse_output(int32_t enabled);
+
+/**
+ * Get the message of the last error on the calling thread.
  *
  * @return Error message string, or NULL if no error.
  *         Do NOT free the returned string.
  */
 const char* lipsyncengine_get_last_error();
 
+/**
+ * Begin a streaming analysis session.
+ * Audio is pushed in chunks while it is being recorded. Each utterance is recognized as soon as
+ * voice activity detection closes it, and its mouth cues can then be polled.
+ * The sessions of an engine share its decoders, which are only held while an utterance is being
+ * recognized, so many sessions can be open at once.
+ *
+ * @param sample_rate Sample rate in Hz (e.g., 8000, 16000, 44100, 48000)
+ * @param dialog_text Optional dialog text for improved recognition (can be NULL or empty string)
+ * @param options Optional analysis options (can be NULL)
+ * @return Stream handle (positive), or -1 on error
+ */
+int32_t lipsyncengine_stream_begin(
+	int32_t sample_rate,
+	const char* dialog_text,
+	const lipsyncengine_options* options
+);
+
+/**
+ * Push PCM16 audio to a streaming session.
+ * Recognizes all utterances completed by this audio before returning, along with those of the
+ * engine's other sessions, taking turns between the sessions on up to the engine's maximum thread
+ * count. If recognizing another session's utterance fails, that session's next push, poll or end
+ * reports the error.
+ * If there are more sessions than threads and they speak more than the threads can recognize in
+ * real time, the sessions begun last animate their utterances from loudness alone until the
+ * threads catch up again. As many sessions as there are threads are always recognized.
+ *
+ * @param stream Stream handle returned by lipsyncengine_stream_begin()
+ * @param pcm16 Pointer to PCM16 audio data (int16_t array)
+ * @param sample_count Number of samples in pcm16 array
+ * @return 0 on success, non-zero on error
+ */
+int lipsyncengine_stream_push(int32_t stream, const int16_t* pcm16, int32_t sample_count);
+
+/**
+ * Push PCM16 audio whose voice activity was detected already, e.g. by the WebRTC detector of
+ * lip-sync-engine-vad.wasm running in the capture thread, so that the session skips its own
+ * detection. Otherwise like lipsyncengine_stream_push().
+ * frame_activity has one value per 10 ms frame, continuing where the session's detection stands:
+ * 0 for a frame without voice, 1 for a frame with voice, and 2 for a frame without voice whose
+ * samples weren't captured, which the session fills with silence. Frame i spans the samples from
+ * i * sample_rate / 100 on, rounded down.
+ * Fails if the audio pushed so far with lipsyncengine_stream_push() ends within a frame.
+ *
+ * @param stream Stream handle returned by lipsyncengine_stream_begin()
+ * @param pcm16 The samples of the frames with values 0 and 1, in order
+ * @param sample_count Number of samples in pcm16 array, which must match the frames
+ * @param frame_activity Activity of each frame
+ * @param frame_count Number of frames in frame_activity array
+ * @return 0 on success, non-zero on error
+ */
+int lipsyncengine_stream_push_activity(
+	int32_t stream,
+	const int16_t* pcm16,
+	int32_t sample_count,
+	const uint8_t* frame_activity,
+	int32_t frame_count
+);
+
+/**
+ * Get the mouth cues finalized since the last poll.
+ * Finalized cues never change, so they can be played back right away.
+ * "tentativeCues" are provisional cues following the finalized ones, animated from what has been
+ * recognized so far. With the streaming profile, they include guesses for the utterance still
+ * being spoken. Each poll's tentative cues replace those of the previous poll.
+ * "fallback" is true while the session's utterances are animated from their loudness because the
+ * engine is overloaded (see lipsyncengine_stream_push()).
+ * "quality" is the recognition the session currently uses (see
+ * lipsyncengine_options.max_real_time_factor): a profile name such as "realtime", "phonetic",
+ * "classifier" or "loudness". "realTimeFactor" is the smoothed seconds of recognition per second
+ * of speech measured at that level, or 0 until measured or without max_real_time_factor.
+ *
+ * @param stream Stream handle returned by lipsyncengine_stream_begin()
+ * @return JSON string of the form
+ *         {"mouthCues": [...], "tentativeCues": [...], "fallback": false, "quality": "realtime",
+ *         "realTimeFactor": 0.31, "final": false},
+ *         or NULL on error.
+ *         Caller must free the returned string using lipsyncengine_free()
+ */
+const char* lipsyncengine_stream_poll(int32_t stream);
+
+/**
+ * End a streaming session, recognizing any remaining audio.
+ * The stream handle is invalid afterwards.
+ *
+ * @param stream Stream handle returned by lipsyncengine_stream_begin()
+ * @return JSON string with all mouth cues not yet polled, no tentative cues and "final": true,
+ *         or NULL on error.
+ *         Caller must free the returned string using lipsyncengine_free()
+ */
+const char* lipsyncengine_stream_end(int32_t stream);
+
+/**
+ * Save the state of a streaming session, so that another engine, possibly in another process or
+ * worker, can continue it with lipsyncengine_stream_restore(), e.g. to move sessions off an
+ * overloaded worker. The state holds the voice activity detector with its noise model, the
+ * cepstral mean learned from the speaker, the audio of the utterance still being spoken, the
+ * phones still being animated and the cues not yet polled; typically a few kilobytes plus 2 bytes
+ * per sample of the open utterance. The session stays open; abort it with
+ * lipsyncengine_stream_abort() once the state has been restored elsewhere.
+ *
+ * @param stream Stream handle returned by lipsyncengine_stream_begin()
+ * @param byte_count Receives the number of bytes returned
+ * @return The session's state, or NULL on error. Caller must free it using lipsyncengine_free()
+ */
+const uint8_t* lipsyncengine_stream_save(int32_t stream, int32_t* byte_count);
+
+/**
+ * Continue a streaming session saved with lipsyncengine_stream_save() on the calling thread's
+ * engine. The sample rate and dialog text are those of the saved session; the options may differ
+ * from its own. The utterance that was being spoken is recognized again from its start, so the
+ * cues continue as if the session had never moved, except for the dither the recognizers add to
+ * the audio and the batches the streaming profile normalizes its cepstra in.
+ *
+ * @param state Bytes returned by lipsyncengine_stream_save()
+ * @param byte_count Number of bytes in state
+ * @param options Optional analysis options (can be NULL)
+ * @return Stream handle (positive), or -1 on error, e.g. for a state saved by an incompatible
+ *         version
+ */
+int32_t lipsyncengine_stream_restore(
+	const uint8_t* state,
+	int32_t byte_count,
+	const lipsyncengine_options* options
+);
+
+/**
+ * Close a streaming session without recognizing its remaining audio, e.g. after it has been
+ * restored elsewhere. The stream handle is invalid afterwards.
+ *
+ * @param stream Stream handle returned by lipsyncengine_stream_begin()
+ * @return 0 on success, -1 if the handle is unknown
+ */
+int lipsyncengine_stream_abort(int32_t stream);
+
+/**
+ * Estimate how long analyzing audio of the given length takes with the given options, from the
+ * speed of earlier analyses with the same recognizer and profile. Until there have been any, typical
+ * speeds of a desktop CPU are assumed. Silence makes analyses faster than estimated.
+ *
+ * @param sample_count Number of samples of the audio
+ * @param sample_rate Sample rate in Hz
+ * @param options Optional analysis options (can be NULL)
+ * @return The estimated duration in milliseconds, or -1 on error
+ */
+double lipsyncengine_estimate_milliseconds(
+	int32_t sample_count,
+	int32_t sample_rate,
+	const lipsyncengine_options* options
+);
+
+/**
+ * Create decoders ahead of the first analysis, so that it doesn't wait for their creation.
+ * A pocketSphinx decoder takes a few hundred milliseconds to create and about 80 MB.
+ * Decoders count against the memory budget; with LIPSYNCENGINE_BUDGET_FALLBACK_PHONETIC, phonetic
+ * decoders are created instead if pocketSphinx ones don't fit.
+ *
+ * @param decoder_count Number of decoders to keep ready, e.g. the maximum thread count
+ * @param options Optional analysis options selecting the recognizer and profile (can be NULL)
+ * @return 0 on success, non-zero on error
+ */
+int lipsyncengine_prewarm(int32_t decoder_count, const lipsyncengine_options* options);
+
+/**
+ * How much of the first analysis lipsyncengine_warmup() does ahead of time.
+ */
+typedef enum lipsyncengine_warmup_level {
+	// Create the decoders, as lipsyncengine_prewarm() with the maximum thread count
+	LIPSYNCENGINE_WARMUP_DECODERS = 0,
+	// Also analyze a second of synthetic speech with a dialog. This touches the pages of the models,
+	// fills the dictionary caches, sets up the text tokenizer and, in WASM, lets the engine compile
+	// the code of every stage.
+	LIPSYNCENGINE_WARMUP_FULL = 1
+} lipsyncengine_warmup_level;
+
+/**
+ * Warm up the engine, so that the first analysis is as fast as later ones. Without it, the first
+ * analysis creates decoders and touches the models for the first time, which can make it several
+ * times slower.
+ * The text tokenizer is set up for the calling thread, which should be the one analyzing.
+ *
+ * @param level A lipsyncengine_warmup_level
+ * @param options Optional analysis options selecting the recognizer, profile and dialog mode to warm
+ *        up (can be NULL); callbacks, stats and the speaker are ignored
+ * @return 0 on success, non-zero on error
+ */
+int lipsyncengine_warmup(int32_t level, const lipsyncengine_options* options);
+
+/**
+ * Set the maximum number of threads used to recognize the utterances of one analysis.
+ * Only the multithreaded build (lip-sync-engine-mt) runs more than one thread; it is limited to
+ * the size of its worker pool. Streaming sessions always use a single thread.
+ *
+ * @param max_thread_count Requested maximum (at least 1)
+ * @return The maximum that will be used, or -1 on error
+ */
+int32_t lipsyncengine_set_max_thread_count(int32_t max_thread_count);
+
+/**
+ * Whether analyses can yield to the host's event loop (see yield_interval_milliseconds).
+ * Only the JSPI build (lip-sync-engine-jspi) can; there, lipsyncengine_analyze_pcm16(),
+ * lipsyncengine_analyze_pcm16_binary(), lipsyncengine_analyze_f32(),
+ * lipsyncengine_analyze_f32_interleaved() and lipsyncengine_analyze_batch() return Promises of
+ * their results.
+ *
+ * @return 1 if analyses can yield, 0 otherwise
+ */
+int32_t lipsyncengine_can_yield();
+
+/**
+ * Score the Gaussians of the tied-mixture acoustic model on the GPU, with the scorer the host
+ * installs as the module's lipsyncengineGpuScorer (see src/ts/utils/gpuScoring.ts). Only the JSPI
+ * build can, as analyses await the GPU. Blocks of frames are then scored through the scorer by
+ * analyses that yield (see yield_interval_milliseconds) with the offline, offline one-best and
+ * balanced profiles, and on the CPU otherwise or if the scorer fails.
+ * Call before the first analysis: decoders created earlier evaluate shorter blocks, which suit the
+ * CPU. Scores may differ from the CPU's in rounding, so results can differ slightly.
+ *
+ * @param enabled 1 to score on the GPU, 0 to score on the CPU
+ * @return 0 on success, -1 if this build can't score on the GPU
+ */
+int32_t lipsyncengine_set_gpu_scoring(int32_t enabled);
+
+/**
+ * Heap usage of the module, filled in by lipsyncengine_get_memory_stats().
+ * All fields are doubles, so the struct can be read from WASM memory as a Float64Array.
+ */
+typedef struct lipsyncengine_memory_stats {
+	// Bytes allocated with malloc and not yet freed (as reported by mallinfo)
+	double heap_bytes;
+	// Peak of heap_bytes. In WASM, malloc's high-water mark including free blocks; natively, the
+	// highest heap_bytes seen when analyses start and when decoders have been created.
+	double peak_heap_bytes;
+	// Size of the WebAssembly memory, which grows as needed and never shrinks. 0 in native builds.
+	double memory_size_bytes;
+	// Size of the model files. In WASM, they are held by the virtual file system.
+	double model_bytes;
+	// Decoders in existence, each keeping its own copy of the acoustic model
+	double decoder_count;
+	// The budget set by lipsyncengine_set_memory_budget(), or 0 for none
+	double memory_budget_bytes;
+} lipsyncengine_memory_stats;
+
+/**
+ * Get the heap usage of the module.
+ *
+ * @param stats Receives the heap usage
+ * @return 0 on success, non-zero on error
+ */
+int lipsyncengine_get_memory_stats(lipsyncengine_memory_stats* stats);
+
+/**
+ * Enable or disable recording trace spans of the engine's work: voice activity detection, each
+ * utterance's recognition (with the number of its decoder), alignment, the animation passes,
+ * reading language models, building dialog language models and creating decoders.
+ * Spans go to a ring buffer of the most recent ones, which disabling frees. Tracing is off by
+ * default and costs nothing then.
+ *
+ * @param enabled Non-zero to record spans, 0 to stop
+ */
+void lipsyncengine_set_tracing(int32_t enabled);
+
+/**
+ * Get the clock trace spans are measured with, to compute the offset for lipsyncengine_take_trace().
+ *
+ * @return The clock in microseconds, from an arbitrary origin
+ */
+double lipsyncengine_trace_clock();
+
+/**
+ * Get the spans recorded since the last call as a JSON array of Chrome trace events, which
+ * chrome://tracing and Perfetto display, and clear them. Each thread of the module gets its own
+ * track. Arrays of several modules (e.g. the workers of a pool) can be concatenated into one trace.
+ *
+ * @param process_id Process ID of the events, distinguishing modules in a merged trace
+ * @param clock_offset_microseconds Added to the lipsyncengine_trace_clock() times of the spans,
+ *        e.g. to put them on a clock shared by several modules
+ * @return JSON string, or NULL on error. Caller must free the returned string using lipsyncengine_free()
+ */
+const char* lipsyncengine_take_trace(int32_t process_id, double clock_offset_microseconds);
+
+/**
+ * What an analysis does when it would exceed the memory budget.
+ */
+typedef enum lipsyncengine_budget_policy {
+	// Fail with an error before analyzing
+	LIPSYNCENGINE_BUDGET_FAIL = 0,
+	// Use LIPSYNCENGINE_RECOGNIZER_PHONETIC instead if that fits the budget, otherwise fail
+	LIPSYNCENGINE_BUDGET_FALLBACK_PHONETIC = 1
+} lipsyncengine_budget_policy;
+
+/**
+ * Limit the heap memory of the module, e.g. to keep a mobile browser tab from running out of
+ * memory. Before each analysis and streaming session, the current heap usage plus an estimate for
+ * the audio buffers and for the decoders that would have to be created is checked against the
+ * budget. The budget applies until it is changed or lipsyncengine_cleanup() is called.
+ *
+ * @param budget_bytes Maximum heap usage in bytes, or 0 for no limit
+ * @param policy A lipsyncengine_budget_policy value
+ * @return 0 on success, non-zero on error
+ */
+int lipsyncengine_set_memory_budget(double budget_bytes, int32_t policy);
+
+/**
+ * Free the cached decoders and dialog language models, e.g. while the page is in the background.
+ * They are re-created as needed, so the next analysis is slower. The engine stays initialized,
+ * and the memory budget stays in effect. The freed heap memory can be reused, but WebAssembly
+ * memory never shrinks.
+ *
+ * @return 0 on success, non-zero on error, e.g. while streaming sessions or stepped analyses are
+ *         open
+ */
+int lipsyncengine_release_caches();
+
 /**
  * Cleanup function to free decoder resources.
  * Call this when completely done with analysis to free memory.
+ * Destroys all engines, ending their open streaming sessions, and releases all speaker profiles.
  * Phase 0: Decoder reuse optimization cleanup.
  */
 void lipsyncengine_cleanup();
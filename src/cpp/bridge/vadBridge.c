@@ -0,0 +1,52 @@
+/*
+ * The WebRTC voice activity detector on its own, built as lip-sync-engine-vad.wasm for the capture
+ * AudioWorklet (see src/ts/utils/capture-worklet.ts). It detects the activity of each 10 ms frame
+ * as it is captured, so that silence doesn't need to reach the engine and its frames only need to
+ * be counted (see lipsyncengine_stream_push_activity()).
+ * The module is standalone: it imports nothing the worklet has to provide and allocates nothing,
+ * as the worklet copies each frame into the buffer of lipsyncengine_vad_frame().
+ */
+
+#include <stdint.h>
+#include <webrtc/common_audio/vad/include/webrtc_vad.h>
+#include <webrtc/common_audio/vad/vad_core.h>
+
+#define LIPSYNCENGINE_EXPORT __attribute__((used, visibility("default")))
+
+/* The samples of 10 ms at 48 kHz, the highest rate WebRtcVad_Process() accepts */
+static int16_t frame[480];
+
+/* The same aggressiveness as VoiceActivityDetector */
+static const int aggressiveness = 2;
+
+/* Buffer of the frame to process, which holds up to 480 samples */
+LIPSYNCENGINE_EXPORT int16_t* lipsyncengine_vad_frame(void) {
+	return frame;
+}
+
+/* Create a detector, or return NULL on failure */
+LIPSYNCENGINE_EXPORT VadInst* lipsyncengine_vad_create(void) {
+	VadInst* vad = WebRtcVad_Create();
+	if (!vad) return NULL;
+	if (WebRtcVad_Init(vad) != 0 || WebRtcVad_set_mode(vad, aggressiveness) != 0) {
+		WebRtcVad_Free(vad);
+		return NULL;
+	}
+	return vad;
+}
+
+/*
+ * Detect the activity of the 10 ms frame in the frame buffer, of 80, 160, 320 or 480 samples at
+ * 8, 16, 32 or 48 kHz. Returns 1 for voice, 0 for none and -1 for an invalid frame.
+ * Like VoiceActivityDetector, this reads the detector's own flag rather than the result of
+ * WebRtcVad_Process(), which stays 1 for a number of frames after the last voice.
+ */
+LIPSYNCENGINE_EXPORT int32_t lipsyncengine_vad_process(VadInst* vad, int32_t sample_rate, int32_t sample_count) {
+	if (WebRtcVad_Process(vad, sample_rate, frame, (size_t) sample_count) < 0) return -1;
+	return ((VadInstT*) vad)->vad == 1 ? 1 : 0;
+}
+
+/* Free a detector */
+LIPSYNCENGINE_EXPORT void lipsyncengine_vad_free(VadInst* vad) {
+	WebRtcVad_Free(vad);
+}
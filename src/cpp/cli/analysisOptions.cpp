@@ -0,0 +1,67 @@
+#include "analysisOptions.h"
+#include "core/Shape.h"
+#include <format.h>
+#include <stdexcept>
+#include <utility>
+
+using std::string;
+using std::invalid_argument;
+
+namespace {
+
+	template<typename TValue, size_t Size>
+	TValue parseName(const string& name, const std::pair<const char*, TValue> (&values)[Size], const char* optionName) {
+		for (const auto& value : values) {
+			if (name == value.first) return value.second;
+		}
+		throw invalid_argument(fmt::format("Unknown {} \"{}\".", optionName, name));
+	}
+
+	// All basic shapes are mandatory; extended shapes are given by their names, such as "GHX"
+	ShapeSet getTargetShapeSet(const string& extendedShapesString) {
+		ShapeSet result(ShapeConverter::get().getBasicShapes());
+		for (char ch : extendedShapesString) {
+			const Shape shape = ShapeConverter::get().parse(string(1, ch));
+			result.insert(shape);
+		}
+		return result;
+	}
+
+}
+
+lipsyncengine_options getAnalysisOptions(
+	const string& recognizer,
+	const string& profile,
+	const string& dialogMode,
+	const string& extendedShapes
+) {
+	static const std::pair<const char*, int32_t> recognizers[] {
+		{ "pocketSphinx", LIPSYNCENGINE_RECOGNIZER_POCKETSPHINX },
+		{ "phonetic", LIPSYNCENGINE_RECOGNIZER_PHONETIC },
+		{ "classifier", LIPSYNCENGINE_RECOGNIZER_CLASSIFIER }
+	};
+	static const std::pair<const char*, int32_t> profiles[] {
+		{ "offline", LIPSYNCENGINE_PROFILE_OFFLINE },
+		{ "offlineOneBest", LIPSYNCENGINE_PROFILE_OFFLINE_ONE_BEST },
+		{ "balanced", LIPSYNCENGINE_PROFILE_BALANCED },
+		{ "realtime", LIPSYNCENGINE_PROFILE_REALTIME },
+		{ "realtimeDownsampled", LIPSYNCENGINE_PROFILE_REALTIME_DOWNSAMPLED },
+		{ "streaming", LIPSYNCENGINE_PROFILE_STREAMING }
+	};
+	static const std::pair<const char*, int32_t> dialogModes[] {
+		{ "biased", LIPSYNCENGINE_DIALOG_MODE_BIASED },
+		{ "strict", LIPSYNCENGINE_DIALOG_MODE_STRICT },
+		{ "verbatim", LIPSYNCENGINE_DIALOG_MODE_VERBATIM }
+	};
+
+	lipsyncengine_options options {};
+	try {
+		options.target_shapes = getTargetShapeSet(extendedShapes).getMask();
+	} catch (const std::exception&) {
+		throw invalid_argument(fmt::format("Invalid extended shapes \"{}\".", extendedShapes));
+	}
+	options.recognizer = parseName(recognizer, recognizers, "recognizer");
+	options.profile = parseName(profile, profiles, "profile");
+	options.dialog_mode = parseName(dialogMode, dialogModes, "dialog mode");
+	return options;
+}
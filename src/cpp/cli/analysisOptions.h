@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include "bridge/bridge.h"
+
+// Returns the options of an analysis given by the names used on the command line and by the
+// server, such as "pocketSphinx", "offline" and "biased". Extended shapes are given by their
+// names, such as "GHX"; all basic shapes are always used.
+// Throws std::invalid_argument for unknown names.
+lipsyncengine_options getAnalysisOptions(
+	const std::string& recognizer,
+	const std::string& profile,
+	const std::string& dialogMode,
+	const std::string& extendedShapes
+);
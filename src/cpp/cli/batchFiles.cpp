@@ -0,0 +1,128 @@
+#include "batchFiles.h"
+#include <algorithm>
+
+using std::string;
+using std::vector;
+using std::lock_guard;
+using std::unique_lock;
+using std::filesystem::path;
+using boost::optional;
+
+BatchReader::BatchReader(vector<path> files, read_function read, int threadCount, size_t maxQueuedCount) :
+	files(std::move(files)),
+	read(std::move(read)),
+	maxQueuedCount(std::max<size_t>(maxQueuedCount, 1))
+{
+	const size_t count = std::min(static_cast<size_t>(std::max(threadCount, 1)), this->files.size());
+	for (size_t i = 0; i < count; ++i) {
+		threads.emplace_back([this] { runThread(); });
+	}
+}
+
+BatchReader::~BatchReader() {
+	{
+		lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	queueChanged.notify_all();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+optional<BatchInput> BatchReader::next() {
+	unique_lock<std::mutex> lock(mutex);
+	queueChanged.wait(lock, [&] { return !queue.empty() || takenCount == files.size(); });
+	if (queue.empty()) return boost::none;
+
+	BatchInput input = std::move(queue.front());
+	queue.pop_front();
+	++takenCount;
+	lock.unlock();
+	queueChanged.notify_all();
+	return input;
+}
+
+void BatchReader::runThread() {
+	while (true) {
+		size_t fileIndex;
+		{
+			unique_lock<std::mutex> lock(mutex);
+			// Inputs being read count against the limit, too
+			queueChanged.wait(lock, [&] {
+				return stopping || nextFileIndex - takenCount < maxQueuedCount;
+			});
+			if (stopping || nextFileIndex == files.size()) return;
+			fileIndex = nextFileIndex++;
+		}
+
+		BatchInput input;
+		try {
+			input = read(files[fileIndex]);
+		} catch (...) {
+			input.error = std::current_exception();
+		}
+		input.file = files[fileIndex];
+
+		{
+			lock_guard<std::mutex> lock(mutex);
+			queue.push_back(std::move(input));
+		}
+		queueChanged.notify_all();
+	}
+}
+
+BatchWriter::BatchWriter(write_function write, error_handler handleError, size_t maxQueuedBytes) :
+	writeFile(std::move(write)),
+	handleError(std::move(handleError)),
+	maxQueuedBytes(maxQueuedBytes),
+	thread([this] { runThread(); })
+{}
+
+BatchWriter::~BatchWriter() {
+	{
+		lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	queueChanged.notify_all();
+	thread.join();
+}
+
+void BatchWriter::write(path file, string contents) {
+	{
+		unique_lock<std::mutex> lock(mutex);
+		// A single output larger than the limit is still queued once the queue is empty
+		queueChanged.wait(lock, [&] {
+			return queue.empty() || queuedBytes + contents.size() <= maxQueuedBytes;
+		});
+		queuedBytes += contents.size();
+		queue.emplace_back(std::move(file), std::move(contents));
+	}
+	queueChanged.notify_all();
+}
+
+void BatchWriter::runThread() {
+	while (true) {
+		std::pair<path, string> output;
+		{
+			unique_lock<std::mutex> lock(mutex);
+			queueChanged.wait(lock, [&] { return stopping || !queue.empty(); });
+			// Stopping still writes the queued outputs
+			if (queue.empty()) return;
+			output = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		try {
+			writeFile(output.first, output.second);
+		} catch (const std::exception& e) {
+			handleError(output.first, e);
+		}
+
+		{
+			lock_guard<std::mutex> lock(mutex);
+			queuedBytes -= output.second.size();
+		}
+		queueChanged.notify_all();
+	}
+}
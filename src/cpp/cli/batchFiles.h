@@ -0,0 +1,89 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <compat/boost_compat.h>
+#include "cli/waveFiles.h"
+
+// An input file of a batch with its decoded audio and dialog
+struct BatchInput {
+	std::filesystem::path file;
+	Pcm16Audio audio;
+	boost::optional<std::string> dialog;
+	// Set if reading the input failed
+	std::exception_ptr error;
+};
+
+// Reads and decodes the input files of a batch on threads of its own, ahead of the threads that
+// analyze them, so that these don't wait for the disk. Several files are read at once to hide the
+// latency of the disk and of opening files. At most maxQueuedCount inputs wait to be taken.
+class BatchReader {
+public:
+	using read_function = std::function<BatchInput(const std::filesystem::path&)>;
+
+	BatchReader(
+		std::vector<std::filesystem::path> files, read_function read, int threadCount, size_t maxQueuedCount);
+	~BatchReader();
+	BatchReader(const BatchReader&) = delete;
+	BatchReader& operator=(const BatchReader&) = delete;
+
+	// Takes the next input that was read, waiting for one if needed.
+	// Returns none once all inputs have been taken.
+	boost::optional<BatchInput> next();
+
+private:
+	void runThread();
+
+	const std::vector<std::filesystem::path> files;
+	const read_function read;
+	const size_t maxQueuedCount;
+
+	std::mutex mutex;
+	// Signaled when an input is queued or taken, or reading stops
+	std::condition_variable queueChanged;
+	std::deque<BatchInput> queue;
+	size_t nextFileIndex = 0;
+	size_t takenCount = 0;
+	bool stopping = false;
+	std::vector<std::thread> threads;
+};
+
+// Writes the output files of a batch on a thread of its own, so that the threads analyzing it go
+// on while earlier outputs are written. Up to maxQueuedBytes of outputs wait to be written.
+class BatchWriter {
+public:
+	using write_function = std::function<void(const std::filesystem::path&, const std::string&)>;
+	// Called on the writer's thread for each output that couldn't be written
+	using error_handler = std::function<void(const std::filesystem::path&, const std::exception&)>;
+
+	BatchWriter(write_function write, error_handler handleError, size_t maxQueuedBytes);
+	// Waits for the queued outputs to be written
+	~BatchWriter();
+	BatchWriter(const BatchWriter&) = delete;
+	BatchWriter& operator=(const BatchWriter&) = delete;
+
+	// Queues an output file, waiting while the queued outputs exceed maxQueuedBytes
+	void write(std::filesystem::path file, std::string contents);
+
+private:
+	void runThread();
+
+	const write_function writeFile;
+	const error_handler handleError;
+	const size_t maxQueuedBytes;
+
+	std::mutex mutex;
+	// Signaled when an output is queued or written, or writing stops
+	std::condition_variable queueChanged;
+	std::deque<std::pair<std::filesystem::path, std::string>> queue;
+	size_t queuedBytes = 0;
+	bool stopping = false;
+	std::thread thread;
+};
@@ -0,0 +1,502 @@
+// Native command-line interface for batch processing.
+// Analyzes WAVE files through the same C API that the WASM module exports.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <tclap/CmdLine.h>
+#include <format.h>
+#include "bridge/bridge.h"
+#include "cli/waveFiles.h"
+#include "cli/batchFiles.h"
+#include "cli/analysisOptions.h"
+#include "cli/resultCache.h"
+#include "core/appInfo.h"
+#include "audio/Timebase.h"
+#include "core/Shape.h"
+#include "exporters/CompactExporter.h"
+#include "tools/NiceCmdLineOutput.h"
+#include "tools/platformTools.h"
+#include "tools/stringTools.h"
+#include "tools/textFiles.h"
+#include "tools/TablePrinter.h"
+#include "tools/AnalysisStats.h"
+#include "tools/exceptions.h"
+#include "tools/parallel.h"
+#include "tools/tools.h"
+#include <compat/boost_compat.h>
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+using std::filesystem::path;
+using boost::optional;
+
+namespace {
+
+	// Seconds of audio pushed to a streaming session at a time
+	constexpr int streamBlockSeconds = 1;
+
+	// Files of a batch read at once, which hides the latency of the disk behind each other
+	constexpr int batchReaderThreadCount = 4;
+	// Output bytes of a batch waiting to be written
+	constexpr size_t batchWriterQueueBytes = 64 * 1024 * 1024;
+
+	// Returns the bridge's error message for the last failed call
+	string getLastError(const string& fallback) {
+		const char* error = lipsyncengine_get_last_error();
+		return error && *error ? string(error) : fallback;
+	}
+
+	// Formats the stats of an analysis as a table
+	string formatStats(const path& inputFile, const lipsyncengine_stats& stats) {
+		std::ostringstream stream;
+		stream << fmt::format("Stats for {}:\n", inputFile.u8string());
+		const TablePrinter table(&stream, { 26, 12 });
+		for (int stage = 0; stage < LIPSYNCENGINE_STAGE_COUNT; ++stage) {
+			table.printRow({
+				AnalysisStageConverter::get().toString(static_cast<AnalysisStage>(stage)),
+				fmt::format("{:.1f} ms", stats.stage_milliseconds[stage])
+			});
+		}
+		table.printRow({ "total", fmt::format("{:.1f} ms", stats.total_milliseconds) });
+		table.printRow({ "utterances", fmt::format("{}", stats.utterance_count) });
+		table.printRow({ "frames", fmt::format("{}", stats.frame_count) });
+		table.printRow({ "HMMs per frame", fmt::format("{:.0f}",
+			stats.frame_count > 0 ? stats.hmm_evaluation_count / stats.frame_count : 0.0) });
+		table.printRow({ "decoder cache hits", fmt::format("{} of {}",
+			stats.decoder_cache_hits, stats.decoder_cache_hits + stats.decoder_cache_misses) });
+		table.printRow({ "dialog model cache hits", fmt::format("{} of {}",
+			stats.dialog_model_cache_hits, stats.dialog_model_cache_hits + stats.dialog_model_cache_misses) });
+		table.printRow({ "utterance cache hits", fmt::format("{} of {}",
+			stats.utterance_cache_hits, stats.utterance_cache_hits + stats.utterance_cache_misses) });
+		return stream.str();
+	}
+
+	// The sound file in the metadata of a file's JSON, as JsonExporter writes it
+	string getSoundFile(const path& inputFile) {
+		return escapeJsonString(std::filesystem::absolute(inputFile).u8string());
+	}
+
+	// Replaces the sound file in the metadata of an analysis's JSON, which the C API gives as that of
+	// analyses from memory, with the input file
+	string setSoundFile(string json, const path& inputFile) {
+		const string key = "\"soundFile\": \"";
+		const string memorySoundFile = getSoundFile("memory://pcm");
+		const size_t start = json.find(key);
+		if (start == string::npos || json.compare(start + key.size(), memorySoundFile.size(), memorySoundFile) != 0) {
+			throw runtime_error("Invalid analysis result.");
+		}
+		json.replace(start + key.size(), memorySoundFile.size(), getSoundFile(inputFile));
+		return json;
+	}
+
+	// Analyzes the audio of a file, returning the animation as JSON or, if compact is set, in the
+	// compact binary format. With a cache, returns the stored output of identical analyses instead.
+	string analyzeAudio(
+		const path& inputFile,
+		const Pcm16Audio& audio,
+		const optional<string>& dialog,
+		lipsyncengine_options options,
+		bool compact,
+		bool printStats,
+		ResultCache* cache,
+		const path& modelDirectory
+	) {
+		if (audio.samples.empty()) {
+			throw runtime_error(fmt::format("File {} contains no samples.", inputFile.u8string()));
+		}
+
+		string cacheKey;
+		if (cache) {
+			cacheKey = ResultCache::getKey(audio, dialog, options, compact ? "compact" : "json", modelDirectory);
+			if (optional<string> cached = cache->get(cacheKey)) {
+				return compact ? std::move(*cached) : setSoundFile(std::move(*cached), inputFile);
+			}
+		}
+
+		lipsyncengine_stats stats {};
+		if (printStats) {
+			options.stats = &stats;
+		}
+		string result;
+		if (compact) {
+			int32_t cueCount = 0;
+			const lipsyncengine_mouth_cue* cues = lipsyncengine_analyze_pcm16_binary(
+				audio.samples.data(),
+				static_cast<int32_t>(audio.samples.size()),
+				audio.sampleRate,
+				dialog ? dialog->c_str() : nullptr,
+				&options,
+				&cueCount);
+			if (!cues) {
+				throw runtime_error(getLastError("Analysis failed."));
+			}
+			const lambda_unique_ptr<const lipsyncengine_mouth_cue> cuesGuard(
+				cues, [](const lipsyncengine_mouth_cue* p) { lipsyncengine_free(p); });
+			int32_t byteCount = 0;
+			const uint8_t* bytes = lipsyncengine_encode_cues(
+				cues, cueCount, CompactExporter::defaultSeekInterval, &byteCount);
+			if (!bytes) {
+				throw runtime_error(getLastError("Encoding failed."));
+			}
+			const lambda_unique_ptr<const uint8_t> bytesGuard(bytes, [](const uint8_t* p) { lipsyncengine_free(p); });
+			result.assign(reinterpret_cast<const char*>(bytes), byteCount);
+		} else {
+			const char* json = lipsyncengine_analyze_pcm16(
+				audio.samples.data(),
+				static_cast<int32_t>(audio.samples.size()),
+				audio.sampleRate,
+				dialog ? dialog->c_str() : nullptr,
+				&options);
+			if (!json) {
+				throw runtime_error(getLastError("Analysis failed."));
+			}
+			const lambda_unique_ptr<const char> jsonGuard(json, [](const char* p) { lipsyncengine_free(p); });
+			result = json;
+		}
+		if (printStats) {
+			std::cerr << formatStats(inputFile, stats);
+		}
+		// The cache holds the JSON of the C API, which doesn't depend on the file's path
+		if (cache) {
+			cache->set(cacheKey, result);
+		}
+		return compact ? result : setSoundFile(std::move(result), inputFile);
+	}
+
+	// Returns the mouth cues of a streaming session's result as the lines of its "mouthCues" array,
+	// which have the cue format of an analysis's JSON
+	string getMouthCueLines(const string& json) {
+		const string key = "\"mouthCues\": [";
+		const size_t start = json.find(key);
+		if (start == string::npos) {
+			throw runtime_error("Invalid stream result.");
+		}
+		const size_t cuesStart = json.find_first_not_of('\n', start + key.size());
+		const size_t cuesEnd = json.find(']', cuesStart);
+		return json.substr(cuesStart, json.find_last_not_of(" \n", cuesEnd - 1) + 1 - cuesStart);
+	}
+
+	// Analyzes a file as a streaming session, writing the same JSON as analyzeAudio() to output.
+	// The file is read block by block, and each block's finalized mouth cues are written before the
+	// next is read, so memory use stays that of the session's current utterance however long the
+	// recording is.
+	void streamFile(
+		const path& inputFile,
+		const optional<string>& dialog,
+		const lipsyncengine_options& options,
+		std::ostream& output
+	) {
+		WaveFileReader reader(inputFile);
+		if (reader.getSampleCount() == 0) {
+			throw runtime_error(fmt::format("File {} contains no samples.", inputFile.u8string()));
+		}
+
+		const int32_t stream = lipsyncengine_stream_begin(
+			reader.getSampleRate(), dialog ? dialog->c_str() : nullptr, &options);
+		if (stream < 0) {
+			throw runtime_error(getLastError("Analysis failed."));
+		}
+		bool ended = false;
+		auto endStream = [&] {
+			ended = true;
+			const char* json = lipsyncengine_stream_end(stream);
+			if (!json) {
+				throw runtime_error(getLastError("Analysis failed."));
+			}
+			const lambda_unique_ptr<const char> jsonGuard(json, [](const char* p) { lipsyncengine_free(p); });
+			return getMouthCueLines(json);
+		};
+
+		// The duration is known from the header, so the metadata can come first.
+		const centiseconds duration = Timebase(reader.getSampleRate())
+			.getTruncatedRange(static_cast<int64_t>(reader.getSampleCount())).getEnd();
+		output << "{\n"
+			<< "  \"metadata\": {\n"
+			<< "    \"soundFile\": \"" << getSoundFile(inputFile) << "\",\n"
+			<< "    \"duration\": " << formatDuration(duration) << "\n"
+			<< "  },\n"
+			<< "  \"mouthCues\": [\n";
+		bool isFirst = true;
+		auto writeCues = [&](const string& cueLines) {
+			if (cueLines.empty()) return;
+			output << (isFirst ? "" : ",\n") << cueLines;
+			output.flush();
+			isFirst = false;
+		};
+
+		try {
+			vector<int16_t> block;
+			for (reader.read(streamBlockSeconds * reader.getSampleRate(), block); !block.empty();
+				reader.read(streamBlockSeconds * reader.getSampleRate(), block))
+			{
+				if (lipsyncengine_stream_push(stream, block.data(), static_cast<int32_t>(block.size())) != 0) {
+					throw runtime_error(getLastError("Analysis failed."));
+				}
+				const char* json = lipsyncengine_stream_poll(stream);
+				if (!json) {
+					throw runtime_error(getLastError("Analysis failed."));
+				}
+				const lambda_unique_ptr<const char> jsonGuard(json, [](const char* p) { lipsyncengine_free(p); });
+				writeCues(getMouthCueLines(json));
+			}
+			writeCues(endStream());
+		} catch (...) {
+			if (!ended) {
+				lipsyncengine_free(lipsyncengine_stream_end(stream));
+			}
+			throw;
+		}
+
+		if (isFirst) {
+			// Make sure there is at least one mouth shape, like JsonExporter
+			output << "    { \"start\": 0.00, \"end\": 0.00, \"value\": \"X\" }";
+		}
+		output << "\n  ]\n}\n";
+		output.flush();
+	}
+
+	void writeOutputFile(const path& outputFile, const string& output) {
+		std::ofstream file;
+		file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+		try {
+			file.open(outputFile, std::ios::binary);
+			file << output;
+		} catch (...) {
+			std::throw_with_nested(runtime_error(fmt::format("Error writing file {}.", outputFile.u8string())));
+		}
+	}
+
+}
+
+int main(int platformArgc, char* platformArgv[]) {
+	NiceCmdLineOutput cmdLineOutput;
+	TCLAP::CmdLine cmd(appName, ' ', appVersion);
+	cmd.setOutput(&cmdLineOutput);
+	cmd.setExceptionHandling(false);
+
+	TCLAP::ValueArg<string> modelDirectory(
+		"", "models", "The directory containing the speech recognition models. "
+		"Defaults to res/sphinx next to the executable.",
+		false, string(), "path", cmd);
+	TCLAP::ValueArg<int> threadCount(
+		"", "threads", "The maximum number of worker threads to use.",
+		false, 0, "number", cmd);
+	vector<string> recognizerNames { "pocketSphinx", "phonetic", "classifier" };
+	TCLAP::ValuesConstraint<string> recognizerConstraint(recognizerNames);
+	TCLAP::ValueArg<string> recognizer(
+		"r", "recognizer", "The speech recognizer to use. \"phonetic\" is faster but less accurate, "
+		"and ignores the dialog. \"classifier\" is faster still, but only gets the mouth shapes right.",
+		false, "pocketSphinx", &recognizerConstraint, cmd);
+	vector<string> profileNames { "offline", "offlineOneBest", "balanced", "realtime", "realtimeDownsampled", "streaming" };
+	TCLAP::ValuesConstraint<string> profileConstraint(profileNames);
+	TCLAP::ValueArg<string> profile(
+		"", "profile", "The decoder profile of the pocketSphinx recognizer, trading accuracy for speed.",
+		false, "offline", &profileConstraint, cmd);
+	vector<string> dialogModeNames { "biased", "strict", "verbatim" };
+	TCLAP::ValuesConstraint<string> dialogModeConstraint(dialogModeNames);
+	TCLAP::ValueArg<string> dialogMode(
+		"", "dialogMode", "How the dialog constrains the pocketSphinx recognizer. \"biased\" favors its words, "
+		"\"strict\" recognizes only its words, which is much faster for scripted lines, and \"verbatim\" "
+		"aligns the dialog as spoken without recognizing words.",
+		false, "biased", &dialogModeConstraint, cmd);
+	TCLAP::ValueArg<string> extendedShapes(
+		"", "extendedShapes", "All extended, optional shapes to use, such as \"GHX\". "
+		"Defaults to the basic shapes A-F only.",
+		false, string(), "string", cmd);
+	vector<string> exportFormatNames { "json", "compact" };
+	TCLAP::ValuesConstraint<string> exportFormatConstraint(exportFormatNames);
+	TCLAP::ValueArg<string> exportFormat(
+		"f", "exportFormat", "The export format. \"compact\" writes a binary .lsc file of a few bytes "
+		"per mouth cue, for storage and network transfer.",
+		false, "json", &exportFormatConstraint, cmd);
+	TCLAP::ValueArg<string> cacheDirectory(
+		"", "cache", "A directory of the outputs of earlier analyses. Files whose audio, dialog and "
+		"options were analyzed before aren't analyzed again.",
+		false, string(), "path", cmd);
+	TCLAP::SwitchArg streamAudio(
+		"", "stream", "Read the file block by block and write the mouth cues as they are finalized, "
+		"so that recordings of any length take little memory. Utterances are detected as in streaming "
+		"sessions, which may differ slightly from analyzing the whole file. Requires a single input "
+		"file and the JSON format, and doesn't support --cache or --stats.",
+		cmd, false);
+	TCLAP::ValueArg<double> maxRealTimeFactor(
+		"", "maxRealTimeFactor", "With --stream, keep recognition under this many seconds per second "
+		"of speech by switching to cheaper recognition while it is slower, and back once it is fast "
+		"enough again. Switches are logged at the info level.",
+		false, 0.0, "number", cmd);
+	TCLAP::SwitchArg printStats(
+		"", "stats", "Print the time spent in each stage of the analysis and other counters to stderr.",
+		cmd, false);
+	TCLAP::ValueArg<string> dialogFile(
+		"d", "dialogFile", "A file containing the text of the dialog. Requires a single input file.",
+		false, string(), "path", cmd);
+	TCLAP::SwitchArg sidecarDialogs(
+		"", "sidecarDialogs", "Read each input file's dialog from a .txt file with the same name, if present.",
+		cmd, false);
+	TCLAP::ValueArg<string> outputFile(
+		"o", "output", "The output file. Requires a single input file.",
+		false, string(), "path", cmd);
+	TCLAP::ValueArg<string> outputDirectory(
+		"", "outputDir", "The directory for the output files. "
+		"Defaults to the directory of each input file, or to stdout for a single input file.",
+		false, string(), "path", cmd);
+	TCLAP::UnlabeledMultiArg<string> inputFiles(
+		"inputFiles", "The WAVE files to process.", true, "input files", cmd);
+
+	try {
+		cmd.parse(platformArgc, platformArgv);
+	} catch (TCLAP::ArgException& e) {
+		cmdLineOutput.failure(cmd, e);
+		return 1;
+	} catch (const TCLAP::ExitException& e) {
+		return e.getExitStatus();
+	}
+
+	try {
+		const vector<string>& inputs = inputFiles.getValue();
+		const bool isBatch = inputs.size() > 1;
+		if (isBatch && (dialogFile.isSet() || outputFile.isSet())) {
+			throw std::invalid_argument("--dialogFile and --output require a single input file.");
+		}
+		if (streamAudio.getValue() && (isBatch || exportFormat.getValue() != "json"
+			|| cacheDirectory.isSet() || printStats.getValue()))
+		{
+			throw std::invalid_argument(
+				"--stream requires a single input file and the JSON format, and doesn't support --cache or --stats.");
+		}
+		if (maxRealTimeFactor.isSet() && (!streamAudio.getValue() || !(maxRealTimeFactor.getValue() > 0))) {
+			throw std::invalid_argument("--maxRealTimeFactor requires --stream and must be positive.");
+		}
+		if (threadCount.isSet() && threadCount.getValue() < 1) {
+			throw std::invalid_argument(fmt::format("Thread count must be 1 or higher; got {}.", threadCount.getValue()));
+		}
+		const int maxThreadCount = threadCount.isSet() ? threadCount.getValue() : getProcessorCoreCount();
+		const bool compact = exportFormat.getValue() == "compact";
+
+		lipsyncengine_options options = getAnalysisOptions(
+			recognizer.getValue(), profile.getValue(), dialogMode.getValue(), extendedShapes.getValue());
+		options.max_real_time_factor = static_cast<float>(maxRealTimeFactor.getValue());
+
+		const path models = modelDirectory.isSet()
+			? path(modelDirectory.getValue())
+			: getBinDirectory() / "res" / "sphinx";
+		if (!exists(models / "acoustic-model")) {
+			throw runtime_error(fmt::format("No speech recognition models found in {}.", models.u8string()));
+		}
+		if (lipsyncengine_init(models.u8string().c_str()) != 0) {
+			throw runtime_error(getLastError("Initialization failed."));
+		}
+
+		// The utterances of a single file are recognized in parallel.
+		// In a batch, files are processed in parallel instead, each on a single thread.
+		lipsyncengine_set_max_thread_count(isBatch ? 1 : maxThreadCount);
+
+		if (outputDirectory.isSet()) {
+			create_directories(path(outputDirectory.getValue()));
+		}
+		optional<ResultCache> cache;
+		if (cacheDirectory.isSet()) {
+			cache.emplace(path(cacheDirectory.getValue()));
+		}
+
+		auto readDialog = [&](const path& inputFile) {
+			optional<string> dialog;
+			const path sidecarFile = path(inputFile).replace_extension(".txt");
+			if (dialogFile.isSet()) {
+				dialog = readUtf8File(dialogFile.getValue());
+			} else if (sidecarDialogs.getValue() && exists(sidecarFile)) {
+				dialog = readUtf8File(sidecarFile);
+			}
+			return dialog;
+		};
+		auto getOutputFile = [&](const path& inputFile) {
+			path output = outputFile.isSet() ? path(outputFile.getValue())
+				: outputDirectory.isSet() ? path(outputDirectory.getValue()) / inputFile.filename()
+				: inputFile;
+			if (!outputFile.isSet()) output.replace_extension(compact ? ".lsc" : ".json");
+			return output;
+		};
+
+		std::atomic<int> failedCount(0);
+		auto reportError = [&](const path& file, const std::exception& e) {
+			++failedCount;
+			std::cerr << fmt::format("Error processing {}: {}\n", file.u8string(), getMessage(e));
+		};
+
+		if (isBatch) {
+			// Files are read and decoded ahead of the analysis threads, and their outputs written
+			// behind them, so that these keep every core busy instead of waiting for the disk
+			BatchReader reader(
+				vector<path>(inputs.begin(), inputs.end()),
+				[&](const path& inputFile) {
+					BatchInput input;
+					input.dialog = readDialog(inputFile);
+					input.audio = readWaveFile(inputFile);
+					return input;
+				},
+				batchReaderThreadCount,
+				2 * static_cast<size_t>(maxThreadCount));
+			BatchWriter writer(writeOutputFile, reportError, batchWriterQueueBytes);
+			const vector<std::function<void()>> tasks(maxThreadCount, [&] {
+				while (optional<BatchInput> input = reader.next()) {
+					const path inputFile = input->file;
+					try {
+						if (input->error) std::rethrow_exception(input->error);
+						string result = analyzeAudio(inputFile, input->audio, input->dialog, options, compact,
+							printStats.getValue(), cache ? &*cache : nullptr, models);
+						// Frees the audio before waiting for the writer
+						input.reset();
+						writer.write(getOutputFile(inputFile), std::move(result));
+					} catch (const std::exception& e) {
+						reportError(inputFile, e);
+					}
+				}
+			});
+			runTasksInParallel(tasks, maxThreadCount);
+		} else {
+			const path inputFile(inputs.front());
+			try {
+				const optional<string> dialog = readDialog(inputFile);
+				const bool toStdout = !outputFile.isSet() && !outputDirectory.isSet();
+				const path output = getOutputFile(inputFile);
+
+				if (streamAudio.getValue()) {
+					if (toStdout) {
+						streamFile(inputFile, dialog, options, std::cout);
+					} else {
+						std::ofstream file;
+						file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+						try {
+							file.open(output, std::ios::binary);
+						} catch (...) {
+							std::throw_with_nested(runtime_error(fmt::format("Error writing file {}.", output.u8string())));
+						}
+						streamFile(inputFile, dialog, options, file);
+					}
+				} else {
+					const string result = analyzeAudio(inputFile, readWaveFile(inputFile), dialog, options, compact,
+						printStats.getValue(), cache ? &*cache : nullptr, models);
+					if (toStdout) {
+						std::cout << result;
+					} else {
+						writeOutputFile(output, result);
+					}
+				}
+			} catch (const std::exception& e) {
+				reportError(inputFile, e);
+			}
+		}
+		if (cache && printStats.getValue()) {
+			std::cerr << fmt::format("Result cache: {} hits, {} misses\n", cache->getHitCount(), cache->getMissCount());
+		}
+
+		lipsyncengine_cleanup();
+		return failedCount > 0 ? 1 : 0;
+	} catch (const std::exception& e) {
+		std::cerr << getMessage(e) << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,78 @@
+#include "resultCache.h"
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <format.h>
+#include "core/appInfo.h"
+#include "tools/contentHash.h"
+
+using std::string;
+using std::filesystem::path;
+using boost::optional;
+
+ResultCache::ResultCache(const path& directory) :
+	directory(directory)
+{
+	create_directories(directory);
+}
+
+string ResultCache::getKey(
+	const Pcm16Audio& audio,
+	const optional<string>& dialog,
+	const lipsyncengine_options& options,
+	const string& exportFormat,
+	const path& modelDirectory
+) {
+	ContentHasher hasher;
+	hasher.add(audio.samples.data(), audio.samples.size() * sizeof(int16_t));
+	hasher.addValue(audio.sampleRate);
+	hasher.addValue(dialog.has_value());
+	hasher.add(dialog.value_or(string()));
+	hasher.addValue(options.target_shapes);
+	hasher.addValue(options.recognizer);
+	hasher.addValue(options.profile);
+	hasher.addValue(options.dialog_mode);
+	hasher.add(exportFormat);
+	hasher.add(appVersion);
+	hasher.add(absolute(modelDirectory).u8string());
+	if (exportFormat == "json") {
+		// The JSON names the sound file of analyses from memory by the working directory
+		hasher.add(std::filesystem::current_path().u8string());
+	}
+	return fmt::format("{:016x}-{}", hasher.get(), audio.samples.size());
+}
+
+optional<string> ResultCache::get(const string& key) {
+	std::ifstream file(directory / key, std::ios::binary);
+	if (!file) {
+		++missCount;
+		return boost::none;
+	}
+	std::ostringstream output;
+	output << file.rdbuf();
+	if (!file) {
+		++missCount;
+		return boost::none;
+	}
+	++hitCount;
+	return output.str();
+}
+
+void ResultCache::set(const string& key, const string& output) {
+	// Unique among the threads and processes sharing the directory
+	const path temporaryFile = directory / fmt::format("{}.{:08x}.tmp", key, std::random_device()());
+	{
+		std::ofstream file(temporaryFile, std::ios::binary);
+		file << output;
+		if (!file) {
+			std::error_code error;
+			remove(temporaryFile, error);
+			return;
+		}
+	}
+	std::error_code error;
+	rename(temporaryFile, directory / key, error);
+	if (error) {
+		remove(temporaryFile, error);
+	}
+}
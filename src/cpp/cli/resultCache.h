@@ -0,0 +1,42 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <atomic>
+#include <compat/boost_compat.h>
+#include "bridge/bridge.h"
+#include "cli/waveFiles.h"
+
+// Output files of earlier analyses in a directory, by a hash of their audio and everything else
+// that affects them. Lets pipelines that resubmit identical audio skip the analysis.
+// Safe to share between threads and processes: files are written under a temporary name and
+// then renamed.
+class ResultCache {
+public:
+	explicit ResultCache(const std::filesystem::path& directory);
+
+	// Returns the key of the output of an analysis.
+	// Covers the audio, the dialog, the options that affect the mouth cues, the export format, the
+	// models and the program version.
+	static std::string getKey(
+		const Pcm16Audio& audio,
+		const boost::optional<std::string>& dialog,
+		const lipsyncengine_options& options,
+		const std::string& exportFormat,
+		const std::filesystem::path& modelDirectory
+	);
+
+	// Returns the output stored for the key, if any
+	boost::optional<std::string> get(const std::string& key);
+
+	// Stores the output for the key. Failures only cost a later analysis.
+	void set(const std::string& key, const std::string& output);
+
+	int getHitCount() const { return hitCount; }
+	int getMissCount() const { return missCount; }
+
+private:
+	std::filesystem::path directory;
+	std::atomic<int> hitCount { 0 };
+	std::atomic<int> missCount { 0 };
+};
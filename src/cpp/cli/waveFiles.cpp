@@ -0,0 +1,141 @@
+#include "waveFiles.h"
+#include "audio/WaveAudioClip.h"
+#include "audio/processing.h"
+#include <format.h>
+#include <fstream>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+using std::vector;
+using std::runtime_error;
+using std::filesystem::path;
+
+namespace {
+
+	int16_t toInt16(float sample) {
+		return static_cast<int16_t>(std::clamp(std::lround(sample * 32768.0f), -32768L, 32767L));
+	}
+
+	uint32_t readUInt(const uint8_t* data, int byteCount) {
+		uint32_t result = 0;
+		for (int i = 0; i < byteCount; ++i) {
+			result |= static_cast<uint32_t>(data[i]) << (8 * i);
+		}
+		return result;
+	}
+
+}
+
+Pcm16Audio readWaveFile(const path& filePath) {
+	std::ifstream file(filePath, std::ios::binary);
+	if (!file) {
+		throw runtime_error(fmt::format("Could not open file {}.", filePath.u8string()));
+	}
+	// One read of the whole file rather than a stream iterator's byte by byte
+	auto bytes = std::make_shared<vector<uint8_t>>();
+	std::error_code error;
+	const auto fileSize = std::filesystem::file_size(filePath, error);
+	if (!error) {
+		bytes->resize(static_cast<size_t>(fileSize));
+		file.read(reinterpret_cast<char*>(bytes->data()), static_cast<std::streamsize>(bytes->size()));
+		bytes->resize(static_cast<size_t>(file.gcount()));
+	} else {
+		bytes->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	try {
+		const WaveAudioClip clip(std::shared_ptr<const uint8_t>(bytes, bytes->data()), bytes->size());
+
+		Pcm16Audio result;
+		result.sampleRate = clip.getSampleRate();
+		result.samples.resize(static_cast<size_t>(clip.size()));
+		forEachBlock(clip, 0, 4096, [&](AudioClip::size_type blockStart, gsl::span<const float> block) {
+			std::transform(block.begin(), block.end(), result.samples.begin() + blockStart, toInt16);
+		});
+		return result;
+	} catch (...) {
+		std::throw_with_nested(runtime_error(fmt::format("Error reading file {}.", filePath.u8string())));
+	}
+}
+
+WaveFileReader::WaveFileReader(const path& filePath) :
+	filePath(filePath),
+	file(filePath, std::ios::binary)
+{
+	if (!file) {
+		throw runtime_error(fmt::format("Could not open file {}.", filePath.u8string()));
+	}
+
+	try {
+		// Keeps the RIFF header and the format chunk, skipping the other chunks before the data
+		bytes.resize(12);
+		if (!file.read(reinterpret_cast<char*>(bytes.data()), 12)
+			|| std::memcmp(bytes.data(), "RIFF", 4) || std::memcmp(bytes.data() + 8, "WAVE", 4))
+		{
+			throw runtime_error("Not a WAVE file.");
+		}
+		int channelCount = 0;
+		int bytesPerSample = 0;
+		size_t dataSize = 0;
+		while (true) {
+			uint8_t chunkHeader[8];
+			if (!file.read(reinterpret_cast<char*>(chunkHeader), 8)) {
+				throw runtime_error("No audio data.");
+			}
+			const size_t chunkSize = readUInt(chunkHeader + 4, 4);
+			if (!std::memcmp(chunkHeader, "data", 4)) {
+				bytes.insert(bytes.end(), chunkHeader, chunkHeader + 8);
+				dataSize = chunkSize;
+				break;
+			}
+			if (std::memcmp(chunkHeader, "fmt ", 4)) {
+				file.seekg(static_cast<std::streamoff>(chunkSize + (chunkSize & 1)), std::ios::cur);
+				continue;
+			}
+			const size_t chunkStart = bytes.size() + 8;
+			bytes.insert(bytes.end(), chunkHeader, chunkHeader + 8);
+			bytes.resize(chunkStart + chunkSize + (chunkSize & 1));
+			if (chunkSize < 16 || !file.read(reinterpret_cast<char*>(&bytes[chunkStart]), bytes.size() - chunkStart)) {
+				throw runtime_error("Invalid format chunk.");
+			}
+			channelCount = static_cast<int>(readUInt(&bytes[chunkStart + 2], 2));
+			bytesPerSample = (static_cast<int>(readUInt(&bytes[chunkStart + 14], 2)) + 7) / 8;
+		}
+		headerSize = bytes.size();
+
+		// Checks the format on the header alone, whose data chunk is read as empty
+		const WaveAudioClip clip(std::shared_ptr<const uint8_t>(std::shared_ptr<void>(), bytes.data()), bytes.size());
+		sampleRate = clip.getSampleRate();
+		frameSize = static_cast<size_t>(channelCount) * bytesPerSample;
+
+		// A truncated data chunk is read as far as it goes
+		const size_t dataStart = static_cast<size_t>(file.tellg());
+		const size_t fileSize = static_cast<size_t>(std::filesystem::file_size(filePath));
+		remainingFrameCount = std::min(dataSize, fileSize - std::min(dataStart, fileSize)) / frameSize;
+		sampleCount = remainingFrameCount;
+	} catch (...) {
+		std::throw_with_nested(runtime_error(fmt::format("Error reading file {}.", filePath.u8string())));
+	}
+}
+
+void WaveFileReader::read(size_t maxCount, vector<int16_t>& samples) {
+	const size_t count = std::min(maxCount, remainingFrameCount);
+	samples.resize(count);
+	if (count == 0) return;
+
+	try {
+		bytes.resize(headerSize + count * frameSize);
+		if (!file.read(reinterpret_cast<char*>(&bytes[headerSize]), static_cast<std::streamsize>(count * frameSize))) {
+			throw runtime_error("Unexpected end of file.");
+		}
+		remainingFrameCount -= count;
+
+		const WaveAudioClip clip(std::shared_ptr<const uint8_t>(std::shared_ptr<void>(), bytes.data()), bytes.size());
+		block.resize(count);
+		clip.readBlock(0, static_cast<AudioClip::size_type>(count), block.data());
+		std::transform(block.begin(), block.end(), samples.begin(), toInt16);
+	} catch (...) {
+		std::throw_with_nested(runtime_error(fmt::format("Error reading file {}.", filePath.u8string())));
+	}
+}
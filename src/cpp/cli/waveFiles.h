@@ -0,0 +1,48 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <cstdint>
+
+// Mono 16-bit audio, as expected by the bridge API
+struct Pcm16Audio {
+	std::vector<int16_t> samples;
+	int sampleRate = 0;
+};
+
+// Reads a WAVE file with integer (8 to 32 bits) or 32-bit float samples.
+// Multiple channels are mixed down to mono.
+Pcm16Audio readWaveFile(const std::filesystem::path& filePath);
+
+// Reads a WAVE file like readWaveFile(), block by block, so that only its format and the current
+// block are held in memory however long the recording is
+class WaveFileReader {
+public:
+	explicit WaveFileReader(const std::filesystem::path& filePath);
+	int getSampleRate() const;
+	// The number of mono samples in the file
+	size_t getSampleCount() const;
+	// Reads up to maxCount of the next samples into samples, leaving it empty at the end of the file
+	void read(size_t maxCount, std::vector<int16_t>& samples);
+private:
+	std::filesystem::path filePath;
+	std::ifstream file;
+	// The bytes of a WAVE file with only the format chunk and the current block of samples, as
+	// decoded by WaveAudioClip
+	std::vector<uint8_t> bytes;
+	size_t headerSize = 0;
+	size_t frameSize = 0;
+	size_t remainingFrameCount = 0;
+	size_t sampleCount = 0;
+	int sampleRate = 0;
+	std::vector<float> block;
+};
+
+inline int WaveFileReader::getSampleRate() const {
+	return sampleRate;
+}
+
+inline size_t WaveFileReader::getSampleCount() const {
+	return sampleCount;
+}
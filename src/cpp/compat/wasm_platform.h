@@ -4,9 +4,14 @@
 #include <random>
 #include <sstream>
 #include <iomanip>
+#include <stdexcept>
+#ifndef __EMSCRIPTEN__
+#include <whereami.h>
+#endif
 
 // Platform compatibility layer for WASM
-// Provides stubs for platform-specific functionality
+// Provides stubs for platform-specific functionality.
+// Native builds use the actual location of the binary instead.
 
 namespace platform {
 
@@ -30,6 +35,8 @@ inline std::string generateUuid() {
 	return ss.str();
 }
 
+#ifdef __EMSCRIPTEN__
+
 // Get binary path (WASM virtual filesystem)
 inline std::string getBinPath() {
 	return "/wasm/lip-sync-engine.wasm";
@@ -40,6 +47,27 @@ inline std::string getBinDirectory() {
 	return "/wasm";
 }
 
+#else
+
+// Get binary path: the executable or shared library containing this code
+inline std::string getBinPath() {
+	const int length = wai_getModulePath(nullptr, 0, nullptr);
+	if (length <= 0) {
+		throw std::runtime_error("Error determining path of binary.");
+	}
+	std::string path(static_cast<size_t>(length), '\0');
+	wai_getModulePath(&path[0], length, nullptr);
+	return path;
+}
+
+// Get binary directory
+inline std::string getBinDirectory() {
+	const std::string path = getBinPath();
+	return path.substr(0, path.find_last_of("/\\"));
+}
+
+#endif
+
 // Get resources path (models directory in WASM virtual filesystem)
 inline std::string getResourcesPath() {
 	return "/models";
@@ -0,0 +1,118 @@
+#include "httpClient.h"
+#include <format.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <unistd.h>
+
+using std::string;
+using std::runtime_error;
+
+namespace {
+
+	// Closes a socket when it goes out of scope
+	class SocketGuard {
+	public:
+		explicit SocketGuard(int socket) : socket(socket) {}
+		~SocketGuard() { if (socket >= 0) close(socket); }
+		SocketGuard(const SocketGuard&) = delete;
+		SocketGuard& operator=(const SocketGuard&) = delete;
+	private:
+		int socket;
+	};
+
+	int connectTo(const HttpEndpoint& endpoint) {
+		addrinfo hints {};
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		addrinfo* addresses = nullptr;
+		const string service = std::to_string(endpoint.port);
+		if (const int error = getaddrinfo(endpoint.host.c_str(), service.c_str(), &hints, &addresses)) {
+			throw runtime_error(fmt::format("Could not resolve {}: {}", endpoint.host, gai_strerror(error)));
+		}
+		int result = -1;
+		string connectError = "no address";
+		for (addrinfo* address = addresses; address && result < 0; address = address->ai_next) {
+			const int candidate = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+			if (candidate < 0) continue;
+			if (connect(candidate, address->ai_addr, address->ai_addrlen) == 0) {
+				result = candidate;
+			} else {
+				connectError = std::strerror(errno);
+				close(candidate);
+			}
+		}
+		freeaddrinfo(addresses);
+		if (result < 0) {
+			throw runtime_error(fmt::format("Could not connect to {}: {}", endpoint.toString(), connectError));
+		}
+		return result;
+	}
+
+	void sendAll(int socket, const string& data) {
+		for (size_t offset = 0; offset < data.size();) {
+			const ssize_t count = send(socket, data.data() + offset, data.size() - offset, 0);
+			if (count < 0) {
+				if (errno == EINTR) continue;
+				throw runtime_error(fmt::format("Sending failed: {}", std::strerror(errno)));
+			}
+			offset += static_cast<size_t>(count);
+		}
+	}
+
+}
+
+HttpEndpoint HttpEndpoint::parse(const string& address) {
+	HttpEndpoint result;
+	const size_t colon = address.rfind(':');
+	result.host = address.substr(0, colon);
+	if (colon != string::npos) {
+		try {
+			result.port = std::stoi(address.substr(colon + 1));
+		} catch (const std::exception&) {
+			throw std::invalid_argument(fmt::format("Invalid port in {}.", address));
+		}
+	}
+	return result;
+}
+
+string HttpEndpoint::toString() const {
+	return fmt::format("{}:{}", host, port);
+}
+
+string httpPost(const HttpEndpoint& endpoint, const string& target, const string& contentType, const string& body) {
+	const int socket = connectTo(endpoint);
+	const SocketGuard guard(socket);
+	sendAll(socket, fmt::format(
+		"POST {} HTTP/1.1\r\nHost: {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n",
+		target, endpoint.toString(), contentType, body.size()));
+	sendAll(socket, body);
+
+	// The servers close the connection after the response, so it's read to the end
+	string response;
+	char buffer[64 * 1024];
+	while (true) {
+		const ssize_t count = recv(socket, buffer, sizeof buffer, 0);
+		if (count == 0) break;
+		if (count < 0) {
+			if (errno == EINTR) continue;
+			throw runtime_error(fmt::format("Receiving from {} failed: {}", endpoint.toString(), std::strerror(errno)));
+		}
+		response.append(buffer, static_cast<size_t>(count));
+	}
+
+	const size_t headerEnd = response.find("\r\n\r\n");
+	const size_t statusStart = response.find(' ');
+	if (headerEnd == string::npos || statusStart == string::npos || statusStart > headerEnd) {
+		throw runtime_error(fmt::format("Invalid response from {}.", endpoint.toString()));
+	}
+	const int status = std::atoi(response.c_str() + statusStart + 1);
+	string responseBody = response.substr(headerEnd + 4);
+	if (status != 200) {
+		while (!responseBody.empty() && responseBody.back() == '\n') responseBody.pop_back();
+		throw runtime_error(fmt::format("{} answered {}: {}", endpoint.toString(), status, responseBody));
+	}
+	return responseBody;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+// A server of the lip-sync engine, given as "host:port"
+struct HttpEndpoint {
+	std::string host;
+	int port = 80;
+
+	// Parses "host:port" or "host". Throws std::invalid_argument if the port isn't a number.
+	static HttpEndpoint parse(const std::string& address);
+	std::string toString() const;
+};
+
+// Posts a body to a path (including the query) on a server and returns the response body.
+// Throws if the connection fails or the response status isn't 200, with the response body as
+// the message for error statuses.
+std::string httpPost(
+	const HttpEndpoint& endpoint,
+	const std::string& target,
+	const std::string& contentType,
+	const std::string& body
+);
@@ -0,0 +1,286 @@
+// Coordinator for analyzing long recordings on several servers.
+// Splits a WAVE file at pauses, has lip-sync-engine-server nodes recognize the phones of the
+// segments in parallel, and animates the phones of the whole recording in one pass, so that the
+// animation has no seams where the segments meet.
+
+#include <iostream>
+#include <fstream>
+#include <deque>
+#include <set>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <tclap/CmdLine.h>
+#include <format.h>
+#include "cli/analysisOptions.h"
+#include "cli/waveFiles.h"
+#include "coordinator/httpClient.h"
+#include "coordinator/segmentation.h"
+#include "animation/mouthAnimation.h"
+#include "audio/Int16AudioClip.h"
+#include "core/appInfo.h"
+#include "exporters/CompactExporter.h"
+#include "exporters/JsonExporter.h"
+#include "recognition/recognizedPhones.h"
+#include "tools/NiceCmdLineOutput.h"
+#include "tools/exceptions.h"
+#include "tools/parallel.h"
+#include "tools/textFiles.h"
+#include "tools/tools.h"
+#include <compat/boost_compat.h>
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+using std::filesystem::path;
+using boost::optional;
+
+namespace {
+
+	// A segment of the recording and the phones a node recognized in it
+	struct Segment {
+		TimeRange range;
+		int attemptCount = 0;
+		optional<BoundedTimeline<Phone>> phones;
+		// Indexes of the nodes the segment failed on
+		std::set<size_t> failedNodes;
+	};
+
+	// Little-endian PCM16 bytes of samples
+	string toBytes(const int16_t* samples, size_t sampleCount) {
+		string result(sampleCount * 2, '\0');
+		for (size_t i = 0; i < sampleCount; ++i) {
+			const uint16_t sample = static_cast<uint16_t>(samples[i]);
+			result[2 * i] = static_cast<char>(sample & 0xFF);
+			result[2 * i + 1] = static_cast<char>(sample >> 8);
+		}
+		return result;
+	}
+
+	// Has the nodes recognize the segments, each taking the next segment as soon as it's done with
+	// one, so that faster nodes take more. A failed segment is retried, on whichever node it hasn't
+	// failed on is free first, until it failed maxAttemptCount times. Once it failed on every node,
+	// any node may retry it.
+	void recognizeSegments(
+		vector<Segment>& segments,
+		const Pcm16Audio& audio,
+		const vector<HttpEndpoint>& nodes,
+		int jobsPerNode,
+		int maxAttemptCount,
+		const string& query,
+		const string& dialog
+	) {
+		const Timebase timebase(audio.sampleRate);
+		std::mutex mutex;
+		// Signaled when a segment is done, re-queued or failed for good
+		std::condition_variable segmentsChanged;
+		std::deque<size_t> pendingSegments;
+		for (size_t i = 0; i < segments.size(); ++i) {
+			pendingSegments.push_back(i);
+		}
+		std::exception_ptr error;
+		size_t doneCount = 0;
+
+		// Each job waits for its node, so they run on threads of their own
+		vector<std::thread> threads;
+		for (size_t nodeIndex = 0; nodeIndex < nodes.size(); ++nodeIndex) {
+			for (int job = 0; job < jobsPerNode; ++job) {
+				threads.emplace_back([&, nodeIndex] {
+					const HttpEndpoint& node = nodes[nodeIndex];
+					// The first pending segment the node may take, if any
+					auto findSegment = [&] {
+						return std::find_if(pendingSegments.begin(), pendingSegments.end(), [&](size_t index) {
+							const std::set<size_t>& failedNodes = segments[index].failedNodes;
+							return !failedNodes.count(nodeIndex) || failedNodes.size() >= nodes.size();
+						});
+					};
+					while (true) {
+						size_t segmentIndex;
+						{
+							// Segments in flight on other nodes may fail and come back, so jobs only
+							// end once all segments are done
+							std::unique_lock<std::mutex> lock(mutex);
+							segmentsChanged.wait(lock, [&] {
+								return error || doneCount == segments.size() || findSegment() != pendingSegments.end();
+							});
+							if (error || doneCount == segments.size()) return;
+							const auto next = findSegment();
+							segmentIndex = *next;
+							pendingSegments.erase(next);
+						}
+						Segment& segment = segments[segmentIndex];
+						const int64_t start = timebase.toSampleIndex(segment.range.getStart());
+						const int64_t end = std::min<int64_t>(
+							timebase.toSampleIndex(segment.range.getEnd()), static_cast<int64_t>(audio.samples.size()));
+						try {
+							// The dialog precedes the audio in the body, as long scripts exceed the
+							// servers' header limit
+							const string phones = httpPost(
+								node,
+								fmt::format("/recognize?{}&dialogBytes={}", query, dialog.size()),
+								"application/octet-stream",
+								dialog + toBytes(audio.samples.data() + start, static_cast<size_t>(end - start)));
+							BoundedTimeline<Phone> segmentPhones = deserializePhones(gsl::span<const uint8_t>(
+								reinterpret_cast<const uint8_t*>(phones.data()), static_cast<std::ptrdiff_t>(phones.size())));
+							segmentPhones.shift(segment.range.getStart());
+
+							std::lock_guard<std::mutex> lock(mutex);
+							segment.phones = std::move(segmentPhones);
+							std::cerr << fmt::format("Recognized segment {} of {} on {}\n",
+								++doneCount, segments.size(), node.toString());
+							if (doneCount == segments.size()) segmentsChanged.notify_all();
+						} catch (const std::exception& e) {
+							std::lock_guard<std::mutex> lock(mutex);
+							std::cerr << fmt::format("Segment {} failed on {}: {}\n",
+								segmentIndex + 1, node.toString(), getMessage(e));
+							segment.failedNodes.insert(nodeIndex);
+							if (++segment.attemptCount >= maxAttemptCount) {
+								error = std::make_exception_ptr(runtime_error(fmt::format(
+									"Segment {} failed {} times.", segmentIndex + 1, segment.attemptCount)));
+							} else {
+								pendingSegments.push_back(segmentIndex);
+							}
+							segmentsChanged.notify_all();
+						}
+					}
+				});
+			}
+		}
+		for (std::thread& thread : threads) {
+			thread.join();
+		}
+		if (error) std::rethrow_exception(error);
+	}
+
+}
+
+int main(int platformArgc, char* platformArgv[]) {
+	NiceCmdLineOutput cmdLineOutput;
+	TCLAP::CmdLine cmd(appName, ' ', appVersion);
+	cmd.setOutput(&cmdLineOutput);
+	cmd.setExceptionHandling(false);
+
+	TCLAP::MultiArg<string> nodeAddresses(
+		"n", "node", "A lip-sync-engine-server to recognize segments on, as host:port. "
+		"Give several to spread the recording across them.",
+		true, "address", cmd);
+	TCLAP::ValueArg<int> jobsPerNode(
+		"", "jobsPerNode", "The number of segments each node recognizes at once.",
+		false, 2, "number", cmd);
+	TCLAP::ValueArg<double> segmentMinutes(
+		"", "segmentMinutes", "The duration of the segments in minutes. They are cut in the first "
+		"pause after this long, so there are more segments than nodes to balance the load.",
+		false, 5, "minutes", cmd);
+	TCLAP::ValueArg<int> attemptCount(
+		"", "attempts", "The number of times a segment is tried before the analysis fails.",
+		false, 3, "number", cmd);
+	vector<string> recognizerNames { "pocketSphinx", "phonetic", "classifier" };
+	TCLAP::ValuesConstraint<string> recognizerConstraint(recognizerNames);
+	TCLAP::ValueArg<string> recognizer(
+		"r", "recognizer", "The speech recognizer to use.",
+		false, "pocketSphinx", &recognizerConstraint, cmd);
+	vector<string> profileNames { "offline", "offlineOneBest", "balanced", "realtime", "realtimeDownsampled", "streaming" };
+	TCLAP::ValuesConstraint<string> profileConstraint(profileNames);
+	TCLAP::ValueArg<string> profile(
+		"", "profile", "The decoder profile of the pocketSphinx recognizer, trading accuracy for speed.",
+		false, "offline", &profileConstraint, cmd);
+	vector<string> dialogModeNames { "biased", "strict" };
+	TCLAP::ValuesConstraint<string> dialogModeConstraint(dialogModeNames);
+	TCLAP::ValueArg<string> dialogMode(
+		"", "dialogMode", "How the dialog constrains the pocketSphinx recognizer. Each segment is "
+		"recognized with the whole dialog, so it can't be aligned verbatim.",
+		false, "biased", &dialogModeConstraint, cmd);
+	TCLAP::ValueArg<string> extendedShapes(
+		"", "extendedShapes", "All extended, optional shapes to use, such as \"GHX\". "
+		"Defaults to the basic shapes A-F only.",
+		false, string(), "string", cmd);
+	vector<string> exportFormatNames { "json", "compact" };
+	TCLAP::ValuesConstraint<string> exportFormatConstraint(exportFormatNames);
+	TCLAP::ValueArg<string> exportFormat(
+		"f", "exportFormat", "The export format.",
+		false, "json", &exportFormatConstraint, cmd);
+	TCLAP::ValueArg<string> dialogFile(
+		"d", "dialogFile", "A file containing the text of the dialog.",
+		false, string(), "path", cmd);
+	TCLAP::ValueArg<string> outputFile(
+		"o", "output", "The output file. Defaults to stdout.",
+		false, string(), "path", cmd);
+	TCLAP::UnlabeledValueArg<string> inputFile(
+		"inputFile", "The WAVE file to process.", true, string(), "input file", cmd);
+
+	try {
+		cmd.parse(platformArgc, platformArgv);
+	} catch (TCLAP::ArgException& e) {
+		cmdLineOutput.failure(cmd, e);
+		return 1;
+	} catch (const TCLAP::ExitException& e) {
+		return e.getExitStatus();
+	}
+
+	try {
+		if (jobsPerNode.getValue() < 1 || attemptCount.getValue() < 1 || segmentMinutes.getValue() <= 0) {
+			throw std::invalid_argument("--jobsPerNode, --attempts and --segmentMinutes must be positive.");
+		}
+		vector<HttpEndpoint> nodes;
+		for (const string& address : nodeAddresses.getValue()) {
+			nodes.push_back(HttpEndpoint::parse(address));
+		}
+		const Pcm16Audio audio = readWaveFile(inputFile.getValue());
+		if (audio.samples.empty()) {
+			throw runtime_error(fmt::format("File {} contains no samples.", inputFile.getValue()));
+		}
+		string query = fmt::format("sampleRate={}&recognizer={}&profile={}&dialogMode={}",
+			audio.sampleRate, recognizer.getValue(), profile.getValue(), dialogMode.getValue());
+		const string dialog = dialogFile.isSet() ? readUtf8File(dialogFile.getValue()) : string();
+		const Int16AudioClip audioClip(
+			std::shared_ptr<const int16_t>(std::shared_ptr<void>(), audio.samples.data()),
+			static_cast<AudioClip::size_type>(audio.samples.size()),
+			audio.sampleRate);
+
+		// Pauses shorter than a second leave too little silence around the utterances they separate
+		const centiseconds targetDuration(static_cast<int>(segmentMinutes.getValue() * 60 * 100));
+		vector<Segment> segments;
+		for (const TimeRange& range : splitAtPauses(audioClip, targetDuration, 100_cs)) {
+			segments.push_back({ range, 0, boost::none, {} });
+		}
+		std::cerr << fmt::format("Recognizing {} segments on {} nodes\n", segments.size(), nodes.size());
+		recognizeSegments(segments, audio, nodes, jobsPerNode.getValue(), attemptCount.getValue(), query, dialog);
+
+		// The phones of all segments are animated together, as if recognized in one piece
+		BoundedTimeline<Phone> phones(audioClip.getTruncatedRange());
+		for (const Segment& segment : segments) {
+			for (const auto& timedPhone : *segment.phones) {
+				phones.set(timedPhone);
+			}
+		}
+		const ShapeSet targetShapeSet = ShapeSet::fromMask(
+			getAnalysisOptions(recognizer.getValue(), profile.getValue(), dialogMode.getValue(), extendedShapes.getValue())
+				.target_shapes);
+		const JoiningContinuousTimeline<Shape> animation = animate(phones, targetShapeSet, getProcessorCoreCount());
+
+		std::unique_ptr<Exporter> exporter;
+		if (exportFormat.getValue() == "compact") {
+			exporter = std::make_unique<CompactExporter>();
+		} else {
+			exporter = std::make_unique<JsonExporter>();
+		}
+		const ExporterInput exporterInput(inputFile.getValue(), animation, targetShapeSet);
+		if (outputFile.isSet()) {
+			std::ofstream file;
+			file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+			try {
+				file.open(outputFile.getValue(), std::ios::binary);
+				exporter->exportAnimation(exporterInput, file);
+			} catch (...) {
+				std::throw_with_nested(runtime_error(fmt::format("Error writing file {}.", outputFile.getValue())));
+			}
+		} else {
+			exporter->exportAnimation(exporterInput, std::cout);
+		}
+		return 0;
+	} catch (const std::exception& e) {
+		std::cerr << getMessage(e) << std::endl;
+		return 1;
+	}
+}
@@ -0,0 +1,37 @@
+#include "segmentation.h"
+#include "audio/voiceActivityDetection.h"
+#include "audio/SampleRateConverter.h"
+#include "audio/DcOffset.h"
+#include "recognition/pocketSphinxTools.h"
+#include "tools/progress.h"
+
+using std::vector;
+
+vector<TimeRange> splitAtPauses(
+	const AudioClip& audioClip,
+	centiseconds targetDuration,
+	centiseconds minPauseDuration
+) {
+	// Utterances are detected as for recognition
+	const std::unique_ptr<AudioClip> preparedClip = audioClip.clone()
+		| resample(sphinxSampleRate)
+		| removeDcOffsetTo16bit();
+	NullProgressSink progressSink;
+	const JoiningBoundedTimeline<void> utterances = detectVoiceActivity(*preparedClip, progressSink);
+
+	const TimeRange clipRange = audioClip.getTruncatedRange();
+	vector<TimeRange> segments;
+	centiseconds segmentStart = clipRange.getStart();
+	for (auto it = utterances.begin(); it != utterances.end(); ++it) {
+		const auto next = std::next(it);
+		if (next == utterances.end()) break;
+
+		const TimeRange pause(it->getEnd(), next->getStart());
+		if (pause.getMiddle() - segmentStart >= targetDuration && pause.getDuration() >= minPauseDuration) {
+			segments.emplace_back(segmentStart, pause.getMiddle());
+			segmentStart = pause.getMiddle();
+		}
+	}
+	segments.emplace_back(segmentStart, clipRange.getEnd());
+	return segments;
+}
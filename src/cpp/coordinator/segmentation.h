@@ -0,0 +1,15 @@
+#pragma once
+
+#include "audio/AudioClip.h"
+#include "time/TimeRange.h"
+#include <vector>
+
+// Splits a clip into consecutive segments of about the given duration, cutting in the middle of
+// pauses between utterances, so that each segment's utterances are recognized as they would be in
+// the whole clip. Pauses shorter than minPauseDuration aren't cut, so segments may be longer.
+// The segments cover the clip's whole truncated range.
+std::vector<TimeRange> splitAtPauses(
+	const AudioClip& audioClip,
+	centiseconds targetDuration,
+	centiseconds minPauseDuration
+);
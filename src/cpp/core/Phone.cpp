@@ -1,8 +1,28 @@
 #include "Phone.h"
+#include <array>
 
 using std::string;
 using boost::optional;
 
+// Phone names in the order of the Phone values, so that writing a phone needs no lookup
+constexpr std::array<const char*, static_cast<size_t>(Phone::Noise) + 1> phoneNames {
+	// Vowels
+	"AO", "AA", "IY", "UW", "EH", "IH", "UH", "AH", "Schwa", "AE",
+	"EY", "AY", "OW", "AW", "OY",
+	"ER",
+
+	// Consonants
+	"P", "B", "T", "D", "K", "G",
+	"CH", "JH",
+	"F", "V", "TH", "DH", "S", "Z", "SH", "ZH", "HH",
+	"M", "N", "NG",
+	"L", "R",
+	"Y", "W",
+
+	// Misc.
+	"Breath", "Cough", "Smack", "Noise"
+};
+
 PhoneConverter& PhoneConverter::get() {
 	static PhoneConverter converter;
 	return converter;
@@ -13,54 +33,11 @@ string PhoneConverter::getTypeName() {
 }
 
 EnumConverter<Phone>::member_data PhoneConverter::getMemberData() {
-	return member_data {
-		{ Phone::AO,		"AO" },
-		{ Phone::AA,		"AA" },
-		{ Phone::IY,		"IY" },
-		{ Phone::UW,		"UW" },
-		{ Phone::EH,		"EH" },
-		{ Phone::IH,		"IH" },
-		{ Phone::UH,		"UH" },
-		{ Phone::AH,		"AH" },
-		{ Phone::Schwa,		"Schwa" },
-		{ Phone::AE,		"AE" },
-		{ Phone::EY,		"EY" },
-		{ Phone::AY,		"AY" },
-		{ Phone::OW,		"OW" },
-		{ Phone::AW,		"AW" },
-		{ Phone::OY,		"OY" },
-		{ Phone::ER,		"ER" },
-
-		{ Phone::P,			"P" },
-		{ Phone::B,			"B" },
-		{ Phone::T,			"T" },
-		{ Phone::D,			"D" },
-		{ Phone::K,			"K" },
-		{ Phone::G,			"G" },
-		{ Phone::CH,		"CH" },
-		{ Phone::JH,		"JH" },
-		{ Phone::F,			"F" },
-		{ Phone::V,			"V" },
-		{ Phone::TH,		"TH" },
-		{ Phone::DH,		"DH" },
-		{ Phone::S,			"S" },
-		{ Phone::Z,			"Z" },
-		{ Phone::SH,		"SH" },
-		{ Phone::ZH,		"ZH" },
-		{ Phone::HH,		"HH" },
-		{ Phone::M,			"M" },
-		{ Phone::N,			"N" },
-		{ Phone::NG,		"NG" },
-		{ Phone::L,			"L" },
-		{ Phone::R,			"R" },
-		{ Phone::Y,			"Y" },
-		{ Phone::W,			"W" },
-
-		{ Phone::Breath,	"Breath" },
-		{ Phone::Cough,		"Cough" },
-		{ Phone::Smack,		"Smack" },
-		{ Phone::Noise,		"Noise" }
-	};
+	member_data result;
+	for (size_t i = 0; i < phoneNames.size(); ++i) {
+		result.emplace_back(static_cast<Phone>(i), phoneNames[i]);
+	}
+	return result;
 }
 
 optional<Phone> PhoneConverter::tryParse(const string& s) {
@@ -80,7 +57,10 @@ optional<Phone> PhoneConverter::tryParse(const string& s) {
 }
 
 std::ostream& operator<<(std::ostream& stream, Phone value) {
-	return PhoneConverter::get().write(stream, value);
+	const size_t index = static_cast<size_t>(value);
+	return index < phoneNames.size()
+		? stream << phoneNames[index]
+		: PhoneConverter::get().write(stream, value);
 }
 
 std::istream& operator>>(std::istream& stream, Phone& value) {
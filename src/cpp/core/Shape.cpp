@@ -1,16 +1,17 @@
 #include "Shape.h"
 
 using std::string;
-using std::set;
+
+constexpr int shapeValueCount = static_cast<int>(Shape::EndSentinel);
 
 ShapeConverter& ShapeConverter::get() {
 	static ShapeConverter converter;
 	return converter;
 }
 
-set<Shape> ShapeConverter::getBasicShapes() {
-	static const set<Shape> result = [] {
-		set<Shape> result;
+ShapeSet ShapeConverter::getBasicShapes() {
+	static const ShapeSet result = [] {
+		ShapeSet result;
 		for (int i = 0; i <= static_cast<int>(Shape::LastBasicShape); ++i) {
 			result.insert(static_cast<Shape>(i));
 		}
@@ -19,9 +20,9 @@ set<Shape> ShapeConverter::getBasicShapes() {
 	return result;
 }
 
-set<Shape> ShapeConverter::getExtendedShapes() {
-	static const set<Shape> result = [] {
-		set<Shape> result;
+ShapeSet ShapeConverter::getExtendedShapes() {
+	static const ShapeSet result = [] {
+		ShapeSet result;
 		for (int i = static_cast<int>(Shape::LastBasicShape) + 1; i < static_cast<int>(Shape::EndSentinel); ++i) {
 			result.insert(static_cast<Shape>(i));
 		}
@@ -35,21 +36,19 @@ string ShapeConverter::getTypeName() {
 }
 
 EnumConverter<Shape>::member_data ShapeConverter::getMemberData() {
-	return member_data {
-		{ Shape::A, "A" },
-		{ Shape::B, "B" },
-		{ Shape::C, "C" },
-		{ Shape::D, "D" },
-		{ Shape::E, "E" },
-		{ Shape::F, "F" },
-		{ Shape::G, "G" },
-		{ Shape::H, "H" },
-		{ Shape::X, "X" }
-	};
+	member_data result;
+	for (int i = 0; i < shapeValueCount; ++i) {
+		const Shape shape = static_cast<Shape>(i);
+		result.emplace_back(shape, string(1, getShapeLetter(shape)));
+	}
+	return result;
 }
 
 std::ostream& operator<<(std::ostream& stream, Shape value) {
-	return ShapeConverter::get().write(stream, value);
+	const int index = static_cast<int>(value);
+	return index >= 0 && index < shapeValueCount
+		? stream << getShapeLetter(value)
+		: ShapeConverter::get().write(stream, value);
 }
 
 std::istream& operator>>(std::istream& stream, Shape& value) {
@@ -1,7 +1,11 @@
 #pragma once
 
 #include "tools/EnumConverter.h"
-#include <set>
+#include <initializer_list>
+#include <algorithm>
+#include <utility>
+#include <iterator>
+#include <cstdint>
 
 // The classic Hanna-Barbera mouth shapes A-F plus the common supplements G-H
 // For reference, see http://sunewatts.dk/lipsync/lipsync/article_02.php
@@ -26,11 +30,166 @@ enum class Shape {
 	EndSentinel
 };
 
+// A set of mouth shapes.
+// This may be used to represent all shapes that can be used to represent a certain sound.
+// Alternatively, it can represent all shapes the user wants to allow as program output.
+// The interface is a subset of std::set's. Shapes are stored as a bit mask, so creating and
+// copying sets never allocates.
+class ShapeSet {
+public:
+	using mask_type = uint16_t;
+
+	// The number of distinct masks, including the empty set
+	static constexpr size_t maskCount = size_t(1) << static_cast<int>(Shape::EndSentinel);
+
+	class const_iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = Shape;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const Shape*;
+		using reference = Shape;
+
+		constexpr Shape operator*() const {
+			return static_cast<Shape>(index);
+		}
+
+		constexpr const_iterator& operator++() {
+			index = nextIndex(mask, index + 1);
+			return *this;
+		}
+
+		constexpr const_iterator operator++(int) {
+			const_iterator result = *this;
+			++*this;
+			return result;
+		}
+
+		constexpr bool operator==(const const_iterator& rhs) const {
+			return index == rhs.index;
+		}
+
+		constexpr bool operator!=(const const_iterator& rhs) const {
+			return index != rhs.index;
+		}
+
+	private:
+		friend class ShapeSet;
+
+		constexpr const_iterator(mask_type mask, int index) :
+			mask(mask),
+			index(index)
+		{}
+
+		mask_type mask;
+		int index;
+	};
+
+	using iterator = const_iterator;
+	using value_type = Shape;
+	using size_type = size_t;
+
+	ShapeSet() = default;
+
+	constexpr ShapeSet(std::initializer_list<Shape> shapes) {
+		for (Shape shape : shapes) {
+			insert(shape);
+		}
+	}
+
+	constexpr bool empty() const {
+		return mask == 0;
+	}
+
+	constexpr size_type size() const {
+		size_type result = 0;
+		for (unsigned bits = mask; bits; bits &= bits - 1) {
+			++result;
+		}
+		return result;
+	}
+
+	constexpr const_iterator begin() const {
+		return const_iterator(mask, nextIndex(mask, 0));
+	}
+
+	constexpr const_iterator end() const {
+		return const_iterator(mask, endIndex);
+	}
+
+	constexpr const_iterator find(Shape shape) const {
+		return count(shape) ? const_iterator(mask, static_cast<int>(shape)) : end();
+	}
+
+	constexpr size_type count(Shape shape) const {
+		return (mask >> static_cast<int>(shape)) & 1;
+	}
+
+	constexpr std::pair<const_iterator, bool> insert(Shape shape) {
+		const bool inserted = !count(shape);
+		mask |= bit(shape);
+		return { const_iterator(mask, static_cast<int>(shape)), inserted };
+	}
+
+	constexpr size_type erase(Shape shape) {
+		const size_type erased = count(shape);
+		mask &= static_cast<mask_type>(~bit(shape));
+		return erased;
+	}
+
+	constexpr void clear() {
+		mask = 0;
+	}
+
+	constexpr bool operator==(const ShapeSet& rhs) const {
+		return mask == rhs.mask;
+	}
+
+	constexpr bool operator!=(const ShapeSet& rhs) const {
+		return mask != rhs.mask;
+	}
+
+	constexpr mask_type getMask() const {
+		return mask;
+	}
+
+	static constexpr ShapeSet fromMask(mask_type mask) {
+		ShapeSet result;
+		result.mask = mask;
+		return result;
+	}
+
+	// Lexicographical comparison, like std::set
+	bool operator<(const ShapeSet& rhs) const {
+		return std::lexicographical_compare(begin(), end(), rhs.begin(), rhs.end());
+	}
+
+private:
+	static constexpr int endIndex = static_cast<int>(Shape::EndSentinel);
+
+	static constexpr mask_type bit(Shape shape) {
+		return static_cast<mask_type>(1u << static_cast<int>(shape));
+	}
+
+	// Returns the index of the first shape at or after the given index, or endIndex
+	static constexpr int nextIndex(mask_type mask, int index) {
+		while (index < endIndex && !((mask >> index) & 1)) {
+			++index;
+		}
+		return index;
+	}
+
+	mask_type mask = 0;
+};
+
+static_assert(ShapeSet::maskCount <= size_t(1) << (8 * sizeof(ShapeSet::mask_type)),
+	"ShapeSet::mask_type is too small for all shapes.");
+
 class ShapeConverter : public EnumConverter<Shape> {
 public:
 	static ShapeConverter& get();
-	static std::set<Shape> getBasicShapes();
-	static std::set<Shape> getExtendedShapes();
+	static ShapeSet getBasicShapes();
+	static ShapeSet getExtendedShapes();
 protected:
 	std::string getTypeName() override;
 	member_data getMemberData() override;
@@ -38,13 +197,14 @@ protected:
 
 std::ostream& operator<<(std::ostream& stream, Shape value);
 
+// Returns the name of a shape, which is a single letter, without a lookup.
+// The shape must be valid.
+constexpr char getShapeLetter(Shape shape) {
+	return "ABCDEFGHX"[static_cast<int>(shape)];
+}
+
 std::istream& operator>>(std::istream& stream, Shape& value);
 
 inline bool isClosed(Shape shape) {
 	return shape == Shape::A || shape == Shape::X;
 }
-
-// A set of mouth shapes.
-// This may be used to represent all shapes that can be used to represent a certain sound.
-// Alternatively, it can represent all shapes the user wants to allow as program output.
-using ShapeSet = std::set<Shape>;
@@ -1,5 +1,5 @@
-// WASM stub for appInfo
-// Provides application name and version for language model generation
+// Application name and version, as used by the CLI and for language model generation
+#include "appInfo.h"
 
-const char* appName = "LipSyncEngine WASM";
-const char* appVersion = "1.14.0-wasm";
+const std::string appName = "LipSyncEngine";
+const std::string appVersion = "1.14.0-wasm";
@@ -0,0 +1,25 @@
+// Build-time tool compiling the pronunciation dictionary of a model directory
+// (cmudict-en-us.dict) into the binary dictionary that native decoders load in place.
+
+#include <iostream>
+#include "recognition/pocketSphinxTools.h"
+
+using std::filesystem::path;
+
+int main(int argc, char* argv[]) {
+	if (argc != 2) {
+		std::cerr << "Usage: " << argv[0] << " <model directory>" << std::endl;
+		return 1;
+	}
+
+	const path modelDirectory = path(argv[1]);
+	setSphinxModelDirectory(modelDirectory);
+	const path textPath = modelDirectory / "cmudict-en-us.dict";
+	path binaryPath = textPath;
+	binaryPath += ".bin";
+	if (!compileSphinxDictionary(textPath, binaryPath)) {
+		std::cerr << "Failed to compile " << textPath.u8string() << std::endl;
+		return 1;
+	}
+	return 0;
+}
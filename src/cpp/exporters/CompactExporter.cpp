@@ -0,0 +1,65 @@
+#include "CompactExporter.h"
+#include <stdexcept>
+
+namespace {
+
+	void writeVarint(std::vector<uint8_t>& output, uint64_t value) {
+		while (value >= 0x80) {
+			output.push_back(static_cast<uint8_t>(value | 0x80));
+			value >>= 7;
+		}
+		output.push_back(static_cast<uint8_t>(value));
+	}
+
+	constexpr char magic[] = { 'L', 'S', 'E', 'C' };
+	constexpr uint8_t version = 1;
+
+}
+
+CompactExporter::CompactExporter(int seekInterval) :
+	seekInterval(seekInterval)
+{
+	if (seekInterval < 0) {
+		throw std::invalid_argument("Seek interval must not be negative.");
+	}
+}
+
+void CompactExporter::exportAnimation(const ExporterInput& input, std::ostream& outputStream) {
+	const std::vector<uint8_t> bytes = encodeCompactCues(input.animation, seekInterval);
+	outputStream.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+std::vector<uint8_t> encodeCompactCues(const JoiningContinuousTimeline<Shape>& animation, int seekInterval) {
+	// The cue data first, as the seek table needs its offsets
+	std::vector<uint8_t> cueData;
+	cueData.reserve(animation.size() * 2);
+	std::vector<std::pair<uint64_t, uint64_t>> seekEntries;
+	size_t cueCount = 0;
+	for (const auto& timedShape : animation) {
+		if (seekInterval > 0 && cueCount > 0 && cueCount % seekInterval == 0) {
+			seekEntries.emplace_back(timedShape.getStart().count(), cueData.size());
+		}
+		const uint64_t duration = timedShape.getDuration().count();
+		writeVarint(cueData, duration << 4 | static_cast<uint8_t>(timedShape.getValue()));
+		++cueCount;
+	}
+
+	const uint64_t start = animation.empty() ? 0 : animation.begin()->getStart().count();
+	std::vector<uint8_t> result(std::begin(magic), std::end(magic));
+	result.push_back(version);
+	result.push_back(0);
+	writeVarint(result, cueCount);
+	writeVarint(result, start);
+	writeVarint(result, seekInterval);
+	writeVarint(result, seekEntries.size());
+	uint64_t time = start;
+	uint64_t offset = 0;
+	for (const auto& [entryTime, entryOffset] : seekEntries) {
+		writeVarint(result, entryTime - time);
+		writeVarint(result, entryOffset - offset);
+		time = entryTime;
+		offset = entryOffset;
+	}
+	result.insert(result.end(), cueData.begin(), cueData.end());
+	return result;
+}
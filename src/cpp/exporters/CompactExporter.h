@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Exporter.h"
+#include <cstdint>
+#include <vector>
+
+// Compact binary format of mouth cues, for storing and transferring many animations.
+// Decoded by decodeCompactCues() in src/ts/utils/compactCues.ts. All varints are unsigned LEB128.
+//
+//   magic      "LSEC"
+//   version    1 byte, 1
+//   reserved   1 byte, 0
+//   cue count, start of the first cue in centiseconds, seek interval, seek entry count: varints
+//   seek table: per entry, the time and the byte offset within the cue data, each as a varint
+//               delta from the previous entry (or from the start and 0)
+//   cue data:  per cue, a varint of its duration in centiseconds << 4 | its shape (0-8 for A-H
+//              and X) -- one byte for cues shorter than 8 centiseconds
+//
+// Seek entry i points at cue (i + 1) * seek interval, so a decoder can start at any entry instead
+// of decoding all cues before a time.
+class CompactExporter : public Exporter {
+public:
+	explicit CompactExporter(int seekInterval = defaultSeekInterval);
+	void exportAnimation(const ExporterInput& input, std::ostream& outputStream) override;
+
+	// Cues per seek entry; about 6 seconds of speech
+	static constexpr int defaultSeekInterval = 64;
+
+private:
+	int seekInterval;
+};
+
+// Encodes an animation in the compact format.
+// A seek interval of 0 writes no seek table.
+std::vector<uint8_t> encodeCompactCues(const JoiningContinuousTimeline<Shape>& animation, int seekInterval);
@@ -0,0 +1,45 @@
+#include "FrameExporter.h"
+#include <algorithm>
+#include <cmath>
+
+size_t getFrameCount(const JoiningContinuousTimeline<Shape>& animation, double frameRate) {
+	const double end = animation.getRange().getEnd().count();
+	return end > 0 ? static_cast<size_t>(std::ceil(end / 100 * frameRate)) : 0;
+}
+
+void sampleFrames(
+	const JoiningContinuousTimeline<Shape>& animation,
+	double frameRate,
+	uint8_t* shapes,
+	uint8_t* blendShapes,
+	float* blendWeights
+) {
+	const size_t frameCount = getFrameCount(animation, frameRate);
+	if (frameCount == 0 || animation.empty()) return;
+
+	// Frame times only grow, so one sweep over the cues finds the cue of every frame
+	auto cue = animation.begin();
+	for (size_t frame = 0; frame < frameCount; ++frame) {
+		// In centiseconds
+		const double frameStart = frame * 100 / frameRate;
+		const double frameEnd = (frame + 1) * 100 / frameRate;
+		while (std::next(cue) != animation.end() && cue->getEnd().count() <= frameStart) {
+			++cue;
+		}
+
+		const Shape shape = cue->getValue();
+		shapes[frame] = static_cast<uint8_t>(shape);
+		if (!blendShapes || !blendWeights) continue;
+
+		// The next cue, if it starts within the frame
+		const auto nextCue = std::next(cue);
+		if (nextCue != animation.end() && cue->getEnd().count() < frameEnd) {
+			blendShapes[frame] = static_cast<uint8_t>(nextCue->getValue());
+			blendWeights[frame] = static_cast<float>(std::clamp(
+				(frameEnd - cue->getEnd().count()) / (frameEnd - frameStart), 0.0, 1.0));
+		} else {
+			blendShapes[frame] = static_cast<uint8_t>(shape);
+			blendWeights[frame] = 0;
+		}
+	}
+}
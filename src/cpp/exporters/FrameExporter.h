@@ -0,0 +1,23 @@
+#pragma once
+
+#include "core/Shape.h"
+#include "time/ContinuousTimeline.h"
+#include <cstdint>
+
+// Resamples an animation at a fixed frame rate, for renderers that show one mouth shape per video
+// frame. Frame i starts at i / frameRate seconds.
+
+// Returns the number of frames until the end of the animation
+size_t getFrameCount(const JoiningContinuousTimeline<Shape>& animation, double frameRate);
+
+// Writes the shape at the start of each frame as its index (0-8 for A-H and X).
+// If blendShapes and blendWeights aren't null, also writes for each frame the shape the mouth
+// changes to within the frame and the fraction of the frame it covers; or the frame's own shape
+// and 0 if the mouth doesn't change. Each array must hold getFrameCount() elements.
+void sampleFrames(
+	const JoiningContinuousTimeline<Shape>& animation,
+	double frameRate,
+	uint8_t* shapes,
+	uint8_t* blendShapes,
+	float* blendWeights
+);
@@ -1,28 +1,92 @@
 #include "JsonExporter.h"
-#include "exporterTools.h"
+#include "animation/targetShapeSet.h"
 #include "tools/stringTools.h"
 
 using std::string;
 
 void JsonExporter::exportAnimation(const ExporterInput& input, std::ostream& outputStream) {
+	const string soundFile = escapeJsonString(absolute(input.inputFilePath).u8string());
+
+	// Measure the document, then write it in one piece
+	JsonWriter counter;
+	writeAnimationJson(counter, soundFile, input.animation, input.targetShapeSet);
+	string json(counter.size(), '\0');
+	JsonWriter writer(&json[0]);
+	writeAnimationJson(writer, soundFile, input.animation, input.targetShapeSet);
+	outputStream << json;
+}
+
+// Writes an array of timed labels after the "mouthCues" array, in its format
+template<typename T, typename TGetLabel>
+static void writeTimedLabelsJson(JsonWriter& writer, const char* name, const Timeline<T>& labels, TGetLabel getLabel) {
+	writer.write(",\n  \"");
+	writer.write(name);
+	writer.write("\": [");
+	bool isFirst = true;
+	for (const auto& timedLabel : labels) {
+		writer.write(isFirst ? "\n" : ",\n");
+		isFirst = false;
+		writer.write("    { \"start\": ");
+		writer.writeSeconds(timedLabel.getStart());
+		writer.write(", \"end\": ");
+		writer.writeSeconds(timedLabel.getEnd());
+		writer.write(", \"value\": \"");
+		writer.write(getLabel(timedLabel.getValue()));
+		writer.write("\" }");
+	}
+	writer.write(isFirst ? "]" : "\n  ]");
+}
+
+void writeAnimationJson(
+	JsonWriter& writer,
+	const string& escapedSoundFile,
+	const JoiningContinuousTimeline<Shape>& animation,
+	const ShapeSet& targetShapeSet,
+	const RecognitionTimings::Clip* timings
+) {
 	// Export as JSON.
 	// I'm not using a library because the code is short enough without one and it lets me control
 	// the formatting.
-	outputStream << "{\n";
-	outputStream << "  \"metadata\": {\n";
-	outputStream << "    \"soundFile\": \"" << escapeJsonString(absolute(input.inputFilePath).u8string()) << "\",\n";
-	outputStream << "    \"duration\": " << formatDuration(input.animation.getRange().getDuration()) << "\n";
-	outputStream << "  },\n";
-	outputStream << "  \"mouthCues\": [\n";
+	writer.write("{\n");
+	writer.write("  \"metadata\": {\n");
+	writer.write("    \"soundFile\": \"");
+	writer.write(escapedSoundFile);
+	writer.write("\",\n");
+	writer.write("    \"duration\": ");
+	writer.writeSeconds(animation.getRange().getDuration());
+	writer.write("\n");
+	writer.write("  },\n");
+	writer.write("  \"mouthCues\": [\n");
+	if (animation.empty()) {
+		// Make sure there is at least one mouth shape: a zero-length empty mouth
+		writeMouthCueJson(writer, { 0_cs, 0_cs, convertToTargetShapeSet(Shape::X, targetShapeSet) });
+	}
 	bool isFirst = true;
-	for (auto& timedShape : dummyShapeIfEmpty(input.animation, input.targetShapeSet)) {
-		if (!isFirst) outputStream << ",\n";
+	for (const auto& timedShape : animation) {
+		if (!isFirst) writer.write(",\n");
 		isFirst = false;
-		outputStream << "    { \"start\": " << formatDuration(timedShape.getStart())
-			<< ", \"end\": " << formatDuration(timedShape.getEnd())
-			<< ", \"value\": \"" << timedShape.getValue() << "\" }";
+		writeMouthCueJson(writer, timedShape);
 	}
-	outputStream << "\n";
-	outputStream << "  ]\n";
-	outputStream << "}\n";
+	writer.write("\n");
+	writer.write("  ]");
+	if (timings) {
+		writeTimedLabelsJson(writer, "words", timings->words, [](const string& word) {
+			return escapeJsonString(word);
+		});
+		writeTimedLabelsJson(writer, "phones", timings->phones, [](Phone phone) {
+			return PhoneConverter::get().toString(phone);
+		});
+	}
+	writer.write("\n");
+	writer.write("}\n");
+}
+
+void writeMouthCueJson(JsonWriter& writer, const Timed<Shape>& timedShape) {
+	writer.write("    { \"start\": ");
+	writer.writeSeconds(timedShape.getStart());
+	writer.write(", \"end\": ");
+	writer.writeSeconds(timedShape.getEnd());
+	writer.write(", \"value\": \"");
+	writer.writeShape(timedShape.getValue());
+	writer.write("\" }");
 }
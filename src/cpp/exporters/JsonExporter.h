@@ -1,8 +1,25 @@
 #pragma once
 
 #include "Exporter.h"
+#include "JsonWriter.h"
+#include "recognition/RecognitionTimings.h"
 
 class JsonExporter : public Exporter {
 public:
 	void exportAnimation(const ExporterInput& input, std::ostream& outputStream) override;
 };
+
+// Writes an animation as the JSON document exported by JsonExporter.
+// The sound file is written as is, so it must already be escaped.
+// If timings are given, the document also has their words and phones as "words" and "phones"
+// arrays, in the format of "mouthCues".
+void writeAnimationJson(
+	JsonWriter& writer,
+	const std::string& escapedSoundFile,
+	const JoiningContinuousTimeline<Shape>& animation,
+	const ShapeSet& targetShapeSet,
+	const RecognitionTimings::Clip* timings = nullptr
+);
+
+// Writes a mouth cue as an element of the exported "mouthCues" array
+void writeMouthCueJson(JsonWriter& writer, const Timed<Shape>& timedShape);
@@ -0,0 +1,37 @@
+#include "JsonWriter.h"
+
+void JsonWriter::writeSeconds(centiseconds time) {
+	// Centiseconds are exact in fixed point, so there is nothing to round
+	long long value = time.count();
+	if (value < 0) {
+		write('-');
+		value = -value;
+	}
+
+	// Digits in reverse order, the integer part having at least one
+	char digits[24];
+	size_t digitCount = 0;
+	do {
+		digits[digitCount++] = static_cast<char>('0' + value % 10);
+		value /= 10;
+	} while (value > 0 || digitCount < 3);
+
+	char text[25];
+	size_t textLength = 0;
+	for (size_t i = digitCount; i > 2; --i) {
+		text[textLength++] = digits[i - 1];
+	}
+	text[textLength++] = '.';
+	text[textLength++] = digits[1];
+	text[textLength++] = digits[0];
+	write(text, textLength);
+}
+
+void JsonWriter::writeShape(Shape shape) {
+	if (shape >= Shape::A && shape < Shape::EndSentinel) {
+		write(getShapeLetter(shape));
+	} else {
+		// Throws for invalid shapes
+		write(ShapeConverter::get().toString(shape));
+	}
+}
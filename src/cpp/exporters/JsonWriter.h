@@ -0,0 +1,57 @@
+#pragma once
+
+#include "core/Shape.h"
+#include "time/centiseconds.h"
+#include <string>
+#include <cstring>
+
+// Writes JSON text straight into preallocated memory.
+// A writer without a buffer only counts the characters. Running the same calls on a counting
+// writer first gives the exact size to allocate for the real one.
+class JsonWriter {
+public:
+	// Creates a writer that only counts characters
+	JsonWriter() = default;
+
+	// Creates a writer for a buffer with room for all characters to be written
+	explicit JsonWriter(char* buffer) :
+		position(buffer)
+	{}
+
+	// The number of characters written or counted so far
+	size_t size() const {
+		return length;
+	}
+
+	void write(const char* text, size_t textLength) {
+		if (position) {
+			std::memcpy(position, text, textLength);
+			position += textLength;
+		}
+		length += textLength;
+	}
+
+	void write(const char* text) {
+		write(text, std::strlen(text));
+	}
+
+	void write(const std::string& text) {
+		write(text.data(), text.size());
+	}
+
+	void write(char c) {
+		if (position) {
+			*position++ = c;
+		}
+		++length;
+	}
+
+	// Writes a time in seconds with two decimals, like formatDuration()
+	void writeSeconds(centiseconds time);
+
+	void writeShape(Shape shape);
+
+private:
+	char* position = nullptr;
+	size_t length = 0;
+};
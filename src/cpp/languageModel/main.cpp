@@ -0,0 +1,29 @@
+// Build-time tool generating the small language model of a model directory (en-us-small.lm.bin)
+// by pruning the full one (en-us.lm.bin), see LanguageModelVariant::Small.
+
+#include <iostream>
+#include <cstdlib>
+#include "recognition/pocketSphinxTools.h"
+
+using std::filesystem::path;
+
+// The pruning threshold the shipped small model is generated with. See the benchmark's
+// --languageModel option for measuring its effect on accuracy.
+constexpr double defaultThreshold = 3e-7;
+
+int main(int argc, char* argv[]) {
+	if (argc != 2 && argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " <model directory> [<pruning threshold>]" << std::endl;
+		return 1;
+	}
+
+	const path modelDirectory = path(argv[1]);
+	const double threshold = argc == 3 ? std::strtod(argv[2], nullptr) : defaultThreshold;
+	const path inputPath = modelDirectory / "en-us.lm.bin";
+	const path outputPath = modelDirectory / "en-us-small.lm.bin";
+	if (!pruneSphinxLanguageModel(inputPath, outputPath, threshold)) {
+		std::cerr << "Failed to prune " << inputPath.u8string() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,83 @@
+#include "QualityController.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using std::chrono::duration;
+
+// Older measurements count for half after this many seconds of speech
+constexpr double smoothingHalfLifeSeconds = 3.0;
+// A level is only judged once this much speech has been recognized at it
+constexpr double minMeasuredSpeechSeconds = 2.0;
+// Steps up once recognition takes less than this share of the target, leaving room for the better
+// level being slower
+constexpr double recoveredShare = 0.5;
+// The speech recognized well below the target before stepping up, and its limit once it has been
+// doubled by failed attempts
+constexpr double initialStepUpDelaySeconds = 10.0;
+constexpr double maxStepUpDelaySeconds = 160.0;
+
+QualityController::QualityController(int levelCount, double maxRealTimeFactor) :
+	levels(static_cast<size_t>(levelCount)),
+	maxRealTimeFactor(maxRealTimeFactor),
+	stepUpDelaySeconds(initialStepUpDelaySeconds)
+{
+	if (levelCount < 1) {
+		throw std::invalid_argument("There must be at least one quality level.");
+	}
+	if (!(maxRealTimeFactor > 0)) {
+		throw std::invalid_argument("The maximum real-time factor must be positive.");
+	}
+}
+
+bool QualityController::addMeasurement(centiseconds speech, duration<double> time) {
+	if (speech <= 0_cs) return false;
+
+	const double speechSeconds = speech.count() / 100.0;
+	const double factor = time.count() / speechSeconds;
+	Level& current = levels[level];
+	if (current.realTimeFactor > 0) {
+		const double weight = 1 - std::pow(0.5, speechSeconds / smoothingHalfLifeSeconds);
+		current.realTimeFactor += weight * (factor - current.realTimeFactor);
+	} else {
+		current.realTimeFactor = factor;
+	}
+	current.speechSeconds += speechSeconds;
+	if (current.speechSeconds < minMeasuredSpeechSeconds) return false;
+
+	const int lastLevel = static_cast<int>(levels.size()) - 1;
+	if (current.realTimeFactor > maxRealTimeFactor && level < lastLevel) {
+		if (onProbation) {
+			// The better level couldn't keep up after all, so wait longer before the next attempt
+			stepUpDelaySeconds = std::min(stepUpDelaySeconds * 2, maxStepUpDelaySeconds);
+		}
+		switchTo(level + 1);
+		onProbation = false;
+		return true;
+	}
+
+	if (onProbation && current.speechSeconds >= initialStepUpDelaySeconds) {
+		onProbation = false;
+		stepUpDelaySeconds = initialStepUpDelaySeconds;
+	}
+	if (level > 0
+		&& current.speechSeconds >= stepUpDelaySeconds
+		&& current.realTimeFactor < recoveredShare * maxRealTimeFactor
+	) {
+		switchTo(level - 1);
+		onProbation = true;
+		return true;
+	}
+	return false;
+}
+
+void QualityController::setLevel(int newLevel) {
+	switchTo(std::min(std::max(newLevel, 0), static_cast<int>(levels.size()) - 1));
+	onProbation = false;
+}
+
+void QualityController::switchTo(int newLevel) {
+	level = newLevel;
+	// The level's earlier speed may have been measured under a different load
+	levels[level] = Level();
+}
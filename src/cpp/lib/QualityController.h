@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include "time/centiseconds.h"
+
+// Keeps the recognition of a stream under a real-time factor by moving between quality levels,
+// from the best (level 0) to the cheapest, e.g. narrower beams, then phonetic recognition, then
+// loudness. The speed is measured per utterance and smoothed, so that single slow utterances don't
+// cause a switch. Switches are damped by hysteresis: the controller steps down as soon as the
+// smoothed factor exceeds the target, but only steps back up once it stayed well below the target
+// for a while. Each time stepping up has to be undone before the better level proved itself, it
+// waits twice as long before trying again, so that it doesn't flap between two levels.
+class QualityController {
+public:
+	// maxRealTimeFactor is in seconds of recognition per second of speech
+	QualityController(int levelCount, double maxRealTimeFactor);
+
+	int getLevel() const { return level; }
+
+	// Continues at the given level, clamped to the existing ones, measuring it anew, e.g. for a
+	// stream continued in another process
+	void setLevel(int newLevel);
+
+	// Seconds of recognition per second of speech at the current level, smoothed; 0 until measured
+	double getRealTimeFactor() const { return levels[level].realTimeFactor; }
+
+	// Records that recognizing speech of the given duration at the current level took the given
+	// time. Returns true if the level changed.
+	bool addMeasurement(centiseconds speech, std::chrono::duration<double> time);
+
+private:
+	struct Level {
+		// Smoothed seconds of recognition per second of speech; 0 until measured
+		double realTimeFactor = 0.0;
+		// The speech recognized at the level since it was last switched to
+		double speechSeconds = 0.0;
+	};
+
+	void switchTo(int newLevel);
+
+	std::vector<Level> levels;
+	double maxRealTimeFactor;
+	int level = 0;
+	// The speech a level must be recognized well below the target before stepping up from it
+	double stepUpDelaySeconds;
+	// Whether the current level was reached by stepping up and hasn't proved itself yet
+	bool onProbation = false;
+};
@@ -0,0 +1,167 @@
+#include "StreamScheduler.h"
+#include "StreamingAnalyzer.h"
+#include "tools/parallel.h"
+#include "logging/logging.h"
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <cmath>
+
+using std::vector;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+// The load is estimated over windows of at least this many seconds
+constexpr double loadWindowSeconds = 2.0;
+// Streams switch to the fallback once recognizing the others would take more than this share of
+// the threads, and back while it takes less than the other share
+constexpr double overloadedLoad = 0.9;
+constexpr double recoveredLoad = 0.6;
+// Older windows count for half after this many seconds, so that the load follows the conversation
+constexpr double loadHalfLifeSeconds = 5.0;
+
+double StreamScheduler::ScheduledStream::getLoad(double realTimeFactor) const {
+	if (audioSeconds <= 0) return 0.0;
+
+	// An utterance is counted once recognized, which may be in a window shorter than the utterance
+	return std::min(speechSeconds / audioSeconds, 1.0) * realTimeFactor;
+}
+
+void StreamScheduler::add(StreamingAnalyzer& stream) {
+	streams.push_back({ &stream, stream.getDuration(), 0_cs });
+}
+
+void StreamScheduler::remove(StreamingAnalyzer& stream) {
+	const auto it = std::find_if(streams.begin(), streams.end(),
+		[&](const ScheduledStream& scheduledStream) { return scheduledStream.stream == &stream; });
+	if (it == streams.end()) return;
+
+	// Keep the turn with the stream that was next
+	if (static_cast<size_t>(it - streams.begin()) < nextStreamIndex) {
+		--nextStreamIndex;
+	}
+	streams.erase(it);
+	if (nextStreamIndex >= streams.size()) {
+		nextStreamIndex = 0;
+	}
+	errors.erase(&stream);
+}
+
+void StreamScheduler::run(int maxThreadCount) {
+	std::mutex errorsMutex;
+	while (true) {
+		vector<ScheduledStream*> readyStreams;
+		for (size_t i = 0; i < streams.size(); ++i) {
+			ScheduledStream& scheduledStream = streams[(nextStreamIndex + i) % streams.size()];
+			if (scheduledStream.stream->hasPendingUtterance()) {
+				readyStreams.push_back(&scheduledStream);
+			}
+		}
+		if (readyStreams.empty()) break;
+		nextStreamIndex = (nextStreamIndex + 1) % streams.size();
+
+		// The time each task spent recognizing with a decoder, if it did
+		vector<duration<double>> decoderTimes(readyStreams.size(), duration<double>(0.0));
+		vector<std::function<void()>> tasks;
+		for (size_t i = 0; i < readyStreams.size(); ++i) {
+			ScheduledStream& scheduledStream = *readyStreams[i];
+			const TimeRange utterance = *scheduledStream.stream->getPendingUtterance();
+			scheduledStream.windowSpeech += utterance.getDuration();
+			const bool decoded = scheduledStream.stream->isRecognizing();
+			if (decoded) {
+				windowDecodedSpeech += utterance.getDuration();
+			}
+			tasks.push_back([&, i, decoded] {
+				StreamingAnalyzer* stream = readyStreams[i]->stream;
+				const auto start = steady_clock::now();
+				try {
+					stream->recognizeNextUtterance();
+				} catch (...) {
+					std::lock_guard<std::mutex> lock(errorsMutex);
+					errors[stream] = std::current_exception();
+				}
+				if (decoded) {
+					decoderTimes[i] = steady_clock::now() - start;
+				}
+			});
+		}
+		runTasksInParallel(tasks, std::max(1, std::min(maxThreadCount, static_cast<int>(tasks.size()))));
+		for (const duration<double>& decoderTime : decoderTimes) {
+			windowDecoderTime += decoderTime;
+		}
+	}
+
+	updateLoad(maxThreadCount);
+}
+
+std::exception_ptr StreamScheduler::takeError(const StreamingAnalyzer& stream) {
+	const auto it = errors.find(&stream);
+	if (it == errors.end()) return nullptr;
+
+	const std::exception_ptr error = it->second;
+	errors.erase(it);
+	return error;
+}
+
+void StreamScheduler::updateLoad(int maxThreadCount) {
+	// The load is measured against the audio rather than the clock: audio may be pushed faster
+	// than real time, e.g. from a file, and pushes take longer while the decoders fall behind
+	double windowSeconds = 0.0;
+	for (const ScheduledStream& scheduledStream : streams) {
+		const centiseconds pushed = scheduledStream.stream->getDuration() - scheduledStream.windowStartDuration;
+		windowSeconds = std::max(windowSeconds, pushed.count() / 100.0);
+	}
+	if (windowSeconds < loadWindowSeconds) return;
+
+	// Only decoded speech tells how long decoding takes
+	if (windowDecodedSpeech > 0_cs) {
+		const double windowFactor = windowDecoderTime.count() / (windowDecodedSpeech.count() / 100.0);
+		realTimeFactor = realTimeFactor > 0 ? (realTimeFactor + windowFactor) / 2 : windowFactor;
+	}
+	const double decay = std::pow(0.5, windowSeconds / loadHalfLifeSeconds);
+	for (ScheduledStream& scheduledStream : streams) {
+		scheduledStream.speechSeconds = scheduledStream.speechSeconds * decay + scheduledStream.windowSpeech.count() / 100.0;
+		const centiseconds streamDuration = scheduledStream.stream->getDuration();
+		scheduledStream.audioSeconds = scheduledStream.audioSeconds * decay
+			+ (streamDuration - scheduledStream.windowStartDuration).count() / 100.0;
+		scheduledStream.windowStartDuration = streamDuration;
+		scheduledStream.windowSpeech = 0_cs;
+	}
+	windowDecoderTime = duration<double>(0.0);
+	windowDecodedSpeech = 0_cs;
+
+	double decodedLoad = 0.0;
+	int decodedStreamCount = 0;
+	for (const ScheduledStream& scheduledStream : streams) {
+		if (scheduledStream.stream->isRecognizing()) {
+			decodedLoad += scheduledStream.getLoad(realTimeFactor);
+			++decodedStreamCount;
+		}
+	}
+	// With a thread for every decoded stream, the decoders are only slow for the streams' profile
+	const int threadCount = std::max(maxThreadCount, 1);
+	if (decodedStreamCount > threadCount && decodedLoad > overloadedLoad * threadCount) {
+		// Fall back with the newest streams first, so that long-running ones keep their quality
+		for (auto it = streams.rbegin(); it != streams.rend(); ++it) {
+			if (decodedLoad <= recoveredLoad * threadCount || decodedStreamCount <= threadCount) break;
+			const double load = it->getLoad(realTimeFactor);
+			if (!it->stream->isRecognizing() || load <= 0) continue;
+
+			it->stream->setFallback(true);
+			decodedLoad -= load;
+			--decodedStreamCount;
+			logging::infoFormat("Stream overloaded the decoders ({:.2f} threads). Falling back to loudness.", load);
+		}
+	} else {
+		// Return to the decoders in the order the streams were added, as long as they keep up
+		for (ScheduledStream& scheduledStream : streams) {
+			if (!scheduledStream.stream->isFallback()) continue;
+			const double load = scheduledStream.getLoad(realTimeFactor);
+			if (decodedLoad + load > recoveredLoad * threadCount) break;
+
+			scheduledStream.stream->setFallback(false);
+			decodedLoad += load;
+			logging::info("Decoders caught up. Stream returns to recognition.");
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <map>
+#include <chrono>
+#include <exception>
+#include "time/centiseconds.h"
+
+class StreamingAnalyzer;
+
+// Recognizes the utterances queued by many streaming sessions, taking turns between the streams,
+// so that they share a few decoders and threads and a talkative stream doesn't hold up the others.
+// Decoders are only held while an utterance is recognized, so the cost follows the speech, not the
+// number of streams. Streams must be removed before they are destroyed.
+// If there are more streams than threads and they speak more than the threads can recognize in
+// real time, the streams added last are switched to the loudness fallback (see
+// StreamingAnalyzer::setFallback()) until the load drops well below the threads' capacity again.
+// At least as many streams as there are threads keep being recognized.
+class StreamScheduler {
+public:
+	void add(StreamingAnalyzer& stream);
+	void remove(StreamingAnalyzer& stream);
+
+	// Recognizes the queued utterances of all streams in rounds of one utterance per stream. Each
+	// round starts one stream further on, and runs on up to maxThreadCount threads.
+	// Errors are kept for the stream they occurred in; see takeError().
+	void run(int maxThreadCount);
+
+	// Returns the error of the stream's last failed recognition, if any, forgetting it
+	std::exception_ptr takeError(const StreamingAnalyzer& stream);
+
+private:
+	struct ScheduledStream {
+		StreamingAnalyzer* stream;
+		// The stream's duration when the current load window started
+		centiseconds windowStartDuration;
+		// The speech recognized during the current load window
+		centiseconds windowSpeech;
+		// The seconds of speech and of audio of earlier windows, fading with age
+		double speechSeconds = 0.0;
+		double audioSeconds = 0.0;
+
+		// The share of a thread that recognizing the stream takes if its audio is pushed in real time
+		double getLoad(double realTimeFactor) const;
+	};
+
+	// Once a load window is long enough, estimates the load of each stream and switches streams
+	// to or from the fallback
+	void updateLoad(int maxThreadCount);
+
+	std::vector<ScheduledStream> streams;
+	size_t nextStreamIndex = 0;
+	std::map<const StreamingAnalyzer*, std::exception_ptr> errors;
+
+	// The time spent recognizing utterances with decoders during the current load window, and
+	// their duration
+	std::chrono::duration<double> windowDecoderTime { 0.0 };
+	centiseconds windowDecodedSpeech { 0 };
+	// Seconds of recognition per second of speech, smoothed over windows; 0 until measured
+	double realTimeFactor = 0.0;
+};
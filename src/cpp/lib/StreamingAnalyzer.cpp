@@ -0,0 +1,715 @@
+#include "StreamingAnalyzer.h"
+#include "recognition/EnergyUtteranceRecognizer.h"
+#include "audio/AudioSegment.h"
+#include "audio/SampleRateConverter.h"
+#include "audio/processing.h"
+#include "time/timedLogging.h"
+#include "logging/logging.h"
+#include "tools/progress.h"
+#include <format.h>
+#include <cmath>
+#include <cstring>
+
+using std::vector;
+using std::unique_ptr;
+using std::make_unique;
+using std::shared_ptr;
+using std::invalid_argument;
+using boost::optional;
+using std::string;
+using std::runtime_error;
+using std::chrono::duration;
+using std::chrono::steady_clock;
+
+// Audio around an utterance that is kept for its recognition
+constexpr centiseconds utterancePadding(3);
+
+// The name of the quality level following the given ones
+const string loudnessLevelName = "loudness";
+
+// Once this many samples can be discarded, they are removed from the buffer
+constexpr int64_t minDiscardSampleCount = 1 << 18;
+
+namespace {
+
+	// "LSSS", then the format version
+	constexpr uint32_t stateMagic = 0x5353534C;
+	constexpr uint32_t stateVersion = 1;
+
+	// Writes values little-endian
+	class StateWriter {
+	public:
+		explicit StateWriter(vector<uint8_t>& bytes) : bytes(bytes) {}
+
+		void writeUInt(uint32_t value, int byteCount = 4) {
+			for (int i = 0; i < byteCount; ++i) {
+				bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+			}
+		}
+
+		void writeUInt64(uint64_t value) {
+			writeUInt(static_cast<uint32_t>(value));
+			writeUInt(static_cast<uint32_t>(value >> 32));
+		}
+
+		void writeTime(centiseconds time) {
+			writeUInt(static_cast<uint32_t>(time.count()));
+		}
+
+		void writeTimeRange(const TimeRange& timeRange) {
+			writeTime(timeRange.getStart());
+			writeTime(timeRange.getEnd());
+		}
+
+		void writeFloat(float value) {
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof bits);
+			writeUInt(bits);
+		}
+
+		void writeDouble(double value) {
+			uint64_t bits;
+			std::memcpy(&bits, &value, sizeof bits);
+			writeUInt64(bits);
+		}
+
+	private:
+		vector<uint8_t>& bytes;
+	};
+
+	class StateReader {
+	public:
+		explicit StateReader(gsl::span<const uint8_t> bytes) : bytes(bytes) {}
+
+		uint32_t readUInt(int byteCount = 4) {
+			if (offset + byteCount > bytes.size()) {
+				throw runtime_error("Stream state is truncated.");
+			}
+			uint32_t value = 0;
+			for (int i = 0; i < byteCount; ++i) {
+				value |= static_cast<uint32_t>(bytes[offset++]) << (8 * i);
+			}
+			return value;
+		}
+
+		uint64_t readUInt64() {
+			const uint64_t low = readUInt();
+			return low | static_cast<uint64_t>(readUInt()) << 32;
+		}
+
+		centiseconds readTime() {
+			return centiseconds(static_cast<int32_t>(readUInt()));
+		}
+
+		TimeRange readTimeRange() {
+			const centiseconds start = readTime();
+			const centiseconds end = readTime();
+			if (end < start) {
+				throw runtime_error("Stream state has an invalid time range.");
+			}
+			return TimeRange(start, end);
+		}
+
+		float readFloat() {
+			const uint32_t bits = readUInt();
+			float value;
+			std::memcpy(&value, &bits, sizeof value);
+			return value;
+		}
+
+		double readDouble() {
+			const uint64_t bits = readUInt64();
+			double value;
+			std::memcpy(&value, &bits, sizeof value);
+			return value;
+		}
+
+		// Reads a count of values that take at least valueSize bytes each
+		size_t readCount(int valueSize) {
+			const size_t count = readUInt();
+			if (count > static_cast<size_t>(bytes.size() - offset) / valueSize) {
+				throw runtime_error("Stream state is truncated.");
+			}
+			return count;
+		}
+
+		string readString(size_t length) {
+			if (length > static_cast<size_t>(bytes.size() - offset)) {
+				throw runtime_error("Stream state is truncated.");
+			}
+			const string result(reinterpret_cast<const char*>(bytes.data() + offset), length);
+			offset += static_cast<std::ptrdiff_t>(length);
+			return result;
+		}
+
+		bool atEnd() const {
+			return offset == bytes.size();
+		}
+
+	private:
+		gsl::span<const uint8_t> bytes;
+		std::ptrdiff_t offset = 0;
+	};
+
+}
+
+// Sample indexes are relative to the start of the stream; discarded samples must not be read.
+class StreamingAnalyzer::StreamClip : public AudioClip {
+public:
+	StreamClip(shared_ptr<const vector<int16_t>> samples, int64_t firstSampleIndex, int sampleRate) :
+		samples(std::move(samples)),
+		firstSampleIndex(firstSampleIndex),
+		sampleRate(sampleRate)
+	{}
+
+	unique_ptr<AudioClip> clone() const override {
+		return make_unique<StreamClip>(*this);
+	}
+
+	int getSampleRate() const override {
+		return sampleRate;
+	}
+
+	size_type size() const override {
+		return firstSampleIndex + static_cast<size_type>(samples->size());
+	}
+
+private:
+	SampleReader createUnsafeSampleReader() const override {
+		return [samples = samples, firstSampleIndex = firstSampleIndex](size_type index) {
+			return static_cast<float>((*samples)[static_cast<size_t>(index - firstSampleIndex)]) / 32768.0f;
+		};
+	}
+
+	void readUnsafeBlock(size_type start, size_type count, value_type* out) const override {
+		int16SamplesToFloat(samples->data() + (start - firstSampleIndex), static_cast<size_t>(count), out);
+	}
+
+	shared_ptr<const vector<int16_t>> samples;
+	int64_t firstSampleIndex;
+	int sampleRate;
+};
+
+StreamingAnalyzer::StreamingAnalyzer(
+	const vector<QualityLevel>& qualityLevels,
+	double maxRealTimeFactor,
+	int sampleRate,
+	const optional<string>& dialog,
+	const ShapeSet& targetShapeSet
+) :
+	sampleRate(sampleRate),
+	animator(targetShapeSet),
+	qualityLevels(qualityLevels),
+	dialog(dialog),
+	dcOffset(sampleRate),
+	samples(std::make_shared<vector<int16_t>>())
+{
+	if (sampleRate <= 0) {
+		throw invalid_argument("Sample rate must be positive.");
+	}
+	if (qualityLevels.empty()) {
+		throw invalid_argument("A stream needs at least one quality level.");
+	}
+	this->qualityLevels.push_back({ loudnessLevelName, nullptr });
+	utteranceRecognizers.resize(this->qualityLevels.size());
+	// The others are created when the stream switches to them
+	getUtteranceRecognizer();
+	fallbackRecognizer = make_unique<EnergyUtteranceRecognizer>();
+	if (maxRealTimeFactor > 0) {
+		qualityController.emplace(static_cast<int>(this->qualityLevels.size()), maxRealTimeFactor);
+	}
+}
+
+void StreamingAnalyzer::push(const int16_t* newSamples, size_t sampleCount) {
+	if (finished) throw std::logic_error("Stream has already ended.");
+
+	samples->insert(samples->end(), newSamples, newSamples + sampleCount);
+	dcOffset.add(newSamples, sampleCount);
+	detectVoiceActivity(false);
+	releaseCues(false);
+	discardProcessedSamples();
+}
+
+void StreamingAnalyzer::pushActivity(
+	const int16_t* capturedSamples,
+	size_t sampleCount,
+	gsl::span<const uint8_t> frameActivity
+) {
+	if (finished) throw std::logic_error("Stream has already ended.");
+
+	const auto getFrameStart = [&](int64_t frame) { return frame * sampleRate / 100; };
+	const int64_t firstFrame = voiceActivityDetector.getTime().count();
+	if (getFrameStart(firstFrame) != discardedSampleCount + static_cast<int64_t>(samples->size())) {
+		throw invalid_argument("Frame activity must start where voice activity detection stands.");
+	}
+	int64_t capturedSampleCount = 0;
+	for (std::ptrdiff_t i = 0; i < frameActivity.size(); ++i) {
+		if (frameActivity[i] > static_cast<uint8_t>(FrameActivity::Uncaptured)) {
+			throw invalid_argument(fmt::format("Invalid frame activity {}.", frameActivity[i]));
+		}
+		if (frameActivity[i] != static_cast<uint8_t>(FrameActivity::Uncaptured)) {
+			capturedSampleCount += getFrameStart(firstFrame + i + 1) - getFrameStart(firstFrame + i);
+		}
+	}
+	if (capturedSampleCount != static_cast<int64_t>(sampleCount)) {
+		throw invalid_argument(fmt::format(
+			"The captured frames span {} samples, not {}.", capturedSampleCount, sampleCount
+		));
+	}
+
+	vector<uint8_t> isActive;
+	isActive.reserve(static_cast<size_t>(frameActivity.size()));
+	const int16_t* frameSamples = capturedSamples;
+	for (std::ptrdiff_t i = 0; i < frameActivity.size(); ++i) {
+		const auto frameLength = static_cast<size_t>(getFrameStart(firstFrame + i + 1) - getFrameStart(firstFrame + i));
+		const auto activity = static_cast<FrameActivity>(frameActivity[i]);
+		if (activity == FrameActivity::Uncaptured) {
+			samples->insert(samples->end(), frameLength, 0);
+		} else {
+			// Only what was captured counts toward the DC offset
+			samples->insert(samples->end(), frameSamples, frameSamples + frameLength);
+			dcOffset.add(frameSamples, frameLength);
+			frameSamples += frameLength;
+		}
+		isActive.push_back(activity == FrameActivity::Active ? 1 : 0);
+	}
+
+	const vector<TimeRange> utterances = voiceActivityDetector.processActivity(isActive);
+	pendingUtterances.insert(pendingUtterances.end(), utterances.begin(), utterances.end());
+	if (pendingUtterances.empty()) {
+		continueOpenUtterance();
+	}
+	releaseCues(false);
+	discardProcessedSamples();
+}
+
+bool StreamingAnalyzer::recognizeNextUtterance() {
+	if (pendingUtterances.empty()) return false;
+
+	const TimeRange utterance = pendingUtterances.front();
+	pendingUtterances.pop_front();
+	recognizeUtterance(utterance);
+	// The open utterance is only recognized early once the utterances before it are done
+	if (pendingUtterances.empty()) {
+		continueOpenUtterance();
+	}
+	releaseCues(false);
+	discardProcessedSamples();
+	return true;
+}
+
+optional<TimeRange> StreamingAnalyzer::getPendingUtterance() const {
+	if (pendingUtterances.empty()) return boost::none;
+	return pendingUtterances.front();
+}
+
+void StreamingAnalyzer::setFallback(bool fallback) {
+	if (fallback == this->fallback) return;
+
+	this->fallback = fallback;
+	if (fallback && continuedUtteranceStart) {
+		discardContinuedUtterance();
+	}
+}
+
+bool StreamingAnalyzer::isRecognizing() const {
+	return !fallback && qualityLevels[qualityLevel].recognizer;
+}
+
+const string& StreamingAnalyzer::getQualityLevelName() const {
+	return qualityLevels[qualityLevel].name;
+}
+
+double StreamingAnalyzer::getRealTimeFactor() const {
+	return qualityController ? qualityController->getRealTimeFactor() : 0.0;
+}
+
+vector<Timed<Shape>> StreamingAnalyzer::poll() {
+	vector<Timed<Shape>> result;
+	result.swap(releasedCues);
+	return result;
+}
+
+const vector<Timed<Shape>>& StreamingAnalyzer::getTentativeCues() {
+	if (tentativeCuesOutdated) {
+		tentativeCues = finished ? vector<Timed<Shape>>() : animator.preview(tentativePhones);
+		tentativeCuesOutdated = false;
+	}
+	return tentativeCues;
+}
+
+void StreamingAnalyzer::finish() {
+	if (finished) return;
+
+	detectVoiceActivity(true);
+	for (; !pendingUtterances.empty(); pendingUtterances.pop_front()) {
+		recognizeUtterance(pendingUtterances.front());
+	}
+	releaseCues(true);
+	finished = true;
+	tentativeCuesOutdated = true;
+	utteranceRecognizers.clear();
+	discardedSampleCount += static_cast<int64_t>(samples->size());
+	samples->clear();
+}
+
+centiseconds StreamingAnalyzer::getDuration() const {
+	return createClip()->getTruncatedRange().getEnd();
+}
+
+vector<uint8_t> StreamingAnalyzer::serialize() const {
+	if (finished) throw std::logic_error("Stream has already ended.");
+
+	vector<uint8_t> bytes;
+	StateWriter writer(bytes);
+	writer.writeUInt(stateMagic);
+	writer.writeUInt(stateVersion);
+	writer.writeUInt(static_cast<uint32_t>(sampleRate));
+	writer.writeUInt(dialog ? 1 : 0, 1);
+	if (dialog) {
+		writer.writeUInt(static_cast<uint32_t>(dialog->size()));
+		bytes.insert(bytes.end(), dialog->begin(), dialog->end());
+	}
+	writer.writeUInt(static_cast<uint32_t>(qualityLevel));
+	writer.writeDouble(dcOffset.getSampleCount());
+	writer.writeDouble(dcOffset.getMean());
+
+	const VadState vadState = voiceActivityDetector.getState();
+	writer.writeUInt(static_cast<uint32_t>(vadState.detectorValues.size()));
+	for (int32_t value : vadState.detectorValues) {
+		writer.writeUInt(static_cast<uint32_t>(value));
+	}
+	writer.writeUInt(static_cast<uint32_t>(vadState.pendingSamples.size()));
+	for (int16_t sample : vadState.pendingSamples) {
+		writer.writeUInt(static_cast<uint16_t>(sample), 2);
+	}
+	writer.writeTime(vadState.time);
+	writer.writeUInt(vadState.openSegment ? 1 : 0, 1);
+	if (vadState.openSegment) {
+		writer.writeTimeRange(*vadState.openSegment);
+	}
+
+	writer.writeUInt(static_cast<uint32_t>(pendingUtterances.size()));
+	for (const TimeRange& utterance : pendingUtterances) {
+		writer.writeTimeRange(utterance);
+	}
+
+	const int64_t firstSampleIndex = getFirstNeededSampleIndex();
+	writer.writeUInt64(static_cast<uint64_t>(firstSampleIndex));
+	const auto keptSamples = samples->begin() + (firstSampleIndex - discardedSampleCount);
+	writer.writeUInt(static_cast<uint32_t>(samples->end() - keptSamples));
+	for (auto it = keptSamples; it != samples->end(); ++it) {
+		writer.writeUInt(static_cast<uint16_t>(*it), 2);
+	}
+
+	const IncrementalAnimator::State animatorState = animator.getState();
+	writer.writeTime(animatorState.windowStart);
+	writer.writeTime(animatorState.releasedEnd);
+	writer.writeUInt(static_cast<uint32_t>(animatorState.phones.size()));
+	for (const Timed<Phone>& timedPhone : animatorState.phones) {
+		writer.writeTimeRange(timedPhone.getTimeRange());
+		writer.writeUInt(static_cast<uint32_t>(timedPhone.getValue()), 1);
+	}
+
+	writer.writeUInt(static_cast<uint32_t>(releasedCues.size()));
+	for (const Timed<Shape>& cue : releasedCues) {
+		writer.writeTimeRange(cue.getTimeRange());
+		writer.writeUInt(static_cast<uint32_t>(cue.getValue()), 1);
+	}
+
+	const unique_ptr<UtteranceRecognizer>& utteranceRecognizer = utteranceRecognizers[qualityLevel];
+	const vector<float> carriedState = utteranceRecognizer ? utteranceRecognizer->getCarriedState() : vector<float>();
+	writer.writeUInt(static_cast<uint32_t>(carriedState.size()));
+	for (float value : carriedState) {
+		writer.writeFloat(value);
+	}
+	return bytes;
+}
+
+unique_ptr<StreamingAnalyzer> StreamingAnalyzer::deserialize(
+	gsl::span<const uint8_t> bytes,
+	const vector<QualityLevel>& qualityLevels,
+	double maxRealTimeFactor,
+	const ShapeSet& targetShapeSet
+) {
+	StateReader reader(bytes);
+	if (reader.readUInt() != stateMagic) {
+		throw runtime_error("Not a stream state.");
+	}
+	const uint32_t version = reader.readUInt();
+	if (version != stateVersion) {
+		throw runtime_error(fmt::format("Unsupported stream state version {}.", version));
+	}
+
+	const int sampleRate = static_cast<int>(reader.readUInt());
+	optional<string> dialog;
+	if (reader.readUInt(1)) {
+		dialog = reader.readString(reader.readCount(1));
+	}
+	auto stream = make_unique<StreamingAnalyzer>(qualityLevels, maxRealTimeFactor, sampleRate, dialog, targetShapeSet);
+
+	// The levels may differ from those of the serialized stream's process
+	const int qualityLevel = static_cast<int>(reader.readUInt());
+	if (stream->qualityController) {
+		stream->qualityController->setLevel(qualityLevel);
+		stream->qualityLevel = stream->qualityController->getLevel();
+	}
+	const double dcSampleCount = reader.readDouble();
+	stream->dcOffset.setState(dcSampleCount, reader.readDouble());
+
+	VadState vadState;
+	vadState.detectorValues.resize(reader.readCount(4));
+	for (int32_t& value : vadState.detectorValues) {
+		value = static_cast<int32_t>(reader.readUInt());
+	}
+	vadState.pendingSamples.resize(reader.readCount(2));
+	for (int16_t& sample : vadState.pendingSamples) {
+		sample = static_cast<int16_t>(reader.readUInt(2));
+	}
+	vadState.time = reader.readTime();
+	if (reader.readUInt(1)) {
+		vadState.openSegment = reader.readTimeRange();
+	}
+	stream->voiceActivityDetector.setState(vadState);
+
+	for (size_t count = reader.readCount(8); count > 0; --count) {
+		stream->pendingUtterances.push_back(reader.readTimeRange());
+	}
+
+	const int64_t firstSampleIndex = static_cast<int64_t>(reader.readUInt64());
+	if (firstSampleIndex < 0) {
+		throw runtime_error("Stream state has an invalid sample index.");
+	}
+	stream->discardedSampleCount = firstSampleIndex;
+	stream->samples->resize(reader.readCount(2));
+	for (int16_t& sample : *stream->samples) {
+		sample = static_cast<int16_t>(reader.readUInt(2));
+	}
+
+	// The samples must reach back to the padding of every utterance yet to be recognized, as
+	// getFirstNeededSampleIndex() keeps them, and on to the time up to which VAD has run
+	centiseconds neededStart = vadState.time;
+	if (vadState.openSegment) {
+		neededStart = std::min(neededStart, vadState.openSegment->getStart());
+	}
+	for (const TimeRange& utterance : stream->pendingUtterances) {
+		neededStart = std::min(neededStart, utterance.getStart());
+	}
+	const centiseconds keptStart = std::max(neededStart - utterancePadding - 1_cs, 0_cs);
+	if (firstSampleIndex > static_cast<int64_t>(keptStart.count()) * sampleRate / 100) {
+		throw runtime_error("Stream state is missing samples that its utterances need.");
+	}
+	const int64_t sampleCount = firstSampleIndex + static_cast<int64_t>(stream->samples->size());
+	if (static_cast<int64_t>(vadState.time.count()) * sampleRate > sampleCount * 100) {
+		throw runtime_error("Stream state has voice activity beyond its samples.");
+	}
+
+	IncrementalAnimator::State animatorState;
+	animatorState.windowStart = reader.readTime();
+	animatorState.releasedEnd = reader.readTime();
+	for (size_t count = reader.readCount(9); count > 0; --count) {
+		const TimeRange timeRange = reader.readTimeRange();
+		const uint32_t phone = reader.readUInt(1);
+		if (phone > static_cast<uint32_t>(Phone::Noise)) {
+			throw runtime_error(fmt::format("Unknown phone: {}", phone));
+		}
+		animatorState.phones.set(timeRange, static_cast<Phone>(phone));
+	}
+	stream->animator.setState(animatorState);
+
+	for (size_t count = reader.readCount(9); count > 0; --count) {
+		const TimeRange timeRange = reader.readTimeRange();
+		const uint32_t shape = reader.readUInt(1);
+		if (shape >= static_cast<uint32_t>(Shape::EndSentinel)) {
+			throw runtime_error(fmt::format("Unknown mouth shape: {}", shape));
+		}
+		stream->releasedCues.emplace_back(timeRange, static_cast<Shape>(shape));
+	}
+
+	vector<float> carriedState(reader.readCount(4));
+	for (float& value : carriedState) {
+		value = reader.readFloat();
+	}
+	if (!reader.atEnd()) {
+		throw runtime_error("Stream state has trailing bytes.");
+	}
+	stream->getUtteranceRecognizer().setCarriedState(carriedState);
+	stream->tentativeCuesOutdated = true;
+	return stream;
+}
+
+unique_ptr<AudioClip> StreamingAnalyzer::createClip() const {
+	return make_unique<StreamClip>(samples, discardedSampleCount, sampleRate);
+}
+
+void StreamingAnalyzer::detectVoiceActivity(bool endOfStream) {
+	const unique_ptr<AudioClip> vadClip = createClip() | resample(VoiceActivityDetector::samplingRate);
+
+	// Only process VAD frames whose samples no longer depend on audio yet to come.
+	// At the end of the stream, process as much as batch analysis would.
+	const int64_t sampleCount = discardedSampleCount + static_cast<int64_t>(samples->size());
+	const centiseconds vadEnd = endOfStream
+		? vadClip->getTruncatedRange().getEnd()
+		: centiseconds(sampleCount * 100 / sampleRate);
+
+	vector<TimeRange> utterances;
+	const centiseconds vadStart = voiceActivityDetector.getTime();
+	if (vadEnd > vadStart) {
+		const unique_ptr<AudioClip> newAudio = vadClip->clone() | segment(TimeRange(vadStart, vadEnd));
+		vector<int16_t> buffer;
+		utterances = voiceActivityDetector.process(get16bitSamples(*newAudio, buffer));
+	}
+	if (endOfStream) {
+		const vector<TimeRange> finalUtterances = voiceActivityDetector.finish();
+		utterances.insert(utterances.end(), finalUtterances.begin(), finalUtterances.end());
+	}
+
+	pendingUtterances.insert(pendingUtterances.end(), utterances.begin(), utterances.end());
+	if (!endOfStream && pendingUtterances.empty()) {
+		continueOpenUtterance();
+	}
+}
+
+void StreamingAnalyzer::recognizeUtterance(const TimeRange& utterance) {
+	if (continuedUtteranceStart && *continuedUtteranceStart != utterance.getStart()) {
+		discardContinuedUtterance();
+	}
+	// Early recognition counts toward the utterance's recognition time
+	const duration<double> continuedTime = continuedUtteranceStart ? continuedUtteranceTime : duration<double>(0.0);
+	continuedUtteranceStart = boost::none;
+	continuedUtteranceTime = duration<double>(0.0);
+	setTentativePhones(Timeline<Phone>());
+
+	TimeRange relativeUtterance;
+	const unique_ptr<AudioClip> utteranceClip = cutUtterance(utterance, relativeUtterance);
+	NullProgressSink progressSink;
+	const bool timed = qualityController && !fallback;
+	const auto start = steady_clock::now();
+	Timeline<Phone> utterancePhones =
+		getUtteranceRecognizer().recognizeUtterance(*utteranceClip, relativeUtterance, progressSink);
+	if (timed) {
+		updateQualityLevel(utterance.getDuration(), steady_clock::now() - start + continuedTime);
+	}
+	utterancePhones.shift(utterance.getStart() - relativeUtterance.getStart());
+	animator.addPhones(utterancePhones);
+	tentativeCuesOutdated = true;
+}
+
+UtteranceRecognizer& StreamingAnalyzer::getUtteranceRecognizer() {
+	const Recognizer* recognizer = qualityLevels[qualityLevel].recognizer;
+	if (fallback || !recognizer) return *fallbackRecognizer;
+
+	unique_ptr<UtteranceRecognizer>& utteranceRecognizer = utteranceRecognizers[qualityLevel];
+	if (!utteranceRecognizer) {
+		utteranceRecognizer = recognizer->createUtteranceRecognizer(dialog, sampleRate);
+	}
+	return *utteranceRecognizer;
+}
+
+void StreamingAnalyzer::updateQualityLevel(centiseconds speech, duration<double> time) {
+	const int previousLevel = qualityLevel;
+	if (!qualityController->addMeasurement(speech, time)) return;
+
+	if (continuedUtteranceStart) {
+		discardContinuedUtterance();
+	}
+	qualityLevel = qualityController->getLevel();
+	if (qualityLevel > previousLevel) {
+		logging::infoFormat("Recognition of stream too slow. Switching from {} to {}.",
+			qualityLevels[previousLevel].name, getQualityLevelName());
+	} else {
+		logging::infoFormat("Recognition of stream fast enough again. Returning from {} to {}.",
+			qualityLevels[previousLevel].name, getQualityLevelName());
+	}
+}
+
+void StreamingAnalyzer::continueOpenUtterance() {
+	const optional<TimeRange>& openSegment = voiceActivityDetector.getOpenSegment();
+	if (continuedUtteranceStart && (!openSegment || *continuedUtteranceStart != openSegment->getStart())) {
+		// The utterance was dropped as too short
+		discardContinuedUtterance();
+	}
+	if (!openSegment || !isRecognizing()) return;
+
+	TimeRange relativeUtterance;
+	const unique_ptr<AudioClip> utteranceClip = cutUtterance(*openSegment, relativeUtterance);
+	UtteranceRecognizer& utteranceRecognizer = getUtteranceRecognizer();
+	const auto start = steady_clock::now();
+	utteranceRecognizer.continueUtterance(*utteranceClip, relativeUtterance);
+	continuedUtteranceTime += steady_clock::now() - start;
+	continuedUtteranceStart = openSegment->getStart();
+
+	Timeline<Phone> phones = utteranceRecognizer.getTentativePhones();
+	phones.shift(openSegment->getStart() - relativeUtterance.getStart());
+	setTentativePhones(phones);
+}
+
+void StreamingAnalyzer::discardContinuedUtterance() {
+	// Not the fallback's, which may just have been switched to
+	if (const unique_ptr<UtteranceRecognizer>& utteranceRecognizer = utteranceRecognizers[qualityLevel]) {
+		utteranceRecognizer->discardUtterance();
+	}
+	continuedUtteranceStart = boost::none;
+	continuedUtteranceTime = duration<double>(0.0);
+	setTentativePhones(Timeline<Phone>());
+}
+
+void StreamingAnalyzer::setTentativePhones(const Timeline<Phone>& phones) {
+	if (phones == tentativePhones) return;
+
+	tentativePhones = phones;
+	tentativeCuesOutdated = true;
+}
+
+unique_ptr<AudioClip> StreamingAnalyzer::cutUtterance(const TimeRange& utterance, TimeRange& relativeUtterance) const {
+	const unique_ptr<AudioClip> clip = createClip();
+
+	// Cut out the utterance with some padding, which is all the recognizer needs
+	const centiseconds discardedEnd(
+		(discardedSampleCount * 100 + sampleRate - 1) / sampleRate
+	);
+	TimeRange contextRange = utterance;
+	contextRange.grow(utterancePadding);
+	contextRange.trim(TimeRange(discardedEnd, clip->getTruncatedRange().getEnd()));
+
+	// The DC offset is tracked while samples are pushed, because the stream's beginning may already
+	// have been discarded and the utterance itself may be too short for a good estimate
+	relativeUtterance = utterance;
+	relativeUtterance.shift(-contextRange.getStart());
+	return clip->clone()
+		| segment(contextRange)
+		| addDcOffset(-dcOffset.getOffset());
+}
+
+void StreamingAnalyzer::releaseCues(bool endOfStream) {
+	// Until the stream ends, there may be speech from the next utterance on
+	const vector<Timed<Shape>> cues = endOfStream
+		? animator.finish(getDuration())
+		: animator.update(std::max(getNextUtteranceStart() - utterancePadding, 0_cs));
+	releasedCues.insert(releasedCues.end(), cues.begin(), cues.end());
+	if (!cues.empty()) tentativeCuesOutdated = true;
+}
+
+centiseconds StreamingAnalyzer::getNextUtteranceStart() const {
+	// Future utterances can't start before the oldest one not yet recognized, if any, or the open
+	// segment of voice activity, or else before the audio VAD has yet to process
+	if (!pendingUtterances.empty()) return pendingUtterances.front().getStart();
+	const optional<centiseconds> openSegmentStart = voiceActivityDetector.getOpenSegmentStart();
+	return openSegmentStart ? *openSegmentStart : voiceActivityDetector.getTime();
+}
+
+int64_t StreamingAnalyzer::getFirstNeededSampleIndex() const {
+	const centiseconds keptStart = getNextUtteranceStart() - utterancePadding - 1_cs;
+	if (keptStart <= 0_cs) return discardedSampleCount;
+
+	return std::max(discardedSampleCount, static_cast<int64_t>(keptStart.count()) * sampleRate / 100);
+}
+
+void StreamingAnalyzer::discardProcessedSamples() {
+	const int64_t keptSampleIndex = getFirstNeededSampleIndex();
+	const int64_t discardableSampleCount = keptSampleIndex - discardedSampleCount;
+	if (discardableSampleCount < minDiscardSampleCount) return;
+
+	samples->erase(samples->begin(), samples->begin() + discardableSampleCount);
+	discardedSampleCount = keptSampleIndex;
+}
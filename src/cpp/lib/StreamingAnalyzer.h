@@ -0,0 +1,200 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <cstdint>
+#include <span.h>
+#include "core/Shape.h"
+#include "time/Timeline.h"
+#include "audio/voiceActivityDetection.h"
+#include "audio/DcOffset.h"
+#include "animation/IncrementalAnimator.h"
+#include "recognition/Recognizer.h"
+#include "QualityController.h"
+
+// Analyzes audio incrementally while it is still being recorded.
+// Audio is pushed in chunks of any size. Each utterance is queued for recognition as soon as voice
+// activity detection closes it, and recognized by recognizeNextUtterance(), so that the caller can
+// take turns between many streams (see StreamScheduler). Its mouth cues are released once later
+// audio can no longer change them.
+// While an utterance is still open, its audio is passed on to recognizers that can start on it
+// early (see UtteranceRecognizer::continueUtterance()).
+// Animation is incremental, too; see IncrementalAnimator.
+// Under load, a stream can be switched to a fallback that animates its utterances from their
+// loudness alone (see EnergyUtteranceRecognizer).
+// Given a maximum real-time factor, a stream also keeps its own recognition fast enough by moving
+// between quality levels (see QualityController).
+// A stream's state can be serialized and continued elsewhere, e.g. in another worker. The state is
+// binary, with all integers little-endian:
+//
+//   magic          "LSSS"
+//   version        4 bytes, 1
+//   sample rate    4 bytes
+//   dialog         1 byte, 1 if there is one, then its length in bytes, 4 bytes, and its UTF-8 text
+//   quality level  4 bytes
+//   DC offset      the samples it weighs and the offset, as doubles of 8 bytes each
+//   VAD            the count and values of VadState::detectorValues, 4 bytes each, the count and
+//                  values of its pending samples, 2 bytes each, its time in centiseconds, 4 bytes,
+//                  and its open segment: 1 byte, 1 if there is one, then start and end, 4 bytes each
+//   utterances     the count of utterances awaiting recognition, then start and end of each
+//   samples        the index of the first sample kept, 8 bytes, then the count and the samples
+//   animation      the start of the animated window and the end of the cues released, then the
+//                  count of phones and, per phone, its start, end and phone, 1 byte
+//   cues           the count of cues finalized but not yet polled, then per cue start, end and
+//                  shape, 1 byte
+//   recognizer     the count and values of UtteranceRecognizer::getCarriedState(), as floats
+class StreamingAnalyzer {
+public:
+	// A recognizer a stream can use, named for reporting
+	struct QualityLevel {
+		std::string name;
+		const Recognizer* recognizer;
+	};
+
+	// Recognizes with the first quality level. If maxRealTimeFactor is positive, utterances are
+	// timed, and the stream moves to the next levels while recognizing them takes more than that
+	// many seconds per second of speech, ending with animation from loudness, and back once
+	// recognition is fast enough again. The levels must be ordered from the best to the cheapest.
+	StreamingAnalyzer(
+		const std::vector<QualityLevel>& qualityLevels,
+		double maxRealTimeFactor,
+		int sampleRate,
+		const boost::optional<std::string>& dialog,
+		const ShapeSet& targetShapeSet
+	);
+
+	// The voice activity of a 10 ms frame, detected before its audio reaches the stream
+	enum class FrameActivity : uint8_t {
+		Inactive = 0,
+		Active = 1,
+		// Inactive, and its samples weren't passed on; the stream fills in silence
+		Uncaptured = 2
+	};
+
+	// Appends 16-bit mono samples to the stream, queuing the utterances completed by them
+	void push(const int16_t* samples, size_t sampleCount);
+
+	// Appends audio whose voice activity was detected already, e.g. in the capture thread, so that
+	// the stream skips its own detection, queuing the utterances completed by it. There is one
+	// FrameActivity value per 10 ms frame, continuing where detection stands, and the samples of
+	// all frames but the uncaptured ones, in order. Frame i spans the samples from
+	// i * sampleRate / 100 on, rounded down.
+	// Throws if the audio pushed so far ends within a frame, or the samples don't fit the frames.
+	void pushActivity(const int16_t* capturedSamples, size_t sampleCount, gsl::span<const uint8_t> frameActivity);
+
+	bool hasPendingUtterance() const { return !pendingUtterances.empty(); }
+
+	// The oldest queued utterance, if any
+	boost::optional<TimeRange> getPendingUtterance() const;
+
+	// Recognizes the oldest queued utterance. Returns false, doing nothing, if there is none.
+	// An utterance whose recognition fails is dropped.
+	bool recognizeNextUtterance();
+
+	// Returns the mouth cues finalized since the last call
+	std::vector<Timed<Shape>> poll();
+
+	// Returns provisional mouth cues following the finalized ones, animating what has been
+	// recognized so far, including guesses for the open utterance. They replace the tentative cues
+	// of earlier calls, and are replaced in turn once the cues they cover are finalized.
+	const std::vector<Timed<Shape>>& getTentativeCues();
+
+	// Ends the stream, recognizing the queued utterances and the remaining audio.
+	// Afterwards, poll() returns all mouth cues not returned before.
+	void finish();
+
+	bool isFinished() const { return finished; }
+
+	// Whether utterances recognized from now on are animated from their loudness instead of being
+	// recognized. Switching to the fallback discards the early recognition of the open utterance.
+	void setFallback(bool fallback);
+	bool isFallback() const { return fallback; }
+
+	// Whether utterances are recognized rather than animated from loudness, either because of the
+	// fallback or because the quality level requires it
+	bool isRecognizing() const;
+
+	// The name of the quality level utterances are recognized with, "loudness" for the level
+	// following the given ones
+	const std::string& getQualityLevelName() const;
+
+	// Seconds of recognition per second of speech at the current quality level, smoothed. 0 until
+	// measured or without a maximum real-time factor.
+	double getRealTimeFactor() const;
+
+	// The duration of the audio pushed so far
+	centiseconds getDuration() const;
+
+	// Returns the state of the stream, which deserialize() can continue from, e.g. in another
+	// process. Only the audio from
+	// the start of the next utterance on is kept. The recognition of the open utterance so far
+	// isn't, so the continued stream recognizes it again from its start. Tentative cues are
+	// animated anew, and whether the stream falls back is up to the new scheduler.
+	// Throws once the stream has finished.
+	std::vector<uint8_t> serialize() const;
+
+	// Continues a stream from a state returned by serialize(), with its sample rate and dialog.
+	// Throws if the bytes aren't a stream state.
+	static std::unique_ptr<StreamingAnalyzer> deserialize(
+		gsl::span<const uint8_t> bytes,
+		const std::vector<QualityLevel>& qualityLevels,
+		double maxRealTimeFactor,
+		const ShapeSet& targetShapeSet
+	);
+
+private:
+	class StreamClip;
+
+	std::unique_ptr<AudioClip> createClip() const;
+	void detectVoiceActivity(bool endOfStream);
+	void recognizeUtterance(const TimeRange& utterance);
+	void continueOpenUtterance();
+	void discardContinuedUtterance();
+	// The recognizer of the current quality level, created on first use, or the fallback
+	UtteranceRecognizer& getUtteranceRecognizer();
+	void updateQualityLevel(centiseconds speech, std::chrono::duration<double> time);
+	void setTentativePhones(const Timeline<Phone>& phones);
+	// Cuts an utterance with its padding out of the stream, returning the utterance's range in the cut
+	std::unique_ptr<AudioClip> cutUtterance(const TimeRange& utterance, TimeRange& relativeUtterance) const;
+	void releaseCues(bool endOfStream);
+	centiseconds getNextUtteranceStart() const;
+	// The index of the first sample that recognizing the utterances yet to come may need
+	int64_t getFirstNeededSampleIndex() const;
+	void discardProcessedSamples();
+
+	int sampleRate;
+	IncrementalAnimator animator;
+	// Followed by the loudness level, whose recognizer is null
+	std::vector<QualityLevel> qualityLevels;
+	// One per quality level, as created by their recognizers
+	std::vector<std::unique_ptr<UtteranceRecognizer>> utteranceRecognizers;
+	boost::optional<std::string> dialog;
+	std::unique_ptr<UtteranceRecognizer> fallbackRecognizer;
+	bool fallback = false;
+	// Only set given a maximum real-time factor
+	boost::optional<QualityController> qualityController;
+	int qualityLevel = 0;
+	VoiceActivityDetector voiceActivityDetector;
+	RunningDcOffset dcOffset;
+
+	// Utterances detected but not yet recognized, in chronological order
+	std::deque<TimeRange> pendingUtterances;
+
+	// Samples not yet discarded, starting at sample index discardedSampleCount
+	std::shared_ptr<std::vector<int16_t>> samples;
+	int64_t discardedSampleCount = 0;
+
+	// The start of the open utterance passed to the recognizer, if any
+	boost::optional<centiseconds> continuedUtteranceStart;
+	// The time spent recognizing the open utterance early
+	std::chrono::duration<double> continuedUtteranceTime { 0.0 };
+	// The phones guessed for the open utterance, and whether tentativeCues must be animated anew
+	Timeline<Phone> tentativePhones;
+	std::vector<Timed<Shape>> tentativeCues;
+	bool tentativeCuesOutdated = false;
+
+	std::vector<Timed<Shape>> releasedCues;
+	bool finished = false;
+};
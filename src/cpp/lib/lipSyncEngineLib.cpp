@@ -2,9 +2,17 @@
 #include "core/Phone.h"
 #include "tools/textFiles.h"
 #include "animation/mouthAnimation.h"
+#include "animation/IncrementalAnimator.h"
+#include "tools/parallel.h"
+#include "recognition/EnergyUtteranceRecognizer.h"
+#include "recognition/pocketSphinxTools.h"
+#include "audio/voiceActivityDetection.h"
+#include "audio/SampleRateConverter.h"
+#include "audio/DcOffset.h"
 
 using boost::optional;
 using std::string;
+using std::vector;
 
 JoiningContinuousTimeline<Shape> animateAudioClip(
 	const AudioClip& audioClip,
@@ -12,11 +20,77 @@ JoiningContinuousTimeline<Shape> animateAudioClip(
 	const Recognizer& recognizer,
 	const ShapeSet& targetShapeSet,
 	int maxThreadCount,
+	ProgressSink& progressSink,
+	const CueSink& cueSink,
+	SpeakerProfile* speakerProfile)
+{
+	if (!cueSink) {
+		const BoundedTimeline<Phone> phones =
+			recognizer.recognizePhones(audioClip, dialog, speakerProfile, maxThreadCount, progressSink, nullptr);
+		JoiningContinuousTimeline<Shape> result = animate(phones, targetShapeSet, maxThreadCount);
+		return result;
+	}
+
+	// Animate each utterance as it is recognized
+	IncrementalAnimator animator(targetShapeSet);
+	JoiningContinuousTimeline<Shape> result(audioClip.getTruncatedRange(), Shape::X);
+	const auto releaseCues = [&](const vector<Timed<Shape>>& cues) {
+		if (cues.empty()) return;
+		for (const Timed<Shape>& cue : cues) {
+			result.set(cue);
+		}
+		cueSink(cues);
+	};
+	recognizer.recognizePhones(
+		audioClip, dialog, speakerProfile, maxThreadCount, progressSink,
+		[&](const Timeline<Phone>& phones, centiseconds knownEnd) {
+			animator.addPhones(phones);
+			releaseCues(animator.update(knownEnd));
+		}
+	);
+	releaseCues(animator.finish(audioClip.getTruncatedRange().getEnd()));
+	return result;
+}
+
+JoiningContinuousTimeline<Shape> previewAudioClip(const AudioClip& audioClip, const ShapeSet& targetShapeSet) {
+	// Utterances are detected as for recognition, but only their loudness is looked at
+	const std::unique_ptr<AudioClip> preparedClip = audioClip.clone()
+		| resample(sphinxSampleRate)
+		| removeDcOffsetTo16bit();
+	NullProgressSink progressSink;
+	EnergyUtteranceRecognizer recognizer;
+	BoundedTimeline<Phone> phones(audioClip.getTruncatedRange());
+	for (const auto& timedUtterance : detectVoiceActivity(*preparedClip, progressSink)) {
+		const Timeline<Phone> utterancePhones =
+			recognizer.recognizeUtterance(*preparedClip, timedUtterance.getTimeRange(), progressSink);
+		for (const auto& timedPhone : utterancePhones) {
+			phones.set(timedPhone);
+		}
+	}
+	return animate(phones, targetShapeSet);
+}
+
+vector<JoiningContinuousTimeline<Shape>> animateAudioClips(
+	const vector<RecognitionInput>& inputs,
+	const Recognizer& recognizer,
+	const ShapeSet& targetShapeSet,
+	int maxThreadCount,
 	ProgressSink& progressSink)
 {
-	const BoundedTimeline<Phone> phones =
-		recognizer.recognizePhones(audioClip, dialog, maxThreadCount, progressSink);
-	JoiningContinuousTimeline<Shape> result = animate(phones, targetShapeSet);
+	const vector<BoundedTimeline<Phone>> phones =
+		recognizer.recognizePhonesBatch(inputs, maxThreadCount, progressSink);
+
+	vector<boost::optional<JoiningContinuousTimeline<Shape>>> animations(phones.size());
+	vector<std::function<void()>> tasks;
+	for (size_t i = 0; i < phones.size(); ++i) {
+		tasks.push_back([&, i] { animations[i] = animate(phones[i], targetShapeSet); });
+	}
+	runTasksInParallel(tasks, maxThreadCount);
+
+	vector<JoiningContinuousTimeline<Shape>> result;
+	for (auto& animation : animations) {
+		result.push_back(std::move(*animation));
+	}
 	return result;
 }
 
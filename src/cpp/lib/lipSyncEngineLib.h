@@ -6,13 +6,35 @@
 #include "tools/progress.h"
 #include "animation/targetShapeSet.h"
 #include "recognition/Recognizer.h"
+#include <functional>
 
+// Receives mouth cues that are final, in chronological order
+using CueSink = std::function<void(const std::vector<Timed<Shape>>& cues)>;
+
+// If cueSink is set, it receives the mouth cues as soon as they are final: after each utterance
+// is recognized and no later phones can change them. The cues it receives make up the result.
+// If speakerProfile is set, recognition starts from it and updates it; see RecognitionInput.
 JoiningContinuousTimeline<Shape> animateAudioClip(
 	const AudioClip& audioClip,
 	const boost::optional<std::string>& dialog,
 	const Recognizer& recognizer,
 	const ShapeSet& targetShapeSet,
 	int maxThreadCount,
+	ProgressSink& progressSink,
+	const CueSink& cueSink = nullptr,
+	SpeakerProfile* speakerProfile = nullptr);
+
+// Guesses the animation of a clip from its loudness alone (see EnergyUtteranceRecognizer), in a
+// tiny fraction of the time of recognition, e.g. to show while the clip is being analyzed.
+JoiningContinuousTimeline<Shape> previewAudioClip(const AudioClip& audioClip, const ShapeSet& targetShapeSet);
+
+// Animates many clips at once, returning one animation per input.
+// The setup cost of recognition is shared across all clips; see Recognizer::recognizePhonesBatch.
+std::vector<JoiningContinuousTimeline<Shape>> animateAudioClips(
+	const std::vector<RecognitionInput>& inputs,
+	const Recognizer& recognizer,
+	const ShapeSet& targetShapeSet,
+	int maxThreadCount,
 	ProgressSink& progressSink);
 
 // animateWaveFile removed - not needed for WASM PCM→JSON workflow
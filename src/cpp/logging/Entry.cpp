@@ -1,30 +1,17 @@
 #include "Entry.h"
 
-#include <thread>
-#include <mutex>
-#include <unordered_map>
+#include <atomic>
 
-using std::lock_guard;
-using std::unordered_map;
 using std::string;
 
 namespace logging {
 
 	// Returns an int representing the current thread.
-	// This used to be a simple thread_local variable, but Xcode doesn't support that yet
+	// Thread-local, so that creating an entry doesn't contend for a lock.
 	int getThreadCounter() {
-		using thread_id = std::thread::id;
-
-		static std::mutex counterMutex;
-		lock_guard<std::mutex> lock(counterMutex);
-
-		static unordered_map<thread_id, int> threadCounters;
-		static int lastThreadId = 0;
-		thread_id threadId = std::this_thread::get_id();
-		if (threadCounters.find(threadId) == threadCounters.end()) {
-			threadCounters.insert({ threadId, ++lastThreadId });
-		}
-		return threadCounters.find(threadId)->second;
+		static std::atomic<int> lastThreadId(0);
+		thread_local const int threadId = ++lastThreadId;
+		return threadId;
 	}
 
 	Entry::Entry(Level level, const string& message) :
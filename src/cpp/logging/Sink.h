@@ -8,6 +8,8 @@ namespace logging {
 	public:
 		virtual ~Sink() = default;
 		virtual void receive(const Entry& entry) = 0;
+		// The lowest level this sink may pass on. Entries below it are never formatted.
+		virtual Level getMinLevel() const { return Level::Trace; }
 	};
 
 }
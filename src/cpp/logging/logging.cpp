@@ -1,6 +1,8 @@
 #include "logging.h"
 #include "tools/tools.h"
 #include <mutex>
+#include <atomic>
+#include <algorithm>
 #include "Entry.h"
 
 using namespace logging;
@@ -19,12 +21,25 @@ vector<shared_ptr<Sink>>& getSinks() {
 	return sinks;
 }
 
+// The lowest level any sink accepts; EndSentinel while there are no sinks
+std::atomic<Level> minLevel(Level::EndSentinel);
+
+// Must be called with the log mutex held
+void updateMinLevel() {
+	Level level = Level::EndSentinel;
+	for (const auto& sink : getSinks()) {
+		level = std::min(level, sink->getMinLevel());
+	}
+	minLevel.store(level, std::memory_order_relaxed);
+}
+
 bool logging::addSink(shared_ptr<Sink> sink) {
 	lock_guard<std::mutex> lock(getLogMutex());
 
 	auto& sinks = getSinks();
 	if (std::find(sinks.begin(), sinks.end(), sink) == sinks.end()) {
 		sinks.push_back(sink);
+		updateMinLevel();
 		return true;
 	}
 	return false;
@@ -37,11 +52,16 @@ bool logging::removeSink(std::shared_ptr<Sink> sink) {
 	const auto it = std::find(sinks.begin(), sinks.end(), sink);
 	if (it != sinks.end()) {
 		sinks.erase(it);
+		updateMinLevel();
 		return true;
 	}
 	return false;
 }
 
+bool logging::isEnabled(Level level) {
+	return level >= minLevel.load(std::memory_order_relaxed);
+}
+
 void logging::log(const Entry& entry) {
 	lock_guard<std::mutex> lock(getLogMutex());
 	for (auto& sink : getSinks()) {
@@ -50,6 +70,7 @@ void logging::log(const Entry& entry) {
 }
 
 void logging::log(Level level, const string& message) {
+	if (!isEnabled(level)) return;
 	const Entry entry = Entry(level, message);
 	log(entry);
 }
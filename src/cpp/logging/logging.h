@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include "tools/EnumConverter.h"
 #include "Sink.h"
 #include "Level.h"
@@ -10,12 +12,17 @@ namespace logging {
 
 	bool removeSink(std::shared_ptr<Sink> sink);
 
+	// Returns whether any sink accepts entries of the given level.
+	// Lock-free, so hot loops can skip building messages nobody will see.
+	bool isEnabled(Level level);
+
 	void log(const Entry& entry);
 
 	void log(Level level, const std::string& message);
 
 	template<typename... Args>
 	void logFormat(Level level, fmt::CStringRef format, const Args&... args) {
+		if (!isEnabled(level)) return;
 		log(level, fmt::format(format, args...));
 	}
 
@@ -1,9 +1,11 @@
 #include "sinks.h"
 #include <iostream>
+#include <algorithm>
 #include "Entry.h"
 
 using std::string;
 using std::shared_ptr;
+using std::vector;
 
 namespace logging {
 
@@ -18,6 +20,10 @@ namespace logging {
 		}
 	}
 
+	Level LevelFilter::getMinLevel() const {
+		return std::max(minLevel, innerSink->getMinLevel());
+	}
+
 	StreamSink::StreamSink(shared_ptr<std::ostream> stream, shared_ptr<Formatter> formatter) :
 		stream(stream),
 		formatter(formatter)
@@ -32,4 +38,52 @@ namespace logging {
 		StreamSink(std::shared_ptr<std::ostream>(&std::cerr, [](void*) {}), formatter)
 	{}
 
+	AsyncSink::AsyncSink(shared_ptr<Sink> innerSink, size_t maxPendingCount) :
+		innerSink(innerSink),
+		maxPendingCount(maxPendingCount),
+		thread([this] { drain(); })
+	{}
+
+	AsyncSink::~AsyncSink() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		entriesPending.notify_one();
+		thread.join();
+	}
+
+	void AsyncSink::receive(const Entry& entry) {
+		{
+			// Block rather than grow without bounds if output can't keep up
+			std::unique_lock<std::mutex> lock(mutex);
+			spaceAvailable.wait(lock, [this] { return pending.size() < maxPendingCount; });
+			pending.push_back(entry);
+		}
+		entriesPending.notify_one();
+	}
+
+	Level AsyncSink::getMinLevel() const {
+		return innerSink->getMinLevel();
+	}
+
+	void AsyncSink::drain() {
+		vector<Entry> entries;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				entriesPending.wait(lock, [this] { return stopping || !pending.empty(); });
+				if (pending.empty()) return;
+				// Take the whole queue so producers never wait for output
+				std::swap(entries, pending);
+			}
+			spaceAvailable.notify_all();
+
+			for (const Entry& entry : entries) {
+				innerSink->receive(entry);
+			}
+			entries.clear();
+		}
+	}
+
 }
@@ -2,6 +2,10 @@
 
 #include "Sink.h"
 #include <memory>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include "Formatter.h"
 
 namespace logging {
@@ -11,6 +15,7 @@ namespace logging {
 	public:
 		LevelFilter(std::shared_ptr<Sink> innerSink, Level minLevel);
 		void receive(const Entry& entry) override;
+		Level getMinLevel() const override;
 	private:
 		std::shared_ptr<Sink> innerSink;
 		Level minLevel;
@@ -30,4 +35,26 @@ namespace logging {
 		explicit StdErrSink(std::shared_ptr<Formatter> formatter);
 	};
 
+	// Passes entries on to the inner sink from a background thread.
+	// Logging threads only append to a queue; formatting and output happen off their path.
+	// Entries still pending on destruction are written before the thread stops.
+	class AsyncSink : public Sink {
+	public:
+		explicit AsyncSink(std::shared_ptr<Sink> innerSink, size_t maxPendingCount = 4096);
+		~AsyncSink() override;
+		void receive(const Entry& entry) override;
+		Level getMinLevel() const override;
+	private:
+		void drain();
+
+		std::shared_ptr<Sink> innerSink;
+		const size_t maxPendingCount;
+		std::mutex mutex;
+		std::condition_variable entriesPending;
+		std::condition_variable spaceAvailable;
+		std::vector<Entry> pending;
+		bool stopping = false;
+		std::thread thread;
+	};
+
 }
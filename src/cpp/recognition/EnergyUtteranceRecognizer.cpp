@@ -0,0 +1,126 @@
+#include "EnergyUtteranceRecognizer.h"
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+using std::vector;
+
+namespace {
+
+	// Loudness thresholds relative to the loudest centisecond of the utterance
+	constexpr double openVowelDb = -6.0;
+	constexpr double vowelDb = -14.0;
+	constexpr double closedDb = -24.0;
+
+	// Frames whose energy is centered above this frequency are sibilants; those centered below the
+	// other are rounded vowels
+	constexpr double sibilantFrequency = 2500.0;
+	constexpr double roundedFrequency = 350.0;
+
+	// Shorter phones are merged into the one before, so that the mouth doesn't flutter
+	constexpr centiseconds minPhoneDuration(5);
+
+	struct Frame {
+		// Without the DC offset
+		double energy;
+		// A rough spectral centroid in Hz
+		double frequency;
+	};
+
+	// For a sine of frequency f, the energy of the first difference is 2 - 2 cos(2 pi f / rate)
+	// times that of the signal, so the ratio of the two maps the spectrum's tilt to a frequency
+	// independently of the sample rate
+	Frame analyzeFrame(const float* samples, size_t count, int sampleRate) {
+		double sum = 0;
+		for (size_t i = 0; i < count; ++i) {
+			sum += samples[i];
+		}
+		const double mean = sum / count;
+		double energy = 0, differenceEnergy = 0;
+		for (size_t i = 0; i < count; ++i) {
+			const double sample = samples[i] - mean;
+			energy += sample * sample;
+			if (i > 0) {
+				const double difference = samples[i] - samples[i - 1];
+				differenceEnergy += difference * difference;
+			}
+		}
+		if (count < 2 || energy <= 0) return { 0.0, 0.0 };
+
+		const double ratio = std::min(differenceEnergy / (count - 1) / (energy / count), 4.0);
+		const double pi = 3.14159265358979323846;
+		return { energy / count, sampleRate / (2 * pi) * std::acos(1.0 - ratio / 2) };
+	}
+
+	Phone classifyFrame(const Frame& frame, double peakEnergy) {
+		const double db = frame.energy > 0 ? 10 * std::log10(frame.energy / peakEnergy) : closedDb - 1;
+		if (db < closedDb) return Phone::M;
+		if (frame.frequency > sibilantFrequency) return Phone::S;
+		if (db < vowelDb) return Phone::Schwa;
+		if (frame.frequency < roundedFrequency) return db < openVowelDb ? Phone::UW : Phone::AO;
+		return db < openVowelDb ? Phone::EH : Phone::AA;
+	}
+
+}
+
+Timeline<Phone> EnergyUtteranceRecognizer::recognizeUtterance(
+	const AudioClip& audioClip,
+	TimeRange utteranceTimeRange,
+	ProgressSink& progressSink
+) {
+	utteranceTimeRange.trim(audioClip.getTruncatedRange());
+	const Timebase timebase = audioClip.getTimebase();
+	const AudioClip::size_type firstSample = timebase.toSampleIndex(utteranceTimeRange.getStart());
+	const AudioClip::size_type lastSample =
+		std::min(timebase.toSampleIndex(utteranceTimeRange.getEnd()), audioClip.size());
+	vector<float> buffer(static_cast<size_t>(std::max<AudioClip::size_type>(lastSample - firstSample, 0)));
+	audioClip.readBlock(firstSample, static_cast<AudioClip::size_type>(buffer.size()), buffer.data());
+
+	vector<Frame> frames;
+	double peakEnergy = 0;
+	for (centiseconds time = utteranceTimeRange.getStart(); time < utteranceTimeRange.getEnd(); ++time) {
+		const AudioClip::size_type frameStart = timebase.toSampleIndex(time);
+		const AudioClip::size_type frameEnd = std::min(timebase.toSampleIndex(time + 1_cs), lastSample);
+		const Frame frame = frameEnd > frameStart
+			? analyzeFrame(buffer.data() + (frameStart - firstSample), static_cast<size_t>(frameEnd - frameStart), timebase.getSampleRate())
+			: Frame { 0.0, 0.0 };
+		frames.push_back(frame);
+		peakEnergy = std::max(peakEnergy, frame.energy);
+	}
+
+	// Collect runs of frames of the same phone, merging short runs into the one before
+	struct Run {
+		Phone phone;
+		centiseconds duration;
+	};
+	vector<Run> runs;
+	for (const Frame& frame : frames) {
+		const Phone phone = peakEnergy > 0 ? classifyFrame(frame, peakEnergy) : Phone::M;
+		if (!runs.empty() && runs.back().phone == phone) {
+			++runs.back().duration;
+		} else {
+			if (runs.size() >= 2 && runs.back().duration < minPhoneDuration) {
+				runs[runs.size() - 2].duration += runs.back().duration;
+				runs.pop_back();
+			}
+			if (!runs.empty() && runs.back().phone == phone) {
+				++runs.back().duration;
+			} else {
+				runs.push_back({ phone, 1_cs });
+			}
+		}
+	}
+	if (runs.size() >= 2 && runs.front().duration < minPhoneDuration) {
+		runs[1].duration += runs.front().duration;
+		runs.erase(runs.begin());
+	}
+
+	Timeline<Phone> phones;
+	centiseconds start = utteranceTimeRange.getStart();
+	for (const Run& run : runs) {
+		phones.set(start, start + run.duration, run.phone);
+		start += run.duration;
+	}
+	progressSink.reportProgress(1.0);
+	return phones;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Recognizer.h"
+
+// Guesses the phones of an utterance from the loudness and spectral tilt of each centisecond
+// instead of recognizing speech: loud frames become open vowels, quieter ones schwas and closed
+// lips, frames whose energy lies mostly at high frequencies sibilants, and dark ones rounded vowels.
+// Nowhere near as accurate as a decoder, but needs no models and a tiny fraction of the time, so
+// that streams can keep their mouths moving while the decoders can't keep up (see StreamScheduler).
+class EnergyUtteranceRecognizer : public UtteranceRecognizer {
+public:
+	Timeline<Phone> recognizeUtterance(
+		const AudioClip& audioClip,
+		TimeRange utteranceTimeRange,
+		ProgressSink& progressSink
+	) override;
+};
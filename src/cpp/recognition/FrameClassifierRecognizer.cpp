@@ -0,0 +1,537 @@
+#include "FrameClassifierRecognizer.h"
+#include "audio/AudioSegment.h"
+#include "audio/SampleRateConverter.h"
+#include "audio/processing.h"
+#include "time/timedLogging.h"
+#include "tools/AnalysisStats.h"
+#include "tools/cancellation.h"
+#include "logging/logging.h"
+#include <array>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <limits>
+
+extern "C" {
+#include <pocketsphinx_internal.h>
+#include <ptm_mgau.h>
+}
+
+using std::runtime_error;
+using std::unique_ptr;
+using std::string;
+using std::vector;
+using boost::optional;
+using std::chrono::milliseconds;
+
+namespace {
+
+	// The strongest components of each phone state's mixture that the classifier keeps, per stream
+	constexpr int componentCount = 8;
+
+	// Log likelihood it costs to switch from one class to another, so that the mouth doesn't flutter
+	constexpr float classSwitchPenalty = 10.0f;
+
+	// Phones that look alike on the lips, each represented by one of them. The first class is silence
+	// and noise, for which no phone is emitted.
+	struct PhoneClass {
+		optional<Phone> representative;
+		vector<Phone> phones;
+	};
+
+	const vector<PhoneClass>& getPhoneClasses() {
+		static const vector<PhoneClass> phoneClasses {
+			{ boost::none, { Phone::Breath, Phone::Cough, Phone::Smack, Phone::Noise } },
+			{ Phone::M, { Phone::M, Phone::B, Phone::P } },
+			{ Phone::F, { Phone::F, Phone::V } },
+			{ Phone::S, {
+				Phone::S, Phone::Z, Phone::SH, Phone::ZH, Phone::TH, Phone::DH, Phone::CH, Phone::JH,
+				Phone::T, Phone::D, Phone::N
+			} },
+			{ Phone::IH, { Phone::IY, Phone::IH, Phone::EY, Phone::Y, Phone::K, Phone::G, Phone::NG, Phone::HH } },
+			{ Phone::EH, { Phone::EH, Phone::AE, Phone::AH, Phone::Schwa, Phone::ER, Phone::AY } },
+			{ Phone::AA, { Phone::AA, Phone::AW } },
+			{ Phone::AO, { Phone::AO, Phone::OW, Phone::OY } },
+			{ Phone::UW, { Phone::UW, Phone::UH, Phone::W, Phone::R } },
+			{ Phone::L, { Phone::L } }
+		};
+		return phoneClasses;
+	}
+
+	// Silence has no phone, but is classified like noise
+	int getPhoneClassIndex(const optional<Phone>& phone) {
+		if (!phone) return 0;
+
+		const vector<PhoneClass>& phoneClasses = getPhoneClasses();
+		for (size_t i = 0; i < phoneClasses.size(); ++i) {
+			const vector<Phone>& phones = phoneClasses[i].phones;
+			if (std::find(phones.begin(), phones.end(), *phone) != phones.end()) {
+				return static_cast<int>(i);
+			}
+		}
+		return 0;
+	}
+
+}
+
+// Diagonal Gaussian mixtures over the feature streams, one per emitting state of each
+// context-independent phone. Log likelihoods are natural logarithms.
+class FrameClassifier {
+public:
+	// Takes the strongest components of the context-independent senones of a PTM acoustic model
+	explicit FrameClassifier(ps_decoder_t& decoder);
+
+	// Returns the log likelihood of each phone class for a frame of features
+	void classifyFrame(mfcc_t** features, vector<float>& classScores) const;
+
+	// The number of bytes of the mixtures
+	size_t getSize() const;
+
+private:
+	// One state's mixture for one stream
+	struct Mixture {
+		// Per component: the log of its weight and normalization
+		std::array<float, componentCount> constants;
+		// Per component and dimension: mean, and the factor of the squared distance
+		vector<float> means;
+		vector<float> scales;
+	};
+
+	// The mixtures of a state by stream
+	using StateMixtures = vector<Mixture>;
+
+	struct PhoneModel {
+		int classIndex;
+		vector<StateMixtures> states;
+	};
+
+	float scoreMixture(const Mixture& mixture, const mfcc_t* features, int dimensionCount) const;
+
+	vector<int> streamDimensions;
+	vector<PhoneModel> phoneModels;
+	int classCount;
+};
+
+FrameClassifier::FrameClassifier(ps_decoder_t& decoder) :
+	classCount(static_cast<int>(getPhoneClasses().size()))
+{
+	acmod_t& acousticModel = *decoder.acmod;
+	if (acousticModel.mgau->vt->frame_eval != &ptm_mgau_frame_eval) {
+		throw runtime_error("The frame classifier needs a phonetically tied acoustic model.");
+	}
+	const ptm_mgau_t& mixtures = *reinterpret_cast<const ptm_mgau_t*>(acousticModel.mgau);
+	const gauden_t& gaussians = *mixtures.g;
+	const bin_mdef_t& modelDefinition = *acousticModel.mdef;
+
+	// Densities are in units of the decoder's log base, mixture weights in coarser ones
+	logmath_t* logMath = acousticModel.lmath;
+	const double logUnit = std::log(logmath_get_base(logMath)) * (1 << logmath_get_shift(logMath));
+	const double weightUnit = std::log(logmath_get_base(logMath)) * (1 << SENSCR_SHIFT);
+
+	for (int stream = 0; stream < gaussians.n_feat; ++stream) {
+		streamDimensions.push_back(gaussians.featlen[stream]);
+	}
+
+	const vector<optional<Phone>>& ciPhones = getCiPhones(decoder);
+	const int stateCount = bin_mdef_n_emit_state(&modelDefinition);
+	for (int phoneId = 0; phoneId < bin_mdef_n_ciphone(&modelDefinition); ++phoneId) {
+		PhoneModel phoneModel { getPhoneClassIndex(ciPhones[phoneId]), {} };
+		for (int state = 0; state < stateCount; ++state) {
+			const int senone = bin_mdef_sseq2sen(&modelDefinition, bin_mdef_pid2ssid(&modelDefinition, phoneId), state);
+			const int codebook = mixtures.sen2cb[senone];
+			StateMixtures stateMixtures;
+			for (int stream = 0; stream < gaussians.n_feat; ++stream) {
+				// Negative log mixture weight of each codeword, read as the decoder does
+				vector<int> mixtureWeights;
+				for (int codeword = 0; codeword < gaussians.n_density; ++codeword) {
+					if (mixtures.mixw_cb) {
+						int weightIndex = mixtures.mixw[stream][codeword][senone / 2];
+						weightIndex = (weightIndex & 1) ? weightIndex >> 4 : weightIndex & 0x0f;
+						mixtureWeights.push_back(mixtures.mixw_cb[weightIndex]);
+					} else {
+						mixtureWeights.push_back(mixtures.mixw[stream][codeword][senone]);
+					}
+				}
+				vector<int> codewords(gaussians.n_density);
+				std::iota(codewords.begin(), codewords.end(), 0);
+				const int keptCount = std::min(componentCount, gaussians.n_density);
+				std::partial_sort(codewords.begin(), codewords.begin() + keptCount, codewords.end(),
+					[&](int a, int b) { return mixtureWeights[a] < mixtureWeights[b]; });
+
+				const int dimensionCount = gaussians.featlen[stream];
+				Mixture mixture;
+				mixture.constants.fill(-std::numeric_limits<float>::infinity());
+				mixture.means.assign(componentCount * dimensionCount, 0.0f);
+				mixture.scales.assign(componentCount * dimensionCount, 0.0f);
+				for (int i = 0; i < keptCount; ++i) {
+					const int codeword = codewords[i];
+					mixture.constants[i] = static_cast<float>(
+						-mixtureWeights[codeword] * weightUnit
+						+ static_cast<double>(gaussians.det[codebook][stream][codeword]) * logUnit);
+					const mfcc_t* density = mixtures.dens + mixtures.dens_offset[codebook * gaussians.n_feat + stream]
+						+ static_cast<size_t>(codeword) * 2 * mixtures.dens_stride[stream];
+					const mfcc_t* variance = density + mixtures.dens_stride[stream];
+					for (int dimension = 0; dimension < dimensionCount; ++dimension) {
+						mixture.means[i * dimensionCount + dimension] = MFCC2FLOAT(density[dimension]);
+						mixture.scales[i * dimensionCount + dimension] =
+							static_cast<float>(static_cast<double>(variance[dimension]) * logUnit);
+					}
+				}
+				stateMixtures.push_back(std::move(mixture));
+			}
+			phoneModel.states.push_back(std::move(stateMixtures));
+		}
+		phoneModels.push_back(std::move(phoneModel));
+	}
+}
+
+float FrameClassifier::scoreMixture(
+	const Mixture& mixture,
+	const mfcc_t* features,
+	int dimensionCount
+) const {
+	std::array<float, componentCount> componentScores;
+	float maxScore = -std::numeric_limits<float>::infinity();
+	for (int i = 0; i < componentCount; ++i) {
+		const float* mean = mixture.means.data() + i * dimensionCount;
+		const float* scale = mixture.scales.data() + i * dimensionCount;
+		float distance = 0.0f;
+		for (int dimension = 0; dimension < dimensionCount; ++dimension) {
+			const float difference = MFCC2FLOAT(features[dimension]) - mean[dimension];
+			distance += difference * difference * scale[dimension];
+		}
+		componentScores[i] = mixture.constants[i] - distance;
+		maxScore = std::max(maxScore, componentScores[i]);
+	}
+
+	float sum = 0.0f;
+	for (const float componentScore : componentScores) {
+		sum += std::exp(componentScore - maxScore);
+	}
+	return maxScore + std::log(sum);
+}
+
+void FrameClassifier::classifyFrame(mfcc_t** features, vector<float>& classScores) const {
+	classScores.assign(classCount, -std::numeric_limits<float>::infinity());
+	for (const PhoneModel& phoneModel : phoneModels) {
+		// A phone is as likely as its likeliest state
+		float phoneScore = -std::numeric_limits<float>::infinity();
+		for (const StateMixtures& stateMixtures : phoneModel.states) {
+			float stateScore = 0.0f;
+			for (size_t stream = 0; stream < stateMixtures.size(); ++stream) {
+				stateScore += scoreMixture(stateMixtures[stream], features[stream], streamDimensions[stream]);
+			}
+			phoneScore = std::max(phoneScore, stateScore);
+		}
+		float& classScore = classScores[phoneModel.classIndex];
+		classScore = std::max(classScore, phoneScore);
+	}
+}
+
+size_t FrameClassifier::getSize() const {
+	size_t size = 0;
+	for (const PhoneModel& phoneModel : phoneModels) {
+		for (const StateMixtures& stateMixtures : phoneModel.states) {
+			for (const Mixture& mixture : stateMixtures) {
+				size += sizeof(mixture.constants) + (mixture.means.size() + mixture.scales.size()) * sizeof(float);
+			}
+		}
+	}
+	return size;
+}
+
+static lambda_unique_ptr<ps_decoder_t> createDecoder() {
+	lambda_unique_ptr<cmd_ln_t> config(
+		cmd_ln_init(
+			nullptr, ps_args(), true,
+			// Set acoustic model. Without a language model, no search is created.
+			"-hmm", (getSphinxModelDirectory() / "acoustic-model").u8string().c_str(),
+			// Add noise against zero silence
+			// (see http://cmusphinx.sourceforge.net/wiki/faq#qwhy_my_accuracy_is_poor)
+			"-dither", "yes",
+			// Disable VAD -- we're doing that ourselves
+			"-remove_silence", "no",
+			// Perform per-utterance cepstral mean normalization
+			"-cmn", "batch",
+			// Map the read-only model files instead of copying them
+			"-mmap", "yes",
+			// There is no search for a phone loop to look ahead for
+			"-pl_window", "0",
+			nullptr),
+		[](cmd_ln_t* config) { cmd_ln_free_r(config); });
+	if (!config) throw runtime_error("Error creating configuration.");
+
+	return initDecoder(*config);
+}
+
+// There is no language model, so there is nothing to prepare for a dialog
+static void prepareDecoder(ps_decoder_t& decoder, const optional<string>& dialog) {
+	UNUSED(decoder);
+	UNUSED(dialog);
+}
+
+// Returns the likeliest phone class of each frame, given the log likelihoods of the classes by
+// frame, penalizing every switch between classes
+static vector<int> findClassPath(const vector<vector<float>>& frameScores, int classCount) {
+	vector<int> path(frameScores.size());
+	if (frameScores.empty()) return path;
+
+	// The class each path came from, by frame and class
+	vector<vector<int>> predecessors(frameScores.size(), vector<int>(classCount));
+	vector<float> pathScores = frameScores[0];
+	std::iota(predecessors[0].begin(), predecessors[0].end(), 0);
+	vector<float> nextPathScores(classCount);
+	for (size_t frame = 1; frame < frameScores.size(); ++frame) {
+		const int bestClass = static_cast<int>(std::max_element(pathScores.begin(), pathScores.end()) - pathScores.begin());
+		for (int classIndex = 0; classIndex < classCount; ++classIndex) {
+			const float switchScore = pathScores[bestClass] - classSwitchPenalty;
+			const bool switchClass = switchScore > pathScores[classIndex];
+			predecessors[frame][classIndex] = switchClass ? bestClass : classIndex;
+			nextPathScores[classIndex] = (switchClass ? switchScore : pathScores[classIndex]) + frameScores[frame][classIndex];
+		}
+		std::swap(pathScores, nextPathScores);
+	}
+
+	int classIndex = static_cast<int>(std::max_element(pathScores.begin(), pathScores.end()) - pathScores.begin());
+	for (size_t frame = frameScores.size(); frame-- > 0;) {
+		path[frame] = classIndex;
+		classIndex = predecessors[frame][classIndex];
+	}
+	return path;
+}
+
+static Timeline<Phone> utteranceToPhones(
+	const FrameClassifier& classifier,
+	const AudioClip& audioClip,
+	TimeRange utteranceTimeRange,
+	ps_decoder_t& decoder,
+	ProgressSink& utteranceProgressSink
+) {
+	// Pad time range like the other recognizers, so that the features at the edges are complete
+	const TimeRange paddedTimeRange = getPaddedUtteranceRange(utteranceTimeRange, audioClip);
+
+	// If the clip is already buffered at the decoder's rate, this is a view of that buffer
+	const unique_ptr<AudioClip> clipSegment = audioClip.clone()
+		| segment(paddedTimeRange)
+		| resample(getDecoderSampleRate(decoder));
+	vector<int16_t> audioBufferStorage;
+	const gsl::span<const int16_t> audioBuffer = get16bitSamples(*clipSegment, audioBufferStorage);
+
+	const CepstralFrames cepstralFrames = measureStage(AnalysisStage::FeatureExtraction, [&] {
+		return CepstralFrames(audioBuffer, decoder);
+	});
+
+	// Classify the frames' dynamic features, without searching them
+	const vector<vector<float>> frameScores = measureStage(AnalysisStage::WordRecognition, [&] {
+		acmod_t* acousticModel = decoder.acmod;
+		const CepstralFrames::frame_buffer frames = cepstralFrames.copyFrames();
+		mfcc_t** nextFrame = frames.get();
+		int frameCount = cepstralFrames.getFrameCount();
+		if (acmod_start_utt(acousticModel) < 0) {
+			throw runtime_error("Error starting utterance processing for frame classification.");
+		}
+		const bool fullUtterance = true;
+		if (acmod_process_cep(acousticModel, &nextFrame, &frameCount, fullUtterance) < 0) {
+			acmod_end_utt(acousticModel);
+			throw runtime_error("Error computing features for frame classification.");
+		}
+
+		vector<vector<float>> result;
+		while (acousticModel->n_feat_frame > 0) {
+			if (result.size() % cancellationCheckFrameInterval == 0) {
+				try {
+					throwIfCancelled();
+				} catch (const OperationCancelled&) {
+					acmod_end_utt(acousticModel);
+					throw;
+				}
+			}
+			int frameIndex = acousticModel->output_frame;
+			mfcc_t** features = acmod_get_frame(acousticModel, &frameIndex);
+			result.emplace_back();
+			classifier.classifyFrame(features, result.back());
+			acmod_advance(acousticModel);
+		}
+		acmod_end_utt(acousticModel);
+		countEvent(AnalysisCounter::DecodedFrames, static_cast<int64_t>(result.size()));
+		return result;
+	});
+
+	// Each frame is a centisecond
+	const vector<PhoneClass>& phoneClasses = getPhoneClasses();
+	const vector<int> classPath = findClassPath(frameScores, static_cast<int>(phoneClasses.size()));
+	Timeline<Phone> utterancePhones;
+	for (size_t frame = 0; frame < classPath.size(); ++frame) {
+		const optional<Phone>& phone = phoneClasses[classPath[frame]].representative;
+		if (!phone) continue;
+
+		const centiseconds start = paddedTimeRange.getStart() + centiseconds(static_cast<int64_t>(frame));
+		utterancePhones.set(start, start + 1_cs, *phone);
+	}
+
+	// Log raw phones
+	for (const auto& timedPhone : utterancePhones) {
+		logTimedEvent("rawPhone", timedPhone);
+	}
+
+	// Guess positions of noise sounds
+	JoiningTimeline<void> noiseSounds = getNoiseSounds(utteranceTimeRange, utterancePhones);
+	for (const auto& noiseSound : noiseSounds) {
+		utterancePhones.set(noiseSound.getTimeRange(), Phone::Noise);
+	}
+
+	// Log phones
+	for (const auto& timedPhone : utterancePhones) {
+		logTimedEvent("phone", timedPhone);
+	}
+
+	utteranceProgressSink.reportProgress(1.0);
+
+	return utterancePhones;
+}
+
+BoundedTimeline<Phone> FrameClassifierRecognizer::recognizePhones(
+	const AudioClip& inputAudioClip,
+	optional<std::string> dialog,
+	SpeakerProfile* speakerProfile,
+	int maxThreadCount,
+	ProgressSink& progressSink,
+	const RecognizedPhonesSink& phonesSink
+) const {
+	DecoderCache& decoderCache = getDecoderCache();
+	return ::recognizePhones(
+		inputAudioClip,
+		dialog,
+		speakerProfile,
+		decoderCache.decoderPool,
+		decoderCache.utterancePhones,
+		costModel,
+		&prepareDecoder,
+		decoderCache.getUtteranceToPhones(),
+		maxThreadCount,
+		progressSink,
+		nullptr,
+		phonesSink
+	);
+}
+
+vector<BoundedTimeline<Phone>> FrameClassifierRecognizer::recognizePhonesBatch(
+	const vector<RecognitionInput>& inputs,
+	int maxThreadCount,
+	ProgressSink& progressSink
+) const {
+	DecoderCache& decoderCache = getDecoderCache();
+	return ::recognizePhonesBatch(
+		inputs,
+		decoderCache.decoderPool,
+		decoderCache.utterancePhones,
+		costModel,
+		&prepareDecoder,
+		decoderCache.getUtteranceToPhones(),
+		maxThreadCount,
+		progressSink
+	);
+}
+
+unique_ptr<SteppedRecognition> FrameClassifierRecognizer::beginRecognition(
+	const vector<RecognitionInput>& inputs,
+	ProgressSink& progressSink
+) const {
+	DecoderCache& decoderCache = getDecoderCache();
+	return std::make_unique<PhoneRecognitionBatch>(
+		inputs,
+		decoderCache.decoderPool,
+		decoderCache.utterancePhones,
+		costModel,
+		&prepareDecoder,
+		decoderCache.getUtteranceToPhones(),
+		1,
+		progressSink
+	);
+}
+
+unique_ptr<UtteranceRecognizer> FrameClassifierRecognizer::createUtteranceRecognizer(
+	const optional<string>& dialog,
+	int sampleRate
+) const {
+	UNUSED(dialog);
+	UNUSED(sampleRate);
+	redirectPocketSphinxOutput();
+
+	DecoderCache& decoderCache = getDecoderCache();
+	return std::make_unique<DecoderUtteranceRecognizer>(
+		decoderCache.decoderPool,
+		nullptr,
+		boost::none,
+		decoderCache.getUtteranceToPhones()
+	);
+}
+
+// Measured size of the first decoder, which holds just the acoustic model, and the typical cost of
+// recognizing a second of speech on a desktop CPU in milliseconds
+FrameClassifierRecognizer::FrameClassifierRecognizer() :
+	decoderMemoryEstimate(6 * 1024 * 1024),
+	costModel(RecognitionCostModel::defaultVadCost, 8)
+{}
+
+size_t FrameClassifierRecognizer::estimateDecoderMemory(int maxThreadCount) const {
+	return decoderMemoryEstimate.getMissingDecoderSize(getDecoderCache().decoderPool, maxThreadCount);
+}
+
+milliseconds FrameClassifierRecognizer::estimateDuration(centiseconds audioDuration, int maxThreadCount) const {
+	return costModel.estimateDuration(audioDuration, maxThreadCount);
+}
+
+void FrameClassifierRecognizer::prewarm(int decoderCount) const {
+	redirectPocketSphinxOutput();
+	prewarmDecoders(getDecoderCache().decoderPool, decoderCount);
+}
+
+void FrameClassifierRecognizer::clearDecoderCache() {
+	std::lock_guard<std::mutex> lock(decoderCachesMutex);
+	decoderCaches.clear();
+}
+
+FrameClassifierRecognizer::DecoderCache::DecoderCache(DecoderMemoryEstimate& decoderMemoryEstimate) :
+	decoderPool([&decoderMemoryEstimate] {
+		return decoderMemoryEstimate.measure(&createDecoder);
+	})
+{}
+
+FrameClassifierRecognizer::DecoderCache::~DecoderCache() = default;
+
+const FrameClassifier& FrameClassifierRecognizer::DecoderCache::getClassifier(ps_decoder_t& decoder) {
+	std::call_once(classifierFlag, [&] {
+		classifier = std::make_unique<FrameClassifier>(decoder);
+		logging::debugFormat("Derived frame classifier of {} KB from the acoustic model.", classifier->getSize() / 1024);
+	});
+	return *classifier;
+}
+
+utteranceToPhonesFunction FrameClassifierRecognizer::DecoderCache::getUtteranceToPhones() {
+	return [this](
+		const AudioClip& audioClip,
+		TimeRange utteranceTimeRange,
+		const optional<vector<string>>& utteranceWords,
+		const RecognizedUtterance* recognizedUtterance,
+		ps_decoder_t& decoder,
+		ProgressSink& utteranceProgressSink
+	) {
+		// Phones are classified directly, and only from whole utterances
+		UNUSED(utteranceWords);
+		UNUSED(recognizedUtterance);
+
+		return utteranceToPhones(getClassifier(decoder), audioClip, utteranceTimeRange, decoder, utteranceProgressSink);
+	};
+}
+
+FrameClassifierRecognizer::DecoderCache& FrameClassifierRecognizer::getDecoderCache() const {
+	const string modelDirectory = getSphinxModelDirectory().u8string();
+
+	std::lock_guard<std::mutex> lock(decoderCachesMutex);
+	auto& decoderCache = decoderCaches[modelDirectory];
+	if (!decoderCache) {
+		decoderCache = std::make_unique<DecoderCache>(decoderMemoryEstimate);
+	}
+	return *decoderCache;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Recognizer.h"
+#include "pocketSphinxTools.h"
+#include <map>
+#include <mutex>
+
+class FrameClassifier;
+
+// Classifies each cepstral frame into a class of phones that look alike on the lips, without any
+// search, language model or dictionary. The classifier is a small set of Gaussian mixtures, one per
+// state of each context-independent phone, taken from the strongest components of the acoustic
+// model. Much faster than PhoneticRecognizer, but the phones only stand for their mouth shapes.
+// Suited for ambient dialog where nobody watches the lips closely. The dialog is ignored.
+// Always uses the wideband acoustic model, as its classifier is built from it.
+class FrameClassifierRecognizer : public Recognizer {
+public:
+	FrameClassifierRecognizer();
+
+	BoundedTimeline<Phone> recognizePhones(
+		const AudioClip& inputAudioClip,
+		boost::optional<std::string> dialog,
+		SpeakerProfile* speakerProfile,
+		int maxThreadCount,
+		ProgressSink& progressSink,
+		const RecognizedPhonesSink& phonesSink
+	) const override;
+
+	std::vector<BoundedTimeline<Phone>> recognizePhonesBatch(
+		const std::vector<RecognitionInput>& inputs,
+		int maxThreadCount,
+		ProgressSink& progressSink
+	) const override;
+
+	// Must be destroyed before the recognizer's decoder cache is cleared.
+	std::unique_ptr<SteppedRecognition> beginRecognition(
+		const std::vector<RecognitionInput>& inputs,
+		ProgressSink& progressSink
+	) const override;
+
+	// Must be destroyed before the recognizer's decoder cache is cleared.
+	std::unique_ptr<UtteranceRecognizer> createUtteranceRecognizer(
+		const boost::optional<std::string>& dialog,
+		int sampleRate
+	) const override;
+
+	size_t estimateDecoderMemory(int maxThreadCount) const override;
+
+	std::chrono::milliseconds estimateDuration(centiseconds audioDuration, int maxThreadCount) const override;
+	void prewarm(int decoderCount) const override;
+
+	// Frees all cached decoders, classifiers and utterance phones. They will be re-created as needed.
+	void clearDecoderCache();
+
+private:
+	// Warm decoders, which only compute features, the classifier derived from their acoustic model,
+	// and the phones they recognized, for one model directory
+	struct DecoderCache {
+		explicit DecoderCache(DecoderMemoryEstimate& decoderMemoryEstimate);
+		~DecoderCache();
+
+		// Returns the classifier, deriving it from the decoder's acoustic model the first time
+		const FrameClassifier& getClassifier(ps_decoder_t& decoder);
+
+		// Recognizes an utterance with the classifier
+		utteranceToPhonesFunction getUtteranceToPhones();
+
+		DecoderPool decoderPool;
+		UtterancePhoneCache utterancePhones;
+
+	private:
+		std::once_flag classifierFlag;
+		std::unique_ptr<FrameClassifier> classifier;
+	};
+
+	// Returns the decoder cache for the current model directory
+	DecoderCache& getDecoderCache() const;
+
+	mutable DecoderMemoryEstimate decoderMemoryEstimate;
+	mutable RecognitionCostModel costModel;
+	mutable std::map<std::string, std::unique_ptr<DecoderCache>> decoderCaches;
+	mutable std::mutex decoderCachesMutex;
+};
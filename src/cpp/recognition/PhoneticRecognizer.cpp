@@ -0,0 +1,229 @@
+#include "PhoneticRecognizer.h"
+#include "audio/AudioSegment.h"
+#include "audio/SampleRateConverter.h"
+#include "audio/processing.h"
+#include "time/timedLogging.h"
+#include "tools/AnalysisStats.h"
+
+using std::runtime_error;
+using std::unique_ptr;
+using std::string;
+using std::vector;
+using boost::optional;
+using std::chrono::milliseconds;
+
+static lambda_unique_ptr<ps_decoder_t> createDecoder(int sampleRate) {
+	lambda_unique_ptr<cmd_ln_t> config(
+		cmd_ln_init(
+			nullptr, ps_args(), true,
+			// Set acoustic model
+			"-hmm", getSphinxAcousticModelPath(sampleRate).u8string().c_str(),
+			// Set phonetic language model
+			"-allphone", (getSphinxModelDirectory() / "en-us-phone.lm.bin").u8string().c_str(),
+			"-allphone_ci", "yes",
+			// Set language model probability weight.
+			// Low values (<= 0.4) can lead to fluttering animation.
+			// High values (>= 1.0) can lead to imprecise or freezing animation.
+			"-lw", "0.8",
+			// Add noise against zero silence
+			// (see http://cmusphinx.sourceforge.net/wiki/faq#qwhy_my_accuracy_is_poor)
+			"-dither", "yes",
+			// Disable VAD -- we're doing that ourselves
+			"-remove_silence", "no",
+			// Perform per-utterance cepstral mean normalization
+			"-cmn", "batch",
+			// Map the read-only model files instead of copying them
+			"-mmap", "yes",
+			nullptr),
+		[](cmd_ln_t* config) { cmd_ln_free_r(config); });
+	if (!config) throw runtime_error("Error creating configuration.");
+	setSphinxFrontEndSampleRate(*config, sampleRate);
+
+	return initDecoder(*config);
+}
+
+// There is only the phonetic language model, so there is nothing to prepare for a dialog
+static void prepareDecoder(ps_decoder_t& decoder, const optional<string>& dialog) {
+	UNUSED(decoder);
+	UNUSED(dialog);
+}
+
+static Timeline<Phone> utteranceToPhones(
+	const AudioClip& audioClip,
+	TimeRange utteranceTimeRange,
+	const optional<vector<string>>& utteranceWords,
+	const RecognizedUtterance* recognizedUtterance,
+	ps_decoder_t& decoder,
+	ProgressSink& utteranceProgressSink
+) {
+	// Phones are recognized directly, and only from whole utterances
+	UNUSED(utteranceWords);
+	UNUSED(recognizedUtterance);
+
+	// Pad time range to give PocketSphinx some breathing room
+	const TimeRange paddedTimeRange = getPaddedUtteranceRange(utteranceTimeRange, audioClip);
+
+	// If the clip is already buffered at the decoder's rate, this is a view of that buffer
+	const unique_ptr<AudioClip> clipSegment = audioClip.clone()
+		| segment(paddedTimeRange)
+		| resample(getDecoderSampleRate(decoder));
+	vector<int16_t> audioBufferStorage;
+	const gsl::span<const int16_t> audioBuffer = get16bitSamples(*clipSegment, audioBufferStorage);
+
+	// Detect phones (returned as words)
+	const CepstralFrames cepstralFrames = measureStage(AnalysisStage::FeatureExtraction, [&] {
+		return CepstralFrames(audioBuffer, decoder);
+	});
+	BoundedTimeline<string> phoneStrings = measureStage(AnalysisStage::WordRecognition, [&] {
+		return recognizeWords(cepstralFrames, decoder);
+	});
+	phoneStrings.shift(paddedTimeRange.getStart());
+	Timeline<Phone> utterancePhones;
+	for (const auto& timedPhoneString : phoneStrings) {
+		if (timedPhoneString.getValue() == "SIL") continue;
+
+		Phone phone = PhoneConverter::get().parse(timedPhoneString.getValue());
+		if (phone == Phone::AH && timedPhoneString.getDuration() < 6_cs) {
+			// Heuristic: < 6_cs is schwa. PocketSphinx doesn't differentiate.
+			phone = Phone::Schwa;
+		}
+		utterancePhones.set(timedPhoneString.getTimeRange(), phone);
+	}
+
+	// Log raw phones
+	for (const auto& timedPhone : utterancePhones) {
+		logTimedEvent("rawPhone", timedPhone);
+	}
+
+	// Guess positions of noise sounds
+	JoiningTimeline<void> noiseSounds = getNoiseSounds(utteranceTimeRange, utterancePhones);
+	for (const auto& noiseSound : noiseSounds) {
+		utterancePhones.set(noiseSound.getTimeRange(), Phone::Noise);
+	}
+
+	// Log phones
+	for (const auto& timedPhone : utterancePhones) {
+		logTimedEvent("phone", timedPhone);
+	}
+
+	utteranceProgressSink.reportProgress(1.0);
+
+	return utterancePhones;
+}
+
+BoundedTimeline<Phone> PhoneticRecognizer::recognizePhones(
+	const AudioClip& inputAudioClip,
+	optional<std::string> dialog,
+	SpeakerProfile* speakerProfile,
+	int maxThreadCount,
+	ProgressSink& progressSink,
+	const RecognizedPhonesSink& phonesSink
+) const {
+	DecoderCache& decoderCache = getDecoderCache(getSphinxSampleRate(inputAudioClip.getSampleRate()));
+	return ::recognizePhones(
+		inputAudioClip,
+		dialog,
+		speakerProfile,
+		decoderCache.decoderPool,
+		decoderCache.utterancePhones,
+		costModel,
+		&prepareDecoder,
+		&utteranceToPhones,
+		maxThreadCount,
+		progressSink,
+		nullptr,
+		phonesSink
+	);
+}
+
+vector<BoundedTimeline<Phone>> PhoneticRecognizer::recognizePhonesBatch(
+	const vector<RecognitionInput>& inputs,
+	int maxThreadCount,
+	ProgressSink& progressSink
+) const {
+	DecoderCache& decoderCache = getDecoderCache(getSphinxSampleRate(inputs));
+	return ::recognizePhonesBatch(
+		inputs,
+		decoderCache.decoderPool,
+		decoderCache.utterancePhones,
+		costModel,
+		&prepareDecoder,
+		&utteranceToPhones,
+		maxThreadCount,
+		progressSink
+	);
+}
+
+unique_ptr<SteppedRecognition> PhoneticRecognizer::beginRecognition(
+	const vector<RecognitionInput>& inputs,
+	ProgressSink& progressSink
+) const {
+	DecoderCache& decoderCache = getDecoderCache(getSphinxSampleRate(inputs));
+	return std::make_unique<PhoneRecognitionBatch>(
+		inputs,
+		decoderCache.decoderPool,
+		decoderCache.utterancePhones,
+		costModel,
+		&prepareDecoder,
+		&utteranceToPhones,
+		1,
+		progressSink
+	);
+}
+
+unique_ptr<UtteranceRecognizer> PhoneticRecognizer::createUtteranceRecognizer(
+	const optional<string>& dialog,
+	int sampleRate
+) const {
+	UNUSED(dialog);
+	redirectPocketSphinxOutput();
+
+	return std::make_unique<DecoderUtteranceRecognizer>(
+		getDecoderCache(getSphinxSampleRate(sampleRate)).decoderPool,
+		nullptr,
+		boost::none,
+		&utteranceToPhones
+	);
+}
+
+// Measured size of the first decoder, including the phonetic language model, and the typical cost of
+// recognizing a second of speech on a desktop CPU in milliseconds
+PhoneticRecognizer::PhoneticRecognizer() :
+	decoderMemoryEstimate(8 * 1024 * 1024),
+	costModel(RecognitionCostModel::defaultVadCost, 55)
+{}
+
+size_t PhoneticRecognizer::estimateDecoderMemory(int maxThreadCount) const {
+	return decoderMemoryEstimate.getMissingDecoderSize(getDecoderCache(sphinxSampleRate).decoderPool, maxThreadCount);
+}
+
+milliseconds PhoneticRecognizer::estimateDuration(centiseconds audioDuration, int maxThreadCount) const {
+	return costModel.estimateDuration(audioDuration, maxThreadCount);
+}
+
+void PhoneticRecognizer::prewarm(int decoderCount) const {
+	redirectPocketSphinxOutput();
+	prewarmDecoders(getDecoderCache(sphinxSampleRate).decoderPool, decoderCount);
+}
+
+void PhoneticRecognizer::clearDecoderCache() {
+	std::lock_guard<std::mutex> lock(decoderCachesMutex);
+	decoderCaches.clear();
+}
+
+PhoneticRecognizer::DecoderCache::DecoderCache(int sampleRate, DecoderMemoryEstimate& decoderMemoryEstimate) :
+	decoderPool([sampleRate, &decoderMemoryEstimate] {
+		return decoderMemoryEstimate.measure([sampleRate] { return createDecoder(sampleRate); });
+	})
+{}
+
+PhoneticRecognizer::DecoderCache& PhoneticRecognizer::getDecoderCache(int sampleRate) const {
+	const string acousticModelDirectory = getSphinxAcousticModelPath(sampleRate).u8string();
+
+	std::lock_guard<std::mutex> lock(decoderCachesMutex);
+	auto& decoderCache = decoderCaches[acousticModelDirectory];
+	if (!decoderCache) {
+		decoderCache = std::make_unique<DecoderCache>(sampleRate, decoderMemoryEstimate);
+	}
+	return *decoderCache;
+}
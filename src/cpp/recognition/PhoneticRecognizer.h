@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Recognizer.h"
+#include "pocketSphinxTools.h"
+#include <map>
+#include <mutex>
+
+// Recognizes phones directly, without recognizing words first.
+// Much faster than PocketSphinxRecognizer and without the word language model and dictionary,
+// but less accurate. The dialog is ignored.
+class PhoneticRecognizer : public Recognizer {
+public:
+	PhoneticRecognizer();
+
+	BoundedTimeline<Phone> recognizePhones(
+		const AudioClip& inputAudioClip,
+		boost::optional<std::string> dialog,
+		SpeakerProfile* speakerProfile,
+		int maxThreadCount,
+		ProgressSink& progressSink,
+		const RecognizedPhonesSink& phonesSink
+	) const override;
+
+	std::vector<BoundedTimeline<Phone>> recognizePhonesBatch(
+		const std::vector<RecognitionInput>& inputs,
+		int maxThreadCount,
+		ProgressSink& progressSink
+	) const override;
+
+	// Must be destroyed before the recognizer's decoder cache is cleared.
+	std::unique_ptr<SteppedRecognition> beginRecognition(
+		const std::vector<RecognitionInput>& inputs,
+		ProgressSink& progressSink
+	) const override;
+
+	// Must be destroyed before the recognizer's decoder cache is cleared.
+	std::unique_ptr<UtteranceRecognizer> createUtteranceRecognizer(
+		const boost::optional<std::string>& dialog,
+		int sampleRate
+	) const override;
+
+	size_t estimateDecoderMemory(int maxThreadCount) const override;
+
+	std::chrono::milliseconds estimateDuration(centiseconds audioDuration, int maxThreadCount) const override;
+	void prewarm(int decoderCount) const override;
+
+	// Frees all cached decoders and utterance phones. They will be re-created as needed.
+	void clearDecoderCache();
+
+private:
+	// Warm decoders and the phones they recognized, for one acoustic model
+	struct DecoderCache {
+		DecoderCache(int sampleRate, DecoderMemoryEstimate& decoderMemoryEstimate);
+
+		DecoderPool decoderPool;
+		UtterancePhoneCache utterancePhones;
+	};
+
+	// Returns the decoder cache for the model directory's acoustic model of a rate of
+	// getSphinxSampleRate()
+	DecoderCache& getDecoderCache(int sampleRate) const;
+
+	mutable DecoderMemoryEstimate decoderMemoryEstimate;
+	mutable RecognitionCostModel costModel;
+	mutable std::map<std::string, std::unique_ptr<DecoderCache>> decoderCaches;
+	mutable std::mutex decoderCachesMutex;
+};
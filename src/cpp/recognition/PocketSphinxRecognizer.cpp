@@ -1,14 +1,22 @@
 #include "PocketSphinxRecognizer.h"
-#include <regex>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <gsl_util.h>
 #include "audio/AudioSegment.h"
 #include "audio/SampleRateConverter.h"
 #include "languageModels.h"
+#include "languageModelPages.h"
 #include "tokenization.h"
 #include "g2p.h"
 #include "time/ContinuousTimeline.h"
 #include "audio/processing.h"
 #include "time/timedLogging.h"
+#include "tools/AnalysisStats.h"
+#include "tools/tracing.h"
+#include "tools/cancellation.h"
+#include "tools/stringTools.h"
+#include "gpuScoring.h"
 
 extern "C" {
 #include <state_align_search.h>
@@ -21,81 +29,245 @@ using std::string;
 using std::vector;
 using std::map;
 using std::filesystem::path;
-using std::regex;
-using std::regex_replace;
 using boost::optional;
 using std::array;
+using std::chrono::milliseconds;
 
 bool dictionaryContains(dict_t& dictionary, const string& word) {
 	return dict_wordid(&dictionary, word.c_str()) != BAD_S3WID;
 }
 
+// Whether the dictionary was read with the word, as opposed to it being added for a dialog.
+// Dialog models only count those as known, so that they don't depend on the dialogs a decoder saw
+// before. The words of a dictionary read with -dictsubset count as read, entered or not.
+bool baseDictionaryContains(dict_t& dictionary, const string& word) {
+	const s3wid_t wordId = dict_wordid(&dictionary, word.c_str());
+	return (wordId != BAD_S3WID && wordId < dictionary.n_init_word)
+		|| dict_has_bin_word(&dictionary, word.c_str());
+}
+
 s3wid_t getWordId(const string& word, dict_t& dictionary) {
 	const s3wid_t wordId = dict_wordid(&dictionary, word.c_str());
 	if (wordId == BAD_S3WID) throw invalid_argument(fmt::format("Unknown word '{}'.", word));
 	return wordId;
 }
 
-void addMissingDictionaryWords(const vector<string>& words, ps_decoder_t& decoder) {
-	map<string, string> missingPronunciations;
-	for (const string& word : words) {
-		if (!dictionaryContains(*decoder.dict, word)) {
-			string pronunciation;
-			for (Phone phone : wordToPhones(word)) {
-				if (pronunciation.length() > 0) pronunciation += " ";
-				pronunciation += PhoneConverter::get().toString(phone);
-			}
-			missingPronunciations[word] = pronunciation;
+// Adds a word to the decoder's dictionary.
+// Unlike ps_add_word, this leaves existing searches alone: ps_add_word would add the word to the
+// language model of every search and rebuild their lexicon trees. Searches created afterwards pick
+// up the new word.
+bool addDictionaryWord(ps_decoder_t& decoder, const string& word, const vector<Phone>& phones) {
+	vector<s3cipid_t> pronunciation;
+	for (Phone phone : phones) {
+		const string phoneName = PhoneConverter::get().toString(phone);
+		const s3cipid_t phoneId = bin_mdef_ciphone_id(decoder.acmod->mdef, phoneName.c_str());
+		if (phoneId == BAD_S3CIPID) {
+			logging::errorFormat("Unknown phone {} in pronunciation of '{}'.", phoneName, word);
+			return false;
 		}
+		pronunciation.push_back(phoneId);
 	}
-	for (auto it = missingPronunciations.begin(); it != missingPronunciations.end(); ++it) {
-		const bool isLast = it == --missingPronunciations.end();
-		logging::infoFormat("Unknown word '{}'. Guessing pronunciation '{}'.", it->first, it->second);
-		ps_add_word(&decoder, it->first.c_str(), it->second.c_str(), isLast);
+
+	const s3wid_t wordId = dict_add_word(
+		decoder.dict, word.c_str(), pronunciation.data(), static_cast<int32>(pronunciation.size()));
+	if (wordId == BAD_S3WID) return false;
+	dict2pid_add_word(decoder.d2p, wordId);
+	return true;
+}
+
+// Enters a word of a dictionary read with -dictsubset, with its alternative pronunciations.
+// Returns false if the dictionary lacks the word.
+bool addBinaryDictionaryWord(ps_decoder_t& decoder, const string& word) {
+	const s3wid_t firstWordId = dict_size(decoder.dict);
+	const bool added = dict_add_bin_word(decoder.dict, word.c_str()) != BAD_S3WID;
+	for (s3wid_t wordId = firstWordId; wordId < dict_size(decoder.dict); ++wordId) {
+		dict2pid_add_word(decoder.d2p, wordId);
 	}
+	return added;
 }
 
-lambda_unique_ptr<ngram_model_t> createDefaultLanguageModel(ps_decoder_t& decoder) {
-	path modelPath = getSphinxModelDirectory() / "en-us.lm.bin";
-	lambda_unique_ptr<ngram_model_t> result(
-		ngram_model_read(decoder.config, modelPath.u8string().c_str(), NGRAM_AUTO, decoder.lmath),
+// Name of the search using the default language model. Created once per decoder.
+constexpr const char* defaultSearchName = "lm";
+// Prefix of the names of the searches using dialogs' biased or strict language models
+constexpr const char* dialogSearchPrefix = "dialog-";
+
+// The number of words added for dialogs above which a decoder's dialog searches are dropped. The
+// words of a dialog stay in the dictionary while any search may use them, so they pile up as
+// searches are replaced.
+constexpr int32 maxAddedDictionaryWordCount = 1000;
+
+// Removes all dialog searches from the decoder, along with the words added to its dictionary for
+// them
+void removeDialogSearches(ps_decoder_t& decoder, PocketSphinxRecognizer::DialogSearches& dialogSearches) {
+	// Including searches left behind by a preparation that failed halfway
+	vector<string> searchNames;
+	for (ps_search_iter_t* it = ps_search_iter(&decoder); it; it = ps_search_iter_next(it)) {
+		const string searchName = ps_search_iter_val(it);
+		if (searchName.compare(0, std::strlen(dialogSearchPrefix), dialogSearchPrefix) == 0) {
+			searchNames.push_back(searchName);
+		}
+	}
+	for (const string& searchName : searchNames) {
+		ps_unset_search(&decoder, searchName.c_str());
+	}
+	dialogSearches.searchNames.clear();
+
+	const int32 removedWordCount = dict_remove_added_words(decoder.dict);
+	if (removedWordCount > 0) {
+		logging::debugFormat("Removed {} dialog words from the dictionary.", removedWordCount);
+	}
+}
+
+// Adds the dialog words missing from the decoder's dictionary.
+// The dialog model may have been created with another decoder, so the words missing here may differ
+// from the ones it guessed pronunciations for.
+void addMissingDictionaryWords(const PocketSphinxRecognizer::DialogModel& dialogModel, ps_decoder_t& decoder) {
+	for (const string& word : dialogModel.words) {
+		if (dictionaryContains(*decoder.dict, word)) continue;
+		if (addBinaryDictionaryWord(decoder, word)) continue;
+
+		const auto pair = dialogModel.addedWords.find(word);
+		addDictionaryWord(decoder, word, pair != dialogModel.addedWords.end() ? pair->second : wordToPhones(word));
+	}
+}
+
+lambda_unique_ptr<ngram_model_t> retainLanguageModel(ngram_model_t* languageModel) {
+	return lambda_unique_ptr<ngram_model_t>(
+		ngram_model_retain(languageModel),
 		[](ngram_model_t* lm) { ngram_model_free(lm); });
-	if (!result) {
-		throw runtime_error(fmt::format("Error reading language model from {}.", modelPath.u8string()));
+}
+
+// Returns a reference to the default language model, the selected variant.
+// The model is read once per process and shared by all decoders and biased language models.
+// Sharing is safe because nothing modifies it after loading: dictionary words are added without
+// touching language models, and scoring only writes to per-thread caches.
+// The model keeps its own reference to the log-math parameters, as it outlives the decoder that
+// loaded it once decoder caches are cleared.
+lambda_unique_ptr<ngram_model_t> getDefaultLanguageModel(ps_decoder_t& decoder) {
+	static std::mutex mutex;
+	static string cachedModelPath;
+	static lambda_unique_ptr<logmath_t> cachedLogMath;
+	static lambda_unique_ptr<ngram_model_t> cachedModel;
+
+	const path modelPath = getSphinxLanguageModelPath();
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!cachedModel || cachedModelPath != modelPath.u8string()) {
+		TraceScope span("readLanguageModel", "recognition");
+		lambda_unique_ptr<logmath_t> logMath(
+			logmath_retain(decoder.lmath),
+			[](logmath_t* lmath) { logmath_free(lmath); });
+		// A paged model's file lacks its n-gram arrays, which the host fills in later
+		lm_trie_pages_t* pages = getLanguageModelPages(modelPath.filename().u8string());
+		lambda_unique_ptr<ngram_model_t> model(
+			pages
+				? ngram_model_trie_read_bin_paged(decoder.config, modelPath.u8string().c_str(), logMath.get(), pages)
+				: ngram_model_read(decoder.config, modelPath.u8string().c_str(), NGRAM_AUTO, logMath.get()),
+			[](ngram_model_t* lm) { ngram_model_free(lm); });
+		if (!model) {
+			throw runtime_error(fmt::format("Error reading language model from {}.", modelPath.u8string()));
+		}
+		cachedModel = std::move(model);
+		cachedLogMath = std::move(logMath);
+		cachedModelPath = modelPath.u8string();
 	}
 
+	return retainLanguageModel(cachedModel.get());
+}
+
+// Returns the index of the dictionary words that tokens missing from the dictionary may stand for.
+// It covers the words the decoder's dictionary was read with, not those added for dialogs, and is
+// built once per dictionary file.
+const SimilarWordIndex& getSimilarWordIndex(const dict_t& dictionary) {
+	static std::mutex mutex;
+	static map<string, std::unique_ptr<SimilarWordIndex>> indexes;
+
+	const string dictionaryPath = getSphinxDictionaryPath().u8string();
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& index = indexes[dictionaryPath];
+	if (!index) {
+		index = std::make_unique<SimilarWordIndex>();
+		const auto addWord = [&](const char* word) {
+			if (word && (std::strchr(word, '\'') || std::strchr(word, '.'))) {
+				index->add(word);
+			}
+		};
+		for (s3wid_t wordId = 0; wordId < dictionary.n_init_word; ++wordId) {
+			addWord(dictionary.word[wordId].word);
+		}
+		// Those of a dictionary read with -dictsubset, entered or not
+		for (int32 i = 0; i < dictionary.n_subset_word; ++i) {
+			addWord(dict_bin_wordstr(&dictionary, i));
+		}
+	}
+	return *index;
+}
+
+// Normalizes whitespace, so that dialog texts differing only in formatting share one dialog model
+string normalizeDialog(const string& dialog) {
+	string result;
+	bool pendingSpace = false;
+	for (char c : dialog) {
+		if (std::isspace(static_cast<unsigned char>(c))) {
+			pendingSpace = !result.empty();
+			continue;
+		}
+		if (pendingSpace) result += ' ';
+		pendingSpace = false;
+		result += c;
+	}
 	return result;
 }
 
-lambda_unique_ptr<ngram_model_t> createDialogLanguageModel(
+std::shared_ptr<const PocketSphinxRecognizer::DialogModel> createDialogModel(
 	ps_decoder_t& decoder,
 	const string& dialog
 ) {
+	auto result = std::make_shared<PocketSphinxRecognizer::DialogModel>();
+
 	// Split dialog into normalized words
 	vector<string> words = tokenizeText(
 		dialog,
-		[&](const string& word) { return dictionaryContains(*decoder.dict, word); }
+		[&](const string& word) { return baseDictionaryContains(*decoder.dict, word); },
+		&getSimilarWordIndex(*decoder.dict)
 	);
 
-	// Add dialog-specific words to the dictionary
-	addMissingDictionaryWords(words, decoder);
+	// Guess pronunciations for dialog-specific words
+	result->tokens = words;
+	result->words.insert(words.begin(), words.end());
+	for (const string& word : result->words) {
+		if (!baseDictionaryContains(*decoder.dict, word)) {
+			result->addedWords[word] = wordToPhones(word);
+		}
+	}
+	for (const auto& pair : result->addedWords) {
+		string pronunciation;
+		for (Phone phone : pair.second) {
+			if (pronunciation.length() > 0) pronunciation += " ";
+			pronunciation += PhoneConverter::get().toString(phone);
+		}
+		logging::infoFormat("Unknown word '{}'. Guessing pronunciation '{}'.", pair.first, pronunciation);
+	}
 
 	// Create dialog-specific language model
 	words.insert(words.begin(), "<s>");
 	words.emplace_back("</s>");
-	return createLanguageModel(words, decoder);
+	result->languageModel = createLanguageModel(words, decoder);
+	if (!result->languageModel) {
+		throw runtime_error("Error creating dialog language model.");
+	}
+
+	return result;
 }
 
 lambda_unique_ptr<ngram_model_t> createBiasedLanguageModel(
 	ps_decoder_t& decoder,
-	const string& dialog
+	const PocketSphinxRecognizer::DialogModel& dialogModel
 ) {
-	auto defaultLanguageModel = createDefaultLanguageModel(decoder);
-	auto dialogLanguageModel = createDialogLanguageModel(decoder, dialog);
+	auto defaultLanguageModel = getDefaultLanguageModel(decoder);
 	constexpr int modelCount = 2;
 	array<ngram_model_t*, modelCount> languageModels {
 		defaultLanguageModel.get(),
-		dialogLanguageModel.get()
+		dialogModel.languageModel.get()
 	};
 	array<const char*, modelCount> modelNames { "defaultLM", "dialogLM" };
 	array<float, modelCount> modelWeights { 0.1f, 0.9f };
@@ -112,17 +284,141 @@ lambda_unique_ptr<ngram_model_t> createBiasedLanguageModel(
 		throw runtime_error("Error creating biased language model.");
 	}
 
+	// Scores precomputed before the default model's pages have all arrived would stay degraded
+	// for as long as the dialog's model is cached
+	lm_trie_pages_t* pages = getLanguageModelPages(getSphinxLanguageModelPath().filename().u8string());
+	if (pages && lm_trie_pages_next(pages) >= 0) {
+		return result;
+	}
+
+	// The search scores the dialog's n-grams over and over, including where an utterance starts or
+	// ends within the dialog. Their interpolated scores are precomputed, so that scoring them takes
+	// one table lookup instead of querying both models.
+	ngram_model_t& set = *result;
+	const int order = ngram_model_get_size(&set);
+	vector<int32> sentence { ngram_wid(&set, "<s>") };
+	for (const string& token : dialogModel.tokens) {
+		sentence.push_back(ngram_wid(&set, token.c_str()));
+	}
+	const int32 sentenceEndId = ngram_wid(&set, "</s>");
+	sentence.push_back(sentenceEndId);
+	vector<int32> ngrams;
+	// Adds the n-gram of the word with the history ending before the specified position; the
+	// history stops at the sentence start, as the search's does
+	const auto addNgram = [&](int32 wordId, size_t historyEnd) {
+		ngrams.push_back(wordId);
+		bool sentenceStarted = false;
+		for (int i = 1; i < order; ++i) {
+			const bool known = !sentenceStarted && historyEnd >= static_cast<size_t>(i);
+			const int32 historyWordId = known ? sentence[historyEnd - i] : NGRAM_INVALID_WID;
+			ngrams.push_back(historyWordId);
+			sentenceStarted = sentenceStarted || historyWordId == sentence.front();
+		}
+	};
+	for (size_t i = 1; i < sentence.size(); ++i) {
+		addNgram(sentence[i], i);
+		if (i + 1 < sentence.size()) {
+			addNgram(sentence[i], 1);
+			addNgram(sentenceEndId, i + 1);
+		}
+	}
+	ngram_model_set_precompute(&set, ngrams.data(), static_cast<int32>(ngrams.size() / order));
+
 	return result;
 }
 
-static lambda_unique_ptr<ps_decoder_t> createDecoder(optional<std::string> dialog) {
+// The number of frames whose top Gaussians the wide-beam profiles compute together. Each codebook
+// is then swept for a block of frames while it is in the cache, including codebooks the search may
+// not need; with wide beams, most of them are needed anyway.
+constexpr int32 gaussianBlockFrameCount = 32;
+
+// The number of frames the phone loop search runs ahead of the n-gram search, whose lexicon tree
+// entries it prunes. PocketSphinx defaults to 5; in the benchmark, 2 frames prune more for every
+// profile (12% less time offline, 8% with the balanced profile) at the same agreement.
+constexpr int32 phoneLookaheadFrameCount = 2;
+
+// Overrides the search settings for the given profile
+static void applyDecoderProfile(cmd_ln_t& config, DecoderProfile profile) {
+	cmd_ln_set_int32_r(&config, "-pl_window", phoneLookaheadFrameCount);
+	const int32 blockFrameCount = isGpuScoringEnabled() ? gpuGaussianBlockFrameCount : gaussianBlockFrameCount;
+	switch (profile) {
+		case DecoderProfile::Offline:
+			cmd_ln_set_int32_r(&config, "-topn_block", blockFrameCount);
+			break;
+		case DecoderProfile::OfflineOneBest:
+			cmd_ln_set_boolean_r(&config, "-bestpath", false);
+			cmd_ln_set_int32_r(&config, "-topn_block", blockFrameCount);
+			break;
+		case DecoderProfile::Balanced:
+			cmd_ln_set_int32_r(&config, "-topn_block", blockFrameCount);
+			cmd_ln_set_float64_r(&config, "-beam", 1e-40);
+			cmd_ln_set_float64_r(&config, "-wbeam", 1e-24);
+			cmd_ln_set_float64_r(&config, "-pbeam", 1e-40);
+			cmd_ln_set_int32_r(&config, "-maxhmmpf", 10000);
+			cmd_ln_set_boolean_r(&config, "-fwdflat", false);
+			break;
+		case DecoderProfile::Realtime:
+		case DecoderProfile::RealtimeDownsampled:
+		case DecoderProfile::Streaming:
+			cmd_ln_set_float64_r(&config, "-beam", 1e-30);
+			cmd_ln_set_float64_r(&config, "-wbeam", 1e-20);
+			cmd_ln_set_float64_r(&config, "-pbeam", 1e-30);
+			cmd_ln_set_float64_r(&config, "-lpbeam", 1e-30);
+			cmd_ln_set_int32_r(&config, "-maxhmmpf", 3000);
+			cmd_ln_set_int32_r(&config, "-maxwpf", 10);
+			cmd_ln_set_int32_r(&config, "-topn", 2);
+			cmd_ln_set_boolean_r(&config, "-fwdflat", false);
+			cmd_ln_set_boolean_r(&config, "-bestpath", false);
+			if (profile == DecoderProfile::RealtimeDownsampled) {
+				// See getPhoneAlignment()
+				cmd_ln_set_int32_r(&config, "-ds", 2);
+			}
+			break;
+		default:
+			throw invalid_argument("Unknown decoder profile.");
+	}
+}
+
+// The typical cost of recognizing utterances with the given profile on a desktop CPU, in
+// milliseconds per second of speech, until the cost model has measured it
+static double getDefaultRecognitionCost(DecoderProfile profile) {
+	switch (profile) {
+		case DecoderProfile::Offline:
+		case DecoderProfile::OfflineOneBest:
+			return 310;
+		case DecoderProfile::Balanced:
+			return 140;
+		case DecoderProfile::Realtime:
+		case DecoderProfile::Streaming:
+			return 55;
+		case DecoderProfile::RealtimeDownsampled:
+			return 50;
+		default:
+			throw invalid_argument("Unknown decoder profile.");
+	}
+}
+
+// Creates the decoder's search with the default language model, which needs the whole dictionary
+static void setDefaultSearch(ps_decoder_t& decoder) {
+	lambda_unique_ptr<ngram_model_t> languageModel = getDefaultLanguageModel(decoder);
+	if (ps_set_lm(&decoder, defaultSearchName, languageModel.get())) {
+		throw runtime_error("Error setting default language model.");
+	}
+}
+
+// Creates a decoder. Decoders for strict dialogs (dialogOnly) start without the search of the
+// default language model, whose lexicon tree of the whole dictionary takes most of a decoder's
+// creation time and memory, and with a compiled dictionary whose words are entered as dialogs
+// need them (-dictsubset). They only get both once they have to recognize without a strict
+// dialog, see useDefaultSearch().
+static lambda_unique_ptr<ps_decoder_t> createDecoder(DecoderProfile profile, int sampleRate, bool dialogOnly) {
 	lambda_unique_ptr<cmd_ln_t> config(
 		cmd_ln_init(
 			nullptr, ps_args(), true,
 			// Set acoustic model
-			"-hmm", (getSphinxModelDirectory() / "acoustic-model").u8string().c_str(),
+			"-hmm", getSphinxAcousticModelPath(sampleRate).u8string().c_str(),
 			// Set pronunciation dictionary
-			"-dict", (getSphinxModelDirectory() / "cmudict-en-us.dict").u8string().c_str(),
+			"-dict", getSphinxDictionaryPath().u8string().c_str(),
 			// Add noise against zero silence
 			// (see http://cmusphinx.sourceforge.net/wiki/faq#qwhy_my_accuracy_is_poor)
 			"-dither", "yes",
@@ -130,97 +426,319 @@ static lambda_unique_ptr<ps_decoder_t> createDecoder(optional<std::string> dialo
 			"-remove_silence", "no",
 			// Perform per-utterance cepstral mean normalization
 			"-cmn", "batch",
+			// Map the read-only model files (and the binary LM and dictionary) instead of copying them
+			"-mmap", "yes",
 			nullptr),
 		[](cmd_ln_t* config) { cmd_ln_free_r(config); });
 	if (!config) throw runtime_error("Error creating configuration.");
+	setSphinxFrontEndSampleRate(*config, sampleRate);
+	applyDecoderProfile(*config, profile);
+	if (dialogOnly) {
+		cmd_ln_set_boolean_r(config.get(), "-dictsubset", true);
+	}
 
-	lambda_unique_ptr<ps_decoder_t> decoder(
-		ps_init(config.get()),
-		[](ps_decoder_t* recognizer) { ps_free(recognizer); });
-	if (!decoder) throw runtime_error("Error creating speech decoder.");
+	lambda_unique_ptr<ps_decoder_t> decoder = initDecoder(*config);
+	useGpuScoring(*decoder);
+	if (profile == DecoderProfile::Streaming) {
+		// Normalize with the running mean (see LiveCmnState). The acoustic model's feat.params
+		// overrides -cmn, so switch the feature computation itself, as sphinxbase does when it
+		// is fed blocks of frames. The mean starts at the model's -cmninit.
+		decoder->acmod->fcb->cmn = CMN_LIVE;
+	}
 
-	// Set language model
-	lambda_unique_ptr<ngram_model_t> languageModel(dialog
-		? createBiasedLanguageModel(*decoder, *dialog)
-		: createDefaultLanguageModel(*decoder));
-	ps_set_lm(decoder.get(), "lm", languageModel.get());
-	ps_set_search(decoder.get(), "lm");
+	if (!dialogOnly) {
+		setDefaultSearch(*decoder);
+		ps_set_search(decoder.get(), defaultSearchName);
+	}
 
 	return decoder;
 }
 
+// Gives a decoder created for strict dialogs the whole dictionary and the search of the default
+// language model, for recognizing without a dialog or with one that has no words. Its dialog
+// searches are removed, as they were built with the entered words only.
+static void useDefaultSearch(ps_decoder_t& decoder, PocketSphinxRecognizer::DialogSearches& dialogSearches) {
+	if (ps_get_lm(&decoder, defaultSearchName)) return;
+
+	TraceScope span("useDefaultSearch", "recognition");
+	if (decoder.dict->subset_word) {
+		removeDialogSearches(decoder, dialogSearches);
+		if (ps_load_dict(&decoder, getSphinxDictionaryPath().u8string().c_str(), nullptr, nullptr) < 0) {
+			throw runtime_error("Error reading dictionary.");
+		}
+	}
+	setDefaultSearch(decoder);
+}
+
+// Returns the model of a dialog, creating it with the decoder unless it is cached.
+// Dialog models are cached, so repeated dialogs skip tokenization, G2P and language model creation.
+static std::shared_ptr<const PocketSphinxRecognizer::DialogModel> getDialogModel(
+	ps_decoder_t& decoder,
+	const string& dialog,
+	LruCache<string, std::shared_ptr<const PocketSphinxRecognizer::DialogModel>>& dialogModels
+) {
+	const string dialogKey = normalizeDialog(dialog);
+	if (auto cachedDialogModel = dialogModels.get(dialogKey)) {
+		logging::debug("Reusing cached dialog language model.");
+		countEvent(AnalysisCounter::DialogModelCacheHits);
+		return *cachedDialogModel;
+	}
+
+	countEvent(AnalysisCounter::DialogModelCacheMisses);
+	TraceScope span("createDialogModel", "recognition");
+	std::shared_ptr<const PocketSphinxRecognizer::DialogModel> dialogModel = createDialogModel(decoder, dialog);
+	dialogModels.set(dialogKey, dialogModel);
+	return dialogModel;
+}
+
+// Selects the language model to use for the specified dialog.
+// Verbatim dialogs use the biased one, for the utterances whose words can't be aligned.
+// The searches of recent dialogs stay registered on the decoder, so that alternating between a
+// few dialogs doesn't rebuild their lexicon trees.
+static void prepareDecoder(
+	ps_decoder_t& decoder,
+	const optional<string>& dialog,
+	DialogMode dialogMode,
+	LruCache<string, std::shared_ptr<const PocketSphinxRecognizer::DialogModel>>& dialogModels,
+	PocketSphinxRecognizer::DialogSearches& dialogSearches
+) {
+	if (!dialog) {
+		useDefaultSearch(decoder, dialogSearches);
+		ps_set_search(&decoder, defaultSearchName);
+		return;
+	}
+
+	auto& searchNames = dialogSearches.searchNames;
+	const string dialogKey = normalizeDialog(*dialog);
+	const auto cachedSearch = std::find_if(searchNames.begin(), searchNames.end(),
+		[&](const auto& pair) { return pair.first == dialogKey; });
+	if (cachedSearch != searchNames.end()) {
+		logging::debug("Reusing dialog search.");
+		std::rotate(searchNames.begin(), cachedSearch, cachedSearch + 1);
+		ps_set_search(&decoder, searchNames.front().second.c_str());
+		return;
+	}
+
+	while (searchNames.size() >= PocketSphinxRecognizer::dialogSearchCacheCapacity) {
+		ps_unset_search(&decoder, searchNames.back().second.c_str());
+		searchNames.pop_back();
+	}
+	if (dict_size(decoder.dict) - decoder.dict->n_init_word > maxAddedDictionaryWordCount) {
+		removeDialogSearches(decoder, dialogSearches);
+	}
+
+	const std::shared_ptr<const PocketSphinxRecognizer::DialogModel> dialogModel =
+		getDialogModel(decoder, *dialog, dialogModels);
+
+	// A dialog without words, e.g. only punctuation, leaves nothing to restrict recognition to
+	const bool strict = dialogMode == DialogMode::Strict && !dialogModel->words.empty();
+	if (!strict) {
+		useDefaultSearch(decoder, dialogSearches);
+	}
+
+	// Words must be in the dictionary before the search is created
+	addMissingDictionaryWords(*dialogModel, decoder);
+
+	lambda_unique_ptr<ngram_model_t> languageModel = strict
+		? retainLanguageModel(dialogModel->languageModel.get())
+		: createBiasedLanguageModel(decoder, *dialogModel);
+	const string searchName = fmt::format("{}{}", dialogSearchPrefix, dialogSearches.nextSearchId++);
+	if (ps_set_lm(&decoder, searchName.c_str(), languageModel.get())) {
+		throw runtime_error("Error setting dialog language model.");
+	}
+	searchNames.emplace(searchNames.begin(), dialogKey, searchName);
+	ps_set_search(&decoder, searchName.c_str());
+}
+
+// Distributes the dialog's words over the utterances in proportion to the utterances' durations,
+// weighting each word by its number of phones: a word goes to the utterance in which its middle
+// falls. Speaking rate varies less within a line than the pauses, so a word's share of the dialog's
+// phones predicts its share of the speech.
+// Needs no prepared decoder: words missing from its dictionary are counted by their guessed
+// pronunciations.
+static vector<vector<string>> distributeDialogWords(
+	ps_decoder_t& decoder,
+	const PocketSphinxRecognizer::DialogModel& dialogModel,
+	const vector<TimeRange>& utteranceTimeRanges
+) {
+	if (dialogModel.tokens.empty() || utteranceTimeRanges.empty()) return {};
+
+	vector<int> phoneCounts;
+	int totalPhoneCount = 0;
+	for (const string& word : dialogModel.tokens) {
+		int phoneCount;
+		if (baseDictionaryContains(*decoder.dict, word)) {
+			phoneCount = dict_pronlen(decoder.dict, getWordId(word, *decoder.dict));
+		} else {
+			const auto pair = dialogModel.addedWords.find(word);
+			phoneCount = static_cast<int>(
+				(pair != dialogModel.addedWords.end() ? pair->second : wordToPhones(word)).size());
+		}
+		phoneCounts.push_back(phoneCount);
+		totalPhoneCount += phoneCount;
+	}
+
+	// Where each utterance ends in the speech, with the pauses left out
+	vector<double> speechEnds;
+	double speechDuration = 0;
+	for (const TimeRange& utteranceTimeRange : utteranceTimeRanges) {
+		speechDuration += static_cast<double>(utteranceTimeRange.getDuration().count());
+		speechEnds.push_back(speechDuration);
+	}
+
+	vector<vector<string>> result(utteranceTimeRanges.size());
+	size_t utteranceIndex = 0;
+	int phonesBefore = 0;
+	for (size_t i = 0; i < dialogModel.tokens.size(); ++i) {
+		const double middle = (phonesBefore + phoneCounts[i] / 2.0) / totalPhoneCount * speechDuration;
+		while (utteranceIndex + 1 < speechEnds.size() && middle >= speechEnds[utteranceIndex]) {
+			++utteranceIndex;
+		}
+		result[utteranceIndex].push_back(dialogModel.tokens[i]);
+		phonesBefore += phoneCounts[i];
+	}
+	return result;
+}
+
+// Forced alignment keeps a backpointer for every emitting state of its words in every frame, in a
+// token buffer the search grows as needed. Each decoder keeps a buffer of up to this many tokens
+// (4 MB) for the next utterance; longer alignments borrow one buffer shared by all decoders instead,
+// so that the rare long utterances don't grow every pooled decoder's to their size.
+constexpr int maxDecoderAlignmentTokenCount = 1 << 19;
+
+// Lends the shared alignment token buffer to a state alignment search while it aligns an utterance
+// that needs more than maxDecoderAlignmentTokenCount tokens. Such alignments take turns.
+class SharedAlignmentTokensScope {
+public:
+	SharedAlignmentTokensScope(ps_search_t& search, int frameCount) :
+		search(reinterpret_cast<state_align_search_t&>(search))
+	{
+		const int64_t tokenCount = int64_t(frameCount) * this->search.n_emit_state;
+		if (tokenCount <= maxDecoderAlignmentTokenCount) return;
+
+		lock = std::unique_lock<std::mutex>(mutex);
+		swapTokens();
+	}
+
+	~SharedAlignmentTokensScope() {
+		if (lock) swapTokens();
+	}
+
+	SharedAlignmentTokensScope(const SharedAlignmentTokensScope&) = delete;
+	SharedAlignmentTokensScope& operator=(const SharedAlignmentTokensScope&) = delete;
+
+private:
+	void swapTokens() {
+		std::swap(search.tokens, sharedTokens);
+		std::swap(search.n_tok_alloc, sharedTokenCount);
+	}
+
+	static std::mutex mutex;
+	// Grown by the searches that borrow it, and kept for the next long utterance
+	static state_align_hist_t* sharedTokens;
+	static int sharedTokenCount;
+
+	state_align_search_t& search;
+	std::unique_lock<std::mutex> lock;
+};
+
+std::mutex SharedAlignmentTokensScope::mutex;
+state_align_hist_t* SharedAlignmentTokensScope::sharedTokens = nullptr;
+int SharedAlignmentTokensScope::sharedTokenCount = 0;
+
 optional<Timeline<Phone>> getPhoneAlignment(
 	const vector<s3wid_t>& wordIds,
-	const vector<int16_t>& audioBuffer,
+	const CepstralFrames& cepstralFrames,
 	ps_decoder_t& decoder)
 {
 	if (wordIds.empty()) return boost::none;
 
-	// Create alignment list
-	lambda_unique_ptr<ps_alignment_t> alignment(
-		ps_alignment_init(decoder.d2p),
-		[](ps_alignment_t* alignment) { ps_alignment_free(alignment); });
-	if (!alignment) throw runtime_error("Error creating alignment.");
+	// Fill the decoder's alignment list, created on its first alignment. Its vectors and the
+	// search's HMMs and tokens keep their memory, so later utterances rarely allocate.
+	if (decoder.align) {
+		ps_alignment_reset(decoder.align);
+	} else {
+		decoder.align = ps_alignment_init(decoder.d2p);
+		if (!decoder.align) throw runtime_error("Error creating alignment.");
+	}
+	ps_alignment_t* alignment = decoder.align;
 	for (s3wid_t wordId : wordIds) {
 		// Add word. Initial value for duration is ignored.
-		ps_alignment_add_word(alignment.get(), wordId, 0);
+		ps_alignment_add_word(alignment, wordId, 0);
 	}
-	int error = ps_alignment_populate(alignment.get());
+	int error = ps_alignment_populate(alignment);
 	if (error) throw runtime_error("Error populating alignment struct.");
 
-	// Create search structure
+	// Prepare search structure
 	acmod_t* acousticModel = decoder.acmod;
-	lambda_unique_ptr<ps_search_t> search(
-		state_align_search_init("state_align", decoder.config, acousticModel, alignment.get()),
-		[](ps_search_t* search) { ps_search_free(search); });
-	if (!search) throw runtime_error("Error creating search.");
+	if (decoder.align_search) {
+		state_align_search_reset(decoder.align_search);
+	} else {
+		decoder.align_search = state_align_search_init("state_align", decoder.config, acousticModel, alignment);
+		if (!decoder.align_search) throw runtime_error("Error creating search.");
+	}
+	ps_search_t* search = decoder.align_search;
+
+	// Align at the full frame rate, even if word recognition was downsampled
+	const int dsRatio = acmod_set_ds_ratio(acousticModel, 1);
+	auto restoreDsRatio = gsl::finally([&]() { acmod_set_ds_ratio(acousticModel, dsRatio); });
 
 	// Start recognition
 	error = acmod_start_utt(acousticModel);
 	if (error) throw runtime_error("Error starting utterance processing for alignment.");
 
 	{
+		// Long utterances are aligned in the shared token buffer
+		SharedAlignmentTokensScope sharedTokens(*search, cepstralFrames.getFrameCount());
+
 		// Eventually end recognition
 		auto endRecognition = gsl::finally([&]() { acmod_end_utt(acousticModel); });
 
 		// Start search
-		ps_search_start(search.get());
+		ps_search_start(search);
 
 		// Process entire audio clip
-		const int16* nextSample = audioBuffer.data();
-		size_t remainingSamples = audioBuffer.size();
+		const CepstralFrames::frame_buffer frames = cepstralFrames.copyFrames();
+		mfcc_t** nextFrame = frames.get();
+		int remainingFrames = cepstralFrames.getFrameCount();
 		const bool fullUtterance = true;
-		while (acmod_process_raw(acousticModel, &nextSample, &remainingSamples, fullUtterance) > 0) {
+		int searchedFrameCount = 0;
+		while (acmod_process_cep(acousticModel, &nextFrame, &remainingFrames, fullUtterance) > 0) {
 			while (acousticModel->n_feat_frame > 0) {
-				ps_search_step(search.get(), acousticModel->output_frame);
+				// The search is reset before its next use, so it needn't be finished
+				if (searchedFrameCount++ % cancellationCheckFrameInterval == 0) {
+					throwIfCancelled();
+				}
+				ps_search_step(search, acousticModel->output_frame);
 				acmod_advance(acousticModel);
 			}
 		}
 
 		// End search
-		error = ps_search_finish(search.get());
+		error = ps_search_finish(search);
 		if (error) return boost::none;
 	}
 
 	// Extract phones with timestamps
-	char** phoneNames = decoder.dict->mdef->ciname;
+	const vector<optional<Phone>>& ciPhones = getCiPhones(decoder);
 	Timeline<Phone> result;
 	for (
-		ps_alignment_iter_t* it = ps_alignment_phones(alignment.get());
+		ps_alignment_iter_t* it = ps_alignment_phones(alignment);
 		it;
 		it = ps_alignment_iter_next(it)
 	) {
 		// Get phone
 		ps_alignment_entry_t* phoneEntry = ps_alignment_iter_get(it);
 		const s3cipid_t phoneId = phoneEntry->id.pid.cipid;
-		string phoneName = phoneNames[phoneId];
+		const optional<Phone> ciPhone = ciPhones[phoneId];
 
-		if (phoneName == "SIL") continue;
+		// Skip silence
+		if (!ciPhone) continue;
 
 		// Add entry
 		centiseconds start(phoneEntry->start);
 		centiseconds duration(phoneEntry->duration);
-		Phone phone = PhoneConverter::get().parse(phoneName);
+		Phone phone = *ciPhone;
 		if (phone == Phone::AH && duration < 6_cs) {
 			// Heuristic: < 6_cs is schwa. PocketSphinx doesn't differentiate.
 			phone = Phone::Schwa;
@@ -231,6 +749,25 @@ optional<Timeline<Phone>> getPhoneAlignment(
 	return result;
 }
 
+// Returns the words of the decoder's last alignment, without silence and filler words
+static Timeline<string> getAlignedWords(ps_decoder_t& decoder) {
+	dict_t& dictionary = *decoder.dict;
+	Timeline<string> result;
+	for (
+		ps_alignment_iter_t* it = ps_alignment_words(decoder.align);
+		it;
+		it = ps_alignment_iter_next(it)
+	) {
+		const ps_alignment_entry_t* wordEntry = ps_alignment_iter_get(it);
+		const s3wid_t wordId = wordEntry->id.wid;
+		if (!dict_real_word(&dictionary, wordId) || wordEntry->duration <= 0) continue;
+
+		const centiseconds start(wordEntry->start);
+		result.set(start, start + centiseconds(wordEntry->duration), dict_basestr(&dictionary, wordId));
+	}
+	return result;
+}
+
 // Some words have multiple pronunciations, one of which results in better animation than the others.
 // This function returns the optimal pronunciation for a select set of these words.
 string fixPronunciation(const string& word) {
@@ -247,70 +784,156 @@ string fixPronunciation(const string& word) {
 	return pair != replacements.end() ? pair->second : word;
 }
 
+// Recognizes the words of an utterance, unless that has been done incrementally, then aligns their
+// phones with the speech.
+// Returns none if the words can't be aligned.
+static optional<Timeline<Phone>> recognizeAndAlignWords(
+	const CepstralFrames& cepstralFrames,
+	const RecognizedUtterance* recognizedUtterance,
+	TimeRange utteranceTimeRange,
+	TimeRange paddedTimeRange,
+	ps_decoder_t& decoder
+) {
+	// Record the codebooks evaluated during word recognition, so that alignment can reuse them.
+	// Incremental recognition has recorded them already.
+	if (!recognizedUtterance) {
+		acmod_set_cache_mode(decoder.acmod, PS_MGAU_CACHE_RECORD);
+	}
+	auto stopCaching = gsl::finally([&]() { acmod_set_cache_mode(decoder.acmod, PS_MGAU_CACHE_OFF); });
+
+	// Get words
+	const LiveCmnState cmnBeforeRecognition(decoder);
+	BoundedTimeline<string> words = recognizedUtterance
+		? recognizedUtterance->words
+		: measureStage(AnalysisStage::WordRecognition, [&] {
+			return recognizeWords(cepstralFrames, decoder);
+		});
+
+	// Building the utterance text is only worth it if debug output is enabled
+	if (logging::isEnabled(logging::Level::Debug)) {
+		// Log utterance text
+		string text;
+		for (auto& timedWord : words) {
+			string word = timedWord.getValue();
+			// Skip details
+			if (word == "<s>" || word == "</s>" || word == "<sil>") {
+				continue;
+			}
+			word = stripPronunciationIndex(word);
+			if (!text.empty()) {
+				text += " ";
+			}
+			text += word;
+		}
+		logTimedEvent("utterance", utteranceTimeRange, text);
+
+		// Log words
+		for (Timed<string> timedWord : words) {
+			timedWord.getTimeRange().shift(paddedTimeRange.getStart());
+			logTimedEvent("word", timedWord);
+		}
+	}
+
+	// Convert word strings to word IDs using dictionary
+	vector<s3wid_t> wordIds;
+	for (const auto& timedWord : words) {
+		const string fixedWord = fixPronunciation(timedWord.getValue());
+		wordIds.push_back(getWordId(fixedWord, *decoder.dict));
+	}
+
+	// With live CMN, word recognition has updated the mean. Align from the mean it started with, so
+	// that the frames are normalized as they were when their codebooks were recorded, then continue
+	// from the updated mean. Incrementally recognized frames are aligned as they were normalized.
+	feat_t& features = *decoder.acmod->fcb;
+	const cmn_type_t cmnType = features.cmn;
+	const LiveCmnState cmnAfterRecognition(decoder);
+	if (recognizedUtterance) {
+		features.cmn = CMN_NONE;
+	} else {
+		cmnBeforeRecognition.restore(decoder);
+	}
+	auto keepCmnUpdate = gsl::finally([&]() {
+		features.cmn = cmnType;
+		cmnAfterRecognition.restore(decoder);
+	});
+
+	// Align the words' phones with speech, over the same frames as word recognition
+	acmod_set_cache_mode(decoder.acmod, PS_MGAU_CACHE_REPLAY);
+	return measureStage(AnalysisStage::Alignment, [&] {
+		return getPhoneAlignment(wordIds, cepstralFrames, decoder);
+	});
+}
+
 static Timeline<Phone> utteranceToPhones(
 	const AudioClip& audioClip,
 	TimeRange utteranceTimeRange,
+	const optional<vector<string>>& utteranceWords,
+	const RecognizedUtterance* recognizedUtterance,
 	ps_decoder_t& decoder,
 	ProgressSink& utteranceProgressSink
 ) {
-	ProgressMerger utteranceProgressMerger(utteranceProgressSink);
-	ProgressSink& wordRecognitionProgressSink =
-		utteranceProgressMerger.addSource("word recognition (PocketSphinx recognizer)", 1.0);
-	ProgressSink& alignmentProgressSink =
-		utteranceProgressMerger.addSource("alignment (PocketSphinx recognizer)", 0.5);
-
 	// Pad time range to give PocketSphinx some breathing room
-	TimeRange paddedTimeRange = utteranceTimeRange;
-	const centiseconds padding(3);
-	paddedTimeRange.grow(padding);
-	paddedTimeRange.trim(audioClip.getTruncatedRange());
+	const TimeRange paddedTimeRange = getPaddedUtteranceRange(utteranceTimeRange, audioClip);
 
+	// If the clip is already buffered at the decoder's rate, this is a view of that buffer
 	const unique_ptr<AudioClip> clipSegment = audioClip.clone()
 		| segment(paddedTimeRange)
-		| resample(sphinxSampleRate);
-	const auto audioBuffer = copyTo16bitBuffer(*clipSegment);
+		| resample(getDecoderSampleRate(decoder));
 
-	// Get words
-	BoundedTimeline<string> words = recognizeWords(audioBuffer, decoder);
-	wordRecognitionProgressSink.reportProgress(1.0);
-
-	// Log utterance text
-	string text;
-	for (auto& timedWord : words) {
-		string word = timedWord.getValue();
-		// Skip details
-		if (word == "<s>" || word == "</s>" || word == "<sil>") {
-			continue;
-		}
-		word = regex_replace(word, regex("\\(\\d\\)"), "");
-		if (!text.empty()) {
-			text += " ";
-		}
-		text += word;
+	// Compute features once for both word recognition and alignment, unless incremental recognition
+	// has computed them already
+	optional<CepstralFrames> computedCepstralFrames;
+	if (!recognizedUtterance) {
+		vector<int16_t> audioBufferStorage;
+		const gsl::span<const int16_t> audioBuffer = get16bitSamples(*clipSegment, audioBufferStorage);
+		computedCepstralFrames = measureStage(AnalysisStage::FeatureExtraction, [&] {
+			return CepstralFrames(audioBuffer, decoder);
+		});
 	}
-	logTimedEvent("utterance", utteranceTimeRange, text);
+	const CepstralFrames& cepstralFrames = recognizedUtterance
+		? recognizedUtterance->normalizedFrames
+		: *computedCepstralFrames;
 
-	// Log words
-	for (Timed<string> timedWord : words) {
-		timedWord.getTimeRange().shift(paddedTimeRange.getStart());
-		logTimedEvent("word", timedWord);
+	// Align the words of a verbatim dialog directly. They may not fit the audio, e.g. if they were
+	// distributed to the wrong utterance; then the words are recognized instead.
+	optional<Timeline<Phone>> phoneAlignment;
+	if (utteranceWords && !recognizedUtterance) {
+		if (logging::isEnabled(logging::Level::Debug)) {
+			logTimedEvent("utterance", utteranceTimeRange, join(*utteranceWords, " "));
+		}
+		vector<s3wid_t> wordIds { decoder.dict->startwid };
+		for (const string& word : *utteranceWords) {
+			wordIds.push_back(getWordId(word, *decoder.dict));
+		}
+		wordIds.push_back(decoder.dict->finishwid);
+		phoneAlignment = measureStage(AnalysisStage::Alignment, [&] {
+			return getPhoneAlignment(wordIds, cepstralFrames, decoder);
+		});
+		if (!phoneAlignment) {
+			logging::debugFormat(
+				"Dialog words at {} don't fit the audio; recognizing them.",
+				formatDuration(utteranceTimeRange.getStart())
+			);
+		}
 	}
 
-	// Convert word strings to word IDs using dictionary
-	vector<s3wid_t> wordIds;
-	for (const auto& timedWord : words) {
-		const string fixedWord = fixPronunciation(timedWord.getValue());
-		wordIds.push_back(getWordId(fixedWord, *decoder.dict));
+	if (!phoneAlignment) {
+		phoneAlignment = recognizeAndAlignWords(
+			cepstralFrames, recognizedUtterance, utteranceTimeRange, paddedTimeRange, decoder);
 	}
-
-	// Align the words' phones with speech
-	auto phoneAlignment = getPhoneAlignment(wordIds, audioBuffer, decoder);
 	Timeline<Phone> utterancePhones = phoneAlignment.has_value()
 		? phoneAlignment.value()
 		: ContinuousTimeline<Phone>(clipSegment->getTruncatedRange(), Phone::Noise);
-	alignmentProgressSink.reportProgress(1.0);
+	utteranceProgressSink.reportProgress(1.0);
 	utterancePhones.shift(paddedTimeRange.getStart());
 
+	// The words as aligned with the phones, which are more precise than the recognized ones
+	if (phoneAlignment) {
+		Timeline<string> alignedWords = getAlignedWords(decoder);
+		alignedWords.shift(paddedTimeRange.getStart());
+		reportUtteranceWords(alignedWords);
+	}
+
 	// Log raw phones
 	for (const auto& timedPhone : utterancePhones) {
 		logTimedEvent("rawPhone", timedPhone);
@@ -330,12 +953,185 @@ static Timeline<Phone> utteranceToPhones(
 	return utterancePhones;
 }
 
+decoderPreparer PocketSphinxRecognizer::getDecoderPreparer(DecoderCache& decoderCache) const {
+	return [this, &decoderCache](ps_decoder_t& decoder, const optional<string>& dialog) {
+		// Take the decoder's searches until it is prepared anew. If that fails halfway, the
+		// decoder starts over with no dialog searches.
+		PocketSphinxRecognizer::DialogSearches dialogSearches;
+		bool isKnown;
+		{
+			std::lock_guard<std::mutex> lock(decoderCache.dialogSearchesMutex);
+			const auto it = decoderCache.dialogSearches.find(&decoder);
+			isKnown = it != decoderCache.dialogSearches.end();
+			if (isKnown) {
+				dialogSearches = std::move(it->second);
+				decoderCache.dialogSearches.erase(it);
+			}
+		}
+		if (!isKnown) {
+			removeDialogSearches(decoder, dialogSearches);
+		}
+		prepareDecoder(decoder, dialog, dialogMode, decoderCache.dialogModels, dialogSearches);
+		{
+			std::lock_guard<std::mutex> lock(decoderCache.dialogSearchesMutex);
+			decoderCache.dialogSearches[&decoder] = std::move(dialogSearches);
+		}
+		decoderCache.cmnPrior.apply(decoder);
+	};
+}
+
+utteranceToPhonesFunction PocketSphinxRecognizer::getUtteranceToPhones(DecoderCache& decoderCache) {
+	return [&decoderCache](
+		const AudioClip& audioClip,
+		TimeRange utteranceTimeRange,
+		const optional<vector<string>>& utteranceWords,
+		const RecognizedUtterance* recognizedUtterance,
+		ps_decoder_t& decoder,
+		ProgressSink& utteranceProgressSink
+	) {
+		Timeline<Phone> phones = utteranceToPhones(
+			audioClip, utteranceTimeRange, utteranceWords, recognizedUtterance, decoder, utteranceProgressSink);
+		decoderCache.cmnPrior.update(decoder);
+		return phones;
+	};
+}
+
+dialogDistributor PocketSphinxRecognizer::getDialogDistributor(DecoderCache& decoderCache) const {
+	if (dialogMode != DialogMode::Verbatim) return nullptr;
+
+	return [&decoderCache](ps_decoder_t& decoder, const string& dialog, const vector<TimeRange>& utteranceTimeRanges) {
+		const auto dialogModel = getDialogModel(decoder, dialog, decoderCache.dialogModels);
+		return distributeDialogWords(decoder, *dialogModel, utteranceTimeRanges);
+	};
+}
+
 BoundedTimeline<Phone> PocketSphinxRecognizer::recognizePhones(
 	const AudioClip& inputAudioClip,
 	optional<std::string> dialog,
+	SpeakerProfile* speakerProfile,
 	int maxThreadCount,
-	ProgressSink& progressSink
+	ProgressSink& progressSink,
+	const RecognizedPhonesSink& phonesSink
 ) const {
+	DecoderCache& decoderCache = getDecoderCache(getSphinxSampleRate(inputAudioClip.getSampleRate()));
 	return ::recognizePhones(
-		inputAudioClip, dialog, &createDecoder, &utteranceToPhones, maxThreadCount, progressSink);
+		inputAudioClip,
+		dialog,
+		speakerProfile,
+		decoderCache.decoderPool,
+		decoderCache.utterancePhones,
+		costModel,
+		getDecoderPreparer(decoderCache),
+		getUtteranceToPhones(decoderCache),
+		maxThreadCount,
+		progressSink,
+		getDialogDistributor(decoderCache),
+		phonesSink
+	);
+}
+
+vector<BoundedTimeline<Phone>> PocketSphinxRecognizer::recognizePhonesBatch(
+	const vector<RecognitionInput>& inputs,
+	int maxThreadCount,
+	ProgressSink& progressSink
+) const {
+	DecoderCache& decoderCache = getDecoderCache(getSphinxSampleRate(inputs));
+	return ::recognizePhonesBatch(
+		inputs,
+		decoderCache.decoderPool,
+		decoderCache.utterancePhones,
+		costModel,
+		getDecoderPreparer(decoderCache),
+		getUtteranceToPhones(decoderCache),
+		maxThreadCount,
+		progressSink,
+		getDialogDistributor(decoderCache)
+	);
+}
+
+unique_ptr<SteppedRecognition> PocketSphinxRecognizer::beginRecognition(
+	const vector<RecognitionInput>& inputs,
+	ProgressSink& progressSink
+) const {
+	DecoderCache& decoderCache = getDecoderCache(getSphinxSampleRate(inputs));
+	return std::make_unique<PhoneRecognitionBatch>(
+		inputs,
+		decoderCache.decoderPool,
+		decoderCache.utterancePhones,
+		costModel,
+		getDecoderPreparer(decoderCache),
+		getUtteranceToPhones(decoderCache),
+		1,
+		progressSink,
+		getDialogDistributor(decoderCache)
+	);
+}
+
+unique_ptr<UtteranceRecognizer> PocketSphinxRecognizer::createUtteranceRecognizer(
+	const optional<string>& dialog,
+	int sampleRate
+) const {
+	redirectPocketSphinxOutput();
+
+	DecoderCache& decoderCache = getDecoderCache(getSphinxSampleRate(sampleRate));
+	return std::make_unique<DecoderUtteranceRecognizer>(
+		decoderCache.decoderPool,
+		getDecoderPreparer(decoderCache),
+		dialog,
+		getUtteranceToPhones(decoderCache)
+	);
+}
+
+size_t PocketSphinxRecognizer::estimateDecoderMemory(int maxThreadCount) const {
+	return decoderMemoryEstimate.getMissingDecoderSize(getDecoderCache(sphinxSampleRate).decoderPool, maxThreadCount);
+}
+
+milliseconds PocketSphinxRecognizer::estimateDuration(centiseconds audioDuration, int maxThreadCount) const {
+	return costModel.estimateDuration(audioDuration, maxThreadCount);
+}
+
+void PocketSphinxRecognizer::prewarm(int decoderCount) const {
+	redirectPocketSphinxOutput();
+	prewarmDecoders(getDecoderCache(sphinxSampleRate).decoderPool, decoderCount);
+}
+
+void PocketSphinxRecognizer::clearDecoderCache() {
+	std::lock_guard<std::mutex> lock(decoderCachesMutex);
+	decoderCaches.clear();
+}
+
+// Measured size of the first decoder, including the default language model shared by all decoders
+PocketSphinxRecognizer::PocketSphinxRecognizer(DecoderProfile profile, DialogMode dialogMode) :
+	profile(profile),
+	dialogMode(dialogMode),
+	decoderMemoryEstimate(80 * 1024 * 1024),
+	costModel(RecognitionCostModel::defaultVadCost, getDefaultRecognitionCost(profile))
+{}
+
+PocketSphinxRecognizer::DecoderCache::DecoderCache(
+	DecoderProfile profile,
+	DialogMode dialogMode,
+	int sampleRate,
+	DecoderMemoryEstimate& decoderMemoryEstimate
+) :
+	decoderPool([profile, dialogMode, sampleRate, &decoderMemoryEstimate] {
+		const bool dialogOnly = dialogMode == DialogMode::Strict;
+		return decoderMemoryEstimate.measure([profile, sampleRate, dialogOnly] {
+			return createDecoder(profile, sampleRate, dialogOnly);
+		});
+	}),
+	dialogModels(dialogModelCacheCapacity)
+{}
+
+PocketSphinxRecognizer::DecoderCache& PocketSphinxRecognizer::getDecoderCache(int sampleRate) const {
+	// All decoders of this recognizer share its profile and the selected models of the Sphinx model directory
+	const string configurationKey = getSphinxLanguageModelPath().u8string()
+		+ "|" + getSphinxAcousticModelPath(sampleRate).u8string();
+
+	std::lock_guard<std::mutex> lock(decoderCachesMutex);
+	auto& decoderCache = decoderCaches[configurationKey];
+	if (!decoderCache) {
+		decoderCache = std::make_unique<DecoderCache>(profile, dialogMode, sampleRate, decoderMemoryEstimate);
+	}
+	return *decoderCache;
 }
@@ -2,13 +2,156 @@
 
 #include "Recognizer.h"
 #include "pocketSphinxTools.h"
+#include "tools/LruCache.h"
+#include <map>
+#include <set>
+#include <mutex>
+
+// Search settings of the decoder, trading accuracy for speed
+enum class DecoderProfile {
+	// PocketSphinx's default search: wide beams, followed by flat-lexicon and best-path passes
+	Offline,
+	// Tighter beams and no flat-lexicon pass
+	Balanced,
+	// Narrow beams and a single pass, for live audio
+	Realtime,
+	// Realtime, with word recognition evaluating all Gaussian codebooks only every other frame.
+	// Alignment still runs at the full frame rate, which keeps the mouth timing.
+	RealtimeDownsampled,
+	// Offline, without the best-path pass: the words come straight from the backpointer table of the
+	// flat-lexicon pass, so no word lattice is built at the end of each utterance
+	OfflineOneBest,
+	// Realtime, with live cepstral mean normalization: frames are normalized with the mean of the
+	// speech heard so far instead of the whole utterance's, starting from the mean left by the last
+	// utterance recognized. Streams can then recognize an utterance while it is being spoken.
+	Streaming
+};
+
+// How the dialog, if any, constrains word recognition
+enum class DialogMode {
+	// The dialog's words and word sequences are likely, but any word of the dictionary may be
+	// recognized
+	Biased,
+	// Only the dialog's words are recognized, with a language model of the dialog alone. The
+	// lexicon tree shrinks from the whole dictionary to those words, which makes decoding much
+	// faster, but words missing from the dialog are recognized as dialog words.
+	Strict,
+	// The dialog is read verbatim: its words are distributed over the utterances by their expected
+	// duration and aligned with the audio, without recognizing words. Utterances whose words can't
+	// be aligned are recognized like biased ones.
+	Verbatim
+};
 
 class PocketSphinxRecognizer : public Recognizer {
 public:
+	explicit PocketSphinxRecognizer(
+		DecoderProfile profile = DecoderProfile::Offline,
+		DialogMode dialogMode = DialogMode::Biased
+	);
+
 	BoundedTimeline<Phone> recognizePhones(
 		const AudioClip& inputAudioClip,
 		boost::optional<std::string> dialog,
+		SpeakerProfile* speakerProfile,
+		int maxThreadCount,
+		ProgressSink& progressSink,
+		const RecognizedPhonesSink& phonesSink
+	) const override;
+
+	std::vector<BoundedTimeline<Phone>> recognizePhonesBatch(
+		const std::vector<RecognitionInput>& inputs,
 		int maxThreadCount,
 		ProgressSink& progressSink
 	) const override;
+
+	// Must be destroyed before the recognizer's decoder cache is cleared.
+	std::unique_ptr<SteppedRecognition> beginRecognition(
+		const std::vector<RecognitionInput>& inputs,
+		ProgressSink& progressSink
+	) const override;
+
+	// Uses a decoder prepared for the dialog.
+	// Must be destroyed before the recognizer's decoder cache is cleared.
+	std::unique_ptr<UtteranceRecognizer> createUtteranceRecognizer(
+		const boost::optional<std::string>& dialog,
+		int sampleRate
+	) const override;
+
+	size_t estimateDecoderMemory(int maxThreadCount) const override;
+
+	std::chrono::milliseconds estimateDuration(centiseconds audioDuration, int maxThreadCount) const override;
+	void prewarm(int decoderCount) const override;
+
+	// Frees all cached decoders, dialog language models and utterance phones. They will be
+	// re-created as needed.
+	void clearDecoderCache();
+
+	// The number of dialog language models kept for reuse
+	static constexpr size_t dialogModelCacheCapacity = 16;
+
+	// The number of dialog searches each warm decoder keeps registered. A search over the biased
+	// language model holds a lexicon tree of the whole dictionary, some 40 MB.
+	static constexpr size_t dialogSearchCacheCapacity = 3;
+
+	// A language model for a specific dialog, along with the pronunciations guessed for words
+	// missing from the dictionary
+	struct DialogModel {
+		lambda_unique_ptr<ngram_model_t> languageModel;
+		// The dialog's words in order
+		std::vector<std::string> tokens;
+		std::set<std::string> words;
+		std::map<std::string, std::vector<Phone>> addedWords;
+	};
+
+	// The searches of recent dialogs registered on a warm decoder, most recently used first, with
+	// the normalized dialog text each was created for. Every search keeps its lexicon tree, so
+	// returning to one of these dialogs only switches searches.
+	struct DialogSearches {
+		std::vector<std::pair<std::string, std::string>> searchNames;
+		int nextSearchId = 0;
+	};
+
+private:
+	// Warm decoders and the dialog language models built with them, for one decoder configuration
+	struct DecoderCache {
+		DecoderCache(
+			DecoderProfile profile,
+			DialogMode dialogMode,
+			int sampleRate,
+			DecoderMemoryEstimate& decoderMemoryEstimate
+		);
+
+		DecoderPool decoderPool;
+		UtterancePhoneCache utterancePhones;
+		// Keyed by normalized dialog text
+		LruCache<std::string, std::shared_ptr<const DialogModel>> dialogModels;
+		// Only used by decoders with live CMN
+		LiveCmnPrior cmnPrior;
+		// The dialog searches registered on each decoder
+		std::map<const ps_decoder_t*, DialogSearches> dialogSearches;
+		std::mutex dialogSearchesMutex;
+	};
+
+	// Returns the decoder cache for the current decoder configuration, with the acoustic model of
+	// a rate of getSphinxSampleRate()
+	DecoderCache& getDecoderCache(int sampleRate) const;
+
+	// Returns the distributor of verbatim dialogs, or none for the other dialog modes
+	dialogDistributor getDialogDistributor(DecoderCache& decoderCache) const;
+
+	// Returns the preparer of the cache's decoders, which also applies its CMN prior
+	decoderPreparer getDecoderPreparer(DecoderCache& decoderCache) const;
+
+	// Returns the phone recognition of the cache's decoders, which also updates its CMN prior
+	static utteranceToPhonesFunction getUtteranceToPhones(DecoderCache& decoderCache);
+
+	DecoderProfile profile;
+	DialogMode dialogMode;
+	mutable DecoderMemoryEstimate decoderMemoryEstimate;
+	mutable RecognitionCostModel costModel;
+
+	// Decoders are expensive to create (acoustic model, dictionary, default language model), so
+	// they are kept across calls, one cache per decoder configuration
+	mutable std::map<std::string, std::unique_ptr<DecoderCache>> decoderCaches;
+	mutable std::mutex decoderCachesMutex;
 };
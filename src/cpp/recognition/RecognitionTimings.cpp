@@ -0,0 +1,32 @@
+#include "RecognitionTimings.h"
+
+namespace {
+	thread_local RecognitionTimings* currentTimings = nullptr;
+}
+
+void RecognitionTimings::add(size_t clipIndex, Clip clip) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (clips.size() <= clipIndex) {
+		clips.resize(clipIndex + 1);
+	}
+	clips[clipIndex] = std::move(clip);
+}
+
+RecognitionTimings::Clip RecognitionTimings::get(size_t clipIndex) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return clipIndex < clips.size() ? clips[clipIndex] : Clip();
+}
+
+RecognitionTimings* RecognitionTimings::getCurrent() {
+	return currentTimings;
+}
+
+RecognitionTimingsScope::RecognitionTimingsScope(RecognitionTimings* timings) :
+	previousTimings(currentTimings)
+{
+	currentTimings = timings;
+}
+
+RecognitionTimingsScope::~RecognitionTimingsScope() {
+	currentTimings = previousTimings;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "core/Phone.h"
+#include "time/BoundedTimeline.h"
+#include <string>
+#include <vector>
+#include <mutex>
+
+// The words and phones an analysis recognized in its clips, with their times in the clips, so that
+// callers can reuse them, e.g. for subtitles, instead of recognizing the audio a second time.
+// Phone recognitions started on a thread within a RecognitionTimingsScope add the timings of each
+// clip once it is recognized. Only recognizers that recognize words give words. Thread-safe.
+class RecognitionTimings {
+public:
+	struct Clip {
+		// Words without pronunciation indexes, e.g. "to" for "to(2)"
+		Timeline<std::string> words;
+		BoundedTimeline<Phone> phones;
+	};
+
+	RecognitionTimings() = default;
+	RecognitionTimings(const RecognitionTimings&) = delete;
+	RecognitionTimings& operator=(const RecognitionTimings&) = delete;
+
+	void add(size_t clipIndex, Clip clip);
+
+	// Returns the timings of a clip, which are empty until it has been recognized
+	Clip get(size_t clipIndex) const;
+
+	// Returns the timings collected by the current thread, or nullptr if it doesn't collect any
+	static RecognitionTimings* getCurrent();
+
+private:
+	mutable std::mutex mutex;
+	std::vector<Clip> clips;
+};
+
+// Makes the current thread collect the specified timings (or none, for nullptr) for its lifetime
+class RecognitionTimingsScope {
+public:
+	explicit RecognitionTimingsScope(RecognitionTimings* timings);
+	~RecognitionTimingsScope();
+	RecognitionTimingsScope(const RecognitionTimingsScope&) = delete;
+	RecognitionTimingsScope& operator=(const RecognitionTimingsScope&) = delete;
+
+private:
+	RecognitionTimings* previousTimings;
+};
@@ -4,15 +4,129 @@
 #include "core/Phone.h"
 #include "tools/progress.h"
 #include "time/BoundedTimeline.h"
+#include <vector>
+#include <memory>
+#include <functional>
+
+class SpeakerProfile;
+
+// One clip of a batch recognition
+struct RecognitionInput {
+	const AudioClip* audioClip;
+	boost::optional<std::string> dialog;
+	// If set, recognition starts from what the profile has learned about the clip's speaker, and
+	// updates it once the batch completes
+	SpeakerProfile* speakerProfile = nullptr;
+};
+
+// Receives the phones of a clip as soon as an utterance and all utterances before it are
+// recognized, in chronological order. No phones will follow before knownEnd. Calls come one at a
+// time, but from any of the threads recognizing the clip.
+using RecognizedPhonesSink = std::function<void(const Timeline<Phone>& phones, centiseconds knownEnd)>;
+
+// Recognizes the utterances of a single stream one at a time, e.g. while audio is still being recorded
+class UtteranceRecognizer {
+public:
+	virtual ~UtteranceRecognizer() = default;
+
+	virtual Timeline<Phone> recognizeUtterance(
+		const AudioClip& audioClip,
+		TimeRange utteranceTimeRange,
+		ProgressSink& progressSink
+	) = 0;
+
+	// Passes the audio of an utterance that is still being spoken, so that recognition can start
+	// before it ends. The clip starts where the clip of the recognizeUtterance() call for the
+	// utterance will start, and may end before the utterance does. Ignored by default.
+	virtual void continueUtterance(const AudioClip& audioClip, TimeRange utteranceTimeRange) {
+		UNUSED(audioClip);
+		UNUSED(utteranceTimeRange);
+	}
+
+	// Discards the work of continueUtterance() for an utterance that won't be recognized after all
+	virtual void discardUtterance() {}
+
+	// Returns phones guessed from the partial recognition of the utterance passed to
+	// continueUtterance(), relative to its clip, for animating it before it is recognized.
+	// Empty by default.
+	virtual Timeline<Phone> getTentativePhones() { return {}; }
+
+	// Returns what the recognizer carries from one utterance to the next, such as the mean of live
+	// cepstral mean normalization, e.g. to continue a stream in another process. Empty by default.
+	virtual std::vector<float> getCarriedState() const { return {}; }
+
+	// Continues from the getCarriedState() of a recognizer of the same kind. States that don't fit
+	// are ignored.
+	virtual void setCarriedState(const std::vector<float>& state) {
+		UNUSED(state);
+	}
+};
+
+// A recognition of many clips that its caller runs an utterance at a time on its own thread, e.g.
+// to spread it over the frames of a game loop (see Recognizer::beginRecognition())
+class SteppedRecognition {
+public:
+	virtual ~SteppedRecognition() = default;
+
+	// Recognizes the next utterance. Returns false, doing nothing, once all are recognized.
+	virtual bool step() = 0;
+
+	// The number of utterances left to recognize
+	virtual size_t getRemainingStepCount() const = 0;
+
+	// Recognizes the remaining utterances, if any, and returns one phone timeline per input.
+	// Called once.
+	virtual std::vector<BoundedTimeline<Phone>> finish() = 0;
+};
 
 class Recognizer {
 public:
 	virtual ~Recognizer() = default;
 
+	// If phonesSink is set, it receives the phones while the clip is being recognized.
+	// speakerProfile is optional; see RecognitionInput.
 	virtual BoundedTimeline<Phone> recognizePhones(
 		const AudioClip& audioClip,
 		boost::optional<std::string> dialog,
+		SpeakerProfile* speakerProfile,
 		int maxThreadCount,
+		ProgressSink& progressSink,
+		const RecognizedPhonesSink& phonesSink
+	) const = 0;
+
+	// Recognizes many clips at once, returning one phone timeline per input.
+	// The utterances of all clips share the threads, and clips with the same dialog share its
+	// language model.
+	virtual std::vector<BoundedTimeline<Phone>> recognizePhonesBatch(
+		const std::vector<RecognitionInput>& inputs,
+		int maxThreadCount,
+		ProgressSink& progressSink
+	) const = 0;
+
+	// Begins recognizing many clips on the calling thread, detecting their utterances before
+	// returning; see SteppedRecognition. The clips and the progress sink must outlive the result,
+	// and so must this recognizer and its decoder cache.
+	virtual std::unique_ptr<SteppedRecognition> beginRecognition(
+		const std::vector<RecognitionInput>& inputs,
 		ProgressSink& progressSink
 	) const = 0;
+
+	// Creates a recognizer prepared for a single dialog, for audio of the given sample rate.
+	// It may use resources of this recognizer, so it must be destroyed first.
+	virtual std::unique_ptr<UtteranceRecognizer> createUtteranceRecognizer(
+		const boost::optional<std::string>& dialog,
+		int sampleRate
+	) const = 0;
+
+	// Estimates the heap memory taken by the decoders that recognizing with up to maxThreadCount
+	// threads would create. 0 once enough decoders are cached.
+	virtual size_t estimateDecoderMemory(int maxThreadCount) const = 0;
+
+	// Estimates how long recognizing a clip of the given duration with up to maxThreadCount threads
+	// takes, from the speed of earlier calls
+	virtual std::chrono::milliseconds estimateDuration(centiseconds audioDuration, int maxThreadCount) const = 0;
+
+	// Creates decoders until decoderCount of them are cached, so that the next recognition doesn't
+	// wait for their creation
+	virtual void prewarm(int decoderCount) const = 0;
 };
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "SpeakerProfile.h"
+#include <format.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using std::vector;
+using std::runtime_error;
+
+namespace {
+
+	// "LSSP", then the format version
+	constexpr uint32_t magic = 0x5053534C;
+	constexpr uint32_t version = 1;
+
+	// Writes values little-endian
+	class ProfileWriter {
+	public:
+		explicit ProfileWriter(vector<uint8_t>& bytes) : bytes(bytes) {}
+
+		void writeUInt(uint32_t value, int byteCount = 4) {
+			for (int i = 0; i < byteCount; ++i) {
+				bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+			}
+		}
+
+		void writeFloat(float value) {
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof bits);
+			writeUInt(bits);
+		}
+
+	private:
+		vector<uint8_t>& bytes;
+	};
+
+	class ProfileReader {
+	public:
+		explicit ProfileReader(gsl::span<const uint8_t> bytes) : bytes(bytes) {}
+
+		uint32_t readUInt(int byteCount = 4) {
+			if (offset + byteCount > bytes.size()) {
+				throw runtime_error("Speaker profile is truncated.");
+			}
+			uint32_t value = 0;
+			for (int i = 0; i < byteCount; ++i) {
+				value |= static_cast<uint32_t>(bytes[offset++]) << (8 * i);
+			}
+			return value;
+		}
+
+		float readFloat() {
+			const uint32_t bits = readUInt();
+			float value;
+			std::memcpy(&value, &bits, sizeof value);
+			return value;
+		}
+
+		// Reads a count of values that take at least valueSize bytes each
+		size_t readCount(int valueSize) {
+			const size_t count = readUInt();
+			if (count > static_cast<size_t>(bytes.size() - offset) / valueSize) {
+				throw runtime_error("Speaker profile is truncated.");
+			}
+			return count;
+		}
+
+	private:
+		gsl::span<const uint8_t> bytes;
+		std::ptrdiff_t offset = 0;
+	};
+
+}
+
+SpeakerProfile::SpeakerProfile(gsl::span<const uint8_t> bytes) {
+	ProfileReader reader(bytes);
+	if (reader.readUInt() != magic) {
+		throw runtime_error("Not a speaker profile.");
+	}
+	const uint32_t profileVersion = reader.readUInt();
+	if (profileVersion != version) {
+		throw runtime_error(fmt::format("Unsupported speaker profile version {}.", profileVersion));
+	}
+
+	state.cepstralMean.resize(reader.readCount(4));
+	for (float& value : state.cepstralMean) {
+		value = reader.readFloat();
+	}
+	const float cepstralFrameCount = reader.readFloat();
+	state.cepstralFrameCount = cepstralFrameCount > 0
+		? std::min<double>(cepstralFrameCount, maxCepstralFrameCount)
+		: 0;
+
+	state.noiseModel.values.resize(reader.readCount(2));
+	for (int16_t& value : state.noiseModel.values) {
+		value = static_cast<int16_t>(reader.readUInt(2));
+	}
+	state.noiseModel.frameCount = static_cast<int32_t>(reader.readUInt());
+}
+
+vector<uint8_t> SpeakerProfile::serialize() const {
+	const State state = getState();
+	vector<uint8_t> bytes;
+	ProfileWriter writer(bytes);
+	writer.writeUInt(magic);
+	writer.writeUInt(version);
+
+	writer.writeUInt(static_cast<uint32_t>(state.cepstralMean.size()));
+	for (float value : state.cepstralMean) {
+		writer.writeFloat(value);
+	}
+	writer.writeFloat(static_cast<float>(state.cepstralFrameCount));
+
+	writer.writeUInt(static_cast<uint32_t>(state.noiseModel.values.size()));
+	for (int16_t value : state.noiseModel.values) {
+		writer.writeUInt(static_cast<uint16_t>(value), 2);
+	}
+	writer.writeUInt(static_cast<uint32_t>(state.noiseModel.frameCount));
+	return bytes;
+}
+
+SpeakerProfile::State SpeakerProfile::getState() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return state;
+}
+
+void SpeakerProfile::learn(const VadNoiseModel& noiseModel, const vector<CepstralStatistics>& utterances) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!noiseModel.empty()) {
+		state.noiseModel = noiseModel;
+	}
+
+	for (const CepstralStatistics& utterance : utterances) {
+		if (utterance.frameCount <= 0) continue;
+
+		// A mean of another length comes from another front end; start over
+		if (state.cepstralMean.size() != utterance.sum.size()) {
+			state.cepstralMean.assign(utterance.sum.size(), 0.0f);
+			state.cepstralFrameCount = 0;
+		}
+		const double frameCount = state.cepstralFrameCount + utterance.frameCount;
+		for (size_t i = 0; i < state.cepstralMean.size(); ++i) {
+			state.cepstralMean[i] = static_cast<float>(
+				(state.cepstralMean[i] * state.cepstralFrameCount + utterance.sum[i]) / frameCount);
+		}
+		state.cepstralFrameCount = std::min(frameCount, maxCepstralFrameCount);
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "audio/voiceActivityDetection.h"
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <span.h>
+
+// The sum of an utterance's cepstra, skipping silent frames, and their number
+struct CepstralStatistics {
+	std::vector<float> sum;
+	int32_t frameCount = 0;
+};
+
+// What analyses have learned about a speaker's voice and recording conditions, so that later
+// analyses of the same speaker don't start cold: the mean of their cepstra, which short utterances
+// are normalized with, and the background noise voice activity detection has adapted to.
+// Analyses given a profile start from its state and update it once they complete. Thread-safe.
+class SpeakerProfile {
+public:
+	struct State {
+		// Empty until an utterance has been recognized
+		std::vector<float> cepstralMean;
+		// The number of frames the mean is estimated from, up to maxCepstralFrameCount
+		double cepstralFrameCount = 0;
+		VadNoiseModel noiseModel;
+	};
+
+	// Older speech is forgotten beyond this many frames, so that the mean follows the speaker
+	static constexpr double maxCepstralFrameCount = 500;
+
+	SpeakerProfile() = default;
+	// Reads a profile written by serialize(). Throws if the bytes aren't one.
+	explicit SpeakerProfile(gsl::span<const uint8_t> bytes);
+
+	std::vector<uint8_t> serialize() const;
+
+	State getState() const;
+
+	// Continues from the noise model of an analysis and the statistics of its utterances, in
+	// chronological order. An empty noise model leaves the current one.
+	void learn(const VadNoiseModel& noiseModel, const std::vector<CepstralStatistics>& utterances);
+
+private:
+	mutable std::mutex mutex;
+	State state;
+};
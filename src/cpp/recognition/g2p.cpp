@@ -2,16 +2,66 @@
 #include <regex>
 #include "tools/stringTools.h"
 #include "logging/logging.h"
+#include "tools/LruCache.h"
+#include <algorithm>
 
 using std::vector;
 using std::wstring;
-using std::regex;
 using std::wregex;
 using std::invalid_argument;
 using std::pair;
 
-const vector<pair<wregex, wstring>>& getReplacementRules() {
-	static vector<pair<wregex, wstring>> rules {
+struct ReplacementRule {
+	ReplacementRule(const wstring& pattern, wstring replacement);
+
+	wregex regex;
+	wstring replacement;
+	// Characters that every match contains, so the rule can be skipped for words lacking any of them
+	wstring requiredChars;
+};
+
+// Collects the literal characters outside groups and brackets that aren't optional,
+// e.g. "a" for "([bcd])a(gh)". Gives up on alternations.
+static wstring getRequiredChars(const wstring& pattern) {
+	if (pattern.find(L'|') != wstring::npos) return wstring();
+
+	const wstring special = L"^$.*+?{}()[]|\\";
+	wstring result;
+	int groupDepth = 0;
+	bool inBrackets = false;
+	for (size_t i = 0; i < pattern.size(); ++i) {
+		const wchar_t c = pattern[i];
+		if (c == L'\\') {
+			++i;
+		} else if (inBrackets) {
+			if (c == L']') inBrackets = false;
+		} else if (c == L'{') {
+			i = pattern.find(L'}', i);
+		} else if (c == L'[') {
+			inBrackets = true;
+		} else if (c == L'(') {
+			++groupDepth;
+		} else if (c == L')') {
+			--groupDepth;
+		} else if (groupDepth == 0 && special.find(c) == wstring::npos) {
+			const bool optional = i + 1 < pattern.size()
+				&& (pattern[i + 1] == L'?' || pattern[i + 1] == L'*' || pattern[i + 1] == L'{');
+			if (!optional) result += c;
+		}
+	}
+	return result;
+}
+
+ReplacementRule::ReplacementRule(const wstring& pattern, wstring replacement) :
+	regex(pattern),
+	replacement(std::move(replacement)),
+	requiredChars(getRequiredChars(pattern))
+{}
+
+const vector<ReplacementRule>& getReplacementRules() {
+	// The rules need their patterns as strings, not just as compiled regexes
+	#define wregex(pattern) wstring(pattern)
+	static const vector<ReplacementRule> rules {
 		#include "g2pRules.cpp"
 
 		// Turn bigrams into unigrams for easier conversion
@@ -19,6 +69,7 @@ const vector<pair<wregex, wstring>>& getReplacementRules() {
 		{ wregex(L"öy"), L"ω" },
 		{ wregex(L"@r"), L"ɝ" }
 	};
+	#undef wregex
 	return rules;
 }
 
@@ -70,23 +121,32 @@ Phone charToPhone(wchar_t c) {
 }
 
 vector<Phone> wordToPhones(const std::string& word) {
-	static regex validWord("^[a-z']*$");
-	if (!regex_match(word, validWord)) {
+	const bool isValidWord = std::all_of(word.begin(), word.end(),
+		[](char c) { return (c >= 'a' && c <= 'z') || c == '\''; });
+	if (!isValidWord) {
 		throw invalid_argument(fmt::format("Word '{}' contains illegal characters.", word));
 	}
 
+	// Scripts tend to repeat the same names and made-up words
+	static LruCache<std::string, vector<Phone>> cache(4096);
+	if (const boost::optional<vector<Phone>> cached = cache.get(word)) {
+		return *cached;
+	}
+
 	wstring wideWord = latin1ToWide(word);
 	for (const auto& rule : getReplacementRules()) {
-		const wregex& regex = rule.first;
-		const wstring& replacement = rule.second;
+		const bool canMatch = std::all_of(
+			rule.requiredChars.begin(), rule.requiredChars.end(),
+			[&](wchar_t c) { return wideWord.find(c) != wstring::npos; }
+		);
+		if (!canMatch) continue;
 
 		// Repeatedly apply rule until there is no more change
-		bool changed;
-		do {
-			wstring tmp = regex_replace(wideWord, regex, replacement);
-			changed = tmp != wideWord;
-			wideWord = tmp;
-		} while (changed);
+		while (regex_search(wideWord, rule.regex)) {
+			wstring tmp = regex_replace(wideWord, rule.regex, rule.replacement);
+			if (tmp == wideWord) break;
+			wideWord = std::move(tmp);
+		}
 	}
 
 	// Remove duplicate phones
@@ -107,5 +167,7 @@ vector<Phone> wordToPhones(const std::string& word) {
 		}
 		lastPhone = phone;
 	}
+
+	cache.set(word, result);
 	return result;
 }
@@ -0,0 +1,129 @@
+#include "gpuScoring.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "tools/cancellation.h"
+#if defined(__EMSCRIPTEN__) && defined(LIPSYNCENGINE_COOPERATIVE_YIELD)
+#include <emscripten.h>
+#endif
+
+extern "C" {
+#include <pocketsphinx_internal.h>
+#include <ptm_mgau.h>
+}
+
+namespace {
+	std::atomic<bool> gpuScoringEnabled(false);
+}
+
+#if defined(__EMSCRIPTEN__) && defined(LIPSYNCENGINE_COOPERATIVE_YIELD)
+
+static_assert(std::is_same<mfcc_t, float>::value, "The GPU scorer reads features as 32-bit floats.");
+static_assert(sizeof(ptm_topn_t) == 8, "The GPU scorer writes top-N entries as pairs of int32.");
+
+namespace {
+	// A block of frames to score, as the host's scorer reads it from WebAssembly memory: 32-bit
+	// counts and pointers, see GpuBlockRequest in src/ts/utils/gpuScoring.ts
+	struct GpuBlockRequest {
+		int32_t codebookCount;
+		int32_t featureCount;
+		int32_t densityCount;
+		int32_t topnCount;
+		int32_t frameCount;
+		// int32 by feature
+		const int32_t* featureLengths;
+		// The packed means and variances (see ptm_mgau_pack_densities()), which identify the model
+		const mfcc_t* densities;
+		// size_t by codebook and feature: where its densities start in densities
+		const size_t* densityOffsets;
+		// int32 by feature: the padded length of its means and variances
+		const int32_t* densityStrides;
+		// float by codebook, feature and density
+		const mfcc_t* determinants;
+		// float by frame and feature, without padding
+		const mfcc_t* features;
+		// Receives the top-N, see ptm_mgau_block_eval_t
+		ptm_topn_t* topn;
+	};
+}
+
+// Awaits the host's scorer. Returns 0 on success, -1 if there is no scorer or it failed.
+EM_ASYNC_JS(int32_t, lipsyncengine_gpu_evaluate_block, (const GpuBlockRequest* request), {
+	const scorer = Module['lipsyncengineGpuScorer'];
+	if (!scorer) return -1;
+	try {
+		return await scorer.evaluateBlock(Module, request);
+	} catch (error) {
+		return -1;
+	}
+});
+
+static int evaluateBlockOnGpu(void*, ptm_mgau_t* s, mfcc_t*** feat, int frameCount, ptm_topn_t* topn) {
+	if (!gpuScoringEnabled) return -1;
+	const CancellationToken* token = CancellationToken::getCurrent();
+	if (!token || !token->canSuspend()) return -1;
+
+	// The acoustic model's frames may wrap around its buffer, so they are copied
+	const int featureCount = s->g->n_feat;
+	int frameLength = 0;
+	for (int i = 0; i < featureCount; ++i) {
+		frameLength += s->g->featlen[i];
+	}
+	thread_local std::vector<mfcc_t> features;
+	features.resize(static_cast<size_t>(frameCount) * frameLength);
+	mfcc_t* frameFeatures = features.data();
+	for (int frame = 0; frame < frameCount; ++frame) {
+		for (int i = 0; i < featureCount; ++i) {
+			std::memcpy(frameFeatures, feat[frame][i], s->g->featlen[i] * sizeof(mfcc_t));
+			frameFeatures += s->g->featlen[i];
+		}
+	}
+
+	const GpuBlockRequest request {
+		s->g->n_mgau,
+		featureCount,
+		s->g->n_density,
+		s->max_topn,
+		frameCount,
+		s->g->featlen,
+		s->dens,
+		s->dens_offset,
+		s->dens_stride,
+		s->g->det[0][0],
+		features.data(),
+		topn
+	};
+	return lipsyncengine_gpu_evaluate_block(&request) == 0 ? 0 : -1;
+}
+
+bool canScoreOnGpu() {
+	return true;
+}
+
+void useGpuScoring(ps_decoder_t& decoder) {
+	ps_mgau_t* mgau = decoder.acmod->mgau;
+	if (std::strcmp(mgau->vt->name, "ptm") != 0) return;
+	if (reinterpret_cast<ptm_mgau_t*>(mgau)->n_block_alloc == 0) return;
+
+	ptm_mgau_set_block_eval(mgau, evaluateBlockOnGpu, nullptr);
+}
+
+#else
+
+bool canScoreOnGpu() {
+	return false;
+}
+
+void useGpuScoring(ps_decoder_t&) {}
+
+#endif
+
+bool isGpuScoringEnabled() {
+	return gpuScoringEnabled;
+}
+
+void setGpuScoringEnabled(bool enabled) {
+	gpuScoringEnabled = enabled && canScoreOnGpu();
+}
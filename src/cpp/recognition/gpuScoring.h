@@ -0,0 +1,29 @@
+#pragma once
+
+extern "C" {
+#include <pocketsphinx.h>
+}
+
+// Scoring of tied-mixture Gaussians on the host's GPU, for the JSPI WebAssembly build in browsers
+// with WebGPU. The host installs a scorer as the module's lipsyncengineGpuScorer (see
+// src/ts/utils/gpuScoring.ts), which uploads a model's codebooks once and computes the top
+// Gaussians of each codebook for a block of frames in a compute shader. Decoders evaluating blocks
+// of frames (-topn_block) hand each block to it, suspending until its result is read back, and
+// score the senones from it as usual.
+// Blocks are scored on the CPU where the current thread can't suspend (see
+// CancellationToken::canSuspend()), e.g. in analyses run in steps, and whenever the scorer fails.
+
+// Whether this build can score on the GPU: WebAssembly builds with JSPI
+bool canScoreOnGpu();
+
+// Whether blocks of frames are handed to the host's scorer (default: false)
+bool isGpuScoringEnabled();
+void setGpuScoringEnabled(bool enabled);
+
+// The number of frames per block of decoders created while GPU scoring is enabled. Each block is a
+// round trip to the GPU, so blocks are longer than those of the CPU.
+constexpr int gpuGaussianBlockFrameCount = 256;
+
+// Has the decoder's blocks of frames scored on the GPU while GPU scoring is enabled, if its
+// acoustic model is tied-mixture and it evaluates blocks of frames
+void useGpuScoring(ps_decoder_t& decoder);
@@ -0,0 +1,38 @@
+#include "languageModelPages.h"
+#include <map>
+#include <mutex>
+
+using std::string;
+
+namespace {
+	std::mutex mutex;
+	std::map<string, lambda_unique_ptr<lm_trie_pages_t>> pagesByFileName;
+}
+
+boost::optional<LanguageModelLayout> pageLanguageModel(
+	const string& fileName,
+	const uint8_t* head,
+	size_t headSize
+) {
+	size_t ngramOffset, ngramSize;
+	if (ngram_model_trie_bin_layout(head, headSize, &ngramOffset, &ngramSize) != 0) {
+		return boost::none;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto& pages = pagesByFileName[fileName];
+	if (!pages || pages->size != ngramSize) {
+		// Models reading replaced pages outlive them, so those are leaked
+		if (pages) pages.release();
+		pages = lambda_unique_ptr<lm_trie_pages_t>(
+			lm_trie_pages_create(ngramSize, languageModelPageBits),
+			[](lm_trie_pages_t* pages) { lm_trie_pages_free(pages); });
+	}
+	return LanguageModelLayout { ngramOffset, ngramSize, static_cast<int>(pages->n_pages) };
+}
+
+lm_trie_pages_t* getLanguageModelPages(const string& fileName) {
+	std::lock_guard<std::mutex> lock(mutex);
+	const auto it = pagesByFileName.find(fileName);
+	return it != pagesByFileName.end() ? it->second.get() : nullptr;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <compat/boost_compat.h>
+#include "tools/tools.h"
+
+extern "C" {
+#include <lm/ngram_model_trie.h>
+}
+
+// Paged loading of a language model, for WASM builds that fetch the models over the network. The
+// n-gram arrays make up most of a binary trie model. The host writes the file without them, so
+// that analyses can start early, and fills them in page by page afterwards. Until a page arrives,
+// lookups back off past the n-grams it holds and flag it as wanted, so that it is fetched next.
+// Recognition reaches full quality once every page has arrived.
+
+// Log2 of the page size: 256 KB, a hundred range requests for the full model
+constexpr int languageModelPageBits = 18;
+
+struct LanguageModelLayout {
+	// Where the n-gram arrays lie in the file
+	size_t ngramOffset;
+	size_t ngramSize;
+	int pageCount;
+};
+
+// Prepares paged loading of the language model file of that name in the model directory from the
+// first bytes of the file, which must include its n-gram counts (64 bytes do). Call before the
+// file is written without its n-gram arrays. Keeps the pages that arrived if the file was paged
+// before.
+// Returns the layout, or none if the head isn't that of a binary trie model.
+boost::optional<LanguageModelLayout> pageLanguageModel(
+	const std::string& fileName,
+	const uint8_t* head,
+	size_t headSize
+);
+
+// The pages of the language model file of that name, or nullptr if it isn't paged. They live as
+// long as the process, like the models reading them.
+lm_trie_pages_t* getLanguageModelPages(const std::string& fileName);
@@ -1,201 +1,217 @@
 #include "languageModels.h"
-#include <compat/boost_compat.h>
 #include <vector>
-#include <regex>
-#include <map>
-#include <tuple>
-#include "tools/platformTools.h"
-#include <fstream>
-#include "core/appInfo.h"
+#include <unordered_map>
+#include <array>
+#include <algorithm>
 #include <cmath>
-#include <gsl_util.h>
+
+extern "C" {
+#include <lm/ngram_model_trie.h>
+}
 
 using std::string;
 using std::vector;
-using std::regex;
-using std::map;
-using std::tuple;
-using std::get;
-using std::endl;
-using std::filesystem::path;
-
-using Unigram = string;
-using Bigram = tuple<string, string>;
-using Trigram = tuple<string, string, string>;
-
-map<Unigram, int> getUnigramCounts(const vector<string>& words) {
-	map<Unigram, int> unigramCounts;
-	for (const Unigram& unigram : words) {
-		++unigramCounts[unigram];
+using std::unordered_map;
+using std::array;
+
+// Words are identified by their indexes in alphabetical order, which the trie expects
+using WordId = uint32;
+
+template<size_t order>
+using Ngram = array<WordId, order>;
+
+// The distinct n-grams of a word sequence in lexicographic order, with their counts
+template<size_t order>
+struct NgramCounts {
+	vector<Ngram<order>> ngrams;
+	vector<int> counts;
+};
+
+// N-grams continuing past a sentence end are skipped, so that the sequence may hold several sentences.
+template<size_t order>
+NgramCounts<order> getNgramCounts(const vector<WordId>& wordIds, WordId sentenceEndId) {
+	vector<Ngram<order>> occurrences;
+	for (size_t i = 0; i + order <= wordIds.size(); ++i) {
+		Ngram<order> ngram;
+		std::copy_n(wordIds.begin() + i, order, ngram.begin());
+		if (std::find(ngram.begin(), ngram.end() - 1, sentenceEndId) != ngram.end() - 1) continue;
+
+		occurrences.push_back(ngram);
 	}
-	return unigramCounts;
-}
-
-map<Bigram, int> getBigramCounts(const vector<string>& words) {
-	map<Bigram, int> bigramCounts;
-	for (auto it = words.begin(); it < words.end() - 1; ++it) {
-		++bigramCounts[Bigram(*it, *(it + 1))];
+	std::sort(occurrences.begin(), occurrences.end());
+
+	NgramCounts<order> result;
+	for (const Ngram<order>& ngram : occurrences) {
+		if (!result.ngrams.empty() && result.ngrams.back() == ngram) {
+			++result.counts.back();
+		} else {
+			result.ngrams.push_back(ngram);
+			result.counts.push_back(1);
+		}
 	}
-	return bigramCounts;
+	return result;
 }
 
-map<Trigram, int> getTrigramCounts(const vector<string>& words) {
-	map<Trigram, int> trigramCounts;
-	if (words.size() >= 3) {
-		for (auto it = words.begin(); it < words.end() - 2; ++it) {
-			++trigramCounts[Trigram(*it, *(it + 1), *(it + 2))];
-		}
-	}
-	return trigramCounts;
+// Packs a bigram into a hash key
+static uint64_t getBigramKey(WordId first, WordId second) {
+	return (static_cast<uint64_t>(first) << 32) | second;
 }
 
-map<Unigram, double> getUnigramProbabilities(
+static lambda_unique_ptr<ngram_model_t> createLanguageModel(
 	const vector<string>& words,
-	const map<Unigram, int>& unigramCounts,
-	const double deflator
+	const UnigramProbabilities* backgroundProbabilities,
+	double backgroundWeight,
+	cmd_ln_t* config,
+	logmath_t& lmath
 ) {
-	map<Unigram, double> unigramProbabilities;
-	for (const auto& pair : unigramCounts) {
-		const Unigram& unigram = get<0>(pair);
-		const int unigramCount = get<1>(pair);
-		unigramProbabilities[unigram] = double(unigramCount) / words.size() * deflator;
+	const double discountMass = 0.5;
+	const double deflator = 1.0 - discountMass;
+
+	// Intern the words
+	vector<string> vocabulary(words);
+	std::sort(vocabulary.begin(), vocabulary.end());
+	vocabulary.erase(std::unique(vocabulary.begin(), vocabulary.end()), vocabulary.end());
+	unordered_map<string, WordId> wordIdsByWord;
+	wordIdsByWord.reserve(vocabulary.size());
+	for (size_t i = 0; i < vocabulary.size(); ++i) {
+		wordIdsByWord.emplace(vocabulary[i], static_cast<WordId>(i));
+	}
+	vector<WordId> wordIds;
+	wordIds.reserve(words.size());
+	for (const string& word : words) {
+		wordIds.push_back(wordIdsByWord.at(word));
 	}
-	return unigramProbabilities;
-}
 
-map<Bigram, double> getBigramProbabilities(
-	const map<Unigram, int>& unigramCounts,
-	const map<Bigram, int>& bigramCounts,
-	const double deflator
-) {
-	map<Bigram, double> bigramProbabilities;
-	for (const auto& pair : bigramCounts) {
-		Bigram bigram = get<0>(pair);
-		const int bigramCount = get<1>(pair);
-		const int unigramPrefixCount = unigramCounts.at(get<0>(bigram));
-		bigramProbabilities[bigram] = double(bigramCount) / unigramPrefixCount * deflator;
+	vector<int> unigramCounts(vocabulary.size(), 0);
+	for (const WordId wordId : wordIds) {
+		++unigramCounts[wordId];
+	}
+	const auto sentenceEnd = wordIdsByWord.find("</s>");
+	const WordId sentenceEndId = sentenceEnd != wordIdsByWord.end()
+		? sentenceEnd->second
+		: static_cast<WordId>(vocabulary.size());
+	const NgramCounts<2> bigrams = getNgramCounts<2>(wordIds, sentenceEndId);
+	const NgramCounts<3> trigrams = getNgramCounts<3>(wordIds, sentenceEndId);
+
+	// The background probabilities are renormalized over the vocabulary
+	vector<double> backgroundUnigramProbabilities(vocabulary.size(), 0.0);
+	double backgroundMass = 0.0;
+	if (backgroundProbabilities) {
+		for (size_t i = 0; i < vocabulary.size(); ++i) {
+			const auto it = backgroundProbabilities->find(vocabulary[i]);
+			if (it == backgroundProbabilities->end()) continue;
+
+			backgroundUnigramProbabilities[i] = it->second;
+			backgroundMass += it->second;
+		}
+	}
+	if (backgroundMass <= 0) {
+		backgroundWeight = 0.0;
+		backgroundMass = 1.0;
 	}
-	return bigramProbabilities;
-}
 
-map<Trigram, double> getTrigramProbabilities(
-	const map<Bigram, int>& bigramCounts,
-	const map<Trigram, int>& trigramCounts,
-	const double deflator
-) {
-	map<Trigram, double> trigramProbabilities;
-	for (const auto& pair : trigramCounts) {
-		Trigram trigram = get<0>(pair);
-		const int trigramCount = get<1>(pair);
-		const int bigramPrefixCount = bigramCounts.at(Bigram(get<0>(trigram), get<1>(trigram)));
-		trigramProbabilities[trigram] = double(trigramCount) / bigramPrefixCount * deflator;
+	vector<double> unigramProbabilities(vocabulary.size());
+	for (size_t i = 0; i < vocabulary.size(); ++i) {
+		const double countProbability = double(unigramCounts[i]) / words.size();
+		const double backgroundProbability = backgroundUnigramProbabilities[i] / backgroundMass;
+		unigramProbabilities[i] =
+			((1.0 - backgroundWeight) * countProbability + backgroundWeight * backgroundProbability) * deflator;
 	}
-	return trigramProbabilities;
-}
 
-map<Unigram, double> getUnigramBackoffWeights(
-	const map<Unigram, int>& unigramCounts,
-	const map<Unigram, double>& unigramProbabilities,
-	const map<Bigram, int>& bigramCounts,
-	const double discountMass)
-{
-	map<Unigram, double> unigramBackoffWeights;
-	for (const Unigram& unigram : unigramCounts | boost::adaptors::map_keys) {
-		double denominator = 1;
-		for (const Bigram& bigram : bigramCounts | boost::adaptors::map_keys) {
-			if (get<0>(bigram) == unigram) {
-				denominator -= unigramProbabilities.at(get<1>(bigram));
-			}
-		}
-		unigramBackoffWeights[unigram] = discountMass / denominator;
+	vector<double> bigramProbabilities(bigrams.ngrams.size());
+	unordered_map<uint64_t, size_t> bigramIndexes;
+	bigramIndexes.reserve(bigrams.ngrams.size());
+	for (size_t i = 0; i < bigrams.ngrams.size(); ++i) {
+		const Ngram<2>& bigram = bigrams.ngrams[i];
+		bigramProbabilities[i] = double(bigrams.counts[i]) / unigramCounts[bigram[0]] * deflator;
+		bigramIndexes.emplace(getBigramKey(bigram[0], bigram[1]), i);
 	}
-	return unigramBackoffWeights;
-}
 
-map<Bigram, double> getBigramBackoffWeights(
-	const map<Bigram, int>& bigramCounts,
-	const map<Bigram, double>& bigramProbabilities,
-	const map<Trigram, int>& trigramCounts,
-	const double discountMass)
-{
-	map<Bigram, double> bigramBackoffWeights;
-	for (const Bigram& bigram : bigramCounts | boost::adaptors::map_keys) {
-		double denominator = 1;
-		for (const Trigram& trigram : trigramCounts | boost::adaptors::map_keys) {
-			if (Bigram(get<0>(trigram), get<1>(trigram)) == bigram) {
-				denominator -= bigramProbabilities.at(Bigram(get<1>(trigram), get<2>(trigram)));
-			}
-		}
-		bigramBackoffWeights[bigram] = discountMass / denominator;
+	vector<double> trigramProbabilities(trigrams.ngrams.size());
+	for (size_t i = 0; i < trigrams.ngrams.size(); ++i) {
+		const Ngram<3>& trigram = trigrams.ngrams[i];
+		const int bigramPrefixCount = bigrams.counts[bigramIndexes.at(getBigramKey(trigram[0], trigram[1]))];
+		trigramProbabilities[i] = double(trigrams.counts[i]) / bigramPrefixCount * deflator;
 	}
-	return bigramBackoffWeights;
-}
 
-void createLanguageModelFile(const vector<string>& words, const path& filePath) {
-	const double discountMass = 0.5;
-	const double deflator = 1.0 - discountMass;
+	// Each backoff weight spreads the discounted mass over the words not seen after its history.
+	// The n-grams are grouped by history, so one pass subtracts their probabilities in order.
+	vector<double> unigramBackoffDenominators(vocabulary.size(), 1.0);
+	for (const Ngram<2>& bigram : bigrams.ngrams) {
+		unigramBackoffDenominators[bigram[0]] -= unigramProbabilities[bigram[1]];
+	}
+	vector<double> bigramBackoffDenominators(bigrams.ngrams.size(), 1.0);
+	for (const Ngram<3>& trigram : trigrams.ngrams) {
+		bigramBackoffDenominators[bigramIndexes.at(getBigramKey(trigram[0], trigram[1]))] -=
+			bigramProbabilities[bigramIndexes.at(getBigramKey(trigram[1], trigram[2]))];
+	}
 
-	map<Unigram, int> unigramCounts = getUnigramCounts(words);
-	map<Bigram, int> bigramCounts = getBigramCounts(words);
-	map<Trigram, int> trigramCounts = getTrigramCounts(words);
-
-	map<Unigram, double> unigramProbabilities =
-		getUnigramProbabilities(words, unigramCounts, deflator);
-	map<Bigram, double> bigramProbabilities =
-		getBigramProbabilities(unigramCounts, bigramCounts, deflator);
-	map<Trigram, double> trigramProbabilities =
-		getTrigramProbabilities(bigramCounts, trigramCounts, deflator);
-
-	map<Unigram, double> unigramBackoffWeights =
-		getUnigramBackoffWeights(unigramCounts, unigramProbabilities, bigramCounts, discountMass);
-	map<Bigram, double> bigramBackoffWeights =
-		getBigramBackoffWeights(bigramCounts, bigramProbabilities, trigramCounts, discountMass);
-
-	std::ofstream file(filePath);
-	file << "Generated by " << appName << " " << appVersion << endl << endl;
-
-	file << "\\data\\" << endl;
-	file << "ngram 1=" << unigramCounts.size() << endl;
-	file << "ngram 2=" << bigramCounts.size() << endl;
-	file << "ngram 3=" << trigramCounts.size() << endl << endl;
-
-	file.setf(std::ios::fixed, std::ios::floatfield);
-	file.precision(4);
-	file << "\\1-grams:" << endl;
-	for (const Unigram& unigram : unigramCounts | boost::adaptors::map_keys) {
-		file << log10(unigramProbabilities.at(unigram))
-			<< " " << unigram
-			<< " " << log10(unigramBackoffWeights.at(unigram)) << endl;
+	// Fill the arrays the trie is built from, with the same log10 values an ARPA file would contain
+	constexpr int order = 3;
+	vector<const char*> unigramStrings;
+	vector<float32> unigramLogProbabilities, unigramLogBackoffWeights;
+	for (size_t i = 0; i < vocabulary.size(); ++i) {
+		unigramStrings.push_back(vocabulary[i].c_str());
+		unigramLogProbabilities.push_back(static_cast<float32>(log10(unigramProbabilities[i])));
+		unigramLogBackoffWeights.push_back(static_cast<float32>(log10(discountMass / unigramBackoffDenominators[i])));
 	}
-	file << endl;
 
-	file << "\\2-grams:" << endl;
-	for (const Bigram& bigram : bigramCounts | boost::adaptors::map_keys) {
-		file << log10(bigramProbabilities.at(bigram))
-			<< " " << get<0>(bigram) << " " << get<1>(bigram)
-			<< " " << log10(bigramBackoffWeights.at(bigram)) << endl;
+	vector<uint32> bigramWordIds;
+	vector<float32> bigramLogProbabilities, bigramLogBackoffWeights;
+	for (size_t i = 0; i < bigrams.ngrams.size(); ++i) {
+		bigramWordIds.insert(bigramWordIds.end(), bigrams.ngrams[i].begin(), bigrams.ngrams[i].end());
+		bigramLogProbabilities.push_back(static_cast<float32>(log10(bigramProbabilities[i])));
+		bigramLogBackoffWeights.push_back(static_cast<float32>(log10(discountMass / bigramBackoffDenominators[i])));
 	}
-	file << endl;
 
-	file << "\\3-grams:" << endl;
-	for (const Trigram& trigram : trigramCounts | boost::adaptors::map_keys) {
-		file << log10(trigramProbabilities.at(trigram))
-			<< " " << get<0>(trigram) << " " << get<1>(trigram) << " " << get<2>(trigram) << endl;
+	vector<uint32> trigramWordIds;
+	vector<float32> trigramLogProbabilities;
+	for (size_t i = 0; i < trigrams.ngrams.size(); ++i) {
+		trigramWordIds.insert(trigramWordIds.end(), trigrams.ngrams[i].begin(), trigrams.ngrams[i].end());
+		trigramLogProbabilities.push_back(static_cast<float32>(log10(trigramProbabilities[i])));
 	}
-	file << endl;
 
-	file << "\\end\\" << endl;
+	const array<uint32, order> counts {
+		static_cast<uint32>(vocabulary.size()),
+		static_cast<uint32>(bigrams.ngrams.size()),
+		static_cast<uint32>(trigrams.ngrams.size())
+	};
+	const array<const float32*, order> logProbabilities {
+		unigramLogProbabilities.data(), bigramLogProbabilities.data(), trigramLogProbabilities.data()
+	};
+	const array<const float32*, order> logBackoffWeights {
+		unigramLogBackoffWeights.data(), bigramLogBackoffWeights.data(), nullptr
+	};
+	const array<const uint32*, order> ngramWordIds {
+		nullptr, bigramWordIds.data(), trigramWordIds.data()
+	};
+
+	return lambda_unique_ptr<ngram_model_t>(
+		ngram_model_trie_build(
+			config,
+			&lmath,
+			order,
+			counts.data(),
+			unigramStrings.data(),
+			logProbabilities.data(),
+			logBackoffWeights.data(),
+			ngramWordIds.data()
+		),
+		[](ngram_model_t* lm) { ngram_model_free(lm); });
 }
 
 lambda_unique_ptr<ngram_model_t> createLanguageModel(
 	const vector<string>& words,
 	ps_decoder_t& decoder
 ) {
-	path tempFilePath = getTempFilePath();
-	createLanguageModelFile(words, tempFilePath);
-	auto deleteTempFile = gsl::finally([&]() { std::filesystem::remove(tempFilePath); });
+	return createLanguageModel(words, nullptr, 0.0, decoder.config, *decoder.lmath);
+}
 
-	return lambda_unique_ptr<ngram_model_t>(
-		ngram_model_read(decoder.config, tempFilePath.u8string().c_str(), NGRAM_ARPA, decoder.lmath),
-		[](ngram_model_t* lm) { ngram_model_free(lm); });
+lambda_unique_ptr<ngram_model_t> createInterpolatedLanguageModel(
+	const vector<string>& words,
+	const UnigramProbabilities& backgroundProbabilities,
+	double backgroundWeight,
+	logmath_t& lmath
+) {
+	return createLanguageModel(words, &backgroundProbabilities, backgroundWeight, nullptr, lmath);
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vector>
+#include <string>
+#include <unordered_map>
 #include "tools/tools.h"
 
 extern "C" {
@@ -8,7 +10,23 @@ extern "C" {
 #include <ngram_search.h>
 }
 
+// Creates a trigram model of a word sequence that starts with "<s>" and ends with "</s>". The
+// sequence may hold several sentences, each between "<s>" and "</s>".
 lambda_unique_ptr<ngram_model_t> createLanguageModel(
 	const std::vector<std::string>& words,
 	ps_decoder_t& decoder
 );
+
+// Unigram probabilities of another language model, by word
+using UnigramProbabilities = std::unordered_map<std::string, double>;
+
+// Creates a trigram model of a word sequence like createLanguageModel(), without a decoder. Its
+// unigram probabilities are interpolated with the background probabilities, which are renormalized
+// over the sequence's words and weighted by backgroundWeight, so that words are likely in the order
+// the sequence gives them, yet also likely in proportion to how common they are elsewhere.
+lambda_unique_ptr<ngram_model_t> createInterpolatedLanguageModel(
+	const std::vector<std::string>& words,
+	const UnigramProbabilities& backgroundProbabilities,
+	double backgroundWeight,
+	logmath_t& lmath
+);
@@ -1,17 +1,41 @@
 #include "pocketSphinxTools.h"
 
 #include "tools/platformTools.h"
-#include <regex>
+#include <array>
+#include <string_view>
 #include "audio/DcOffset.h"
+#include "audio/SampleRateConverter.h"
 #include "audio/voiceActivityDetection.h"
+#include "audio/energyGate.h"
+#include "audio/AudioSegment.h"
+#include "audio/Int16AudioClip.h"
 #include "tools/parallel.h"
-#include "tools/ObjectPool.h"
+#include "tools/AnalysisStats.h"
+#include "tools/tracing.h"
+#include "tools/memoryUsage.h"
+#include "tools/cancellation.h"
+#include "tools/contentHash.h"
+#include "tools/stringTools.h"
+#include "audio/processing.h"
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cmath>
 #include "time/timedLogging.h"
+#include <gsl_util.h>
 
 extern "C" {
 #include <sphinxbase/err.h>
+#include <sphinxbase/ckd_alloc.h>
+#include <sphinxbase/cmn.h>
 #include <pocketsphinx_internal.h>
 #include <ngram_search.h>
+#include <allphone_search.h>
+#include <dict.h>
+#include <dict2pid.h>
+#include <lm/ngram_model_trie.h>
 }
 
 using std::runtime_error;
@@ -20,9 +44,11 @@ using std::unique_ptr;
 using std::string;
 using std::vector;
 using std::filesystem::path;
-using std::regex;
 using boost::optional;
 using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
 	
 logging::Level convertSphinxErrorLevel(err_lvl_t errorLevel) {
 	switch (errorLevel) {
@@ -44,28 +70,44 @@ logging::Level convertSphinxErrorLevel(err_lvl_t errorLevel) {
 void sphinxLogCallback(void* user_data, err_lvl_t errorLevel, const char* format, ...) {
 	UNUSED(user_data);
 
+	// PocketSphinx is chatty; don't format messages that would be discarded
+	const logging::Level logLevel = convertSphinxErrorLevel(errorLevel);
+	if (!logging::isEnabled(logLevel)) return;
+
 	// Create varArgs list
 	va_list args;
 	va_start(args, format);
 	auto _ = gsl::finally([&args]() { va_end(args); });
 
-	// Format message
-	const int initialSize = 256;
-	vector<char> chars(initialSize);
-	bool success = false;
-	while (!success) {
-		const int charsWritten = vsnprintf(chars.data(), chars.size(), format, args);
-		if (charsWritten < 0) throw runtime_error("Error formatting PocketSphinx log message.");
+	// Format message into a stack buffer, falling back to the heap for long messages
+	char buffer[512];
+	va_list argsCopy;
+	va_copy(argsCopy, args);
+	const int charsWritten = vsnprintf(buffer, sizeof buffer, format, argsCopy);
+	va_end(argsCopy);
+	if (charsWritten < 0) throw runtime_error("Error formatting PocketSphinx log message.");
 
-		success = charsWritten < static_cast<int>(chars.size());
-		if (!success) chars.resize(chars.size() * 2);
+	string message;
+	if (charsWritten < static_cast<int>(sizeof buffer)) {
+		message.assign(buffer, charsWritten);
+	} else {
+		vector<char> chars(charsWritten + 1);
+		vsnprintf(chars.data(), chars.size(), format, args);
+		message.assign(chars.data(), charsWritten);
+	}
+
+	// Strip the level prefix
+	static const std::array<std::string_view, 6> prefixes {
+		"DEBUG: ", "INFO: ", "INFOCONT: ", "WARN: ", "ERROR: ", "FATAL: "
+	};
+	for (const std::string_view prefix : prefixes) {
+		if (message.compare(0, prefix.size(), prefix) == 0) {
+			message.erase(0, prefix.size());
+			break;
+		}
 	}
-	const regex waste("^(DEBUG|INFO|INFOCONT|WARN|ERROR|FATAL): ");
-	string message =
-		std::regex_replace(chars.data(), waste, "", std::regex_constants::format_first_only);
 	boost::algorithm::trim(message);
 
-	const logging::Level logLevel = convertSphinxErrorLevel(errorLevel);
 	logging::log(logLevel, message);
 }
 
@@ -82,95 +124,1179 @@ void redirectPocketSphinxOutput() {
 	redirected = true;
 }
 
+DecoderPool::wrapper_type acquireDecoder(DecoderPool& decoderPool) {
+	bool isNew;
+	DecoderPool::wrapper_type decoder = decoderPool.acquire(&isNew);
+	countEvent(isNew ? AnalysisCounter::DecoderCacheMisses : AnalysisCounter::DecoderCacheHits);
+	ps_decoder_t* pooledDecoder = decoder.release();
+	return DecoderPool::wrapper_type(
+		pooledDecoder,
+		[returnToPool = decoder.get_deleter()](ps_decoder_t* returnedDecoder) {
+			compactDecoder(*returnedDecoder);
+			returnToPool(returnedDecoder);
+		});
+}
+
+void compactDecoder(ps_decoder_t& decoder) {
+	ps_compact(&decoder, decoderCompactionFrameCount);
+}
+
+void prewarmDecoders(DecoderPool& decoderPool, int decoderCount) {
+	decoderPool.prewarm(static_cast<size_t>(std::max(decoderCount, 0)));
+
+	const ObjectPoolMetrics metrics = decoderPool.getMetrics();
+	logging::debugFormat(
+		"Decoder pool holds {} decoders after prewarming; {} created, {} reused, {} waits.",
+		decoderPool.size(), metrics.creates, metrics.hits, metrics.waits
+	);
+}
+
+namespace {
+	std::atomic<int> decoderCount(0);
+
+	// The acoustic model of the first decoder read from each model directory. Later decoders share
+	// its model definition, transition matrices and Gaussian parameters instead of reading their
+	// own; only the feature computation and search state are per decoder. The models are kept
+	// while any decoder exists.
+	std::mutex sharedAcousticModelsMutex;
+	std::map<string, lambda_unique_ptr<acmod_t>> sharedAcousticModels;
+
+	lambda_unique_ptr<acmod_t> retainAcousticModel(acmod_t* acousticModel) {
+		return lambda_unique_ptr<acmod_t>(
+			acousticModel ? acmod_retain(acousticModel) : nullptr,
+			[](acmod_t* acousticModel) { acmod_free(acousticModel); });
+	}
+}
+
+lambda_unique_ptr<ps_decoder_t> initDecoder(cmd_ln_t& config) {
+	const char* modelDirectory = cmd_ln_str_r(&config, "-hmm");
+	const string modelKey = modelDirectory ? modelDirectory : "";
+	lambda_unique_ptr<acmod_t> sharedAcousticModel = retainAcousticModel(nullptr);
+	{
+		std::lock_guard<std::mutex> lock(sharedAcousticModelsMutex);
+		const auto it = sharedAcousticModels.find(modelKey);
+		if (it != sharedAcousticModels.end()) {
+			sharedAcousticModel = retainAcousticModel(it->second.get());
+		}
+	}
+
+	lambda_unique_ptr<ps_decoder_t> decoder(
+		ps_init_shared(&config, sharedAcousticModel.get()),
+		[](ps_decoder_t* decoder) {
+			ps_free(decoder);
+			if (--decoderCount == 0) {
+				std::lock_guard<std::mutex> lock(sharedAcousticModelsMutex);
+				sharedAcousticModels.clear();
+			}
+		});
+	if (!decoder) throw runtime_error("Error creating speech decoder.");
+
+	++decoderCount;
+	if (!sharedAcousticModel) {
+		std::lock_guard<std::mutex> lock(sharedAcousticModelsMutex);
+		auto& acousticModel = sharedAcousticModels[modelKey];
+		if (!acousticModel) {
+			acousticModel = retainAcousticModel(decoder->acmod);
+		}
+	}
+	return decoder;
+}
+
+int getDecoderCount() {
+	return decoderCount;
+}
+
+DecoderMemoryEstimate::DecoderMemoryEstimate(size_t defaultDecoderSize) :
+	decoderSize(defaultDecoderSize)
+{}
+
+lambda_unique_ptr<ps_decoder_t> DecoderMemoryEstimate::measure(
+	const std::function<lambda_unique_ptr<ps_decoder_t>()>& createDecoder
+) {
+	TraceScope span("createDecoder", "recognition");
+	const size_t heapUsageBefore = getHeapUsage();
+	auto decoder = createDecoder();
+	const size_t heapUsageAfter = getHeapUsage();
+	// Without heap usage, keep the default
+	if (heapUsageAfter > heapUsageBefore) {
+		decoderSize = heapUsageAfter - heapUsageBefore;
+	}
+	return decoder;
+}
+
+size_t DecoderMemoryEstimate::getMissingDecoderSize(const DecoderPool& decoderPool, int maxThreadCount) const {
+	const size_t pooledDecoderCount = decoderPool.size();
+	const size_t neededDecoderCount = static_cast<size_t>(std::max(maxThreadCount, 1));
+	return neededDecoderCount > pooledDecoderCount
+		? (neededDecoderCount - pooledDecoderCount) * decoderSize.load()
+		: 0;
+}
+
+// Warm decoders cost nothing, but creating one takes as long as recognizing seconds of speech, so
+// recognition only creates an additional decoder for each this much speech
+constexpr centiseconds speechPerNewDecoder = 500_cs;
+
+// The duration of the pieces long utterances are split into. Short enough to spread a monologue
+// over threads, and it bounds the memory of forced alignment, which keeps a backpointer for every
+// HMM state of the utterance's words in every frame: some 25 MB for 30 seconds of dense speech.
+// It doesn't depend on the thread count, so that results don't either.
+constexpr centiseconds utterancePieceDuration = 1000_cs;
+
+RecognitionCostModel::RecognitionCostModel(double defaultVadCost, double defaultRecognitionCost) :
+	vadCost(defaultVadCost),
+	recognitionCost(defaultRecognitionCost),
+	speechShare(0.8)
+{}
+
+double RecognitionCostModel::estimateVadCost(centiseconds audioDuration) const {
+	return vadCost.estimate(audioDuration.count() / 100.0);
+}
+
+double RecognitionCostModel::estimateRecognitionCost(centiseconds speechDuration) const {
+	return recognitionCost.estimate(speechDuration.count() / 100.0);
+}
+
+double RecognitionCostModel::estimateRecognitionCostOfAudio(centiseconds audioDuration) const {
+	return recognitionCost.estimate(speechShare.estimate(audioDuration.count() / 100.0));
+}
+
+milliseconds RecognitionCostModel::estimateDuration(centiseconds audioDuration, int maxThreadCount) const {
+	// Voice activity detection of a single clip runs on one thread, recognition on as many threads as
+	// the speech keeps busy
+	const double speechSeconds = speechShare.estimate(audioDuration.count() / 100.0);
+	const int threadCount = std::clamp(
+		static_cast<int>(speechSeconds * 100 / speechPerNewDecoder.count()),
+		1,
+		std::max(maxThreadCount, 1)
+	);
+	return milliseconds(std::llround(
+		estimateVadCost(audioDuration) + recognitionCost.estimate(speechSeconds) / threadCount
+	));
+}
+
+void RecognitionCostModel::measureVad(centiseconds audioDuration, centiseconds speechDuration, nanoseconds work) {
+	vadCost.measure(audioDuration.count() / 100.0, work);
+	speechShare.measure(audioDuration.count(), static_cast<double>(speechDuration.count()));
+}
+
+void RecognitionCostModel::measureRecognition(centiseconds speechDuration, nanoseconds work) {
+	recognitionCost.measure(speechDuration.count() / 100.0, work);
+}
+
+// Incremental recognition holds back the audio this close to the end of what has arrived, and to
+// the end of the open utterance's padding, because resampling it would still change once more audio
+// arrives. For the same reason, it resamples new audio along with this much of the audio before it.
+constexpr centiseconds incrementalFeedMargin = 2_cs;
+
+// Tentative phones are guessed anew whenever this many more frames (100 ms) have been searched
+constexpr int tentativePhoneFrameInterval = 10;
+
+DecoderUtteranceRecognizer::DecoderUtteranceRecognizer(
+	DecoderPool& decoderPool,
+	decoderPreparer prepareDecoder,
+	optional<string> dialog,
+	utteranceToPhonesFunction utteranceToPhones
+) :
+	decoderPool(decoderPool),
+	prepareDecoder(std::move(prepareDecoder)),
+	dialog(std::move(dialog)),
+	utteranceToPhones(std::move(utteranceToPhones))
+{
+	// Prepare a decoder right away, so that a dialog that can't be prepared fails here and its
+	// language model is cached before the first utterance
+	borrowDecoder();
+	incremental = LiveCmnState::isLive(*decoder)
+		&& std::strcmp(ps_search_type(decoder->search), PS_SEARCH_TYPE_NGRAM) == 0;
+	returnDecoder();
+}
+
+DecoderUtteranceRecognizer::~DecoderUtteranceRecognizer() {
+	// The open utterance ends on its decoder before the decoder is returned
+	openUtterance.reset();
+}
+
+void DecoderUtteranceRecognizer::borrowDecoder() {
+	if (decoder) return;
+
+	DecoderPool::wrapper_type newDecoder = acquireDecoder(decoderPool);
+	if (prepareDecoder) {
+		prepareDecoder(*newDecoder, dialog);
+	}
+	// Continue from this recognizer's own speech rather than whatever the decoder heard last
+	cmnState.restore(*newDecoder);
+	decoder = std::move(newDecoder);
+}
+
+void DecoderUtteranceRecognizer::returnDecoder() {
+	if (!decoder || openUtterance) return;
+
+	if (LiveCmnState::isLive(*decoder)) {
+		cmnState = LiveCmnState(*decoder);
+	}
+	decoder.reset();
+}
+
+Timeline<Phone> DecoderUtteranceRecognizer::recognizeUtterance(
+	const AudioClip& audioClip,
+	TimeRange utteranceTimeRange,
+	ProgressSink& progressSink
+) {
+	borrowDecoder();
+	// Discarding the open utterance returns the decoder, so that only happens once it has aligned
+	// the words
+	auto release = gsl::finally([&]() { discardUtterance(); });
+
+	optional<RecognizedUtterance> recognizedUtterance;
+	if (openUtterance) {
+		// Use the incremental recognition unless the utterance turned out to start elsewhere
+		const TimeRange paddedTimeRange = getPaddedUtteranceRange(utteranceTimeRange, audioClip);
+		const bool sameUtterance = utteranceTimeRange.getStart() == openUtteranceStart
+			&& paddedTimeRange.getStart() == fedStart
+			&& paddedTimeRange.getEnd() >= fedEnd;
+		if (sameUtterance) {
+			feedOpenUtterance(audioClip, paddedTimeRange.getEnd());
+			recognizedUtterance = openUtterance->finish();
+		}
+		// Ends the decoder's utterance, unless it has been finished
+		openUtterance.reset();
+	}
+
+	TraceScope span("utterance", "recognition");
+	span.setArgument("decoder", getTraceObjectId(decoder.get()));
+	span.setArgument("start", utteranceTimeRange.getStart().count());
+	return utteranceToPhones(
+		audioClip,
+		utteranceTimeRange,
+		boost::none,
+		recognizedUtterance ? &*recognizedUtterance : nullptr,
+		*decoder,
+		progressSink
+	);
+}
+
+void DecoderUtteranceRecognizer::continueUtterance(const AudioClip& audioClip, TimeRange utteranceTimeRange) {
+	if (!incremental) return;
+
+	if (openUtterance && utteranceTimeRange.getStart() != openUtteranceStart) {
+		discardUtterance();
+	}
+	const TimeRange paddedTimeRange = getPaddedUtteranceRange(utteranceTimeRange, audioClip);
+	if (!openUtterance) {
+		borrowDecoder();
+		try {
+			openUtterance = std::make_unique<IncrementalWordRecognition>(*decoder);
+		} catch (...) {
+			returnDecoder();
+			throw;
+		}
+		openUtteranceStart = utteranceTimeRange.getStart();
+		fedStart = paddedTimeRange.getStart();
+		fedEnd = fedStart;
+	}
+
+	try {
+		feedOpenUtterance(audioClip, paddedTimeRange.getEnd() - incrementalFeedMargin);
+	} catch (...) {
+		discardUtterance();
+		throw;
+	}
+}
+
+void DecoderUtteranceRecognizer::discardUtterance() {
+	openUtterance.reset();
+	tentativePhones = Timeline<Phone>();
+	tentativeFrameCount = 0;
+	returnDecoder();
+}
+
+Timeline<Phone> DecoderUtteranceRecognizer::getTentativePhones() {
+	if (!openUtterance) return {};
+
+	// Tracing back the partial result is cheap, but not cheap enough to repeat for every push
+	const int searchedFrameCount = openUtterance->getSearchedFrameCount();
+	if (searchedFrameCount >= tentativeFrameCount + tentativePhoneFrameInterval) {
+		tentativePhones = spreadWordPhones(openUtterance->getPartialWords(), *decoder);
+		tentativePhones.shift(fedStart);
+		tentativeFrameCount = searchedFrameCount;
+	}
+	return tentativePhones;
+}
+
+vector<float> DecoderUtteranceRecognizer::getCarriedState() const {
+	return cmnState.toFloats();
+}
+
+void DecoderUtteranceRecognizer::setCarriedState(const vector<float>& state) {
+	cmnState = LiveCmnState::fromFloats(state);
+}
+
+void DecoderUtteranceRecognizer::feedOpenUtterance(const AudioClip& audioClip, centiseconds end) {
+	if (end <= fedEnd) return;
+
+	const centiseconds overlapStart = std::max(fedEnd - incrementalFeedMargin, fedStart);
+	const Timebase timebase(getDecoderSampleRate(*decoder));
+	const unique_ptr<AudioClip> newAudio = audioClip.clone()
+		| segment(TimeRange(overlapStart, end))
+		| resample(timebase.getSampleRate());
+	vector<int16_t> audioBufferStorage;
+	const gsl::span<const int16_t> audioBuffer = get16bitSamples(*newAudio, audioBufferStorage);
+	const auto overlapSampleCount = std::min<std::ptrdiff_t>(
+		timebase.toSampleIndex(fedEnd - overlapStart),
+		audioBuffer.size()
+	);
+	openUtterance->addSamples(audioBuffer.subspan(overlapSampleCount));
+	fedEnd = end;
+}
+
+// Converts a clip to 16-bit samples at its rate of getSphinxSampleRate(), removing its DC offset in
+// the same pass, and detects its voice activity.
+// Long silences are skipped by an energy gate: only the audible stretches are converted and searched
+// for voice activity, while the silence between them is left at zero. Clips without long silences
+// are processed as a whole.
+// If noiseModel is set, detection starts from it and it is updated from the clip.
+// Detection runs on a single thread before recognition starts: it takes about 0.2% of the time of
+// recognizing the speech it finds, and detecting chunks in parallel would start each chunk from
+// unconverged noise models, moving utterance boundaries for no measurable gain.
+static unique_ptr<AudioClip> prepareClip(
+	const AudioClip& inputAudioClip,
+	JoiningBoundedTimeline<void>& utterances,
+	ProgressSink& progressSink,
+	VadNoiseModel* noiseModel
+) {
+	const JoiningBoundedTimeline<void> sound = [&] {
+		const StageTimer timer(AnalysisStage::VoiceActivityDetection);
+		return detectSound(inputAudioClip);
+	}();
+	const TimeRange clipRange = inputAudioClip.getTruncatedRange();
+	const Timebase timebase(getSphinxSampleRate(inputAudioClip.getSampleRate()));
+	if (sound.size() == 1 && sound.begin()->getTimeRange() == clipRange) {
+		unique_ptr<AudioClip> audioClip;
+		{
+			const StageTimer timer(AnalysisStage::Resampling);
+			audioClip = inputAudioClip.clone()
+				| resample(timebase.getSampleRate())
+				| removeDcOffsetTo16bit();
+		}
+		const StageTimer timer(AnalysisStage::VoiceActivityDetection);
+		utterances = detectVoiceActivity(*audioClip, progressSink, noiseModel);
+		return audioClip;
+	}
+
+	const AudioClip::size_type size = (inputAudioClip.clone() | resample(timebase.getSampleRate()))->size();
+	const auto buffer = std::make_shared<vector<int16_t>>(static_cast<size_t>(size), int16_t(0));
+	utterances = JoiningBoundedTimeline<void>(clipRange);
+
+	ProgressMerger progressMerger(progressSink);
+	vector<ProgressSink*> soundProgressSinks;
+	for (const auto& timedSound : sound) {
+		soundProgressSinks.push_back(&progressMerger.addSource(
+			fmt::format("sound at {}", formatDuration(timedSound.getStart())),
+			static_cast<double>(timedSound.getDuration().count())
+		));
+	}
+
+	centiseconds audibleDuration = 0_cs;
+	size_t soundIndex = 0;
+	for (const auto& timedSound : sound) {
+		const TimeRange& range = timedSound.getTimeRange();
+		unique_ptr<AudioClip> soundClip;
+		{
+			const StageTimer timer(AnalysisStage::Resampling);
+			soundClip = inputAudioClip.clone()
+				| segment(range)
+				| resample(timebase.getSampleRate())
+				| removeDcOffsetTo16bit();
+		}
+
+		// The converted stretch may round to a sample more or less than its place in the buffer
+		const size_t offset = static_cast<size_t>(timebase.toSampleIndex(range.getStart()));
+		const size_t count = std::min(static_cast<size_t>(soundClip->size()), buffer->size() - std::min(offset, buffer->size()));
+		const int16_t* samples = soundClip->get16bitBuffer();
+		std::copy(samples, samples + count, buffer->begin() + offset);
+
+		const StageTimer timer(AnalysisStage::VoiceActivityDetection);
+		for (const auto& timedUtterance : detectVoiceActivity(*soundClip, *soundProgressSinks[soundIndex++], noiseModel)) {
+			utterances.set(timedUtterance.getStart() + range.getStart(), timedUtterance.getEnd() + range.getStart());
+		}
+		audibleDuration += range.getDuration();
+	}
+	logging::debugFormat(
+		"Energy gate skipped {} of {} of audio.",
+		formatDuration(clipRange.getDuration() - audibleDuration),
+		formatDuration(clipRange.getDuration())
+	);
+
+	// Share ownership of the vector while pointing to its data
+	std::shared_ptr<const int16_t> samples(buffer, buffer->data());
+	return std::make_unique<Int16AudioClip>(std::move(samples), size, timebase.getSampleRate());
+}
+
+TimeRange getPaddedUtteranceRange(TimeRange utteranceTimeRange, const AudioClip& audioClip) {
+	utteranceTimeRange.grow(utterancePadding);
+	utteranceTimeRange.trim(audioClip.getTruncatedRange());
+	return utteranceTimeRange;
+}
+
+UtterancePhoneCache::UtterancePhoneCache() :
+	entries(capacity)
+{}
+
+uint64_t UtterancePhoneCache::getKey(
+	const AudioClip& audioClip,
+	TimeRange utteranceTimeRange,
+	const optional<string>& dialog
+) {
+	const TimeRange paddedTimeRange = getPaddedUtteranceRange(utteranceTimeRange, audioClip);
+	const unique_ptr<AudioClip> clipSegment = audioClip.clone() | segment(paddedTimeRange);
+	vector<int16_t> audioBufferStorage;
+	const gsl::span<const int16_t> audioBuffer = get16bitSamples(*clipSegment, audioBufferStorage);
+
+	ContentHasher hasher;
+	hasher.add(audioBuffer.data(), audioBuffer.size() * sizeof(int16_t));
+	// Where the utterance lies within the padded samples
+	hasher.addValue((utteranceTimeRange.getStart() - paddedTimeRange.getStart()).count());
+	hasher.addValue((paddedTimeRange.getEnd() - utteranceTimeRange.getEnd()).count());
+	hasher.addValue(dialog.has_value());
+	hasher.add(dialog.value_or(string()));
+	return hasher.get();
+}
+
+optional<UtterancePhoneCache::Utterance> UtterancePhoneCache::get(uint64_t key, centiseconds utteranceStart) {
+	const optional<std::shared_ptr<const Entry>> entry = entries.get(key);
+	if (!entry) return boost::none;
+
+	Utterance utterance = (*entry)->utterance;
+	utterance.phones.shift(utteranceStart - (*entry)->utteranceStart);
+	utterance.words.shift(utteranceStart - (*entry)->utteranceStart);
+	return utterance;
+}
+
+void UtterancePhoneCache::set(uint64_t key, centiseconds utteranceStart, const Utterance& utterance) {
+	entries.set(key, std::make_shared<const Entry>(Entry { utteranceStart, utterance }));
+}
+
+namespace {
+	// The words reported for the utterance the current thread is recognizing
+	thread_local Timeline<string>* currentUtteranceWords = nullptr;
+}
+
+void reportUtteranceWords(const Timeline<string>& words) {
+	if (currentUtteranceWords) {
+		*currentUtteranceWords = words;
+	}
+}
+
+static std::atomic<bool> utterancePhoneCacheEnabled(true);
+
+bool isUtterancePhoneCacheEnabled() {
+	return utterancePhoneCacheEnabled;
+}
+
+void setUtterancePhoneCacheEnabled(bool enabled) {
+	utterancePhoneCacheEnabled = enabled;
+}
+
 BoundedTimeline<Phone> recognizePhones(
 	const AudioClip& inputAudioClip,
 	optional<std::string> dialog,
-	decoderFactory createDecoder,
+	SpeakerProfile* speakerProfile,
+	DecoderPool& decoderPool,
+	UtterancePhoneCache& utterancePhoneCache,
+	RecognitionCostModel& costModel,
+	decoderPreparer prepareDecoder,
 	utteranceToPhonesFunction utteranceToPhones,
 	int maxThreadCount,
-	ProgressSink& progressSink
+	ProgressSink& progressSink,
+	dialogDistributor distributeDialog,
+	RecognizedPhonesSink phonesSink
+) {
+	PhoneRecognitionBatch batch(
+		{ RecognitionInput { &inputAudioClip, std::move(dialog), speakerProfile } },
+		decoderPool,
+		utterancePhoneCache,
+		costModel,
+		std::move(prepareDecoder),
+		std::move(utteranceToPhones),
+		maxThreadCount,
+		progressSink,
+		std::move(distributeDialog)
+	);
+	if (phonesSink) {
+		batch.setPhonesSink([&phonesSink](size_t, const Timeline<Phone>& phones, centiseconds knownEnd) {
+			phonesSink(phones, knownEnd);
+		});
+	}
+	batch.run();
+	return std::move(batch.finish().front());
+}
+
+vector<BoundedTimeline<Phone>> recognizePhonesBatch(
+	const vector<RecognitionInput>& inputs,
+	DecoderPool& decoderPool,
+	UtterancePhoneCache& utterancePhoneCache,
+	RecognitionCostModel& costModel,
+	decoderPreparer prepareDecoder,
+	utteranceToPhonesFunction utteranceToPhones,
+	int maxThreadCount,
+	ProgressSink& progressSink,
+	dialogDistributor distributeDialog
 ) {
-	ProgressMerger totalProgressMerger(progressSink);
-	ProgressSink& voiceActivationProgressSink =
-		totalProgressMerger.addSource("VAD (PocketSphinx tools)", 1.0);
-	ProgressSink& dialogProgressSink =
-		totalProgressMerger.addSource("recognition (PocketSphinx tools)", 15.0);
+	PhoneRecognitionBatch batch(
+		inputs,
+		decoderPool,
+		utterancePhoneCache,
+		costModel,
+		std::move(prepareDecoder),
+		std::move(utteranceToPhones),
+		maxThreadCount,
+		progressSink,
+		std::move(distributeDialog)
+	);
+	batch.run();
+	return batch.finish();
+}
 
-	// Make sure audio stream has no DC offset
-	const unique_ptr<AudioClip> audioClip = inputAudioClip.clone() | removeDcOffset();
+PhoneRecognitionBatch::PhoneRecognitionBatch(
+	const vector<RecognitionInput>& inputs,
+	DecoderPool& decoderPool,
+	UtterancePhoneCache& utterancePhoneCache,
+	RecognitionCostModel& costModel,
+	decoderPreparer prepareDecoder,
+	utteranceToPhonesFunction utteranceToPhones,
+	int maxThreadCount,
+	ProgressSink& progressSink,
+	dialogDistributor distributeDialog
+) :
+	decoderPool(decoderPool),
+	utterancePhoneCache(utterancePhoneCache),
+	costModel(costModel),
+	prepareDecoder(std::move(prepareDecoder)),
+	utteranceToPhones(std::move(utteranceToPhones)),
+	totalProgressMerger(progressSink),
+	useUtterancePhoneCache(isUtterancePhoneCacheEnabled()),
+	timings(RecognitionTimings::getCurrent())
+{
+	if (maxThreadCount < 1) {
+		throw invalid_argument(fmt::format("maxThreadCount cannot be {}.", maxThreadCount));
+	}
 
-	// Split audio into utterances
-	JoiningBoundedTimeline<void> utterances;
-	try {
-		utterances = detectVoiceActivity(*audioClip, voiceActivationProgressSink);
-	} catch (...) {
-		std::throw_with_nested(runtime_error("Error detecting segments of speech."));
+	// Weight the stages by their expected cost, so that progress grows evenly over time
+	centiseconds audioDuration = 0_cs;
+	for (const RecognitionInput& input : inputs) {
+		audioDuration += input.audioClip->getTruncatedRange().getDuration();
+	}
+	ProgressSink& voiceActivationProgressSink = totalProgressMerger.addSource(
+		"VAD (PocketSphinx tools)",
+		costModel.estimateVadCost(audioDuration)
+	);
+	ProgressSink& dialogProgressSink = totalProgressMerger.addSource(
+		"recognition (PocketSphinx tools)",
+		costModel.estimateRecognitionCostOfAudio(audioDuration)
+	);
+
+	// Start clips of a speaker from the profile as it is now, so that the result doesn't depend on
+	// which other clips of the batch finish first
+	for (const RecognitionInput& input : inputs) {
+		speakerProfiles.push_back(input.speakerProfile);
+		speakerStates.push_back(input.speakerProfile ? input.speakerProfile->getState() : SpeakerProfile::State());
+		noiseModels.push_back(speakerStates.back().noiseModel);
+	}
+
+	// For each clip, convert the audio to 16-bit samples at its recognition rate once, so that VAD
+	// and all utterances read from the same buffer instead of re-evaluating the effects.
+	// Afterwards, split the audio into utterances.
+	audioClips.resize(inputs.size());
+	vector<JoiningBoundedTimeline<void>> clipUtterances(inputs.size());
+	std::atomic<int64_t> vadWork(0);
+	{
+		ProgressMerger vadProgressMerger(voiceActivationProgressSink);
+		vector<std::function<void()>> vadTasks;
+		for (size_t clipIndex = 0; clipIndex < inputs.size(); ++clipIndex) {
+			const AudioClip& inputAudioClip = *inputs[clipIndex].audioClip;
+			ProgressSink& clipProgressSink = vadProgressMerger.addSource(
+				fmt::format("VAD #{}", clipIndex),
+				static_cast<double>(inputAudioClip.getTruncatedRange().getDuration().count()) + 1
+			);
+			vadTasks.push_back([&, clipIndex] {
+				try {
+					const auto start = steady_clock::now();
+					audioClips[clipIndex] = prepareClip(
+						inputAudioClip,
+						clipUtterances[clipIndex],
+						clipProgressSink,
+						speakerProfiles[clipIndex] ? &noiseModels[clipIndex] : nullptr
+					);
+					vadWork += duration_cast<nanoseconds>(steady_clock::now() - start).count();
+				} catch (const OperationCancelled&) {
+					throw;
+				} catch (...) {
+					std::throw_with_nested(runtime_error("Error detecting segments of speech."));
+				}
+			});
+		}
+		runTasksInParallel(vadTasks, std::min(maxThreadCount, std::max(static_cast<int>(inputs.size()), 1)));
 	}
 
 	redirectPocketSphinxOutput();
 
-	// Prepare pool of decoders
-	ObjectPool<ps_decoder_t, lambda_unique_ptr<ps_decoder_t>> decoderPool(
-		[&] { return createDecoder(dialog); });
-
-	BoundedTimeline<Phone> phones(audioClip->getTruncatedRange());
-	std::mutex resultMutex;
-	const auto processUtterance = [&](Timed<void> timedUtterance, ProgressSink& utteranceProgressSink) {
-		// Detect phones for utterance
-		const auto decoder = decoderPool.acquire();
-		Timeline<Phone> utterancePhones = utteranceToPhones(
-			*audioClip,
-			timedUtterance.getTimeRange(),
+	// Group the utterances by dialog, so that each decoder switches language models as rarely as
+	// possible. Dialog models are cached, so each one is built once.
+	std::map<optional<string>, size_t> dialogIndexes;
+	centiseconds speechDuration = 0_cs;
+	for (size_t clipIndex = 0; clipIndex < inputs.size(); ++clipIndex) {
+		const auto inserted = dialogIndexes.emplace(inputs[clipIndex].dialog, dialogs.size());
+		if (inserted.second) {
+			dialogs.push_back(inputs[clipIndex].dialog);
+		}
+		for (const auto& timedUtterance : clipUtterances[clipIndex]) {
+			jobs.push_back({ clipIndex, inserted.first->second, timedUtterance, boost::none });
+			speechDuration += timedUtterance.getDuration();
+		}
+	}
+	countEvent(AnalysisCounter::Utterances, static_cast<int64_t>(jobs.size()));
+	costModel.measureVad(audioDuration, speechDuration, nanoseconds(vadWork.load()));
+
+	// Determine how many parallel threads to use.
+	// Only create additional decoders if there is enough speech to keep them busy.
+	const int warmDecoderCount = static_cast<int>(decoderPool.size());
+	threadCount = std::min(
+		maxThreadCount,
+		std::max(warmDecoderCount, static_cast<int>(speechDuration / speechPerNewDecoder))
+	);
+	if (threadCount < 1) {
+		threadCount = 1;
+	}
+
+	// Split long utterances into pieces of about utterancePieceDuration at their quietest points, so
+	// that a long monologue doesn't keep one thread busy while the others are idle.
+	// Splitting is what spreads a monologue over threads: aligning an utterance takes about 1% of the
+	// time of recognizing its words, so running the two stages on separate decoders would gain next to
+	// nothing for twice the decoders.
+	// The pieces are the same on any number of threads and with any number of warm decoders; threads
+	// only schedule them.
+	{
+		const centiseconds pieceDuration = utterancePieceDuration;
+		// Split points are searched for within this distance of the even split
+		const centiseconds searchRadius = std::min(100_cs, pieceDuration / 4);
+		vector<UtteranceJob> splitJobs;
+		for (const UtteranceJob& job : jobs) {
+			const centiseconds duration = job.utterance.getDuration();
+			const int pieceCount = static_cast<int>(std::lround(static_cast<double>(duration.count()) / pieceDuration.count()));
+			if (duration < pieceDuration * 3 / 2 || pieceCount < 2) {
+				splitJobs.push_back(job);
+				continue;
+			}
+
+			centiseconds pieceStart = job.utterance.getStart();
+			for (int piece = 1; piece < pieceCount; ++piece) {
+				const centiseconds evenSplit = job.utterance.getStart() + duration * piece / pieceCount;
+				const centiseconds split = findQuietestPoint(
+					*audioClips[job.clipIndex],
+					TimeRange(std::max(evenSplit - searchRadius, pieceStart + 1_cs), evenSplit + searchRadius)
+				);
+				splitJobs.push_back({ job.clipIndex, job.dialogIndex, Timed<void>(pieceStart, split), boost::none });
+				pieceStart = split;
+			}
+			splitJobs.push_back({ job.clipIndex, job.dialogIndex, Timed<void>(pieceStart, job.utterance.getEnd()), boost::none });
+			logging::debugFormat(
+				"Split utterance at {} into {} pieces.",
+				formatDuration(job.utterance.getStart()),
+				pieceCount
+			);
+		}
+		jobs = std::move(splitJobs);
+	}
+
+	// Don't use more threads than there are utterances to be processed
+	threadCount = std::max(1, std::min(threadCount, static_cast<int>(jobs.size())));
+
+	// Distribute each clip's dialog over its utterances, including the pieces of split ones. The
+	// jobs are still in chronological order per clip.
+	if (distributeDialog && !jobs.empty()) {
+		const auto decoder = acquireDecoder(decoderPool);
+		for (size_t clipIndex = 0; clipIndex < inputs.size(); ++clipIndex) {
+			const optional<string>& dialog = inputs[clipIndex].dialog;
+			if (!dialog) continue;
+
+			vector<UtteranceJob*> clipJobs;
+			vector<TimeRange> utteranceTimeRanges;
+			for (UtteranceJob& job : jobs) {
+				if (job.clipIndex != clipIndex) continue;
+				clipJobs.push_back(&job);
+				utteranceTimeRanges.push_back(job.utterance.getTimeRange());
+			}
+			if (clipJobs.empty()) continue;
+
+			vector<vector<string>> utteranceWords = distributeDialog(*decoder, *dialog, utteranceTimeRanges);
+			if (utteranceWords.size() != clipJobs.size()) continue;
+			for (size_t i = 0; i < clipJobs.size(); ++i) {
+				clipJobs[i]->words = std::move(utteranceWords[i]);
+			}
+		}
+	}
+
+	// Within a dialog, start the longest utterances first, so that no long utterance is left running
+	// at the end. Dialogs with longer utterances go first for the same reason; that way, the longest
+	// utterance of all starts right away. A single thread keeps chronological order.
+	vector<size_t> dialogRanks(dialogs.size());
+	std::iota(dialogRanks.begin(), dialogRanks.end(), size_t(0));
+	if (threadCount > 1) {
+		vector<centiseconds> longestDurations(dialogs.size(), 0_cs);
+		for (const UtteranceJob& job : jobs) {
+			longestDurations[job.dialogIndex] = std::max(longestDurations[job.dialogIndex], job.utterance.getDuration());
+		}
+		vector<size_t> dialogOrder(dialogRanks);
+		std::stable_sort(dialogOrder.begin(), dialogOrder.end(), [&](size_t a, size_t b) {
+			return longestDurations[a] > longestDurations[b];
+		});
+		for (size_t rank = 0; rank < dialogOrder.size(); ++rank) {
+			dialogRanks[dialogOrder[rank]] = rank;
+		}
+	}
+	std::stable_sort(jobs.begin(), jobs.end(), [&](const UtteranceJob& a, const UtteranceJob& b) {
+		if (a.dialogIndex != b.dialogIndex) return dialogRanks[a.dialogIndex] < dialogRanks[b.dialogIndex];
+		return threadCount > 1 && a.utterance.getDuration() > b.utterance.getDuration();
+	});
+
+	clipJobIndexes.resize(audioClips.size());
+	for (size_t jobIndex = 0; jobIndex < jobs.size(); ++jobIndex) {
+		clipJobIndexes[jobs[jobIndex].clipIndex].push_back(jobIndex);
+	}
+	for (vector<size_t>& jobIndexes : clipJobIndexes) {
+		std::sort(jobIndexes.begin(), jobIndexes.end(), [&](size_t a, size_t b) {
+			return jobs[a].utterance.getStart() < jobs[b].utterance.getStart();
+		});
+	}
+	passedJobCounts.resize(audioClips.size(), 0);
+	jobPhones.resize(jobs.size());
+	jobWords.resize(jobs.size());
+	recognizedJobs.resize(jobs.size(), false);
+	jobCepstra.resize(jobs.size());
+
+	recognitionProgressMerger = std::make_unique<ProgressMerger>(dialogProgressSink);
+	for (const UtteranceJob& job : jobs) {
+		ProgressSink& utteranceProgressSink = recognitionProgressMerger->addSource(
+			fmt::format("utterance #{} of clip #{}", tasks.size(), job.clipIndex),
+			static_cast<double>(job.utterance.getDuration().count())
+		);
+		tasks.push_back([this, &job = job, &utteranceProgressSink = utteranceProgressSink] {
+			recognizeUtterance(job, utteranceProgressSink);
+		});
+	}
+}
+
+PhoneRecognitionBatch::~PhoneRecognitionBatch() = default;
+
+void PhoneRecognitionBatch::recognizeUtterance(const UtteranceJob& job, ProgressSink& utteranceProgressSink) {
+	const AudioClip& audioClip = *audioClips[job.clipIndex];
+	const TimeRange utteranceTimeRange = job.utterance.getTimeRange();
+	// The phones of a speaker's utterance depend on the profile, and its statistics are needed
+	const SpeakerProfile::State* speakerState =
+		speakerProfiles[job.clipIndex] ? &speakerStates[job.clipIndex] : nullptr;
+	const bool useCache = useUtterancePhoneCache && !speakerState;
+	uint64_t cacheKey = 0;
+	optional<UtterancePhoneCache::Utterance> cachedUtterance;
+	if (useCache) {
+		// Distributed words may differ between occurrences of an utterance with the same dialog
+		cacheKey = UtterancePhoneCache::getKey(
+			audioClip,
+			utteranceTimeRange,
+			job.words ? optional<string>(join(*job.words, " ")) : dialogs[job.dialogIndex]
+		);
+		cachedUtterance = utterancePhoneCache.get(cacheKey, utteranceTimeRange.getStart());
+		countEvent(cachedUtterance ? AnalysisCounter::UtteranceCacheHits : AnalysisCounter::UtteranceCacheMisses);
+	}
+	if (cachedUtterance) {
+		utteranceProgressSink.reportProgress(1.0);
+		addUtterancePhones(job, std::move(*cachedUtterance));
+		return;
+	}
+
+	// Detect phones for utterance
+	const auto decoder = acquireDecoder(decoderPool);
+	bool isPrepared;
+	{
+		std::lock_guard<std::mutex> lock(decoderDialogIndexesMutex);
+		const auto it = decoderDialogIndexes.find(decoder.get());
+		isPrepared = it != decoderDialogIndexes.end() && it->second == job.dialogIndex;
+	}
+	TraceScope span("utterance", "recognition");
+	span.setArgument("decoder", getTraceObjectId(decoder.get()));
+	span.setArgument("start", utteranceTimeRange.getStart().count());
+	if (!isPrepared) {
+		prepareDecoder(*decoder, dialogs[job.dialogIndex]);
+		std::lock_guard<std::mutex> lock(decoderDialogIndexesMutex);
+		decoderDialogIndexes[decoder.get()] = job.dialogIndex;
+	}
+	const auto start = steady_clock::now();
+	optional<CmnPriorScope> cmnPrior;
+	if (speakerState) {
+		cmnPrior.emplace(*decoder, *speakerState);
+	}
+	UtterancePhoneCache::Utterance utterance;
+	{
+		// Collect the words the recognizer reports, if it recognizes any
+		Timeline<string>* const outerUtteranceWords = currentUtteranceWords;
+		currentUtteranceWords = &utterance.words;
+		auto restoreUtteranceWords = gsl::finally([&]() { currentUtteranceWords = outerUtteranceWords; });
+		utterance.phones = utteranceToPhones(
+			audioClip,
+			utteranceTimeRange,
+			job.words,
+			nullptr,
 			*decoder,
 			utteranceProgressSink
 		);
+	}
+	recognitionWork += duration_cast<nanoseconds>(steady_clock::now() - start).count();
+	recognizedSpeechDuration += utteranceTimeRange.getDuration().count();
+	if (useCache) {
+		utterancePhoneCache.set(cacheKey, utteranceTimeRange.getStart(), utterance);
+	}
 
-		// Copy phones to result timeline
-		std::lock_guard<std::mutex> lock(resultMutex);
-		for (const auto& timedPhone : utterancePhones) {
-			phones.set(timedPhone);
-		}
-	};
+	if (cmnPrior) {
+		jobCepstra[&job - jobs.data()] = cmnPrior->getUtteranceStatistics();
+	}
+	addUtterancePhones(job, std::move(utterance));
+}
 
-	const auto getUtteranceProgressWeight = [](const Timed<void> timedUtterance) {
-		return timedUtterance.getDuration().count();
-	};
+void PhoneRecognitionBatch::addUtterancePhones(const UtteranceJob& job, UtterancePhoneCache::Utterance utterance) {
+	const size_t jobIndex = &job - jobs.data();
+	jobPhones[jobIndex] = std::move(utterance.phones);
+	jobWords[jobIndex] = std::move(utterance.words);
+	if (!phonesSink) return;
+
+	// Pass on the phones of this job and of the later ones that were only waiting for it
+	std::lock_guard<std::mutex> lock(phonesSinkMutex);
+	recognizedJobs[jobIndex] = true;
+	const vector<size_t>& jobIndexes = clipJobIndexes[job.clipIndex];
+	size_t& passedJobCount = passedJobCounts[job.clipIndex];
+	while (passedJobCount < jobIndexes.size() && recognizedJobs[jobIndexes[passedJobCount]]) {
+		const Timeline<Phone>& passedPhones = jobPhones[jobIndexes[passedJobCount++]];
+		// Recognized phones may reach into the padding before an utterance
+		const centiseconds knownEnd = passedJobCount < jobIndexes.size()
+			? std::max(jobs[jobIndexes[passedJobCount]].utterance.getStart() - utterancePadding, 0_cs)
+			: audioClips[job.clipIndex]->getTruncatedRange().getEnd();
+		phonesSink(job.clipIndex, passedPhones, knownEnd);
+	}
+}
+
+void PhoneRecognitionBatch::setPhonesSink(
+	std::function<void(size_t clipIndex, const Timeline<Phone>& phones, centiseconds knownEnd)> sink
+) {
+	phonesSink = std::move(sink);
+}
 
-	// Perform speech recognition
+void PhoneRecognitionBatch::run() {
+	const vector<std::function<void()>> remainingTasks(tasks.begin() + nextTaskIndex, tasks.end());
+	nextTaskIndex = tasks.size();
 	try {
-		// Determine how many parallel threads to use
-		int threadCount = std::min({
-			maxThreadCount,
-			// Don't use more threads than there are utterances to be processed
-			static_cast<int>(utterances.size()),
-			// Don't waste time creating additional threads (and decoders!) if the recording is short
-			static_cast<int>(
-				duration_cast<std::chrono::seconds>(audioClip->getTruncatedRange().getDuration()).count() / 5
-			)
-		});
-		if (threadCount < 1) {
-			threadCount = 1;
-		}
 		logging::debugFormat("Speech recognition using {} threads -- start", threadCount);
-		runParallel(
-			"speech recognition (PocketSphinx tools)",
-			processUtterance,
-			utterances,
-			threadCount,
-			dialogProgressSink,
-			getUtteranceProgressWeight
-		);
+		runTasksInParallel(remainingTasks, threadCount);
 		logging::debug("Speech recognition -- end");
+	} catch (const OperationCancelled&) {
+		// Not an error of recognition
+		throw;
 	} catch (...) {
 		std::throw_with_nested(runtime_error("Error performing speech recognition via PocketSphinx tools."));
 	}
+}
+
+bool PhoneRecognitionBatch::step() {
+	if (nextTaskIndex == tasks.size()) return false;
 
+	const size_t taskIndex = nextTaskIndex++;
+	try {
+		throwIfCancelled();
+		tasks[taskIndex]();
+	} catch (const OperationCancelled&) {
+		throw;
+	} catch (...) {
+		std::throw_with_nested(runtime_error("Error performing speech recognition via PocketSphinx tools."));
+	}
+	return true;
+}
+
+size_t PhoneRecognitionBatch::getRemainingStepCount() const {
+	return tasks.size() - nextTaskIndex;
+}
+
+vector<BoundedTimeline<Phone>> PhoneRecognitionBatch::finish() {
+	run();
+	costModel.measureRecognition(
+		centiseconds(recognizedSpeechDuration.load()),
+		nanoseconds(recognitionWork.load())
+	);
+
+	for (size_t clipIndex = 0; clipIndex < speakerProfiles.size(); ++clipIndex) {
+		if (!speakerProfiles[clipIndex]) continue;
+
+		vector<CepstralStatistics> utterances;
+		for (size_t jobIndex : clipJobIndexes[clipIndex]) {
+			utterances.push_back(std::move(jobCepstra[jobIndex]));
+		}
+		speakerProfiles[clipIndex]->learn(noiseModels[clipIndex], utterances);
+	}
+
+	// Utterances don't overlap, so in chronological order, their phones are mostly appended.
+	// Phones reaching into the padding before an utterance replace those of the one before.
+	vector<BoundedTimeline<Phone>> phones;
+	for (size_t clipIndex = 0; clipIndex < audioClips.size(); ++clipIndex) {
+		BoundedTimeline<Phone>& clipPhones = phones.emplace_back(audioClips[clipIndex]->getTruncatedRange());
+		size_t phoneCount = 0;
+		for (size_t jobIndex : clipJobIndexes[clipIndex]) {
+			phoneCount += jobPhones[jobIndex].size();
+		}
+		clipPhones.reserve(phoneCount);
+		for (size_t jobIndex : clipJobIndexes[clipIndex]) {
+			for (const auto& timedPhone : jobPhones[jobIndex]) {
+				clipPhones.set(timedPhone);
+			}
+		}
+
+		if (timings) {
+			RecognitionTimings::Clip clipTimings { Timeline<string>(), clipPhones };
+			for (size_t jobIndex : clipJobIndexes[clipIndex]) {
+				for (const auto& timedWord : jobWords[jobIndex]) {
+					clipTimings.words.set(timedWord);
+				}
+			}
+			timings->add(clipIndex, std::move(clipTimings));
+		}
+	}
 	return phones;
 }
 
+static path& sphinxModelDirectory() {
+	static path directory(getBinDirectory() / "res" / "sphinx");
+	return directory;
+}
+
 const path& getSphinxModelDirectory() {
-	static path sphinxModelDirectory(getBinDirectory() / "res" / "sphinx");
-	return sphinxModelDirectory;
+	return sphinxModelDirectory();
+}
+
+void setSphinxModelDirectory(const path& directory) {
+	sphinxModelDirectory() = directory;
+}
+
+bool hasNarrowbandSphinxModel() {
+	static std::mutex mutex;
+	static path cachedDirectory;
+	static bool cachedResult = false;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (cachedDirectory != getSphinxModelDirectory()) {
+		std::error_code error;
+		cachedResult = std::filesystem::exists(getSphinxAcousticModelPath(narrowbandSphinxSampleRate) / "mdef", error);
+		cachedDirectory = getSphinxModelDirectory();
+	}
+	return cachedResult;
+}
+
+int getSphinxSampleRate(int inputSampleRate) {
+	return inputSampleRate < sphinxSampleRate && hasNarrowbandSphinxModel()
+		? narrowbandSphinxSampleRate
+		: sphinxSampleRate;
+}
+
+int getSphinxSampleRate(const vector<RecognitionInput>& inputs) {
+	const bool allNarrowband = !inputs.empty() && std::all_of(inputs.begin(), inputs.end(),
+		[](const RecognitionInput& input) {
+			return getSphinxSampleRate(input.audioClip->getSampleRate()) == narrowbandSphinxSampleRate;
+		});
+	return allNarrowband ? narrowbandSphinxSampleRate : sphinxSampleRate;
+}
+
+path getSphinxAcousticModelPath(int sampleRate) {
+	return getSphinxModelDirectory()
+		/ (sampleRate == narrowbandSphinxSampleRate ? "acoustic-model-8k" : "acoustic-model");
+}
+
+void setSphinxFrontEndSampleRate(cmd_ln_t& config, int sampleRate) {
+	cmd_ln_set_float32_r(&config, "-samprate", static_cast<float>(sampleRate));
+	if (sampleRate == narrowbandSphinxSampleRate) {
+		// The 25.6 ms window spans 205 samples at 8 kHz, so half the default FFT length covers it
+		cmd_ln_set_int32_r(&config, "-nfft", 256);
+	}
+}
+
+int getDecoderSampleRate(const ps_decoder_t& decoder) {
+	return static_cast<int>(cmd_ln_float32_r(decoder.config, "-samprate"));
+}
+
+static LanguageModelVariant& sphinxLanguageModelVariant() {
+	static LanguageModelVariant variant = LanguageModelVariant::Full;
+	return variant;
+}
+
+LanguageModelVariant getSphinxLanguageModelVariant() {
+	return sphinxLanguageModelVariant();
+}
+
+void setSphinxLanguageModelVariant(LanguageModelVariant variant) {
+	sphinxLanguageModelVariant() = variant;
+}
+
+string getSphinxLanguageModelFileName(LanguageModelVariant variant) {
+	switch (variant) {
+		case LanguageModelVariant::Small:
+			return "en-us-small.lm.bin";
+		case LanguageModelVariant::Vocabulary:
+			return vocabularyLanguageModelFileName;
+		default:
+			return "en-us.lm.bin";
+	}
+}
+
+path getSphinxLanguageModelPath() {
+	return getSphinxModelDirectory() / getSphinxLanguageModelFileName(getSphinxLanguageModelVariant());
+}
+
+#if !defined(__EMSCRIPTEN__)
+// Writes a temporary file first, so that concurrent processes never read a partial one
+bool compileSphinxDictionary(const path& textPath, const path& binaryPath) {
+	lambda_unique_ptr<cmd_ln_t> config(
+		cmd_ln_init(nullptr, ps_args(), true, "-dict", textPath.u8string().c_str(), nullptr),
+		[](cmd_ln_t* config) { cmd_ln_free_r(config); });
+	if (!config) return false;
+	// The fillers aren't written, but decoders will have them when building the triphone tables
+	const path acousticModelDirectory = getSphinxModelDirectory() / "acoustic-model";
+	const path fillerPath = acousticModelDirectory / "noisedict";
+	cmd_ln_set_str_extra_r(config.get(), "_fdict",
+		std::filesystem::exists(fillerPath) ? fillerPath.u8string().c_str() : nullptr);
+	const path mdefPath = acousticModelDirectory / "mdef";
+	lambda_unique_ptr<bin_mdef_t> mdef(
+		bin_mdef_read(config.get(), mdefPath.u8string().c_str()),
+		[](bin_mdef_t* mdef) { bin_mdef_free(mdef); });
+	if (!mdef) return false;
+	lambda_unique_ptr<dict_t> dictionary(
+		dict_init(config.get(), mdef.get()),
+		[](dict_t* dictionary) { dict_free(dictionary); });
+	if (!dictionary) return false;
+	// Save the triphone tables, so that decoders copy them instead of building them
+	lambda_unique_ptr<dict2pid_t> dict2pid(
+		dict2pid_build(mdef.get(), dictionary.get()),
+		[](dict2pid_t* dict2pid) { dict2pid_free(dict2pid); });
+	if (!dict2pid) return false;
+	size_t tablesSize = 0;
+	lambda_unique_ptr<void> tables(
+		dict2pid_write_tables(dict2pid.get(), &tablesSize),
+		[](void* tables) { ckd_free(tables); });
+
+	const auto uniqueSuffix = std::chrono::steady_clock::now().time_since_epoch().count();
+	path temporaryPath = binaryPath;
+	temporaryPath += fmt::format(".{}.tmp", uniqueSuffix);
+	if (dict_write_bin(dictionary.get(), tables.get(), tablesSize, temporaryPath.u8string().c_str()) < 0) {
+		std::error_code error;
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, binaryPath, error);
+	if (error) {
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+	return true;
+}
+
+// Writes a temporary file first, like compileSphinxDictionary()
+bool pruneSphinxLanguageModel(const path& inputPath, const path& outputPath, double threshold) {
+	lambda_unique_ptr<logmath_t> lmath(
+		logmath_init(1.0001, 0, 0),
+		[](logmath_t* lmath) { logmath_free(lmath); });
+	if (!lmath) return false;
+	lambda_unique_ptr<ngram_model_t> model(
+		ngram_model_read(nullptr, inputPath.u8string().c_str(), NGRAM_AUTO, lmath.get()),
+		[](ngram_model_t* lm) { ngram_model_free(lm); });
+	if (!model) return false;
+	lambda_unique_ptr<ngram_model_t> prunedModel(
+		ngram_model_trie_prune(model.get(), threshold),
+		[](ngram_model_t* lm) { ngram_model_free(lm); });
+	if (!prunedModel) return false;
+
+	const auto uniqueSuffix = std::chrono::steady_clock::now().time_since_epoch().count();
+	path temporaryPath = outputPath;
+	temporaryPath += fmt::format(".{}.tmp", uniqueSuffix);
+	if (ngram_model_write(prunedModel.get(), temporaryPath.u8string().c_str(), NGRAM_BIN) < 0) {
+		std::error_code error;
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, outputPath, error);
+	if (error) {
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+	return true;
+}
+#endif
+
+path getSphinxDictionaryPath() {
+	const path textPath = getSphinxModelDirectory()
+		/ (getSphinxLanguageModelVariant() == LanguageModelVariant::Vocabulary
+			? vocabularyDictionaryFileName
+			: "cmudict-en-us.dict");
+#if defined(__EMSCRIPTEN__)
+	// The WASM builds ship the compiled dictionary instead of the text
+	path binaryPath = textPath;
+	binaryPath += ".bin";
+	return binaryPath;
+#else
+	static std::mutex mutex;
+	static path cachedTextPath;
+	static path cachedPath;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (cachedTextPath != textPath) {
+		path binaryPath = textPath;
+		binaryPath += ".bin";
+		std::error_code textError, binaryError;
+		const auto textTime = std::filesystem::last_write_time(textPath, textError);
+		const auto binaryTime = std::filesystem::last_write_time(binaryPath, binaryError);
+		const bool upToDate = !textError && !binaryError && binaryTime >= textTime
+			&& dict_bin_compatible(binaryPath.u8string().c_str());
+		if (upToDate || compileSphinxDictionary(textPath, binaryPath)) {
+			cachedPath = binaryPath;
+		} else {
+			logging::warnFormat(
+				"Can't write the compiled dictionary {}. Parsing the text dictionary instead.",
+				binaryPath.u8string()
+			);
+			cachedPath = textPath;
+		}
+		cachedTextPath = textPath;
+	}
+	return cachedPath;
+#endif
+}
+
+std::uintmax_t getSphinxModelSize() {
+	static std::mutex mutex;
+	static path cachedDirectory;
+	static std::uintmax_t cachedSize = 0;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (cachedDirectory != getSphinxModelDirectory()) {
+		std::uintmax_t size = 0;
+		for (const auto& entry : std::filesystem::recursive_directory_iterator(getSphinxModelDirectory())) {
+			if (entry.is_regular_file()) {
+				size += entry.file_size();
+			}
+		}
+		cachedDirectory = getSphinxModelDirectory();
+		cachedSize = size;
+	}
+	return cachedSize;
+}
+
+string stripPronunciationIndex(const string& word) {
+	const size_t size = word.size();
+	const bool hasIndex = size >= 3
+		&& word[size - 3] == '(' && word[size - 2] >= '0' && word[size - 2] <= '9' && word[size - 1] == ')';
+	return hasIndex ? word.substr(0, size - 3) : word;
 }
 
 JoiningTimeline<void> getNoiseSounds(TimeRange utteranceTimeRange, const Timeline<Phone>& phones) {
@@ -195,30 +1321,182 @@ JoiningTimeline<void> getNoiseSounds(TimeRange utteranceTimeRange, const Timelin
 	return noiseSounds;
 }
 
+const vector<optional<Phone>>& getCiPhones(const ps_decoder_t& decoder) {
+	static std::mutex mutex;
+	// Never erased, so references stay valid
+	static std::map<string, vector<optional<Phone>>> ciPhonesByModel;
+
+	const bin_mdef_t& mdef = *decoder.dict->mdef;
+	const char* modelDirectory = cmd_ln_str_r(decoder.config, "-hmm");
+	std::lock_guard<std::mutex> lock(mutex);
+	vector<optional<Phone>>& ciPhones = ciPhonesByModel[modelDirectory ? modelDirectory : ""];
+	if (ciPhones.empty()) {
+		for (int phoneId = 0; phoneId < mdef.n_ciphone; ++phoneId) {
+			const string phoneName = mdef.ciname[phoneId];
+			ciPhones.push_back(phoneName == "SIL"
+				? optional<Phone>()
+				: PhoneConverter::get().parse(phoneName));
+		}
+	}
+	assert(ciPhones.size() == static_cast<size_t>(mdef.n_ciphone));
+	return ciPhones;
+}
+
+Timeline<Phone> spreadWordPhones(const BoundedTimeline<string>& words, const ps_decoder_t& decoder) {
+	const vector<optional<Phone>>& ciPhones = getCiPhones(decoder);
+	dict_t* dictionary = decoder.dict;
+	Timeline<Phone> result;
+	for (const auto& timedWord : words) {
+		const s3wid_t wordId = dict_wordid(dictionary, timedWord.getValue().c_str());
+		if (wordId == BAD_S3WID || !dict_real_word(dictionary, wordId)) continue;
+
+		// Give each phone an equal share of the word, with the first phones taking the remainder
+		const int phoneCount = dict_pronlen(dictionary, wordId);
+		const int64_t duration = timedWord.getDuration().count();
+		centiseconds phoneStart = timedWord.getStart();
+		for (int i = 0; i < phoneCount; ++i) {
+			const centiseconds phoneDuration(duration / phoneCount + (i < duration % phoneCount ? 1 : 0));
+			const optional<Phone>& phone = ciPhones[dict_pron(dictionary, wordId, i)];
+			if (phone && phoneDuration > 0_cs) {
+				result.set(phoneStart, phoneStart + phoneDuration, *phone);
+			}
+			phoneStart += phoneDuration;
+		}
+	}
+	return result;
+}
+
+CepstralFrames::frame_buffer allocateFrames(int32 frameCount, int32 frameSize) {
+	// Allocate at least one frame, so that the buffer is never null
+	return CepstralFrames::frame_buffer(
+		static_cast<mfcc_t**>(ckd_calloc_2d(std::max(frameCount, 1), frameSize, sizeof(mfcc_t))),
+		[](mfcc_t** frames) { ckd_free_2d(frames); });
+}
+
+CepstralFrames::CepstralFrames(gsl::span<const int16_t> audioBuffer, ps_decoder_t& decoder) :
+	frameCount(0),
+	frameSize(fe_get_output_size(decoder.acmod->fe)),
+	timeRange(Timebase(getDecoderSampleRate(decoder)).getTruncatedRange(audioBuffer.size()))
+{
+	// Mirrors acmod_process_full_raw
+	fe_t* frontEnd = decoder.acmod->fe;
+	size_t sampleCount = static_cast<size_t>(audioBuffer.size());
+	int32 maxFrameCount;
+	if (fe_process_frames(frontEnd, nullptr, &sampleCount, nullptr, &maxFrameCount, nullptr) < 0) {
+		throw runtime_error("Error determining cepstral frame count.");
+	}
+	// One additional frame for the remaining samples
+	frames = allocateFrames(maxFrameCount + 1, frameSize);
+
+	fe_start_utt(frontEnd);
+	const int16* nextSample = audioBuffer.data();
+	frameCount = maxFrameCount;
+	if (fe_process_frames(frontEnd, &nextSample, &sampleCount, frames.get(), &frameCount, nullptr) < 0) {
+		throw runtime_error("Error computing cepstral frames.");
+	}
+	int32 tailFrameCount;
+	fe_end_utt(frontEnd, frames.get()[frameCount], &tailFrameCount);
+	frameCount += tailFrameCount;
+}
+
+CepstralFrames::CepstralFrames(const vector<mfcc_t>& frameData, int32 frameSize, TimeRange timeRange) :
+	frames(allocateFrames(static_cast<int32>(frameData.size() / frameSize), frameSize)),
+	frameCount(static_cast<int32>(frameData.size() / frameSize)),
+	frameSize(frameSize),
+	timeRange(timeRange)
+{
+	std::copy_n(frameData.data(), static_cast<size_t>(frameCount) * frameSize, frames.get()[0]);
+}
+
+CepstralFrames::frame_buffer CepstralFrames::copyFrames() const {
+	frame_buffer result = allocateFrames(frameCount, frameSize);
+	std::copy_n(frames.get()[0], static_cast<size_t>(frameCount) * frameSize, result.get()[0]);
+	return result;
+}
+
 BoundedTimeline<string> recognizeWords(const vector<int16_t>& audioBuffer, ps_decoder_t& decoder) {
-	// Restart timing at 0
-	ps_start_stream(&decoder);
+	return recognizeWords(CepstralFrames(audioBuffer, decoder), decoder);
+}
 
-	// Start recognition
-	int error = ps_start_utt(&decoder);
-	if (error) throw runtime_error("Error starting utterance processing for word recognition.");
+// Returns the number of HMMs the decoder's search evaluated during the last utterance
+static int64_t getEvaluatedHmmCount(ps_decoder_t& decoder) {
+	const char* searchType = ps_search_type(decoder.search);
+	if (std::strcmp(searchType, PS_SEARCH_TYPE_NGRAM) == 0) {
+		const auto& searchStats = reinterpret_cast<ngram_search_t*>(decoder.search)->st;
+		return int64_t(searchStats.n_root_chan_eval) + searchStats.n_nonroot_chan_eval
+			+ searchStats.n_last_chan_eval + searchStats.n_fwdflat_chan;
+	}
+	if (std::strcmp(searchType, PS_SEARCH_TYPE_ALLPHONE) == 0) {
+		return reinterpret_cast<allphone_search_t*>(decoder.search)->n_hmm_eval;
+	}
+	return 0;
+}
 
-	// Process entire audio clip
-	const bool noRecognition = false;
-	const bool fullUtterance = true;
-	const int searchedFrameCount =
-		ps_process_raw(&decoder, audioBuffer.data(), audioBuffer.size(), noRecognition, fullUtterance);
-	if (searchedFrameCount < 0) {
-		throw runtime_error("Error analyzing raw audio data for word recognition.");
+// Like ps_process_cep(), checking for cancellation between batches of frames.
+// Returns the number of frames searched, or a negative number on error.
+static int processCepstralFrames(ps_decoder_t& decoder, mfcc_t** frames, int frameCount, bool fullUtterance) {
+	acmod_t* acousticModel = decoder.acmod;
+	int searchedFrameCount = 0;
+	while (frameCount > 0) {
+		// Mid-utterance, the feature ring only holds the lookahead frames on top of a full cepstral
+		// buffer, so pass no more frames at once than acmod_process_raw() would. Otherwise the ring
+		// fills up and the frames the n-gram search lags behind are overwritten.
+		int batchFrameCount = fullUtterance ? frameCount : std::min(frameCount, acousticModel->n_mfc_alloc);
+		const int heldBackFrameCount = frameCount - batchFrameCount;
+		if (acmod_process_cep(acousticModel, &frames, &batchFrameCount, fullUtterance) < 0) return -1;
+		frameCount = heldBackFrameCount + batchFrameCount;
+
+		// Search all features, as ps_search_forward() would
+		while (acousticModel->n_feat_frame > 0) {
+			if (searchedFrameCount % cancellationCheckFrameInterval == 0) {
+				throwIfCancelled();
+			}
+			if (decoder.pl_window > 0
+				&& ps_search_step(decoder.phone_loop, acousticModel->output_frame) < 0)
+			{
+				return -1;
+			}
+			if (acousticModel->output_frame >= decoder.pl_window
+				&& ps_search_step(decoder.search, acousticModel->output_frame - decoder.pl_window) < 0)
+			{
+				return -1;
+			}
+			acmod_advance(acousticModel);
+			++decoder.n_frame;
+			++searchedFrameCount;
+		}
 	}
+	return searchedFrameCount;
+}
 
-	// End recognition
-	error = ps_end_utt(&decoder);
-	if (error) throw runtime_error("Error ending utterance processing for word recognition.");
+// Ends a cancelled utterance without searching its remaining frames, so that the decoder can
+// start the next one
+static void abandonUtterance(ps_decoder_t& decoder) {
+	acmod_t* acousticModel = decoder.acmod;
+	acmod_end_utt(acousticModel);
+	while (acousticModel->n_feat_frame > 0) {
+		acmod_advance(acousticModel);
+	}
+	if (decoder.phone_loop) {
+		ps_search_finish(decoder.phone_loop);
+	}
 
-	BoundedTimeline<string> result(
-		TimeRange(0_cs, centiseconds(100 * audioBuffer.size() / sphinxSampleRate))
-	);
+	// Finishing resets the search for the next utterance. Skip the flat-lexicon pass over the
+	// frames searched so far, whose result would be discarded.
+	ngram_search_t* ngramSearch = std::strcmp(ps_search_type(decoder.search), PS_SEARCH_TYPE_NGRAM) == 0
+		? reinterpret_cast<ngram_search_t*>(decoder.search)
+		: nullptr;
+	const bool skipFlatLexiconPass = ngramSearch && ngramSearch->fwdtree && ngramSearch->fwdflat;
+	if (skipFlatLexiconPass) ngramSearch->fwdflat = false;
+	ps_search_finish(decoder.search);
+	if (skipFlatLexiconPass) ngramSearch->fwdflat = true;
+	ptmr_stop(&decoder.perf);
+}
+
+// Returns the words the decoder recognized in the utterance it just ended, or so far in the one it
+// is processing
+static BoundedTimeline<string> getRecognizedWords(ps_decoder_t& decoder, TimeRange utteranceTimeRange) {
+	BoundedTimeline<string> result(utteranceTimeRange);
 	const bool phonetic = cmd_ln_boolean_r(decoder.config, "-allphone_ci");
 	if (!phonetic) {
 		// If the decoder is in word mode (as opposed to phonetic recognition), it expects each
@@ -243,3 +1521,224 @@ BoundedTimeline<string> recognizeWords(const vector<int16_t>& audioBuffer, ps_de
 
 	return result;
 }
+
+BoundedTimeline<string> recognizeWords(const CepstralFrames& cepstralFrames, ps_decoder_t& decoder) {
+	// Restart timing at 0
+	ps_start_stream(&decoder);
+
+	// Start recognition
+	int error = ps_start_utt(&decoder);
+	if (error) throw runtime_error("Error starting utterance processing for word recognition.");
+
+	// The frame count is known up front, so the backpointer table can be sized once
+	if (std::strcmp(ps_search_type(decoder.search), PS_SEARCH_TYPE_NGRAM) == 0) {
+		ngram_search_reserve(reinterpret_cast<ngram_search_t*>(decoder.search), cepstralFrames.getFrameCount());
+	}
+
+	// Process entire audio clip
+	const CepstralFrames::frame_buffer frames = cepstralFrames.copyFrames();
+	int searchedFrameCount;
+	try {
+		const bool fullUtterance = true;
+		searchedFrameCount = processCepstralFrames(decoder, frames.get(), cepstralFrames.getFrameCount(), fullUtterance);
+	} catch (const OperationCancelled&) {
+		abandonUtterance(decoder);
+		throw;
+	}
+	if (searchedFrameCount < 0) {
+		throw runtime_error("Error analyzing cepstral frames for word recognition.");
+	}
+
+	// End recognition
+	error = ps_end_utt(&decoder);
+	if (error) throw runtime_error("Error ending utterance processing for word recognition.");
+	countEvent(AnalysisCounter::DecodedFrames, searchedFrameCount);
+	countEvent(AnalysisCounter::HmmEvaluations, getEvaluatedHmmCount(decoder));
+
+	return getRecognizedWords(decoder, cepstralFrames.getTimeRange());
+}
+LiveCmnState::LiveCmnState(const ps_decoder_t& decoder) {
+	if (!isLive(decoder)) return;
+
+	const cmn_t& cmn = *decoder.acmod->fcb->cmn_struct;
+	mean.assign(cmn.cmn_mean, cmn.cmn_mean + cmn.veclen);
+	sum.assign(cmn.sum, cmn.sum + cmn.veclen);
+	frameCount = cmn.nframe;
+}
+
+bool LiveCmnState::isLive(const ps_decoder_t& decoder) {
+	const feat_t& features = *decoder.acmod->fcb;
+	return features.cmn == CMN_LIVE && features.cmn_struct;
+}
+
+void LiveCmnState::restore(ps_decoder_t& decoder) const {
+	if (empty() || !isLive(decoder)) return;
+
+	// Unlike cmn_live_set(), this keeps the accumulated frames, which weigh the mean's next update
+	cmn_t& cmn = *decoder.acmod->fcb->cmn_struct;
+	if (mean.size() != static_cast<size_t>(cmn.veclen)) return;
+
+	std::copy(mean.begin(), mean.end(), cmn.cmn_mean);
+	std::copy(sum.begin(), sum.end(), cmn.sum);
+	cmn.nframe = frameCount;
+}
+
+vector<float> LiveCmnState::toFloats() const {
+	if (empty()) return {};
+
+	vector<float> values { static_cast<float>(frameCount) };
+	for (mfcc_t value : mean) {
+		values.push_back(MFCC2FLOAT(value));
+	}
+	for (mfcc_t value : sum) {
+		values.push_back(MFCC2FLOAT(value));
+	}
+	return values;
+}
+
+LiveCmnState LiveCmnState::fromFloats(const vector<float>& values) {
+	LiveCmnState state;
+	if (values.size() < 3 || values.size() % 2 == 0 || !(values[0] >= 0)) return state;
+
+	const size_t length = (values.size() - 1) / 2;
+	for (size_t i = 0; i < length; ++i) {
+		state.mean.push_back(FLOAT2MFCC(values[1 + i]));
+		state.sum.push_back(FLOAT2MFCC(values[1 + length + i]));
+	}
+	state.frameCount = static_cast<int32>(values[0]);
+	return state;
+}
+
+CmnPriorScope::CmnPriorScope(ps_decoder_t& decoder, const SpeakerProfile::State& speaker) :
+	decoder(decoder)
+{
+	const feat_t& features = *decoder.acmod->fcb;
+	isBatch = features.cmn == CMN_BATCH && features.cmn_struct;
+	if (!isBatch) return;
+
+	cmn_t& cmn = *features.cmn_struct;
+	cmn.utt_nframe = 0;
+	if (speaker.cepstralMean.size() != static_cast<size_t>(cmn.veclen)) return;
+
+	for (int i = 0; i < cmn.veclen; ++i) {
+		cmn.prior[i] = FLOAT2MFCC(speaker.cepstralMean[i]);
+	}
+	cmn.prior_nframe = static_cast<int32>(std::min<double>(speaker.cepstralFrameCount, maxPriorFrameCount));
+}
+
+CmnPriorScope::~CmnPriorScope() {
+	if (isBatch) {
+		decoder.acmod->fcb->cmn_struct->prior_nframe = 0;
+	}
+}
+
+CepstralStatistics CmnPriorScope::getUtteranceStatistics() const {
+	CepstralStatistics statistics;
+	if (!isBatch) return statistics;
+
+	const cmn_t& cmn = *decoder.acmod->fcb->cmn_struct;
+	if (cmn.utt_nframe <= 0) return statistics;
+
+	statistics.sum.resize(cmn.veclen);
+	for (int i = 0; i < cmn.veclen; ++i) {
+		statistics.sum[i] = MFCC2FLOAT(cmn.utt_sum[i]);
+	}
+	statistics.frameCount = cmn.utt_nframe;
+	return statistics;
+}
+
+void LiveCmnPrior::apply(ps_decoder_t& decoder) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	state.restore(decoder);
+}
+
+void LiveCmnPrior::update(const ps_decoder_t& decoder) {
+	if (!LiveCmnState::isLive(decoder)) return;
+
+	LiveCmnState newState(decoder);
+	std::lock_guard<std::mutex> lock(mutex);
+	state = std::move(newState);
+}
+
+IncrementalWordRecognition::IncrementalWordRecognition(ps_decoder_t& decoder) :
+	decoder(decoder),
+	timebase(getDecoderSampleRate(decoder)),
+	frameSize(fe_get_output_size(decoder.acmod->fe))
+{
+	// Restart timing at 0
+	ps_start_stream(&decoder);
+
+	// Start recognition, which also starts the front end's utterance
+	const int error = ps_start_utt(&decoder);
+	if (error) throw runtime_error("Error starting utterance processing for word recognition.");
+
+	// Record the codebooks evaluated during word recognition, so that alignment can reuse them
+	acmod_set_cache_mode(decoder.acmod, PS_MGAU_CACHE_RECORD);
+}
+
+IncrementalWordRecognition::~IncrementalWordRecognition() {
+	if (finished) return;
+
+	abandonUtterance(decoder);
+	acmod_set_cache_mode(decoder.acmod, PS_MGAU_CACHE_OFF);
+}
+
+void IncrementalWordRecognition::addSamples(gsl::span<const int16_t> samples) {
+	// Samples that don't complete a frame are kept by the front end until the next call
+	fe_t* frontEnd = decoder.acmod->fe;
+	size_t remainingSampleCount = static_cast<size_t>(samples.size());
+	int32 maxFrameCount;
+	if (fe_process_frames(frontEnd, nullptr, &remainingSampleCount, nullptr, &maxFrameCount, nullptr) < 0) {
+		throw runtime_error("Error determining cepstral frame count.");
+	}
+	const CepstralFrames::frame_buffer frames = allocateFrames(maxFrameCount, frameSize);
+	const int16* nextSample = samples.data();
+	int32 frameCount = maxFrameCount;
+	if (fe_process_frames(frontEnd, &nextSample, &remainingSampleCount, frames.get(), &frameCount, nullptr) < 0) {
+		throw runtime_error("Error computing cepstral frames.");
+	}
+	sampleCount += samples.size();
+
+	searchFrames(frames, frameCount);
+}
+
+RecognizedUtterance IncrementalWordRecognition::finish() {
+	// Compute the frame of the remaining samples
+	const CepstralFrames::frame_buffer tailFrames = allocateFrames(1, frameSize);
+	int32 tailFrameCount;
+	fe_end_utt(decoder.acmod->fe, tailFrames.get()[0], &tailFrameCount);
+	searchFrames(tailFrames, tailFrameCount);
+
+	// End recognition
+	finished = true;
+	const int error = ps_end_utt(&decoder);
+	if (error) throw runtime_error("Error ending utterance processing for word recognition.");
+	countEvent(AnalysisCounter::DecodedFrames, searchedFrameCount);
+	countEvent(AnalysisCounter::HmmEvaluations, getEvaluatedHmmCount(decoder));
+
+	const TimeRange timeRange = timebase.getTruncatedRange(static_cast<int64_t>(sampleCount));
+	return RecognizedUtterance {
+		CepstralFrames(frameData, frameSize, timeRange),
+		getRecognizedWords(decoder, timeRange)
+	};
+}
+
+BoundedTimeline<string> IncrementalWordRecognition::getPartialWords() {
+	// Mid-utterance, the decoder traces back from the best word exit of the last searched frame
+	return getRecognizedWords(decoder, TimeRange(0_cs, centiseconds(searchedFrameCount)));
+}
+
+void IncrementalWordRecognition::searchFrames(const CepstralFrames::frame_buffer& frames, int32 frameCount) {
+	if (frameCount <= 0) return;
+
+	const bool fullUtterance = false;
+	const int count = processCepstralFrames(decoder, frames.get(), frameCount, fullUtterance);
+	if (count < 0) {
+		throw runtime_error("Error analyzing cepstral frames for word recognition.");
+	}
+	searchedFrameCount += count;
+
+	// The acoustic model has normalized the frames in place
+	const mfcc_t* firstValue = frames.get()[0];
+	frameData.insert(frameData.end(), firstValue, firstValue + static_cast<size_t>(frameCount) * frameSize);
+}
@@ -4,39 +4,640 @@
 #include "core/Phone.h"
 #include "audio/AudioClip.h"
 #include "tools/progress.h"
+#include "tools/ObjectPool.h"
+#include "tools/LruCache.h"
+#include "recognition/Recognizer.h"
+#include "recognition/SpeakerProfile.h"
+#include "recognition/RecognitionTimings.h"
+#include <span.h>
 #include <filesystem>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <map>
 
 extern "C" {
 #include <pocketsphinx.h>
 }
 
-typedef std::function<lambda_unique_ptr<ps_decoder_t>(
-	boost::optional<std::string> dialog
-)> decoderFactory;
+// A pool of decoders sharing the same configuration.
+// Decoders are returned to the pool after use, so they survive across recognition calls.
+using DecoderPool = ObjectPool<ps_decoder_t, lambda_unique_ptr<ps_decoder_t>>;
 
+// Takes a decoder from the pool, counting in the current stats whether it was reused.
+// The decoder is compacted (see compactDecoder()) as it returns to the pool.
+DecoderPool::wrapper_type acquireDecoder(DecoderPool& decoderPool);
+
+// Decoders keep the buffers that grow with an utterance's length (features, codebook cache,
+// backpointer tables, word graphs) from one utterance to the next. Those sized for more than this
+// many frames are shrunk back to their initial sizes once the utterance is done, so that a rare long
+// utterance doesn't leave every pooled decoder it passed through at its size.
+constexpr int decoderCompactionFrameCount = 1000;
+
+// Shrinks the buffers of a decoder sized for more than decoderCompactionFrameCount frames. Does
+// nothing during an utterance.
+void compactDecoder(ps_decoder_t& decoder);
+
+// Creates decoders until the pool holds decoderCount of them
+void prewarmDecoders(DecoderPool& decoderPool, int decoderCount);
+
+// Creates a decoder with the given configuration, counted by getDecoderCount() while it exists.
+// Decoders of the same acoustic model directory share its read-only parameters.
+lambda_unique_ptr<ps_decoder_t> initDecoder(cmd_ln_t& config);
+
+// The number of decoders in existence, in use or pooled
+int getDecoderCount();
+
+// Measures the heap memory taken by creating decoders, to predict the cost of creating more.
+// Measurements overlap if decoders are created concurrently, so they are approximate.
+class DecoderMemoryEstimate {
+public:
+	// Uses the default until a decoder has been measured
+	explicit DecoderMemoryEstimate(size_t defaultDecoderSize);
+
+	// Creates a decoder, measuring the heap memory it takes
+	lambda_unique_ptr<ps_decoder_t> measure(const std::function<lambda_unique_ptr<ps_decoder_t>()>& createDecoder);
+
+	// The heap memory needed to create the decoders missing from the pool for recognizing with up
+	// to maxThreadCount threads
+	size_t getMissingDecoderSize(const DecoderPool& decoderPool, int maxThreadCount) const;
+
+private:
+	std::atomic<size_t> decoderSize;
+};
+
+// Learns how long the stages of recognition take on this device, so that their progress is weighted
+// by their expected cost and the duration of a recognition can be estimated before it starts.
+// Costs are the work of all threads, in milliseconds per second of audio.
+class RecognitionCostModel {
+public:
+	// Uses the defaults until the stages have been measured
+	RecognitionCostModel(double defaultVadCost, double defaultRecognitionCost);
+
+	// The typical cost of voice activity detection on a desktop CPU, which doesn't depend on the
+	// recognizer. Recognition costs hundreds of times more.
+	static constexpr double defaultVadCost = 0.3;
+
+	// The expected work of voice activity detection on audio of the given duration
+	double estimateVadCost(centiseconds audioDuration) const;
+
+	// The expected work of recognizing utterances of the given total duration
+	double estimateRecognitionCost(centiseconds speechDuration) const;
+
+	// The expected work of recognizing the speech in audio of the given duration, before it is known
+	// how much of it is speech
+	double estimateRecognitionCostOfAudio(centiseconds audioDuration) const;
+
+	// Estimates how long recognizing a clip of the given duration takes on up to maxThreadCount threads
+	std::chrono::milliseconds estimateDuration(centiseconds audioDuration, int maxThreadCount) const;
+
+	// Adds the measurement of voice activity detection finding speechDuration of utterances in audio
+	// of audioDuration
+	void measureVad(centiseconds audioDuration, centiseconds speechDuration, std::chrono::nanoseconds work);
+
+	// Adds the measurement of recognizing utterances of the given total duration
+	void measureRecognition(centiseconds speechDuration, std::chrono::nanoseconds work);
+
+private:
+	RateEstimate vadCost;
+	RateEstimate recognitionCost;
+	// Seconds of speech per second of audio
+	RateEstimate speechShare;
+};
+
+// Prepares a pooled decoder for the current recognition call, e.g. by selecting the language model
+// for the specified dialog. Called before a decoder's first utterance of a call, and again whenever
+// its next utterance has a different dialog.
+typedef std::function<void(
+	ps_decoder_t& decoder,
+	const boost::optional<std::string>& dialog
+)> decoderPreparer;
+
+// Recognizers decode each utterance with this much of the surrounding audio, within the clip
+constexpr centiseconds utterancePadding = 3_cs;
+
+TimeRange getPaddedUtteranceRange(TimeRange utteranceTimeRange, const AudioClip& audioClip);
+
+// Phones recognized in earlier utterances, keyed by a hash of the utterance's padded samples and
+// the dialog. Re-analyses of edited audio then only decode the utterances whose audio changed,
+// including utterances that merely moved by whole centiseconds.
+class UtterancePhoneCache {
+public:
+	// The number of utterances kept; each takes about a kilobyte
+	static constexpr size_t capacity = 1024;
+
+	UtterancePhoneCache();
+
+	// Returns the key of an utterance of a clip at its recognition rate (see getSphinxSampleRate())
+	static uint64_t getKey(
+		const AudioClip& audioClip,
+		TimeRange utteranceTimeRange,
+		const boost::optional<std::string>& dialog
+	);
+
+	// The phones of an utterance and the words reported with them (see reportUtteranceWords())
+	struct Utterance {
+		Timeline<Phone> phones;
+		Timeline<std::string> words;
+	};
+
+	// Returns the utterance stored for the key, moved to the utterance's start
+	boost::optional<Utterance> get(uint64_t key, centiseconds utteranceStart);
+
+	void set(uint64_t key, centiseconds utteranceStart, const Utterance& utterance);
+
+private:
+	struct Entry {
+		centiseconds utteranceStart;
+		Utterance utterance;
+	};
+
+	LruCache<uint64_t, std::shared_ptr<const Entry>> entries;
+};
+
+// Whether recognition reuses the phones of utterances recognized before (default: true).
+// Benchmarks turn it off, so that repeated runs recognize every utterance.
+bool isUtterancePhoneCacheEnabled();
+void setUtterancePhoneCacheEnabled(bool enabled);
+
+// Reports the words recognized in the utterance the current thread is recognizing, with their times
+// in the clip, so that PhoneRecognitionBatch can return them with its phones (see
+// RecognitionTimings). Does nothing outside an utterance of a PhoneRecognitionBatch.
+void reportUtteranceWords(const Timeline<std::string>& words);
+
+struct RecognizedUtterance;
+
+// Recognizes the phones of an utterance. If the words spoken in it are given, they may be aligned
+// without recognizing words. If the utterance has been recognized incrementally while it was
+// spoken, recognizedUtterance holds the result; recognizers that can't use it recognize the
+// utterance as usual.
 typedef std::function<Timeline<Phone>(
 	const AudioClip& audioClip,
 	TimeRange utteranceTimeRange,
+	const boost::optional<std::vector<std::string>>& utteranceWords,
+	const RecognizedUtterance* recognizedUtterance,
 	ps_decoder_t& decoder,
 	ProgressSink& utteranceProgressSink
 )> utteranceToPhonesFunction;
 
+// Distributes the words of a clip's dialog over its utterances, given in chronological order, with
+// a decoder that may hold another dialog. Returns the words of each utterance, or nothing to have the
+// utterances' words recognized.
+typedef std::function<std::vector<std::vector<std::string>>(
+	ps_decoder_t& decoder,
+	const std::string& dialog,
+	const std::vector<TimeRange>& utteranceTimeRanges
+)> dialogDistributor;
+
+// Utterances found in the phone cache aren't decoded again.
+// Progress is weighted by the cost model, which learns from the stages as they are measured.
+// If distributeDialog is set, it is called for every clip with a dialog before its utterances are
+// recognized. If phonesSink is set, it receives the phones as they are recognized.
 BoundedTimeline<Phone> recognizePhones(
 	const AudioClip& inputAudioClip,
 	boost::optional<std::string> dialog,
-	decoderFactory createDecoder,
+	SpeakerProfile* speakerProfile,
+	DecoderPool& decoderPool,
+	UtterancePhoneCache& utterancePhoneCache,
+	RecognitionCostModel& costModel,
+	decoderPreparer prepareDecoder,
 	utteranceToPhonesFunction utteranceToPhones,
 	int maxThreadCount,
-	ProgressSink& progressSink
+	ProgressSink& progressSink,
+	dialogDistributor distributeDialog = nullptr,
+	RecognizedPhonesSink phonesSink = nullptr
 );
 
+// Recognizes many clips at once, returning one phone timeline per input.
+// The utterances of all clips are scheduled on one work queue, grouped by dialog.
+std::vector<BoundedTimeline<Phone>> recognizePhonesBatch(
+	const std::vector<RecognitionInput>& inputs,
+	DecoderPool& decoderPool,
+	UtterancePhoneCache& utterancePhoneCache,
+	RecognitionCostModel& costModel,
+	decoderPreparer prepareDecoder,
+	utteranceToPhonesFunction utteranceToPhones,
+	int maxThreadCount,
+	ProgressSink& progressSink,
+	dialogDistributor distributeDialog = nullptr
+);
+
+// The recognition of recognizePhonesBatch(), which can also be stepped through an utterance at a
+// time on the calling thread.
+// The constructor detects the utterances and plans their recognition. The clips, the pool, the
+// caches and the progress sink must outlive the batch.
+class PhoneRecognitionBatch : public SteppedRecognition {
+public:
+	PhoneRecognitionBatch(
+		const std::vector<RecognitionInput>& inputs,
+		DecoderPool& decoderPool,
+		UtterancePhoneCache& utterancePhoneCache,
+		RecognitionCostModel& costModel,
+		decoderPreparer prepareDecoder,
+		utteranceToPhonesFunction utteranceToPhones,
+		int maxThreadCount,
+		ProgressSink& progressSink,
+		dialogDistributor distributeDialog = nullptr
+	);
+	~PhoneRecognitionBatch() override;
+	PhoneRecognitionBatch(const PhoneRecognitionBatch&) = delete;
+	PhoneRecognitionBatch& operator=(const PhoneRecognitionBatch&) = delete;
+
+	// Passes the phones of each clip to the sink as soon as an utterance and all before it are
+	// recognized; see RecognizedPhonesSink. Set before recognizing any utterances.
+	void setPhonesSink(std::function<void(size_t clipIndex, const Timeline<Phone>& phones, centiseconds knownEnd)> sink);
+
+	// Recognizes the remaining utterances with up to maxThreadCount threads
+	void run();
+
+	bool step() override;
+	size_t getRemainingStepCount() const override;
+	std::vector<BoundedTimeline<Phone>> finish() override;
+
+private:
+	struct UtteranceJob {
+		size_t clipIndex;
+		size_t dialogIndex;
+		Timed<void> utterance;
+		// The dialog's words spoken in the utterance, if distributed
+		boost::optional<std::vector<std::string>> words;
+	};
+
+	void recognizeUtterance(const UtteranceJob& job, ProgressSink& utteranceProgressSink);
+	// Stores the phones of a job in its slot and passes them on to the phones sink, if any, once
+	// the earlier jobs of the clip have been
+	void addUtterancePhones(const UtteranceJob& job, UtterancePhoneCache::Utterance utterance);
+
+	DecoderPool& decoderPool;
+	UtterancePhoneCache& utterancePhoneCache;
+	RecognitionCostModel& costModel;
+	decoderPreparer prepareDecoder;
+	utteranceToPhonesFunction utteranceToPhones;
+	ProgressMerger totalProgressMerger;
+	std::unique_ptr<ProgressMerger> recognitionProgressMerger;
+	const bool useUtterancePhoneCache;
+
+	// The clips at their rates of getSphinxSampleRate(); the decoders resample utterances of another
+	// rate to theirs
+	std::vector<std::unique_ptr<AudioClip>> audioClips;
+	// For clips with a speaker profile: its state before the batch, the noise model voice activity
+	// detection adapted to the clip, and the cepstral statistics of each job, to learn once the
+	// batch completes
+	std::vector<SpeakerProfile*> speakerProfiles;
+	std::vector<SpeakerProfile::State> speakerStates;
+	std::vector<VadNoiseModel> noiseModels;
+	std::vector<CepstralStatistics> jobCepstra;
+	std::vector<boost::optional<std::string>> dialogs;
+	std::vector<UtteranceJob> jobs;
+	int threadCount = 1;
+
+	// Decoders come from a pool that outlives the batch, so each one has to be prepared for the
+	// dialog of its next utterance unless it already is
+	std::map<ps_decoder_t*, size_t> decoderDialogIndexes;
+	std::mutex decoderDialogIndexesMutex;
+
+	// The phones of each job. Every slot is only written by its job's task, so the tasks don't wait
+	// for each other; finish() merges the slots of each clip in chronological order.
+	std::vector<Timeline<Phone>> jobPhones;
+	std::vector<Timeline<std::string>> jobWords;
+	// Where finish() adds the clips' timings, if the batch was created within a
+	// RecognitionTimingsScope
+	RecognitionTimings* timings;
+	// The indexes of each clip's jobs in chronological order
+	std::vector<std::vector<size_t>> clipJobIndexes;
+
+	// For the phones sink: which jobs have been recognized, and how many of each clip's jobs have
+	// been passed on
+	std::function<void(size_t, const Timeline<Phone>&, centiseconds)> phonesSink;
+	std::mutex phonesSinkMutex;
+	std::vector<char> recognizedJobs;
+	std::vector<size_t> passedJobCounts;
+
+	// The work of recognizing the utterances missing from the cache, and their duration
+	std::atomic<int64_t> recognitionWork { 0 };
+	std::atomic<int64_t> recognizedSpeechDuration { 0 };
+
+	// One task per job
+	std::vector<std::function<void()>> tasks;
+	size_t nextTaskIndex = 0;
+};
+
+// A snapshot of a decoder's live cepstral mean normalization (-cmn live), which estimates the mean
+// from the frames seen so far instead of from the whole utterance, carrying it from one utterance
+// to the next. Empty for decoders normalizing otherwise.
+class LiveCmnState {
+public:
+	LiveCmnState() = default;
+	explicit LiveCmnState(const ps_decoder_t& decoder);
+
+	static bool isLive(const ps_decoder_t& decoder);
+
+	bool empty() const { return mean.empty(); }
+
+	// Continues the decoder's normalization from this state. Does nothing if the state is empty or
+	// of another feature length.
+	void restore(ps_decoder_t& decoder) const;
+
+	// The frame count, then the mean and the sum
+	std::vector<float> toFloats() const;
+	// Reads the values of toFloats(). Returns an empty state if they don't form one.
+	static LiveCmnState fromFloats(const std::vector<float>& values);
+
+private:
+	std::vector<mfcc_t> mean;
+	std::vector<mfcc_t> sum;
+	int32 frameCount = 0;
+};
+
+class IncrementalWordRecognition;
+
+// Recognizes utterances one at a time with decoders borrowed from a pool.
+// A decoder is only held while an utterance is recognized or still being spoken, so that many
+// recognizers share a few decoders: their number follows the speech being recognized at once, not
+// the number of recognizers. Each recognizer carries its live CMN state from one decoder to the
+// next. If the decoders normalize with live CMN and search for words, utterances passed to
+// continueUtterance() are recognized while they are spoken, so that only their alignment remains
+// once they end.
+class DecoderUtteranceRecognizer : public UtteranceRecognizer {
+public:
+	// prepareDecoder may be empty if the decoders need no preparation
+	DecoderUtteranceRecognizer(
+		DecoderPool& decoderPool,
+		decoderPreparer prepareDecoder,
+		boost::optional<std::string> dialog,
+		utteranceToPhonesFunction utteranceToPhones
+	);
+	~DecoderUtteranceRecognizer() override;
+
+	Timeline<Phone> recognizeUtterance(
+		const AudioClip& audioClip,
+		TimeRange utteranceTimeRange,
+		ProgressSink& progressSink
+	) override;
+
+	void continueUtterance(const AudioClip& audioClip, TimeRange utteranceTimeRange) override;
+
+	void discardUtterance() override;
+
+	Timeline<Phone> getTentativePhones() override;
+
+	// The live CMN state before the open utterance, if any
+	std::vector<float> getCarriedState() const override;
+	void setCarriedState(const std::vector<float>& state) override;
+
+private:
+	// Feeds the recognition of the open utterance the audio of the clip up to the given time
+	void feedOpenUtterance(const AudioClip& audioClip, centiseconds end);
+	// Takes a decoder from the pool, prepared for the dialog, unless one is held already
+	void borrowDecoder();
+	// Returns the decoder to the pool, keeping its live CMN state for the next one
+	void returnDecoder();
+
+	DecoderPool& decoderPool;
+	decoderPreparer prepareDecoder;
+	boost::optional<std::string> dialog;
+	utteranceToPhonesFunction utteranceToPhones;
+	bool incremental = false;
+	// Held while an utterance is recognized or open
+	DecoderPool::wrapper_type decoder;
+	LiveCmnState cmnState;
+
+	// The utterance being recognized incrementally, if any
+	std::unique_ptr<IncrementalWordRecognition> openUtterance;
+	centiseconds openUtteranceStart = 0_cs;
+	// The padded start of the open utterance, and the end of the audio fed so far
+	centiseconds fedStart = 0_cs;
+	centiseconds fedEnd = 0_cs;
+	// The tentative phones of the open utterance, and the number of frames searched when they were
+	// guessed
+	Timeline<Phone> tentativePhones;
+	int tentativeFrameCount = 0;
+};
+
+// The rate of the wideband acoustic model (acoustic-model), and that of the narrowband one
+// (acoustic-model-8k) a model directory may have for telephone audio
 constexpr int sphinxSampleRate = 16000;
+constexpr Timebase sphinxTimebase(sphinxSampleRate);
+constexpr int narrowbandSphinxSampleRate = 8000;
+
+// Recognition checks for cancellation every so many frames (1 s of audio)
+constexpr int cancellationCheckFrameInterval = 100;
+
+// Sends PocketSphinx's output to our log. Call before using a decoder.
+void redirectPocketSphinxOutput();
 
 const std::filesystem::path& getSphinxModelDirectory();
 
+// Overrides the model directory, which defaults to res/sphinx next to the binary.
+// Must be called before the first recognizer is created.
+void setSphinxModelDirectory(const std::filesystem::path& directory);
+
+// Whether the model directory has a narrowband acoustic model in acoustic-model-8k, such as
+// CMUSphinx's en-us-ptm-8khz, with a feat.params for its front end
+bool hasNarrowbandSphinxModel();
+
+// The rate at which the decoder-based recognizers recognize audio of the given sample rate: the
+// narrowband one if the audio is sampled below sphinxSampleRate and the model directory has a
+// narrowband model, so that it isn't upsampled and each frame takes half the samples; otherwise
+// sphinxSampleRate
+int getSphinxSampleRate(int inputSampleRate);
+
+// The rate at which to recognize a batch of clips, which share their decoders: the narrowband one
+// only if getSphinxSampleRate() gives it for every clip. Narrowband clips of mixed batches are
+// upsampled.
+int getSphinxSampleRate(const std::vector<RecognitionInput>& inputs);
+
+// The acoustic model directory for recognizing at a rate of getSphinxSampleRate()
+std::filesystem::path getSphinxAcousticModelPath(int sampleRate);
+
+// Sets the sample rate of a decoder configuration's front end, along with an FFT length that fits
+// its frames. The acoustic model's feat.params, which decoders read on creation, takes precedence.
+void setSphinxFrontEndSampleRate(cmd_ln_t& config, int sampleRate);
+
+// The sample rate of a decoder's front end, at which it expects the samples of utterances
+int getDecoderSampleRate(const ps_decoder_t& decoder);
+
+// The variants of the word language model
+enum class LanguageModelVariant {
+	// en-us.lm.bin, as distributed with PocketSphinx
+	Full,
+	// en-us-small.lm.bin, generated from the full model at build time by dropping the n-grams that
+	// contribute least. About a quarter of the full model's size and memory, for
+	// memory-constrained clients, at some loss of recognition accuracy.
+	Small,
+	// A vocabulary pack: vocabulary.lm.bin, generated for a project's dialog lines by
+	// createSphinxVocabularyPack(), along with the dictionary vocabulary.dict, which replaces
+	// the full dictionary. Both are a fraction of the size of the full ones.
+	Vocabulary
+};
+
+// The files of a vocabulary pack in the model directory
+constexpr const char* vocabularyLanguageModelFileName = "vocabulary.lm.bin";
+constexpr const char* vocabularyDictionaryFileName = "vocabulary.dict";
+
+LanguageModelVariant getSphinxLanguageModelVariant();
+
+// Selects the language model of the pocketSphinx recognizer. Takes effect for decoders created
+// afterwards; recognizers keep separate decoders per variant.
+void setSphinxLanguageModelVariant(LanguageModelVariant variant);
+
+// The file name of a language model variant in the model directory
+std::string getSphinxLanguageModelFileName(LanguageModelVariant variant);
+
+// The file of the selected language model in the model directory
+std::filesystem::path getSphinxLanguageModelPath();
+
+// The pronunciation dictionary for decoders' -dict option: the full one, or that of the vocabulary
+// pack if it is selected.
+// Native builds use a binary dictionary next to the text one (cmudict-en-us.dict.bin), which the
+// build generates and which is recompiled if it's outdated or of another format version. Decoders
+// map it into memory instead of parsing, so its pages are shared across decoders and processes, and
+// look words up with its perfect hash index instead of building a hash table. Falls back to the
+// text dictionary if the compiled one can't be written. WASM builds always use the compiled
+// dictionary, which they ship as the 'dictionary' asset.
+std::filesystem::path getSphinxDictionaryPath();
+
+#if !defined(__EMSCRIPTEN__)
+// Compiles a text dictionary for the phones of the model directory's acoustic model into a binary
+// one, along with the triphone tables that decoders would otherwise build from it. Returns false
+// if that fails.
+bool compileSphinxDictionary(const std::filesystem::path& textPath, const std::filesystem::path& binaryPath);
+
+// Writes a pruned copy of a trie language model, without the n-grams whose removal changes the
+// model by less than the threshold (see ngram_model_trie_prune()). Returns false if that fails.
+bool pruneSphinxLanguageModel(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath, double threshold);
+#endif
+
+// The total size of the files in the model directory
+std::uintmax_t getSphinxModelSize();
+
+// Removes the index that the dictionary appends to alternative pronunciations, as in "read(2)"
+std::string stripPronunciationIndex(const std::string& word);
+
 JoiningTimeline<void> getNoiseSounds(TimeRange utteranceTimeRange, const Timeline<Phone>& phones);
 
+// Returns the phone for each context-independent phone ID of the decoder's acoustic model, or none
+// for silence. The table is built once per acoustic model directory.
+const std::vector<boost::optional<Phone>>& getCiPhones(const ps_decoder_t& decoder);
+
+// Guesses the phones of recognized words by spreading each word's pronunciation evenly over its
+// time range, as a stand-in until they are aligned. Fillers such as silence are skipped.
+Timeline<Phone> spreadWordPhones(const BoundedTimeline<std::string>& words, const ps_decoder_t& decoder);
+
+// The cepstral (MFCC) frames of an utterance, as computed by a decoder's front end.
+// Computing them once lets word recognition and alignment share the front-end work.
+class CepstralFrames {
+public:
+	using frame_buffer = lambda_unique_ptr<mfcc_t*>;
+
+	CepstralFrames(gsl::span<const int16_t> audioBuffer, ps_decoder_t& decoder);
+
+	// Takes frames that have already been computed, stored one after another
+	CepstralFrames(const std::vector<mfcc_t>& frameData, int32 frameSize, TimeRange timeRange);
+
+	int32 getFrameCount() const { return frameCount; }
+	TimeRange getTimeRange() const { return timeRange; }
+
+	// Returns a copy of the frames.
+	// The acoustic model normalizes the frames it processes in place, so every pass needs its own copy.
+	frame_buffer copyFrames() const;
+
+private:
+	frame_buffer frames;
+	int32 frameCount;
+	int32 frameSize;
+	TimeRange timeRange;
+};
+
+BoundedTimeline<std::string> recognizeWords(
+	const CepstralFrames& cepstralFrames,
+	ps_decoder_t& decoder
+);
+
 BoundedTimeline<std::string> recognizeWords(
 	const std::vector<int16_t>& audioBuffer,
 	ps_decoder_t& decoder
 );
+
+// The live CMN state after the last utterance recognized with a decoder configuration. Decoders
+// starting a recognition call or stream begin from it, so that their first frames are normalized
+// with a mean estimated from earlier speech rather than the acoustic model's -cmninit or the last
+// speaker this particular decoder heard.
+class LiveCmnPrior {
+public:
+	// Does nothing if the decoder doesn't use live CMN or no utterance has been recognized yet
+	void apply(ps_decoder_t& decoder) const;
+
+	// Does nothing if the decoder doesn't use live CMN
+	void update(const ps_decoder_t& decoder);
+
+private:
+	mutable std::mutex mutex;
+	LiveCmnState state;
+};
+
+// Blends a speaker's cepstral mean into the batch cepstral mean normalization (-cmn batch) of a
+// decoder's utterances while it exists, so that short utterances are normalized with a stable mean.
+// Does nothing for decoders normalizing otherwise, or if the speaker has no mean yet.
+class CmnPriorScope {
+public:
+	// The mean weighs as at most this many frames, so that longer utterances are mostly normalized
+	// with their own
+	static constexpr int maxPriorFrameCount = 100;
+
+	CmnPriorScope(ps_decoder_t& decoder, const SpeakerProfile::State& speaker);
+	CmnPriorScope(const CmnPriorScope&) = delete;
+	CmnPriorScope& operator=(const CmnPriorScope&) = delete;
+	~CmnPriorScope();
+
+	// The statistics of the last utterance normalized, before blending. Empty if there was none.
+	CepstralStatistics getUtteranceStatistics() const;
+
+private:
+	ps_decoder_t& decoder;
+	bool isBatch;
+};
+
+// An utterance whose words were recognized while it was spoken
+struct RecognizedUtterance {
+	// Already normalized, as word recognition normalized them. The mean changes while the
+	// utterance is recognized, so normalizing them again couldn't reproduce that.
+	CepstralFrames normalizedFrames;
+	BoundedTimeline<std::string> words;
+};
+
+// Recognizes the words of an utterance from audio that arrives while it is spoken.
+// Frames can only be normalized before the utterance ends with live CMN.
+class IncrementalWordRecognition {
+public:
+	explicit IncrementalWordRecognition(ps_decoder_t& decoder);
+	IncrementalWordRecognition(const IncrementalWordRecognition&) = delete;
+	IncrementalWordRecognition& operator=(const IncrementalWordRecognition&) = delete;
+
+	// Abandons the utterance unless it has been finished
+	~IncrementalWordRecognition();
+
+	// Searches the frames completed by 16-bit samples at the decoder's sample rate
+	void addSamples(gsl::span<const int16_t> samples);
+
+	// Ends the utterance, searching its remaining frames
+	RecognizedUtterance finish();
+
+	// The words recognized so far. The last one may still be incomplete, or turn out to be another
+	// word once more audio is searched.
+	BoundedTimeline<std::string> getPartialWords();
+
+	int getSearchedFrameCount() const { return searchedFrameCount; }
+
+private:
+	// Searches computed frames, keeping them for alignment once they are normalized
+	void searchFrames(const CepstralFrames::frame_buffer& frames, int32 frameCount);
+
+	ps_decoder_t& decoder;
+	Timebase timebase;
+	int32 frameSize;
+	std::vector<mfcc_t> frameData;
+	int64_t sampleCount = 0;
+	int searchedFrameCount = 0;
+	bool finished = false;
+};
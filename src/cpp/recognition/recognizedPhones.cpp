@@ -0,0 +1,105 @@
+#include "recognizedPhones.h"
+#include <format.h>
+#include <stdexcept>
+
+using std::vector;
+using std::runtime_error;
+
+namespace {
+
+	// "LSPH", then the format version
+	constexpr uint32_t magic = 0x48504C53;
+	constexpr uint32_t version = 1;
+
+	// Start, end and phone
+	constexpr int phoneSize = 9;
+
+	void writeUInt(vector<uint8_t>& bytes, uint32_t value, int byteCount = 4) {
+		for (int i = 0; i < byteCount; ++i) {
+			bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+		}
+	}
+
+	class PhoneReader {
+	public:
+		explicit PhoneReader(gsl::span<const uint8_t> bytes) : bytes(bytes) {}
+
+		uint32_t readUInt(int byteCount = 4) {
+			if (offset + byteCount > bytes.size()) {
+				throw runtime_error("Recognized phones are truncated.");
+			}
+			uint32_t value = 0;
+			for (int i = 0; i < byteCount; ++i) {
+				value |= static_cast<uint32_t>(bytes[offset++]) << (8 * i);
+			}
+			return value;
+		}
+
+		centiseconds readTime() {
+			return centiseconds(static_cast<int32_t>(readUInt()));
+		}
+
+		size_t getRemainingByteCount() const {
+			return static_cast<size_t>(bytes.size() - offset);
+		}
+
+	private:
+		gsl::span<const uint8_t> bytes;
+		std::ptrdiff_t offset = 0;
+	};
+
+}
+
+vector<uint8_t> serializePhones(const BoundedTimeline<Phone>& phones) {
+	vector<uint8_t> bytes;
+	bytes.reserve(20 + phones.size() * phoneSize);
+	writeUInt(bytes, magic);
+	writeUInt(bytes, version);
+	writeUInt(bytes, static_cast<uint32_t>(phones.getRange().getStart().count()));
+	writeUInt(bytes, static_cast<uint32_t>(phones.getRange().getEnd().count()));
+	writeUInt(bytes, static_cast<uint32_t>(phones.size()));
+	for (const Timed<Phone>& timedPhone : phones) {
+		writeUInt(bytes, static_cast<uint32_t>(timedPhone.getStart().count()));
+		writeUInt(bytes, static_cast<uint32_t>(timedPhone.getEnd().count()));
+		writeUInt(bytes, static_cast<uint32_t>(timedPhone.getValue()), 1);
+	}
+	return bytes;
+}
+
+BoundedTimeline<Phone> deserializePhones(gsl::span<const uint8_t> bytes) {
+	PhoneReader reader(bytes);
+	if (reader.readUInt() != magic) {
+		throw runtime_error("Not recognized phones.");
+	}
+	const uint32_t phonesVersion = reader.readUInt();
+	if (phonesVersion != version) {
+		throw runtime_error(fmt::format("Unsupported recognized phones version {}.", phonesVersion));
+	}
+
+	const centiseconds rangeStart = reader.readTime();
+	const centiseconds rangeEnd = reader.readTime();
+	if (rangeEnd < rangeStart) {
+		throw runtime_error("Recognized phones have an invalid time range.");
+	}
+	const size_t count = reader.readUInt();
+	if (count > reader.getRemainingByteCount() / phoneSize) {
+		throw runtime_error("Recognized phones are truncated.");
+	}
+
+	BoundedTimeline<Phone> phones(TimeRange(rangeStart, rangeEnd));
+	centiseconds previousEnd = rangeStart;
+	for (size_t i = 0; i < count; ++i) {
+		const centiseconds start = reader.readTime();
+		const centiseconds end = reader.readTime();
+		const uint32_t phone = reader.readUInt(1);
+		if (start < previousEnd || end <= start || end > rangeEnd) {
+			throw runtime_error("Recognized phones must be ordered, non-empty and within their time range.");
+		}
+		if (phone > static_cast<uint32_t>(Phone::Noise)) {
+			throw runtime_error(fmt::format("Unknown phone: {}", phone));
+		}
+		phones.set(start, end, static_cast<Phone>(phone));
+		previousEnd = end;
+	}
+	return phones;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "core/Phone.h"
+#include "time/BoundedTimeline.h"
+#include <vector>
+#include <cstdint>
+#include <span.h>
+
+// Binary format of recognized phones, so that they can be stored and animated again later, e.g.
+// with other target shapes, without recognizing the audio again. All integers are little-endian.
+//
+//   magic      "LSPH"
+//   version    4 bytes, 1
+//   range      start and end of the timeline in centiseconds, 4 bytes each
+//   count      4 bytes
+//   phones     per phone, its start and end in centiseconds, 4 bytes each, and the phone, 1 byte
+std::vector<uint8_t> serializePhones(const BoundedTimeline<Phone>& phones);
+
+// Reads phones written by serializePhones(). Throws if the bytes aren't recognized phones.
+BoundedTimeline<Phone> deserializePhones(gsl::span<const uint8_t> bytes);
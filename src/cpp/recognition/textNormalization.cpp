@@ -0,0 +1,1003 @@
+#include "textNormalization.h"
+#include "tools/stringTools.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+using std::string;
+using std::vector;
+using std::function;
+
+// Follows us_text.c and us_expand.c of Flite 1.4, whose rules and tables this adopts
+
+namespace {
+
+	using Words = vector<string>;
+
+	Words concat(Words a, const Words& b) {
+		a.insert(a.end(), b.begin(), b.end());
+		return a;
+	}
+
+	bool isDigit(char c) { return c >= '0' && c <= '9'; }
+	bool isUpper(char c) { return c >= 'A' && c <= 'Z'; }
+	bool isLower(char c) { return c >= 'a' && c <= 'z'; }
+	bool isLetter(char c) { return isUpper(c) || isLower(c); }
+
+	bool isDigits(const string& s) {
+		return !s.empty() && std::all_of(s.begin(), s.end(), isDigit);
+	}
+
+	bool isAlpha(const string& s) {
+		return !s.empty() && std::all_of(s.begin(), s.end(), isLetter);
+	}
+
+	string toLower(string s) {
+		for (char& c : s) {
+			if (isUpper(c)) c += 'a' - 'A';
+		}
+		return s;
+	}
+
+	string removeAll(string s, char c) {
+		s.erase(std::remove(s.begin(), s.end(), c), s.end());
+		return s;
+	}
+
+	bool isOneOf(const string& s, std::initializer_list<const char*> candidates) {
+		return std::any_of(candidates.begin(), candidates.end(), [&](const char* c) { return s == c; });
+	}
+
+	// The patterns of Flite's regular expressions, each matching whole strings
+
+	// "([A-Za-z]\.)+[A-Za-z]\.?", such as "U.S.A."
+	bool isDottedAbbreviation(const string& s) {
+		const size_t length = !s.empty() && s.back() == '.' ? s.size() - 1 : s.size();
+		if (length < 3 || length % 2 == 0) return false;
+		for (size_t i = 0; i < length; ++i) {
+			if (i % 2 == 0 ? !isLetter(s[i]) : s[i] != '.') return false;
+		}
+		return true;
+	}
+
+	// "[0-9][0-9]?[0-9]?,([0-9][0-9][0-9],)*[0-9][0-9][0-9](\.[0-9]+)?", such as "1,234.5"
+	bool isCommaNumber(const string& s) {
+		const size_t dot = s.find('.');
+		if (dot != string::npos && !isDigits(s.substr(dot + 1))) return false;
+		const string integer = s.substr(0, dot);
+		const size_t firstComma = integer.find(',');
+		if (firstComma == string::npos || firstComma == 0 || firstComma > 3) return false;
+		for (size_t i = 0; i < integer.size(); ++i) {
+			const bool isCommaPosition = i >= firstComma && (i - firstComma) % 4 == 0;
+			if (isCommaPosition ? integer[i] != ',' : !isDigit(integer[i])) return false;
+		}
+		return (integer.size() - firstComma) % 4 == 0;
+	}
+
+	// "[0-9][0-9][0-9]-[0-9][0-9][0-9][0-9]"
+	bool isSevenDigitPhoneNumber(const string& s) {
+		return s.size() == 8 && s[3] == '-' && isDigits(s.substr(0, 3)) && isDigits(s.substr(4));
+	}
+
+	bool isDigits(const string& s, size_t count) {
+		return s.size() == count && isDigits(s);
+	}
+
+	// "[0-9]?[0-9]:[0-5][0-9]"
+	bool isTime(const string& s) {
+		const size_t colon = s.size() - 3;
+		return (s.size() == 4 || s.size() == 5) && s[colon] == ':' && isDigits(s.substr(0, colon))
+			&& s[colon + 1] >= '0' && s[colon + 1] <= '5' && isDigit(s[colon + 2]);
+	}
+
+	// "[0-9]?[0-9][:.][0-5][0-9][ap]m", such as "9:30pm"
+	bool isTimeWithMeridiem(const string& s) {
+		if (s.size() != 6 && s.size() != 7) return false;
+		string time = s.substr(0, s.size() - 2);
+		char& separator = time[time.size() - 3];
+		if (separator != ':' && separator != '.') return false;
+		separator = ':';
+		return isTime(time) && (s[s.size() - 2] == 'a' || s[s.size() - 2] == 'p') && s.back() == 'm';
+	}
+
+	// "([0-9]+-.)+[0-9]+", such as "1-800-555-1234"; the character after each dash may be any
+	bool isDashedDigits(const string& s, size_t start = 0, bool hasGroup = false) {
+		size_t end = start;
+		while (end < s.size() && isDigit(s[end])) ++end;
+		if (end == start) return false;
+		if (end == s.size()) return hasGroup;
+		return s[end] == '-' && end + 1 < s.size() && isDashedDigits(s, end + 2, true);
+	}
+
+	// "II?I?|IV|VI?I?I?|IX|X[VIX]*"
+	bool isRomanNumeral(const string& s) {
+		if (isOneOf(s, { "I", "II", "III", "IV", "V", "VI", "VII", "VIII", "IX" })) return true;
+		return !s.empty() && s[0] == 'X' && s.find_first_not_of("VIX") == string::npos;
+	}
+
+	// "-?(([0-9]+\.[0-9]*)|([0-9]+)|(\.[0-9]+))([eE][-+]?[0-9]+)?"
+	bool isReal(const string& s) {
+		size_t i = s.empty() || s[0] != '-' ? 0 : 1;
+		const auto skipDigits = [&] {
+			const size_t start = i;
+			while (i < s.size() && isDigit(s[i])) ++i;
+			return i - start;
+		};
+		const size_t integerDigits = skipDigits();
+		size_t fractionDigits = 0;
+		if (i < s.size() && s[i] == '.') {
+			++i;
+			fractionDigits = skipDigits();
+		}
+		if (integerDigits == 0 && fractionDigits == 0) return false;
+		if (i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+			++i;
+			if (i < s.size() && (s[i] == '-' || s[i] == '+')) ++i;
+			if (skipDigits() == 0) return false;
+		}
+		return i == s.size();
+	}
+
+	// "[0-9][0-9,]*(th|TH|st|ST|nd|ND|rd|RD)", such as "21st"
+	bool isOrdinalNumber(const string& s) {
+		return s.size() >= 3 && isDigit(s[0])
+			&& s.find_first_not_of("0123456789,", 1) == s.size() - 2
+			&& isOneOf(s.substr(s.size() - 2), { "th", "TH", "st", "ST", "nd", "ND", "rd", "RD" });
+	}
+
+	// ".*illion"
+	bool endsWithIllion(const string& s) {
+		return s.size() >= 6 && s.compare(s.size() - 6, 6, "illion") == 0;
+	}
+
+	// "\$[0-9,]+(\.[0-9]+)?"
+	bool isDollarAmount(const string& s) {
+		if (s.size() < 2 || s[0] != '$') return false;
+		const size_t dot = s.find('.');
+		const string integer = s.substr(1, dot == string::npos ? string::npos : dot - 1);
+		return !integer.empty() && integer.find_first_not_of("0123456789,") == string::npos
+			&& (dot == string::npos || isDigits(s.substr(dot + 1)));
+	}
+
+	// "[0-9]+s", such as "60s"
+	bool isDecade(const string& s) {
+		return s.size() >= 2 && s.back() == 's' && isDigits(s.substr(0, s.size() - 1));
+	}
+
+	// "[0-9]+/[0-9]+"
+	bool isFraction(const string& s) {
+		const size_t slash = s.find('/');
+		return slash != string::npos && isDigits(s.substr(0, slash)) && isDigits(s.substr(slash + 1));
+	}
+
+	const char* const unitAbbreviations[][2] = {
+		{ "LB", "pounds" }, { "LBS", "pounds" }, { "lb", "pounds" }, { "lbs", "pounds" },
+		{ "ft", "feet" }, { "FT", "feet" },
+		{ "kg", "kilograms" }, { "km", "kilometers" }, { "oz", "ounces" },
+		{ "hz", "hertz" }, { "Hz", "hertz" }, { "HZ", "hertz" },
+		{ "KHz", "kilohertz" }, { "MHz", "megahertz" }, { "GHz", "gigahertz" }
+	};
+
+	// "[0-9,]*[0-9]+(lb|LB|lbs|...)", such as "5kg": returns the unit's name, or null
+	const char* getMeasureUnit(const string& s) {
+		const size_t lastDigit = s.find_last_of("0123456789");
+		if (lastDigit == string::npos || s.find_first_not_of("0123456789,") <= lastDigit) return nullptr;
+		const string abbreviation = s.substr(lastDigit + 1);
+		for (const auto& unit : unitAbbreviations) {
+			if (abbreviation == unit[0]) return unit[1];
+		}
+		return nullptr;
+	}
+
+	// Number expansion
+
+	const char* const digitNames[] = {
+		"zero", "one", "two", "three", "four", "five", "six", "seven", "eight", "nine"
+	};
+	const char* const teenNames[] = {
+		"ten", "eleven", "twelve", "thirteen", "fourteen",
+		"fifteen", "sixteen", "seventeen", "eighteen", "nineteen"
+	};
+	const char* const tensNames[] = {
+		"zero", "ten", "twenty", "thirty", "forty", "fifty", "sixty", "seventy", "eighty", "ninety"
+	};
+	const char* const ordinalDigitNames[] = {
+		"zeroth", "first", "second", "third", "fourth", "fifth", "sixth", "seventh", "eighth", "ninth"
+	};
+	const char* const ordinalTeenNames[] = {
+		"tenth", "eleventh", "twelfth", "thirteenth", "fourteenth",
+		"fifteenth", "sixteenth", "seventeenth", "eighteenth", "nineteenth"
+	};
+	const char* const ordinalTensNames[] = {
+		"zeroth", "tenth", "twentieth", "thirtieth", "fortieth",
+		"fiftieth", "sixtieth", "seventieth", "eightieth", "ninetieth"
+	};
+
+	// Digit by digit, such as "one two three" for "123"
+	Words expandDigits(const string& digits) {
+		Words result;
+		for (const char c : digits) {
+			result.emplace_back(isDigit(c) ? digitNames[c - '0'] : "umpty");
+		}
+		return result;
+	}
+
+	// Letter by letter, with "_a" for the letter A
+	Words expandLetters(const string& letters) {
+		Words result;
+		for (const char c : toLower(letters)) {
+			if (isDigit(c)) {
+				result.emplace_back(digitNames[c - '0']);
+			} else {
+				result.push_back(c == 'a' ? "_a" : string(1, c));
+			}
+		}
+		return result;
+	}
+
+	// As a cardinal number of up to 12 digits, such as "one hundred twenty three" for "123"; nothing
+	// for zeros of more than one digit
+	Words expandNumber(const string& number) {
+		const size_t digitCount = number.size();
+		const auto digit = [&](size_t i) { return number[i] - '0'; };
+		if (digitCount == 0) return {};
+		if (digitCount == 1) return expandDigits(number);
+		if (digitCount == 2) {
+			if (number[0] == '0') {
+				return number[1] == '0' ? Words() : Words { digitNames[digit(1)] };
+			}
+			if (number[1] == '0') return { tensNames[digit(0)] };
+			if (number[0] == '1') return { teenNames[digit(1)] };
+			return { tensNames[digit(0)], digitNames[digit(1)] };
+		}
+		if (digitCount == 3) {
+			if (number[0] == '0') return expandNumber(number.substr(1));
+			return concat({ digitNames[digit(0)], "hundred" }, expandNumber(number.substr(1)));
+		}
+
+		static const struct { size_t maxDigitCount; const char* name; } scales[] = {
+			{ 6, "thousand" }, { 9, "million" }, { 12, "billion" }
+		};
+		for (const auto& scale : scales) {
+			if (digitCount <= scale.maxDigitCount) {
+				const size_t split = digitCount - (scale.maxDigitCount - 3);
+				Words result = expandNumber(number.substr(0, split));
+				if (result.empty()) return expandNumber(number.substr(split));
+				result.emplace_back(scale.name);
+				return concat(result, expandNumber(number.substr(split)));
+			}
+		}
+		return expandDigits(number);
+	}
+
+	// As an ordinal number, such as "twenty first" for "21"
+	Words expandOrdinal(const string& number) {
+		Words result = expandNumber(removeAll(number, ','));
+		if (result.empty()) return result;
+		string& last = result.back();
+		const auto replaceLast = [&](const char* const names[], const char* const ordinalNames[]) {
+			for (int i = 0; i < 10; ++i) {
+				if (last == names[i]) {
+					last = ordinalNames[i];
+					return true;
+				}
+			}
+			return false;
+		};
+		if (
+			!replaceLast(digitNames, ordinalDigitNames)
+			&& !replaceLast(teenNames, ordinalTeenNames)
+			&& !replaceLast(tensNames, ordinalTensNames)
+		) {
+			// "hundredth", "thousandth", "millionth" or "billionth"
+			last += "th";
+		}
+		return result;
+	}
+
+	// In pairs of digits, as in years or identifiers, such as "nineteen eighty four" for "1984"
+	Words expandId(const string& number) {
+		const size_t digitCount = number.size();
+		if (digitCount == 4 && number[2] == '0' && number[3] == '0') {
+			if (number[1] == '0') return expandNumber(number);
+			return concat(expandNumber(number.substr(0, 2)), { "hundred" });
+		}
+		if (digitCount == 3 && number[0] != '0' && number[1] == '0' && number[2] == '0') {
+			return { digitNames[number[0] - '0'], "hundred" };
+		}
+		if (number == "00") return { "zero", "zero" };
+		if (digitCount == 2 && number[0] == '0') return concat({ "oh" }, expandDigits(number.substr(1)));
+		if ((digitCount == 4 && number[1] == '0') || digitCount < 3) return expandNumber(number);
+		if (digitCount % 2 == 1) return concat({ digitNames[number[0] - '0'] }, expandId(number.substr(1)));
+		return concat(expandNumber(number.substr(0, 2)), expandId(number.substr(2)));
+	}
+
+	// As a real number, such as "minus one point five e three" for "-1.5e3"
+	Words expandReal(const string& number) {
+		if (!number.empty() && number[0] == '-') return concat({ "minus" }, expandReal(number.substr(1)));
+		if (!number.empty() && number[0] == '+') return concat({ "plus" }, expandReal(number.substr(1)));
+		size_t split = number.find('e');
+		if (split == string::npos) split = number.find('E');
+		if (split != string::npos) {
+			return concat(concat(expandReal(number.substr(0, split)), { "e" }), expandReal(number.substr(split + 1)));
+		}
+		split = number.find('.');
+		if (split != string::npos) {
+			return concat(concat(expandNumber(number.substr(0, split)), { "point" }), expandDigits(number.substr(split + 1)));
+		}
+		return expandNumber(number);
+	}
+
+	int parseRomanNumeral(const string& numeral) {
+		int value = 0;
+		for (size_t i = 0; i < numeral.size(); ++i) {
+			const char next = i + 1 < numeral.size() ? numeral[i + 1] : '\0';
+			if (numeral[i] == 'X') {
+				value += 10;
+			} else if (numeral[i] == 'V') {
+				value += 5;
+			} else if (numeral[i] == 'I') {
+				if (next == 'V' || next == 'X') {
+					value += next == 'V' ? 4 : 9;
+					++i;
+				} else {
+					value += 1;
+				}
+			}
+		}
+		return value;
+	}
+
+	// Classification of digit strings as cardinal numbers, ordinal numbers, years or digits, by the
+	// length and value of the number and the kinds of the neighboring tokens. Flite's us_nums_cart.
+
+	enum class NumberFeature : uint8_t {
+		Leaf,
+		DigitCount,
+		PreviousKind,
+		SecondPreviousKind,
+		NextKind,
+		SecondNextKind,
+		// "1" for 1 to 31, "0" otherwise
+		MonthRange,
+		Value
+	};
+
+	struct NumberTreeNode {
+		NumberFeature feature;
+		// The value that the feature is compared with, or the leaf's class
+		const char* value;
+		// The value that the numeric feature must be less than
+		float threshold;
+		// The node to continue with if the comparison fails; otherwise, it's the next node
+		uint8_t noNode;
+	};
+
+	using F = NumberFeature;
+	const NumberTreeNode numberTree[] = {
+		{ F::DigitCount, nullptr, 3.8f, 56 },
+		{ F::PreviousKind, "month", 0, 5 },
+		{ F::MonthRange, "0", 0, 4 },
+		{ F::Leaf, "year", 0, 0 },
+		{ F::Leaf, "ordinal", 0, 0 },
+		{ F::NextKind, "month", 0, 9 },
+		{ F::MonthRange, "0", 0, 8 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "ordinal", 0, 0 },
+		{ F::NextKind, "numeric", 0, 19 },
+		{ F::DigitCount, nullptr, 2.f, 16 },
+		{ F::PreviousKind, "numeric", 0, 15 },
+		{ F::SecondPreviousKind, "sym", 0, 14 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::SecondNextKind, "sym", 0, 18 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::DigitCount, nullptr, 2.f, 27 },
+		{ F::SecondNextKind, "numeric", 0, 26 },
+		{ F::NextKind, "sym", 0, 25 },
+		{ F::MonthRange, "0", 0, 24 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Value, nullptr, 302.299988f, 35 },
+		{ F::PreviousKind, "flight", 0, 30 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::NextKind, "sym", 0, 34 },
+		{ F::PreviousKind, "sym", 0, 33 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::PreviousKind, "a", 0, 37 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::NextKind, "sym", 0, 43 },
+		{ F::SecondNextKind, "sym", 0, 42 },
+		{ F::Value, nullptr, 669.200012f, 41 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Value, nullptr, 373.200012f, 45 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Value, nullptr, 436.200012f, 49 },
+		{ F::Value, nullptr, 392.600006f, 48 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Value, nullptr, 716.5f, 51 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Value, nullptr, 773.599976f, 55 },
+		{ F::PreviousKind, "_other_", 0, 54 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::PreviousKind, "numeric", 0, 62 },
+		{ F::SecondPreviousKind, "month", 0, 59 },
+		{ F::Leaf, "year", 0, 0 },
+		{ F::SecondNextKind, "numeric", 0, 61 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::SecondNextKind, "numeric", 0, 70 },
+		{ F::NextKind, "month", 0, 65 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::NextKind, "numeric", 0, 67 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::PreviousKind, "_other_", 0, 69 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "year", 0, 0 },
+		{ F::PreviousKind, "_other_", 0, 80 },
+		{ F::DigitCount, nullptr, 4.4f, 77 },
+		{ F::Value, nullptr, 2959.600098f, 76 },
+		{ F::Value, nullptr, 1773.400024f, 75 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "year", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::SecondPreviousKind, "_other_", 0, 79 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::NextKind, "to", 0, 82 },
+		{ F::Leaf, "year", 0, 0 },
+		{ F::PreviousKind, "sym", 0, 88 },
+		{ F::SecondPreviousKind, "sym", 0, 85 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::DigitCount, nullptr, 4.6f, 87 },
+		{ F::Leaf, "year", 0, 0 },
+		{ F::Leaf, "digits", 0, 0 },
+		{ F::DigitCount, nullptr, 4.8f, 96 },
+		{ F::Value, nullptr, 2880.f, 95 },
+		{ F::Value, nullptr, 1633.199951f, 94 },
+		{ F::Value, nullptr, 1306.400024f, 93 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "year", 0, 0 },
+		{ F::Leaf, "year", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 },
+		{ F::Leaf, "cardinal", 0, 0 }
+	};
+
+	// The kind of a token for the classification of numbers, Flite's token_pos_guess feature
+	const char* getTokenKind(const string& name) {
+		const string word = toLower(name);
+		if (isDigits(word)) return "numeric";
+		if (isReal(word)) return "number";
+		if (isOneOf(word, {
+			"jan", "january", "feb", "february", "mar", "march", "apr", "april", "may", "jun", "june",
+			"jul", "july", "aug", "august", "sep", "sept", "september", "oct", "october", "nov",
+			"november", "dec", "december"
+		})) return "month";
+		if (isOneOf(word, {
+			"sun", "sunday", "mon", "monday", "tue", "tues", "tuesday", "wed", "wednesday", "thu",
+			"thurs", "thursday", "fri", "friday", "sat", "saturday"
+		})) return "day";
+		if (word == "a") return "a";
+		if (word == "flight") return "flight";
+		if (word == "to") return "to";
+		return "_other_";
+	}
+
+	// Pronounceability of letter sequences. Flite's us_aswd.c: finite-state machines of the letters
+	// that words can begin and end with, up to the first vowel. Their symbols are 'V' for vowels,
+	// 'N' for 'n' and 'm', '#' for the word boundary and the other letters themselves. Each state is
+	// a list of transitions, ending with 0, which each encode their symbol and target state as
+	// target * 128 + symbol.
+
+	const uint16_t wordStartTransitions[] = {
+	291, 0, 3064, 3057, 3322, 3050, 4470, 4971, 6004, 7159, 7654, 8295, 9328, 10476, 10995, 13160,
+	13938, 14308, 15458, 16227, 17102, 17622, 0, 17622, 0, 3062, 3063, 3052, 17779, 3048, 18020, 3042,
+	17622, 0, 3052, 3058, 17622, 0, 3050, 3063, 3052, 3048, 3058, 3022, 17622, 0, 3050, 3062,
+	3051, 3063, 18291, 18664, 19186, 17622, 0, 3048, 3058, 17622, 0, 3050, 3052, 3058, 17622, 0,
+	3050, 3063, 3052, 3048, 19186, 3022, 17622, 0, 3060, 19558, 3052, 3059, 4456, 19186, 3022, 17622,
+	0, 3052, 3048, 17622, 0, 3057, 19962, 3050, 3062, 4459, 20340, 3063, 3046, 18023, 20720, 3052,
+	21352, 3058, 21987, 3022, 17622, 0, 3063, 3052, 3059, 3058, 17622, 0, 3048, 17622, 0, 3066,
+	3050, 3062, 3063, 3052, 3048, 3058, 17622, 0, 3050, 3052, 3048, 3058, 17622, 0, 3066, 3063,
+	3052, 4456, 3058, 17622, 0, 3058, 22627, 17622, 0, 0, 24803, 0, 3058, 0, 24803, 17622,
+	0, 3063, 3058, 17622, 0, 3066, 17622, 0, 3052, 17622, 0, 25059, 17622, 0, 3058, 17622,
+	0, 3052, 3048, 3058, 17622, 0, 3052, 3058, 24803, 17622, 0, 3052, 25320, 3058, 17622, 0,
+	3057, 3062, 3051, 3060, 3063, 3046, 4455, 13936, 3052, 3048, 3058, 3044, 20322, 4451, 3022, 17622,
+	0, 3048, 0, 3066, 0, 3063, 3052, 3058, 3022, 17622, 0,
+	};
+
+	const uint16_t wordEndTransitions[] = {
+	291, 0, 3050, 3313, 3830, 4194, 4986, 6374, 7288, 8048, 8936, 3063, 10467, 11243, 12532, 14828,
+	17127, 18020, 19187, 21490, 22350, 23766, 0, 23766, 0, 3811, 3022, 23766, 0, 3058, 23766, 0,
+	3042, 3052, 3058, 3022, 23766, 0, 3066, 3046, 23907, 24564, 3052, 25444, 25843, 3058, 3022, 23766,
+	0, 26214, 26992, 27500, 3058, 3022, 23766, 0, 3064, 3052, 3058, 3022, 23766, 0, 25840, 3052,
+	3059, 3058, 3022, 23766, 0, 3042, 27888, 28515, 3051, 29428, 27879, 25828, 31091, 31602, 3022, 23766,
+	0, 3052, 3059, 3058, 3022, 23766, 0, 3066, 3063, 27875, 3051, 3052, 31859, 3058, 3022, 23766,
+	0, 3042, 32762, 33254, 3064, 27888, 33896, 3063, 25827, 3819, 26996, 34284, 25831, 34788, 35443, 27506,
+	36686, 23766, 0, 3050, 3062, 3042, 37498, 25840, 37864, 3063, 38243, 38507, 39028, 3820, 25831, 25828,
+	39795, 3058, 3022, 23766, 0, 3048, 3052, 25831, 3058, 27470, 23766, 0, 3066, 3048, 3063, 40172,
+	3044, 3058, 3790, 23766, 0, 3062, 4194, 3066, 40678, 41328, 42216, 3063, 10467, 43115, 44148, 46316,
+	47207, 47844, 3827, 48754, 49358, 23766, 0, 3062, 3048, 3060, 3059, 3058, 23766, 0, 3050, 3066,
+	50536, 3063, 3052, 3047, 3059, 3058, 3790, 23766, 0, 0, 51066, 3058, 3022, 23766, 0, 3060,
+	3052, 3059, 3058, 3790, 23766, 0, 3066, 23766, 0, 3022, 23766, 0, 38256, 3052, 3058, 3022,
+	23766, 0, 3058, 3022, 23766, 0, 3048, 23766, 0, 3052, 3058, 3022, 23766, 0, 3828, 3052,
+	51315, 3058, 3022, 23766, 0, 52342, 52582, 3064, 3056, 52968, 3063, 3052, 38247, 3044, 3058, 3790,
+	23766, 0, 3052, 3058, 23766, 0, 3058, 0, 3062, 3060, 3052, 3058, 3022, 23766, 0, 31604,
+	3059, 3058, 0, 3046, 3052, 3022, 23766, 0, 53219, 3047, 0, 3048, 3058, 23766, 0, 3052,
+	3058, 3790, 23766, 0, 3810, 3824, 3051, 3052, 25831, 3044, 3058, 53582, 23766, 0, 54132, 52580,
+	3059, 3058, 23766, 0, 3060, 3022, 0, 54371, 23766, 0, 3022, 0, 3043, 3058, 3022, 0,
+	3060, 3059, 3058, 3022, 23766, 0, 3063, 3059, 0, 3043, 3058, 23766, 0, 3046, 27500, 3058,
+	23766, 0, 3056, 3052, 3059, 3058, 3022, 23766, 0, 27888, 3811, 3051, 54772, 3047, 23766, 0,
+	3063, 26979, 3052, 3059, 3058, 3022, 23766, 0, 3042, 3066, 3046, 3064, 27888, 56168, 3063, 25827,
+	3060, 3052, 3047, 56548, 3827, 3058, 3022, 23766, 0, 3062, 3048, 3063, 3052, 3058, 23766, 0,
+	3047, 3058, 3022, 23766, 0, 3063, 53612, 3044, 3058, 56910, 23766, 0, 3048, 54131, 3058, 23766,
+	0, 50536, 3063, 3052, 3047, 3059, 27506, 3022, 23766, 0, 3060, 3047, 23766, 0, 31603, 0,
+	57338, 3051, 57588, 3052, 3058, 3022, 23766, 0, 3052, 0, 3052, 23766, 0, 3047, 0, 31603,
+	23766, 0, 3063, 3058, 23766, 0, 3059, 0, 3059, 23766, 0, 3046, 3064, 3056, 3063, 3052,
+	38247, 25828, 3058, 3022, 23766, 0, 3043, 3047, 0, 3058, 3022, 0, 3063, 23766, 0, 38260,
+	0, 3060, 3058, 3022, 23766, 0,
+	};
+
+	int transition(const uint16_t* transitions, int state, int symbol) {
+		for (int i = state; transitions[i]; ++i) {
+			if (transitions[i] % 128 == symbol) return transitions[i] / 128;
+		}
+		return -1;
+	}
+
+	// Whether the letters up to the first vowel, in the given order, can end or begin a word
+	template<typename Iterator>
+	bool hasPronounceableEdge(const uint16_t* transitions, Iterator begin, Iterator end) {
+		// Both machines start from the state of the boundary in the one of word starts
+		int state = transition(wordStartTransitions, 0, '#');
+		for (Iterator it = begin; it != end; ++it) {
+			const char c = *it;
+			const int symbol = c == 'n' || c == 'm' ? 'N' : std::strchr("aeiouy", c) ? 'V' : c;
+			state = transition(transitions, state, symbol);
+			if (state == -1) return false;
+			if (symbol == 'V') return true;
+		}
+		return false;
+	}
+
+	bool isPronounceable(const string& letters) {
+		const string word = toLower(letters);
+		return hasPronounceableEdge(wordStartTransitions, word.begin(), word.end())
+			&& hasPronounceableEdge(wordEndTransitions, word.rbegin(), word.rend());
+	}
+
+	// State abbreviations, with whether they are also common words or abbreviations
+	struct StateAbbreviation {
+		const char* abbreviation;
+		bool isAmbiguous;
+		Words words;
+	};
+
+	const StateAbbreviation stateAbbreviations[] = {
+		{ "AL", true, { "alabama" } }, { "Al", true, { "alabama" } }, { "Ala", false, { "alabama" } },
+		{ "AK", false, { "alaska" } }, { "Ak", false, { "alaska" } },
+		{ "AZ", false, { "arizona" } }, { "Az", false, { "arizona" } },
+		{ "CA", false, { "california" } }, { "Ca", false, { "california" } },
+		{ "Cal", true, { "california" } }, { "Calif", false, { "california" } },
+		{ "CO", true, { "colorado" } }, { "Co", true, { "colorado" } }, { "Colo", false, { "colorado" } },
+		{ "DC", false, { "d", "c" } },
+		{ "DE", false, { "delaware" } }, { "De", true, { "delaware" } }, { "Del", true, { "delaware" } },
+		{ "FL", false, { "florida" } }, { "Fl", true, { "florida" } }, { "Fla", false, { "florida" } },
+		{ "GA", false, { "georgia" } }, { "Ga", false, { "georgia" } },
+		{ "HI", false, { "hawaii" } }, { "Hi", true, { "hawaii" } },
+		{ "IA", false, { "iowa" } }, { "Ia", true, { "iowa" } },
+		{ "Ind", true, { "indiana" } },
+		{ "ID", true, { "idaho" } },
+		{ "IL", true, { "illinois" } }, { "Il", true, { "illinois" } }, { "ILL", true, { "illinois" } },
+		{ "KS", false, { "kansas" } }, { "Ks", false, { "kansas" } }, { "Kans", false, { "kansas" } },
+		{ "KY", true, { "kentucky" } }, { "Ky", true, { "kentucky" } },
+		{ "LA", true, { "louisiana" } }, { "La", true, { "louisiana" } },
+		{ "Lou", true, { "louisiana" } }, { "Lous", true, { "louisiana" } },
+		{ "MA", true, { "massachusetts" } }, { "Mass", true, { "massachusetts" } },
+		{ "Ma", true, { "massachusetts" } },
+		{ "MD", true, { "maryland" } }, { "Md", true, { "maryland" } },
+		{ "ME", true, { "maine" } }, { "Me", true, { "maine" } },
+		{ "MI", false, { "michigan" } }, { "Mi", true, { "michigan" } }, { "Mich", true, { "michigan" } },
+		{ "MN", true, { "minnesota" } }, { "Minn", true, { "minnesota" } },
+		{ "MS", true, { "mississippi" } }, { "Miss", true, { "mississippi" } },
+		{ "MT", true, { "montana" } }, { "Mt", true, { "montana" } },
+		{ "MO", true, { "missouri" } }, { "Mo", true, { "missouri" } },
+		{ "NC", true, { "north", "carolina" } }, { "ND", true, { "north", "dakota" } },
+		{ "NE", true, { "nebraska" } }, { "Ne", true, { "nebraska" } }, { "Neb", true, { "nebraska" } },
+		{ "NH", true, { "new", "hampshire" } },
+		{ "NV", false, { "nevada" } }, { "Nev", false, { "nevada" } },
+		{ "NY", false, { "new", "york" } },
+		{ "OH", true, { "ohio" } },
+		{ "OK", true, { "oklahoma" } }, { "Okla", false, { "oklahoma" } },
+		{ "OR", true, { "oregon" } }, { "Or", true, { "oregon" } }, { "Ore", true, { "oregon" } },
+		{ "PA", true, { "pennsylvania" } }, { "Pa", true, { "pennsylvania" } },
+		{ "Penn", true, { "pennsylvania" } },
+		{ "RI", true, { "rhode", "island" } },
+		{ "SC", true, { "south", "carolina" } }, { "SD", true, { "south", "dakota" } },
+		{ "TN", true, { "tennessee" } }, { "Tn", true, { "tennessee" } }, { "Tenn", true, { "tennessee" } },
+		{ "TX", true, { "texas" } }, { "Tx", true, { "texas" } }, { "Tex", true, { "texas" } },
+		{ "UT", true, { "utah" } },
+		{ "VA", true, { "virginia" } },
+		{ "WA", true, { "washington" } }, { "Wa", true, { "washington" } }, { "Wash", true, { "washington" } },
+		{ "WI", true, { "wisconsin" } }, { "Wi", true, { "wisconsin" } },
+		{ "WV", true, { "west", "virginia" } },
+		{ "WY", true, { "wyoming" } }, { "Wy", true, { "wyoming" } }, { "Wyo", false, { "wyoming" } },
+		{ "PR", true, { "puerto", "rico" } }
+	};
+
+	// Tokenization
+
+	struct Token {
+		string name;
+		// The whitespace before the token
+		string whitespace;
+		// The punctuation after the token, which some expansions change
+		string punctuation;
+		// Whether the token was split into parts; digits in them are then read in pairs
+		bool isSplit = false;
+	};
+
+	bool isWhitespace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
+	bool isPrepunctuation(char c) { return c && std::strchr("\"'`({[", c); }
+	bool isPostpunctuation(char c) { return c && std::strchr("\"'`.,:;!?(){}[]", c); }
+
+	// Splits a text at whitespace, separating punctuation at either end of each token, like Flite's
+	// token stream. The first character of a token is never punctuation after it.
+	vector<Token> tokenize(const string& text) {
+		vector<Token> tokens;
+		size_t i = 0;
+		while (i < text.size()) {
+			Token token;
+			size_t start = i;
+			while (i < text.size() && isWhitespace(text[i])) ++i;
+			token.whitespace = text.substr(start, i - start);
+			while (i < text.size() && isPrepunctuation(text[i])) ++i;
+			start = i;
+			while (i < text.size() && !isWhitespace(text[i])) ++i;
+			size_t nameEnd = i;
+			while (nameEnd > start + 1 && isPostpunctuation(text[nameEnd - 1])) --nameEnd;
+			if (nameEnd == start) continue;
+
+			token.name = text.substr(start, nameEnd - start);
+			token.punctuation = text.substr(nameEnd, i - nameEnd);
+			tokens.push_back(std::move(token));
+		}
+		return tokens;
+	}
+
+	// Expands tokens into words. Flite's us_tokentowords().
+	class TokenExpander {
+	public:
+		TokenExpander(vector<Token>& tokens, const function<bool(const string&)>& dictionaryContains) :
+			tokens(tokens),
+			dictionaryContains(dictionaryContains)
+		{}
+
+		Words expand(size_t tokenIndex) {
+			index = tokenIndex;
+			return expand(tokens[index].name);
+		}
+
+	private:
+		// Expands the token or a part of it
+		Words expand(const string& name);
+
+		bool hasNeighbor(int offset) const {
+			const long long neighborIndex = static_cast<long long>(index) + offset;
+			return neighborIndex >= 0 && neighborIndex < static_cast<long long>(tokens.size());
+		}
+
+		// Like Flite's features of neighboring tokens, the neighbor's name is "0" if there is none
+		const string& neighborName(int offset) const {
+			static const string missing = "0";
+			return hasNeighbor(offset) ? tokens[index + offset].name : missing;
+		}
+
+		const char* neighborKind(int offset) const {
+			return hasNeighbor(offset) ? getTokenKind(tokens[index + offset].name) : "0";
+		}
+
+		bool isPhoneNumberPart(const string& name) const;
+		const char* classifyNumber(const string& name) const;
+		bool followsRulerName() const;
+		bool followsSectionName() const;
+		const Words* expandStateAbbreviation(const string& name) const;
+
+		vector<Token>& tokens;
+		const function<bool(const string&)>& dictionaryContains;
+		size_t index = 0;
+	};
+
+	// Part of a phone number, such as "412 268 3448"
+	bool TokenExpander::isPhoneNumberPart(const string& name) const {
+		if (isDigits(name, 3)) {
+			return (!isDigits(neighborName(-1)) && isDigits(neighborName(1), 3) && isDigits(neighborName(2), 4))
+				|| isSevenDigitPhoneNumber(neighborName(1))
+				|| (!isDigits(neighborName(-2)) && isDigits(neighborName(-1), 3) && isDigits(neighborName(1), 4));
+		}
+		return isDigits(name, 4)
+			&& !isDigits(neighborName(1)) && isDigits(neighborName(-1), 3) && isDigits(neighborName(-2), 3);
+	}
+
+	const char* TokenExpander::classifyNumber(const string& name) const {
+		const int intValue = std::atoi(name.c_str());
+		const char* const monthRange = intValue > 0 && intValue < 32 ? "1" : "0";
+		const float value = static_cast<float>(std::atof(name.c_str()));
+
+		for (int node = 0;;) {
+			const NumberTreeNode& treeNode = numberTree[node];
+			bool isMatch;
+			switch (treeNode.feature) {
+				case F::Leaf: return treeNode.value;
+				case F::DigitCount: isMatch = static_cast<float>(name.size()) < treeNode.threshold; break;
+				case F::Value: isMatch = value < treeNode.threshold; break;
+				case F::MonthRange: isMatch = std::strcmp(monthRange, treeNode.value) == 0; break;
+				case F::PreviousKind: isMatch = std::strcmp(neighborKind(-1), treeNode.value) == 0; break;
+				case F::SecondPreviousKind: isMatch = std::strcmp(neighborKind(-2), treeNode.value) == 0; break;
+				case F::NextKind: isMatch = std::strcmp(neighborKind(1), treeNode.value) == 0; break;
+				case F::SecondNextKind: isMatch = std::strcmp(neighborKind(2), treeNode.value) == 0; break;
+				default: return "cardinal";
+			}
+			node = isMatch ? node + 1 : treeNode.noNode;
+		}
+	}
+
+	// After a name that takes a regnal number, such as "Henry VIII" or "King George III"
+	bool TokenExpander::followsRulerName() const {
+		return isOneOf(toLower(neighborName(-1)), {
+				"louis", "henry", "charles", "philip", "george", "edward", "pius", "william", "richard",
+				"ptolemy", "john", "paul", "peter", "nicholas", "frederick", "james", "alfonso", "ivan",
+				"napolean", "leo", "gregory", "catherine", "alexandria", "pierre", "elizabeth", "mary"
+			})
+			|| isOneOf(toLower(neighborName(-2)), {
+				"king", "queen", "pope", "duke", "tsar", "emperor", "shah", "ceasar", "duchess", "tsarina",
+				"empress", "baron", "baroness", "sultan", "count", "countess"
+			});
+	}
+
+	// After a word that takes a cardinal number, such as "Chapter IV"
+	bool TokenExpander::followsSectionName() const {
+		return isOneOf(toLower(neighborName(-1)), {
+			"section", "chapter", "part", "phrase", "verse", "scene", "act", "book", "volume", "chap",
+			"war", "apollo", "trek", "fortran"
+		});
+	}
+
+	const Words* TokenExpander::expandStateAbbreviation(const string& name) const {
+		for (const StateAbbreviation& state : stateAbbreviations) {
+			if (name != state.abbreviation) continue;
+			if (!state.isAmbiguous) return &state.words;
+
+			// After a capitalized word, and before a lowercase word, the end of the sentence or a zip code
+			const string& previousName = neighborName(-1);
+			const string& nextName = neighborName(1);
+			if (
+				isUpper(previousName[0]) && previousName.size() > 2 && isAlpha(previousName)
+				&& (
+					isLower(nextName[0]) || !hasNeighbor(1) || tokens[index].punctuation == "."
+					|| ((nextName.size() == 5 || nextName.size() == 10) && isDigits(nextName))
+				)
+			) {
+				return &state.words;
+			}
+		}
+		return nullptr;
+	}
+
+	Words TokenExpander::expand(const string& name) {
+		Token& token = tokens[index];
+		if ((name == "a" || name == "A") && (!hasNeighbor(1) || name != token.name || !token.punctuation.empty())) {
+			// The letter rather than the article
+			return { "_a" };
+		}
+		if (name.empty()) return {};
+		if (isDottedAbbreviation(name)) return expandLetters(removeAll(name, '.'));
+		if (isCommaNumber(name)) return expandReal(removeAll(name, ','));
+		if (isSevenDigitPhoneNumber(name)) {
+			return concat(expandDigits(name.substr(0, 3)), expandDigits(name.substr(4)));
+		}
+		if (isPhoneNumberPart(name)) {
+			if (token.punctuation.empty()) token.punctuation = ",";
+			return expandDigits(name);
+		}
+		if (isTime(name)) {
+			const size_t colon = name.find(':');
+			const string minutes = name.substr(colon + 1);
+			return concat(expandNumber(name.substr(0, colon)), minutes == "00" ? Words() : expandId(minutes));
+		}
+		if (isTimeWithMeridiem(name)) {
+			const size_t separator = name.find_first_of(":.");
+			const string minutes = name.substr(separator + 1, 2);
+			return concat(
+				concat(expandNumber(name.substr(0, separator)), minutes == "00" ? Words() : expandId(minutes)),
+				expandLetters(name.substr(separator + 3))
+			);
+		}
+		if (isDashedDigits(name)) {
+			Words result;
+			for (size_t start = 0, end; start <= name.size(); start = end + 1) {
+				end = std::min(name.find('-', start), name.size());
+				result = concat(result, expandDigits(name.substr(start, end - start)));
+			}
+			return result;
+		}
+		if (isDigits(name)) {
+			if (token.isSplit) return expandId(name);
+			const string kind = classifyNumber(name);
+			if (kind == "ordinal") return expandOrdinal(name);
+			if (kind == "digits") return expandDigits(name);
+			if (kind == "year") return expandId(name);
+			return expandNumber(name);
+		}
+		if (isRomanNumeral(name)) {
+			if (hasNeighbor(-1) && tokens[index - 1].punctuation.empty()) {
+				const string value = std::to_string(parseRomanNumeral(name));
+				if (followsRulerName()) return concat({ "the" }, expandOrdinal(value));
+				if (followsSectionName()) return expandNumber(value);
+			}
+			return expandLetters(name);
+		}
+		if (toLower(name) == "dr" || toLower(name) == "st") {
+			// Such as "Dr King Dr" or "St Andrew's St"
+			const bool isSaint = toLower(name) == "st";
+			const char* const street = isSaint ? "street" : "drive";
+			const char* const title = isSaint ? "saint" : "doctor";
+			const char* word;
+			const char previous = neighborName(-1)[0];
+			const char next = neighborName(1)[0];
+			if (!hasNeighbor(1) || token.punctuation.find(',') != string::npos) {
+				word = street;
+			} else if ((isUpper(previous) || isDigit(previous)) && isLower(next)) {
+				word = street;
+			} else if (isLower(previous) && isUpper(next)) {
+				word = title;
+			} else {
+				word = tokens[index + 1].whitespace == " " ? title : street;
+			}
+			if (token.punctuation == ".") token.punctuation.clear();
+			return { word };
+		}
+		if (name == "Mr" || name == "Mrs") {
+			token.punctuation.clear();
+			return { name == "Mr" ? "mister" : "missus" };
+		}
+		if (name == "read" || name == "lead") {
+			const bool isPresent = isOneOf(neighborName(-1), {
+				"to", "can", "can't", "cannot", "cant", "could", "couldn't", "couldnt", "will", "shall"
+			});
+			if (name == "read") return { isPresent ? "reed" : "red" };
+			return { isPresent ? "leed" : "led" };
+		}
+		if (name == "am" || name == "AM") {
+			if (name != token.name) return expandLetters(name);
+			if (hasNeighbor(-1) && (isTime(neighborName(-1)) || isDigits(neighborName(-1)))) {
+				return expandLetters(name);
+			}
+			return { name };
+		}
+		if (
+			name.size() == 1 && isUpper(name[0]) && hasNeighbor(1)
+			&& tokens[index + 1].whitespace == " " && isUpper(neighborName(1)[0])
+		) {
+			// An initial, such as "J" in "J Smith"
+			token.punctuation.clear();
+			return { name == "A" ? "_a" : toLower(name) };
+		}
+		if (isReal(name)) return expandReal(name);
+		if (isOrdinalNumber(name)) return expandOrdinal(name.substr(0, name.size() - 2));
+		if (endsWithIllion(name) && isDollarAmount(neighborName(-1))) return { name, "dollars" };
+		if (isDollarAmount(name)) {
+			const size_t dot = name.find('.');
+			if (endsWithIllion(neighborName(1))) {
+				// Such as "$5 million"
+				return expandReal(removeAll(name.substr(1), ','));
+			}
+			if (dot == string::npos) {
+				const string amount = name.substr(1);
+				return concat(expand(amount), { amount == "1" ? "dollar" : "dollars" });
+			}
+			const string cents = name.substr(dot + 1);
+			if (cents.size() > 2) {
+				return concat(expandReal(removeAll(name.substr(1), ',')), { "dollars" });
+			}
+			const string dollars = removeAll(name.substr(1, dot - 1), ',');
+			Words result = concat(expandNumber(dollars), { dollars == "1" ? "dollar" : "dollars" });
+			if (cents != "00") {
+				result = concat(concat(result, expandNumber(cents)), { cents == "01" ? "cent" : "cents" });
+			}
+			return result;
+		}
+		if (name.back() == '%') {
+			return concat(expand(name.substr(0, name.size() - 1)), { "per", "cent" });
+		}
+		if (isDecade(name)) {
+			return concat(expandNumber(name.substr(0, name.size() - 1)), { "'s" });
+		}
+		const size_t apostrophe = name.rfind('\'');
+		if (apostrophe != string::npos) {
+			const string suffix = toLower(name.substr(apostrophe));
+			if (isOneOf(suffix, { "'s", "'ll", "'ve", "'d" })) {
+				return concat(expand(name.substr(0, apostrophe)), { suffix });
+			}
+			if (name.compare(apostrophe, string::npos, "'tve") == 0) {
+				return concat(expand(name.substr(0, apostrophe + 2)), { "'ve" });
+			}
+			return expand(string(name).erase(apostrophe, 1));
+		}
+		if (isFraction(name) && name == token.name) {
+			const size_t slash = name.find('/');
+			const string numerator = name.substr(0, slash);
+			const string denominator = name.substr(slash + 1);
+			Words result;
+			if (numerator == "1" && denominator == "2") {
+				result = { "a", "half" };
+			} else if (std::atoi(numerator.c_str()) < std::atoi(denominator.c_str())) {
+				result = concat(expandNumber(numerator), expandOrdinal(denominator));
+				if (std::atoi(numerator.c_str()) > 1) result.emplace_back("'s");
+			} else {
+				result = concat(concat(expandNumber(numerator), { "slash" }), expandNumber(denominator));
+			}
+			// Such as "2 1/2"
+			if (hasNeighbor(-1) && isDigits(neighborName(-1))) result.insert(result.begin(), "and");
+			return result;
+		}
+		const size_t dash = name.find('-');
+		if (dash != string::npos) {
+			const string first = name.substr(0, dash);
+			const string second = name.substr(dash + 1);
+			if (!isDigits(first) || !isDigits(second)) return concat(expand(first), expand(second));
+
+			// A range, such as "5-10", whose parts are classified as tokens of their own
+			const string tokenName = token.name;
+			token.name = second;
+			const Words secondWords = expand(second);
+			token.name = first;
+			Words result = concat(concat(expand(first), { "to" }), secondWords);
+			token.name = tokenName;
+			return result;
+		}
+		if (const char* unit = getMeasureUnit(name)) {
+			return concat(expandNumber(removeAll(name.substr(0, name.find_last_of("0123456789") + 1), ',')), { unit });
+		}
+		if (name.size() > 1 && !isAlpha(name)) {
+			// Splits after the first letter or digit not followed by one of the same kind
+			size_t split = 0;
+			while (split + 1 < name.size()) {
+				const char c = name[split];
+				const char next = name[split + 1];
+				if (!(isLetter(c) && isLetter(next)) && !(isDigit(c) && isDigit(next))) break;
+				++split;
+			}
+			token.isSplit = true;
+			return concat(expand(name.substr(0, split + 1)), expand(name.substr(split + 1)));
+		}
+		if (const Words* words = expandStateAbbreviation(name)) return *words;
+		if (name.size() > 1 && isAlpha(name) && !dictionaryContains(name) && !isPronounceable(name)) {
+			return expandLetters(name);
+		}
+		return { toLower(name) };
+	}
+
+}
+
+vector<string> normalizeText(const string& text, const function<bool(const string&)>& dictionaryContains) {
+	vector<Token> tokens = tokenize(utf8ToAscii(text));
+	TokenExpander expander(tokens, dictionaryContains);
+	vector<string> words;
+	for (size_t i = 0; i < tokens.size(); ++i) {
+		words = concat(std::move(words), expander.expand(i));
+	}
+	return words;
+}
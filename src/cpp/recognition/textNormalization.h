@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <string>
+
+// Splits a text into words the way Flite's US English front end does, without Flite: tokenizes it
+// at whitespace and punctuation, then expands numbers (cardinals, ordinals, years, digit strings,
+// decimals, money, times, phone numbers, fractions), abbreviations such as "Mr" or "St", state
+// codes, Roman numerals and unpronounceable letter sequences.
+// Follows Flite's rules closely enough to give the same words for dialog text, except that the
+// dictionary stands in for Flite's CMU lexicon when deciding whether to spell out a letter sequence.
+// Like Flite, returns "_a" for the letter A and may return words with punctuation, such as ".", or
+// with a leading apostrophe, such as "'s".
+std::vector<std::string> normalizeText(
+	const std::string& text,
+	const std::function<bool(const std::string&)>& dictionaryContains
+);
@@ -1,32 +1,47 @@
 #include "tokenization.h"
+#include "textNormalization.h"
 #include "tools/tools.h"
 #include "tools/stringTools.h"
-#include <regex>
 #include <compat/boost_compat.h>
+#include <algorithm>
 
+#if defined(LIPSYNCENGINE_FLITE)
 extern "C" {
 #include <cst_utt_utils.h>
 #include <lang/usenglish/usenglish.h>
 #include <lang/cmulex/cmu_lex.h>
 }
+#endif
 
 using std::runtime_error;
 using std::string;
 using std::vector;
-using std::regex;
-using std::pair;
 using boost::optional;
 using std::function;
 
+#if defined(LIPSYNCENGINE_FLITE)
+
+static cst_lexicon* getLexicon() {
+	// cmu_lex_init() fills a global lexicon on first use, so only let one thread do that
+	static cst_lexicon* const lexicon = cmu_lex_init();
+	return lexicon;
+}
+
 lambda_unique_ptr<cst_voice> createDummyVoice() {
 	lambda_unique_ptr<cst_voice> voice(new_voice(), [](cst_voice* voice) { delete_voice(voice); });
 	voice->name = "dummy_voice";
 	usenglish_init(voice.get());
-	cst_lexicon* lexicon = cmu_lex_init();
-	feat_set(voice->features, "lexicon", lexicon_val(lexicon));
+	feat_set(voice->features, "lexicon", lexicon_val(getLexicon()));
 	return voice;
 }
 
+// Setting up the voice costs more than tokenizing a typical dialog line, so each thread keeps one.
+// It can't be shared between threads because Flite's value reference counts aren't atomic.
+static cst_voice& getDummyVoice() {
+	thread_local const lambda_unique_ptr<cst_voice> voice = createDummyVoice();
+	return *voice;
+}
+
 static const cst_synth_module synth_method_normalize[] = {
 	{ "tokenizer_func", default_tokenization },		// split text into tokens
 	{ "textanalysis_func", default_textanalysis },	// transform tokens into words
@@ -43,8 +58,7 @@ vector<string> tokenizeViaFlite(const string& text) {
 		[](cst_utterance* utterance) { delete_utterance(utterance); }
 	);
 	utt_set_input_text(utterance.get(), asciiText.c_str());
-	lambda_unique_ptr<cst_voice> voice = createDummyVoice();
-	utt_init(utterance.get(), voice.get());
+	utt_init(utterance.get(), &getDummyVoice());
 
 	// Perform tokenization and text normalization
 	if (!apply_synth_method(utterance.get(), synth_method_normalize)) {
@@ -63,34 +77,73 @@ vector<string> tokenizeViaFlite(const string& text) {
 	return result;
 }
 
-optional<string> findSimilarDictionaryWord(
-	const string& word,
-	const function<bool(const string&)>& dictionaryContains
-) {
-	for (bool addPeriod : { false, true }) {
-		for (int apostropheIndex = -1; apostropheIndex <= static_cast<int>(word.size()); ++apostropheIndex) {
-			string modified = word;
-			if (apostropheIndex != -1) {
-				modified.insert(apostropheIndex, "'");
-			}
-			if (addPeriod) {
-				modified += ".";
-			}
+bool fliteLexiconContains(const string& word) {
+	return in_lex(getLexicon(), word.c_str(), nullptr);
+}
 
-			if (dictionaryContains(modified)) {
-				return modified;
-			}
+#endif
+
+void SimilarWordIndex::add(const string& dictionaryWord) {
+	const bool hasPeriod = !dictionaryWord.empty() && dictionaryWord.back() == '.';
+	const string baseWord = hasPeriod ? dictionaryWord.substr(0, dictionaryWord.size() - 1) : dictionaryWord;
+	// Tokens only consist of lowercase letters and apostrophes
+	const bool isTokenLike = std::all_of(baseWord.begin(), baseWord.end(),
+		[](char c) { return (c >= 'a' && c <= 'z') || c == '\''; });
+	if (!isTokenLike) return;
+
+	// Ranked like the candidates were once probed: first without a period, then by the position the
+	// apostrophe was inserted at, if any
+	const int periodRank = hasPeriod ? static_cast<int>(baseWord.size()) + 2 : 0;
+	const auto addEntry = [&](const string& key, int apostropheIndex) {
+		const int rank = periodRank + apostropheIndex + 1;
+		const auto it = entries.find(key);
+		if (it == entries.end() || rank < it->second.rank) {
+			entries[key] = { rank, dictionaryWord };
+		}
+	};
+	if (hasPeriod) {
+		addEntry(baseWord, -1);
+	}
+	for (size_t i = 0; i < baseWord.size(); ++i) {
+		if (baseWord[i] == '\'') {
+			addEntry(baseWord.substr(0, i) + baseWord.substr(i + 1), static_cast<int>(i));
 		}
 	}
+}
 
-	return boost::none;
+optional<string> SimilarWordIndex::find(const string& word) const {
+	const auto it = entries.find(word);
+	if (it == entries.end()) return boost::none;
+	return it->second.word;
+}
+
+string replaceSymbols(const string& word) {
+	string result;
+	result.reserve(word.size());
+	for (const char c : word) {
+		switch (c) {
+			case '&': result += "and"; break;
+			case '*': result += "times"; break;
+			case '+': result += "plus"; break;
+			case '=': result += "equals"; break;
+			case '@': result += "at"; break;
+			default:
+				if ((c >= 'a' && c <= 'z') || c == '\'') result += c;
+		}
+	}
+	return result;
 }
 
 vector<string> tokenizeText(
 	const string& text,
-	const function<bool(const string&)>& dictionaryContains
+	const function<bool(const string&)>& dictionaryContains,
+	const SimilarWordIndex* similarWords
 ) {
+#if defined(LIPSYNCENGINE_FLITE)
 	vector<string> words = tokenizeViaFlite(text);
+#else
+	vector<string> words = normalizeText(text, dictionaryContains);
+#endif
 
 	// Join words separated by apostrophes
 	for (int i = static_cast<int>(words.size()) - 1; i > 0; --i) {
@@ -100,19 +153,8 @@ vector<string> tokenizeText(
 		}
 	}
 
-	// Turn some symbols into words, remove the rest
-	const static vector<pair<regex, string>> replacements {
-		{ regex("&"), "and" },
-		{ regex("\\*"), "times" },
-		{ regex("\\+"), "plus" },
-		{ regex("="), "equals" },
-		{ regex("@"), "at" },
-		{ regex("[^a-z']"), "" }
-	};
 	for (auto& word : words) {
-		for (const auto& replacement : replacements) {
-			word = regex_replace(word, replacement.first, replacement.second);
-		}
+		word = replaceSymbols(word);
 	}
 
 	// Remove empty words
@@ -122,11 +164,13 @@ vector<string> tokenizeText(
 	);
 
 	// Try to replace words that are not in the dictionary with similar ones that are
-	for (auto& word : words) {
-		if (!dictionaryContains(word)) {
-			optional<string> modifiedWord = findSimilarDictionaryWord(word, dictionaryContains);
-			if (modifiedWord) {
-				word = *modifiedWord;
+	if (similarWords) {
+		for (auto& word : words) {
+			if (!dictionaryContains(word)) {
+				optional<string> similarWord = similarWords->find(word);
+				if (similarWord) {
+					word = *similarWord;
+				}
 			}
 		}
 	}
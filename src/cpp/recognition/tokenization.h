@@ -3,8 +3,47 @@
 #include <vector>
 #include <functional>
 #include <string>
+#include <unordered_map>
+#include <compat/boost_compat.h>
 
+// Turns some symbols of a token into words, such as "&" into "and", and removes all other
+// characters except lowercase letters and apostrophes
+std::string replaceSymbols(const std::string& word);
+
+// Finds the dictionary word that differs from a token only by an inserted apostrophe or an appended
+// period, such as "o'clock" for "oclock" or "mr." for "mr", with a single lookup
+class SimilarWordIndex {
+public:
+	// Indexes a dictionary word. Only words with an apostrophe or a final period are similar to others.
+	void add(const std::string& dictionaryWord);
+
+	// Returns the similar dictionary word, preferring words without a period and apostrophes further
+	// to the front, or none
+	boost::optional<std::string> find(const std::string& word) const;
+
+private:
+	struct Entry {
+		// Lower is preferred
+		int rank;
+		std::string word;
+	};
+
+	std::unordered_map<std::string, Entry> entries;
+};
+
+#if defined(LIPSYNCENGINE_FLITE)
+// Splits a text into words with Flite's US English text analysis, which normalizeText() follows
+std::vector<std::string> tokenizeViaFlite(const std::string& text);
+
+// Whether Flite's CMU lexicon has a word; as normalizeText()'s dictionary, makes it decide like Flite
+bool fliteLexiconContains(const std::string& word);
+#endif
+
+// Splits a text into normalized words, with normalizeText() or, in builds with
+// LIPSYNCENGINE_FLITE, with Flite. Words missing from the dictionary are replaced with similar
+// ones from the index, if given.
 std::vector<std::string> tokenizeText(
 	const std::string& text,
-	const std::function<bool(const std::string&)>& dictionaryContains
+	const std::function<bool(const std::string&)>& dictionaryContains,
+	const SimilarWordIndex* similarWords = nullptr
 );
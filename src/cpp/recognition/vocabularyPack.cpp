@@ -0,0 +1,174 @@
+#include "vocabularyPack.h"
+
+#if !defined(__EMSCRIPTEN__)
+
+#include <fstream>
+#include <map>
+#include <set>
+#include <chrono>
+#include "pocketSphinxTools.h"
+#include "languageModels.h"
+#include "tokenization.h"
+#include "g2p.h"
+#include "logging/logging.h"
+
+using std::string;
+using std::vector;
+using std::map;
+using std::set;
+using std::filesystem::path;
+
+// The weight of the full language model's unigram probabilities in the pack's language model.
+// Like the default model of a biased dialog model, it keeps words likely outside the lines they
+// appear in, e.g. for ad-libs.
+constexpr double backgroundWeight = 0.1;
+
+// The pronunciations of the dictionary, by word without pronunciation index, as lines of the
+// dictionary file
+static map<string, vector<string>> readDictionary(const path& dictionaryPath) {
+	map<string, vector<string>> result;
+	std::ifstream file(dictionaryPath);
+	string line;
+	while (std::getline(file, line)) {
+		const size_t wordEnd = line.find(' ');
+		if (wordEnd == string::npos || wordEnd == 0) continue;
+
+		result[stripPronunciationIndex(line.substr(0, wordEnd))].push_back(line);
+	}
+	return result;
+}
+
+// Moves a temporary file into place, so that concurrent processes never read a partial one
+static bool replaceFile(const path& temporaryPath, const path& filePath) {
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, filePath, error);
+	if (error) {
+		std::filesystem::remove(temporaryPath, error);
+		return false;
+	}
+	return true;
+}
+
+static path getTemporaryPath(const path& filePath) {
+	const auto uniqueSuffix = std::chrono::steady_clock::now().time_since_epoch().count();
+	path temporaryPath = filePath;
+	temporaryPath += fmt::format(".{}.tmp", uniqueSuffix);
+	return temporaryPath;
+}
+
+bool createSphinxVocabularyPack(const vector<string>& dialogs, const path& outputDirectory) {
+	const map<string, vector<string>> dictionary =
+		readDictionary(getSphinxModelDirectory() / "cmudict-en-us.dict");
+	if (dictionary.empty()) return false;
+	SimilarWordIndex similarWords;
+	for (const auto& pair : dictionary) {
+		const string& word = pair.first;
+		if (word.find('\'') != string::npos || word.find('.') != string::npos) {
+			similarWords.add(word);
+		}
+	}
+
+	// Split the dialog lines into sentences of normalized words, guessing pronunciations for the
+	// words the dictionary lacks
+	vector<string> words;
+	map<string, vector<Phone>> addedWords;
+	set<string> skippedWords;
+	const auto dictionaryContains = [&](const string& word) { return dictionary.count(word) > 0; };
+	for (const string& dialog : dialogs) {
+		vector<string> sentence;
+		for (const string& word : tokenizeText(dialog, dictionaryContains, &similarWords)) {
+			if (!dictionaryContains(word) && !addedWords.count(word)) {
+				vector<Phone> phones = wordToPhones(word);
+				if (phones.empty()) {
+					skippedWords.insert(word);
+					continue;
+				}
+				addedWords[word] = std::move(phones);
+			}
+			sentence.push_back(word);
+		}
+		if (sentence.empty()) continue;
+
+		words.emplace_back("<s>");
+		words.insert(words.end(), sentence.begin(), sentence.end());
+		words.emplace_back("</s>");
+	}
+	if (words.empty()) return false;
+	for (const string& word : skippedWords) {
+		logging::warnFormat("Can't guess a pronunciation for '{}'. Leaving it out of the vocabulary.", word);
+	}
+
+	// Write the dictionary in the order of the full one
+	const path dictionaryPath = outputDirectory / vocabularyDictionaryFileName;
+	const path temporaryDictionaryPath = getTemporaryPath(dictionaryPath);
+	map<string, vector<string>> entries;
+	for (const string& word : words) {
+		if (word == "<s>" || word == "</s>" || entries.count(word)) continue;
+
+		const auto it = dictionary.find(word);
+		if (it != dictionary.end()) {
+			entries[word] = it->second;
+			continue;
+		}
+		string line = word;
+		for (Phone phone : addedWords.at(word)) {
+			line += " " + PhoneConverter::get().toString(phone);
+		}
+		logging::infoFormat("Unknown word '{}'. Guessing pronunciation '{}'.", word, line.substr(word.size() + 1));
+		entries[word] = { line };
+	}
+	std::ofstream file(temporaryDictionaryPath);
+	for (const auto& pair : entries) {
+		for (const string& line : pair.second) {
+			file << line << '\n';
+		}
+	}
+	file.close();
+	if (!file) {
+		std::error_code error;
+		std::filesystem::remove(temporaryDictionaryPath, error);
+		return false;
+	}
+	if (!replaceFile(temporaryDictionaryPath, dictionaryPath)) return false;
+	path compiledDictionaryPath = dictionaryPath;
+	compiledDictionaryPath += ".bin";
+	if (!compileSphinxDictionary(dictionaryPath, compiledDictionaryPath)) return false;
+
+	// Take the unigram probabilities of the pack's words from the full language model
+	lambda_unique_ptr<logmath_t> lmath(
+		logmath_init(1.0001, 0, 0),
+		[](logmath_t* lmath) { logmath_free(lmath); });
+	if (!lmath) return false;
+	const path fullModelPath = getSphinxModelDirectory() / "en-us.lm.bin";
+	lambda_unique_ptr<ngram_model_t> fullModel(
+		ngram_model_read(nullptr, fullModelPath.u8string().c_str(), NGRAM_AUTO, lmath.get()),
+		[](ngram_model_t* lm) { ngram_model_free(lm); });
+	if (!fullModel) return false;
+	UnigramProbabilities backgroundProbabilities;
+	for (const string& word : words) {
+		if (backgroundProbabilities.count(word)) continue;
+		if (ngram_wid(fullModel.get(), word.c_str()) == ngram_unknown_wid(fullModel.get())) continue;
+
+		backgroundProbabilities[word] = logmath_exp(lmath.get(), ngram_probv(fullModel.get(), word.c_str(), nullptr));
+	}
+	// The sentence boundaries only follow the dialog lines
+	backgroundProbabilities.erase("<s>");
+	backgroundProbabilities.erase("</s>");
+
+	lambda_unique_ptr<ngram_model_t> model =
+		createInterpolatedLanguageModel(words, backgroundProbabilities, backgroundWeight, *lmath);
+	if (!model) return false;
+	const path modelPath = outputDirectory / vocabularyLanguageModelFileName;
+	const path temporaryModelPath = getTemporaryPath(modelPath);
+	if (ngram_model_write(model.get(), temporaryModelPath.u8string().c_str(), NGRAM_BIN) < 0) {
+		std::error_code error;
+		std::filesystem::remove(temporaryModelPath, error);
+		return false;
+	}
+	if (!replaceFile(temporaryModelPath, modelPath)) return false;
+
+	logging::infoFormat("Wrote a vocabulary pack of {} words, {} of them guessed.", entries.size(), addedWords.size());
+	return true;
+}
+
+#endif
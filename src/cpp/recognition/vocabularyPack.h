@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <filesystem>
+
+#if !defined(__EMSCRIPTEN__)
+// Writes a vocabulary pack for the given dialog lines to the output directory (see
+// LanguageModelVariant::Vocabulary), from the dictionary and language model of the model directory:
+// * vocabulary.dict, with the dictionary's pronunciations of the dialog's words and guessed ones for
+//   the words it lacks, along with its compiled copy vocabulary.dict.bin
+// * vocabulary.lm.bin, a trigram model of the dialog lines, whose unigrams are interpolated with
+//   those of the full language model
+// Returns false if that fails.
+bool createSphinxVocabularyPack(
+	const std::vector<std::string>& dialogs,
+	const std::filesystem::path& outputDirectory
+);
+#endif
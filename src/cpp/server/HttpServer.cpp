@@ -0,0 +1,449 @@
+#include "HttpServer.h"
+#include <format.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+
+using std::string;
+using std::runtime_error;
+
+namespace {
+
+	// Headers longer than this are rejected
+	constexpr size_t maxHeaderSize = 64 * 1024;
+	// Connections are closed after this long without receiving anything
+	constexpr int receiveTimeoutSeconds = 60;
+	// How often run() checks whether stop() was called
+	constexpr int stopPollMilliseconds = 200;
+
+	const char* getStatusText(int status) {
+		switch (status) {
+			case 100: return "Continue";
+			case 200: return "OK";
+			case 400: return "Bad Request";
+			case 404: return "Not Found";
+			case 405: return "Method Not Allowed";
+			case 411: return "Length Required";
+			case 413: return "Payload Too Large";
+			case 415: return "Unsupported Media Type";
+			case 422: return "Unprocessable Entity";
+			case 429: return "Too Many Requests";
+			case 431: return "Request Header Fields Too Large";
+			case 503: return "Service Unavailable";
+			default: return status < 500 ? "Bad Request" : "Internal Server Error";
+		}
+	}
+
+	string toLower(string s) {
+		std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return std::tolower(c); });
+		return s;
+	}
+
+	string trim(const string& s) {
+		const size_t start = s.find_first_not_of(" \t");
+		return start == string::npos ? string() : s.substr(start, s.find_last_not_of(" \t") + 1 - start);
+	}
+
+	// Decodes percent escapes and '+' as space
+	string decodeUrlComponent(const string& s) {
+		string result;
+		for (size_t i = 0; i < s.size(); ++i) {
+			if (s[i] == '+') {
+				result += ' ';
+			} else if (s[i] == '%' && i + 2 < s.size() && std::isxdigit(static_cast<unsigned char>(s[i + 1]))
+				&& std::isxdigit(static_cast<unsigned char>(s[i + 2])))
+			{
+				result += static_cast<char>(std::stoi(s.substr(i + 1, 2), nullptr, 16));
+				i += 2;
+			} else {
+				result += s[i];
+			}
+		}
+		return result;
+	}
+
+}
+
+HttpConnection::HttpConnection(int socket) :
+	socket(socket)
+{}
+
+void HttpConnection::readRequest() {
+	// Receives until the end of the headers; the rest is the start of the body
+	size_t headerEnd;
+	while ((headerEnd = received.find("\r\n\r\n")) == string::npos) {
+		if (received.size() > maxHeaderSize) {
+			throw HttpError(431, "Request headers too large");
+		}
+		char buffer[4096];
+		const size_t count = receive(buffer, sizeof buffer);
+		if (count == 0) {
+			throw HttpError(400, "Incomplete request");
+		}
+		received.append(buffer, count);
+	}
+	const string head = received.substr(0, headerEnd);
+	receivedOffset = headerEnd + 4;
+
+	size_t lineEnd = head.find("\r\n");
+	const string requestLine = head.substr(0, lineEnd);
+	const size_t methodEnd = requestLine.find(' ');
+	const size_t targetEnd = requestLine.find(' ', methodEnd + 1);
+	if (methodEnd == string::npos || targetEnd == string::npos) {
+		throw HttpError(400, "Malformed request line");
+	}
+	method = requestLine.substr(0, methodEnd);
+	const string target = requestLine.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+	const size_t queryStart = target.find('?');
+	path = decodeUrlComponent(target.substr(0, queryStart));
+	if (queryStart != string::npos) {
+		const string queryString = target.substr(queryStart + 1);
+		for (size_t start = 0; start <= queryString.size();) {
+			size_t end = queryString.find('&', start);
+			if (end == string::npos) end = queryString.size();
+			const string parameter = queryString.substr(start, end - start);
+			if (!parameter.empty()) {
+				const size_t equals = parameter.find('=');
+				query[decodeUrlComponent(parameter.substr(0, equals))] =
+					equals == string::npos ? string() : decodeUrlComponent(parameter.substr(equals + 1));
+			}
+			start = end + 1;
+		}
+	}
+
+	while (lineEnd != string::npos) {
+		const size_t lineStart = lineEnd + 2;
+		lineEnd = head.find("\r\n", lineStart);
+		const string line = head.substr(lineStart, lineEnd == string::npos ? string::npos : lineEnd - lineStart);
+		const size_t colon = line.find(':');
+		if (colon == string::npos) {
+			throw HttpError(400, "Malformed header");
+		}
+		headers[toLower(trim(line.substr(0, colon)))] = trim(line.substr(colon + 1));
+	}
+
+	chunked = toLower(getHeader("transfer-encoding")).find("chunked") != string::npos;
+	const string contentLength = getHeader("content-length");
+	if (chunked) {
+		remainingBodySize = 0;
+	} else if (!contentLength.empty()) {
+		try {
+			remainingBodySize = static_cast<size_t>(std::stoull(contentLength));
+		} catch (const std::exception&) {
+			throw HttpError(400, "Invalid Content-Length");
+		}
+		bodyEnded = remainingBodySize == 0;
+	} else {
+		bodyEnded = true;
+	}
+	continueExpected = toLower(getHeader("expect")) == "100-continue";
+}
+
+const string& HttpConnection::getMethod() const {
+	return method;
+}
+
+const string& HttpConnection::getPath() const {
+	return path;
+}
+
+string HttpConnection::getQuery(const string& name, const string& defaultValue) const {
+	const auto it = query.find(name);
+	return it == query.end() ? defaultValue : it->second;
+}
+
+bool HttpConnection::hasQuery(const string& name) const {
+	return query.count(name) > 0;
+}
+
+string HttpConnection::getHeader(const string& name) const {
+	const auto it = headers.find(name);
+	return it == headers.end() ? string() : it->second;
+}
+
+size_t HttpConnection::readBody(char* buffer, size_t size) {
+	if (bodyEnded || size == 0) return 0;
+	sendContinue();
+
+	if (chunked && remainingBodySize == 0) {
+		// Each chunk starts with its size in hex; the last one is empty and followed by trailers
+		const string sizeLine = readLine();
+		size_t chunkSize;
+		try {
+			chunkSize = static_cast<size_t>(std::stoull(sizeLine, nullptr, 16));
+		} catch (const std::exception&) {
+			throw HttpError(400, "Invalid chunk size");
+		}
+		if (chunkSize == 0) {
+			while (!readLine().empty()) {}
+			bodyEnded = true;
+			return 0;
+		}
+		remainingBodySize = chunkSize;
+	}
+
+	const size_t count = readRaw(buffer, std::min(size, remainingBodySize));
+	if (count == 0) {
+		throw HttpError(400, "Incomplete request body");
+	}
+	remainingBodySize -= count;
+	if (remainingBodySize == 0) {
+		if (chunked) {
+			readLine();
+		} else {
+			bodyEnded = true;
+		}
+	}
+	return count;
+}
+
+string HttpConnection::readWholeBody(size_t maxSize) {
+	if (!chunked && remainingBodySize > maxSize) {
+		throw HttpError(413, fmt::format("Request body larger than {} bytes", maxSize));
+	}
+	string body;
+	if (!chunked) body.reserve(remainingBodySize);
+	char buffer[64 * 1024];
+	while (const size_t count = readBody(buffer, sizeof buffer)) {
+		if (body.size() + count > maxSize) {
+			throw HttpError(413, fmt::format("Request body larger than {} bytes", maxSize));
+		}
+		body.append(buffer, count);
+	}
+	return body;
+}
+
+void HttpConnection::sendResponse(int status, const string& contentType, const string& body) {
+	responded = true;
+	send(fmt::format(
+		"HTTP/1.1 {} {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n",
+		status, getStatusText(status), contentType, body.size()));
+	send(body);
+}
+
+void HttpConnection::beginChunkedResponse(int status, const string& contentType) {
+	// The body is read while the response is streamed, so the client must not wait for it
+	sendContinue();
+	responded = true;
+	send(fmt::format(
+		"HTTP/1.1 {} {}\r\nContent-Type: {}\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n",
+		status, getStatusText(status), contentType));
+}
+
+void HttpConnection::writeChunk(const string& data) {
+	if (data.empty()) return;
+	send(fmt::format("{:x}\r\n", data.size()) + data + "\r\n");
+}
+
+void HttpConnection::endChunkedResponse() {
+	send("0\r\n\r\n");
+}
+
+bool HttpConnection::hasResponded() const {
+	return responded;
+}
+
+size_t HttpConnection::receive(char* buffer, size_t size) {
+	while (true) {
+		const ssize_t count = recv(socket, buffer, size, 0);
+		if (count >= 0) return static_cast<size_t>(count);
+		if (errno != EINTR) {
+			throw runtime_error(fmt::format("Receiving failed: {}", std::strerror(errno)));
+		}
+	}
+}
+
+size_t HttpConnection::readRaw(char* buffer, size_t size) {
+	if (receivedOffset < received.size()) {
+		const size_t count = std::min(size, received.size() - receivedOffset);
+		std::memcpy(buffer, received.data() + receivedOffset, count);
+		receivedOffset += count;
+		return count;
+	}
+	return receive(buffer, size);
+}
+
+string HttpConnection::readLine() {
+	string line;
+	char c;
+	while (readRaw(&c, 1) == 1) {
+		if (c == '\n') {
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			return line;
+		}
+		if (line.size() > maxHeaderSize) break;
+		line += c;
+	}
+	throw HttpError(400, "Malformed chunked body");
+}
+
+void HttpConnection::send(const string& data) {
+	for (size_t offset = 0; offset < data.size();) {
+		const ssize_t count = ::send(socket, data.data() + offset, data.size() - offset, 0);
+		if (count < 0) {
+			if (errno == EINTR) continue;
+			throw runtime_error(fmt::format("Sending failed: {}", std::strerror(errno)));
+		}
+		offset += static_cast<size_t>(count);
+	}
+}
+
+void HttpConnection::sendContinue() {
+	// Clients that asked whether to send the body wait for this before sending it
+	if (continueExpected) {
+		continueExpected = false;
+		send("HTTP/1.1 100 Continue\r\n\r\n");
+	}
+}
+
+HttpServer::HttpServer(const string& host, int port, int threadCount, Handler handler) :
+	handler(std::move(handler))
+{
+	addrinfo hints {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	addrinfo* addresses = nullptr;
+	const string service = std::to_string(port);
+	if (const int error = getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(), &hints, &addresses)) {
+		throw runtime_error(fmt::format("Could not resolve {}: {}", host, gai_strerror(error)));
+	}
+	string bindError = "no address";
+	for (addrinfo* address = addresses; address && listeningSocket < 0; address = address->ai_next) {
+		const int candidate = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (candidate < 0) continue;
+		const int enabled = 1;
+		setsockopt(candidate, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof enabled);
+		if (bind(candidate, address->ai_addr, address->ai_addrlen) == 0 && listen(candidate, 128) == 0) {
+			listeningSocket = candidate;
+		} else {
+			bindError = std::strerror(errno);
+			close(candidate);
+		}
+	}
+	freeaddrinfo(addresses);
+	if (listeningSocket < 0) {
+		throw runtime_error(fmt::format("Could not listen on {}:{}: {}", host, port, bindError));
+	}
+
+	sockaddr_storage boundAddress {};
+	socklen_t addressLength = sizeof boundAddress;
+	getsockname(listeningSocket, reinterpret_cast<sockaddr*>(&boundAddress), &addressLength);
+	this->port = boundAddress.ss_family == AF_INET6
+		? ntohs(reinterpret_cast<sockaddr_in6*>(&boundAddress)->sin6_port)
+		: ntohs(reinterpret_cast<sockaddr_in*>(&boundAddress)->sin_port);
+
+	for (int i = 0; i < std::max(threadCount, 1); ++i) {
+		threads.emplace_back([this] { runConnectionThread(); });
+	}
+}
+
+HttpServer::~HttpServer() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closing = true;
+	}
+	socketsChanged.notify_all();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	for (int socket : pendingSockets) {
+		close(socket);
+	}
+	close(listeningSocket);
+}
+
+int HttpServer::getPort() const {
+	return port;
+}
+
+void HttpServer::run() {
+	while (!stopping) {
+		pollfd listening { listeningSocket, POLLIN, 0 };
+		if (poll(&listening, 1, stopPollMilliseconds) <= 0) continue;
+
+		const int socket = accept(listeningSocket, nullptr, nullptr);
+		if (socket < 0) continue;
+		timeval timeout {};
+		timeout.tv_sec = receiveTimeoutSeconds;
+		setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pendingSockets.push_back(socket);
+		}
+		socketsChanged.notify_one();
+	}
+
+	// Lets the threads finish the connections accepted so far
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closing = true;
+	}
+	socketsChanged.notify_all();
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	threads.clear();
+}
+
+void HttpServer::stop() {
+	stopping = true;
+}
+
+void HttpServer::runConnectionThread() {
+	while (true) {
+		int socket;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			socketsChanged.wait(lock, [&] { return closing || !pendingSockets.empty(); });
+			if (pendingSockets.empty()) return;
+			socket = pendingSockets.front();
+			pendingSockets.pop_front();
+		}
+		handleConnection(socket);
+
+		// Closing with unread data resets the connection, which discards the response before the
+		// client reads it. This happens when a request is rejected before its body was read, so the
+		// rest of the body is discarded first, up to a limit.
+		shutdown(socket, SHUT_WR);
+		char buffer[16384];
+		size_t discardedSize = 0;
+		const size_t maxDiscardedSize = 64 * 1024 * 1024;
+		while (discardedSize < maxDiscardedSize) {
+			const ssize_t size = recv(socket, buffer, sizeof buffer, 0);
+			if (size <= 0) break;
+			discardedSize += static_cast<size_t>(size);
+		}
+		close(socket);
+	}
+}
+
+void HttpServer::handleConnection(int socket) {
+	HttpConnection connection(socket);
+	try {
+		connection.readRequest();
+		handler(connection);
+	} catch (const HttpError& e) {
+		if (!connection.hasResponded()) {
+			try {
+				connection.sendResponse(e.getStatus(), "text/plain", string(e.what()) + "\n");
+			} catch (const std::exception&) {}
+		}
+	} catch (const std::exception& e) {
+		if (!connection.hasResponded()) {
+			try {
+				connection.sendResponse(500, "text/plain", string(e.what()) + "\n");
+			} catch (const std::exception&) {}
+		} else {
+			std::cerr << fmt::format("Error handling {}: {}\n", connection.getPath(), e.what());
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <stdexcept>
+
+// An error to answer a request with, such as 400 for invalid parameters
+class HttpError : public std::runtime_error {
+public:
+	HttpError(int status, const std::string& message) :
+		std::runtime_error(message),
+		status(status)
+	{}
+
+	int getStatus() const {
+		return status;
+	}
+
+private:
+	int status;
+};
+
+// A request being handled and its response.
+// The body is read on demand, so that handlers can process it while it arrives. A response is
+// either sent whole or streamed in chunks (chunked transfer encoding); the connection is closed
+// after it.
+class HttpConnection {
+public:
+	explicit HttpConnection(int socket);
+
+	// Reads the request line and the headers. Throws HttpError for malformed requests.
+	void readRequest();
+
+	const std::string& getMethod() const;
+	// The path without the query
+	const std::string& getPath() const;
+	// The decoded value of a query parameter, or defaultValue if it's missing
+	std::string getQuery(const std::string& name, const std::string& defaultValue = std::string()) const;
+	bool hasQuery(const std::string& name) const;
+	// The value of a header, by its name in lower case, or an empty string if it's missing
+	std::string getHeader(const std::string& name) const;
+
+	// Reads up to size bytes of the body, returning 0 at its end
+	size_t readBody(char* buffer, size_t size);
+	// Reads the whole body. Throws HttpError 413 if it's longer than maxSize.
+	std::string readWholeBody(size_t maxSize);
+
+	void sendResponse(int status, const std::string& contentType, const std::string& body);
+	void beginChunkedResponse(int status, const std::string& contentType);
+	void writeChunk(const std::string& data);
+	void endChunkedResponse();
+	// Whether a response has been started, after which errors can only close the connection
+	bool hasResponded() const;
+
+private:
+	size_t receive(char* buffer, size_t size);
+	// Reads up to size bytes, from what was received with the headers first
+	size_t readRaw(char* buffer, size_t size);
+	std::string readLine();
+	void send(const std::string& data);
+	void sendContinue();
+
+	int socket;
+	std::string method;
+	std::string path;
+	std::map<std::string, std::string> query;
+	std::map<std::string, std::string> headers;
+	// Bytes received after the headers, not yet read
+	std::string received;
+	size_t receivedOffset = 0;
+	bool chunked = false;
+	// Bytes of the body, or of its current chunk, left to read
+	size_t remainingBodySize = 0;
+	bool bodyEnded = false;
+	bool continueExpected = false;
+	bool responded = false;
+};
+
+// A minimal HTTP/1.1 server over POSIX sockets.
+// Connections are handled by a fixed number of threads, each answering one request per connection.
+class HttpServer {
+public:
+	using Handler = std::function<void(HttpConnection&)>;
+
+	// Listens on the given address and port (0 for any free port). Throws if binding fails.
+	HttpServer(const std::string& host, int port, int threadCount, Handler handler);
+	~HttpServer();
+	HttpServer(const HttpServer&) = delete;
+	HttpServer& operator=(const HttpServer&) = delete;
+
+	int getPort() const;
+
+	// Accepts connections until stop() is called, then waits for the requests being handled
+	void run();
+	// Makes run() return. Only sets a flag, so it may be called from a signal handler.
+	void stop();
+
+private:
+	void runConnectionThread();
+	void handleConnection(int socket);
+
+	Handler handler;
+	int listeningSocket = -1;
+	int port = 0;
+	std::atomic<bool> stopping { false };
+
+	std::vector<std::thread> threads;
+	std::deque<int> pendingSockets;
+	std::mutex mutex;
+	std::condition_variable socketsChanged;
+	bool closing = false;
+};
@@ -0,0 +1,120 @@
+#include "ServerMetrics.h"
+#include "bridge/bridge.h"
+#include <format.h>
+#include "tools/stringTools.h"
+#include <algorithm>
+#include <tuple>
+
+using std::string;
+
+namespace {
+
+	// Upper bounds of the duration buckets in seconds, from 10 ms to minutes
+	const std::vector<double> bucketBounds {
+		0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120
+	};
+
+}
+
+ServerMetrics::ServerMetrics() = default;
+
+void ServerMetrics::recordRequest(const string& endpoint, int status, double seconds, double audioSeconds) {
+	std::lock_guard<std::mutex> lock(mutex);
+	++requestCounts[{ endpoint, status }];
+	Histogram& histogram = durations[endpoint];
+	if (histogram.counts.empty()) {
+		histogram.counts.resize(bucketBounds.size());
+	}
+	const auto bucket = std::lower_bound(bucketBounds.begin(), bucketBounds.end(), seconds);
+	if (bucket != bucketBounds.end()) {
+		++histogram.counts[bucket - bucketBounds.begin()];
+	}
+	++histogram.count;
+	histogram.sum += seconds;
+	this->audioSeconds[endpoint] += audioSeconds;
+}
+
+string ServerMetrics::format(const std::vector<FairShareScheduler::TenantStats>& tenants) const {
+	fmt::MemoryWriter out;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		out << "# HELP lipsyncengine_requests_total Requests handled, by endpoint and status.\n"
+			<< "# TYPE lipsyncengine_requests_total counter\n";
+		for (const auto& entry : requestCounts) {
+			out.write("lipsyncengine_requests_total{{endpoint=\"{}\",status=\"{}\"}} {}\n",
+				entry.first.first, entry.first.second, entry.second);
+		}
+
+		out << "# HELP lipsyncengine_request_duration_seconds Time to answer a request, by endpoint.\n"
+			<< "# TYPE lipsyncengine_request_duration_seconds histogram\n";
+		for (const auto& entry : durations) {
+			long long cumulativeCount = 0;
+			for (size_t i = 0; i < bucketBounds.size(); ++i) {
+				cumulativeCount += entry.second.counts[i];
+				out.write("lipsyncengine_request_duration_seconds_bucket{{endpoint=\"{}\",le=\"{}\"}} {}\n",
+					entry.first, bucketBounds[i], cumulativeCount);
+			}
+			out.write("lipsyncengine_request_duration_seconds_bucket{{endpoint=\"{}\",le=\"+Inf\"}} {}\n",
+				entry.first, entry.second.count);
+			out.write("lipsyncengine_request_duration_seconds_sum{{endpoint=\"{}\"}} {}\n", entry.first, entry.second.sum);
+			out.write("lipsyncengine_request_duration_seconds_count{{endpoint=\"{}\"}} {}\n", entry.first, entry.second.count);
+		}
+
+		out << "# HELP lipsyncengine_audio_seconds_total Audio analyzed, by endpoint.\n"
+			<< "# TYPE lipsyncengine_audio_seconds_total counter\n";
+		for (const auto& entry : audioSeconds) {
+			out.write("lipsyncengine_audio_seconds_total{{endpoint=\"{}\"}} {}\n", entry.first, entry.second);
+		}
+	}
+
+	out << "# HELP lipsyncengine_requests_in_flight Requests being handled.\n"
+		<< "# TYPE lipsyncengine_requests_in_flight gauge\n";
+	out.write("lipsyncengine_requests_in_flight {}\n", requestsInFlight.load());
+	out << "# HELP lipsyncengine_open_streams Streaming sessions open.\n"
+		<< "# TYPE lipsyncengine_open_streams gauge\n";
+	out.write("lipsyncengine_open_streams {}\n", openStreams.load());
+
+	using TenantValue = double (*)(const FairShareScheduler::TenantStats&);
+	const std::tuple<const char*, const char*, const char*, TenantValue> tenantMetrics[] {
+		{ "tenant_weight", "gauge", "Share of the recognition threads, by tenant.",
+			[](const FairShareScheduler::TenantStats& t) { return t.options.weight; } },
+		{ "tenant_requests_in_flight", "gauge", "Requests being handled, by tenant.",
+			[](const FairShareScheduler::TenantStats& t) { return static_cast<double>(t.requestCount); } },
+		{ "tenant_rejected_requests_total", "counter", "Requests refused for the tenant's request limit.",
+			[](const FairShareScheduler::TenantStats& t) { return static_cast<double>(t.rejectedRequestCount); } },
+		{ "tenant_running_tasks", "gauge", "Utterances being recognized, by tenant.",
+			[](const FairShareScheduler::TenantStats& t) { return static_cast<double>(t.runningTaskCount); } },
+		{ "tenant_waiting_tasks", "gauge", "Utterances waiting for a thread, by tenant.",
+			[](const FairShareScheduler::TenantStats& t) { return static_cast<double>(t.waitingTaskCount); } },
+		{ "tenant_tasks_total", "counter", "Utterances and other tasks run, by tenant.",
+			[](const FairShareScheduler::TenantStats& t) { return static_cast<double>(t.taskCount); } },
+		{ "tenant_cpu_seconds_total", "counter", "CPU time of the tasks run, by tenant.",
+			[](const FairShareScheduler::TenantStats& t) { return t.cpuSeconds; } },
+		{ "tenant_task_wait_seconds_total", "counter", "Time tasks waited for a thread, by tenant.",
+			[](const FairShareScheduler::TenantStats& t) { return t.waitSeconds; } }
+	};
+	for (const auto& metric : tenantMetrics) {
+		out.write("# HELP lipsyncengine_{} {}\n# TYPE lipsyncengine_{} {}\n",
+			std::get<0>(metric), std::get<2>(metric), std::get<0>(metric), std::get<1>(metric));
+		for (const auto& tenant : tenants) {
+			out.write("lipsyncengine_{}{{tenant=\"{}\"}} {}\n",
+				std::get<0>(metric), escapeJsonString(tenant.name), std::get<3>(metric)(tenant));
+		}
+	}
+
+	lipsyncengine_memory_stats memory {};
+	if (lipsyncengine_get_memory_stats(&memory) == 0) {
+		const std::pair<const char*, double> gauges[] {
+			{ "heap_bytes", memory.heap_bytes },
+			{ "peak_heap_bytes", memory.peak_heap_bytes },
+			{ "model_bytes", memory.model_bytes },
+			{ "decoders", memory.decoder_count },
+			{ "memory_budget_bytes", memory.memory_budget_bytes }
+		};
+		for (const auto& gauge : gauges) {
+			out.write("# TYPE lipsyncengine_{} gauge\nlipsyncengine_{} {}\n", gauge.first, gauge.first, gauge.second);
+		}
+	}
+	return out.str();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include "tools/FairShareScheduler.h"
+
+// Counters of the requests a server handled, written in the Prometheus text format.
+// Safe to share between threads.
+class ServerMetrics {
+public:
+	ServerMetrics();
+
+	// Records a request that was answered with the given status
+	void recordRequest(const std::string& endpoint, int status, double seconds, double audioSeconds);
+
+	// Requests being handled, and streaming sessions open
+	std::atomic<int> requestsInFlight { 0 };
+	std::atomic<int> openStreams { 0 };
+
+	// The metrics in the Prometheus text exposition format, along with the module's memory stats
+	// and the given stats of the tenants
+	std::string format(const std::vector<FairShareScheduler::TenantStats>& tenants) const;
+
+private:
+	struct Histogram {
+		std::vector<long long> counts;
+		long long count = 0;
+		double sum = 0;
+	};
+
+	mutable std::mutex mutex;
+	// Requests by endpoint and status
+	std::map<std::pair<std::string, int>, long long> requestCounts;
+	// Durations of the requests by endpoint, in seconds
+	std::map<std::string, Histogram> durations;
+	// Audio analyzed by endpoint, in seconds
+	std::map<std::string, double> audioSeconds;
+};
@@ -0,0 +1,511 @@
+// Native HTTP server for content pipelines.
+// Keeps the models loaded and decoders warm between requests, and analyzes the audio of all
+// requests through the same C API that the WASM module exports. The utterances of concurrent
+// requests are recognized on the process-wide thread pool, shared between the requests' tenants
+// by weighted fair queuing.
+
+#include <iostream>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <tclap/CmdLine.h>
+#include <format.h>
+#include <gsl_util.h>
+#include "bridge/bridge.h"
+#include "cli/analysisOptions.h"
+#include "cli/waveFiles.h"
+#include "core/appInfo.h"
+#include "exporters/CompactExporter.h"
+#include "server/HttpServer.h"
+#include "server/ServerMetrics.h"
+#include "tools/NiceCmdLineOutput.h"
+#include "tools/platformTools.h"
+#include "tools/stringTools.h"
+#include "tools/exceptions.h"
+#include "tools/FairShareScheduler.h"
+#include "tools/parallel.h"
+#include "tools/tools.h"
+
+using std::string;
+using std::vector;
+using std::runtime_error;
+using std::filesystem::path;
+
+namespace {
+
+	// Sample rate WAVE bodies are decoded to, that of the recognizers
+	constexpr int32_t wavSampleRate = 16000;
+
+	HttpServer* runningServer = nullptr;
+
+	void handleStopSignal(int) {
+		if (runningServer) runningServer->stop();
+	}
+
+	// Returns the bridge's error message for the last failed call
+	string getLastError(const string& fallback) {
+		const char* error = lipsyncengine_get_last_error();
+		return error && *error ? string(error) : fallback;
+	}
+
+	// The options of a request, given by query parameters named like the CLI's arguments
+	lipsyncengine_options getRequestOptions(const HttpConnection& connection) {
+		lipsyncengine_options options;
+		try {
+			options = getAnalysisOptions(
+				connection.getQuery("recognizer", "pocketSphinx"),
+				connection.getQuery("profile", "offline"),
+				connection.getQuery("dialogMode", "biased"),
+				connection.getQuery("extendedShapes"));
+		} catch (const std::invalid_argument& e) {
+			throw HttpError(400, e.what());
+		}
+		// Only used by streams
+		if (connection.hasQuery("maxRealTimeFactor")) {
+			try {
+				options.max_real_time_factor = std::stof(connection.getQuery("maxRealTimeFactor"));
+			} catch (const std::exception&) {}
+			if (!(options.max_real_time_factor > 0)) {
+				throw HttpError(400, "maxRealTimeFactor must be a positive number");
+			}
+		}
+		return options;
+	}
+
+	int32_t getSampleRate(const HttpConnection& connection) {
+		if (!connection.hasQuery("sampleRate")) {
+			throw HttpError(400, "The sampleRate parameter is required for PCM16 audio");
+		}
+		try {
+			const int sampleRate = std::stoi(connection.getQuery("sampleRate"));
+			if (sampleRate > 0) return sampleRate;
+		} catch (const std::exception&) {}
+		throw HttpError(400, "sampleRate must be a positive integer");
+	}
+
+	bool isWaveContentType(const string& contentType) {
+		for (const char* type : { "audio/wav", "audio/wave", "audio/x-wav", "audio/vnd.wave" }) {
+			if (contentType.compare(0, std::strlen(type), type) == 0) return true;
+		}
+		return false;
+	}
+
+	// Little-endian PCM16 samples of a body
+	vector<int16_t> toSamples(const char* bytes, size_t byteCount) {
+		vector<int16_t> samples(byteCount / 2);
+		for (size_t i = 0; i < samples.size(); ++i) {
+			samples[i] = static_cast<int16_t>(
+				static_cast<uint8_t>(bytes[2 * i]) | static_cast<uint8_t>(bytes[2 * i + 1]) << 8);
+		}
+		return samples;
+	}
+
+	// Puts the lines of a JSON result on one line, for newline-delimited JSON
+	string toJsonLine(const char* json) {
+		string result;
+		bool lineStart = false;
+		for (const char* c = json; *c; ++c) {
+			if (*c == '\n') {
+				lineStart = true;
+			} else if (!(lineStart && *c == ' ')) {
+				lineStart = false;
+				result += *c;
+			}
+		}
+		return result + "\n";
+	}
+
+	// Parses a --tenant value of the form name:weight[:maxRequests]
+	std::pair<string, FairShareScheduler::TenantOptions> parseTenantOptions(const string& value) {
+		vector<string> parts;
+		for (size_t start = 0;;) {
+			const size_t end = value.find(':', start);
+			parts.push_back(value.substr(start, end - start));
+			if (end == string::npos) break;
+			start = end + 1;
+		}
+		if (parts.size() < 2 || parts.size() > 3 || parts[0].empty()) {
+			throw std::invalid_argument(fmt::format(
+				"Invalid tenant '{}'; expected name:weight or name:weight:maxRequests.", value));
+		}
+		FairShareScheduler::TenantOptions options;
+		try {
+			options.weight = std::stod(parts[1]);
+			if (parts.size() == 3) options.maxRequests = std::stoi(parts[2]);
+		} catch (const std::exception&) {
+			throw std::invalid_argument(fmt::format("Invalid weight or request limit in tenant '{}'.", value));
+		}
+		return { parts[0], options };
+	}
+
+	// The tenant a request is on behalf of, from the X-Tenant header or the tenant parameter
+	string getTenantName(const HttpConnection& connection) {
+		const string header = connection.getHeader("x-tenant");
+		if (!header.empty()) return header;
+		return connection.getQuery("tenant", "default");
+	}
+
+	class Service {
+	public:
+		Service(size_t maxBodySize, int slotCount) :
+			maxBodySize(maxBodySize),
+			scheduler(slotCount)
+		{}
+
+		FairShareScheduler& getScheduler() {
+			return scheduler;
+		}
+
+		void handle(HttpConnection& connection) {
+			const string& route = connection.getPath();
+			if (route == "/health") {
+				connection.sendResponse(200, "text/plain", "ok\n");
+			} else if (route == "/metrics") {
+				connection.sendResponse(200, "text/plain; version=0.0.4", metrics.format(scheduler.getStats()));
+			} else if (route == "/analyze" || route == "/recognize" || route == "/stream") {
+				if (connection.getMethod() != "POST") {
+					throw HttpError(405, "Use POST");
+				}
+				const auto start = std::chrono::steady_clock::now();
+				FairShareScheduler::Tenant& tenant = scheduler.getTenant(getTenantName(connection));
+				if (!scheduler.tryBeginRequest(tenant)) {
+					finishRequest(route, 429, start, 0, false);
+					throw HttpError(429, "Too many requests of this tenant are being handled");
+				}
+				auto endRequest = gsl::finally([&] { scheduler.endRequest(tenant); });
+				// The utterances of the request take turns with those of other tenants
+				const FairShareScope fairShareScope(&tenant);
+				++metrics.requestsInFlight;
+				double audioSeconds = 0;
+				try {
+					audioSeconds = route == "/analyze" ? analyze(connection)
+						: route == "/recognize" ? recognize(connection)
+						: stream(connection);
+				} catch (const HttpError& e) {
+					finishRequest(route, e.getStatus(), start, 0);
+					throw;
+				} catch (...) {
+					finishRequest(route, 500, start, 0);
+					throw;
+				}
+				finishRequest(route, 200, start, audioSeconds);
+			} else {
+				throw HttpError(404, "Not found");
+			}
+		}
+
+	private:
+		void finishRequest(
+			const string& route, int status, std::chrono::steady_clock::time_point start, double audioSeconds,
+			bool inFlight = true)
+		{
+			if (inFlight) --metrics.requestsInFlight;
+			const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+			metrics.recordRequest(route.substr(1), status, duration.count(), audioSeconds);
+		}
+
+		// Reads a whole body of WAVE audio, decoded to wavSampleRate, or of little-endian PCM16 audio
+		// at the sampleRate parameter, along with the dialog text. The dialog is the dialog parameter
+		// or, with dialogBytes=n, the first n bytes of the body, which keeps long scripts out of the
+		// request line and its size limit.
+		Pcm16Audio readAudio(HttpConnection& connection, string& dialog) {
+			const bool isWave = isWaveContentType(connection.getHeader("content-type"));
+			Pcm16Audio audio;
+			audio.sampleRate = isWave ? wavSampleRate : getSampleRate(connection);
+			size_t dialogSize = 0;
+			if (connection.hasQuery("dialogBytes")) {
+				try {
+					dialogSize = std::stoul(connection.getQuery("dialogBytes"));
+				} catch (const std::exception&) {
+					throw HttpError(400, "dialogBytes must be a non-negative integer");
+				}
+			}
+			const string body = connection.readWholeBody(maxBodySize);
+			if (dialogSize > body.size()) {
+				throw HttpError(400, "dialogBytes exceeds the body");
+			}
+			dialog = connection.hasQuery("dialogBytes")
+				? body.substr(0, dialogSize)
+				: connection.getQuery("dialog");
+			const char* audioBytes = body.data() + dialogSize;
+			const size_t audioByteCount = body.size() - dialogSize;
+			if (isWave) {
+				int32_t sampleCount = 0;
+				const int16_t* decoded = lipsyncengine_decode_wav(
+					reinterpret_cast<const uint8_t*>(audioBytes), static_cast<int32_t>(audioByteCount),
+					wavSampleRate, &sampleCount);
+				if (!decoded) {
+					throw HttpError(415, getLastError("Unsupported WAVE file"));
+				}
+				audio.samples.assign(decoded, decoded + sampleCount);
+				lipsyncengine_free(decoded);
+			} else {
+				if (audioByteCount % 2) {
+					throw HttpError(400, "PCM16 audio must have an even number of bytes");
+				}
+				audio.samples = toSamples(audioBytes, audioByteCount);
+			}
+			if (audio.samples.empty()) {
+				throw HttpError(400, "The audio contains no samples");
+			}
+			return audio;
+		}
+
+		// Analyzes a whole body of WAVE or little-endian PCM16 audio, answering with the JSON of
+		// lipsyncengine_analyze_pcm16() or, with format=compact, a compact .lsc file.
+		// Returns the seconds of audio analyzed.
+		double analyze(HttpConnection& connection) {
+			const lipsyncengine_options options = getRequestOptions(connection);
+			const string format = connection.getQuery("format", "json");
+			if (format != "json" && format != "compact") {
+				throw HttpError(400, "format must be json or compact");
+			}
+			string dialog;
+			const Pcm16Audio audio = readAudio(connection, dialog);
+			const vector<int16_t>& samples = audio.samples;
+			const int32_t sampleRate = audio.sampleRate;
+
+			if (format == "compact") {
+				int32_t cueCount = 0;
+				const lipsyncengine_mouth_cue* cues = lipsyncengine_analyze_pcm16_binary(
+					samples.data(), static_cast<int32_t>(samples.size()), sampleRate,
+					dialog.empty() ? nullptr : dialog.c_str(), &options, &cueCount);
+				if (!cues) {
+					throw runtime_error(getLastError("Analysis failed."));
+				}
+				const lambda_unique_ptr<const lipsyncengine_mouth_cue> cuesGuard(
+					cues, [](const lipsyncengine_mouth_cue* p) { lipsyncengine_free(p); });
+				int32_t byteCount = 0;
+				const uint8_t* bytes = lipsyncengine_encode_cues(
+					cues, cueCount, CompactExporter::defaultSeekInterval, &byteCount);
+				if (!bytes) {
+					throw runtime_error(getLastError("Encoding failed."));
+				}
+				const lambda_unique_ptr<const uint8_t> bytesGuard(bytes, [](const uint8_t* p) { lipsyncengine_free(p); });
+				connection.sendResponse(200, "application/octet-stream",
+					string(reinterpret_cast<const char*>(bytes), static_cast<size_t>(byteCount)));
+			} else {
+				const char* json = lipsyncengine_analyze_pcm16(
+					samples.data(), static_cast<int32_t>(samples.size()), sampleRate,
+					dialog.empty() ? nullptr : dialog.c_str(), &options);
+				if (!json) {
+					throw runtime_error(getLastError("Analysis failed."));
+				}
+				const lambda_unique_ptr<const char> jsonGuard(json, [](const char* p) { lipsyncengine_free(p); });
+				connection.sendResponse(200, "application/json", json);
+			}
+			return static_cast<double>(samples.size()) / sampleRate;
+		}
+
+		// Recognizes the phones of a whole body of audio like analyze(), answering with the phones
+		// of lipsyncengine_recognize_pcm16(), e.g. for a coordinator that animates the phones of
+		// several segments of a recording at once.
+		// Returns the seconds of audio recognized.
+		double recognize(HttpConnection& connection) {
+			const lipsyncengine_options options = getRequestOptions(connection);
+			string dialog;
+			const Pcm16Audio audio = readAudio(connection, dialog);
+
+			int32_t byteCount = 0;
+			const uint8_t* phones = lipsyncengine_recognize_pcm16(
+				audio.samples.data(), static_cast<int32_t>(audio.samples.size()), audio.sampleRate,
+				dialog.empty() ? nullptr : dialog.c_str(), &options, &byteCount);
+			if (!phones) {
+				throw runtime_error(getLastError("Recognition failed."));
+			}
+			const lambda_unique_ptr<const uint8_t> phonesGuard(phones, [](const uint8_t* p) { lipsyncengine_free(p); });
+			connection.sendResponse(200, "application/octet-stream",
+				string(reinterpret_cast<const char*>(phones), static_cast<size_t>(byteCount)));
+			return static_cast<double>(audio.samples.size()) / audio.sampleRate;
+		}
+
+		// Analyzes a body of little-endian PCM16 audio as a streaming session while it arrives,
+		// answering with newline-delimited JSON: a result of lipsyncengine_stream_poll() whenever
+		// cues are finalized, and that of lipsyncengine_stream_end() last.
+		// Returns the seconds of audio analyzed.
+		double stream(HttpConnection& connection) {
+			const lipsyncengine_options options = getRequestOptions(connection);
+			const int32_t sampleRate = getSampleRate(connection);
+			const string dialog = connection.getQuery("dialog");
+
+			// Streaming sessions share their engine's scheduler, so calls into them take turns
+			int32_t stream;
+			{
+				std::lock_guard<std::mutex> lock(streamMutex);
+				stream = lipsyncengine_stream_begin(sampleRate, dialog.empty() ? nullptr : dialog.c_str(), &options);
+			}
+			if (stream < 0) {
+				throw HttpError(400, getLastError("Could not begin the stream"));
+			}
+			++metrics.openStreams;
+			connection.beginChunkedResponse(200, "application/x-ndjson");
+
+			size_t sampleCount = 0;
+			bool ended = false;
+			try {
+				// Holds the odd byte of a sample split between reads
+				vector<char> buffer(64 * 1024 + 1);
+				size_t carry = 0;
+				while (const size_t count = connection.readBody(buffer.data() + carry, buffer.size() - 1 - carry)) {
+					const size_t byteCount = carry + count;
+					const vector<int16_t> samples = toSamples(buffer.data(), byteCount);
+					carry = byteCount % 2;
+					if (carry) buffer[0] = buffer[byteCount - 1];
+					if (samples.empty()) continue;
+
+					sampleCount += samples.size();
+					string line;
+					{
+						std::lock_guard<std::mutex> lock(streamMutex);
+						if (lipsyncengine_stream_push(stream, samples.data(), static_cast<int32_t>(samples.size())) != 0) {
+							throw runtime_error(getLastError("Analysis failed."));
+						}
+						const char* json = lipsyncengine_stream_poll(stream);
+						if (!json) {
+							throw runtime_error(getLastError("Analysis failed."));
+						}
+						const lambda_unique_ptr<const char> jsonGuard(json, [](const char* p) { lipsyncengine_free(p); });
+						if (std::strstr(json, "\"mouthCues\": []") == nullptr) {
+							line = toJsonLine(json);
+						}
+					}
+					connection.writeChunk(line);
+				}
+
+				string line;
+				{
+					std::lock_guard<std::mutex> lock(streamMutex);
+					ended = true;
+					const char* json = lipsyncengine_stream_end(stream);
+					if (!json) {
+						throw runtime_error(getLastError("Analysis failed."));
+					}
+					const lambda_unique_ptr<const char> jsonGuard(json, [](const char* p) { lipsyncengine_free(p); });
+					line = toJsonLine(json);
+				}
+				connection.writeChunk(line);
+				connection.endChunkedResponse();
+			} catch (const std::exception& e) {
+				if (!ended) {
+					std::lock_guard<std::mutex> lock(streamMutex);
+					lipsyncengine_free(lipsyncengine_stream_end(stream));
+				}
+				--metrics.openStreams;
+				// The status has been sent, so the error ends the response instead
+				try {
+					connection.writeChunk(fmt::format("{{\"error\": \"{}\"}}\n", escapeJsonString(e.what())));
+					connection.endChunkedResponse();
+				} catch (const std::exception&) {}
+				throw;
+			}
+			--metrics.openStreams;
+			return static_cast<double>(sampleCount) / sampleRate;
+		}
+
+		size_t maxBodySize;
+		FairShareScheduler scheduler;
+		ServerMetrics metrics;
+		std::mutex streamMutex;
+	};
+
+}
+
+int main(int platformArgc, char* platformArgv[]) {
+	NiceCmdLineOutput cmdLineOutput;
+	TCLAP::CmdLine cmd(appName, ' ', appVersion);
+	cmd.setOutput(&cmdLineOutput);
+	cmd.setExceptionHandling(false);
+
+	TCLAP::ValueArg<string> modelDirectory(
+		"", "models", "The directory containing the speech recognition models. "
+		"Defaults to res/sphinx next to the executable.",
+		false, string(), "path", cmd);
+	TCLAP::ValueArg<string> host(
+		"", "host", "The address to listen on. Use 0.0.0.0 to accept connections from other machines.",
+		false, "127.0.0.1", "address", cmd);
+	TCLAP::ValueArg<int> port(
+		"p", "port", "The port to listen on.",
+		false, 8080, "number", cmd);
+	TCLAP::ValueArg<int> threadCount(
+		"", "threads", "The maximum number of threads recognizing the utterances of one request. "
+		"Defaults to the number of processor cores.",
+		false, 0, "number", cmd);
+	TCLAP::ValueArg<int> connectionCount(
+		"", "connections", "The number of requests handled at once; more wait for their turn. "
+		"Defaults to twice the number of processor cores.",
+		false, 0, "number", cmd);
+	TCLAP::ValueArg<int> prewarmCount(
+		"", "prewarm", "The number of pocketSphinx decoders to create at startup, about 80 MB each. "
+		"Defaults to the thread count.",
+		false, -1, "number", cmd);
+	TCLAP::ValueArg<double> maxBodyMegabytes(
+		"", "maxBodySize", "The largest audio body accepted by /analyze, in megabytes.",
+		false, 256, "megabytes", cmd);
+	TCLAP::MultiArg<string> tenants(
+		"", "tenant", "The share of the recognition threads of a tenant, given by the X-Tenant header "
+		"or the tenant parameter of requests, as name:weight[:maxRequests]. While several tenants have "
+		"utterances waiting, each gets threads in proportion to its weight; with maxRequests, further "
+		"requests of the tenant are refused with status 429. Other tenants, including 'default' for "
+		"requests naming none, have weight 1 and no limit. Can be repeated.",
+		false, "name:weight", cmd);
+
+	try {
+		cmd.parse(platformArgc, platformArgv);
+	} catch (TCLAP::ArgException& e) {
+		cmdLineOutput.failure(cmd, e);
+		return 1;
+	} catch (const TCLAP::ExitException& e) {
+		return e.getExitStatus();
+	}
+
+	try {
+		if (threadCount.isSet() && threadCount.getValue() < 1) {
+			throw std::invalid_argument(fmt::format("Thread count must be 1 or higher; got {}.", threadCount.getValue()));
+		}
+		if (connectionCount.isSet() && connectionCount.getValue() < 1) {
+			throw std::invalid_argument(fmt::format("Connection count must be 1 or higher; got {}.", connectionCount.getValue()));
+		}
+		const int maxThreadCount = threadCount.isSet() ? threadCount.getValue() : getProcessorCoreCount();
+
+		const path models = modelDirectory.isSet()
+			? path(modelDirectory.getValue())
+			: getBinDirectory() / "res" / "sphinx";
+		if (!exists(models / "acoustic-model")) {
+			throw runtime_error(fmt::format("No speech recognition models found in {}.", models.u8string()));
+		}
+		if (lipsyncengine_init(models.u8string().c_str()) != 0) {
+			throw runtime_error(getLastError("Initialization failed."));
+		}
+		lipsyncengine_set_max_thread_count(maxThreadCount);
+		const int decoderCount = prewarmCount.getValue() >= 0 ? prewarmCount.getValue() : maxThreadCount;
+		if (decoderCount > 0 && lipsyncengine_prewarm(decoderCount, nullptr) != 0) {
+			throw runtime_error(getLastError("Creating decoders failed."));
+		}
+
+		Service service(static_cast<size_t>(maxBodyMegabytes.getValue() * 1024 * 1024), maxThreadCount);
+		for (const string& tenant : tenants.getValue()) {
+			const auto options = parseTenantOptions(tenant);
+			service.getScheduler().setTenantOptions(options.first, options.second);
+		}
+		HttpServer server(
+			host.getValue(),
+			port.getValue(),
+			connectionCount.isSet() ? connectionCount.getValue() : 2 * getProcessorCoreCount(),
+			[&](HttpConnection& connection) { service.handle(connection); });
+
+		// Clients that disconnect early make writes fail instead of ending the process
+		std::signal(SIGPIPE, SIG_IGN);
+		runningServer = &server;
+		std::signal(SIGINT, handleStopSignal);
+		std::signal(SIGTERM, handleStopSignal);
+		std::cerr << fmt::format("Listening on {}:{}\n", host.getValue(), server.getPort());
+		server.run();
+		runningServer = nullptr;
+
+		lipsyncengine_cleanup();
+		return 0;
+	} catch (const std::exception& e) {
+		std::cerr << getMessage(e) << std::endl;
+		return 1;
+	}
+}
@@ -23,6 +23,7 @@ public:
 	BoundedTimeline(TimeRange range, InputIterator first, InputIterator last) :
 		range(range)
 	{
+		this->reserveFor(first, last);
 		for (auto it = first; it != last; ++it) {
 			// Virtual function call in constructor. Derived constructors shouldn't call this one!
 			BoundedTimeline::set(*it);
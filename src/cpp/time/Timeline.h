@@ -1,8 +1,10 @@
 #pragma once
 #include "Timed.h"
-#include <set>
+#include <vector>
+#include <algorithm>
 #include <compat/boost_compat.h>
 #include <type_traits>
+#include <iterator>
 #include "tools/tools.h"
 
 enum class FindMode {
@@ -49,10 +51,12 @@ private:
 	};
 
 public:
-	using set_type = std::set<Timed<T>, compare>;
+	// Elements are kept sorted by start time in contiguous storage.
+	// Unlike with a node-based set, modifying the timeline invalidates all iterators.
+	using set_type = std::vector<Timed<T>>;
 	using const_iterator = typename set_type::const_iterator;
 	using iterator = const_iterator;
-	using reverse_iterator = typename set_type::reverse_iterator;
+	using reverse_iterator = typename set_type::const_reverse_iterator;
 	using size_type = size_t;
 	using value_type = Timed<T>;
 	using reference = const value_type&;
@@ -104,6 +108,7 @@ public:
 
 	template<typename InputIterator>
 	Timeline(InputIterator first, InputIterator last) {
+		reserveFor(first, last);
 		for (auto it = first; it != last; ++it) {
 			// Virtual function call in constructor. Derived constructors don't call this one.
 			Timeline::set(*it);
@@ -129,6 +134,11 @@ public:
 		return elements.size();
 	}
 
+	// Makes room for count elements, e.g. before appending them in time order
+	void reserve(size_type count) {
+		elements.reserve(count);
+	}
+
 	virtual TimeRange getRange() const {
 		return empty()
 			? TimeRange(time_type::zero(), time_type::zero())
@@ -166,7 +176,7 @@ public:
 			case FindMode::SearchLeft:
 			{
 				// Get first element starting >= time
-				iterator it = elements.lower_bound(time);
+				iterator it = lowerBound(time);
 
 				// Go one element back
 				return it != begin() ? --it : end();
@@ -174,7 +184,7 @@ public:
 			case FindMode::SearchRight:
 			{
 				// Get first element starting > time
-				iterator it = elements.upper_bound(time);
+				iterator it = upperBound(time);
 
 				// Go one element back
 				if (it != begin()) {
@@ -219,6 +229,20 @@ public:
 			return end();
 		}
 
+		// Most timelines are built in time order. Appending needs neither searches nor splits.
+		if (elements.empty() || timedValue.getStart() >= elements.back().getEnd()) {
+			if (
+				AutoJoin && !elements.empty()
+				&& timedValue.getStart() == elements.back().getEnd()
+				&& ::internal::valueEquals(elements.back(), timedValue)
+			) {
+				elements.back().getTimeRange().resize(elements.back().getStart(), timedValue.getEnd());
+			} else {
+				elements.push_back(std::move(timedValue));
+			}
+			return std::prev(elements.cend());
+		}
+
 		if (AutoJoin) {
 			// Extend the timed value if it touches elements with equal value
 			iterator elementBefore = find(timedValue.getStart(), FindMode::SampleLeft);
@@ -231,11 +255,21 @@ public:
 			}
 		}
 
-		// Erase overlapping elements
-		Timeline::clear(timedValue.getTimeRange());
+		// Split overlapping elements
+		const TimeRange& range = timedValue.getTimeRange();
+		splitAt(range.getStart());
+		splitAt(range.getEnd());
 
-		// Add timed value
-		return elements.insert(timedValue).first;
+		// Replace overlapping elements with the timed value, moving the remaining elements only once
+		const iterator first = find(range.getStart(), FindMode::SearchRight);
+		const iterator last = find(range.getEnd(), FindMode::SearchRight);
+		if (first == last) {
+			return elements.insert(first, std::move(timedValue));
+		}
+		const auto position = elements.begin() + (first - elements.cbegin());
+		*position = std::move(timedValue);
+		elements.erase(std::next(position), last);
+		return position;
 	}
 
 	template<typename TElement = T>
@@ -273,35 +307,42 @@ public:
 	// Combines adjacent equal elements into one
 	template<bool autoJoin = AutoJoin, typename = std::enable_if_t<!autoJoin>>
 	void joinAdjacent() {
-		Timeline copy(*this);
-		for (auto it = copy.begin(); it != copy.end(); ++it) {
-			const auto rangeBegin = it;
-			auto rangeEnd = std::next(rangeBegin);
-			while (rangeEnd != copy.end()
-				&& rangeEnd->getStart() == rangeBegin->getEnd()
-				&& ::internal::valueEquals(*rangeEnd, *rangeBegin)
-			) {
-				++rangeEnd;
-			}
+		joinAdjacentElements();
+	}
 
-			if (rangeEnd != std::next(rangeBegin)) {
-				Timed<T> combined = *rangeBegin;
-				combined.setTimeRange({ rangeBegin->getStart(), rangeEnd->getEnd() });
-				set(combined);
-				it = rangeEnd;
-			}
+	// Replaces the value of each element with function(iterator), in a single sweep over the
+	// elements rather than one set() per element. The function sees the original values of the
+	// element and its neighbors. Elements keep their time ranges; if AutoJoin is set, elements
+	// that end up equal to their neighbors are joined afterwards.
+	template<
+		typename TFunction,
+		typename TElement = T,
+		typename = std::enable_if_t<!std::is_void<TElement>::value>
+	>
+	void transformValues(TFunction&& function) {
+		if (elements.empty()) return;
+
+		// Hold back each new value until the function has seen the following element
+		T pendingValue = function(elements.cbegin());
+		for (auto it = std::next(elements.begin()); it != elements.end(); ++it) {
+			T value = function(const_iterator(it));
+			std::prev(it)->setValue(pendingValue);
+			pendingValue = std::move(value);
+		}
+		elements.back().setValue(pendingValue);
+
+		if (AutoJoin) {
+			joinAdjacentElements();
 		}
 	}
 
 	virtual void shift(time_type offset) {
 		if (offset == time_type::zero()) return;
 
-		set_type newElements;
-		for (Timed<T> element : elements) {
+		// Shifting all elements keeps their order
+		for (Timed<T>& element : elements) {
 			element.getTimeRange().shift(offset);
-			newElements.insert(element);
 		}
-		elements = std::move(newElements);
 	}
 
 	Timeline(const Timeline&) = default;
@@ -322,19 +363,50 @@ protected:
 		return elements == rhs.elements;
 	}
 
+protected:
+	template<typename InputIterator>
+	void reserveFor(InputIterator first, InputIterator last) {
+		using category = typename std::iterator_traits<InputIterator>::iterator_category;
+		if constexpr (std::is_base_of<std::forward_iterator_tag, category>::value) {
+			elements.reserve(elements.size() + static_cast<size_type>(std::distance(first, last)));
+		}
+	}
+
 private:
+	iterator lowerBound(time_type time) const {
+		return std::lower_bound(elements.begin(), elements.end(), time, compare());
+	}
+
+	iterator upperBound(time_type time) const {
+		return std::upper_bound(elements.begin(), elements.end(), time, compare());
+	}
+
+	// Combines touching equal elements in one pass, moving each remaining element at most once
+	void joinAdjacentElements() {
+		if (elements.empty()) return;
+
+		auto last = elements.begin();
+		for (auto it = std::next(elements.begin()); it != elements.end(); ++it) {
+			if (it->getStart() == last->getEnd() && ::internal::valueEquals(*it, *last)) {
+				last->getTimeRange().resize(last->getStart(), it->getEnd());
+			} else if (++last != it) {
+				*last = std::move(*it);
+			}
+		}
+		elements.erase(std::next(last), elements.end());
+	}
+
 	void splitAt(time_type splitTime) {
 		iterator elementBefore = find(splitTime - time_type(1));
 		iterator elementAfter = find(splitTime);
 		if (elementBefore != elementAfter || elementBefore == end()) return;
-		
-		Timed<T> first = *elementBefore;
-		Timed<T> second = *elementBefore;
-		elements.erase(elementBefore);
-		first.getTimeRange().resize(first.getStart(), splitTime);
-		elements.insert(first);
+
+		// Shorten the element in place and insert its second half after it
+		const auto first = elements.begin() + (elementBefore - elements.cbegin());
+		Timed<T> second = *first;
 		second.getTimeRange().resize(splitTime, second.getEnd());
-		elements.insert(second);
+		first->getTimeRange().resize(first->getStart(), splitTime);
+		elements.insert(std::next(first), std::move(second));
 	}
 
 	set_type elements;
@@ -0,0 +1,173 @@
+#include "AnalysisStats.h"
+#include "tracing.h"
+#include <algorithm>
+
+using std::string;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+namespace {
+	thread_local AnalysisStats* currentStats = nullptr;
+
+	std::atomic<bool> stageAllocationTracking(false);
+	// The allocations of the current thread's innermost running stage, if they are tracked
+	thread_local StageAllocations* currentAllocations = nullptr;
+
+	void raiseToMax(std::atomic<int64_t>& maximum, int64_t value) {
+		int64_t current = maximum.load(std::memory_order_relaxed);
+		while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+	}
+}
+
+AnalysisStageConverter& AnalysisStageConverter::get() {
+	static AnalysisStageConverter converter;
+	return converter;
+}
+
+string AnalysisStageConverter::getTypeName() {
+	return "AnalysisStage";
+}
+
+EnumConverter<AnalysisStage>::member_data AnalysisStageConverter::getMemberData() {
+	return member_data {
+		{ AnalysisStage::DcRemoval, "dcRemoval" },
+		{ AnalysisStage::Resampling, "resampling" },
+		{ AnalysisStage::VoiceActivityDetection, "voiceActivityDetection" },
+		{ AnalysisStage::FeatureExtraction, "featureExtraction" },
+		{ AnalysisStage::WordRecognition, "wordRecognition" },
+		{ AnalysisStage::Alignment, "alignment" },
+		{ AnalysisStage::ShapeRules, "shapeRules" },
+		{ AnalysisStage::RoughAnimation, "roughAnimation" },
+		{ AnalysisStage::TimingOptimization, "timingOptimization" },
+		{ AnalysisStage::PauseAnimation, "pauseAnimation" },
+		{ AnalysisStage::Tweening, "tweening" },
+		{ AnalysisStage::TargetShapeConversion, "targetShapeConversion" },
+		{ AnalysisStage::Export, "export" }
+	};
+}
+
+AnalysisStats::AnalysisStats() {
+	for (auto& duration : durations) duration = 0;
+	for (auto& count : counts) count = 0;
+	for (auto& count : allocationCounts) count = 0;
+	for (auto& bytes : allocatedBytes) bytes = 0;
+	for (auto& bytes : peakLiveBytes) bytes = 0;
+}
+
+void AnalysisStats::addDuration(AnalysisStage stage, nanoseconds duration) {
+	durations[static_cast<size_t>(stage)] += duration.count();
+}
+
+void AnalysisStats::addCount(AnalysisCounter counter, int64_t count) {
+	counts[static_cast<size_t>(counter)] += count;
+}
+
+void AnalysisStats::addAllocations(AnalysisStage stage, const StageAllocations& allocations) {
+	const size_t index = static_cast<size_t>(stage);
+	allocationCounts[index] += allocations.count;
+	allocatedBytes[index] += allocations.bytes;
+	raiseToMax(peakLiveBytes[index], allocations.peakLiveBytes);
+}
+
+nanoseconds AnalysisStats::getDuration(AnalysisStage stage) const {
+	return nanoseconds(durations[static_cast<size_t>(stage)].load());
+}
+
+int64_t AnalysisStats::getCount(AnalysisCounter counter) const {
+	return counts[static_cast<size_t>(counter)].load();
+}
+
+StageAllocations AnalysisStats::getAllocations(AnalysisStage stage) const {
+	const size_t index = static_cast<size_t>(stage);
+	StageAllocations allocations;
+	allocations.count = allocationCounts[index].load();
+	allocations.bytes = allocatedBytes[index].load();
+	allocations.peakLiveBytes = peakLiveBytes[index].load();
+	return allocations;
+}
+
+AnalysisStats* AnalysisStats::getCurrent() {
+	return currentStats;
+}
+
+AnalysisStatsScope::AnalysisStatsScope(AnalysisStats* stats) :
+	previousStats(currentStats)
+{
+	currentStats = stats;
+}
+
+AnalysisStatsScope::~AnalysisStatsScope() {
+	currentStats = previousStats;
+}
+
+// The names of the stages, which trace spans keep pointers to
+static const char* getStageName(AnalysisStage stage) {
+	static const auto names = [] {
+		std::array<string, static_cast<size_t>(AnalysisStage::EndSentinel)> result;
+		for (size_t i = 0; i < result.size(); ++i) {
+			result[i] = AnalysisStageConverter::get().toString(static_cast<AnalysisStage>(i));
+		}
+		return result;
+	}();
+	return names[static_cast<size_t>(stage)].c_str();
+}
+
+StageTimer::StageTimer(AnalysisStage stage) :
+	stats(currentStats),
+	stage(stage),
+	tracing(isTracingEnabled()),
+	trackingAllocations(stats && stageAllocationTracking.load(std::memory_order_relaxed)),
+	outerAllocations(currentAllocations)
+{
+	// Don't even read the clock unless stats are collected or spans traced
+	if (stats || tracing) {
+		start = steady_clock::now();
+	}
+	if (trackingAllocations) {
+		currentAllocations = &allocations;
+	}
+}
+
+StageTimer::~StageTimer() {
+	if (trackingAllocations) {
+		currentAllocations = outerAllocations;
+		stats->addAllocations(stage, allocations);
+	}
+	if (!stats && !tracing) return;
+
+	const steady_clock::time_point end = steady_clock::now();
+	if (stats) {
+		stats->addDuration(stage, end - start);
+	}
+	if (tracing) {
+		recordTraceSpan(getStageName(stage), "stage", start, end);
+	}
+}
+
+void countEvent(AnalysisCounter counter, int64_t count) {
+	if (currentStats) {
+		currentStats->addCount(counter, count);
+	}
+}
+
+void setStageAllocationTracking(bool enabled) {
+	stageAllocationTracking = enabled;
+}
+
+void countStageAllocation(size_t size) {
+	StageAllocations* allocations = currentAllocations;
+	if (!allocations) return;
+
+	++allocations->count;
+	allocations->bytes += static_cast<int64_t>(size);
+	allocations->liveBytes += static_cast<int64_t>(size);
+	allocations->peakLiveBytes = std::max(allocations->peakLiveBytes, allocations->liveBytes);
+}
+
+void countStageDeallocation(size_t size) {
+	StageAllocations* allocations = currentAllocations;
+	if (!allocations) return;
+
+	// Memory allocated before the stage may be freed during it, so the live size can go negative
+	allocations->liveBytes -= static_cast<int64_t>(size);
+}
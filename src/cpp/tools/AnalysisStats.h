@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "EnumConverter.h"
+
+// The stages of an analysis whose duration is measured
+enum class AnalysisStage {
+	// Estimating the DC offset in a pass of its own. Batch analyses estimate it while the resampled
+	// audio is buffered, which counts towards Resampling.
+	DcRemoval,
+	// Includes estimating and applying the DC offset, which happen while the resampled audio is buffered
+	Resampling,
+	// Includes the energy gate that skips long silences before voice activity detection
+	VoiceActivityDetection,
+	FeatureExtraction,
+	// Recognition of words, of phones by the phonetic recognizer, or of phone classes by the frame
+	// classifier
+	WordRecognition,
+	Alignment,
+	// Animation passes
+	ShapeRules,
+	RoughAnimation,
+	TimingOptimization,
+	PauseAnimation,
+	Tweening,
+	TargetShapeConversion,
+	Export,
+
+	EndSentinel
+};
+
+class AnalysisStageConverter : public EnumConverter<AnalysisStage> {
+public:
+	static AnalysisStageConverter& get();
+protected:
+	std::string getTypeName() override;
+	member_data getMemberData() override;
+};
+
+// Events counted during an analysis
+enum class AnalysisCounter {
+	Utterances,
+	// Cepstral frames searched by word or phone recognition
+	DecodedFrames,
+	// HMMs evaluated by word or phone recognition
+	HmmEvaluations,
+	// Decoders reused from the pool vs. newly created
+	DecoderCacheHits,
+	DecoderCacheMisses,
+	// Dialog language models reused from the cache vs. newly built
+	DialogModelCacheHits,
+	DialogModelCacheMisses,
+	// Utterances whose phones were reused from earlier analyses vs. recognized
+	UtteranceCacheHits,
+	UtteranceCacheMisses,
+
+	EndSentinel
+};
+
+// Heap allocations made during a stage
+struct StageAllocations {
+	int64_t count = 0;
+	int64_t bytes = 0;
+	// The most memory allocated and not yet freed at any one time during a single run of the stage
+	// on one thread
+	int64_t peakLiveBytes = 0;
+	// The memory allocated and not yet freed so far, while the stage runs
+	int64_t liveBytes = 0;
+};
+
+// Durations and counts collected during an analysis.
+// Threads working on the same analysis add to the same stats, so durations are summed over threads.
+class AnalysisStats {
+public:
+	AnalysisStats();
+	AnalysisStats(const AnalysisStats&) = delete;
+	AnalysisStats& operator=(const AnalysisStats&) = delete;
+
+	void addDuration(AnalysisStage stage, std::chrono::nanoseconds duration);
+	void addCount(AnalysisCounter counter, int64_t count);
+	void addAllocations(AnalysisStage stage, const StageAllocations& allocations);
+
+	std::chrono::nanoseconds getDuration(AnalysisStage stage) const;
+	int64_t getCount(AnalysisCounter counter) const;
+	StageAllocations getAllocations(AnalysisStage stage) const;
+
+	// Returns the stats collected by the current thread, or nullptr if it doesn't collect any
+	static AnalysisStats* getCurrent();
+
+private:
+	using stage_array = std::array<std::atomic<int64_t>, static_cast<size_t>(AnalysisStage::EndSentinel)>;
+	using count_array = std::array<std::atomic<int64_t>, static_cast<size_t>(AnalysisCounter::EndSentinel)>;
+
+	stage_array durations;
+	count_array counts;
+	stage_array allocationCounts;
+	stage_array allocatedBytes;
+	stage_array peakLiveBytes;
+};
+
+// Makes the current thread collect the specified stats (or none, for nullptr) for its lifetime
+class AnalysisStatsScope {
+public:
+	explicit AnalysisStatsScope(AnalysisStats* stats);
+	~AnalysisStatsScope();
+	AnalysisStatsScope(const AnalysisStatsScope&) = delete;
+	AnalysisStatsScope& operator=(const AnalysisStatsScope&) = delete;
+
+private:
+	AnalysisStats* previousStats;
+};
+
+// Adds its lifetime to the duration of a stage in the current thread's stats, if any, and records
+// it as a trace span if tracing is enabled.
+// If stage allocations are tracked, also adds the current thread's heap allocations during its
+// lifetime, except those of nested stages.
+class StageTimer {
+public:
+	explicit StageTimer(AnalysisStage stage);
+	~StageTimer();
+	StageTimer(const StageTimer&) = delete;
+	StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+	AnalysisStats* stats;
+	AnalysisStage stage;
+	bool tracing;
+	std::chrono::steady_clock::time_point start;
+	bool trackingAllocations;
+	StageAllocations allocations;
+	StageAllocations* outerAllocations;
+};
+
+// Calls the function, adding the time it takes to the duration of the stage
+template<typename TFunction>
+auto measureStage(AnalysisStage stage, TFunction&& function) {
+	StageTimer timer(stage);
+	return function();
+}
+
+// Adds to a counter of the current thread's stats, if any
+void countEvent(AnalysisCounter counter, int64_t count = 1);
+
+// Attributes heap allocations to the stages of analyses collecting stats. Only takes effect in
+// builds whose allocation functions report to countStageAllocation() and
+// countStageDeallocation() (see benchmark/heapTracking.cpp). Off by default.
+void setStageAllocationTracking(bool enabled);
+
+// Adds an allocation or deallocation of the current thread to its innermost running stage, if
+// any. Called from the allocation functions, so they must not allocate.
+void countStageAllocation(size_t size);
+void countStageDeallocation(size_t size);
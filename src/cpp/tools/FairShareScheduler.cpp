@@ -0,0 +1,246 @@
+#include "FairShareScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+#include <format.h>
+
+using std::string;
+using std::vector;
+using std::lock_guard;
+using std::unique_lock;
+using std::chrono::steady_clock;
+
+struct FairShareScheduler::Tenant {
+	Tenant(FairShareScheduler& scheduler, string name) :
+		scheduler(scheduler),
+		name(std::move(name))
+	{}
+
+	FairShareScheduler& scheduler;
+	const string name;
+	TenantOptions options;
+
+	// CPU time charged to the tenant divided by its weight. Slots go to the waiting tenant with the
+	// lowest. A tenant starting to wait after being idle catches up with the busy ones, so that
+	// idle time doesn't turn into credit.
+	double virtualSeconds = 0;
+	// The CPU time of the tenant's recent tasks, charged when a task starts and corrected when it
+	// ends, so that a tenant's running tasks count against it right away
+	double expectedTaskSeconds = 0;
+	int runningTaskCount = 0;
+	// Tickets of the waiting tasks, oldest first
+	std::deque<uint64_t> waitingTickets;
+	int requestCount = 0;
+
+	long long rejectedRequestCount = 0;
+	long long taskCount = 0;
+	double cpuSeconds = 0;
+	double waitSeconds = 0;
+};
+
+namespace {
+	thread_local FairShareScheduler::Tenant* currentTenant = nullptr;
+	// Whether the current thread holds a slot
+	thread_local bool holdingSlot = false;
+
+	// Weight of a task's CPU time in the tenant's expected task time
+	constexpr double expectedTaskSmoothing = 0.2;
+
+	double getThreadCpuSeconds() {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+		timespec time;
+		if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) == 0) {
+			return time.tv_sec + time.tv_nsec * 1e-9;
+		}
+#endif
+		// Without a CPU clock, the time the task took
+		return std::chrono::duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+FairShareScheduler::FairShareScheduler(int slotCount) :
+	slotCount(slotCount)
+{
+	if (slotCount < 1) {
+		throw std::invalid_argument(fmt::format("slotCount cannot be {}.", slotCount));
+	}
+}
+
+FairShareScheduler::~FairShareScheduler() = default;
+
+void FairShareScheduler::setTenantOptions(const string& name, TenantOptions options) {
+	if (!(options.weight > 0)) {
+		throw std::invalid_argument(fmt::format("The weight of tenant {} must be positive.", name));
+	}
+	if (options.maxRequests < 0) {
+		throw std::invalid_argument(fmt::format("The request limit of tenant {} cannot be negative.", name));
+	}
+	Tenant& tenant = getTenant(name);
+	lock_guard<std::mutex> lock(mutex);
+	tenant.options = options;
+}
+
+FairShareScheduler::Tenant& FairShareScheduler::getTenant(const string& name) {
+	lock_guard<std::mutex> lock(mutex);
+	std::unique_ptr<Tenant>& tenant = tenants[name];
+	if (!tenant) {
+		tenant = std::make_unique<Tenant>(*this, name);
+	}
+	return *tenant;
+}
+
+bool FairShareScheduler::tryBeginRequest(Tenant& tenant) {
+	lock_guard<std::mutex> lock(mutex);
+	if (tenant.options.maxRequests > 0 && tenant.requestCount >= tenant.options.maxRequests) {
+		++tenant.rejectedRequestCount;
+		return false;
+	}
+	++tenant.requestCount;
+	return true;
+}
+
+void FairShareScheduler::endRequest(Tenant& tenant) {
+	lock_guard<std::mutex> lock(mutex);
+	--tenant.requestCount;
+}
+
+FairShareScheduler::Tenant* FairShareScheduler::getNextTenant() const {
+	if (usedSlotCount >= slotCount) return nullptr;
+
+	// The lowest virtual time; on ties, the fewest running tasks per weight, then the oldest task
+	Tenant* next = nullptr;
+	for (const auto& entry : tenants) {
+		Tenant& tenant = *entry.second;
+		if (tenant.waitingTickets.empty()) continue;
+		if (!next) {
+			next = &tenant;
+			continue;
+		}
+		const double load = tenant.runningTaskCount / tenant.options.weight;
+		const double nextLoad = next->runningTaskCount / next->options.weight;
+		if (tenant.virtualSeconds < next->virtualSeconds
+			|| (tenant.virtualSeconds == next->virtualSeconds
+				&& (load < nextLoad
+					|| (load == nextLoad && tenant.waitingTickets.front() < next->waitingTickets.front())))
+		) {
+			next = &tenant;
+		}
+	}
+	return next;
+}
+
+void FairShareScheduler::acquireSlot(Tenant& tenant) {
+	const auto start = steady_clock::now();
+	unique_lock<std::mutex> lock(mutex);
+
+	if (tenant.runningTaskCount == 0 && tenant.waitingTickets.empty()) {
+		double busyVirtualSeconds = std::numeric_limits<double>::infinity();
+		for (const auto& entry : tenants) {
+			const Tenant& other = *entry.second;
+			if (other.runningTaskCount > 0 || !other.waitingTickets.empty()) {
+				busyVirtualSeconds = std::min(busyVirtualSeconds, other.virtualSeconds);
+			}
+		}
+		if (busyVirtualSeconds != std::numeric_limits<double>::infinity()) {
+			tenant.virtualSeconds = std::max(tenant.virtualSeconds, busyVirtualSeconds);
+		}
+	}
+
+	const uint64_t ticket = nextTicket++;
+	tenant.waitingTickets.push_back(ticket);
+	slotsChanged.wait(lock, [&] {
+		return getNextTenant() == &tenant && tenant.waitingTickets.front() == ticket;
+	});
+
+	tenant.waitingTickets.pop_front();
+	++tenant.runningTaskCount;
+	++usedSlotCount;
+	tenant.virtualSeconds += tenant.expectedTaskSeconds / tenant.options.weight;
+	tenant.waitSeconds += std::chrono::duration<double>(steady_clock::now() - start).count();
+	lock.unlock();
+	// Another slot may be free for the next waiting task
+	slotsChanged.notify_all();
+}
+
+void FairShareScheduler::releaseSlot(Tenant& tenant, double cpuSeconds) {
+	{
+		lock_guard<std::mutex> lock(mutex);
+		--tenant.runningTaskCount;
+		--usedSlotCount;
+		tenant.virtualSeconds += (cpuSeconds - tenant.expectedTaskSeconds) / tenant.options.weight;
+		tenant.expectedTaskSeconds += expectedTaskSmoothing * (cpuSeconds - tenant.expectedTaskSeconds);
+		++tenant.taskCount;
+		tenant.cpuSeconds += cpuSeconds;
+	}
+	slotsChanged.notify_all();
+}
+
+void FairShareScheduler::discardSlot(Tenant& tenant) {
+	{
+		lock_guard<std::mutex> lock(mutex);
+		--tenant.runningTaskCount;
+		--usedSlotCount;
+		tenant.virtualSeconds -= tenant.expectedTaskSeconds / tenant.options.weight;
+	}
+	slotsChanged.notify_all();
+}
+
+vector<FairShareScheduler::TenantStats> FairShareScheduler::getStats() const {
+	lock_guard<std::mutex> lock(mutex);
+	vector<TenantStats> stats;
+	for (const auto& entry : tenants) {
+		const Tenant& tenant = *entry.second;
+		stats.push_back({
+			tenant.name,
+			tenant.options,
+			tenant.runningTaskCount,
+			static_cast<int>(tenant.waitingTickets.size()),
+			tenant.requestCount,
+			tenant.rejectedRequestCount,
+			tenant.taskCount,
+			tenant.cpuSeconds,
+			tenant.waitSeconds
+		});
+	}
+	return stats;
+}
+
+FairShareScheduler::Tenant* FairShareScheduler::getCurrentTenant() {
+	return currentTenant;
+}
+
+FairShareScope::FairShareScope(FairShareScheduler::Tenant* tenant) :
+	previousTenant(currentTenant)
+{
+	currentTenant = tenant;
+}
+
+FairShareScope::~FairShareScope() {
+	currentTenant = previousTenant;
+}
+
+FairShareSlot::FairShareSlot() {
+	if (!currentTenant || holdingSlot) return;
+
+	currentTenant->scheduler.acquireSlot(*currentTenant);
+	tenant = currentTenant;
+	holdingSlot = true;
+	startCpuSeconds = getThreadCpuSeconds();
+}
+
+FairShareSlot::~FairShareSlot() {
+	if (!tenant) return;
+
+	holdingSlot = false;
+	tenant->scheduler.releaseSlot(*tenant, std::max(getThreadCpuSeconds() - startCpuSeconds, 0.0));
+}
+
+void FairShareSlot::discard() {
+	if (!tenant) return;
+
+	holdingSlot = false;
+	tenant->scheduler.discardSlot(*tenant);
+	tenant = nullptr;
+}
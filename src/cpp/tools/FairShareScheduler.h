@@ -0,0 +1,117 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Shares a number of slots for running tasks, such as the utterances of analyses, between tenants,
+// e.g. the teams using one server, by weighted fair queuing: a free slot goes to the waiting tenant
+// that has used the least CPU time in proportion to its weight. A tenant submitting a bulk import
+// gets its share of the threads, and a tenant with little work waits for at most one running task
+// per slot instead of for the whole import.
+// Threads take part while in a FairShareScope: runTasksInParallel() runs each task in a slot of
+// the current tenant (see FairShareSlot), and its pool jobs join the scope of the thread that
+// started them.
+class FairShareScheduler {
+public:
+	struct TenantOptions {
+		// Share of the slots relative to the other tenants', while they all have tasks waiting
+		double weight = 1;
+		// Requests of the tenant handled at once, 0 for no limit; see tryBeginRequest()
+		int maxRequests = 0;
+	};
+
+	struct TenantStats {
+		std::string name;
+		TenantOptions options;
+		int runningTaskCount;
+		int waitingTaskCount;
+		int requestCount;
+		long long rejectedRequestCount;
+		long long taskCount;
+		// CPU time of the tenant's finished tasks
+		double cpuSeconds;
+		// Time the tenant's tasks waited for a slot
+		double waitSeconds;
+	};
+
+	struct Tenant;
+
+	explicit FairShareScheduler(int slotCount);
+	~FairShareScheduler();
+	FairShareScheduler(const FairShareScheduler&) = delete;
+	FairShareScheduler& operator=(const FairShareScheduler&) = delete;
+
+	// Sets the options of a tenant, which is created if it doesn't exist yet
+	void setTenantOptions(const std::string& name, TenantOptions options);
+
+	// Returns the tenant of the given name, creating it with default options if needed.
+	// Tenants live as long as the scheduler.
+	Tenant& getTenant(const std::string& name);
+
+	// Counts a request of the tenant as being handled and returns true, unless the tenant's
+	// maxRequests are already being handled. Call endRequest() once done with it.
+	bool tryBeginRequest(Tenant& tenant);
+	void endRequest(Tenant& tenant);
+
+	// Blocks until the tenant's turn for a free slot comes
+	void acquireSlot(Tenant& tenant);
+	// Frees a slot of the tenant, charging it the CPU time of the task that ran in it
+	void releaseSlot(Tenant& tenant, double cpuSeconds);
+	// Frees a slot of the tenant in which no task ran
+	void discardSlot(Tenant& tenant);
+
+	std::vector<TenantStats> getStats() const;
+
+	// Returns the tenant whose tasks the current thread runs, or nullptr if there is none
+	static Tenant* getCurrentTenant();
+
+private:
+	// The tenant to get the next free slot, or nullptr if no tenant may take one
+	Tenant* getNextTenant() const;
+
+	const int slotCount;
+	int usedSlotCount = 0;
+	// Orders the waiting tasks of each tenant, and breaks ties between tenants
+	uint64_t nextTicket = 0;
+
+	mutable std::mutex mutex;
+	// Signaled when a slot is freed or a task starts waiting
+	std::condition_variable slotsChanged;
+	std::map<std::string, std::unique_ptr<Tenant>> tenants;
+};
+
+// Makes the current thread run the tasks of the specified tenant (or none, for nullptr) for its
+// lifetime
+class FairShareScope {
+public:
+	explicit FairShareScope(FairShareScheduler::Tenant* tenant);
+	~FairShareScope();
+	FairShareScope(const FairShareScope&) = delete;
+	FairShareScope& operator=(const FairShareScope&) = delete;
+
+private:
+	FairShareScheduler::Tenant* previousTenant;
+};
+
+// Holds a slot of the current thread's tenant, if any, for its lifetime, charging the tenant the
+// thread's CPU time meanwhile. Tasks nested in one holding a slot run in that slot.
+class FairShareSlot {
+public:
+	FairShareSlot();
+	~FairShareSlot();
+	FairShareSlot(const FairShareSlot&) = delete;
+	FairShareSlot& operator=(const FairShareSlot&) = delete;
+
+	// Frees the slot early, without counting a task
+	void discard();
+
+private:
+	FairShareScheduler::Tenant* tenant = nullptr;
+	double startCpuSeconds = 0;
+};
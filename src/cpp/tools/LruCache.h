@@ -0,0 +1,67 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <utility>
+#include <compat/boost_compat.h>
+
+// A thread-safe cache holding a bounded number of values.
+// When full, adding a value evicts the least recently used one.
+template<typename key_type, typename value_type>
+class LruCache {
+public:
+	explicit LruCache(size_t capacity) :
+		capacity(capacity)
+	{}
+
+	// Returns the value for the specified key, marking it as most recently used
+	boost::optional<value_type> get(const key_type& key) {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+
+		const auto it = index.find(key);
+		if (it == index.end()) return boost::none;
+
+		entries.splice(entries.begin(), entries, it->second);
+		return it->second->second;
+	}
+
+	void set(const key_type& key, value_type value) {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+
+		const auto it = index.find(key);
+		if (it != index.end()) {
+			it->second->second = std::move(value);
+			entries.splice(entries.begin(), entries, it->second);
+			return;
+		}
+
+		if (capacity == 0) return;
+		while (entries.size() >= capacity) {
+			index.erase(entries.back().first);
+			entries.pop_back();
+		}
+		entries.emplace_front(key, std::move(value));
+		index[key] = entries.begin();
+	}
+
+	void clear() {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		index.clear();
+		entries.clear();
+	}
+
+	size_t size() const {
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		return entries.size();
+	}
+
+private:
+	using entry_list = std::list<std::pair<key_type, value_type>>;
+
+	size_t capacity;
+	// Most recently used entries first
+	entry_list entries;
+	std::unordered_map<key_type, typename entry_list::iterator> index;
+	mutable std::mutex cacheMutex;
+};
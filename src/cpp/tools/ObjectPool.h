@@ -1,45 +1,221 @@
 #pragma once
 #include <memory>
 #include <functional>
-#include <stack>
+#include <atomic>
 #include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include "tools.h"
 
+// Counters of a pool's activity since it was created
+struct ObjectPoolMetrics {
+	// Objects created, on demand or by prewarming
+	int64_t creates;
+	// Acquisitions served by a pooled object
+	int64_t hits;
+	// Acquisitions that had to wait for an object to be released, as the pool had reached its
+	// maximum size
+	int64_t waits;
+};
+
+// A pool of objects that are expensive to create, such as decoders, with up to maxSize of them in
+// existence. Released objects are kept on a lock-free free list for reuse. Objects are created on
+// demand, outside of any lock, until there are maxSize of them; then acquire() blocks until one is
+// released.
 template<typename value_type, typename pointer_type = std::unique_ptr<value_type>>
 class ObjectPool {
 public:
 	using wrapper_type = lambda_unique_ptr<value_type>;
 
-	ObjectPool(std::function<pointer_type()> createObject) :
-		createObject(createObject)
-	{}
+	static constexpr size_t defaultMaxSize = 64;
+
+	explicit ObjectPool(std::function<pointer_type()> createObject, size_t maxSize = defaultMaxSize) :
+		createObject(std::move(createObject)),
+		maxSize(maxSize),
+		objects(maxSize),
+		nextIndexes(new std::atomic<uint32_t>[maxSize])
+	{
+		if (maxSize < 1 || maxSize >= noIndex) {
+			throw std::invalid_argument("Invalid maximum size of object pool.");
+		}
+	}
+
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
 
-	wrapper_type acquire() {
-		std::lock_guard<std::mutex> lock(poolMutex);
+	// Takes an object from the pool, creating one if the pool is empty. Waits for an object to be
+	// released if the pool is empty and has reached its maximum size.
+	// If isNew is given, it receives whether the object was created.
+	wrapper_type acquire(bool* isNew = nullptr) {
+		bool waited = false;
+		while (true) {
+			uint32_t index = freeObjects.pop(nextIndexes.get());
+			if (index != noIndex) {
+				--pooledCount;
+				++hitCount;
+				if (isNew) *isNew = false;
+				return wrap(index);
+			}
 
-		if (pool.empty()) {
-			pool.push(createObject());
+			index = reserveSlot();
+			if (index != noIndex) {
+				create(index);
+				if (isNew) *isNew = true;
+				return wrap(index);
+			}
+
+			if (!waited) {
+				waited = true;
+				++waitCount;
+			}
+			std::unique_lock<std::mutex> lock(waitMutex);
+			++waiterCount;
+			releaseCondition.wait(lock, [&] { return pooledCount > 0 || canReserveSlot(); });
+			--waiterCount;
 		}
+	}
+
+	// Creates objects until the pool holds the given number of them or has reached its maximum
+	// size, so that the first acquisitions don't wait for their creation
+	void prewarm(size_t count) {
+		while (pooledCount < count) {
+			const uint32_t index = reserveSlot();
+			if (index == noIndex) return;
 
-		auto pointer = pool.top();
-		pool.pop();
-		return wrapper_type(pointer.get(), [this, pointer](value_type*) {
-			std::lock_guard<std::mutex> lock(poolMutex);
-			this->pool.push(pointer);
-		});
+			create(index);
+			release(index);
+		}
 	}
 
 	bool empty() const {
-		std::lock_guard<std::mutex> lock(poolMutex);
-		return pool.empty();
+		return pooledCount == 0;
 	}
 
+	// The number of pooled objects, ready to be acquired
 	size_t size() const {
-		std::lock_guard<std::mutex> lock(poolMutex);
-		return pool.size();
+		return pooledCount;
+	}
+
+	ObjectPoolMetrics getMetrics() const {
+		return { createCount.load(), hitCount.load(), waitCount.load() };
 	}
 
 private:
+	static constexpr uint32_t noIndex = std::numeric_limits<uint32_t>::max();
+
+	// A Treiber stack of slot indexes, linked through nextIndexes. The head carries a tag that
+	// changes with every update, so that a stale head can't be swapped back in (ABA).
+	class IndexStack {
+	public:
+		void push(uint32_t index, std::atomic<uint32_t>* nextIndexes) {
+			uint64_t head = this->head.load();
+			do {
+				nextIndexes[index].store(getIndex(head));
+			} while (!this->head.compare_exchange_weak(head, pack(index, getTag(head) + 1)));
+		}
+
+		// Returns noIndex if the stack is empty
+		uint32_t pop(std::atomic<uint32_t>* nextIndexes) {
+			uint64_t head = this->head.load();
+			while (getIndex(head) != noIndex) {
+				const uint32_t next = nextIndexes[getIndex(head)].load();
+				if (this->head.compare_exchange_weak(head, pack(next, getTag(head) + 1))) {
+					return getIndex(head);
+				}
+			}
+			return noIndex;
+		}
+
+		bool empty() const {
+			return getIndex(head.load()) == noIndex;
+		}
+
+	private:
+		static uint64_t pack(uint32_t index, uint32_t tag) {
+			return (static_cast<uint64_t>(tag) << 32) | index;
+		}
+		static uint32_t getIndex(uint64_t head) {
+			return static_cast<uint32_t>(head);
+		}
+		static uint32_t getTag(uint64_t head) {
+			return static_cast<uint32_t>(head >> 32);
+		}
+
+		std::atomic<uint64_t> head { pack(noIndex, 0) };
+	};
+
+	bool canReserveSlot() const {
+		return usedSlotCount < maxSize || !vacantSlots.empty();
+	}
+
+	// Reserves an empty slot for a new object. Returns noIndex if all slots hold objects.
+	uint32_t reserveSlot() {
+		const uint32_t index = vacantSlots.pop(nextIndexes.get());
+		if (index != noIndex) return index;
+
+		size_t used = usedSlotCount.load();
+		while (used < maxSize) {
+			if (usedSlotCount.compare_exchange_weak(used, used + 1)) {
+				return static_cast<uint32_t>(used);
+			}
+		}
+		return noIndex;
+	}
+
+	// Creates the object of a reserved slot, giving the slot back if that fails
+	void create(uint32_t index) {
+		try {
+			objects[index] = createObject();
+		} catch (...) {
+			vacantSlots.push(index, nextIndexes.get());
+			notifyWaiters();
+			throw;
+		}
+		++createCount;
+	}
+
+	void release(uint32_t index) {
+		// Counting before pushing keeps the count from dropping below the size of the free list
+		++pooledCount;
+		freeObjects.push(index, nextIndexes.get());
+		notifyWaiters();
+	}
+
+	void notifyWaiters() {
+		// Waiters check for objects after registering under the mutex, so taking it before notifying
+		// means that none of them misses the object
+		if (waiterCount > 0) {
+			{ std::lock_guard<std::mutex> lock(waitMutex); }
+			releaseCondition.notify_all();
+		}
+	}
+
+	wrapper_type wrap(uint32_t index) {
+		// The deleter fits std::function's small-object buffer, so wrapping doesn't allocate
+		return wrapper_type(objects[index].get(), [this, index](value_type*) { release(index); });
+	}
+
 	std::function<pointer_type()> createObject;
-	std::stack<std::shared_ptr<value_type>> pool;
-	mutable std::mutex poolMutex;
+	const size_t maxSize;
+	// Slots of the objects, by index; filled as objects are created
+	std::vector<pointer_type> objects;
+	std::unique_ptr<std::atomic<uint32_t>[]> nextIndexes;
+	// Slots holding pooled objects
+	IndexStack freeObjects;
+	// Slots given back after their objects failed to be created
+	IndexStack vacantSlots;
+	// Slots reserved once, in order of their indexes
+	std::atomic<size_t> usedSlotCount { 0 };
+	std::atomic<size_t> pooledCount { 0 };
+
+	std::mutex waitMutex;
+	std::condition_variable releaseCondition;
+	std::atomic<int> waiterCount { 0 };
+
+	std::atomic<int64_t> createCount { 0 };
+	std::atomic<int64_t> hitCount { 0 };
+	std::atomic<int64_t> waitCount { 0 };
 };
@@ -0,0 +1,113 @@
+#include "ThreadPool.h"
+#include "parallel.h"
+#include <algorithm>
+#include <stdexcept>
+#include <format.h>
+
+using std::invalid_argument;
+using std::lock_guard;
+using std::unique_lock;
+using std::mutex;
+
+namespace {
+	// The pool and index of the worker running on the current thread, if any
+	thread_local const ThreadPool* currentPool = nullptr;
+	thread_local size_t currentWorkerIndex = 0;
+}
+
+ThreadPool::ThreadPool(int threadCount) {
+	if (threadCount < 1) {
+		throw invalid_argument(fmt::format("threadCount cannot be {}.", threadCount));
+	}
+
+	for (int i = 0; i < threadCount; ++i) {
+		workers.push_back(std::make_unique<Worker>());
+	}
+	for (size_t i = 0; i < workers.size(); ++i) {
+		threads.emplace_back([this, i] { runWorker(i); });
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		lock_guard<mutex> lock(stateMutex);
+		stopping = true;
+	}
+	stateChanged.notify_all();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+ThreadPool& ThreadPool::get() {
+	int threadCount = getProcessorCoreCount() - 1;
+#if defined(LIPSYNCENGINE_MAX_THREAD_COUNT)
+	// Don't start more threads than there are prestarted WASM workers
+	threadCount = std::min(threadCount, LIPSYNCENGINE_MAX_THREAD_COUNT - 1);
+#endif
+	static ThreadPool pool(std::max(threadCount, 1));
+	return pool;
+}
+
+void ThreadPool::submit(job_type job) {
+	size_t workerIndex;
+	{
+		lock_guard<mutex> lock(stateMutex);
+		workerIndex = currentPool == this
+			? currentWorkerIndex
+			: nextWorkerIndex++ % workers.size();
+	}
+
+	{
+		Worker& worker = *workers[workerIndex];
+		lock_guard<mutex> lock(worker.mutex);
+		worker.jobs.push_back(std::move(job));
+	}
+
+	{
+		lock_guard<mutex> lock(stateMutex);
+		++pendingJobCount;
+	}
+	stateChanged.notify_one();
+}
+
+bool ThreadPool::tryTakeJob(size_t workerIndex, job_type& job) {
+	// Take the oldest job from the own queue, else steal the newest job from another queue
+	for (size_t offset = 0; offset < workers.size(); ++offset) {
+		Worker& worker = *workers[(workerIndex + offset) % workers.size()];
+		lock_guard<mutex> lock(worker.mutex);
+		if (worker.jobs.empty()) continue;
+
+		if (offset == 0) {
+			job = std::move(worker.jobs.front());
+			worker.jobs.pop_front();
+		} else {
+			job = std::move(worker.jobs.back());
+			worker.jobs.pop_back();
+		}
+		return true;
+	}
+	return false;
+}
+
+void ThreadPool::runWorker(size_t workerIndex) {
+	currentPool = this;
+	currentWorkerIndex = workerIndex;
+
+	while (true) {
+		{
+			unique_lock<mutex> lock(stateMutex);
+			stateChanged.wait(lock, [&] { return stopping || pendingJobCount > 0; });
+			if (stopping) return;
+			// Reserve a job. It is in one of the queues, because submit() queues before counting.
+			--pendingJobCount;
+		}
+
+		job_type job;
+		while (!tryTakeJob(workerIndex, job)) {
+			// Another worker is still pushing the reserved job
+			std::this_thread::yield();
+		}
+		job();
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// A fixed set of worker threads executing submitted jobs.
+// Each worker has its own job queue. Idle workers steal jobs from the queues of busy ones.
+class ThreadPool {
+public:
+	using job_type = std::function<void()>;
+
+	explicit ThreadPool(int threadCount);
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// The process-wide pool, created on first use.
+	// Together with the thread waiting for its jobs, it uses all processor cores.
+	static ThreadPool& get();
+
+	int getThreadCount() const;
+
+	// Queues a job for execution on a worker thread.
+	// Jobs submitted by a worker go to that worker's own queue.
+	// Jobs must not throw.
+	void submit(job_type job);
+
+private:
+	struct Worker {
+		std::deque<job_type> jobs;
+		std::mutex mutex;
+	};
+
+	void runWorker(size_t workerIndex);
+	bool tryTakeJob(size_t workerIndex, job_type& job);
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::thread> threads;
+
+	// Guards pendingJobCount and stopping; signaled when either changes
+	std::mutex stateMutex;
+	std::condition_variable stateChanged;
+	size_t pendingJobCount = 0;
+	bool stopping = false;
+
+	size_t nextWorkerIndex = 0;
+};
+
+inline int ThreadPool::getThreadCount() const {
+	return static_cast<int>(threads.size());
+}
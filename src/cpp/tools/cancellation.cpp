@@ -0,0 +1,87 @@
+#include "cancellation.h"
+#if defined(__EMSCRIPTEN__) && defined(LIPSYNCENGINE_COOPERATIVE_YIELD)
+#include <emscripten.h>
+#endif
+
+namespace {
+	thread_local const CancellationToken* currentToken = nullptr;
+}
+
+OperationCancelled::OperationCancelled(Reason reason) :
+	std::runtime_error(reason == Reason::Deadline ? "The operation exceeded its deadline." : "The operation was cancelled."),
+	reason(reason)
+{}
+
+CancellationToken::CancellationToken(
+	const volatile int32_t* flag,
+	boost::optional<clock::time_point> deadline,
+	std::chrono::milliseconds yieldInterval
+) :
+	cancelled(false),
+	flag(flag),
+	deadline(deadline),
+	yieldInterval(canYield() ? yieldInterval : std::chrono::milliseconds::zero()),
+	yieldingThread(std::this_thread::get_id()),
+	lastYield(clock::now())
+{}
+
+void CancellationToken::cancel() {
+	cancelled = true;
+}
+
+void CancellationToken::throwIfCancelled() const {
+	if (cancelled.load(std::memory_order_relaxed) || (flag && *flag != 0)) {
+		throw OperationCancelled(OperationCancelled::Reason::Request);
+	}
+	if (deadline && clock::now() >= *deadline) {
+		throw OperationCancelled(OperationCancelled::Reason::Deadline);
+	}
+}
+
+void CancellationToken::yieldIfDue() const {
+	if (yieldInterval <= std::chrono::milliseconds::zero()) return;
+	if (std::this_thread::get_id() != yieldingThread) return;
+
+	const clock::time_point now = clock::now();
+	if (now - lastYield < yieldInterval) return;
+
+#if defined(__EMSCRIPTEN__) && defined(LIPSYNCENGINE_COOPERATIVE_YIELD)
+	// Suspends the WebAssembly stack until a macrotask later, letting the host handle its events
+	emscripten_sleep(0);
+#endif
+	lastYield = clock::now();
+}
+
+bool CancellationToken::canSuspend() const {
+	return yieldInterval > std::chrono::milliseconds::zero() && std::this_thread::get_id() == yieldingThread;
+}
+
+const CancellationToken* CancellationToken::getCurrent() {
+	return currentToken;
+}
+
+bool CancellationToken::canYield() {
+#if defined(__EMSCRIPTEN__) && defined(LIPSYNCENGINE_COOPERATIVE_YIELD)
+	return true;
+#else
+	return false;
+#endif
+}
+
+CancellationScope::CancellationScope(const CancellationToken* token) :
+	previousToken(currentToken)
+{
+	currentToken = token;
+}
+
+CancellationScope::~CancellationScope() {
+	currentToken = previousToken;
+}
+
+void throwIfCancelled() {
+	if (currentToken) {
+		// Events handled while yielding may cancel the token
+		currentToken->yieldIfDue();
+		currentToken->throwIfCancelled();
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <compat/boost_compat.h>
+
+// Thrown by throwIfCancelled() when the current operation has been cancelled
+class OperationCancelled : public std::runtime_error {
+public:
+	enum class Reason {
+		// The token was cancelled or its flag set
+		Request,
+		// The deadline has passed
+		Deadline
+	};
+
+	explicit OperationCancelled(Reason reason);
+
+	Reason getReason() const { return reason; }
+
+private:
+	Reason reason;
+};
+
+// Lets an operation be stopped early, on request or once a deadline has passed.
+// The operation checks its token between units of work, such as utterances, batches of frames and
+// animation passes, so it stops soon after, not immediately.
+// In builds that can yield (see canYield()), the thread that created the token may also yield to
+// the host's event loop at these checkpoints, so that a single-threaded WebAssembly host can handle
+// events, such as a request to cancel, during a long operation.
+class CancellationToken {
+public:
+	using clock = std::chrono::steady_clock;
+
+	// Also cancels once *flag is non-zero, if flag isn't nullptr. The flag may be set from any
+	// thread, including JavaScript writing to shared WebAssembly memory.
+	// If yieldInterval is positive, yields at most that often.
+	explicit CancellationToken(
+		const volatile int32_t* flag = nullptr,
+		boost::optional<clock::time_point> deadline = boost::none,
+		std::chrono::milliseconds yieldInterval = std::chrono::milliseconds::zero()
+	);
+	CancellationToken(const CancellationToken&) = delete;
+	CancellationToken& operator=(const CancellationToken&) = delete;
+
+	// May be called from any thread
+	void cancel();
+
+	// Throws OperationCancelled if the token is cancelled
+	void throwIfCancelled() const;
+
+	// Yields to the host if called on the thread that created the token and the yield interval has
+	// passed since the token was created or last yielded
+	void yieldIfDue() const;
+
+	// Whether the current thread may suspend to await the host, as yielding does: in builds that
+	// can yield, on the thread that created the token, if the token yields at all
+	bool canSuspend() const;
+
+	// Returns the token checked by the current thread, or nullptr if there is none
+	static const CancellationToken* getCurrent();
+
+	// Whether this build can yield to the host: WebAssembly builds with JSPI
+	// (LIPSYNCENGINE_COOPERATIVE_YIELD), whose operations yield through promising exports
+	static bool canYield();
+
+private:
+	std::atomic<bool> cancelled;
+	const volatile int32_t* flag;
+	boost::optional<clock::time_point> deadline;
+	std::chrono::milliseconds yieldInterval;
+	std::thread::id yieldingThread;
+	// Only used by yieldingThread
+	mutable clock::time_point lastYield;
+};
+
+// Makes the current thread check the specified token (or none, for nullptr) for its lifetime
+class CancellationScope {
+public:
+	explicit CancellationScope(const CancellationToken* token);
+	~CancellationScope();
+	CancellationScope(const CancellationScope&) = delete;
+	CancellationScope& operator=(const CancellationScope&) = delete;
+
+private:
+	const CancellationToken* previousToken;
+};
+
+// Throws OperationCancelled if the current thread's token, if any, is cancelled, after yielding to
+// the host if the token is due to
+void throwIfCancelled();
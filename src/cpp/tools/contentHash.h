@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// A 64-bit hash of data of any length, for keying caches by content.
+// FNV-1a over 64-bit words instead of bytes, with a final mix. Not cryptographic; accidental
+// collisions between cached items are negligible.
+class ContentHasher {
+public:
+	void add(const void* data, size_t size) {
+		const auto* bytes = static_cast<const uint8_t*>(data);
+		size_t i = 0;
+		for (; i + 8 <= size; i += 8) {
+			uint64_t word;
+			std::memcpy(&word, bytes + i, 8);
+			addWord(word);
+		}
+		uint64_t rest = 0;
+		if (i < size) std::memcpy(&rest, bytes + i, size - i);
+		addWord(rest ^ (static_cast<uint64_t>(size) << 56));
+	}
+
+	void add(const std::string& value) {
+		add(value.data(), value.size());
+	}
+
+	template<typename T>
+	void addValue(const T& value) {
+		add(&value, sizeof(value));
+	}
+
+	uint64_t get() const {
+		uint64_t h = hash;
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		return h ^ (h >> 33);
+	}
+
+private:
+	void addWord(uint64_t word) {
+		hash = (hash ^ word) * 0x100000001b3ULL;
+		hash ^= hash >> 29;
+	}
+
+	uint64_t hash = 0xcbf29ce484222325ULL;
+};
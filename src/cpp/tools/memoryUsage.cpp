@@ -0,0 +1,50 @@
+#include "memoryUsage.h"
+#include <atomic>
+#include <algorithm>
+
+#if defined(__EMSCRIPTEN__) || defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#if defined(__EMSCRIPTEN__)
+#include <emscripten/heap.h>
+#endif
+
+namespace {
+	std::atomic<size_t> peakHeapUsage(0);
+
+	void updatePeakHeapUsage(size_t usage) {
+		size_t peak = peakHeapUsage.load(std::memory_order_relaxed);
+		while (usage > peak && !peakHeapUsage.compare_exchange_weak(peak, usage, std::memory_order_relaxed)) {}
+	}
+}
+
+size_t getHeapUsage() {
+#if defined(__EMSCRIPTEN__)
+	const size_t usage = static_cast<size_t>(mallinfo().uordblks);
+#elif defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	const struct mallinfo2 info = mallinfo2();
+	// Large blocks are mapped separately from the arenas
+	const size_t usage = info.uordblks + info.hblkhd;
+#else
+	const size_t usage = 0;
+#endif
+	updatePeakHeapUsage(usage);
+	return usage;
+}
+
+size_t getPeakHeapUsage() {
+	const size_t usage = getHeapUsage();
+#if defined(__EMSCRIPTEN__)
+	return std::max(usage, static_cast<size_t>(mallinfo().usmblks));
+#else
+	return std::max(usage, peakHeapUsage.load());
+#endif
+}
+
+size_t getMemorySize() {
+#if defined(__EMSCRIPTEN__)
+	return emscripten_get_heap_size();
+#else
+	return 0;
+#endif
+}
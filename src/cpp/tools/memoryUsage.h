@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+// Bytes allocated on the heap and not yet freed, as reported by malloc.
+// 0 where the allocator doesn't report it.
+size_t getHeapUsage();
+
+// The peak heap usage.
+// In WASM builds, this is malloc's high-water mark of the memory it took from the WebAssembly
+// memory, including free blocks. Elsewhere, it is the highest usage returned by getHeapUsage().
+size_t getPeakHeapUsage();
+
+// Size of the WebAssembly memory, which grows as needed and never shrinks. 0 in native builds.
+size_t getMemorySize();
@@ -0,0 +1,115 @@
+#include "parallel.h"
+#include "ThreadPool.h"
+#include "AnalysisStats.h"
+#include "cancellation.h"
+#include "FairShareScheduler.h"
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+using std::vector;
+using std::function;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::shared_ptr;
+
+namespace {
+	// Tasks shared between the calling thread and the pool jobs helping it.
+	// A job may only start after the calling thread has returned; it then finds no tasks left.
+	class TaskBatch {
+	public:
+		explicit TaskBatch(const vector<function<void()>>& tasks) :
+			tasks(tasks),
+			taskCount(tasks.size())
+		{}
+
+		// Runs the next task, if any. Returns false if there is none.
+		bool runNextTask() {
+			// Waits for a slot before taking a task, so that a job waiting for its tenant's turn
+			// leaves the tasks to the threads that can run them
+			FairShareSlot slot;
+			size_t taskIndex;
+			{
+				lock_guard<mutex> lock(batchMutex);
+				if (exception || nextTaskIndex == taskCount) {
+					slot.discard();
+					return false;
+				}
+				taskIndex = nextTaskIndex++;
+				++runningTaskCount;
+			}
+
+			std::exception_ptr taskException;
+			try {
+				throwIfCancelled();
+				tasks[taskIndex]();
+			} catch (...) {
+				taskException = std::current_exception();
+			}
+
+			{
+				lock_guard<mutex> lock(batchMutex);
+				--runningTaskCount;
+				if (taskException && !exception) {
+					exception = taskException;
+				}
+			}
+			taskFinished.notify_all();
+			return true;
+		}
+
+		// Waits for all started tasks, then re-throws the first exception, if any
+		void finish() {
+			unique_lock<mutex> lock(batchMutex);
+			taskFinished.wait(lock, [&] { return runningTaskCount == 0; });
+			if (exception) {
+				std::rethrow_exception(exception);
+			}
+		}
+
+	private:
+		// Only valid while the calling thread waits for the batch
+		const vector<function<void()>>& tasks;
+		const size_t taskCount;
+		mutex batchMutex;
+		std::condition_variable taskFinished;
+		size_t nextTaskIndex = 0;
+		int runningTaskCount = 0;
+		std::exception_ptr exception;
+	};
+}
+
+void runTasksInParallel(const vector<function<void()>>& tasks, int maxThreadCount) {
+	if (maxThreadCount < 1) {
+		throw std::invalid_argument(fmt::format("maxThreadCount cannot be {}.", maxThreadCount));
+	}
+
+	const auto batch = std::make_shared<TaskBatch>(tasks);
+
+	// Let pool workers help with the tasks. The calling thread is one of the maxThreadCount.
+	// They add to the stats of the calling thread, check its cancellation token and run the tasks
+	// in slots of its tenant, if any.
+	if (tasks.size() > 1 && maxThreadCount > 1) {
+		ThreadPool& pool = ThreadPool::get();
+		const int helperCount = std::min({
+			maxThreadCount - 1,
+			static_cast<int>(tasks.size()) - 1,
+			pool.getThreadCount()
+		});
+		AnalysisStats* stats = AnalysisStats::getCurrent();
+		const CancellationToken* cancellationToken = CancellationToken::getCurrent();
+		FairShareScheduler::Tenant* tenant = FairShareScheduler::getCurrentTenant();
+		for (int i = 0; i < helperCount; ++i) {
+			pool.submit([batch, stats, cancellationToken, tenant] {
+				const AnalysisStatsScope statsScope(stats);
+				const CancellationScope cancellationScope(cancellationToken);
+				const FairShareScope fairShareScope(tenant);
+				while (batch->runNextTask()) {}
+			});
+		}
+	}
+
+	while (batch->runNextTask()) {}
+	batch->finish();
+}
@@ -1,9 +1,20 @@
 #pragma once
 
 #include <functional>
-#include <future>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <numeric>
 #include "progress.h"
-#include <gsl_util.h>
+#include "cancellation.h"
+#include <format.h>
+
+// Runs the tasks on the process-wide thread pool, in order of their indexes, with at most
+// maxThreadCount of them at a time. The calling thread runs tasks, too.
+// If a task throws, no further tasks are started; once running tasks have finished,
+// the first exception is re-thrown. Before each task, the current cancellation token is checked.
+// Within a FairShareScope, each task waits for a slot of the current tenant.
+void runTasksInParallel(const std::vector<std::function<void()>>& tasks, int maxThreadCount);
 
 template<typename TCollection>
 void runParallel(
@@ -18,66 +29,17 @@ void runParallel(
 	if (maxThreadCount == 1) {
 		// Process synchronously
 		for (auto& element : collection) {
+			throwIfCancelled();
 			processElement(element);
 		}
 		return;
 	}
 
-	using future_type = std::future<void>;
-
-	std::mutex mutex;
-	int currentThreadCount = 0;
-	std::condition_variable elementFinished;
-	future_type finishedElement;
-
-	// Before exiting, wait for all running tasks to finish, but don't re-throw exceptions.
-	// This only applies if one task already failed with an exception.
-	auto finishRunning = gsl::finally([&] {
-		std::unique_lock<std::mutex> lock(mutex);
-		elementFinished.wait(lock, [&] { return currentThreadCount == 0; });
-	});
-
-	// Asynchronously run all elements
-	for (auto it = collection.begin(); it != collection.end(); ++it) {
-		// This variable will later hold the future, but can be value-captured right now
-		auto future = std::make_shared<future_type>();
-
-		// Notifies that an element is done processing
-		auto notifyElementDone = [&, future] {
-			std::lock_guard<std::mutex> lock(mutex);
-			finishedElement = std::move(*future);
-			--currentThreadCount;
-			elementFinished.notify_one();
-		};
-
-		// Processes the current element, then notifies
-		auto wrapperFunction = [processElement, &element = *it, notifyElementDone]() {
-			auto done = gsl::finally(notifyElementDone);
-			processElement(element);
-		};
-
-		// Asynchronously process element
-		{
-			std::lock_guard<std::mutex> lock(mutex);
-			*future = std::async(std::launch::async, wrapperFunction);
-			++currentThreadCount;
-		}
-
-		// Wait for threads to finish, if necessary
-		{
-			std::unique_lock<std::mutex> lock(mutex);
-			const int targetThreadCount = it == collection.end() ? 0 : maxThreadCount - 1;
-			while (currentThreadCount > targetThreadCount) {
-				elementFinished.wait(lock);
-				if (finishedElement.valid()) {
-					// Re-throw any exception
-					finishedElement.get();
-					finishedElement = future_type();
-				}
-			}
-		}
+	std::vector<std::function<void()>> tasks;
+	for (auto& element : collection) {
+		tasks.push_back([&processElement, &element] { processElement(element); });
 	}
-
+	runTasksInParallel(tasks, maxThreadCount);
 }
 
 template<typename TCollection>
@@ -93,17 +55,34 @@ void runParallel(
 	// Create a collection of wrapper functions that take care of progress handling
 	ProgressMerger progressMerger(progressSink);
 	std::vector<std::function<void()>> functions;
+	std::vector<double> weights;
 	int elementIndex = 0;
 	for (auto& element : collection) {
+		const double weight = getElementProgressWeight(element);
 		auto& elementProgressSink = progressMerger.addSource(
 			fmt::format("runParallel ({}) #{}", description, elementIndex),
-			getElementProgressWeight(element)
+			weight
 		);
 		functions.push_back([&]() { processElement(element, elementProgressSink); });
+		weights.push_back(weight);
 
 		++elementIndex;
 	}
 
+	// Start the heaviest elements first, so that no long element is left running at the end
+	if (maxThreadCount > 1) {
+		std::vector<size_t> order(functions.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			return weights[a] > weights[b];
+		});
+		std::vector<std::function<void()>> sortedFunctions;
+		for (const size_t index : order) {
+			sortedFunctions.push_back(std::move(functions[index]));
+		}
+		functions = std::move(sortedFunctions);
+	}
+
 	// Run wrapper function
 	runParallel([&](std::function<void()> function) { function(); }, functions, maxThreadCount);
 }
@@ -1,5 +1,6 @@
 #include "progress.h"
 
+#include <algorithm>
 #include <mutex>
 #include "logging/logging.h"
 
@@ -19,47 +20,79 @@ ProgressMerger::ProgressMerger(ProgressSink& sink) :
 
 ProgressMerger::~ProgressMerger() {
 	for (const auto& source : sources) {
-		if (source.progress < 1.0) {
+		if (source->progress < 1.0) {
 			logging::debugFormat(
 				"Progress merger source '{}' never reached 1.0, but stopped at {}.",
-				source.description,
-				source.progress
+				source->description,
+				source->progress.load()
 			);
 		}
 	}
 }
 
 ProgressSink& ProgressMerger::addSource(const std::string& description, double weight) {
-	std::lock_guard<std::mutex> lock(mutex);
-
-	totalWeight += weight;
-
-	const int sourceIndex = static_cast<int>(sources.size());
-	sources.push_back({
-		description,
-		weight,
-		std::make_unique<ProgressForwarder>(
-			[sourceIndex, this](double progress) {
-				sources[sourceIndex].progress = progress;
-				report();
-			}
-		),
-		0.0
-	});
-	return *sources[sourceIndex].forwarder;
+	std::lock_guard<std::mutex> lock(addMutex);
+
+	sources.push_back(std::make_unique<MergerSource>());
+	MergerSource& source = *sources.back();
+	source.description = description;
+	source.weight = weight;
+	source.forwarder = std::make_unique<ProgressForwarder>(
+		[&source, this](double progress) { report(source, progress); }
+	);
+	totalWeight = totalWeight + weight;
+	++sourceCount;
+	return *source.forwarder;
 }
 
-void ProgressMerger::report() {
-	std::lock_guard<std::mutex> lock(mutex);
+void ProgressMerger::report(MergerSource& source, double progress) {
+	const double previousProgress = source.progress.exchange(progress);
+	if (progress == previousProgress) return;
 
-	if (totalWeight != 0) {
-		double weightedSum = 0;
-		for (const auto& source : sources) {
-			weightedSum += source.weight * source.progress;
-		}
-		const double progress = weightedSum / totalWeight;
-		sink.reportProgress(progress);
-	} else {
-		sink.reportProgress(0);
+	double sum = weightedSum.load();
+	const double change = source.weight * (progress - previousProgress);
+	while (!weightedSum.compare_exchange_weak(sum, sum + change)) {}
+	sum += change;
+
+	if (previousProgress < 1.0 && progress >= 1.0) {
+		++completedSourceCount;
+	} else if (previousProgress >= 1.0 && progress < 1.0) {
+		--completedSourceCount;
+	}
+
+	// The running sum may be off by rounding errors, so completion is counted instead
+	const double weight = totalWeight;
+	const double merged = completedSourceCount == sourceCount
+		? 1.0
+		: weight != 0 ? std::min(std::max(sum / weight, 0.0), 1.0) : 0.0;
+	double reported = reportedProgress.load();
+	do {
+		if (merged < reported + minReportedGrowth && !(merged == 1.0 && reported < 1.0)) return;
+	} while (!reportedProgress.compare_exchange_weak(reported, merged));
+	sink.reportProgress(merged);
+}
+
+RateEstimate::RateEstimate(double defaultRate) :
+	rate(defaultRate)
+{}
+
+double RateEstimate::estimate(double amount) const {
+	return rate.load() * amount;
+}
+
+void RateEstimate::measure(double amount, double value) {
+	if (!(amount > 0)) return;
+
+	const double measuredRate = value / amount;
+	// The first measurement replaces the default
+	if (!measured.exchange(true)) {
+		rate = measuredRate;
+		return;
 	}
+	double current = rate.load();
+	while (!rate.compare_exchange_weak(current, current + smoothing * (measuredRate - current))) {}
+}
+
+void RateEstimate::measure(double amount, std::chrono::nanoseconds duration) {
+	measure(amount, std::chrono::duration<double, std::milli>(duration).count());
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <mutex>
 #include <vector>
@@ -28,22 +30,58 @@ private:
 struct MergerSource {
 	std::string description;
 	double weight;
-	// Needs to be a pointer because we give away references to the forwarder
-	// itself which would become invalid if the MergerSource is moved.
 	std::unique_ptr<ProgressForwarder> forwarder;
-	double progress;
+	std::atomic<double> progress { 0.0 };
 };
 
+// Merges the progress of weighted sources into one, e.g. of tasks running in parallel.
+// Sources are added before they report. Reports don't lock: each one adds its change to a running
+// weighted sum, so they are cheap no matter how many sources there are. The sink only receives the
+// merged progress once it has grown by at least a thousandth, and when all sources have completed.
+// Reports from different threads may reach it out of order.
 class ProgressMerger {
 public:
 	ProgressMerger(ProgressSink& sink);
 	~ProgressMerger();
 	ProgressSink& addSource(const std::string& description, double weight);
 private:
-	void report();
+	// The smallest growth of the merged progress passed on to the sink
+	static constexpr double minReportedGrowth = 0.001;
+
+	void report(MergerSource& source, double progress);
 
 	ProgressSink& sink;
-	std::mutex mutex;
-	double totalWeight = 0;
-	std::vector<MergerSource> sources;
+	std::mutex addMutex;
+	// Pointers, because the forwarders are handed out and the progress is shared between threads
+	std::vector<std::unique_ptr<MergerSource>> sources;
+	std::atomic<size_t> sourceCount { 0 };
+	std::atomic<double> totalWeight { 0.0 };
+	std::atomic<double> weightedSum { 0.0 };
+	std::atomic<size_t> completedSourceCount { 0 };
+	std::atomic<double> reportedProgress { -1.0 };
+};
+
+// Learns a rate online, such as the milliseconds a stage of analysis takes per second of audio, so
+// that progress can be weighted by the expected cost of each stage and the remaining time estimated.
+// Measurements are smoothed exponentially, as they vary with the input and the load of the device.
+class RateEstimate {
+public:
+	// Uses the default until a rate has been measured
+	explicit RateEstimate(double defaultRate);
+
+	// The estimated value for the given amount, e.g. the milliseconds for some seconds of audio
+	double estimate(double amount) const;
+
+	// Adds the measurement of a value for an amount. Ignores amounts that are not positive.
+	void measure(double amount, double value);
+
+	// Adds the measurement of a duration for an amount, for rates in milliseconds per unit
+	void measure(double amount, std::chrono::nanoseconds duration);
+
+private:
+	// Weight of each new measurement
+	static constexpr double smoothing = 0.3;
+
+	std::atomic<double> rate;
+	std::atomic<bool> measured { false };
 };
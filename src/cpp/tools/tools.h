@@ -28,14 +28,17 @@ void for_each_adjacent(
 	for (unsigned i = 0; i < n; ++i) {
 		if (it == end) return;
 		values.push_back(std::ref(*it));
-		if (i < n - 1) ++it;
+		++it;
 	}
 
-	for (; it != end; ++it) {
+	// Slide the window by one element at a time, ending with the last n values
+	while (true) {
 		f(values);
+		if (it == end) return;
 
 		values.pop_front();
-		values.push_back(*it);
+		values.push_back(std::ref(*it));
+		++it;
 	}
 }
 
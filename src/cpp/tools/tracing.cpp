@@ -0,0 +1,166 @@
+#include "tracing.h"
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <format.h>
+
+using std::string;
+using std::vector;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::chrono::steady_clock;
+
+namespace {
+	// The number of spans the ring buffer keeps, about 2 MB
+	constexpr size_t traceCapacity = 1 << 15;
+
+	struct TraceSpan {
+		const char* name;
+		const char* category;
+		int64_t startMicroseconds;
+		int64_t durationMicroseconds;
+		uint32_t threadId;
+		std::array<std::pair<const char*, int64_t>, 2> arguments;
+		size_t argumentCount;
+	};
+
+	std::atomic<bool> tracingEnabled { false };
+	std::mutex traceMutex;
+	vector<TraceSpan> spans;
+	// The index at which the next span is stored; spans wrap around once the buffer is full
+	size_t nextSpanIndex = 0;
+	std::unordered_map<const void*, int64_t> objectIds;
+
+	std::atomic<uint32_t> nextThreadId { 1 };
+	thread_local uint32_t traceThreadId = 0;
+
+	uint32_t getTraceThreadId() {
+		if (traceThreadId == 0) {
+			traceThreadId = nextThreadId++;
+		}
+		return traceThreadId;
+	}
+
+	int64_t toMicroseconds(steady_clock::time_point time) {
+		return duration_cast<microseconds>(time.time_since_epoch()).count();
+	}
+
+	void recordSpan(const TraceSpan& span) {
+		std::lock_guard<std::mutex> lock(traceMutex);
+		// Tracing may have been disabled since the span started
+		if (!tracingEnabled) return;
+
+		if (spans.size() < traceCapacity) {
+			spans.push_back(span);
+		} else {
+			spans[nextSpanIndex] = span;
+		}
+		nextSpanIndex = (nextSpanIndex + 1) % traceCapacity;
+	}
+}
+
+void setTracingEnabled(bool enabled) {
+	std::lock_guard<std::mutex> lock(traceMutex);
+	if (enabled) {
+		spans.reserve(traceCapacity);
+	} else {
+		vector<TraceSpan>().swap(spans);
+		nextSpanIndex = 0;
+		objectIds.clear();
+	}
+	tracingEnabled = enabled;
+}
+
+bool isTracingEnabled() {
+	return tracingEnabled.load(std::memory_order_relaxed);
+}
+
+int64_t getTraceClockMicroseconds() {
+	return toMicroseconds(steady_clock::now());
+}
+
+int64_t getTraceObjectId(const void* object) {
+	std::lock_guard<std::mutex> lock(traceMutex);
+	return objectIds.emplace(object, static_cast<int64_t>(objectIds.size()) + 1).first->second;
+}
+
+void recordTraceSpan(const char* name, const char* category, steady_clock::time_point start, steady_clock::time_point end) {
+	if (!isTracingEnabled()) return;
+
+	recordSpan({
+		name,
+		category,
+		toMicroseconds(start),
+		duration_cast<microseconds>(end - start).count(),
+		getTraceThreadId(),
+		{},
+		0
+	});
+}
+
+TraceScope::TraceScope(const char* name, const char* category) :
+	name(name),
+	category(category),
+	enabled(isTracingEnabled())
+{
+	// Don't even read the clock unless tracing
+	if (enabled) {
+		start = steady_clock::now();
+	}
+}
+
+TraceScope::~TraceScope() {
+	if (!enabled) return;
+
+	const steady_clock::time_point end = steady_clock::now();
+	recordSpan({
+		name,
+		category,
+		toMicroseconds(start),
+		duration_cast<microseconds>(end - start).count(),
+		getTraceThreadId(),
+		arguments,
+		argumentCount
+	});
+}
+
+void TraceScope::setArgument(const char* argumentName, int64_t value) {
+	if (!enabled || argumentCount == arguments.size()) return;
+
+	arguments[argumentCount++] = { argumentName, value };
+}
+
+string takeChromeTraceEvents(int64_t processId, int64_t clockOffsetMicroseconds) {
+	vector<TraceSpan> orderedSpans;
+	{
+		std::lock_guard<std::mutex> lock(traceMutex);
+		orderedSpans.reserve(spans.size());
+		const size_t firstIndex = spans.size() < traceCapacity ? 0 : nextSpanIndex;
+		for (size_t i = 0; i < spans.size(); ++i) {
+			orderedSpans.push_back(spans[(firstIndex + i) % spans.size()]);
+		}
+		spans.clear();
+		nextSpanIndex = 0;
+	}
+
+	fmt::MemoryWriter json;
+	json << '[';
+	bool first = true;
+	for (const TraceSpan& span : orderedSpans) {
+		if (!first) json << ',';
+		first = false;
+		json.write(
+			R"({{"name":"{}","cat":"{}","ph":"X","ts":{},"dur":{},"pid":{},"tid":{},"args":{{)",
+			span.name, span.category, span.startMicroseconds + clockOffsetMicroseconds,
+			span.durationMicroseconds, processId, span.threadId
+		);
+		for (size_t i = 0; i < span.argumentCount; ++i) {
+			if (i > 0) json << ',';
+			json.write(R"("{}":{})", span.arguments[i].first, span.arguments[i].second);
+		}
+		json << "}}";
+	}
+	json << ']';
+	return json.str();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Fine-grained spans of engine work for Chrome's trace event format (chrome://tracing, Perfetto).
+// Recording is off until enabled. Spans go to a ring buffer of the process, which keeps the most
+// recent ones, so tracing a long session costs a fixed amount of memory.
+
+// Enables or disables recording. Enabling allocates the ring buffer; disabling frees it along with
+// the spans recorded so far.
+void setTracingEnabled(bool enabled);
+bool isTracingEnabled();
+
+// Microseconds of the clock spans are measured with, for relating them to other clocks
+int64_t getTraceClockMicroseconds();
+
+// A small number identifying an object, such as a decoder, in span arguments. Numbers are assigned
+// in the order objects are first seen, by address, until tracing is disabled.
+int64_t getTraceObjectId(const void* object);
+
+// Records a span of the current thread that started and ended at the given times, if tracing is
+// enabled. The name and category must outlive the span, like those of TraceScope.
+void recordTraceSpan(
+	const char* name,
+	const char* category,
+	std::chrono::steady_clock::time_point start,
+	std::chrono::steady_clock::time_point end
+);
+
+// Records its lifetime as a span of the current thread, if tracing is enabled.
+// The name, category and argument names must be string literals or otherwise outlive the span.
+class TraceScope {
+public:
+	TraceScope(const char* name, const char* category);
+	~TraceScope();
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+	// Attaches an argument to the span. Spans keep up to two arguments; later ones are dropped.
+	void setArgument(const char* name, int64_t value);
+
+private:
+	const char* name;
+	const char* category;
+	bool enabled;
+	std::chrono::steady_clock::time_point start;
+	std::array<std::pair<const char*, int64_t>, 2> arguments {};
+	size_t argumentCount = 0;
+};
+
+// Returns the recorded spans as a JSON array of Chrome trace events, oldest first, and clears them.
+// Events are complete events ("X") with the given process ID and a thread ID numbering the threads
+// in the order they first recorded a span. Timestamps are those of getTraceClockMicroseconds() plus
+// the offset, so that traces of several processes can be merged on one timeline.
+std::string takeChromeTraceEvents(int64_t processId, int64_t clockOffsetMicroseconds);
@@ -0,0 +1,54 @@
+// Tool generating a vocabulary pack for a project's dialog, see LanguageModelVariant::Vocabulary.
+// Projects that know all their lines at build time ship the pack instead of the full dictionary and
+// language model.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "recognition/pocketSphinxTools.h"
+#include "recognition/vocabularyPack.h"
+#include "logging/logging.h"
+#include "logging/sinks.h"
+#include "logging/formatters.h"
+
+using std::filesystem::path;
+using std::string;
+using std::vector;
+
+int main(int argc, char* argv[]) {
+	if (argc != 3 && argc != 4) {
+		std::cerr << "Usage: " << argv[0] << " <model directory> <dialog file> [<output directory>]" << std::endl
+			<< "The dialog file holds one line of dialog per line. The pack is written to the model directory "
+			"unless an output directory is given." << std::endl;
+		return 1;
+	}
+
+	const path modelDirectory = path(argv[1]);
+	const path dialogPath = path(argv[2]);
+	const path outputDirectory = argc == 4 ? path(argv[3]) : modelDirectory;
+	setSphinxModelDirectory(modelDirectory);
+	// Report guessed pronunciations and words left out
+	logging::addSink(std::make_shared<logging::LevelFilter>(
+		std::make_shared<logging::StdErrSink>(std::make_shared<logging::SimpleConsoleFormatter>()),
+		logging::Level::Info));
+
+	std::ifstream dialogFile(dialogPath);
+	if (!dialogFile) {
+		std::cerr << "Failed to read " << dialogPath.u8string() << std::endl;
+		return 1;
+	}
+	vector<string> dialogs;
+	string line;
+	while (std::getline(dialogFile, line)) {
+		dialogs.push_back(line);
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(outputDirectory, error);
+	if (!createSphinxVocabularyPack(dialogs, outputDirectory)) {
+		std::cerr << "Failed to create a vocabulary pack in " << outputDirectory.u8string() << std::endl;
+		return 1;
+	}
+	return 0;
+}
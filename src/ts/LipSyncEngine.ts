@@ -1,10 +1,46 @@
 import type {
   LipSyncEngineResult,
   LipSyncEngineOptions,
+  LipSyncEngineBatchClip,
   LipSyncEngineModule,
-  WasmLoaderOptions,
+  LipSyncEngineMemoryBudget,
+  LipSyncEngineMemoryStats,
+  LipSyncEngineTrace,
+  LipSyncEngineModelAsset,
+  LipSyncEngineInitOptions,
+  LipSyncEngineTransformStreamOptions,
+  LipSyncEngineWarmupLevel,
+  MouthCue,
 } from './types';
+import type { WorkerPool } from './WorkerPool';
 import { WasmLoader } from './WasmLoader';
+import { LipSyncEngineStream } from './LipSyncEngineStream';
+import { readMouthCues, CUE_STRIDE } from './utils/mouthCues';
+import { readFrames } from './utils/frames';
+import {
+  addMouthCueCallback,
+  addProgressCallback,
+  allocateOptions,
+  readStats,
+  readTimings,
+} from './utils/options';
+import { applyMemoryBudget, readMemoryStats } from './utils/memory';
+import { getProcessNameEvent, setModuleTracing, takeModuleTrace } from './utils/tracing';
+import { createSpeaker, saveSpeaker } from './utils/speakerProfile';
+import {
+  ModelLoader,
+  SharedModelStore,
+  MODELS_DIRECTORY,
+  DEFAULT_PRELOADED_ASSETS,
+  applyLanguageModel,
+  canShareModels,
+  getRequiredAssets,
+} from './utils/models';
+import { throwIfAborted } from './utils/abort';
+import { convertToPcm16, getChannels, writeInterleaved } from './utils/convert';
+import { createMouthCueTransformStream } from './utils/transformStream';
+import { warmupModule } from './utils/warmup';
+import type { WarmupOptions } from './utils/warmup';
 
 /**
  * Main API class for Lip Sync
@@ -49,8 +85,21 @@ import { WasmLoader } from './WasmLoader';
 export class LipSyncEngine {
   private static instance: LipSyncEngine | null = null;
   private module: LipSyncEngineModule | null = null;
+  private models: ModelLoader | null = null;
+  /** The page's shared copy of the model files, if cross-origin isolated */
+  private sharedModels: SharedModelStore | null = null;
+  private memoryBudget: LipSyncEngineMemoryBudget | null = null;
   private initialized = false;
   private initPromise: Promise<void> | null = null;
+  private initOptions: LipSyncEngineInitOptions = {};
+  /** Whether analyze() runs in the dedicated worker */
+  private offMainThread = false;
+  /** The dedicated worker, unless the application's `WorkerPool` replaces it */
+  private workerPool: Promise<WorkerPool> | null = null;
+  /** Calls using each dedicated worker, see `acquireWorkerPool()` */
+  private workerPoolCalls: Map<WorkerPool, number> = new Map();
+  /** Dedicated workers replaced while calls were using them, retired once the last one returns */
+  private replacedWorkerPools: Set<WorkerPool> = new Set();
 
   private constructor() {}
 
@@ -64,22 +113,64 @@ export class LipSyncEngine {
     return this.instance;
   }
 
+  /**
+   * Get singleton instance if it has been initialized
+   */
+  static getReadyInstance(): LipSyncEngine | null {
+    return this.instance?.initialized ? this.instance : null;
+  }
+
   /**
    * Initialize the WASM module
    * Call this once before using analyze()
+   * Resolves once the acoustic model is loaded; the other model assets in
+   * `options.preloadModels` keep loading in the background. On a page's main thread, the
+   * dedicated worker of `analyze()` starts too, loading those assets instead.
    *
-   * @param options - Optional paths to WASM files
+   * @param options - Optional paths to WASM files and models
    */
-  async init(options: WasmLoaderOptions = {}): Promise<void> {
+  async init(options: LipSyncEngineInitOptions = {}): Promise<void> {
     if (this.initialized) return;
     if (this.initPromise) return this.initPromise;
 
+    this.initOptions = options;
+    this.offMainThread = options.offMainThread ?? isMainThread();
     this.initPromise = (async () => {
       // Load WASM module
       this.module = await WasmLoader.load(options);
 
+      const languageModel = options.languageModel ?? 'full';
+      let modelsPath: string;
+      if (WasmLoader.isNode()) {
+        // The Node.js build reads the model files in place from the host file system
+        modelsPath = WasmLoader.getModelsDirectory(options);
+      } else {
+        // Fetch the models in parallel. The engine only uses the models directory if it
+        // contains the acoustic model, so wait for that one. Where possible, the files are
+        // those the page's worker pools share, so that they are loaded once.
+        const modelsUrl = WasmLoader.getModelsPath(options);
+        if (canShareModels()) {
+          this.sharedModels =
+            SharedModelStore.acquire(modelsUrl, options.cache !== false, languageModel);
+        }
+        this.models = new ModelLoader(
+          this.module,
+          modelsUrl,
+          options.cache !== false,
+          languageModel,
+          options.pagedLanguageModel === true,
+          this.sharedModels
+        );
+        // Off the main thread, the assets of analyze() are the worker's to load
+        if (!this.offMainThread) {
+          this.models.preload(options.preloadModels ?? DEFAULT_PRELOADED_ASSETS);
+        }
+        await this.models.load('acousticModel');
+        modelsPath = MODELS_DIRECTORY;
+      }
+      applyLanguageModel(this.module, languageModel);
+
       // Initialize LipSyncEngine with models
-      const modelsPath = '/models';
       const modelsPathLen = this.module.lengthBytesUTF8(modelsPath) + 1;
       const modelsPathPtr = this.module._malloc(modelsPathLen);
 
@@ -99,13 +190,39 @@ export class LipSyncEngine {
       } finally {
         this.module._free(modelsPathPtr);
       }
+
+      if (this.offMainThread) {
+        // Failures surface with the first analysis, which retries
+        this.acquireWorkerPool().then((pool) => this.releaseWorkerPool(pool), () => {});
+      }
     })();
 
     return this.initPromise;
   }
 
+  /**
+   * Load model assets ahead of the analyses that need them
+   * Analyses load missing assets anyway; call this to start early, e.g. with
+   * `['phoneLanguageModel']` before switching to the `'phonetic'` recognizer.
+   *
+   * @param assets - The assets to load
+   */
+  async loadModels(assets: LipSyncEngineModelAsset[]): Promise<void> {
+    await this.init();
+    await this.models?.loadAll(assets);
+  }
+
+  /**
+   * Wait for the model assets an analysis needs
+   */
+  private async loadRequiredModels(options: Pick<LipSyncEngineOptions, 'recognizer'>): Promise<void> {
+    await this.models?.loadAll(getRequiredAssets(options, this.memoryBudget));
+  }
+
   /**
    * Analyze audio and generate lip-sync-engine data
+   * On a page's main thread, the analysis runs in a dedicated worker unless `init()` was called
+   * with `offMainThread: false`; the samples are copied to it.
    *
    * @param pcm16 - 16-bit PCM audio buffer (mono, 16kHz recommended)
    * @param options - Optional configuration
@@ -113,69 +230,403 @@ export class LipSyncEngine {
    *
    * @throws {TypeError} If pcm16 is not an Int16Array
    * @throws {Error} If audio buffer is empty
-   * @throws {Error} If analysis fails
+   * @throws {Error} If analysis fails or times out
+   * @throws The reason of `options.signal` if it is aborted
    */
   async analyze(
     pcm16: Int16Array,
     options: LipSyncEngineOptions = {}
   ): Promise<LipSyncEngineResult> {
     await this.init();
+    if (!this.offMainThread) {
+      return this.analyzeOnCurrentThread(pcm16, options);
+    }
 
-    if (!this.module) {
-      throw new Error('Module not initialized');
+    validatePcm16(pcm16, options);
+    const pool = await this.acquireWorkerPool();
+    try {
+      return await pool.analyze(pcm16, options);
+    } finally {
+      this.releaseWorkerPool(pool);
+    }
+  }
+
+  /**
+   * Analyze audio on the calling thread, e.g. in a worker of the application's own
+   * Blocks the thread while decoding; the returned promise only waits for initialization and
+   * missing model assets.
+   *
+   * @param pcm16 - 16-bit PCM audio buffer (mono, 16kHz recommended)
+   * @param options - Optional configuration
+   * @returns Promise resolving to lip-sync-engine result with mouth cues
+   *
+   * @throws {TypeError} If pcm16 is not an Int16Array
+   * @throws {Error} If audio buffer is empty
+   * @throws {Error} If analysis fails or times out
+   * @throws The reason of `options.signal` if it is aborted before the analysis starts; a running
+   *   analysis blocks this thread, so it can't be aborted
+   */
+  async analyzeOnCurrentThread(
+    pcm16: Int16Array,
+    options: LipSyncEngineOptions = {}
+  ): Promise<LipSyncEngineResult> {
+    await this.init();
+    await this.loadRequiredModels(options);
+    throwIfAborted(options.signal);
+    validatePcm16(pcm16, options);
+
+    const { sampleRate = 16000 } = options;
+    return this.analyzeSamples(
+      pcm16.length * 2,
+      (module, samplesPtr) => module.HEAP16.set(pcm16, samplesPtr / 2),
+      (module, samplesPtr, dialogPtr, optionsPtr, cueCountPtr) =>
+        module._lipsyncengine_analyze_pcm16_binary(
+          samplesPtr,
+          pcm16.length,
+          sampleRate,
+          dialogPtr,
+          optionsPtr,
+          cueCountPtr
+        ),
+      options
+    );
+  }
+
+  /**
+   * Analyze float audio, such as the channel data of a Web Audio API AudioBuffer
+   * Saves converting the samples to PCM16 first. Interleaved channels are mixed down to mono by
+   * the engine.
+   *
+   * @param samples - Samples in [-1, 1], with `options.channelCount` interleaved channels (default: 1)
+   * @param options - Optional configuration
+   * @returns Promise resolving to lip-sync-engine result with mouth cues
+   *
+   * @throws {TypeError} If samples is not a Float32Array
+   * @throws {Error} If audio buffer is empty or doesn't hold whole frames
+   * @throws {Error} If analysis fails or times out
+   */
+  async analyzeFloat32(
+    samples: Float32Array,
+    options: LipSyncEngineOptions & { channelCount?: number } = {}
+  ): Promise<LipSyncEngineResult> {
+    await this.init();
+    await this.loadRequiredModels(options);
+    throwIfAborted(options.signal);
+
+    const { sampleRate = 16000, channelCount = 1 } = options;
+
+    if (!(samples instanceof Float32Array)) {
+      throw new TypeError('samples must be a Float32Array');
     }
 
-    const { dialogText, sampleRate = 16000 } = options;
+    if (samples.length === 0) {
+      throw new Error('samples buffer is empty');
+    }
 
-    // Validate input
-    if (!(pcm16 instanceof Int16Array)) {
-      throw new TypeError('pcm16 must be an Int16Array');
+    if (!Number.isInteger(channelCount) || channelCount <= 0) {
+      throw new Error('channelCount must be a positive integer');
     }
 
-    if (pcm16.length === 0) {
-      throw new Error('pcm16 buffer is empty');
+    if (samples.length % channelCount !== 0) {
+      throw new Error('samples must hold the same number of samples for each channel');
     }
 
     if (sampleRate <= 0) {
       throw new Error('sampleRate must be positive');
     }
 
-    let pcm16Ptr = 0;
+    const frameCount = samples.length / channelCount;
+    return this.analyzeSamples(
+      samples.length * 4,
+      (module, samplesPtr) => module.HEAPF32.set(samples, samplesPtr / 4),
+      (module, samplesPtr, dialogPtr, optionsPtr, cueCountPtr) =>
+        module._lipsyncengine_analyze_f32_interleaved(
+          samplesPtr,
+          frameCount,
+          channelCount,
+          sampleRate,
+          dialogPtr,
+          optionsPtr,
+          cueCountPtr
+        ),
+      options
+    );
+  }
+
+  /**
+   * Analyze a Web Audio API AudioBuffer at its own sample rate
+   * The channels are copied into WASM memory once, interleaved, and mixed down to mono by the
+   * engine; there is no conversion or resampling in JavaScript.
+   *
+   * @param audioBuffer - Decoded or recorded audio with any number of channels
+   * @param options - Optional configuration (`sampleRate` is taken from the buffer)
+   * @returns Promise resolving to lip-sync-engine result with mouth cues
+   *
+   * @throws {Error} If the buffer is empty or analysis fails
+   */
+  async analyzeAudioBuffer(
+    audioBuffer: AudioBuffer,
+    options: Omit<LipSyncEngineOptions, 'sampleRate'> = {}
+  ): Promise<LipSyncEngineResult> {
+    await this.init();
+    await this.loadRequiredModels(options);
+    throwIfAborted(options.signal);
+
+    const { length: frameCount, numberOfChannels: channelCount, sampleRate } = audioBuffer;
+    if (frameCount === 0) {
+      throw new Error('audioBuffer is empty');
+    }
+
+    return this.analyzeSamples(
+      frameCount * channelCount * 4,
+      (module, samplesPtr) => writeInterleaved(module, getChannels(audioBuffer), samplesPtr),
+      (module, samplesPtr, dialogPtr, optionsPtr, cueCountPtr) =>
+        module._lipsyncengine_analyze_f32_interleaved(
+          samplesPtr,
+          frameCount,
+          channelCount,
+          sampleRate,
+          dialogPtr,
+          optionsPtr,
+          cueCountPtr
+        ),
+      { ...options, sampleRate }
+    );
+  }
+
+  /**
+   * Recognize the phones of audio on the calling thread, without animating them
+   * Pass the phones to animate() to get mouth cues, as many times as needed, e.g. with other
+   * `extendedShapes`, without recognizing the audio again. They can also be stored.
+   *
+   * @param pcm16 - 16-bit PCM audio buffer (mono, 16kHz recommended)
+   * @param options - Optional configuration (`dialogText`, `sampleRate`, `threadCount`, `recognizer`, `profile`, `dialogMode` and `timeoutMs` apply)
+   * @returns Promise resolving to the phones in the engine's binary format
+   *
+   * @throws {TypeError} If pcm16 is not an Int16Array
+   * @throws {Error} If audio buffer is empty
+   * @throws {Error} If recognition fails or times out
+   */
+  async recognize(
+    pcm16: Int16Array,
+    options: Omit<LipSyncEngineOptions, 'extendedShapes' | 'speakerProfile' | 'onMouthCues' | 'onPreview'> = {}
+  ): Promise<Uint8Array> {
+    await this.init();
+    await this.loadRequiredModels(options);
+    throwIfAborted(options.signal);
+    validatePcm16(pcm16, options);
+
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+
+    const module = this.module;
+    const { dialogText, sampleRate = 16000, threadCount = 1 } = options;
+    let samplesPtr = 0;
     let dialogPtr = 0;
+    let optionsPtr = 0;
+    let byteCountPtr = 0;
+    let phonesPtr = 0;
+    let progressCallbackPtr = 0;
+
+    try {
+      samplesPtr = module._malloc(pcm16.length * 2);
+      module.HEAP16.set(pcm16, samplesPtr / 2);
+      if (dialogText) {
+        const dialogLen = module.lengthBytesUTF8(dialogText) + 1;
+        dialogPtr = module._malloc(dialogLen);
+        module.stringToUTF8(dialogText, dialogPtr, dialogLen);
+      }
+      if (options.onProgress) {
+        progressCallbackPtr = addProgressCallback(module, options.onProgress);
+      }
+      optionsPtr = allocateOptions(module, options, 0, progressCallbackPtr);
+      module._lipsyncengine_set_max_thread_count(Math.max(1, threadCount));
+
+      byteCountPtr = module._malloc(4);
+      phonesPtr = module._lipsyncengine_recognize_pcm16(
+        samplesPtr,
+        pcm16.length,
+        sampleRate,
+        dialogPtr,
+        optionsPtr,
+        byteCountPtr
+      );
+      if (!phonesPtr) {
+        const errorPtr = module._lipsyncengine_get_last_error();
+        throw new Error(errorPtr ? module.UTF8ToString(errorPtr) : 'Recognition failed');
+      }
+      const byteCount = module.HEAP32[byteCountPtr / 4];
+      return module.HEAPU8.slice(phonesPtr, phonesPtr + byteCount);
+    } finally {
+      if (samplesPtr) module._free(samplesPtr);
+      if (dialogPtr) module._free(dialogPtr);
+      if (optionsPtr) module._free(optionsPtr);
+      if (byteCountPtr) module._free(byteCountPtr);
+      if (phonesPtr) module._lipsyncengine_free(phonesPtr);
+      if (progressCallbackPtr) module.removeFunction(progressCallbackPtr);
+    }
+  }
+
+  /**
+   * Animate phones returned by recognize()
+   * Only runs the animation, which takes milliseconds where recognition takes seconds.
+   *
+   * @param phones - Phones in the engine's binary format
+   * @param options - Optional configuration (`extendedShapes`, `threadCount`, `frameRate` and `frameBlending` apply)
+   * @returns Promise resolving to lip-sync-engine result with mouth cues
+   *
+   * @throws {Error} If the bytes aren't phones returned by recognize()
+   */
+  async animate(
+    phones: Uint8Array,
+    options: Pick<LipSyncEngineOptions, 'extendedShapes' | 'threadCount' | 'frameRate' | 'frameBlending'> = {}
+  ): Promise<LipSyncEngineResult> {
+    await this.init();
+
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+
+    const module = this.module;
+    let phonesPtr = 0;
+    let optionsPtr = 0;
+    let cueCountPtr = 0;
     let resultPtr = 0;
 
     try {
-      // Allocate PCM buffer in WASM memory
-      const pcm16Bytes = pcm16.length * 2;
-      pcm16Ptr = this.module._malloc(pcm16Bytes);
-      this.module.HEAP16.set(pcm16, pcm16Ptr / 2);
+      phonesPtr = module._malloc(phones.length);
+      module.HEAPU8.set(phones, phonesPtr);
+      optionsPtr = allocateOptions(module, options);
+      module._lipsyncengine_set_max_thread_count(Math.max(1, options.threadCount ?? 1));
+
+      cueCountPtr = module._malloc(4);
+      resultPtr = module._lipsyncengine_animate(phonesPtr, phones.length, optionsPtr, cueCountPtr);
+      if (!resultPtr) {
+        const errorPtr = module._lipsyncengine_get_last_error();
+        throw new Error(errorPtr ? module.UTF8ToString(errorPtr) : 'Animation failed');
+      }
+
+      const cueCount = module.HEAP32[cueCountPtr / 4];
+      const result: LipSyncEngineResult = {
+        mouthCues: readMouthCues(module, resultPtr, cueCount),
+      };
+      if (options.frameRate !== undefined) {
+        result.frames = readFrames(module, resultPtr, cueCount, options);
+      }
+      return result;
+    } finally {
+      if (phonesPtr) module._free(phonesPtr);
+      if (optionsPtr) module._free(optionsPtr);
+      if (cueCountPtr) module._free(cueCountPtr);
+      if (resultPtr) module._lipsyncengine_free(resultPtr);
+    }
+  }
+
+  /**
+   * Copy samples into WASM memory and run one of the binary analysis functions on them
+   *
+   * @param byteLength - Size of the samples in WASM memory
+   * @param writeSamples - Writes the samples to the allocated memory
+   * @param run - Calls the analysis function, returning its result pointer
+   * @param options - Options of the analysis
+   */
+  private analyzeSamples(
+    byteLength: number,
+    writeSamples: (module: LipSyncEngineModule, samplesPtr: number) => void,
+    run: (
+      module: LipSyncEngineModule,
+      samplesPtr: number,
+      dialogPtr: number,
+      optionsPtr: number,
+      cueCountPtr: number
+    ) => number,
+    options: LipSyncEngineOptions
+  ): LipSyncEngineResult {
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+
+    const module = this.module;
+    const { dialogText, sampleRate = 16000, threadCount = 1 } = options;
+    let samplesPtr = 0;
+    let dialogPtr = 0;
+    let optionsPtr = 0;
+    let cueCountPtr = 0;
+    let resultPtr = 0;
+    let progressCallbackPtr = 0;
+    let cueCallbackPtr = 0;
+    let previewCallbackPtr = 0;
+    let speaker = 0;
+
+    try {
+      // Allocate the samples in WASM memory
+      samplesPtr = module._malloc(byteLength);
+      writeSamples(module, samplesPtr);
 
       // Allocate dialog text if provided
       if (dialogText) {
-        const dialogLen = this.module.lengthBytesUTF8(dialogText) + 1;
-        dialogPtr = this.module._malloc(dialogLen);
-        this.module.stringToUTF8(dialogText, dialogPtr, dialogLen);
+        const dialogLen = module.lengthBytesUTF8(dialogText) + 1;
+        dialogPtr = module._malloc(dialogLen);
+        module.stringToUTF8(dialogText, dialogPtr, dialogLen);
       }
 
-      // Call WASM function
-      resultPtr = this.module._lipsyncengine_analyze_pcm16(
-        pcm16Ptr,
-        pcm16.length,
-        sampleRate,
-        dialogPtr
+      if (options.onProgress) {
+        progressCallbackPtr = addProgressCallback(module, options.onProgress);
+      }
+      if (options.onMouthCues) {
+        cueCallbackPtr = addMouthCueCallback(module, options.onMouthCues);
+      }
+      if (options.onPreview) {
+        previewCallbackPtr = addMouthCueCallback(module, options.onPreview);
+      }
+      if (options.speakerProfile) {
+        speaker = createSpeaker(module, options.speakerProfile);
+      }
+      optionsPtr = allocateOptions(
+        module,
+        options,
+        0,
+        progressCallbackPtr,
+        0,
+        cueCallbackPtr,
+        speaker,
+        previewCallbackPtr
       );
+      module._lipsyncengine_set_max_thread_count(Math.max(1, threadCount));
+
+      // Call WASM function, receiving the cues in binary format
+      cueCountPtr = module._malloc(4);
+      resultPtr = run(module, samplesPtr, dialogPtr, optionsPtr, cueCountPtr);
 
       if (!resultPtr) {
-        const errorPtr = this.module._lipsyncengine_get_last_error();
+        const errorPtr = module._lipsyncengine_get_last_error();
         const error = errorPtr
-          ? this.module.UTF8ToString(errorPtr)
+          ? module.UTF8ToString(errorPtr)
           : 'Analysis failed';
         throw new Error(error);
       }
 
-      // Parse JSON result
-      const resultJson = this.module.UTF8ToString(resultPtr);
-      const result: LipSyncEngineResult = JSON.parse(resultJson);
+      // Read cues directly from WASM memory
+      const cueCount = module.HEAP32[cueCountPtr / 4];
+      const result: LipSyncEngineResult = {
+        mouthCues: readMouthCues(module, resultPtr, cueCount),
+      };
+      if (options.frameRate !== undefined) {
+        result.frames = readFrames(module, resultPtr, cueCount, options);
+      }
+      const stats = readStats(module, optionsPtr);
+      if (stats) {
+        result.stats = stats;
+      }
+      const timings = readTimings(module, optionsPtr);
+      if (timings) {
+        result.words = timings.words;
+        result.phones = timings.phones;
+      }
+      if (speaker) {
+        result.speakerProfile = saveSpeaker(module, speaker);
+      }
 
       // Add metadata
       result.metadata = {
@@ -187,12 +638,535 @@ export class LipSyncEngine {
       return result;
     } finally {
       // Always cleanup allocated memory
-      if (pcm16Ptr) this.module._free(pcm16Ptr);
-      if (dialogPtr) this.module._free(dialogPtr);
-      if (resultPtr) this.module._lipsyncengine_free(resultPtr);
+      if (samplesPtr) module._free(samplesPtr);
+      if (dialogPtr) module._free(dialogPtr);
+      if (optionsPtr) module._free(optionsPtr);
+      if (cueCountPtr) module._free(cueCountPtr);
+      if (resultPtr) module._lipsyncengine_free(resultPtr);
+      if (progressCallbackPtr) module.removeFunction(progressCallbackPtr);
+      if (cueCallbackPtr) module.removeFunction(cueCallbackPtr);
+      if (previewCallbackPtr) module.removeFunction(previewCallbackPtr);
+      if (speaker) module._lipsyncengine_speaker_release(speaker);
     }
   }
 
+  /**
+   * Analyze many clips in one call
+   * Much cheaper than analyzing the clips one by one: the utterances of all clips share one work
+   * queue, and clips with identical dialog text share its language model.
+   *
+   * @param clips - Audio clips with their optional dialog text and sample rate
+   * @param options - Optional configuration (`threadCount`, `extendedShapes`, `recognizer`, `profile`, `dialogMode`, `collectStats`, `signal`, `timeoutMs`, `frameRate`, `frameBlending` and `onProgress` apply to the whole batch)
+   * @returns Promise resolving to one result per clip, in the same order
+   *
+   * @throws {TypeError} If a clip's pcm16 is not an Int16Array
+   * @throws {Error} If a clip is empty or analysis fails
+   */
+  async analyzeBatch(
+    clips: LipSyncEngineBatchClip[],
+    options: Pick<
+      LipSyncEngineOptions,
+      | 'threadCount'
+      | 'extendedShapes'
+      | 'recognizer'
+      | 'profile'
+      | 'dialogMode'
+      | 'collectStats'
+      | 'signal'
+      | 'timeoutMs'
+      | 'frameRate'
+      | 'frameBlending'
+    > = {}
+  ): Promise<LipSyncEngineResult[]> {
+    await this.init();
+    await this.loadRequiredModels(options);
+    throwIfAborted(options.signal);
+
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+
+    if (clips.length === 0) {
+      return [];
+    }
+
+    const module = this.module;
+    const { threadCount = 1 } = options;
+
+    clips.forEach(({ pcm16, sampleRate = 16000 }, index) => {
+      if (!(pcm16 instanceof Int16Array)) {
+        throw new TypeError(`Clip ${index}: pcm16 must be an Int16Array`);
+      }
+      if (pcm16.length === 0) {
+        throw new Error(`Clip ${index}: pcm16 buffer is empty`);
+      }
+      if (sampleRate <= 0) {
+        throw new Error(`Clip ${index}: sampleRate must be positive`);
+      }
+    });
+
+    const allocations: number[] = [];
+    const allocate = (size: number): number => {
+      const ptr = module._malloc(size);
+      allocations.push(ptr);
+      return ptr;
+    };
+    let resultPtr = 0;
+    let progressCallbackPtr = 0;
+
+    try {
+      // Array of lipsyncengine_batch_clip: pcm16, sample_count, sample_rate, dialog_text
+      const clipsPtr = allocate(clips.length * 16);
+      clips.forEach(({ pcm16, dialogText, sampleRate = 16000 }, index) => {
+        const pcm16Ptr = allocate(pcm16.length * 2);
+        module.HEAP16.set(pcm16, pcm16Ptr / 2);
+
+        let dialogPtr = 0;
+        if (dialogText) {
+          const dialogLen = module.lengthBytesUTF8(dialogText) + 1;
+          dialogPtr = allocate(dialogLen);
+          module.stringToUTF8(dialogText, dialogPtr, dialogLen);
+        }
+
+        // Write after allocating, as growing memory replaces the heap views
+        module.HEAP32.set(
+          [pcm16Ptr, pcm16.length, sampleRate, dialogPtr],
+          clipsPtr / 4 + index * 4
+        );
+      });
+
+      if (options.onProgress) {
+        progressCallbackPtr = addProgressCallback(module, options.onProgress);
+      }
+      const optionsPtr = allocateOptions(module, options, 0, progressCallbackPtr);
+      allocations.push(optionsPtr);
+      module._lipsyncengine_set_max_thread_count(Math.max(1, threadCount));
+
+      const cueCountsPtr = allocate(clips.length * 4);
+      resultPtr = module._lipsyncengine_analyze_batch(
+        clipsPtr,
+        clips.length,
+        optionsPtr,
+        cueCountsPtr
+      );
+
+      if (!resultPtr) {
+        const errorPtr = module._lipsyncengine_get_last_error();
+        const error = errorPtr
+          ? module.UTF8ToString(errorPtr)
+          : 'Batch analysis failed';
+        throw new Error(error);
+      }
+
+      const stats = readStats(module, optionsPtr);
+
+      // The cues of all clips are stored one clip after another
+      let cuePtr = resultPtr;
+      return clips.map(({ dialogText, sampleRate = 16000 }, index) => {
+        const cueCount = module.HEAP32[cueCountsPtr / 4 + index];
+        const mouthCues = readMouthCues(module, cuePtr, cueCount);
+        const frames = options.frameRate !== undefined
+          ? readFrames(module, cuePtr, cueCount, options)
+          : undefined;
+        cuePtr += cueCount * CUE_STRIDE * 4;
+
+        return {
+          mouthCues,
+          ...(frames && { frames }),
+          metadata: {
+            duration: mouthCues[mouthCues.length - 1]?.end || 0,
+            sampleRate,
+            dialogText,
+          },
+          ...(stats && { stats }),
+        };
+      });
+    } finally {
+      allocations.forEach((ptr) => module._free(ptr));
+      if (resultPtr) module._lipsyncengine_free(resultPtr);
+      if (progressCallbackPtr) module.removeFunction(progressCallbackPtr);
+    }
+  }
+
+  /**
+   * Begin a streaming analysis session
+   * Use this for live audio: push chunks as they arrive and receive finalized mouth cues
+   * utterance by utterance.
+   *
+   * @param options - Optional configuration
+   * @returns Promise resolving to the session
+   */
+  async createStream(
+    options: LipSyncEngineOptions = {}
+  ): Promise<LipSyncEngineStream> {
+    await this.init();
+    await this.loadRequiredModels(options);
+
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+
+    return LipSyncEngineStream.begin(this.module, options);
+  }
+
+  /**
+   * Continue a streaming session saved with `LipSyncEngineStream.save()`, e.g. in another worker
+   * The sample rate and dialog text are those of the saved session; the other options may differ.
+   *
+   * @param state - Bytes returned by `LipSyncEngineStream.save()`
+   * @param options - Optional configuration
+   * @returns Promise resolving to the session
+   *
+   * @throws {Error} If the bytes aren't the state of a session
+   */
+  async restoreStream(
+    state: Uint8Array,
+    options: LipSyncEngineOptions = {}
+  ): Promise<LipSyncEngineStream> {
+    await this.init();
+    await this.loadRequiredModels(options);
+
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+
+    return LipSyncEngineStream.restore(this.module, state, options);
+  }
+
+  /**
+   * Create a TransformStream that analyzes the audio piped through it
+   * Chunks written are pushed to a streaming session, begun when the stream starts; each chunk
+   * read is the array of mouth cues the session finalized, in seconds from the start. On a page's
+   * main thread, the session runs in a worker of its own, like `WorkerPool.createTransformStream()`;
+   * otherwise it runs on this thread, like `createStream()`. Writes wait while the analysis is
+   * behind or the cues aren't read, so a source of any length is read in constant memory.
+   *
+   * @param options - Analysis options and the tentative cues callback
+   * @returns The stream, which ends its session once closed
+   *
+   * @example
+   * ```typescript
+   * // pcm16Chunks is a ReadableStream<Int16Array>, e.g. of a long recording
+   * await pcm16Chunks
+   *   .pipeThrough(lipSyncEngine.createTransformStream({ sampleRate: 16000 }))
+   *   .pipeTo(new WritableStream({ write: (mouthCues) => avatar.enqueue(mouthCues) }));
+   * ```
+   */
+  createTransformStream(
+    options: LipSyncEngineTransformStreamOptions = {}
+  ): TransformStream<Int16Array, MouthCue[]> {
+    const { onTentativeCues, ...analysisOptions } = options;
+    return createMouthCueTransformStream(async () => {
+      await this.init();
+      if (this.offMainThread) {
+        // Once created, the stream keeps its worker until it ends
+        const pool = await this.acquireWorkerPool();
+        try {
+          return await pool.createStream(analysisOptions);
+        } finally {
+          this.releaseWorkerPool(pool);
+        }
+      }
+      return this.createStream(analysisOptions);
+    }, onTentativeCues);
+  }
+
+  /**
+   * Mix float audio down to mono PCM16 at another sample rate, using the engine's resampler
+   * Runs vectorized in WASM, but on this thread; `WorkerPool.convertToPcm16()` runs in a worker.
+   *
+   * @param channels - Samples in [-1, 1] of each channel, all of the same length
+   * @param sampleRate - Sample rate of the channels
+   * @param targetSampleRate - Sample rate of the result (default: 16000)
+   * @returns Promise resolving to the PCM16 samples
+   *
+   * @throws {Error} If the audio is empty or the channels differ in length
+   */
+  async convertToPcm16(
+    channels: Float32Array[],
+    sampleRate: number,
+    targetSampleRate = 16000
+  ): Promise<Int16Array> {
+    await this.init();
+
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+    return convertToPcm16(this.module, channels, sampleRate, targetSampleRate);
+  }
+
+  /**
+   * Get the heap usage of the WASM module
+   * Useful to see how far the heap grows with long clips or several decoders.
+   *
+   * @returns Current and peak heap usage, model size and decoder count
+   * @throws {Error} If the module isn't initialized
+   */
+  getMemoryStats(): LipSyncEngineMemoryStats {
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+    return readMemoryStats(this.module);
+  }
+
+  /**
+   * Start or stop recording trace spans of the engine's work: voice activity detection, the
+   * recognition of each utterance, alignment, the animation passes, building language models and
+   * creating decoders. The most recent spans are kept until `takeTrace()`.
+   *
+   * @param enabled - Whether to record spans; stopping discards those not taken yet
+   * @throws {Error} If the module isn't initialized
+   */
+  setTracing(enabled: boolean): void {
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+    setModuleTracing(this.module, enabled);
+  }
+
+  /**
+   * Take the trace spans recorded since the last call
+   * Each thread of the module gets its own track. Analyses of `WorkerPool` are traced with
+   * `WorkerPool.setTracing()` instead.
+   *
+   * @returns A trace to save as JSON and open in chrome://tracing or Perfetto
+   * @throws {Error} If the module isn't initialized
+   *
+   * @example
+   * ```typescript
+   * lipSyncEngine.setTracing(true);
+   * await lipSyncEngine.analyze(pcm16, { dialogText });
+   * const json = JSON.stringify(lipSyncEngine.takeTrace());
+   * ```
+   */
+  takeTrace(): LipSyncEngineTrace {
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+    return {
+      traceEvents: [getProcessNameEvent(1, 'engine'), ...takeModuleTrace(this.module, 1)]
+    };
+  }
+
+  /**
+   * Estimate how long analyzing audio takes, e.g. to show it before the analysis starts
+   * Learned from the speed of earlier analyses with the same recognizer and profile; until there
+   * have been any, typical speeds of a desktop CPU are assumed. Silence and utterances analyzed
+   * before make analyses faster than estimated.
+   *
+   * @param sampleCount - Number of samples of the audio
+   * @param options - Analysis options; `sampleRate`, `threadCount`, `recognizer` and `profile` apply
+   * @returns The estimated duration in milliseconds
+   * @throws {Error} If the module isn't initialized or the options are invalid
+   */
+  estimateDurationMs(sampleCount: number, options: LipSyncEngineOptions = {}): number {
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+
+    const module = this.module;
+    const optionsPtr = allocateOptions(module, { ...options, collectStats: false });
+    try {
+      module._lipsyncengine_set_max_thread_count(Math.max(1, options.threadCount ?? 1));
+      const estimate = module._lipsyncengine_estimate_milliseconds(
+        sampleCount,
+        options.sampleRate || 16000,
+        optionsPtr
+      );
+      if (estimate < 0) {
+        const errorPtr = module._lipsyncengine_get_last_error();
+        throw new Error(errorPtr ? module.UTF8ToString(errorPtr) : 'Estimation failed');
+      }
+      return estimate;
+    } finally {
+      module._free(optionsPtr);
+    }
+  }
+
+  /**
+   * Create decoders ahead of the first analysis, so that it doesn't wait for their creation
+   * A pocketSphinx decoder takes a few hundred milliseconds to create. Decoders count against the
+   * memory budget.
+   *
+   * @param options - Analysis options; `recognizer`, `profile` and `threadCount` apply. As many
+   *   decoders as `threadCount` are created.
+   * @throws {Error} If the module isn't initialized, the options are invalid or the decoders don't
+   *   fit the memory budget
+   */
+  async prewarm(options: LipSyncEngineOptions = {}): Promise<void> {
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+    await this.loadRequiredModels(options);
+
+    const module = this.module;
+    const optionsPtr = allocateOptions(module, { ...options, collectStats: false });
+    try {
+      if (module._lipsyncengine_prewarm(Math.max(1, options.threadCount ?? 1), optionsPtr) !== 0) {
+        const errorPtr = module._lipsyncengine_get_last_error();
+        throw new Error(errorPtr ? module.UTF8ToString(errorPtr) : 'Prewarming failed');
+      }
+    } finally {
+      module._free(optionsPtr);
+    }
+  }
+
+  /**
+   * Warm up the engine, so that the first analysis is as fast as later ones
+   * Without it, the first analysis creates decoders, touches the models and runs code the JIT
+   * hasn't compiled yet, which can make it several times slower. On a page's main thread, the
+   * dedicated worker of `analyze()` is warmed up instead (see `WorkerPool.warmup()`).
+   *
+   * @param level - How much of the first analysis to do ahead of time (default: `'full'`)
+   * @param options - `recognizer`, `profile`, `dialogMode` and `threadCount` apply; as many
+   *   decoders as `threadCount` are created
+   * @throws {Error} If the module isn't initialized, the options are invalid or the decoders don't
+   *   fit the memory budget
+   */
+  async warmup(level: LipSyncEngineWarmupLevel = 'full', options: WarmupOptions = {}): Promise<void> {
+    await this.init();
+    if (this.offMainThread) {
+      const pool = await this.acquireWorkerPool();
+      try {
+        return await pool.warmup(level, options);
+      } finally {
+        this.releaseWorkerPool(pool);
+      }
+    }
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+    await this.loadRequiredModels(options);
+    warmupModule(this.module, level, options);
+  }
+
+  /**
+   * Limit the heap memory of the WASM module, e.g. to keep a mobile tab from running out of memory
+   * Before each analysis, the current heap usage plus an estimate for the audio and for the
+   * decoders that would have to be created is checked against the budget. A pocketSphinx decoder
+   * takes about 80 MB, a phonetic one a few MB.
+   *
+   * @param budget - The budget, or null to remove it
+   * @throws {Error} If the module isn't initialized or the budget is invalid
+   *
+   * @example
+   * ```typescript
+   * await lipSyncEngine.init();
+   * lipSyncEngine.setMemoryBudget({ bytes: 96 * 1024 * 1024, onExceeded: 'phonetic' });
+   * ```
+   */
+  setMemoryBudget(budget: LipSyncEngineMemoryBudget | null): void {
+    if (!this.module) {
+      throw new Error('Module not initialized');
+    }
+    applyMemoryBudget(this.module, budget);
+    this.memoryBudget = budget;
+    // The dedicated worker takes its budget when it starts, so start a new one
+    this.retireWorkerPool();
+  }
+
+  /**
+   * Get the pool that analyze() runs in: the application's `WorkerPool` singleton once it has
+   * been initialized, unless `shareWorkerPool` is false, so that using both APIs doesn't run a
+   * second engine; otherwise the dedicated worker, starting it if needed.
+   * The call uses the pool until it passes it to `releaseWorkerPool()`. A dedicated worker replaced
+   * meanwhile keeps the work the call gives it, and is destroyed once that is done.
+   */
+  private async acquireWorkerPool(): Promise<WorkerPool> {
+    for (;;) {
+      if (this.initOptions.shareWorkerPool !== false) {
+        // Lazy load WorkerPool to avoid circular dependencies
+        const { WorkerPool } = await import('./WorkerPool');
+        const applicationPool = WorkerPool.getReadyInstance();
+        if (applicationPool) {
+          this.retireWorkerPool();
+          return applicationPool;
+        }
+      }
+      const promise = this.startWorkerPool();
+      const pool = await promise;
+      // Counted before anything else runs, so that retiring the worker now waits for this call
+      if (this.workerPool === promise) {
+        this.workerPoolCalls.set(pool, (this.workerPoolCalls.get(pool) ?? 0) + 1);
+        return pool;
+      }
+      // Replaced while starting; the call goes to its replacement
+    }
+  }
+
+  /**
+   * End a call's use of the pool from `acquireWorkerPool()`
+   */
+  private releaseWorkerPool(pool: WorkerPool): void {
+    const calls = this.workerPoolCalls.get(pool);
+    // The application's pool isn't counted
+    if (calls === undefined) return;
+    if (calls > 1) {
+      this.workerPoolCalls.set(pool, calls - 1);
+      return;
+    }
+    this.workerPoolCalls.delete(pool);
+    if (this.replacedWorkerPools.delete(pool)) {
+      pool.destroyWhenIdle();
+    }
+  }
+
+  /**
+   * Start the dedicated worker, unless it is running
+   */
+  private startWorkerPool(): Promise<WorkerPool> {
+    if (!this.workerPool) {
+      const {
+        offMainThread,
+        workerScriptUrl,
+        wasmModule,
+        threads,
+        shareWorkerPool,
+        ...options
+      } = this.initOptions;
+      const promise = (async () => {
+        // Lazy load WorkerPool to avoid circular dependencies
+        const { WorkerPool } = await import('./WorkerPool');
+        const pool = WorkerPool.create(1, workerScriptUrl);
+        await pool.init({ ...options, memoryBudget: this.memoryBudget ?? undefined });
+        return pool;
+      })();
+      promise.catch(() => {
+        if (this.workerPool === promise) this.workerPool = null;
+      });
+      this.workerPool = promise;
+    }
+    return this.workerPool;
+  }
+
+  /**
+   * Route later calls away from the dedicated worker, and destroy it once the calls using it
+   * have returned and the jobs and streams they gave it are done
+   */
+  private retireWorkerPool(): void {
+    const promise = this.workerPool;
+    if (!promise) return;
+    this.workerPool = null;
+    promise.then((pool) => {
+      if (this.workerPoolCalls.has(pool)) {
+        this.replacedWorkerPools.add(pool);
+      } else {
+        pool.destroyWhenIdle();
+      }
+    }, () => {});
+  }
+
+  /**
+   * Destroy the dedicated worker at once, ending its jobs and streams
+   */
+  private destroyWorkerPool(): void {
+    this.workerPool?.then((pool) => pool.destroy()).catch(() => {});
+    this.workerPool = null;
+    this.workerPoolCalls.forEach((_calls, pool) => pool.destroy());
+    this.workerPoolCalls.clear();
+    this.replacedWorkerPools.clear();
+  }
+
   /**
    * Analyze audio using Web Worker (non-blocking)
    * Recommended for long audio files to avoid blocking UI
@@ -216,13 +1190,40 @@ export class LipSyncEngine {
    * Call this when you're completely done with lip-sync-engine analysis
    */
   destroy(): void {
+    this.destroyWorkerPool();
     this.module = null;
+    this.models = null;
+    this.sharedModels?.release();
+    this.sharedModels = null;
+    this.memoryBudget = null;
     this.initialized = false;
     this.initPromise = null;
     LipSyncEngine.instance = null;
   }
 }
 
+/**
+ * Whether this runs on a page's main thread, where long synchronous calls block rendering
+ */
+function isMainThread(): boolean {
+  return typeof window !== 'undefined' && typeof document !== 'undefined' && typeof Worker !== 'undefined';
+}
+
+/**
+ * Check the arguments of an analysis of PCM16 samples
+ */
+function validatePcm16(pcm16: Int16Array, options: LipSyncEngineOptions): void {
+  if (!(pcm16 instanceof Int16Array)) {
+    throw new TypeError('pcm16 must be an Int16Array');
+  }
+  if (pcm16.length === 0) {
+    throw new Error('pcm16 buffer is empty');
+  }
+  if ((options.sampleRate ?? 16000) <= 0) {
+    throw new Error('sampleRate must be positive');
+  }
+}
+
 /**
  * Convenience function for one-off analysis
  * Framework-agnostic - works everywhere
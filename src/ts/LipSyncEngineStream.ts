@@ -0,0 +1,271 @@
+import type {
+  LipSyncEngineModule,
+  LipSyncEngineOptions,
+  LipSyncEngineStreamResult,
+  MouthCue,
+} from './types';
+import { allocateOptions } from './utils/options';
+import { findTentativeCuesChange } from './utils/cueDeltas';
+
+/**
+ * Streaming analysis session
+ * Keeps voice activity detection and decoder state across pushes, so words aren't cut at chunk
+ * boundaries. Each utterance is recognized as soon as it is complete.
+ *
+ * Create sessions with `LipSyncEngine.createStream()`.
+ *
+ * @example
+ * ```typescript
+ * const stream = await lipSyncEngine.createStream({ sampleRate: 16000 });
+ * for await (const chunk of microphoneChunks) {
+ *   const { mouthCues } = stream.push(chunk);
+ *   avatar.enqueue(mouthCues);
+ * }
+ * avatar.enqueue(stream.end().mouthCues);
+ * ```
+ */
+export class LipSyncEngineStream {
+  private ended = false;
+  /** The tentative cues of the previous result */
+  private tentativeCues: MouthCue[] = [];
+  private generation = 0;
+
+  /** @internal */
+  constructor(
+    private readonly module: LipSyncEngineModule,
+    private readonly handle: number
+  ) {}
+
+  /**
+   * Begin a session in a module whose engine is initialized and has the models the options need
+   *
+   * @internal
+   */
+  static begin(
+    module: LipSyncEngineModule,
+    options: Omit<LipSyncEngineOptions, 'signal'> = {}
+  ): LipSyncEngineStream {
+    const { dialogText, sampleRate = 16000 } = options;
+    let dialogPtr = 0;
+    let optionsPtr = 0;
+
+    try {
+      if (dialogText) {
+        const dialogLen = module.lengthBytesUTF8(dialogText) + 1;
+        dialogPtr = module._malloc(dialogLen);
+        module.stringToUTF8(dialogText, dialogPtr, dialogLen);
+      }
+
+      optionsPtr = allocateOptions(module, options);
+      const handle = module._lipsyncengine_stream_begin(sampleRate, dialogPtr, optionsPtr);
+      if (handle < 0) {
+        const errorPtr = module._lipsyncengine_get_last_error();
+        const error = errorPtr ? module.UTF8ToString(errorPtr) : 'Failed to begin stream';
+        throw new Error(error);
+      }
+
+      return new LipSyncEngineStream(module, handle);
+    } finally {
+      if (dialogPtr) module._free(dialogPtr);
+      if (optionsPtr) module._free(optionsPtr);
+    }
+  }
+
+  /**
+   * Continue a saved session in a module whose engine is initialized and has the models the
+   * options need
+   *
+   * @internal
+   */
+  static restore(
+    module: LipSyncEngineModule,
+    state: Uint8Array,
+    options: Omit<LipSyncEngineOptions, 'signal'> = {}
+  ): LipSyncEngineStream {
+    let statePtr = 0;
+    let optionsPtr = 0;
+
+    try {
+      statePtr = module._malloc(Math.max(state.length, 1));
+      module.HEAPU8.set(state, statePtr);
+
+      optionsPtr = allocateOptions(module, options);
+      const handle = module._lipsyncengine_stream_restore(statePtr, state.length, optionsPtr);
+      if (handle < 0) {
+        const errorPtr = module._lipsyncengine_get_last_error();
+        const error = errorPtr ? module.UTF8ToString(errorPtr) : 'Failed to restore stream';
+        throw new Error(error);
+      }
+
+      return new LipSyncEngineStream(module, handle);
+    } finally {
+      if (statePtr) module._free(statePtr);
+      if (optionsPtr) module._free(optionsPtr);
+    }
+  }
+
+  /**
+   * Push audio to the session
+   *
+   * @param pcm16 - 16-bit PCM audio chunk (mono, at the session's sample rate)
+   * @returns Mouth cues finalized since the previous call, and the current tentative cues
+   */
+  push(pcm16: Int16Array): LipSyncEngineStreamResult {
+    this.assertOpen();
+
+    if (!(pcm16 instanceof Int16Array)) {
+      throw new TypeError('pcm16 must be an Int16Array');
+    }
+
+    if (pcm16.length > 0) {
+      const pcm16Ptr = this.module._malloc(pcm16.length * 2);
+      try {
+        this.module.HEAP16.set(pcm16, pcm16Ptr / 2);
+        const result = this.module._lipsyncengine_stream_push(
+          this.handle,
+          pcm16Ptr,
+          pcm16.length
+        );
+        if (result !== 0) {
+          throw new Error(this.getLastError('Stream push failed'));
+        }
+      } finally {
+        this.module._free(pcm16Ptr);
+      }
+    }
+
+    return this.poll();
+  }
+
+  /**
+   * Push audio whose voice activity was detected already, e.g. in the capture worklet, so that
+   * the session skips its own detection
+   *
+   * @param pcm16 - The samples of the captured frames (mono, at the session's sample rate)
+   * @param frameActivity - One value per 10 ms frame, continuing where the session's detection
+   *   stands: 0 for a frame without voice, 1 for a frame with voice, and 2 for a frame without voice
+   *   that wasn't captured, which the session fills with silence. Frame i spans the samples from
+   *   `Math.floor(i * sampleRate / 100)` on.
+   * @returns Mouth cues finalized since the previous call, and the current tentative cues
+   */
+  pushActivity(pcm16: Int16Array, frameActivity: Uint8Array): LipSyncEngineStreamResult {
+    this.assertOpen();
+
+    if (!(pcm16 instanceof Int16Array)) {
+      throw new TypeError('pcm16 must be an Int16Array');
+    }
+    if (!(frameActivity instanceof Uint8Array)) {
+      throw new TypeError('frameActivity must be a Uint8Array');
+    }
+
+    if (frameActivity.length > 0) {
+      const pcm16Ptr = this.module._malloc(Math.max(pcm16.length * 2, 1));
+      const activityPtr = this.module._malloc(frameActivity.length);
+      try {
+        this.module.HEAP16.set(pcm16, pcm16Ptr / 2);
+        this.module.HEAPU8.set(frameActivity, activityPtr);
+        const result = this.module._lipsyncengine_stream_push_activity(
+          this.handle,
+          pcm16Ptr,
+          pcm16.length,
+          activityPtr,
+          frameActivity.length
+        );
+        if (result !== 0) {
+          throw new Error(this.getLastError('Stream push failed'));
+        }
+      } finally {
+        this.module._free(pcm16Ptr);
+        this.module._free(activityPtr);
+      }
+    }
+
+    return this.poll();
+  }
+
+  /**
+   * Get the mouth cues finalized since the previous call, and the current tentative cues
+   */
+  poll(): LipSyncEngineStreamResult {
+    this.assertOpen();
+    return this.readResult(this.module._lipsyncengine_stream_poll(this.handle));
+  }
+
+  /**
+   * End the session, analyzing any remaining audio
+   *
+   * @returns All mouth cues not returned before
+   */
+  end(): LipSyncEngineStreamResult {
+    this.assertOpen();
+    this.ended = true;
+    return this.readResult(this.module._lipsyncengine_stream_end(this.handle));
+  }
+
+  /**
+   * Save the session's state, so that `LipSyncEngine.restoreStream()` can continue it elsewhere,
+   * e.g. in a less busy worker. The session stays open; `abort()` it once it has been restored.
+   *
+   * @returns The state: the voice activity detector, what was learned about the speaker, the
+   *   audio of the utterance being spoken and the cues not yet returned
+   */
+  save(): Uint8Array {
+    this.assertOpen();
+
+    const byteCountPtr = this.module._malloc(4);
+    let statePtr = 0;
+    try {
+      statePtr = this.module._lipsyncengine_stream_save(this.handle, byteCountPtr);
+      if (!statePtr) {
+        throw new Error(this.getLastError('Failed to save stream'));
+      }
+      const byteCount = this.module.HEAP32[byteCountPtr / 4];
+      return this.module.HEAPU8.slice(statePtr, statePtr + byteCount);
+    } finally {
+      this.module._free(byteCountPtr);
+      if (statePtr) this.module._lipsyncengine_free(statePtr);
+    }
+  }
+
+  /**
+   * Close the session without analyzing its remaining audio
+   */
+  abort(): void {
+    this.assertOpen();
+    this.ended = true;
+    this.module._lipsyncengine_stream_abort(this.handle);
+  }
+
+  private readResult(resultPtr: number): LipSyncEngineStreamResult {
+    if (!resultPtr) {
+      throw new Error(this.getLastError('Stream analysis failed'));
+    }
+
+    let result: LipSyncEngineStreamResult;
+    try {
+      result = JSON.parse(this.module.UTF8ToString(resultPtr));
+    } finally {
+      this.module._lipsyncengine_free(resultPtr);
+    }
+
+    const tentativeFrom = findTentativeCuesChange(this.tentativeCues, result.tentativeCues);
+    if (result.mouthCues.length > 0 || tentativeFrom !== null) {
+      this.generation++;
+    }
+    this.tentativeCues = result.tentativeCues;
+    result.tentativeFrom = tentativeFrom ?? result.tentativeCues.length;
+    result.generation = this.generation;
+    return result;
+  }
+
+  private assertOpen(): void {
+    if (this.ended) {
+      throw new Error('Stream has already ended');
+    }
+  }
+
+  private getLastError(fallback: string): string {
+    const errorPtr = this.module._lipsyncengine_get_last_error();
+    return errorPtr ? this.module.UTF8ToString(errorPtr) : fallback;
+  }
+}
@@ -0,0 +1,134 @@
+import type { MouthCue } from './types';
+import type { WorkerRequest, WorkerAnalyzeResponse, WorkerStreamCuesResponse } from './worker';
+import type { EngineWorker } from './utils/sharedEngine';
+import { applyTentativeCues } from './utils/cueDeltas';
+
+/**
+ * Live analysis of captured audio
+ * An AudioWorklet writes the audio to a ring buffer in shared memory, and a reserved pool worker
+ * feeds it to a streaming session, so the main thread neither copies nor posts audio. Mouth cues
+ * arrive utterance by utterance, as soon as the engine finalizes them.
+ *
+ * Start captures with `WorkerPool.startLiveCapture()`.
+ *
+ * @example
+ * ```typescript
+ * const microphone = await navigator.mediaDevices.getUserMedia({ audio: true });
+ * const capture = await pool.startLiveCapture(microphone, {
+ *   onMouthCues: (mouthCues) => avatar.enqueue(mouthCues),
+ * });
+ * // ...
+ * await capture.stop();
+ * ```
+ */
+export class LiveCapture {
+  private mouthCues: MouthCue[] = [];
+  /** The tentative cues, as the worker's deltas have built them */
+  private tentativeCues: MouthCue[] = [];
+  private droppedSamples = 0;
+  private stopped: Promise<MouthCue[]> | null = null;
+  private resolveStop: ((mouthCues: MouthCue[]) => void) | null = null;
+  private rejectStop: ((error: Error) => void) | null = null;
+  private finished = false;
+  private connected = true;
+
+  /** @internal */
+  constructor(
+    private readonly id: number,
+    private readonly worker: EngineWorker,
+    private readonly nodes: {
+      source: AudioNode;
+      capture: AudioWorkletNode;
+      /** The context, if the capture created it */
+      ownedContext?: AudioContext;
+    },
+    private readonly callbacks: {
+      onMouthCues?: (mouthCues: MouthCue[]) => void;
+      onTentativeCues?: (tentativeCues: MouthCue[], from: number) => void;
+      onError?: (error: Error) => void;
+    },
+    /** Returns the worker to the pool */
+    private readonly release: () => void
+  ) {}
+
+  /**
+   * Stop capturing and analyze the remaining audio
+   *
+   * @returns Promise resolving to all mouth cues of the capture
+   */
+  stop(): Promise<MouthCue[]> {
+    if (!this.stopped) {
+      this.stopped = new Promise((resolve, reject) => {
+        this.resolveStop = resolve;
+        this.rejectStop = reject;
+      });
+      this.disconnect();
+      if (this.finished) {
+        // The analysis has failed before
+        this.resolveStop!(this.mouthCues);
+      } else {
+        const message: WorkerRequest = { type: 'streamEnd', id: this.id };
+        this.worker.postMessage(message);
+      }
+    }
+    return this.stopped;
+  }
+
+  /**
+   * All mouth cues finalized so far, in seconds from the start of the capture
+   */
+  getMouthCues(): MouthCue[] {
+    return [...this.mouthCues];
+  }
+
+  /**
+   * The number of samples dropped so far because the worker fell behind the capture
+   */
+  getDroppedSampleCount(): number {
+    return this.droppedSamples;
+  }
+
+  /** @internal */
+  handleMessage(message: WorkerStreamCuesResponse | WorkerAnalyzeResponse): void {
+    if (message.type === 'streamCues') {
+      this.droppedSamples = message.droppedSamples;
+      this.mouthCues.push(...message.mouthCues);
+      if (message.mouthCues.length > 0) {
+        this.callbacks.onMouthCues?.(message.mouthCues);
+      }
+      if (message.tentativeCues) {
+        const from = message.tentativeFrom ?? 0;
+        this.tentativeCues = applyTentativeCues(this.tentativeCues, from, message.tentativeCues);
+        this.callbacks.onTentativeCues?.(this.tentativeCues, from);
+      }
+      if (message.final) {
+        this.finish();
+        this.resolveStop?.(this.mouthCues);
+      }
+    } else if (message.type === 'error') {
+      const error = new Error(message.error || 'Live capture failed');
+      this.disconnect();
+      this.finish();
+      if (this.rejectStop) {
+        this.rejectStop(error);
+      } else {
+        this.callbacks.onError?.(error);
+      }
+    }
+  }
+
+  private disconnect(): void {
+    if (!this.connected) return;
+    this.connected = false;
+    this.nodes.source.disconnect(this.nodes.capture);
+    this.nodes.capture.disconnect();
+    this.nodes.ownedContext?.close();
+  }
+
+  private finish(): void {
+    if (!this.finished) {
+      this.finished = true;
+      this.release();
+    }
+  }
+}
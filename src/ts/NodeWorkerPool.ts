@@ -0,0 +1,233 @@
+/**
+ * Pool of worker threads analyzing clips in parallel in Node.js, e.g. for server-side batch jobs
+ * and asset validation in CI
+ * Each worker runs its own instance of the Node.js build (lip-sync-engine-node), which reads the
+ * model files in place from the host file system.
+ */
+
+import { Worker } from 'node:worker_threads';
+import { readFile } from 'node:fs/promises';
+import { pathToFileURL } from 'node:url';
+import os from 'node:os';
+import { createPackedResult } from './utils/mouthCues';
+import { getAbortReason, throwIfAborted } from './utils/abort';
+import type { NodeWorkerAnalyzeRequest, NodeWorkerResponse } from './node-worker';
+import type { LipSyncEngineOptions, LipSyncEngineResult, WasmLoaderOptions } from './types';
+
+export interface NodeWorkerPoolOptions extends WasmLoaderOptions {
+  /** Number of worker threads (default: the number of CPU cores) */
+  workerCount?: number;
+  /** Path or URL of the worker script (default: dist/node-worker.mjs next to this module) */
+  workerScriptPath?: string | URL;
+}
+
+interface NodeJob {
+  id: number;
+  pcm16: Int16Array;
+  options: LipSyncEngineOptions;
+  resolve: (result: LipSyncEngineResult) => void;
+  reject: (error: unknown) => void;
+  /** Removes the abort listener */
+  cleanup: () => void;
+}
+
+interface NodePoolWorker {
+  worker: Worker;
+  job: NodeJob | null;
+}
+
+export class NodeWorkerPool {
+  private workers: NodePoolWorker[] = [];
+  private queue: NodeJob[] = [];
+  private nextJobId = 0;
+  private workerScriptUrl: URL | null = null;
+  private workerOptions: WasmLoaderOptions = {};
+  private initPromise: Promise<void> | null = null;
+  private destroyed = false;
+
+  /**
+   * Start the worker threads and wait for their engines to initialize
+   * The .wasm file is compiled once and shared with all workers.
+   */
+  init(options: NodeWorkerPoolOptions = {}): Promise<void> {
+    if (!this.initPromise) {
+      this.initPromise = this.initWorkers(options);
+    }
+    return this.initPromise;
+  }
+
+  private async initWorkers(options: NodeWorkerPoolOptions): Promise<void> {
+    const { workerCount, workerScriptPath, ...loaderOptions } = options;
+    this.workerScriptUrl = toFileUrl(workerScriptPath ?? new URL('./node-worker.mjs', import.meta.url));
+
+    const wasmPath = loaderOptions.wasmPath ?? new URL('./wasm/lip-sync-engine-node.wasm', import.meta.url);
+    this.workerOptions = {
+      ...loaderOptions,
+      wasmModule: loaderOptions.wasmModule ?? (await WebAssembly.compile(await readFile(toFileUrl(wasmPath)))),
+    };
+
+    const count = Math.max(1, workerCount ?? getCoreCount());
+    await Promise.all(Array.from({ length: count }, () => this.startWorker()));
+  }
+
+  /**
+   * Analyze a clip on the next idle worker
+   * `onProgress` is called as in `LipSyncEngine.analyze()`. Aborting `signal` while the clip is
+   * being analyzed terminates its worker, which the pool replaces.
+   *
+   * @param pcm16 - 16-bit PCM audio; copied to the worker
+   * @param options - Optional configuration
+   * @returns Promise resolving to the result
+   */
+  async analyze(pcm16: Int16Array, options: LipSyncEngineOptions = {}): Promise<LipSyncEngineResult> {
+    if (!this.initPromise) {
+      throw new Error('Pool not initialized');
+    }
+    await this.initPromise;
+    throwIfAborted(options.signal);
+
+    return new Promise((resolve, reject) => {
+      const job: NodeJob = { id: this.nextJobId++, pcm16, options, resolve, reject, cleanup: () => {} };
+      const { signal } = options;
+      if (signal) {
+        const onAbort = () => this.abort(job, getAbortReason(signal));
+        signal.addEventListener('abort', onAbort, { once: true });
+        job.cleanup = () => signal.removeEventListener('abort', onAbort);
+      }
+      this.queue.push(job);
+      this.dispatch();
+    });
+  }
+
+  /**
+   * Terminate all workers, rejecting the queued and running analyses
+   */
+  async destroy(): Promise<void> {
+    this.destroyed = true;
+    const error = new Error('Pool destroyed');
+    this.queue.splice(0).forEach((job) => this.settle(job, () => job.reject(error)));
+    await Promise.all(
+      this.workers.splice(0).map((poolWorker) => {
+        if (poolWorker.job) {
+          const { job } = poolWorker;
+          this.settle(job, () => job.reject(error));
+        }
+        return poolWorker.worker.terminate();
+      })
+    );
+  }
+
+  private startWorker(): Promise<void> {
+    return new Promise((resolve, reject) => {
+      const worker = new Worker(this.workerScriptUrl!);
+      const poolWorker: NodePoolWorker = { worker, job: null };
+
+      const onInit = (response: NodeWorkerResponse) => {
+        if (response.type === 'ready') {
+          worker.off('message', onInit);
+          worker.on('message', (message: NodeWorkerResponse) => this.handleMessage(poolWorker, message));
+          this.workers.push(poolWorker);
+          this.dispatch();
+          resolve();
+        } else if (response.type === 'error') {
+          worker.terminate();
+          reject(new Error(`Worker initialization failed: ${response.error}`));
+        }
+      };
+      worker.on('message', onInit);
+      worker.on('error', (error) => {
+        reject(error);
+        this.replaceWorker(poolWorker, error);
+      });
+      worker.postMessage({ type: 'init', options: this.workerOptions });
+    });
+  }
+
+  private handleMessage(poolWorker: NodePoolWorker, response: NodeWorkerResponse): void {
+    const { job } = poolWorker;
+    if (!job || !('id' in response) || response.id !== job.id) return;
+
+    if (response.type === 'progress') {
+      job.options.onProgress?.(response.progress, response.remainingMs);
+      return;
+    }
+
+    poolWorker.job = null;
+    if (response.type === 'result' && response.result) {
+      const { packedMouthCues, ...rest } = response.result;
+      const result = Object.assign(createPackedResult(packedMouthCues!), rest);
+      this.settle(job, () => job.resolve(result));
+    } else {
+      this.settle(job, () => job.reject(new Error(response.error ?? 'Analysis failed')));
+    }
+    this.dispatch();
+  }
+
+  private dispatch(): void {
+    for (const poolWorker of this.workers) {
+      if (this.queue.length === 0) return;
+      if (poolWorker.job) continue;
+
+      const job = this.queue.shift()!;
+      poolWorker.job = job;
+      const { signal, onProgress, onPreview: _onPreview, ...options } = job.options;
+      const request: NodeWorkerAnalyzeRequest = {
+        type: 'analyze',
+        id: job.id,
+        pcm16: job.pcm16,
+        options,
+        reportProgress: onProgress !== undefined,
+      };
+      poolWorker.worker.postMessage(request);
+    }
+  }
+
+  private abort(job: NodeJob, reason: unknown): void {
+    const queueIndex = this.queue.indexOf(job);
+    if (queueIndex >= 0) {
+      this.queue.splice(queueIndex, 1);
+    } else {
+      // A running analysis can only be stopped with its worker
+      const poolWorker = this.workers.find((candidate) => candidate.job === job);
+      if (!poolWorker) return;
+      poolWorker.job = null;
+      this.replaceWorker(poolWorker, reason);
+    }
+    this.settle(job, () => job.reject(reason));
+  }
+
+  private replaceWorker(poolWorker: NodePoolWorker, reason: unknown): void {
+    const index = this.workers.indexOf(poolWorker);
+    if (index < 0) return;
+    this.workers.splice(index, 1);
+    poolWorker.worker.terminate();
+
+    if (poolWorker.job) {
+      const { job } = poolWorker;
+      this.settle(job, () => job.reject(reason));
+    }
+    if (!this.destroyed) {
+      this.startWorker().catch((error) => {
+        // Without workers, nothing would ever take the queued jobs
+        if (this.workers.length === 0) {
+          this.queue.splice(0).forEach((job) => this.settle(job, () => job.reject(error)));
+        }
+      });
+    }
+  }
+
+  private settle(job: NodeJob, settle: () => void): void {
+    job.cleanup();
+    settle();
+  }
+}
+
+function toFileUrl(path: string | URL): URL {
+  if (path instanceof URL) return path;
+  return path.startsWith('file:') ? new URL(path) : pathToFileURL(path);
+}
+
+function getCoreCount(): number {
+  // availableParallelism() is missing before Node.js 18.14
+  return os.availableParallelism?.() ?? os.cpus().length;
+}
@@ -1,10 +1,46 @@
-import type { LipSyncEngineModule, WasmLoaderOptions } from './types';
+import type { LipSyncEngineDeviceTier, LipSyncEngineModule, WasmLoaderOptions } from './types';
 import packageJson from '../../package.json';
+import { fetchCached } from './utils/cache';
 
 // Declare worker globals for TypeScript
 declare const WorkerGlobalScope: any;
 declare function importScripts(...urls: string[]): void;
 
+// Smallest module using a SIMD128 instruction: (func (result v128) (i32x4.splat (i32.const 0)))
+const SIMD_TEST_MODULE = new Uint8Array([
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x05, 0x01, 0x60, 0x00, 0x01, 0x7b, 0x03,
+  0x02, 0x01, 0x00, 0x0a, 0x08, 0x01, 0x06, 0x00, 0x41, 0x00, 0xfd, 0x11, 0x0b,
+]);
+
+// Smallest module using exception handling: (func (try (do) (catch_all)))
+const EXCEPTIONS_TEST_MODULE = new Uint8Array([
+  0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x04, 0x01, 0x60, 0x00, 0x00, 0x03, 0x02,
+  0x01, 0x00, 0x0a, 0x08, 0x01, 0x06, 0x00, 0x06, 0x40, 0x19, 0x0b, 0x0b,
+]);
+
+/**
+ * URL of a file of the package's dist directory, or throws where that isn't known
+ * Only ES module bundles, such as dist/node.mjs, know their own URL.
+ */
+function getPackageFileUrl(file: string): string {
+  const baseUrl: string | undefined = import.meta.url;
+  if (!baseUrl) {
+    throw new Error(
+      'The location of the package is unknown; import lip-sync-engine/node, or pass jsPath and modelsPath'
+    );
+  }
+  return new URL(file, baseUrl).href;
+}
+
+/**
+ * File system path of a file of the package's dist directory
+ */
+function getPackageFilePath(file: string): string {
+  const path = decodeURIComponent(new URL(getPackageFileUrl(file)).pathname);
+  // file:///C:/... has the pathname /C:/...
+  return path.replace(/^\/([A-Za-z]:)/, '$1');
+}
+
 /**
  * Loads the WASM module
  * This is a singleton loader that handles WASM initialization
@@ -12,9 +48,145 @@ declare function importScripts(...urls: string[]): void;
 export class WasmLoader {
   private static modulePromise: Promise<LipSyncEngineModule> | null = null;
   private static module: LipSyncEngineModule | null = null;
+  private static simdSupported: boolean | null = null;
+  private static exceptionsSupported: boolean | null = null;
+  private static compiledModules = new Map<string, Promise<WebAssembly.Module>>();
+
+  /**
+   * Whether the runtime supports WebAssembly SIMD128, which the default builds are compiled with
+   */
+  static supportsSimd(): boolean {
+    if (this.simdSupported === null) {
+      try {
+        this.simdSupported = WebAssembly.validate(SIMD_TEST_MODULE);
+      } catch {
+        this.simdSupported = false;
+      }
+    }
+    return this.simdSupported;
+  }
+
+  /**
+   * Whether the runtime supports WebAssembly exception handling, which the `-eh` builds use
+   * instead of Emscripten's JavaScript-based emulation
+   */
+  static supportsExceptions(): boolean {
+    if (this.exceptionsSupported === null) {
+      try {
+        this.exceptionsSupported = WebAssembly.validate(EXCEPTIONS_TEST_MODULE);
+      } catch {
+        this.exceptionsSupported = false;
+      }
+    }
+    return this.exceptionsSupported;
+  }
+
+  /**
+   * Whether the runtime supports JavaScript Promise Integration, which lets the JSPI build's
+   * analyses suspend to yield to the event loop
+   */
+  static supportsJspi(): boolean {
+    const api = WebAssembly as any;
+    return typeof api.Suspending === 'function' && typeof api.promising === 'function';
+  }
+
+  /**
+   * Whether this runs in Node.js rather than in a browser or a web worker
+   */
+  static isNode(): boolean {
+    return (
+      typeof (globalThis as any).process?.versions?.node === 'string' &&
+      typeof window === 'undefined' &&
+      typeof WorkerGlobalScope === 'undefined'
+    );
+  }
+
+  /**
+   * Name of the build to load by default: the Node.js one in Node.js, the fixed-point one for
+   * low-end devices, the
+   * multithreaded one if requested and possible, the size-optimized one if requested, the JSPI one
+   * if requested and supported, and the
+   * scalar one if the runtime lacks SIMD128. SIMD builds with native exception handling are
+   * preferred if the runtime supports it.
+   * The JSPI build's analysis functions return Promises, so only workers driving them that way
+   * (see worker.ts) can use it.
+   */
+  static getBuildName(
+    threads = false,
+    deviceTier: LipSyncEngineDeviceTier = 'standard',
+    compact = false,
+    jspi = false
+  ): string {
+    if (this.isNode()) {
+      return 'lip-sync-engine-node';
+    }
+    // The multithreaded build needs a SharedArrayBuffer heap
+    const useThreads = threads && (globalThis as any).crossOriginIsolated === true;
+    const baseName =
+      deviceTier === 'low'
+        ? 'lip-sync-engine-fixed'
+        : useThreads
+          ? 'lip-sync-engine-mt'
+          : compact
+            ? 'lip-sync-engine-compact'
+            : 'lip-sync-engine';
+    if (baseName === 'lip-sync-engine' && jspi && this.supportsJspi() && this.supportsSimd()) {
+      // Runtimes with JSPI support exception handling, which the JSPI build always uses
+      return 'lip-sync-engine-jspi';
+    }
+    if (!this.supportsSimd()) {
+      // The size-optimized build has no scalar variant
+      return baseName === 'lip-sync-engine-compact' ? 'lip-sync-engine-scalar' : `${baseName}-scalar`;
+    }
+    return this.supportsExceptions() ? `${baseName}-eh` : baseName;
+  }
+
+  /**
+   * URL of the directory containing the model files, shared by all builds
+   */
+  static getModelsPath(options: WasmLoaderOptions = {}): string {
+    return (
+      options.modelsPath ??
+      `https://unpkg.com/lip-sync-engine@${packageJson.version}/dist/wasm/models`
+    );
+  }
+
+  /**
+   * Directory of the host file system containing the model files, for the Node.js build
+   * It reads them in place instead of fetching them.
+   */
+  static getModelsDirectory(options: WasmLoaderOptions = {}): string {
+    return options.modelsPath ?? getPackageFilePath('wasm/models');
+  }
+
+  /**
+   * Compile a .wasm file, once per URL and page
+   * The file is kept in Cache Storage unless `useCache` is false. The compiled module can be
+   * posted to workers, which then instantiate it without downloading or compiling it again.
+   * @param wasmPath - URL of the .wasm file
+   * @param useCache - Whether to keep the file in Cache Storage across page loads
+   */
+  static compile(wasmPath: string, useCache = true): Promise<WebAssembly.Module> {
+    let promise = this.compiledModules.get(wasmPath);
+    if (!promise) {
+      promise = (async () => {
+        const response = await fetchCached(wasmPath, useCache);
+        try {
+          // Compiles while downloading; needs the application/wasm MIME type
+          return await WebAssembly.compileStreaming(response.clone());
+        } catch {
+          return WebAssembly.compile(await response.arrayBuffer());
+        }
+      })();
+      promise.catch(() => this.compiledModules.delete(wasmPath));
+      this.compiledModules.set(wasmPath, promise);
+    }
+    return promise;
+  }
 
   /**
    * Load the WASM module
+   * The module comes without models; see `ModelLoader` for loading them.
    * @param options - Optional paths to WASM files
    * @returns Promise resolving to the loaded WASM module
    */
@@ -57,13 +229,56 @@ export class WasmLoader {
   private static async _loadModuleImpl(
     options: WasmLoaderOptions
   ): Promise<LipSyncEngineModule> {
+    if (this.isNode()) {
+      return this.loadNodeModule(options);
+    }
+
     const version = packageJson.version;
+    const baseName = this.getBuildName(options.threads === true, options.deviceTier, options.compact);
     const {
-      wasmPath = `https://unpkg.com/lip-sync-engine@${version}/dist/wasm/lip-sync-engine.wasm`,
-      dataPath = `https://unpkg.com/lip-sync-engine@${version}/dist/wasm/lip-sync-engine.data`,
-      jsPath = `https://unpkg.com/lip-sync-engine@${version}/dist/wasm/lip-sync-engine.js`,
+      wasmPath = `https://unpkg.com/lip-sync-engine@${version}/dist/wasm/${baseName}.wasm`,
+      jsPath = `https://unpkg.com/lip-sync-engine@${version}/dist/wasm/${baseName}.js`,
     } = options;
 
+    // Instantiate a module compiled once (or posted by the creator of this worker), rather than
+    // letting Emscripten download and compile the .wasm file for every module. Compiling
+    // overlaps with loading the script.
+    const wasmModule = options.wasmModule
+      ? Promise.resolve(options.wasmModule)
+      : this.compile(wasmPath, options.cache !== false);
+    let rejectInstantiation: (error: unknown) => void = () => {};
+    const instantiationFailed = new Promise<never>((_, reject) => {
+      rejectInstantiation = reject;
+    });
+
+    const moduleOptions = {
+      instantiateWasm: (
+        imports: WebAssembly.Imports,
+        receiveInstance: (instance: WebAssembly.Instance, module: WebAssembly.Module) => void
+      ) => {
+        wasmModule
+          .then((module) =>
+            WebAssembly.instantiate(module, imports).then((instance) =>
+              receiveInstance(instance, module)
+            )
+          )
+          .catch(rejectInstantiation);
+        // Instantiation is asynchronous
+        return {};
+      },
+      locateFile: (path: string) => {
+        if (path.endsWith('.wasm')) {
+          return wasmPath;
+        }
+        if (path.endsWith('.worker.js')) {
+          return jsPath.replace(/\.js$/, '.worker.js');
+        }
+        return path;
+      },
+      // Thread workers load the same script
+      mainScriptUrlOrBlob: jsPath,
+    };
+
     // Detect if we're in a worker context
     const isWorker = typeof WorkerGlobalScope !== 'undefined' && self instanceof WorkerGlobalScope;
 
@@ -83,17 +298,7 @@ export class WasmLoader {
             );
           }
 
-          const module = await createModule({
-            locateFile: (path: string) => {
-              if (path.endsWith('.wasm')) {
-                return wasmPath;
-              }
-              if (path.endsWith('.data')) {
-                return dataPath;
-              }
-              return path;
-            },
-          });
+          const module = await Promise.race([createModule(moduleOptions), instantiationFailed]);
 
           resolve(module as LipSyncEngineModule);
         } catch (error) {
@@ -122,17 +327,7 @@ export class WasmLoader {
               );
             }
 
-            const module = await createModule({
-              locateFile: (path: string) => {
-                if (path.endsWith('.wasm')) {
-                  return wasmPath;
-                }
-                if (path.endsWith('.data')) {
-                  return dataPath;
-                }
-                return path;
-              },
-            });
+            const module = await Promise.race([createModule(moduleOptions), instantiationFailed]);
 
             resolve(module as LipSyncEngineModule);
           } catch (error) {
@@ -149,11 +344,41 @@ export class WasmLoader {
     }
   }
 
+  /**
+   * Import the ES module of the Node.js build, which reads the models from the host file system
+   */
+  private static async loadNodeModule(options: WasmLoaderOptions): Promise<LipSyncEngineModule> {
+    const jsPath = options.jsPath ?? getPackageFileUrl('wasm/lip-sync-engine-node.mjs');
+    const { default: createModule } = await import(/* @vite-ignore */ /* webpackIgnore: true */ jsPath);
+
+    const moduleOptions: Record<string, unknown> = {};
+    if (options.wasmPath) {
+      const { wasmPath } = options;
+      moduleOptions.locateFile = (path: string, prefix: string) =>
+        path.endsWith('.wasm') ? wasmPath : prefix + path;
+    }
+    if (options.wasmModule) {
+      // E.g. compiled once by NodeWorkerPool for all its workers
+      const { wasmModule } = options;
+      moduleOptions.instantiateWasm = (
+        imports: WebAssembly.Imports,
+        receiveInstance: (instance: WebAssembly.Instance, module: WebAssembly.Module) => void
+      ) => {
+        WebAssembly.instantiate(wasmModule, imports).then((instance) =>
+          receiveInstance(instance, wasmModule)
+        );
+        return {};
+      };
+    }
+    return (await createModule(moduleOptions)) as LipSyncEngineModule;
+  }
+
   /**
    * Reset the loader (useful for testing)
    */
   static reset(): void {
     this.module = null;
     this.modulePromise = null;
+    this.compiledModules.clear();
   }
 }
@@ -1,25 +1,211 @@
-import type { LipSyncEngineResult, LipSyncEngineOptions } from './types';
-import type { WorkerRequest, WorkerResponse } from './worker';
+import type {
+  LipSyncEngineResult,
+  LipSyncEngineOptions,
+  LipSyncEngineLanguageModel,
+  LipSyncEngineDeviceTier,
+  LipSyncEngineMemoryBudget,
+  LipSyncEngineModelAsset,
+  LipSyncEngineResultCache,
+  StreamWindowOptions,
+  LiveCaptureOptions,
+  LipSyncEngineFileOptions,
+  LipSyncEngineTransformStreamOptions,
+  LipSyncEngineTrace,
+  LipSyncEngineTraceEvent,
+  LipSyncEngineWarmupLevel,
+  MouthCue,
+  WorkerPoolMetrics,
+} from './types';
+import type {
+  WorkerRequest,
+  WorkerResponse,
+  WorkerAnalyzeRequest,
+  WorkerAnalyzeResponse,
+  WorkerCancelRequest,
+  SharedModels,
+} from './worker';
+import type { WarmupOptions } from './utils/warmup';
+import type { CaptureProcessorOptions } from './capture-worklet';
+import { LiveCapture } from './LiveCapture';
+import { WorkerStream } from './WorkerStream';
+import { FileAnalysis } from './utils/fileAnalysis';
+import { SharedRingBuffer } from './utils/ringBuffer';
+import { createVadImports } from './utils/captureVad';
+import { SharedJobChannel, canPostThroughChannel, canUseJobChannels } from './utils/jobChannel';
+import { SharedEngineConnection, type EngineWorker } from './utils/sharedEngine';
+import { getAbortReason, throwIfAborted } from './utils/abort';
+import {
+  SharedModelStore,
+  DEFAULT_PRELOADED_ASSETS,
+  canShareModels,
+  getRequiredAssets,
+} from './utils/models';
+import { WasmLoader } from './WasmLoader';
+import { createPackedResult, encodeMouthCues } from './utils/mouthCues';
+import { getResultCacheKey } from './utils/resultCache';
+import { getProcessNameEvent, getTraceTimestamp } from './utils/tracing';
+import { Histogram } from './utils/metrics';
+import { createMouthCueTransformStream } from './utils/transformStream';
+import { sampleFrames, validateFrameOptions } from './utils/frames';
+import { TransferBufferPool, canTransfer } from './utils/transferBuffers';
+import {
+  findQuietestPoint,
+  stitchMouthCues,
+  sliceMouthCues,
+  type StitchedWindow,
+} from './utils/stitching';
 import packageJson from '../../package.json';
 
 /**
  * Represents a worker in the pool
  */
 interface PoolWorker {
-  worker: Worker;
+  /** A dedicated worker, or a connection to the engine of a SharedWorker */
+  worker: EngineWorker;
   busy: boolean;
   ready: boolean;
+  /** Cancels the worker's running analysis when set to 1, if its memory is shared */
+  cancelFlag?: Int32Array;
+  /** Whether the worker's analyses yield, so that it handles cancel requests during them */
+  canYield: boolean;
+  /** Shared model assets already sent to the worker */
+  sharedAssets: Set<LipSyncEngineModelAsset>;
+  /** Unique number of the worker, for rendezvous hashing */
+  id: number;
+  /** Keys of the dialog language models the worker has likely cached, least recent first */
+  dialogModels: string[];
+  /** Size of the worker's WASM memory, as of its last job */
+  memoryBytes: number;
+  /** performance.now() when the worker last finished a job */
+  lastUsed: number;
+  /** performance.now() when the worker became ready */
+  readyAt: number;
+  /** performance.now() when the worker became busy, while it is */
+  busySince?: number;
+  /** Retires the worker once it has been idle for `idleTimeoutMs` */
+  idleTimer?: ReturnType<typeof setTimeout>;
+  /** Resolves the worker's pending `takeTrace()` requests by id */
+  traceRequests: Map<number, (events: LipSyncEngineTraceEvent[]) => void>;
+  /** Settles the worker's pending warmups by id, with the error if one failed */
+  warmupRequests: Map<number, (error?: string) => void>;
+  /** Channel in shared memory that the worker takes short analyses from, if it does */
+  jobChannel?: SharedJobChannel;
 }
 
 /**
- * Represents a pending analysis job
+ * Scheduling state of a queued job
  */
-interface PendingJob {
+interface ScheduledJob {
   id: number;
+  priority: 'interactive' | 'batch';
+  /** performance.now() by which the result is wanted, or Infinity */
+  deadline: number;
+  /** performance.now() when the job was queued */
+  queuedAt: number;
+  /** Estimated milliseconds the job takes once it runs */
+  estimatedMs: number;
+  /** performance.now() when the job was sent to its worker */
+  startedAt?: number;
+}
+
+/**
+ * Represents a pending analysis job
+ */
+interface PendingJob extends ScheduledJob {
   pcm16: Int16Array;
   options: LipSyncEngineOptions;
+  /** Duration of the audio in seconds, kept as the audio is transferred to the worker */
+  audioSeconds: number;
   resolve: (result: LipSyncEngineResult) => void;
-  reject: (error: Error) => void;
+  reject: (error: unknown) => void;
+  /** The worker running the job, once assigned */
+  worker?: PoolWorker;
+}
+
+/**
+ * Represents a pending conversion job
+ */
+interface PendingConversion extends ScheduledJob {
+  /** Float channels to mix down, or the contents of a WAVE file to decode */
+  source: { channels: Float32Array[]; sampleRate: number } | { bytes: Uint8Array };
+  targetSampleRate: number;
+  resolve: (pcm16: Int16Array) => void;
+  reject: (error: unknown) => void;
+  /** The worker running the job, once assigned */
+  worker?: PoolWorker;
+}
+
+/** Chunks of `analyzeChunks()` queued or running at a time, per worker the pool may have */
+const MAX_CHUNKS_IN_FLIGHT_PER_WORKER = 2;
+/** Batch jobs longer than this are split into pieces of about this length, in seconds */
+const BATCH_PIECE_DURATION = 30;
+/** Audio analyzed on both sides of each cut between pieces, for context, in seconds */
+const BATCH_PIECE_OVERLAP = 0.5;
+/** How far a cut between pieces may move back to a quiet point, in seconds */
+const BATCH_PIECE_SEARCH = 2;
+
+/**
+ * Milliseconds an analysis takes per second of audio until the pool has measured analyses with the
+ * same recognizer and profile
+ */
+const DEFAULT_ANALYSIS_COST = 500;
+/** Weight of each measured analysis in the pool's estimate of the cost of its recognizer and profile */
+const ANALYSIS_COST_SMOOTHING = 0.3;
+
+/** Number of dialog language models each worker's engine caches per decoder profile */
+const DIALOG_MODEL_CACHE_CAPACITY = 16;
+
+/**
+ * Get the key of the dialog language model an analysis uses, or null if it uses none
+ * Dialogs are normalized like the engine's cache keys (whitespace runs collapsed and trimmed),
+ * and each decoder profile and dialog mode caches its own models.
+ */
+function getDialogModelKey(options: LipSyncEngineOptions): string | null {
+  if (!options.dialogText || (options.recognizer ?? 'pocketSphinx') !== 'pocketSphinx') {
+    return null;
+  }
+  const dialog = options.dialogText.split(/[ \t\n\v\f\r]+/).filter(Boolean).join(' ');
+  const mode = options.dialogMode && options.dialogMode !== 'biased' ? `:${options.dialogMode}` : '';
+  return dialog ? `${options.profile ?? 'offline'}${mode}:${dialog}` : null;
+}
+
+/**
+ * 32-bit FNV-1a hash of a string
+ */
+function hashString(value: string): number {
+  let hash = 0x811c9dc5;
+  for (let i = 0; i < value.length; i++) {
+    hash ^= value.charCodeAt(i);
+    hash = Math.imul(hash, 0x01000193);
+  }
+  return hash >>> 0;
+}
+
+/**
+ * Get the key under which the pool learns the cost of analyses with the options
+ */
+function getAnalysisCostKey(options: LipSyncEngineOptions): string {
+  return `${options.recognizer ?? 'pocketSphinx'}:${options.profile ?? 'offline'}`;
+}
+
+/**
+ * Order in which queued jobs run: interactive jobs first, then by deadline, then shortest first by
+ * estimated duration. A job goes first once it has waited longer than the other job is shorter, so
+ * that long jobs aren't starved by a stream of short ones.
+ */
+function compareJobs(a: ScheduledJob, b: ScheduledJob): number {
+  if (a.priority !== b.priority) {
+    return a.priority === 'interactive' ? -1 : 1;
+  }
+  if (a.deadline !== b.deadline) {
+    return a.deadline < b.deadline ? -1 : 1;
+  }
+  const aDue = a.queuedAt + a.estimatedMs;
+  const bDue = b.queuedAt + b.estimatedMs;
+  if (aDue !== bDue) {
+    return aDue < bDue ? -1 : 1;
+  }
+  return a.id - b.id;
 }
 
 /**
@@ -30,16 +216,63 @@ export class WorkerPool {
   private static instance: WorkerPool | null = null;
 
   private workers: PoolWorker[] = [];
-  private queue: PendingJob[] = [];
-  private inFlightJobs: Map<number, PendingJob> = new Map();
+  private queue: Array<PendingJob | PendingConversion> = [];
+  private inFlightJobs: Map<number, PendingJob | PendingConversion> = new Map();
+  /** Measured milliseconds per second of audio, by `getAnalysisCostKey()` */
+  private analysisCosts: Map<string, number> = new Map();
   private nextJobId = 0;
+  private nextWorkerId = 0;
   private maxWorkers: number;
+  /** Workers being created on demand for interactive jobs */
+  private pendingWorkerCount = 0;
   private workerScriptUrl: string;
+  private workletScriptUrl: string;
+  /** Contexts that have loaded the capture worklet */
+  private workletContexts = new WeakSet<BaseAudioContext>();
+  /** lip-sync-engine-vad.wasm for the capture worklet, once requested; undefined if unavailable */
+  private vadModule: Promise<WebAssembly.Module | undefined> | null = null;
+  /** URLs that workers and worklets load, by script URL; see `getScriptUrl()` */
+  private scriptUrls: Map<string, Promise<string>> = new Map();
+  /** Running live captures, worker streams and file analyses by id; each has a worker reserved */
+  private liveStreams: Map<number, LiveCapture | WorkerStream | FileAnalysis> = new Map();
+  /** Buffers of the chunks of worker streams, which the workers send back for reuse */
+  private transferBuffers = new TransferBufferPool();
+  /** Set by `destroyWhenIdle()` */
+  private destroyingWhenIdle = false;
   private wasmPaths: {
     wasmPath: string;
-    dataPath: string;
     jsPath: string;
+    modelsPath: string;
   };
+  private preloadModels?: LipSyncEngineModelAsset[];
+  private languageModel: LipSyncEngineLanguageModel = 'full';
+  private pagedLanguageModel = false;
+  private cache = true;
+  private gpuScoring = false;
+  private shareModels = true;
+  private useJobChannels = true;
+  /** Whether the workers are connections to one engine in a SharedWorker */
+  private useSharedWorker = false;
+  /** One copy of the model files for all workers, if cross-origin isolated */
+  private sharedModels: SharedModelStore | null = null;
+  private memoryBudget?: LipSyncEngineMemoryBudget;
+  private resultCache: LipSyncEngineResultCache | null = null;
+  private idleTimeoutMs = 60000;
+  private minWorkers = 1;
+  private maxMemoryBytes?: number;
+  /** performance.now() of the last measureUserAgentSpecificMemory() call */
+  private lastMemoryMeasurement = -Infinity;
+  private onVisibilityChange: (() => void) | null = null;
+  /** Spans of the pool's jobs not taken yet, while tracing */
+  private traceEvents: LipSyncEngineTraceEvent[] | null = null;
+  /** The counters of `getMetrics()`, since `metricsStart` */
+  private metrics = WorkerPool.createMetrics();
+  private metricsStart = performance.now();
+  /** Busy and ready time of retired workers and of the finished jobs of live ones, since `metricsStart` */
+  private busyMs = 0;
+  private workerMs = 0;
+  /** Timers of `onMetrics()` listeners */
+  private metricsTimers = new Set<ReturnType<typeof setInterval>>();
   private initialized = false;
 
   private constructor(
@@ -52,12 +285,15 @@ export class WorkerPool {
 
     // Default worker script URL - uses CDN, can be overridden
     this.workerScriptUrl = workerScriptUrl || `https://unpkg.com/lip-sync-engine@${version}/dist/worker.js`;
+    this.workletScriptUrl = `https://unpkg.com/lip-sync-engine@${version}/dist/capture-worklet.js`;
 
     // Default WASM paths - uses CDN, can be configured via init()
+    // Workers run on the same engine, so the SIMD and exception handling detection applies to them too
+    const baseName = WasmLoader.getBuildName(false, 'standard', false, true);
     this.wasmPaths = {
-      wasmPath: `https://unpkg.com/lip-sync-engine@${version}/dist/wasm/lip-sync-engine.wasm`,
-      dataPath: `https://unpkg.com/lip-sync-engine@${version}/dist/wasm/lip-sync-engine.data`,
-      jsPath: `https://unpkg.com/lip-sync-engine@${version}/dist/wasm/lip-sync-engine.js`
+      wasmPath: `https://unpkg.com/lip-sync-engine@${version}/dist/wasm/${baseName}.wasm`,
+      jsPath: `https://unpkg.com/lip-sync-engine@${version}/dist/wasm/${baseName}.js`,
+      modelsPath: WasmLoader.getModelsPath()
     };
   }
 
@@ -71,19 +307,101 @@ export class WorkerPool {
     return this.instance;
   }
 
+  /**
+   * Create a pool separate from the singleton, e.g. the dedicated worker of `LipSyncEngine`
+   */
+  static create(maxWorkers?: number, workerScriptUrl?: string): WorkerPool {
+    return new WorkerPool(maxWorkers, workerScriptUrl);
+  }
+
+  /**
+   * Get singleton instance if it has been initialized
+   */
+  static getReadyInstance(): WorkerPool | null {
+    return this.instance?.initialized ? this.instance : null;
+  }
+
   /**
    * Initialize the worker pool
    * Must be called before using analyze()
    *
    * Strategy: Start with 1 worker for fast initialization
    * - Use warmup() to create all workers upfront if needed
-   * - Workers scale on-demand automatically
+   * - Workers scale on-demand automatically, and idle ones are terminated after `idleTimeoutMs`
    */
   async init(options?: {
     wasmPath?: string;
+    /** @deprecated The models are fetched per asset from `modelsPath`; ignored */
     dataPath?: string;
     jsPath?: string;
+    /** URL of the directory containing the model files */
+    modelsPath?: string;
+    /** Assets each worker starts fetching during its initialization */
+    preloadModels?: LipSyncEngineModelAsset[];
+    /** Variant of the language model of the workers (default: 'full') */
+    languageModel?: LipSyncEngineLanguageModel;
+    /**
+     * Fetch the workers' language model n-grams page by page with range requests, so that the
+     * first analysis doesn't wait for all of them; ignored where the models are shared
+     * (default: false)
+     */
+    pagedLanguageModel?: boolean;
+    /** Keep the .wasm file and the models in Cache Storage across page loads (default: true) */
+    cache?: boolean;
+    /** Performance tier of the device; `'low'` loads the fixed-point build by default */
+    deviceTier?: LipSyncEngineDeviceTier;
+    /** Load the size-optimized build by default, for faster worker startup (default: false) */
+    compact?: boolean;
+    /**
+     * Where the runtime supports JSPI, load the build whose analyses yield to their worker's event
+     * loop (lip-sync-engine-jspi) by default, so that aborting an analysis stops it early instead
+     * of leaving the worker busy until it completes (default: true)
+     */
+    cooperative?: boolean;
+    /**
+     * Score the acoustic model on the GPU with WebGPU where it is available, in the workers of the
+     * JSPI build; other builds, and analyses run in steps, score on the CPU (default: false)
+     */
+    gpuScoring?: boolean;
+    /**
+     * On cross-origin-isolated pages, fetch the model files once into shared memory that all
+     * workers' file systems use in place, instead of a copy per worker (default: true)
+     */
+    shareModels?: boolean;
+    /**
+     * On cross-origin-isolated pages where `Atomics.waitAsync()` is available, hand short
+     * analyses to workers through shared memory instead of messages (default: true)
+     */
+    jobChannels?: boolean;
+    /**
+     * Where SharedWorker is available, run a single engine in a SharedWorker that serves the
+     * pools of all tabs of the origin, instead of workers of this page. `workerScriptUrl` must
+     * then be of the page's origin. Excludes `shareModels`, `jobChannels` and live capture, as
+     * shared memory can't be posted to a SharedWorker (default: false)
+     */
+    sharedWorker?: boolean;
     workerScriptUrl?: string;
+    /** URL of the capture worklet script of `startLiveCapture()` (dist/capture-worklet.js) */
+    workletScriptUrl?: string;
+    /** Memory budget of each worker's WASM module */
+    memoryBudget?: LipSyncEngineMemoryBudget;
+    /**
+     * Answer `analyze()` calls whose audio and options were analyzed before from this cache,
+     * e.g. a `MemoryResultCache` or an `IndexedDbResultCache`
+     */
+    resultCache?: LipSyncEngineResultCache;
+    /** Terminate workers idle for this many milliseconds, down to `minWorkers`; 0 never does (default: 60000) */
+    idleTimeoutMs?: number;
+    /** Workers kept despite being idle (default: 1) */
+    minWorkers?: number;
+    /**
+     * Terminate the least recently used idle workers while the workers' WASM memory, or the
+     * page's memory where `performance.measureUserAgentSpecificMemory()` is available, exceeds
+     * this many bytes. Keeps at least one worker.
+     */
+    maxMemoryBytes?: number;
+    /** Free the workers' cached decoders and dialog models while the page is hidden (default: true) */
+    releaseCachesWhenHidden?: boolean;
   }): Promise<void> {
     if (this.initialized) {
       return;
@@ -91,49 +409,116 @@ export class WorkerPool {
 
     // Update paths if provided
     if (options) {
+      if (options.deviceTier || options.compact || options.cooperative === false) {
+        const baseName = WasmLoader.getBuildName(
+          false,
+          options.deviceTier,
+          options.compact,
+          options.cooperative !== false
+        );
+        const version = packageJson.version;
+        this.wasmPaths.wasmPath = `https://unpkg.com/lip-sync-engine@${version}/dist/wasm/${baseName}.wasm`;
+        this.wasmPaths.jsPath = `https://unpkg.com/lip-sync-engine@${version}/dist/wasm/${baseName}.js`;
+      }
       if (options.wasmPath) this.wasmPaths.wasmPath = options.wasmPath;
-      if (options.dataPath) this.wasmPaths.dataPath = options.dataPath;
       if (options.jsPath) this.wasmPaths.jsPath = options.jsPath;
+      if (options.modelsPath) this.wasmPaths.modelsPath = options.modelsPath;
+      if (options.preloadModels) this.preloadModels = options.preloadModels;
+      if (options.languageModel) this.languageModel = options.languageModel;
+      if (options.pagedLanguageModel !== undefined) this.pagedLanguageModel = options.pagedLanguageModel;
+      if (options.cache !== undefined) this.cache = options.cache;
+      if (options.gpuScoring !== undefined) this.gpuScoring = options.gpuScoring;
+      if (options.shareModels !== undefined) this.shareModels = options.shareModels;
+      if (options.jobChannels !== undefined) this.useJobChannels = options.jobChannels;
+      if (options.sharedWorker && typeof SharedWorker !== 'undefined') {
+        // The engine runs one job at a time, so more connections would only cost the other tabs
+        // their turns; streams still get a connection each
+        this.useSharedWorker = true;
+        this.shareModels = false;
+        this.useJobChannels = false;
+        this.maxWorkers = 1;
+      }
       if (options.workerScriptUrl) this.workerScriptUrl = options.workerScriptUrl;
+      if (options.workletScriptUrl) this.workletScriptUrl = options.workletScriptUrl;
+      if (options.memoryBudget) this.memoryBudget = options.memoryBudget;
+      if (options.resultCache) this.resultCache = options.resultCache;
+      if (options.idleTimeoutMs !== undefined) this.idleTimeoutMs = options.idleTimeoutMs;
+      if (options.minWorkers !== undefined) this.minWorkers = options.minWorkers;
+      if (options.maxMemoryBytes !== undefined) this.maxMemoryBytes = options.maxMemoryBytes;
+    }
+
+    if (this.shareModels && canShareModels()) {
+      this.sharedModels = SharedModelStore.acquire(
+        this.wasmPaths.modelsPath,
+        this.cache,
+        this.languageModel
+      );
+      this.sharedModels.preload(this.preloadModels ?? DEFAULT_PRELOADED_ASSETS);
     }
 
     // Start with 1 worker for fast initialization
     // More workers will be created on-demand when needed
     await this.createWorker();
 
+    if (options?.releaseCachesWhenHidden !== false && typeof document !== 'undefined') {
+      this.onVisibilityChange = () => {
+        if (document.hidden) this.releaseCaches();
+      };
+      document.addEventListener('visibilitychange', this.onVisibilityChange);
+    }
+
     this.initialized = true;
   }
 
   /**
-   * Pre-create all workers up to maxWorkers
-   * Call this during app initialization to eliminate worker creation overhead
+   * Pre-create all workers up to maxWorkers and warm them up
+   * Call this during app initialization, so that neither creating a worker nor the first analysis
+   * of one slows down the first requests: the workers create their decoders and, at the `'full'`
+   * level, analyze a second of synthetic speech, which touches the models' memory, fills the
+   * dictionary caches, sets up the text tokenizer and lets the JIT compile the code of every
+   * stage. Busy workers warm up once their running job completes.
+   *
+   * @param level - How much of the first analysis to do ahead of time (default: `'full'`)
+   * @param options - `recognizer`, `profile`, `dialogMode` and `threadCount` of the analyses to
+   *   warm up for
+   * @throws {Error} If a worker fails to warm up, e.g. if its decoders don't fit the memory budget
    *
    * @example
    * ```typescript
    * const pool = WorkerPool.getInstance();
    * await pool.init({ ... });
-   * await pool.warmup(); // Pre-create all workers
-   * // Now all workers are ready for chunked processing
+   * await pool.warmup(); // Pre-create and warm up all workers
+   * // Now the first analyses run as fast as later ones
    * ```
    */
-  async warmup(): Promise<void> {
+  async warmup(level: LipSyncEngineWarmupLevel = 'full', options: WarmupOptions = {}): Promise<void> {
     if (!this.initialized) {
       throw new Error('WorkerPool not initialized. Call init() first.');
     }
 
-    const workersToCreate = this.maxWorkers - this.workers.length;
-
-    if (workersToCreate <= 0) {
-      return; // Already at max workers
-    }
-
     // Create remaining workers in parallel
+    const workersToCreate = this.maxWorkers - this.workers.length;
     const promises: Promise<PoolWorker>[] = [];
     for (let i = 0; i < workersToCreate; i++) {
       promises.push(this.createWorker());
     }
-
     await Promise.all(promises);
+
+    if (this.sharedModels) {
+      await this.sharedModels.loadAll(getRequiredAssets(options, this.memoryBudget));
+    }
+    await Promise.all(this.workers.map(poolWorker => new Promise<void>((resolve, reject) => {
+      const id = this.nextJobId++;
+      poolWorker.warmupRequests.set(id, error => error ? reject(new Error(error)) : resolve());
+      const message: WorkerRequest = {
+        type: 'warmup',
+        id,
+        level,
+        options,
+        sharedModels: this.getMissingSharedModels(poolWorker, options)
+      };
+      poolWorker.worker.postMessage(message);
+    })));
   }
 
   /**
@@ -142,27 +527,38 @@ export class WorkerPool {
   private async createWorker(): Promise<PoolWorker> {
     return new Promise(async (resolve, reject) => {
       try {
-        // If the worker URL is from a CDN (cross-origin), fetch it and create a blob URL
-        let workerUrl = this.workerScriptUrl;
-        if (workerUrl.startsWith('http://') || workerUrl.startsWith('https://')) {
-          try {
-            const response = await fetch(workerUrl);
-            const blob = await response.blob();
-            workerUrl = URL.createObjectURL(blob);
-          } catch (fetchError) {
-            console.warn('Failed to fetch worker script, trying direct URL:', fetchError);
-            // Fall back to direct URL (will fail with CORS but worth trying)
-          }
-        }
-
-        const worker = new Worker(workerUrl);
+        const createdAt = performance.now();
+        // Compile the build once for all workers, while the script loads. If that fails here,
+        // each worker tries itself. A compiled module can't be posted to a SharedWorker.
+        const wasmModulePromise = this.useSharedWorker
+          ? Promise.resolve(undefined)
+          : WasmLoader.compile(this.wasmPaths.wasmPath, this.cache).catch(() => undefined);
+
+        // The SharedWorker is looked up by URL and name, so it is loaded from the script's own
+        // URL rather than a blob URL of this page; pools of other versions get their own
+        const worker: EngineWorker = this.useSharedWorker
+          ? new SharedEngineConnection(this.workerScriptUrl, `lip-sync-engine-${packageJson.version}`)
+          : new Worker(await this.getScriptUrl(this.workerScriptUrl));
 
         const poolWorker: PoolWorker = {
           worker,
           busy: false,
-          ready: false
+          ready: false,
+          canYield: false,
+          sharedAssets: new Set(),
+          id: this.nextWorkerId++,
+          dialogModels: [],
+          memoryBytes: 0,
+          lastUsed: performance.now(),
+          readyAt: performance.now(),
+          traceRequests: new Map(),
+          warmupRequests: new Map()
         };
 
+        const jobChannel = this.useJobChannels && canUseJobChannels()
+          ? new SharedJobChannel()
+          : undefined;
+
         // Set up message handler
         worker.onmessage = (event: MessageEvent<WorkerResponse>) => {
           this.handleWorkerMessage(poolWorker, event.data);
@@ -176,8 +572,20 @@ export class WorkerPool {
         // Wait for worker to be ready
         const initHandler = (event: MessageEvent<WorkerResponse>) => {
           if (event.data.type === 'ready') {
+            const { memory, cancelFlagPtr, memoryBytes, canYield } = event.data;
+            if (memory && cancelFlagPtr) {
+              poolWorker.cancelFlag = new Int32Array(memory, cancelFlagPtr, 1);
+            }
+            poolWorker.canYield = canYield === true;
+            if (event.data.jobChannel) {
+              poolWorker.jobChannel = jobChannel;
+            }
+            poolWorker.memoryBytes = memoryBytes ?? 0;
             poolWorker.ready = true;
+            poolWorker.readyAt = performance.now();
+            this.metrics.workerInitMs.record(poolWorker.readyAt - createdAt);
             this.workers.push(poolWorker);
+            this.startIdleTimer(poolWorker);
             worker.removeEventListener('message', initHandler);
             resolve(poolWorker);
           } else if (event.data.type === 'error') {
@@ -188,10 +596,30 @@ export class WorkerPool {
 
         worker.addEventListener('message', initHandler);
 
+        const wasmModule = await wasmModulePromise;
+
+        // With shared models, the worker gets the acoustic model now and the other assets with
+        // the jobs that need them, so it fetches nothing itself
+        let sharedModels: SharedModels | undefined;
+        if (this.sharedModels) {
+          sharedModels = { acousticModel: await this.sharedModels.load('acousticModel') };
+          poolWorker.sharedAssets.add('acousticModel');
+        }
+
         // Send init message
         const initMessage: WorkerRequest = {
           type: 'init',
-          ...this.wasmPaths
+          ...this.wasmPaths,
+          wasmModule,
+          cache: this.cache,
+          preloadModels: this.sharedModels ? [] : this.preloadModels,
+          languageModel: this.languageModel,
+          pagedLanguageModel: this.pagedLanguageModel,
+          sharedModels,
+          memoryBudget: this.memoryBudget,
+          tracing: this.traceEvents !== null,
+          jobChannel: jobChannel?.buffer,
+          gpuScoring: this.gpuScoring
         };
         worker.postMessage(initMessage);
 
@@ -201,26 +629,111 @@ export class WorkerPool {
     });
   }
 
+  /**
+   * Get a URL of a script that workers and worklets can load
+   * Scripts on a CDN (cross-origin) are fetched into a blob URL, once for all workers.
+   */
+  private getScriptUrl(url: string): Promise<string> {
+    let promise = this.scriptUrls.get(url);
+    if (!promise) {
+      promise = (async () => {
+        if (url.startsWith('http://') || url.startsWith('https://')) {
+          try {
+            const response = await fetch(url);
+            if (!response.ok) {
+              throw new Error(`HTTP ${response.status}`);
+            }
+            const blob = await response.blob();
+            return URL.createObjectURL(blob);
+          } catch (fetchError) {
+            console.warn('Failed to fetch script, trying direct URL:', fetchError);
+            // Fall back to direct URL (will fail with CORS but worth trying), and fetch again
+            // for the next worker
+            this.scriptUrls.delete(url);
+          }
+        }
+        return url;
+      })();
+      this.scriptUrls.set(url, promise);
+    }
+    return promise;
+  }
+
   /**
    * Handle messages from workers
    */
   private handleWorkerMessage(poolWorker: PoolWorker, message: WorkerResponse): void {
+    // Messages of live captures and worker streams don't free their reserved worker
+    const stream = 'id' in message ? this.liveStreams.get(message.id) : undefined;
+    if (stream && (message.type === 'streamCues' || message.type === 'error')) {
+      stream.handleMessage(message);
+      return;
+    }
+
     if (message.type === 'result') {
       // Find and resolve the in-flight job
       const job = this.inFlightJobs.get(message.id);
-      if (job) {
+      if (job && !('targetSampleRate' in job)) {
         this.inFlightJobs.delete(message.id);
-
-        if (message.result) {
-          job.resolve(message.result);
+        this.recordJob(job, poolWorker, false);
+
+        if (message.packedMouthCues) {
+          this.measureAnalysisCost(job);
+          this.recordResult(message);
+          const result = createPackedResult(message.packedMouthCues);
+          if (message.frames) {
+            result.frames = message.frames;
+          }
+          // The pool collects stats of all analyses for its metrics
+          if (message.stats && job.options.collectStats) {
+            result.stats = message.stats;
+          }
+          if (message.words && message.phones) {
+            result.words = message.words;
+            result.phones = message.phones;
+          }
+          if (message.speakerProfile) {
+            result.speakerProfile = message.speakerProfile;
+          }
+          job.resolve(result);
         } else {
           job.reject(new Error('No result returned from worker'));
         }
       }
 
       // Mark worker as available and process next job
-      poolWorker.busy = false;
-      this.processQueue();
+      this.releaseWorker(poolWorker, message.memoryBytes);
+
+    } else if (message.type === 'progress') {
+      // Progress doesn't free the worker
+      const job = this.inFlightJobs.get(message.id);
+      if (job && !('targetSampleRate' in job)) {
+        job.options.onProgress?.(message.progress, message.remainingMs);
+      }
+
+    } else if (message.type === 'mouthCues') {
+      // Neither do mouth cues
+      const job = this.inFlightJobs.get(message.id);
+      if (job && !('targetSampleRate' in job)) {
+        job.options.onMouthCues?.(message.mouthCues);
+      }
+
+    } else if (message.type === 'preview') {
+      const job = this.inFlightJobs.get(message.id);
+      if (job && !('targetSampleRate' in job)) {
+        job.options.onPreview?.(message.mouthCues);
+      }
+
+    } else if (message.type === 'converted') {
+      const job = this.inFlightJobs.get(message.id);
+      if (job && 'targetSampleRate' in job) {
+        this.inFlightJobs.delete(message.id);
+        this.recordJob(job, poolWorker, false);
+        this.metrics.bytesFromWorkers += message.pcm16.byteLength;
+        job.resolve(message.pcm16);
+      }
+
+      this.releaseWorker(poolWorker, message.memoryBytes);
 
     } else if (message.type === 'error') {
       // Check if this is an analyze error (has id) or init error (no id)
@@ -229,14 +742,25 @@ export class WorkerPool {
         const job = this.inFlightJobs.get(message.id);
         if (job) {
           this.inFlightJobs.delete(message.id);
+          this.recordJob(job, poolWorker, true);
           job.reject(new Error(message.error || 'Unknown worker error'));
         }
 
         // Mark worker as available and process next job
-        poolWorker.busy = false;
-        this.processQueue();
+        this.releaseWorker(poolWorker, message.memoryBytes);
       }
       // Init errors are handled in createWorker()
+
+    } else if (message.type === 'trace') {
+      poolWorker.traceRequests.get(message.id)?.(message.events);
+      poolWorker.traceRequests.delete(message.id);
+
+    } else if (message.type === 'warmedUp') {
+      if (message.memoryBytes !== undefined) {
+        poolWorker.memoryBytes = message.memoryBytes;
+      }
+      poolWorker.warmupRequests.get(message.id)?.(message.error);
+      poolWorker.warmupRequests.delete(message.id);
     }
   }
 
@@ -247,62 +771,427 @@ export class WorkerPool {
     const index = this.workers.indexOf(poolWorker);
     if (index !== -1) {
       this.workers.splice(index, 1);
+      clearTimeout(poolWorker.idleTimer);
       poolWorker.worker.terminate();
+      poolWorker.jobChannel?.close();
+      const now = performance.now();
+      this.busyMs += this.getCurrentBusyMs(poolWorker, now);
+      this.workerMs += now - Math.max(poolWorker.readyAt, this.metricsStart);
+      // The spans of a terminated worker are lost
+      poolWorker.traceRequests.forEach(resolve => resolve([]));
+      poolWorker.traceRequests.clear();
+      // A terminated worker needs no warming up
+      poolWorker.warmupRequests.forEach(settle => settle());
+      poolWorker.warmupRequests.clear();
+    }
+  }
+
+  /**
+   * Mark a worker as available after a job, give it the next job, and shrink the pool if needed
+   */
+  private releaseWorker(poolWorker: PoolWorker, memoryBytes?: number): void {
+    poolWorker.busy = false;
+    poolWorker.lastUsed = performance.now();
+    this.busyMs += this.getCurrentBusyMs(poolWorker, poolWorker.lastUsed);
+    poolWorker.busySince = undefined;
+    if (memoryBytes !== undefined) {
+      poolWorker.memoryBytes = memoryBytes;
+    }
+
+    this.processQueue();
+    if (!poolWorker.busy) {
+      this.startIdleTimer(poolWorker);
+    }
+    this.enforceMemoryLimit();
+    this.destroyIfIdle();
+  }
+
+  /**
+   * Retire a worker once it stays idle for `idleTimeoutMs`, unless the pool is at `minWorkers`
+   */
+  private startIdleTimer(poolWorker: PoolWorker): void {
+    clearTimeout(poolWorker.idleTimer);
+    if (this.idleTimeoutMs <= 0) return;
+
+    poolWorker.idleTimer = setTimeout(() => {
+      poolWorker.idleTimer = undefined;
+      if (!poolWorker.busy && this.workers.length > this.minWorkers) {
+        this.removeWorker(poolWorker);
+      }
+    }, this.idleTimeoutMs);
+  }
+
+  /**
+   * Retire the least recently used idle workers while memory exceeds `maxMemoryBytes`
+   * Uses the WASM memory the workers reported, and the page's measured memory if the browser
+   * can measure it; measurements wait for garbage collection, so they run at most every 30 s.
+   */
+  private enforceMemoryLimit(): void {
+    const maxMemoryBytes = this.maxMemoryBytes;
+    if (maxMemoryBytes === undefined) return;
+
+    const workerBytes = this.workers.reduce((sum, w) => sum + w.memoryBytes, 0);
+    this.retireColdWorkers(workerBytes - maxMemoryBytes);
+
+    const performanceWithMemory = performance as Performance & {
+      measureUserAgentSpecificMemory?: () => Promise<{ bytes: number }>;
+    };
+    const now = performance.now();
+    if (
+      performanceWithMemory.measureUserAgentSpecificMemory &&
+      globalThis.crossOriginIsolated &&
+      now - this.lastMemoryMeasurement >= 30000
+    ) {
+      this.lastMemoryMeasurement = now;
+      performanceWithMemory
+        .measureUserAgentSpecificMemory()
+        .then(({ bytes }) => {
+          if (this.initialized) this.retireColdWorkers(bytes - maxMemoryBytes);
+        })
+        .catch(() => {
+          // Not allowed in this context
+        });
     }
   }
 
+  /**
+   * Terminate least recently used idle workers until at least `excessBytes` of their memory is
+   * freed, keeping at least one worker
+   */
+  private retireColdWorkers(excessBytes: number): void {
+    const idleWorkers = this.workers
+      .filter(w => w.ready && !w.busy)
+      .sort((a, b) => a.lastUsed - b.lastUsed);
+    for (const worker of idleWorkers) {
+      if (excessBytes <= 0 || this.workers.length <= 1) break;
+      excessBytes -= worker.memoryBytes;
+      this.removeWorker(worker);
+    }
+  }
+
+  /**
+   * Free the cached decoders and dialog models of all workers
+   * They are re-created as needed, so the next analyses are slower. The pool calls this when the
+   * page is hidden unless `releaseCachesWhenHidden` is false.
+   */
+  releaseCaches(): void {
+    const message: WorkerRequest = { type: 'releaseCaches' };
+    for (const poolWorker of this.workers) {
+      poolWorker.worker.postMessage(message);
+      poolWorker.dialogModels = [];
+    }
+  }
+
+  /**
+   * Start or stop recording trace spans in all workers, including those created later, and of the
+   * pool's jobs: how long each waited in the queue and which worker ran it
+   *
+   * @param enabled - Whether to record spans; stopping discards those not taken yet
+   */
+  setTracing(enabled: boolean): void {
+    if (enabled === (this.traceEvents !== null)) return;
+
+    this.traceEvents = enabled ? [] : null;
+    const message: WorkerRequest = { type: 'setTracing', enabled };
+    for (const poolWorker of this.workers) {
+      poolWorker.worker.postMessage(message);
+    }
+  }
+
+  /**
+   * Take the trace spans recorded since the last call, merged onto one timeline
+   * The pool is process 0, with a track of queued jobs and a track per worker of the jobs it ran;
+   * each worker is a process of its own, numbered by worker id plus one, with a track per thread.
+   * Busy workers answer once their running job completes.
+   *
+   * @returns A trace to save as JSON and open in chrome://tracing or Perfetto
+   */
+  async takeTrace(): Promise<LipSyncEngineTrace> {
+    const workerEvents = await Promise.all(
+      this.workers.map(poolWorker => new Promise<LipSyncEngineTraceEvent[]>(resolve => {
+        const id = this.nextJobId++;
+        poolWorker.traceRequests.set(id, resolve);
+        const message: WorkerRequest = { type: 'takeTrace', id, processId: poolWorker.id + 1 };
+        poolWorker.worker.postMessage(message);
+      }))
+    );
+
+    const traceEvents: LipSyncEngineTraceEvent[] = [getProcessNameEvent(0, 'pool')];
+    this.workers.forEach(poolWorker => {
+      traceEvents.push(getProcessNameEvent(poolWorker.id + 1, `worker ${poolWorker.id}`));
+    });
+    traceEvents.push(...(this.traceEvents ?? []), ...workerEvents.flat());
+    if (this.traceEvents) {
+      this.traceEvents = [];
+    }
+    return { traceEvents };
+  }
+
+  /**
+   * Record the metrics of a completed job, and its spans if tracing
+   */
+  private recordJob(job: PendingJob | PendingConversion, poolWorker: PoolWorker, failed: boolean): void {
+    const startedAt = job.startedAt ?? job.queuedAt;
+    this.metrics.serviceMs.record(performance.now() - startedAt);
+    this.metrics.completedJobs++;
+    if (failed) this.metrics.failedJobs++;
+    if (!this.traceEvents) return;
+
+    const name = 'targetSampleRate' in job ? 'convert' : 'analyze';
+    const args = { job: job.id, worker: poolWorker.id };
+    // Waiting jobs overlap, so their spans are async ones, each on a row of its own
+    this.traceEvents.push(
+      { name, cat: 'pool', ph: 'b', ts: getTraceTimestamp(job.queuedAt), pid: 0, tid: 0, id: job.id, args },
+      { name, cat: 'pool', ph: 'e', ts: getTraceTimestamp(startedAt), pid: 0, tid: 0, id: job.id },
+      {
+        name,
+        cat: 'pool',
+        ph: 'X',
+        ts: getTraceTimestamp(startedAt),
+        dur: (performance.now() - startedAt) * 1000,
+        pid: 0,
+        tid: poolWorker.id + 1,
+        args
+      }
+    );
+  }
+
   /**
    * Process queued jobs
-   * Simple algorithm: assign each queued job to the next available idle worker
-   * Workers must be pre-created via init() or warmup()
+   * Assigns the next job by `compareJobs()` to an idle worker while there are both, and creates
+   * workers up to `maxWorkers` for the jobs left waiting. Batch jobs run on at most all but one of
+   * `maxWorkers` workers, so that an interactive job queued behind them gets a worker.
    */
   private processQueue(): void {
-    // Assign all pending jobs to available idle workers
+    const batchWorkerLimit = Math.max(1, this.maxWorkers - 1);
     while (this.queue.length > 0) {
-      const idleWorker = this.workers.find(w => w.ready && !w.busy);
+      const idleWorkers = this.workers.filter(w => w.ready && !w.busy);
 
-      if (!idleWorker) {
+      if (idleWorkers.length === 0) {
         // No idle workers available - jobs will be processed when a worker becomes free
         break;
       }
 
-      const job = this.queue.shift();
-      if (!job) break;
+      let batchJobCount = 0;
+      this.inFlightJobs.forEach(job => {
+        if (job.priority === 'batch') batchJobCount++;
+      });
+
+      let next: PendingJob | PendingConversion | undefined;
+      for (const job of this.queue) {
+        if (job.priority === 'batch' && batchJobCount >= batchWorkerLimit) continue;
+        if (!next || compareJobs(job, next) < 0) next = job;
+      }
+      if (!next) break;
+
+      this.queue.splice(this.queue.indexOf(next), 1);
+      this.assignJobToWorker(next, this.chooseWorker(next, idleWorkers));
+    }
+
+    // Jobs still queued are waiting for busy workers; grow the pool for those allowed to run
+    let batchJobCount = 0;
+    this.inFlightJobs.forEach(job => {
+      if (job.priority === 'batch') batchJobCount++;
+    });
+    const interactiveWaiting = this.queue.filter(job => job.priority === 'interactive').length;
+    const batchWaiting = Math.min(
+      this.queue.length - interactiveWaiting,
+      Math.max(0, batchWorkerLimit - batchJobCount)
+    );
+    const workersToCreate = Math.min(
+      interactiveWaiting + batchWaiting - this.pendingWorkerCount,
+      this.maxWorkers - this.workers.length - this.pendingWorkerCount
+    );
+    for (let i = 0; i < workersToCreate; i++) {
+      this.pendingWorkerCount++;
+      this.createWorker().then(
+        () => {
+          this.pendingWorkerCount--;
+          this.processQueue();
+        },
+        (error) => {
+          // The queued jobs wait for the existing workers
+          this.pendingWorkerCount--;
+          console.error('Failed to create worker:', error);
+        }
+      );
+    }
+  }
+
+  /**
+   * Choose the idle worker to run a job
+   * A job with a dialog goes to a worker that has recently built its language model, or else to
+   * the worker ranked first for the dialog by rendezvous hashing, so that the same dialog keeps
+   * going to the same worker as the pool grows or shrinks. Other jobs go to the worker with the
+   * fewest cached dialogs, keeping the others free for their dialogs.
+   */
+  private chooseWorker(
+    job: PendingJob | PendingConversion,
+    idleWorkers: PoolWorker[]
+  ): PoolWorker {
+    const dialogModelKey = 'options' in job ? getDialogModelKey(job.options) : null;
+    if (dialogModelKey !== null) {
+      const holder = idleWorkers.find(w => w.dialogModels.includes(dialogModelKey));
+      if (holder) return holder;
+
+      let best = idleWorkers[0];
+      let bestScore = -1;
+      for (const worker of idleWorkers) {
+        const score = hashString(`${worker.id}:${dialogModelKey}`);
+        if (score > bestScore) {
+          best = worker;
+          bestScore = score;
+        }
+      }
+      return best;
+    }
+
+    return idleWorkers.reduce((least, worker) =>
+      worker.dialogModels.length < least.dialogModels.length ? worker : least
+    );
+  }
 
-      this.assignJobToWorker(job, idleWorker);
+  /**
+   * Remember that a worker builds or reuses a dialog language model
+   */
+  private touchDialogModel(worker: PoolWorker, dialogModelKey: string): void {
+    const index = worker.dialogModels.indexOf(dialogModelKey);
+    if (index !== -1) {
+      worker.dialogModels.splice(index, 1);
+    }
+    worker.dialogModels.push(dialogModelKey);
+    if (worker.dialogModels.length > DIALOG_MODEL_CACHE_CAPACITY) {
+      worker.dialogModels.shift();
     }
   }
 
   /**
    * Assign a job to a worker
    */
-  private assignJobToWorker(job: PendingJob, worker: PoolWorker): void {
+  private assignJobToWorker(job: PendingJob | PendingConversion, worker: PoolWorker): void {
     // Add to in-flight jobs
     this.inFlightJobs.set(job.id, job);
+    job.worker = worker;
+    job.startedAt = performance.now();
 
     // Mark worker as busy
     worker.busy = true;
+    worker.busySince = job.startedAt;
+    clearTimeout(worker.idleTimer);
+    this.metrics.waitMs.record(job.startedAt - job.queuedAt);
+
+    if ('targetSampleRate' in job) {
+      // The audio was copied by convertToPcm16() or decodeToPcm16(), so it can be transferred
+      const { source } = job;
+      if ('bytes' in source) {
+        const message: WorkerRequest = {
+          type: 'decode',
+          id: job.id,
+          bytes: source.bytes,
+          targetSampleRate: job.targetSampleRate
+        };
+        this.metrics.bytesToWorkers += source.bytes.byteLength;
+        worker.worker.postMessage(message, [source.bytes.buffer]);
+      } else {
+        const message: WorkerRequest = {
+          type: 'convert',
+          id: job.id,
+          channels: source.channels,
+          sampleRate: source.sampleRate,
+          targetSampleRate: job.targetSampleRate
+        };
+        this.metrics.bytesToWorkers += source.channels.reduce((sum, channel) => sum + channel.byteLength, 0);
+        worker.worker.postMessage(message, source.channels.map((channel) => channel.buffer));
+      }
+      return;
+    }
+
+    const dialogModelKey = getDialogModelKey(job.options);
+    if (dialogModelKey !== null) {
+      this.touchDialogModel(worker, dialogModelKey);
+    }
 
-    // Send job to worker
-    // Create a true copy with a new ArrayBuffer to avoid detaching the original
-    const bufferCopy = new Int16Array(job.pcm16);
+    // Send job to worker, with the shared model assets it hasn't got yet; analyze() has loaded them
+    const sharedModels = this.getMissingSharedModels(worker, job.options);
 
-    const message: WorkerRequest = {
+    // Signals and callbacks can't be posted to workers
+    const { signal: _signal, onProgress, onMouthCues, onPreview, ...options } = job.options;
+    const message: WorkerAnalyzeRequest = {
       type: 'analyze',
       id: job.id,
-      pcm16: bufferCopy,
-      options: job.options
+      pcm16: job.pcm16,
+      options: { ...options, collectStats: true },
+      reportProgress: onProgress !== undefined,
+      reportMouthCues: onMouthCues !== undefined,
+      reportPreview: onPreview !== undefined,
+      sharedModels
     };
 
-    // Use transferable objects for zero-copy transfer
-    worker.worker.postMessage(message, [bufferCopy.buffer]);
+    this.metrics.bytesToWorkers += job.pcm16.byteLength;
+
+    // Short jobs without callbacks go through the worker's channel, sparing a message each way
+    const { jobChannel } = worker;
+    if (jobChannel && canPostThroughChannel(message) && jobChannel.postRequest(message)) {
+      this.metrics.channelJobs++;
+      jobChannel.takeResponse().then((response) => {
+        if (response) this.handleWorkerMessage(worker, response);
+      });
+      return;
+    }
+
+    // The job owns its audio (see analyze()), so it can be transferred without copying
+    worker.worker.postMessage(message, [job.pcm16.buffer]);
+  }
+
+  /**
+   * Get the shared model assets that options need and that a worker hasn't got yet
+   * The assets must have been loaded; they count as sent to the worker afterwards.
+   */
+  private getMissingSharedModels(
+    worker: PoolWorker,
+    options: Omit<LipSyncEngineOptions, 'signal'>
+  ): SharedModels | undefined {
+    let sharedModels: SharedModels | undefined;
+    if (this.sharedModels) {
+      for (const asset of getRequiredAssets(options, this.memoryBudget)) {
+        const files = this.sharedModels.get(asset);
+        if (files && !worker.sharedAssets.has(asset)) {
+          sharedModels = { ...sharedModels, [asset]: files };
+          worker.sharedAssets.add(asset);
+        }
+      }
+    }
+    return sharedModels;
+  }
+
+  /**
+   * Abort a queued or running job
+   * A running job keeps its worker busy until the worker notices the cancel flag, set directly in
+   * shared memory or by a cancel request that a yielding analysis handles, or finishes anyway; its
+   * result is then discarded.
+   */
+  private abortJob(job: PendingJob, reason: unknown): void {
+    const queueIndex = this.queue.indexOf(job);
+    if (queueIndex !== -1) {
+      this.queue.splice(queueIndex, 1);
+      this.destroyIfIdle();
+    } else if (this.inFlightJobs.delete(job.id) && job.worker) {
+      if (job.worker.cancelFlag) {
+        Atomics.store(job.worker.cancelFlag, 0, 1);
+      } else if (job.worker.canYield) {
+        const request: WorkerCancelRequest = { type: 'cancel', id: job.id };
+        job.worker.worker.postMessage(request);
+      }
+    }
+    job.reject(reason);
   }
 
   /**
    * Analyze audio in a Web Worker (non-blocking)
    *
    * @param pcm16 - 16-bit PCM audio buffer
-   * @param options - Optional configuration
+   * @param options - Optional configuration; `options.signal` aborts the analysis without
+   *   terminating the worker, `options.priority` and `options.deadlineMs` schedule it
    * @returns Promise resolving to lip-sync-engine result
    */
   async analyze(
@@ -312,19 +1201,120 @@ export class WorkerPool {
     if (!this.initialized) {
       throw new Error('WorkerPool not initialized. Call init() first.');
     }
+    throwIfAborted(options.signal);
+
+    // A speaker's result depends on the profile, which the analysis updates
+    if (!this.resultCache || options.speakerProfile) {
+      return this.analyzeUncached(pcm16, options);
+    }
+
+    // Hash before the audio may be transferred. Stats and timings can't be cached, so analyses
+    // including them skip the lookup, but still store their results.
+    const key = getResultCacheKey(pcm16, options, {
+      languageModel: this.languageModel,
+      memoryBudget: this.memoryBudget,
+    });
+    if (!options.collectStats && !options.includeTimings) {
+      const cached = await Promise.resolve()
+        .then(() => this.resultCache!.get(key))
+        .catch(() => undefined);
+      throwIfAborted(options.signal);
+      if (cached) {
+        this.metrics.resultCacheHits++;
+        const result = createPackedResult(cached.packedMouthCues.slice());
+        if (options.frameRate !== undefined) {
+          result.frames = sampleFrames(result.mouthCues, options);
+        }
+        options.onMouthCues?.(result.mouthCues);
+        return result;
+      }
+      this.metrics.resultCacheMisses++;
+    }
+
+    const result = await this.analyzeUncached(pcm16, options);
+    const packedMouthCues = result.packedMouthCues?.slice() ?? encodeMouthCues(result.mouthCues);
+    Promise.resolve()
+      .then(() => this.resultCache!.set(key, { packedMouthCues }))
+      .catch(() => {});
+    return result;
+  }
 
-    // Create a copy of the buffer since we'll transfer ownership to the worker
-    const pcm16Copy = new Int16Array(pcm16);
+  /**
+   * Analyze audio in a Web Worker, without the result cache
+   */
+  private async analyzeUncached(
+    pcm16: Int16Array,
+    options: LipSyncEngineOptions
+  ): Promise<LipSyncEngineResult> {
+    const { signal } = options;
+
+    // Shared model assets are loaded before the job is queued, so that it can be sent at once
+    if (this.sharedModels) {
+      await this.sharedModels.loadAll(getRequiredAssets(options, this.memoryBudget));
+      throwIfAborted(signal);
+    }
+
+    const deadline = options.deadlineMs !== undefined
+      ? performance.now() + options.deadlineMs
+      : Infinity;
+
+    // Pieces can't report the stats of the whole clip, nor its mouth cues in order as they come,
+    // nor one preview of it, nor learn a speaker profile one after another, and their timings
+    // would need stitching like their cues
+    const sampleRate = options.sampleRate || 16000;
+    if (
+      options.priority === 'batch' &&
+      !options.collectStats &&
+      !options.includeTimings &&
+      !options.onMouthCues &&
+      !options.onPreview &&
+      !options.speakerProfile &&
+      pcm16.length > 1.5 * BATCH_PIECE_DURATION * sampleRate
+    ) {
+      return this.analyzeInPieces(pcm16, options, deadline);
+    }
+
+    // Unless the caller hands over the buffer, copy it since we'll transfer ownership to the worker
+    return this.enqueueAnalysis(
+      options.transferAudio && canTransfer(pcm16) ? pcm16 : new Int16Array(pcm16),
+      options,
+      deadline
+    );
+  }
 
-    // Create job promise
+  /**
+   * Queue an analysis job
+   *
+   * @param pcm16 - Audio the job transfers to the worker; covers its whole buffer
+   */
+  private enqueueAnalysis(
+    pcm16: Int16Array,
+    options: LipSyncEngineOptions,
+    deadline: number
+  ): Promise<LipSyncEngineResult> {
+    const { signal } = options;
     return new Promise<LipSyncEngineResult>((resolve, reject) => {
+      const onAbort = () => this.abortJob(job, getAbortReason(signal!));
+      const audioSeconds = pcm16.length / (options.sampleRate || 16000);
       const job: PendingJob = {
         id: this.nextJobId++,
-        pcm16: pcm16Copy,
+        priority: options.priority ?? 'interactive',
+        deadline,
+        queuedAt: performance.now(),
+        estimatedMs: this.estimateAnalysisMs(audioSeconds, options),
+        pcm16,
         options,
-        resolve,
-        reject
+        audioSeconds,
+        resolve: (result) => {
+          signal?.removeEventListener('abort', onAbort);
+          resolve(result);
+        },
+        reject: (error) => {
+          signal?.removeEventListener('abort', onAbort);
+          reject(error);
+        }
       };
+      signal?.addEventListener('abort', onAbort, { once: true });
 
       // Add to queue
       this.queue.push(job);
@@ -334,8 +1324,474 @@ export class WorkerPool {
     });
   }
 
+  /**
+   * Estimate how long an analysis takes once it runs, from the analyses with the same recognizer
+   * and profile that the pool has run
+   */
+  private estimateAnalysisMs(audioSeconds: number, options: LipSyncEngineOptions): number {
+    const cost = this.analysisCosts.get(getAnalysisCostKey(options)) ?? DEFAULT_ANALYSIS_COST;
+    return cost * audioSeconds;
+  }
+
+  /**
+   * Learn the cost of a finished analysis, including the time to post it to the worker and back
+   */
+  private measureAnalysisCost(job: PendingJob): void {
+    if (job.startedAt === undefined || job.audioSeconds <= 0) return;
+    const key = getAnalysisCostKey(job.options);
+    const cost = (performance.now() - job.startedAt) / job.audioSeconds;
+    const previous = this.analysisCosts.get(key);
+    this.analysisCosts.set(
+      key,
+      previous === undefined ? cost : previous + ANALYSIS_COST_SMOOTHING * (cost - previous)
+    );
+  }
+
+  /**
+   * Analyze a long batch clip as pieces cut at quiet points, each queued as a job of its own
+   * Between pieces, the scheduler can run interactive jobs. The pieces overlap for context, and
+   * their cues are stitched at the cuts like those of a stream analyzer's windows.
+   */
+  private async analyzeInPieces(
+    pcm16: Int16Array,
+    options: LipSyncEngineOptions,
+    deadline: number
+  ): Promise<LipSyncEngineResult> {
+    validateFrameOptions(options);
+    const sampleRate = options.sampleRate || 16000;
+    const pieceLength = Math.round(BATCH_PIECE_DURATION * sampleRate);
+    const overlap = Math.round(BATCH_PIECE_OVERLAP * sampleRate);
+    const search = Math.round(BATCH_PIECE_SEARCH * sampleRate);
+
+    const cuts = [0];
+    while (pcm16.length - cuts[cuts.length - 1] > 1.5 * pieceLength) {
+      const target = cuts[cuts.length - 1] + pieceLength;
+      cuts.push(findQuietestPoint(pcm16, target - search, target, sampleRate));
+    }
+    cuts.push(pcm16.length);
+
+    // The progress of the clip is that of its pieces, weighted by their length. The remaining time
+    // is that of the pieces, which run on all but one of the workers at a time, estimated by the pool
+    // until they report their own.
+    const { onProgress } = options;
+    const pieceCount = cuts.length - 1;
+    const pieceProgress = new Array<number>(pieceCount).fill(0);
+    const pieceRemainingMs = cuts.slice(1).map((cut, i) =>
+      this.estimateAnalysisMs((cut - cuts[i]) / sampleRate, options)
+    );
+    const parallelPieces = Math.min(pieceCount, Math.max(1, this.maxWorkers - 1));
+    const reportPieceProgress = (index: number, progress: number, remainingMs: number) => {
+      pieceProgress[index] = progress;
+      pieceRemainingMs[index] = remainingMs;
+      let done = 0;
+      pieceProgress.forEach((value, i) => {
+        done += value * (cuts[i + 1] - cuts[i]);
+      });
+      const remaining = pieceRemainingMs.reduce((sum, value) => sum + value, 0);
+      onProgress!(done / pcm16.length, remaining / parallelPieces);
+    };
+
+    // The frames are sampled from the stitched cues instead
+    const { frameRate, frameBlending, ...baseOptions } = options;
+
+    const pieces: StitchedWindow[] = [];
+    const jobs: Promise<LipSyncEngineResult>[] = [];
+    for (let i = 0; i + 1 < cuts.length; i++) {
+      const audioStart = Math.max(cuts[i] - overlap, 0);
+      const audioEnd = Math.min(cuts[i + 1] + overlap, pcm16.length);
+      pieces.push({
+        offset: audioStart / sampleRate,
+        start: cuts[i] / sampleRate,
+        end: cuts[i + 1] / sampleRate,
+        mouthCues: [],
+      });
+      const pieceOptions = onProgress
+        ? {
+          ...baseOptions,
+          onProgress: (progress: number, remainingMs: number) =>
+            reportPieceProgress(i, progress, remainingMs),
+        }
+        : baseOptions;
+      jobs.push(this.enqueueAnalysis(pcm16.slice(audioStart, audioEnd), pieceOptions, deadline));
+    }
+
+    const results = await Promise.all(jobs);
+    results.forEach((result, i) => {
+      pieces[i].mouthCues = result.mouthCues;
+    });
+    const mouthCues = stitchMouthCues(pieces);
+    return {
+      mouthCues,
+      ...(frameRate !== undefined && { frames: sampleFrames(mouthCues, { frameRate, frameBlending }) }),
+    };
+  }
+
+  /**
+   * Mix float audio down to mono PCM16 at another sample rate in a Web Worker (non-blocking)
+   * Uses the engine's vectorized resampler, so long recordings don't block the main thread with
+   * JavaScript conversion loops.
+   *
+   * @param channels - Samples in [-1, 1] of each channel, all of the same length
+   * @param sampleRate - Sample rate of the channels
+   * @param targetSampleRate - Sample rate of the result (default: 16000)
+   * @returns Promise resolving to the PCM16 samples
+   */
+  async convertToPcm16(
+    channels: Float32Array[],
+    sampleRate: number,
+    targetSampleRate = 16000
+  ): Promise<Int16Array> {
+    if (!this.initialized) {
+      throw new Error('WorkerPool not initialized. Call init() first.');
+    }
+
+    // Copy the channels since we'll transfer ownership to the worker
+    const channelCopies = channels.map((channel) => new Float32Array(channel));
+    return this.enqueueConversion({ channels: channelCopies, sampleRate }, targetSampleRate);
+  }
+
+  /**
+   * Decode a WAVE file to mono PCM16 at another sample rate in a Web Worker (non-blocking)
+   * The file is decoded, mixed down and resampled in one pass inside the worker, so the main
+   * thread never holds the decoded audio at its original sample rate.
+   * Compressed formats must be decoded first, e.g. with `AudioContext.decodeAudioData()` and
+   * `convertToPcm16()`.
+   *
+   * @param bytes - Contents of a WAVE file with integer (8 to 32 bits) or 32-bit float samples
+   * @param targetSampleRate - Sample rate of the result (default: 16000)
+   * @returns Promise resolving to the PCM16 samples
+   */
+  async decodeToPcm16(bytes: ArrayBuffer | Uint8Array, targetSampleRate = 16000): Promise<Int16Array> {
+    if (!this.initialized) {
+      throw new Error('WorkerPool not initialized. Call init() first.');
+    }
+
+    // Copy the file since we'll transfer ownership to the worker
+    const bytesCopy = bytes instanceof Uint8Array ? bytes.slice() : new Uint8Array(bytes.slice(0));
+    return this.enqueueConversion({ bytes: bytesCopy }, targetSampleRate);
+  }
+
+  /**
+   * Decode a WAVE file and analyze it in Web Workers (non-blocking)
+   * Shorthand for `decodeToPcm16()` followed by `analyze()`.
+   *
+   * @param bytes - Contents of a WAVE file, see `decodeToPcm16()`
+   * @param options - Optional configuration, as for `analyze()`; `options.sampleRate` is ignored
+   * @returns Promise resolving to lip-sync-engine result
+   */
+  async analyzeWaveFile(
+    bytes: ArrayBuffer | Uint8Array,
+    options: LipSyncEngineOptions = {}
+  ): Promise<LipSyncEngineResult> {
+    throwIfAborted(options.signal);
+    const pcm16 = await this.decodeToPcm16(bytes);
+    return this.analyze(pcm16, { ...options, sampleRate: 16000, transferAudio: true });
+  }
+
+  private enqueueConversion(
+    source: PendingConversion['source'],
+    targetSampleRate: number
+  ): Promise<Int16Array> {
+    return new Promise<Int16Array>((resolve, reject) => {
+      // Conversions prepare audio that someone is waiting for
+      this.queue.push({
+        id: this.nextJobId++,
+        priority: 'interactive',
+        deadline: Infinity,
+        queuedAt: performance.now(),
+        estimatedMs: 0,
+        source,
+        targetSampleRate,
+        resolve,
+        reject
+      });
+      this.processQueue();
+    });
+  }
+
+  /**
+   * Analyze live audio while it is being captured
+   * An AudioWorklet writes the audio to a ring buffer in shared memory, which a worker reserved
+   * for the capture drains every `pollIntervalMs` into a streaming session. The audio reaches the
+   * engine within one poll interval; mouth cues follow as soon as the engine finalizes them.
+   * By default, the worklet also detects voice activity, so that silence stays in the audio
+   * thread (see `LiveCaptureOptions.workletVad`).
+   * Uses an idle worker, or creates one if all are busy.
+   *
+   * Requires a cross-origin-isolated page, for SharedArrayBuffer.
+   *
+   * @param source - Audio to capture: a media stream, or a node of the audio context to use
+   * @param options - Analysis options and callbacks
+   * @returns Promise resolving to the running capture
+   */
+  async startLiveCapture(
+    source: MediaStream | AudioNode,
+    options: LiveCaptureOptions = {}
+  ): Promise<LiveCapture> {
+    if (!this.initialized) {
+      throw new Error('WorkerPool not initialized. Call init() first.');
+    }
+    if (typeof SharedArrayBuffer === 'undefined' || !globalThis.crossOriginIsolated) {
+      throw new Error('Live capture requires a cross-origin-isolated page');
+    }
+    if (this.useSharedWorker) {
+      throw new Error('Live capture is unavailable with a SharedWorker engine; use createStream()');
+    }
+
+    const {
+      onMouthCues,
+      onTentativeCues,
+      onError,
+      audioContext,
+      workletUrl,
+      pollIntervalMs = 20,
+      bufferMs = 5000,
+      workletVad = true,
+      ...analysisOptions
+    } = options;
+
+    if (this.sharedModels) {
+      await this.sharedModels.loadAll(getRequiredAssets(analysisOptions, this.memoryBudget));
+    }
+
+    // Nodes can only connect within their context
+    let context: BaseAudioContext;
+    let ownedContext: AudioContext | undefined;
+    let sourceNode: AudioNode;
+    if (source instanceof AudioNode) {
+      context = source.context;
+      sourceNode = source;
+    } else {
+      ownedContext = audioContext ? undefined : new AudioContext();
+      const streamContext = audioContext ?? ownedContext!;
+      context = streamContext;
+      sourceNode = streamContext.createMediaStreamSource(source);
+    }
+
+    if (!this.workletContexts.has(context)) {
+      await context.audioWorklet.addModule(await this.getScriptUrl(workletUrl ?? this.workletScriptUrl));
+      this.workletContexts.add(context);
+    }
+
+    const ringBuffer = new SharedRingBuffer(Math.ceil((context.sampleRate * bufferMs) / 1000));
+    const vadModule = workletVad ? await this.getVadModule() : undefined;
+    // At most one entry per frame, so the audio ring buffer fills first
+    const activityRing = vadModule ? new SharedRingBuffer(Math.ceil(bufferMs / 10) + 1) : undefined;
+    const processorOptions: CaptureProcessorOptions = {
+      ringBuffer: ringBuffer.buffer,
+      vadModule,
+      activityBuffer: activityRing?.buffer,
+    };
+    const captureNode = new AudioWorkletNode(context, 'lip-sync-engine-capture', {
+      numberOfInputs: 1,
+      numberOfOutputs: 0,
+      processorOptions
+    });
+
+    const poolWorker = await this.reserveWorker();
+    const id = this.nextJobId++;
+    const capture = new LiveCapture(
+      id,
+      poolWorker.worker,
+      { source: sourceNode, capture: captureNode, ownedContext },
+      { onMouthCues, onTentativeCues, onError },
+      () => {
+        this.liveStreams.delete(id);
+        this.releaseWorker(poolWorker);
+      }
+    );
+    this.liveStreams.set(id, capture);
+
+    const message: WorkerRequest = {
+      type: 'streamBegin',
+      id,
+      ringBuffer: ringBuffer.buffer,
+      activityBuffer: activityRing?.buffer,
+      options: { ...analysisOptions, sampleRate: context.sampleRate },
+      pollIntervalMs,
+      sharedModels: this.getMissingSharedModels(poolWorker, analysisOptions)
+    };
+    poolWorker.worker.postMessage(message);
+
+    sourceNode.connect(captureNode);
+    if (ownedContext) {
+      await ownedContext.resume();
+    }
+    return capture;
+  }
+
+  /**
+   * Compile lip-sync-engine-vad.wasm, from the directory of the engine's build, and check that it
+   * instantiates
+   * Resolves to undefined if it can't be loaded, in which case the engine detects voice activity.
+   */
+  private getVadModule(): Promise<WebAssembly.Module | undefined> {
+    if (!this.vadModule) {
+      const vadPath = this.wasmPaths.wasmPath.replace(/[^/]*$/, 'lip-sync-engine-vad.wasm');
+      this.vadModule = WasmLoader.compile(vadPath, this.cache)
+        .then(async module => {
+          await WebAssembly.instantiate(module, createVadImports(module));
+          return module;
+        })
+        .catch(() => undefined);
+    }
+    return this.vadModule;
+  }
+
+  /**
+   * Reserve an idle worker for a live capture or stream, or create one if all are busy
+   * The worker stays busy until released with `releaseWorker()`.
+   */
+  private async reserveWorker(): Promise<PoolWorker> {
+    const poolWorker =
+      this.workers.find(w => w.ready && !w.busy) ?? (await this.createWorker());
+    poolWorker.busy = true;
+    poolWorker.busySince = performance.now();
+    clearTimeout(poolWorker.idleTimer);
+    return poolWorker;
+  }
+
+  /**
+   * Begin a streaming analysis session in a worker
+   * Like `LipSyncEngine.createStream()`, but the session runs in a worker reserved for it until
+   * `end()`, so recognizing each chunk doesn't block this thread. Uses an idle worker, or creates
+   * one if all are busy.
+   *
+   * @param options - Analysis options; callbacks are ignored
+   * @returns Promise resolving to the session
+   */
+  async createStream(options: LipSyncEngineOptions = {}): Promise<WorkerStream> {
+    if (!this.initialized) {
+      throw new Error('WorkerPool not initialized. Call init() first.');
+    }
+
+    // Signals and callbacks can't be posted to workers
+    const {
+      signal: _signal,
+      onProgress: _onProgress,
+      onMouthCues: _onMouthCues,
+      onPreview: _onPreview,
+      ...analysisOptions
+    } = options;
+    if (this.sharedModels) {
+      await this.sharedModels.loadAll(getRequiredAssets(analysisOptions, this.memoryBudget));
+    }
+
+    const poolWorker = await this.reserveWorker();
+    const id = this.nextJobId++;
+    const stream = new WorkerStream(id, poolWorker.worker, this.transferBuffers, () => {
+      this.liveStreams.delete(id);
+      this.releaseWorker(poolWorker);
+    });
+    this.liveStreams.set(id, stream);
+
+    const message: WorkerRequest = {
+      type: 'streamBegin',
+      id,
+      options: analysisOptions,
+      sharedModels: this.getMissingSharedModels(poolWorker, analysisOptions)
+    };
+    poolWorker.worker.postMessage(message);
+    return stream;
+  }
+
+  /**
+   * Take a buffer for a chunk of a worker stream, to fill and push with `transferAudio`
+   * Buffers come from those the workers sent back after earlier chunks of the same size, so
+   * capture code that fills one per chunk allocates none once streaming runs.
+   *
+   * @param length - Number of samples
+   */
+  acquireAudioBuffer(length: number): Int16Array {
+    return this.transferBuffers.acquire(length);
+  }
+
+  /**
+   * Analyze a WAVE file that a worker reads itself, block by block
+   * The file is posted by reference: a `File` or `Blob`, e.g. of a file input, or the
+   * `FileSystemFileHandle` of a file in the origin private file system, which the worker reads
+   * straight into WASM memory. The main thread never touches the file's bytes, and the worker only
+   * holds one block of them at a time, so files of any length are analyzed in constant memory. The
+   * worker feeds the blocks to a streaming session, as `createStream()` does, and posts the cues as
+   * the session finalizes them. Uses an idle worker, or creates one if all are busy.
+   *
+   * @param file - A WAVE file with integer (8 to 32 bits) or 32-bit float samples
+   * @param options - Analysis options; the file is analyzed at its own sample rate
+   * @returns Promise resolving to the mouth cues, in seconds from the start
+   */
+  async analyzeFile(
+    file: Blob | FileSystemFileHandle,
+    options: LipSyncEngineFileOptions = {}
+  ): Promise<MouthCue[]> {
+    if (!this.initialized) {
+      throw new Error('WorkerPool not initialized. Call init() first.');
+    }
+
+    const { signal, onMouthCues, onTentativeCues, ...analysisOptions } = options;
+    throwIfAborted(signal);
+    if (this.sharedModels) {
+      await this.sharedModels.loadAll(getRequiredAssets(analysisOptions, this.memoryBudget));
+    }
+
+    const poolWorker = await this.reserveWorker();
+    if (signal?.aborted) {
+      this.releaseWorker(poolWorker);
+      throw getAbortReason(signal);
+    }
+    const id = this.nextJobId++;
+    // Closes the session, which the worker stops reading for
+    const onAbort = () => {
+      const message: WorkerRequest = { type: 'cancel', id };
+      poolWorker.worker.postMessage(message);
+      analysis.fail(getAbortReason(signal!));
+    };
+    const analysis = new FileAnalysis({ onMouthCues, onTentativeCues }, () => {
+      signal?.removeEventListener('abort', onAbort);
+      this.liveStreams.delete(id);
+      this.releaseWorker(poolWorker);
+    });
+    signal?.addEventListener('abort', onAbort, { once: true });
+    this.liveStreams.set(id, analysis);
+
+    const message: WorkerRequest = {
+      type: 'streamBegin',
+      id,
+      file,
+      options: analysisOptions,
+      sharedModels: this.getMissingSharedModels(poolWorker, analysisOptions)
+    };
+    poolWorker.worker.postMessage(message);
+    return analysis.result;
+  }
+
+  /**
+   * Create a TransformStream that analyzes the audio piped through it in a worker
+   * Chunks written are pushed to a session of `createStream()`, begun when the stream starts;
+   * each chunk read is the array of mouth cues the session finalized, in seconds from the start.
+   * Writes wait while the worker is a few chunks behind or the cues aren't read, so a piped
+   * source of any length is read at the pace of the analysis in constant memory.
+   *
+   * @param options - Analysis options and the tentative cues callback
+   * @returns The stream, which ends its session and releases its worker once closed
+   *
+   * @example
+   * ```typescript
+   * await pcm16Chunks
+   *   .pipeThrough(pool.createTransformStream({ sampleRate: 16000 }))
+   *   .pipeTo(new WritableStream({ write: (mouthCues) => avatar.enqueue(mouthCues) }));
+   * ```
+   */
+  createTransformStream(
+    options: LipSyncEngineTransformStreamOptions = {}
+  ): TransformStream<Int16Array, MouthCue[]> {
+    const { onTentativeCues, ...analysisOptions } = options;
+    return createMouthCueTransformStream(() => this.createStream(analysisOptions), onTentativeCues);
+  }
+
   /**
    * Analyze multiple audio buffers in parallel using chunked processing
+   * At most two chunks per worker are queued or running at a time, so that the pool only holds
+   * copies of those, however many chunks there are.
    *
    * @param chunks - Array of audio chunks to process
    * @param options - Optional configuration
@@ -349,16 +1805,30 @@ export class WorkerPool {
       throw new Error('WorkerPool not initialized. Call init() first.');
     }
 
-    // Analyze all chunks in parallel
-    const promises = chunks.map(chunk => this.analyze(chunk, options));
-    return Promise.all(promises);
+    const results: LipSyncEngineResult[] = new Array(chunks.length);
+    let nextIndex = 0;
+    const analyzeNext = async (): Promise<void> => {
+      while (nextIndex < chunks.length) {
+        const index = nextIndex++;
+        results[index] = await this.analyze(chunks[index], options);
+      }
+    };
+    const runners = Array.from(
+      { length: Math.min(chunks.length, MAX_CHUNKS_IN_FLIGHT_PER_WORKER * this.maxWorkers) },
+      analyzeNext
+    );
+    await Promise.all(runners);
+    return results;
   }
 
   /**
    * Create a dynamic streaming analyzer that allows adding chunks on-the-fly
-   * Returns a controller that lets you add chunks as they arrive from a stream
+   * Returns a controller that lets you add chunks as they arrive from a stream. The stream is cut
+   * into overlapping windows at quiet points, which workers analyze in parallel; their mouth cues
+   * are stitched together at the cuts, so chunk boundaries don't cut words or add idle padding.
    *
    * @param options - Optional configuration for all chunks
+   * @param windowOptions - Optional overlap and cut search range of the windows
    * @returns StreamController with addChunk() and finalize() methods
    *
    * @example
@@ -366,21 +1836,24 @@ export class WorkerPool {
    * const stream = pool.createStreamAnalyzer({ dialogText: "hello" });
    * await pool.warmup(); // Pre-create workers
    *
-   * // Add chunks as they arrive from your audio stream
+   * // Add chunks as they arrive from your audio stream, waiting while the workers fall behind
    * for await (const chunk of audioStream) {
-   *   stream.addChunk(chunk); // Non-blocking, queues immediately
+   *   await stream.write(chunk);
    * }
    *
    * // Wait for all chunks to complete and get results in order
    * const results = await stream.finalize();
    * ```
    */
-  createStreamAnalyzer(options: LipSyncEngineOptions = {}): StreamAnalyzerController {
+  createStreamAnalyzer(
+    options: LipSyncEngineOptions = {},
+    windowOptions: StreamWindowOptions = {}
+  ): StreamAnalyzerController {
     if (!this.initialized) {
       throw new Error('WorkerPool not initialized. Call init() first.');
     }
 
-    const controller = new StreamAnalyzerController(this, options);
+    const controller = new StreamAnalyzerController(this, options, windowOptions);
     return controller;
   }
 
@@ -393,6 +1866,10 @@ export class WorkerPool {
     idleWorkers: number;
     queuedJobs: number;
     maxWorkers: number;
+    /** `analyze()` calls answered from the result cache */
+    resultCacheHits: number;
+    /** `analyze()` calls that looked up the result cache in vain */
+    resultCacheMisses: number;
   } {
     const busyWorkers = this.workers.filter(w => w.busy).length;
     return {
@@ -400,10 +1877,146 @@ export class WorkerPool {
       busyWorkers,
       idleWorkers: this.workers.length - busyWorkers,
       queuedJobs: this.queue.length,
-      maxWorkers: this.maxWorkers
+      maxWorkers: this.maxWorkers,
+      resultCacheHits: this.metrics.resultCacheHits,
+      resultCacheMisses: this.metrics.resultCacheMisses
+    };
+  }
+
+  /**
+   * Get live metrics of the pool for capacity planning: queue length, wait and service times of
+   * jobs, worker utilization and initialization times, bytes transferred, and the cache hits of
+   * the workers' engines and of the result cache
+   */
+  getMetrics(): WorkerPoolMetrics {
+    const now = performance.now();
+    let busyMs = this.busyMs;
+    let workerMs = this.workerMs;
+    for (const poolWorker of this.workers) {
+      busyMs += this.getCurrentBusyMs(poolWorker, now);
+      workerMs += now - Math.max(poolWorker.readyAt, this.metricsStart);
+    }
+    const { waitMs, serviceMs, workerInitMs, ...counters } = this.metrics;
+    return {
+      timestamp: now,
+      periodMs: now - this.metricsStart,
+      queueLength: this.queue.length,
+      totalWorkers: this.workers.length,
+      busyWorkers: this.workers.filter(w => w.busy).length,
+      waitMs: waitMs.snapshot(),
+      serviceMs: serviceMs.snapshot(),
+      utilization: workerMs > 0 ? busyMs / workerMs : 0,
+      workerInitMs: workerInitMs.snapshot(),
+      ...counters
+    };
+  }
+
+  /**
+   * Call a listener with the pool's metrics at an interval
+   *
+   * @param listener - Called with each snapshot of `getMetrics()`
+   * @param intervalMs - Milliseconds between snapshots (default: 1000)
+   * @returns A function that stops the calls
+   *
+   * @example
+   * ```typescript
+   * const stop = pool.onMetrics((metrics) => {
+   *   console.log(metrics.queueLength, metrics.waitMs.p90, metrics.utilization);
+   * }, 5000);
+   * ```
+   */
+  onMetrics(listener: (metrics: WorkerPoolMetrics) => void, intervalMs = 1000): () => void {
+    const timer = setInterval(() => listener(this.getMetrics()), intervalMs);
+    this.metricsTimers.add(timer);
+    return () => {
+      clearInterval(timer);
+      this.metricsTimers.delete(timer);
     };
   }
 
+  /**
+   * Start a new period of `getMetrics()`, clearing its counts and durations
+   */
+  resetMetrics(): void {
+    const now = performance.now();
+    this.metrics = WorkerPool.createMetrics();
+    this.metricsStart = now;
+    this.busyMs = 0;
+    this.workerMs = 0;
+  }
+
+  private static createMetrics() {
+    return {
+      completedJobs: 0,
+      failedJobs: 0,
+      waitMs: new Histogram(),
+      serviceMs: new Histogram(),
+      workerInitMs: new Histogram(),
+      bytesToWorkers: 0,
+      bytesFromWorkers: 0,
+      channelJobs: 0,
+      decoderCacheHits: 0,
+      decoderCacheMisses: 0,
+      dialogModelCacheHits: 0,
+      dialogModelCacheMisses: 0,
+      utteranceCacheHits: 0,
+      utteranceCacheMisses: 0,
+      resultCacheHits: 0,
+      resultCacheMisses: 0
+    };
+  }
+
+  /**
+   * Get how long a worker has been busy in the current period of the metrics, if it is
+   */
+  private getCurrentBusyMs(poolWorker: PoolWorker, now: number): number {
+    return poolWorker.busySince === undefined ? 0 : now - Math.max(poolWorker.busySince, this.metricsStart);
+  }
+
+  /**
+   * Add the transferred bytes and engine cache counters of an analysis result to the metrics
+   */
+  private recordResult(message: WorkerAnalyzeResponse): void {
+    const metrics = this.metrics;
+    metrics.bytesFromWorkers += (message.packedMouthCues?.byteLength ?? 0)
+      + (message.speakerProfile?.byteLength ?? 0)
+      + (message.frames?.shapes.byteLength ?? 0)
+      + (message.frames?.blendShapes?.byteLength ?? 0)
+      + (message.frames?.blendWeights?.byteLength ?? 0);
+    const stats = message.stats;
+    if (stats) {
+      metrics.decoderCacheHits += stats.decoderCacheHits;
+      metrics.decoderCacheMisses += stats.decoderCacheMisses;
+      metrics.dialogModelCacheHits += stats.dialogModelCacheHits;
+      metrics.dialogModelCacheMisses += stats.dialogModelCacheMisses;
+      metrics.utteranceCacheHits += stats.utteranceCacheHits;
+      metrics.utteranceCacheMisses += stats.utteranceCacheMisses;
+    }
+  }
+
+  /**
+   * Destroy the worker pool once its queued and running jobs, live captures and streams are done,
+   * or now if there are none. Unlike `destroy()`, work already given to the pool finishes; the pool
+   * shouldn't be given more.
+   */
+  destroyWhenIdle(): void {
+    this.destroyingWhenIdle = true;
+    this.destroyIfIdle();
+  }
+
+  /** Destroy the pool if `destroyWhenIdle()` was called and it has nothing left to do */
+  private destroyIfIdle(): void {
+    if (
+      this.destroyingWhenIdle &&
+      this.queue.length === 0 &&
+      this.inFlightJobs.size === 0 &&
+      this.liveStreams.size === 0 &&
+      !this.workers.some(w => w.busy)
+    ) {
+      this.destroy();
+    }
+  }
+
   /**
    * Destroy the worker pool and terminate all workers
    */
@@ -420,17 +2033,66 @@ export class WorkerPool {
     });
     this.inFlightJobs.clear();
 
+    // Captures just stop; streams reject their pending pushes
+    this.liveStreams.forEach((stream, id) => {
+      if (stream instanceof WorkerStream || stream instanceof FileAnalysis) {
+        stream.handleMessage({ type: 'error', id, error: 'WorkerPool destroyed' });
+      }
+    });
+    this.liveStreams.clear();
+    this.transferBuffers.clear();
+    this.metricsTimers.forEach(timer => clearInterval(timer));
+    this.metricsTimers.clear();
+
+    if (this.onVisibilityChange) {
+      document.removeEventListener('visibilitychange', this.onVisibilityChange);
+      this.onVisibilityChange = null;
+    }
+
     // Terminate all workers
     this.workers.forEach(poolWorker => {
+      clearTimeout(poolWorker.idleTimer);
       poolWorker.worker.terminate();
+      poolWorker.jobChannel?.close();
     });
     this.workers = [];
+    this.sharedModels?.release();
+    this.sharedModels = null;
+
+    // Workers have loaded their scripts, so the blob URLs can go
+    this.scriptUrls.forEach(promise => {
+      promise.then(url => {
+        if (url.startsWith('blob:')) URL.revokeObjectURL(url);
+      });
+    });
+    this.scriptUrls.clear();
 
     this.initialized = false;
-    WorkerPool.instance = null;
+    this.destroyingWhenIdle = false;
+    // A pool from create() leaves the singleton alone
+    if (WorkerPool.instance === this) {
+      WorkerPool.instance = null;
+    }
   }
 }
 
+/**
+ * A window of a stream, analyzed by one worker
+ * All positions are sample indexes in the stream.
+ */
+interface StreamWindow {
+  /** First sample of the window's audio, including the overlap before the cut */
+  audioStart: number;
+  /** Cut before the window: the first sample whose cues are taken from this window */
+  start: number;
+  /** Cut after the window: the sample after the last whose cues are taken from this window */
+  end: number;
+  promise: Promise<LipSyncEngineResult>;
+  completed: boolean;
+  /** Samples of the window's audio, pending until it completes or fails */
+  sampleCount: number;
+}
+
 /**
  * Controller for dynamic streaming analysis
  * Allows adding chunks on-the-fly as they arrive from a stream
@@ -438,18 +2100,52 @@ export class WorkerPool {
 export class StreamAnalyzerController {
   private pool: WorkerPool;
   private options: LipSyncEngineOptions;
-  private chunks: Array<{ index: number; promise: Promise<LipSyncEngineResult> }> = [];
-  private nextIndex = 0;
+  private sampleRate: number;
+  private overlap: number;
+  private search: number;
+  /** Stream position of the first sample of each chunk */
+  private chunkStarts: number[] = [];
+  private sampleCount = 0;
+  /** The audio from `bufferStart` on, which later windows still need */
+  private buffer = new Int16Array(0);
+  private bufferStart = 0;
+  /** The cut after the last dispatched window */
+  private lastCut = 0;
+  private windows: StreamWindow[] = [];
+  private stitched: Promise<MouthCue[]> | null = null;
   private finalized = false;
+  /** Samples above which `write()` and `ready` wait; see `StreamWindowOptions.maxPendingMs` */
+  private maxPendingSamples: number;
+  /** Samples of the windows queued but not analyzed yet */
+  private pendingSamples = 0;
+  /** Resolves `ready` promises once the pending audio falls to the limit */
+  private readyWaiters: Array<() => void> = [];
+
+  constructor(
+    pool: WorkerPool,
+    options: LipSyncEngineOptions,
+    windowOptions: StreamWindowOptions = {}
+  ) {
+    const { overlapMs = 500, searchMs = 1000, maxPendingMs = 60000 } = windowOptions;
+    if (overlapMs < 0 || searchMs < 0) {
+      throw new Error('overlapMs and searchMs must not be negative');
+    }
+    if (!(maxPendingMs > 0)) {
+      throw new Error('maxPendingMs must be positive');
+    }
 
-  constructor(pool: WorkerPool, options: LipSyncEngineOptions) {
     this.pool = pool;
     this.options = options;
+    this.sampleRate = options.sampleRate || 16000;
+    this.overlap = Math.round((overlapMs * this.sampleRate) / 1000);
+    this.search = Math.max(Math.round((searchMs * this.sampleRate) / 1000), 1);
+    this.maxPendingSamples = Math.round((maxPendingMs * this.sampleRate) / 1000);
   }
 
   /**
    * Add a chunk to be analyzed
-   * This immediately queues the chunk for processing - no main thread blocking
+   * This immediately queues the audio up to a quiet point near the end of the chunk for
+   * processing - no main thread blocking. The rest waits for the next chunk or finalize().
    *
    * @param chunk - Audio chunk to analyze
    * @returns The index of this chunk in the result array
@@ -459,27 +2155,184 @@ export class StreamAnalyzerController {
       throw new Error('Cannot add chunks after finalize() has been called');
     }
 
-    const index = this.nextIndex++;
-    const promise = this.pool.analyze(chunk, this.options);
+    const index = this.chunkStarts.length;
+    this.chunkStarts.push(this.sampleCount);
+    this.sampleCount += chunk.length;
 
-    this.chunks.push({ index, promise });
+    const buffer = new Int16Array(this.buffer.length + chunk.length);
+    buffer.set(this.buffer);
+    buffer.set(chunk, this.buffer.length);
+    this.buffer = buffer;
 
+    this.dispatchWindows();
+    return index;
+  }
+
+  /**
+   * Add a chunk to be analyzed, then wait until the workers have caught up
+   * Like `addChunk()`, followed by `ready`.
+   *
+   * @param chunk - Audio chunk to analyze
+   * @returns The index of this chunk in the result array
+   */
+  async write(chunk: Int16Array): Promise<number> {
+    const index = this.addChunk(chunk);
+    await this.ready;
     return index;
   }
 
+  /**
+   * Resolves once the audio queued for analysis is at most `maxPendingMs`
+   * Producers that await it before each `addChunk()` are slowed to the pace of the workers.
+   */
+  get ready(): Promise<void> {
+    if (this.pendingSamples <= this.maxPendingSamples) {
+      return Promise.resolve();
+    }
+    return new Promise((resolve) => this.readyWaiters.push(resolve));
+  }
+
+  /**
+   * Get a WritableStream that adds the chunks written to it, for piping audio streams in
+   * Its writes wait like `write()`, so a piped stream is read at the pace of the workers.
+   * Closing it doesn't finalize the analyzer; call `finalize()` or `finalizeStitched()`.
+   */
+  getWritable(): WritableStream<Int16Array> {
+    return new WritableStream<Int16Array>({
+      write: async (chunk) => {
+        await this.write(chunk);
+      },
+    });
+  }
+
+  /**
+   * Queue windows for the audio added so far
+   * A cut needs `overlap` samples after it, and is moved back by up to `search` samples to the
+   * quietest point. Without `final`, audio too close to the end waits for more.
+   */
+  private dispatchWindows(final = false): void {
+    const latestCut = this.sampleCount - this.overlap;
+    if (latestCut - this.search > this.lastCut) {
+      const cut = findQuietestPoint(
+        this.buffer,
+        latestCut - this.search - this.bufferStart,
+        latestCut - this.bufferStart,
+        this.sampleRate
+      ) + this.bufferStart;
+      this.dispatchWindow(cut);
+    }
+
+    if (final && this.sampleCount > this.lastCut) {
+      this.dispatchWindow(this.sampleCount);
+    }
+  }
+
+  /**
+   * Queue the window ending at a cut, with the overlap on both sides
+   */
+  private dispatchWindow(cut: number): void {
+    const audioStart = Math.max(this.lastCut - this.overlap, 0);
+    const audioEnd = Math.min(cut + this.overlap, this.sampleCount);
+    const audio = this.buffer.subarray(audioStart - this.bufferStart, audioEnd - this.bufferStart);
+
+    const window: StreamWindow = {
+      audioStart,
+      start: this.lastCut,
+      end: cut,
+      promise: this.pool.analyze(audio, this.options),
+      completed: false,
+      sampleCount: audio.length,
+    };
+    this.pendingSamples += window.sampleCount;
+    window.promise.then(
+      () => {
+        window.completed = true;
+        this.settleWindow(window);
+      },
+      () => this.settleWindow(window)
+    );
+    this.windows.push(window);
+
+    // The next window only needs the overlap before the cut
+    this.lastCut = cut;
+    const newBufferStart = Math.max(cut - this.overlap, 0);
+    this.buffer = this.buffer.slice(newBufferStart - this.bufferStart);
+    this.bufferStart = newBufferStart;
+  }
+
+  /**
+   * Stop counting a finished window as pending, and resolve `ready` if the workers caught up
+   */
+  private settleWindow(window: StreamWindow): void {
+    this.pendingSamples -= window.sampleCount;
+    if (this.pendingSamples <= this.maxPendingSamples) {
+      const waiters = this.readyWaiters;
+      this.readyWaiters = [];
+      waiters.forEach((resolve) => resolve());
+    }
+  }
+
+  /**
+   * Analyze the rest of the stream and stitch the cues of all windows
+   */
+  private stitch(): Promise<MouthCue[]> {
+    if (!this.stitched) {
+      this.finalized = true;
+      this.dispatchWindows(true);
+      this.stitched = Promise.all(this.windows.map((w) => w.promise)).then((results) =>
+        stitchMouthCues(
+          results.map((result, i): StitchedWindow => ({
+            offset: this.windows[i].audioStart / this.sampleRate,
+            start: this.windows[i].start / this.sampleRate,
+            end: this.windows[i].end / this.sampleRate,
+            mouthCues: result.mouthCues,
+          }))
+        )
+      );
+    }
+    return this.stitched;
+  }
+
   /**
    * Wait for all chunks to complete and return results in insertion order
+   * Each result holds the stitched cues within its chunk, relative to the start of the chunk.
    *
    * @returns Array of results in the same order chunks were added
    */
   async finalize(): Promise<LipSyncEngineResult[]> {
-    this.finalized = true;
-
-    // Wait for all chunks to complete
-    const results = await Promise.all(this.chunks.map(c => c.promise));
+    const mouthCues = await this.stitch();
+    return this.chunkStarts.map((chunkStart, index) => {
+      const chunkEnd = this.chunkStarts[index + 1] ?? this.sampleCount;
+      return {
+        mouthCues: sliceMouthCues(
+          mouthCues,
+          chunkStart / this.sampleRate,
+          chunkEnd / this.sampleRate
+        ),
+        metadata: {
+          duration: (chunkEnd - chunkStart) / this.sampleRate,
+          sampleRate: this.sampleRate,
+          dialogText: this.options.dialogText,
+        },
+      };
+    });
+  }
 
-    // Results are already in order since we preserved insertion order
-    return results;
+  /**
+   * Wait for all chunks to complete and return the cues of the whole stream
+   *
+   * @returns Result with the stitched cues, in seconds from the start of the stream
+   */
+  async finalizeStitched(): Promise<LipSyncEngineResult> {
+    const mouthCues = await this.stitch();
+    return {
+      mouthCues,
+      metadata: {
+        duration: this.sampleCount / this.sampleRate,
+        sampleRate: this.sampleRate,
+        dialogText: this.options.dialogText,
+      },
+    };
   }
 
   /**
@@ -488,11 +2341,28 @@ export class StreamAnalyzerController {
   getStats(): {
     chunksAdded: number;
     chunksCompleted: number;
+    windowsQueued: number;
+    windowsCompleted: number;
+    /** Milliseconds of audio queued for analysis but not yet analyzed */
+    pendingMs: number;
     poolStats: ReturnType<WorkerPool['getStats']>;
   } {
+    // Chunks are complete once all windows up to their end are
+    let completedEnd = 0;
+    for (const window of this.windows) {
+      if (!window.completed) break;
+      completedEnd = window.end;
+    }
+    const chunksCompleted = this.chunkStarts.filter(
+      (_, index) => (this.chunkStarts[index + 1] ?? this.sampleCount) <= completedEnd
+    ).length;
+
     return {
-      chunksAdded: this.chunks.length,
-      chunksCompleted: this.nextIndex,
+      chunksAdded: this.chunkStarts.length,
+      chunksCompleted,
+      windowsQueued: this.windows.length,
+      windowsCompleted: this.windows.filter((w) => w.completed).length,
+      pendingMs: (this.pendingSamples * 1000) / this.sampleRate,
       poolStats: this.pool.getStats()
     };
   }
@@ -0,0 +1,148 @@
+import type { LipSyncEngineStreamResult, MouthCue } from './types';
+import type { WorkerRequest, WorkerAnalyzeResponse, WorkerStreamCuesResponse } from './worker';
+import type { EngineWorker } from './utils/sharedEngine';
+import { applyTentativeCues } from './utils/cueDeltas';
+import { canTransfer, type TransferBufferPool } from './utils/transferBuffers';
+
+/**
+ * Streaming analysis session in a reserved pool worker
+ * The counterpart of `LipSyncEngineStream` off the main thread: each chunk is posted to the worker,
+ * and the promise `push()` returns resolves with the cues the session finalized once the worker has
+ * recognized it. Pushes may overlap; their results arrive in order. The worker sends the buffer of
+ * each chunk back with its result, and later chunks of the same size are copied into it, so steady
+ * streaming allocates no audio buffers.
+ *
+ * Create sessions with `WorkerPool.createStream()`, or pipe audio through
+ * `WorkerPool.createTransformStream()`.
+ *
+ * @example
+ * ```typescript
+ * const stream = await pool.createStream({ sampleRate: 16000 });
+ * for await (const chunk of chunks) {
+ *   const { mouthCues } = await stream.push(chunk);
+ *   avatar.enqueue(mouthCues);
+ * }
+ * avatar.enqueue((await stream.end()).mouthCues);
+ * ```
+ */
+export class WorkerStream {
+  /** Settle the pending pushes and the end, in the order they were posted */
+  private pending: Array<{
+    resolve: (result: LipSyncEngineStreamResult) => void;
+    reject: (error: Error) => void;
+  }> = [];
+  private tentativeCues: MouthCue[] = [];
+  private error: Error | null = null;
+  private ended = false;
+  private finished = false;
+
+  /** @internal */
+  constructor(
+    private readonly id: number,
+    private readonly worker: EngineWorker,
+    /** The pool's buffers for chunks */
+    private readonly buffers: TransferBufferPool,
+    /** Returns the worker to the pool */
+    private readonly release: () => void
+  ) {}
+
+  /**
+   * Push audio to the session
+   * The samples are copied into a buffer of the pool, so the chunk can be reused right away.
+   *
+   * @param pcm16 - 16-bit PCM audio chunk (mono, at the session's sample rate)
+   * @param options - `transferAudio` to hand the chunk's buffer over instead of copying it, e.g.
+   *   one of `WorkerPool.acquireAudioBuffer()`; the buffer then returns to the pool
+   * @returns Promise resolving to the mouth cues finalized since the previous push, and the
+   *   current tentative cues
+   */
+  push(
+    pcm16: Int16Array,
+    options: { transferAudio?: boolean } = {}
+  ): Promise<LipSyncEngineStreamResult> {
+    if (this.ended) {
+      return Promise.reject(new Error('Stream has already ended'));
+    }
+    if (!(pcm16 instanceof Int16Array)) {
+      return Promise.reject(new TypeError('pcm16 must be an Int16Array'));
+    }
+
+    let audio = pcm16;
+    if (!(options.transferAudio && canTransfer(pcm16))) {
+      audio = this.buffers.acquire(pcm16.length);
+      audio.set(pcm16);
+    }
+    const message: WorkerRequest = {
+      type: 'streamPush',
+      id: this.id,
+      pcm16: audio,
+      returnBuffer: true,
+    };
+    return this.post(message, [audio.buffer]);
+  }
+
+  /**
+   * End the session, analyzing any remaining audio, and return the worker to the pool
+   *
+   * @returns Promise resolving to all mouth cues not returned before
+   */
+  end(): Promise<LipSyncEngineStreamResult> {
+    if (this.ended) {
+      return Promise.reject(new Error('Stream has already ended'));
+    }
+    this.ended = true;
+    const message: WorkerRequest = { type: 'streamEnd', id: this.id };
+    return this.post(message, []);
+  }
+
+  /** @internal */
+  handleMessage(message: WorkerStreamCuesResponse | WorkerAnalyzeResponse): void {
+    if (message.type === 'streamCues') {
+      if (message.returnedBuffer) {
+        this.buffers.release(message.returnedBuffer);
+      }
+      const tentativeFrom = message.tentativeFrom ?? this.tentativeCues.length;
+      if (message.tentativeCues) {
+        this.tentativeCues =
+          applyTentativeCues(this.tentativeCues, tentativeFrom, message.tentativeCues);
+      }
+      this.pending.shift()?.resolve({
+        mouthCues: message.mouthCues,
+        tentativeCues: this.tentativeCues,
+        tentativeFrom,
+        generation: message.generation,
+        fallback: message.fallback,
+        quality: message.quality,
+        realTimeFactor: message.realTimeFactor,
+        final: message.final,
+      });
+      if (message.final) {
+        this.finish();
+      }
+    } else if (message.type === 'error') {
+      // The worker has dropped the session, so the pending pushes get no response
+      this.error = new Error(message.error || 'Stream analysis failed');
+      this.ended = true;
+      this.pending.forEach(({ reject }) => reject(this.error!));
+      this.pending = [];
+      this.finish();
+    }
+  }
+
+  private post(message: WorkerRequest, transfer: Transferable[]): Promise<LipSyncEngineStreamResult> {
+    if (this.error) {
+      return Promise.reject(this.error);
+    }
+    return new Promise((resolve, reject) => {
+      this.pending.push({ resolve, reject });
+      this.worker.postMessage(message, transfer);
+    });
+  }
+
+  private finish(): void {
+    if (!this.finished) {
+      this.finished = true;
+      this.release();
+    }
+  }
+}
@@ -0,0 +1,256 @@
+/**
+ * AudioWorklet entry point for lip-sync-engine live capture
+ * This file runs in the audio rendering thread. It mixes the input down to mono and writes it to
+ * the shared ring buffer that the analysis worker reads from. With lip-sync-engine-vad.wasm, it
+ * detects voice activity too and only writes the audio around voice (see utils/captureVad.ts).
+ */
+
+import {
+  FRAME_ACTIVE,
+  FRAME_INACTIVE,
+  createVadImports,
+  getFrameStart,
+} from './utils/captureVad';
+import { SharedRingBuffer } from './utils/ringBuffer';
+
+// The AudioWorkletGlobalScope isn't part of the DOM library
+declare class AudioWorkletProcessor {
+  constructor(options?: AudioWorkletNodeOptions);
+}
+declare function registerProcessor(
+  name: string,
+  processorCtor: new (options: AudioWorkletNodeOptions) => AudioWorkletProcessor
+): void;
+declare const sampleRate: number;
+
+/** Name under which the processor is registered; `LiveCapture` creates its nodes by it */
+const CAPTURE_PROCESSOR_NAME = 'lip-sync-engine-capture';
+
+export interface CaptureProcessorOptions {
+  /** Buffer of a `SharedRingBuffer` created by the main thread */
+  ringBuffer: SharedArrayBuffer;
+  /**
+   * lip-sync-engine-vad.wasm, compiled; with `activityBuffer`, the processor detects voice
+   * activity and only writes the audio around voice to the ring buffer
+   */
+  vadModule?: WebAssembly.Module;
+  /** Buffer of a `SharedRingBuffer` for the activity of each frame */
+  activityBuffer?: SharedArrayBuffer;
+}
+
+interface VadExports {
+  memory: WebAssembly.Memory;
+  _initialize?: () => void;
+  lipsyncengine_vad_frame(): number;
+  lipsyncengine_vad_create(): number;
+  lipsyncengine_vad_process(vad: number, sampleRate: number, sampleCount: number): number;
+}
+
+/** Rates at which WebRTC detects directly; frames at other rates are decimated to 8 kHz */
+const VAD_SAMPLE_RATES = [8000, 16000, 32000, 48000];
+/**
+ * Silent frames captured before and after voice, so that the engine has the audio it pads and
+ * bridges utterances with (3 and 10 frames)
+ */
+const PRE_ROLL_FRAMES = 3;
+const HANGOVER_FRAMES = 13;
+/** Uncaptured frames are passed on at least this often, so that the engine's time keeps up */
+const FLUSH_FRAMES = 10;
+
+/**
+ * Detects the voice activity of 10 ms frames and writes those around voice to the ring buffers
+ * It allocates nothing per frame: held frames live in preallocated buffers.
+ */
+class FrameGate {
+  private readonly exports: VadExports;
+  private readonly vad: number;
+  private readonly vadFrame: Int16Array;
+  private readonly directRate: boolean;
+  private frame: Int16Array;
+  private frameLength: number;
+  private frameFill = 0;
+  private frameIndex = 0;
+  /** The silent frames held back for the pre-roll, oldest first from `heldStart` */
+  private held: Int16Array[] = [];
+  private heldLengths: number[] = [];
+  private heldStart = 0;
+  private heldCount = 0;
+  /** Frames since the last one with voice */
+  private framesSinceVoice = Infinity;
+  /** Uncaptured frames not yet written to the activity ring buffer */
+  private uncapturedCount = 0;
+  private entry = new Int16Array(1);
+
+  constructor(
+    vadModule: WebAssembly.Module,
+    private readonly ringBuffer: SharedRingBuffer,
+    private readonly activityRing: SharedRingBuffer
+  ) {
+    const instance = new WebAssembly.Instance(vadModule, createVadImports(vadModule));
+    this.exports = instance.exports as unknown as VadExports;
+    this.exports._initialize?.();
+    this.vad = this.exports.lipsyncengine_vad_create();
+    if (!this.vad) {
+      throw new Error('Failed to create the voice activity detector');
+    }
+    // The module's memory doesn't grow, so the view stays valid
+    const framePtr = this.exports.lipsyncengine_vad_frame();
+    this.vadFrame = new Int16Array(this.exports.memory.buffer, framePtr, 480);
+    this.directRate = VAD_SAMPLE_RATES.includes(sampleRate);
+
+    const maxFrameLength = Math.ceil(sampleRate / 100);
+    this.frame = new Int16Array(maxFrameLength);
+    for (let i = 0; i < PRE_ROLL_FRAMES; i++) {
+      this.held.push(new Int16Array(maxFrameLength));
+      this.heldLengths.push(0);
+    }
+    this.frameLength = getFrameStart(1, sampleRate);
+  }
+
+  /**
+   * Add float samples in [-1, 1]
+   */
+  write(input: Float32Array): void {
+    for (let i = 0; i < input.length; i++) {
+      const sample = Math.max(-1, Math.min(1, input[i]));
+      this.frame[this.frameFill++] = sample < 0 ? sample * 0x8000 : sample * 0x7fff;
+      if (this.frameFill === this.frameLength) {
+        this.endFrame();
+        this.frameIndex++;
+        this.frameLength = getFrameStart(this.frameIndex + 1, sampleRate)
+          - getFrameStart(this.frameIndex, sampleRate);
+        this.frameFill = 0;
+      }
+    }
+  }
+
+  private endFrame(): void {
+    if (this.detect()) {
+      this.framesSinceVoice = 0;
+      for (; this.heldCount > 0; this.heldCount--) {
+        const index = this.heldStart;
+        this.heldStart = (this.heldStart + 1) % PRE_ROLL_FRAMES;
+        this.capture(this.held[index], this.heldLengths[index], FRAME_INACTIVE);
+      }
+      this.capture(this.frame, this.frameLength, FRAME_ACTIVE);
+    } else if (this.framesSinceVoice < HANGOVER_FRAMES) {
+      this.framesSinceVoice++;
+      this.capture(this.frame, this.frameLength, FRAME_INACTIVE);
+    } else {
+      if (this.heldCount === PRE_ROLL_FRAMES) {
+        // The oldest held frame is too far from voice to be needed
+        this.heldStart = (this.heldStart + 1) % PRE_ROLL_FRAMES;
+        this.heldCount--;
+        this.uncapturedCount++;
+      }
+      const index = (this.heldStart + this.heldCount) % PRE_ROLL_FRAMES;
+      this.held[index].set(this.frame.subarray(0, this.frameLength));
+      this.heldLengths[index] = this.frameLength;
+      this.heldCount++;
+    }
+    if (this.uncapturedCount >= FLUSH_FRAMES) {
+      this.flushUncaptured();
+    }
+  }
+
+  private detect(): boolean {
+    if (this.directRate) {
+      this.vadFrame.set(this.frame.subarray(0, this.frameLength));
+      return this.exports.lipsyncengine_vad_process(this.vad, sampleRate, this.frameLength) === 1;
+    }
+    // Averaging each 8 kHz sample's span of input filters out most of what would alias
+    for (let i = 0; i < 80; i++) {
+      const start = Math.floor((i * this.frameLength) / 80);
+      const end = Math.floor(((i + 1) * this.frameLength) / 80);
+      let sum = 0;
+      for (let j = start; j < end; j++) {
+        sum += this.frame[j];
+      }
+      this.vadFrame[i] = sum / Math.max(end - start, 1);
+    }
+    return this.exports.lipsyncengine_vad_process(this.vad, 8000, 80) === 1;
+  }
+
+  /**
+   * Write a frame to the ring buffers, or count it as uncaptured if they are full
+   */
+  private capture(samples: Int16Array, length: number, activity: number): void {
+    this.flushUncaptured();
+    // Frames are written in order, so none may overtake uncaptured ones that didn't fit
+    if (
+      this.uncapturedCount === 0
+      && this.activityRing.getFreeCount() > 0
+      && this.ringBuffer.writeAll(samples.subarray(0, length))
+    ) {
+      this.entry[0] = activity;
+      this.activityRing.writeAll(this.entry);
+    } else {
+      this.uncapturedCount++;
+    }
+  }
+
+  private flushUncaptured(): void {
+    while (this.uncapturedCount > 0) {
+      const count = Math.min(this.uncapturedCount, 0x7fff);
+      this.entry[0] = -count;
+      if (!this.activityRing.writeAll(this.entry)) return;
+      this.uncapturedCount -= count;
+    }
+  }
+}
+
+class CaptureProcessor extends AudioWorkletProcessor {
+  private ringBuffer: SharedRingBuffer;
+  private frameGate: FrameGate | null = null;
+  private mono = new Float32Array(128);
+
+  constructor(options: AudioWorkletNodeOptions) {
+    super(options);
+    const { ringBuffer, vadModule, activityBuffer } =
+      options.processorOptions as CaptureProcessorOptions;
+    this.ringBuffer = new SharedRingBuffer(ringBuffer);
+    if (vadModule && activityBuffer) {
+      this.frameGate = new FrameGate(vadModule, this.ringBuffer, new SharedRingBuffer(activityBuffer));
+    }
+  }
+
+  process(inputs: Float32Array[][]): boolean {
+    const channels = inputs[0];
+    if (!channels || channels.length === 0) {
+      // No input connected (yet); keep the processor alive
+      return true;
+    }
+
+    if (channels.length === 1) {
+      this.writeMono(channels[0]);
+      return true;
+    }
+
+    const frameCount = channels[0].length;
+    if (this.mono.length !== frameCount) {
+      this.mono = new Float32Array(frameCount);
+    }
+    this.mono.fill(0);
+    for (const channel of channels) {
+      for (let i = 0; i < frameCount; i++) {
+        this.mono[i] += channel[i];
+      }
+    }
+    const scale = 1 / channels.length;
+    for (let i = 0; i < frameCount; i++) {
+      this.mono[i] *= scale;
+    }
+    this.writeMono(this.mono);
+    return true;
+  }
+
+  private writeMono(samples: Float32Array): void {
+    if (this.frameGate) {
+      this.frameGate.write(samples);
+    } else {
+      this.ringBuffer.write(samples);
+    }
+  }
+}
+
+registerProcessor(CAPTURE_PROCESSOR_NAME, CaptureProcessor);
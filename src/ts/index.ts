@@ -1,27 +1,66 @@
 // Main exports
 export { LipSyncEngine, analyze, analyzeAsync } from './LipSyncEngine';
+export { LipSyncEngineStream } from './LipSyncEngineStream';
+export { LiveCapture } from './LiveCapture';
+export { WorkerStream } from './WorkerStream';
 export { WasmLoader } from './WasmLoader';
 export { WorkerPool, StreamAnalyzerController } from './WorkerPool';
 
 // Utilities
 export * from './utils/AudioConverter';
+export { CompactCues, decodeCompactCues } from './utils/compactCues';
+export { CueSampler } from './utils/cueSampler';
+export type { CueSample, CueSamplerBatchOptions } from './utils/cueSampler';
+export { MemoryResultCache, IndexedDbResultCache } from './utils/resultCache';
 
 // Types
 export type {
   MouthCue,
+  TimedLabel,
   LipSyncEngineResult,
+  LipSyncEngineFrames,
+  LipSyncEngineResultCache,
+  LipSyncEngineCachedResult,
+  LipSyncEngineStage,
+  LipSyncEngineStats,
   LipSyncEngineOptions,
+  LipSyncEngineBatchClip,
+  StreamWindowOptions,
+  LipSyncEngineMemoryBudget,
+  LipSyncEngineMemoryStats,
+  LipSyncEngineTrace,
+  LipSyncEngineTraceEvent,
+  LipSyncEngineHistogram,
+  WorkerPoolMetrics,
+  LipSyncEngineModelAsset,
+  LipSyncEngineLanguageModel,
+  LipSyncEngineWarmupLevel,
+  LipSyncEngineDeviceTier,
+  LipSyncEngineStreamResult,
+  LiveCaptureOptions,
+  LipSyncEngineFileOptions,
+  LipSyncEngineTransformStreamOptions,
   LipSyncEngineModule,
   ProgressCallback,
   WasmLoaderOptions,
+  LipSyncEngineInitOptions,
 } from './types';
 
 // Worker types
 export type {
   WorkerAnalyzeRequest,
   WorkerAnalyzeResponse,
+  WorkerMouthCuesResponse,
+  WorkerConvertRequest,
+  WorkerDecodeRequest,
+  WorkerConvertResponse,
+  WorkerStreamBeginRequest,
+  WorkerStreamPushRequest,
+  WorkerStreamEndRequest,
+  WorkerStreamCuesResponse,
   WorkerInitRequest,
   WorkerInitResponse,
+  WorkerCancelRequest,
   WorkerRequest,
   WorkerResponse,
 } from './worker';
@@ -0,0 +1,91 @@
+/**
+ * worker_threads entry point of NodeWorkerPool
+ * Each worker runs its own instance of the Node.js build and analyzes one clip at a time.
+ */
+
+import { parentPort } from 'node:worker_threads';
+import { LipSyncEngine } from './LipSyncEngine';
+import { encodeMouthCues } from './utils/mouthCues';
+import type { LipSyncEngineOptions, LipSyncEngineResult, WasmLoaderOptions } from './types';
+
+export interface NodeWorkerInitRequest {
+  type: 'init';
+  options: WasmLoaderOptions;
+}
+
+export interface NodeWorkerAnalyzeRequest {
+  type: 'analyze';
+  id: number;
+  pcm16: Int16Array;
+  /** Signals and callbacks can't be posted; the pool terminates the worker to abort */
+  options: Omit<LipSyncEngineOptions, 'signal' | 'onProgress' | 'onPreview'>;
+  /** Post `NodeWorkerProgressResponse`s during the analysis */
+  reportProgress?: boolean;
+}
+
+export type NodeWorkerRequest = NodeWorkerInitRequest | NodeWorkerAnalyzeRequest;
+
+export interface NodeWorkerReadyResponse {
+  type: 'ready';
+}
+
+export interface NodeWorkerProgressResponse {
+  type: 'progress';
+  id: number;
+  progress: number;
+  remainingMs: number;
+}
+
+export interface NodeWorkerAnalyzeResponse {
+  type: 'result' | 'error';
+  /** Missing for a failed initialization */
+  id?: number;
+  /** The result without `mouthCues`, which are in `packedMouthCues` (transferred) */
+  result?: Omit<LipSyncEngineResult, 'mouthCues'>;
+  error?: string;
+}
+
+export type NodeWorkerResponse =
+  | NodeWorkerReadyResponse
+  | NodeWorkerProgressResponse
+  | NodeWorkerAnalyzeResponse;
+
+const port = parentPort;
+if (!port) {
+  throw new Error('node-worker must run in a worker thread');
+}
+
+const post = (response: NodeWorkerResponse) => port.postMessage(response);
+const engine = LipSyncEngine.getInstance();
+
+port.on('message', async (request: NodeWorkerRequest) => {
+  if (request.type === 'init') {
+    try {
+      await engine.init(request.options);
+      post({ type: 'ready' });
+    } catch (error) {
+      post({ type: 'error', error: error instanceof Error ? error.message : String(error) });
+    }
+    return;
+  }
+
+  const { id, pcm16, options, reportProgress } = request;
+  try {
+    const result = await engine.analyze(pcm16, {
+      ...options,
+      onProgress: reportProgress
+        ? (progress, remainingMs) => post({ type: 'progress', id, progress, remainingMs })
+        : undefined,
+    });
+    const { mouthCues, ...rest } = result;
+    const packedMouthCues = encodeMouthCues(mouthCues);
+    const response: NodeWorkerAnalyzeResponse = {
+      type: 'result',
+      id,
+      result: { ...rest, packedMouthCues },
+    };
+    port.postMessage(response, [packedMouthCues.buffer]);
+  } catch (error) {
+    post({ type: 'error', id, error: error instanceof Error ? error.message : String(error) });
+  }
+});
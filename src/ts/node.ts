@@ -0,0 +1,9 @@
+/**
+ * Node.js entry point (lip-sync-engine/node)
+ * The API of the main entry point, loading the Node.js build, which reads the models from the
+ * host file system, plus a pool of worker threads for parallel analyses.
+ */
+
+export * from './index';
+export { NodeWorkerPool } from './NodeWorkerPool';
+export type { NodeWorkerPoolOptions } from './NodeWorkerPool';
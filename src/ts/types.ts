@@ -10,12 +10,84 @@ export interface MouthCue {
   value: string;
 }
 
+/**
+ * A recognized word or phone with its timing, see `LipSyncEngineOptions.includeTimings`
+ */
+export interface TimedLabel {
+  /** Start time in seconds */
+  start: number;
+  /** End time in seconds */
+  end: number;
+  /** The word in lowercase, or the phone, e.g. 'AA', 'Schwa' or 'Noise' */
+  value: string;
+}
+
+/**
+ * Stage of an analysis whose duration is measured
+ * The animation passes run from `shapeRules` to `targetShapeConversion`.
+ */
+export type LipSyncEngineStage =
+  | 'dcRemoval'
+  | 'resampling'
+  | 'voiceActivityDetection'
+  | 'featureExtraction'
+  | 'wordRecognition'
+  | 'alignment'
+  | 'shapeRules'
+  | 'roughAnimation'
+  | 'timingOptimization'
+  | 'pauseAnimation'
+  | 'tweening'
+  | 'targetShapeConversion'
+  | 'export';
+
+/**
+ * Timing and counters of an analysis, collected with `LipSyncEngineOptions.collectStats`
+ */
+export interface LipSyncEngineStats {
+  /**
+   * Milliseconds spent in each stage, summed over all threads
+   * `resampling` includes applying the DC offset; `wordRecognition` is phone recognition for the
+   * `'phonetic'` recognizer.
+   */
+  stages: Record<LipSyncEngineStage, number>;
+  /** Wall time of the whole analysis in milliseconds */
+  totalMs: number;
+  /** Utterances found by voice activity detection */
+  utteranceCount: number;
+  /** Cepstral frames searched by recognition, 100 per second of utterance audio */
+  frameCount: number;
+  /** HMMs evaluated by recognition per frame */
+  hmmEvaluationsPerFrame: number;
+  /** Decoders reused from earlier analyses */
+  decoderCacheHits: number;
+  /** Decoders created, each costing hundreds of milliseconds and tens of megabytes */
+  decoderCacheMisses: number;
+  /** Dialog language models reused from earlier analyses */
+  dialogModelCacheHits: number;
+  /** Dialog language models built */
+  dialogModelCacheMisses: number;
+  /**
+   * Utterances whose phones were reused from earlier analyses of the same audio and dialog, such
+   * as the unchanged parts of an edited recording
+   */
+  utteranceCacheHits: number;
+  /** Utterances recognized */
+  utteranceCacheMisses: number;
+}
+
 /**
  * Result of lip-sync-engine analysis
  */
 export interface LipSyncEngineResult {
   /** Array of mouth cues with precise timing */
   mouthCues: MouthCue[];
+  /**
+   * The cues in the engine's binary format, if the result was analyzed in a `WorkerPool` worker:
+   * start and end in centiseconds and the shape index (0-8 for A-H and X) per cue
+   * `mouthCues` is then decoded from this on first access.
+   */
+  packedMouthCues?: Int32Array;
   /** Optional metadata about the analysis */
   metadata?: {
     /** Duration of analyzed audio in seconds */
@@ -25,6 +97,67 @@ export interface LipSyncEngineResult {
     /** Dialog text used for analysis (if provided) */
     dialogText?: string;
   };
+  /**
+   * Timing and counters, if requested by `collectStats`
+   * For a batch, every result shares the stats of the whole batch.
+   */
+  stats?: LipSyncEngineStats;
+  /** The mouth shapes resampled at a fixed frame rate, if requested by `frameRate` */
+  frames?: LipSyncEngineFrames;
+  /**
+   * The recognized words ordered by time, without silence and noises, if requested by
+   * `includeTimings`; empty for recognizers other than `'pocketSphinx'`
+   */
+  words?: TimedLabel[];
+  /**
+   * The aligned phones the mouth cues were animated from, ordered by time and without silence, if
+   * requested by `includeTimings`
+   */
+  phones?: TimedLabel[];
+  /**
+   * The speaker profile updated by the analysis, if `speakerProfile` was given
+   * Pass it as `speakerProfile` to the next analysis of the same speaker, or store it to
+   * warm-start a later session.
+   */
+  speakerProfile?: Uint8Array;
+}
+
+/**
+ * Mouth shapes resampled at a fixed frame rate, one byte per frame
+ * The arrays can be uploaded to a renderer as they are, e.g. as textures or vertex attributes.
+ */
+export interface LipSyncEngineFrames {
+  /** Frames per second; frame i starts at i / frameRate seconds */
+  frameRate: number;
+  /** The mouth shape at the start of each frame: 0-8 for A-H and X */
+  shapes: Uint8Array;
+  /**
+   * The shape the mouth changes to within each frame, or the frame's own shape, if requested by
+   * `frameBlending`
+   */
+  blendShapes?: Uint8Array;
+  /** The fraction of each frame covered by its blend shape, if requested by `frameBlending` */
+  blendWeights?: Float32Array;
+}
+
+/**
+ * Storage of analysis results by a key of their audio and options, see `WorkerPool.init()`
+ * `MemoryResultCache` and `IndexedDbResultCache` implement it; other backends, such as a server,
+ * can too. Failing calls count as misses.
+ */
+export interface LipSyncEngineResultCache {
+  /** The result stored for the key, if any */
+  get(key: string): Promise<LipSyncEngineCachedResult | undefined> | LipSyncEngineCachedResult | undefined;
+  /** Store a result for the key */
+  set(key: string, result: LipSyncEngineCachedResult): Promise<void> | void;
+}
+
+/**
+ * A result as stored by a `LipSyncEngineResultCache`
+ */
+export interface LipSyncEngineCachedResult {
+  /** The cues in the binary format, see `LipSyncEngineResult.packedMouthCues` */
+  packedMouthCues: Int32Array;
 }
 
 /**
@@ -43,12 +176,546 @@ export interface LipSyncEngineOptions {
    * @recommended 16000 for best PocketSphinx results
    */
   sampleRate?: number;
+
+  /**
+   * Maximum number of threads for recognizing the utterances of one clip
+   * Only takes effect with the multithreaded build (see `WasmLoaderOptions.threads`);
+   * capped at its worker pool size. Ignored by streaming sessions.
+   * @default 1
+   */
+  threadCount?: number;
+
+  /**
+   * Extended mouth shapes to use in addition to the basic shapes A-F, such as 'GHX'
+   * Shapes left out are replaced by similar basic shapes: G and X by A, H by C.
+   * @default ''
+   */
+  extendedShapes?: string;
+
+  /**
+   * Speech recognizer
+   * - `'pocketSphinx'`: recognizes words, then aligns their phones; uses `dialogText`
+   * - `'phonetic'`: recognizes phones directly; several times faster and needs far less memory,
+   *   but less accurate. Suited for real-time previews. Ignores `dialogText`.
+   * - `'classifier'`: classifies each frame into phones that look alike, without any search; several
+   *   times faster than `'phonetic'` and needs only the acoustic model, but only the mouth shapes
+   *   are reliable. Suited for ambient dialog. Ignores `dialogText`.
+   * @default 'pocketSphinx'
+   */
+  recognizer?: 'pocketSphinx' | 'phonetic' | 'classifier';
+
+  /**
+   * Decoder profile of the `'pocketSphinx'` recognizer, trading accuracy for speed
+   * - `'offline'`: full search, for offline rendering
+   * - `'offlineOneBest'`: `'offline'` without rescoring a word lattice at the end of each utterance
+   * - `'balanced'`: tighter beams without the second search pass
+   * - `'realtime'`: narrow beams and a single search pass, for live audio
+   * - `'realtimeDownsampled'`: `'realtime'` with word recognition scoring the audio at half the
+   *   frame rate; the phones are still aligned at the full rate, which keeps the mouth timing
+   * - `'streaming'`: `'realtime'` normalizing the audio with the mean of the speech heard so far
+   *   rather than of each whole utterance, so that streams recognize utterances while they are
+   *   spoken and deliver their mouth cues sooner after they end
+   * Each profile keeps its own decoders, so alternating between profiles costs memory.
+   * @default 'offline'
+   */
+  profile?: 'offline' | 'offlineOneBest' | 'balanced' | 'realtime' | 'realtimeDownsampled' | 'streaming';
+
+  /**
+   * How `dialogText` constrains the `'pocketSphinx'` recognizer
+   * - `'biased'`: the dialog's words are favored, but any word can be recognized
+   * - `'strict'`: only the dialog's words are recognized; decoding scripted lines gets several
+   *   times faster, but words missing from the dialog text are recognized as dialog words
+   * - `'verbatim'`: the dialog is taken as spoken and aligned with the audio, skipping word
+   *   recognition; utterances the dialog doesn't fit are recognized like biased ones
+   * Like a profile, strict and verbatim decoding keep their own decoders.
+   * @default 'biased'
+   */
+  dialogMode?: 'biased' | 'strict' | 'verbatim';
+
+  /**
+   * Collect the time spent in each stage and other counters, returned as `result.stats`
+   * Costs next to nothing. Ignored by streaming sessions.
+   * @default false
+   */
+  collectStats?: boolean;
+
+  /**
+   * Return the recognized words and phones with their timing as `result.words` and
+   * `result.phones`, e.g. for subtitles, so that they needn't be recognized a second time
+   * A `WorkerPool` neither splits the job into pieces nor looks it up in its result cache.
+   * Ignored by `analyzeBatch()` and streaming sessions.
+   * @default false
+   */
+  includeTimings?: boolean;
+
+  /**
+   * Abort the analysis, rejecting its promise with the signal's reason
+   * A queued analysis never starts. A running one stops soon after (between utterances, every
+   * 100 frames of recognition and between animation passes) if it runs in a `WorkerPool` worker
+   * with shared memory (the multithreaded build); otherwise its result is discarded. The worker
+   * and its models survive either way. Ignored by streaming sessions.
+   */
+  signal?: AbortSignal;
+
+  /**
+   * Fail the analysis with a timeout error once it has run this many milliseconds
+   * Checked like an aborted `signal`, so the analysis stops soon after. Ignored by streaming
+   * sessions.
+   */
+  timeoutMs?: number;
+
+  /**
+   * Keep the recognition of a streaming session under this many seconds per second of speech,
+   * e.g. 0.5, by moving to cheaper recognition while it is slower
+   * The session steps from its own profile to `'realtime'`, `'realtimeDownsampled'`, the
+   * `'phonetic'` recognizer, the `'classifier'` recognizer and finally loudness alone, skipping the
+   * levels that aren't cheaper than its options, and returns to better levels once recognition has
+   * been well within the limit for a while. Results report the level as `quality`. Each profile
+   * keeps its own decoders, so stepping down costs memory, and the WASM builds also load the
+   * `'phoneLanguageModel'`. Only used by streaming sessions.
+   */
+  maxRealTimeFactor?: number;
+
+  /**
+   * Called with the progress of the analysis, from 0 to 1, as it grows by at least 1%, and the
+   * estimated milliseconds remaining
+   * Combines voice activity detection and recognition, weighted by their cost as measured in
+   * earlier analyses with the same recognizer and profile, so it grows about evenly over time; 1 is
+   * reported once the analysis has succeeded. On the main thread, the callback runs during the
+   * analysis; in a `WorkerPool`, the worker posts the progress at most every 100 ms.
+   * Ignored by streaming sessions.
+   */
+  onProgress?: ProgressCallback;
+
+  /**
+   * Called with mouth cues as soon as they are final: after each utterance is recognized and no
+   * later utterance can change them, in seconds from the start
+   * Together, the cues of all calls make up `LipSyncEngineResult.mouthCues`, except that a cue may
+   * be split between two calls. On the main thread, the callback runs during the analysis; in a
+   * `WorkerPool`, the worker posts the cues as they come, and the job isn't split into pieces.
+   * Ignored by `analyzeBatch()` and streaming sessions.
+   */
+  onMouthCues?: (mouthCues: MouthCue[]) => void;
+
+  /**
+   * Called once before speech is recognized with a preview of the mouth cues, guessed from the
+   * loudness of the audio alone within milliseconds, in seconds from the start
+   * An editor can show the preview at once and replace it with the result of full recognition
+   * once the analysis resolves. A `WorkerPool` doesn't split the job into pieces.
+   * Ignored by `analyzeBatch()`, `NodeWorkerPool` and streaming sessions.
+   */
+  onPreview?: (mouthCues: MouthCue[]) => void;
+
+  /**
+   * What earlier analyses learned about the speaker, as returned in
+   * `LipSyncEngineResult.speakerProfile`; an empty array starts a new profile
+   * The analysis starts from the speaker's cepstral mean, which normalizes short utterances better
+   * than their own, and from the background noise voice activity detection adapted to, and
+   * returns the updated profile. The same audio may then be animated slightly differently. A
+   * `WorkerPool` neither splits the job into pieces nor uses its result cache.
+   * Ignored by `analyzeBatch()` and streaming sessions.
+   */
+  speakerProfile?: Uint8Array;
+
+  /**
+   * Scheduling class of the analysis in a `WorkerPool`
+   * Interactive jobs run before batch jobs, and batch jobs leave one worker free for them (if
+   * the pool may have more than one). Batch jobs of more than 30 seconds are split at quiet
+   * points into pieces queued separately, so interactive jobs can run in between.
+   * Ignored outside a `WorkerPool`.
+   * @default 'interactive'
+   */
+  priority?: 'interactive' | 'batch';
+
+  /**
+   * Milliseconds from submission by which the result is wanted
+   * Among queued jobs of the same priority, the one with the earliest deadline runs first; jobs
+   * without a deadline run last, in order of submission. A missed deadline doesn't cancel the job.
+   * Ignored outside a `WorkerPool`.
+   */
+  deadlineMs?: number;
+
+  /**
+   * Hand the audio buffer over to the `WorkerPool` worker instead of copying it
+   * The Int16Array (and its ArrayBuffer) is detached afterwards and must not be used again. Audio
+   * that doesn't cover its whole ArrayBuffer, shared memory and batch clips split into pieces
+   * are still copied. Ignored outside a `WorkerPool`.
+   * @default false
+   */
+  transferAudio?: boolean;
+
+  /**
+   * Also resample the mouth shapes at this frame rate, such as a video's 24, 30 or 60 fps,
+   * returned as `result.frames`
+   * Computed by the engine from its binary cues, so renderers that show one shape per frame
+   * needn't convert the cues themselves. Ignored by streaming sessions.
+   */
+  frameRate?: number;
+
+  /**
+   * Also return the shape each frame changes to and the fraction of the frame it covers, for
+   * renderers that blend between adjacent shapes. Requires `frameRate`.
+   * @default false
+   */
+  frameBlending?: boolean;
+}
+
+/**
+ * Limit on the heap memory of a WASM module, see `LipSyncEngine.setMemoryBudget()`
+ */
+export interface LipSyncEngineMemoryBudget {
+  /** Maximum heap usage in bytes */
+  bytes: number;
+  /**
+   * What an analysis does when it would exceed the budget: fail with an error, or use the
+   * `'phonetic'` recognizer instead if that fits
+   * @default 'fail'
+   */
+  onExceeded?: 'fail' | 'phonetic';
+}
+
+/**
+ * Heap usage of a WASM module, returned by `LipSyncEngine.getMemoryStats()`
+ */
+export interface LipSyncEngineMemoryStats {
+  /** Bytes allocated and not yet freed */
+  heapBytes: number;
+  /** High-water mark of the memory taken by the allocator, including free blocks */
+  peakHeapBytes: number;
+  /** Size of the WebAssembly memory, which grows as needed and never shrinks */
+  memorySizeBytes: number;
+  /** Size of the model files, held by the virtual file system */
+  modelBytes: number;
+  /** Decoders in existence, each keeping its own copy of the acoustic model */
+  decoderCount: number;
+  /** The budget in bytes, or 0 for none */
+  memoryBudgetBytes: number;
+}
+
+/**
+ * A distribution of durations in `WorkerPoolMetrics`, in milliseconds
+ */
+export interface LipSyncEngineHistogram {
+  count: number;
+  sum: number;
+  min: number;
+  max: number;
+  /** Percentiles, as the upper bounds of the buckets they fall in (at most `max`) */
+  p50: number;
+  p90: number;
+  p99: number;
+  /** Durations above the previous bucket's bound and at most `le`; the last bound is Infinity */
+  buckets: { le: number; count: number }[];
+}
+
+/**
+ * Live metrics of a `WorkerPool`, returned by `getMetrics()` and passed to `onMetrics()` listeners
+ * Counts and durations cover the period since the pool was initialized or `resetMetrics()` was
+ * called; the cache counters are summed over the analyses of all workers.
+ */
+export interface WorkerPoolMetrics {
+  /** performance.now() of the snapshot */
+  timestamp: number;
+  /** Milliseconds the metrics cover */
+  periodMs: number;
+  /** Jobs waiting for a worker */
+  queueLength: number;
+  totalWorkers: number;
+  busyWorkers: number;
+  /** Jobs completed, including failed ones */
+  completedJobs: number;
+  /** Jobs that failed in their worker */
+  failedJobs: number;
+  /** Time from queueing each job until a worker took it */
+  waitMs: LipSyncEngineHistogram;
+  /** Time from sending each job to its worker until the result came back */
+  serviceMs: LipSyncEngineHistogram;
+  /** Share of the workers' time spent running jobs or live captures, from 0 to 1 */
+  utilization: number;
+  /** Time from creating each worker until its engine was ready */
+  workerInitMs: LipSyncEngineHistogram;
+  /** Bytes of audio posted to workers */
+  bytesToWorkers: number;
+  /** Bytes of results posted back: cues, frames, speaker profiles and converted audio */
+  bytesFromWorkers: number;
+  /** Analyses handed to workers through job channels in shared memory instead of messages */
+  channelJobs: number;
+  decoderCacheHits: number;
+  decoderCacheMisses: number;
+  dialogModelCacheHits: number;
+  dialogModelCacheMisses: number;
+  utteranceCacheHits: number;
+  utteranceCacheMisses: number;
+  /** `analyze()` calls answered from the result cache */
+  resultCacheHits: number;
+  /** `analyze()` calls that looked up the result cache in vain */
+  resultCacheMisses: number;
+}
+
+/**
+ * An event of Chrome's trace event format, as returned by `LipSyncEngine.takeTrace()`
+ */
+export interface LipSyncEngineTraceEvent {
+  name: string;
+  /** Category: 'stage' for analysis stages, 'recognition' for decoders and language models, 'pool' for jobs */
+  cat?: string;
+  /** Phase: 'X' for a complete span, 'b' and 'e' for the start and end of an async span, 'M' for metadata */
+  ph: string;
+  /** Start in microseconds since the Unix epoch */
+  ts?: number;
+  /** Duration of complete spans in microseconds */
+  dur?: number;
+  pid: number;
+  tid?: number;
+  /** Pairs async events */
+  id?: number;
+  args?: Record<string, number | string>;
+}
+
+/**
+ * A trace that chrome://tracing and Perfetto (ui.perfetto.dev) open once saved as JSON
+ */
+export interface LipSyncEngineTrace {
+  traceEvents: LipSyncEngineTraceEvent[];
+}
+
+/**
+ * How `WorkerPool.createStreamAnalyzer()` cuts the stream into windows
+ * Each window is analyzed by its own worker. Windows overlap, so that the recognizer has context
+ * on both sides of each cut, and the cuts are moved to the quietest point near the end of the
+ * audio added so far.
+ */
+export interface StreamWindowOptions {
+  /**
+   * Audio on each side of a cut that the windows on both sides analyze, in milliseconds
+   * @default 500
+   */
+  overlapMs?: number;
+  /**
+   * How far a cut may move back from the latest possible point into a quieter place, in milliseconds
+   * @default 1000
+   */
+  searchMs?: number;
+  /**
+   * Audio queued for analysis but not yet analyzed above which `write()` and `ready` wait, in
+   * milliseconds, so that a producer faster than the workers slows down instead of piling up
+   * copies of its audio
+   * @default 60000
+   */
+  maxPendingMs?: number;
+}
+
+/**
+ * A clip to be analyzed by `LipSyncEngine.analyzeBatch()`
+ */
+export interface LipSyncEngineBatchClip {
+  /** 16-bit PCM audio buffer (mono) */
+  pcm16: Int16Array;
+  /**
+   * Optional dialog text for improved recognition accuracy
+   * Clips with identical dialog text share its language model
+   */
+  dialogText?: string;
+  /**
+   * Sample rate of the audio buffer
+   * @default 16000
+   */
+  sampleRate?: number;
+}
+
+/**
+ * Options of `LipSyncEngine.createTransformStream()` and `WorkerPool.createTransformStream()`
+ */
+export interface LipSyncEngineTransformStreamOptions
+  extends Omit<
+    LipSyncEngineOptions,
+    | 'signal'
+    | 'onProgress'
+    | 'onMouthCues'
+    | 'onPreview'
+    | 'priority'
+    | 'deadlineMs'
+    | 'transferAudio'
+  > {
+  /**
+   * Called when the provisional cues following the finalized ones change; each call replaces the
+   * cues of the previous one (see `LipSyncEngineStreamResult.tentativeCues`), of which the cues
+   * before `from` are kept
+   */
+  onTentativeCues?: (tentativeCues: MouthCue[], from: number) => void;
+}
+
+/**
+ * Options of `WorkerPool.analyzeFile()`
+ * The file is analyzed at its own sample rate.
+ */
+export interface LipSyncEngineFileOptions
+  extends Omit<
+    LipSyncEngineOptions,
+    | 'sampleRate'
+    | 'onProgress'
+    | 'onPreview'
+    | 'priority'
+    | 'deadlineMs'
+    | 'transferAudio'
+  > {
+  /**
+   * Called when the provisional cues following the finalized ones change; each call replaces the
+   * cues of the previous one (see `LipSyncEngineStreamResult.tentativeCues`), of which the cues
+   * before `from` are kept
+   */
+  onTentativeCues?: (tentativeCues: MouthCue[], from: number) => void;
+}
+
+/**
+ * Options of live capture with `WorkerPool.startLiveCapture()`
+ * The audio is analyzed at the sample rate of the audio context.
+ */
+export interface LiveCaptureOptions
+  extends Omit<
+    LipSyncEngineOptions,
+    | 'sampleRate'
+    | 'signal'
+    | 'onProgress'
+    | 'onMouthCues'
+    | 'onPreview'
+    | 'priority'
+    | 'deadlineMs'
+    | 'transferAudio'
+  > {
+  /** Called with the mouth cues finalized since the previous call, in seconds from the start */
+  onMouthCues?: (mouthCues: MouthCue[]) => void;
+  /**
+   * Called when the provisional cues following the finalized ones change; each call replaces the
+   * cues of the previous one (see `LipSyncEngineStreamResult.tentativeCues`), of which the cues
+   * before `from` are kept
+   */
+  onTentativeCues?: (tentativeCues: MouthCue[], from: number) => void;
+  /** Called if the analysis fails; the capture has stopped by then */
+  onError?: (error: Error) => void;
+  /** Context to capture in; a new one is created (and closed by `stop()`) if omitted */
+  audioContext?: AudioContext;
+  /**
+   * URL of the capture worklet script (dist/capture-worklet.js)
+   * @default The pool's `workletScriptUrl`
+   */
+  workletUrl?: string;
+  /**
+   * How often the worker moves captured audio to the engine, in milliseconds
+   * @default 20
+   */
+  pollIntervalMs?: number;
+  /**
+   * Audio the ring buffer holds while the worker is busy recognizing, in milliseconds
+   * Audio captured beyond that is dropped.
+   * @default 5000
+   */
+  bufferMs?: number;
+  /**
+   * Detect voice activity in the capture worklet, with lip-sync-engine-vad.wasm from the
+   * directory of the pool's `wasmPath`, so that only the audio around voice reaches the worker
+   * and the engine skips its own detection. If the module can't be loaded, the engine detects
+   * voice activity as without it.
+   * @default true
+   */
+  workletVad?: boolean;
+}
+
+/**
+ * Mouth cues finalized by a streaming session
+ */
+export interface LipSyncEngineStreamResult {
+  /** Cues finalized since the previous result; they never change afterwards */
+  mouthCues: MouthCue[];
+  /**
+   * Provisional cues following all finalized ones, animated from what has been recognized so far.
+   * They replace the tentative cues of the previous result. With the `'streaming'` profile, they
+   * include guesses for the utterance still being spoken. Empty in the last result.
+   */
+  tentativeCues: MouthCue[];
+  /**
+   * Index of the first of `tentativeCues` that differs from the tentative cues of the previous
+   * result; the cues before it are the same. A renderer holding the previous cues only has to
+   * replace those from this index on. Equal to the length of `tentativeCues` if they didn't
+   * change, or if they only lost cues at the end.
+   */
+  tentativeFrom: number;
+  /**
+   * Counts the results whose finalized or tentative cues changed, from 1 for the first. A renderer
+   * that applied the result of the previous generation can apply this one's cues as a delta;
+   * otherwise, e.g. if results were handled out of order, it has missed a change.
+   */
+  generation: number;
+  /**
+   * True while the stream's utterances are animated from their loudness alone, because the open
+   * streams speak more than the module's threads can recognize in real time
+   */
+  fallback: boolean;
+  /**
+   * The recognition the stream currently uses: its profile, `'phonetic'` or `'classifier'`, or
+   * `'loudness'`; only changes with `maxRealTimeFactor`
+   */
+  quality: string;
+  /**
+   * Seconds of recognition per second of speech measured at the current `quality`, smoothed over
+   * recent utterances; 0 until measured or without `maxRealTimeFactor`
+   */
+  realTimeFactor: number;
+  /** True once the stream has ended and all cues have been returned */
+  final: boolean;
 }
 
+/**
+ * A model asset fetched separately by the WASM builds
+ * - `'acousticModel'`: needed by all recognizers, about 6.6 MB
+ * - `'dictionary'`: pronunciations of the `'pocketSphinx'` recognizer, about 3.3 MB, or those of
+ *   the vocabulary pack (see `LipSyncEngineLanguageModel`)
+ * - `'languageModel'`: language model of the `'pocketSphinx'` recognizer, about 27 MB, or
+ *   7.2 MB for the small one, or that of the vocabulary pack
+ * - `'phoneLanguageModel'`: phone language model of the `'phonetic'` recognizer, about 0.9 MB
+ */
+export type LipSyncEngineModelAsset =
+  | 'acousticModel'
+  | 'dictionary'
+  | 'languageModel'
+  | 'phoneLanguageModel';
+
+/**
+ * Variant of the language model of the `'pocketSphinx'` recognizer
+ * - `'full'`: the language model distributed with PocketSphinx
+ * - `'small'`: a pruned copy generated at build time, about a quarter of the download and memory
+ *   size of the full one, for memory-constrained clients such as mobile browsers. On the
+ *   benchmark corpus, the animation matches that of the full model 86 to 93% of the time without
+ *   dialog text and 99% with it.
+ * - `'vocabulary'`: a vocabulary pack generated for a project's dialog lines with
+ *   lip-sync-engine-vocabulary-pack (`vocabulary.lm.bin` and `vocabulary.dict.bin` in the models
+ *   directory), which also replaces the dictionary. Only the pack's words are recognized.
+ */
+export type LipSyncEngineLanguageModel = 'full' | 'small' | 'vocabulary';
+
+/**
+ * How much of the first analysis `warmup()` does ahead of time
+ * - `'decoders'`: create the decoders, as `prewarm()` does
+ * - `'full'`: also analyze a second of synthetic speech with a dialog, which touches the models'
+ *   memory, fills the dictionary caches, sets up the text tokenizer and lets the JIT compile the
+ *   code of every stage
+ */
+export type LipSyncEngineWarmupLevel = 'decoders' | 'full';
+
+/**
+ * Performance tier of the device, which selects the build to load by default
+ * - `'standard'`: the floating-point builds
+ * - `'low'`: the fixed-point build (lip-sync-engine-fixed), which computes the audio features and
+ *   acoustic scores in integer arithmetic, for low-end mobile devices. It is single-threaded.
+ */
+export type LipSyncEngineDeviceTier = 'standard' | 'low';
+
 /**
  * Progress callback for analysis
+ * @param progress - Progress from 0 to 1
+ * @param remainingMs - Estimated milliseconds until the analysis completes
  */
-export type ProgressCallback = (progress: number) => void;
+export type ProgressCallback = (progress: number, remainingMs: number) => void;
 
 /**
  * WASM module interface (internal)
@@ -57,19 +724,183 @@ export interface LipSyncEngineModule {
   _malloc(size: number): number;
   _free(ptr: number): void;
   _lipsyncengine_init(modelsPathPtr: number): number;
+  _lipsyncengine_create(): number;
+  _lipsyncengine_select(engine: number): number;
+  _lipsyncengine_destroy(engine: number): number;
+  _lipsyncengine_speaker_create(profilePtr: number, byteCount: number): number;
+  _lipsyncengine_speaker_save(speaker: number, byteCountPtr: number): number;
+  _lipsyncengine_speaker_release(speaker: number): number;
   _lipsyncengine_analyze_pcm16(
     pcm16Ptr: number,
     sampleCount: number,
     sampleRate: number,
-    dialogPtr: number
+    dialogPtr: number,
+    optionsPtr: number
+  ): number;
+  _lipsyncengine_analyze_pcm16_binary(
+    pcm16Ptr: number,
+    sampleCount: number,
+    sampleRate: number,
+    dialogPtr: number,
+    optionsPtr: number,
+    cueCountPtr: number
+  ): number;
+  _lipsyncengine_analyze_f32(
+    samplesPtr: number,
+    sampleCount: number,
+    sampleRate: number,
+    dialogPtr: number,
+    optionsPtr: number,
+    cueCountPtr: number
+  ): number;
+  _lipsyncengine_analyze_f32_interleaved(
+    samplesPtr: number,
+    frameCount: number,
+    channelCount: number,
+    sampleRate: number,
+    dialogPtr: number,
+    optionsPtr: number,
+    cueCountPtr: number
+  ): number;
+  _lipsyncengine_convert_f32(
+    samplesPtr: number,
+    frameCount: number,
+    channelCount: number,
+    sampleRate: number,
+    targetSampleRate: number,
+    sampleCountPtr: number
+  ): number;
+  _lipsyncengine_decode_wav(
+    bytesPtr: number,
+    byteCount: number,
+    targetSampleRate: number,
+    sampleCountPtr: number
+  ): number;
+  _lipsyncengine_analyze_batch(
+    clipsPtr: number,
+    clipCount: number,
+    optionsPtr: number,
+    cueCountsPtr: number
+  ): number;
+  _lipsyncengine_analyze_begin(
+    pcm16Ptr: number,
+    sampleCount: number,
+    sampleRate: number,
+    dialogPtr: number,
+    optionsPtr: number
+  ): number;
+  _lipsyncengine_analyze_step(analysis: number, budgetMilliseconds: number): number;
+  _lipsyncengine_analyze_finish(analysis: number, cueCountPtr: number): number;
+  _lipsyncengine_analyze_abort(analysis: number): number;
+  _lipsyncengine_recognize_pcm16(
+    pcm16Ptr: number,
+    sampleCount: number,
+    sampleRate: number,
+    dialogPtr: number,
+    optionsPtr: number,
+    byteCountPtr: number
+  ): number;
+  _lipsyncengine_animate(
+    phonesPtr: number,
+    byteCount: number,
+    optionsPtr: number,
+    cueCountPtr: number
   ): number;
   _lipsyncengine_free(ptr: number): void;
   _lipsyncengine_get_last_error(): number;
+  _lipsyncengine_set_max_thread_count(maxThreadCount: number): number;
+  /** 1 for the JSPI build, whose analysis functions return Promises of their results */
+  _lipsyncengine_can_yield(): number;
+  /** Score on the GPU with `lipsyncengineGpuScorer`; -1 unless the build can (JSPI) */
+  _lipsyncengine_set_gpu_scoring(enabled: number): number;
+  _lipsyncengine_estimate_milliseconds(
+    sampleCount: number,
+    sampleRate: number,
+    optionsPtr: number
+  ): number;
+  _lipsyncengine_prewarm(decoderCount: number, optionsPtr: number): number;
+  _lipsyncengine_warmup(level: number, optionsPtr: number): number;
   _lipsyncengine_cleanup(): void; // Phase 0: Decoder cleanup
+  _lipsyncengine_release_caches(): number;
+  _lipsyncengine_reserve_input(byteLength: number): number;
+  _lipsyncengine_reuse_output(enabled: number): void;
+  _lipsyncengine_sample_frames(
+    cuesPtr: number,
+    cueCount: number,
+    frameRate: number,
+    blend: number,
+    framesPtr: number
+  ): number;
+  _lipsyncengine_stream_begin(
+    sampleRate: number,
+    dialogPtr: number,
+    optionsPtr: number
+  ): number;
+  _lipsyncengine_stream_push(
+    stream: number,
+    pcm16Ptr: number,
+    sampleCount: number
+  ): number;
+  _lipsyncengine_stream_push_activity(
+    stream: number,
+    pcm16Ptr: number,
+    sampleCount: number,
+    frameActivityPtr: number,
+    frameCount: number
+  ): number;
+  _lipsyncengine_stream_poll(stream: number): number;
+  _lipsyncengine_stream_end(stream: number): number;
+  _lipsyncengine_stream_save(stream: number, byteCountPtr: number): number;
+  _lipsyncengine_stream_restore(
+    statePtr: number,
+    byteCount: number,
+    optionsPtr: number
+  ): number;
+  _lipsyncengine_stream_abort(stream: number): number;
+  _lipsyncengine_get_memory_stats(statsPtr: number): number;
+  _lipsyncengine_set_memory_budget(budgetBytes: number, policy: number): number;
+  _lipsyncengine_set_language_model(languageModel: number): number;
+  _lipsyncengine_page_language_model(
+    languageModel: number,
+    headPtr: number,
+    headSize: number,
+    layoutPtr: number
+  ): number;
+  _lipsyncengine_language_model_page(languageModel: number, index: number): number;
+  _lipsyncengine_set_language_model_page_loaded(languageModel: number, index: number): number;
+  _lipsyncengine_next_language_model_page(languageModel: number): number;
+  _lipsyncengine_set_tracing(enabled: number): void;
+  _lipsyncengine_trace_clock(): number;
+  _lipsyncengine_take_trace(processId: number, clockOffsetMicroseconds: number): number;
+  HEAPU8: Uint8Array;
   HEAP16: Int16Array;
+  HEAP32: Int32Array;
+  HEAPF32: Float32Array;
+  HEAPF64: Float64Array;
+  addFunction(func: (...args: number[]) => void, signature: string): number;
+  removeFunction(ptr: number): void;
   lengthBytesUTF8(str: string): number;
   stringToUTF8(str: string, ptr: number, maxLen: number): void;
   UTF8ToString(ptr: number): string;
+  FS: {
+    open(path: string, flags: string): unknown;
+    write(
+      stream: unknown,
+      buffer: Uint8Array,
+      offset: number,
+      length: number,
+      position?: number,
+      canOwn?: boolean
+    ): number;
+    close(stream: unknown): void;
+    rename(oldPath: string, newPath: string): void;
+    unlink(path: string): void;
+    mkdirTree(path: string): void;
+  };
+  /** Scores blocks of frames on the GPU once installed, see `utils/gpuScoring.ts` */
+  lipsyncengineGpuScorer?: {
+    evaluateBlock(module: LipSyncEngineModule, requestPtr: number): Promise<number>;
+  };
 }
 
 /**
@@ -78,8 +909,95 @@ export interface LipSyncEngineModule {
 export interface WasmLoaderOptions {
   /** Path to the .wasm file */
   wasmPath?: string;
-  /** Path to the .data file */
+  /**
+   * @deprecated The models are no longer packaged in a .data file but fetched per asset from
+   * `modelsPath`; ignored
+   */
   dataPath?: string;
-  /** Path to the .js file */
+  /** Path to the .js file; in Node.js, the URL of the .mjs file of the Node.js build */
   jsPath?: string;
+  /**
+   * URL of the directory containing the model files (dist/wasm/models)
+   * Each asset is fetched when first needed and cached by the browser on its own. In Node.js,
+   * the directory of the file system, from which the files are read in place.
+   * @default the models directory on unpkg for the package version; in Node.js, the package's
+   *   dist/wasm/models
+   */
+  modelsPath?: string;
+  /**
+   * Assets to start fetching during initialization, so that the first analysis doesn't wait for
+   * them. The acoustic model is always loaded before initialization completes; the other assets
+   * load in parallel, and an analysis waits for those it needs, loading missing ones on demand.
+   * @default ['dictionary', 'languageModel'], the assets of the default recognizer
+   */
+  preloadModels?: LipSyncEngineModelAsset[];
+  /**
+   * Variant of the language model to fetch and use as the `'languageModel'` asset. A vocabulary
+   * pack also replaces the `'dictionary'` asset.
+   * @default 'full'
+   */
+  languageModel?: LipSyncEngineLanguageModel;
+  /**
+   * Fetch the language model's n-grams, most of its download, page by page with HTTP range
+   * requests after the rest of it, so that the first analysis doesn't wait for all of it.
+   * Recognition backs off past the n-grams of pages that haven't arrived, at some loss of
+   * accuracy until they have; the pages analyses need are fetched first. Falls back to fetching
+   * the whole file if the server doesn't answer range requests. Ignored where a `WorkerPool`
+   * shares the models between its workers.
+   * @default false
+   */
+  pagedLanguageModel?: boolean;
+  /**
+   * Keep the .wasm file and the models in Cache Storage, so that later page loads don't download
+   * them again. The cache is per package version; caches of other versions are deleted. Disable
+   * it for self-hosted files that change without a version change.
+   * @default true
+   */
+  cache?: boolean;
+  /**
+   * An already compiled module of the build, from `WasmLoader.compile()`, to instantiate instead
+   * of fetching and compiling `wasmPath`. `WorkerPool` passes one to all its workers.
+   */
+  wasmModule?: WebAssembly.Module;
+  /**
+   * Load the multithreaded build (lip-sync-engine-mt) by default
+   * It requires SharedArrayBuffer, so it is only used on cross-origin-isolated pages;
+   * otherwise the single-threaded build is loaded.
+   * @default false
+   */
+  threads?: boolean;
+  /**
+   * Performance tier of the device; `'low'` loads the fixed-point build by default, ignoring
+   * `threads`
+   * @default 'standard'
+   */
+  deviceTier?: LipSyncEngineDeviceTier;
+  /**
+   * Load the size-optimized build (lip-sync-engine-compact) by default, which downloads,
+   * compiles and starts faster but analyzes more slowly. Ignored with `threads` or a `'low'`
+   * `deviceTier`.
+   * @default false
+   */
+  compact?: boolean;
+}
+
+/**
+ * Options of `LipSyncEngine.init()`
+ */
+export interface LipSyncEngineInitOptions extends WasmLoaderOptions {
+  /**
+   * Run `analyze()` in a dedicated worker (a `WorkerPool` with one worker), so that decoding
+   * doesn't block rendering. `analyzeOnCurrentThread()` still runs on the calling thread.
+   * @default true on a page's main thread, false in workers and Node.js
+   */
+  offMainThread?: boolean;
+  /** URL of the worker script of the dedicated worker (dist/worker.js) */
+  workerScriptUrl?: string;
+  /**
+   * Run `analyze()` in the `WorkerPool` singleton's workers once the application has initialized
+   * it, instead of the dedicated worker, so that using both APIs doesn't run an extra engine. The
+   * pool's own options, e.g. its memory budget, then apply to those analyses.
+   * @default true
+   */
+  shareWorkerPool?: boolean;
 }
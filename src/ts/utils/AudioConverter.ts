@@ -3,6 +3,10 @@
  * Framework-agnostic - works with any audio API
  */
 
+import { LipSyncEngine } from '../LipSyncEngine';
+import { WorkerPool } from '../WorkerPool';
+import { getChannels } from './convert';
+
 /**
  * Convert Float32Array to Int16Array PCM
  */
@@ -42,6 +46,33 @@ export function audioBufferToInt16(
   return float32ToInt16(float32);
 }
 
+/**
+ * Convert AudioBuffer to Int16Array PCM with the engine's resampler
+ * Runs in a worker of the initialized WorkerPool, or else in the initialized LipSyncEngine's
+ * module. All channels are mixed down to mono. Falls back to `audioBufferToInt16()` if neither is
+ * initialized.
+ *
+ * @param audioBuffer - Web Audio API AudioBuffer
+ * @param targetSampleRate - Target sample rate (default: 16000)
+ * @returns Promise resolving to Int16Array PCM data
+ */
+export async function audioBufferToInt16Async(
+  audioBuffer: AudioBuffer,
+  targetSampleRate = 16000
+): Promise<Int16Array> {
+  const pool = WorkerPool.getReadyInstance();
+  if (pool) {
+    return pool.convertToPcm16(getChannels(audioBuffer), audioBuffer.sampleRate, targetSampleRate);
+  }
+
+  const engine = LipSyncEngine.getReadyInstance();
+  if (engine) {
+    return engine.convertToPcm16(getChannels(audioBuffer), audioBuffer.sampleRate, targetSampleRate);
+  }
+
+  return audioBufferToInt16(audioBuffer, targetSampleRate);
+}
+
 /**
  * Simple linear resampling
  * For better quality, consider using a dedicated library
@@ -120,7 +151,7 @@ export async function recordAudio(
   const audioContext = new AudioContext({ sampleRate });
   const audioBuffer = await audioContext.decodeAudioData(arrayBuffer);
 
-  const pcm16 = audioBufferToInt16(audioBuffer, sampleRate);
+  const pcm16 = await audioBufferToInt16Async(audioBuffer, sampleRate);
 
   return { pcm16, audioBuffer };
 }
@@ -150,7 +181,7 @@ export async function loadAudio(
   const audioContext = new AudioContext({ sampleRate: targetSampleRate });
   const audioBuffer = await audioContext.decodeAudioData(arrayBuffer);
 
-  const pcm16 = audioBufferToInt16(audioBuffer, targetSampleRate);
+  const pcm16 = await audioBufferToInt16Async(audioBuffer, targetSampleRate);
 
   return { pcm16, audioBuffer };
 }
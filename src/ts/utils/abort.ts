@@ -0,0 +1,22 @@
+/**
+ * Helpers for aborting analyses with an AbortSignal
+ */
+
+/**
+ * Get the error an aborted analysis rejects with
+ * @param signal - The aborted signal
+ * @returns The signal's reason, or an AbortError if it has none
+ */
+export function getAbortReason(signal: AbortSignal): unknown {
+  return signal.reason ?? new DOMException('The analysis was aborted', 'AbortError');
+}
+
+/**
+ * Throw the signal's reason if it has been aborted
+ * @param signal - Optional signal
+ */
+export function throwIfAborted(signal?: AbortSignal): void {
+  if (signal?.aborted) {
+    throw getAbortReason(signal);
+  }
+}
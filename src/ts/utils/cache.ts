@@ -0,0 +1,138 @@
+/**
+ * Persistent caching of the downloaded WASM and model files in Cache Storage
+ * Each package version has its own cache, so an update never mixes files of two versions;
+ * the caches of other versions are deleted once the current one is used.
+ */
+
+import packageJson from '../../../package.json';
+
+/** Prefix of the names of all caches of the package */
+const CACHE_PREFIX = 'lip-sync-engine-';
+
+/** Name of the cache of this package version */
+export const CACHE_NAME = `${CACHE_PREFIX}${packageJson.version}`;
+
+let cachePromise: Promise<Cache | null> | null = null;
+
+/**
+ * Open the cache of this package version, or get null if Cache Storage is unavailable
+ * (e.g. on insecure origins or in private browsing modes)
+ */
+function openCache(): Promise<Cache | null> {
+  if (!cachePromise) {
+    cachePromise = (async () => {
+      if (typeof caches === 'undefined') {
+        return null;
+      }
+      try {
+        const cache = await caches.open(CACHE_NAME);
+        // Drop the files of other versions, without waiting for it
+        caches
+          .keys()
+          .then((names) =>
+            Promise.all(
+              names
+                .filter((name) => name.startsWith(CACHE_PREFIX) && name !== CACHE_NAME)
+                .map((name) => caches.delete(name))
+            )
+          )
+          .catch(() => {});
+        return cache;
+      } catch {
+        return null;
+      }
+    })();
+  }
+  return cachePromise;
+}
+
+/**
+ * Fetch a file, answering from the cache if it holds the file and storing it there otherwise
+ * @param url - URL of the file
+ * @param useCache - Whether to use the cache at all
+ * @returns The response, whose body is still unread
+ * @throws {Error} If the file can't be fetched
+ */
+export async function fetchCached(url: string, useCache = true): Promise<Response> {
+  const cache = useCache ? await openCache() : null;
+  if (cache) {
+    const cached = await cache.match(url).catch(() => undefined);
+    if (cached) {
+      return cached;
+    }
+  }
+
+  const response = await fetch(url);
+  if (!response.ok) {
+    throw new Error(`Failed to fetch ${url}: ${response.status} ${response.statusText}`);
+  }
+  if (cache) {
+    // A full or failing cache only costs the next visit a download
+    cache.put(url, response.clone()).catch(() => {});
+  }
+  return response;
+}
+
+/** A byte range of a file, see `fetchRangeCached` */
+export interface FileRange {
+  bytes: Uint8Array;
+  /** Size of the whole file */
+  fileSize: number;
+}
+
+/**
+ * Fetch a byte range of a file with a range request, answering from the cache if it holds the
+ * range and storing it there otherwise
+ * Cache Storage doesn't store partial responses, so each range is stored as a whole response
+ * under a URL of its own, keeping the file's size in its Content-Range header.
+ * @param url - URL of the file
+ * @param start - Offset of the first byte
+ * @param end - Offset past the last byte
+ * @param useCache - Whether to use the cache at all
+ * @returns The range, or null if the server answers with the whole file instead
+ * @throws {Error} If the range can't be fetched
+ */
+export async function fetchRangeCached(
+  url: string,
+  start: number,
+  end: number,
+  useCache = true
+): Promise<FileRange | null> {
+  const rangeUrl = `${url}${url.includes('?') ? '&' : '?'}lipsyncengine-range=${start}-${end}`;
+  const cache = useCache ? await openCache() : null;
+  if (cache) {
+    const cached = await cache.match(rangeUrl).catch(() => undefined);
+    const fileSize = cached ? parseFileSize(cached) : null;
+    if (cached && fileSize !== null) {
+      return { bytes: new Uint8Array(await cached.arrayBuffer()), fileSize };
+    }
+  }
+
+  const response = await fetch(url, { headers: { Range: `bytes=${start}-${end - 1}` } });
+  if (!response.ok) {
+    throw new Error(`Failed to fetch ${url}: ${response.status} ${response.statusText}`);
+  }
+  const fileSize = response.status === 206 ? parseFileSize(response) : null;
+  if (fileSize === null) {
+    // Cancel the download of the whole file
+    response.body?.cancel().catch(() => {});
+    return null;
+  }
+  const bytes = new Uint8Array(await response.arrayBuffer());
+  if (bytes.length !== Math.min(end, fileSize) - start) {
+    throw new Error(`Failed to fetch ${url}: unexpected range`);
+  }
+  if (cache) {
+    const headers = { 'Content-Range': `bytes ${start}-${start + bytes.length - 1}/${fileSize}` };
+    cache.put(rangeUrl, new Response(bytes.slice(), { headers })).catch(() => {});
+  }
+  return { bytes, fileSize };
+}
+
+/**
+ * Get the size of the whole file from a response's Content-Range header, or null if it lacks one
+ */
+function parseFileSize(response: Response): number | null {
+  const match = /\/(\d+)\s*$/.exec(response.headers.get('Content-Range') ?? '');
+  return match ? Number(match[1]) : null;
+}
@@ -0,0 +1,70 @@
+/**
+ * Voice activity detection in the capture worklet, with lip-sync-engine-vad.wasm
+ * The worklet detects the activity of each 10 ms frame as it is captured, writes the samples of
+ * the frames around voice to the audio ring buffer and one entry per frame to an activity ring
+ * buffer. Each entry is `FRAME_INACTIVE` or `FRAME_ACTIVE` for a frame whose samples are in the
+ * audio ring buffer, or a negative count of consecutive frames without voice that weren't
+ * captured. The worker passes them on with `LipSyncEngineStream.pushActivity()`.
+ */
+
+export const FRAME_INACTIVE = 0;
+export const FRAME_ACTIVE = 1;
+/** The value of an uncaptured frame for `LipSyncEngineStream.pushActivity()` */
+export const FRAME_UNCAPTURED = 2;
+
+/**
+ * The index of the first sample of a frame; frame lengths alternate at rates that aren't
+ * multiples of 100 Hz
+ */
+export function getFrameStart(frame: number, sampleRate: number): number {
+  return Math.floor((frame * sampleRate) / 100);
+}
+
+/**
+ * Imports for instantiating lip-sync-engine-vad.wasm
+ * The module is standalone and calls none of its imports, e.g. the WASI ones of the C library, so
+ * they are stubbed.
+ */
+export function createVadImports(module: WebAssembly.Module): WebAssembly.Imports {
+  const imports: Record<string, Record<string, WebAssembly.ImportValue>> = {};
+  for (const { module: moduleName, name, kind } of WebAssembly.Module.imports(module)) {
+    if (kind === 'function') {
+      imports[moduleName] = { ...imports[moduleName], [name]: () => 0 };
+    }
+  }
+  return imports;
+}
+
+/**
+ * The activity entries of frames, converted for `LipSyncEngineStream.pushActivity()`
+ *
+ * @param firstFrame - Index of the frame of the first entry
+ * @returns The activity of each frame, and the number of samples of the captured ones
+ */
+export function decodeFrameActivity(
+  entries: Int16Array,
+  firstFrame: number,
+  sampleRate: number
+): { frameActivity: Uint8Array; sampleCount: number } {
+  let frameCount = 0;
+  for (const entry of entries) {
+    frameCount += entry < 0 ? -entry : 1;
+  }
+
+  const frameActivity = new Uint8Array(frameCount);
+  let frame = firstFrame;
+  let sampleCount = 0;
+  let index = 0;
+  for (const entry of entries) {
+    if (entry < 0) {
+      frameActivity.fill(FRAME_UNCAPTURED, index, index - entry);
+      index -= entry;
+      frame -= entry;
+    } else {
+      frameActivity[index++] = entry;
+      sampleCount += getFrameStart(frame + 1, sampleRate) - getFrameStart(frame, sampleRate);
+      frame++;
+    }
+  }
+  return { frameActivity, sampleCount };
+}
@@ -0,0 +1,138 @@
+/**
+ * Decoding of the compact binary cue format, as written by the CLI's `--exportFormat compact`
+ * See CompactExporter.h for the layout.
+ */
+
+import type { MouthCue } from '../types';
+
+/** Mouth shapes by their index in the binary format */
+const SHAPES = 'ABCDEFGHX';
+
+const MAGIC = 'LSEC';
+const VERSION = 1;
+
+/**
+ * Mouth cues in the compact format, decoded on demand
+ * The header and seek table are read up front; `getMouthCues()` decodes from the seek entry
+ * before the requested time, so a window of a long file costs a few dozen cues.
+ *
+ * @example
+ * ```typescript
+ * const cues = new CompactCues(new Uint8Array(await (await fetch('line.lsc')).arrayBuffer()));
+ * const visible = cues.getMouthCues(12.5, 15);
+ * ```
+ */
+export class CompactCues {
+  /** Number of cues */
+  readonly cueCount: number;
+  /** Start of the first cue in seconds */
+  readonly start: number;
+
+  private readonly bytes: Uint8Array;
+  private readonly seekInterval: number;
+  /** Per seek point, including one for the first cue: start in centiseconds and byte offset */
+  private readonly seekTimes: number[];
+  private readonly seekOffsets: number[];
+
+  /**
+   * @param bytes - The encoded cues
+   * @throws {Error} If the bytes aren't in the compact format
+   */
+  constructor(bytes: Uint8Array) {
+    this.bytes = bytes;
+    if (bytes.length < 6 || String.fromCharCode(...bytes.subarray(0, 4)) !== MAGIC) {
+      throw new Error('Not a compact cue file');
+    }
+    if (bytes[4] !== VERSION) {
+      throw new Error(`Unsupported compact cue version: ${bytes[4]}`);
+    }
+
+    const reader = new VarintReader(bytes, 6);
+    this.cueCount = reader.read();
+    const start = reader.read();
+    this.seekInterval = reader.read();
+    const seekEntryCount = reader.read();
+
+    let time = start;
+    let offset = 0;
+    const times = [start];
+    const offsets = [0];
+    for (let i = 0; i < seekEntryCount; i++) {
+      time += reader.read();
+      offset += reader.read();
+      times.push(time);
+      offsets.push(offset);
+    }
+
+    // Offsets are relative to the cue data, which follows the seek table
+    this.seekTimes = times;
+    this.seekOffsets = offsets.map((value) => value + reader.offset);
+    this.start = start / 100;
+  }
+
+  /**
+   * Decode the cues that overlap a time range, or all cues
+   * @param start - Start of the range in seconds
+   * @param end - End of the range in seconds
+   * @returns Mouth cues with times in seconds
+   */
+  getMouthCues(start = -Infinity, end = Infinity): MouthCue[] {
+    const startCs = start * 100;
+    const endCs = end * 100;
+
+    // The last seek point at or before the start
+    let low = 0;
+    let high = this.seekTimes.length - 1;
+    while (low < high) {
+      const middle = (low + high + 1) >> 1;
+      if (this.seekTimes[middle] <= startCs) {
+        low = middle;
+      } else {
+        high = middle - 1;
+      }
+    }
+
+    const reader = new VarintReader(this.bytes, this.seekOffsets[low]);
+    let time = this.seekTimes[low];
+    const mouthCues: MouthCue[] = [];
+    for (let i = low * this.seekInterval; i < this.cueCount && time < endCs; i++) {
+      const value = reader.read();
+      const cueEnd = time + Math.floor(value / 16);
+      if (cueEnd > startCs) {
+        mouthCues.push({ start: time / 100, end: cueEnd / 100, value: SHAPES[value & 0xf] });
+      }
+      time = cueEnd;
+    }
+    return mouthCues;
+  }
+}
+
+/**
+ * Decode all cues of the compact format
+ * @param bytes - The encoded cues
+ * @returns Mouth cues with times in seconds
+ * @throws {Error} If the bytes aren't in the compact format
+ */
+export function decodeCompactCues(bytes: Uint8Array): MouthCue[] {
+  return new CompactCues(bytes).getMouthCues();
+}
+
+/** Reader of unsigned LEB128 varints */
+class VarintReader {
+  constructor(private readonly bytes: Uint8Array, public offset: number) {}
+
+  read(): number {
+    let value = 0;
+    let scale = 1;
+    for (;;) {
+      if (this.offset >= this.bytes.length) {
+        throw new Error('Truncated compact cue file');
+      }
+      const byte = this.bytes[this.offset++];
+      // Multiplication instead of shifts, so values beyond 31 bits stay exact
+      value += (byte & 0x7f) * scale;
+      if (byte < 0x80) return value;
+      scale *= 128;
+    }
+  }
+}
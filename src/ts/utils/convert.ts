@@ -0,0 +1,141 @@
+/**
+ * Audio conversion through the C API
+ * See lipsyncengine_convert_f32 and lipsyncengine_decode_wav in bridge.h
+ */
+
+import type { LipSyncEngineModule } from '../types';
+
+/**
+ * Get the channel data of an AudioBuffer
+ */
+export function getChannels(audioBuffer: AudioBuffer): Float32Array[] {
+  return Array.from({ length: audioBuffer.numberOfChannels }, (_, channel) =>
+    audioBuffer.getChannelData(channel)
+  );
+}
+
+/**
+ * Interleave float channels into WASM memory
+ *
+ * @param module - WASM module
+ * @param channels - Samples of each channel, all of the same length
+ * @param samplesPtr - Address of room for the samples of all channels
+ */
+export function writeInterleaved(
+  module: LipSyncEngineModule,
+  channels: Float32Array[],
+  samplesPtr: number
+): void {
+  const heap = module.HEAPF32;
+  const base = samplesPtr / 4;
+  const channelCount = channels.length;
+  if (channelCount === 1) {
+    heap.set(channels[0], base);
+    return;
+  }
+  channels.forEach((data, channel) => {
+    for (let i = 0; i < data.length; i++) {
+      heap[base + i * channelCount + channel] = data[i];
+    }
+  });
+}
+
+/**
+ * Mix float channels down to mono PCM16 at another sample rate, using the engine's resampler
+ * The channels are interleaved straight into WASM memory, so they are copied only once.
+ *
+ * @param module - WASM module
+ * @param channels - Samples in [-1, 1] of each channel, all of the same length
+ * @param sampleRate - Sample rate of the channels
+ * @param targetSampleRate - Sample rate of the result
+ * @returns The converted samples
+ * @throws {Error} If the channels are invalid or the C API fails
+ */
+export function convertToPcm16(
+  module: LipSyncEngineModule,
+  channels: Float32Array[],
+  sampleRate: number,
+  targetSampleRate: number
+): Int16Array {
+  const channelCount = channels.length;
+  const frameCount = channels[0]?.length ?? 0;
+  if (frameCount === 0) {
+    throw new Error('Audio is empty');
+  }
+  if (channels.some((channel) => channel.length !== frameCount)) {
+    throw new Error('All channels must have the same length');
+  }
+
+  let samplesPtr = 0;
+  let sampleCountPtr = 0;
+  let resultPtr = 0;
+  try {
+    samplesPtr = module._malloc(frameCount * channelCount * 4);
+    sampleCountPtr = module._malloc(4);
+    writeInterleaved(module, channels, samplesPtr);
+
+    resultPtr = module._lipsyncengine_convert_f32(
+      samplesPtr,
+      frameCount,
+      channelCount,
+      sampleRate,
+      targetSampleRate,
+      sampleCountPtr
+    );
+    if (!resultPtr) {
+      const errorPtr = module._lipsyncengine_get_last_error();
+      throw new Error(errorPtr ? module.UTF8ToString(errorPtr) : 'Conversion failed');
+    }
+
+    // Copy out of WASM memory, which the caller must not keep a view of
+    const sampleCount = module.HEAP32[sampleCountPtr / 4];
+    return module.HEAP16.slice(resultPtr / 2, resultPtr / 2 + sampleCount);
+  } finally {
+    if (samplesPtr) module._free(samplesPtr);
+    if (sampleCountPtr) module._free(sampleCountPtr);
+    if (resultPtr) module._lipsyncengine_free(resultPtr);
+  }
+}
+
+/**
+ * Decode a WAVE file to mono PCM16 at another sample rate, using the engine's resampler
+ * The file is copied into WASM memory once and decoded, mixed down and resampled in one pass.
+ *
+ * @param module - WASM module
+ * @param bytes - Contents of the WAVE file
+ * @param targetSampleRate - Sample rate of the result
+ * @returns The decoded samples
+ * @throws {Error} If the file is unsupported or the C API fails
+ */
+export function decodeToPcm16(
+  module: LipSyncEngineModule,
+  bytes: Uint8Array,
+  targetSampleRate: number
+): Int16Array {
+  if (bytes.length === 0) {
+    throw new Error('Audio is empty');
+  }
+
+  let bytesPtr = 0;
+  let sampleCountPtr = 0;
+  let resultPtr = 0;
+  try {
+    bytesPtr = module._malloc(bytes.length);
+    sampleCountPtr = module._malloc(4);
+    module.HEAPU8.set(bytes, bytesPtr);
+
+    resultPtr = module._lipsyncengine_decode_wav(bytesPtr, bytes.length, targetSampleRate, sampleCountPtr);
+    if (!resultPtr) {
+      const errorPtr = module._lipsyncengine_get_last_error();
+      throw new Error(errorPtr ? module.UTF8ToString(errorPtr) : 'Decoding failed');
+    }
+
+    // Copy out of WASM memory, which the caller must not keep a view of
+    const sampleCount = module.HEAP32[sampleCountPtr / 4];
+    return module.HEAP16.slice(resultPtr / 2, resultPtr / 2 + sampleCount);
+  } finally {
+    if (bytesPtr) module._free(bytesPtr);
+    if (sampleCountPtr) module._free(sampleCountPtr);
+    if (resultPtr) module._lipsyncengine_free(resultPtr);
+  }
+}
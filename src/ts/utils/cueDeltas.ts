@@ -0,0 +1,40 @@
+/**
+ * Deltas of the tentative cues of streaming sessions
+ * Sessions post the tentative cues from the first one that changed on, rather than the whole
+ * list, and receivers splice them into the list they hold.
+ */
+
+import type { MouthCue } from '../types';
+
+function sameMouthCue(a: MouthCue, b: MouthCue): boolean {
+  return a.start === b.start && a.end === b.end && a.value === b.value;
+}
+
+/**
+ * Find where a session's tentative cues changed
+ * @returns The index of the first cue of `current` that differs from `previous`, or null if the
+ *   lists are the same. If `current` only drops cues of `previous`, its length.
+ */
+export function findTentativeCuesChange(previous: MouthCue[], current: MouthCue[]): number | null {
+  const commonLength = Math.min(previous.length, current.length);
+  let index = 0;
+  while (index < commonLength && sameMouthCue(previous[index], current[index])) {
+    index++;
+  }
+  return index === current.length && index === previous.length ? null : index;
+}
+
+/**
+ * Apply a delta of tentative cues
+ * @param previous - The tentative cues before the delta; not modified
+ * @param from - The index from which the delta replaces them
+ * @param cues - The cues from `from` on
+ * @returns The tentative cues after the delta
+ */
+export function applyTentativeCues(
+  previous: MouthCue[],
+  from: number,
+  cues: MouthCue[]
+): MouthCue[] {
+  return from === 0 ? cues : [...previous.slice(0, from), ...cues];
+}
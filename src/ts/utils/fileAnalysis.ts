@@ -0,0 +1,68 @@
+import type { MouthCue } from '../types';
+import type { WorkerAnalyzeResponse, WorkerStreamCuesResponse } from '../worker';
+import { applyTentativeCues } from './cueDeltas';
+
+/**
+ * Analysis of a file that a reserved pool worker reads and feeds to a streaming session itself
+ * (see `WorkerPool.analyzeFile()`); collects the cues the worker posts as the session finalizes
+ * them
+ */
+export class FileAnalysis {
+  readonly result: Promise<MouthCue[]>;
+  private mouthCues: MouthCue[] = [];
+  /** The tentative cues, as the worker's deltas have built them */
+  private tentativeCues: MouthCue[] = [];
+  private resolve!: (mouthCues: MouthCue[]) => void;
+  private reject!: (error: unknown) => void;
+  private finished = false;
+
+  constructor(
+    private readonly callbacks: {
+      onMouthCues?: (mouthCues: MouthCue[]) => void;
+      onTentativeCues?: (tentativeCues: MouthCue[], from: number) => void;
+    },
+    /** Returns the worker to the pool */
+    private readonly release: () => void
+  ) {
+    this.result = new Promise((resolve, reject) => {
+      this.resolve = resolve;
+      this.reject = reject;
+    });
+  }
+
+  /** @internal */
+  handleMessage(message: WorkerStreamCuesResponse | WorkerAnalyzeResponse): void {
+    if (message.type === 'streamCues') {
+      this.mouthCues.push(...message.mouthCues);
+      if (message.mouthCues.length > 0) {
+        this.callbacks.onMouthCues?.(message.mouthCues);
+      }
+      if (message.tentativeCues) {
+        const from = message.tentativeFrom ?? 0;
+        this.tentativeCues = applyTentativeCues(this.tentativeCues, from, message.tentativeCues);
+        this.callbacks.onTentativeCues?.(this.tentativeCues, from);
+      }
+      if (message.final) {
+        this.finish();
+        this.resolve(this.mouthCues);
+      }
+    } else if (message.type === 'error') {
+      this.fail(new Error(message.error || 'File analysis failed'));
+    }
+  }
+
+  /**
+   * Settle the analysis with an error, e.g. once it has been aborted, and return the worker
+   */
+  fail(error: unknown): void {
+    this.finish();
+    this.reject(error);
+  }
+
+  private finish(): void {
+    if (!this.finished) {
+      this.finished = true;
+      this.release();
+    }
+  }
+}
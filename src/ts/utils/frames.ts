@@ -0,0 +1,112 @@
+/**
+ * Mouth shapes resampled at a fixed frame rate
+ * See lipsyncengine_sample_frames in bridge.h
+ */
+
+import type { LipSyncEngineFrames, LipSyncEngineModule, LipSyncEngineOptions, MouthCue } from '../types';
+
+/** Mouth shapes by their index in the binary format */
+const SHAPES = 'ABCDEFGHX';
+
+/** Size of lipsyncengine_frames in bytes: the frame count and three pointers */
+const FRAMES_SIZE = 16;
+
+/**
+ * Throw if the frame options are invalid, before an analysis is spent on them
+ */
+export function validateFrameOptions(options: Pick<LipSyncEngineOptions, 'frameRate'>): void {
+  const { frameRate } = options;
+  if (frameRate !== undefined && !(frameRate > 0 && frameRate <= 1000)) {
+    throw new Error(`Invalid frame rate: ${frameRate}`);
+  }
+}
+
+/**
+ * Resample binary mouth cues in WASM memory, copying the frames out of it
+ * @param module - WASM module owning the memory
+ * @param cuesPtr - Pointer to the first cue
+ * @param cueCount - Number of cues
+ * @param options - `frameRate` and `frameBlending`
+ */
+export function readFrames(
+  module: LipSyncEngineModule,
+  cuesPtr: number,
+  cueCount: number,
+  options: Pick<LipSyncEngineOptions, 'frameRate' | 'frameBlending'>
+): LipSyncEngineFrames {
+  const frameRate = options.frameRate!;
+  const framesPtr = module._malloc(FRAMES_SIZE);
+  let shapesPtr = 0;
+  try {
+    const blend = options.frameBlending ? 1 : 0;
+    if (module._lipsyncengine_sample_frames(cuesPtr, cueCount, frameRate, blend, framesPtr) !== 0) {
+      const errorPtr = module._lipsyncengine_get_last_error();
+      throw new Error(errorPtr ? module.UTF8ToString(errorPtr) : 'Frame sampling failed');
+    }
+
+    const [frameCount, ptr, blendShapesPtr, blendWeightsPtr] =
+      module.HEAP32.subarray(framesPtr / 4, framesPtr / 4 + 4);
+    shapesPtr = ptr;
+    const frames: LipSyncEngineFrames = {
+      frameRate,
+      shapes: module.HEAPU8.slice(shapesPtr, shapesPtr + frameCount),
+    };
+    if (blend) {
+      frames.blendShapes = module.HEAPU8.slice(blendShapesPtr, blendShapesPtr + frameCount);
+      frames.blendWeights = module.HEAPF32.slice(blendWeightsPtr / 4, blendWeightsPtr / 4 + frameCount);
+    }
+    return frames;
+  } finally {
+    if (shapesPtr) module._lipsyncengine_free(shapesPtr);
+    module._free(framesPtr);
+  }
+}
+
+/**
+ * Resample decoded mouth cues, the same way as the engine
+ * For results assembled outside the engine, such as the stitched pieces of a long batch clip.
+ * @param mouthCues - Mouth cues ordered by time
+ * @param options - `frameRate` and `frameBlending`
+ */
+export function sampleFrames(
+  mouthCues: MouthCue[],
+  options: Pick<LipSyncEngineOptions, 'frameRate' | 'frameBlending'>
+): LipSyncEngineFrames {
+  const frameRate = options.frameRate!;
+  // In centiseconds, like the binary cues
+  const ends = mouthCues.map((cue) => Math.round(cue.end * 100));
+  const end = ends.length > 0 ? ends[ends.length - 1] : 0;
+  const frameCount = end > 0 ? Math.ceil(end / 100 * frameRate) : 0;
+
+  const frames: LipSyncEngineFrames = { frameRate, shapes: new Uint8Array(frameCount) };
+  const blendShapes = options.frameBlending ? new Uint8Array(frameCount) : null;
+  const blendWeights = options.frameBlending ? new Float32Array(frameCount) : null;
+
+  // Frame times only grow, so one sweep over the cues finds the cue of every frame
+  let cue = 0;
+  for (let frame = 0; frame < frameCount; frame++) {
+    const frameStart = frame * 100 / frameRate;
+    const frameEnd = (frame + 1) * 100 / frameRate;
+    while (cue + 1 < mouthCues.length && ends[cue] <= frameStart) {
+      cue++;
+    }
+
+    const shape = SHAPES.indexOf(mouthCues[cue].value);
+    frames.shapes[frame] = shape;
+    if (!blendShapes || !blendWeights) continue;
+
+    // The next cue, if it starts within the frame
+    if (cue + 1 < mouthCues.length && ends[cue] < frameEnd) {
+      blendShapes[frame] = SHAPES.indexOf(mouthCues[cue + 1].value);
+      blendWeights[frame] = Math.min(Math.max((frameEnd - ends[cue]) / (frameEnd - frameStart), 0), 1);
+    } else {
+      blendShapes[frame] = shape;
+    }
+  }
+
+  if (blendShapes && blendWeights) {
+    frames.blendShapes = blendShapes;
+    frames.blendWeights = blendWeights;
+  }
+  return frames;
+}
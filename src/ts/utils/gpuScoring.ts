@@ -0,0 +1,412 @@
+/**
+ * Scoring of tied-mixture Gaussians on the GPU with WebGPU, for the JSPI build
+ * Installed as the module's `lipsyncengineGpuScorer` (see `lipsyncengine_set_gpu_scoring()`), the
+ * scorer uploads the codebooks of an acoustic model once and computes the top Gaussians of every
+ * codebook for each block of frames a decoder hands it, one shader invocation per frame, codebook
+ * and feature. The module suspends until the result is read back, so only the analyses of the
+ * JSPI build, which can suspend, score on the GPU.
+ */
+
+import type { LipSyncEngineModule } from '../types';
+
+/** The parts of WebGPU the scorer uses, which TypeScript's DOM library doesn't declare */
+interface GpuBuffer {
+  mapAsync(mode: number, offset: number, size: number): Promise<void>;
+  getMappedRange(offset: number, size: number): ArrayBuffer;
+  unmap(): void;
+  destroy(): void;
+}
+interface GpuComputePass {
+  setPipeline(pipeline: GpuComputePipeline): void;
+  setBindGroup(index: number, bindGroup: unknown): void;
+  dispatchWorkgroups(count: number): void;
+  end(): void;
+}
+interface GpuComputePipeline {
+  getBindGroupLayout(index: number): unknown;
+}
+interface GpuDevice {
+  readonly lost: Promise<unknown>;
+  readonly queue: {
+    writeBuffer(buffer: GpuBuffer, offset: number, data: ArrayBufferView): void;
+    submit(commandBuffers: unknown[]): void;
+  };
+  createBuffer(descriptor: { size: number; usage: number }): GpuBuffer;
+  createShaderModule(descriptor: { code: string }): unknown;
+  createComputePipeline(descriptor: {
+    layout: 'auto';
+    compute: { module: unknown; entryPoint: string };
+  }): GpuComputePipeline;
+  createBindGroup(descriptor: {
+    layout: unknown;
+    entries: Array<{ binding: number; resource: { buffer: GpuBuffer } }>;
+  }): unknown;
+  createCommandEncoder(): {
+    beginComputePass(): GpuComputePass;
+    copyBufferToBuffer(
+      source: GpuBuffer,
+      sourceOffset: number,
+      destination: GpuBuffer,
+      destinationOffset: number,
+      size: number
+    ): void;
+    finish(): unknown;
+  };
+}
+interface Gpu {
+  requestAdapter(options?: { powerPreference?: string }): Promise<{
+    requestDevice(): Promise<GpuDevice>;
+  } | null>;
+}
+
+// GPUBufferUsage and GPUMapMode flags
+const USAGE_MAP_READ = 0x0001;
+const USAGE_COPY_DST = 0x0008;
+const USAGE_COPY_SRC = 0x0004;
+const USAGE_UNIFORM = 0x0040;
+const USAGE_STORAGE = 0x0080;
+const MAP_MODE_READ = 0x0001;
+
+/** The largest top-N the shader keeps; PocketSphinx's default is 4 */
+const MAX_TOPN = 16;
+const WORKGROUP_SIZE = 64;
+/** WebGPU's default limit of workgroups per dispatch dimension */
+const MAX_WORKGROUP_COUNT = 65535;
+
+/**
+ * Computes the top-N densities of one frame, codebook and feature, as ptm_mgau.c's eval_cb() does
+ * with every Gaussian: the score is the log determinant minus the variance-weighted squared
+ * distance, truncated to an integer, best first.
+ */
+const SHADER = /* wgsl */ `
+struct Params {
+  codebookCount: u32,
+  featureCount: u32,
+  densityCount: u32,
+  topnCount: u32,
+  frameCount: u32,
+  frameLength: u32,
+}
+
+const MAX_TOPN = ${MAX_TOPN}u;
+
+@group(0) @binding(0) var<uniform> params: Params;
+@group(0) @binding(1) var<storage, read> densities: array<f32>;
+@group(0) @binding(2) var<storage, read> densityOffsets: array<u32>;
+// Length, padded stride of the means and variances, and offset within a frame of each feature
+@group(0) @binding(3) var<storage, read> featureLayouts: array<vec4<u32>>;
+@group(0) @binding(4) var<storage, read> determinants: array<f32>;
+@group(0) @binding(5) var<storage, read> features: array<f32>;
+@group(0) @binding(6) var<storage, read_write> topn: array<vec2<i32>>;
+
+@compute @workgroup_size(${WORKGROUP_SIZE})
+fn main(@builtin(global_invocation_id) id: vec3<u32>) {
+  let index = id.x;
+  if (index >= params.frameCount * params.codebookCount * params.featureCount) {
+    return;
+  }
+  let feature = index % params.featureCount;
+  let codebookFeature = index % (params.codebookCount * params.featureCount);
+  let frame = index / (params.codebookCount * params.featureCount);
+  let layout = featureLayouts[feature];
+  let observation = frame * params.frameLength + layout.z;
+
+  var bestCodewords: array<i32, MAX_TOPN>;
+  var bestScores: array<f32, MAX_TOPN>;
+  for (var rank = 0u; rank < params.topnCount; rank++) {
+    bestCodewords[rank] = 0;
+    bestScores[rank] = -3.4e38;
+  }
+  for (var codeword = 0u; codeword < params.densityCount; codeword++) {
+    let mean = densityOffsets[codebookFeature] + codeword * 2u * layout.y;
+    let variance = mean + layout.y;
+    var score = determinants[codebookFeature * params.densityCount + codeword];
+    for (var j = 0u; j < layout.x; j++) {
+      let diff = features[observation + j] - densities[mean + j];
+      score -= diff * diff * densities[variance + j];
+    }
+
+    var rank = params.topnCount;
+    while (rank > 0u && score > bestScores[rank - 1u]) {
+      if (rank < params.topnCount) {
+        bestScores[rank] = bestScores[rank - 1u];
+        bestCodewords[rank] = bestCodewords[rank - 1u];
+      }
+      rank--;
+    }
+    if (rank < params.topnCount) {
+      bestScores[rank] = score;
+      bestCodewords[rank] = i32(codeword);
+    }
+  }
+  for (var rank = 0u; rank < params.topnCount; rank++) {
+    topn[index * params.topnCount + rank] = vec2<i32>(bestCodewords[rank], i32(bestScores[rank]));
+  }
+}
+`;
+
+/** A block to score, as gpuScoring.cpp's GpuBlockRequest lays it out: 32-bit counts and pointers */
+interface GpuBlockRequest {
+  codebookCount: number;
+  featureCount: number;
+  densityCount: number;
+  topnCount: number;
+  frameCount: number;
+  featureLengthsPtr: number;
+  densitiesPtr: number;
+  densityOffsetsPtr: number;
+  densityStridesPtr: number;
+  determinantsPtr: number;
+  featuresPtr: number;
+  topnPtr: number;
+}
+
+function readRequest(heap: Int32Array, requestPtr: number): GpuBlockRequest {
+  const fields = heap.subarray(requestPtr / 4, requestPtr / 4 + 12);
+  return {
+    codebookCount: fields[0],
+    featureCount: fields[1],
+    densityCount: fields[2],
+    topnCount: fields[3],
+    frameCount: fields[4],
+    featureLengthsPtr: fields[5] >>> 0,
+    densitiesPtr: fields[6] >>> 0,
+    densityOffsetsPtr: fields[7] >>> 0,
+    densityStridesPtr: fields[8] >>> 0,
+    determinantsPtr: fields[9] >>> 0,
+    featuresPtr: fields[10] >>> 0,
+    topnPtr: fields[11] >>> 0,
+  };
+}
+
+/** The codebooks of an acoustic model, uploaded to the GPU */
+interface GpuModel {
+  /** The dimensions and the first values, which tell whether memory now holds another model */
+  signature: number[];
+  /** The number of features of a frame, without padding */
+  frameLength: number;
+  buffers: GpuBuffer[];
+}
+
+/**
+ * Scores blocks of frames of the JSPI build's decoders on the GPU
+ */
+export class GpuGaussianScorer {
+  /** Models by the address of their packed densities */
+  private readonly models = new Map<number, GpuModel>();
+  private readonly params: GpuBuffer;
+  /** Block buffers, grown as needed: features, top-N and its readback copy */
+  private blockBuffers: { bytes: number; features: GpuBuffer; topn: GpuBuffer; readback: GpuBuffer } | null =
+    null;
+  private lost = false;
+
+  private constructor(
+    private readonly device: GpuDevice,
+    private readonly pipeline: GpuComputePipeline
+  ) {
+    this.params = device.createBuffer({ size: 32, usage: USAGE_UNIFORM | USAGE_COPY_DST });
+    device.lost.then(() => {
+      this.lost = true;
+    });
+  }
+
+  /**
+   * Create a scorer on the high-performance adapter, or return null where WebGPU isn't available
+   */
+  static async create(): Promise<GpuGaussianScorer | null> {
+    const gpu = (globalThis.navigator as unknown as { gpu?: Gpu } | undefined)?.gpu;
+    if (!gpu) {
+      return null;
+    }
+    try {
+      const adapter = await gpu.requestAdapter({ powerPreference: 'high-performance' });
+      if (!adapter) {
+        return null;
+      }
+      const device = await adapter.requestDevice();
+      const pipeline = device.createComputePipeline({
+        layout: 'auto',
+        compute: { module: device.createShaderModule({ code: SHADER }), entryPoint: 'main' },
+      });
+      return new GpuGaussianScorer(device, pipeline);
+    } catch {
+      return null;
+    }
+  }
+
+  /**
+   * Score the block of frames described by the `GpuBlockRequest` at `requestPtr`, writing its
+   * top-N densities to WASM memory
+   *
+   * @returns 0 on success, -1 to have the module score the block on the CPU
+   */
+  async evaluateBlock(module: LipSyncEngineModule, requestPtr: number): Promise<number> {
+    const request = readRequest(module.HEAP32, requestPtr);
+    const invocationCount = request.frameCount * request.codebookCount * request.featureCount;
+    if (
+      this.lost ||
+      request.topnCount > MAX_TOPN ||
+      Math.ceil(invocationCount / WORKGROUP_SIZE) > MAX_WORKGROUP_COUNT
+    ) {
+      return -1;
+    }
+
+    const model = this.getModel(module, request);
+    const featureCount = request.frameCount * model.frameLength;
+    const topnBytes = invocationCount * request.topnCount * 8;
+    const block = this.reserveBlockBuffers(Math.max(featureCount * 4, topnBytes));
+
+    const queue = this.device.queue;
+    queue.writeBuffer(
+      this.params,
+      0,
+      new Uint32Array([
+        request.codebookCount,
+        request.featureCount,
+        request.densityCount,
+        request.topnCount,
+        request.frameCount,
+        model.frameLength,
+        0,
+        0,
+      ])
+    );
+    queue.writeBuffer(
+      block.features,
+      0,
+      module.HEAPF32.slice(request.featuresPtr / 4, request.featuresPtr / 4 + featureCount)
+    );
+
+    const [densities, densityOffsets, featureLayouts, determinants] = model.buffers;
+    const bindGroup = this.device.createBindGroup({
+      layout: this.pipeline.getBindGroupLayout(0),
+      entries: [this.params, densities, densityOffsets, featureLayouts, determinants, block.features, block.topn]
+        .map((buffer, binding) => ({ binding, resource: { buffer } })),
+    });
+    const encoder = this.device.createCommandEncoder();
+    const pass = encoder.beginComputePass();
+    pass.setPipeline(this.pipeline);
+    pass.setBindGroup(0, bindGroup);
+    pass.dispatchWorkgroups(Math.ceil(invocationCount / WORKGROUP_SIZE));
+    pass.end();
+    encoder.copyBufferToBuffer(block.topn, 0, block.readback, 0, topnBytes);
+    queue.submit([encoder.finish()]);
+
+    await block.readback.mapAsync(MAP_MODE_READ, 0, topnBytes);
+    try {
+      // Taken after waiting, as the heap may have grown meanwhile
+      module.HEAP32.set(
+        new Int32Array(block.readback.getMappedRange(0, topnBytes)),
+        request.topnPtr / 4
+      );
+    } finally {
+      block.readback.unmap();
+    }
+    return 0;
+  }
+
+  /**
+   * Free the uploaded models, e.g. once the module has freed its decoders
+   */
+  releaseModels(): void {
+    for (const model of this.models.values()) {
+      model.buffers.forEach((buffer) => buffer.destroy());
+    }
+    this.models.clear();
+  }
+
+  private getModel(module: LipSyncEngineModule, request: GpuBlockRequest): GpuModel {
+    const { codebookCount, featureCount, densityCount } = request;
+    const densitySignature = module.HEAPF32.subarray(request.densitiesPtr / 4, request.densitiesPtr / 4 + 8);
+    const determinantSignature = module.HEAPF32.subarray(
+      request.determinantsPtr / 4,
+      request.determinantsPtr / 4 + 8
+    );
+    const signature = [
+      codebookCount,
+      featureCount,
+      densityCount,
+      request.determinantsPtr,
+      ...densitySignature,
+      ...determinantSignature,
+    ];
+    const cached = this.models.get(request.densitiesPtr);
+    if (cached && cached.signature.every((value, i) => Object.is(value, signature[i]))) {
+      return cached;
+    }
+    if (cached) {
+      cached.buffers.forEach((buffer) => buffer.destroy());
+    }
+
+    const featureLengths = module.HEAP32.subarray(
+      request.featureLengthsPtr / 4,
+      request.featureLengthsPtr / 4 + featureCount
+    );
+    const densityStrides = module.HEAP32.subarray(
+      request.densityStridesPtr / 4,
+      request.densityStridesPtr / 4 + featureCount
+    );
+    // size_t is 32 bits in WASM
+    const densityOffsets = new Uint32Array(
+      module.HEAP32.buffer,
+      request.densityOffsetsPtr,
+      codebookCount * featureCount
+    ).slice();
+
+    const featureLayouts = new Uint32Array(featureCount * 4);
+    let frameLength = 0;
+    for (let i = 0; i < featureCount; i++) {
+      featureLayouts.set([featureLengths[i], densityStrides[i], frameLength, 0], i * 4);
+      frameLength += featureLengths[i];
+    }
+    let densityLength = 0;
+    for (let i = 0; i < codebookCount * featureCount; i++) {
+      const end = densityOffsets[i] + densityCount * 2 * densityStrides[i % featureCount];
+      densityLength = Math.max(densityLength, end);
+    }
+
+    const upload = (data: ArrayBufferView & { byteLength: number }): GpuBuffer => {
+      const buffer = this.device.createBuffer({
+        size: Math.max(data.byteLength, 4),
+        usage: USAGE_STORAGE | USAGE_COPY_DST,
+      });
+      this.device.queue.writeBuffer(buffer, 0, data);
+      return buffer;
+    };
+    const model: GpuModel = {
+      signature,
+      frameLength,
+      buffers: [
+        upload(module.HEAPF32.slice(request.densitiesPtr / 4, request.densitiesPtr / 4 + densityLength)),
+        upload(densityOffsets),
+        upload(featureLayouts),
+        upload(
+          module.HEAPF32.slice(
+            request.determinantsPtr / 4,
+            request.determinantsPtr / 4 + codebookCount * featureCount * densityCount
+          )
+        ),
+      ],
+    };
+    this.models.set(request.densitiesPtr, model);
+    return model;
+  }
+
+  private reserveBlockBuffers(bytes: number) {
+    if (this.blockBuffers && this.blockBuffers.bytes >= bytes) {
+      return this.blockBuffers;
+    }
+    if (this.blockBuffers) {
+      this.blockBuffers.features.destroy();
+      this.blockBuffers.topn.destroy();
+      this.blockBuffers.readback.destroy();
+    }
+    this.blockBuffers = {
+      bytes,
+      features: this.device.createBuffer({ size: bytes, usage: USAGE_STORAGE | USAGE_COPY_DST }),
+      topn: this.device.createBuffer({ size: bytes, usage: USAGE_STORAGE | USAGE_COPY_SRC }),
+      readback: this.device.createBuffer({ size: bytes, usage: USAGE_MAP_READ | USAGE_COPY_DST }),
+    };
+    return this.blockBuffers;
+  }
+}
@@ -0,0 +1,223 @@
+/**
+ * Channel in shared memory that carries a worker's analysis jobs and their results
+ * Lets `WorkerPool` hand short analyses to a worker without a message per job and back.
+ */
+
+import type { WorkerAnalyzeRequest, WorkerAnalyzeResponse } from '../worker';
+
+/** Header slots, as int32 */
+const STATE = 0;
+const JOB_ID = 1;
+/** Samples of the job's audio */
+const PCM_LENGTH = 2;
+/** Bytes of the job's options, or of the result's information, as JSON */
+const JSON_LENGTH = 3;
+/** Whether the result is an error */
+const FAILED = 4;
+/** Cues of the result, as packed int32 */
+const CUES_LENGTH = 5;
+const HEADER_LENGTH = 8;
+
+/** States of the channel */
+const IDLE = 0;
+const JOB_POSTED = 1;
+const RESULT_POSTED = 2;
+/** The worker is gone; nothing is posted anymore */
+const CLOSED = 3;
+
+/** Default bytes of a channel's data, about 15 seconds of 16 kHz audio and its options */
+export const DEFAULT_JOB_CHANNEL_CAPACITY = 512 * 1024;
+
+/** Information of a result besides its cues */
+interface ResultInfo {
+  stats?: WorkerAnalyzeResponse['stats'];
+  error?: string;
+  memoryBytes?: number;
+}
+
+/** `Atomics.waitAsync()`, missing from the ES2020 library */
+type WaitAsync = (
+  array: Int32Array,
+  index: number,
+  value: number
+) => { async: false; value: string } | { async: true; value: Promise<string> };
+
+function getWaitAsync(): WaitAsync | undefined {
+  return (Atomics as unknown as { waitAsync?: WaitAsync }).waitAsync;
+}
+
+/**
+ * Whether workers can take jobs through a channel: shared memory and `Atomics.waitAsync()`, which
+ * waits without blocking the worker's event loop, so that it still handles cancel requests
+ */
+export function canUseJobChannels(): boolean {
+  return (
+    typeof SharedArrayBuffer !== 'undefined' &&
+    (globalThis as any).crossOriginIsolated === true &&
+    getWaitAsync() !== undefined
+  );
+}
+
+/**
+ * Whether a job can go through a channel
+ * Jobs with callbacks, shared model assets, frames, timings or a speaker profile exchange more
+ * than audio, options and cues, so they are posted as messages.
+ */
+export function canPostThroughChannel(request: WorkerAnalyzeRequest): boolean {
+  return (
+    !request.reportProgress &&
+    !request.reportMouthCues &&
+    !request.reportPreview &&
+    !request.sharedModels &&
+    request.options.speakerProfile === undefined &&
+    request.options.frameRate === undefined &&
+    !request.options.includeTimings
+  );
+}
+
+/**
+ * Single-slot channel over a SharedArrayBuffer; the pool and its worker create their own view
+ * The pool posts a job while the channel is idle, the worker posts its result, and the pool takes
+ * the result, leaving the channel idle again. Each side waits for the other's state change with
+ * `Atomics.waitAsync()`.
+ */
+export class SharedJobChannel {
+  readonly buffer: SharedArrayBuffer;
+  private header: Int32Array;
+  private bytes: Uint8Array;
+
+  /**
+   * @param bufferOrCapacity - A buffer created by another view, or the bytes of data to hold
+   */
+  constructor(bufferOrCapacity: SharedArrayBuffer | number = DEFAULT_JOB_CHANNEL_CAPACITY) {
+    this.buffer = typeof bufferOrCapacity === 'number'
+      ? new SharedArrayBuffer(HEADER_LENGTH * 4 + bufferOrCapacity)
+      : bufferOrCapacity;
+    this.header = new Int32Array(this.buffer, 0, HEADER_LENGTH);
+    this.bytes = new Uint8Array(this.buffer, HEADER_LENGTH * 4);
+  }
+
+  /**
+   * Post a job, if it fits and the channel is idle
+   * The audio is copied; the request keeps it.
+   *
+   * @returns Whether the job was posted; otherwise it has to be posted as a message
+   */
+  postRequest(request: WorkerAnalyzeRequest): boolean {
+    if (Atomics.load(this.header, STATE) !== IDLE) return false;
+
+    const pcmBytes = request.pcm16.length * 2;
+    const json = new TextEncoder().encode(JSON.stringify(request.options));
+    if (pcmBytes + json.length > this.bytes.length) return false;
+
+    new Int16Array(this.buffer, HEADER_LENGTH * 4, request.pcm16.length).set(request.pcm16);
+    this.bytes.set(json, pcmBytes);
+    this.header[JOB_ID] = request.id;
+    this.header[PCM_LENGTH] = request.pcm16.length;
+    this.header[JSON_LENGTH] = json.length;
+    Atomics.store(this.header, STATE, JOB_POSTED);
+    Atomics.notify(this.header, STATE);
+    return true;
+  }
+
+  /**
+   * Wait for the result of the posted job, then leave the channel idle
+   * @returns The result, or null if the channel was closed first
+   */
+  async takeResponse(): Promise<WorkerAnalyzeResponse | null> {
+    await this.waitWhile(JOB_POSTED);
+    if (Atomics.load(this.header, STATE) === CLOSED) return null;
+
+    const id = this.header[JOB_ID];
+    const cuesLength = this.header[CUES_LENGTH];
+    const cuesBytes = cuesLength * 4;
+    // Decoding and slicing copy out of shared memory, so the channel can take the next job
+    const info: ResultInfo = JSON.parse(
+      new TextDecoder().decode(this.bytes.slice(cuesBytes, cuesBytes + this.header[JSON_LENGTH]))
+    );
+    const response: WorkerAnalyzeResponse = this.header[FAILED]
+      ? { type: 'error', id, error: info.error, memoryBytes: info.memoryBytes }
+      : {
+          type: 'result',
+          id,
+          packedMouthCues: new Int32Array(this.buffer, HEADER_LENGTH * 4, cuesLength).slice(),
+          stats: info.stats,
+          memoryBytes: info.memoryBytes
+        };
+
+    Atomics.store(this.header, STATE, IDLE);
+    Atomics.notify(this.header, STATE);
+    return response;
+  }
+
+  /**
+   * Wait for the next job
+   * The audio is a view of the channel, valid until `postResponse()`.
+   */
+  async takeRequest(): Promise<WorkerAnalyzeRequest> {
+    while (Atomics.load(this.header, STATE) !== JOB_POSTED) {
+      await this.waitWhile(Atomics.load(this.header, STATE));
+    }
+
+    const pcmLength = this.header[PCM_LENGTH];
+    const pcmBytes = pcmLength * 2;
+    return {
+      type: 'analyze',
+      id: this.header[JOB_ID],
+      pcm16: new Int16Array(this.buffer, HEADER_LENGTH * 4, pcmLength),
+      options: JSON.parse(
+        new TextDecoder().decode(this.bytes.slice(pcmBytes, pcmBytes + this.header[JSON_LENGTH]))
+      )
+    };
+  }
+
+  /**
+   * Post the result of the job taken
+   * Cues that don't fit fail the job.
+   */
+  postResponse(response: WorkerAnalyzeResponse): void {
+    const cues = response.packedMouthCues ?? new Int32Array(0);
+    let info: ResultInfo = response.type === 'result'
+      ? { stats: response.stats, memoryBytes: response.memoryBytes }
+      : { error: response.error, memoryBytes: response.memoryBytes };
+    let json = new TextEncoder().encode(JSON.stringify(info));
+    let failed = response.type === 'error';
+    let cuesLength = failed ? 0 : cues.length;
+    if (cuesLength * 4 + json.length > this.bytes.length) {
+      info = { error: 'The result exceeds the job channel', memoryBytes: response.memoryBytes };
+      json = new TextEncoder().encode(JSON.stringify(info));
+      failed = true;
+      cuesLength = 0;
+    }
+
+    new Int32Array(this.buffer, HEADER_LENGTH * 4, cuesLength).set(cues.subarray(0, cuesLength));
+    this.bytes.set(json, cuesLength * 4);
+    this.header[FAILED] = failed ? 1 : 0;
+    this.header[CUES_LENGTH] = cuesLength;
+    this.header[JSON_LENGTH] = json.length;
+    Atomics.store(this.header, STATE, RESULT_POSTED);
+    Atomics.notify(this.header, STATE);
+  }
+
+  /**
+   * Stop posting through the channel, once its worker is terminated
+   * A result being waited for resolves to null.
+   */
+  close(): void {
+    Atomics.store(this.header, STATE, CLOSED);
+    Atomics.notify(this.header, STATE);
+  }
+
+  /**
+   * Wait until the state is no longer the given one
+   */
+  private async waitWhile(state: number): Promise<void> {
+    const waitAsync = getWaitAsync()!;
+    while (Atomics.load(this.header, STATE) === state) {
+      const result = waitAsync(this.header, STATE, state);
+      if (result.async) {
+        await result.value;
+      }
+    }
+  }
+}
@@ -0,0 +1,81 @@
+/**
+ * Access to the heap usage and memory budget of the C API
+ * See lipsyncengine_memory_stats and lipsyncengine_set_memory_budget in bridge.h
+ */
+
+import type {
+  LipSyncEngineModule,
+  LipSyncEngineMemoryBudget,
+  LipSyncEngineMemoryStats,
+} from '../types';
+
+/** Values of lipsyncengine_budget_policy */
+const BUDGET_POLICIES = {
+  fail: 0,
+  phonetic: 1,
+} as const;
+
+/** Number of doubles in lipsyncengine_memory_stats */
+const MEMORY_STATS_LENGTH = 6;
+
+/**
+ * Get the last error of the C API
+ * @param module - WASM module
+ * @param fallback - Message to use if there is no error
+ */
+function getLastError(module: LipSyncEngineModule, fallback: string): string {
+  const errorPtr = module._lipsyncengine_get_last_error();
+  return errorPtr ? module.UTF8ToString(errorPtr) : fallback;
+}
+
+/**
+ * Read the heap usage of a module
+ * @param module - WASM module
+ * @returns The heap usage
+ * @throws {Error} If the C API fails
+ */
+export function readMemoryStats(module: LipSyncEngineModule): LipSyncEngineMemoryStats {
+  const statsPtr = module._malloc(MEMORY_STATS_LENGTH * 8);
+  try {
+    if (module._lipsyncengine_get_memory_stats(statsPtr) !== 0) {
+      throw new Error(getLastError(module, 'Reading memory stats failed'));
+    }
+    const [
+      heapBytes,
+      peakHeapBytes,
+      memorySizeBytes,
+      modelBytes,
+      decoderCount,
+      memoryBudgetBytes,
+    ] = module.HEAPF64.subarray(statsPtr / 8, statsPtr / 8 + MEMORY_STATS_LENGTH);
+    return {
+      heapBytes,
+      peakHeapBytes,
+      memorySizeBytes,
+      modelBytes,
+      decoderCount,
+      memoryBudgetBytes,
+    };
+  } finally {
+    module._free(statsPtr);
+  }
+}
+
+/**
+ * Set or remove the memory budget of a module
+ * @param module - WASM module
+ * @param budget - The budget, or null for none
+ * @throws {Error} If the budget is invalid
+ */
+export function applyMemoryBudget(
+  module: LipSyncEngineModule,
+  budget: LipSyncEngineMemoryBudget | null
+): void {
+  const policy = BUDGET_POLICIES[budget?.onExceeded ?? 'fail'];
+  if (policy === undefined) {
+    throw new Error(`Unknown onExceeded policy '${budget?.onExceeded}'`);
+  }
+  if (module._lipsyncengine_set_memory_budget(budget?.bytes ?? 0, policy) !== 0) {
+    throw new Error(getLastError(module, 'Setting the memory budget failed'));
+  }
+}
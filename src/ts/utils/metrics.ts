@@ -0,0 +1,57 @@
+/**
+ * Histograms of the durations in `WorkerPoolMetrics`
+ */
+
+import type { LipSyncEngineHistogram } from '../types';
+
+/** Upper bounds of the buckets in milliseconds, from a millisecond to minutes */
+const BUCKET_BOUNDS = [
+  1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, Infinity,
+];
+
+/**
+ * Counts durations in fixed buckets, so that recording one costs the same however many there are
+ */
+export class Histogram {
+  private counts: number[] = BUCKET_BOUNDS.map(() => 0);
+  private count = 0;
+  private sum = 0;
+  private min = Infinity;
+  private max = 0;
+
+  record(milliseconds: number): void {
+    const value = Math.max(0, milliseconds);
+    this.counts[BUCKET_BOUNDS.findIndex(bound => value <= bound)]++;
+    this.count++;
+    this.sum += value;
+    this.min = Math.min(this.min, value);
+    this.max = Math.max(this.max, value);
+  }
+
+  /**
+   * Get the distribution recorded so far
+   * Percentiles are the upper bounds of the buckets they fall in, at most the maximum.
+   */
+  snapshot(): LipSyncEngineHistogram {
+    const getPercentile = (percentile: number): number => {
+      if (this.count === 0) return 0;
+      const rank = Math.max(1, Math.ceil((percentile / 100) * this.count));
+      let cumulativeCount = 0;
+      for (let i = 0; i < BUCKET_BOUNDS.length; i++) {
+        cumulativeCount += this.counts[i];
+        if (cumulativeCount >= rank) return Math.min(BUCKET_BOUNDS[i], this.max);
+      }
+      return this.max;
+    };
+    return {
+      count: this.count,
+      sum: this.sum,
+      min: this.count ? this.min : 0,
+      max: this.max,
+      p50: getPercentile(50),
+      p90: getPercentile(90),
+      p99: getPercentile(99),
+      buckets: BUCKET_BOUNDS.map((le, i) => ({ le, count: this.counts[i] })),
+    };
+  }
+}
@@ -0,0 +1,569 @@
+/**
+ * Loading of the speech recognition models into the Emscripten file system
+ * The WASM builds don't package the models. Each asset is fetched when first needed, streamed
+ * into the file system and stored in Cache Storage independently of the others.
+ */
+
+import type {
+  LipSyncEngineLanguageModel,
+  LipSyncEngineModelAsset,
+  LipSyncEngineModule,
+  LipSyncEngineOptions,
+  LipSyncEngineMemoryBudget,
+} from '../types';
+import { fetchCached, fetchRangeCached } from './cache';
+import type { FileRange } from './cache';
+
+/** Directory of the file system holding the models, passed to lipsyncengine_init */
+export const MODELS_DIRECTORY = '/models';
+
+/** Files of each asset, relative to the models directory (see LIPSYNCENGINE_WASM_MODEL_FILES) */
+const ASSET_FILES: Record<
+  Exclude<LipSyncEngineModelAsset, 'languageModel' | 'dictionary'>,
+  string[]
+> = {
+  acousticModel: [
+    'acoustic-model/feat.params',
+    'acoustic-model/mdef',
+    'acoustic-model/means',
+    'acoustic-model/noisedict',
+    'acoustic-model/sendump',
+    'acoustic-model/transition_matrices',
+    'acoustic-model/variances',
+  ],
+  phoneLanguageModel: ['en-us-phone.lm.bin'],
+};
+
+/** Files of the `'languageModel'` asset for each variant */
+const LANGUAGE_MODEL_FILES: Record<LipSyncEngineLanguageModel, string[]> = {
+  full: ['en-us.lm.bin'],
+  small: ['en-us-small.lm.bin'],
+  vocabulary: ['vocabulary.lm.bin'],
+};
+
+/** Files of the `'dictionary'` asset for each language model variant */
+const DICTIONARY_FILES: Record<LipSyncEngineLanguageModel, string[]> = {
+  full: ['cmudict-en-us.dict.bin'],
+  small: ['cmudict-en-us.dict.bin'],
+  vocabulary: ['vocabulary.dict.bin'],
+};
+
+/** Values of lipsyncengine_language_model */
+const LANGUAGE_MODELS: Record<LipSyncEngineLanguageModel, number> = {
+  full: 0,
+  small: 1,
+  vocabulary: 2,
+};
+
+function getAssetFiles(
+  asset: LipSyncEngineModelAsset,
+  languageModel: LipSyncEngineLanguageModel
+): string[] {
+  if (asset === 'languageModel') return LANGUAGE_MODEL_FILES[languageModel];
+  if (asset === 'dictionary') return DICTIONARY_FILES[languageModel];
+  return ASSET_FILES[asset];
+}
+
+/**
+ * Select the language model variant of a module
+ * @param module - WASM module
+ * @param languageModel - The variant, whose files a `ModelLoader` for it loads
+ * @throws {Error} If the variant is unknown
+ */
+export function applyLanguageModel(
+  module: LipSyncEngineModule,
+  languageModel: LipSyncEngineLanguageModel
+): void {
+  const value = LANGUAGE_MODELS[languageModel];
+  if (value === undefined || module._lipsyncengine_set_language_model(value) !== 0) {
+    throw new Error(`Unknown language model '${languageModel}'`);
+  }
+}
+
+/**
+ * The files of a model asset in SharedArrayBuffers, by path relative to the models directory
+ * Posting them to a worker shares the bytes instead of copying them.
+ */
+export type SharedModelFiles = Record<string, SharedArrayBuffer>;
+
+/** Whether model files can be shared between workers, which requires cross-origin isolation */
+export function canShareModels(): boolean {
+  return (
+    typeof SharedArrayBuffer !== 'undefined' && (globalThis as any).crossOriginIsolated === true
+  );
+}
+
+/** Assets loaded by default while the engine initializes: those of the default recognizer */
+export const DEFAULT_PRELOADED_ASSETS: LipSyncEngineModelAsset[] = ['dictionary', 'languageModel'];
+
+/**
+ * Get the assets an analysis needs
+ * @param options - Options of the analysis
+ * @param memoryBudget - Memory budget of the module, whose 'phonetic' policy may switch recognizers
+ */
+export function getRequiredAssets(
+  options: Pick<LipSyncEngineOptions, 'recognizer' | 'maxRealTimeFactor'>,
+  memoryBudget?: LipSyncEngineMemoryBudget | null
+): LipSyncEngineModelAsset[] {
+  const assets: LipSyncEngineModelAsset[] = ['acousticModel'];
+  if (options.recognizer === 'phonetic') {
+    assets.push('phoneLanguageModel');
+  } else if (options.recognizer !== 'classifier') {
+    assets.push('dictionary', 'languageModel');
+    // Streams fall back to phonetic recognition to keep up with maxRealTimeFactor
+    if (memoryBudget?.onExceeded === 'phonetic' || options.maxRealTimeFactor) {
+      assets.push('phoneLanguageModel');
+    }
+  }
+  return assets;
+}
+
+/**
+ * Fetch a model file and read it, preferring its gzip copy (`<url>.gz`), which is decompressed as
+ * it arrives, so that the compressed file is never held as a whole
+ * Falls back to the file itself if the runtime lacks `DecompressionStream`, or if the copy is
+ * missing or can't be decompressed, e.g. in self-hosted model directories without the copies.
+ * @param read - Reads the response's body; called again for the fallback if it fails
+ */
+async function fetchModelFile<T>(
+  url: string,
+  useCache: boolean,
+  read: (response: Response) => Promise<T>
+): Promise<T> {
+  if (typeof DecompressionStream !== 'undefined') {
+    try {
+      const response = await fetchCached(`${url}.gz`, useCache);
+      if (response.body) {
+        return await read(new Response(response.body.pipeThrough(new DecompressionStream('gzip'))));
+      }
+    } catch {
+      // Fetch the file itself
+    }
+  }
+  return read(await fetchCached(url, useCache));
+}
+
+/**
+ * Fetch a file into the file system, writing the chunks as they arrive
+ */
+function fetchFile(
+  module: LipSyncEngineModule,
+  url: string,
+  path: string,
+  useCache: boolean
+): Promise<void> {
+  return fetchModelFile(url, useCache, (response) => writeFile(module, response, path));
+}
+
+/**
+ * Write a response's body into the file system, chunk by chunk
+ * Writes a temporary file first, so that decoders never read a partial one.
+ */
+async function writeFile(module: LipSyncEngineModule, response: Response, path: string): Promise<void> {
+  const temporaryPath = `${path}.part`;
+  const stream = module.FS.open(temporaryPath, 'w');
+  try {
+    if (response.body) {
+      const reader = response.body.getReader();
+      for (;;) {
+        const { done, value } = await reader.read();
+        if (done) break;
+        module.FS.write(stream, value, 0, value.length);
+      }
+    } else {
+      const data = new Uint8Array(await response.arrayBuffer());
+      module.FS.write(stream, data, 0, data.length);
+    }
+  } catch (error) {
+    module.FS.close(stream);
+    module.FS.unlink(temporaryPath);
+    throw error;
+  }
+  module.FS.close(stream);
+  module.FS.rename(temporaryPath, path);
+}
+
+/**
+ * Write chunks into a file of the file system, through a temporary file like `writeFile`
+ */
+function writeChunks(module: LipSyncEngineModule, chunks: Uint8Array[], path: string): void {
+  const temporaryPath = `${path}.part`;
+  const stream = module.FS.open(temporaryPath, 'w');
+  try {
+    chunks.forEach((chunk) => module.FS.write(stream, chunk, 0, chunk.length));
+  } catch (error) {
+    module.FS.close(stream);
+    module.FS.unlink(temporaryPath);
+    throw error;
+  }
+  module.FS.close(stream);
+  module.FS.rename(temporaryPath, path);
+}
+
+/** Where the n-gram arrays of a language model file lie, see lipsyncengine_language_model_layout */
+interface LanguageModelLayout {
+  ngramOffset: number;
+  ngramSize: number;
+  pageSize: number;
+  pageCount: number;
+}
+
+/** Bytes fetched from the start of a language model file to find its layout */
+const LANGUAGE_MODEL_HEAD_SIZE = 4096;
+
+/** Delays before fetching a page of a paged language model again after it failed, in ms */
+const PAGE_RETRY_DELAYS_MS = [1000, 5000, 30000];
+
+/**
+ * Prepare paged loading of a language model from the head of its file
+ * @returns The layout of the file, or null if it isn't a binary trie model
+ */
+function pageLanguageModel(
+  module: LipSyncEngineModule,
+  languageModel: number,
+  head: Uint8Array
+): LanguageModelLayout | null {
+  const headPtr = module._malloc(head.length);
+  const layoutPtr = module._malloc(16);
+  try {
+    module.HEAPU8.set(head, headPtr);
+    if (module._lipsyncengine_page_language_model(languageModel, headPtr, head.length, layoutPtr) !== 0) {
+      return null;
+    }
+    const index = layoutPtr / 4;
+    return {
+      ngramOffset: module.HEAP32[index],
+      ngramSize: module.HEAP32[index + 1],
+      pageSize: module.HEAP32[index + 2],
+      pageCount: module.HEAP32[index + 3],
+    };
+  } finally {
+    module._free(headPtr);
+    module._free(layoutPtr);
+  }
+}
+
+/**
+ * Fetch a file into a SharedArrayBuffer
+ */
+function fetchShared(url: string, useCache: boolean): Promise<SharedArrayBuffer> {
+  return fetchModelFile(url, useCache, readShared);
+}
+
+/**
+ * Read a response's body into a SharedArrayBuffer
+ */
+async function readShared(response: Response): Promise<SharedArrayBuffer> {
+  // Content-Length may be the compressed size, so collect the chunks before sizing the buffer
+  const chunks: Uint8Array[] = [];
+  let size = 0;
+  if (response.body) {
+    const reader = response.body.getReader();
+    for (;;) {
+      const { done, value } = await reader.read();
+      if (done) break;
+      chunks.push(value);
+      size += value.length;
+    }
+  } else {
+    const data = new Uint8Array(await response.arrayBuffer());
+    chunks.push(data);
+    size = data.length;
+  }
+
+  const buffer = new SharedArrayBuffer(size);
+  const bytes = new Uint8Array(buffer);
+  let offset = 0;
+  for (const chunk of chunks) {
+    bytes.set(chunk, offset);
+    offset += chunk.length;
+  }
+  return buffer;
+}
+
+/**
+ * Holds one copy of each model file in shared memory for the workers of a pool
+ * The workers' file systems use the shared bytes in place, so the files take memory once
+ * however many workers there are. The pools and the `LipSyncEngine` of a page acquire the same
+ * store for the same files (see `acquire()`), so using both APIs doesn't load the models twice.
+ */
+export class SharedModelStore {
+  /** The acquired stores, by `getStoreKey()` */
+  private static stores = new Map<string, SharedModelStore>();
+
+  private loads = new Map<LipSyncEngineModelAsset, Promise<SharedModelFiles>>();
+  private loaded = new Map<LipSyncEngineModelAsset, SharedModelFiles>();
+  /** The users that acquired the store and haven't released it */
+  private users = 0;
+
+  /**
+   * Get the page's store of the files, creating it if no one holds one
+   * Call `release()` once done with it.
+   */
+  static acquire(
+    modelsUrl: string,
+    useCache = true,
+    languageModel: LipSyncEngineLanguageModel = 'full'
+  ): SharedModelStore {
+    const key = getStoreKey(modelsUrl, useCache, languageModel);
+    let store = this.stores.get(key);
+    if (!store) {
+      store = new SharedModelStore(modelsUrl, useCache, languageModel);
+      this.stores.set(key, store);
+    }
+    store.users++;
+    return store;
+  }
+
+  /**
+   * Release an acquired store; the last release drops it, so its files are freed once no module
+   * uses them anymore
+   */
+  release(): void {
+    if (--this.users > 0) return;
+    const key = getStoreKey(this.modelsUrl, this.useCache, this.languageModel);
+    if (SharedModelStore.stores.get(key) === this) {
+      SharedModelStore.stores.delete(key);
+    }
+  }
+
+  /**
+   * @param modelsUrl - URL of the directory containing the model files
+   * @param useCache - Whether to keep the files in Cache Storage across page loads
+   * @param languageModel - Variant of the language model to load as the `'languageModel'` asset,
+   *   which also selects the `'dictionary'` asset's files
+   */
+  constructor(
+    private modelsUrl: string,
+    private useCache = true,
+    private languageModel: LipSyncEngineLanguageModel = 'full'
+  ) {}
+
+  /**
+   * Load an asset, or wait for it if it is already loading
+   * A failed load is retried by the next call.
+   */
+  load(asset: LipSyncEngineModelAsset): Promise<SharedModelFiles> {
+    let promise = this.loads.get(asset);
+    if (!promise) {
+      const baseUrl = this.modelsUrl.replace(/\/$/, '');
+      promise = Promise.all(
+        getAssetFiles(asset, this.languageModel).map(
+          async (file): Promise<[string, SharedArrayBuffer]> => [
+            file,
+            await fetchShared(`${baseUrl}/${file}`, this.useCache),
+          ]
+        )
+      ).then((entries) => {
+        const files: SharedModelFiles = Object.fromEntries(entries);
+        this.loaded.set(asset, files);
+        return files;
+      });
+      promise.catch(() => this.loads.delete(asset));
+      this.loads.set(asset, promise);
+    }
+    return promise;
+  }
+
+  /**
+   * Load several assets in parallel
+   */
+  async loadAll(assets: LipSyncEngineModelAsset[]): Promise<void> {
+    await Promise.all(assets.map((asset) => this.load(asset)));
+  }
+
+  /**
+   * Start loading assets without waiting for them
+   */
+  preload(assets: LipSyncEngineModelAsset[]): void {
+    assets.forEach((asset) => this.load(asset).catch(() => {}));
+  }
+
+  /**
+   * Get the files of an asset if it has finished loading
+   */
+  get(asset: LipSyncEngineModelAsset): SharedModelFiles | undefined {
+    return this.loaded.get(asset);
+  }
+}
+
+function getStoreKey(
+  modelsUrl: string,
+  useCache: boolean,
+  languageModel: LipSyncEngineLanguageModel
+): string {
+  return `${modelsUrl.replace(/\/$/, '')} ${useCache} ${languageModel}`;
+}
+
+/**
+ * Loads the model assets of one module, each at most once
+ */
+export class ModelLoader {
+  private loads = new Map<LipSyncEngineModelAsset, Promise<void>>();
+
+  /**
+   * @param module - WASM module
+   * @param modelsUrl - URL of the directory containing the model files
+   * @param useCache - Whether to keep the files in Cache Storage across page loads
+   * @param languageModel - Variant of the language model to load as the `'languageModel'` asset,
+   *   which also selects the `'dictionary'` asset's files
+   * @param pagedLanguageModel - Whether to load the language model's n-grams page by page after
+   *   the rest of it, with range requests, so that analyses can start before all of it arrives
+   * @param sharedModels - A store of the same files to take the assets from instead of fetching
+   *   them, except a paged language model
+   */
+  constructor(
+    private module: LipSyncEngineModule,
+    private modelsUrl: string,
+    private useCache = true,
+    private languageModel: LipSyncEngineLanguageModel = 'full',
+    private pagedLanguageModel = false,
+    private sharedModels: SharedModelStore | null = null
+  ) {}
+
+  /**
+   * Resolves once the module can be called into; pages of a paged language model are only
+   * handed to it then. Set by workers, whose analyses may suspend in the JSPI build.
+   */
+  whenIdle: () => Promise<void> = () => Promise.resolve();
+
+  /**
+   * Load an asset, or wait for it if it is already loading
+   * A failed load is retried by the next call.
+   */
+  load(asset: LipSyncEngineModelAsset): Promise<void> {
+    let promise = this.loads.get(asset);
+    if (!promise && this.sharedModels && !(asset === 'languageModel' && this.pagedLanguageModel)) {
+      promise = this.sharedModels.load(asset).then((files) => this.writeShared(files));
+      promise.catch(() => this.loads.delete(asset));
+      this.loads.set(asset, promise);
+    }
+    if (!promise) {
+      const baseUrl = this.modelsUrl.replace(/\/$/, '');
+      // The files of an asset are fetched in parallel
+      promise = Promise.all(
+        getAssetFiles(asset, this.languageModel).map(async (file) => {
+          const path = `${MODELS_DIRECTORY}/${file}`;
+          this.module.FS.mkdirTree(path.slice(0, path.lastIndexOf('/')));
+          const url = `${baseUrl}/${file}`;
+          if (asset === 'languageModel' && this.pagedLanguageModel) {
+            if (await this.fetchPagedLanguageModel(url, path)) return;
+          }
+          await fetchFile(this.module, url, path, this.useCache);
+        })
+      ).then(() => undefined);
+      promise.catch(() => this.loads.delete(asset));
+      this.loads.set(asset, promise);
+    }
+    return promise;
+  }
+
+  /**
+   * Load several assets in parallel
+   */
+  async loadAll(assets: LipSyncEngineModelAsset[]): Promise<void> {
+    await Promise.all(assets.map((asset) => this.load(asset)));
+  }
+
+  /**
+   * Fetch the language model file into the file system without its n-gram arrays, which make up
+   * most of it, and fetch those page by page in the background, the pages that analyses needed
+   * first
+   * Each range is stored in Cache Storage on its own.
+   * @returns false if the server doesn't answer range requests or the file isn't a binary trie
+   *   model, which is then fetched as a whole
+   */
+  private async fetchPagedLanguageModel(url: string, path: string): Promise<boolean> {
+    const head = await fetchRangeCached(url, 0, LANGUAGE_MODEL_HEAD_SIZE, this.useCache);
+    if (!head) return false;
+    const languageModel = LANGUAGE_MODELS[this.languageModel];
+    await this.whenIdle();
+    const layout = pageLanguageModel(this.module, languageModel, head.bytes);
+    if (!layout) return false;
+
+    // From here on, the engine reads the file as a paged one, so failures aren't fallen back from
+    const ngramEnd = layout.ngramOffset + layout.ngramSize;
+    const [prefix, suffix] = await Promise.all([
+      fetchRangeCached(url, 0, layout.ngramOffset, this.useCache),
+      fetchRangeCached(url, ngramEnd, head.fileSize, this.useCache),
+    ]);
+    if (!prefix || !suffix) {
+      throw new Error(`Failed to fetch ${url}: range requests stopped being answered`);
+    }
+    writeChunks(this.module, [prefix.bytes, suffix.bytes], path);
+
+    this.fetchLanguageModelPages(url, languageModel, layout).catch((error) => {
+      console.warn('Fetching the language model stopped, recognizing with part of it:', error);
+    });
+    return true;
+  }
+
+  /**
+   * Fetch the pages of a paged language model until all have arrived
+   */
+  private async fetchLanguageModelPages(
+    url: string,
+    languageModel: number,
+    layout: LanguageModelLayout
+  ): Promise<void> {
+    const ngramEnd = layout.ngramOffset + layout.ngramSize;
+    for (;;) {
+      await this.whenIdle();
+      const index = this.module._lipsyncengine_next_language_model_page(languageModel);
+      if (index < 0) return;
+
+      const start = layout.ngramOffset + index * layout.pageSize;
+      const end = Math.min(start + layout.pageSize, ngramEnd);
+      let page: FileRange | null = null;
+      for (let attempt = 0; !page; ++attempt) {
+        try {
+          page = await fetchRangeCached(url, start, end, this.useCache);
+          if (!page) throw new Error(`Failed to fetch ${url}: range requests stopped being answered`);
+        } catch (error) {
+          if (attempt >= PAGE_RETRY_DELAYS_MS.length) throw error;
+          await new Promise((resolve) => setTimeout(resolve, PAGE_RETRY_DELAYS_MS[attempt]));
+        }
+      }
+
+      // Decoding threads read the page once it is marked loaded
+      await this.whenIdle();
+      const pagePtr = this.module._lipsyncengine_language_model_page(languageModel, index);
+      if (!pagePtr) return;
+      this.module.HEAPU8.set(page.bytes, pagePtr);
+      this.module._lipsyncengine_set_language_model_page_loaded(languageModel, index);
+    }
+  }
+
+  /**
+   * Use the files of an asset from a `SharedModelStore` instead of fetching them
+   * The file system uses the shared bytes in place; the files are never written to.
+   */
+  install(asset: LipSyncEngineModelAsset, files: SharedModelFiles): void {
+    if (this.loads.has(asset)) return;
+    this.writeShared(files);
+    this.loads.set(asset, Promise.resolve());
+  }
+
+  /**
+   * Write the files of an asset from shared memory to the file system, using the bytes in place
+   */
+  private writeShared(files: SharedModelFiles): void {
+    Object.entries(files).forEach(([file, buffer]) => {
+      const path = `${MODELS_DIRECTORY}/${file}`;
+      this.module.FS.mkdirTree(path.slice(0, path.lastIndexOf('/')));
+      const data = new Uint8Array(buffer);
+      const stream = this.module.FS.open(path, 'w');
+      // canOwn: the file takes the view instead of copying it
+      this.module.FS.write(stream, data, 0, data.length, 0, true);
+      this.module.FS.close(stream);
+    });
+  }
+
+  /**
+   * Start loading assets without waiting for them
+   * Failures surface when an analysis waits for the asset.
+   */
+  preload(assets: LipSyncEngineModelAsset[]): void {
+    assets.forEach((asset) => this.load(asset).catch(() => {}));
+  }
+}
@@ -0,0 +1,102 @@
+/**
+ * Decoding of the binary mouth-cue format
+ * See lipsyncengine_mouth_cue in bridge.h
+ */
+
+import type { LipSyncEngineModule, LipSyncEngineResult, MouthCue } from '../types';
+
+/** Mouth shapes by their index in the binary format */
+const SHAPES = 'ABCDEFGHX';
+
+/** Size of one cue in 32-bit words: start, end, shape (plus padding) */
+export const CUE_STRIDE = 3;
+
+/**
+ * Read an array of binary mouth cues from WASM memory
+ * @param module - WASM module owning the memory
+ * @param cuesPtr - Pointer to the first cue
+ * @param cueCount - Number of cues
+ * @returns Mouth cues with times in seconds
+ */
+export function readMouthCues(
+  module: LipSyncEngineModule,
+  cuesPtr: number,
+  cueCount: number
+): MouthCue[] {
+  return decodeMouthCues(module.HEAP32.subarray(cuesPtr / 4, cuesPtr / 4 + cueCount * CUE_STRIDE));
+}
+
+/**
+ * Copy an array of binary mouth cues out of WASM memory, e.g. to transfer it to another thread
+ * @param module - WASM module owning the memory
+ * @param cuesPtr - Pointer to the first cue
+ * @param cueCount - Number of cues
+ * @returns The cues' words, `CUE_STRIDE` per cue
+ */
+export function copyMouthCues(
+  module: LipSyncEngineModule,
+  cuesPtr: number,
+  cueCount: number
+): Int32Array {
+  return module.HEAP32.slice(cuesPtr / 4, cuesPtr / 4 + cueCount * CUE_STRIDE);
+}
+
+/**
+ * Decode binary mouth cues
+ * @param words - The cues' words, `CUE_STRIDE` per cue
+ * @returns Mouth cues with times in seconds
+ */
+export function decodeMouthCues(words: Int32Array): MouthCue[] {
+  const cueCount = Math.floor(words.length / CUE_STRIDE);
+  const mouthCues: MouthCue[] = new Array(cueCount);
+
+  for (let i = 0; i < cueCount; i++) {
+    const offset = i * CUE_STRIDE;
+    mouthCues[i] = {
+      start: words[offset] / 100,
+      end: words[offset + 1] / 100,
+      // The shape is the low byte of the third word (WASM is little-endian)
+      value: SHAPES[words[offset + 2] & 0xff],
+    };
+  }
+
+  return mouthCues;
+}
+
+/**
+ * Encode mouth cues in the binary format, the reverse of `decodeMouthCues()`
+ * @param mouthCues - Mouth cues with times in seconds
+ * @returns The cues' words, `CUE_STRIDE` per cue
+ */
+export function encodeMouthCues(mouthCues: MouthCue[]): Int32Array {
+  const words = new Int32Array(mouthCues.length * CUE_STRIDE);
+  mouthCues.forEach((cue, i) => {
+    const offset = i * CUE_STRIDE;
+    words[offset] = Math.round(cue.start * 100);
+    words[offset + 1] = Math.round(cue.end * 100);
+    words[offset + 2] = SHAPES.indexOf(cue.value);
+  });
+  return words;
+}
+
+/**
+ * Create a result whose `mouthCues` are decoded from binary cues on first access
+ * Results with many cues then cost one buffer to receive from a worker, not an object per cue.
+ * @param words - The cues' words, `CUE_STRIDE` per cue
+ */
+export function createPackedResult(words: Int32Array): LipSyncEngineResult {
+  let mouthCues: MouthCue[] | null = null;
+  const result = { packedMouthCues: words } as LipSyncEngineResult;
+  Object.defineProperty(result, 'mouthCues', {
+    get: () => {
+      if (!mouthCues) mouthCues = decodeMouthCues(words);
+      return mouthCues;
+    },
+    set: (value: MouthCue[]) => {
+      mouthCues = value;
+    },
+    enumerable: true,
+    configurable: true,
+  });
+  return result;
+}
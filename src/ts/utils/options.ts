@@ -0,0 +1,317 @@
+/**
+ * Encoding of analysis options for the C API
+ * See lipsyncengine_options in bridge.h
+ */
+
+import type {
+  LipSyncEngineModule,
+  LipSyncEngineOptions,
+  LipSyncEngineStage,
+  LipSyncEngineStats,
+  MouthCue,
+  TimedLabel,
+} from '../types';
+import { readMouthCues } from './mouthCues';
+
+/** Mouth shapes by their bit in the target shape mask */
+const SHAPES = 'ABCDEFGHX';
+
+/** The basic shapes A-F, which are always used */
+const BASIC_SHAPE_MASK = 0x3f;
+
+/** Values of lipsyncengine_recognizer */
+const RECOGNIZERS = {
+  pocketSphinx: 0,
+  phonetic: 1,
+  classifier: 2,
+} as const;
+
+/** Values of lipsyncengine_profile */
+const PROFILES = {
+  offline: 0,
+  balanced: 1,
+  realtime: 2,
+  realtimeDownsampled: 3,
+  offlineOneBest: 4,
+  streaming: 5,
+} as const;
+
+/** Values of lipsyncengine_dialog_mode */
+const DIALOG_MODES = {
+  biased: 0,
+  strict: 1,
+  verbatim: 2,
+} as const;
+
+/**
+ * Size of lipsyncengine_options in bytes:
+ * target_shapes, recognizer, profile, stats, cancel_flag, timeout_milliseconds,
+ * progress_callback, progress_context, dialog_mode, yield_interval_milliseconds, cue_callback,
+ * cue_context, speaker, preview_callback, preview_context, max_real_time_factor and timings
+ */
+const OPTIONS_SIZE = 68;
+
+/** Size of lipsyncengine_timings in bytes: word_count, words, phone_count and phones */
+const TIMINGS_SIZE = 16;
+
+/** Size of a lipsyncengine_timed_label in 32-bit words: start, end and text */
+const LABEL_STRIDE = 3;
+
+/** Stages in the order of lipsyncengine_stage */
+const STAGES: readonly LipSyncEngineStage[] = [
+  'dcRemoval',
+  'resampling',
+  'voiceActivityDetection',
+  'featureExtraction',
+  'wordRecognition',
+  'alignment',
+  'shapeRules',
+  'roughAnimation',
+  'timingOptimization',
+  'pauseAnimation',
+  'tweening',
+  'targetShapeConversion',
+  'export',
+];
+
+/** Number of doubles in lipsyncengine_stats: the stage times, then the total and 9 counters */
+const STATS_LENGTH = STAGES.length + 10;
+
+/**
+ * Get the target shape mask for the given extended shapes
+ * @param extendedShapes - Extended shapes to use in addition to the basic shapes, such as 'GHX'
+ * @returns Bitmask with bit i set for shape i
+ * @throws {Error} If extendedShapes contains an unknown shape
+ */
+export function getTargetShapeMask(extendedShapes = ''): number {
+  let mask = BASIC_SHAPE_MASK;
+  for (const shape of extendedShapes) {
+    const index = SHAPES.indexOf(shape);
+    if (index < 0) {
+      throw new Error(`Unknown mouth shape '${shape}' in extendedShapes`);
+    }
+    mask |= 1 << index;
+  }
+  return mask;
+}
+
+/**
+ * Write analysis options to WASM memory
+ * If stats are to be collected, the lipsyncengine_stats struct receiving them follows the options,
+ * and if timings are to be included, the lipsyncengine_timings struct receiving them follows that.
+ * @param module - WASM module owning the memory
+ * @param options - Options to encode; only the options handled by the C API are used
+ * @param cancelFlagPtr - Pointer to an int32 that cancels the analysis once non-zero, or 0 for none
+ * @param progressCallbackPtr - Table index of a
+ *   `void (double progress, double remaining_milliseconds, void* context)` function
+ *   receiving the progress, or 0 for none (see `addProgressCallback()`)
+ * @param yieldIntervalMs - How often the analysis yields to the event loop, or 0 for never; only
+ *   for analyses called through the JSPI build's exports
+ * @param cueCallbackPtr - Table index of a
+ *   `void (const lipsyncengine_mouth_cue* cues, int32_t cue_count, void* context)` function
+ *   receiving the final mouth cues, or 0 for none (see `addMouthCueCallback()`)
+ * @param speakerHandle - Speaker profile the analysis starts from and updates, or 0 for none
+ *   (see `createSpeaker()`)
+ * @param previewCallbackPtr - Table index of a mouth cue callback receiving the preview of the
+ *   animation, or 0 for none (see `addMouthCueCallback()`)
+ * @returns Pointer to a lipsyncengine_options struct, to be freed by the caller with _free()
+ */
+export function allocateOptions(
+  module: LipSyncEngineModule,
+  options: Pick<
+    LipSyncEngineOptions,
+    | 'extendedShapes'
+    | 'recognizer'
+    | 'profile'
+    | 'dialogMode'
+    | 'collectStats'
+    | 'includeTimings'
+    | 'timeoutMs'
+    | 'maxRealTimeFactor'
+  >,
+  cancelFlagPtr = 0,
+  progressCallbackPtr = 0,
+  yieldIntervalMs = 0,
+  cueCallbackPtr = 0,
+  speakerHandle = 0,
+  previewCallbackPtr = 0
+): number {
+  const mask = getTargetShapeMask(options.extendedShapes);
+  const recognizer = RECOGNIZERS[options.recognizer ?? 'pocketSphinx'];
+  if (recognizer === undefined) {
+    throw new Error(`Unknown recognizer '${options.recognizer}'`);
+  }
+  const profile = PROFILES[options.profile ?? 'offline'];
+  if (profile === undefined) {
+    throw new Error(`Unknown profile '${options.profile}'`);
+  }
+  const dialogMode = DIALOG_MODES[options.dialogMode ?? 'biased'];
+  if (dialogMode === undefined) {
+    throw new Error(`Unknown dialog mode '${options.dialogMode}'`);
+  }
+  const timeoutMs = Math.ceil(options.timeoutMs ?? 0);
+  if (!(timeoutMs >= 0)) {
+    throw new Error('timeoutMs must not be negative');
+  }
+  const maxRealTimeFactor = options.maxRealTimeFactor ?? 0;
+  if (!(maxRealTimeFactor >= 0)) {
+    throw new Error('maxRealTimeFactor must not be negative');
+  }
+
+  const statsSize = options.collectStats ? STATS_LENGTH * 8 : 0;
+  const timingsSize = options.includeTimings ? TIMINGS_SIZE : 0;
+  const optionsPtr = module._malloc(OPTIONS_SIZE + statsSize + timingsSize);
+  const statsPtr = statsSize ? optionsPtr + OPTIONS_SIZE : 0;
+  const timingsPtr = timingsSize ? optionsPtr + OPTIONS_SIZE + statsSize : 0;
+  module.HEAP32.set(
+    [
+      mask,
+      recognizer,
+      profile,
+      statsPtr,
+      cancelFlagPtr,
+      Math.min(timeoutMs, 0x7fffffff),
+      progressCallbackPtr,
+      0,
+      dialogMode,
+      yieldIntervalMs,
+      cueCallbackPtr,
+      0,
+      speakerHandle,
+      previewCallbackPtr,
+      0,
+    ],
+    optionsPtr / 4
+  );
+  module.HEAPF32[optionsPtr / 4 + 15] = maxRealTimeFactor;
+  module.HEAP32[optionsPtr / 4 + 16] = timingsPtr;
+  if (statsPtr) {
+    module.HEAPF64.fill(0, statsPtr / 8, statsPtr / 8 + STATS_LENGTH);
+  }
+  if (timingsPtr) {
+    module.HEAP32.fill(0, timingsPtr / 4, (timingsPtr + TIMINGS_SIZE) / 4);
+  }
+  return optionsPtr;
+}
+
+/**
+ * Make a progress callback callable from WASM
+ * @param module - WASM module to call it
+ * @param callback - Receives the progress from 0 to 1 and the estimated milliseconds remaining
+ * @returns Table index to pass to allocateOptions(), to be freed by the caller with
+ *   removeFunction()
+ */
+export function addProgressCallback(
+  module: LipSyncEngineModule,
+  callback: (progress: number, remainingMs: number) => void
+): number {
+  return module.addFunction(
+    (progress: number, remainingMs: number) => callback(progress, remainingMs),
+    'vddi'
+  );
+}
+
+/**
+ * Make a mouth cue callback callable from WASM
+ * @param module - WASM module to call it
+ * @param callback - Receives the mouth cues that became final, in seconds
+ * @returns Table index to pass to allocateOptions(), to be freed by the caller with
+ *   removeFunction()
+ */
+export function addMouthCueCallback(
+  module: LipSyncEngineModule,
+  callback: (mouthCues: MouthCue[]) => void
+): number {
+  return module.addFunction(
+    (cuesPtr: number, cueCount: number) => callback(readMouthCues(module, cuesPtr, cueCount)),
+    'viii'
+  );
+}
+
+/**
+ * Read the stats of a successful analysis
+ * @param module - WASM module owning the memory
+ * @param optionsPtr - Options returned by allocateOptions()
+ * @returns The stats, or undefined if the options don't collect any
+ */
+export function readStats(
+  module: LipSyncEngineModule,
+  optionsPtr: number
+): LipSyncEngineStats | undefined {
+  const statsPtr = module.HEAP32[optionsPtr / 4 + 3];
+  if (!statsPtr) {
+    return undefined;
+  }
+
+  const values = module.HEAPF64.subarray(statsPtr / 8, statsPtr / 8 + STATS_LENGTH);
+  const stages = {} as Record<LipSyncEngineStage, number>;
+  STAGES.forEach((stage, index) => {
+    stages[stage] = values[index];
+  });
+  const [
+    totalMs,
+    utteranceCount,
+    frameCount,
+    hmmEvaluationCount,
+    decoderCacheHits,
+    decoderCacheMisses,
+    dialogModelCacheHits,
+    dialogModelCacheMisses,
+    utteranceCacheHits,
+    utteranceCacheMisses,
+  ] = values.subarray(STAGES.length);
+  return {
+    stages,
+    totalMs,
+    utteranceCount,
+    frameCount,
+    hmmEvaluationsPerFrame: frameCount ? hmmEvaluationCount / frameCount : 0,
+    decoderCacheHits,
+    decoderCacheMisses,
+    dialogModelCacheHits,
+    dialogModelCacheMisses,
+    utteranceCacheHits,
+    utteranceCacheMisses,
+  };
+}
+
+/**
+ * Read the words and phones of a successful analysis, freeing them in WASM memory
+ * Call it after every successful analysis with options including timings, or they leak.
+ * @param module - WASM module owning the memory
+ * @param optionsPtr - Options returned by allocateOptions()
+ * @returns The words and phones, or undefined if the options don't include them or the analysis
+ *   failed
+ */
+export function readTimings(
+  module: LipSyncEngineModule,
+  optionsPtr: number
+): { words: TimedLabel[]; phones: TimedLabel[] } | undefined {
+  const timingsPtr = module.HEAP32[optionsPtr / 4 + 16];
+  const [wordCount, wordsPtr, phoneCount, phonesPtr] = timingsPtr
+    ? module.HEAP32.subarray(timingsPtr / 4, (timingsPtr + TIMINGS_SIZE) / 4)
+    : [0, 0, 0, 0];
+  if (!wordsPtr) {
+    return undefined;
+  }
+
+  const readLabels = (labelsPtr: number, count: number): TimedLabel[] => {
+    const labels: TimedLabel[] = new Array(count);
+    for (let i = 0; i < count; i++) {
+      const offset = labelsPtr / 4 + i * LABEL_STRIDE;
+      labels[i] = {
+        start: module.HEAP32[offset] / 100,
+        end: module.HEAP32[offset + 1] / 100,
+        value: module.UTF8ToString(module.HEAP32[offset + 2]),
+      };
+    }
+    return labels;
+  };
+  try {
+    return { words: readLabels(wordsPtr, wordCount), phones: readLabels(phonesPtr, phoneCount) };
+  } finally {
+    // The labels and their text are one allocation
+    module._lipsyncengine_free(wordsPtr);
+    module.HEAP32[timingsPtr / 4 + 1] = 0;
+  }
+}
@@ -0,0 +1,189 @@
+/**
+ * Caching of analysis results by a hash of their audio and everything else that affects them
+ * Lets pipelines that resubmit identical audio (re-imports, undo, asset checks) skip the analysis.
+ */
+
+import type {
+  LipSyncEngineCachedResult,
+  LipSyncEngineLanguageModel,
+  LipSyncEngineMemoryBudget,
+  LipSyncEngineOptions,
+  LipSyncEngineResultCache,
+} from '../types';
+import packageJson from '../../../package.json';
+
+/**
+ * Hash 32-bit words with two independent lanes, into 16 hex digits
+ * Not cryptographic; 64 bits make accidental collisions between cached clips negligible.
+ */
+function hashWords(count: number, word: (index: number) => number): string {
+  let h1 = 0x811c9dc5 ^ count;
+  let h2 = 0x9747b28c;
+  for (let i = 0; i < count; i++) {
+    const value = word(i);
+    h1 = Math.imul(h1 ^ value, 0x5bd1e995);
+    h1 ^= h1 >>> 15;
+    h2 = Math.imul(h2 + value, 0x27d4eb2f);
+    h2 = (h2 << 13) | (h2 >>> 19);
+  }
+  return (finalize(h1) >>> 0).toString(16).padStart(8, '0')
+    + (finalize(h2 ^ h1) >>> 0).toString(16).padStart(8, '0');
+}
+
+/** Murmur3's finalizer, spreading every input bit over the whole hash */
+function finalize(h: number): number {
+  h ^= h >>> 16;
+  h = Math.imul(h, 0x85ebca6b);
+  h ^= h >>> 13;
+  h = Math.imul(h, 0xc2b2ae35);
+  return h ^ (h >>> 16);
+}
+
+/**
+ * Key of the result of an analysis
+ * Covers the audio, the options that affect the mouth cues, the pool settings that can change
+ * the models and the package version.
+ *
+ * @param pcm16 - Audio of the analysis
+ * @param options - Options of the analysis
+ * @param settings - Language model and memory budget of the workers
+ */
+export function getResultCacheKey(
+  pcm16: Int16Array,
+  options: LipSyncEngineOptions,
+  settings: { languageModel: LipSyncEngineLanguageModel; memoryBudget?: LipSyncEngineMemoryBudget }
+): string {
+  // Two samples per word
+  const audioHash = hashWords(
+    Math.ceil(pcm16.length / 2),
+    (i) => (pcm16[2 * i] & 0xffff) | ((pcm16[2 * i + 1] ?? 0) << 16)
+  );
+  const extendedShapes = [...new Set((options.extendedShapes ?? '').toUpperCase())].sort().join('');
+  const description = JSON.stringify([
+    packageJson.version,
+    options.sampleRate || 16000,
+    options.dialogText || '',
+    extendedShapes,
+    options.recognizer ?? 'pocketSphinx',
+    options.profile ?? 'offline',
+    options.dialogMode ?? 'biased',
+    settings.languageModel,
+    settings.memoryBudget ?? null,
+  ]);
+  const optionsHash = hashWords(description.length, (i) => description.charCodeAt(i));
+  return `${audioHash}-${pcm16.length}-${optionsHash}`;
+}
+
+/**
+ * Result cache in memory, dropping the least recently used results beyond a size
+ */
+export class MemoryResultCache implements LipSyncEngineResultCache {
+  /** Results in order of use, the most recent last */
+  private results = new Map<string, LipSyncEngineCachedResult>();
+  private bytes = 0;
+
+  /**
+   * @param maxBytes - Total size of the stored cues (default: 16 MB, about a million cues)
+   */
+  constructor(private readonly maxBytes = 16 * 1024 * 1024) {}
+
+  get(key: string): LipSyncEngineCachedResult | undefined {
+    const result = this.results.get(key);
+    if (result) {
+      this.results.delete(key);
+      this.results.set(key, result);
+    }
+    return result;
+  }
+
+  set(key: string, result: LipSyncEngineCachedResult): void {
+    this.delete(key);
+    if (result.packedMouthCues.byteLength > this.maxBytes) return;
+
+    this.results.set(key, result);
+    this.bytes += result.packedMouthCues.byteLength;
+    for (const oldest of this.results.keys()) {
+      if (this.bytes <= this.maxBytes) break;
+      this.delete(oldest);
+    }
+  }
+
+  /** Drop all results */
+  clear(): void {
+    this.results.clear();
+    this.bytes = 0;
+  }
+
+  private delete(key: string): void {
+    const result = this.results.get(key);
+    if (result) {
+      this.results.delete(key);
+      this.bytes -= result.packedMouthCues.byteLength;
+    }
+  }
+}
+
+/**
+ * Result cache in IndexedDB, persisting results across page loads
+ * Results are never evicted; call `clear()`, e.g. when the assets they belong to change.
+ */
+export class IndexedDbResultCache implements LipSyncEngineResultCache {
+  private static readonly STORE_NAME = 'results';
+  private database: Promise<IDBDatabase> | null = null;
+
+  /**
+   * @param databaseName - Name of the database (default: 'lip-sync-engine-results')
+   */
+  constructor(private readonly databaseName = 'lip-sync-engine-results') {}
+
+  async get(key: string): Promise<LipSyncEngineCachedResult | undefined> {
+    const database = await this.open();
+    return request(
+      database.transaction(IndexedDbResultCache.STORE_NAME).objectStore(IndexedDbResultCache.STORE_NAME).get(key)
+    );
+  }
+
+  async set(key: string, result: LipSyncEngineCachedResult): Promise<void> {
+    const database = await this.open();
+    await request(
+      database
+        .transaction(IndexedDbResultCache.STORE_NAME, 'readwrite')
+        .objectStore(IndexedDbResultCache.STORE_NAME)
+        .put({ packedMouthCues: result.packedMouthCues }, key)
+    );
+  }
+
+  /** Delete all results */
+  async clear(): Promise<void> {
+    const database = await this.open();
+    await request(
+      database
+        .transaction(IndexedDbResultCache.STORE_NAME, 'readwrite')
+        .objectStore(IndexedDbResultCache.STORE_NAME)
+        .clear()
+    );
+  }
+
+  private open(): Promise<IDBDatabase> {
+    if (!this.database) {
+      const openRequest = indexedDB.open(this.databaseName, 1);
+      openRequest.onupgradeneeded = () => {
+        openRequest.result.createObjectStore(IndexedDbResultCache.STORE_NAME);
+      };
+      this.database = request(openRequest);
+      // Let a later call retry, e.g. after the user allowed storage
+      this.database.catch(() => {
+        this.database = null;
+      });
+    }
+    return this.database;
+  }
+}
+
+/** Promise of the result of an IndexedDB request */
+function request<T>(idbRequest: IDBRequest<T>): Promise<T> {
+  return new Promise((resolve, reject) => {
+    idbRequest.onsuccess = () => resolve(idbRequest.result);
+    idbRequest.onerror = () => reject(idbRequest.error);
+  });
+}
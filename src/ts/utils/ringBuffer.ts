@@ -0,0 +1,119 @@
+/**
+ * Single-producer, single-consumer ring buffer of PCM16 samples in shared memory
+ * Lets the capture worklet hand audio to a worker without a message per render quantum. With
+ * voice activity detection in the worklet, a second one carries the activity of each frame.
+ */
+
+/** Header slots, as int32 */
+const WRITE_INDEX = 0;
+const READ_INDEX = 1;
+/** Samples dropped because the consumer fell behind */
+const DROPPED_COUNT = 2;
+const HEADER_LENGTH = 4;
+
+/**
+ * Ring buffer over a SharedArrayBuffer; both sides create their own view of the same buffer
+ * The writer only advances the write index and the reader only the read index, so no locks are
+ * needed. One slot stays empty, so that a full buffer can be told from an empty one.
+ */
+export class SharedRingBuffer {
+  readonly buffer: SharedArrayBuffer;
+  private header: Int32Array;
+  private samples: Int16Array;
+
+  /**
+   * @param bufferOrCapacity - A buffer created by another view, or the number of samples to hold
+   */
+  constructor(bufferOrCapacity: SharedArrayBuffer | number) {
+    this.buffer = typeof bufferOrCapacity === 'number'
+      ? new SharedArrayBuffer(HEADER_LENGTH * 4 + (bufferOrCapacity + 1) * 2)
+      : bufferOrCapacity;
+    this.header = new Int32Array(this.buffer, 0, HEADER_LENGTH);
+    this.samples = new Int16Array(this.buffer, HEADER_LENGTH * 4);
+  }
+
+  /**
+   * Append float samples in [-1, 1], converting them to PCM16
+   * Samples that don't fit are dropped and counted.
+   *
+   * @returns The number of samples written
+   */
+  write(input: Float32Array): number {
+    const size = this.samples.length;
+    const writeIndex = Atomics.load(this.header, WRITE_INDEX);
+    const count = Math.min(input.length, this.getFreeCount());
+
+    let index = writeIndex;
+    for (let i = 0; i < count; i++) {
+      const sample = Math.max(-1, Math.min(1, input[i]));
+      this.samples[index] = sample < 0 ? sample * 0x8000 : sample * 0x7fff;
+      if (++index === size) index = 0;
+    }
+
+    Atomics.store(this.header, WRITE_INDEX, index);
+    if (count < input.length) {
+      Atomics.add(this.header, DROPPED_COUNT, input.length - count);
+    }
+    return count;
+  }
+
+  /**
+   * Append 16-bit values if all of them fit, or count them as dropped
+   *
+   * @returns Whether the values were written
+   */
+  writeAll(input: Int16Array): boolean {
+    const size = this.samples.length;
+    const writeIndex = Atomics.load(this.header, WRITE_INDEX);
+    if (input.length > this.getFreeCount()) {
+      Atomics.add(this.header, DROPPED_COUNT, input.length);
+      return false;
+    }
+
+    const firstPart = Math.min(input.length, size - writeIndex);
+    this.samples.set(input.subarray(0, firstPart), writeIndex);
+    this.samples.set(input.subarray(firstPart), 0);
+    Atomics.store(this.header, WRITE_INDEX, (writeIndex + input.length) % size);
+    return true;
+  }
+
+  /**
+   * The number of values that can be written before the buffer is full
+   */
+  getFreeCount(): number {
+    const size = this.samples.length;
+    const writeIndex = Atomics.load(this.header, WRITE_INDEX);
+    const readIndex = Atomics.load(this.header, READ_INDEX);
+    return (readIndex - writeIndex - 1 + size) % size;
+  }
+
+  /**
+   * Remove and return the samples written so far, or the first `maxCount` of them
+   */
+  read(maxCount = Infinity): Int16Array {
+    const size = this.samples.length;
+    const readIndex = Atomics.load(this.header, READ_INDEX);
+    const available = (Atomics.load(this.header, WRITE_INDEX) - readIndex + size) % size;
+    const count = Math.min(available, maxCount);
+    const endIndex = (readIndex + count) % size;
+
+    let result: Int16Array;
+    if (endIndex >= readIndex) {
+      result = this.samples.slice(readIndex, endIndex);
+    } else {
+      result = new Int16Array(count);
+      result.set(this.samples.subarray(readIndex));
+      result.set(this.samples.subarray(0, endIndex), size - readIndex);
+    }
+
+    Atomics.store(this.header, READ_INDEX, endIndex);
+    return result;
+  }
+
+  /**
+   * The number of samples dropped because the buffer was full
+   */
+  getDroppedCount(): number {
+    return Atomics.load(this.header, DROPPED_COUNT);
+  }
+}
@@ -0,0 +1,289 @@
+/**
+ * One engine in a SharedWorker, serving the `WorkerPool`s of every tab of an origin
+ * Each pool connects to the worker through a port and uses the connection like one of its
+ * workers. The worker initializes the engine once for all connections, so tabs opened later
+ * start with its models loaded and its decoders and dialog models cached.
+ */
+
+import type { WorkerInitResponse, WorkerRequest, WorkerResponse } from '../worker';
+
+/**
+ * The members of `Worker` that `WorkerPool` uses, which a connection to a shared engine has too
+ */
+export interface EngineWorker {
+  postMessage(message: unknown, transfer?: Transferable[]): void;
+  addEventListener(type: 'message', listener: (event: MessageEvent) => void): void;
+  removeEventListener(type: 'message', listener: (event: MessageEvent) => void): void;
+  onmessage: ((event: MessageEvent) => void) | null;
+  onerror: ((event: ErrorEvent) => void) | null;
+  terminate(): void;
+}
+
+/**
+ * Connection of a pool to the engine of a SharedWorker, in the shape of a dedicated worker
+ */
+export class SharedEngineConnection implements EngineWorker {
+  onerror: ((event: ErrorEvent) => void) | null = null;
+  private readonly port: MessagePort;
+
+  /**
+   * @param url - URL of the worker script, of the page's origin
+   * @param name - Name of the SharedWorker; pools connect to the same one only if they agree
+   */
+  constructor(url: string, name: string) {
+    const worker = new SharedWorker(url, { name });
+    worker.onerror = (event) => this.onerror?.(event);
+    this.port = worker.port;
+  }
+
+  get onmessage(): ((event: MessageEvent) => void) | null {
+    return this.port.onmessage;
+  }
+
+  set onmessage(handler: ((event: MessageEvent) => void) | null) {
+    this.port.onmessage = handler;
+  }
+
+  postMessage(message: unknown, transfer: Transferable[] = []): void {
+    this.port.postMessage(message, transfer);
+  }
+
+  addEventListener(type: 'message', listener: (event: MessageEvent) => void): void {
+    this.port.addEventListener(type, listener);
+  }
+
+  removeEventListener(type: 'message', listener: (event: MessageEvent) => void): void {
+    this.port.removeEventListener(type, listener);
+  }
+
+  /** Disconnect from the engine, which keeps running for the other connections */
+  terminate(): void {
+    const message: WorkerRequest = { type: 'disconnect' };
+    this.port.postMessage(message);
+    this.port.close();
+  }
+}
+
+/** The engine of the worker script */
+export interface SharedEngine {
+  /** Handle a request, or defer it while an analysis is suspended */
+  receive(message: WorkerRequest): void;
+  /** Handle a request that runs until it is answered, e.g. an analysis */
+  run(message: WorkerRequest): Promise<void>;
+}
+
+/** Requests that occupy the engine until answered; the host runs one of them at a time */
+const JOB_TYPES: ReadonlySet<WorkerRequest['type']> = new Set<WorkerRequest['type']>([
+  'analyze',
+  'convert',
+  'decode',
+  'warmup',
+]);
+
+/** Whether a request gets no further responses after this one */
+function isLastResponse(response: Exclude<WorkerResponse, WorkerInitResponse>): boolean {
+  return response.type === 'streamCues'
+    ? response.final
+    : response.type !== 'progress' && response.type !== 'mouthCues' && response.type !== 'preview';
+}
+
+interface Connection {
+  port: MessagePort;
+  /** Host ids of the connection's unanswered requests and open streams, by the pool's ids */
+  ids: Map<number, number>;
+  /** Jobs waiting for the engine, with host ids */
+  jobs: WorkerRequest[];
+  /** Whether the connection asked to release the caches, and sent no request since */
+  releasedCaches: boolean;
+  /** Whether the connection waits for the engine to be initialized */
+  awaitingInit: boolean;
+}
+
+/**
+ * Serves the connections of a SharedWorker from its engine
+ * The pools number their requests independently, so the host gives each request an id unique
+ * across connections and maps the responses back. Jobs wait in a queue per connection, and the
+ * connections take turns, so that a tab queuing many analyses doesn't hold up the others.
+ * Requests that only take a moment, such as stream pushes, are handled right away.
+ */
+export class SharedEngineHost {
+  private readonly connections: Connection[] = [];
+  /** The connection and pool id of each host id that may still be answered */
+  private readonly requests = new Map<number, { connection: Connection; id: number }>();
+  private nextId = 1;
+  /** Index of the connection whose job runs next, if it has one */
+  private nextTurn = 0;
+  private runningJobs = false;
+  private initializing = false;
+  /** The response of the engine's initialization, once it succeeded */
+  private initResponse: WorkerInitResponse | null = null;
+
+  constructor(private readonly engine: SharedEngine) {}
+
+  /**
+   * Serve a new connection
+   */
+  connect(port: MessagePort): void {
+    const connection: Connection = {
+      port,
+      ids: new Map(),
+      jobs: [],
+      releasedCaches: false,
+      awaitingInit: false,
+    };
+    this.connections.push(connection);
+    port.onmessage = (event: MessageEvent<WorkerRequest>) => this.receive(connection, event.data);
+    // Where supported, the port of a closed tab fires 'close'
+    port.addEventListener('close', () => this.disconnect(connection));
+  }
+
+  /**
+   * Send a response of the engine to the connection whose request it answers
+   */
+  route(response: WorkerResponse, transfer: Transferable[]): void {
+    if (!('id' in response)) {
+      this.answerInit(response);
+      return;
+    }
+    const request = this.requests.get(response.id);
+    if (!request) return;
+    if (isLastResponse(response)) {
+      this.requests.delete(response.id);
+      request.connection.ids.delete(request.id);
+    }
+    request.connection.port.postMessage({ ...response, id: request.id }, transfer);
+  }
+
+  private receive(connection: Connection, message: WorkerRequest): void {
+    if (message.type === 'init') {
+      if (this.initResponse) {
+        connection.port.postMessage(this.initResponse);
+        return;
+      }
+      connection.awaitingInit = true;
+      if (!this.initializing) {
+        this.initializing = true;
+        // Shared memory can't be posted to a SharedWorker, and the host answers every connection
+        this.engine.run({
+          ...message,
+          wasmModule: undefined,
+          sharedModels: undefined,
+          jobChannel: undefined,
+        });
+      }
+    } else if (message.type === 'disconnect') {
+      this.disconnect(connection);
+    } else if (message.type === 'releaseCaches') {
+      // The caches serve every tab, so they are only released once all tabs asked for it
+      connection.releasedCaches = true;
+      if (this.connections.every(c => c.releasedCaches)) {
+        this.engine.receive(message);
+      }
+    } else if (message.type === 'setTracing') {
+      this.engine.receive(message);
+    } else if (message.type === 'cancel') {
+      const hostId = connection.ids.get(message.id);
+      if (hostId === undefined) return;
+      const queueIndex = connection.jobs.findIndex(job => 'id' in job && job.id === hostId);
+      if (queueIndex !== -1) {
+        // The pool has given up on the job, so it gets no response
+        connection.jobs.splice(queueIndex, 1);
+        this.forget(connection, message.id);
+      } else {
+        this.engine.receive({ type: 'cancel', id: hostId });
+      }
+    } else {
+      connection.releasedCaches = false;
+      // Stream pushes and ends continue the stream their begin opened
+      let hostId = connection.ids.get(message.id);
+      if (hostId === undefined) {
+        hostId = this.nextId++;
+        connection.ids.set(message.id, hostId);
+        this.requests.set(hostId, { connection, id: message.id });
+      }
+      const request = { ...message, id: hostId } as WorkerRequest;
+      if (JOB_TYPES.has(message.type)) {
+        connection.jobs.push(request);
+        this.runJobs();
+      } else {
+        this.engine.receive(request);
+      }
+    }
+  }
+
+  /**
+   * Answer the connections waiting for the engine's initialization
+   * Pointers into the engine's memory are of no use to the pools, as it isn't shared with them.
+   */
+  private answerInit(response: WorkerInitResponse): void {
+    const answer: WorkerInitResponse = {
+      type: response.type,
+      error: response.error,
+      memoryBytes: response.memoryBytes,
+      canYield: response.canYield,
+    };
+    this.initializing = false;
+    // After a failure, the next connection tries again
+    if (answer.type === 'ready') {
+      this.initResponse = answer;
+    }
+    for (const connection of this.connections) {
+      if (connection.awaitingInit) {
+        connection.awaitingInit = false;
+        connection.port.postMessage(answer);
+      }
+    }
+  }
+
+  /**
+   * Run the queued jobs one at a time, taking them from the connections in turn
+   */
+  private async runJobs(): Promise<void> {
+    if (this.runningJobs) return;
+    this.runningJobs = true;
+    try {
+      for (let job = this.takeJob(); job; job = this.takeJob()) {
+        await this.engine.run(job);
+      }
+    } finally {
+      this.runningJobs = false;
+    }
+  }
+
+  private takeJob(): WorkerRequest | undefined {
+    const count = this.connections.length;
+    for (let i = 0; i < count; i++) {
+      const index = (this.nextTurn + i) % count;
+      const connection = this.connections[index];
+      if (connection.jobs.length > 0) {
+        this.nextTurn = (index + 1) % count;
+        return connection.jobs.shift();
+      }
+    }
+    return undefined;
+  }
+
+  /**
+   * Stop serving a connection: drop its queued jobs, cancel its running analysis and close its
+   * streams
+   */
+  private disconnect(connection: Connection): void {
+    const index = this.connections.indexOf(connection);
+    if (index === -1) return;
+    this.connections.splice(index, 1);
+    connection.jobs = [];
+    for (const [id, hostId] of connection.ids) {
+      this.engine.receive({ type: 'cancel', id: hostId });
+      this.forget(connection, id);
+    }
+    connection.port.close();
+  }
+
+  private forget(connection: Connection, id: number): void {
+    const hostId = connection.ids.get(id);
+    if (hostId !== undefined) {
+      this.requests.delete(hostId);
+    }
+    connection.ids.delete(id);
+  }
+}
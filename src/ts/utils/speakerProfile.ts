@@ -0,0 +1,62 @@
+/**
+ * Speaker profiles of the C API
+ * See lipsyncengine_speaker_create in bridge.h
+ */
+
+import type { LipSyncEngineModule } from '../types';
+
+/**
+ * Get the last error of the module
+ */
+function getLastError(module: LipSyncEngineModule, fallback: string): string {
+  const errorPtr = module._lipsyncengine_get_last_error();
+  return errorPtr ? module.UTF8ToString(errorPtr) : fallback;
+}
+
+/**
+ * Create a speaker profile in the module
+ * @param module - WASM module to create it in
+ * @param profile - Bytes of a saved profile (see `LipSyncEngineResult.speakerProfile`), or
+ *   undefined for a new speaker
+ * @returns Handle to pass to allocateOptions(), to be released by the caller with
+ *   _lipsyncengine_speaker_release()
+ * @throws {Error} If the bytes aren't a speaker profile
+ */
+export function createSpeaker(module: LipSyncEngineModule, profile?: Uint8Array): number {
+  let profilePtr = 0;
+  try {
+    if (profile && profile.length > 0) {
+      profilePtr = module._malloc(profile.length);
+      module.HEAPU8.set(profile, profilePtr);
+    }
+    const speaker = module._lipsyncengine_speaker_create(profilePtr, profile?.length ?? 0);
+    if (speaker < 0) {
+      throw new Error(getLastError(module, 'Failed to read the speaker profile'));
+    }
+    return speaker;
+  } finally {
+    if (profilePtr) module._free(profilePtr);
+  }
+}
+
+/**
+ * Copy what a speaker profile has learned out of WASM memory
+ * @param module - WASM module owning the profile
+ * @param speaker - Handle returned by createSpeaker()
+ * @returns The profile's bytes, to pass to createSpeaker() in a later session
+ */
+export function saveSpeaker(module: LipSyncEngineModule, speaker: number): Uint8Array {
+  const byteCountPtr = module._malloc(4);
+  let profilePtr = 0;
+  try {
+    profilePtr = module._lipsyncengine_speaker_save(speaker, byteCountPtr);
+    if (!profilePtr) {
+      throw new Error(getLastError(module, 'Failed to save the speaker profile'));
+    }
+    const byteCount = module.HEAP32[byteCountPtr / 4];
+    return module.HEAPU8.slice(profilePtr, profilePtr + byteCount);
+  } finally {
+    module._free(byteCountPtr);
+    if (profilePtr) module._lipsyncengine_free(profilePtr);
+  }
+}
@@ -0,0 +1,128 @@
+/**
+ * Cutting audio streams into overlapping windows and stitching their mouth cues back together
+ */
+
+import type { MouthCue } from '../types';
+
+/** Length of the stretch whose energy is compared when looking for a quiet cut, in centiseconds */
+const QUIET_STRETCH_CENTISECONDS = 3;
+
+/**
+ * Find the quietest point in a range of samples: the middle of the 30 ms with the least energy,
+ * ignoring DC offset. Cuts there are least likely to split a phone.
+ * Candidates are whole centiseconds, so that the point maps to cue times exactly.
+ *
+ * @param samples - The samples to search
+ * @param start - First candidate index
+ * @param end - Index after the last candidate
+ * @param sampleRate - Sample rate of the samples
+ * @returns The index of the quietest point, or `start` if the range is too short
+ */
+export function findQuietestPoint(
+  samples: Int16Array,
+  start: number,
+  end: number,
+  sampleRate: number
+): number {
+  const step = sampleRate / 100;
+  const firstBlock = Math.ceil(start / step);
+  const blockCount = Math.floor(end / step) - firstBlock;
+  if (blockCount < QUIET_STRETCH_CENTISECONDS) {
+    return start;
+  }
+
+  const energies = new Float64Array(blockCount);
+  for (let block = 0; block < blockCount; block++) {
+    const blockStart = Math.round((firstBlock + block) * step);
+    const blockEnd = Math.min(Math.round((firstBlock + block + 1) * step), samples.length);
+    let sum = 0;
+    let sumOfSquares = 0;
+    for (let i = blockStart; i < blockEnd; i++) {
+      sum += samples[i];
+      sumOfSquares += samples[i] * samples[i];
+    }
+    const count = blockEnd - blockStart;
+    energies[block] = count > 0 ? sumOfSquares - (sum * sum) / count : 0;
+  }
+
+  let quietestBlock = 0;
+  let quietestEnergy = Infinity;
+  for (let block = 0; block + QUIET_STRETCH_CENTISECONDS <= blockCount; block++) {
+    let energy = 0;
+    for (let i = 0; i < QUIET_STRETCH_CENTISECONDS; i++) {
+      energy += energies[block + i];
+    }
+    if (energy < quietestEnergy) {
+      quietestEnergy = energy;
+      quietestBlock = block;
+    }
+  }
+  return Math.round((firstBlock + quietestBlock + 1) * step);
+}
+
+/**
+ * The mouth cues of a window, together with the part of the stream the window is responsible for
+ * All times are in seconds.
+ */
+export interface StitchedWindow {
+  /** Stream time of the window's first sample, to which its cue times are relative */
+  offset: number;
+  /** Start of the part of the stream whose cues are taken from this window */
+  start: number;
+  /** End of the part of the stream whose cues are taken from this window */
+  end: number;
+  mouthCues: MouthCue[];
+}
+
+/** Rounds a time to centiseconds, the resolution of the engine's cues */
+function roundTime(time: number): number {
+  return Math.round(time * 100) / 100;
+}
+
+/**
+ * Stitch the mouth cues of consecutive windows into one track in stream time
+ * Each window contributes the cues within its own part of the stream, cut at the seams. Cues of
+ * the same shape meeting at a seam are merged.
+ *
+ * @param windows - Windows in stream order, whose parts adjoin
+ * @returns Mouth cues in stream time
+ */
+export function stitchMouthCues(windows: StitchedWindow[]): MouthCue[] {
+  const result: MouthCue[] = [];
+  for (const window of windows) {
+    for (const cue of window.mouthCues) {
+      const start = roundTime(Math.max(cue.start + window.offset, window.start));
+      const end = roundTime(Math.min(cue.end + window.offset, window.end));
+      if (end <= start) continue;
+
+      const previous = result[result.length - 1];
+      if (previous && previous.value === cue.value && previous.end >= start) {
+        previous.end = Math.max(previous.end, end);
+      } else {
+        result.push({ start, end, value: cue.value });
+      }
+    }
+  }
+  return result;
+}
+
+/**
+ * Get the cues within a part of a track, relative to the start of that part
+ *
+ * @param mouthCues - Cues ordered by time
+ * @param start - Start of the part in seconds
+ * @param end - End of the part in seconds
+ */
+export function sliceMouthCues(mouthCues: MouthCue[], start: number, end: number): MouthCue[] {
+  const result: MouthCue[] = [];
+  for (const cue of mouthCues) {
+    if (cue.end <= start) continue;
+    if (cue.start >= end) break;
+    result.push({
+      start: roundTime(Math.max(cue.start, start) - start),
+      end: roundTime(Math.min(cue.end, end) - start),
+      value: cue.value,
+    });
+  }
+  return result;
+}
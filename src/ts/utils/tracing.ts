@@ -0,0 +1,54 @@
+/**
+ * Access to the trace spans of the C API
+ * See lipsyncengine_set_tracing and lipsyncengine_take_trace in bridge.h
+ */
+
+import type { LipSyncEngineModule, LipSyncEngineTraceEvent } from '../types';
+
+/**
+ * Get the current time in microseconds since the Unix epoch, the clock of all trace events
+ * performance.timeOrigin differs between the page and its workers, but the sum doesn't.
+ */
+export function getTraceTimestamp(time: number = performance.now()): number {
+  return (performance.timeOrigin + time) * 1000;
+}
+
+/**
+ * Start or stop recording trace spans in a module
+ * @param module - WASM module
+ * @param enabled - Whether to record spans; stopping discards those not taken yet
+ */
+export function setModuleTracing(module: LipSyncEngineModule, enabled: boolean): void {
+  module._lipsyncengine_set_tracing(enabled ? 1 : 0);
+}
+
+/**
+ * Take the trace spans a module recorded since the last call
+ * @param module - WASM module
+ * @param processId - Process ID of the events, distinguishing modules in a merged trace
+ * @returns The spans, with timestamps of `getTraceTimestamp()`
+ * @throws {Error} If the C API fails
+ */
+export function takeModuleTrace(
+  module: LipSyncEngineModule,
+  processId: number
+): LipSyncEngineTraceEvent[] {
+  const clockOffset = getTraceTimestamp() - module._lipsyncengine_trace_clock();
+  const tracePtr = module._lipsyncengine_take_trace(processId, clockOffset);
+  if (!tracePtr) {
+    const errorPtr = module._lipsyncengine_get_last_error();
+    throw new Error(errorPtr ? module.UTF8ToString(errorPtr) : 'Taking the trace failed');
+  }
+  try {
+    return JSON.parse(module.UTF8ToString(tracePtr)) as LipSyncEngineTraceEvent[];
+  } finally {
+    module._lipsyncengine_free(tracePtr);
+  }
+}
+
+/**
+ * Get a metadata event naming a process of a merged trace
+ */
+export function getProcessNameEvent(processId: number, name: string): LipSyncEngineTraceEvent {
+  return { name: 'process_name', ph: 'M', pid: processId, args: { name } };
+}
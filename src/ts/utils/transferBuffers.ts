@@ -0,0 +1,68 @@
+/**
+ * Audio buffers that travel to a worker and back
+ * Streaming posts a chunk to the worker many times a second. Rather than allocating a buffer per
+ * chunk and letting the worker drop it, the worker sends each buffer back with its response, and
+ * the next chunk of the same size is copied into it.
+ */
+
+/**
+ * Whether samples can be transferred to a worker as they are: they must cover an ArrayBuffer
+ * (not shared memory) completely, or the transfer would detach more than them
+ */
+export function canTransfer(pcm16: Int16Array): boolean {
+  return (
+    pcm16.buffer instanceof ArrayBuffer &&
+    pcm16.byteOffset === 0 &&
+    pcm16.byteLength === pcm16.buffer.byteLength
+  );
+}
+
+/**
+ * Free ArrayBuffers by size
+ * Chunks of a capture usually have one size, so buffers are only reused for the exact size asked
+ * for. Buffers beyond `maxBytes` are left to the garbage collector.
+ */
+export class TransferBufferPool {
+  private buffers: Map<number, ArrayBuffer[]> = new Map();
+  private bytes = 0;
+
+  /**
+   * @param maxBytes - The most bytes of free buffers to keep, across sizes
+   */
+  constructor(private readonly maxBytes = 4 * 1024 * 1024) {}
+
+  /**
+   * Take a free buffer of `length` samples, or allocate one
+   * The samples of a reused buffer are those of its previous chunk.
+   */
+  acquire(length: number): Int16Array {
+    const byteLength = length * 2;
+    const buffer = this.buffers.get(byteLength)?.pop();
+    if (!buffer) {
+      return new Int16Array(length);
+    }
+    this.bytes -= byteLength;
+    return new Int16Array(buffer);
+  }
+
+  /**
+   * Give back a buffer for later chunks of its size
+   */
+  release(buffer: ArrayBuffer): void {
+    // Empty buffers are detached ones, or not worth keeping
+    if (buffer.byteLength === 0 || this.bytes + buffer.byteLength > this.maxBytes) return;
+    let buffers = this.buffers.get(buffer.byteLength);
+    if (!buffers) {
+      buffers = [];
+      this.buffers.set(buffer.byteLength, buffers);
+    }
+    buffers.push(buffer);
+    this.bytes += buffer.byteLength;
+  }
+
+  /** Drop all free buffers */
+  clear(): void {
+    this.buffers.clear();
+    this.bytes = 0;
+  }
+}
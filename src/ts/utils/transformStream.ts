@@ -0,0 +1,97 @@
+/**
+ * TransformStreams of audio into mouth cues, over a streaming session
+ */
+
+import type { LipSyncEngineStreamResult, MouthCue } from '../types';
+import { findTentativeCuesChange } from './cueDeltas';
+
+/** A streaming session, on this thread (`LipSyncEngineStream`) or in a worker (`WorkerStream`) */
+export interface MouthCueStreamSession {
+  push(pcm16: Int16Array): LipSyncEngineStreamResult | Promise<LipSyncEngineStreamResult>;
+  end(): LipSyncEngineStreamResult | Promise<LipSyncEngineStreamResult>;
+}
+
+/**
+ * Chunks pushed to the session before the transform waits for the oldest one's cues
+ * A few in flight keep a worker busy while the next chunk is posted.
+ */
+const MAX_PUSHES_IN_FLIGHT = 4;
+
+/**
+ * Create a TransformStream that pushes the chunks written to it to a session and reads the cues
+ * the session finalizes
+ * Each chunk read is a non-empty array of cues, in seconds from the start of the stream. Writes
+ * wait while `MAX_PUSHES_IN_FLIGHT` chunks are being recognized and while the readable side is
+ * full, so a piped source is read at the pace of the recognition. Closing the writable side ends
+ * the session; aborting it, or canceling the readable side, ends it where the runtime supports
+ * transformer cancelation.
+ *
+ * @param begin - Begins the session once the stream starts
+ * @param onTentativeCues - Called when the provisional cues following the finalized ones change
+ */
+export function createMouthCueTransformStream(
+  begin: () => Promise<MouthCueStreamSession>,
+  onTentativeCues?: (tentativeCues: MouthCue[], from: number) => void
+): TransformStream<Int16Array, MouthCue[]> {
+  let session: MouthCueStreamSession | null = null;
+  let ended = false;
+  const inFlight: Promise<void>[] = [];
+  let tentativeCues: MouthCue[] = [];
+
+  const emit = (
+    controller: TransformStreamDefaultController<MouthCue[]>,
+    result: LipSyncEngineStreamResult
+  ): void => {
+    if (result.mouthCues.length > 0) {
+      controller.enqueue(result.mouthCues);
+    }
+    if (!onTentativeCues) return;
+    const from = findTentativeCuesChange(tentativeCues, result.tentativeCues);
+    if (from !== null) {
+      tentativeCues = result.tentativeCues;
+      onTentativeCues(tentativeCues, from);
+    }
+  };
+
+  const end = async (): Promise<LipSyncEngineStreamResult | null> => {
+    if (!session || ended) return null;
+    ended = true;
+    return session.end();
+  };
+
+  // Transformer cancelation is newer than the DOM library's types
+  const transformer: Transformer<Int16Array, MouthCue[]> & { cancel?: () => Promise<void> } = {
+    start: async () => {
+      session = await begin();
+    },
+    transform: async (chunk, controller) => {
+      // Results arrive in order, so the cues are enqueued in order
+      const pushed = Promise.resolve()
+        .then(() => session!.push(chunk))
+        .then(
+          (result) => emit(controller, result),
+          (error) => {
+            ended = true;
+            controller.error(error);
+          }
+        );
+      inFlight.push(pushed);
+      if (inFlight.length >= MAX_PUSHES_IN_FLIGHT) {
+        await inFlight.shift();
+      }
+    },
+    flush: async (controller) => {
+      while (inFlight.length > 0) {
+        await inFlight.shift();
+      }
+      const result = await end();
+      if (result) {
+        emit(controller, result);
+      }
+    },
+    cancel: async () => {
+      await end().catch(() => null);
+    },
+  };
+  return new TransformStream(transformer);
+}
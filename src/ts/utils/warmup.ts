@@ -0,0 +1,50 @@
+/**
+ * Warming up the engine ahead of the first analysis
+ * See lipsyncengine_warmup in bridge.h
+ */
+
+import type {
+  LipSyncEngineModule,
+  LipSyncEngineOptions,
+  LipSyncEngineWarmupLevel,
+} from '../types';
+import { allocateOptions } from './options';
+
+/** Values of lipsyncengine_warmup_level */
+const WARMUP_LEVELS = {
+  decoders: 0,
+  full: 1,
+} as const;
+
+/** The options that select what `warmupModule()` warms up */
+export type WarmupOptions = Pick<LipSyncEngineOptions, 'recognizer' | 'profile' | 'dialogMode' | 'threadCount'>;
+
+/**
+ * Warm up a module on the calling thread, whose models the options require must have been loaded
+ * @param module - WASM module
+ * @param level - How much of the first analysis to do ahead of time
+ * @param options - The recognizer, profile and dialog mode to warm up; as many decoders as
+ *   `threadCount` are created
+ * @throws {Error} If the level or the options are invalid, or the decoders don't fit the memory
+ *   budget
+ */
+export function warmupModule(
+  module: LipSyncEngineModule,
+  level: LipSyncEngineWarmupLevel,
+  options: WarmupOptions
+): void {
+  const levelValue = WARMUP_LEVELS[level];
+  if (levelValue === undefined) {
+    throw new Error(`Unknown warmup level '${level}'`);
+  }
+  module._lipsyncengine_set_max_thread_count(Math.max(1, options.threadCount ?? 1));
+  const optionsPtr = allocateOptions(module, { ...options, collectStats: false });
+  try {
+    if (module._lipsyncengine_warmup(levelValue, optionsPtr) !== 0) {
+      const errorPtr = module._lipsyncengine_get_last_error();
+      throw new Error(errorPtr ? module.UTF8ToString(errorPtr) : 'Warmup failed');
+    }
+  } finally {
+    module._free(optionsPtr);
+  }
+}
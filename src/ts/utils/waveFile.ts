@@ -0,0 +1,242 @@
+/**
+ * Reading WAVE files block by block in a worker, from a `File`/`Blob` or a file of the origin
+ * private file system
+ * Only the format chunk and the current block are in memory, so files of any length can be
+ * analyzed. Like the CLI's WaveFileReader, each block is decoded by lipsyncengine_decode_wav() as
+ * a WAVE file of its own, with the format chunk of the original.
+ */
+
+import type { LipSyncEngineModule } from '../types';
+
+/** `FileSystemFileHandle.createSyncAccessHandle()`, which only dedicated workers have */
+interface SyncAccessFileHandle {
+  createSyncAccessHandle(): Promise<{
+    getSize(): number;
+    read(buffer: Uint8Array, options: { at: number }): number;
+    close(): void;
+  }>;
+}
+
+/** Random access to the bytes of a file */
+interface ByteSource {
+  size: number;
+  /**
+   * Read bytes into the array `getTarget()` returns, which is called once they are available, so
+   * that it may be a view of WASM memory
+   */
+  read(offset: number, length: number, getTarget: () => Uint8Array): Promise<void>;
+  close(): void;
+}
+
+async function openByteSource(file: Blob | FileSystemFileHandle): Promise<ByteSource> {
+  if (file instanceof Blob) {
+    return {
+      size: file.size,
+      async read(offset, length, getTarget) {
+        const bytes = await file.slice(offset, offset + length).arrayBuffer();
+        if (bytes.byteLength < length) {
+          throw new Error('Unexpected end of file');
+        }
+        getTarget().set(new Uint8Array(bytes));
+      },
+      close() {},
+    };
+  }
+
+  // Reads straight into WASM memory
+  const access = await (file as unknown as SyncAccessFileHandle).createSyncAccessHandle();
+  return {
+    size: access.getSize(),
+    async read(offset, length, getTarget) {
+      if (access.read(getTarget(), { at: offset }) < length) {
+        throw new Error('Unexpected end of file');
+      }
+    },
+    close: () => access.close(),
+  };
+}
+
+function readUInt(bytes: Uint8Array, offset: number, byteCount: number): number {
+  let result = 0;
+  for (let i = byteCount - 1; i >= 0; i--) {
+    result = result * 256 + bytes[offset + i];
+  }
+  return result;
+}
+
+function readTag(bytes: Uint8Array, offset: number): string {
+  return String.fromCharCode(...bytes.subarray(offset, offset + 4));
+}
+
+/**
+ * A WAVE file, read as mono PCM16 at its own sample rate
+ */
+export class WaveFileReader {
+  private offset: number;
+  private remainingFrameCount: number;
+
+  private constructor(
+    private readonly source: ByteSource,
+    /** The RIFF header, the format chunk and the header of a data chunk of one block */
+    private readonly header: Uint8Array,
+    readonly sampleRate: number,
+    private readonly frameSize: number,
+    dataStart: number,
+    /** The number of mono samples in the file */
+    readonly sampleCount: number
+  ) {
+    this.offset = dataStart;
+    this.remainingFrameCount = sampleCount;
+  }
+
+  /**
+   * Open a WAVE file with integer (8 to 32 bits) or 32-bit float samples
+   * OPFS files are read with a sync access handle, which locks them until `close()`.
+   *
+   * @throws {Error} If the file isn't such a WAVE file
+   */
+  static async open(
+    module: LipSyncEngineModule,
+    file: Blob | FileSystemFileHandle
+  ): Promise<WaveFileReader> {
+    const source = await openByteSource(file);
+    try {
+      const read = async (offset: number, length: number): Promise<Uint8Array> => {
+        const bytes = new Uint8Array(length);
+        await source.read(offset, length, () => bytes);
+        return bytes;
+      };
+
+      if (source.size < 12) {
+        throw new Error('Not a WAVE file.');
+      }
+      const riffHeader = await read(0, 12);
+      if (readTag(riffHeader, 0) !== 'RIFF' || readTag(riffHeader, 8) !== 'WAVE') {
+        throw new Error('Not a WAVE file.');
+      }
+
+      // Keeps the format chunk, skipping the other chunks before the data
+      let formatChunk: Uint8Array | null = null;
+      let offset = 12;
+      for (;;) {
+        if (offset + 8 > source.size) {
+          throw new Error('No audio data.');
+        }
+        const chunkHeader = await read(offset, 8);
+        const chunkSize = readUInt(chunkHeader, 4, 4);
+        offset += 8;
+        if (readTag(chunkHeader, 0) === 'data') {
+          break;
+        }
+        if (readTag(chunkHeader, 0) === 'fmt ') {
+          const paddedSize = chunkSize + (chunkSize & 1);
+          if (chunkSize < 16 || offset + paddedSize > source.size) {
+            throw new Error('Invalid format chunk.');
+          }
+          formatChunk = new Uint8Array(8 + paddedSize);
+          formatChunk.set(chunkHeader);
+          formatChunk.set(await read(offset, paddedSize), 8);
+        }
+        offset += chunkSize + (chunkSize & 1);
+      }
+      const dataStart = offset;
+      const dataSize = readUInt(await read(dataStart - 4, 4), 0, 4);
+
+      const sampleRate = formatChunk ? readUInt(formatChunk, 12, 4) : 0;
+      if (!formatChunk || sampleRate === 0) {
+        throw new Error('Invalid format chunk.');
+      }
+      const channelCount = readUInt(formatChunk, 10, 2);
+      const bytesPerSample = Math.ceil(readUInt(formatChunk, 22, 2) / 8);
+      const frameSize = channelCount * bytesPerSample;
+      if (frameSize === 0) {
+        throw new Error('Invalid format chunk.');
+      }
+
+      const header = new Uint8Array(12 + formatChunk.length + 8);
+      header.set(riffHeader);
+      header.set(formatChunk, 12);
+      header.set([0x64, 0x61, 0x74, 0x61], 12 + formatChunk.length);
+      // Checks the format on the header alone, whose data chunk is read as empty
+      decodeBlock(module, header, sampleRate);
+
+      // A truncated data chunk is read as far as it goes
+      const frameCount = Math.floor(Math.min(dataSize, source.size - dataStart) / frameSize);
+      return new WaveFileReader(source, header, sampleRate, frameSize, dataStart, frameCount);
+    } catch (error) {
+      source.close();
+      throw error;
+    }
+  }
+
+  /**
+   * Read up to `maxCount` of the next samples; the result is empty at the end of the file
+   */
+  async read(module: LipSyncEngineModule, maxCount: number): Promise<Int16Array> {
+    const count = Math.min(maxCount, this.remainingFrameCount);
+    if (count === 0) {
+      return new Int16Array(0);
+    }
+
+    const dataSize = count * this.frameSize;
+    const headerSize = this.header.length;
+    new DataView(this.header.buffer).setUint32(headerSize - 4, dataSize, true);
+    const bytesPtr = module._malloc(headerSize + dataSize);
+    if (!bytesPtr) {
+      throw new Error('Memory allocation failed');
+    }
+    try {
+      module.HEAPU8.set(this.header, bytesPtr);
+      // A view of WASM memory is only taken once nothing can grow it
+      await this.source.read(this.offset, dataSize, () =>
+        module.HEAPU8.subarray(bytesPtr + headerSize, bytesPtr + headerSize + dataSize));
+      this.offset += dataSize;
+      this.remainingFrameCount -= count;
+      return decodeBlock(
+        module,
+        module.HEAPU8.subarray(bytesPtr, bytesPtr + headerSize + dataSize),
+        this.sampleRate
+      );
+    } finally {
+      module._free(bytesPtr);
+    }
+  }
+
+  /**
+   * Release the file
+   */
+  close(): void {
+    this.source.close();
+  }
+}
+
+/**
+ * Decode a WAVE file, in WASM memory or out of it, to mono PCM16 at its own sample rate, at which
+ * the samples pass the resampler unchanged
+ */
+function decodeBlock(module: LipSyncEngineModule, bytes: Uint8Array, sampleRate: number): Int16Array {
+  const inHeap = bytes.buffer === module.HEAPU8.buffer;
+  let bytesPtr = inHeap ? bytes.byteOffset : 0;
+  let sampleCountPtr = 0;
+  let resultPtr = 0;
+  try {
+    if (!inHeap) {
+      bytesPtr = module._malloc(bytes.length);
+      module.HEAPU8.set(bytes, bytesPtr);
+    }
+    sampleCountPtr = module._malloc(4);
+
+    resultPtr = module._lipsyncengine_decode_wav(bytesPtr, bytes.length, sampleRate, sampleCountPtr);
+    if (!resultPtr) {
+      const errorPtr = module._lipsyncengine_get_last_error();
+      throw new Error(errorPtr ? module.UTF8ToString(errorPtr) : 'Decoding failed');
+    }
+
+    const sampleCount = module.HEAP32[sampleCountPtr / 4];
+    return module.HEAP16.slice(resultPtr / 2, resultPtr / 2 + sampleCount);
+  } finally {
+    if (!inHeap && bytesPtr) module._free(bytesPtr);
+    if (sampleCountPtr) module._free(sampleCountPtr);
+    if (resultPtr) module._lipsyncengine_free(resultPtr);
+  }
+}
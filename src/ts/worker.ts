@@ -4,54 +4,452 @@
  */
 
 import { WasmLoader } from './WasmLoader';
-import type { LipSyncEngineModule, LipSyncEngineOptions, LipSyncEngineResult } from './types';
+import { copyMouthCues } from './utils/mouthCues';
+import { findTentativeCuesChange } from './utils/cueDeltas';
+import { readFrames } from './utils/frames';
+import {
+  addMouthCueCallback,
+  addProgressCallback,
+  allocateOptions,
+  readStats,
+  readTimings,
+} from './utils/options';
+import { applyMemoryBudget } from './utils/memory';
+import { setModuleTracing, takeModuleTrace } from './utils/tracing';
+import { createSpeaker, saveSpeaker } from './utils/speakerProfile';
+import { convertToPcm16, decodeToPcm16 } from './utils/convert';
+import { SharedRingBuffer } from './utils/ringBuffer';
+import { decodeFrameActivity } from './utils/captureVad';
+import { WaveFileReader } from './utils/waveFile';
+import { SharedJobChannel, canUseJobChannels } from './utils/jobChannel';
+import { SharedEngineHost } from './utils/sharedEngine';
+import { LipSyncEngineStream } from './LipSyncEngineStream';
+import { warmupModule } from './utils/warmup';
+import { GpuGaussianScorer } from './utils/gpuScoring';
+import type { WarmupOptions } from './utils/warmup';
+import {
+  ModelLoader,
+  MODELS_DIRECTORY,
+  DEFAULT_PRELOADED_ASSETS,
+  applyLanguageModel,
+  getRequiredAssets,
+} from './utils/models';
+import type { SharedModelFiles } from './utils/models';
+import type {
+  LipSyncEngineModule,
+  LipSyncEngineFrames,
+  LipSyncEngineLanguageModel,
+  LipSyncEngineMemoryBudget,
+  LipSyncEngineModelAsset,
+  LipSyncEngineOptions,
+  LipSyncEngineStats,
+  LipSyncEngineTraceEvent,
+  LipSyncEngineWarmupLevel,
+  MouthCue,
+  TimedLabel,
+} from './types';
 
 // Worker message types
 export interface WorkerAnalyzeRequest {
   type: 'analyze';
   id: number;
   pcm16: Int16Array;
-  options: LipSyncEngineOptions;
+  /**
+   * Signals and callbacks can't be posted; the pool aborts through
+   * `WorkerInitResponse.cancelFlagPtr`
+   */
+  options: Omit<LipSyncEngineOptions, 'signal' | 'onProgress' | 'onMouthCues' | 'onPreview'>;
+  /** Post `WorkerProgressResponse`s during the analysis */
+  reportProgress?: boolean;
+  /** Post `WorkerMouthCuesResponse`s during the analysis */
+  reportMouthCues?: boolean;
+  /** Post a `WorkerPreviewResponse` before recognizing speech */
+  reportPreview?: boolean;
+  /** Model assets the job needs that the pool hasn't sent the worker yet */
+  sharedModels?: SharedModels;
 }
 
+/** Model files the pool shares with its workers instead of letting each fetch its own */
+export type SharedModels = Partial<Record<LipSyncEngineModelAsset, SharedModelFiles>>;
+
 export interface WorkerAnalyzeResponse {
   type: 'result' | 'error';
   id: number;
-  result?: LipSyncEngineResult;
+  /** The cues in the binary format (see `LipSyncEngineResult.packedMouthCues`), transferred */
+  packedMouthCues?: Int32Array;
+  /** The resampled shapes, if requested by `frameRate`, transferred */
+  frames?: LipSyncEngineFrames;
+  stats?: LipSyncEngineStats;
+  /** The recognized words and phones, if requested by `includeTimings` */
+  words?: TimedLabel[];
+  phones?: TimedLabel[];
+  /** The updated speaker profile, if the job had one, transferred */
+  speakerProfile?: Uint8Array;
+  error?: string;
+  /** Size of the worker's WASM memory after the job */
+  memoryBytes?: number;
+}
+
+/** Progress of an analysis, posted at most every 100 ms and once it reaches 1 */
+export interface WorkerProgressResponse {
+  type: 'progress';
+  id: number;
+  /** From 0 to 1 */
+  progress: number;
+  /** Estimated milliseconds until the analysis completes */
+  remainingMs: number;
+}
+
+/** Mouth cues of an analysis that became final, posted as they come */
+export interface WorkerMouthCuesResponse {
+  type: 'mouthCues';
+  id: number;
+  /** In seconds from the start */
+  mouthCues: MouthCue[];
+}
+
+/** Preview of the mouth cues of an analysis, posted once before speech is recognized */
+export interface WorkerPreviewResponse {
+  type: 'preview';
+  id: number;
+  /** In seconds from the start */
+  mouthCues: MouthCue[];
+}
+
+export interface WorkerConvertRequest {
+  type: 'convert';
+  id: number;
+  /** Samples in [-1, 1] of each channel, mixed down to mono */
+  channels: Float32Array[];
+  sampleRate: number;
+  targetSampleRate: number;
+}
+
+/** Decodes a WAVE file; answered like a `WorkerConvertRequest` */
+export interface WorkerDecodeRequest {
+  type: 'decode';
+  id: number;
+  /** Contents of the WAVE file */
+  bytes: Uint8Array;
+  targetSampleRate: number;
+}
+
+/** Errors of conversions are sent as a `WorkerAnalyzeResponse` of type 'error' */
+export interface WorkerConvertResponse {
+  type: 'converted';
+  id: number;
+  pcm16: Int16Array;
+  /** Size of the worker's WASM memory after the job */
+  memoryBytes?: number;
+}
+
+/** Frees the engine's cached decoders and dialog models, e.g. while the page is hidden */
+export interface WorkerReleaseCachesRequest {
+  type: 'releaseCaches';
+}
+
+/** Starts or stops recording trace spans; stopping discards those not taken yet */
+export interface WorkerSetTracingRequest {
+  type: 'setTracing';
+  enabled: boolean;
+}
+
+/** Takes the trace spans recorded since the last request, answered by a `WorkerTraceResponse` */
+export interface WorkerTakeTraceRequest {
+  type: 'takeTrace';
+  id: number;
+  /** Process ID of the events in the merged trace */
+  processId: number;
+}
+
+export interface WorkerTraceResponse {
+  type: 'trace';
+  id: number;
+  /** The spans, with timestamps in microseconds since the Unix epoch; empty on error */
+  events: LipSyncEngineTraceEvent[];
+}
+
+/** Warms up the worker's engine, answered by a `WorkerWarmupResponse` */
+export interface WorkerWarmupRequest {
+  type: 'warmup';
+  id: number;
+  level: LipSyncEngineWarmupLevel;
+  options: WarmupOptions;
+  /** Model assets the warmup needs that the pool hasn't sent the worker yet */
+  sharedModels?: SharedModels;
+}
+
+export interface WorkerWarmupResponse {
+  type: 'warmedUp';
+  id: number;
+  /** Why the warmup failed, if it did */
   error?: string;
+  /** Size of the worker's WASM memory after the warmup */
+  memoryBytes?: number;
+}
+
+/**
+ * Cancels an analysis of a worker whose build yields (see `WorkerInitResponse.canYield`), or
+ * closes a stream without analyzing its remaining audio; ignored once either has completed
+ */
+export interface WorkerCancelRequest {
+  type: 'cancel';
+  id: number;
+}
+
+export interface WorkerStreamBeginRequest {
+  type: 'streamBegin';
+  id: number;
+  /**
+   * Buffer of the `SharedRingBuffer` the capture worklet writes to; without it, the audio comes
+   * with `WorkerStreamPushRequest`s
+   */
+  ringBuffer?: SharedArrayBuffer;
+  /**
+   * Buffer of the `SharedRingBuffer` of the activity of each frame, if the capture worklet
+   * detects voice activity (see utils/captureVad.ts)
+   */
+  activityBuffer?: SharedArrayBuffer;
+  /**
+   * A WAVE file the worker reads and feeds to the session itself, block by block, ending the
+   * session after the last; its sample rate replaces `options.sampleRate`
+   */
+  file?: Blob | FileSystemFileHandle;
+  /** `sampleRate` is the sample rate of the stream's audio */
+  options: Omit<LipSyncEngineOptions, 'signal'>;
+  /** How often to move the audio from the ring buffer to the session, in milliseconds */
+  pollIntervalMs?: number;
+  /** Model assets the session needs that the pool hasn't sent the worker yet */
+  sharedModels?: SharedModels;
+}
+
+/** Audio of a stream without a ring buffer, transferred; answered by a `WorkerStreamCuesResponse` */
+export interface WorkerStreamPushRequest {
+  type: 'streamPush';
+  id: number;
+  pcm16: Int16Array;
+  /** Send the buffer of `pcm16` back with the response, for the next chunk */
+  returnBuffer?: boolean;
+}
+
+export interface WorkerStreamEndRequest {
+  type: 'streamEnd';
+  id: number;
+}
+
+/** Errors of streams are sent as a `WorkerAnalyzeResponse` of type 'error' */
+export interface WorkerStreamCuesResponse {
+  type: 'streamCues';
+  id: number;
+  /** Cues finalized since the previous response, in seconds from the start of the capture */
+  mouthCues: MouthCue[];
+  /**
+   * The provisional cues following all finalized ones from `tentativeFrom` on, if they changed
+   * since the previous response; they replace the previous response's cues from that index on
+   */
+  tentativeCues?: MouthCue[];
+  /** See `LipSyncEngineStreamResult.tentativeFrom`; set along with `tentativeCues` */
+  tentativeFrom?: number;
+  /** See `LipSyncEngineStreamResult.generation` */
+  generation: number;
+  /** True for the last response, after `WorkerStreamEndRequest` */
+  final: boolean;
+  /** The buffer of the pushed audio this answers, if its request had `returnBuffer`, transferred */
+  returnedBuffer?: ArrayBuffer;
+  /** See `LipSyncEngineStreamResult.fallback` */
+  fallback: boolean;
+  /** See `LipSyncEngineStreamResult.quality` */
+  quality: string;
+  /** See `LipSyncEngineStreamResult.realTimeFactor` */
+  realTimeFactor: number;
+  /** Samples dropped so far because the worker fell behind the capture */
+  droppedSamples: number;
+}
+
+/**
+ * Ends the connection of a pool to a worker shared by several pools (see `SharedEngineHost`),
+ * dropping its jobs and streams
+ */
+export interface WorkerDisconnectRequest {
+  type: 'disconnect';
 }
 
 export interface WorkerInitRequest {
   type: 'init';
   wasmPath: string;
-  dataPath: string;
   jsPath: string;
+  /** URL of the directory containing the model files */
+  modelsPath: string;
+  /** The build compiled by the pool, so that the worker doesn't fetch and compile `wasmPath` */
+  wasmModule?: WebAssembly.Module;
+  /** Whether to keep the downloaded files in Cache Storage */
+  cache?: boolean;
+  /** Assets to start fetching during initialization */
+  preloadModels?: LipSyncEngineModelAsset[];
+  /** Variant of the language model */
+  languageModel?: LipSyncEngineLanguageModel;
+  /** Whether to fetch the language model's n-grams page by page */
+  pagedLanguageModel?: boolean;
+  /** Shared model assets, at least the acoustic model, if the pool shares the models */
+  sharedModels?: SharedModels;
+  /** Memory budget of the worker's module, if any */
+  memoryBudget?: LipSyncEngineMemoryBudget;
+  /** Whether to record trace spans from the start */
+  tracing?: boolean;
+  /** Buffer of a `SharedJobChannel` to take analyses from besides `WorkerAnalyzeRequest`s */
+  jobChannel?: SharedArrayBuffer;
+  /** Whether to score acoustic models on the GPU where WebGPU is available (JSPI build) */
+  gpuScoring?: boolean;
 }
 
 export interface WorkerInitResponse {
   type: 'ready' | 'error';
   error?: string;
+  /** Memory of the worker's module, if it is shared (multithreaded build) */
+  memory?: SharedArrayBuffer;
+  /** Address of the int32 in `memory` that cancels the running analysis once set to 1 */
+  cancelFlagPtr?: number;
+  /** Size of the worker's WASM memory */
+  memoryBytes?: number;
+  /**
+   * Whether analyses yield to the worker's event loop (JSPI build), so that a
+   * `WorkerCancelRequest` stops them
+   */
+  canYield?: boolean;
+  /** Whether the worker takes analyses from `WorkerInitRequest.jobChannel` */
+  jobChannel?: boolean;
 }
 
-export type WorkerRequest = WorkerAnalyzeRequest | WorkerInitRequest;
-export type WorkerResponse = WorkerAnalyzeResponse | WorkerInitResponse;
+export type WorkerRequest =
+  | WorkerAnalyzeRequest
+  | WorkerConvertRequest
+  | WorkerDecodeRequest
+  | WorkerStreamBeginRequest
+  | WorkerStreamPushRequest
+  | WorkerStreamEndRequest
+  | WorkerReleaseCachesRequest
+  | WorkerSetTracingRequest
+  | WorkerTakeTraceRequest
+  | WorkerWarmupRequest
+  | WorkerCancelRequest
+  | WorkerDisconnectRequest
+  | WorkerInitRequest;
+export type WorkerResponse =
+  | WorkerAnalyzeResponse
+  | WorkerProgressResponse
+  | WorkerMouthCuesResponse
+  | WorkerPreviewResponse
+  | WorkerConvertResponse
+  | WorkerStreamCuesResponse
+  | WorkerTraceResponse
+  | WorkerWarmupResponse
+  | WorkerInitResponse;
 
 // Worker state
 let wasmModule: LipSyncEngineModule | null = null;
-let modelsPath = '/models';
+let models: ModelLoader | null = null;
+let workerMemoryBudget: LipSyncEngineMemoryBudget | undefined;
+// Cancels the running analysis once non-zero; reset before each analysis
+let cancelFlagPtr = 0;
+// Posts the progress of the analysis in progressJob
+let progressCallbackPtr = 0;
+// The analysis whose progress is posted, and when it was last posted
+let progressJob: { id: number; postedAt: number } | null = null;
+// Posts the mouth cues of the analysis in mouthCuesJobId
+let mouthCueCallbackPtr = 0;
+// The analysis whose mouth cues are posted
+let mouthCuesJobId: number | null = null;
+// Posts the preview of the analysis in previewJobId
+let previewCallbackPtr = 0;
+// The analysis whose preview is posted
+let previewJobId: number | null = null;
+/** Progress is posted at most this often, in milliseconds */
+const PROGRESS_INTERVAL_MS = 100;
+// Whether analyses yield to the event loop, which the JSPI build's do
+let canYield = false;
+// The running analysis, which a WorkerCancelRequest cancels
+let analysisId: number | null = null;
+// Whether the running analysis is suspended in WASM; the module can't be called into meanwhile
+let analysisYielding = false;
+// Messages received while the analysis was suspended, handled once it completes
+const deferredMessages: WorkerRequest[] = [];
+// Resolved once the suspended analysis completes
+const analysisWaiters: Array<() => void> = [];
+/** Yielding analyses yield at most this often, in milliseconds */
+const YIELD_INTERVAL_MS = 50;
+// Scores the module's blocks of frames on the GPU, if the pool asked for it and it is available
+let gpuScorer: GpuGaussianScorer | null = null;
+
+/**
+ * A streaming session fed from a capture ring buffer, or by `WorkerStreamPushRequest`s
+ */
+interface LiveStream {
+  id: number;
+  stream: LipSyncEngineStream;
+  ringBuffer: SharedRingBuffer | null;
+  /** The activity of the frames in `ringBuffer`, if the capture worklet detects it */
+  activityRing: SharedRingBuffer | null;
+  /** Index of the next frame of `activityRing` */
+  frameIndex: number;
+  sampleRate: number;
+  timer?: ReturnType<typeof setInterval>;
+  /** The tentative cues of the last response */
+  tentativeCues: MouthCue[];
+  /** The generation of the last response, see `LipSyncEngineStreamResult.generation` */
+  generation: number;
+}
+
+// The open live streams by id; a worker shared by several pools runs one per stream of theirs
+const liveStreams = new Map<number, LiveStream>();
+// Settle once the last request of each stream has been handled, so that each request waits for
+// the previous one, and those following the WorkerStreamBeginRequest for the session, which may
+// have to load models first
+const liveStreamRequests = new Map<number, Promise<void>>();
+
+// Posts a response to the pool; in a SharedWorker, to the connection whose request it answers
+let postResponse = (response: WorkerResponse, transfer: Transferable[] = []): void => {
+  self.postMessage(response, { transfer });
+};
 
 /**
  * Initialize WASM module in worker context
  */
-async function initializeWorker(wasmPath: string, dataPath: string, jsPath: string): Promise<void> {
+async function initializeWorker(message: WorkerInitRequest): Promise<void> {
+  const { wasmPath, jsPath, memoryBudget, cache } = message;
   try {
     wasmModule = await WasmLoader.loadModule({
       wasmPath,
-      dataPath,
-      jsPath
+      jsPath,
+      wasmModule: message.wasmModule,
+      cache
     });
 
+    // The engine only uses the models directory if it contains the acoustic model
+    const languageModel = message.languageModel ?? 'full';
+    models = new ModelLoader(
+      wasmModule,
+      message.modelsPath,
+      cache !== false,
+      languageModel,
+      message.pagedLanguageModel === true
+    );
+    models.whenIdle = waitForSuspendedAnalysis;
+    installSharedModels(message.sharedModels);
+    models.preload(message.preloadModels ?? DEFAULT_PRELOADED_ASSETS);
+    applyLanguageModel(wasmModule, languageModel);
+    await models.load('acousticModel');
+
+    // Decoders only score on the GPU if it is enabled when they are created
+    if (message.gpuScoring && wasmModule._lipsyncengine_can_yield() === 1) {
+      gpuScorer = await GpuGaussianScorer.create();
+      if (gpuScorer) {
+        wasmModule.lipsyncengineGpuScorer = gpuScorer;
+        wasmModule._lipsyncengine_set_gpu_scoring(1);
+      }
+    }
+
     // Initialize the engine
+    const modelsPath = MODELS_DIRECTORY;
     const modelsPathPtr = wasmModule._malloc(modelsPath.length + 1);
     wasmModule.stringToUTF8(modelsPath, modelsPathPtr, modelsPath.length + 1);
 
@@ -63,102 +461,660 @@ async function initializeWorker(wasmPath: string, dataPath: string, jsPath: stri
       const errorMsg = errorPtr ? wasmModule.UTF8ToString(errorPtr) : 'Unknown initialization error';
       throw new Error(errorMsg);
     }
+
+    if (memoryBudget) {
+      applyMemoryBudget(wasmModule, memoryBudget);
+      workerMemoryBudget = memoryBudget;
+    }
+    if (message.tracing) {
+      setModuleTracing(wasmModule, true);
+    }
+
+    cancelFlagPtr = wasmModule._malloc(4);
+    wasmModule.HEAP32[cancelFlagPtr / 4] = 0;
+    canYield = wasmModule._lipsyncengine_can_yield() === 1;
+    progressCallbackPtr = addProgressCallback(wasmModule, postProgress);
+    mouthCueCallbackPtr = addMouthCueCallback(wasmModule, postMouthCues);
+    previewCallbackPtr = addMouthCueCallback(wasmModule, postPreview);
+
+    // Keep the input and output buffers across analyses, sparing a malloc and free of each per
+    // analysis, which fragment the heap over long sessions
+    wasmModule._lipsyncengine_reuse_output(1);
   } catch (error) {
     throw new Error(`Worker initialization failed: ${error instanceof Error ? error.message : String(error)}`);
   }
 }
 
 /**
- * Analyze audio in worker context
+ * Size of the worker's WASM memory, which grows as needed and never shrinks
+ */
+function getMemoryBytes(): number | undefined {
+  return wasmModule?.HEAP32.buffer.byteLength;
+}
+
+/**
+ * Use the model files shared by the pool
  */
-function analyzeAudio(pcm16: Int16Array, options: LipSyncEngineOptions): LipSyncEngineResult {
-  if (!wasmModule) {
+function installSharedModels(sharedModels?: SharedModels): void {
+  if (!models || !sharedModels) return;
+  for (const [asset, files] of Object.entries(sharedModels)) {
+    if (files) {
+      models.install(asset as LipSyncEngineModelAsset, files);
+    }
+  }
+}
+
+/**
+ * Post the progress of the running analysis, if it reports progress
+ * Progress is reported from within the analysis, which blocks the worker, so posting it is the
+ * only way to pass it on. It is throttled, apart from completion.
+ */
+function postProgress(progress: number, remainingMs: number): void {
+  if (!progressJob) return;
+  const now = performance.now();
+  if (progress < 1 && now - progressJob.postedAt < PROGRESS_INTERVAL_MS) return;
+  progressJob.postedAt = now;
+  const message: WorkerProgressResponse = {
+    type: 'progress',
+    id: progressJob.id,
+    progress,
+    remainingMs,
+  };
+  postResponse(message);
+}
+
+/**
+ * Post the mouth cues of the running analysis that became final, if it reports them
+ * Unlike progress, they aren't throttled, as each call only comes once an utterance is recognized.
+ */
+function postMouthCues(mouthCues: MouthCue[]): void {
+  if (mouthCuesJobId === null) return;
+  const message: WorkerMouthCuesResponse = {
+    type: 'mouthCues',
+    id: mouthCuesJobId,
+    mouthCues,
+  };
+  postResponse(message);
+}
+
+/** Post the preview of the running analysis, if it reports it */
+function postPreview(mouthCues: MouthCue[]): void {
+  if (previewJobId === null) return;
+  const message: WorkerPreviewResponse = {
+    type: 'preview',
+    id: previewJobId,
+    mouthCues,
+  };
+  postResponse(message);
+}
+
+/** Result of `analyzeAudio`, in the form it is posted */
+interface AnalysisResult {
+  packedMouthCues: Int32Array;
+  frames?: LipSyncEngineFrames;
+  stats?: LipSyncEngineStats;
+  words?: TimedLabel[];
+  phones?: TimedLabel[];
+  speakerProfile?: Uint8Array;
+}
+
+/**
+ * Analyze audio in worker context, once the model assets it needs are loaded
+ *
+ * @param id - Job id, to post the progress with and to cancel the analysis with
+ * @param reportProgress - Post the progress of the analysis
+ * @param reportMouthCues - Post the mouth cues of the analysis as they become final
+ * @param reportPreview - Post the preview of the analysis
+ */
+async function analyzeAudio(
+  id: number,
+  pcm16: Int16Array,
+  options: Omit<LipSyncEngineOptions, 'signal' | 'onProgress' | 'onMouthCues' | 'onPreview'>,
+  reportProgress = false,
+  reportMouthCues = false,
+  reportPreview = false
+): Promise<AnalysisResult> {
+  if (!wasmModule || !models) {
     throw new Error('Worker not initialized');
   }
 
+  // Reset the cancel flag before waiting, so that aborting during the wait cancels the analysis
+  wasmModule.HEAP32[cancelFlagPtr / 4] = 0;
+  analysisId = id;
+  try {
+    await models.loadAll(getRequiredAssets(options, workerMemoryBudget));
+    return await runAnalysis(
+      wasmModule,
+      id,
+      pcm16,
+      options,
+      reportProgress,
+      reportMouthCues,
+      reportPreview
+    );
+  } finally {
+    analysisId = null;
+  }
+}
+
+/**
+ * Run an analysis whose model assets are loaded
+ */
+async function runAnalysis(
+  module: LipSyncEngineModule,
+  id: number,
+  pcm16: Int16Array,
+  options: Omit<LipSyncEngineOptions, 'signal' | 'onProgress' | 'onMouthCues' | 'onPreview'>,
+  reportProgress: boolean,
+  reportMouthCues: boolean,
+  reportPreview: boolean
+): Promise<AnalysisResult> {
   const sampleRate = options.sampleRate || 16000;
   const dialogText = options.dialogText || '';
 
-  // Allocate memory for PCM buffer
-  const pcmByteLength = pcm16.length * 2;
-  const pcmPtr = wasmModule._malloc(pcmByteLength);
-  wasmModule.HEAP16.set(pcm16, pcmPtr / 2);
+  // Copy the audio into the engine's input buffer, its only copy in WASM memory
+  const pcmPtr = module._lipsyncengine_reserve_input(pcm16.length * 2);
+  if (!pcmPtr) {
+    throw new Error('Failed to allocate the input buffer');
+  }
+  module.HEAP16.set(pcm16, pcmPtr / 2);
+
+  // Allocate memory for the options, as encoding them validates them
+  const speaker = options.speakerProfile ? createSpeaker(module, options.speakerProfile) : 0;
+  let optionsPtr: number;
+  try {
+    optionsPtr = allocateOptions(
+      module,
+      options,
+      cancelFlagPtr,
+      reportProgress ? progressCallbackPtr : 0,
+      canYield ? YIELD_INTERVAL_MS : 0,
+      reportMouthCues ? mouthCueCallbackPtr : 0,
+      speaker,
+      reportPreview ? previewCallbackPtr : 0
+    );
+  } catch (error) {
+    if (speaker) module._lipsyncengine_speaker_release(speaker);
+    throw error;
+  }
 
   // Allocate memory for dialog text (if provided)
   let dialogPtr = 0;
   if (dialogText) {
-    const dialogByteLength = wasmModule.lengthBytesUTF8(dialogText) + 1;
-    dialogPtr = wasmModule._malloc(dialogByteLength);
-    wasmModule.stringToUTF8(dialogText, dialogPtr, dialogByteLength);
+    const dialogByteLength = module.lengthBytesUTF8(dialogText) + 1;
+    dialogPtr = module._malloc(dialogByteLength);
+    module.stringToUTF8(dialogText, dialogPtr, dialogByteLength);
+  }
+
+  module._lipsyncengine_set_max_thread_count(Math.max(1, options.threadCount || 1));
+
+  // Allocate memory for the cue count
+  const cueCountPtr = module._malloc(4);
+
+  if (reportProgress) {
+    progressJob = { id, postedAt: -Infinity };
+  }
+  if (reportMouthCues) {
+    mouthCuesJobId = id;
+  }
+  if (reportPreview) {
+    previewJobId = id;
   }
 
   try {
-    // Call analysis function
-    const resultPtr = wasmModule._lipsyncengine_analyze_pcm16(
+    // Call analysis function, receiving the cues in binary format. The JSPI build returns a
+    // Promise, and the worker handles cancel requests while the analysis yields.
+    analysisYielding = canYield;
+    const resultPtr = await module._lipsyncengine_analyze_pcm16_binary(
       pcmPtr,
       pcm16.length,
       sampleRate,
-      dialogPtr
+      dialogPtr,
+      optionsPtr,
+      cueCountPtr
     );
+    analysisYielding = false;
 
     // Check for errors
     if (!resultPtr) {
-      const errorPtr = wasmModule._lipsyncengine_get_last_error();
-      const errorMsg = errorPtr ? wasmModule.UTF8ToString(errorPtr) : 'Unknown analysis error';
+      const errorPtr = module._lipsyncengine_get_last_error();
+      const errorMsg = errorPtr ? module.UTF8ToString(errorPtr) : 'Unknown analysis error';
       throw new Error(errorMsg);
     }
 
-    // Parse JSON result
-    const jsonString = wasmModule.UTF8ToString(resultPtr);
-    const result = JSON.parse(jsonString) as LipSyncEngineResult;
+    // Copy the cues out of WASM memory as they are, to be transferred
+    const cueCount = module.HEAP32[cueCountPtr / 4];
+    const result: AnalysisResult = {
+      packedMouthCues: copyMouthCues(module, resultPtr, cueCount),
+    };
+    if (options.frameRate !== undefined) {
+      result.frames = readFrames(module, resultPtr, cueCount, options);
+    }
+    const stats = readStats(module, optionsPtr);
+    if (stats) {
+      result.stats = stats;
+    }
+    const timings = readTimings(module, optionsPtr);
+    if (timings) {
+      result.words = timings.words;
+      result.phones = timings.phones;
+    }
+    if (speaker) {
+      result.speakerProfile = saveSpeaker(module, speaker);
+    }
 
-    // Free result memory
-    wasmModule._lipsyncengine_free(resultPtr);
+    // Free result memory (a no-op for the reused output buffer)
+    module._lipsyncengine_free(resultPtr);
 
     return result;
   } finally {
-    // Always free allocated memory
-    wasmModule._free(pcmPtr);
+    progressJob = null;
+    mouthCuesJobId = null;
+    previewJobId = null;
+    analysisYielding = false;
+
+    // Always free allocated memory; the input buffer is kept for the next analysis
+    module._free(optionsPtr);
+    module._free(cueCountPtr);
     if (dialogPtr) {
-      wasmModule._free(dialogPtr);
+      module._free(dialogPtr);
+    }
+    if (speaker) {
+      module._lipsyncengine_speaker_release(speaker);
     }
+
+    if (deferredMessages.length > 0) {
+      queueMicrotask(handleDeferredMessages);
+    }
+    analysisWaiters.splice(0).forEach(resolve => resolve());
+  }
+}
+
+/**
+ * Handle the messages received while an analysis was suspended
+ */
+function handleDeferredMessages(): void {
+  while (deferredMessages.length > 0 && !analysisYielding) {
+    handleMessage(deferredMessages.shift()!);
+  }
+}
+
+/**
+ * Wait until no analysis is suspended, so that the module can be called into
+ * Only needed where an analysis may run meanwhile, i.e. in a worker shared by several pools.
+ */
+async function waitForSuspendedAnalysis(): Promise<void> {
+  while (analysisYielding) {
+    await new Promise<void>(resolve => analysisWaiters.push(resolve));
   }
 }
 
 /**
- * Message handler for worker
+ * Begin a streaming session that reads its audio from a capture ring buffer, if given
  */
-self.onmessage = async (event: MessageEvent<WorkerRequest>) => {
-  const message = event.data;
+async function beginLiveStream(message: WorkerStreamBeginRequest): Promise<void> {
+  if (!wasmModule || !models) {
+    throw new Error('Worker not initialized');
+  }
+  await models.loadAll(getRequiredAssets(message.options, workerMemoryBudget));
+  await waitForSuspendedAnalysis();
+  const file = message.file ? await WaveFileReader.open(wasmModule, message.file) : null;
+  let stream: LipSyncEngineStream;
+  try {
+    stream = LipSyncEngineStream.begin(
+      wasmModule,
+      file ? { ...message.options, sampleRate: file.sampleRate } : message.options
+    );
+  } catch (error) {
+    file?.close();
+    throw error;
+  }
+  const live: LiveStream = {
+    id: message.id,
+    stream,
+    ringBuffer: message.ringBuffer ? new SharedRingBuffer(message.ringBuffer) : null,
+    activityRing: message.activityBuffer ? new SharedRingBuffer(message.activityBuffer) : null,
+    frameIndex: 0,
+    sampleRate: file?.sampleRate ?? message.options.sampleRate ?? 16000,
+    tentativeCues: [],
+    generation: 0,
+  };
+  if (live.ringBuffer) {
+    live.timer = setInterval(() => drainLiveStream(live), message.pollIntervalMs ?? 20);
+  }
+  liveStreams.set(live.id, live);
+  if (file) {
+    // Runs on after the begin request has been handled, so that a cancel request can stop it
+    readLiveStreamFile(live, file);
+  }
+}
+
+/** Samples of a file pushed to its session at once: one second */
+const FILE_BLOCK_SECONDS = 1;
+
+/**
+ * Feed a file to its session block by block, posting the cues it finalizes, then end the session
+ * The worker handles other messages between blocks, e.g. a cancel request, which closes the
+ * session and stops the reading.
+ */
+async function readLiveStreamFile(live: LiveStream, file: WaveFileReader): Promise<void> {
+  try {
+    for (;;) {
+      await waitForSuspendedAnalysis();
+      if (liveStreams.get(live.id) !== live) return;
+      const pcm16 = await file.read(wasmModule!, file.sampleRate * FILE_BLOCK_SECONDS);
+      if (liveStreams.get(live.id) !== live) return;
+      const end = pcm16.length === 0;
+      feedLiveStream(live, pcm16, end, false);
+      if (end) return;
+      await new Promise(resolve => setTimeout(resolve, 0));
+    }
+  } catch (error) {
+    if (liveStreams.get(live.id) === live) {
+      live.stream.abort();
+      stopLiveStream(live);
+      const response: WorkerAnalyzeResponse = {
+        type: 'error',
+        id: live.id,
+        error: error instanceof Error ? error.message : String(error)
+      };
+      postResponse(response);
+    }
+  } finally {
+    file.close();
+  }
+}
 
+/**
+ * Push the captured audio to the session and post the cues it finalized
+ * Recognition runs here, so a tick may take longer than the poll interval; the ring buffer holds
+ * the audio captured meanwhile.
+ */
+function drainLiveStream(live: LiveStream, end = false): void {
+  if (!live.activityRing) {
+    feedLiveStream(live, live.ringBuffer?.read() ?? new Int16Array(0), end, false);
+    return;
+  }
+  // The worklet writes the samples of a frame before its entry, so they are all there
+  const { frameActivity, sampleCount } =
+    decodeFrameActivity(live.activityRing.read(), live.frameIndex, live.sampleRate);
+  live.frameIndex += frameActivity.length;
+  feedLiveStream(live, live.ringBuffer!.read(sampleCount), end, false, frameActivity);
+}
+
+/**
+ * Push audio to the session and post the cues it finalized
+ *
+ * @param acknowledge - Post a response even if nothing changed, as pushed audio expects one
+ * @param frameActivity - The activity of the audio's frames, if the capture worklet detected it
+ */
+function feedLiveStream(
+  live: LiveStream,
+  pcm16: Int16Array,
+  end: boolean,
+  acknowledge: boolean,
+  frameActivity?: Uint8Array,
+  returnedBuffer?: ArrayBuffer
+): void {
+  try {
+    const { mouthCues, tentativeCues, fallback, quality, realTimeFactor } = frameActivity
+      ? live.stream.pushActivity(pcm16, frameActivity)
+      : live.stream.push(pcm16);
+    const cues = end ? [...mouthCues, ...live.stream.end().mouthCues] : mouthCues;
+    const newTentativeCues = end ? [] : tentativeCues;
+    // Only the tentative cues that changed are posted
+    const tentativeFrom = findTentativeCuesChange(live.tentativeCues, newTentativeCues);
+    if (cues.length > 0 || tentativeFrom !== null) {
+      live.generation++;
+    }
+    if (cues.length > 0 || tentativeFrom !== null || end || acknowledge) {
+      const response: WorkerStreamCuesResponse = {
+        type: 'streamCues',
+        id: live.id,
+        mouthCues: cues,
+        ...(tentativeFrom !== null && {
+          tentativeCues: newTentativeCues.slice(tentativeFrom),
+          tentativeFrom,
+        }),
+        generation: live.generation,
+        final: end,
+        fallback,
+        quality,
+        realTimeFactor,
+        droppedSamples: live.ringBuffer?.getDroppedCount() ?? 0,
+        ...(returnedBuffer && { returnedBuffer }),
+      };
+      live.tentativeCues = newTentativeCues;
+      postResponse(response, returnedBuffer ? [returnedBuffer] : []);
+    }
+    if (end) {
+      stopLiveStream(live);
+    }
+  } catch (error) {
+    stopLiveStream(live);
+    const response: WorkerAnalyzeResponse = {
+      type: 'error',
+      id: live.id,
+      error: error instanceof Error ? error.message : String(error)
+    };
+    postResponse(response);
+  }
+}
+
+function stopLiveStream(live: LiveStream): void {
+  clearInterval(live.timer);
+  if (liveStreams.get(live.id) === live) {
+    liveStreams.delete(live.id);
+    liveStreamRequests.delete(live.id);
+  }
+}
+
+/**
+ * Run an analysis request, whether posted or taken from the job channel
+ */
+async function handleAnalyzeRequest(message: WorkerAnalyzeRequest): Promise<WorkerAnalyzeResponse> {
+  try {
+    installSharedModels(message.sharedModels);
+    const { packedMouthCues, frames, stats, words, phones, speakerProfile } = await analyzeAudio(
+      message.id,
+      message.pcm16,
+      message.options,
+      message.reportProgress,
+      message.reportMouthCues,
+      message.reportPreview
+    );
+    return {
+      type: 'result',
+      id: message.id,
+      packedMouthCues,
+      frames,
+      stats,
+      words,
+      phones,
+      speakerProfile,
+      memoryBytes: getMemoryBytes()
+    };
+  } catch (error) {
+    return {
+      type: 'error',
+      id: message.id,
+      error: error instanceof Error ? error.message : String(error)
+    };
+  }
+}
+
+/**
+ * Take analyses from the pool's job channel and post their results back, for as long as the
+ * worker lives
+ * The channel is waited for asynchronously, so messages are still handled in between.
+ */
+async function serveJobChannel(channel: SharedJobChannel): Promise<void> {
+  for (;;) {
+    const request = await channel.takeRequest();
+    channel.postResponse(await handleAnalyzeRequest(request));
+  }
+}
+
+/**
+ * Handle a request, or defer it while the running analysis is suspended
+ */
+function receive(message: WorkerRequest): void {
+  if (message.type === 'cancel' && analysisId === message.id) {
+    if (wasmModule) {
+      wasmModule.HEAP32[cancelFlagPtr / 4] = 1;
+    }
+  } else if (analysisYielding) {
+    deferredMessages.push(message);
+  } else {
+    handleMessage(message);
+  }
+}
+
+if ('onconnect' in self) {
+  // A SharedWorker: one engine serves the pools of all tabs that connect
+  const host = new SharedEngineHost({ receive, run: handleMessage });
+  postResponse = (response, transfer = []) => host.route(response, transfer);
+  const scope = self as unknown as { onconnect: ((event: MessageEvent) => void) | null };
+  scope.onconnect = (event) => host.connect(event.ports[0]);
+} else {
+  self.onmessage = (event: MessageEvent<WorkerRequest>) => receive(event.data);
+}
+
+async function handleMessage(message: WorkerRequest): Promise<void> {
   if (message.type === 'init') {
     try {
-      await initializeWorker(message.wasmPath, message.dataPath, message.jsPath);
-      const response: WorkerInitResponse = { type: 'ready' };
-      self.postMessage(response);
+      await initializeWorker(message);
+      const response: WorkerInitResponse = { type: 'ready', memoryBytes: getMemoryBytes(), canYield };
+      const memory = wasmModule?.HEAP32.buffer;
+      if (typeof SharedArrayBuffer !== 'undefined' && memory instanceof SharedArrayBuffer) {
+        response.memory = memory;
+        response.cancelFlagPtr = cancelFlagPtr;
+      }
+      if (message.jobChannel && canUseJobChannels()) {
+        serveJobChannel(new SharedJobChannel(message.jobChannel));
+        response.jobChannel = true;
+      }
+      postResponse(response);
     } catch (error) {
       const response: WorkerInitResponse = {
         type: 'error',
         error: error instanceof Error ? error.message : String(error)
       };
-      self.postMessage(response);
+      postResponse(response);
     }
   } else if (message.type === 'analyze') {
+    const response = await handleAnalyzeRequest(message);
+    const transfer: Transferable[] = [];
+    if (response.packedMouthCues) transfer.push(response.packedMouthCues.buffer);
+    if (response.speakerProfile) transfer.push(response.speakerProfile.buffer);
+    if (response.frames) {
+      transfer.push(response.frames.shapes.buffer);
+      if (response.frames.blendShapes) transfer.push(response.frames.blendShapes.buffer);
+      if (response.frames.blendWeights) transfer.push(response.frames.blendWeights.buffer);
+    }
+    postResponse(response, transfer);
+  } else if (message.type === 'streamBegin') {
+    const started = (async () => {
+      try {
+        installSharedModels(message.sharedModels);
+        await beginLiveStream(message);
+      } catch (error) {
+        const response: WorkerAnalyzeResponse = {
+          type: 'error',
+          id: message.id,
+          error: error instanceof Error ? error.message : String(error)
+        };
+        postResponse(response);
+        liveStreamRequests.delete(message.id);
+      }
+    })();
+    liveStreamRequests.set(message.id, started);
+    await started;
+  } else if (
+    message.type === 'streamPush' ||
+    message.type === 'streamEnd' ||
+    message.type === 'cancel'
+  ) {
+    // Requests after a failed begin find no session; its error has been posted
+    const request = message;
+    const previous = liveStreamRequests.get(request.id);
+    if (!previous) return;
+    const handled = previous.then(async () => {
+      await waitForSuspendedAnalysis();
+      const live = liveStreams.get(request.id);
+      if (!live) return;
+      if (request.type === 'streamPush') {
+        // The samples have been copied into WASM memory once it returns
+        const buffer = request.returnBuffer ? request.pcm16.buffer as ArrayBuffer : undefined;
+        feedLiveStream(live, request.pcm16, false, true, undefined, buffer);
+      } else if (request.type === 'streamEnd') {
+        drainLiveStream(live, true);
+      } else {
+        live.stream.abort();
+        stopLiveStream(live);
+      }
+    });
+    liveStreamRequests.set(request.id, handled);
+    await handled;
+  } else if (message.type === 'releaseCaches') {
+    // Fails harmlessly while a live stream holds decoders
+    if (wasmModule) {
+      // Also frees the input and output buffers
+      wasmModule._lipsyncengine_release_caches();
+    }
+    gpuScorer?.releaseModels();
+  } else if (message.type === 'setTracing') {
+    if (wasmModule) {
+      setModuleTracing(wasmModule, message.enabled);
+    }
+  } else if (message.type === 'takeTrace') {
+    let events: LipSyncEngineTraceEvent[] = [];
     try {
-      const result = analyzeAudio(message.pcm16, message.options);
-      const response: WorkerAnalyzeResponse = {
-        type: 'result',
+      if (wasmModule) {
+        events = takeModuleTrace(wasmModule, message.processId);
+      }
+    } catch (error) {
+      console.warn('Taking the trace failed:', error);
+    }
+    const response: WorkerTraceResponse = { type: 'trace', id: message.id, events };
+    postResponse(response);
+  } else if (message.type === 'warmup') {
+    const response: WorkerWarmupResponse = { type: 'warmedUp', id: message.id };
+    try {
+      if (!wasmModule || !models) {
+        throw new Error('Worker not initialized');
+      }
+      installSharedModels(message.sharedModels);
+      await models.loadAll(getRequiredAssets(message.options, workerMemoryBudget));
+      warmupModule(wasmModule, message.level, message.options);
+    } catch (error) {
+      response.error = error instanceof Error ? error.message : String(error);
+    }
+    response.memoryBytes = getMemoryBytes();
+    postResponse(response);
+  } else if (message.type === 'convert' || message.type === 'decode') {
+    try {
+      if (!wasmModule) {
+        throw new Error('Worker not initialized');
+      }
+      const pcm16 =
+        message.type === 'decode'
+          ? decodeToPcm16(wasmModule, message.bytes, message.targetSampleRate)
+          : convertToPcm16(wasmModule, message.channels, message.sampleRate, message.targetSampleRate);
+      const response: WorkerConvertResponse = {
+        type: 'converted',
         id: message.id,
-        result
+        pcm16,
+        memoryBytes: getMemoryBytes()
       };
-      self.postMessage(response);
+      postResponse(response, [pcm16.buffer]);
     } catch (error) {
       const response: WorkerAnalyzeResponse = {
         type: 'error',
         id: message.id,
         error: error instanceof Error ? error.message : String(error)
       };
-      self.postMessage(response);
+      postResponse(response);
     }
   }
-};
+}
@@ -0,0 +1,153 @@
+// Checks that lipsyncengine_stream_restore() rejects tampered stream states instead of reading
+// outside of their samples.
+// Usage: lip-sync-engine-stream-state-test <models directory>
+
+#include "bridge.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+	int failureCount = 0;
+
+	void check(bool condition, const std::string& description) {
+		if (!condition) {
+			const char* error = lipsyncengine_get_last_error();
+			std::fprintf(stderr, "FAILED: %s (%s)\n", description.c_str(), error ? error : "no error");
+			++failureCount;
+		}
+	}
+
+	// Speech-like audio: a buzz swelling like syllables, with a pause after each second
+	std::vector<int16_t> createSpeech(int sampleRate, double seconds) {
+		const double pi = std::acos(-1.0);
+		std::vector<int16_t> samples(static_cast<size_t>(sampleRate * seconds));
+		for (size_t i = 0; i < samples.size(); ++i) {
+			const double time = static_cast<double>(i) / sampleRate;
+			if (std::fmod(time, 1.5) >= 1.0) continue;
+			const double envelope = 0.5 - 0.5 * std::cos(2 * pi * 3 * time);
+			double value = 0;
+			for (int overtone = 1; overtone <= 7; ++overtone) {
+				value += std::sin(2 * pi * 120 * overtone * time) / overtone;
+			}
+			samples[i] = static_cast<int16_t>(3000 * envelope * value);
+		}
+		return samples;
+	}
+
+	uint32_t readUInt(const std::vector<uint8_t>& bytes, size_t offset) {
+		uint32_t value = 0;
+		for (int i = 3; i >= 0; --i) {
+			value = value << 8 | bytes.at(offset + i);
+		}
+		return value;
+	}
+
+	void writeUInt(std::vector<uint8_t>& bytes, size_t offset, uint32_t value) {
+		for (int i = 0; i < 4; ++i) {
+			bytes.at(offset + i) = static_cast<uint8_t>(value >> (8 * i));
+		}
+	}
+
+	// Offsets of fields in a stream state, as written by StreamingAnalyzer::serialize()
+	struct StateLayout {
+		size_t vadTime;
+		size_t firstSampleIndex;
+	};
+
+	StateLayout getLayout(const std::vector<uint8_t>& state) {
+		// Magic, version and sample rate
+		size_t offset = 12;
+		// Dialog
+		if (state.at(offset++)) {
+			offset += 4 + readUInt(state, offset);
+		}
+		// Quality level and DC offset
+		offset += 4 + 16;
+		// VAD detector values and pending samples
+		offset += 4 + 4 * readUInt(state, offset);
+		offset += 4 + 2 * readUInt(state, offset);
+		StateLayout layout {};
+		layout.vadTime = offset;
+		offset += 4;
+		// Open segment
+		if (state.at(offset++)) {
+			offset += 8;
+		}
+		// Pending utterances
+		offset += 4 + 8 * readUInt(state, offset);
+		layout.firstSampleIndex = offset;
+		return layout;
+	}
+
+	bool restores(const std::vector<uint8_t>& state) {
+		const int32_t stream =
+			lipsyncengine_stream_restore(state.data(), static_cast<int32_t>(state.size()), nullptr);
+		if (stream < 0) return false;
+
+		// Reading the samples is what a bad state would break
+		const std::vector<int16_t> samples = createSpeech(16000, 1.0);
+		const bool pushed =
+			lipsyncengine_stream_push(stream, samples.data(), static_cast<int32_t>(samples.size())) == 0;
+		lipsyncengine_stream_abort(stream);
+		return pushed;
+	}
+
+	bool rejects(const std::vector<uint8_t>& state) {
+		const int32_t stream =
+			lipsyncengine_stream_restore(state.data(), static_cast<int32_t>(state.size()), nullptr);
+		if (stream < 0) return true;
+
+		// Pushing to the stream could read outside of its samples
+		lipsyncengine_stream_abort(stream);
+		return false;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	if (argc != 2) {
+		std::fprintf(stderr, "Usage: %s <models directory>\n", argv[0]);
+		return 2;
+	}
+	if (lipsyncengine_init(argv[1]) != 0) {
+		std::fprintf(stderr, "Initialization failed: %s\n", lipsyncengine_get_last_error());
+		return 2;
+	}
+
+	const int32_t stream = lipsyncengine_stream_begin(16000, nullptr, nullptr);
+	check(stream >= 0, "Beginning a stream");
+	const std::vector<int16_t> speech = createSpeech(16000, 4.0);
+	check(
+		lipsyncengine_stream_push(stream, speech.data(), static_cast<int32_t>(speech.size())) == 0,
+		"Pushing audio"
+	);
+	int32_t byteCount = 0;
+	const uint8_t* saved = lipsyncengine_stream_save(stream, &byteCount);
+	check(saved != nullptr, "Saving the stream");
+	lipsyncengine_stream_abort(stream);
+	if (!saved) {
+		lipsyncengine_cleanup();
+		return 1;
+	}
+	const std::vector<uint8_t> state(saved, saved + byteCount);
+	lipsyncengine_free(saved);
+	const StateLayout layout = getLayout(state);
+
+	check(restores(state), "Restoring the saved state");
+
+	std::vector<uint8_t> laterSamples = state;
+	writeUInt(laterSamples, layout.firstSampleIndex, 10000000);
+	writeUInt(laterSamples, layout.firstSampleIndex + 4, 0);
+	check(rejects(laterSamples), "Rejecting samples that start after the utterances they cover");
+
+	std::vector<uint8_t> laterVad = state;
+	writeUInt(laterVad, layout.vadTime, readUInt(state, layout.vadTime) + 100000);
+	check(rejects(laterVad), "Rejecting voice activity beyond the samples");
+
+	lipsyncengine_cleanup();
+	if (failureCount > 0) return 1;
+	std::printf("All stream state checks passed\n");
+	return 0;
+}
@@ -33,5 +33,60 @@ export default defineConfig([
     onSuccess: async () => {
       console.log('✅ Worker build complete');
     },
+  },
+  // Node.js entry point (ESM only, as it locates the Node.js build with import.meta.url)
+  {
+    entry: ['src/ts/node.ts'],
+    format: ['esm'],
+    platform: 'node',
+    target: 'node18',
+    dts: true,
+    clean: false,
+    sourcemap: true,
+    splitting: false,
+    minify: true,
+    treeshake: true,
+    external: [],
+    outDir: 'dist',
+    outExtension: () => ({ js: '.mjs', dts: '.d.mts' }),
+    onSuccess: async () => {
+      console.log('✅ Node.js build complete');
+    },
+  },
+  // Worker thread bundle of NodeWorkerPool
+  {
+    entry: ['src/ts/node-worker.ts'],
+    format: ['esm'],
+    platform: 'node',
+    target: 'node18',
+    dts: false,
+    clean: false,
+    sourcemap: true,
+    splitting: false,
+    minify: true,
+    treeshake: true,
+    external: [],
+    outDir: 'dist',
+    outExtension: () => ({ js: '.mjs' }),
+    onSuccess: async () => {
+      console.log('✅ Node.js worker build complete');
+    },
+  },
+  // Capture worklet bundle (loaded by AudioWorklet.addModule())
+  {
+    entry: ['src/ts/capture-worklet.ts'],
+    format: ['esm'],
+    dts: false,
+    clean: false,
+    sourcemap: true,
+    splitting: false,
+    minify: true,
+    treeshake: true,
+    external: [],
+    outDir: 'dist',
+    outExtension: () => ({ js: '.js' }),
+    onSuccess: async () => {
+      console.log('✅ Capture worklet build complete');
+    },
   }
 ]);